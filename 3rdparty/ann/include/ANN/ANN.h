@@ -83,6 +83,20 @@
   #define DLL_API
 #endif
 
+//----------------------------------------------------------------------
+// ANN_THREAD_LOCAL
+// The search routines keep their state in global variables to keep the
+// argument lists of the recursive calls short. These globals are thread
+// local so that several threads can search the same (const) tree at
+// once. ANN_REENTRANT_SEARCH tells clients that this is the case.
+//----------------------------------------------------------------------
+#if defined(_MSC_VER)
+  #define ANN_THREAD_LOCAL __declspec(thread)
+#else
+  #define ANN_THREAD_LOCAL __thread
+#endif
+#define ANN_REENTRANT_SEARCH 1
+
 //----------------------------------------------------------------------
 //  basic includes
 //----------------------------------------------------------------------
@@ -76,9 +76,9 @@
 //		These are given below.
 //----------------------------------------------------------------------
 
-int				ANNkdDim;				// dimension of space
-double			ANNkdMaxErr;			// max tolerable squared error
-ANNpointArray	ANNkdPts;				// the points
+ANN_THREAD_LOCAL int				ANNkdDim;				// dimension of space
+ANN_THREAD_LOCAL double			ANNkdMaxErr;			// max tolerable squared error
+ANN_THREAD_LOCAL ANNpointArray	ANNkdPts;				// the points
 
 //----------------------------------------------------------------------
 //	annkSearch - search for the k nearest neighbors
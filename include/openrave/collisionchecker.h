@@ -70,6 +70,7 @@ public:
 
     CollisionReport() {
         nKeepPrevious = 0;
+        nMaxContacts = 0;
         Reset();
     }
 
@@ -92,11 +93,42 @@ public:
 
     uint8_t nKeepPrevious; ///< if 1, will keep all previous data when resetting the collision checker. otherwise will reset
 
+    /// \brief if > 0, the checkers stop computing contacts once the report holds this many, see CO_Contacts. Is not changed by \ref Reset.
+    ///
+    /// Callers that only need a few contacts should set it so that contact queries cost about as much as boolean queries.
+    uint32_t nMaxContacts;
+
     //KinBody::Link::GeomConstPtr pgeom1, pgeom2; ///< the specified geometries hit for the given links
 };
 
 typedef CollisionReport COLLISIONREPORT RAVE_DEPRECATED;
 
+/** \brief returns a report from a pool owned by the calling thread, so frequent queries do not have to allocate a report and its contact buffers every time.
+
+    When the last reference is released, the report is reset and put back into the pool of the releasing thread, so it should not be kept.
+    nKeepPrevious and nMaxContacts are 0.
+ */
+OPENRAVE_API CollisionReportPtr RaveGetPooledCollisionReport();
+
+/// \brief Holds the result of a minimum distance query between two sets of links, see \ref CollisionCheckerBase::ComputeDistance
+class OPENRAVE_API DistanceReport
+{
+public:
+    DistanceReport() {
+        Reset();
+    }
+
+    /// \brief resets the report structure for the next distance query
+    inline void Reset() {
+        plink1.reset();
+        plink2.reset();
+        distance = std::numeric_limits<dReal>::infinity();
+    }
+
+    KinBody::LinkConstPtr plink1, plink2; ///< the links holding the closest features. plink1 belongs to the first body (or its attached bodies). Empty if there are no geometries to measure against.
+    dReal distance; ///< the minimum distance between the links, 0 if they are colliding. Infinity if there are no geometries to measure against.
+};
+
 /** \brief <b>[interface]</b> Responsible for all collision checking queries of the environment. <b>If not specified, method is not multi-thread safe.</b> See \ref arch_collisionchecker.
     \ingroup interfaces
  */
@@ -199,6 +231,49 @@ public:
     /// \param[out] report [optional] collision report to be filled with data about the collision. If a body was hit, CollisionReport::plink1 contains the hit link pointer.
     virtual bool CheckCollision(const RAY& ray, CollisionReportPtr report = CollisionReportPtr()) = 0;
 
+    /// \brief Checks a batch of rays against the scene, equivalent to calling \ref CheckCollision(const RAY&,CollisionReportPtr) for every ray. CO_ActiveDOFs option is ignored.
+    ///
+    /// The default implementation calls CheckCollision once per ray, checkers can override it in order to amortize the synchronization of the scene across the batch.
+    /// \param rays holds the origin and direction of every ray. The length of a ray is the length of its direction.
+    /// \param[out] vdistances resized to rays.size(), vdistances[i] is the CollisionReport::minDistance of the hit of ray i, or -1 if it does not hit anything
+    /// \param[out] vhitlinks resized to rays.size(), vhitlinks[i] is the link hit by ray i, empty if there is no hit or the checker does not report it
+    /// \return the number of rays that hit something
+    virtual size_t CheckCollisionRays(const std::vector<RAY>& rays, std::vector<dReal>& vdistances, std::vector<KinBody::LinkConstPtr>& vhitlinks);
+
+    /// \brief Computes the minimum distance between two bodies. Attached bodies are respected.
+    ///
+    /// Unlike the CO_Distance option, the distance is computed regardless of the current collision options and the links are reported even when not colliding.
+    /// The default implementation sets the CO_Distance option and calls \ref CheckCollision(KinBodyConstPtr,KinBodyConstPtr,CollisionReportPtr),
+    /// checkers can override it in order to cache the closest features between consecutive queries.
+    /// \param[out] report filled with the minimum distance and the closest links
+    /// \return false if the checker does not support distance queries, in which case report is not filled
+    virtual bool ComputeDistance(KinBodyConstPtr pbody1, KinBodyConstPtr pbody2, DistanceReport& report);
+
+    /// \brief Computes the minimum distance between a body and the rest of the environment. Attached bodies are respected.
+    ///
+    /// The default implementation sets the CO_Distance option and calls \ref CheckCollision(KinBodyConstPtr,CollisionReportPtr).
+    /// \param[out] report filled with the minimum distance and the closest links, plink1 belongs to pbody or its attached bodies
+    /// \return false if the checker does not support distance queries, in which case report is not filled
+    virtual bool ComputeDistance(KinBodyConstPtr pbody, DistanceReport& report);
+
+    /** \brief Checks if a body collides with the environment while its DOFs move along a straight line from vstart to vend. Attached bodies are respected.
+
+        The default implementation uses conservative advancement on top of \ref ComputeDistance(KinBodyConstPtr,DistanceReport&):
+        the motion of every point of the body per unit of path parameter is bounded using the rigid distances along the kinematic chain,
+        so the path can be advanced by the current distance divided by that bound without missing any contact. Checkers with warm-started
+        distance queries make every step cheap. Self-collisions are not checked. Bodies whose moving DOFs drive mimic joints are not supported.
+
+        The DOF values of the body are restored before returning.
+        \param[in] dofindices the DOFs that move, if empty then all the DOFs of the body
+        \param[in] vstart the DOF values at the start of the segment, same size as dofindices
+        \param[in] vend the DOF values at the end of the segment, same size as dofindices. The interpolation is linear, so circular DOFs should already be unwrapped.
+        \param[out] fcollisiontime if colliding, the path parameter in [0,1] where the body first comes within fdistancetolerance of the environment
+        \param[in] fdistancetolerance the distance considered as contact, has to be positive so that the advancement terminates
+        \return true if the body collides somewhere on the segment
+        \throw openrave_exception ORE_NotImplemented if the checker does not support distance queries
+     */
+    virtual bool CheckContinuousCollision(KinBodyPtr pbody, const std::vector<int>& dofindices, const std::vector<dReal>& vstart, const std::vector<dReal>& vend, dReal& fcollisiontime, dReal fdistancetolerance=0.001);
+
     /// \brief Checks self collision only with the links of the passed in body.
     ///
     /// Only checks KinBody::GetNonAdjacentLinks(), Links that are joined together are ignored.
@@ -212,6 +287,19 @@ public:
     /// \param[out] report [optional] collision report to be filled with data about the collision.
     virtual bool CheckStandaloneSelfCollision(KinBody::LinkConstPtr plink, CollisionReportPtr report = CollisionReportPtr()) = 0;
 
+    /// \brief checks collision of a body and a scene for a batch of configurations. Attached bodies are respected. If CO_ActiveDOFs is set, will only check affected links of the body.
+    ///
+    /// The body is set to each configuration in turn with KinBody::SetDOFValues (limits are not checked) and the state of the body is restored before returning.
+    /// The default implementation calls \ref CheckCollision once per configuration, checkers can override it in order to amortize the synchronization of the scene across the batch. No collision reports are filled.
+    /// \param pbody the body to check, the other bodies in the environment should not move during the call
+    /// \param dofindices the dof indices each configuration sets. If empty, each configuration holds the values of all the dofs of the body
+    /// \param pconfigs numconfigs consecutive configurations of dofindices.size() (or pbody->GetDOF()) values each
+    /// \param numconfigs the number of configurations to check
+    /// \param[out] vresults resized to numconfigs, vresults[i] is 1 if configuration i is in collision, 0 otherwise
+    /// \param bcheckself if true, will also check the self collision of the body with \ref CheckStandaloneSelfCollision
+    /// \return the number of configurations in collision
+    virtual size_t CheckCollisionBatch(KinBodyPtr pbody, const std::vector<int>& dofindices, const dReal* pconfigs, size_t numconfigs, std::vector<uint8_t>& vresults, bool bcheckself=false);
+
     /// \deprecated (13/04/09)
     virtual bool CheckSelfCollision(KinBodyConstPtr pbody, CollisionReportPtr report = CollisionReportPtr()) RAVE_DEPRECATED
     {
@@ -44,6 +44,46 @@ public:
     /// Do not call inside a SimulationStep call
     virtual void Reset()=0;
 
+    /// \brief Executes a command on the environment. <b>[multi-thread safe]</b>
+    ///
+    /// The commands are:
+    /// - \b SetProfilingEnabled 0|1 - starts or stops timing the \ref utils::ProfileZone scopes of the hot paths (FK, collision, IK, planning, smoothing). Profiling is process-wide, so it covers all the environments.
+    /// - \b ResetProfiling - clears the profiling statistics
+    /// - \b GetProfilingStatistics - outputs the count, total, mean, min, and max time of every zone as a JSON object
+    /// - \b SetThreadPoolSize numthreads [cpu0 cpu1 ...] - sets the number of workers of the process-wide thread pool that runs the parallel planning, smoothing, collision, and IK work, and optionally the cpus they are pinned to, see \ref utils::SetThreadPoolSize
+    /// - \b GetThreadPoolSize - outputs the number of workers of the thread pool
+    /// - \b ResetThreadPoolStatistics - clears the thread pool statistics
+    /// - \b GetThreadPoolStatistics - outputs the count, cancelled count, total and max run time, and total queue time of every task type as a JSON object
+    /// \return true if the command is known and succeeded
+    virtual bool SendCommand(std::ostream& sout, std::istream& sinput);
+
+    /// \brief starts deferring the change callbacks of the bodies, see \ref KinBody::RegisterChangeCallback. Needs the environment to be locked.
+    ///
+    /// Until the matching \ref EndBodyChangeBatch, the callbacks of every body are only fired once per changed property when the batch ends,
+    /// so collision checkers, viewers and other listeners do not process the same body repeatedly while it is loaded, grabbed, or moved in bulk.
+    /// The update stamps and hashes of the bodies are still updated immediately. Batches can be nested, the callbacks fire when the outermost ends.
+    /// Prefer the \ref EnvironmentBodyChangeBatch helper, which ends the batch even if an exception is thrown.
+    void BeginBodyChangeBatch();
+
+    /// \brief ends a batch started with \ref BeginBodyChangeBatch and fires the deferred callbacks if it is the outermost one. Needs the environment to be locked.
+    void EndBodyChangeBatch();
+
+    /// \brief returns true if the change callbacks of the bodies are being deferred
+    inline bool IsBodyChangeBatchActive() const {
+        return __nBodyChangeBatchDepth > 0;
+    }
+
+    /// \brief enables or disables all the links of the bodies inside one change batch. Needs the environment to be locked.
+    ///
+    /// The collision checkers only toggle the collision objects of the links, the bodies keep their place in the collision spaces
+    /// so that toggling is cheap and does not resynchronize the transforms.
+    void EnableBodies(const std::vector<KinBodyPtr>& vbodies, bool bEnable);
+
+    /// \brief sets the link enable states of several bodies inside one change batch, see \ref KinBody::SetLinkEnableStates. Needs the environment to be locked.
+    ///
+    /// \param vlinkenablestates one vector of enable states per body
+    void SetBodiesLinkEnableStates(const std::vector<KinBodyPtr>& vbodies, const std::vector< std::vector<uint8_t> >& vlinkenablestates);
+
     /// \brief set user data
     virtual void SetUserData(UserDataPtr data) {
         __pUserData = data;
@@ -76,6 +116,7 @@ public:
     /// \brief Clones the reference environment into the current environment
     ///
     /// Tries to preserve computation by re-using bodies/interfaces that are already similar between the current and reference environments.
+    /// When keeping a clone in sync with a parent environment (for example one clone per worker thread), pass \ref Clone_SkipUnchangedBodies so that the cost is proportional to the number of bodies that changed since the last call.
     /// \param[in] cloningoptions The parts of the environment to clone. Parts not specified are left as is.
     virtual void Clone(EnvironmentBaseConstPtr preference, int cloningoptions) = 0;
 
@@ -182,6 +223,63 @@ public:
     ///
     /// See \ref arch_simulation for more about the simulation thread.
     virtual uint64_t GetSimulationTime() = 0;
+
+    /// \brief the parts of the environment advanced by \ref StepSimulation, in the order they are stepped
+    enum SimulationSubsystem
+    {
+        SS_Physics = 0, ///< the physics engine
+        SS_Controllers = 1, ///< the bodies (which step their controllers) and the modules
+        SS_Sensors = 2, ///< the sensors
+        SS_NumSubsystems = 3,
+    };
+
+    /** \brief Sets the simulation period of a subsystem (in seconds). <b>[multi-thread safe]</b>
+
+        A period of 0 (default) steps the subsystem at every \ref StepSimulation call. Otherwise the subsystem accumulates the simulation time
+        of the \ref StepSimulation calls and is stepped once the accumulated time reaches the period, with the accumulated time as its time step.
+        When the real-time simulation thread is running and a step of the subsystem takes longer in real time than its period (an overrun),
+        the ticks of the subsystem that become due during the overrun are skipped and their time is coalesced into its next step.
+     */
+    virtual void SetSimulationSubsystemPeriod(SimulationSubsystem subsystem, dReal period) = 0;
+
+    /// \brief Returns the simulation period of a subsystem set with \ref SetSimulationSubsystemPeriod. <b>[multi-thread safe]</b>
+    virtual dReal GetSimulationSubsystemPeriod(SimulationSubsystem subsystem) const = 0;
+
+    /// \brief Timing counters of \ref StepSimulation and the simulation thread, see \ref GetSimulationStatistics
+    class OPENRAVE_API SimulationStatistics
+    {
+public:
+        class OPENRAVE_API SubsystemStatistics
+        {
+public:
+            SubsystemStatistics() : numSteps(0), numOverruns(0), numSkippedTicks(0), totalStepTime(0), maxStepTime(0) {
+            }
+            uint64_t numSteps; ///< number of times the subsystem was stepped
+            uint64_t numOverruns; ///< number of steps that took longer in real time than the simulation time they advanced
+            uint64_t numSkippedTicks; ///< number of due ticks that were skipped because the subsystem was overrunning
+            uint64_t totalStepTime; ///< total real time spent stepping the subsystem (us)
+            uint64_t maxStepTime; ///< longest real time of a step of the subsystem (us)
+        };
+
+        SimulationStatistics() : numSteps(0), numLateSteps(0), simulationTime(0), realTime(0) {
+        }
+
+        /// \brief simulation time advanced per real time elapsed, 1 if the simulation keeps up with real time
+        inline dReal GetRealTimeFactor() const {
+            return realTime > 0 ? dReal(simulationTime)/dReal(realTime) : dReal(0);
+        }
+
+        SubsystemStatistics subsystems[SS_NumSubsystems]; ///< indexed by \ref SimulationSubsystem
+        uint64_t numSteps; ///< number of \ref StepSimulation calls
+        uint64_t numLateSteps; ///< number of times the real-time simulation thread fell behind real time and dropped the lag
+        uint64_t simulationTime; ///< simulation time advanced (us)
+        uint64_t realTime; ///< real time elapsed (us)
+    };
+
+    /// \brief Returns the simulation counters accumulated since the environment was created or the counters were reset. <b>[multi-thread safe]</b>
+    ///
+    /// \param bReset if true, resets the counters after reading them
+    virtual void GetSimulationStatistics(SimulationStatistics& stats, bool bReset=false) = 0;
     //@}
 
     /// \name File Loading and Parsing
@@ -434,6 +532,15 @@ public:
     /// \throw openrave_exception with ORE_Timeout error code
     virtual void GetBodies(std::vector<KinBodyPtr>& bodies, uint64_t timeout=0) const = 0;
 
+    /// \brief Computes the axis-aligned bounding boxes of all the bodies in the environment (including robots) at once.
+    ///
+    /// The environment should be locked so that the bodies do not move in the meantime. Only the boxes of bodies that
+    /// changed since their last \ref KinBody::ComputeAABB are recomputed.
+    /// \param[out] bodies filled with all the bodies, same as \ref GetBodies
+    /// \param[out] vaabbs the world bounding box of every body
+    /// \param timeout microseconds to wait for the bodies before throwing an exception, if 0, will block indefinitely.
+    virtual void ComputeBodiesAABB(std::vector<KinBodyPtr>& bodies, std::vector<AABB>& vaabbs, uint64_t timeout=0) const;
+
     /// \brief Fill an array with all robots loaded in the environment. <b>[multi-thread safe]</b>
     ///
     /// A separate **interface mutex** is locked for reading the bodies.
@@ -443,12 +550,17 @@ public:
 
     /// \brief Retrieve published bodies, completes even if environment is locked. <b>[multi-thread safe]</b>
     ///
-    /// A separate **interface mutex** is locked for reading the modules.
+    /// The published bodies are an immutable snapshot, so reading them never waits on the environment or interface mutexes.
     /// Note that the pbody pointer might become invalid as soon as GetPublishedBodies returns.
     /// \param timeout microseconds to wait before throwing an exception, if 0, will block indefinitely.
     /// \throw openrave_exception with ORE_Timeout error code
     virtual void GetPublishedBodies(std::vector<KinBody::BodyState>& vbodies, uint64_t timeout=0) = 0;
 
+    /// \brief Returns a stamp that changes every time the published bodies are updated or cleared. <b>[multi-thread safe]</b>
+    ///
+    /// Readers polling the published bodies can compare it with the previous stamp to skip copying unchanged snapshots.
+    virtual uint64_t GetPublishedBodiesStamp() const = 0;
+
     /// \brief Updates the published bodies that viewers and other programs listening in on the environment see.
     ///
     /// For example, calling this function inside a planning loop allows the viewer to update the environment
@@ -458,6 +570,27 @@ public:
     /// \throw openrave_exception with ORE_Timeout error code
     virtual void UpdatePublishedBodies(uint64_t timeout=0) = 0;
 
+    /** \brief Writes the published bodies whose state changed after a stamp in a compact binary format. <b>[multi-thread safe]</b>
+
+        Replicas of the environment in other processes keep the stamp of the last delta they applied and only receive the link transformations
+        and joint values of the bodies that were published with a new update stamp since then, see \ref ApplyPublishedBodiesDelta.
+        Every delta also has the environment ids of all the published bodies, so that replicas can drop the removed ones.
+        \param O the output stream, should be opened in binary mode
+        \param stamp the stamp returned with the last delta the replica applied, or 0 to write all the bodies
+        \return the stamp of the written snapshot, see \ref GetPublishedBodiesStamp
+     */
+    virtual uint64_t WritePublishedBodiesDelta(std::ostream& O, uint64_t stamp) = 0;
+
+    /** \brief Applies a delta written by \ref WritePublishedBodiesDelta to a replica of the published bodies
+
+        The bodies are matched by their environment id and BodyState::pbody is left empty.
+        \param I the delta
+        \param vbodies the replica, updated in place
+        \return the stamp of the delta, which should be passed to the next WritePublishedBodiesDelta
+        \throw openrave_exception if the delta is truncated or malformed
+     */
+    static uint64_t ApplyPublishedBodiesDelta(std::istream& I, std::vector<KinBody::BodyState>& vbodies);
+
     /// Get the corresponding body from its unique network id
     virtual KinBodyPtr GetBodyFromEnvironmentId(int id) = 0;
 
@@ -470,11 +603,21 @@ public:
 
     /// \brief General triangulation of the whole scene. <b>[multi-thread safe]</b>
     ///
+    /// Only the bodies that changed since the last call are triangulated again, see \ref TriangulateSceneMeshes.
     /// \param[out] trimesh - The output triangle mesh. The new triangles are appended to the existing triangles!
     /// \param[in] options - Controlls what to triangulate.
     /// \param[in] selectname - name of the body used in options
     /// \throw openrave_exception Throw if failed to add anything
     virtual void TriangulateScene(TriMesh& trimesh, SelectionOptions options, const std::string& selectname) = 0;
+
+    /// \brief Per-body triangulation of the scene in world coordinates without copying it into one mesh. <b>[multi-thread safe]</b>
+    ///
+    /// The environment keeps the world-space mesh of each body and only recomputes it when the update stamp or the link geometries of the body change,
+    /// so calling this every cycle only costs the bodies that moved. The returned meshes are never modified by the environment afterwards and can be kept.
+    /// \param[out] vmeshes one (body, mesh) entry per selected body in the order of the environment bodies
+    /// \param[in] options - Controlls what to triangulate.
+    /// \param[in] selectname - name of the body used in options
+    virtual void TriangulateSceneMeshes(std::vector< std::pair<KinBodyConstPtr, boost::shared_ptr<TriMesh const> > >& vmeshes, SelectionOptions options, const std::string& selectname) = 0;
     //@}
 
     /// \brief Load a new module, need to Lock if calling outside simulation thread
@@ -505,6 +648,30 @@ public:
     /// is locked, the user is guaranteed that nnothing will change in the environment.
     virtual EnvironmentMutex& GetMutex() const = 0;
 
+    /// \brief Counters describing how often threads had to wait for the environment locks.
+    ///
+    /// Only acquisitions that could not be granted immediately are counted, so uncontended locking stays free.
+    /// The environment mutex is only tracked when it is locked inside the environment methods, not when users lock \ref GetMutex directly.
+    class OPENRAVE_API LockStatistics
+    {
+public:
+        LockStatistics() : numEnvironmentContended(0), environmentWaitTime(0), numInterfacesSharedContended(0), interfacesSharedWaitTime(0), numInterfacesExclusiveContended(0), interfacesExclusiveWaitTime(0) {
+        }
+        uint64_t numEnvironmentContended; ///< number of times the environment mutex had to be waited on
+        uint64_t environmentWaitTime; ///< total time waited for the environment mutex (us)
+        uint64_t numInterfacesSharedContended; ///< number of times a read access of the **interface mutex** had to be waited on
+        uint64_t interfacesSharedWaitTime; ///< total time waited for read accesses of the **interface mutex** (us)
+        uint64_t numInterfacesExclusiveContended; ///< number of times a write access of the **interface mutex** had to be waited on
+        uint64_t interfacesExclusiveWaitTime; ///< total time waited for write accesses of the **interface mutex** (us)
+    };
+
+    /// \brief Returns the lock contention counters accumulated since the environment was created or the counters were reset. <b>[multi-thread safe]</b>
+    ///
+    /// The **interface mutex** protecting the body, robot, sensor, module and viewer lists is a reader-writer lock,
+    /// queries like \ref GetBodies or \ref GetKinBody share it while adding or removing interfaces has exclusive access.
+    /// \param bReset if true, resets the counters after reading them
+    virtual void GetLockStatistics(LockStatistics& stats, bool bReset=false) = 0;
+
     /// \name 3D plotting methods.
     /// \anchor env_plotting
     //@{
@@ -646,9 +813,36 @@ protected:
         return OPENRAVE_ENVIRONMENT_HASH;
     }
 
+    /// \brief writes the bodies of a published snapshot with a BodyState::publishedstamp after stamp, see \ref WritePublishedBodiesDelta
+    static void _WritePublishedBodiesDelta(std::ostream& O, const std::vector<KinBody::BodyState>& vbodies, uint64_t stamp, uint64_t newstamp);
+
 private:
+    /// \brief queues the change callbacks of pbody for parameters if a batch is active, called by \ref KinBody::_PostprocessChangedParameters
+    ///
+    /// \return true if the callbacks were deferred
+    bool _QueueBodyChangeCallbacks(KinBodyPtr pbody, uint32_t parameters);
+
     UserDataPtr __pUserData;         ///< \see GetUserData
     int __nUniqueId;         ///< \see RaveGetEnvironmentId
+    int __nBodyChangeBatchDepth; ///< number of nested \ref BeginBodyChangeBatch calls
+    std::vector< std::pair<KinBodyWeakPtr, uint32_t> > __vBodyChangeBatch; ///< the bodies changed during the batch in the order of their first change, and their changed properties
+    std::map<KinBody*, size_t> __mapBodyChangeBatchIndices; ///< index of each body in __vBodyChangeBatch
+
+    friend class KinBody;
+};
+
+/// \brief Helper class to defer the change callbacks of the bodies while it is in scope, see \ref EnvironmentBase::BeginBodyChangeBatch
+class OPENRAVE_API EnvironmentBodyChangeBatch
+{
+public:
+    EnvironmentBodyChangeBatch(EnvironmentBasePtr penv) : _penv(penv) {
+        _penv->BeginBodyChangeBatch();
+    }
+    virtual ~EnvironmentBodyChangeBatch() {
+        _penv->EndBodyChangeBatch();
+    }
+private:
+    EnvironmentBasePtr _penv;
 };
 
 } // end namespace OpenRAVE
@@ -369,6 +369,127 @@ inline RaveVector<T> operator* (double f, const RaveVector<T>&left)
     return v;
 }
 
+/** \brief Low-level kernels used by the \ref RaveTransform and \ref RaveTransformMatrix operators.
+
+    \ingroup affine_math
+    This is the scalar reference implementation. When OPENRAVE_GEOMETRY_SIMD is set, geometrysimd.h specializes it for float and double with SSE/AVX/NEON code.
+    Matrices are passed as the 12 values of \ref RaveTransformMatrix::m.
+ */
+template <typename T>
+class RaveAffineKernels
+{
+public:
+    /// \brief quat0 * quat1, quaternions are (s,vx,vy,vz)
+    static inline RaveVector<T> QuatMultiply(const RaveVector<T>& quat0, const RaveVector<T>& quat1) {
+        return RaveVector<T>(quat0.x*quat1.x - quat0.y*quat1.y - quat0.z*quat1.z - quat0.w*quat1.w,
+                             quat0.x*quat1.y + quat0.y*quat1.x + quat0.z*quat1.w - quat0.w*quat1.z,
+                             quat0.x*quat1.z + quat0.z*quat1.x + quat0.w*quat1.y - quat0.y*quat1.w,
+                             quat0.x*quat1.w + quat0.w*quat1.x + quat0.y*quat1.z - quat0.z*quat1.y);
+    }
+
+    /// \brief rotates the first 3 values of r by the quaternion, w of the result is 0
+    static inline RaveVector<T> QuatRotate(const RaveVector<T>& quat, const RaveVector<T>& r) {
+        T xx = 2 * quat.y * quat.y;
+        T xy = 2 * quat.y * quat.z;
+        T xz = 2 * quat.y * quat.w;
+        T xw = 2 * quat.y * quat.x;
+        T yy = 2 * quat.z * quat.z;
+        T yz = 2 * quat.z * quat.w;
+        T yw = 2 * quat.z * quat.x;
+        T zz = 2 * quat.w * quat.w;
+        T zw = 2 * quat.w * quat.x;
+
+        RaveVector<T> v;
+        v.x = (1-yy-zz) * r.x + (xy-zw) * r.y + (xz+yw)*r.z;
+        v.y = (xy+zw) * r.x + (1-xx-zz) * r.y + (yz-xw)*r.z;
+        v.z = (xz-yw) * r.x + (yz+xw) * r.y + (1-xx-yy)*r.z;
+        return v;
+    }
+
+    /// \brief mout = m0 * m1 for the rotation part, mout cannot alias the inputs
+    static inline void MatrixMultiply(const T* m0, const T* m1, T* mout) {
+        mout[0*4+0] = m0[0*4+0]*m1[0*4+0]+m0[0*4+1]*m1[1*4+0]+m0[0*4+2]*m1[2*4+0];
+        mout[0*4+1] = m0[0*4+0]*m1[0*4+1]+m0[0*4+1]*m1[1*4+1]+m0[0*4+2]*m1[2*4+1];
+        mout[0*4+2] = m0[0*4+0]*m1[0*4+2]+m0[0*4+1]*m1[1*4+2]+m0[0*4+2]*m1[2*4+2];
+        mout[0*4+3] = 0;
+        mout[1*4+0] = m0[1*4+0]*m1[0*4+0]+m0[1*4+1]*m1[1*4+0]+m0[1*4+2]*m1[2*4+0];
+        mout[1*4+1] = m0[1*4+0]*m1[0*4+1]+m0[1*4+1]*m1[1*4+1]+m0[1*4+2]*m1[2*4+1];
+        mout[1*4+2] = m0[1*4+0]*m1[0*4+2]+m0[1*4+1]*m1[1*4+2]+m0[1*4+2]*m1[2*4+2];
+        mout[1*4+3] = 0;
+        mout[2*4+0] = m0[2*4+0]*m1[0*4+0]+m0[2*4+1]*m1[1*4+0]+m0[2*4+2]*m1[2*4+0];
+        mout[2*4+1] = m0[2*4+0]*m1[0*4+1]+m0[2*4+1]*m1[1*4+1]+m0[2*4+2]*m1[2*4+1];
+        mout[2*4+2] = m0[2*4+0]*m1[0*4+2]+m0[2*4+1]*m1[1*4+2]+m0[2*4+2]*m1[2*4+2];
+        mout[2*4+3] = 0;
+    }
+
+    /// \brief m * r + trans for the first 3 values of r, w of the result is 0
+    static inline RaveVector<T> MatrixTransform(const T* m, const RaveVector<T>& trans, const RaveVector<T>& r) {
+        RaveVector<T> v;
+        v.x = r.x * m[0] + r.y * m[1] + r.z * m[2] + trans.x;
+        v.y = r.x * m[4] + r.y * m[5] + r.z * m[6] + trans.y;
+        v.z = r.x * m[8] + r.y * m[9] + r.z * m[10] + trans.z;
+        return v;
+    }
+
+    /// \brief m * r for the first 3 values of r, w of the result is 0
+    static inline RaveVector<T> MatrixRotate(const T* m, const RaveVector<T>& r) {
+        RaveVector<T> v;
+        v.x = r.x * m[0] + r.y * m[1] + r.z * m[2];
+        v.y = r.x * m[4] + r.y * m[5] + r.z * m[6];
+        v.z = r.x * m[8] + r.y * m[9] + r.z * m[10];
+        return v;
+    }
+
+    /// \brief transforms numpoints packed xyz points by m and trans. dst can be the same as src.
+    static inline void TransformPoints(const T* m, const RaveVector<T>& trans, const T* src, T* dst, size_t numpoints) {
+        for(size_t i = 0; i < numpoints; ++i, src += 3, dst += 3) {
+            T x = src[0], y = src[1], z = src[2];
+            dst[0] = x * m[0] + y * m[1] + z * m[2] + trans.x;
+            dst[1] = x * m[4] + y * m[5] + z * m[6] + trans.y;
+            dst[2] = x * m[8] + y * m[9] + z * m[10] + trans.z;
+        }
+    }
+
+    /// \brief transforms numpoints packed xyz points by a quaternion and trans, gives the same values as QuatRotate(quat,r)+trans. dst can be the same as src.
+    static inline void TransformPoints(const RaveVector<T>& quat, const RaveVector<T>& trans, const T* src, T* dst, size_t numpoints) {
+        T m[12];
+        _MatrixFromQuatRotate(quat, m);
+        for(size_t i = 0; i < numpoints; ++i, src += 3, dst += 3) {
+            T x = src[0], y = src[1], z = src[2];
+            dst[0] = trans.x + (m[0] * x + m[1] * y + m[2] * z);
+            dst[1] = trans.y + (m[4] * x + m[5] * y + m[6] * z);
+            dst[2] = trans.z + (m[8] * x + m[9] * y + m[10] * z);
+        }
+    }
+
+protected:
+    /// \brief the coefficients QuatRotate uses, without normalizing the quaternion like \ref matrixFromQuat
+    static inline void _MatrixFromQuatRotate(const RaveVector<T>& quat, T* m) {
+        T xx = 2 * quat.y * quat.y;
+        T xy = 2 * quat.y * quat.z;
+        T xz = 2 * quat.y * quat.w;
+        T xw = 2 * quat.y * quat.x;
+        T yy = 2 * quat.z * quat.z;
+        T yz = 2 * quat.z * quat.w;
+        T yw = 2 * quat.z * quat.x;
+        T zz = 2 * quat.w * quat.w;
+        T zw = 2 * quat.w * quat.x;
+        m[0] = 1-yy-zz; m[1] = xy-zw; m[2] = xz+yw; m[3] = 0;
+        m[4] = xy+zw; m[5] = 1-xx-zz; m[6] = yz-xw; m[7] = 0;
+        m[8] = xz-yw; m[9] = yz+xw; m[10] = 1-xx-yy; m[11] = 0;
+    }
+};
+
+} // end namespace geometry
+} // end namespace OpenRAVE
+
+#if defined(OPENRAVE_GEOMETRY_SIMD) && OPENRAVE_GEOMETRY_SIMD
+#include <openrave/geometrysimd.h>
+#endif
+
+namespace OpenRAVE {
+namespace geometry {
+
 /** \brief Affine transformation parameterized with quaterions.
 
     \ingroup affine_math
@@ -402,31 +523,14 @@ public:
 
     /// transform a vector by the rotation component only
     inline RaveVector<T> rotate(const RaveVector<T>& r) const {
-        T xx = 2 * rot.y * rot.y;
-        T xy = 2 * rot.y * rot.z;
-        T xz = 2 * rot.y * rot.w;
-        T xw = 2 * rot.y * rot.x;
-        T yy = 2 * rot.z * rot.z;
-        T yz = 2 * rot.z * rot.w;
-        T yw = 2 * rot.z * rot.x;
-        T zz = 2 * rot.w * rot.w;
-        T zw = 2 * rot.w * rot.x;
-
-        RaveVector<T> v;
-        v.x = (1-yy-zz) * r.x + (xy-zw) * r.y + (xz+yw)*r.z;
-        v.y = (xy+zw) * r.x + (1-xx-zz) * r.y + (yz-xw)*r.z;
-        v.z = (xz-yw) * r.x + (yz+xw) * r.y + (1-xx-yy)*r.z;
-        return v;
+        return RaveAffineKernels<T>::QuatRotate(rot, r);
     }
 
     /// transform a transform by the rotation component only
     inline RaveTransform<T> rotate(const RaveTransform<T>& r) const {
         RaveTransform<T> t;
         t.trans = rotate(r.trans);
-        t.rot.x = rot.x*r.rot.x - rot.y*r.rot.y - rot.z*r.rot.z - rot.w*r.rot.w;
-        t.rot.y = rot.x*r.rot.y + rot.y*r.rot.x + rot.z*r.rot.w - rot.w*r.rot.z;
-        t.rot.z = rot.x*r.rot.z + rot.z*r.rot.x + rot.w*r.rot.y - rot.y*r.rot.w;
-        t.rot.w = rot.x*r.rot.w + rot.w*r.rot.x + rot.y*r.rot.z - rot.z*r.rot.y;
+        t.rot = RaveAffineKernels<T>::QuatMultiply(rot, r.rot);
         // normalize the transformation
         MATH_ASSERT( t.rot.lengthsqr4() > 0.99f && t.rot.lengthsqr4() < 1.01f );
         t.rot.normalize4();
@@ -437,10 +541,7 @@ public:
     inline RaveTransform<T> operator* (const RaveTransform<T>&r) const {
         RaveTransform<T> t;
         t.trans = operator*(r.trans);
-        t.rot.x = rot.x*r.rot.x - rot.y*r.rot.y - rot.z*r.rot.z - rot.w*r.rot.w;
-        t.rot.y = rot.x*r.rot.y + rot.y*r.rot.x + rot.z*r.rot.w - rot.w*r.rot.z;
-        t.rot.z = rot.x*r.rot.z + rot.z*r.rot.x + rot.w*r.rot.y - rot.y*r.rot.w;
-        t.rot.w = rot.x*r.rot.w + rot.w*r.rot.x + rot.y*r.rot.z - rot.z*r.rot.y;
+        t.rot = RaveAffineKernels<T>::QuatMultiply(rot, r.rot);
         // normalize the transformation
         MATH_ASSERT( t.rot.lengthsqr4() > 0.99f && t.rot.lengthsqr4() < 1.01f );
         t.rot.normalize4();
@@ -518,6 +619,10 @@ public:
         return m[4*i+j];
     }
 
+    inline RaveVector<T> operator* (const RaveVector<T>&r) const {
+        return RaveAffineKernels<T>::MatrixTransform(m, trans, r);
+    }
+
     template <typename U>
     inline RaveVector<T> operator* (const RaveVector<U>&r) const {
         RaveVector<T> v;
@@ -530,18 +635,8 @@ public:
     /// t = this * r
     inline RaveTransformMatrix<T> operator* (const RaveTransformMatrix<T>&r) const {
         RaveTransformMatrix<T> t;
-        t.m[0*4+0] = m[0*4+0]*r.m[0*4+0]+m[0*4+1]*r.m[1*4+0]+m[0*4+2]*r.m[2*4+0];
-        t.m[0*4+1] = m[0*4+0]*r.m[0*4+1]+m[0*4+1]*r.m[1*4+1]+m[0*4+2]*r.m[2*4+1];
-        t.m[0*4+2] = m[0*4+0]*r.m[0*4+2]+m[0*4+1]*r.m[1*4+2]+m[0*4+2]*r.m[2*4+2];
-        t.m[1*4+0] = m[1*4+0]*r.m[0*4+0]+m[1*4+1]*r.m[1*4+0]+m[1*4+2]*r.m[2*4+0];
-        t.m[1*4+1] = m[1*4+0]*r.m[0*4+1]+m[1*4+1]*r.m[1*4+1]+m[1*4+2]*r.m[2*4+1];
-        t.m[1*4+2] = m[1*4+0]*r.m[0*4+2]+m[1*4+1]*r.m[1*4+2]+m[1*4+2]*r.m[2*4+2];
-        t.m[2*4+0] = m[2*4+0]*r.m[0*4+0]+m[2*4+1]*r.m[1*4+0]+m[2*4+2]*r.m[2*4+0];
-        t.m[2*4+1] = m[2*4+0]*r.m[0*4+1]+m[2*4+1]*r.m[1*4+1]+m[2*4+2]*r.m[2*4+1];
-        t.m[2*4+2] = m[2*4+0]*r.m[0*4+2]+m[2*4+1]*r.m[1*4+2]+m[2*4+2]*r.m[2*4+2];
-        t.trans[0] = r.trans[0] * m[0] + r.trans[1] * m[1] + r.trans[2] * m[2] + trans.x;
-        t.trans[1] = r.trans[0] * m[4] + r.trans[1] * m[5] + r.trans[2] * m[6] + trans.y;
-        t.trans[2] = r.trans[0] * m[8] + r.trans[1] * m[9] + r.trans[2] * m[10] + trans.z;
+        RaveAffineKernels<T>::MatrixMultiply(m, r.m, t.m);
+        t.trans = RaveAffineKernels<T>::MatrixTransform(m, trans, r.trans);
         return t;
     }
 
@@ -550,6 +645,10 @@ public:
         return *this;
     }
 
+    inline RaveVector<T> rotate(const RaveVector<T>& r) const {
+        return RaveAffineKernels<T>::MatrixRotate(m, r);
+    }
+
     template <typename U>
     inline RaveVector<U> rotate(const RaveVector<U>& r) const {
         RaveVector<U> v;
@@ -561,18 +660,8 @@ public:
 
     inline RaveTransformMatrix<T> rotate(const RaveTransformMatrix<T>& r) const {
         RaveTransformMatrix<T> t;
-        t.m[0*4+0] = m[0*4+0]*r.m[0*4+0]+m[0*4+1]*r.m[1*4+0]+m[0*4+2]*r.m[2*4+0];
-        t.m[0*4+1] = m[0*4+0]*r.m[0*4+1]+m[0*4+1]*r.m[1*4+1]+m[0*4+2]*r.m[2*4+1];
-        t.m[0*4+2] = m[0*4+0]*r.m[0*4+2]+m[0*4+1]*r.m[1*4+2]+m[0*4+2]*r.m[2*4+2];
-        t.m[1*4+0] = m[1*4+0]*r.m[0*4+0]+m[1*4+1]*r.m[1*4+0]+m[1*4+2]*r.m[2*4+0];
-        t.m[1*4+1] = m[1*4+0]*r.m[0*4+1]+m[1*4+1]*r.m[1*4+1]+m[1*4+2]*r.m[2*4+1];
-        t.m[1*4+2] = m[1*4+0]*r.m[0*4+2]+m[1*4+1]*r.m[1*4+2]+m[1*4+2]*r.m[2*4+2];
-        t.m[2*4+0] = m[2*4+0]*r.m[0*4+0]+m[2*4+1]*r.m[1*4+0]+m[2*4+2]*r.m[2*4+0];
-        t.m[2*4+1] = m[2*4+0]*r.m[0*4+1]+m[2*4+1]*r.m[1*4+1]+m[2*4+2]*r.m[2*4+1];
-        t.m[2*4+2] = m[2*4+0]*r.m[0*4+2]+m[2*4+1]*r.m[1*4+2]+m[2*4+2]*r.m[2*4+2];
-        t.trans[0] = r.trans[0] * m[0] + r.trans[1] * m[1] + r.trans[2] * m[2];
-        t.trans[1] = r.trans[0] * m[4] + r.trans[1] * m[5] + r.trans[2] * m[6];
-        t.trans[2] = r.trans[0] * m[8] + r.trans[1] * m[9] + r.trans[2] * m[10];
+        RaveAffineKernels<T>::MatrixMultiply(m, r.m, t.m);
+        t.trans = RaveAffineKernels<T>::MatrixRotate(m, r.trans);
         return t;
     }
 
@@ -955,12 +1044,8 @@ template <typename T> inline RaveTransformMatrix<T> matrixFromAxisAngle(const Ra
 template <typename T>
 inline RaveVector<T> quatMultiply(const RaveVector<T>& quat0, const RaveVector<T>& quat1)
 {
-    RaveVector<T> q(quat0.x*quat1.x - quat0.y*quat1.y - quat0.z*quat1.z - quat0.w*quat1.w,
-                    quat0.x*quat1.y + quat0.y*quat1.x + quat0.z*quat1.w - quat0.w*quat1.z,
-                    quat0.x*quat1.z + quat0.z*quat1.x + quat0.w*quat1.y - quat0.y*quat1.w,
-                    quat0.x*quat1.w + quat0.w*quat1.x + quat0.y*quat1.z - quat0.z*quat1.y);
     // do not normalize since some quaternion math (like derivatives) do not correspond to unit quaternions
-    return q;
+    return RaveAffineKernels<T>::QuatMultiply(quat0, quat1);
 }
 
 /// \brief Inverted a quaternion rotation.
@@ -1201,6 +1286,40 @@ RaveTransformMatrix<T>::RaveTransformMatrix(const RaveTransform<T>& t)
 
 }
 
+/// \brief Transforms an array of points, same as dst[i] = t * src[i].
+///
+/// \ingroup affine_math
+/// \param src numpoints*3 values, packed xyz
+/// \param dst numpoints*3 values, can be the same as src
+template <typename T>
+inline void transformPoints(const RaveTransform<T>& t, const T* src, T* dst, size_t numpoints)
+{
+    RaveAffineKernels<T>::TransformPoints(t.rot, t.trans, src, dst, numpoints);
+}
+
+/// \brief Transforms an array of points, same as dst[i] = t * src[i].
+///
+/// \ingroup affine_math
+/// \param src numpoints*3 values, packed xyz
+/// \param dst numpoints*3 values, can be the same as src
+template <typename T>
+inline void transformPoints(const RaveTransformMatrix<T>& t, const T* src, T* dst, size_t numpoints)
+{
+    RaveAffineKernels<T>::TransformPoints(t.m, t.trans, src, dst, numpoints);
+}
+
+/// \brief Transforms an array of vectors, same as dst[i] = t * src[i].
+///
+/// \ingroup affine_math
+/// \param dst can be the same as src
+template <typename T>
+inline void transformPoints(const RaveTransform<T>& t, const RaveVector<T>* src, RaveVector<T>* dst, size_t numpoints)
+{
+    for(size_t i = 0; i < numpoints; ++i) {
+        dst[i] = t * src[i];
+    }
+}
+
 /// \brief Returns a camera matrix that looks along a ray with a desired up vector.
 ///
 /// \ingroup affine_math
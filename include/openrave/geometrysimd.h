@@ -0,0 +1,395 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2012 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+/** \file   geometrysimd.h
+    \brief  SSE/AVX/NEON specializations of \ref OpenRAVE::geometry::RaveAffineKernels for float and double.
+
+    Included by \ref geometry.h when OPENRAVE_GEOMETRY_SIMD is set, do not include directly.
+    The instruction set is picked from the compiler target flags (for example -march=native). If none is available, the scalar kernels are used.
+    Matrix multiplications and the batch point transforms evaluate the products in the same order as the scalar code.
+    The single quaternion rotation uses the cross-product form, so its results can differ from the scalar code in the last bits.
+ */
+#ifndef OPENRAVE_GEOMETRY_SIMD_H
+#define OPENRAVE_GEOMETRY_SIMD_H
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OPENRAVE_GEOMETRY_SIMD_SSE2
+#include <emmintrin.h>
+#if defined(__AVX__)
+#define OPENRAVE_GEOMETRY_SIMD_AVX
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define OPENRAVE_GEOMETRY_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+namespace OpenRAVE {
+namespace geometry {
+
+/// \brief 4-wide packs the SIMD kernels are written against.
+///
+/// Each pack provides load/store of 4 or 3 values, set, set1, add, sub, mul, a compile-time lane permute, and zerow to clear the 4th lane.
+namespace simd {
+
+#if defined(OPENRAVE_GEOMETRY_SIMD_SSE2)
+
+#define OPENRAVE_GEOMETRY_SIMD_FLOAT
+struct Pack4f
+{
+    typedef __m128 type;
+    static inline type load(const float* p) {
+        return _mm_loadu_ps(p);
+    }
+    static inline type load3(const float* p) {
+        return _mm_setr_ps(p[0], p[1], p[2], 0);
+    }
+    static inline void store(float* p, type v) {
+        _mm_storeu_ps(p, v);
+    }
+    static inline void store3(float* p, type v) {
+        _mm_storel_pi(reinterpret_cast<__m64*>(p), v);
+        _mm_store_ss(p+2, _mm_movehl_ps(v, v));
+    }
+    static inline type set(float x, float y, float z, float w) {
+        return _mm_setr_ps(x, y, z, w);
+    }
+    static inline type set1(float f) {
+        return _mm_set1_ps(f);
+    }
+    static inline type add(type a, type b) {
+        return _mm_add_ps(a, b);
+    }
+    static inline type sub(type a, type b) {
+        return _mm_sub_ps(a, b);
+    }
+    static inline type mul(type a, type b) {
+        return _mm_mul_ps(a, b);
+    }
+    template <int i0, int i1, int i2, int i3> static inline type permute(type v) {
+        return _mm_shuffle_ps(v, v, _MM_SHUFFLE(i3, i2, i1, i0));
+    }
+    static inline type zerow(type v) {
+        return _mm_and_ps(v, _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0)));
+    }
+};
+
+#define OPENRAVE_GEOMETRY_SIMD_DOUBLE
+#if defined(OPENRAVE_GEOMETRY_SIMD_AVX)
+struct Pack4d
+{
+    typedef __m256d type;
+    static inline type load(const double* p) {
+        return _mm256_loadu_pd(p);
+    }
+    static inline type load3(const double* p) {
+        return _mm256_setr_pd(p[0], p[1], p[2], 0);
+    }
+    static inline void store(double* p, type v) {
+        _mm256_storeu_pd(p, v);
+    }
+    static inline void store3(double* p, type v) {
+        _mm_storeu_pd(p, _mm256_castpd256_pd128(v));
+        _mm_store_sd(p+2, _mm256_extractf128_pd(v, 1));
+    }
+    static inline type set(double x, double y, double z, double w) {
+        return _mm256_setr_pd(x, y, z, w);
+    }
+    static inline type set1(double f) {
+        return _mm256_set1_pd(f);
+    }
+    static inline type add(type a, type b) {
+        return _mm256_add_pd(a, b);
+    }
+    static inline type sub(type a, type b) {
+        return _mm256_sub_pd(a, b);
+    }
+    static inline type mul(type a, type b) {
+        return _mm256_mul_pd(a, b);
+    }
+    /// AVX cannot permute across the 128bit halves in one instruction, so permute v and v with its halves swapped and blend
+    template <int i0, int i1, int i2, int i3> static inline type permute(type v) {
+        type swapped = _mm256_permute2f128_pd(v, v, 1);
+        type a = _mm256_permute_pd(v, (i0&1)|((i1&1)<<1)|((i2&1)<<2)|((i3&1)<<3));
+        type b = _mm256_permute_pd(swapped, (i0&1)|((i1&1)<<1)|((i2&1)<<2)|((i3&1)<<3));
+        return _mm256_blend_pd(a, b, ((i0>>1) != 0 ? 1 : 0)|((i1>>1) != 0 ? 2 : 0)|((i2>>1) != 1 ? 4 : 0)|((i3>>1) != 1 ? 8 : 0));
+    }
+    static inline type zerow(type v) {
+        return _mm256_blend_pd(v, _mm256_setzero_pd(), 8);
+    }
+};
+#else
+struct Pack4d
+{
+    struct type
+    {
+        __m128d lo, hi;
+    };
+    static inline type make(__m128d lo, __m128d hi) {
+        type v; v.lo = lo; v.hi = hi; return v;
+    }
+    static inline type load(const double* p) {
+        return make(_mm_loadu_pd(p), _mm_loadu_pd(p+2));
+    }
+    static inline type load3(const double* p) {
+        return make(_mm_loadu_pd(p), _mm_load_sd(p+2));
+    }
+    static inline void store(double* p, const type& v) {
+        _mm_storeu_pd(p, v.lo); _mm_storeu_pd(p+2, v.hi);
+    }
+    static inline void store3(double* p, const type& v) {
+        _mm_storeu_pd(p, v.lo); _mm_store_sd(p+2, v.hi);
+    }
+    static inline type set(double x, double y, double z, double w) {
+        return make(_mm_setr_pd(x, y), _mm_setr_pd(z, w));
+    }
+    static inline type set1(double f) {
+        return make(_mm_set1_pd(f), _mm_set1_pd(f));
+    }
+    static inline type add(const type& a, const type& b) {
+        return make(_mm_add_pd(a.lo, b.lo), _mm_add_pd(a.hi, b.hi));
+    }
+    static inline type sub(const type& a, const type& b) {
+        return make(_mm_sub_pd(a.lo, b.lo), _mm_sub_pd(a.hi, b.hi));
+    }
+    static inline type mul(const type& a, const type& b) {
+        return make(_mm_mul_pd(a.lo, b.lo), _mm_mul_pd(a.hi, b.hi));
+    }
+    template <int i0, int i1, int i2, int i3> static inline type permute(const type& v) {
+        return make(_mm_shuffle_pd(i0 < 2 ? v.lo : v.hi, i1 < 2 ? v.lo : v.hi, (i0&1)|((i1&1)<<1)),
+                    _mm_shuffle_pd(i2 < 2 ? v.lo : v.hi, i3 < 2 ? v.lo : v.hi, (i2&1)|((i3&1)<<1)));
+    }
+    static inline type zerow(const type& v) {
+        return make(v.lo, _mm_move_sd(_mm_setzero_pd(), v.hi));
+    }
+};
+#endif
+
+#elif defined(OPENRAVE_GEOMETRY_SIMD_NEON)
+
+#define OPENRAVE_GEOMETRY_SIMD_FLOAT
+struct Pack4f
+{
+    typedef float32x4_t type;
+    static inline type load(const float* p) {
+        return vld1q_f32(p);
+    }
+    static inline type load3(const float* p) {
+        return vsetq_lane_f32(p[2], vcombine_f32(vld1_f32(p), vdup_n_f32(0)), 2);
+    }
+    static inline void store(float* p, type v) {
+        vst1q_f32(p, v);
+    }
+    static inline void store3(float* p, type v) {
+        vst1_f32(p, vget_low_f32(v));
+        vst1q_lane_f32(p+2, v, 2);
+    }
+    static inline type set(float x, float y, float z, float w) {
+        const float f[4] = {x, y, z, w};
+        return vld1q_f32(f);
+    }
+    static inline type set1(float f) {
+        return vdupq_n_f32(f);
+    }
+    static inline type add(type a, type b) {
+        return vaddq_f32(a, b);
+    }
+    static inline type sub(type a, type b) {
+        return vsubq_f32(a, b);
+    }
+    static inline type mul(type a, type b) {
+        return vmulq_f32(a, b);
+    }
+    template <int i0, int i1, int i2, int i3> static inline type permute(type v) {
+        type r = vdupq_n_f32(vgetq_lane_f32(v, i0));
+        r = vsetq_lane_f32(vgetq_lane_f32(v, i1), r, 1);
+        r = vsetq_lane_f32(vgetq_lane_f32(v, i2), r, 2);
+        return vsetq_lane_f32(vgetq_lane_f32(v, i3), r, 3);
+    }
+    static inline type zerow(type v) {
+        return vsetq_lane_f32(0, v, 3);
+    }
+};
+
+#if defined(__aarch64__)
+#define OPENRAVE_GEOMETRY_SIMD_DOUBLE
+struct Pack4d
+{
+    struct type
+    {
+        float64x2_t lo, hi;
+    };
+    static inline type make(float64x2_t lo, float64x2_t hi) {
+        type v; v.lo = lo; v.hi = hi; return v;
+    }
+    static inline type load(const double* p) {
+        return make(vld1q_f64(p), vld1q_f64(p+2));
+    }
+    static inline type load3(const double* p) {
+        return make(vld1q_f64(p), vsetq_lane_f64(p[2], vdupq_n_f64(0), 0));
+    }
+    static inline void store(double* p, const type& v) {
+        vst1q_f64(p, v.lo); vst1q_f64(p+2, v.hi);
+    }
+    static inline void store3(double* p, const type& v) {
+        vst1q_f64(p, v.lo); vst1q_lane_f64(p+2, v.hi, 0);
+    }
+    static inline type set(double x, double y, double z, double w) {
+        const double f[4] = {x, y, z, w};
+        return load(f);
+    }
+    static inline type set1(double f) {
+        return make(vdupq_n_f64(f), vdupq_n_f64(f));
+    }
+    static inline type add(const type& a, const type& b) {
+        return make(vaddq_f64(a.lo, b.lo), vaddq_f64(a.hi, b.hi));
+    }
+    static inline type sub(const type& a, const type& b) {
+        return make(vsubq_f64(a.lo, b.lo), vsubq_f64(a.hi, b.hi));
+    }
+    static inline type mul(const type& a, const type& b) {
+        return make(vmulq_f64(a.lo, b.lo), vmulq_f64(a.hi, b.hi));
+    }
+    template <int i0, int i1, int i2, int i3> static inline type permute(const type& v) {
+        float64x2_t lo = vdupq_n_f64(vgetq_lane_f64(i0 < 2 ? v.lo : v.hi, i0&1));
+        float64x2_t hi = vdupq_n_f64(vgetq_lane_f64(i2 < 2 ? v.lo : v.hi, i2&1));
+        return make(vsetq_lane_f64(vgetq_lane_f64(i1 < 2 ? v.lo : v.hi, i1&1), lo, 1),
+                    vsetq_lane_f64(vgetq_lane_f64(i3 < 2 ? v.lo : v.hi, i3&1), hi, 1));
+    }
+    static inline type zerow(const type& v) {
+        return make(v.lo, vsetq_lane_f64(0, v.hi, 1));
+    }
+};
+#endif
+
+#endif
+
+/// \brief RaveAffineKernels written against a 4-wide pack P holding RaveVector<T>.
+template <typename T, typename P>
+class AffineKernels
+{
+public:
+    typedef typename P::type pack;
+
+    static inline RaveVector<T> QuatMultiply(const RaveVector<T>& quat0, const RaveVector<T>& quat1) {
+        pack a = P::load(&quat0.x), b = P::load(&quat1.x);
+        pack q = P::mul(P::template permute<0,0,0,0>(a), b);
+        q = P::add(q, P::mul(P::mul(P::template permute<1,1,1,1>(a), P::set(-1,1,-1,1)), P::template permute<1,0,3,2>(b)));
+        q = P::add(q, P::mul(P::mul(P::template permute<2,2,2,2>(a), P::set(-1,1,1,-1)), P::template permute<2,3,0,1>(b)));
+        q = P::add(q, P::mul(P::mul(P::template permute<3,3,3,3>(a), P::set(-1,-1,1,1)), P::template permute<3,2,1,0>(b)));
+        RaveVector<T> v;
+        P::store(&v.x, q);
+        return v;
+    }
+
+    /// r + 2s(u x r) + 2u x (u x r) where quat = (s,u)
+    static inline RaveVector<T> QuatRotate(const RaveVector<T>& quat, const RaveVector<T>& r) {
+        pack q = P::load(&quat.x);
+        pack u = P::zerow(P::template permute<1,2,3,3>(q));
+        pack p = P::load3(&r.x);
+        pack t = _Cross(u, p);
+        t = P::add(t, t);
+        pack res = P::add(P::add(p, P::mul(P::template permute<0,0,0,0>(q), t)), _Cross(u, t));
+        RaveVector<T> v;
+        P::store(&v.x, res);
+        return v;
+    }
+
+    static inline void MatrixMultiply(const T* m0, const T* m1, T* mout) {
+        pack row0 = P::load(m1), row1 = P::load(m1+4), row2 = P::load(m1+8);
+        for(int i = 0; i < 3; ++i) {
+            const T* prow = m0+4*i;
+            pack res = P::add(P::add(P::mul(P::set1(prow[0]), row0), P::mul(P::set1(prow[1]), row1)), P::mul(P::set1(prow[2]), row2));
+            P::store(mout+4*i, P::zerow(res));
+        }
+    }
+
+    static inline RaveVector<T> MatrixTransform(const T* m, const RaveVector<T>& trans, const RaveVector<T>& r) {
+        RaveVector<T> v;
+        P::store(&v.x, P::add(_Rotate(P::set(m[0], m[4], m[8], 0), P::set(m[1], m[5], m[9], 0), P::set(m[2], m[6], m[10], 0), r.x, r.y, r.z), P::load3(&trans.x)));
+        return v;
+    }
+
+    static inline RaveVector<T> MatrixRotate(const T* m, const RaveVector<T>& r) {
+        RaveVector<T> v;
+        P::store(&v.x, _Rotate(P::set(m[0], m[4], m[8], 0), P::set(m[1], m[5], m[9], 0), P::set(m[2], m[6], m[10], 0), r.x, r.y, r.z));
+        return v;
+    }
+
+    static inline void TransformPoints(const T* m, const RaveVector<T>& trans, const T* src, T* dst, size_t numpoints) {
+        pack col0 = P::set(m[0], m[4], m[8], 0), col1 = P::set(m[1], m[5], m[9], 0), col2 = P::set(m[2], m[6], m[10], 0);
+        pack ptrans = P::load3(&trans.x);
+        for(size_t i = 0; i < numpoints; ++i, src += 3, dst += 3) {
+            P::store3(dst, P::add(_Rotate(col0, col1, col2, src[0], src[1], src[2]), ptrans));
+        }
+    }
+
+    static inline void TransformPoints(const RaveVector<T>& quat, const RaveVector<T>& trans, const T* src, T* dst, size_t numpoints) {
+        T m[12];
+        _MatrixFromQuatRotate(quat, m);
+        pack col0 = P::set(m[0], m[4], m[8], 0), col1 = P::set(m[1], m[5], m[9], 0), col2 = P::set(m[2], m[6], m[10], 0);
+        pack ptrans = P::load3(&trans.x);
+        for(size_t i = 0; i < numpoints; ++i, src += 3, dst += 3) {
+            P::store3(dst, P::add(ptrans, _Rotate(col0, col1, col2, src[0], src[1], src[2])));
+        }
+    }
+
+protected:
+    static inline pack _Cross(const pack& a, const pack& b) {
+        return P::sub(P::mul(P::template permute<1,2,0,3>(a), P::template permute<2,0,1,3>(b)), P::mul(P::template permute<2,0,1,3>(a), P::template permute<1,2,0,3>(b)));
+    }
+
+    /// col0*x + col1*y + col2*z, same summation order as the scalar kernels
+    static inline pack _Rotate(const pack& col0, const pack& col1, const pack& col2, T x, T y, T z) {
+        return P::add(P::add(P::mul(col0, P::set1(x)), P::mul(col1, P::set1(y))), P::mul(col2, P::set1(z)));
+    }
+
+    static inline void _MatrixFromQuatRotate(const RaveVector<T>& quat, T* m) {
+        T xx = 2 * quat.y * quat.y;
+        T xy = 2 * quat.y * quat.z;
+        T xz = 2 * quat.y * quat.w;
+        T xw = 2 * quat.y * quat.x;
+        T yy = 2 * quat.z * quat.z;
+        T yz = 2 * quat.z * quat.w;
+        T yw = 2 * quat.z * quat.x;
+        T zz = 2 * quat.w * quat.w;
+        T zw = 2 * quat.w * quat.x;
+        m[0] = 1-yy-zz; m[1] = xy-zw; m[2] = xz+yw; m[3] = 0;
+        m[4] = xy+zw; m[5] = 1-xx-zz; m[6] = yz-xw; m[7] = 0;
+        m[8] = xz-yw; m[9] = yz+xw; m[10] = 1-xx-yy; m[11] = 0;
+    }
+};
+
+} // end namespace simd
+
+#ifdef OPENRAVE_GEOMETRY_SIMD_FLOAT
+template <>
+class RaveAffineKernels<float> : public simd::AffineKernels<float, simd::Pack4f>
+{
+};
+#endif
+
+#ifdef OPENRAVE_GEOMETRY_SIMD_DOUBLE
+template <>
+class RaveAffineKernels<double> : public simd::AffineKernels<double, simd::Pack4d>
+{
+};
+#endif
+
+} // end namespace geometry
+} // end namespace OpenRAVE
+
+#endif
@@ -102,6 +102,8 @@ public:
     //std::vector<CollisionReport> _reports; ///< all the reports that are written with the collision information if ik failed due to collisions. Only valid if _action has IKRA_RejectSelfCollision or IKRA_RejectEnvCollision set. (TODO)
 };
 
+class CustomIkSolverFilterData;
+
 /** \brief <b>[interface]</b> Base class for all Inverse Kinematic solvers. <b>If not specified, method is not multi-thread safe.</b> See \ref arch_iksolver.
    \ingroup interfaces
  */
@@ -126,7 +128,7 @@ public:
      */
     typedef boost::function<void (IkReturnPtr, RobotBase::ManipulatorConstPtr, const IkParameterization&)> IkFinishCallbackFn;
 
-    IkSolverBase(EnvironmentBasePtr penv) : InterfaceBase(PT_InverseKinematicsSolver, penv) {
+    IkSolverBase(EnvironmentBasePtr penv) : InterfaceBase(PT_InverseKinematicsSolver, penv), __nFilterStamp(0), __nFilterDispatchStamp(0) {
     }
     virtual ~IkSolverBase() {
     }
@@ -224,6 +226,16 @@ public:
      */
     virtual bool SolveAll(const IkParameterization& param, int filteroptions, std::vector<IkReturnPtr>& ikreturns);
 
+    /** \brief Return all joint configurations for each of the given end effector transforms.
+
+        Equivalent to calling \ref SolveAll for every parameterization. Solvers can override it to keep the robot state savers and the collision setup alive across the whole batch, which matters when generating grasp or reachability databases.
+        \param[in] vparams the poses the end effector has to achieve in the manipulator base's coordinate system.
+        \param[in] filteroptions A bitmask of \ref IkFilterOptions values controlling what is checked for each ik solution.
+        \param[out] vikreturns vikreturns[i] holds the ik output data of vparams[i], it is empty if there is no solution.
+        \return the number of parameterizations with at least one solution
+     */
+    virtual int SolveAllBatch(const std::vector<IkParameterization>& vparams, int filteroptions, std::vector< std::vector<IkReturnPtr> >& vikreturns);
+
     /** Return a joint configuration for the given end effector transform.
 
         Can specify the free parameters in [0,1] range. If NULL, the regular equivalent Solve is called
@@ -310,13 +322,25 @@ protected:
 
     virtual void _CallFinishCallbacks(IkReturnPtr, RobotBase::ManipulatorConstPtr, const IkParameterization &);
 
+    /// \brief returns true if there are registered finish callbacks
+    virtual bool _HasFinishCallbacks() const;
+
 private:
     virtual const char* GetHash() const {
         return OPENRAVE_IKSOLVER_HASH;
     }
 
+    /// \brief rebuilds __vFilterDispatch from __listRegisteredFilters
+    void __UpdateFilterDispatch() const;
+
+    /// \brief returns the index of the first filter of __vFilterDispatch whose priority is <= maxpriority
+    size_t __FindFirstFilter(int32_t maxpriority) const;
+
     std::list<UserDataWeakPtr> __listRegisteredFilters; ///< internally managed filters
     std::list<UserDataWeakPtr> __listRegisteredFinishCallbacks; ///< internally managed callbacks
+    mutable std::vector<CustomIkSolverFilterData*> __vFilterDispatch; ///< the live filters of __listRegisteredFilters ordered by descending priority, so _CallFilters does not lock and cast every handle for every solution
+    int __nFilterStamp; ///< incremented every time a filter is registered or released
+    mutable int __nFilterDispatchStamp; ///< __nFilterStamp when __vFilterDispatch was built
 
     friend class CustomIkSolverFilterData;
     friend class IkSolverFinishCallbackData;
@@ -35,6 +35,7 @@ enum SerializationOptions
     SO_RobotSensors = 0x20, ///< serialize robot sensors
     SO_Geometry = 0x40, ///< geometry information (for collision detection)
     SO_InverseKinematics = 0x80, ///< information necessary for inverse kinematics. If Transform6D, then don't include the manipulator local transform
+    SO_BinaryTrajectory = 0x100, ///< write trajectories in the compact binary format instead of XML, see \ref TrajectoryBase::serialize
 };
 
 /** \brief <b>[interface]</b> Base class for all interfaces that OpenRAVE provides. See \ref interface_concepts.
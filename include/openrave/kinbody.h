@@ -35,6 +35,7 @@ enum GeometryType {
     GT_Cylinder = 3, ///< oriented towards z-axis
     GT_TriMesh = 4,
     GT_Container=5, ///< a container shaped geometry that has inner and outer extents. container opens on +Z.
+    GT_Octree=6, ///< occupancy voxel map, for example built from point clouds. see KinBody::GeometryInfo::_setOctreeVoxels
 };
 
 /// \brief holds parameters for an electric motor
@@ -148,12 +149,22 @@ public:
         inline const Vector& GetBoxExtents() const {
             return _vGeomData;
         }
+        inline dReal GetOctreeVoxelSize() const {
+            return _vGeomData.x;
+        }
+
+        /// \brief returns the key of the octree voxel containing point, given in the local coordinate system of the geometry
+        int64_t GetOctreeVoxelKey(const Vector& point) const;
+
+        /// \brief returns the center of the octree voxel with key in the local coordinate system of the geometry
+        Vector GetOctreeVoxelCenter(int64_t key) const;
 
         Transform _t; ///< Local transformation of the geom primitive with respect to the link's coordinate system.
         Vector _vGeomData; ///< for boxes, first 3 values are half extents. For containers, the first 3 values are the full outer extents.
         Vector _vGeomData2; ///< For containers, the first 3 values are the full inner extents.
         Vector _vGeomData3; ///< For containers, the first 3 values is the bottom cross XY full extents and Z height from bottom face.
         
+        ///< for octrees, first value is the edge length of the voxels
         ///< for sphere it is radius
         ///< for cylinder, first 2 values are radius and height
         ///< for trimesh, none
@@ -168,6 +179,11 @@ public:
 
         GeometryType _type; ///< the type of geometry primitive
 
+        /// \brief for octrees, the keys of the occupied voxels, see \ref GetOctreeVoxelKey
+        ///
+        /// _meshcollision holds a box for each voxel for the interfaces that do not support octrees natively.
+        std::set<int64_t> _setOctreeVoxels;
+
         /// \brief filename for render model (optional)
         ///
         /// Should be transformed by _t before rendering.
@@ -311,6 +327,13 @@ public:
             inline const Vector& GetContainerBottomCross() const {
                 return _info._vGeomData3;
             }
+            inline dReal GetOctreeVoxelSize() const {
+                return _info._vGeomData.x;
+            }
+            /// \brief returns the keys of the occupied voxels of an octree, see \ref GeometryInfo::GetOctreeVoxelCenter
+            inline const std::set<int64_t>& GetOctreeVoxels() const {
+                return _info._setOctreeVoxels;
+            }
             inline const RaveVector<float>& GetDiffuseColor() const {
                 return _info._vDiffuseColor;
             }
@@ -329,12 +352,38 @@ public:
 
             virtual bool InitCollisionMesh(float fTessellation=1);
 
+            /// \brief increases every time the collision data of this geometry is modified in place, e.g. by \ref SetCollisionMesh or \ref UpdateOctreeVoxels
+            ///
+            /// When receiving Prop_LinkGeometry, collision checkers can compare it to only rebuild the geometries that changed
+            /// as long as the geometries of the link are the same objects.
+            inline int GetUpdateStamp() const {
+                return _nUpdateStamp;
+            }
+
             /// \brief returns an axis aligned bounding box given that the geometry is transformed by trans
+            ///
+            /// The bounds of trimesh vertices are cached until the geometry is modified, see \ref GetUpdateStamp, and reused when trans does not rotate the geometry.
             virtual AABB ComputeAABB(const Transform& trans) const;
             virtual void serialize(std::ostream& o, int options) const;
 
+            /// \brief returns the md5 hash of the geometric data of the geometry, the part of \ref KinBody::GetKinematicsGeometryHash it contributes
+            ///
+            /// Cached until the geometry is modified, see \ref GetUpdateStamp, so the mesh is only serialized once.
+            virtual const std::string& GetHash() const;
+
             /// \brief sets a new collision mesh and notifies every registered callback about it
             virtual void SetCollisionMesh(const TriMesh& mesh);
+
+            /// \brief marks or frees the voxels of an octree that contain the points, and notifies every registered callback about it
+            ///
+            /// The body does not have to be recreated, collision checkers supporting octrees only update this geometry.
+            /// \param vpoints points in the local coordinate system of the geometry
+            /// \param bOccupied if true, marks the voxels as occupied, otherwise frees them
+            /// \return the number of voxels whose state changed
+            virtual size_t UpdateOctreeVoxels(const std::vector<Vector>& vpoints, bool bOccupied);
+
+            /// \brief frees all the voxels of an octree and notifies every registered callback about it
+            virtual void ClearOctreeVoxels();
             /// \brief sets visible flag. if changed, notifies every registered callback about it.
             ///
             /// \return true if changed
@@ -363,6 +412,11 @@ public:
 protected:
             boost::weak_ptr<Link> _parent;
             KinBody::GeometryInfo _info; ///< geometry info
+            int _nUpdateStamp; ///< \see GetUpdateStamp
+            mutable std::string __hash; ///< \see GetHash
+            mutable int __nHashUpdateStamp; ///< _nUpdateStamp when __hash was computed
+            mutable Vector __vMeshMin, __vMeshMax; ///< bounds of the trimesh vertices in the geometry frame, \see ComputeAABB
+            mutable int __nMeshBoundsUpdateStamp; ///< _nUpdateStamp when __vMeshMin and __vMeshMax were computed
 #ifdef RAVE_PRIVATE
 #ifdef _MSC_VER
             friend class OpenRAVEXMLParser::LinkXMLReader;
@@ -431,9 +485,13 @@ protected:
         }
 
         /// \brief Compute the aabb of all the geometries of the link in the link coordinate system
+        ///
+        /// Cached until the geometries change.
         virtual AABB ComputeLocalAABB() const;
 
         /// \brief Compute the aabb of all the geometries of the link in the world coordinate system
+        ///
+        /// Cached until the geometries change or the link moves, see \ref GetUpdateStamp.
         virtual AABB ComputeAABB() const;
 
         /// \brief Return the current transformation of the link in the world coordinate system.
@@ -441,6 +499,13 @@ protected:
             return _info._t;
         }
 
+        /// \brief return the value of KinBody::GetUpdateStamp right after the transformation of this link was last changed.
+        ///
+        /// Comparing it with a previously stored stamp tells whether this particular link moved, so that collision checkers do not have to re-synchronize links that stayed in place.
+        inline int GetUpdateStamp() const {
+            return _nUpdateStampId;
+        }
+
         /// \brief Return all the direct parent links in the kinematics hierarchy of this link.
         ///
         /// A parent link is is immediately connected to this link by a joint and has a path to the root joint so that it is possible
@@ -657,6 +722,11 @@ private:
         /// @name Private Link Variables
         //@{
         int _index;                  ///< \see GetIndex
+        int _nUpdateStampId;         ///< \see GetUpdateStamp
+        int _nGeometryStamp; ///< increased every time the geometries are updated, \see _Update
+        mutable AABB _localaabb, _aabb; ///< cached results of ComputeLocalAABB and ComputeAABB
+        mutable int _nLocalAABBGeometryStamp; ///< _nGeometryStamp when _localaabb was computed
+        mutable int _nAABBGeometryStamp, _nAABBUpdateStamp; ///< _nGeometryStamp and _nUpdateStampId when _aabb was computed
         KinBodyWeakPtr _parent;         ///< \see GetParent
         std::vector<int> _vParentLinks;         ///< \see GetParentLinks, IsParentLink
         std::vector<int> _vRigidlyAttachedLinks;         ///< \see IsRigidlyAttached, GetRigidlyAttachedLinks
@@ -746,12 +816,46 @@ public:
             }
         };
 
+        /** \brief closed-form polynomial that an equation is compiled into when it only uses +, -, *, division by constants, and constant integer powers.
+
+            Linear and affine mimic equations are the common case, evaluating them directly avoids the function parser on every forward kinematics and jacobian call.
+         */
+        class Polynomial
+        {
+public:
+            Polynomial() : _numvars(0) {
+            }
+
+            /// \brief evaluates the polynomial, pvalues are ordered as \ref _vdofformat
+            inline dReal Eval(const dReal* pvalues) const {
+                dReal fsum = 0;
+                const uint8_t* ppowers = _vpowers.empty() ? NULL : &_vpowers[0];
+                for(size_t iterm = 0; iterm < _vcoeffs.size(); ++iterm, ppowers += _numvars) {
+                    dReal fterm = _vcoeffs[iterm];
+                    for(size_t ivar = 0; ivar < _numvars; ++ivar) {
+                        for(uint8_t ipower = 0; ipower < ppowers[ivar]; ++ipower) {
+                            fterm *= pvalues[ivar];
+                        }
+                    }
+                    fsum += fterm;
+                }
+                return fsum;
+            }
+
+            std::vector<dReal> _vcoeffs; ///< coefficient of each term
+            std::vector<uint8_t> _vpowers; ///< _numvars powers for each term
+            size_t _numvars;
+        };
+        typedef boost::shared_ptr<Polynomial const> PolynomialConstPtr;
+
         /// @name automatically set
         //@{
         std::vector< DOFFormat > _vdofformat;         ///< the format of the values the equation takes order is important.
         std::vector<DOFHierarchy> _vmimicdofs;         ///< all dof indices that the equations depends on. DOFHierarchy::dofindex can repeat
         OpenRAVEFunctionParserRealPtr _posfn;
         std::vector<OpenRAVEFunctionParserRealPtr > _velfns, _accelfns;         ///< the velocity and acceleration partial derivatives with respect to each of the values in _vdofformat
+        PolynomialConstPtr _pospoly; ///< if set, evaluated instead of _posfn
+        std::vector<PolynomialConstPtr> _velpolys, _accelpolys; ///< same size as _velfns and _accelfns, if an entry is set it is evaluated instead of the function parser
         //@}
     };
     typedef boost::shared_ptr<Mimic> MimicPtr;
@@ -1270,7 +1374,7 @@ private:
     class BodyState
     {
 public:
-        BodyState() : updatestamp(0), environmentid(0) {
+        BodyState() : updatestamp(0), environmentid(0), publishedstamp(0) {
         }
         virtual ~BodyState() {
         }
@@ -1281,6 +1385,7 @@ public:
         std::string uri; ///< \see KinBody::GetURI
         int updatestamp; ///< \see KinBody::GetUpdateStamp
         int environmentid; ///< \see KinBody::GetEnvironmentId
+        uint64_t publishedstamp; ///< \ref EnvironmentBase::GetPublishedBodiesStamp of the snapshot where the link transformations and joint values last changed
         std::string activeManipulatorName; ///< the currently active manpiulator set for the body
         Transform activeManipulatorTransform; ///< the active manipulator's transform
     };
@@ -1378,6 +1483,7 @@ protected:
         std::vector<dReal> _vdoflastsetvalues;
         std::vector<dReal> _vMaxVelocities, _vMaxAccelerations, _vDOFWeights, _vDOFLimits[2];
         KinBodyPtr _pbody;
+        int _nUpdateStamp; ///< KinBody::GetUpdateStamp at the time of saving, if it did not change, the link transformations and enable states do not need to be restored
         bool _bRestoreOnDestructor;
 private:
         virtual void _RestoreKinBody(boost::shared_ptr<KinBody> body);
@@ -1475,6 +1581,13 @@ private:
     /// \param dofindices the dof indices to return the values for. If empty, will compute for all the dofs
     virtual void GetDOFValues(std::vector<dReal>& v, const std::vector<int>& dofindices = std::vector<int>()) const;
 
+    /// \brief Returns the joint values into a user-provided buffer without allocating any memory.
+    ///
+    /// \param[out] pValues filled with the values, has to hold numvalues elements
+    /// \param numvalues has to be at least GetDOF(), or dofindices.size() if dofindices is not empty
+    /// \param dofindices the dof indices to return the values for. If empty, will compute for all the dofs
+    virtual void GetDOFValues(dReal* pValues, size_t numvalues, const std::vector<int>& dofindices = std::vector<int>()) const;
+
     /// \brief Returns all the joint velocities as organized by the DOF indices.
     ///
     /// \param dofindices the dof indices to return the values for. If empty, will compute for all the dofs
@@ -1657,6 +1770,21 @@ private:
     /// Knowing the dof branches allows the robot to recover the full state of the joints with SetLinkTransformations
     virtual void GetLinkTransformations(std::vector<Transform>& transforms, std::vector<dReal>& doflastsetvalues) const;
 
+    /// \brief get the transformations of all the links into a user-provided buffer without allocating any memory.
+    ///
+    /// \param numtransforms number of elements in ptransforms, has to be at least GetLinks().size()
+    virtual void GetLinkTransformations(Transform* ptransforms, size_t numtransforms) const;
+
+    /** \brief computes the link transformations of many configurations without changing the state of the body.
+
+        The joint hierarchy is evaluated for all the configurations at once. Poses are stored as a structure of arrays over the configurations so that the loops composing them can be vectorized. No link or joint is modified and no callbacks are called, so it is useful for offline tools that need the link poses of huge numbers of configurations.
+
+        The base link keeps its current transformation and passive joints keep their current values. Mimic joints are evaluated from the configuration values like \ref SetDOFValues with CLA_Nothing, and the values are not checked against the limits.
+        \param pconfigs numconfigs configurations of GetDOF() values stored one after the other
+        \param vlinkposes filled with GetLinks().size()*7*numconfigs values. Component icomponent of the pose of link ilink for configuration iconfig is vlinkposes[(ilink*7+icomponent)*numconfigs+iconfig], the components are the quaternion of Transform::rot followed by the translation.
+     */
+    virtual void ComputeLinkTransformations(const dReal* pconfigs, size_t numconfigs, std::vector<dReal>& vlinkposes) const;
+
     /// \deprecated (14/05/26)
     virtual void GetLinkTransformations(std::vector<Transform>& transforms, std::vector<int>& dofbranches) const RAVE_DEPRECATED;
 
@@ -1736,6 +1864,8 @@ private:
     virtual void SetTransform(const Transform& transform);
 
     /// \brief Return an axis-aligned bounding box of the entire object in the world coordinate system.
+    ///
+    /// Cached until \ref GetUpdateStamp changes. Only the links that moved or whose geometries changed are recomputed.
     virtual AABB ComputeAABB() const;
 
     /// \brief Return the center of mass of entire robot in the world coordinate system.
@@ -1762,6 +1892,15 @@ private:
     /// \param dofindices the dof indices to return the values for. If empty, will compute for all the dofs
     virtual void SetDOFValues(const std::vector<dReal>& values, uint32_t checklimits = CLA_CheckLimits, const std::vector<int>& dofindices = std::vector<int>());
 
+    /// \brief Sets the joint values of the robot from a raw buffer.
+    ///
+    /// Intermediate results are stored in buffers owned by the body, so repeated calls do not allocate memory.
+    /// \param values points to numvalues values (ordered by the dof indices, or by dofindices if not empty)
+    /// \param numvalues has to be at least GetDOF(), or dofindices.size() if dofindices is not empty
+    /// \param[in] checklimits one of \ref CheckLimitsAction
+    /// \param dofindices the dof indices to set the values for. If empty, will set all the dofs
+    virtual void SetDOFValues(const dReal* values, size_t numvalues, uint32_t checklimits = CLA_CheckLimits, const std::vector<int>& dofindices = std::vector<int>());
+
     virtual void SetJointValues(const std::vector<dReal>& values, bool checklimits = true) {
         SetDOFValues(values,static_cast<uint32_t>(checklimits));
     }
@@ -1841,6 +1980,19 @@ private:
     /// \param vjacobian 3xDOF matrix
     virtual void ComputeJacobianAxisAngle(int linkindex, std::vector<dReal>& jacobian, const std::vector<int>& dofindices=std::vector<int>()) const;
 
+    /** \brief Computes the translation and angular velocity jacobians of several (link, world position) pairs in one pass over the joints.
+
+        Each joint's axis, anchor and mimic partial derivatives are computed once and shared by every pair whose chain contains the joint.
+        For pair i, rows 6*i+0..6*i+2 match \ref ComputeJacobianTranslation and rows 6*i+3..6*i+5 match \ref ComputeJacobianAxisAngle.
+        \param vlinkpositions (linkindex, world position) pairs
+        \param jacobians 6*vlinkpositions.size()*DOF values, row-major. DOF is dofindices.size() if dofindices is not empty.
+        \param dofindices the dof indices to compute the jacobians for. If empty, will compute for all the dofs
+     */
+    virtual void ComputeJacobians(const std::vector< std::pair<int, Vector> >& vlinkpositions, dReal* jacobians, const std::vector<int>& dofindices=std::vector<int>()) const;
+
+    /// \brief calls the pointer version of ComputeJacobians after resizing jacobians
+    virtual void ComputeJacobians(const std::vector< std::pair<int, Vector> >& vlinkpositions, std::vector<dReal>& jacobians, const std::vector<int>& dofindices=std::vector<int>()) const;
+
     /// \brief Computes the angular velocity jacobian of a specified link about the axes of world coordinates.
     virtual void CalculateAngularVelocityJacobian(int linkindex, std::vector<dReal>& jacobian) const {
         ComputeJacobianAxisAngle(linkindex,jacobian);
@@ -1929,6 +2081,19 @@ private:
      */
     virtual void ComputeInverseDynamics(boost::array< std::vector<dReal>, 3>& doftorquecomponents, const std::vector<dReal>& dofaccelerations, const ForceTorqueMap& externalforcetorque=ForceTorqueMap()) const;
 
+    /** \brief Computes the inverse dynamics torques for a sequence of robot states, for example the waypoints of a trajectory.
+
+        For every state i the dof values and velocities are set from dofvalues[i*GetDOF():(i+1)*GetDOF()] and
+        dofvelocities[i*GetDOF():(i+1)*GetDOF()], and then the torques are computed the same way as \ref ComputeInverseDynamics.
+        The link transformations and velocities of the body are restored before returning. All intermediate buffers are reused across the states.
+        \param[out] doftorques The output torques, numstates*GetDOF() values.
+        \param[in] dofvalues numstates*GetDOF() dof values
+        \param[in] dofvelocities numstates*GetDOF() dof velocities
+        \param[in] dofaccelerations numstates*GetDOF() dof accelerations. If the size is 0, assumes all accelerations are 0
+        \param[in] externalforcetorque [optional] Specifies all the external forces/torques acting on the links at their center of mass, same for every state.
+     */
+    virtual void ComputeInverseDynamicsSequence(std::vector<dReal>& doftorques, const std::vector<dReal>& dofvalues, const std::vector<dReal>& dofvelocities, const std::vector<dReal>& dofaccelerations, const ForceTorqueMap& externalforcetorque=ForceTorqueMap());
+
     /// \brief sets a self-collision checker to be used whenever \ref CheckSelfCollision is called
     ///
     /// This function allows self-collisions to use a different, un-padded geometry for self-collisions
@@ -1943,6 +2108,15 @@ private:
     /// \param collisionchecker An option collision checker to use for checking self-collisions. If not specified, then will use the environment collision checker.
     virtual bool CheckSelfCollision(CollisionReportPtr report = CollisionReportPtr(), CollisionCheckerBasePtr collisionchecker=CollisionCheckerBasePtr()) const;
 
+    /** \brief conservative self-collision test of the link bounding spheres, used by \ref CheckSelfCollision to skip the collision checker when all link pairs are far apart.
+
+        Every link has a sphere bounding all its geometries and one sphere per geometry. The spheres include the geometries of all the geometry groups
+        so the test holds for whatever group a collision checker uses. The spheres are computed once and recomputed only when the geometries change.
+        \param adjacentoptions a bitmask of \ref AdjacentOptions values selecting the link pairs to test, see \ref GetNonAdjacentLinkPairs
+        \return true if the spheres of at least one link pair overlap, false if no pair can be in collision
+     */
+    virtual bool CheckSelfCollisionSpheres(int adjacentoptions=AO_Enabled) const;
+
     /// \return true if two bodies should be considered as one during collision (ie one is grabbing the other)
     virtual bool IsAttached(KinBodyConstPtr body) const;
 
@@ -2002,6 +2176,22 @@ private:
     /// \param adjacentoptions a bitmask of \ref AdjacentOptions values
     virtual const std::set<int>& GetNonAdjacentLinks(int adjacentoptions=0) const;
 
+    /** \brief return the same link pairs as \ref GetNonAdjacentLinks as a flat array of (first link index, second link index) where first < second.
+
+        The array is sorted in the same order as the set and is cached, so iterating over it does not chase set nodes.
+        The reference stays valid until the non-adjacent information is recomputed, see \ref GetNonAdjacentLinksUpdateStamp.
+        \param adjacentoptions a bitmask of \ref AdjacentOptions values
+     */
+    virtual const std::vector< std::pair<int16_t, int16_t> >& GetNonAdjacentLinkPairs(int adjacentoptions=0) const;
+
+    /// \brief returns a stamp that changes every time any of the non-adjacent link sets is recomputed.
+    ///
+    /// Users that build their own structures from \ref GetNonAdjacentLinkPairs can compare the stamp to know when to rebuild them.
+    /// Because the sets are recomputed lazily, call it after \ref GetNonAdjacentLinkPairs.
+    inline int GetNonAdjacentLinksUpdateStamp() const {
+        return _nNonAdjacentLinkUpdateStamp;
+    }
+
     /// \brief return all possible link pairs whose collisions are ignored.
     virtual const std::set<int>& GetAdjacentLinks() const;
 
@@ -2044,6 +2234,7 @@ private:
     /// This 32 byte string can be used to check if two bodies have the same kinematic structure and can be used
     /// to index into tables when looking for body-specific models. OpenRAVE stores all
     /// such models in the OPENRAVE_HOME directory (usually ~/.openrave), indexed by the particular robot/body hashes.
+    /// The geometries contribute their cached \ref Link::Geometry::GetHash, so only the modified geometries are serialized again when the body changes.
     /// \return md5 hash string of kinematics/geometry
     virtual const std::string& GetKinematicsGeometryHash() const;
 
@@ -2139,6 +2330,12 @@ protected:
     /// recomputes the hashes if geometry changed.
     virtual void _PostprocessChangedParameters(uint32_t parameters);
 
+    /// \brief calls the change callbacks registered for parameters, deferred by _PostprocessChangedParameters during a \ref EnvironmentBase::BeginBodyChangeBatch
+    virtual void _FireChangeCallbacks(uint32_t parameters);
+
+    /// \brief computes _vLinkBoundingSpheres and _vLinkGeometrySpheres from the current and group geometries of the links
+    virtual void _ComputeLinkBoundingSpheres() const;
+
     /// \brief Return true if two bodies should be considered as one during collision (ie one is grabbing the other)
     virtual bool _IsAttached(KinBodyConstPtr body, std::set<KinBodyConstPtr>& setChecked) const;
 
@@ -2175,6 +2372,13 @@ protected:
 
     mutable boost::array<std::set<int>, 4> _setNonAdjacentLinks; ///< contains cached versions of the non-adjacent links depending on values in AdjacentOptions. Declared as mutable since data is cached.
     mutable int _nNonAdjacentLinkCache; ///< specifies what information is currently valid in the AdjacentOptions.  Declared as mutable since data is cached. If 0x80000000 (ie < 0), then everything needs to be recomputed including _setNonAdjacentLinks[0].
+    mutable boost::array<std::vector< std::pair<int16_t, int16_t> >, 4> _vNonAdjacentLinkPairs; ///< flat versions of _setNonAdjacentLinks, \see GetNonAdjacentLinkPairs
+    mutable boost::array<int, 4> _vNonAdjacentLinkPairsStamps; ///< the _nNonAdjacentLinkUpdateStamp each _vNonAdjacentLinkPairs entry was built from
+    mutable int _nNonAdjacentLinkUpdateStamp; ///< \see GetNonAdjacentLinksUpdateStamp
+    mutable std::vector<Vector> _vLinkBoundingSpheres; ///< for every link, the center of its bounding sphere in the link frame and the radius in w. The radius is negative if the link has no geometry. Empty if it has to be recomputed, \see CheckSelfCollisionSpheres
+    mutable std::vector< std::vector<Vector> > _vLinkGeometrySpheres; ///< for every link, the bounding spheres of its geometries of all the groups, same format as _vLinkBoundingSpheres
+    mutable std::vector<dReal> _vLinkSphereWorldCoords; ///< cache for CheckSelfCollisionSpheres, the world (x,y,z,radius) of every link sphere
+    mutable std::vector<uint8_t> _vLinkSpherePairOverlaps; ///< cache for CheckSelfCollisionSpheres, the link sphere test result of every link pair
     std::vector<Transform> _vInitialLinkTransformations; ///< the initial transformations of each link specifying at least one pose where the robot is collision free
 
     ConfigurationSpecification _spec;
@@ -2182,6 +2386,8 @@ protected:
 
     int _environmentid; ///< \see GetEnvironmentId
     mutable int _nUpdateStampId; ///< \see GetUpdateStamp
+    mutable AABB _aabb; ///< cached result of ComputeAABB
+    mutable int _nAABBUpdateStamp; ///< _nUpdateStampId when _aabb was computed, -1 if it has to be recomputed
     uint32_t _nParametersChanged; ///< set of parameters that changed and need callbacks
     ManageDataPtr _pManageData;
     uint32_t _nHierarchyComputed; ///< true if the joint heirarchy and other cached information is computed
@@ -2189,6 +2395,19 @@ protected:
 private:
     mutable std::string __hashkinematics;
     mutable std::vector<dReal> _vTempJoints;
+    std::vector<dReal> _vTempLowerLimits, _vTempUpperLimits; ///< used by SetDOFValues for checking the joint limits
+    std::vector<dReal> _vTempMimicValues, _vTempMimicEval, _vTempMimicEvalCopy; ///< used by SetDOFValues for evaluating the mimic equations
+    std::vector< std::vector<dReal> > _vTempPassiveJointValues; ///< used by SetDOFValues for the values of the passive joints
+    std::vector<uint8_t> _vTempLinksComputed, _vTempLinksMoved; ///< used by SetDOFValues for tracking which links were updated
+    std::vector<dReal> _vLastSetDOFValues; ///< the dof values the link transformations were computed from in the last SetDOFValues call
+    int _nLastSetDOFValuesStamp; ///< _nUpdateStampId right after _vLastSetDOFValues was set. If the stamp changed since, the link transformations were modified by other means and _vLastSetDOFValues cannot be used.
+    mutable std::vector<TransformMatrix> _vLinkLocalInertias; ///< inertia tensor of each link about its COM in the link frame, used by ComputeInverseDynamics. Empty when it has to be recomputed because the link dynamics changed.
+    mutable std::vector<dReal> _vTempDOFVelocities; ///< used by ComputeInverseDynamics
+    mutable std::vector< std::pair<Vector, Vector> > _vTempLinkVelocities, _vTempLinkAccelerations, _vTempLinkForceTorques; ///< used by ComputeInverseDynamics
+    mutable std::vector<Vector> _vTempLinkGlobalCOMs, _vTempLinkCOMLinearAccelerations, _vTempLinkCOMMomentOfInertia; ///< used by ComputeInverseDynamics
+    mutable std::vector<std::pair<int,dReal> > _vTempPartials; ///< used by ComputeInverseDynamics
+    mutable AccelerationMap _mapTempExternalAccelerations; ///< used by ComputeInverseDynamics
+    std::vector<dReal> _vTempSequenceDOFTorques, _vTempSequenceDOFVelocities, _vTempSequenceDOFAccelerations; ///< used by ComputeInverseDynamicsSequence
     virtual const char* GetHash() const {
         return OPENRAVE_KINBODY_HASH;
     }
@@ -2215,6 +2434,7 @@ private:
     friend class SensorSystemBase;
     friend class RaveDatabase;
     friend class ChangeCallbackData;
+    friend class EnvironmentBase;
 };
 
 } // end namespace OpenRAVE
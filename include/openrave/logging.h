@@ -127,6 +127,37 @@ OPENRAVE_API void RaveSetDebugLevel(int level);
 /// Returns the openrave debug level
 OPENRAVE_API int RaveGetDebugLevel();
 
+/// \brief RAVELOG macros of a level above this one compile to nothing, define it before including openrave to strip verbose logging from release builds.
+#ifndef OPENRAVE_LOG_COMPILE_LEVEL
+#define OPENRAVE_LOG_COMPILE_LEVEL OpenRAVE::Level_Verbose
+#endif
+
+/** \brief Switches the global RAVELOG macros between synchronous and asynchronous output.
+
+    In the asynchronous mode, the logging thread formats the message into a fixed size record of its own lock-free queue and returns,
+    and a background thread writes the records to the console or log4cxx. Nothing is allocated or locked on the logging thread, so debug
+    logging can stay on in time critical threads. Messages longer than a record are truncated. When the queue of a thread is full,
+    its records are dropped and counted, see \ref RaveGetAsyncLoggingDroppedCount. The macros with a custom log4cxx logger always write synchronously.
+    \param bAsync if false, flushes the pending records and stops the background thread
+    \param queuesize the number of records of each thread queue, only used by the threads that log for the first time after the call
+    \return false if the asynchronous mode is not supported by this build
+ */
+OPENRAVE_API bool RaveSetAsyncLogging(bool bAsync, size_t queuesize=256);
+
+/// \brief returns true if the RAVELOG macros are asynchronous, see \ref RaveSetAsyncLogging
+OPENRAVE_API bool RaveIsAsyncLogging();
+
+/// \brief writes all the records that are pending in the asynchronous queues before returning
+OPENRAVE_API void RaveFlushAsyncLogging();
+
+/// \brief returns the total number of records dropped because a thread queue was full
+OPENRAVE_API uint64_t RaveGetAsyncLoggingDroppedCount();
+
+/// \brief pushes a message to the asynchronous queue of the calling thread, used by the RAVELOG macros
+OPENRAVE_API void RaveLogAsyncA(int level, const char* pfilename, int line, const char* pfunction, const std::string& s);
+OPENRAVE_API void RaveLogAsyncA(int level, const char* pfilename, int line, const char* pfunction, const char* fmt, ...);
+OPENRAVE_API void RaveLogAsyncW(int level, const char* pfilename, int line, const char* pfunction, const wchar_t* wfmt, ...);
+
 /// extracts only the filename
 inline const char* RaveGetSourceFilename(const char* pfilename)
 {
@@ -146,8 +177,8 @@ inline const char* RaveGetSourceFilename(const char* pfilename)
 
 // different logging levels. The higher the suffix number, the less important the information is.
 // 0 log level logs all the time. OpenRAVE starts up with a log level of 0.
-#define RAVELOG_LEVELW(LEVEL,level,...) do { if (int(OpenRAVE::RaveGetDebugLevel()&OpenRAVE::Level_OutputMask)>=int(level)) { RAVEPRINTHEADER(LEVEL); OpenRAVE::RavePrintfW ## LEVEL(__VA_ARGS__); } } while (0)
-#define RAVELOG_LEVELA(LEVEL,level,...) do { if (int(OpenRAVE::RaveGetDebugLevel()&OpenRAVE::Level_OutputMask)>=int(level)) { RAVEPRINTHEADER(LEVEL); OpenRAVE::RavePrintfA ## LEVEL(__VA_ARGS__); } } while (0)
+#define RAVELOG_LEVELW(LEVEL,level,...) do { if (int(level) <= int(OPENRAVE_LOG_COMPILE_LEVEL) && int(OpenRAVE::RaveGetDebugLevel()&OpenRAVE::Level_OutputMask)>=int(level)) { if( OpenRAVE::RaveIsAsyncLogging() ) { OpenRAVE::RaveLogAsyncW(int(level), OpenRAVE::RaveGetSourceFilename(__FILE__), __LINE__, __FUNCTION__, __VA_ARGS__); } else { RAVEPRINTHEADER(LEVEL); OpenRAVE::RavePrintfW ## LEVEL(__VA_ARGS__); } } } while (0)
+#define RAVELOG_LEVELA(LEVEL,level,...) do { if (int(level) <= int(OPENRAVE_LOG_COMPILE_LEVEL) && int(OpenRAVE::RaveGetDebugLevel()&OpenRAVE::Level_OutputMask)>=int(level)) { if( OpenRAVE::RaveIsAsyncLogging() ) { OpenRAVE::RaveLogAsyncA(int(level), OpenRAVE::RaveGetSourceFilename(__FILE__), __LINE__, __FUNCTION__, __VA_ARGS__); } else { RAVEPRINTHEADER(LEVEL); OpenRAVE::RavePrintfA ## LEVEL(__VA_ARGS__); } } } while (0)
 
 
 #if OPENRAVE_LOG4CXX
@@ -309,15 +340,15 @@ inline int RavePrintfA(const std::string& s, uint32_t level)
     return 0;
 }
 
-#define RAVELOG_LOGGER_LEVELW(logger, LEVEL, level, ...) do { if (int(OpenRAVE::RaveGetDebugLevel()&OpenRAVE::Level_OutputMask)>=int(level)) { OpenRAVE::RavePrintfW ## LEVEL(logger, LOG4CXX_LOCATION, __VA_ARGS__); } } while (0)
+#define RAVELOG_LOGGER_LEVELW(logger, LEVEL, level, ...) do { if (int(level) <= int(OPENRAVE_LOG_COMPILE_LEVEL) && int(OpenRAVE::RaveGetDebugLevel()&OpenRAVE::Level_OutputMask)>=int(level)) { OpenRAVE::RavePrintfW ## LEVEL(logger, LOG4CXX_LOCATION, __VA_ARGS__); } } while (0)
 
-#define RAVELOG_LOGGER_LEVELA(logger, LEVEL, level, ...) do { if (int(OpenRAVE::RaveGetDebugLevel()&OpenRAVE::Level_OutputMask)>=int(level)) { OpenRAVE::RavePrintfA ## LEVEL(logger, LOG4CXX_LOCATION, __VA_ARGS__); } } while (0)
+#define RAVELOG_LOGGER_LEVELA(logger, LEVEL, level, ...) do { if (int(level) <= int(OPENRAVE_LOG_COMPILE_LEVEL) && int(OpenRAVE::RaveGetDebugLevel()&OpenRAVE::Level_OutputMask)>=int(level)) { OpenRAVE::RavePrintfA ## LEVEL(logger, LOG4CXX_LOCATION, __VA_ARGS__); } } while (0)
 
 #undef RAVELOG_LEVELW
-#define RAVELOG_LEVELW(LEVEL, level, ...) RAVELOG_LOGGER_LEVELW(OpenRAVE::RaveGetLogger(), LEVEL, level, __VA_ARGS__)
+#define RAVELOG_LEVELW(LEVEL, level, ...) do { if (int(level) <= int(OPENRAVE_LOG_COMPILE_LEVEL) && int(OpenRAVE::RaveGetDebugLevel()&OpenRAVE::Level_OutputMask)>=int(level)) { if( OpenRAVE::RaveIsAsyncLogging() ) { OpenRAVE::RaveLogAsyncW(int(level), OpenRAVE::RaveGetSourceFilename(__FILE__), __LINE__, __FUNCTION__, __VA_ARGS__); } else { OpenRAVE::RavePrintfW ## LEVEL(OpenRAVE::RaveGetLogger(), LOG4CXX_LOCATION, __VA_ARGS__); } } } while (0)
 
 #undef RAVELOG_LEVELA
-#define RAVELOG_LEVELA(LEVEL, level, ...) RAVELOG_LOGGER_LEVELA(OpenRAVE::RaveGetLogger(), LEVEL, level, __VA_ARGS__)
+#define RAVELOG_LEVELA(LEVEL, level, ...) do { if (int(level) <= int(OPENRAVE_LOG_COMPILE_LEVEL) && int(OpenRAVE::RaveGetDebugLevel()&OpenRAVE::Level_OutputMask)>=int(level)) { if( OpenRAVE::RaveIsAsyncLogging() ) { OpenRAVE::RaveLogAsyncA(int(level), OpenRAVE::RaveGetSourceFilename(__FILE__), __LINE__, __FUNCTION__, __VA_ARGS__); } else { OpenRAVE::RavePrintfA ## LEVEL(OpenRAVE::RaveGetLogger(), LOG4CXX_LOCATION, __VA_ARGS__); } } } while (0)
 
 #else
 
@@ -513,7 +544,7 @@ DefineRavePrintfA(_VERBOSELEVEL)
 #define RAVELOG_DEBUG_FORMAT(x, params) RAVELOG_DEBUG(boost::str(boost::format(x)%params))
 #define RAVELOG_VERBOSE_FORMAT(x, params) RAVELOG_VERBOSE(boost::str(boost::format(x)%params))
 
-#define IS_DEBUGLEVEL(level) ((OpenRAVE::RaveGetDebugLevel()&OpenRAVE::Level_OutputMask)>=(level))
+#define IS_DEBUGLEVEL(level) (int(level) <= int(OPENRAVE_LOG_COMPILE_LEVEL) && (OpenRAVE::RaveGetDebugLevel()&OpenRAVE::Level_OutputMask)>=(level))
 
 }
 
@@ -393,6 +393,7 @@ enum CloningOptions {
     Clone_RealControllers = 8, ///< if specified, will clone the real controllers of all the robots, otherwise each robot gets ideal controller
     Clone_Sensors = 0x0010, ///< if specified, will clone the sensors attached to the robot and added to the environment
     Clone_Modules = 0x0020, ///< if specified, will clone the modules attached to the environment
+    Clone_SkipUnchangedBodies = 0x0040, ///< when updating an existing clone with EnvironmentBase::Clone, only copy the state of the bodies whose update stamp changed in either environment since the last clone. Changes that do not update KinBody::GetUpdateStamp (like velocities) are not propagated for the skipped bodies.
     Clone_All = 0xffffffff,
 };
 
@@ -1010,6 +1011,65 @@ protected:
      */
     static void ConvertData(std::vector<dReal>::iterator ittargetdata, const ConfigurationSpecification& targetspec, std::vector<dReal>::const_iterator itsourcedata, const ConfigurationSpecification& sourcespec, size_t numpoints, EnvironmentBaseConstPtr penv, bool filluninitialized = true);
 
+    /** \brief A conversion from a source specification to a target specification that is computed once and applied to many points.
+
+        \ref ConvertData matches the groups by name, parses the group names, and queries the environment every time it is called.
+        The converter does this work in its constructor and reduces every conversion to contiguous copies of the groups that
+        are the same, gathers of the values of joint, affine, and ikparam groups that have to be reordered, and fills of the
+        values that the source does not have. Only rotation conversions between affine representations are computed per point.
+
+        The converter is only valid for the specifications it was created with. Default values of uninitialized data are
+        read from the environment when the converter is created, so it should be re-created when the environment changes
+        if \ref HasEnvironmentDefaults returns true.
+     */
+    class OPENRAVE_API Converter
+    {
+public:
+        Converter();
+
+        /** \brief computes the conversion, the arguments have the same meaning as \ref ConvertData
+
+            \param penv [optional] The environment to fill in unknown data from. Assumes environment is locked.
+            \throw openrave_exception throw if groups are incompatible
+         */
+        Converter(const ConfigurationSpecification& targetspec, const ConfigurationSpecification& sourcespec, EnvironmentBaseConstPtr penv, bool filluninitialized = true);
+
+        /// \brief converts numpoints points of the source specification to the target specification
+        void Convert(std::vector<dReal>::iterator ittargetdata, std::vector<dReal>::const_iterator itsourcedata, size_t numpoints) const;
+
+        /// \brief true if some default values were read from the bodies in the environment
+        inline bool HasEnvironmentDefaults() const {
+            return _bEnvironmentDefaults;
+        }
+
+        inline int GetTargetDOF() const {
+            return _targetstride;
+        }
+        inline int GetSourceDOF() const {
+            return _sourcestride;
+        }
+
+private:
+        typedef boost::function<void (std::vector<dReal>::iterator, std::vector<dReal>::const_iterator)> RotationConverterFn;
+
+        /// \brief computes how gtarget is filled from gsource and appends it to the conversion. The offsets of the groups are ignored, targetoffset and sourceoffset are used instead
+        void _AddGroup(const Group& gtarget, int targetoffset, const Group& gsource, int sourceoffset, EnvironmentBaseConstPtr penv, bool filluninitialized);
+
+        /// \brief adds a copy of one element, merging it with the previous copy if contiguous
+        void _AddCopy(int sourceindex, int targetindex);
+
+        std::vector< std::pair<std::pair<int,int>, int> > _vcopies; ///< ((source index, target index), number of elements) of contiguous copies
+        std::vector< std::pair<int, dReal> > _vfills; ///< (target index, value) of uninitialized data
+        std::vector< std::pair<std::pair<int,int>, RotationConverterFn> > _vrotations; ///< ((source index, target index), converter) of affine rotations that change representation
+        int _targetstride, _sourcestride;
+        bool _bEnvironmentDefaults;
+
+        friend class ConfigurationSpecification;
+    };
+
+    typedef boost::shared_ptr<Converter> ConverterPtr;
+    typedef boost::shared_ptr<Converter const> ConverterConstPtr;
+
     /// \brief gets the name of the interpolation that represents the derivative of the passed in interpolation.
     ///
     /// For example GetInterpolationDerivative("quadratic") -> "linear"
@@ -1357,7 +1417,15 @@ public:
         return 1e30;
     }
 
-    /// \brief fills the iterator with the serialized values of the ikparameterization.
+    /** \brief computes \ref ComputeDistanceSqr between this parameterization and many parameterizations of the same type at once
+
+        The result is equal to calling ComputeDistanceSqr with each of the parameterizations rebuilt with \ref SetValues, so custom data and
+        the direction of Lookat3D (which is not part of the values) are ignored. The common types are compared in tight loops over the values that
+        the compiler can vectorize, instead of one IkParameterization at a time.
+        \param vvalues the \ref GetValues of the parameterizations one after the other, a multiple of \ref GetNumberOfValues
+        \param vdists receives the squared distance to each of them
+     */
+    void ComputeDistancesSqr(const std::vector<dReal>& vvalues, std::vector<dReal>& vdists) const;
     ///
     /// The container the iterator points to needs to have \ref GetNumberOfValues() available.
     /// Does not support custom data
@@ -1534,6 +1602,22 @@ public:
         SetValues(itvalues,iktype);
     }
 
+    /// \brief returns the number of bytes \ref SerializeBinary writes for a type, every parameterization of a type has the same size
+    static size_t GetBinarySize(IkParameterizationType type) {
+        return 4 + 8*GetNumberOfValues(type);
+    }
+
+    /** \brief writes the parameterization in a fixed binary layout, much more compact and faster to parse than the text operator<<
+
+        The layout is the 32-bit type followed by the \ref GetValues as 64-bit doubles, all little-endian, so \ref GetBinarySize bytes.
+        Records of the same type can therefore be stored back to back and indexed directly. O should be opened in binary mode.
+        \throw openrave_exception if the parameterization has custom data, which only the text operators support
+     */
+    void SerializeBinary(std::ostream& O) const;
+
+    /// \brief reads a parameterization written by \ref SerializeBinary and clears the custom data
+    void DeserializeBinary(std::istream& I);
+
     /** \brief sets named custom data in the ik parameterization
 
         The custom data is serialized along with the rest of the parameters and can also be part of a configuration specification under the "ikparam_values" anotation.
@@ -2126,6 +2210,9 @@ public:
     AABB ComputeAABB() const;
     void serialize(std::ostream& o, int options=0) const;
 
+    /// \brief hash of the exact vertices and indices, used by the collision checkers and viewers to share the data they build from identical meshes
+    size_t ComputeHash() const;
+
     friend OPENRAVE_API std::ostream& operator<<(std::ostream& O, const TriMesh &trimesh);
     friend OPENRAVE_API std::istream& operator>>(std::istream& I, TriMesh& trimesh);
 };
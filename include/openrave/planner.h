@@ -24,6 +24,11 @@
 
 namespace OpenRAVE {
 
+namespace utils {
+class ThreadPoolTaskGroup;
+class MonotonicArena;
+}
+
 /// \brief Controls what information gets validated when calling the constraints functions in planner parameters
 ///
 /// By default, the lower 16 bits are set while the upper 16bits are zero.
@@ -37,6 +42,9 @@ enum ConstraintFilterOptions
     CFO_CheckWithPerturbation=0x00010000, ///< when checking collisions, perturbs all the joint values a little and checks again. This forces the line to be away from grazing collisions.
     CFO_FillCheckedConfiguration=0x00020000, ///< if set, will fill \ref ConstraintFilterReturn::_configurations and \ref ConstraintFilterReturn::_configurationtimes
     CFO_FillCollisionReport=0x00040000, ///< if set, will fill \ref ConstraintFilterReturn::_report if in environment or self-collision
+    CFO_BisectionCheckOrder=0x00080000, ///< if set, checks the intermediate configurations of a segment in bisection (van der Corput) order instead of from start to end so that collisions in the middle are found sooner. Every configuration is computed directly from the start configuration, so only use it when the neighbor function does not depend on the path taken. Ignored if CFO_FillCheckedConfiguration is set.
+    CFO_SweptBoundCulling=0x00100000, ///< if set, bounds the space swept by the links of the checked body over the whole segment and skips the environment collision checks of the intermediate configurations when no other body overlaps it. Same as CFO_BisectionCheckOrder, only use it when the neighbor function does not depend on the path taken. Ignored if CFO_FillCheckedConfiguration is set.
+    CFO_ClearanceAdaptiveSteps=0x00200000, ///< if set, checks the environment collisions of the intermediate configurations with distance queries and takes steps that the body provably cannot cross in that distance, so segments far from obstacles need few queries. Near obstacles the steps shrink to the regular resolution. Needs a collision checker supporting CollisionCheckerBase::ComputeDistance, otherwise the regular steps are used. Same as CFO_BisectionCheckOrder, only use it when the neighbor function does not depend on the path taken. Ignored if CFO_FillCheckedConfiguration is set.
     CFO_FinalValuesNotReached=0x40000000, ///< if set, then the final values of the interpolation have not been reached, although a close interpolation has been computed. This happens when manipulator constraints are used.
     CFO_StateSettingError=0x80000000, ///< error when the state setting function (or neighbor function) breaks
     CFO_RecommendedOptions = 0x0000ffff, ///< recommended options that all plugins should use by default
@@ -78,7 +86,7 @@ enum NeighborStateOptions
 class OPENRAVE_API ConstraintFilterReturn
 {
 public:
-    ConstraintFilterReturn() : _fTimeWhenInvalid(0), _returncode(0) {
+    ConstraintFilterReturn() : _fTimeWhenInvalid(0), _returncode(0), _numcheckedconfigurations(0) {
     }
     /// \brief clears the data
     inline void Clear() {
@@ -88,6 +96,7 @@ public:
         _invalidvelocities.resize(0);
         _returncode = 0;
         _fTimeWhenInvalid = 0;
+        _numcheckedconfigurations = 0;
         _report.Reset();
     }
 
@@ -98,6 +107,7 @@ public:
     dReal _fTimeWhenInvalid; ///< if the constraint has an elapsed time, will contain the time when invalidated
     int _returncode; ///< if == 0, the constraint is good. If != 0 means constraint was violated and bitmasks in ConstraintFilterOptions can be used to find what constraint was violated.
     CollisionReport _report; ///< if in collision (_returncode&(CFO_CheckEnvCollisions|CFO_CheckSelfCollisions)), then stores the collision report
+    int _numcheckedconfigurations; ///< number of configurations whose state was set and checked, perturbations excluded. The distance queries of CFO_ClearanceAdaptiveSteps are counted too. Useful for tuning the checking order and resolution.
 };
 
 typedef boost::shared_ptr<ConstraintFilterReturn> ConstraintFilterReturnPtr;
@@ -150,8 +160,9 @@ private:
 
         /** \brief Attemps to copy data from one set of parameters to another in the safest manner.
 
-            First serializes the data of the right hand into a string, then initializes the current parameters via >>
-            pointers to functions are copied directly
+            The pointers to functions and the data of PlannerParameters are copied directly. The data of derived parameters
+            and the extra parameters are serialized into a string and then initialize the current parameters via >>.
+            If the right hand is a plain PlannerParameters without extra parameters, no xml is involved.
          */
         virtual PlannerParameters& operator=(const PlannerParameters& r);
         virtual void copy(boost::shared_ptr<PlannerParameters const> r);
@@ -224,6 +235,16 @@ private:
         typedef boost::function<dReal(const std::vector<dReal>&, const std::vector<dReal>&)> DistMetricFn;
         DistMetricFn _distmetricfn;
 
+        /// \brief Distances from one configuration to a batch of configurations (optional)
+        ///
+        /// distmetricbatch(config,vconfigs,vdistances)
+        ///
+        /// vconfigs holds N configurations stored one after the other, vdistances has to be resized to N and filled with _distmetricfn(config, vconfigs[i]).
+        /// Planners that evaluate many distances against the same configuration call it once instead of calling _distmetricfn N times, which matters when the metric is implemented in an interpreted language.
+        /// Has to compute the same values as _distmetricfn, so it is set again whenever _distmetricfn is set by SetRobotActiveJoints or SetConfigurationSpecification.
+        typedef boost::function<void (const std::vector<dReal>&, const std::vector<dReal>&, std::vector<dReal>&)> DistMetricBatchFn;
+        DistMetricBatchFn _distmetricbatchfn;
+
         /// \deprecated (13/05/29)
         typedef boost::function<bool (const std::vector<dReal>&, const std::vector<dReal>&, IntervalType, PlannerBase::ConfigurationListPtr)> CheckPathConstraintFn;
         CheckPathConstraintFn _checkpathconstraintsfn RAVE_DEPRECATED;
@@ -409,6 +430,12 @@ private:
         /// For example, when _samplefn is set and a SpaceSampler is used as the underlying number generator, then it should be added to this list.
         std::list<SpaceSamplerBasePtr> _listInternalSamplers;
 
+        /// \brief If set, the planners allocate the memory of the request from this arena instead of the heap. Not serialized.
+        ///
+        /// The arena is shared by the copies of the parameters, so the post-processing planners use it too. Its memory is released at once
+        /// when the caller and the planners initialized with it all dropped their references.
+        boost::shared_ptr<utils::MonotonicArena> _parena;
+
 protected:
         // router to a default implementation of _checkpathconstraintsfn that calls on _checkpathvelocityconstraintsfn
         bool _CheckPathConstraintsOld(const std::vector<dReal>&q0, const std::vector<dReal>&q1, IntervalType interval, PlannerBase::ConfigurationListPtr pvCheckedConfigurations) {
@@ -448,7 +475,7 @@ protected:
 
         /// \brief output the planner parameters in a string (in XML format)
         ///
-        /// \param options if 1 will skip writing the extra parameters
+        /// \param options if 1 will skip writing the extra parameters. If 2 will skip writing the data of PlannerParameters, only derived data and the extra parameters are written.
         /// don't use PlannerParameters as a tag!
         virtual bool serialize(std::ostream& O, int options=0) const;
 
@@ -543,6 +570,62 @@ public:
      */
     virtual UserDataPtr RegisterPlanCallback(const PlanCallbackFn& callbackfn);
 
+    class PlanPathHandleState;
+
+    /// \brief handle of a \ref PlanPath running on the shared thread pool, see \ref PlanPathAsync <b>[multi-thread safe]</b>
+    ///
+    /// Destroying the handle interrupts the planner and waits for PlanPath to return.
+    class OPENRAVE_API PlanPathHandle
+    {
+public:
+        PlanPathHandle(boost::shared_ptr<PlanPathHandleState> state, boost::shared_ptr<utils::ThreadPoolTaskGroup> group);
+        virtual ~PlanPathHandle();
+
+        /// \brief waits for PlanPath to return and returns its status
+        ///
+        /// If no worker of the thread pool started the planning yet, it is run by the calling thread. The calling thread should not hold the environment lock
+        /// unless it is sure that the planning was not started by another thread.
+        /// \throw openrave_exception the exception thrown by PlanPath
+        PlannerStatus Wait();
+
+        /// \brief waits at most timeout milliseconds for PlanPath to return, returns true if it returned
+        bool WaitFor(uint32_t timeout);
+
+        /// \brief returns true if PlanPath returned
+        bool IsDone() const;
+
+        /// \brief interrupts the planner the next time it calls its callbacks, PlanPath then returns PS_Interrupted or PS_InterruptedWithSolution
+        void Cancel();
+
+        /// \brief asks the planner to return as soon as it has any solution, like returning PA_ReturnWithAnySolution from a callback
+        void RequestAnySolution();
+
+        /// \brief returns true if \ref Cancel was called or the timeout passed
+        bool IsCancelled() const;
+
+        /// \brief returns the latest progress the planner reported
+        PlannerProgress GetProgress() const;
+
+        /// \brief returns how many times the planner reported its progress
+        int GetNumProgressUpdates() const;
+
+private:
+        boost::shared_ptr<PlanPathHandleState> _state;
+        boost::shared_ptr<utils::ThreadPoolTaskGroup> _group;
+    };
+    typedef boost::shared_ptr<PlanPathHandle> PlanPathHandlePtr;
+
+    /** \brief Runs \ref PlanPath on the shared thread pool and returns immediately, see \ref utils::ThreadPoolTaskGroup
+
+        The environment is locked while planning, so the caller can serve other requests and cancel or wait on the returned handle.
+        The handle is called after the registered callbacks every time the planner calls them, so every planner that checks its callbacks
+        (including the post-processing planners) can be interrupted through the handle.
+        \param traj the output trajectory, it should not be used until the handle is done
+        \param progressfn if set, called from the planning thread with every progress the planner reports. Returning an action other than PA_None is forwarded to the planner.
+        \param timeout if > 0, the planner is interrupted once that many milliseconds passed since PlanPathAsync was called
+     */
+    virtual PlanPathHandlePtr PlanPathAsync(TrajectoryBasePtr traj, const PlanCallbackFn& progressfn=PlanCallbackFn(), uint32_t timeout=0);
+
 protected:
     inline PlannerBasePtr shared_planner() {
         return boost::static_pointer_cast<PlannerBase>(shared_from_this());
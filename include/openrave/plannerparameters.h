@@ -27,13 +27,15 @@ namespace OpenRAVE {
 class OPENRAVE_API ExplorationParameters : public PlannerBase::PlannerParameters
 {
 public:
-    ExplorationParameters() : _fExploreProb(0), _nExpectedDataSize(100), _bProcessingExploration(false) {
+    ExplorationParameters() : _fExploreProb(0), _nExpectedDataSize(100), _nNumThreads(1), _bProcessingExploration(false) {
         _vXMLParameters.push_back("exploreprob");
         _vXMLParameters.push_back("expectedsize");
+        _vXMLParameters.push_back("numthreads");
     }
 
     dReal _fExploreProb; ///< explore close to the neighbors already added
     int _nExpectedDataSize; ///< the expected number of nodes of the RRT tree to expand to before returning a solution. This allows the RRT tree to build up 
+    int _nNumThreads; ///< if > 1, every iteration computes this many extensions in parallel on environment snapshots and adds them to the tree at once.
     
 protected:
     bool _bProcessingExploration;
@@ -45,6 +47,7 @@ protected:
         }
         O << "<exploreprob>" << _fExploreProb << "</exploreprob>" << std::endl;
         O << "<expectedsize>" << _nExpectedDataSize << "</expectedsize>" << std::endl;
+        O << "<numthreads>" << _nNumThreads << "</numthreads>" << std::endl;
         if( !(options & 1) ) {
             O << _sExtraParameters << std::endl;
         }
@@ -62,7 +65,7 @@ protected:
         case PE_Ignore: return PE_Ignore;
         }
 
-        _bProcessingExploration = name=="exploreprob"||name=="expectedsize";
+        _bProcessingExploration = name=="exploreprob"||name=="expectedsize"||name=="numthreads";
         return _bProcessingExploration ? PE_Support : PE_Pass;
     }
 
@@ -77,6 +80,9 @@ protected:
             else if( name == "expectedsize" ) {
                 _ss >> _nExpectedDataSize;
             }
+            else if( name == "numthreads" ) {
+                _ss >> _nNumThreads;
+            }
             else {
                 RAVELOG_WARN(str(boost::format("unknown tag %s\n")%name));
             }
@@ -264,7 +270,7 @@ protected:
 class OPENRAVE_API GraspParameters : public PlannerBase::PlannerParameters
 {
 public:
-    GraspParameters(EnvironmentBasePtr penv) : PlannerBase::PlannerParameters(), fstandoff(0), ftargetroll(0), vtargetdirection(0,0,1), btransformrobot(false), breturntrajectory(false), bonlycontacttarget(true), btightgrasp(false), bavoidcontact(false), fcoarsestep(0.1f), ffinestep(0.001f), ftranslationstepmult(0.1f), fgraspingnoise(0), _penv(penv) {
+    GraspParameters(EnvironmentBasePtr penv) : PlannerBase::PlannerParameters(), fstandoff(0), ftargetroll(0), vtargetdirection(0,0,1), btransformrobot(false), breturntrajectory(false), bonlycontacttarget(true), btightgrasp(false), bavoidcontact(false), bcontinuouscontact(false), fcoarsestep(0.1f), ffinestep(0.001f), ftranslationstepmult(0.1f), fgraspingnoise(0), _penv(penv) {
         _vXMLParameters.push_back("fstandoff");
         _vXMLParameters.push_back("targetbody");
         _vXMLParameters.push_back("ftargetroll");
@@ -277,6 +283,7 @@ public:
         _vXMLParameters.push_back("btightgrasp");
         _vXMLParameters.push_back("bavoidcontact");
         _vXMLParameters.push_back("vavoidlinkgeometry");
+        _vXMLParameters.push_back("bcontinuouscontact");
         _vXMLParameters.push_back("fcoarsestep");
         _vXMLParameters.push_back("ffinestep");
         _vXMLParameters.push_back("ftranslationstepmult");
@@ -297,6 +304,7 @@ public:
     bool btightgrasp;     ///< This is tricky, but basically if true will also move the basic link along the negative axes of some of the joints to get a tighter fit.
     bool bavoidcontact;     ///< if true, will return a final robot configuration right before contact is made.
     std::vector<std::string> vavoidlinkgeometry;     ///< list of links on the robot to avoid collisions with (for exmaple, sensors)
+    bool bcontinuouscontact;     ///< if true, every finger advances as far as the distance of its links to the environment allows and the step that collides is bisected down to ffinestep, instead of taking fcoarsestep and ffinestep steps. Needs a collision checker supporting CO_Distance, otherwise the distance steps are replaced by fcoarsestep.
 
     dReal fcoarsestep;      ///< step for coarse planning (in radians)
     dReal ffinestep;     ///< step for fine planning (in radians), THIS STEP MUST BE VERY SMALL OR THE COLLISION CHECKER GIVES WILDLY BOGUS RESULTS
@@ -329,6 +337,7 @@ protected:
             O << *it << " ";
         }
         O << "</vavoidlinkgeometry>" << std::endl;
+        O << "<bcontinuouscontact>" << bcontinuouscontact << "</bcontinuouscontact>" << std::endl;
         O << "<fcoarsestep>" << fcoarsestep << "</fcoarsestep>" << std::endl;
         O << "<ffinestep>" << ffinestep << "</ffinestep>" << std::endl;
         O << "<ftranslationstepmult>" << ftranslationstepmult << "</ftranslationstepmult>" << std::endl;
@@ -355,7 +364,7 @@ protected:
             return PE_Support;
         }
 
-        static boost::array<std::string,17> tags = {{"fstandoff","targetbody","ftargetroll","vtargetdirection","vtargetposition","vmanipulatordirection", "btransformrobot","breturntrajectory","bonlycontacttarget","btightgrasp","bavoidcontact","vavoidlinkgeometry","fcoarsestep","ffinestep","ftranslationstepmult","fgraspingnoise","vintersectplane"}};
+        static boost::array<std::string,18> tags = {{"fstandoff","targetbody","ftargetroll","vtargetdirection","vtargetposition","vmanipulatordirection", "btransformrobot","breturntrajectory","bonlycontacttarget","btightgrasp","bavoidcontact","vavoidlinkgeometry","bcontinuouscontact","fcoarsestep","ffinestep","ftranslationstepmult","fgraspingnoise","vintersectplane"}};
         _bProcessingGrasp = find(tags.begin(),tags.end(),name) != tags.end();
         return _bProcessingGrasp ? PE_Support : PE_Pass;
     }
@@ -404,6 +413,9 @@ protected:
             else if( name == "bavoidcontact" ) {
                 _ss >> bavoidcontact;
             }
+            else if( name == "bcontinuouscontact" ) {
+                _ss >> bcontinuouscontact;
+            }
             else if( name == "fcoarsestep" ) {
                 _ss >> fcoarsestep;
             }
@@ -537,7 +549,7 @@ typedef boost::shared_ptr<TrajectoryTimingParameters const> TrajectoryTimingPara
 class OPENRAVE_API ConstraintTrajectoryTimingParameters : public TrajectoryTimingParameters
 {
 public:
-    ConstraintTrajectoryTimingParameters() : TrajectoryTimingParameters(), maxlinkspeed(0), maxlinkaccel(0), maxmanipspeed(0), maxmanipaccel(0), vConstraintManipDir(0,0,1), vConstraintGlobalDir(0,0,1), fCosManipAngleThresh(-1), mingripperdistance(0), velocitydistancethresh(0), maxmergeiterations(1000), minswitchtime(0.2),nshortcutcycles(1), fSearchVelAccelMult(0.8), _bCProcessing(false) {
+    ConstraintTrajectoryTimingParameters() : TrajectoryTimingParameters(), maxlinkspeed(0), maxlinkaccel(0), maxmanipspeed(0), maxmanipaccel(0), vConstraintManipDir(0,0,1), vConstraintGlobalDir(0,0,1), fCosManipAngleThresh(-1), mingripperdistance(0), velocitydistancethresh(0), maxmergeiterations(1000), minswitchtime(0.2),nshortcutcycles(1), nshortcutthreads(1), nshortcutwindowsize(0), bisectioncheckorder(0), fSearchVelAccelMult(0.8), onlineleadtime(0), onlinepadtime(0.01), _bCProcessing(false) {
         _vXMLParameters.push_back("maxlinkspeed");
         _vXMLParameters.push_back("maxlinkaccel");
         _vXMLParameters.push_back("manipname");
@@ -551,7 +563,13 @@ public:
         _vXMLParameters.push_back("maxmergeiterations");
         _vXMLParameters.push_back("minswitchtime");
         _vXMLParameters.push_back("nshortcutcycles");
+        _vXMLParameters.push_back("nshortcutthreads");
+        _vXMLParameters.push_back("nshortcutwindowsize");
+        _vXMLParameters.push_back("bisectioncheckorder");
         _vXMLParameters.push_back("searchvelaccelmult");
+        _vXMLParameters.push_back("onlineleadtime");
+        _vXMLParameters.push_back("onlinepadtime");
+        _vXMLParameters.push_back("_vconfigjerklimit");
     }
 
     dReal maxlinkspeed; ///< max speed in m/s that any point on any link goes. 0 means no speed limit
@@ -572,9 +590,18 @@ public:
     int maxmergeiterations; ///< when merging several ramps together, the order that they are merged in depends. This parameters pecifies how many permutations to test before giving up.
     dReal minswitchtime; ///< the minimum time between switching accelerations of any joint (waypoints).
     int nshortcutcycles; ///< number of times the shortcut cycle is repeted.
+    int nshortcutthreads; ///< if > 1, every shortcut iteration checks this many candidates in parallel on environment snapshots and keeps the best feasible one. The constraint smoother instead evaluates this many time-scaling coefficients in parallel when merging the ramps of a shortcut.
+    int nshortcutwindowsize; ///< if > 0 and nshortcutthreads > 1, paths with more than twice this many ramps are split into windows of about this many ramps that are shortcut concurrently on the environment snapshots with their boundary states fixed, followed by a pass that only shortcuts across the window boundaries. 0 disables windows.
+    int bisectioncheckorder; ///< if 1, checks the configurations of a ramp in bisection order (CFO_BisectionCheckOrder) so that infeasible shortcuts are rejected sooner, and skips their environment collision checks when the space swept by the ramp is free (CFO_SweptBoundCulling). Not used with manipulator constraints.
 
     dReal fSearchVelAccelMult; ///< a number in [0.0001,0.99999] that is the multipler of the velocity/acceleration limits when time-based constraints are invalidated (manip speed and/or dynamics). The closer to 1 it is, the more optimal the trajectory will be, but it will take more time to compute. A value around 0.5-0.8 is best.
 
+    // online shortcutting related parameters, only used by smoothers that shortcut while the path is executed
+    dReal onlineleadtime; ///< time in seconds between the start of planning and the start of the execution of the path. Only the portion of the path that is not executed yet is shortcut.
+    dReal onlinepadtime; ///< approximate upper bound in seconds of the time it takes to check a shortcut. Shortcuts starting sooner than this in the execution are not tried.
+
+    std::vector<dReal> _vConfigJerkLimit; ///< the jerk limits of the configuration space for the retimers that support them. If empty, jerk is not limited.
+
 protected:
     bool _bCProcessing;
     virtual bool serialize(std::ostream& O, int options=0) const
@@ -595,7 +622,17 @@ protected:
         O << "<maxmergeiterations>" << maxmergeiterations << "</maxmergeiterations>" << std::endl;
         O << "<minswitchtime>" << minswitchtime << "</minswitchtime>" << std::endl;
         O << "<nshortcutcycles>" << nshortcutcycles << "</nshortcutcycles>" << std::endl;
+        O << "<nshortcutthreads>" << nshortcutthreads << "</nshortcutthreads>" << std::endl;
+        O << "<nshortcutwindowsize>" << nshortcutwindowsize << "</nshortcutwindowsize>" << std::endl;
+        O << "<bisectioncheckorder>" << bisectioncheckorder << "</bisectioncheckorder>" << std::endl;
         O << "<searchvelaccelmult>" << fSearchVelAccelMult << "</searchvelaccelmult>" << std::endl;
+        O << "<onlineleadtime>" << onlineleadtime << "</onlineleadtime>" << std::endl;
+        O << "<onlinepadtime>" << onlinepadtime << "</onlinepadtime>" << std::endl;
+        O << "<_vconfigjerklimit>";
+        for(std::vector<dReal>::const_iterator it = _vConfigJerkLimit.begin(); it != _vConfigJerkLimit.end(); ++it) {
+            O << *it << " ";
+        }
+        O << "</_vconfigjerklimit>" << std::endl;
         if( !(options & 1) ) {
             O << _sExtraParameters << std::endl;
         }
@@ -613,7 +650,7 @@ protected:
         case PE_Support: return PE_Support;
         case PE_Ignore: return PE_Ignore;
         }
-        _bCProcessing = name=="maxlinkspeed" || name =="maxlinkaccel" || name=="manipname" || name=="maxmanipspeed" || name =="maxmanipaccel" || name=="mingripperdistance" || name=="velocitydistancethresh" || name=="maxmergeiterations" || name=="minswitchtime"|| name=="nshortcutcycles" || name=="constraintmanipdir" || name=="constraintglobaldir" || name=="cosmanipanglethresh" || name=="searchvelaccelmult";
+        _bCProcessing = name=="maxlinkspeed" || name =="maxlinkaccel" || name=="manipname" || name=="maxmanipspeed" || name =="maxmanipaccel" || name=="mingripperdistance" || name=="velocitydistancethresh" || name=="maxmergeiterations" || name=="minswitchtime"|| name=="nshortcutcycles" || name=="nshortcutthreads" || name=="nshortcutwindowsize" || name=="bisectioncheckorder" || name=="constraintmanipdir" || name=="constraintglobaldir" || name=="cosmanipanglethresh" || name=="searchvelaccelmult" || name=="onlineleadtime" || name=="onlinepadtime" || name=="_vconfigjerklimit";
         return _bCProcessing ? PE_Support : PE_Pass;
     }
 
@@ -650,9 +687,27 @@ protected:
             else if( name == "nshortcutcycles") {
                 _ss >> nshortcutcycles;
             }
+            else if( name == "nshortcutthreads") {
+                _ss >> nshortcutthreads;
+            }
+            else if( name == "nshortcutwindowsize") {
+                _ss >> nshortcutwindowsize;
+            }
+            else if( name == "bisectioncheckorder") {
+                _ss >> bisectioncheckorder;
+            }
             else if( name == "searchvelaccelmult") {
                 _ss >> fSearchVelAccelMult;
             }
+            else if( name == "onlineleadtime") {
+                _ss >> onlineleadtime;
+            }
+            else if( name == "onlinepadtime") {
+                _ss >> onlinepadtime;
+            }
+            else if( name == "_vconfigjerklimit" ) {
+                _vConfigJerkLimit = std::vector<dReal>((std::istream_iterator<dReal>(_ss)), std::istream_iterator<dReal>());
+            }
             else if( name == "constraintmanipdir" ) {
                 _ss >> vConstraintManipDir;
             }
@@ -711,11 +766,15 @@ typedef boost::shared_ptr<WorkspaceTrajectoryParameters const> WorkspaceTrajecto
 class OPENRAVE_API RRTParameters : public PlannerBase::PlannerParameters
 {
 public:
-    RRTParameters() : _minimumgoalpaths(1), _bProcessing(false) {
+    RRTParameters() : _minimumgoalpaths(1), _nNumThreads(1), _nLazyCollisionChecking(0), _bProcessing(false) {
         _vXMLParameters.push_back("minimumgoalpaths");
+        _vXMLParameters.push_back("numthreads");
+        _vXMLParameters.push_back("lazycollisionchecking");
     }
 
     size_t _minimumgoalpaths; ///< minimum number of goals to connect to before exiting. the goal with the shortest path is returned.
+    int _nNumThreads; ///< if > 1, BirrtPlanner races this many independently seeded instances on environment snapshots and returns the first solution found, BasicRrtPlanner computes this many extensions per iteration in parallel on environment snapshots.
+    int _nLazyCollisionChecking; ///< if > 0, the trees are grown without checking environment collisions and only the edges of a candidate path are fully checked. Edges that fail are removed and planning continues. Once this many candidate paths failed, the rest of the trees is grown with all constraints checked.
 
 protected:
     bool _bProcessing;
@@ -725,6 +784,8 @@ protected:
             return false;
         }
         O << "<minimumgoalpaths>" << _minimumgoalpaths << "</minimumgoalpaths>" << std::endl;
+        O << "<numthreads>" << _nNumThreads << "</numthreads>" << std::endl;
+        O << "<lazycollisionchecking>" << _nLazyCollisionChecking << "</lazycollisionchecking>" << std::endl;
         if( !(options & 1) ) {
             O << _sExtraParameters << std::endl;
         }
@@ -742,7 +803,7 @@ protected:
         case PE_Ignore: return PE_Ignore;
         }
 
-        _bProcessing = name=="minimumgoalpaths";
+        _bProcessing = name=="minimumgoalpaths" || name=="numthreads" || name=="lazycollisionchecking";
         return _bProcessing ? PE_Support : PE_Pass;
     }
 
@@ -752,6 +813,12 @@ protected:
             if( name == "minimumgoalpaths") {
                 _ss >> _minimumgoalpaths;
             }
+            else if( name == "numthreads" ) {
+                _ss >> _nNumThreads;
+            }
+            else if( name == "lazycollisionchecking" ) {
+                _ss >> _nLazyCollisionChecking;
+            }
             else {
                 RAVELOG_WARN(str(boost::format("unknown tag %s\n")%name));
             }
@@ -783,7 +850,7 @@ protected:
     bool _bProcessingBasic;
     virtual bool serialize(std::ostream& O, int options=0) const
     {
-        if( !PlannerParameters::serialize(O, options&~1) ) {
+        if( !RRTParameters::serialize(O, options|1) ) { // skip writing extra
             return false;
         }
         O << "<goalbias>" << _fGoalBiasProb << "</goalbias>" << std::endl;
@@ -801,7 +868,7 @@ protected:
         if( _bProcessingBasic ) {
             return PE_Ignore;
         }
-        switch( PlannerBase::PlannerParameters::startElement(name,atts) ) {
+        switch( RRTParameters::startElement(name,atts) ) {
         case PE_Pass: break;
         case PE_Support: return PE_Support;
         case PE_Ignore: return PE_Ignore;
@@ -830,8 +897,8 @@ protected:
             return false;
         }
 
-        // give a chance for the default parameters to get processed
-        return PlannerParameters::endElement(name);
+        // give a chance for the rrt parameters to get processed
+        return RRTParameters::endElement(name);
     }
 };
 
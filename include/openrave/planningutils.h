@@ -57,9 +57,33 @@ OPENRAVE_API int JitterCurrentConfiguration(PlannerBase::PlannerParametersConstP
  */
 OPENRAVE_API void VerifyTrajectory(PlannerBase::PlannerParametersConstPtr parameters, TrajectoryBaseConstPtr trajectory, dReal samplingstep=0.002);
 
+/// \brief a time interval of a trajectory that violates the planning constraints, returned by \ref VerifyTrajectoryIntervals
+class OPENRAVE_API InvalidTrajectoryInterval
+{
+public:
+    InvalidTrajectoryInterval() : starttime(0), endtime(0) {
+    }
+    dReal starttime, endtime; ///< equal when a waypoint is invalid
+    std::string message; ///< the reason, same as the exception message of \ref VerifyTrajectory
+};
+
+/** \brief validates a trajectory like \ref VerifyTrajectory, but reports every invalid time interval instead of throwing at the first one. <b>[multi-thread safe]</b>
+
+    The waypoints and the sampled segments are split into numthreads contiguous time ranges, each checked by its own thread on a snapshot of the environment.
+    Because every thread has its own copy of the parameters made with PlannerParameters::copy, custom state and constraint functions set on parameters
+    are replaced by the defaults of its configuration specification when numthreads > 1. Failed trajectories are not written to disk.
+    \param vinvalidintervals filled with the invalid intervals sorted by start time
+    \param numthreads the number of threads to check with, 1 checks in the calling thread
+    \param bstopatfirst if true, all threads stop as soon as one interval is invalid, so vinvalidintervals holds only the intervals found until then
+    \return true if the trajectory is valid
+ */
+OPENRAVE_API bool VerifyTrajectoryIntervals(PlannerBase::PlannerParametersConstPtr parameters, TrajectoryBaseConstPtr trajectory, std::vector<InvalidTrajectoryInterval>& vinvalidintervals, dReal samplingstep=0.002, int numthreads=1, bool bstopatfirst=true);
+
 /** \brief Extends the last ramp of the trajectory in order to reach a goal. THe configuration space matches the positional data of the trajectory.
 
-    Useful when appending jittered points to the trajectory.
+    Useful when appending jittered points to the trajectory. When index is the end of the trajectory, only the last segment is
+    replanned, so the cost does not depend on the length of the trajectory. This makes it suitable for trajectories that are
+    being streamed to a controller, as long as the controller has not yet reached the last segment.
     \param index the waypoint index of the trajectory
     \return the index of the first point in the original trajectory that comes after the modified trajectory.
  */
@@ -141,8 +165,9 @@ public:
        \param plannerparameters XML string to be appended to PlannerBase::PlannerParameters::_sExtraParameters passed in to the planner.
      **/
     ActiveDOFTrajectorySmoother(RobotBasePtr robot, const std::string& plannername="", const std::string& plannerparameters="");
-    virtual ~ActiveDOFTrajectorySmoother() {
-    }
+
+    /// \brief gives the planner back to a pool so the next smoother of the same robot and planner does not have to create it again
+    virtual ~ActiveDOFTrajectorySmoother();
 
     /// \brief Executes smoothing. <b>[multi-thread safe]</b>
     ///
@@ -181,8 +206,9 @@ public:
        \param hastimestamps if true, use the already initialized timestamps of the trajectory
      **/
     ActiveDOFTrajectoryRetimer(RobotBasePtr robot, const std::string& plannername="", const std::string& plannerparameters="");
-    virtual ~ActiveDOFTrajectoryRetimer() {
-    }
+
+    /// \brief gives the planner back to a pool so the next retimer of the same robot and planner does not have to create it again
+    virtual ~ActiveDOFTrajectoryRetimer();
 
     /// \brief Executes smoothing. <b>[multi-thread safe]</b>
     ///
@@ -340,6 +366,12 @@ OPENRAVE_API TrajectoryBasePtr ReverseTrajectory(TrajectoryBasePtr traj);
 /// Velocities are just negated and the new trajectory is not guaranteed to be executable or valid
 OPENRAVE_API TrajectoryBasePtr GetReverseTrajectory(TrajectoryBaseConstPtr traj);
 
+/// \brief returns a view of the trajectory with the order of the waypoints and times reversed.
+///
+/// Same as \ref GetReverseTrajectory except that the waypoints are read from traj when they are needed instead of being copied.
+/// The view is copied into a new trajectory the first time it is modified. traj must not be modified while the view reads from it.
+OPENRAVE_API TrajectoryBasePtr GetReverseTrajectoryView(TrajectoryBaseConstPtr traj);
+
 /// \brief segment the trajectory given the start and end points in-memory
 ///
 /// this is an in-memory operation
@@ -355,6 +387,12 @@ OPENRAVE_API void SegmentTrajectory(TrajectoryBasePtr traj, dReal starttime, dRe
 /// \param endtime the end time of the segment. If > duration, returns the last waypoint of the trajectory
 OPENRAVE_API TrajectoryBasePtr GetTrajectorySegment(TrajectoryBaseConstPtr traj, dReal starttime, dReal endtime);
 
+/// \brief returns a view of the segment of the trajectory given the start and end points
+///
+/// Same as \ref GetTrajectorySegment except that the waypoints are read from traj when they are needed instead of being copied.
+/// The view is copied into a new trajectory the first time it is modified. traj must not be modified while the view reads from it.
+OPENRAVE_API TrajectoryBasePtr GetTrajectorySegmentView(TrajectoryBaseConstPtr traj, dReal starttime, dReal endtime);
+
 /// \brief merges the contents of multiple trajectories into one so that everything can be played simultaneously.
 ///
 /// Each trajectory needs to have a 'deltatime' group for timestamps. The trajectories cannot share common configuration data because only one
@@ -453,10 +491,37 @@ protected:
     ///
     /// \param options should already be masked with _filtermask
     virtual int _SetAndCheckState(PlannerBase::PlannerParametersConstPtr params, const std::vector<dReal>& vdofvalues, const std::vector<dReal>& vdofvelocities, const std::vector<dReal>& vdofaccels, int options, ConstraintFilterReturnPtr filterreturn);
+
+    /// \brief checks the intermediate configurations of a segment in bisection order, used for CFO_BisectionCheckOrder
+    ///
+    /// Expects dQ, _vtempveldelta, and _vtempaccelconfig to be set up by Check. The start and end configurations are not checked.
+    /// \param options should already be masked with _filtermask
+    virtual int _CheckBisection(PlannerBase::PlannerParametersConstPtr params, const std::vector<dReal>& q0, const std::vector<dReal>& dq0, dReal timeelapsed, int numSteps, int options, ConstraintFilterReturnPtr filterreturn);
+
+    /// \brief returns true if the bounds swept by the links of the checked body from q0 over the segment do not overlap any other body, used for CFO_SweptBoundCulling
+    ///
+    /// Expects dQ and _vtempaccelconfig to be set up by Check. Sets the state to q0. Returns false whenever the bound cannot be computed,
+    /// for example when there are several check bodies, attached bodies, or the configuration moves other bodies or affine dofs.
+    /// \param fperturbation the perturbation of CFO_CheckWithPerturbation, 0 if not used
+    virtual bool _IsSweptBoundFree(PlannerBase::PlannerParametersConstPtr params, const std::vector<dReal>& q0, const std::vector<dReal>& dq0, dReal timeelapsed, dReal fperturbation);
+
+    /// \brief computes _vsweptlinkreaches at the current state of the body, returns false if its joints are not supported
+    virtual bool _ComputeSweptLinkReaches(KinBodyPtr pbody);
+
+    /// \brief sets the state to q0 and makes sure _vsweptconfigdofindices and _vsweptlinkreaches are set, returns false if the configuration or the check body are not supported
+    virtual bool _PrepareSweptLinkReaches(PlannerBase::PlannerParametersConstPtr params, const std::vector<dReal>& q0);
+
+    /// \brief checks the environment collisions of the intermediate configurations of a segment with steps adapted to the clearance, used for CFO_ClearanceAdaptiveSteps
+    ///
+    /// Every point of the check body moves at most the sum of the dof speeds times their reaches, so no collision can happen before the path parameter advances by the distance to the environment divided by that bound.
+    /// Expects dQ, _vtempveldelta, and _vtempaccelconfig to be set up by Check. The start and end configurations are not checked.
+    /// \param options should already be masked with _filtermask
+    /// \param[out] bsupported false if the segment could not be checked this way, in which case the environment collisions still have to be checked at the regular resolution
+    virtual int _CheckClearanceAdaptive(PlannerBase::PlannerParametersConstPtr params, const std::vector<dReal>& q0, const std::vector<dReal>& dq0, dReal timeelapsed, int numSteps, int options, ConstraintFilterReturnPtr filterreturn, bool& bsupported);
     virtual void _PrintOnFailure(const std::string& prefix);
 
     PlannerBase::PlannerParametersWeakConstPtr _parameters;
-    std::vector<dReal> _vtempconfig, _vtempvelconfig, dQ, _vtempveldelta, _vtempaccelconfig, _vperturbedvalues, _vcoeff2, _vcoeff1, _vprevtempconfig, _vprevtempvelconfig; ///< in configuration space
+    std::vector<dReal> _vtempconfig, _vtempvelconfig, dQ, _vtempveldelta, _vtempaccelconfig, _vperturbedvalues, _vcoeff2, _vcoeff1, _vprevtempconfig, _vprevtempvelconfig, _vpostdq, _vpostddq; ///< in configuration space
     CollisionReportPtr _report;
     std::list<KinBodyPtr> _listCheckBodies;
     int _filtermask;
@@ -470,6 +535,20 @@ protected:
     std::vector< int > _vdofindices;
     std::vector<dReal> _doftorques, _dofaccelerations; ///< in body DOF space
     boost::shared_ptr<ConfigurationSpecification::SetConfigurationStateFn> _setvelstatefn;
+
+    // for CFO_SweptBoundCulling
+    std::vector<int> _vsweptconfigdofindices; ///< the dof index of the check body of every configuration index, empty if it has to be recomputed
+    bool _bsweptconfigsupported; ///< true if the configuration only holds joint values of the check body, valid if _vsweptconfigdofindices is set
+    std::vector< std::vector< std::pair<int, dReal> > > _vsweptlinkreaches; ///< for every link, the dofs that move it and a bound on the distance of any point of the link to the dof axis that holds for all configurations. Empty if it has to be recomputed.
+    bool _bsweptlinkreachessupported; ///< false if the joints of the body are not supported, valid if _vsweptlinkreaches is set
+    UserDataPtr _sweptbodycallback; ///< resets _vsweptlinkreaches when the geometry or joints of the check body change
+    std::vector<dReal> _vsweptdoftravel; ///< in body DOF space, the distance each dof travels over the segment
+    std::vector<KinBodyPtr> _vsweptbodies;
+    std::vector<AABB> _vsweptbodyaabbs, _vsweptlinkaabbs;
+
+    // for CFO_ClearanceAdaptiveSteps
+    std::vector<dReal> _vclearancedofspeeds, _vclearancedofperturbations; ///< in body DOF space, the max speed of each dof with respect to the path parameter and how far the perturbations move it
+    DistanceReport _distancereport;
 };
 
 typedef boost::shared_ptr<DynamicsCollisionConstraint> DynamicsCollisionConstraintPtr;
@@ -562,6 +641,145 @@ protected:
     PlannerBase::PlannerParameters::DiffStateFn _diffstatefn;
 };
 
+/** \brief state space of the active dofs of a robot without affine dofs, used by \ref PlannerBase::PlannerParameters::SetRobotActiveJoints
+
+    The distance, difference, and neighbor functions are inline and work on contiguous buffers so planners can call them directly instead of going through the boost::function adapters of the parameters. Use \ref GetActiveDOFStateSpace to get the space of a set of parameters.
+
+    Computes the same values as SimpleDistanceMetric, RobotBase::SubtractActiveDOFValues, and the default neighbor function. The weights and joints are read at construction, so the space has to be created again when the active dofs change. All methods are const and can be called from several threads.
+ */
+class OPENRAVE_API ActiveDOFStateSpace
+{
+public:
+    /// \throw openrave_exception if the robot has active affine dofs
+    ActiveDOFStateSpace(RobotBasePtr robot);
+
+    inline int GetDOF() const {
+        return (int)_vweights2.size();
+    }
+
+    inline RobotBasePtr GetRobot() const {
+        return _robot;
+    }
+
+    /// \brief the squared weights of the active dofs
+    inline const std::vector<dReal>& GetWeights2() const {
+        return _vweights2;
+    }
+
+    /// \brief true if one of the active dofs is circular, in which case differences are wrapped
+    inline bool HasCircularDOFs() const {
+        return _vcircularjoints.size() > 0;
+    }
+
+    /// \brief weighted distance between two configurations of GetDOF() values
+    inline dReal ComputeDistance(const dReal* q0, const dReal* q1) const
+    {
+        const dReal* pweights = &_vweights2[0];
+        const int dof = GetDOF();
+        dReal fsum = 0;
+        if( _vcircularjoints.size() == 0 ) {
+            for(int i = 0; i < dof; ++i) {
+                dReal f = q0[i]-q1[i];
+                fsum += pweights[i]*f*f;
+            }
+        }
+        else {
+            for(int i = 0; i < dof; ++i) {
+                dReal f = _SubtractValue(q0[i], q1[i], i);
+                fsum += pweights[i]*f*f;
+            }
+        }
+        return RaveSqrt(fsum);
+    }
+
+    /// \brief q0 -= q1, circular dofs are wrapped
+    inline void Subtract(dReal* q0, const dReal* q1) const
+    {
+        const int dof = GetDOF();
+        if( _vcircularjoints.size() == 0 ) {
+            for(int i = 0; i < dof; ++i) {
+                q0[i] -= q1[i];
+            }
+        }
+        else {
+            for(int i = 0; i < dof; ++i) {
+                q0[i] = _SubtractValue(q0[i], q1[i], i);
+            }
+        }
+    }
+
+    /// \brief q += qdelta clamped to [plowerlimit, pupperlimit]
+    inline void AddStates(dReal* q, const dReal* qdelta, const dReal* plowerlimit, const dReal* pupperlimit) const
+    {
+        const int dof = GetDOF();
+        for(int i = 0; i < dof; ++i) {
+            q[i] += qdelta[i];
+            if( q[i] > pupperlimit[i] ) {
+                q[i] = pupperlimit[i];
+            }
+            else if( q[i] < plowerlimit[i] ) {
+                q[i] = plowerlimit[i];
+            }
+        }
+    }
+
+    /// \brief distances from config to the configurations stored one after the other in vconfigs, has the signature of PlannerBase::PlannerParameters::DistMetricBatchFn
+    void ComputeDistances(const std::vector<dReal>& config, const std::vector<dReal>& vconfigs, std::vector<dReal>& vdistances) const;
+
+protected:
+    inline dReal _SubtractValue(dReal value0, dReal value1, int index) const
+    {
+        const std::pair<KinBody::JointPtr, int>& circularjoint = _vcircularjoints[index];
+        if( !!circularjoint.first ) {
+            return circularjoint.first->SubtractValue(value0, value1, circularjoint.second);
+        }
+        return value0-value1;
+    }
+
+    RobotBasePtr _robot;
+    std::vector<dReal> _vweights2; ///< squared weights of the active dofs
+    std::vector< std::pair<KinBody::JointPtr, int> > _vcircularjoints; ///< for every active dof the joint and axis if it is circular, empty if no dof is circular
+};
+
+typedef boost::shared_ptr<ActiveDOFStateSpace> ActiveDOFStateSpacePtr;
+
+/// \brief the PlannerBase::PlannerParameters::_distmetricfn set by SetRobotActiveJoints
+struct OPENRAVE_API ActiveDOFDistanceMetricFn
+{
+    ActiveDOFDistanceMetricFn(ActiveDOFStateSpacePtr statespace) : _statespace(statespace) {
+    }
+    dReal operator()(const std::vector<dReal>& c0, const std::vector<dReal>& c1) const;
+
+    ActiveDOFStateSpacePtr _statespace;
+};
+
+/// \brief the PlannerBase::PlannerParameters::_diffstatefn set by SetRobotActiveJoints
+struct OPENRAVE_API ActiveDOFDiffStateFn
+{
+    ActiveDOFDiffStateFn(ActiveDOFStateSpacePtr statespace) : _statespace(statespace) {
+    }
+    void operator()(std::vector<dReal>& q0, const std::vector<dReal>& q1) const;
+
+    ActiveDOFStateSpacePtr _statespace;
+};
+
+/// \brief the PlannerBase::PlannerParameters::_neighstatefn set by SetRobotActiveJoints, clamps to the limits of the parameters it was created for
+struct OPENRAVE_API ActiveDOFNeighStateFn
+{
+    ActiveDOFNeighStateFn(ActiveDOFStateSpacePtr statespace, const std::vector<dReal>& vlowerlimit, const std::vector<dReal>& vupperlimit) : _statespace(statespace), _pvlowerlimit(&vlowerlimit), _pvupperlimit(&vupperlimit) {
+    }
+    bool operator()(std::vector<dReal>& q, const std::vector<dReal>& qdelta, int fromgoal) const;
+
+    ActiveDOFStateSpacePtr _statespace;
+    const std::vector<dReal>* _pvlowerlimit, *_pvupperlimit;
+};
+
+/** \brief returns the state space if the distance, difference, and neighbor functions of the parameters are the ones set by SetRobotActiveJoints
+
+    Planners can then call the inline functions of the space directly. Returns an empty pointer when any of the functions were overwritten, or when the neighbor function clamps to the limits of other parameters, in which case the functions of the parameters have to be called.
+ */
+OPENRAVE_API ActiveDOFStateSpacePtr GetActiveDOFStateSpace(const PlannerBase::PlannerParameters& params);
+
 /// \brief Samples numsamples of solutions and each solution to vsolutions
 ///
 /// \param nummaxsamples the max samples to query from a particular workspace goal. This does not necessarily mean every goal will have this many samples.
@@ -599,6 +817,19 @@ public:
     /// \param maxdist If > 0, allows jittering of the goal IK if they cause the robot to be in collision and no IK solutions to be found
     virtual void SetJitter(dReal maxdist);
 
+    /// \brief if true, Sample solves the ik of all the parameterizations at once and then only hands out the cached solutions
+    ///
+    /// The solutions are solved again at the next Sample call after the environment changed: bodies were added, removed or moved,
+    /// the robot base or the dofs outside of the arm moved, or the robot grabbed other bodies. The parameterizations are solved
+    /// one after the other since the checks share the environment, the ik solver can still sweep its free parameters in parallel.
+    virtual void SetBatchSolving(bool bbatch);
+
+    /// \brief returns the index of the parameterization given at construction that is closest to ikparam, or -1 if none has its type
+    ///
+    /// All the parameterizations of the type are compared at once with \ref IkParameterization::ComputeDistancesSqr, e.g. to find the goal of a large goal set that a reached pose belongs to.
+    /// \param fdistsqr receives the squared distance to the closest parameterization
+    virtual int FindClosestIkParameterization(const IkParameterization& ikparam, dReal& fdistsqr);
+
 protected:
     struct SampleInfo
     {
@@ -623,6 +854,27 @@ protected:
     int _tempikindex; ///< if _vikreturns.size() > 0, points to the original ik index of those solutions
     int _ikfilteroptions;
     bool _searchfreeparameters;
+
+    // batch solving, see SetBatchSolving
+    IkReturnPtr _SampleBatch();
+    void _SolveBatch();
+    void _GetBatchState(std::vector<int>& vbodystamps, std::vector<dReal>& vrobotstate);
+
+    std::list<SampleInfo> _listorigsamples; ///< the samples before any was consumed, the batch solving restarts from them
+    std::vector< std::vector<IkReturnPtr> > _vbatchsolutions; ///< for every parameterization, the solutions left to hand out. The next one is at the back
+    std::vector<int> _vbatchindices; ///< the parameterizations that have solutions left in _vbatchsolutions
+    std::vector<int> _vbatchbodystamps, _vtempbodystamps; ///< (environment id, update stamp) of the bodies the batch was solved with
+    std::vector<dReal> _vbatchrobotstate, _vtemprobotstate; ///< the robot transform and the values of the dofs outside of the arm the batch was solved with
+    bool _bBatchSolving, _bBatchSolved;
+
+    /// \brief the parameterizations of one type packed for IkParameterization::ComputeDistancesSqr
+    struct PackedParameterizations
+    {
+        std::vector<dReal> _vvalues; ///< the values of the parameterizations one after the other
+        std::vector<int> _vorgindices; ///< the original index of each parameterization
+    };
+    std::map<IkParameterizationType, PackedParameterizations> _mapPackedParameterizations; ///< used by FindClosestIkParameterization
+    std::vector<dReal> _vtempdists;
 };
 
 typedef boost::shared_ptr<ManipulatorIKGoalSampler> ManipulatorIKGoalSamplerPtr;
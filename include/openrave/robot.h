@@ -354,6 +354,11 @@ public:
         /// \brief calls std::vector version of CalculateAngularVelocityJacobian internally, a little inefficient since it copies memory
         virtual void CalculateAngularVelocityJacobian(boost::multi_array<dReal,2>& jacobian) const;
 
+        /// \brief computes the translation and angule axis jacobians of the arm indices together, see \ref KinBody::ComputeJacobians
+        ///
+        /// \param jacobian 6xN row-major, the first 3 rows are \ref CalculateJacobian and the last 3 rows are \ref CalculateAngularVelocityJacobian
+        virtual void CalculateJacobians(std::vector<dReal>& jacobian) const;
+
         /// \brief return a copy of the configuration specification of the arm indices
         ///
         /// Note that the return type is by-value, so should not be used in iteration
@@ -602,6 +607,7 @@ private:
 
     virtual void SetDOFValues(const std::vector<dReal>& vJointValues, uint32_t checklimits = 1, const std::vector<int>& dofindices = std::vector<int>());
     virtual void SetDOFValues(const std::vector<dReal>& vJointValues, const Transform& transbase, uint32_t checklimits = 1);
+    virtual void SetDOFValues(const dReal* pJointValues, size_t numvalues, uint32_t checklimits = 1, const std::vector<int>& dofindices = std::vector<int>());
 
     virtual void SetLinkTransformations(const std::vector<Transform>& transforms);
     virtual void SetLinkTransformations(const std::vector<Transform>& transforms, const std::vector<dReal>& doflastsetvalues);
@@ -744,6 +750,13 @@ private:
 
     virtual void SetActiveDOFValues(const std::vector<dReal>& values, uint32_t checklimits=1);
     virtual void GetActiveDOFValues(std::vector<dReal>& v) const;
+
+    /// \brief sets the active dof values from a raw buffer of numvalues >= GetActiveDOF() values. Repeated calls do not allocate memory.
+    virtual void SetActiveDOFValues(const dReal* pValues, size_t numvalues, uint32_t checklimits=1);
+
+    /// \brief fills a raw buffer of numvalues >= GetActiveDOF() values with the active dof values. Repeated calls do not allocate memory.
+    virtual void GetActiveDOFValues(dReal* pValues, size_t numvalues) const;
+
     virtual void SetActiveDOFVelocities(const std::vector<dReal>& velocities, uint32_t checklimits=1);
     virtual void GetActiveDOFVelocities(std::vector<dReal>& velocities) const;
     virtual void GetActiveDOFLimits(std::vector<dReal>& lower, std::vector<dReal>& upper) const;
@@ -932,6 +945,20 @@ private:
      */
     virtual void GetIgnoredLinksOfGrabbed(KinBodyConstPtr body, std::list<KinBody::LinkConstPtr>& ignorelinks) const;
 
+    /** \brief sets the resolution of the cache of the robot links that do not collide with a body when it is grabbed.
+
+        Grabbing checks the body against every robot link. The results are cached by the geometry hash of the body, the grabbing link, the ignored links,
+        and the relative pose of the body and the robot configuration rounded to fResolution, so grabbing the same part the same way again skips the checks.
+        The cache is cleared when the geometry or the kinematics of the robot change, or when its self-collision checker changes.
+        \param fResolution meters and radians, 0 disables the cache
+     */
+    virtual void SetGrabbedCollidingLinksCacheResolution(dReal fResolution);
+
+    /// \brief returns the resolution of the cache of the non-colliding links of grabbed bodies, see \ref SetGrabbedCollidingLinksCacheResolution
+    virtual dReal GetGrabbedCollidingLinksCacheResolution() const {
+        return _fGrabbedCollidingLinksCacheResolution;
+    }
+
     //@}
 
     /** \brief Simulate the robot and update the grabbed bodies and attached sensors
@@ -1020,6 +1047,10 @@ protected:
     virtual void _PostprocessChangedParameters(uint32_t parameters);
 
     std::vector<UserDataPtr> _vGrabbedBodies; ///< vector of grabbed bodies
+    std::vector<std::pair<Vector,Vector> > _vGrabbedLinkVelocities; ///< cache for _UpdateGrabbedBodies
+    std::map<std::string, std::vector<uint8_t> > _mapGrabbedCollidingLinksCache; ///< for every grab key, 1 for the robot links that did not collide with the grabbed body, see \ref SetGrabbedCollidingLinksCacheResolution
+    CollisionCheckerBaseWeakPtr _pGrabbedCollidingLinksCacheChecker; ///< the checker that computed _mapGrabbedCollidingLinksCache
+    dReal _fGrabbedCollidingLinksCacheResolution; ///< \see SetGrabbedCollidingLinksCacheResolution
     virtual void _UpdateGrabbedBodies();
     virtual void _UpdateAttachedSensors();
     std::vector<ManipulatorPtr> _vecManipulators; ///< \see GetManipulators
@@ -1049,6 +1080,7 @@ private:
     }
     mutable std::string __hashrobotstructure;
     mutable std::vector<dReal> _vTempRobotJoints;
+    mutable std::vector<dReal> _vTempAffineValues; ///< used for converting the affine part of the active dofs
 
 #ifdef RAVE_PRIVATE
 #ifdef _MSC_VER
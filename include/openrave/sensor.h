@@ -50,6 +50,8 @@ public:
     class OPENRAVE_API SensorData
     {
 public:
+        SensorData() : __stamp(0), __sequence(0) {
+        }
         virtual ~SensorData() {
         }
         virtual SensorType GetType() = 0;
@@ -59,6 +61,7 @@ public:
 
         uint64_t __stamp;         ///< time stamp of the sensor data in microseconds. If 0, then the data is uninitialized! (floating-point precision is bad here). This can be either simulation or real time depending on the sensor.
         Transform __trans;             ///< the coordinate system the sensor was when the measurement was taken, this is taken directly from SensorBase::GetTransform
+        uint64_t __sequence;         ///< incremented by the sensor every time it publishes new data, 0 if the sensor does not count its frames. Consumers can compare it to detect new or dropped frames.
     };
     typedef boost::shared_ptr<SensorBase::SensorData> SensorDataPtr;
     typedef boost::shared_ptr<SensorBase::SensorData const> SensorDataConstPtr;
@@ -88,6 +91,7 @@ public:
             return ST_Camera;
         }
         std::vector<uint8_t> vimagedata;         ///< rgb image data, if camera only outputs in grayscale, fill each channel with the same value
+        std::vector<float> vdepthdata;         ///< width*height depth along the optical axis in meters, 0 where nothing was hit. Empty if the camera does not output depth.
         virtual bool serialize(std::ostream& O) const;
     };
 
@@ -392,6 +396,18 @@ public:
     /// psensordata->GetType() in order to return the correctly supported type.
     virtual bool GetSensorData(SensorDataPtr psensordata) = 0;
 
+    /** \brief Returns the most recent published data of the sensor without copying it.
+
+        The returned data is immutable and reference counted, the sensor never writes into it again, so any number of consumers can hold on to it
+        for as long as they like without blocking the sensor thread. Sensors that publish from a ring of preallocated frames recycle a frame
+        only once all consumers have released it. Poll SensorData::__sequence to detect new frames. This method is thread safe.
+
+        The default implementation copies the data through \ref CreateSensorData and \ref GetSensorData.
+        \param type the requested sensor type, if ST_Invalid returns the type most representative of this sensor.
+        \return the latest data, or an empty pointer if the sensor has not published anything of that type yet
+     */
+    virtual SensorDataConstPtr GetLatestSensorData(SensorType type=ST_Invalid);
+
     /// \brief returns true if sensor supports a particular sensor type
     virtual bool Supports(SensorType type) = 0;
 
@@ -184,6 +184,19 @@ protected:
     virtual bool EnableBody(KinBodyPtr pbody, bool bEnable);
     virtual bool SwitchBody(KinBodyPtr pbody1, KinBodyPtr pbody2);
 
+    /// \brief queues the raw transforms returned by the tracking system, can be called from any thread without locking the environment
+    ///
+    /// The update thread applies all the queued transforms inside one environment lock. If several transforms of a body are queued
+    /// before the update thread runs, only the latest one is applied. Transforms of bodies that are not in the system or disabled are ignored.
+    /// \param vtransforms pairs of XMLData::id and the transform returned by the tracking system
+    virtual void QueueTransforms(const std::vector< std::pair<int, Transform> >& vtransforms);
+
+    /// \brief bodies whose new transform is closer than both thresholds to their current transform are not moved, but are still marked as present
+    ///
+    /// \param ftranslationthresh distance threshold in meters, 0 moves the bodies on every update
+    /// \param frotationthresh angle threshold in radians
+    virtual void SetUpdateThresholds(dReal ftranslationthresh, dReal frotationthresh);
+
 protected:
     typedef std::pair<boost::shared_ptr<BodyData>, Transform > SNAPSHOT;
     typedef std::map<int,boost::shared_ptr<BodyData> > BODIES;
@@ -202,6 +215,8 @@ protected:
     BODIES _mapbodies;
     boost::mutex _mutex;
     uint64_t _expirationtime;     ///< expiration time in us
+    std::map<int, Transform> _mapqueuedtransforms; ///< XMLData::id to the latest queued transform, protected by _mutex
+    dReal _ftranslationthresh, _frotationthresh; ///< see SetUpdateThresholds
     bool _bShutdown;
     boost::thread _threadUpdate;
 };
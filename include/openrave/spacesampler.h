@@ -56,6 +56,18 @@ public:
     /// \brief sets a new seed. For sequence samplers, the seed describes the n^th sample to begin at.
     virtual void SetSeed(uint32_t seed) OPENRAVE_DUMMY_IMPLEMENTATION;
 
+    /** \brief creates a new sampler generating the index'th of numsubstreams deterministic substreams of this sampler
+
+        Gives every thread of a parallel computation its own reproducible stream. The substreams only depend on the seed
+        (and for sequence samplers the current position in the sequence), so the same index always reproduces the same values.
+        \param index the substream to create, in [0,numsubstreams)
+        \param numsubstreams the number of substreams the caller splits the sampler into
+        \return the new sampler, or an empty pointer if the sampler does not support substreams
+     */
+    virtual SpaceSamplerBasePtr CreateSubstream(uint32_t index, uint32_t numsubstreams) {
+        return SpaceSamplerBasePtr();
+    }
+
     /// \brief Sets the degrees of freedom of the space (note this is different from the parameterization dimension)
     virtual void SetSpaceDOF(int dof) OPENRAVE_DUMMY_IMPLEMENTATION;
 
@@ -91,6 +103,25 @@ public:
      */
     virtual int SampleSequence(std::vector<dReal>& samples, size_t num=1,IntervalType interval=IT_Closed) OPENRAVE_DUMMY_IMPLEMENTATION;
 
+    /** \brief sequentially sampling the next 'num' samples into a caller-provided buffer
+
+        Samplers that generate many samples at once should override this, it avoids resizing a vector for every call.
+        \param samples buffer of at least num*GetNumberOfValues() values
+        \param num number of samples to return
+        \param interval the sampling intervel for each of the dimensions.
+        \return the number of samples completed or an error code. Error codes are <= 0.
+     */
+    virtual int SampleSequence(dReal* samples, size_t num, IntervalType interval=IT_Closed)
+    {
+        // by default, use the vector version
+        std::vector<dReal> vsamples;
+        int ret = SampleSequence(vsamples,num,interval);
+        if( ret > 0 ) {
+            std::copy(vsamples.begin(),vsamples.begin()+ret*GetNumberOfValues(),samples);
+        }
+        return ret;
+    }
+
     /// \brief samples the real next value on the sequence, only valid for 1 DOF sequences.
     ///
     /// \throw openrave_exception throw if could not be sampled
@@ -93,6 +93,76 @@ public:
      */
     virtual void SamplePoints(std::vector<dReal>& data, const std::vector<dReal>& times, const ConfigurationSpecification& spec) const;
 
+    /** \brief bulk samples the trajectory every deltatime seconds using the trajectory's specification.
+
+        The i-th point is sampled at time i*deltatime, starting from 0 up to GetDuration().
+        \param data[out] the sampled points
+        \param deltatime[in] the time step between two samples, has to be positive
+        \param ensureLastPoint[in] if true, will always add the point at GetDuration() even if it is closer than deltatime to the previous sample
+     */
+    virtual void SamplePointsSameDeltaTime(std::vector<dReal>& data, dReal deltatime, bool ensureLastPoint) const;
+
+    /** \brief bulk samples the trajectory every deltatime seconds in a specific configuration specification.
+
+        The default implementation is slow, so interface developers should override it.
+        \param data[out] the sampled points
+        \param deltatime[in] the time step between two samples, has to be positive
+        \param ensureLastPoint[in] if true, will always add the point at GetDuration() even if it is closer than deltatime to the previous sample
+        \param spec[in] the specification format to return the data in
+     */
+    virtual void SamplePointsSameDeltaTime(std::vector<dReal>& data, dReal deltatime, bool ensureLastPoint, const ConfigurationSpecification& spec) const;
+
+    /** \brief Sequentially samples one trajectory in a fixed configuration specification.
+
+        Returned from \ref CreateSampler. Returns the same values as \ref Sample(std::vector<dReal>&, dReal, const ConfigurationSpecification&) const,
+        but implementations can remember the last sampled segment and precompute the specification conversion, so sampling at
+        monotonically increasing times is much faster. The sampler is not multi-thread safe, each thread should create its own.
+     */
+    class OPENRAVE_API Sampler
+    {
+public:
+        Sampler(TrajectoryBaseConstPtr traj, const ConfigurationSpecification& spec);
+        virtual ~Sampler() {
+        }
+
+        /** \brief samples a data point on the trajectory at a particular time.
+
+            \param data[out] the sampled point, resized to GetConfigurationSpecification().GetDOF(). If the capacity is already enough, nothing is allocated.
+            \param time[in] the time to sample
+         */
+        virtual void Sample(std::vector<dReal>& data, dReal time);
+
+        /// \brief forget any cached segment information so the next sample searches the whole trajectory
+        virtual void Reset() {
+        }
+
+        inline TrajectoryBaseConstPtr GetTrajectory() const {
+            return _traj;
+        }
+
+        /// \brief the specification the samples are returned in
+        inline const ConfigurationSpecification& GetConfigurationSpecification() const {
+            return _spec;
+        }
+
+protected:
+        TrajectoryBaseConstPtr _traj;
+        ConfigurationSpecification _spec;
+    };
+    typedef boost::shared_ptr<Sampler> SamplerPtr;
+
+    /** \brief creates a sampler that returns points of this trajectory in the specified configuration specification.
+
+        The default implementation calls \ref Sample for every point, so interface developers should override it.
+        \param spec[in] the specification format to return the data in
+     */
+    virtual SamplerPtr CreateSampler(const ConfigurationSpecification& spec) const;
+
+    /// \brief creates a sampler that returns points in the trajectory's own configuration specification.
+    inline SamplerPtr CreateSampler() const {
+        return CreateSampler(GetConfigurationSpecification());
+    }
+
     virtual const ConfigurationSpecification& GetConfigurationSpecification() const = 0;
 
     /// \brief return the number of waypoints
@@ -116,6 +186,16 @@ public:
      */
     virtual void GetWaypoints(size_t startindex, size_t endindex, std::vector<dReal>& data, const ConfigurationSpecification& spec) const;
 
+    /** \brief returns a pointer to the internal data of the waypoints starting at startindex, so that the waypoints can be read without copying them.
+
+        The data is in \ref GetConfigurationSpecification and is valid until the trajectory is modified.
+        \param startindex[in] the start index of the waypoint
+        \return NULL if the trajectory does not store its waypoints contiguously or startindex is out of range
+     */
+    virtual const dReal* GetWaypointsData(size_t startindex) const {
+        return NULL;
+    }
+
     /** \brief returns one waypoint
 
         \param index[in] index of the waypoint. If < 0, then counting starts from the last waypoint. For example GetWaypoints(-1,data) returns the last waypoint.
@@ -155,10 +235,14 @@ public:
     /// \brief return the duration of the trajectory in seconds
     virtual dReal GetDuration() const = 0;
 
-    /// \brief output the trajectory in XML format
+    /** \brief output the trajectory in XML format
+
+        If options has \ref SO_BinaryTrajectory, writes the binary format instead: a header with the configuration specification
+        followed by the raw little-endian waypoint data, then the description and readable interfaces. O should be opened in binary mode.
+     */
     virtual void serialize(std::ostream& O, int options=0) const;
 
-    /// \brief initialize the trajectory
+    /// \brief initialize the trajectory from the XML or the binary format, the format is detected from the first byte of the stream.
     virtual InterfaceBasePtr deserialize(std::istream& I);
 
     virtual void Clone(InterfaceBaseConstPtr preference, int cloningoptions);
@@ -268,6 +352,23 @@ protected:
         return boost::static_pointer_cast<TrajectoryBase const>(shared_from_this());
     }
 
+    /// \brief returns true if the next non-whitespace byte of I starts the binary trajectory format
+    static bool _IsBinaryFormat(std::istream& I);
+
+    /// \brief writes the binary format header, the waypoint data pdata[0:numwaypoints*spec.GetDOF()], and the description and readable interfaces
+    void _SerializeBinary(std::ostream& O, const ConfigurationSpecification& spec, const dReal* pdata, size_t numwaypoints, int options) const;
+
+    /// \brief reads the binary format header written by \ref _SerializeBinary
+    ///
+    /// \param[out] numwaypoints the number of waypoints, the next numwaypoints*spec.GetDOF() dReals of I are the data
+    static void _DeserializeBinaryHeader(std::istream& I, ConfigurationSpecification& spec, size_t& numwaypoints);
+
+    /// \brief reads numvalues dReals of waypoint data written by \ref _SerializeBinary
+    static void _DeserializeBinaryData(std::istream& I, dReal* pdata, size_t numvalues);
+
+    /// \brief reads the description and readable interfaces following the data and sets them on this trajectory
+    void _DeserializeBinaryFooter(std::istream& I);
+
 private:
     virtual const char* GetHash() const {
         return OPENRAVE_TRAJECTORY_HASH;
@@ -33,6 +33,7 @@
 #include <boost/weak_ptr.hpp>
 #include <boost/function.hpp>
 #include <boost/assert.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include <time.h>
 
@@ -144,6 +145,155 @@ inline static uint64_t GetNanoPerformanceTime()
 
 #endif
 
+/// \brief enables accumulating the time spent in the \ref ProfileZone scopes of all the threads. Disabled by default.
+OPENRAVE_API void SetProfilingEnabled(bool benabled);
+
+/// \brief returns true if the \ref ProfileZone scopes are timed
+OPENRAVE_API bool IsProfilingEnabled();
+
+/// \brief adds one call of duration nanoseconds to the zone of the calling thread
+///
+/// \param zonename a string literal, zones are aggregated by the address of their name while recording
+OPENRAVE_API void AddProfileSample(const char* zonename, uint64_t nanoseconds);
+
+/// \brief clears the statistics of all the zones and threads
+OPENRAVE_API void ResetProfiling();
+
+/// \brief writes the statistics of the zones merged over all the threads as a JSON object
+///
+/// e.g. {"KinBody::SetDOFValues": {"count": 10, "total": 0.001, "mean": 0.0001, "min": 0.00005, "max": 0.0003}}, times are in seconds
+OPENRAVE_API void WriteProfilingStatistics(std::ostream& sout);
+
+/// \brief times its scope as one call of a named zone when profiling is enabled, see \ref SetProfilingEnabled
+///
+/// The time is inclusive, so nested zones are also counted in the enclosing zones. When profiling is disabled the cost is a function call.
+/// \code
+/// void KinBody::SetDOFValues(...)
+/// {
+///     utils::ProfileZone profilezone("KinBody::SetDOFValues");
+/// \endcode
+class ProfileZone
+{
+public:
+    ProfileZone(const char* zonename) : _zonename(zonename), _starttime(0) {
+        if( IsProfilingEnabled() ) {
+            _starttime = GetNanoPerformanceTime();
+        }
+    }
+    ~ProfileZone() {
+        if( _starttime != 0 ) {
+            AddProfileSample(_zonename, GetNanoPerformanceTime() - _starttime);
+        }
+    }
+private:
+    const char* _zonename;
+    uint64_t _starttime;
+};
+
+/// \brief sets the number of worker threads of the process-wide thread pool that runs the parallel work of all the modules, see \ref ThreadPoolTaskGroup
+///
+/// The pool starts with one thread per hardware thread the first time it is used. Tasks that are queued when the size changes are kept.
+/// \param numthreads the number of worker threads, 0 uses the number of hardware threads
+/// \param vcpus if not empty, worker i is pinned to the cpu vcpus[i%vcpus.size()]. Only supported on Linux.
+OPENRAVE_API void SetThreadPoolSize(int numthreads, const std::vector<int>& vcpus=std::vector<int>());
+
+/// \brief returns the number of worker threads of the thread pool
+OPENRAVE_API int GetThreadPoolSize();
+
+/// \brief clears the statistics of all the task types
+OPENRAVE_API void ResetThreadPoolStatistics();
+
+/// \brief writes the statistics of each task type of the thread pool as a JSON object
+///
+/// e.g. {"ParallelRangeWorkers": {"count": 10, "cancelled": 0, "total": 0.01, "max": 0.002, "queuetotal": 0.0001}}, times are in seconds.
+/// total is the time spent running the tasks and queuetotal the time they waited in the queue.
+OPENRAVE_API void WriteThreadPoolStatistics(std::ostream& sout);
+
+class ThreadPoolTaskGroupState;
+
+/// \brief a group of tasks run by the process-wide thread pool, which can be waited on and cancelled together
+///
+/// Each worker of the pool has its own queue. Tasks submitted from a worker go to its queue, and idle workers steal from the other queues,
+/// so nested parallel work does not oversubscribe the cores. While waiting, the calling thread runs the queued tasks of its own group.
+/// \code
+/// utils::ThreadPoolTaskGroup group("MyPlanner", boost::bind(&MyPlanner::_IsInterrupted, this));
+/// for(size_t i = 0; i < vjobs.size(); ++i) {
+///     group.Submit(boost::bind(&MyPlanner::_Evaluate, this, i));
+/// }
+/// group.Wait();
+/// \endcode
+class OPENRAVE_API ThreadPoolTaskGroup
+{
+public:
+    /// \param tasktype the name the tasks are aggregated under in \ref WriteThreadPoolStatistics
+    /// \param cancelfn if set, it is called before each task starts and cancels the group once it returns true, e.g. when a planner was interrupted by its callbacks
+    ThreadPoolTaskGroup(const std::string& tasktype, const boost::function<bool()>& cancelfn=boost::function<bool()>());
+
+    /// \brief cancels the tasks that did not start and waits for the running ones
+    virtual ~ThreadPoolTaskGroup();
+
+    /// \brief queues a task, which can be called from any thread, including from the tasks of the group
+    void Submit(const boost::function<void()>& fn);
+
+    /// \brief returns when all the submitted tasks are done or skipped because the group was cancelled
+    ///
+    /// \throw openrave_exception the first exception thrown by one of the tasks, the other tasks still run
+    void Wait();
+
+    /// \brief skips the tasks that did not start yet. The running ones can poll \ref IsCancelled to stop early.
+    void Cancel();
+
+    /// \brief returns true if \ref Cancel was called or the cancel function returned true
+    bool IsCancelled() const;
+
+private:
+    boost::shared_ptr<ThreadPoolTaskGroupState> _state;
+};
+
+/// \brief monotonic memory arena that the allocations of one planning request can be served from, see \ref PlannerBase::PlannerParameters::_parena
+///
+/// Allocations only move a pointer forward inside big blocks and are never freed one by one. All the memory is released at once
+/// when the last reference to the arena goes away, so a long-lived process does not fragment its heap with the many small objects of each request.
+/// Allocate can be called from several threads.
+class OPENRAVE_API MonotonicArena
+{
+public:
+    class Statistics
+    {
+public:
+        Statistics() : numblocks(0), reservedbytes(0), usedbytes(0), numallocations(0), numresets(0) {
+        }
+        size_t numblocks; ///< number of blocks taken from the heap
+        size_t reservedbytes; ///< total bytes held by the blocks
+        size_t usedbytes; ///< bytes handed out since the last reset, including the alignment padding and the unused ends of the filled blocks
+        size_t numallocations; ///< number of allocations since the last reset
+        size_t numresets; ///< number of times Reset was called
+    };
+
+    /// \param blocksize the size of the blocks taken from the heap. Bigger allocations get a block of their own.
+    MonotonicArena(size_t blocksize=65536);
+    virtual ~MonotonicArena();
+
+    /// \brief returns size bytes aligned to alignment, which has to be a power of two
+    void* Allocate(size_t size, size_t alignment=sizeof(dReal));
+
+    /// \brief makes all the memory available again while keeping the blocks for the next request
+    ///
+    /// Everything allocated before becomes invalid, so the planners that were initialized with this arena have to be destroyed or re-initialized first.
+    void Reset();
+
+    void GetStatistics(Statistics& stats) const;
+
+private:
+    std::vector< std::pair<char*, size_t> > _vblocks; ///< the blocks and their sizes
+    size_t _blocksize;
+    size_t _curblock, _curoffset; ///< the next free byte
+    size_t _numallocations, _numresets;
+    mutable boost::mutex _mutex;
+};
+
+typedef boost::shared_ptr<MonotonicArena> MonotonicArenaPtr;
+
 struct null_deleter
 {
     void operator()(void const *) const {
@@ -262,6 +412,18 @@ inline void TokenizeString(std::string const& s, char const* d, C& ret, bool ski
 /// If separator is not present, will return entire string
 OPENRAVE_API std::string GetFilenameUntilSeparator(std::istream& sinput, char separator);
 
+/// \brief parses the whitespace separated numbers of [pbegin, pend) independent of the locale and appends them to values
+///
+/// Much faster than reading the values with istream_iterator<dReal>, which is what it replaces for long value lists like inline meshes.
+/// \return where the parsing stopped, pend unless a token is not a number
+OPENRAVE_API const char* ParseRealValues(const char* pbegin, const char* pend, std::vector<dReal>& values);
+
+/// \brief reads all the remaining numbers of ss into values like std::vector<dReal>((istream_iterator<dReal>(ss)), istream_iterator<dReal>())
+///
+/// Leaves ss in the same state the istream_iterator loop would.
+/// \param sbuffer storage for the characters of ss, can be kept by the caller so that it is not reallocated
+OPENRAVE_API void ParseRealValues(std::stringstream& ss, std::vector<dReal>& values, std::string& sbuffer);
+
 /// \brief search and replace strings for all pairs. Internally first checks the longest strings before the shortest
 ///
 /// \return returns a reference to the out string
@@ -41,6 +41,19 @@ public:
     virtual void SetTransform(const RaveTransform<float>& t) OPENRAVE_DUMMY_IMPLEMENTATION;
     /// \brief Shows or hides the plot without destroying its resources. <b>[multi-thread safe]</b>
     virtual void SetShow(bool bshow) OPENRAVE_DUMMY_IMPLEMENTATION;
+
+    /** \brief Replaces the vertices of a point, line strip, or line list plot in place. <b>[multi-thread safe]</b>
+
+        The viewer keeps its vertex buffer instead of creating a new plot, so plots that change every frame should be created once with
+        the largest number of points and then updated. Points after numPoints are not drawn, colors are kept.
+        \param ppoints array of points, first three values are xyz
+        \param numPoints number of points, has to be at most the number of points the plot was created with
+        \param stride stride in bytes to the next point
+        \return true if the plot was updated, false if the plot cannot be updated in place and has to be re-created
+     */
+    virtual bool SetPoints(const float* ppoints, int numPoints, int stride) {
+        return false;
+    }
 };
 
 typedef boost::shared_ptr<GraphHandle> GraphHandlePtr;
@@ -211,6 +211,22 @@ OPENRAVE_C_API void ORCBodyGetTransformMatrix(void* body, OpenRAVEReal* matrix);
 /// \param trimesh returned from ORCTriMeshCreate()
 OPENRAVE_C_API bool ORCBodyInitFromTrimesh(void* body, void* trimesh, bool visible);
 
+/// \brief Sets each configuration with \ref KinBody::SetDOFValues and checks its collisions.
+///
+/// The environment lock is acquired once for the whole batch and the body state is restored at the end.
+/// \param configurations numconfigurations*dof array of DOF values
+/// \param checkself if non-zero, also calls \ref KinBody::CheckSelfCollision
+/// \param[out] collisions pre-allocated array of numconfigurations flags, 1 if the configuration is in collision
+/// \return number of configurations in collision
+OPENRAVE_C_API int ORCBodyCheckCollisionBatch(void* body, const OpenRAVEReal* configurations, int numconfigurations, int checkself, int* collisions);
+
+/// \brief Sets each configuration with \ref KinBody::SetDOFValues and gets the link transforms.
+///
+/// The environment lock is acquired once for the whole batch and the body state is restored at the end.
+/// \param configurations numconfigurations*dof array of DOF values
+/// \param[out] poses pre-allocated numconfigurations*numlinks*7 array, for every link the quaternion (4) and translation (3) of its world pose
+OPENRAVE_C_API void ORCBodyGetLinkTransformsBatch(void* body, const OpenRAVEReal* configurations, int numconfigurations, OpenRAVEReal* poses);
+
 //@}
 
 /// \name \ref KinBody::Link methods
@@ -240,6 +256,17 @@ OPENRAVE_C_API void ORCBodyGeometrySetDiffuseColor(void* geometry, float red, fl
 
 OPENRAVE_C_API const char* ORCRobotGetName(void* robot);
 
+/// \brief Calls \ref RobotBase::Manipulator::FindIKSolution for every end effector pose.
+///
+/// The environment lock is acquired once for the whole batch and the robot state is restored at the end.
+/// \param manipname name of the manipulator, if NULL or empty uses the active manipulator
+/// \param poses numposes*7 array of the quaternion (4) and translation (3) of the Transform6D end effector poses
+/// \param filteroptions \ref OpenRAVE::IkFilterOptions
+/// \param[out] solutions pre-allocated numposes*armdof array of the arm values, untouched for the poses without a solution
+/// \param[out] success pre-allocated array of numposes flags, 1 if a solution was found
+/// \return number of poses with a solution, or -1 if the manipulator does not exist
+OPENRAVE_C_API int ORCRobotFindIKSolutionsBatch(void* robot, const char* manipname, const OpenRAVEReal* poses, int numposes, int filteroptions, OpenRAVEReal* solutions, int* success);
+
 /// \brief Calls \ref RaveCreateModule
 ///
 /// Have to release the module pointer with \ref ORCModuleRelease
@@ -14,5 +14,5 @@ if(strcmp('error',sscanf(out,'%s',1)))
     error('Error orBodyGetLinks');
 end
 
-values = str2num(out);
+values = orReadArray(out);
 values = reshape(values,12,size(values,2)/12);
\ No newline at end of file
@@ -22,7 +22,7 @@ end
 
 out = orCommunicator(['env_triangulate ' num2str(inclusive) ' ' sprintf('%d ', ids)], 1);
 
-values = sscanf(out,'%f');
+values = orReadArray(out);
 pointsend = values(1)*3+2;
 if( values(1) > 0 )
     tripoints = reshape(values(3:pointsend),[3 values(1)]);
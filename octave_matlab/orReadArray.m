@@ -0,0 +1,12 @@
+% values = orReadArray(out)
+%
+% Returns the numeric result of a server command as a row vector. If the server
+% wrote the values to shared memory (see orSetSharedMemory), reads them from there.
+function values = orReadArray(out)
+global orSharedMemoryName
+
+if( strncmp(out,'shm ',4) )
+    values = orshmread(orSharedMemoryName, sscanf(out(5:end),'%d',1));
+else
+    values = sscanf(out,'%f')';
+end
@@ -0,0 +1,26 @@
+% success = orSetSharedMemory(enable)
+%
+% Sets whether the server passes large numeric results like the ones of orBodyGetLinks
+% and orEnvTriangulate through shared memory instead of text. Only works when
+% the server runs on the same computer and for the current connection.
+% Arguments:
+%   enable - if 1 (default), creates the shared memory of the connection, if 0 removes it
+function success = orSetSharedMemory(enable)
+global orSharedMemoryName
+
+if( ~exist('enable','var') )
+    enable = 1;
+end
+
+out = orCommunicator(['sharedmemory ' num2str(enable)], 1);
+orSharedMemoryName = [];
+success = 0;
+if( enable )
+    name = sscanf(out,'%s',1);
+    if( ~strcmp('error',name) )
+        orSharedMemoryName = name;
+        success = 1;
+    end
+else
+    success = 1;
+end
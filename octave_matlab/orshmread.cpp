@@ -0,0 +1,61 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2011 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "mex.h"
+#include <string>
+#include <cstring>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// values = orshmread(name, numvalues)
+// reads the first numvalues doubles of the textserver shared memory segment name into a row vector
+void mexFunction(int nlhs,       mxArray *plhs[],
+                 int nrhs, const mxArray *prhs[])
+{
+    if( nrhs != 2 ) {
+        mexErrMsgTxt("orshmread takes 2 arguments: (shared memory name (string), number of values (int))");
+    }
+
+    std::string name;
+    name.resize(mxGetNumberOfElements(prhs[0])+1);
+    mxGetString(prhs[0], &name[0], name.size());
+    name.resize(mxGetNumberOfElements(prhs[0]));
+    size_t numvalues = (size_t)mxGetScalar(prhs[1]);
+
+    *plhs = mxCreateDoubleMatrix(1, numvalues, mxREAL);
+    if( numvalues == 0 ) {
+        return;
+    }
+#ifndef _WIN32
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if( fd < 0 ) {
+        mexErrMsgTxt("failed to open shared memory");
+    }
+    size_t size = numvalues*sizeof(double);
+    void* pdata = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if( pdata == MAP_FAILED ) {
+        mexErrMsgTxt("failed to map shared memory");
+    }
+    memcpy(mxGetPr(*plhs), pdata, size);
+    munmap(pdata, size);
+#else
+    mexErrMsgTxt("shared memory is not supported on windows");
+#endif
+}
@@ -20,15 +20,46 @@
 
 class IdealController : public ControllerBase
 {
+    struct GrabBody
+    {
+        GrabBody() : offset(0), robotlinkindex(0) {
+        }
+        GrabBody(int offset, int robotlinkindex, KinBodyPtr pbody) : offset(offset), robotlinkindex(robotlinkindex), pbody(pbody) {
+        }
+        int offset;
+        int robotlinkindex;
+        KinBodyPtr pbody;
+        boost::shared_ptr<Transform> trelativepose; ///< relative pose of body with link when grabbed. if it doesn't exist, then do not pre-transform the pose
+    };
+
+    /// \brief a trajectory to follow. Built by SetPath and not modified afterwards except for sampling, so it is handed to the simulation thread by swapping a pointer.
+    ///
+    /// When streaming, ptraj is the caller's trajectory rather than a copy, and the caller keeps appending waypoints to it while it is executed.
+    struct TrajectoryCommand
+    {
+        TrajectoryCommand() : bTrajHasJoints(false), bTrajHasTransform(false), bStreaming(false), bStreamEnded(false) {
+        }
+        TrajectoryBaseConstPtr ptraj; ///< computed trajectory robot needs to follow in chunks of _pbody->GetDOF()
+        TrajectoryBase::SamplerPtr psampler; ///< only used by the simulation thread
+        ConfigurationSpecification samplespec;
+        bool bTrajHasJoints, bTrajHasTransform;
+        std::vector< pair<int, int> > vgrablinks; /// (data offset, link index) pairs
+        std::vector<GrabBody> vgrabbodylinks;
+        bool bStreaming; ///< if true, reaching the end of ptraj only finishes the command once bStreamEnded is set
+        bool bStreamEnded; ///< set by EndStream, protected by _mutexCommand
+    };
+    typedef boost::shared_ptr<TrajectoryCommand> TrajectoryCommandPtr;
+
 public:
-    IdealController(EnvironmentBasePtr penv, std::istream& sinput) : ControllerBase(penv), cmdid(0), _bPause(false), _bIsDone(true), _bCheckCollision(false), _bThrowExceptions(false), _bEnableLogging(false)
+    IdealController(EnvironmentBasePtr penv, std::istream& sinput) : ControllerBase(penv), _bHasPendingCommand(false), _bPendingClearDesired(false), _nNumSteps(0), _nTotalStepTime(0), _nMaxStepTime(0), _nNumCommands(0), _nNumStreamUnderruns(0), cmdid(0), _bPause(false), _bIsDone(true), _bCheckCollision(false), _bThrowExceptions(false), _bEnableLogging(false), _bStreaming(false)
     {
         __description = ":Interface Author: Rosen Diankov\n\nIdeal controller used for planning and non-physics simulations. Forces exact robot positions.\n\n\
 If \ref ControllerBase::SetPath is called and the trajectory finishes, then the controller will continue to set the trajectory's final joint values and transformation until one of three things happens:\n\n\
 1. ControllerBase::SetPath is called.\n\n\
 2. ControllerBase::SetDesired is called.\n\n\
 3. ControllerBase::Reset is called resetting everything\n\n\
-If SetDesired is called, only joint values will be set at every timestep leaving the transformation alone.\n";
+If SetDesired is called, only joint values will be set at every timestep leaving the transformation alone.\n\n\
+If streaming is enabled with SetStreaming, the trajectory given to SetPath is executed while waypoints are still being appended to it, see SetStreaming.\n";
         RegisterCommand("Pause",boost::bind(&IdealController::_Pause,this,_1,_2),
                         "pauses the controller from reacting to commands ");
         RegisterCommand("SetCheckCollisions",boost::bind(&IdealController::_SetCheckCollisions,this,_1,_2),
@@ -37,6 +68,12 @@ If SetDesired is called, only joint values will be set at every timestep leaving
                         "If set, will throw exceptions instead of print warnings. Format is:\n\n  [0/1]");
         RegisterCommand("SetEnableLogging",boost::bind(&IdealController::_SetEnableLogging,this,_1,_2),
                         "If set, will write trajectories to disk");
+        RegisterCommand("GetStepStatistics",boost::bind(&IdealController::_GetStepStatistics,this,_1,_2),
+                        "Returns the latency of the simulation steps, the number of trajectory hand-offs, and the number of steps a streamed trajectory ran out of waypoints. Format is:\n\n  numsteps meanstepus maxstepus numcommands numstreamunderruns\n\nIf 'reset' is passed, resets the statistics.");
+        RegisterCommand("SetStreaming",boost::bind(&IdealController::_SetStreamingCommand,this,_1,_2),
+                        "If set, the trajectories passed to SetPath afterwards are streamed: the controller samples the caller's trajectory instead of a copy, so waypoints appended to its end (with the environment locked) are executed without calling SetPath again. When the controller reaches the end of the trajectory, it holds the last waypoint until more waypoints are appended or EndStream is called. Format is:\n\n  [0/1]");
+        RegisterCommand("EndStream",boost::bind(&IdealController::_EndStreamCommand,this,_1,_2),
+                        "Marks the streamed trajectory as complete, the controller finishes once it reaches its end.");
         _fCommandTime = 0;
         _fSpeed = 1;
         _nControlTransformation = 0;
@@ -93,7 +130,7 @@ If SetDesired is called, only joint values will be set at every timestep leaving
 
     virtual void Reset(int options)
     {
-        _ptraj.reset();
+        _SetCommand(TrajectoryCommandPtr(), true);
         _vecdesired.resize(0);
         if( flog.is_open() ) {
             flog.close();
@@ -114,7 +151,7 @@ If SetDesired is called, only joint values will be set at every timestep leaving
             throw openrave_exception(str(boost::format("wrong desired dimensions %d!=%d")%values.size()%_dofindices.size()),ORE_InvalidArguments);
         }
         _fCommandTime = 0;
-        _ptraj.reset();
+        _SetCommand(TrajectoryCommandPtr(), false);
         // do not set done to true here! let it be picked up by the simulation thread.
         // this will also let it have consistent mechanics as SetPath
         // (there's a race condition we're avoiding where a user calls SetDesired and then state savers revert the robot)
@@ -141,47 +178,43 @@ If SetDesired is called, only joint values will be set at every timestep leaving
     virtual bool SetPath(TrajectoryBaseConstPtr ptraj)
     {
         OPENRAVE_ASSERT_FORMAT0(!ptraj || GetEnv()==ptraj->GetEnv(), "trajectory needs to come from the same environment as the controller", ORE_InvalidArguments);
-        boost::mutex::scoped_lock lock(_mutex);
         if( _bPause ) {
             RAVELOG_DEBUG("IdealController cannot start trajectories when paused\n");
-            _ptraj.reset();
+            _SetCommand(TrajectoryCommandPtr(), true);
             _bIsDone = true;
             return false;
         }
-        _fCommandTime = 0;
-        _bIsDone = true;
-        _vecdesired.resize(0);
-        _ptraj.reset();
 
+        // prepare the new command without blocking the simulation thread, it is handed off in _SetCommand
+        TrajectoryCommandPtr command;
         if( !!ptraj ) {
-            _samplespec._vgroups.resize(0);
-            _bTrajHasJoints = false;
+            command.reset(new TrajectoryCommand());
+            ConfigurationSpecification& samplespec = command->samplespec;
             if( !!_gjointvalues ) {
                 // have to reset the name since _gjointvalues can be using an old one
+                ConfigurationSpecification::Group gjointvalues = *_gjointvalues;
                 stringstream ss;
                 ss << "joint_values " << _probot->GetName();
                 FOREACHC(it, _dofindices) {
                     ss << " " << *it;
                 }
-                _gjointvalues->name = ss.str();
-                _bTrajHasJoints = ptraj->GetConfigurationSpecification().FindCompatibleGroup(_gjointvalues->name,false) != ptraj->GetConfigurationSpecification()._vgroups.end();
-                if( _bTrajHasJoints ) {
-                    _samplespec._vgroups.push_back(*_gjointvalues);
+                gjointvalues.name = ss.str();
+                command->bTrajHasJoints = ptraj->GetConfigurationSpecification().FindCompatibleGroup(gjointvalues.name,false) != ptraj->GetConfigurationSpecification()._vgroups.end();
+                if( command->bTrajHasJoints ) {
+                    samplespec._vgroups.push_back(gjointvalues);
                 }
             }
-            _bTrajHasTransform = false;
             if( !!_gtransform ) {
                 // have to reset the name since _gtransform can be using an old one
-                _gtransform->name = str(boost::format("affine_transform %s %d")%_probot->GetName()%DOF_Transform);
-                _bTrajHasTransform = ptraj->GetConfigurationSpecification().FindCompatibleGroup(_gtransform->name,false) != ptraj->GetConfigurationSpecification()._vgroups.end();
-                if( _bTrajHasTransform ) {
-                    _samplespec._vgroups.push_back(*_gtransform);
+                ConfigurationSpecification::Group gtransform = *_gtransform;
+                gtransform.name = str(boost::format("affine_transform %s %d")%_probot->GetName()%DOF_Transform);
+                command->bTrajHasTransform = ptraj->GetConfigurationSpecification().FindCompatibleGroup(gtransform.name,false) != ptraj->GetConfigurationSpecification()._vgroups.end();
+                if( command->bTrajHasTransform ) {
+                    samplespec._vgroups.push_back(gtransform);
                 }
             }
-            _samplespec.ResetGroupOffsets();
-            _vgrablinks.resize(0);
-            _vgrabbodylinks.resize(0);
-            int dof = _samplespec.GetDOF();
+            samplespec.ResetGroupOffsets();
+            int dof = samplespec.GetDOF();
             FOREACHC(itgroup,ptraj->GetConfigurationSpecification()._vgroups) {
                 if( itgroup->name.size()>=8 && itgroup->name.substr(0,8) == "grabbody") {
                     stringstream ss(itgroup->name);
@@ -190,9 +223,9 @@ If SetDesired is called, only joint values will be set at every timestep leaving
                         if( tokens.at(2) == _probot->GetName() ) {
                             KinBodyPtr pbody = GetEnv()->GetKinBody(tokens.at(1));
                             if( !!pbody ) {
-                                _samplespec._vgroups.push_back(*itgroup);
-                                _samplespec._vgroups.back().offset = dof;
-                                _vgrabbodylinks.push_back(GrabBody(dof,boost::lexical_cast<int>(tokens.at(3)), pbody));
+                                samplespec._vgroups.push_back(*itgroup);
+                                samplespec._vgroups.back().offset = dof;
+                                command->vgrabbodylinks.push_back(GrabBody(dof,boost::lexical_cast<int>(tokens.at(3)), pbody));
                                 if( tokens.size() >= 11 ) {
                                     Transform trelativepose;
                                     trelativepose.rot[0] = boost::lexical_cast<dReal>(tokens[4]);
@@ -202,10 +235,10 @@ If SetDesired is called, only joint values will be set at every timestep leaving
                                     trelativepose.trans[0] = boost::lexical_cast<dReal>(tokens[8]);
                                     trelativepose.trans[1] = boost::lexical_cast<dReal>(tokens[9]);
                                     trelativepose.trans[2] = boost::lexical_cast<dReal>(tokens[10]);
-                                    _vgrabbodylinks.back().trelativepose.reset(new Transform(trelativepose));
+                                    command->vgrabbodylinks.back().trelativepose.reset(new Transform(trelativepose));
                                 }
                             }
-                            dof += _samplespec._vgroups.back().dof;
+                            dof += samplespec._vgroups.back().dof;
                         }
                     }
                     else {
@@ -216,37 +249,49 @@ If SetDesired is called, only joint values will be set at every timestep leaving
                     stringstream ss(itgroup->name);
                     std::vector<std::string> tokens((istream_iterator<std::string>(ss)), istream_iterator<std::string>());
                     if( tokens.size() >= 2 && tokens[1] == _probot->GetName() ) {
-                        _samplespec._vgroups.push_back(*itgroup);
-                        _samplespec._vgroups.back().offset = dof;
-                        for(int idof = 0; idof < _samplespec._vgroups.back().dof; ++idof) {
-                            _vgrablinks.push_back(make_pair(dof+idof,boost::lexical_cast<int>(tokens.at(2+idof))));
+                        samplespec._vgroups.push_back(*itgroup);
+                        samplespec._vgroups.back().offset = dof;
+                        for(int idof = 0; idof < samplespec._vgroups.back().dof; ++idof) {
+                            command->vgrablinks.push_back(make_pair(dof+idof,boost::lexical_cast<int>(tokens.at(2+idof))));
                         }
-                        dof += _samplespec._vgroups.back().dof;
+                        dof += samplespec._vgroups.back().dof;
                     }
                     else {
                         RAVELOG_WARN(str(boost::format("robot %s invalid grab tokens: %s")%_probot->GetName()%ss.str()));
                     }
                 }
             }
-            BOOST_ASSERT(_samplespec.IsValid());
+            BOOST_ASSERT(samplespec.IsValid());
 
             // see if at least one point can be sampled, this make it easier to debug bad trajectories
             vector<dReal> v;
-            ptraj->Sample(v,0,_samplespec);
-            if( _bTrajHasTransform ) {
+            ptraj->Sample(v,0,samplespec);
+            if( command->bTrajHasTransform ) {
                 Transform t;
-                _samplespec.ExtractTransform(t,v.begin(),_probot);
+                samplespec.ExtractTransform(t,v.begin(),_probot);
             }
 
             if( !!flog && _bEnableLogging ) {
+                boost::mutex::scoped_lock lock(_mutex);
                 ptraj->serialize(flog);
             }
 
-            _ptraj = RaveCreateTrajectory(GetEnv(),ptraj->GetXMLId());
-            _ptraj->Clone(ptraj,0);
-            _bIsDone = false;
+            if( _bStreaming ) {
+                // waypoints appended by the caller have to be seen, so cannot copy
+                command->ptraj = ptraj;
+                command->bStreaming = true;
+            }
+            else {
+                TrajectoryBasePtr ptrajcopy = RaveCreateTrajectory(GetEnv(),ptraj->GetXMLId());
+                ptrajcopy->Clone(ptraj,0);
+                command->ptraj = ptrajcopy;
+            }
+            command->psampler = command->ptraj->CreateSampler(samplespec);
         }
 
+        _fCommandTime = 0;
+        _SetCommand(command, true);
+        _bIsDone = !command;
         return true;
     }
 
@@ -255,16 +300,49 @@ If SetDesired is called, only joint values will be set at every timestep leaving
         if( _bPause ) {
             return;
         }
-        boost::mutex::scoped_lock lock(_mutex);
-        TrajectoryBaseConstPtr ptraj = _ptraj; // because of multi-threading setting issues
-        if( !!ptraj ) {
-            vector<dReal> sampledata;
-            ptraj->Sample(sampledata,_fCommandTime,_samplespec);
+        uint64_t starttime = utils::GetMicroTime();
+        TrajectoryCommandPtr oldcommand; // released after the lock
+        {
+            boost::mutex::scoped_lock lock(_mutexCommand);
+            if( _bHasPendingCommand ) {
+                oldcommand = _activecommand;
+                _activecommand = _pendingcommand;
+                _pendingcommand.reset();
+                _bHasPendingCommand = false;
+                _fCommandTime = 0;
+                if( _bPendingClearDesired ) {
+                    _vecdesired.resize(0);
+                }
+            }
+        }
+        TrajectoryCommandPtr command = _activecommand;
+        if( !!command ) {
+            std::vector<dReal>& sampledata = _vsampledata;
+            command->psampler->Sample(sampledata,_fCommandTime);
+            const TrajectoryBaseConstPtr& ptraj = command->ptraj;
 
             // already sampled, so change the command times before before setting values
             // incase the below functions fail
             bool bIsDone = _bIsDone;
-            if( _fCommandTime > ptraj->GetDuration() ) {
+            if( command->bStreaming ) {
+                // never step past the end, the next chunk has to start playing from where the current one ends
+                dReal duration = ptraj->GetDuration();
+                if( _fCommandTime >= duration ) {
+                    _fCommandTime = duration;
+                    boost::mutex::scoped_lock lock(_mutexCommand);
+                    if( command->bStreamEnded ) {
+                        bIsDone = true;
+                    }
+                    else {
+                        // ran out of waypoints, hold the last one until the next chunk arrives
+                        _nNumStreamUnderruns++;
+                    }
+                }
+                else {
+                    _fCommandTime = min(duration, _fCommandTime + _fSpeed * fTimeElapsed);
+                }
+            }
+            else if( _fCommandTime > ptraj->GetDuration() ) {
                 _fCommandTime = ptraj->GetDuration();
                 bIsDone = true;
             }
@@ -276,7 +354,7 @@ If SetDesired is called, only joint values will be set at every timestep leaving
             list<KinBodyPtr> listrelease;
             list<pair<KinBodyPtr, KinBody::LinkPtr> > listgrab;
             list<int> listgrabindices;
-            FOREACH(itgrabinfo,_vgrablinks) {
+            FOREACHC(itgrabinfo,command->vgrablinks) {
                 int bodyid = int(std::floor(sampledata.at(itgrabinfo->first)+0.5));
                 if( bodyid != 0 ) {
                     KinBodyPtr pbody = GetEnv()->GetBodyFromEnvironmentId(abs(bodyid));
@@ -303,7 +381,7 @@ If SetDesired is called, only joint values will be set at every timestep leaving
                     }
                 }
             }
-            FOREACH(itgrabinfo,_vgrabbodylinks) {
+            FOREACHC(itgrabinfo,command->vgrabbodylinks) {
                 int dograb = int(std::floor(sampledata.at(itgrabinfo->offset)+0.5));
                 if( dograb <= 0 ) {
                     if( !!_probot->IsGrabbing(itgrabinfo->pbody) ) {
@@ -315,19 +393,20 @@ If SetDesired is called, only joint values will be set at every timestep leaving
                     if( !!pgrabbinglink ) {
                         listrelease.push_back(itgrabinfo->pbody);
                     }
-                    listgrabindices.push_back(static_cast<int>(itgrabinfo-_vgrabbodylinks.begin()));
+                    listgrabindices.push_back(static_cast<int>(itgrabinfo-command->vgrabbodylinks.begin()));
                 }
             }
 
-            vector<dReal> vdofvalues;
-            if( _bTrajHasJoints && _dofindices.size() > 0 ) {
+            std::vector<dReal>& vdofvalues = _vdofvalues;
+            vdofvalues.resize(0);
+            if( command->bTrajHasJoints && _dofindices.size() > 0 ) {
                 vdofvalues.resize(_dofindices.size());
-                _samplespec.ExtractJointValues(vdofvalues.begin(),sampledata.begin(), _probot, _dofindices, 0);
+                command->samplespec.ExtractJointValues(vdofvalues.begin(),sampledata.begin(), _probot, _dofindices, 0);
             }
 
             Transform t;
-            if( _bTrajHasTransform && _nControlTransformation ) {
-                _samplespec.ExtractTransform(t,sampledata.begin(),_probot);
+            if( command->bTrajHasTransform && _nControlTransformation ) {
+                command->samplespec.ExtractTransform(t,sampledata.begin(),_probot);
                 if( vdofvalues.size() > 0 ) {
                     _SetDOFValues(vdofvalues,t, _fCommandTime > 0 ? fTimeElapsed : 0);
                 }
@@ -344,7 +423,7 @@ If SetDesired is called, only joint values will be set at every timestep leaving
                 _probot->Release(*itbody);
             }
             FOREACH(itindex,listgrabindices) {
-                const GrabBody& grabinfo = _vgrabbodylinks.at(*itindex);
+                const GrabBody& grabinfo = command->vgrabbodylinks.at(*itindex);
                 KinBody::LinkPtr plink = _probot->GetLinks().at(grabinfo.robotlinkindex);
                 if( !!grabinfo.trelativepose ) {
                     grabinfo.pbody->SetTransform(plink->GetTransform() * *grabinfo.trelativepose);
@@ -354,11 +433,14 @@ If SetDesired is called, only joint values will be set at every timestep leaving
             FOREACH(it,listgrab) {
                 _probot->Grab(it->first,it->second);
             }
-            // set _bIsDone after all computation is done!
-            _bIsDone = bIsDone;
+            // set _bIsDone after all computation is done! A trajectory set while stepping is not done yet.
+            boost::mutex::scoped_lock lock(_mutexCommand);
+            if( !_bHasPendingCommand ) {
+                _bIsDone = bIsDone;
+            }
             if( bIsDone ) {
                 // trajectory is done, so reset it so that the controller doesn't continously set the dof values (which can get annoying)
-                _ptraj.reset();
+                _activecommand.reset();
             }
         }
 
@@ -373,6 +455,12 @@ If SetDesired is called, only joint values will be set at every timestep leaving
             // don't need to set it anymore
             _vecdesired.resize(0);
         }
+
+        uint64_t steptime = utils::GetMicroTime()-starttime;
+        boost::mutex::scoped_lock lock(_mutexCommand);
+        _nNumSteps++;
+        _nTotalStepTime += steptime;
+        _nMaxStepTime = max(_nMaxStepTime, steptime);
     }
 
     virtual bool IsDone() {
@@ -409,6 +497,51 @@ private:
         is >> _bEnableLogging;
         return !!is;
     }
+    virtual bool _GetStepStatistics(std::ostream& os, std::istream& is)
+    {
+        string cmd;
+        is >> cmd;
+        boost::mutex::scoped_lock lock(_mutexCommand);
+        os << _nNumSteps << " " << (_nNumSteps > 0 ? _nTotalStepTime/_nNumSteps : 0) << " " << _nMaxStepTime << " " << _nNumCommands << " " << _nNumStreamUnderruns;
+        if( cmd == "reset" ) {
+            _nNumSteps = 0;
+            _nTotalStepTime = 0;
+            _nMaxStepTime = 0;
+            _nNumCommands = 0;
+            _nNumStreamUnderruns = 0;
+        }
+        return true;
+    }
+    virtual bool _SetStreamingCommand(std::ostream& os, std::istream& is)
+    {
+        is >> _bStreaming;
+        return !!is;
+    }
+    virtual bool _EndStreamCommand(std::ostream& os, std::istream& is)
+    {
+        boost::mutex::scoped_lock lock(_mutexCommand);
+        // the stream can end before the simulation thread picked up the command
+        TrajectoryCommandPtr command = _bHasPendingCommand ? _pendingcommand : _activecommand;
+        if( !command || !command->bStreaming ) {
+            return false;
+        }
+        command->bStreamEnded = true;
+        return true;
+    }
+
+    /// \brief hands a new command to the simulation thread, which picks it up at the start of its next step
+    void _SetCommand(TrajectoryCommandPtr command, bool bClearDesired)
+    {
+        TrajectoryCommandPtr oldcommand; // released after the lock
+        boost::mutex::scoped_lock lock(_mutexCommand);
+        oldcommand = _pendingcommand;
+        _pendingcommand = command;
+        _bHasPendingCommand = true;
+        _bPendingClearDesired = bClearDesired;
+        if( !!command ) {
+            _nNumCommands++;
+        }
+    }
 
     inline boost::shared_ptr<IdealController> shared_controller() {
         return boost::dynamic_pointer_cast<IdealController>(shared_from_this());
@@ -429,9 +562,10 @@ private:
         }
     }
 
+    /// called with the environment locked, which also protects the buffers
     virtual void _SetDOFValues(const std::vector<dReal>&values, dReal timeelapsed)
     {
-        vector<dReal> prevvalues, curvalues, curvel;
+        std::vector<dReal>& prevvalues = _vprevvalues, &curvalues = _vcurvalues, &curvel = _vcurvel;
         _probot->GetDOFValues(prevvalues);
         curvalues = prevvalues;
         _probot->GetDOFVelocities(curvel);
@@ -450,7 +584,7 @@ private:
     virtual void _SetDOFValues(const std::vector<dReal>&values, const Transform &t, dReal timeelapsed)
     {
         BOOST_ASSERT(_nControlTransformation);
-        vector<dReal> prevvalues, curvalues, curvel;
+        std::vector<dReal>& prevvalues = _vprevvalues, &curvalues = _vcurvalues, &curvel = _vcurvel;
         _probot->GetDOFValues(prevvalues);
         curvalues = prevvalues;
         _probot->GetDOFVelocities(curvel);
@@ -478,7 +612,8 @@ private:
             }
         }
         if( timeelapsed > 0 ) {
-            vector<dReal> vdiff = curvalues;
+            std::vector<dReal>& vdiff = _vdiff;
+            vdiff = curvalues;
             _probot->SubtractDOFValues(vdiff,prevvalues);
             for(size_t i = 0; i < _vupper[1].size(); ++i) {
                 dReal maxallowed = timeelapsed * _vupper[1][i]+1e-6;
@@ -503,12 +638,13 @@ private:
 
     void _ReportError(const std::string& s)
     {
-        if( !!_ptraj ) {
+        TrajectoryCommandPtr command = _activecommand;
+        if( !!command ) {
             if( IS_DEBUGLEVEL(Level_Verbose) ) {
                 string filename = str(boost::format("%s/failedtrajectory%d.xml")%RaveGetHomeDirectory()%(RaveRandomInt()%1000));
                 ofstream f(filename.c_str());
                 f << std::setprecision(std::numeric_limits<dReal>::digits10+1);     /// have to do this or otherwise precision gets lost
-                _ptraj->serialize(f);
+                command->ptraj->serialize(f);
                 RAVELOG_VERBOSE(str(boost::format("trajectory dumped to %s")%filename));
             }
         }
@@ -522,21 +658,13 @@ private:
 
     RobotBasePtr _probot;               ///< controlled body
     dReal _fSpeed;                    ///< how fast the robot should go
-    TrajectoryBasePtr _ptraj;         ///< computed trajectory robot needs to follow in chunks of _pbody->GetDOF()
-    bool _bTrajHasJoints, _bTrajHasTransform;
-    std::vector< pair<int, int> > _vgrablinks; /// (data offset, link index) pairs
-    struct GrabBody
-    {
-        GrabBody() : offset(0), robotlinkindex(0) {
-        }
-        GrabBody(int offset, int robotlinkindex, KinBodyPtr pbody) : offset(offset), robotlinkindex(robotlinkindex), pbody(pbody) {
-        }
-        int offset;
-        int robotlinkindex;
-        KinBodyPtr pbody;
-        boost::shared_ptr<Transform> trelativepose; ///< relative pose of body with link when grabbed. if it doesn't exist, then do not pre-transform the pose
-    };
-    std::vector<GrabBody> _vgrabbodylinks;
+
+    TrajectoryCommandPtr _activecommand; ///< only used by the simulation thread, which changes it with _mutexCommand locked
+    TrajectoryCommandPtr _pendingcommand; ///< set by SetPath, picked up by the next simulation step
+    bool _bHasPendingCommand, _bPendingClearDesired;
+    boost::mutex _mutexCommand; ///< protects the pending command and the statistics, only held to swap pointers
+    uint64_t _nNumSteps, _nTotalStepTime, _nMaxStepTime, _nNumCommands, _nNumStreamUnderruns; ///< step statistics in microseconds
+    std::vector<dReal> _vsampledata, _vdofvalues, _vprevvalues, _vcurvalues, _vcurvel, _vdiff; ///< preallocated buffers
     dReal _fCommandTime;
 
     std::vector<dReal> _vecdesired;         ///< desired values of the joints
@@ -549,11 +677,11 @@ private:
     ofstream flog;
     int cmdid;
     bool _bPause, _bIsDone, _bCheckCollision, _bThrowExceptions, _bEnableLogging;
+    bool _bStreaming; ///< if true, SetPath streams the trajectory instead of copying it, see SetStreaming
     CollisionReportPtr _report;
     UserDataPtr _cblimits;
-    ConfigurationSpecification _samplespec;
     boost::shared_ptr<ConfigurationSpecification::Group> _gjointvalues, _gtransform;
-    boost::mutex _mutex;
+    boost::mutex _mutex; ///< protects the log
 };
 
 ControllerBasePtr CreateIdealController(EnvironmentBasePtr penv, std::istream& sinput)
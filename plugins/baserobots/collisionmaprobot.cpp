@@ -37,6 +37,125 @@ public:
         list<COLLISIONPAIR> listmaps;
     };
 
+    /// \brief all the collision pairs compiled into bit-packed 2D grids that are looked up in O(1)
+    ///
+    /// Every grid row is padded to whole 64-bit words and every grid starts on a cache line. The per-pair parameters are stored
+    /// as flat arrays so that the cells of all the pairs are computed in one loop over the dof values.
+    class CompiledCollisionMaps
+    {
+public:
+        CompiledCollisionMaps() : _pbits(NULL) {
+        }
+
+        void Compile(const XMLData& cmdata, const RobotBase& robot)
+        {
+            _vpairs.resize(0);
+            _vdofindices.resize(0);
+            _vmin.resize(0);
+            _videlta.resize(0);
+            _vdims.resize(0);
+            _voffsets.resize(0);
+            _vrowwords.resize(0);
+            size_t numwords = 0;
+            FOREACHC(itmap, cmdata.listmaps) {
+                boost::array<int,2> dofindices = { { -1, -1}};
+                for(size_t i = 0; i < 2; ++i) {
+                    if( itmap->jointindices[i] >= 0 ) {
+                        KinBody::JointPtr pjoint = robot.GetJoints().at(itmap->jointindices[i]);
+                        if( pjoint->GetDOF() > 0 ) {
+                            dofindices[i] = pjoint->GetDOFIndex();
+                        }
+                    }
+                }
+                if( dofindices[0] < 0 || dofindices[1] < 0 || itmap->vfreespace.shape()[0] == 0 || itmap->vfreespace.shape()[1] == 0 ) {
+                    continue;
+                }
+                _vpairs.push_back(&*itmap);
+                size_t rowwords = (itmap->vfreespace.shape()[1]+63)/64;
+                for(size_t i = 0; i < 2; ++i) {
+                    _vdofindices.push_back(dofindices[i]);
+                    if( itmap->fmin[i] < itmap->fmax[i] ) {
+                        _vmin.push_back(itmap->fmin[i]);
+                        _videlta.push_back(itmap->fidelta[i]);
+                    }
+                    else {
+                        // degenerate range always indexes the first cell
+                        _vmin.push_back(0);
+                        _videlta.push_back(0);
+                    }
+                    _vdims.push_back((int)itmap->vfreespace.shape()[i]);
+                }
+                _voffsets.push_back(numwords);
+                _vrowwords.push_back(rowwords);
+                numwords += (itmap->vfreespace.shape()[0]*rowwords + 7) & ~(size_t)7;
+            }
+
+            // over-allocate by a cache line so the grids can start on a 64-byte boundary
+            _vbits.resize(0);
+            _vbits.resize(numwords+8, 0);
+            _pbits = &_vbits[0];
+            while( ((uintptr_t)_pbits) & 63 ) {
+                ++_pbits;
+            }
+            for(size_t ipair = 0; ipair < _vpairs.size(); ++ipair) {
+                const XMLData::COLLISIONPAIR& pair = *_vpairs[ipair];
+                uint64_t* pgrid = _pbits + _voffsets[ipair];
+                for(size_t i = 0; i < pair.vfreespace.shape()[0]; ++i) {
+                    uint64_t* prow = pgrid + i*_vrowwords[ipair];
+                    for(size_t j = 0; j < pair.vfreespace.shape()[1]; ++j) {
+                        if( !pair.vfreespace[i][j] ) {
+                            prow[j>>6] |= (uint64_t)1 << (j&63);
+                        }
+                    }
+                }
+            }
+            _vcells.resize(_vdofindices.size());
+            RAVELOG_VERBOSE_FORMAT("compiled %d collision maps into %d bytes", _vpairs.size()%(numwords*sizeof(uint64_t)));
+        }
+
+        /// \brief returns the index of the first pair starting at startpair whose map marks the dof values as colliding, or -1
+        ///
+        /// Pairs whose values fall outside of their map are ignored.
+        /// \param[out] cells receives the two cell indices of the colliding pair
+        int FindCollidingPair(const std::vector<dReal>& vdofvalues, boost::array<int,2>& cells, size_t startpair=0) const
+        {
+            int numaxes = (int)_vdofindices.size();
+            for(int k = 2*(int)startpair; k < numaxes; ++k) {
+                _vcells[k] = (int)((vdofvalues[_vdofindices[k]]-_vmin[k])*_videlta[k]);
+            }
+            for(size_t ipair = startpair; ipair < _vpairs.size(); ++ipair) {
+                int i = _vcells[2*ipair], j = _vcells[2*ipair+1];
+                if( (unsigned)i >= (unsigned)_vdims[2*ipair] || (unsigned)j >= (unsigned)_vdims[2*ipair+1] ) {
+                    continue;
+                }
+                const uint64_t* prow = _pbits + _voffsets[ipair] + i*_vrowwords[ipair];
+                if( (prow[j>>6] >> (j&63)) & 1 ) {
+                    cells[0] = i;
+                    cells[1] = j;
+                    return (int)ipair;
+                }
+            }
+            return -1;
+        }
+
+        const XMLData::COLLISIONPAIR& GetPair(int ipair) const {
+            return *_vpairs.at(ipair);
+        }
+
+        size_t GetNumPairs() const {
+            return _vpairs.size();
+        }
+
+private:
+        std::vector<const XMLData::COLLISIONPAIR*> _vpairs; ///< pointers into XMLData::listmaps
+        std::vector<int> _vdofindices, _vdims; ///< 2 per pair
+        std::vector<dReal> _vmin, _videlta; ///< 2 per pair
+        std::vector<size_t> _voffsets, _vrowwords; ///< word offset of the grid and words per row, 1 per pair
+        std::vector<uint64_t> _vbits; ///< 1 bit per cell, set if the cell is in self-collision
+        uint64_t* _pbits; ///< first cache-aligned word of _vbits
+        mutable std::vector<int> _vcells;
+    };
+
     class CollisionMapXMLReader : public BaseXMLReader
     {
 public:
@@ -179,6 +298,8 @@ For joints J2xJ3, the index operation is::\n\n\
     {
         RobotBase::_ComputeInternalInformation();
         boost::shared_ptr<XMLData> cmdata = boost::dynamic_pointer_cast<XMLData>(GetReadableInterface("collisionmap"));
+        _cmdata = cmdata;
+        _compiledmaps.reset();
         if( !!cmdata ) {
             // process the collisionmap structures
             FOREACH(itmap,cmdata->listmaps) {
@@ -194,77 +315,76 @@ For joints J2xJ3, the index operation is::\n\n\
                     }
                 }
             }
+            _compiledmaps.reset(new CompiledCollisionMaps());
+            _compiledmaps->Compile(*cmdata, *this);
         }
     }
 
     virtual bool CheckSelfCollision(CollisionReportPtr report = CollisionReportPtr(), CollisionCheckerBasePtr collisionchecker=CollisionCheckerBasePtr()) const
     {
-        if( RobotBase::CheckSelfCollision(report, collisionchecker) ) {
+        // the maps are checked first since they are a lot cheaper than the geometric self-collision check
+        if( _CheckCollisionMaps(report) ) {
             return true;
         }
-        // check if the current joint angles fall within the allowable range
+        return RobotBase::CheckSelfCollision(report, collisionchecker);
+    }
+
+protected:
+    /// \brief returns true if the current joint values fall into a self-colliding region of any of the collision maps
+    bool _CheckCollisionMaps(CollisionReportPtr report) const
+    {
         boost::shared_ptr<XMLData> cmdata = boost::dynamic_pointer_cast<XMLData>(GetReadableInterface("collisionmap"));
-        if( !!cmdata ) {
-            vector<dReal> values;
-            boost::array<int,2> indices={ { 0,0}};
-            FOREACHC(itmap,cmdata->listmaps) {
-                size_t i=0;
-                const XMLData::COLLISIONPAIR& curmap = *itmap;     // for debugging
-                FOREACHC(itjindex,curmap.jointindices) {
-                    if( *itjindex < 0 ) {
-                        break;
-                    }
-                    GetJoints().at(*itjindex)->GetValues(values);
-                    if( curmap.fmin[i] < curmap.fmax[i] ) {
-                        int index = (int)((values.at(0)-curmap.fmin[i])*curmap.fidelta[i]);
-                        if( index < 0 || index >= (int)curmap.vfreespace.shape()[i] ) {
-                            break;
-                        }
-                        indices.at(i) = index;
-                    }
-                    ++i;
-                }
-                if( i != curmap.jointindices.size() ) {
-                    continue;
-                }
-                if( !curmap.vfreespace(indices) ) {
-                    // get all colliding links and check to make sure that at least two are enabled
-                    vector< std::pair<LinkConstPtr, LinkConstPtr> > vLinkColliding;
-                    FOREACHC(itjindex,curmap.jointindices) {
-                        JointPtr pjoint = GetJoints().at(*itjindex);
-                        if( !!pjoint->GetFirstAttached() && !!pjoint->GetSecondAttached() ) {
-                            std::pair<LinkConstPtr, LinkConstPtr> links(pjoint->GetFirstAttached(), pjoint->GetSecondAttached());
-                            if( links.first->IsEnabled() && links.second->IsEnabled() ) {
-                                if( links.second->GetIndex() < links.first->GetIndex() ) {
-                                    std::swap(links.first, links.second);
-                                }
-                                if( find(vLinkColliding.begin(),vLinkColliding.end(), links) == vLinkColliding.end() ) {
-                                    vLinkColliding.push_back(links);
-                                }
-                            }
+        if( !cmdata ) {
+            return false;
+        }
+        if( cmdata != _cmdata || !_compiledmaps ) {
+            RAVELOG_DEBUG("collisionmap was changed after the robot was initialized, ignoring it\n");
+            return false;
+        }
+        if( _compiledmaps->GetNumPairs() == 0 ) {
+            return false;
+        }
+        GetDOFValues(_vdofvalues);
+        boost::array<int,2> indices={ { 0,0}};
+        int ipair = _compiledmaps->FindCollidingPair(_vdofvalues, indices);
+        while( ipair >= 0 ) {
+            const XMLData::COLLISIONPAIR& curmap = _compiledmaps->GetPair(ipair);
+            // get all colliding links and check to make sure that at least two are enabled
+            vector< std::pair<LinkConstPtr, LinkConstPtr> > vLinkColliding;
+            FOREACHC(itjindex,curmap.jointindices) {
+                JointPtr pjoint = GetJoints().at(*itjindex);
+                if( !!pjoint->GetFirstAttached() && !!pjoint->GetSecondAttached() ) {
+                    std::pair<LinkConstPtr, LinkConstPtr> links(pjoint->GetFirstAttached(), pjoint->GetSecondAttached());
+                    if( links.first->IsEnabled() && links.second->IsEnabled() ) {
+                        if( links.second->GetIndex() < links.first->GetIndex() ) {
+                            std::swap(links.first, links.second);
                         }
-                    }
-                    if( vLinkColliding.size() == 0 ) {
-                        continue;
-                    }
-                    if( !!report ) {
-                        report->vLinkColliding = vLinkColliding;
-                        if( vLinkColliding.size() > 0 ) {
-                            report->plink1 = vLinkColliding.at(0).first;
-                            report->plink2 = vLinkColliding.at(0).second;
+                        if( find(vLinkColliding.begin(),vLinkColliding.end(), links) == vLinkColliding.end() ) {
+                            vLinkColliding.push_back(links);
                         }
                     }
-                    RAVELOG_VERBOSE_FORMAT("Self collision: joints %s(%d):%s(%d)", curmap.jointnames[0]%indices[0]%curmap.jointnames[1]%indices[1]);
-                    return true;
                 }
             }
+            if( vLinkColliding.size() > 0 ) {
+                if( !!report ) {
+                    report->vLinkColliding = vLinkColliding;
+                    report->plink1 = vLinkColliding.at(0).first;
+                    report->plink2 = vLinkColliding.at(0).second;
+                }
+                RAVELOG_VERBOSE_FORMAT("Self collision: joints %s(%d):%s(%d)", curmap.jointnames[0]%indices[0]%curmap.jointnames[1]%indices[1]);
+                return true;
+            }
+            // the links of this pair are disabled, look at the remaining pairs
+            ipair = _compiledmaps->FindCollidingPair(_vdofvalues, indices, ipair+1);
         }
         return false;
     }
 
-protected:
     TrajectoryBaseConstPtr _trajcur;
     ControllerBasePtr _pController;
+    boost::shared_ptr<XMLData> _cmdata; ///< the collisionmap the maps were compiled from
+    boost::shared_ptr<CompiledCollisionMaps> _compiledmaps;
+    mutable std::vector<dReal> _vdofvalues;
 };
 
 RobotBasePtr CreateCollisionMapRobot(EnvironmentBasePtr penv, std::istream& sinput)
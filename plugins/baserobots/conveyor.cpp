@@ -50,6 +50,11 @@ public:
             std::vector<dReal> vcurrentvalues(1); vcurrentvalues[0] = 0; // current values always 0
             Joint::_ComputeInternalInformation(plink0, plink1, Vector(), std::vector<Vector>(), vcurrentvalues);
         }
+
+        /// \brief the trajectory time the joint was last set to by KinBody::SetDOFValues
+        inline dReal GetLastSetTime() const {
+            return _doflastsetvalues[0];
+        }
     };
 
     class ConveyorInfo : public XMLReadable
@@ -189,7 +194,7 @@ protected:
         return BaseXMLReaderPtr(new ConveyorXMLReader(ConveyorInfoPtr(),RaveInterfaceCast<RobotBase>(ptr), atts));
     }
 
-    Conveyor(EnvironmentBasePtr penv, std::istream& is) : RobotBase(penv) {
+    Conveyor(EnvironmentBasePtr penv, std::istream& is) : RobotBase(penv), _fConveyorTableStep(0), _fConveyorDuration(0), _bUpdatingConveyor(false) {
         __description = ":Interface Author: Rosen Diankov\n\nParses conveyor joints as a trajectory and adds child links to form a full conveyor system. Use the <conveyorjoint> tag to specify the conveyor properties.";
     }
     virtual ~Conveyor() {
@@ -219,6 +224,38 @@ protected:
         }
     }
 
+    virtual void SetDOFValues(const std::vector<dReal>& values, uint32_t checklimits, const std::vector<int>& dofindices)
+    {
+        if( values.size() == 0 ) {
+            return;
+        }
+        SetDOFValues(&values[0], values.size(), checklimits, dofindices);
+    }
+
+    /// \brief if the conveyor fast path is available, only the first conveyor joint goes through the generic kinematics and the rest of the conveyor links are placed from the lookup table, see _UpdateConveyorLinks
+    virtual void SetDOFValues(const dReal* values, size_t numvalues, uint32_t checklimits, const std::vector<int>& dofindices)
+    {
+        if( _vSortedJointsFast.size() == 0 || _bUpdatingConveyor ) {
+            RobotBase::SetDOFValues(values, numvalues, checklimits, dofindices);
+            return;
+        }
+        _vTopologicallySortedJointsAll.swap(_vSortedJointsFast);
+        _vTopologicallySortedJointIndicesAll.swap(_vSortedJointIndicesFast);
+        _bUpdatingConveyor = true;
+        try {
+            RobotBase::SetDOFValues(values, numvalues, checklimits, dofindices);
+        }
+        catch(...) {
+            _bUpdatingConveyor = false;
+            _vTopologicallySortedJointsAll.swap(_vSortedJointsFast);
+            _vTopologicallySortedJointIndicesAll.swap(_vSortedJointIndicesFast);
+            throw;
+        }
+        _bUpdatingConveyor = false;
+        _vTopologicallySortedJointsAll.swap(_vSortedJointsFast);
+        _vTopologicallySortedJointIndicesAll.swap(_vSortedJointIndicesFast);
+    }
+
     virtual void _ComputeInternalInformation()
     {
         // create extra joints for each conveyor joint
@@ -244,12 +281,35 @@ protected:
                 boost::shared_ptr<ConveyorJoint> pchildjoint(new ConveyorJoint(pchildlink->GetName(), cmdata->_trajfollow, mimic, cmdata->_bIsCircular, shared_kinbody()));
                 _vecjoints.push_back(pchildjoint);
                 pchildjoint->_ComputeInternalInformation(cmdata->_linkParent, pchildlink, curtime);
+                _vconveyorjoints.push_back(pchildjoint);
+                _vconveyortimes.push_back(curtime);
+            }
+            if( cmdata->_bIsCircular && numchildlinks > 1 ) {
+                _InitConveyorTable(cmdata->_trajfollow, numchildlinks);
             }
             cmdata->_bCreated = true;
         }
 
         RobotBase::_ComputeInternalInformation();
 
+        // the fast path runs the generic kinematics on all joints except the conveyor joints after the first one
+        _vSortedJointsFast.resize(0);
+        _vSortedJointIndicesFast.resize(0);
+        if( _vconveyortable.size() > 0 ) {
+            std::set<KinBody::JointPtr> setskipjoints(_vconveyorjoints.begin()+1, _vconveyorjoints.end());
+            for(size_t ijoint = 0; ijoint < _vTopologicallySortedJointsAll.size(); ++ijoint) {
+                if( setskipjoints.find(_vTopologicallySortedJointsAll[ijoint]) == setskipjoints.end() ) {
+                    _vSortedJointsFast.push_back(_vTopologicallySortedJointsAll[ijoint]);
+                    _vSortedJointIndicesFast.push_back(_vTopologicallySortedJointIndicesAll[ijoint]);
+                }
+            }
+            if( _vSortedJointsFast.size()+setskipjoints.size() != _vTopologicallySortedJointsAll.size() ) {
+                RAVELOG_WARN_FORMAT("conveyor %s joints changed, disabling fast path", GetName());
+                _vSortedJointsFast.resize(0);
+                _vSortedJointIndicesFast.resize(0);
+            }
+        }
+
         std::vector<int> dofindices(GetDOF());
         for(int i = 0; i < GetDOF(); ++i) {
             dofindices[i] = i;
@@ -261,9 +321,74 @@ protected:
     }
 
 protected:
+    /// \brief samples the transforms of the follow trajectory uniformly in time so that the conveyor links can be placed without sampling the trajectory
+    void _InitConveyorTable(TrajectoryBasePtr trajfollow, int numchildlinks)
+    {
+        _fConveyorDuration = trajfollow->GetDuration();
+        int numsamples = numchildlinks*s_nTableSamplesPerLink;
+        _fConveyorTableStep = _fConveyorDuration/numsamples;
+        _vconveyortable.resize(numsamples+1);
+        std::vector<dReal> vsampledata;
+        for(int isample = 0; isample <= numsamples; ++isample) {
+            trajfollow->Sample(vsampledata, isample == numsamples ? _fConveyorDuration : isample*_fConveyorTableStep);
+            if( !trajfollow->GetConfigurationSpecification().ExtractTransform(_vconveyortable[isample], vsampledata.begin(), KinBodyConstPtr()) ) {
+                RAVELOG_WARN_FORMAT("conveyor %s trajectory does not have transforms, disabling fast path", GetName());
+                _vconveyortable.resize(0);
+                return;
+            }
+        }
+    }
+
+    /// \brief places all conveyor links after the first one from the time of the first conveyor joint
+    ///
+    /// Conveyor link i is offset by _vconveyortimes[i] along the trajectory, so its transform is interpolated from the neighboring table entries in one pass without evaluating mimic equations or sampling the trajectory.
+    void _UpdateConveyorLinks()
+    {
+        const ConveyorJoint& joint0 = *_vconveyorjoints.at(0);
+        const dReal ftime0 = joint0.GetLastSetTime();
+        const dReal fInvTableStep = 1/_fConveyorTableStep;
+        const int maxindex = (int)_vconveyortable.size()-2;
+        for(size_t ijoint = 1; ijoint < _vconveyorjoints.size(); ++ijoint) {
+            const ConveyorJoint& joint = *_vconveyorjoints[ijoint];
+            dReal ftime = ftime0 + _vconveyortimes[ijoint];
+            if( ftime >= _fConveyorDuration ) {
+                ftime -= _fConveyorDuration;
+            }
+            dReal fsample = ftime*fInvTableStep;
+            int index = std::max(0, std::min(maxindex, (int)fsample));
+            dReal fblend = fsample - index;
+            const Transform& t0 = _vconveyortable[index];
+            const Transform& t1 = _vconveyortable[index+1];
+            Transform tlocal;
+            tlocal.trans = t0.trans + (t1.trans-t0.trans)*fblend;
+            tlocal.rot = quatSlerp(t0.rot, t1.rot, fblend);
+            KinBody::LinkPtr plinkparent = joint.GetHierarchyParentLink();
+            Transform tparent = !plinkparent ? _veclinks.at(0)->GetTransform() : plinkparent->GetTransform();
+            joint.GetHierarchyChildLink()->SetTransform(tparent * joint.GetInternalHierarchyLeftTransform() * tlocal * joint.GetInternalHierarchyRightTransform());
+        }
+    }
+
+    virtual void _PostprocessChangedParameters(uint32_t parameters)
+    {
+        if( _bUpdatingConveyor && (parameters & Prop_LinkTransforms) ) {
+            // place the links before the change is broadcasted so that the collision checker syncs all of them at once
+            _UpdateConveyorLinks();
+        }
+        RobotBase::_PostprocessChangedParameters(parameters);
+    }
+
     TrajectoryBaseConstPtr _trajcur;
     ControllerBasePtr _pController;
 
+    std::vector< boost::shared_ptr<ConveyorJoint> > _vconveyorjoints; ///< the created conveyor joints, ordered by their time offset
+    std::vector<dReal> _vconveyortimes; ///< the time offset of each conveyor joint along the trajectory
+    std::vector<Transform> _vconveyortable; ///< trajectory transforms sampled every _fConveyorTableStep, empty if the fast path is disabled
+    dReal _fConveyorTableStep, _fConveyorDuration;
+    std::vector<KinBody::JointPtr> _vSortedJointsFast; ///< _vTopologicallySortedJointsAll without the conveyor joints placed by _UpdateConveyorLinks
+    std::vector<int> _vSortedJointIndicesFast;
+    bool _bUpdatingConveyor;
+
+    static const int s_nTableSamplesPerLink = 16; ///< number of table samples between consecutive conveyor links
     static UserDataPtr s_registeredhandle;
 };
 
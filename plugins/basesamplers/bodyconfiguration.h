@@ -78,15 +78,26 @@ By default will sample the entire body space, can use 'SetDOFs' command to set a
 
     int SampleSequence(std::vector<dReal>& samples, size_t num=1,IntervalType interval=IT_Closed)
     {
-        _psampler->SampleSequence(samples,num,interval);
-        for (size_t inum = 0; inum < num*_lower.size(); inum += _lower.size()) {
-            for (size_t i = 0; i < _lower.size(); i++) {
-                if( _viscircular[i] ) {
-                    samples[inum+i] = -PI + 2*PI*samples[inum+i];
-                }
-                else {
-                    samples[inum+i] = _lower[i] + samples[inum+i]*_range[i];
-                }
+        samples.resize(num*_lower.size());
+        if( samples.size() == 0 ) {
+            return (int)num;
+        }
+        return SampleSequence(&samples[0],num,interval);
+    }
+
+    int SampleSequence(dReal* samples, size_t num, IntervalType interval=IT_Closed)
+    {
+        int ret = _psampler->SampleSequence(samples,num,interval);
+        if( ret <= 0 ) {
+            return ret;
+        }
+        const size_t dof = _lower.size();
+        const dReal* poffset = _offset.size() > 0 ? &_offset[0] : NULL;
+        const dReal* pscale = _scale.size() > 0 ? &_scale[0] : NULL;
+        for (size_t inum = 0; inum < num*dof; inum += dof) {
+            dReal* psample = samples+inum;
+            for (size_t i = 0; i < dof; i++) {
+                psample[i] = poffset[i] + psample[i]*pscale[i];
             }
         }
         return (int)num;
@@ -120,12 +131,22 @@ protected:
             KinBody::JointPtr pjoint = _pbody->GetJointFromDOFIndex(_dofindices[i]);
             _viscircular[i] = pjoint->IsCircular(_dofindices[i]-pjoint->GetDOFIndex());
         }
+        // value = offset + sample*scale
+        _offset = _lower;
+        _scale = _range;
+        for(size_t i = 0; i < _dofindices.size(); ++i) {
+            if( _viscircular[i] ) {
+                _offset[i] = -PI;
+                _scale[i] = 2*PI;
+            }
+        }
     }
 
     SpaceSamplerBasePtr _psampler;
     KinBodyPtr _pbody;
     std::vector<int> _dofindices;
     std::vector<dReal> _lower, _upper, _range, _rangescaled;
+    std::vector<dReal> _offset, _scale; ///< maps the [0,1] samples of _psampler to the configuration space
     std::vector<dReal> _tempsamples;
     std::vector<uint8_t> _viscircular;
 };
@@ -48,6 +48,28 @@ References:\n\n\
         BOOST_ASSERT(dof > 0);
         halton_dim_num_set ( dof );
     }
+
+    /// \brief leapfrogs the remaining sequence: substream index gets the elements index, index+numsubstreams, index+2*numsubstreams, ...
+    SpaceSamplerBasePtr CreateSubstream(uint32_t index, uint32_t numsubstreams)
+    {
+        OPENRAVE_ASSERT_OP(index,<,numsubstreams);
+        boost::shared_ptr<HaltonSampler> psampler = boost::dynamic_pointer_cast<HaltonSampler>(RaveCreateSpaceSampler(GetEnv(), GetXMLId()));
+        if( !psampler ) {
+            return SpaceSamplerBasePtr();
+        }
+        int dof = halton_dim_num_get();
+        psampler->SetSpaceDOF(dof);
+        // element j of a dimension is seed + (step+j)*leap
+        vector<int> vseed(dof), vleap(dof);
+        for(int i = 0; i < dof; ++i) {
+            vseed[i] = halton_SEED[i] + (halton_STEP + (int)index)*halton_LEAP[i];
+            vleap[i] = halton_LEAP[i]*(int)numsubstreams;
+        }
+        psampler->halton_seed_set(&vseed[0]);
+        psampler->halton_leap_set(&vleap[0]);
+        psampler->halton_step_set(0);
+        return psampler;
+    }
     int GetDOF() const {
         return halton_dim_num_get();
     }
@@ -71,7 +93,15 @@ References:\n\n\
     int SampleSequence(std::vector<dReal>& samples, size_t num=1,IntervalType interval=IT_Closed)
     {
         samples.resize(halton_dim_num_get()*num);
-        halton_sequence(num,&samples[0]);
+        if( num == 0 ) {
+            return 0;
+        }
+        return SampleSequence(&samples[0],num,interval);
+    }
+
+    int SampleSequence(dReal* samples, size_t num, IntervalType interval=IT_Closed)
+    {
+        halton_sequence(num,samples);
         return (int)num;
     }
 
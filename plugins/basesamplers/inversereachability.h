@@ -0,0 +1,357 @@
+// -*- coding: utf-8 --*
+// Copyright (C) 2006-2012 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include <openrave/utils.h>
+#include <boost/bind.hpp>
+
+/** \brief samples robot base placements from which a set of grasps are reachable
+
+    Native version of the kernel density sampling of openravepy.databases.inversereachability.
+    The equivalence classes of the database are set once with LoadEquivalenceClasses, then each SetGrasps call
+    transforms the samples of the best class of every grasp into a mixture of gaussian kernels over the
+    planar base pose (angle, x, y) in the world. Each sample has 8 values: the robot pose (qw qx qy qz x y z) followed by the index of the grasp it was sampled for.
+ */
+class InverseReachabilitySampler : public SpaceSamplerBase
+{
+public:
+    InverseReachabilitySampler(EnvironmentBasePtr penv, std::istream& sinput) : SpaceSamplerBase(penv), _rotweight(0.2), _quatdelta(0), _xyzdelta(0), _fBandwidthWeight(1)
+    {
+        __description = ":Interface Author: Rosen Diankov\n\n\
+Samples robot base placements such that the given grasps are reachable by the manipulator, uses the equivalence classes of the inverse reachability database. When creating pass the following parameters::\n\n\
+  InverseReachability [robot name] [manip name] [sampler name]\n\n\
+The sampler needs to return values in the range [0,1]. Default sampler is 'mt19937'. Default manipulator is the active one.\n\
+Each sample is the robot pose 'qw qx qy qz x y z' followed by the index of the grasp it was sampled for.\n\
+";
+        RegisterCommand("LoadEquivalenceClasses",boost::bind(&InverseReachabilitySampler::LoadEquivalenceClassesCommand,this,_1,_2),
+                        "Sets the equivalence classes of the inverse reachability database::\n\n  rotweight quatdelta xyzdelta numclasses [qw qx qy qz z qstd zstd numsamples [zangle x y weight]*]*\n\n");
+        RegisterCommand("SetGrasps",boost::bind(&InverseReachabilitySampler::SetGraspsCommand,this,_1,_2),
+                        "Sets the grasps in the world coordinate system to sample base placements for, uses the current robot and manipulator base transforms::\n\n  logllthresh numgrasps [graspindex qw qx qy qz x y z]*\n\nOutputs the number of grasps whose best equivalence class is above logllthresh.");
+        RegisterCommand("SetBandwidthWeight",boost::bind(&InverseReachabilitySampler::SetBandwidthWeightCommand,this,_1,_2),
+                        "Multiplies the standard deviation of the sampling kernels by weight.");
+        RegisterCommand("EvaluateDensity",boost::bind(&InverseReachabilitySampler::EvaluateDensityCommand,this,_1,_2),
+                        "Outputs the density of each robot pose::\n\n  numposes [qw qx qy qz x y z]*\n\n");
+        string robotname, manipname, samplername;
+        sinput >> robotname >> manipname >> samplername;
+        _probot = GetEnv()->GetRobot(robotname);
+        if( !!_probot ) {
+            _pmanip = manipname.size() > 0 ? _probot->GetManipulator(manipname) : _probot->GetActiveManipulator();
+        }
+        if( samplername.size() == 0 ) {
+            samplername = "mt19937";
+        }
+        _psampler = RaveCreateSpaceSampler(penv,samplername);
+        if( !!_psampler ) {
+            _psampler->SetSpaceDOF(1);
+        }
+    }
+
+    void SetSeed(uint32_t seed) {
+        _psampler->SetSeed(seed);
+    }
+
+    void SetSpaceDOF(int dof) {
+        BOOST_ASSERT(dof==3);
+    }
+    int GetDOF() const {
+        return 3;
+    }
+    int GetNumberOfValues() const {
+        return 8;
+    }
+    bool Supports(SampleDataType type) const {
+        return !!_pmanip && !!_psampler && type==SDT_Real;
+    }
+
+    void GetLimits(std::vector<dReal>& vLowerLimit, std::vector<dReal>& vUpperLimit) const
+    {
+        vLowerLimit = _vlower;
+        vUpperLimit = _vupper;
+    }
+
+    int SampleSequence(std::vector<dReal>& samples, size_t num=1,IntervalType interval=IT_Closed)
+    {
+        samples.resize(num*8);
+        if( samples.size() == 0 ) {
+            return (int)num;
+        }
+        return SampleSequence(&samples[0],num,interval);
+    }
+
+    int SampleSequence(dReal* samples, size_t num, IntervalType interval=IT_Closed)
+    {
+        if( _vcumweights.size() == 0 ) {
+            return 0;
+        }
+        const dReal fangledev = _quatdelta*_fBandwidthWeight, fxydev = _xyzdelta*_fBandwidthWeight;
+        for(size_t inum = 0; inum < num; ++inum) {
+            // pick the kernel proportionally to its weight, then sample its gaussian
+            dReal u = _vcumweights.back()*_psampler->SampleSequenceOneReal(IT_OpenEnd);
+            size_t ikernel = std::min(_vcumweights.size()-1, (size_t)(std::upper_bound(_vcumweights.begin(), _vcumweights.end(), u) - _vcumweights.begin()));
+            dReal angle = _vkernelangle[ikernel] + fangledev*_SampleNormal();
+            dReal x = _vkernelx[ikernel] + fxydev*_SampleNormal();
+            dReal y = _vkernely[ikernel] + fxydev*_SampleNormal();
+            Transform trobot = _ComputeRobotTransform(angle, x, y);
+            dReal* psample = samples + 8*inum;
+            for(int j = 0; j < 4; ++j) {
+                psample[j] = trobot.rot[j];
+            }
+            for(int j = 0; j < 3; ++j) {
+                psample[4+j] = trobot.trans[j];
+            }
+            psample[7] = _vkernelgrasp[ikernel];
+        }
+        return (int)num;
+    }
+
+protected:
+    /// \brief an equivalence class of the inverse reachability database, see InverseReachabilityModel.generate
+    struct EquivalenceClass
+    {
+        Vector qmean; ///< mean of the end effector rotation with the z rotation removed
+        dReal zmean; ///< mean of the end effector height
+        dReal logllquatweight, logllzweight, logllconst; ///< coefficients of the log likelihood of a grasp belonging to the class
+        std::vector<dReal> vsamples; ///< base poses of the class relative to the end effector, [zangle x y weight] per sample
+    };
+
+    bool LoadEquivalenceClassesCommand(ostream& sout, istream& sinput)
+    {
+        size_t numclasses = 0;
+        sinput >> _rotweight >> _quatdelta >> _xyzdelta >> numclasses;
+        if( !sinput ) {
+            return false;
+        }
+        _vclasses.resize(numclasses);
+        for(std::vector<EquivalenceClass>::iterator itclass = _vclasses.begin(); itclass != _vclasses.end(); ++itclass) {
+            dReal qstd = 0, zstd = 0;
+            size_t numsamples = 0;
+            sinput >> itclass->qmean.x >> itclass->qmean.y >> itclass->qmean.z >> itclass->qmean.w >> itclass->zmean >> qstd >> zstd >> numsamples;
+            itclass->vsamples.resize(4*numsamples);
+            for(size_t i = 0; i < itclass->vsamples.size(); ++i) {
+                sinput >> itclass->vsamples[i];
+            }
+            if( !sinput ) {
+                _vclasses.clear();
+                return false;
+            }
+            // same as InverseReachabilityModel.preprocess
+            qstd += _quatdelta*0.1;
+            zstd += _xyzdelta*0.1;
+            itclass->logllquatweight = -0.5/(qstd*qstd);
+            itclass->logllzweight = -0.5/(zstd*zstd);
+            itclass->logllconst = RaveLog(1.0/(qstd*qstd)+0.3334) - 0.5*RaveLog(PI) - 0.5*RaveLog(zstd);
+        }
+        _ClearKernels();
+        return true;
+    }
+
+    bool SetGraspsCommand(ostream& sout, istream& sinput)
+    {
+        if( !_pmanip ) {
+            return false;
+        }
+        dReal logllthresh = 0;
+        size_t numgrasps = 0;
+        sinput >> logllthresh >> numgrasps;
+        if( !sinput ) {
+            return false;
+        }
+        _ClearKernels();
+        _tbase = _pmanip->GetBase()->GetTransform();
+        _tbaseinvrobot = _tbase.inverse()*_probot->GetTransform();
+        dReal zbaseangle = 0;
+        Vector qbasenorm = _NormalizeZRotation(_tbase.rot, zbaseangle);
+        if( RaveAcos(std::min(dReal(1), RaveFabs(qbasenorm.x))) > 0.05 ) {
+            RAVELOG_WARN("out of plane rotations for base are not supported\n");
+            return false;
+        }
+
+        // kernels are gaussians over (angle, x, y) with standard deviation (quatdelta, xyzdelta, xyzdelta), see InverseReachabilityModel.computeBaseDistribution
+        const dReal normalizationconst = 1.0/RaveSqrt(PI*PI*PI*_rotweight*_quatdelta*_xyzdelta*_xyzdelta);
+        const Vector vbasexy(_tbase.trans.x, _tbase.trans.y, 0);
+        int numaccepted = 0;
+        for(size_t igrasp = 0; igrasp < numgrasps; ++igrasp) {
+            dReal graspindex = 0;
+            Transform tgrasp;
+            sinput >> graspindex >> tgrasp.rot.x >> tgrasp.rot.y >> tgrasp.rot.z >> tgrasp.rot.w >> tgrasp.trans.x >> tgrasp.trans.y >> tgrasp.trans.z;
+            if( !sinput ) {
+                _ClearKernels();
+                return false;
+            }
+            tgrasp.rot.normalize4();
+            Transform ttarget = _tbase.inverse()*tgrasp;
+            dReal znormangle = 0;
+            Vector qnormalized = _NormalizeZRotation(ttarget.rot, znormangle);
+            int ibest = -1;
+            dReal bestlogll = 0;
+            for(size_t iclass = 0; iclass < _vclasses.size(); ++iclass) {
+                const EquivalenceClass& eclass = _vclasses[iclass];
+                dReal fquatdist = RaveAcos(std::min(dReal(1), RaveFabs(qnormalized.dot(eclass.qmean)+qnormalized.w*eclass.qmean.w)));
+                dReal fzdist = ttarget.trans.z - eclass.zmean;
+                dReal logll = fquatdist*fquatdist*eclass.logllquatweight + fzdist*fzdist*eclass.logllzweight + eclass.logllconst;
+                if( ibest < 0 || logll > bestlogll ) {
+                    ibest = iclass;
+                    bestlogll = logll;
+                }
+            }
+            if( ibest < 0 || bestlogll < logllthresh ) {
+                continue;
+            }
+            ++numaccepted;
+
+            // base poses relative to the grasp are rotated by the grasp and base z angles, then offset by the planar grasp and base positions
+            const std::vector<dReal>& vsamples = _vclasses[ibest].vsamples;
+            const dReal c = RaveCos(zbaseangle+znormangle), s = RaveSin(zbaseangle+znormangle);
+            const dReal cb = RaveCos(zbaseangle), sb = RaveSin(zbaseangle);
+            const dReal offsetx = cb*ttarget.trans.x - sb*ttarget.trans.y + vbasexy.x, offsety = sb*ttarget.trans.x + cb*ttarget.trans.y + vbasexy.y;
+            for(size_t isample = 0; isample+3 < vsamples.size(); isample += 4) {
+                _vkernelangle.push_back(_NormalizeAngle(vsamples[isample] + znormangle + zbaseangle));
+                _vkernelx.push_back(c*vsamples[isample+1] - s*vsamples[isample+2] + offsetx);
+                _vkernely.push_back(s*vsamples[isample+1] + c*vsamples[isample+2] + offsety);
+                _vkernelweight.push_back(vsamples[isample+3]*normalizationconst);
+                _vcumweights.push_back((_vcumweights.size() > 0 ? _vcumweights.back() : 0) + _vkernelweight.back());
+                _vkernelgrasp.push_back(graspindex);
+            }
+        }
+
+        if( _vkernelx.size() > 0 ) {
+            _vlower.resize(3); _vupper.resize(3);
+            _vlower[0] = -PI; _vupper[0] = PI;
+            _vlower[1] = *std::min_element(_vkernelx.begin(), _vkernelx.end()) - _xyzdelta;
+            _vupper[1] = *std::max_element(_vkernelx.begin(), _vkernelx.end()) + _xyzdelta;
+            _vlower[2] = *std::min_element(_vkernely.begin(), _vkernely.end()) - _xyzdelta;
+            _vupper[2] = *std::max_element(_vkernely.begin(), _vkernely.end()) + _xyzdelta;
+        }
+        sout << numaccepted;
+        return true;
+    }
+
+    bool SetBandwidthWeightCommand(ostream& sout, istream& sinput)
+    {
+        dReal fweight = 0;
+        sinput >> fweight;
+        if( !sinput || fweight <= 0 ) {
+            return false;
+        }
+        _fBandwidthWeight = fweight;
+        return true;
+    }
+
+    bool EvaluateDensityCommand(ostream& sout, istream& sinput)
+    {
+        size_t numposes = 0;
+        sinput >> numposes;
+        if( !sinput ) {
+            return false;
+        }
+        sout << std::setprecision(std::numeric_limits<dReal>::digits10+1);
+        const Transform trobotinvbase = _tbaseinvrobot.inverse();
+        for(size_t ipose = 0; ipose < numposes; ++ipose) {
+            Transform trobot;
+            sinput >> trobot.rot.x >> trobot.rot.y >> trobot.rot.z >> trobot.rot.w >> trobot.trans.x >> trobot.trans.y >> trobot.trans.z;
+            if( !sinput ) {
+                return false;
+            }
+            trobot.rot.normalize4();
+            Transform tbase = trobot*trobotinvbase;
+            dReal angle = 0;
+            _NormalizeZRotation(tbase.rot, angle);
+            sout << _EvaluateDensity(_NormalizeAngle(angle), tbase.trans.x, tbase.trans.y) << " ";
+        }
+        return true;
+    }
+
+    /// \brief sum of the kernels within 3 standard deviations of the base pose
+    ///
+    /// The kernels are stored as separate arrays and the loop has no branches or calls into libopenrave so that it can be vectorized.
+    dReal _EvaluateDensity(dReal angle, dReal x, dReal y) const
+    {
+        const dReal fanglebandwidth = _rotweight*_quatdelta;
+        const dReal ianglebandwidth2 = -0.5/(fanglebandwidth*fanglebandwidth), ixybandwidth2 = -0.5/(_xyzdelta*_xyzdelta);
+        const dReal rotweight2 = _rotweight*_rotweight;
+        const dReal searchradius2 = 9*(fanglebandwidth*fanglebandwidth + 2*_xyzdelta*_xyzdelta);
+        const size_t numkernels = _vkernelx.size();
+        const dReal* pangle = numkernels > 0 ? &_vkernelangle[0] : NULL;
+        const dReal* px = numkernels > 0 ? &_vkernelx[0] : NULL;
+        const dReal* py = numkernels > 0 ? &_vkernely[0] : NULL;
+        const dReal* pweight = numkernels > 0 ? &_vkernelweight[0] : NULL;
+        dReal fdensity = 0;
+        for(size_t i = 0; i < numkernels; ++i) {
+            dReal da = RaveFabs(pangle[i] - angle);
+            da = std::min(da, 2*PI - da);
+            dReal dx = px[i] - x, dy = py[i] - y;
+            dReal da2 = rotweight2*da*da, dxy2 = dx*dx + dy*dy;
+            dReal fexp = std::exp(da2*ianglebandwidth2 + dxy2*ixybandwidth2);
+            fdensity += (da2 + dxy2 <= searchradius2) ? pweight[i]*fexp : dReal(0);
+        }
+        return fdensity;
+    }
+
+    /// \brief returns the robot transform whose manipulator base is at the planar pose
+    Transform _ComputeRobotTransform(dReal angle, dReal x, dReal y) const
+    {
+        Transform tbase;
+        tbase.rot = quatFromAxisAngle(Vector(0,0,1), angle);
+        tbase.trans = Vector(x, y, _tbase.trans.z);
+        return tbase*_tbaseinvrobot;
+    }
+
+    /// \brief removes the rotation about z from the quaternion that brings it closest to the identity, see openravepy_ext.normalizeZRotation
+    static Vector _NormalizeZRotation(const Vector& q, dReal& zangle)
+    {
+        dReal halfangle = RaveAtan2(-q.w, q.x);
+        dReal c = RaveCos(halfangle), s = RaveSin(halfangle);
+        zangle = -2*halfangle;
+        return Vector(c*q.x - s*q.w, c*q.y - s*q.z, c*q.z + s*q.y, c*q.w + s*q.x);
+    }
+
+    static dReal _NormalizeAngle(dReal angle)
+    {
+        return utils::NormalizeCircularAngle(angle, -PI, PI);
+    }
+
+    /// \brief standard normal sample with the Box-Muller transform
+    dReal _SampleNormal()
+    {
+        dReal u1 = _psampler->SampleSequenceOneReal(IT_OpenStart);
+        dReal u2 = _psampler->SampleSequenceOneReal(IT_OpenEnd);
+        return RaveSqrt(-2*RaveLog(u1))*RaveCos(2*PI*u2);
+    }
+
+    void _ClearKernels()
+    {
+        _vkernelangle.resize(0);
+        _vkernelx.resize(0);
+        _vkernely.resize(0);
+        _vkernelweight.resize(0);
+        _vcumweights.resize(0);
+        _vkernelgrasp.resize(0);
+        _vlower.resize(0);
+        _vupper.resize(0);
+    }
+
+    RobotBasePtr _probot;
+    RobotBase::ManipulatorPtr _pmanip;
+    SpaceSamplerBasePtr _psampler;
+    std::vector<EquivalenceClass> _vclasses;
+    dReal _rotweight, _quatdelta, _xyzdelta; ///< parameters of the database
+    dReal _fBandwidthWeight;
+    Transform _tbase; ///< manipulator base transform when SetGrasps was called
+    Transform _tbaseinvrobot; ///< robot transform in the manipulator base frame
+    std::vector<dReal> _vkernelangle, _vkernelx, _vkernely, _vkernelweight; ///< kernel centers and weights in the world
+    std::vector<dReal> _vcumweights; ///< cumulative kernel weights
+    std::vector<dReal> _vkernelgrasp; ///< grasp index of each kernel
+    std::vector<dReal> _vlower, _vupper;
+};
@@ -53,7 +53,7 @@ using namespace std;
 class MT19937Sampler : public SpaceSamplerBase
 {
 public:
-    MT19937Sampler(EnvironmentBasePtr penv,std::istream& sinput) : SpaceSamplerBase(penv), _dof(1)
+    MT19937Sampler(EnvironmentBasePtr penv,std::istream& sinput) : SpaceSamplerBase(penv), _dof(1), _seed(5489UL)
     {
         __description = ":Interface Author: Takuji Nishimura and Makoto Matsumoto\n\n\
 Mersenne twister sampling algorithm that is based on matrix linear recurrence over finite binary field F2. It has a period of 2^19937-1 and passes many tests for statistical uniform randomness.";
@@ -61,9 +61,27 @@ Mersenne twister sampling algorithm that is based on matrix linear recurrence ov
     }
 
     void SetSeed(uint32_t seed) {
+        _seed = seed;
         init_genrand(seed);
     }
 
+    /// \brief seeds the substream with the key (seed, index) through init_by_array.
+    ///
+    /// mt19937 has no cheap jump-ahead, but different keys start at statistically independent points of its 2^19937-1 period.
+    SpaceSamplerBasePtr CreateSubstream(uint32_t index, uint32_t numsubstreams)
+    {
+        OPENRAVE_ASSERT_OP(index,<,numsubstreams);
+        boost::shared_ptr<MT19937Sampler> psampler = boost::dynamic_pointer_cast<MT19937Sampler>(RaveCreateSpaceSampler(GetEnv(), GetXMLId()));
+        if( !psampler ) {
+            return SpaceSamplerBasePtr();
+        }
+        psampler->SetSpaceDOF(_dof);
+        uint32_t key[2] = { _seed, index };
+        psampler->init_by_array(key, 2);
+        psampler->_seed = _seed;
+        return psampler;
+    }
+
     void SetSpaceDOF(int dof) {
         BOOST_ASSERT(dof > 0); _dof = dof;
     }
@@ -101,30 +119,47 @@ Mersenne twister sampling algorithm that is based on matrix linear recurrence ov
     int SampleSequence(std::vector<dReal>& samples, size_t num=1,IntervalType interval=IT_Closed)
     {
         samples.resize(_dof*num);
+        if( num == 0 ) {
+            return 0;
+        }
+        return SampleSequence(&samples[0],num,interval);
+    }
+
+    int SampleSequence(dReal* samples, size_t num, IntervalType interval=IT_Closed)
+    {
+        // sample = (genrand_int32()+offset)*scale
+        dReal offset, scale;
         switch(interval) {
         case IT_Open:
-            for(size_t i = 0; i < samples.size(); ++i) {
-                samples[i] = (((dReal)genrand_int32()) + 0.5f)*(1.0f/4294967296.0f);
-            }
+            offset = 0.5f; scale = 1.0f/4294967296.0f;
             break;
         case IT_OpenStart:
-            for(size_t i = 0; i < samples.size(); ++i) {
-                samples[i] = (((dReal)genrand_int32()) + 1.0f)*(1.0f/4294967296.0f);
-            }
+            offset = 1.0f; scale = 1.0f/4294967296.0f;
             break;
         case IT_OpenEnd:
-            for(size_t i = 0; i < samples.size(); ++i) {
-                samples[i] = (dReal)genrand_int32()*(1.0f/4294967296.0f);
-            }
+            offset = 0; scale = 1.0f/4294967296.0f;
             break;
         case IT_Closed:
-            for(size_t i = 0; i < samples.size(); ++i) {
-                samples[i] = (dReal)genrand_int32()*(1.0f/4294967295.0f);
-            }
+            offset = 0; scale = 1.0f/4294967295.0f;
             break;
         default:
             throw OPENRAVE_EXCEPTION_FORMAT0("invalid interval", ORE_InvalidArguments);
         }
+        size_t numvalues = _dof*num;
+        while(numvalues > 0) {
+            if( mti >= N ) {
+                genrand_next_state();
+            }
+            // temper the remaining state words in one pass
+            size_t numblock = min(numvalues, (size_t)(N-mti));
+            const uint32_t* pstate = &mt[mti];
+            for(size_t i = 0; i < numblock; ++i) {
+                samples[i] = ((dReal)genrand_temper(pstate[i]) + offset)*scale;
+            }
+            mti += numblock;
+            samples += numblock;
+            numvalues -= numblock;
+        }
         return (int)num;
     }
 
@@ -210,43 +245,49 @@ private:
         mt[0] = 0x80000000UL;     /* MSB is 1; assuring non-zero initial array */
     }
 
-    /* generates a random number on [0,0xffffffff]-interval */
-    uint32_t genrand_int32(void)
+    /* generates N words at one time */
+    void genrand_next_state(void)
     {
         uint32_t y;
         /* mag01[x] = x * MATRIX_A  for x=0,1 */
+        int kk;
 
-        if (mti >= N) {     /* generate N words at one time */
-            int kk;
-
-            if (mti == N+1)                                                                                                                                                                                                                                                                                           /* if init_genrand() has not been called, */
-                init_genrand(5489UL);                                                                                                                                                                                                                                                                                                                                                                                                      /* a default initial seed is used */
-
-            for (kk=0; kk<N-M; kk++) {
-                y = (mt[kk]&UPPER_MASK)|(mt[kk+1]&LOWER_MASK);
-                mt[kk] = mt[kk+M] ^ (y >> 1) ^ mag01[y & 0x1UL];
-            }
-            for (; kk<N-1; kk++) {
-                y = (mt[kk]&UPPER_MASK)|(mt[kk+1]&LOWER_MASK);
-                mt[kk] = mt[kk+(M-N)] ^ (y >> 1) ^ mag01[y & 0x1UL];
-            }
-            y = (mt[N-1]&UPPER_MASK)|(mt[0]&LOWER_MASK);
-            mt[N-1] = mt[M-1] ^ (y >> 1) ^ mag01[y & 0x1UL];
+        if (mti == N+1)     /* if init_genrand() has not been called, */
+            init_genrand(5489UL);     /* a default initial seed is used */
 
-            mti = 0;
+        for (kk=0; kk<N-M; kk++) {
+            y = (mt[kk]&UPPER_MASK)|(mt[kk+1]&LOWER_MASK);
+            mt[kk] = mt[kk+M] ^ (y >> 1) ^ mag01[y & 0x1UL];
+        }
+        for (; kk<N-1; kk++) {
+            y = (mt[kk]&UPPER_MASK)|(mt[kk+1]&LOWER_MASK);
+            mt[kk] = mt[kk+(M-N)] ^ (y >> 1) ^ mag01[y & 0x1UL];
         }
+        y = (mt[N-1]&UPPER_MASK)|(mt[0]&LOWER_MASK);
+        mt[N-1] = mt[M-1] ^ (y >> 1) ^ mag01[y & 0x1UL];
 
-        y = mt[mti++];
+        mti = 0;
+    }
 
-        /* Tempering */
+    /* Tempering */
+    static inline uint32_t genrand_temper(uint32_t y)
+    {
         y ^= (y >> 11);
         y ^= (y << 7) & 0x9d2c5680UL;
         y ^= (y << 15) & 0xefc60000UL;
         y ^= (y >> 18);
-
         return y;
     }
 
+    /* generates a random number on [0,0xffffffff]-interval */
+    uint32_t genrand_int32(void)
+    {
+        if (mti >= N) {
+            genrand_next_state();
+        }
+        return genrand_temper(mt[mti++]);
+    }
+
     /* generates a random number on [0,0x7fffffff]-interval */
     long genrand_int31(void)
     {
@@ -291,6 +332,7 @@ private:
     int mti;     /* mti==N+1 means mt[N] is not initialized */
     uint32_t mag01[2];
     int _dof;
+    uint32_t _seed; ///< last seed set, substreams are derived from it
 };
 
 #endif
@@ -76,32 +76,39 @@ If the robot active DOFs change, can use the 'TrackActiveSpace' command to autom
 
     int SampleSequence(std::vector<dReal>& samples, size_t num=1,IntervalType interval=IT_Closed)
     {
-        _psampler->SampleSequence(samples,num,interval);
-        for (size_t inum = 0; inum < num*_lower.size(); inum += _lower.size()) {
-            for (size_t i = 0; i < _lower.size(); i++) {
-                if( _viscircular[i] || (int)i == _affinerotaxis ) {
-                    samples[inum+i] = -PI + 2*PI*samples[inum+i];
-                }
-                else if( _affinerot3d >= 0 && (int)i >= _affinerot3d && (int)i < _affinerot3d+3 ) {
-                    if( (int)i == _affinerot3d ) {
-                        Vector axisangle = axisAngleFromQuat(_SampleQuaternion());
-                        samples[inum+i+0] = axisangle[0];
-                        samples[inum+i+1] = axisangle[1];
-                        samples[inum+i+2] = axisangle[2];
-                    }
-                }
-                else if( _affinequat >= 0 && (int)i >= _affinequat && (int)i < _affinequat+3 ) {
-                    if( (int)i == _affinequat ) {
-                        Vector quat = _SampleQuaternion();
-                        samples[inum+i+0] = quat[0];
-                        samples[inum+i+1] = quat[1];
-                        samples[inum+i+2] = quat[2];
-                        samples[inum+i+3] = quat[3];
-                    }
-                }
-                else {
-                    samples[inum+i] = _lower[i] + samples[inum+i]*_range[i];
-                }
+        samples.resize(num*_lower.size());
+        if( samples.size() == 0 ) {
+            return (int)num;
+        }
+        return SampleSequence(&samples[0],num,interval);
+    }
+
+    int SampleSequence(dReal* samples, size_t num, IntervalType interval=IT_Closed)
+    {
+        int ret = _psampler->SampleSequence(samples,num,interval);
+        if( ret <= 0 ) {
+            return ret;
+        }
+        const size_t dof = _lower.size();
+        const dReal* poffset = _offset.size() > 0 ? &_offset[0] : NULL;
+        const dReal* pscale = _scale.size() > 0 ? &_scale[0] : NULL;
+        for (size_t inum = 0; inum < num*dof; inum += dof) {
+            dReal* psample = samples+inum;
+            for (size_t i = 0; i < dof; i++) {
+                psample[i] = poffset[i] + psample[i]*pscale[i];
+            }
+            if( _affinerot3d >= 0 ) {
+                Vector axisangle = axisAngleFromQuat(_SampleQuaternion());
+                psample[_affinerot3d+0] = axisangle[0];
+                psample[_affinerot3d+1] = axisangle[1];
+                psample[_affinerot3d+2] = axisangle[2];
+            }
+            if( _affinequat >= 0 ) {
+                Vector quat = _SampleQuaternion();
+                psample[_affinequat+0] = quat[0];
+                psample[_affinequat+1] = quat[1];
+                psample[_affinequat+2] = quat[2];
+                psample[_affinequat+3] = quat[3];
             }
         }
         return (int)num;
@@ -175,6 +182,16 @@ protected:
             _affinequat = _probot->GetActiveDOFIndices().size()+RaveGetIndexFromAffineDOF(_probot->GetAffineDOF(),DOF_RotationQuat);
         }
 
+        // value = offset + sample*scale, rotations are sampled separately and overwritten
+        _offset = _lower;
+        _scale = _range;
+        for(size_t i = 0; i < _lower.size(); ++i) {
+            if( _viscircular[i] || (int)i == _affinerotaxis ) {
+                _offset[i] = -PI;
+                _scale[i] = 2*PI;
+            }
+        }
+
         if( _lower.size() > 0 ) {
             _psampler->SetSpaceDOF(_lower.size());
         }
@@ -184,6 +201,7 @@ protected:
     RobotBasePtr _probot;
     UserDataPtr _updatedofscallback;
     std::vector<dReal> _lower, _upper, _range, _rangescaled;
+    std::vector<dReal> _offset, _scale; ///< maps the [0,1] samples of _psampler to the configuration space
     std::vector<dReal> _tempsamples;
     std::vector<uint8_t> _viscircular;
     int _affinerotaxis, _affinerot3d, _affinequat;
@@ -17,6 +17,8 @@
 #define OPENRAVE_BASECAMERA_H
 
 #include <boost/lexical_cast.hpp>
+#include "camerarenderer.h"
+#include "sensordataring.h"
 
 class BaseCameraSensor : public SensorBase
 {
@@ -35,7 +37,7 @@ public:
                 }
                 return PE_Ignore;
             }
-            static boost::array<string, 18> tags = { { "sensor", "kk", "width", "height", "framerate", "power", "color", "focal_length","image_dimensions","intrinsic","measurement_time", "format", "distortion_model", "distortion_coeffs", "sensor_reference", "target_region", "gain", "hardware_id"}};
+            static boost::array<string, 19> tags = { { "sensor", "kk", "width", "height", "framerate", "power", "color", "focal_length","image_dimensions","intrinsic","measurement_time", "format", "distortion_model", "distortion_coeffs", "sensor_reference", "target_region", "gain", "hardware_id", "renderer"}};
             if( find(tags.begin(),tags.end(),name) == tags.end() ) {
                 return PE_Pass;
             }
@@ -139,6 +141,9 @@ public:
             else if( name == "hardware_id" ) {
                 ss >> _psensor->_pgeom->hardware_id;
             }
+            else if( name == "renderer" ) {
+                ss >> _psensor->_renderer;
+            }
             else {
                 RAVELOG_WARN(str(boost::format("bad tag: %s")%name));
             }
@@ -180,14 +185,16 @@ public:
                         "Set the dimensions of the image (width,height)");
         RegisterCommand("SaveImage",boost::bind(&BaseCameraSensor::_SaveImage,this,_1,_2),
                         "Saves the next camera image to the given filename");
+        RegisterCommand("SetRenderer",boost::bind(&BaseCameraSensor::_SetRendererCommand,this,_1,_2),
+                        "Set how the images are rendered: 'viewer' uses the environment viewer, 'offscreen' rasterizes the scene on worker threads and also outputs depth, 'auto' (default) uses the viewer if there is one and offscreen otherwise.");
         _pgeom.reset(new CameraGeomData());
-        _pdata.reset(new CameraSensorData());
         _bPower = false;
         _vColor = RaveVector<float>(0.5f,0.5f,1,1);
         framerate = 5;
         //_numchannels = 3;
         _bRenderGeometry = true;
         _bRenderData = false;
+        _renderer = "auto";
         _Reset();
     }
 
@@ -247,10 +254,11 @@ public:
 
     virtual void _Reset()
     {
-        _pdata->vimagedata.resize(0);
-        _pdata->__stamp = 0;
+        _dataring.Reset();
         _vimagedata.resize(3*_pgeom->width*_pgeom->height);
         _fTimeToImage = 0;
+        // images still in flight go to the old target and are discarded
+        _pRenderTarget.reset(new CameraRenderTarget());
         _graphgeometry.reset();
         _dataviewer.reset();
     }
@@ -264,24 +272,32 @@ public:
 
     virtual bool SimulationStep(dReal fTimeElapsed)
     {
-        boost::shared_ptr<CameraSensorData> pdata = _pdata;
-
         _RenderGeometry();
         if(( _pgeom->width > 0) &&( _pgeom->height > 0) && _bPower) {
             _fTimeToImage -= fTimeElapsed;
             if( _fTimeToImage <= 0 ) {
                 _fTimeToImage = 1 / (float)framerate;
-                GetEnv()->UpdatePublishedBodies();
-                if( !!GetEnv()->GetViewer() ) {
-                    if( GetEnv()->GetViewer()->GetCameraImage(_vimagedata, _pgeom->width, _pgeom->height, _trans, _pgeom->KK) ) {
-                        // copy the data
-                        boost::mutex::scoped_lock lock(_mutexdata);
-                        pdata->vimagedata = _vimagedata;
-                        pdata->__stamp = GetEnv()->GetSimulationTime();
-                        pdata->__trans = _trans;
+                if( _UseOffscreenRenderer() ) {
+                    _RequestOffscreenImage();
+                }
+                else {
+                    GetEnv()->UpdatePublishedBodies();
+                    if( !!GetEnv()->GetViewer() ) {
+                        if( GetEnv()->GetViewer()->GetCameraImage(_vimagedata, _pgeom->width, _pgeom->height, _trans, _pgeom->KK) ) {
+                            // hand the image buffer to a free frame and take back its old buffer for the next image
+                            boost::mutex::scoped_lock lock(_mutexpublish);
+                            boost::shared_ptr<CameraSensorData> pdata = _dataring.AcquireFrame();
+                            pdata->vimagedata.swap(_vimagedata);
+                            pdata->vdepthdata.resize(0);
+                            pdata->__stamp = GetEnv()->GetSimulationTime();
+                            pdata->__trans = _trans;
+                            _dataring.Publish(pdata);
+                            _vimagedata.resize(3*_pgeom->width*_pgeom->height);
+                        }
                     }
                 }
             }
+            _PublishOffscreenImage();
         }
         return true;
     }
@@ -307,15 +323,28 @@ public:
     virtual bool GetSensorData(SensorDataPtr psensordata)
     {
         if( _bPower &&( psensordata->GetType() == ST_Camera) ) {
-            boost::mutex::scoped_lock lock(_mutexdata);
-            if( _pdata->vimagedata.size() > 0 ) {
-                *boost::dynamic_pointer_cast<CameraSensorData>(psensordata) = *_pdata;
+            _PublishOffscreenImage();
+            boost::shared_ptr<CameraSensorData const> pdata = _dataring.GetLatest();
+            if( !!pdata && pdata->vimagedata.size() > 0 ) {
+                *boost::dynamic_pointer_cast<CameraSensorData>(psensordata) = *pdata;
                 return true;
             }
         }
         return false;
     }
 
+    virtual SensorDataConstPtr GetLatestSensorData(SensorType type)
+    {
+        if( _bPower &&(( type == ST_Invalid) ||( type == ST_Camera)) ) {
+            _PublishOffscreenImage();
+            boost::shared_ptr<CameraSensorData const> pdata = _dataring.GetLatest();
+            if( !!pdata && pdata->vimagedata.size() > 0 ) {
+                return pdata;
+            }
+        }
+        return SensorDataConstPtr();
+    }
+
     virtual bool Supports(SensorType type) {
         return type == ST_Camera;
     }
@@ -326,8 +355,7 @@ public:
         sinput >> _bPower;
         if( !_bPower ) {
             // should reset!
-            _pdata->vimagedata.resize(0);
-            _pdata->__stamp = 0;
+            _dataring.Reset();
         }
         return !!sinput;
     }
@@ -356,6 +384,16 @@ public:
         RAVELOG_WARN("SaveImage not implemented yet\n");
         return false;
     }
+    bool _SetRendererCommand(ostream& sout, istream& sinput)
+    {
+        string renderer;
+        sinput >> renderer;
+        if( !sinput || (renderer != "auto" && renderer != "viewer" && renderer != "offscreen") ) {
+            return false;
+        }
+        _renderer = renderer;
+        return true;
+    }
 
     virtual void SetTransform(const Transform& trans)
     {
@@ -378,6 +416,7 @@ public:
         _bRenderGeometry = r->_bRenderGeometry;
         _bRenderData = r->_bRenderData;
         _bPower = r->_bPower;
+        _renderer = r->_renderer;
         _Reset();
     }
 
@@ -389,9 +428,67 @@ public:
         ss << _vColor.x << " " << _vColor.y << " " << _vColor.z;
         writer->AddChild("color",atts)->SetCharData(ss.str());
         writer->AddChild("format",atts)->SetCharData(_channelformat.size() > 0 ? _channelformat : std::string("uint8"));
+        if( _renderer != "auto" ) {
+            writer->AddChild("renderer",atts)->SetCharData(_renderer);
+        }
     }
 
 protected:
+    bool _UseOffscreenRenderer()
+    {
+        if( _renderer == "offscreen" ) {
+            return true;
+        }
+        return _renderer == "auto" && !GetEnv()->GetViewer();
+    }
+
+    /// \brief queues an image of the current scene to the render workers, the simulation does not wait for it
+    void _RequestOffscreenImage()
+    {
+        CameraRenderTargetPtr ptarget = _pRenderTarget;
+        CameraRenderFramePtr pframe = ptarget->StartFrame();
+        if( !pframe ) {
+            RAVELOG_VERBOSE_FORMAT("env=%d, camera %s dropped an image since the previous one is still being rendered", GetEnv()->GetId()%GetName());
+            return;
+        }
+        if( !_pRenderWorkers ) {
+            _pRenderWorkers = CameraRenderWorkers::GetSharedWorkers();
+        }
+        pframe->trans = _trans;
+        pframe->stamp = GetEnv()->GetSimulationTime();
+        CameraRenderWorkers::RenderJob job;
+        job.pscene = _pRenderWorkers->GetScene(GetEnv());
+        job.ptarget = ptarget;
+        job.pframe = pframe;
+        job.KK = _pgeom->KK;
+        job.width = _pgeom->width;
+        job.height = _pgeom->height;
+        _pRenderWorkers->Push(job);
+    }
+
+    /// \brief publishes the last image the render workers completed, the buffers of the previously published image go back to the pool
+    void _PublishOffscreenImage()
+    {
+        CameraRenderTargetPtr ptarget = _pRenderTarget;
+        if( !ptarget ) {
+            return;
+        }
+        CameraRenderFramePtr pframe = ptarget->PopCompletedFrame();
+        if( !pframe ) {
+            return;
+        }
+        boost::mutex::scoped_lock lock(_mutexpublish); // GetSensorData can publish from other threads
+        if( (int)pframe->vimagedata.size() == 3*_pgeom->width*_pgeom->height ) {
+            boost::shared_ptr<CameraSensorData> pdata = _dataring.AcquireFrame();
+            pdata->vimagedata.swap(pframe->vimagedata);
+            pdata->vdepthdata.swap(pframe->vdepthdata);
+            pdata->__stamp = pframe->stamp;
+            pdata->__trans = pframe->trans;
+            _dataring.Publish(pdata);
+        }
+        ptarget->ReleaseFrame(pframe);
+    }
+
     void _RenderGeometry()
     {
         if( !_bRenderGeometry ) {
@@ -436,7 +533,7 @@ protected:
     }
 
     boost::shared_ptr<CameraGeomData> _pgeom;
-    boost::shared_ptr<CameraSensorData> _pdata;
+    SensorDataRing<CameraSensorData> _dataring; ///< published images, consumers hold on to frames without copying them
 
     // more geom stuff
     vector<uint8_t> _vimagedata;
@@ -449,8 +546,12 @@ protected:
     GraphHandlePtr _graphgeometry;
     ViewerBasePtr _dataviewer;
     string _channelformat;
+    string _renderer; ///< auto, viewer, or offscreen, see SetRenderer command
+    CameraRenderWorkersPtr _pRenderWorkers;
+    CameraRenderTargetPtr _pRenderTarget;
 
     mutable boost::mutex _mutexdata;
+    boost::mutex _mutexpublish; ///< serializes the producers of _dataring
 
     bool _bRenderGeometry, _bRenderData;
     bool _bPower;     ///< if true, gather data, otherwise don't
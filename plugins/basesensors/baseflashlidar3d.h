@@ -220,6 +220,9 @@ public:
                 r.pos = t.trans;
                 _pdata->positions.at(0) = t.trans;
 
+                // index = w*height+h
+                _vrays.resize(_pgeom->width*_pgeom->height);
+                _vraydirs.resize(_vrays.size());
                 for(int w = 0; w < _pgeom->width; ++w) {
                     for(int h = 0; h < _pgeom->height; ++h) {
                         Vector vdir;
@@ -230,22 +233,27 @@ public:
                         r.dir = _pgeom->max_range*vdir;
 
                         int index = w*_pgeom->height+h;
+                        _vrays[index] = r;
+                        _vraydirs[index] = vdir;
+                    }
+                }
 
-                        if( GetEnv()->CheckCollision(r, _report)) {
-                            _pdata->ranges[index] = vdir*_report->minDistance;
-                            _pdata->intensity[index] = 1;
-                            // store the colliding bodies
-                            KinBody::LinkConstPtr plink = !!_report->plink1 ? _report->plink1 : _report->plink2;
-                            if( !!plink ) {
-                                _databodyids[index] = plink->GetParent()->GetEnvironmentId();
-                            }
-                        }
-                        else {
-                            _databodyids[index] = 0;
-                            _pdata->ranges[index] = vdir*_pgeom->max_range;
-                            _pdata->intensity[index] = 0;
+                GetEnv()->GetCollisionChecker()->CheckCollisionRays(_vrays, _vraydistances, _vrayhitlinks);
+                for(size_t index = 0; index < _vrays.size(); ++index) {
+                    const Vector& vdir = _vraydirs[index];
+                    if( _vraydistances[index] >= 0 ) {
+                        _pdata->ranges[index] = vdir*_vraydistances[index];
+                        _pdata->intensity[index] = 1;
+                        // store the colliding bodies
+                        if( !!_vrayhitlinks[index] ) {
+                            _databodyids[index] = _vrayhitlinks[index]->GetParent()->GetEnvironmentId();
                         }
                     }
+                    else {
+                        _databodyids[index] = 0;
+                        _pdata->ranges[index] = vdir*_pgeom->max_range;
+                        _pdata->intensity[index] = 0;
+                    }
                 }
 
                 _report->Reset();
@@ -426,6 +434,10 @@ protected:
     boost::shared_ptr<LaserSensorData> _pdata;
     vector<int> _databodyids;     ///< if non 0, for each point in _data, specifies the body that was hit
     CollisionReportPtr _report;
+    std::vector<RAY> _vrays; ///< the rays of the current scan, passed to CollisionCheckerBase::CheckCollisionRays
+    std::vector<Vector> _vraydirs; ///< the unit direction of each ray
+    std::vector<dReal> _vraydistances;
+    std::vector<KinBody::LinkConstPtr> _vrayhitlinks;
     // more geom stuff
     RaveVector<float> _vColor;
     dReal _iKK[4];     // inverse of KK
@@ -210,22 +210,28 @@ public:
                 _pdata->__stamp = GetEnv()->GetSimulationTime();
                 t = GetLaserPlaneTransform();
                 _pdata->positions.at(0) = t.trans;
-                size_t index = 0;
-                for(dReal frotangle = _pgeom->min_angle[0]; frotangle <= _pgeom->max_angle[0]; frotangle += _pgeom->resolution[0], ++index) {
-                    if( index >= _pdata->ranges.size() ) {
+                _vrays.resize(0);
+                _vraydirs.resize(0);
+                for(dReal frotangle = _pgeom->min_angle[0]; frotangle <= _pgeom->max_angle[0]; frotangle += _pgeom->resolution[0]) {
+                    if( _vrays.size() >= _pdata->ranges.size() ) {
                         break;
                     }
                     Vector vdir(t.rotate(quatRotate(quatFromAxisAngle(rotaxis, (dReal)frotangle),Vector(1,0,0))));
                     r.pos = t.trans+_pgeom->min_range*vdir;
                     r.dir = (_pgeom->max_range-_pgeom->min_range)*vdir;
+                    _vrays.push_back(r);
+                    _vraydirs.push_back(vdir);
+                }
 
-                    if( GetEnv()->CheckCollision(r, _report)) {
-                        _pdata->ranges[index] = vdir*(_report->minDistance+_pgeom->min_range);
+                GetEnv()->GetCollisionChecker()->CheckCollisionRays(_vrays, _vraydistances, _vrayhitlinks);
+                for(size_t index = 0; index < _vrays.size(); ++index) {
+                    const Vector& vdir = _vraydirs[index];
+                    if( _vraydistances[index] >= 0 ) {
+                        _pdata->ranges[index] = vdir*(_vraydistances[index]+_pgeom->min_range);
                         _pdata->intensity[index] = 1;
                         // store the colliding bodies
-                        KinBody::LinkConstPtr plink = !!_report->plink1 ? _report->plink1 : _report->plink2;
-                        if( !!plink ) {
-                            _databodyids[index] = plink->GetParent()->GetEnvironmentId();
+                        if( !!_vrayhitlinks[index] ) {
+                            _databodyids[index] = _vrayhitlinks[index]->GetParent()->GetEnvironmentId();
                         }
                     }
                     else {
@@ -433,6 +439,10 @@ protected:
     boost::shared_ptr<LaserSensorData> _pdata;
     vector<int> _databodyids;     ///< if non 0, for each point in _data, specifies the body that was hit
     CollisionReportPtr _report;
+    std::vector<RAY> _vrays; ///< the beams of the current scan, passed to CollisionCheckerBase::CheckCollisionRays
+    std::vector<Vector> _vraydirs; ///< the unit direction of each beam
+    std::vector<dReal> _vraydistances;
+    std::vector<KinBody::LinkConstPtr> _vrayhitlinks;
 
     // more geom stuff
     RaveVector<float> _vColor;
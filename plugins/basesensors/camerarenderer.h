@@ -0,0 +1,416 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2011 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef OPENRAVE_CAMERARENDERER_H
+#define OPENRAVE_CAMERARENDERER_H
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/condition.hpp>
+
+/// \brief triangles of the visible geometry of the environment in world coordinates
+///
+/// One scene is shared by all the cameras that render the same environment state.
+class CameraRenderScene
+{
+public:
+    CameraRenderScene() : simtime(0), bodystamp(0), numbodies(0) {
+    }
+
+    /// \brief copies the visible geometry of all the bodies, the environment has to be locked
+    void Init(const std::vector<KinBodyPtr>& vbodies)
+    {
+        vvertices.resize(0);
+        vcolors.resize(0);
+        FOREACHC(itbody, vbodies) {
+            if( !(*itbody)->IsVisible() ) {
+                continue;
+            }
+            FOREACHC(itlink, (*itbody)->GetLinks()) {
+                if( !(*itlink)->IsVisible() ) {
+                    continue;
+                }
+                Transform tlink = (*itlink)->GetTransform();
+                FOREACHC(itgeom, (*itlink)->GetGeometries()) {
+                    const KinBody::Link::Geometry& geom = **itgeom;
+                    if( !geom.IsVisible() || geom.GetTransparency() >= 1 ) {
+                        continue;
+                    }
+                    const TriMesh& mesh = geom.GetCollisionMesh();
+                    TransformMatrix t(tlink*geom.GetTransform());
+                    const RaveVector<float>& color = geom.GetDiffuseColor();
+                    uint8_t r = (uint8_t)(255*max(0.0f,min(1.0f,color.x))), g = (uint8_t)(255*max(0.0f,min(1.0f,color.y))), b = (uint8_t)(255*max(0.0f,min(1.0f,color.z)));
+                    size_t ntriangles = mesh.indices.size()/3;
+                    size_t offset = vvertices.size();
+                    vvertices.resize(offset+9*ntriangles);
+                    vcolors.reserve(vcolors.size()+3*ntriangles);
+                    for(size_t i = 0; i < mesh.indices.size(); ++i) {
+                        Vector v = t*mesh.vertices.at(mesh.indices[i]);
+                        vvertices[offset+3*i+0] = v.x;
+                        vvertices[offset+3*i+1] = v.y;
+                        vvertices[offset+3*i+2] = v.z;
+                    }
+                    for(size_t i = 0; i < ntriangles; ++i) {
+                        vcolors.push_back(r);
+                        vcolors.push_back(g);
+                        vcolors.push_back(b);
+                    }
+                }
+            }
+        }
+    }
+
+    std::vector<float> vvertices; ///< 9 values per triangle
+    std::vector<uint8_t> vcolors; ///< rgb per triangle
+    uint64_t simtime; ///< simulation time the scene was taken
+    int bodystamp; ///< sum of the body update stamps when the scene was taken
+    size_t numbodies;
+};
+
+typedef boost::shared_ptr<CameraRenderScene> CameraRenderScenePtr;
+typedef boost::shared_ptr<CameraRenderScene const> CameraRenderSceneConstPtr;
+
+/// \brief buffers of one rendered camera image, reused between frames
+class CameraRenderFrame
+{
+public:
+    CameraRenderFrame() : stamp(0) {
+    }
+    std::vector<uint8_t> vimagedata;
+    std::vector<float> vdepthdata;
+    std::vector<float> vinvdepth; ///< z-buffer holding 1/depth, which is linear in image space
+    Transform trans;
+    uint64_t stamp;
+};
+
+typedef boost::shared_ptr<CameraRenderFrame> CameraRenderFramePtr;
+
+/// \brief the pool of frames of one camera and the last image the workers completed for it
+///
+/// The camera only ever has one image in flight. If the workers are still busy when the next image is due, that image is dropped instead of queueing up.
+class CameraRenderTarget
+{
+public:
+    CameraRenderTarget() : _bPending(false) {
+    }
+
+    /// \brief returns a frame for the next request and marks the target as pending, returns an empty pointer if an image is already in flight
+    CameraRenderFramePtr StartFrame()
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        if( _bPending ) {
+            return CameraRenderFramePtr();
+        }
+        _bPending = true;
+        if( _vfreeframes.size() == 0 ) {
+            return CameraRenderFramePtr(new CameraRenderFrame());
+        }
+        CameraRenderFramePtr pframe = _vfreeframes.back();
+        _vfreeframes.pop_back();
+        return pframe;
+    }
+
+    /// \brief called from the workers when the image of the frame is ready
+    void FinishFrame(CameraRenderFramePtr pframe)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        if( !!_pcompleted ) {
+            _vfreeframes.push_back(_pcompleted);
+        }
+        _pcompleted = pframe;
+        _bPending = false;
+    }
+
+    /// \brief called from the workers when the frame could not be rendered
+    void CancelFrame(CameraRenderFramePtr pframe)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _vfreeframes.push_back(pframe);
+        _bPending = false;
+    }
+
+    /// \brief returns the last completed frame if it has not been taken yet
+    CameraRenderFramePtr PopCompletedFrame()
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        CameraRenderFramePtr pframe = _pcompleted;
+        _pcompleted.reset();
+        return pframe;
+    }
+
+    /// \brief gives the frame back to the pool so its buffers are reused
+    void ReleaseFrame(CameraRenderFramePtr pframe)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _vfreeframes.push_back(pframe);
+    }
+
+protected:
+    boost::mutex _mutex;
+    std::vector<CameraRenderFramePtr> _vfreeframes;
+    CameraRenderFramePtr _pcompleted;
+    bool _bPending;
+};
+
+typedef boost::shared_ptr<CameraRenderTarget> CameraRenderTargetPtr;
+
+/// \brief renders camera images offscreen on worker threads shared by all the cameras of the process
+///
+/// Rendering is a software z-buffer rasterization of the collision meshes colored with their diffuse color, so it does not need a viewer or a display.
+class CameraRenderWorkers
+{
+public:
+    struct RenderJob
+    {
+        CameraRenderSceneConstPtr pscene;
+        CameraRenderTargetPtr ptarget;
+        CameraRenderFramePtr pframe;
+        SensorBase::CameraIntrinsics KK;
+        int width, height;
+    };
+
+    CameraRenderWorkers(int nthreads) : _bStop(false)
+    {
+        for(int i = 0; i < nthreads; ++i) {
+            _vthreads.push_back(boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&CameraRenderWorkers::_WorkerThread, this))));
+        }
+    }
+
+    virtual ~CameraRenderWorkers()
+    {
+        {
+            boost::mutex::scoped_lock lock(_mutex);
+            _bStop = true;
+            _condition.notify_all();
+        }
+        FOREACH(itthread, _vthreads) {
+            (*itthread)->join();
+        }
+    }
+
+    /// \brief returns the workers shared by all the cameras, they are destroyed along with the last camera using them
+    static boost::shared_ptr<CameraRenderWorkers> GetSharedWorkers()
+    {
+        static boost::mutex s_mutex;
+        static boost::weak_ptr<CameraRenderWorkers> s_pworkers;
+        boost::mutex::scoped_lock lock(s_mutex);
+        boost::shared_ptr<CameraRenderWorkers> pworkers = s_pworkers.lock();
+        if( !pworkers ) {
+            pworkers.reset(new CameraRenderWorkers(max(1, (int)boost::thread::hardware_concurrency())));
+            s_pworkers = pworkers;
+        }
+        return pworkers;
+    }
+
+    /// \brief returns the scene of the current environment state, cameras stepping at the same time share the same scene
+    ///
+    /// The environment has to be locked.
+    CameraRenderSceneConstPtr GetScene(EnvironmentBasePtr penv)
+    {
+        std::vector<KinBodyPtr> vbodies;
+        penv->GetBodies(vbodies);
+        uint64_t simtime = penv->GetSimulationTime();
+        int bodystamp = 0;
+        FOREACHC(itbody, vbodies) {
+            bodystamp += (*itbody)->GetUpdateStamp();
+        }
+        boost::mutex::scoped_lock lock(_mutex);
+        boost::weak_ptr<CameraRenderScene const>& pweakscene = _mapScenes[penv->GetId()];
+        CameraRenderSceneConstPtr pscene = pweakscene.lock();
+        if( !!pscene && pscene->simtime == simtime && pscene->bodystamp == bodystamp && pscene->numbodies == vbodies.size() ) {
+            return pscene;
+        }
+        CameraRenderScenePtr pnewscene(new CameraRenderScene());
+        pnewscene->Init(vbodies);
+        pnewscene->simtime = simtime;
+        pnewscene->bodystamp = bodystamp;
+        pnewscene->numbodies = vbodies.size();
+        pweakscene = pnewscene;
+        return pnewscene;
+    }
+
+    /// \brief queues the job, its frame is published to its target once it is rendered
+    void Push(const RenderJob& job)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _listjobs.push_back(job);
+        _condition.notify_one();
+    }
+
+    inline int GetNumThreads() const {
+        return (int)_vthreads.size();
+    }
+
+protected:
+    void _WorkerThread()
+    {
+        while(1) {
+            RenderJob job;
+            {
+                boost::mutex::scoped_lock lock(_mutex);
+                while(!_bStop && _listjobs.size() == 0) {
+                    _condition.wait(lock);
+                }
+                if( _bStop ) {
+                    break;
+                }
+                job = _listjobs.front();
+                _listjobs.pop_front();
+            }
+            try {
+                _Render(job);
+                job.ptarget->FinishFrame(job.pframe);
+            }
+            catch(const std::exception& ex) {
+                RAVELOG_WARN_FORMAT("failed to render camera image: %s", ex.what());
+                job.ptarget->CancelFrame(job.pframe);
+            }
+        }
+    }
+
+    /// \brief rasterizes the scene into the image and depth buffers of the frame
+    static void _Render(RenderJob& job)
+    {
+        CameraRenderFrame& frame = *job.pframe;
+        const int width = job.width, height = job.height;
+        frame.vimagedata.resize(3*width*height);
+        std::fill(frame.vimagedata.begin(), frame.vimagedata.end(), 0);
+        frame.vinvdepth.resize(width*height);
+        std::fill(frame.vinvdepth.begin(), frame.vinvdepth.end(), 0);
+
+        TransformMatrix tinv(frame.trans.inverse());
+        float m[12];
+        for(int i = 0; i < 3; ++i) {
+            m[4*i+0] = tinv.m[4*i+0];
+            m[4*i+1] = tinv.m[4*i+1];
+            m[4*i+2] = tinv.m[4*i+2];
+            m[4*i+3] = tinv.trans[i];
+        }
+        const float fx = job.KK.fx, fy = job.KK.fy, cx = job.KK.cx, cy = job.KK.cy;
+        const float znear = 0.001f;
+        const std::vector<float>& vvertices = job.pscene->vvertices;
+        const size_t ntriangles = vvertices.size()/9;
+        float p[3][3], clipped[4][3], projected[4][3];
+        for(size_t itri = 0; itri < ntriangles; ++itri) {
+            const float* pv = &vvertices[9*itri];
+            bool bbehind = true;
+            for(int j = 0; j < 3; ++j) {
+                for(int k = 0; k < 3; ++k) {
+                    p[j][k] = m[4*k+0]*pv[3*j+0] + m[4*k+1]*pv[3*j+1] + m[4*k+2]*pv[3*j+2] + m[4*k+3];
+                }
+                if( p[j][2] >= znear ) {
+                    bbehind = false;
+                }
+            }
+            if( bbehind ) {
+                continue;
+            }
+
+            // flat shading by the angle between the view ray and the triangle normal
+            float e1[3] = { p[1][0]-p[0][0], p[1][1]-p[0][1], p[1][2]-p[0][2]};
+            float e2[3] = { p[2][0]-p[0][0], p[2][1]-p[0][1], p[2][2]-p[0][2]};
+            float n[3] = { e1[1]*e2[2]-e1[2]*e2[1], e1[2]*e2[0]-e1[0]*e2[2], e1[0]*e2[1]-e1[1]*e2[0]};
+            float fnormal2 = n[0]*n[0]+n[1]*n[1]+n[2]*n[2], fview2 = p[0][0]*p[0][0]+p[0][1]*p[0][1]+p[0][2]*p[0][2];
+            if( fnormal2 <= 0 ) {
+                continue;
+            }
+            float fshade = fview2 > 0 ? fabsf(n[0]*p[0][0]+n[1]*p[0][1]+n[2]*p[0][2])/sqrtf(fnormal2*fview2) : 1.0f;
+            fshade = 0.3f + 0.7f*fshade;
+            const uint8_t* pcolor = &job.pscene->vcolors[3*itri];
+            uint8_t color[3] = { (uint8_t)(pcolor[0]*fshade), (uint8_t)(pcolor[1]*fshade), (uint8_t)(pcolor[2]*fshade)};
+
+            int nclipped = _ClipNear(p, clipped, znear);
+            for(int j = 0; j < nclipped; ++j) {
+                float invz = 1/clipped[j][2];
+                projected[j][0] = fx*clipped[j][0]*invz + cx;
+                projected[j][1] = fy*clipped[j][1]*invz + cy;
+                projected[j][2] = invz;
+            }
+            for(int j = 2; j < nclipped; ++j) {
+                _RasterizeTriangle(frame, width, height, projected[0], projected[j-1], projected[j], color);
+            }
+        }
+
+        frame.vdepthdata.resize(width*height);
+        for(size_t i = 0; i < frame.vinvdepth.size(); ++i) {
+            frame.vdepthdata[i] = frame.vinvdepth[i] > 0 ? 1/frame.vinvdepth[i] : 0;
+        }
+    }
+
+    /// \brief clips the triangle to z >= znear, returns the number of vertices of the resulting polygon
+    static int _ClipNear(const float p[3][3], float clipped[4][3], float znear)
+    {
+        int nclipped = 0;
+        for(int i = 0; i < 3; ++i) {
+            const float* a = p[i];
+            const float* b = p[(i+1)%3];
+            bool bina = a[2] >= znear, binb = b[2] >= znear;
+            if( bina ) {
+                clipped[nclipped][0] = a[0]; clipped[nclipped][1] = a[1]; clipped[nclipped][2] = a[2];
+                ++nclipped;
+            }
+            if( bina != binb ) {
+                float t = (znear-a[2])/(b[2]-a[2]);
+                for(int k = 0; k < 3; ++k) {
+                    clipped[nclipped][k] = a[k] + t*(b[k]-a[k]);
+                }
+                ++nclipped;
+            }
+        }
+        return nclipped;
+    }
+
+    /// \brief fills the pixels whose centers are inside the projected triangle and closer than the z-buffer
+    static void _RasterizeTriangle(CameraRenderFrame& frame, int width, int height, const float* p0, const float* p1, const float* p2, const uint8_t* color)
+    {
+        float area = (p1[0]-p0[0])*(p2[1]-p0[1]) - (p2[0]-p0[0])*(p1[1]-p0[1]);
+        if( fabsf(area) < 1e-10f ) {
+            return;
+        }
+        float iarea = 1/area;
+        int xmin = max(0, (int)floorf(min(p0[0], min(p1[0], p2[0])))), xmax = min(width-1, (int)ceilf(max(p0[0], max(p1[0], p2[0]))));
+        int ymin = max(0, (int)floorf(min(p0[1], min(p1[1], p2[1])))), ymax = min(height-1, (int)ceilf(max(p0[1], max(p1[1], p2[1]))));
+        for(int y = ymin; y <= ymax; ++y) {
+            float py = y+0.5f;
+            for(int x = xmin; x <= xmax; ++x) {
+                float px = x+0.5f;
+                float w0 = ((p1[0]-px)*(p2[1]-py) - (p2[0]-px)*(p1[1]-py))*iarea;
+                float w1 = ((p2[0]-px)*(p0[1]-py) - (p0[0]-px)*(p2[1]-py))*iarea;
+                float w2 = 1-w0-w1;
+                if( w0 < 0 || w1 < 0 || w2 < 0 ) {
+                    continue;
+                }
+                float invz = w0*p0[2] + w1*p1[2] + w2*p2[2];
+                int index = y*width+x;
+                if( invz > frame.vinvdepth[index] ) {
+                    frame.vinvdepth[index] = invz;
+                    frame.vimagedata[3*index+0] = color[0];
+                    frame.vimagedata[3*index+1] = color[1];
+                    frame.vimagedata[3*index+2] = color[2];
+                }
+            }
+        }
+    }
+
+    std::vector< boost::shared_ptr<boost::thread> > _vthreads;
+    std::list<RenderJob> _listjobs;
+    std::map<int, boost::weak_ptr<CameraRenderScene const> > _mapScenes; ///< last scene of each environment id, kept alive only by the jobs in flight
+    boost::mutex _mutex;
+    boost::condition _condition;
+    bool _bStop;
+};
+
+typedef boost::shared_ptr<CameraRenderWorkers> CameraRenderWorkersPtr;
+
+#endif
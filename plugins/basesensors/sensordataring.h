@@ -0,0 +1,92 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2011 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef OPENRAVE_SENSORDATARING_H
+#define OPENRAVE_SENSORDATARING_H
+
+#include <boost/thread/mutex.hpp>
+
+/// \brief preallocated ring of sensor data frames that are published as immutable shared pointers
+///
+/// The producer acquires a free frame, fills it, and publishes it. Once published the frame is never written again until every consumer
+/// holding it has released it, so consumers read the latest frame without copying and without blocking the producer.
+/// Only one thread should produce at a time, any number of threads can consume.
+template <typename T>
+class SensorDataRing
+{
+public:
+    typedef boost::shared_ptr<T> FramePtr;
+    typedef boost::shared_ptr<T const> FrameConstPtr;
+
+    SensorDataRing(size_t numframes=4) : _nSequence(0), _nextframe(0) {
+        _vframes.resize(numframes);
+        FOREACH(it, _vframes) {
+            it->reset(new T());
+        }
+    }
+
+    /// \brief returns a frame that no consumer references, its previous contents are kept so that buffers can be reused
+    ///
+    /// If consumers hold on to every frame, the oldest one is given up to them and a new frame takes its place in the ring.
+    FramePtr AcquireFrame()
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        for(size_t i = 0; i < _vframes.size(); ++i) {
+            size_t index = (_nextframe+i)%_vframes.size();
+            if( _vframes[index] != _pLatest && _vframes[index].unique() ) {
+                _nextframe = (index+1)%_vframes.size();
+                return _vframes[index];
+            }
+        }
+        size_t index = _nextframe;
+        if( _vframes[index] == _pLatest ) {
+            index = (index+1)%_vframes.size();
+        }
+        _vframes[index].reset(new T());
+        _nextframe = (index+1)%_vframes.size();
+        return _vframes[index];
+    }
+
+    /// \brief makes the frame returned by AcquireFrame the latest one and stamps it with the next sequence number
+    void Publish(FramePtr pframe)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        pframe->__sequence = ++_nSequence;
+        _pLatest = pframe;
+    }
+
+    /// \brief returns the most recently published frame, or an empty pointer if nothing was published since the last reset
+    FrameConstPtr GetLatest() const
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _pLatest;
+    }
+
+    /// \brief drops the latest frame, the sequence numbers keep increasing so consumers still see the next frame as new
+    void Reset()
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _pLatest.reset();
+    }
+
+private:
+    std::vector<FramePtr> _vframes;
+    FramePtr _pLatest;
+    uint64_t _nSequence;
+    size_t _nextframe;
+    mutable boost::mutex _mutex; ///< only protects the pointers, never held while frames are filled or copied
+};
+
+#endif
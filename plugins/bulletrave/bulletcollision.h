@@ -305,7 +305,9 @@ public:
         std::list<EnvironmentBase::CollisionCallbackFn> listcallbacks;
 
         SetFilterScope filter(_dispatcher, _world->getPairCache(), poverlapfilt);
-        _world->performDiscreteCollisionDetection();
+        // aabbs are already updated by bulletspace->Synchronize for the bodies that moved, so only find the pairs and dispatch them
+        _broadphase->calculateOverlappingPairs(_world->getDispatcher());
+        _world->getDispatcher()->dispatchAllCollisionPairs(_world->getPairCache(), _world->getDispatchInfo(), _world->getDispatcher());
 
         // for some reason this is necessary, or else collisions will start disappearing
         _broadphase->calculateOverlappingPairs(_world->getDispatcher());
@@ -400,6 +402,7 @@ public:
         _collisionConfiguration.reset(new btDefaultCollisionConfiguration());
         _dispatcher.reset(new btOpenraveDispatcher(this, _collisionConfiguration.get()));
         _world.reset(new btCollisionWorld(_dispatcher.get(),_broadphase.get(),_collisionConfiguration.get()));
+        _world->setForceUpdateAllAabbs(false);
 
         if( !bulletspace->InitEnvironment(_world) )
             return false;
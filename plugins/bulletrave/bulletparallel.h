@@ -0,0 +1,512 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2011 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef OPENRAVE_BULLET_PARALLEL
+#define OPENRAVE_BULLET_PARALLEL
+
+#include "bulletspace.h"
+#include "parallelrangeworkers.h"
+
+#include <iomanip>
+#include <boost/thread/recursive_mutex.hpp>
+#include <BulletCollision/CollisionDispatch/btConvexConvexAlgorithm.h>
+#include <BulletCollision/CollisionDispatch/btSimulationIslandManager.h>
+#include <BulletCollision/NarrowPhaseCollision/btVoronoiSimplexSolver.h>
+
+// bullet 2.81 introduced btCollisionObjectWrapper, the narrow phase can only be run in parallel from then on
+#if BT_BULLET_VERSION >= 281
+#define OPENRAVE_BULLET_PARALLEL_NARROWPHASE
+#endif
+
+/// \brief wall time spent in each phase of the physics steps
+class BulletStepStatistics
+{
+public:
+    enum StepPhase
+    {
+        SP_Synchronize=0, ///< pushing the openrave transforms of the moved bodies to bullet
+        SP_Predict, ///< integrating the velocities without constraints
+        SP_Collision, ///< broad and narrow phase
+        SP_Islands, ///< building the simulation islands
+        SP_Solve, ///< solving the contacts and joints
+        SP_Integrate, ///< integrating the transforms
+        SP_WriteBack, ///< setting the link transforms of openrave
+        SP_Total, ///< the whole SimulateStep call
+        SP_Count,
+    };
+
+    BulletStepStatistics() {
+        Reset();
+    }
+
+    void Reset()
+    {
+        numsteps = numsubsteps = 0;
+        for(int i = 0; i < SP_Count; ++i) {
+            total[i] = max[i] = last[i] = 0;
+        }
+    }
+
+    /// \brief starts a new SimulateStep call, the phases of all its sub steps are summed
+    void BeginStep()
+    {
+        for(int i = 0; i < SP_Count; ++i) {
+            last[i] = 0;
+        }
+    }
+
+    /// \brief adds the time since starttime to a phase
+    inline void Add(StepPhase phase, uint64_t starttime) {
+        last[phase] += utils::GetNanoPerformanceTime() - starttime;
+    }
+
+    void EndStep(int substeps, uint64_t starttime)
+    {
+        Add(SP_Total, starttime);
+        numsteps += 1;
+        numsubsteps += substeps;
+        for(int i = 0; i < SP_Count; ++i) {
+            total[i] += last[i];
+            max[i] = std::max(max[i], last[i]);
+        }
+    }
+
+    /// \brief writes the statistics as a JSON object, times are in seconds
+    ///
+    /// e.g. {"steps": 100, "substeps": 100, "solve": {"total": 0.02, "max": 0.0004, "last": 0.0002}, ...}
+    void Write(std::ostream& sout) const
+    {
+        static const char* s_phasenames[SP_Count] = { "synchronize", "predict", "collision", "islands", "solve", "integrate", "writeback", "total" };
+        std::stringstream ss;
+        ss << std::setprecision(9) << "{\"steps\": " << numsteps << ", \"substeps\": " << numsubsteps;
+        for(int i = 0; i < SP_Count; ++i) {
+            ss << ", \"" << s_phasenames[i] << "\": {\"total\": " << 1e-9*total[i] << ", \"max\": " << 1e-9*max[i] << ", \"last\": " << 1e-9*last[i] << "}";
+        }
+        ss << "}";
+        sout << ss.str();
+    }
+
+    uint64_t numsteps; ///< number of SimulateStep calls
+    uint64_t numsubsteps; ///< number of fixed sub steps bullet took in them
+    uint64_t total[SP_Count], max[SP_Count], last[SP_Count]; ///< nanoseconds of each phase summed over all the steps, of the slowest step, and of the last step
+};
+
+#ifdef OPENRAVE_BULLET_PARALLEL_NARROWPHASE
+
+/// \brief creates convex-convex algorithms that own their simplex solver
+///
+/// btDefaultCollisionConfiguration gives the same simplex solver to all the convex-convex algorithms, so they cannot run concurrently.
+/// The solver is stored right after the algorithm in the same allocation and is released with it.
+class BulletConvexConvexCreateFunc : public btConvexConvexAlgorithm::CreateFunc
+{
+public:
+    BulletConvexConvexCreateFunc(btSimplexSolverInterface* simplexSolver, btConvexPenetrationDepthSolver* pdSolver) : btConvexConvexAlgorithm::CreateFunc(simplexSolver, pdSolver) {
+    }
+
+    virtual btCollisionAlgorithm* CreateCollisionAlgorithm(btCollisionAlgorithmConstructionInfo& ci, const btCollisionObjectWrapper* body0Wrap, const btCollisionObjectWrapper* body1Wrap)
+    {
+        char* mem = static_cast<char*>(ci.m_dispatcher1->allocateCollisionAlgorithm(GetAlgorithmSize()));
+        btVoronoiSimplexSolver* psimplexsolver = new(mem+_GetSimplexSolverOffset()) btVoronoiSimplexSolver();
+        return new(mem) btConvexConvexAlgorithm(ci.m_manifold, ci, body0Wrap, body1Wrap, psimplexsolver, m_pdSolver, m_numPerturbationIterations, m_minimumPointsPerturbationThreshold);
+    }
+
+    /// \brief bytes of one algorithm with its simplex solver, rounded to 16 so that the pool keeps its elements aligned
+    static int GetAlgorithmSize() {
+        return (_GetSimplexSolverOffset()+(int)sizeof(btVoronoiSimplexSolver)+15)&~15;
+    }
+
+private:
+    static int _GetSimplexSolverOffset() {
+        return ((int)sizeof(btConvexConvexAlgorithm)+15)&~15;
+    }
+};
+
+#endif
+
+/// \brief default collision configuration whose algorithms can be run from several threads by \ref BulletParallelDispatcher
+class BulletParallelCollisionConfiguration : public btDefaultCollisionConfiguration
+{
+public:
+    BulletParallelCollisionConfiguration() : btDefaultCollisionConfiguration(_GetConstructionInfo())
+    {
+#ifdef OPENRAVE_BULLET_PARALLEL_NARROWPHASE
+        m_convexConvexCreateFunc->~btCollisionAlgorithmCreateFunc();
+        btAlignedFree(m_convexConvexCreateFunc);
+        void* mem = btAlignedAlloc(sizeof(BulletConvexConvexCreateFunc),16);
+        m_convexConvexCreateFunc = new(mem) BulletConvexConvexCreateFunc(m_simplexSolver, m_pdSolver);
+#endif
+    }
+
+private:
+    static btDefaultCollisionConstructionInfo _GetConstructionInfo()
+    {
+        btDefaultCollisionConstructionInfo info;
+#ifdef OPENRAVE_BULLET_PARALLEL_NARROWPHASE
+        info.m_customCollisionAlgorithmMaxElementSize = BulletConvexConvexCreateFunc::GetAlgorithmSize();
+#endif
+        return info;
+    }
+};
+
+/// \brief dispatcher that runs the narrow phase of the overlapping pairs on the OpenRAVE thread pool
+///
+/// Each pair only writes to its own algorithm and manifold. Creating and releasing algorithms and manifolds goes through the
+/// shared pools of the dispatcher, so it is serialized while the pairs are processed in parallel.
+/// Has to be used with \ref BulletParallelCollisionConfiguration.
+class BulletParallelDispatcher : public btCollisionDispatcher
+{
+public:
+    BulletParallelDispatcher(BulletParallelCollisionConfiguration* collisionConfiguration) : btCollisionDispatcher(collisionConfiguration), _numthreads(1), _bParallel(false) {
+    }
+
+    /// \brief the number of chunks the pairs are split into, 1 processes them on the calling thread
+    void SetNumThreads(int numthreads) {
+        _numthreads = std::max(numthreads, 1);
+    }
+
+#ifdef OPENRAVE_BULLET_PARALLEL_NARROWPHASE
+    virtual void dispatchAllCollisionPairs(btOverlappingPairCache* pairCache, const btDispatcherInfo& dispatchInfo, btDispatcher* dispatcher)
+    {
+        btBroadphasePairArray& pairs = pairCache->getOverlappingPairArray();
+        if( _numthreads <= 1 || pairs.size() <= 1 || dispatchInfo.m_dispatchFunc != btDispatcherInfo::DISPATCH_DISCRETE ) {
+            btCollisionDispatcher::dispatchAllCollisionPairs(pairCache, dispatchInfo, dispatcher);
+            return;
+        }
+        _bParallel = true;
+        try {
+            ParallelRangeWorkers(_numthreads, "BulletNarrowphase").Run(pairs.size(), boost::bind(&BulletParallelDispatcher::_DispatchPairs, this, boost::ref(pairs), _1, _2, boost::cref(dispatchInfo)));
+        }
+        catch(...) {
+            _bParallel = false;
+            throw;
+        }
+        _bParallel = false;
+    }
+
+    virtual btCollisionAlgorithm* findAlgorithm(const btCollisionObjectWrapper* body0Wrap, const btCollisionObjectWrapper* body1Wrap, btPersistentManifold* sharedManifold=0)
+    {
+        if( !_bParallel ) {
+            return btCollisionDispatcher::findAlgorithm(body0Wrap, body1Wrap, sharedManifold);
+        }
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        return btCollisionDispatcher::findAlgorithm(body0Wrap, body1Wrap, sharedManifold);
+    }
+
+    virtual btPersistentManifold* getNewManifold(const btCollisionObject* b0, const btCollisionObject* b1)
+    {
+        if( !_bParallel ) {
+            return btCollisionDispatcher::getNewManifold(b0, b1);
+        }
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        return btCollisionDispatcher::getNewManifold(b0, b1);
+    }
+
+    virtual void releaseManifold(btPersistentManifold* manifold)
+    {
+        if( !_bParallel ) {
+            btCollisionDispatcher::releaseManifold(manifold);
+            return;
+        }
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        btCollisionDispatcher::releaseManifold(manifold);
+    }
+
+    virtual void* allocateCollisionAlgorithm(int size)
+    {
+        if( !_bParallel ) {
+            return btCollisionDispatcher::allocateCollisionAlgorithm(size);
+        }
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        return btCollisionDispatcher::allocateCollisionAlgorithm(size);
+    }
+
+    virtual void freeCollisionAlgorithm(void* ptr)
+    {
+        if( !_bParallel ) {
+            btCollisionDispatcher::freeCollisionAlgorithm(ptr);
+            return;
+        }
+        boost::recursive_mutex::scoped_lock lock(_mutex);
+        btCollisionDispatcher::freeCollisionAlgorithm(ptr);
+    }
+
+private:
+    void _DispatchPairs(btBroadphasePairArray& pairs, size_t start, size_t end, const btDispatcherInfo& dispatchInfo)
+    {
+        for(size_t i = start; i < end; ++i) {
+            getNearCallback()(pairs[(int)i], *this, dispatchInfo);
+        }
+    }
+
+    boost::recursive_mutex _mutex; ///< creating an algorithm allocates it and can create a manifold, so it has to be recursive
+#endif
+
+private:
+    int _numthreads;
+    bool _bParallel; ///< true while the pairs are processed in parallel, only set by the stepping thread
+};
+
+/// \brief dynamics world that times the phases of its steps and can solve the simulation islands on the OpenRAVE thread pool
+///
+/// The islands are independent except for the static and kinematic links they touch, which the solver also writes to,
+/// so islands sharing such a link are solved by the same task. Each task has its own solver.
+/// The parallel solve orders the contacts differently than bullet does, so its results are not bit-identical to the serial ones.
+class BulletParallelDynamicsWorld : public btDiscreteDynamicsWorld
+{
+    /// \brief contacts and joints of one simulation island
+    class Island
+    {
+public:
+        std::vector<btCollisionObject*> vbodies;
+        std::vector<btPersistentManifold*> vmanifolds;
+        std::vector<btTypedConstraint*> vconstraints;
+        size_t cost; ///< number of contacts and joints
+        int id;
+    };
+
+    /// \brief copies the islands reported by btSimulationIslandManager, which reuses its arrays between the islands
+    class IslandCollector : public btSimulationIslandManager::IslandCallback
+    {
+public:
+        IslandCollector() : numislands(0) {
+        }
+
+        virtual void processIsland(btCollisionObject** bodies, int numBodies, btPersistentManifold** manifolds, int numManifolds, int islandId)
+        {
+            if( vislands.size() <= numislands ) {
+                vislands.resize(numislands+1);
+            }
+            Island& island = vislands[numislands++];
+            island.vbodies.assign(bodies, bodies+numBodies);
+            island.vmanifolds.assign(manifolds, manifolds+numManifolds);
+            island.vconstraints.resize(0);
+            island.id = islandId;
+        }
+
+        std::vector<Island> vislands; ///< only the first numislands are valid, the rest are kept for their memory
+        size_t numislands;
+    };
+
+public:
+    BulletParallelDynamicsWorld(btDispatcher* dispatcher, btBroadphaseInterface* pairCache, btConstraintSolver* constraintSolver, btCollisionConfiguration* collisionConfiguration, BulletStepStatistics* pstats) : btDiscreteDynamicsWorld(dispatcher, pairCache, constraintSolver, collisionConfiguration), _pstats(pstats), _numthreads(1) {
+    }
+
+    /// \brief the number of tasks the islands are split into, 1 solves them with the solver of the world
+    void SetNumThreads(int numthreads)
+    {
+        _numthreads = std::max(numthreads, 1);
+        while((int)_vsolvers.size() < _numthreads) {
+            _vsolvers.push_back(boost::shared_ptr<btSequentialImpulseConstraintSolver>(new btSequentialImpulseConstraintSolver()));
+        }
+    }
+
+protected:
+    virtual void predictUnconstraintMotion(btScalar timeStep)
+    {
+        uint64_t starttime = utils::GetNanoPerformanceTime();
+        btDiscreteDynamicsWorld::predictUnconstraintMotion(timeStep);
+        _pstats->Add(BulletStepStatistics::SP_Predict, starttime);
+    }
+
+    virtual void performDiscreteCollisionDetection()
+    {
+        uint64_t starttime = utils::GetNanoPerformanceTime();
+        btDiscreteDynamicsWorld::performDiscreteCollisionDetection();
+        _pstats->Add(BulletStepStatistics::SP_Collision, starttime);
+    }
+
+    virtual void calculateSimulationIslands()
+    {
+        uint64_t starttime = utils::GetNanoPerformanceTime();
+        btDiscreteDynamicsWorld::calculateSimulationIslands();
+        _pstats->Add(BulletStepStatistics::SP_Islands, starttime);
+    }
+
+    virtual void solveConstraints(btContactSolverInfo& solverInfo)
+    {
+        uint64_t starttime = utils::GetNanoPerformanceTime();
+        if( _numthreads <= 1 ) {
+            btDiscreteDynamicsWorld::solveConstraints(solverInfo);
+        }
+        else {
+            _SolveIslandsInParallel(solverInfo);
+        }
+        _pstats->Add(BulletStepStatistics::SP_Solve, starttime);
+    }
+
+    virtual void integrateTransforms(btScalar timeStep)
+    {
+        uint64_t starttime = utils::GetNanoPerformanceTime();
+        btDiscreteDynamicsWorld::integrateTransforms(timeStep);
+        _pstats->Add(BulletStepStatistics::SP_Integrate, starttime);
+    }
+
+private:
+    void _SolveIslandsInParallel(btContactSolverInfo& solverInfo)
+    {
+        _collector.numislands = 0;
+        m_islandManager->buildAndProcessIslands(getDispatcher(), getCollisionWorld(), &_collector);
+        std::vector<Island>& vislands = _collector.vislands;
+        size_t numislands = _collector.numislands;
+        if( numislands == 0 ) {
+            return;
+        }
+
+        // same island as bullet assigns to the joints
+        _mapislandindices.clear();
+        for(size_t i = 0; i < numislands; ++i) {
+            _mapislandindices[vislands[i].id] = i;
+        }
+        for(int i = 0; i < m_constraints.size(); ++i) {
+            btTypedConstraint* pconstraint = m_constraints[i];
+            const btCollisionObject& obj0 = pconstraint->getRigidBodyA();
+            const btCollisionObject& obj1 = pconstraint->getRigidBodyB();
+            std::map<int, size_t>::iterator it = _mapislandindices.find(obj0.getIslandTag() >= 0 ? obj0.getIslandTag() : obj1.getIslandTag());
+            if( it != _mapislandindices.end() ) {
+                vislands[it->second].vconstraints.push_back(pconstraint);
+            }
+        }
+
+        // islands touching the same non-static object go to the same group
+        _vgroupparents.resize(numislands);
+        for(size_t i = 0; i < numislands; ++i) {
+            _vgroupparents[i] = i;
+        }
+        _mapobjectislands.clear();
+        for(size_t i = 0; i < numislands; ++i) {
+            Island& island = vislands[i];
+            FOREACH(itmanifold, island.vmanifolds) {
+                _MergeObjectIsland(static_cast<const btCollisionObject*>((*itmanifold)->getBody0()), i);
+                _MergeObjectIsland(static_cast<const btCollisionObject*>((*itmanifold)->getBody1()), i);
+            }
+            FOREACH(itconstraint, island.vconstraints) {
+                _MergeObjectIsland(&(*itconstraint)->getRigidBodyA(), i);
+                _MergeObjectIsland(&(*itconstraint)->getRigidBodyB(), i);
+            }
+            island.cost = island.vmanifolds.size() + island.vconstraints.size();
+        }
+
+        // assign the biggest groups first to the least loaded task
+        _vgroups.resize(0);
+        _vgroupcosts.resize(0);
+        _vislandgroups.resize(numislands);
+        for(size_t i = 0; i < numislands; ++i) {
+            size_t root = _FindGroup(i);
+            if( root == i ) {
+                _vislandgroups[i] = _vgroups.size();
+                _vgroups.push_back(std::vector<size_t>());
+                _vgroupcosts.push_back(std::make_pair(size_t(0), _vgroups.size()-1));
+            }
+            else {
+                _vislandgroups[i] = _vislandgroups[root];
+            }
+            _vgroups.at(_vislandgroups[i]).push_back(i);
+            _vgroupcosts.at(_vislandgroups[i]).first += vislands[i].cost;
+        }
+        std::sort(_vgroupcosts.begin(), _vgroupcosts.end(), _CompareGroupCost);
+
+        _vtaskgroups.resize(_numthreads);
+        _vtaskcosts.resize(_numthreads);
+        for(int itask = 0; itask < _numthreads; ++itask) {
+            _vtaskgroups[itask].resize(0);
+            _vtaskcosts[itask] = 0;
+        }
+        FOREACH(itgroup, _vgroupcosts) {
+            size_t itask = std::min_element(_vtaskcosts.begin(), _vtaskcosts.end()) - _vtaskcosts.begin();
+            _vtaskgroups[itask].push_back(itgroup->second);
+            _vtaskcosts[itask] += itgroup->first;
+        }
+
+        utils::ThreadPoolTaskGroup taskgroup("BulletIslands");
+        for(int itask = 1; itask < _numthreads; ++itask) {
+            if( _vtaskgroups[itask].size() > 0 ) {
+                taskgroup.Submit(boost::bind(&BulletParallelDynamicsWorld::_SolveTask, this, itask, boost::cref(solverInfo)));
+            }
+        }
+        _SolveTask(0, solverInfo);
+        taskgroup.Wait();
+    }
+
+    void _SolveTask(int itask, const btContactSolverInfo& solverInfo)
+    {
+        btSequentialImpulseConstraintSolver& solver = *_vsolvers.at(itask);
+        FOREACH(itgroup, _vtaskgroups.at(itask)) {
+            FOREACH(itisland, _vgroups.at(*itgroup)) {
+                Island& island = _collector.vislands.at(*itisland);
+                if( island.cost == 0 ) {
+                    continue;
+                }
+                btCollisionObject** pbodies = island.vbodies.size() > 0 ? &island.vbodies[0] : NULL;
+                btPersistentManifold** pmanifolds = island.vmanifolds.size() > 0 ? &island.vmanifolds[0] : NULL;
+                btTypedConstraint** pconstraints = island.vconstraints.size() > 0 ? &island.vconstraints[0] : NULL;
+#if BT_BULLET_VERSION >= 281
+                solver.solveGroup(pbodies, (int)island.vbodies.size(), pmanifolds, (int)island.vmanifolds.size(), pconstraints, (int)island.vconstraints.size(), solverInfo, NULL, getDispatcher());
+#else
+                solver.solveGroup(pbodies, (int)island.vbodies.size(), pmanifolds, (int)island.vmanifolds.size(), pconstraints, (int)island.vconstraints.size(), solverInfo, NULL, NULL, getDispatcher());
+#endif
+            }
+        }
+    }
+
+    /// \brief static objects are never written by the solver, but kinematic ones like the static links of openrave are, so they tie the islands together
+    void _MergeObjectIsland(const btCollisionObject* pobj, size_t islandindex)
+    {
+        if( pobj->isStaticObject() && !pobj->isKinematicObject() ) {
+            return;
+        }
+        std::pair<std::map<const btCollisionObject*, size_t>::iterator, bool> itinserted = _mapobjectislands.insert(std::make_pair(pobj, islandindex));
+        if( !itinserted.second ) {
+            size_t root0 = _FindGroup(itinserted.first->second), root1 = _FindGroup(islandindex);
+            // keep the smallest index as the root so that the groups are in the order of the islands
+            if( root0 < root1 ) {
+                _vgroupparents[root1] = root0;
+            }
+            else if( root1 < root0 ) {
+                _vgroupparents[root0] = root1;
+            }
+        }
+    }
+
+    size_t _FindGroup(size_t islandindex)
+    {
+        while( _vgroupparents[islandindex] != islandindex ) {
+            _vgroupparents[islandindex] = _vgroupparents[_vgroupparents[islandindex]];
+            islandindex = _vgroupparents[islandindex];
+        }
+        return islandindex;
+    }
+
+    static bool _CompareGroupCost(const std::pair<size_t, size_t>& p0, const std::pair<size_t, size_t>& p1)
+    {
+        // biggest first, ties in the order of the islands
+        return p0.first > p1.first || (p0.first == p1.first && p0.second < p1.second);
+    }
+
+    BulletStepStatistics* _pstats;
+    int _numthreads;
+    std::vector<boost::shared_ptr<btSequentialImpulseConstraintSolver> > _vsolvers; ///< one per task
+
+    // kept between the steps for their memory
+    IslandCollector _collector;
+    std::map<int, size_t> _mapislandindices;
+    std::map<const btCollisionObject*, size_t> _mapobjectislands;
+    std::vector<size_t> _vgroupparents, _vislandgroups;
+    std::vector< std::vector<size_t> > _vgroups;
+    std::vector< std::pair<size_t, size_t> > _vgroupcosts; ///< (cost, group index)
+    std::vector< std::vector<size_t> > _vtaskgroups;
+    std::vector<size_t> _vtaskcosts;
+};
+
+#endif
@@ -15,6 +15,7 @@
 
 // 2013 Modifications: Theodoros Stouraitis and Praveen Ramanujam
 #include "bulletspace.h"
+#include "bulletparallel.h"
 
 class BulletPhysicsEngine : public PhysicsEngineBase
 {
@@ -139,6 +140,15 @@ public:
                 _ss >> _physics->_super_damp2;
                 
             }
+            else if( name == "num_threads" ) {
+                _ss >> _physics->_numthreads;
+            }
+            else if( name == "fixed_timestep" ) {
+                _ss >> _physics->_fixedtimestep;
+            }
+            else if( name == "max_substeps" ) {
+                _ss >> _physics->_maxsubsteps;
+            }
             else if( name == "gravity" ) {
                 Vector v;
                 _ss >> v.x >> v.y >> v.z;
@@ -168,9 +178,9 @@ public:
             }
         }
 
-        static const boost::array<string, 8>& GetTags() {
-        static const boost::array<string, 8> tags = {{"solver_iterations","margin_depth","linear_damping","rotation_damping",
-        "global_contact_force_mixing","global_friction","global_restitution","gravity" }};
+        static const boost::array<string, 11>& GetTags() {
+        static const boost::array<string, 11> tags = {{"solver_iterations","margin_depth","linear_damping","rotation_damping",
+        "global_contact_force_mixing","global_friction","global_restitution","gravity","num_threads","fixed_timestep","max_substeps" }};
             return tags;
         }
 
@@ -192,6 +202,10 @@ public:
 	stringstream ss;        
 	__description = ":Interface Authors: Max Argus, Nick Hillier, Katrina Monkley, Rosen Diankov\n\nInterface to `Bullet Physics Engine <http://bulletphysics.org/>`_\n";
         RegisterCommand("SetStaticBodyTransform",boost::bind(&BulletPhysicsEngine::SetStaticBodyTransform,this,_1,_2),"Sets the transformation of a static body manually, not allowed to use for dynamic bodies and it should be used with caution even for static bodies because it can cause instabilities in physics engine.");
+        RegisterCommand("SetNumThreads",boost::bind(&BulletPhysicsEngine::_SetNumThreadsCommand,this,_1,_2),"Sets the number of tasks the narrow phase and the simulation islands of each step are split into on the OpenRAVE thread pool. 1 (default) steps on the calling thread, 0 uses the size of the pool. The parallel results are not bit-identical to the serial ones.");
+        RegisterCommand("SetFixedTimeStep",boost::bind(&BulletPhysicsEngine::_SetFixedTimeStepCommand,this,_1,_2),"[timestep] [maxsubsteps]: steps bullet with fixed sub steps of timestep seconds covering the elapsed time of each SimulateStep call, at most maxsubsteps per call. A timestep of 0 (default) takes a single step of 0.005s per call.");
+        RegisterCommand("GetStepStatistics",boost::bind(&BulletPhysicsEngine::_GetStepStatisticsCommand,this,_1,_2),"Returns a JSON object with the number of steps and sub steps and the total, max, and last seconds spent in each phase of the steps: synchronize, predict, collision, islands, solve, integrate, writeback, total.");
+        RegisterCommand("ResetStepStatistics",boost::bind(&BulletPhysicsEngine::_ResetStepStatisticsCommand,this,_1,_2),"Clears the statistics returned by GetStepStatistics.");
         _solver_iterations = 5;
         _margin_depth = 0.001;
         _linear_damping = 0.1;
@@ -203,6 +217,10 @@ public:
         
         _super_damp = 0.3; 
         _super_damp2 = 0.9;
+
+        _numthreads = 1;
+        _fixedtimestep = 0;
+        _maxsubsteps = 10;
           
         FOREACHC(it, PhysicsPropertiesXMLReader::GetTags()) {
             ss << "**" << *it << "**, ";
@@ -314,15 +332,16 @@ public:
         _broadphase.reset(new btDbvtBroadphase());
 
         // allowes configuration of collision detection
-        _collisionConfiguration.reset(new btDefaultCollisionConfiguration());
+        _collisionConfiguration.reset(new BulletParallelCollisionConfiguration());
 
         // handels conves and concave collisions
         //_dispatcher = new btOpenraveDispatcher::btOpenraveDispatcher(_collisionConfiguration);
-        _dispatcher.reset(new btCollisionDispatcher(_collisionConfiguration.get()));
+        _dispatcher.reset(new BulletParallelDispatcher(_collisionConfiguration.get()));
         _solver.reset(new btSequentialImpulseConstraintSolver());
         
         // btContinuousDynamicsWorld gives a segfault for some reason
-        _dynamicsWorld.reset(new btDiscreteDynamicsWorld(_dispatcher.get(),_broadphase.get(),_solver.get(),_collisionConfiguration.get()));
+        _dynamicsWorld.reset(new BulletParallelDynamicsWorld(_dispatcher.get(),_broadphase.get(),_solver.get(),_collisionConfiguration.get(),&_stepstats));
+        _SetNumThreads(_numthreads);
         
         // Critical point when you introduce the hand in the simulation
         // the PhysicsFilterCallback() is derived from the OpenRAVEFilterCallback which is in the file bulletspace.h
@@ -662,11 +681,22 @@ public:
 
     virtual void SimulateStep(dReal fTimeElapsed)
     {
+        uint64_t starttime = utils::GetNanoPerformanceTime();
+        _stepstats.BeginStep();
         _space->Synchronize();
-        int maxSubSteps = 0;  // --> reduced sub steps
-        //_dynamicsWorld->applyGravity();
-        _dynamicsWorld->stepSimulation(0.005,maxSubSteps); //-> reduced elapse time
+        _stepstats.Add(BulletStepStatistics::SP_Synchronize, starttime);
 
+        int numsubsteps;
+        if( _fixedtimestep > 0 ) {
+            numsubsteps = _dynamicsWorld->stepSimulation(fTimeElapsed,_maxsubsteps,_fixedtimestep);
+        }
+        else {
+            int maxSubSteps = 0;  // --> reduced sub steps
+            //_dynamicsWorld->applyGravity();
+            numsubsteps = _dynamicsWorld->stepSimulation(0.005,maxSubSteps); //-> reduced elapse time
+        }
+
+        uint64_t writebacktime = utils::GetNanoPerformanceTime();
         vector<KinBodyPtr> vbodies;
         GetEnv()->GetBodies(vbodies);
         FOREACHC(itbody, vbodies) {
@@ -677,6 +707,8 @@ public:
             }
             pinfo->nLastStamp = (*itbody)->GetUpdateStamp();
         }
+        _stepstats.Add(BulletStepStatistics::SP_WriteBack, writebacktime);
+        _stepstats.EndStep(numsubsteps, starttime);
         //_dynamicsWorld->clearForces();
     }
 
@@ -691,6 +723,9 @@ public:
     btScalar _global_restitution;
     btScalar _super_damp;
     btScalar _super_damp2;
+    int _numthreads;
+    btScalar _fixedtimestep;
+    int _maxsubsteps;
 
 private:
     static BulletSpace::KinBodyInfoPtr GetPhysicsInfo(KinBodyConstPtr pbody)
@@ -698,6 +733,58 @@ private:
         return boost::dynamic_pointer_cast<BulletSpace::KinBodyInfo>(pbody->GetUserData("bulletphysics"));
     }
 
+    void _SetNumThreads(int numthreads)
+    {
+        _numthreads = numthreads;
+        int numtasks = numthreads > 0 ? numthreads : utils::GetThreadPoolSize();
+        if( !!_dispatcher ) {
+            _dispatcher->SetNumThreads(numtasks);
+        }
+        if( !!_dynamicsWorld ) {
+            _dynamicsWorld->SetNumThreads(numtasks);
+        }
+    }
+
+    bool _SetNumThreadsCommand(ostream& sout, istream& sinput)
+    {
+        int numthreads = 1;
+        sinput >> numthreads;
+        if( !sinput || numthreads < 0 ) {
+            return false;
+        }
+        _SetNumThreads(numthreads);
+        return true;
+    }
+
+    bool _SetFixedTimeStepCommand(ostream& sout, istream& sinput)
+    {
+        btScalar fixedtimestep = 0;
+        int maxsubsteps = _maxsubsteps;
+        sinput >> fixedtimestep;
+        if( !sinput || fixedtimestep < 0 ) {
+            return false;
+        }
+        sinput >> maxsubsteps;
+        if( maxsubsteps < 1 ) {
+            return false;
+        }
+        _fixedtimestep = fixedtimestep;
+        _maxsubsteps = maxsubsteps;
+        return true;
+    }
+
+    bool _GetStepStatisticsCommand(ostream& sout, istream& sinput)
+    {
+        _stepstats.Write(sout);
+        return true;
+    }
+
+    bool _ResetStepStatisticsCommand(ostream& sout, istream& sinput)
+    {
+        _stepstats.Reset();
+        return true;
+    }
+
     void _SyncCallback(BulletSpace::KinBodyInfoConstPtr pinfo)
     {
         // reset dynamics
@@ -711,15 +798,16 @@ private:
 
     int _options;
     boost::shared_ptr<BulletSpace> _space;
-    boost::shared_ptr<btDiscreteDynamicsWorld> _dynamicsWorld;
-    boost::shared_ptr<btDefaultCollisionConfiguration> _collisionConfiguration;
+    boost::shared_ptr<BulletParallelDynamicsWorld> _dynamicsWorld;
+    boost::shared_ptr<BulletParallelCollisionConfiguration> _collisionConfiguration;
     boost::shared_ptr<btBroadphaseInterface> _broadphase;
-    boost::shared_ptr<btCollisionDispatcher> _dispatcher;
+    boost::shared_ptr<BulletParallelDispatcher> _dispatcher;
     boost::shared_ptr<btConstraintSolver> _solver;
     boost::shared_ptr<btOverlapFilterCallback> _filterCallback;
 
     std::list<EnvironmentBase::CollisionCallbackFn> _listcallbacks;
     CollisionReportPtr _report;
+    BulletStepStatistics _stepstats;
 };
 
 
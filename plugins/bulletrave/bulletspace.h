@@ -141,6 +141,7 @@ private:
     {
         _world.reset();
         _worlddynamics.reset();
+        _vinfos.clear();
     }
 
     KinBodyInfoPtr InitKinBody(KinBodyPtr pbody, KinBodyInfoPtr pinfo = KinBodyInfoPtr(), btScalar fmargin=0.0005) //  -> changed fmargin because penetration was too little. For collision the values needs to be changed. There will be an XML interface for fmargin.
@@ -148,6 +149,7 @@ private:
         // create all ode bodies and joints
         if( !pinfo ) {
             pinfo.reset(new KinBodyInfo(_world,_bPhysics));
+            _vinfos.push_back(pinfo);
         }
         pinfo->Reset();
         pinfo->pbody = pbody;
@@ -370,17 +372,26 @@ private:
         return pinfo;
     }
 
+    /// \brief updates the bullet objects of all the bodies whose update stamp changed since the last call
+    ///
+    /// Goes through the infos created by InitKinBody instead of querying the environment, infos of removed bodies are dropped.
     void Synchronize()
     {
-        vector<KinBodyPtr> vbodies;
-        _penv->GetBodies(vbodies);
-        FOREACHC(itbody, vbodies) {
-            KinBodyInfoPtr pinfo = GetInfo(*itbody);
-            BOOST_ASSERT( pinfo->pbody == *itbody );
-            if( pinfo->nLastStamp != (*itbody)->GetUpdateStamp() ) {
+        size_t ivalid = 0;
+        for(size_t i = 0; i < _vinfos.size(); ++i) {
+            KinBodyInfoPtr pinfo = _vinfos[i].lock();
+            if( !pinfo ) {
+                continue;
+            }
+            if( ivalid != i ) {
+                _vinfos[ivalid] = _vinfos[i];
+            }
+            ++ivalid;
+            if( !!pinfo->pbody && pinfo->nLastStamp != pinfo->pbody->GetUpdateStamp() ) {
                 _Synchronize(pinfo);
             }
         }
+        _vinfos.resize(ivalid);
     }
 
     void Synchronize(KinBodyConstPtr pbody)
@@ -445,7 +456,12 @@ private:
         pinfo->nLastStamp = pinfo->pbody->GetUpdateStamp();
         BOOST_ASSERT( vtrans.size() == pinfo->vlinks.size() );
         for(size_t i = 0; i < vtrans.size(); ++i) {
-            pinfo->vlinks[i]->obj->getWorldTransform() = GetBtTransform(vtrans[i]*pinfo->vlinks[i]->tlocal);
+            btCollisionObject* obj = pinfo->vlinks[i]->obj.get();
+            obj->getWorldTransform() = GetBtTransform(vtrans[i]*pinfo->vlinks[i]->tlocal);
+            if( !!obj->getBroadphaseHandle() ) {
+                // only the moved objects update their aabbs, the world does not recompute all of them on every query
+                _world->updateSingleAabb(obj);
+            }
         }
         if( !!_synccallback ) {
             _synccallback(pinfo);
@@ -470,6 +486,7 @@ private:
     boost::shared_ptr<btCollisionWorld> _world;
     boost::shared_ptr<btDiscreteDynamicsWorld> _worlddynamics;
     SynchronizeCallbackFn _synccallback;
+    std::vector< boost::weak_ptr<KinBodyInfo> > _vinfos; ///< all infos created by InitKinBody, expired ones belong to removed bodies
     bool _bPhysics;
 };
 
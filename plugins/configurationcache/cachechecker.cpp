@@ -13,10 +13,176 @@
 // limitations under the License.
 #include "openraveplugindefs.h"
 #include "configurationcachetree.h"
+#include "parallelrangeworkers.h"
+#include <fstream>
 
 namespace configurationcache
 {
 
+/// \brief latency histograms and timings of the queries of one configuration cache
+struct CacheQueryStatistics
+{
+    enum QueryResult {
+        QR_HitCollision=0, ///< cache returned a collision
+        QR_HitFree=1, ///< cache returned free space
+        QR_MissFree=2, ///< cache did not know, the checker returned free space
+        QR_MissCollision=3, ///< cache did not know, the checker returned a collision
+        QR_NumResults=4,
+    };
+
+    static const int s_numbuckets = 24; ///< bucket 0 holds latencies below 1us, bucket i holds [2^(i-1),2^i) us, the last bucket also holds everything above
+    static const int s_maxnodecountsamples = 256; ///< when reached, every other sample is dropped and the sampling interval is doubled
+
+    CacheQueryStatistics() {
+        Reset();
+    }
+
+    void Reset()
+    {
+        for(int iresult = 0; iresult < QR_NumResults; ++iresult) {
+            std::fill(vhistograms[iresult], vhistograms[iresult]+s_numbuckets, 0);
+            vnumqueries[iresult] = 0;
+            vtotaltime[iresult] = 0;
+        }
+        lookuptime = 0;
+        rawtime = 0;
+        inserttime = 0;
+        numvisitednodes = 0;
+        numabortedlookups = 0;
+        numqueries = 0;
+        nodecountinterval = 100;
+        vnodecounts.resize(0);
+        starttime = utils::GetMicroTime();
+    }
+
+    /// \brief records one query, all times are in microseconds
+    void AddQuery(QueryResult result, uint64_t querylookuptime, uint64_t queryrawtime, uint64_t queryinserttime, int numnodes)
+    {
+        uint64_t totaltime = querylookuptime + queryrawtime + queryinserttime;
+        int ibucket = 0;
+        while(ibucket+1 < s_numbuckets && (totaltime>>ibucket) > 0 ) {
+            ++ibucket;
+        }
+        vhistograms[result][ibucket] += 1;
+        vnumqueries[result] += 1;
+        vtotaltime[result] += totaltime;
+        lookuptime += querylookuptime;
+        rawtime += queryrawtime;
+        inserttime += queryinserttime;
+        if( numqueries % nodecountinterval == 0 ) {
+            if( (int)vnodecounts.size() >= s_maxnodecountsamples ) {
+                for(size_t i = 0; 2*i < vnodecounts.size(); ++i) {
+                    vnodecounts[i] = vnodecounts[2*i];
+                }
+                vnodecounts.resize((vnodecounts.size()+1)/2);
+                nodecountinterval *= 2;
+            }
+            if( numqueries % nodecountinterval == 0 ) {
+                NodeCountSample sample;
+                sample.elapsedtime = utils::GetMicroTime() - starttime;
+                sample.numqueries = numqueries;
+                sample.numnodes = numnodes;
+                vnodecounts.push_back(sample);
+            }
+        }
+        ++numqueries;
+    }
+
+    /// \brief records the work of one CacheTree lookup
+    void AddLookup(const CacheTreeQueryInfo& info)
+    {
+        numvisitednodes += info.numvisited;
+        if( info.bAborted ) {
+            ++numabortedlookups;
+        }
+    }
+
+    /// \brief writes the statistics as a JSON object
+    void WriteJSON(std::ostream& O, ConfigurationCacheConstPtr cache) const
+    {
+        static const char* s_resultnames[QR_NumResults] = { "hitcollision", "hitfree", "missfree", "misscollision" };
+        O << "{\"numqueries\": " << numqueries;
+        O << ", \"numnodes\": " << (!cache ? 0 : cache->GetNumNodes());
+        O << ", \"lookuptime_us\": " << lookuptime << ", \"rawtime_us\": " << rawtime << ", \"inserttime_us\": " << inserttime;
+        O << ", \"lookuprawratio\": ";
+        if( rawtime > 0 ) {
+            O << (double)lookuptime/(double)rawtime;
+        }
+        else {
+            O << "null";
+        }
+        O << ", \"approximation\": {\"errorfactor\": " << (!cache ? dReal(0) : cache->GetApproximationErrorFactor()) << ", \"maxvisitednodes\": " << (!cache ? 0 : cache->GetMaxVisitedNodes());
+        O << ", \"visitednodes\": " << numvisitednodes << ", \"averagevisitednodes\": ";
+        if( numqueries > 0 ) {
+            O << (double)numvisitednodes/(double)numqueries;
+        }
+        else {
+            O << "null";
+        }
+        O << ", \"abortedlookups\": " << numabortedlookups << "}";
+        O << ", \"latency\": {\"bucketupperbounds_us\": [";
+        for(int ibucket = 0; ibucket < s_numbuckets; ++ibucket) {
+            if( ibucket > 0 ) {
+                O << ", ";
+            }
+            if( ibucket+1 < s_numbuckets ) {
+                O << (uint64_t(1)<<ibucket);
+            }
+            else {
+                O << "null";
+            }
+        }
+        O << "]";
+        for(int iresult = 0; iresult < QR_NumResults; ++iresult) {
+            O << ", \"" << s_resultnames[iresult] << "\": {\"count\": " << vnumqueries[iresult] << ", \"totaltime_us\": " << vtotaltime[iresult] << ", \"histogram\": [";
+            for(int ibucket = 0; ibucket < s_numbuckets; ++ibucket) {
+                if( ibucket > 0 ) {
+                    O << ", ";
+                }
+                O << vhistograms[iresult][ibucket];
+            }
+            O << "]}";
+        }
+        O << "}, \"levels\": [";
+        if( !!cache ) {
+            std::vector< std::pair<int, int> > vlevelcounts;
+            cache->GetLevelNodeCounts(vlevelcounts);
+            for(size_t i = 0; i < vlevelcounts.size(); ++i) {
+                if( i > 0 ) {
+                    O << ", ";
+                }
+                O << "{\"level\": " << vlevelcounts[i].first << ", \"numnodes\": " << vlevelcounts[i].second << "}";
+            }
+        }
+        O << "], \"nodecounts\": [";
+        for(size_t i = 0; i < vnodecounts.size(); ++i) {
+            if( i > 0 ) {
+                O << ", ";
+            }
+            O << "{\"elapsedtime_us\": " << vnodecounts[i].elapsedtime << ", \"numqueries\": " << vnodecounts[i].numqueries << ", \"numnodes\": " << vnodecounts[i].numnodes << "}";
+        }
+        O << "]}";
+    }
+
+    struct NodeCountSample
+    {
+        uint64_t elapsedtime; ///< time since the last reset, us
+        int numqueries; ///< number of queries before the sample
+        int numnodes; ///< number of nodes in the tree
+    };
+
+    uint64_t vhistograms[QR_NumResults][s_numbuckets]; ///< per query latency histograms (lookup+raw+insert)
+    int vnumqueries[QR_NumResults];
+    uint64_t vtotaltime[QR_NumResults]; ///< us
+    uint64_t lookuptime, rawtime, inserttime; ///< total time spent in the CacheTree lookups, the underlying checker, and the insertions, us
+    uint64_t numvisitednodes; ///< total number of nodes visited by the lookups
+    uint64_t numabortedlookups; ///< number of lookups that reached the maximum number of visited nodes, these are counted as misses
+    int numqueries;
+    int nodecountinterval; ///< number of queries between two node count samples
+    std::vector<NodeCountSample> vnodecounts;
+    uint64_t starttime; ///< time of the last reset, us
+};
+
 class CacheCollisionChecker : public CollisionCheckerBase
 {
 public:
@@ -34,6 +200,8 @@ public:
                         "set the self collision cache parameters: collisionthreshold, freespacethreshold, insertiondistancemultiplier, base");
         RegisterCommand("SetCacheParameters",boost::bind(&CacheCollisionChecker::_SetCacheParametersCommand,this,_1,_2),
                         "set the collision cache parameters: collisionthreshold, freespacethreshold, insertiondistancemultiplier, base");
+        RegisterCommand("SetCacheApproximation",boost::bind(&CacheCollisionChecker::_SetCacheApproximationCommand,this,_1,_2),
+                        "set how the cache lookups trade accuracy for speed: errorfactor maxvisitednodes [self]. errorfactor=0 is exact, maxvisitednodes=0 is unlimited. Lookups that visit too many nodes call the collision checker.");
         RegisterCommand("ValidateCache",boost::bind(&CacheCollisionChecker::_ValidateCacheCommand,this,_1,_2),
                         "test the validity of the cache");
         RegisterCommand("ValidateSelfCache",boost::bind(&CacheCollisionChecker::_ValidateSelfCacheCommand,this,_1,_2),
@@ -50,8 +218,14 @@ public:
                         "save self collision cache");
         RegisterCommand("LoadCache",boost::bind(&CacheCollisionChecker::_LoadCacheCommand,this,_1,_2),
                         "load self collision cache");
+        RegisterCommand("WarmSelfCache",boost::bind(&CacheCollisionChecker::_WarmSelfCacheCommand,this,_1,_2),
+                        "label recorded configurations in parallel, insert them into the self collision cache and save it. [numthreads n] [trajectory filename]* [configurations num values...]* [samplingstep dt] [save 0|1]. Configurations hold all the DOF values of the robot, trajectory joints that are not set keep the current values. Outputs: numconfigurations numlabeled numinserted numcollision");
         RegisterCommand("GetCacheTimes",boost::bind(&CacheCollisionChecker::_GetCacheTimesCommand,this,_1,_2),
                         "get the cache times: insert, query, collision checking, load");
+        RegisterCommand("GetCacheStatisticsJSON",boost::bind(&CacheCollisionChecker::_GetCacheStatisticsJSONCommand,this,_1,_2),
+                        "get the query statistics of the environment and self collision caches as a JSON object: per result latency histograms, lookup/checker times, tree level distribution, and node counts over time");
+        RegisterCommand("ResetCacheStatistics",boost::bind(&CacheCollisionChecker::_ResetCacheStatisticsCommand,this,_1,_2),
+                        "reset the statistics returned by GetCacheStatisticsJSON");
         std::string collisionname="ode";
         sinput >> collisionname;
         _pintchecker = RaveCreateCollisionChecker(GetEnv(), collisionname);
@@ -138,7 +312,13 @@ public:
             _cache->Reset();
         }
         if( !!_selfcache ) {
-            _selfcache->Reset();
+            if( _selfcache->GetRobot()->GetEnv() == GetEnv() ) {
+                _selfcache->Reset();
+            }
+            else {
+                // shared with the checker of another environment, so leave its nodes
+                _selfcache.reset();
+            }
         }
         if( !!_pintchecker ) {
             _pintchecker->DestroyEnvironment();
@@ -164,6 +344,8 @@ public:
         }
 
         _strRobotName = clone->_strRobotName;
+        // self-collisions only depend on the robot, so share the self cache with the reference checker once the robot is available. This lets checkers of environments used by different planner threads benefit from each other's queries.
+        _pSharedSelfCache = clone->_selfcache;
         _probot.reset(); // have to rest to force creating a new cache
         _probot = GetRobot();
 
@@ -175,6 +357,8 @@ public:
         _selfcachedcollisionhits=clone->_selfcachedcollisionhits;
         _selfcachedfreehits = clone->_selfcachedfreehits;
 
+        _cachestats = clone->_cachestats;
+        _selfcachestats = clone->_selfcachestats;
     }
 
     virtual bool InitKinBody(KinBodyPtr pbody) {
@@ -208,9 +392,13 @@ public:
         dReal closestdist=0;
 
         // see if cache contains the result, closestdist is used to determine if the configuration should be inserted into the cache
+        uint64_t querystarttime = utils::GetMicroTime();
         _stime = utils::GetMilliTime();
-        int ret = _cache->CheckCollision(robotlink, collidinglink, closestdist);
+        CacheTreeQueryInfo lookupinfo;
+        int ret = _cache->CheckCollision(robotlink, collidinglink, closestdist, &lookupinfo);
         _querytime += utils::GetMilliTime()-_stime;
+        uint64_t lookuptime = utils::GetMicroTime()-querystarttime;
+        _cachestats.AddLookup(lookupinfo);
 
         ++_cachedcollisionchecks;
 
@@ -227,6 +415,7 @@ public:
         // cache hit (collision)
         if( ret == 1 ) {
             ++_cachedcollisionhits;
+            _cachestats.AddQuery(CacheQueryStatistics::QR_HitCollision, lookuptime, 0, 0, _cache->GetNumNodes());
             // in collision, create collision report
             if( !!report ) {
                 report->plink1 = robotlink;
@@ -236,6 +425,7 @@ public:
         } // (free configuration)
         else if( ret == 0 ) {
             ++_cachedfreehits;
+            _cachestats.AddQuery(CacheQueryStatistics::QR_HitFree, lookuptime, 0, 0, _cache->GetNumNodes());
             // free space
             return false;
         }
@@ -247,16 +437,18 @@ public:
         }
 
         // raw collisioncheck
+        uint64_t rawstarttime = utils::GetMicroTime();
         _stime = utils::GetMilliTime();
         bool col = _pintchecker->CheckCollision(pbody1, report);
         _rawtime += utils::GetMilliTime()-_stime;
 
-
+        uint64_t insertstarttime = utils::GetMicroTime();
         _stime = utils::GetMilliTime();
         _cache->GetDOFValues(_dofvals);
         // insert collisioncheck result into cache
         _cache->InsertConfiguration(_dofvals, !col ? CollisionReportPtr() : report, closestdist);
         _intime += utils::GetMilliTime()-_stime;
+        _cachestats.AddQuery(col ? CacheQueryStatistics::QR_MissCollision : CacheQueryStatistics::QR_MissFree, lookuptime, insertstarttime-rawstarttime, utils::GetMicroTime()-insertstarttime, _cache->GetNumNodes());
 
         return col;
     }
@@ -320,9 +512,15 @@ public:
         KinBody::LinkConstPtr robotlink, collidinglink;
         dReal closestdist=0;
 
+        // the self cache might be shared with other environments, so take the values of this environment's robot
+        uint64_t querystarttime = utils::GetMicroTime();
         _stime = utils::GetMilliTime();
-        int ret = _selfcache->CheckCollision(robotlink, collidinglink, closestdist);
+        probot->GetDOFValues(_dofvals);
+        CacheTreeQueryInfo lookupinfo;
+        int ret = _selfcache->CheckCollision(_dofvals, robotlink, collidinglink, closestdist, &lookupinfo);
         _selfquerytime += utils::GetMilliTime()-_stime;
+        uint64_t lookuptime = utils::GetMicroTime()-querystarttime;
+        _selfcachestats.AddLookup(lookupinfo);
 
         ++_selfcachedcollisionchecks;
 
@@ -348,15 +546,17 @@ public:
         }
         if( ret == 1 ) {
             ++_selfcachedcollisionhits;
+            _selfcachestats.AddQuery(CacheQueryStatistics::QR_HitCollision, lookuptime, 0, 0, _selfcache->GetNumNodes());
             // in collision
             if( !!report ) {
-                report->plink1 = robotlink;
-                report->plink2 = collidinglink;
+                report->plink1 = _GetEnvironmentLink(robotlink);
+                report->plink2 = _GetEnvironmentLink(collidinglink);
             }
             return true;
         }
         else if( ret == 0 ) {
             ++_selfcachedfreehits;
+            _selfcachestats.AddQuery(CacheQueryStatistics::QR_HitFree, lookuptime, 0, 0, _selfcache->GetNumNodes());
             // free space
             return false;
         }
@@ -366,14 +566,27 @@ public:
             report.reset(new CollisionReport());
         }
 
+        uint64_t rawstarttime = utils::GetMicroTime();
         _stime = utils::GetMilliTime();
-        bool col = _pintchecker->CheckStandaloneSelfCollision(pbody, report);
+        // the link bounding spheres reject most free configurations without the internal checker
+        int adjacentoptions = KinBody::AO_Enabled;
+        if( _pintchecker->GetCollisionOptions() & CO_ActiveDOFs ) {
+            adjacentoptions |= KinBody::AO_ActiveDOFs;
+        }
+        bool col = false;
+        if( (_pintchecker->GetCollisionOptions() & CO_Distance) || pbody->CheckSelfCollisionSpheres(adjacentoptions) ) {
+            col = _pintchecker->CheckStandaloneSelfCollision(pbody, report);
+        }
+        else {
+            report->Reset(_pintchecker->GetCollisionOptions());
+        }
         _selfrawtime += utils::GetMilliTime()-_stime;
 
+        uint64_t insertstarttime = utils::GetMicroTime();
         _stime = utils::GetMilliTime();
-        _selfcache->GetDOFValues(_dofvals);
         _selfcache->InsertConfiguration(_dofvals, !col ? CollisionReportPtr() : report, closestdist);
         _selfintime += utils::GetMilliTime()-_stime;
+        _selfcachestats.AddQuery(col ? CacheQueryStatistics::QR_MissCollision : CacheQueryStatistics::QR_MissFree, lookuptime, insertstarttime-rawstarttime, utils::GetMicroTime()-insertstarttime, _selfcache->GetNumNodes());
 
         return col;
     }
@@ -473,6 +686,23 @@ protected:
         return true;
     }
 
+    virtual bool _GetCacheStatisticsJSONCommand(std::ostream& sout, std::istream& sinput)
+    {
+        sout << "{\"cache\": ";
+        _cachestats.WriteJSON(sout, _cache);
+        sout << ", \"selfcache\": ";
+        _selfcachestats.WriteJSON(sout, _selfcache);
+        sout << "}";
+        return true;
+    }
+
+    virtual bool _ResetCacheStatisticsCommand(std::ostream& sout, std::istream& sinput)
+    {
+        _cachestats.Reset();
+        _selfcachestats.Reset();
+        return true;
+    }
+
     virtual bool _SetCacheParametersCommand(std::ostream& sout, std::istream& sinput)
     {
 
@@ -489,6 +719,25 @@ protected:
         return true;
     }
 
+    virtual bool _SetCacheApproximationCommand(std::ostream& sout, std::istream& sinput)
+    {
+        dReal errorfactor = 0;
+        int maxvisitednodes = 0;
+        std::string target;
+        sinput >> errorfactor >> maxvisitednodes;
+        if( !sinput ) {
+            return false;
+        }
+        sinput >> target;
+        ConfigurationCachePtr cache = target == "self" ? _selfcache : _cache;
+        if( !cache ) {
+            return false;
+        }
+        cache->SetApproximation(errorfactor, maxvisitednodes);
+        sout << cache->GetApproximationErrorFactor() << " " << cache->GetMaxVisitedNodes();
+        return true;
+    }
+
     virtual bool _SetSelfCacheParametersCommand(std::ostream& sout, std::istream& sinput)
     {
 
@@ -584,6 +833,196 @@ protected:
         return true;
     }
 
+    /// \brief robot copy labeling the configurations of _WarmSelfCacheCommand
+    struct WarmSnapshot
+    {
+        EnvironmentBasePtr penv;
+        RobotBasePtr probot;
+        CollisionCheckerBasePtr pchecker;
+    };
+
+    virtual bool _WarmSelfCacheCommand(std::ostream& sout, std::istream& sinput)
+    {
+        RobotBasePtr probot = GetRobot();
+        if( !probot || !_selfcache ) {
+            RAVELOG_WARN("need a tracked robot to warm the self cache\n");
+            return false;
+        }
+        int numthreads = 1, dof = probot->GetDOF();
+        dReal samplingstep = 0;
+        bool bsave = true;
+        std::vector<std::string> vtrajfilenames;
+        std::vector<dReal> vconfigs; // every dof values are one configuration
+        std::string cmd;
+        while(!!sinput) {
+            sinput >> cmd;
+            if( !sinput ) {
+                break;
+            }
+            std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
+            if( cmd == "numthreads" ) {
+                sinput >> numthreads;
+            }
+            else if( cmd == "trajectory" ) {
+                std::string filename;
+                sinput >> filename;
+                vtrajfilenames.push_back(filename);
+            }
+            else if( cmd == "configurations" ) {
+                int num = 0;
+                sinput >> num;
+                size_t offset = vconfigs.size();
+                vconfigs.resize(offset+num*dof);
+                for(size_t i = offset; i < vconfigs.size(); ++i) {
+                    sinput >> vconfigs[i];
+                }
+            }
+            else if( cmd == "samplingstep" ) {
+                sinput >> samplingstep;
+            }
+            else if( cmd == "save" ) {
+                sinput >> bsave;
+            }
+            else {
+                RAVELOG_WARN_FORMAT("unrecognized command: %s", cmd);
+                return false;
+            }
+            if( !sinput ) {
+                RAVELOG_WARN_FORMAT("failed processing command %s", cmd);
+                return false;
+            }
+        }
+
+        std::vector<int> vdofindices(dof);
+        for(int i = 0; i < dof; ++i) {
+            vdofindices[i] = i;
+        }
+        std::vector<dReal> vcurvalues, vdata;
+        probot->GetDOFValues(vcurvalues);
+        FOREACHC(itfilename, vtrajfilenames) {
+            std::ifstream f(itfilename->c_str());
+            if( !f ) {
+                RAVELOG_WARN_FORMAT("failed to open trajectory %s", *itfilename);
+                return false;
+            }
+            TrajectoryBasePtr ptraj = RaveCreateTrajectory(GetEnv(), "");
+            ptraj->deserialize(f);
+            const ConfigurationSpecification& spec = ptraj->GetConfigurationSpecification();
+            ptraj->GetWaypoints(0, ptraj->GetNumWaypoints(), vdata);
+            size_t numpoints = ptraj->GetNumWaypoints();
+            if( samplingstep > 0 && ptraj->GetDuration() > 0 ) {
+                // also cover the motion between the waypoints
+                std::vector<dReal> vsample;
+                for(dReal t = 0; t < ptraj->GetDuration(); t += samplingstep) {
+                    ptraj->Sample(vsample, t);
+                    vdata.insert(vdata.end(), vsample.begin(), vsample.end());
+                    ++numpoints;
+                }
+            }
+            for(size_t ipoint = 0; ipoint < numpoints; ++ipoint) {
+                size_t offset = vconfigs.size();
+                vconfigs.insert(vconfigs.end(), vcurvalues.begin(), vcurvalues.end());
+                spec.ExtractJointValues(vconfigs.begin()+offset, vdata.begin()+ipoint*spec.GetDOF(), probot, vdofindices, 0);
+            }
+        }
+
+        // only the configurations the cache does not know yet need the collision checker
+        size_t numconfigs = dof > 0 ? vconfigs.size()/dof : 0;
+        std::vector<size_t> vunknown;
+        std::vector<dReal> vconf(dof);
+        for(size_t iconfig = 0; iconfig < numconfigs; ++iconfig) {
+            std::copy(vconfigs.begin()+iconfig*dof, vconfigs.begin()+(iconfig+1)*dof, vconf.begin());
+            KinBody::LinkConstPtr robotlink, collidinglink;
+            dReal closestdist = 0;
+            if( _selfcache->CheckCollision(vconf, robotlink, collidinglink, closestdist) < 0 ) {
+                vunknown.push_back(iconfig);
+            }
+        }
+
+        numthreads = min(max(numthreads, 1), (int)vunknown.size());
+        std::vector<WarmSnapshot> vsnapshots(numthreads);
+        for(int ithread = 0; ithread < numthreads; ++ithread) {
+            WarmSnapshot& snapshot = vsnapshots[ithread];
+            snapshot.penv = GetEnv()->CloneSelf(Clone_Bodies);
+            EnvironmentMutex::scoped_lock lock(snapshot.penv->GetMutex());
+            snapshot.probot = snapshot.penv->GetRobot(probot->GetName());
+            snapshot.pchecker = RaveCreateCollisionChecker(snapshot.penv, _pintchecker->GetXMLId());
+            if( !snapshot.probot || !snapshot.pchecker ) {
+                RAVELOG_WARN_FORMAT("env=%d, failed to initialize snapshot %d for warming the self cache", GetEnv()->GetId()%ithread);
+                FOREACH(itsnapshot, vsnapshots) {
+                    if( !!itsnapshot->penv ) {
+                        itsnapshot->penv->Destroy();
+                    }
+                }
+                return false;
+            }
+            snapshot.pchecker->SetCollisionOptions(_pintchecker->GetCollisionOptions());
+            snapshot.penv->SetCollisionChecker(snapshot.pchecker);
+        }
+
+        std::vector<CollisionReportPtr> vreports(vunknown.size()); // empty if free
+        if( numthreads <= 1 ) {
+            _LabelConfigurationsRange(vsnapshots, vconfigs, vunknown, vreports, 0, vsnapshots.size());
+        }
+        else {
+            ParallelRangeWorkers workers(numthreads, "WarmSelfCache");
+            // one job per snapshot, each job labels a contiguous part of the configurations
+            workers.Run(numthreads, boost::bind(&CacheCollisionChecker::_LabelConfigurationsRange, this, boost::cref(vsnapshots), boost::cref(vconfigs), boost::cref(vunknown), boost::ref(vreports), _1, _2));
+        }
+
+        int numinserted = 0, numcollision = 0;
+        for(size_t i = 0; i < vunknown.size(); ++i) {
+            std::copy(vconfigs.begin()+vunknown[i]*dof, vconfigs.begin()+(vunknown[i]+1)*dof, vconf.begin());
+            CollisionReportPtr report = vreports[i];
+            if( !!report ) {
+                ++numcollision;
+                report->plink1 = _GetEnvironmentLink(report->plink1);
+                report->plink2 = _GetEnvironmentLink(report->plink2);
+            }
+            if( _selfcache->InsertConfiguration(vconf, report) ) {
+                ++numinserted;
+            }
+        }
+        vreports.clear();
+        FOREACH(itsnapshot, vsnapshots) {
+            itsnapshot->penv->Destroy();
+        }
+
+        if( bsave ) {
+            _selfcache->SaveCache(GetCacheHash());
+            _size = _selfcache->GetNumKnownNodes();
+        }
+        RAVELOG_DEBUG_FORMAT("env=%d, warmed self cache with %d/%d configurations, %d inserted, %d in collision", GetEnv()->GetId()%vunknown.size()%numconfigs%numinserted%numcollision);
+        sout << numconfigs << " " << vunknown.size() << " " << numinserted << " " << numcollision;
+        return true;
+    }
+
+    /// \brief labels the configurations of the snapshots [startsnapshot, endsnapshot) with their self collision reports
+    void _LabelConfigurationsRange(const std::vector<WarmSnapshot>& vsnapshots, const std::vector<dReal>& vconfigs, const std::vector<size_t>& vunknown, std::vector<CollisionReportPtr>& vreports, size_t startsnapshot, size_t endsnapshot)
+    {
+        size_t numsnapshots = vsnapshots.size();
+        for(size_t isnapshot = startsnapshot; isnapshot < endsnapshot; ++isnapshot) {
+            const WarmSnapshot& snapshot = vsnapshots[isnapshot];
+            EnvironmentMutex::scoped_lock lock(snapshot.penv->GetMutex());
+            int dof = snapshot.probot->GetDOF();
+            std::vector<dReal> vconf(dof);
+            int adjacentoptions = KinBody::AO_Enabled;
+            if( snapshot.pchecker->GetCollisionOptions() & CO_ActiveDOFs ) {
+                adjacentoptions |= KinBody::AO_ActiveDOFs;
+            }
+            CollisionReportPtr report(new CollisionReport());
+            for(size_t i = (vunknown.size()*isnapshot)/numsnapshots; i < (vunknown.size()*(isnapshot+1))/numsnapshots; ++i) {
+                std::copy(vconfigs.begin()+vunknown[i]*dof, vconfigs.begin()+(vunknown[i]+1)*dof, vconf.begin());
+                snapshot.probot->SetDOFValues(vconf, KinBody::CLA_Nothing);
+                // same test as a cache miss of CheckStandaloneSelfCollision
+                if( ((snapshot.pchecker->GetCollisionOptions() & CO_Distance) || snapshot.probot->CheckSelfCollisionSpheres(adjacentoptions)) && snapshot.pchecker->CheckStandaloneSelfCollision(snapshot.probot, report) ) {
+                    vreports[i] = report;
+                    report.reset(new CollisionReport());
+                }
+            }
+        }
+    }
+
     RobotBasePtr GetRobot()
     {
         if( !_probot && _strRobotName.size() > 0 ) {
@@ -596,6 +1035,19 @@ protected:
         return _probot;
     }
 
+    /// \brief returns the link of this checker's environment corresponding to plink, which could come from a shared cache of another environment
+    KinBody::LinkConstPtr _GetEnvironmentLink(KinBody::LinkConstPtr plink)
+    {
+        if( !plink || plink->GetParent()->GetEnv() == GetEnv() ) {
+            return plink;
+        }
+        KinBodyPtr pbody = GetEnv()->GetKinBody(plink->GetParent()->GetName());
+        if( !pbody || plink->GetIndex() >= (int)pbody->GetLinks().size() ) {
+            return KinBody::LinkConstPtr();
+        }
+        return pbody->GetLinks()[plink->GetIndex()];
+    }
+
     /// \brief generate a string to be used to save/load selfcollision cache. hash considers: robot, grabbed bodies, parameters for the cache, and DOF
     std::string GetCacheHash()
     {
@@ -625,12 +1077,15 @@ protected:
 
 
     // for testing, will remove soon (cloning collision checkers resets all parameters)
-    void _SetParams()
+    void _SetParams(bool bsetselfcache=true)
     {
         _cache->SetCollisionThresh(0.1);
         _cache->SetFreeSpaceThresh(0.1);
         _cache->SetInsertionDistanceMult(0.1);
         _cache->SetBase(2.0);
+        if( !bsetselfcache ) {
+            return;
+        }
 
         _selfcache->SetCollisionThresh(0.2);
         _selfcache->SetFreeSpaceThresh(0.3);
@@ -641,9 +1096,16 @@ protected:
     void _InitializeCache()
     {
         _cache.reset(new ConfigurationCache(_probot));
-        _selfcache.reset(new ConfigurationCache(_probot, false)); //envupdates should be disabled for self collision cache
-
-        _SetParams();
+        ConfigurationCachePtr psharedselfcache = _pSharedSelfCache.lock();
+        if( !!psharedselfcache && psharedselfcache->GetRobot()->GetRobotStructureHash() == _probot->GetRobotStructureHash() ) {
+            // setting the parameters would reset the shared nodes
+            _selfcache = psharedselfcache;
+            _SetParams(false);
+        }
+        else {
+            _selfcache.reset(new ConfigurationCache(_probot, false)); //envupdates should be disabled for self collision cache
+            _SetParams();
+        }
 
         _cachedcollisionchecks=0;
         _cachedcollisionhits=0;
@@ -673,6 +1135,7 @@ protected:
     std::vector<int> _dofindices;
     ConfigurationCachePtr _cache;
     ConfigurationCachePtr _selfcache;
+    boost::weak_ptr<ConfigurationCache> _pSharedSelfCache; ///< self cache of the checker this one was cloned from, shared once the robot is found
     CollisionCheckerBasePtr _pintchecker;
     std::string _strRobotName; ///< the robot name to track
     std::string __cachehash;
@@ -682,6 +1145,7 @@ protected:
     int _cachedcollisionchecks, _cachedcollisionhits, _cachedfreehits, _size;
     int _selfcachedcollisionchecks, _selfcachedcollisionhits, _selfcachedfreehits;
     uint64_t _stime, _ftime, _intime, _querytime, _loadtime, _savetime, _rawtime, _resettime, _selfintime, _selfquerytime, _selfrawtime;
+    CacheQueryStatistics _cachestats, _selfcachestats; ///< statistics of the queries that went to _cache and _selfcache
     stringstream _ss;
     ostringstream _oss;
 
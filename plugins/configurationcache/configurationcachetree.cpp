@@ -17,6 +17,8 @@
 #include <boost/lexical_cast.hpp>
 
 #include <boost/multi_array.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #include <algorithm>
 
 using boost::multi_array;
@@ -106,12 +108,17 @@ void CacheTreeNode::SetCollisionInfo(int robotlinkindex, int type)
 
 CacheTree::CacheTree(int statedof)
 {
-    _poolNodes.reset(new boost::pool<>(sizeof(CacheTreeNode)+sizeof(dReal)*statedof));
+    _statedof = statedof;
+    _numlinkspheres = 0;
+    _poolNodes.reset(new boost::pool<>(_GetNodeMemorySize()));
     _vnodes.resize(0);
     _dummycs.resize(0);
     _fulldirname.resize(0);
     _mapNodeIndices.clear();
     _collidingbodyname.resize(0);
+    _fApproxErrorFactor = 0;
+    _fApproxStopMult = 0;
+    _nMaxVisitedNodes = 0;
 
     _statedof=statedof;
     _weights.resize(_statedof, 1.0);
@@ -167,7 +174,7 @@ void CacheTree::Reset()
     }
     // purge_memory leaks!
     //_poolNodes.purge_memory();
-    _poolNodes.reset(new boost::pool<>(sizeof(CacheTreeNode)+sizeof(dReal)*_statedof));
+    _poolNodes.reset(new boost::pool<>(_GetNodeMemorySize()));
     //_pNodesPool.reset(new boost::pool<>(sizeof(Node)+_dof*sizeof(dReal)));
     _numnodes = 0;
 }
@@ -176,7 +183,7 @@ void CacheTree::Reset()
 static int s_CacheTreeId = 0;
 #endif
 
-CacheTreeNodePtr CacheTree::_CreateCacheTreeNode(const std::vector<dReal>& cs, CollisionReportPtr report)
+CacheTreeNodePtr CacheTree::_CreateCacheTreeNode(const std::vector<dReal>& cs, CollisionReportPtr report, const Vector* plinkspheres)
 {
     // allocate memory for the structure and the internal state vectors
     void* pmemory;
@@ -184,8 +191,10 @@ CacheTreeNodePtr CacheTree::_CreateCacheTreeNode(const std::vector<dReal>& cs, C
         //boost::mutex::scoped_lock lock(_mutexpool);
         pmemory = _poolNodes->malloc();
     }
-    //Vector* plinkspheres = (Vector*)((uint8_t*)pmemory + sizeof(CacheTreeNode) + sizeof(dReal)*_statedof);
-    CacheTreeNodePtr newnode = new (pmemory) CacheTreeNode(cs, NULL);
+    CacheTreeNodePtr newnode = new (pmemory) CacheTreeNode(cs, !!plinkspheres ? _GetLinkSpheresMemory(pmemory) : NULL);
+    if( !!newnode->_plinkspheres ) {
+        std::copy(plinkspheres, plinkspheres+_numlinkspheres, newnode->_plinkspheres);
+    }
 #ifdef _DEBUG
     newnode->id = s_CacheTreeId++;
 #endif
@@ -201,8 +210,11 @@ CacheTreeNodePtr CacheTree::_CloneCacheTreeNode(CacheTreeNodeConstPtr refnode)
         //boost::mutex::scoped_lock lock(_mutexpool);
         pmemory = _poolNodes->malloc();
     }
-    //Vector* plinkspheres = (Vector*)((uint8_t*)pmemory + sizeof(CacheTreeNode) + sizeof(dReal)*_statedof);
-    CacheTreeNodePtr clonenode = new (pmemory) CacheTreeNode(refnode->GetConfigurationState(), _statedof, refnode->_plinkspheres);
+    CacheTreeNodePtr clonenode = new (pmemory) CacheTreeNode(refnode->GetConfigurationState(), _statedof, !!refnode->_plinkspheres ? _GetLinkSpheresMemory(pmemory) : NULL);
+    if( !!clonenode->_plinkspheres ) {
+        // the clone outlives the reference node when it is removed, so it keeps its own copy
+        std::copy(refnode->_plinkspheres, refnode->_plinkspheres+_numlinkspheres, clonenode->_plinkspheres);
+    }
 #ifdef _DEBUG
     clonenode->id = s_CacheTreeId++;
 #endif
@@ -238,6 +250,16 @@ dReal CacheTree::_ComputeDistance2(const dReal* cstatei, const dReal* cstatef) c
     return distance;
 }
 
+CacheTree::QueryCache& CacheTree::_GetQueryCache() const
+{
+    QueryCache* pquerycache = _querycache.get();
+    if( !pquerycache ) {
+        pquerycache = new QueryCache();
+        _querycache.reset(pquerycache);
+    }
+    return *pquerycache;
+}
+
 void CacheTree::SetWeights(const std::vector<dReal>& weights)
 {
     Reset();
@@ -274,6 +296,13 @@ void CacheTree::SetBase(dReal base)
     }
 }
 
+void CacheTree::SetApproximation(dReal errorfactor, int maxvisitednodes)
+{
+    _fApproxErrorFactor = max(errorfactor, dReal(0));
+    _fApproxStopMult = _fApproxErrorFactor > 0 ? 1+1/_fApproxErrorFactor : 0;
+    _nMaxVisitedNodes = max(maxvisitednodes, 0);
+}
+
 std::pair<CacheTreeNodeConstPtr, dReal> CacheTree::FindNearestNode(const std::vector<dReal>& vquerystate, dReal distancebound, ConfigurationNodeType conftype) const
 {
     if( _numnodes == 0 ) {
@@ -289,17 +318,20 @@ std::pair<CacheTreeNodeConstPtr, dReal> CacheTree::FindNearestNode(const std::ve
     int currentlevel = _maxlevel; // where the root node is
     // traverse all levels gathering up the children at each level
     dReal fLevelBound2 = Sqr(_fMaxLevelBound);
-    _vCurrentLevelNodes.resize(1);
-    _vCurrentLevelNodes[0].first = *_vsetLevelNodes.at(_EncodeLevel(_maxlevel)).begin();
-    _vCurrentLevelNodes[0].second = _ComputeDistance2(pquerystate, _vCurrentLevelNodes[0].first->GetConfigurationState());
-    if( (conftype == CNT_Any || _vCurrentLevelNodes[0].first->GetType() == conftype) && _vCurrentLevelNodes[0].first->_usenn ) {
-        pbestnode = _vCurrentLevelNodes[0].first;
-        bestdist2 = _vCurrentLevelNodes[0].second;
-    }
-    while(_vCurrentLevelNodes.size() > 0 ) {
-        _vNextLevelNodes.resize(0);
+    QueryCache& querycache = _GetQueryCache();
+    std::vector< std::pair<CacheTreeNodePtr, dReal> >& vCurrentLevelNodes = querycache._vCurrentLevelNodes;
+    std::vector< std::pair<CacheTreeNodePtr, dReal> >& vNextLevelNodes = querycache._vNextLevelNodes;
+    vCurrentLevelNodes.resize(1);
+    vCurrentLevelNodes[0].first = *_vsetLevelNodes.at(_EncodeLevel(_maxlevel)).begin();
+    vCurrentLevelNodes[0].second = _ComputeDistance2(pquerystate, vCurrentLevelNodes[0].first->GetConfigurationState());
+    if( (conftype == CNT_Any || vCurrentLevelNodes[0].first->GetType() == conftype) && vCurrentLevelNodes[0].first->_usenn ) {
+        pbestnode = vCurrentLevelNodes[0].first;
+        bestdist2 = vCurrentLevelNodes[0].second;
+    }
+    while(vCurrentLevelNodes.size() > 0 ) {
+        vNextLevelNodes.resize(0);
         dReal minchilddist2 = std::numeric_limits<dReal>::infinity();
-        FOREACH(itcurrentnode, _vCurrentLevelNodes) {
+        FOREACH(itcurrentnode, vCurrentLevelNodes) {
             // only take the children whose distances are within the bound
             FOREACHC(itchild, itcurrentnode->first->_vchildren) {
                 dReal curdist2 = _ComputeDistance2(pquerystate, (*itchild)->GetConfigurationState());
@@ -308,27 +340,26 @@ std::pair<CacheTreeNodeConstPtr, dReal> CacheTree::FindNearestNode(const std::ve
                         bestdist2 = curdist2;
                         pbestnode = *itchild;
                         if( distancebound > 0 && bestdist2 <= distancebound2 ) {
-                            (*itchild)->IncreaseHitCount();
                             return make_pair(pbestnode, RaveSqrt(bestdist2));
                         }
                     }
                 }
-                _vNextLevelNodes.push_back(make_pair(*itchild, curdist2));
+                vNextLevelNodes.push_back(make_pair(*itchild, curdist2));
                 if( minchilddist2 > curdist2 ) {
                     minchilddist2 = curdist2;
                 }
             }
         }
 
-        _vCurrentLevelNodes.resize(0);
+        vCurrentLevelNodes.resize(0);
         // have to compute dist < RaveSqrt(minchilddist2) + fLevelBound
         // dist2 < m2 + 2mL + L2
 
         dReal ftestbound2 = 4*minchilddist2*fLevelBound2;
-        FOREACH(itnode, _vNextLevelNodes) {
+        FOREACH(itnode, vNextLevelNodes) {
             dReal f = itnode->second - minchilddist2 - fLevelBound2;
             if( f <= 0 || Sqr(f) <= ftestbound2 ) {
-                _vCurrentLevelNodes.push_back(*itnode);
+                vCurrentLevelNodes.push_back(*itnode);
             }
         }
         currentlevel -= 1;
@@ -341,11 +372,16 @@ std::pair<CacheTreeNodeConstPtr, dReal> CacheTree::FindNearestNode(const std::ve
     return make_pair(CacheTreeNodeConstPtr(), dReal(0));
 }
 
-std::pair<CacheTreeNodeConstPtr, dReal> CacheTree::FindNearestNode(const std::vector<dReal>& vquerystate, dReal collisionthresh, dReal freespacethresh) const
+std::pair<CacheTreeNodeConstPtr, dReal> CacheTree::FindNearestNode(const std::vector<dReal>& vquerystate, dReal collisionthresh, dReal freespacethresh, CacheTreeQueryInfo* pinfo) const
 {
     std::pair<CacheTreeNodeConstPtr, dReal> bestnode;
     bestnode.first = NULL;
     bestnode.second = std::numeric_limits<dReal>::infinity();
+    int numvisited = 0;
+    if( !!pinfo ) {
+        pinfo->numvisited = 0;
+        pinfo->bAborted = false;
+    }
     if( _numnodes == 0 ) {
         return bestnode;
     }
@@ -358,13 +394,19 @@ std::pair<CacheTreeNodeConstPtr, dReal> CacheTree::FindNearestNode(const std::ve
     // traverse all levels gathering up the children at each level
     int currentlevel = _maxlevel; // where the root node is
     dReal fLevelBound = _fMaxLevelBound;
+    QueryCache& querycache = _GetQueryCache();
+    std::vector< std::pair<CacheTreeNodePtr, dReal> >& vCurrentLevelNodes = querycache._vCurrentLevelNodes;
+    std::vector< std::pair<CacheTreeNodePtr, dReal> >& vNextLevelNodes = querycache._vNextLevelNodes;
     {
         CacheTreeNodePtr proot = *_vsetLevelNodes.at(_EncodeLevel(_maxlevel)).begin();
         dReal curdist2 = _ComputeDistance2(pquerystate, proot->GetConfigurationState());
+        ++numvisited;
         if( proot->_usenn ) {
             ConfigurationNodeType cntype = proot->GetType();
             if( cntype == CNT_Collision && curdist2 <= collisionthresh2 ) {
-                proot->_hitcount++;
+                if( !!pinfo ) {
+                    pinfo->numvisited = numvisited;
+                }
                 return make_pair(proot,RaveSqrt(curdist2));
             }
             else if( cntype == CNT_Free && curdist2 <= freespacethresh2 ) {
@@ -372,26 +414,37 @@ std::pair<CacheTreeNodeConstPtr, dReal> CacheTree::FindNearestNode(const std::ve
                 bestnode = make_pair(proot,RaveSqrt(curdist2));
             }
         }
-        _vCurrentLevelNodes.resize(1);
-        _vCurrentLevelNodes[0].first = proot;
-        _vCurrentLevelNodes[0].second = curdist2;
+        vCurrentLevelNodes.resize(1);
+        vCurrentLevelNodes[0].first = proot;
+        vCurrentLevelNodes[0].second = curdist2;
     }
-    dReal pruneradius2 = Sqr(_maxdistance); // the radius to prune all _vCurrentLevelNodes when going through them. Equivalent to min(query,children) + levelbound from the previous iteration
-    while(_vCurrentLevelNodes.size() > 0 ) {
-        _vNextLevelNodes.resize(0);
+    dReal pruneradius2 = Sqr(_maxdistance); // the radius to prune all vCurrentLevelNodes when going through them. Equivalent to min(query,children) + levelbound from the previous iteration
+    while(vCurrentLevelNodes.size() > 0 ) {
+        vNextLevelNodes.resize(0);
         dReal minchilddist=_maxdistance;
-        FOREACH(itcurrentnode, _vCurrentLevelNodes) {
+        FOREACH(itcurrentnode, vCurrentLevelNodes) {
             if( itcurrentnode->second > pruneradius2 ) {
                 continue;
             }
             dReal comparedist2 = Sqr(minchilddist + fLevelBound);
             // only take the children whose distances are within the bound
             FOREACHC(itchild, itcurrentnode->first->_vchildren) {
+                if( _nMaxVisitedNodes > 0 && numvisited >= _nMaxVisitedNodes ) {
+                    // give up quickly, the caller falls back to the real collision checker
+                    if( !!pinfo ) {
+                        pinfo->numvisited = numvisited;
+                        pinfo->bAborted = true;
+                    }
+                    return make_pair(CacheTreeNodeConstPtr(), dReal(0));
+                }
                 dReal curdist2 = _ComputeDistance2(pquerystate, (*itchild)->GetConfigurationState());
+                ++numvisited;
                 if( (*itchild)->_usenn ) {
                     ConfigurationNodeType cntype = (*itchild)->GetType();
                     if( cntype == CNT_Collision && curdist2 <= collisionthresh2 ) {
-                        (*itchild)->_hitcount++;
+                        if( !!pinfo ) {
+                            pinfo->numvisited = numvisited;
+                        }
                         return make_pair(*itchild, RaveSqrt(curdist2));
                     }
                     else if( cntype == CNT_Free && curdist2 <= freespacethresh2 ) {
@@ -402,7 +455,7 @@ std::pair<CacheTreeNodeConstPtr, dReal> CacheTree::FindNearestNode(const std::ve
                     }
                 }
                 if( curdist2 < comparedist2 ) {
-                    _vNextLevelNodes.push_back(make_pair(*itchild, curdist2));
+                    vNextLevelNodes.push_back(make_pair(*itchild, curdist2));
                     if( Sqr(minchilddist) > curdist2 ) {
                         minchilddist = RaveSqrt(curdist2);
                         comparedist2 = Sqr(minchilddist + fLevelBound);
@@ -411,11 +464,18 @@ std::pair<CacheTreeNodeConstPtr, dReal> CacheTree::FindNearestNode(const std::ve
             }
         }
 
-        _vCurrentLevelNodes.swap(_vNextLevelNodes);
+        if( _fApproxStopMult > 0 && fLevelBound*_fApproxStopMult <= minchilddist ) {
+            // the levels below cannot hold a node much closer than minchilddist
+            break;
+        }
+        vCurrentLevelNodes.swap(vNextLevelNodes);
         pruneradius2 = Sqr(minchilddist + fLevelBound);
         currentlevel -= 1;
         fLevelBound *= _fBaseInv;
     }
+    if( !!pinfo ) {
+        pinfo->numvisited = numvisited;
+    }
     // if here, then either found a free node within the bounds, or could not find any nodes
     // failed radius search, so should return empty
     if( !!bestnode.first ) {
@@ -424,11 +484,11 @@ std::pair<CacheTreeNodeConstPtr, dReal> CacheTree::FindNearestNode(const std::ve
     return bestnode;
 }
 
-int CacheTree::InsertNode(const std::vector<dReal>& cs, CollisionReportPtr report, dReal fMinSeparationDist)
+int CacheTree::InsertNode(const std::vector<dReal>& cs, CollisionReportPtr report, dReal fMinSeparationDist, const Vector* plinkspheres)
 {
 
     OPENRAVE_ASSERT_OP(cs.size(),==,_weights.size());
-    CacheTreeNodePtr nodein = _CreateCacheTreeNode(cs, report);
+    CacheTreeNodePtr nodein = _CreateCacheTreeNode(cs, report, !report ? plinkspheres : NULL);
     // if there is no root, make this the root, otherwise call the lowlevel  insert
     if( _numnodes == 0 ) {
         // no root
@@ -764,6 +824,20 @@ void CacheTree::GetNodeValues(std::vector<dReal>& vals) const
     }
 }
 
+void CacheTree::GetLevelNodeCounts(std::vector< std::pair<int, int> >& vlevelcounts) const
+{
+    vlevelcounts.resize(0);
+    if( _numnodes == 0 ) {
+        return;
+    }
+    for(int level = _maxlevel; level >= _minlevel; --level) {
+        int enclevel = _EncodeLevel(level);
+        if( enclevel < (int)_vsetLevelNodes.size() && _vsetLevelNodes[enclevel].size() > 0 ) {
+            vlevelcounts.push_back(std::make_pair(level, (int)_vsetLevelNodes[enclevel].size()));
+        }
+    }
+}
+
 void CacheTree::GetNodeValuesList(std::vector<CacheTreeNodePtr>& lvals)
 {
     lvals.resize(0);
@@ -788,76 +862,139 @@ int CacheTree::RemoveCollisionConfigurations()
     return nremoved;
 }
 
+/// \brief header of the cache file. The file is laid out so that it can be memory mapped: the header is followed by contiguous arrays at the stored offsets.
+struct CacheFileHeader
+{
+    char magic[8]; ///< s_CacheFileMagic
+    uint32_t version; ///< s_CacheFileVersion
+    uint32_t realsize; ///< sizeof(dReal) of the process that wrote the file
+    int32_t statedof;
+    int32_t numnodes;
+    int32_t numchildindices; ///< total number of children of all nodes
+    int32_t maxlevel, minlevel;
+    dReal base, maxdistance, fMaxLevelBound;
+    uint64_t offsetweights; ///< statedof dReals
+    uint64_t offsetnodes; ///< numnodes CacheFileNode
+    uint64_t offsetstates; ///< numnodes*statedof dReals
+    uint64_t offsetchildren; ///< numchildindices int32_t node indices
+    uint64_t offsetnames, sizenames; ///< null-terminated names of the colliding bodies
+    char hash[64]; ///< the cache hash the file was saved with, null-terminated
+};
+
+/// \brief per node record of the cache file
+struct CacheFileNode
+{
+    int16_t level;
+    uint8_t hasselfchild;
+    uint8_t usenn;
+    int32_t conftype;
+    int32_t robotlinkindex;
+    int32_t collidingbodyname; ///< offset into the names, -1 if not in collision
+    int32_t collidinglinkindex;
+    int32_t childoffset; ///< index of the first child into the children array
+    int32_t numchildren;
+    int32_t reserved; ///< keeps the records and the states following them 8-byte aligned
+};
+
+static const char s_CacheFileMagic[8] = {'O','R','C','T','R','E','E','\0'};
+static const uint32_t s_CacheFileVersion = 1;
+
 int CacheTree::SaveCache(std::string filename)
 {
     //boost::mutex::scoped_lock lock(_mutexpool);
     _mapNodeIndices.clear();
     int index=0;
-    int knownnodes=0;
+    int numchildindices=0;
     FOREACH(itlevelnodes, _vsetLevelNodes) {
         FOREACH(itnode, *itlevelnodes) {
-            if( (*itnode)->_conftype != CNT_Unknown) {
-                knownnodes++;
-            }
             _mapNodeIndices[*itnode] = index++;
+            numchildindices += (*itnode)->_vchildren.size();
         }
     }
 
-    _numnodes = knownnodes;
-    _fulldirname = RaveFindDatabaseFile(std::string("selfcache.")+filename,false);
-
-    RAVELOG_DEBUG_FORMAT("Writing cache to %s, size=%d", _fulldirname%_numnodes);
-    
-    FILE* pfile;
-    pfile = fopen(_fulldirname.c_str(),"wb");
-
-    fwrite(&_statedof, sizeof(_statedof), 1, pfile);
-    fwrite(&_weights[0], sizeof(_weights[0])*_weights.size(), 1, pfile);
-    fwrite(&_base, sizeof(_base), 1, pfile);
-    fwrite(&_fBaseInv, sizeof(_fBaseInv), 1, pfile);
-    fwrite(&_fBaseInv2, sizeof(_fBaseInv2), 1, pfile);
-    fwrite(&_fBaseChildMult, sizeof(_fBaseChildMult), 1, pfile);
-    fwrite(&_maxdistance, sizeof(_maxdistance), 1, pfile);
-    fwrite(&_maxlevel, sizeof(_maxlevel), 1, pfile);
-    fwrite(&_minlevel, sizeof(_minlevel), 1, pfile);
-    fwrite(&_numnodes, sizeof(_numnodes), 1, pfile);
-    fwrite(&_fMaxLevelBound, sizeof(_fMaxLevelBound), 1, pfile);
-
+    std::vector<CacheFileNode> vfilenodes(index);
+    std::vector<dReal> vstates(index*_statedof);
+    std::vector<int32_t> vchildren; vchildren.reserve(numchildindices);
+    std::string names;
+    std::map<std::string, int32_t> mapNameOffsets;
     FOREACH(itlevelnodes, _vsetLevelNodes) {
         FOREACH(itnode, *itlevelnodes) {
             _newnode = *itnode;
-            // TODO save only configuration != CNT_Unknown without losing the validity of the tree
-            if (true) { //_newnode->_conftype != CNT_Unknown) {
-                fwrite(&_newnode->_level, sizeof(_newnode->_level), 1, pfile);
-                fwrite(_newnode->GetConfigurationState(), sizeof(dReal)*_statedof, 1, pfile);
-                fwrite(&_newnode->_conftype, sizeof(_newnode->_conftype), 1, pfile);
-
-                if (_newnode->_conftype == CNT_Collision ) {
-                    // note, this assumes the colliding body name never changes across environments, which is a false assumption
-                    _collidingbodyname = _newnode->GetCollidingLink()->GetParent()->GetName();
-                    int namelength = _collidingbodyname.size();
-                    fwrite(&namelength, sizeof(namelength), 1, pfile);
-                    fwrite(_collidingbodyname.c_str(), _collidingbodyname.size(), 1, pfile);
-                    int linkindex = _newnode->GetCollidingLink()->GetIndex();
-                    fwrite(&linkindex, sizeof(linkindex), 1, pfile);
-                    fwrite(&_newnode->_robotlinkindex, sizeof(_newnode->_robotlinkindex), 1, pfile);
-                }
-
-                fwrite(&_newnode->_hasselfchild, sizeof(_newnode->_hasselfchild), 1, pfile);
-                fwrite(&_newnode->_usenn, sizeof(_newnode->_usenn), 1, pfile);
-                int numchildren = _newnode->_vchildren.size();
-                fwrite(&numchildren, sizeof(numchildren), 1, pfile);
-
-                FOREACHC(itchild, (*itnode)->_vchildren) {
-                    int cindex = _mapNodeIndices[*itchild];
-                    fwrite(&cindex, sizeof(cindex), 1, pfile);
+            int inode = _mapNodeIndices[_newnode];
+            CacheFileNode& filenode = vfilenodes[inode];
+            filenode.level = _newnode->_level;
+            filenode.hasselfchild = _newnode->_hasselfchild;
+            filenode.usenn = _newnode->_usenn;
+            filenode.conftype = _newnode->_conftype;
+            filenode.robotlinkindex = _newnode->_robotlinkindex;
+            filenode.collidingbodyname = -1;
+            filenode.collidinglinkindex = -1;
+            filenode.reserved = 0;
+            if( _newnode->_conftype == CNT_Collision && !!_newnode->_collidinglink ) {
+                // note, this assumes the colliding body name never changes across environments, which is a false assumption
+                _collidingbodyname = _newnode->GetCollidingLink()->GetParent()->GetName();
+                std::map<std::string, int32_t>::iterator itname = mapNameOffsets.find(_collidingbodyname);
+                if( itname == mapNameOffsets.end() ) {
+                    itname = mapNameOffsets.insert(make_pair(_collidingbodyname, (int32_t)names.size())).first;
+                    names += _collidingbodyname;
+                    names.push_back('\0');
                 }
+                filenode.collidingbodyname = itname->second;
+                filenode.collidinglinkindex = _newnode->GetCollidingLink()->GetIndex();
+            }
+            std::copy(_newnode->GetConfigurationState(), _newnode->GetConfigurationState()+_statedof, vstates.begin()+inode*_statedof);
+            filenode.childoffset = vchildren.size();
+            filenode.numchildren = _newnode->_vchildren.size();
+            FOREACHC(itchild, _newnode->_vchildren) {
+                vchildren.push_back(_mapNodeIndices[*itchild]);
             }
         }
     }
+    _mapNodeIndices.clear();
 
-    fclose(pfile);
+    CacheFileHeader header;
+    memset(&header, 0, sizeof(header));
+    std::copy(s_CacheFileMagic, s_CacheFileMagic+sizeof(s_CacheFileMagic), header.magic);
+    header.version = s_CacheFileVersion;
+    header.realsize = sizeof(dReal);
+    header.statedof = _statedof;
+    header.numnodes = index;
+    header.numchildindices = vchildren.size();
+    header.maxlevel = _maxlevel;
+    header.minlevel = _minlevel;
+    header.base = _base;
+    header.maxdistance = _maxdistance;
+    header.fMaxLevelBound = _fMaxLevelBound;
+    header.offsetweights = sizeof(header);
+    header.offsetnodes = header.offsetweights + sizeof(dReal)*_statedof;
+    header.offsetstates = header.offsetnodes + sizeof(CacheFileNode)*vfilenodes.size();
+    header.offsetchildren = header.offsetstates + sizeof(dReal)*vstates.size();
+    header.offsetnames = header.offsetchildren + sizeof(int32_t)*vchildren.size();
+    header.sizenames = names.size();
+    strncpy(header.hash, filename.c_str(), sizeof(header.hash)-1);
 
+    _fulldirname = RaveFindDatabaseFile(std::string("selfcache.")+filename,false);
+    RAVELOG_DEBUG_FORMAT("Writing cache to %s, size=%d", _fulldirname%index);
+
+    // write to a temporary file and rename it, so that processes mapping the cache never see a partially written file
+    std::string tempfilename = str(boost::format("%s.%d.tmp")%_fulldirname%utils::GetMicroTime());
+    FILE* pfile = fopen(tempfilename.c_str(),"wb");
+    if( !pfile ) {
+        RAVELOG_WARN_FORMAT("failed to open %s for writing the cache", tempfilename);
+        return 0;
+    }
+    bool bsuccess = fwrite(&header, sizeof(header), 1, pfile) == 1;
+    bsuccess &= _statedof == 0 || fwrite(&_weights[0], sizeof(dReal)*_statedof, 1, pfile) == 1;
+    bsuccess &= vfilenodes.size() == 0 || fwrite(&vfilenodes[0], sizeof(CacheFileNode)*vfilenodes.size(), 1, pfile) == 1;
+    bsuccess &= vstates.size() == 0 || fwrite(&vstates[0], sizeof(dReal)*vstates.size(), 1, pfile) == 1;
+    bsuccess &= vchildren.size() == 0 || fwrite(&vchildren[0], sizeof(int32_t)*vchildren.size(), 1, pfile) == 1;
+    bsuccess &= names.size() == 0 || fwrite(names.c_str(), names.size(), 1, pfile) == 1;
+    bsuccess &= fclose(pfile) == 0;
+    if( !bsuccess || rename(tempfilename.c_str(), _fulldirname.c_str()) != 0 ) {
+        RAVELOG_WARN_FORMAT("failed to write the cache to %s", _fulldirname);
+        remove(tempfilename.c_str());
+        return 0;
+    }
     return 1;
 }
 
@@ -866,86 +1003,106 @@ int CacheTree::LoadCache(std::string filename, EnvironmentBasePtr penv)
     //boost::mutex::scoped_lock lock(_mutexpool);
     _fulldirname = RaveFindDatabaseFile(std::string("selfcache.")+filename,false);
 
-    FILE* pfile = fopen(_fulldirname.c_str(),"rb");
-    size_t outs;
+    // map the file read-only so that the pages are shared between all the processes loading the same cache
+    boost::interprocess::file_mapping filemapping;
+    boost::interprocess::mapped_region region;
+    try {
+        boost::interprocess::file_mapping(_fulldirname.c_str(), boost::interprocess::read_only).swap(filemapping);
+        boost::interprocess::mapped_region(filemapping, boost::interprocess::read_only).swap(region);
+    }
+    catch(const boost::interprocess::interprocess_exception&) {
+        // no cache saved yet
+        return 0;
+    }
 
-    if (!pfile) {
+    const uint8_t* pdata = static_cast<const uint8_t*>(region.get_address());
+    size_t datasize = region.get_size();
+    if( datasize < sizeof(CacheFileHeader) ) {
+        RAVELOG_WARN_FORMAT("cache file %s is too small, ignoring", _fulldirname);
+        return 0;
+    }
+    const CacheFileHeader& header = *reinterpret_cast<const CacheFileHeader*>(pdata);
+    if( !std::equal(s_CacheFileMagic, s_CacheFileMagic+sizeof(s_CacheFileMagic), header.magic) || header.version != s_CacheFileVersion || header.realsize != sizeof(dReal) ) {
+        RAVELOG_WARN_FORMAT("cache file %s has an unsupported format, ignoring", _fulldirname);
+        return 0;
+    }
+    if( filename.compare(0, sizeof(header.hash)-1, std::string(header.hash, strnlen(header.hash, sizeof(header.hash)))) != 0 ) {
+        RAVELOG_WARN_FORMAT("cache file %s was saved for hash %s, ignoring", _fulldirname%std::string(header.hash, strnlen(header.hash, sizeof(header.hash))));
+        return 0;
+    }
+    if( header.statedof <= 0 || header.numnodes < 0 || header.numchildindices < 0 || header.offsetnames + header.sizenames > datasize ) {
+        RAVELOG_WARN_FORMAT("cache file %s is truncated, ignoring", _fulldirname);
         return 0;
     }
 
     Reset();
-    outs = fread(&_statedof, sizeof(_statedof), 1, pfile);
-
-    _weights.resize(_statedof,1.0);
+    _statedof = header.statedof;
+    _weights.resize(_statedof);
     _curconf.resize(_statedof,1.0);
-    outs = fread(&_weights[0], sizeof(_weights[0])*_weights.size(), 1, pfile);
-
-    outs = fread(&_base, sizeof(_base), 1, pfile);
-    outs = fread(&_fBaseInv, sizeof(_fBaseInv), 1, pfile);
-    outs = fread(&_fBaseInv2, sizeof(_fBaseInv2), 1, pfile);
-    outs = fread(&_fBaseChildMult, sizeof(_fBaseChildMult), 1, pfile);
-    outs = fread(&_maxdistance, sizeof(_maxdistance), 1, pfile);
-    outs = fread(&_maxlevel, sizeof(_maxlevel), 1, pfile);
-    outs = fread(&_minlevel, sizeof(_minlevel), 1, pfile);
-    outs = fread(&_numnodes, sizeof(_numnodes), 1, pfile);
-    outs = fread(&_fMaxLevelBound, sizeof(_fMaxLevelBound), 1, pfile);
+    const dReal* pweights = reinterpret_cast<const dReal*>(pdata + header.offsetweights);
+    std::copy(pweights, pweights+_statedof, _weights.begin());
+    _poolNodes.reset(new boost::pool<>(_GetNodeMemorySize()));
+
+    _base = header.base;
+    _fBaseInv = 1/_base;
+    _fBaseInv2 = 1/Sqr(_base);
+    _fBaseChildMult = 1/(_base-1);
+    _maxdistance = header.maxdistance;
+    _maxlevel = header.maxlevel;
+    _minlevel = header.minlevel;
+    _fMaxLevelBound = header.fMaxLevelBound;
 
     int maxenclevel = max(_EncodeLevel(_maxlevel), _EncodeLevel(_minlevel));
     _vsetLevelNodes.resize(maxenclevel+1);
 
-    _vnodes.resize(_numnodes);
-    _dummycs.resize(_statedof, 0);
-
-    for(int i = 0; i < _numnodes; ++i) {
-        _vnodes[i] = _CreateCacheTreeNode(_dummycs, CollisionReportPtr());
-    }
-
-    for (int inode = 0; inode < _numnodes; ++inode)
-    {
-        _newnode = _vnodes.at(inode);
-        outs = fread(&_newnode->_level, sizeof(_newnode->_level), 1, pfile);
-        outs = fread(_newnode->_pcstate, sizeof(dReal)*_statedof, 1, pfile);
-        outs = fread(&_newnode->_conftype, sizeof(_newnode->_conftype), 1, pfile);
-
-        if( _newnode->_conftype == CNT_Collision ) {
-            int namelength;
-            outs = fread(&namelength, sizeof(namelength), 1, pfile);
-            _collidingbodyname.resize(namelength);
-            outs = fread(&_collidingbodyname[0], namelength, 1, pfile);
-            int collidinglinkindex;
-            outs = fread(&collidinglinkindex, sizeof(collidinglinkindex), 1, pfile);
-            _pcollidingbody = penv->GetKinBody(_collidingbodyname);
-            if( !_pcollidingbody ) {
-                RAVELOG_WARN_FORMAT("loading cache expected colliding body %s, but none found", _collidingbodyname);
+    const CacheFileNode* pfilenodes = reinterpret_cast<const CacheFileNode*>(pdata + header.offsetnodes);
+    const dReal* pstates = reinterpret_cast<const dReal*>(pdata + header.offsetstates);
+    const int32_t* pchildren = reinterpret_cast<const int32_t*>(pdata + header.offsetchildren);
+    const char* pnames = reinterpret_cast<const char*>(pdata + header.offsetnames);
+
+    _vnodes.resize(header.numnodes);
+    for(int inode = 0; inode < header.numnodes; ++inode) {
+        _vnodes[inode] = new (_poolNodes->malloc()) CacheTreeNode(pstates + inode*_statedof, _statedof, NULL);
+    }
+
+    // the colliding bodies are looked up once per name
+    std::map<int32_t, KinBodyPtr> mapCollidingBodies;
+    for(int inode = 0; inode < header.numnodes; ++inode) {
+        const CacheFileNode& filenode = pfilenodes[inode];
+        _newnode = _vnodes[inode];
+        _newnode->_level = filenode.level;
+        _newnode->_hasselfchild = filenode.hasselfchild;
+        _newnode->_usenn = filenode.usenn;
+        _newnode->_conftype = static_cast<ConfigurationNodeType>(filenode.conftype);
+        _newnode->_robotlinkindex = filenode.robotlinkindex;
+        if( filenode.collidingbodyname >= 0 && filenode.collidingbodyname < (int32_t)header.sizenames ) {
+            std::map<int32_t, KinBodyPtr>::iterator itbody = mapCollidingBodies.find(filenode.collidingbodyname);
+            if( itbody == mapCollidingBodies.end() ) {
+                _collidingbodyname = pnames + filenode.collidingbodyname;
+                _pcollidingbody = penv->GetKinBody(_collidingbodyname);
+                if( !_pcollidingbody ) {
+                    RAVELOG_WARN_FORMAT("loading cache expected colliding body %s, but none found", _collidingbodyname);
+                }
+                itbody = mapCollidingBodies.insert(make_pair(filenode.collidingbodyname, _pcollidingbody)).first;
+            }
+            if( !!itbody->second && filenode.collidinglinkindex >= 0 && filenode.collidinglinkindex < (int)itbody->second->GetLinks().size() ) {
+                _newnode->_collidinglink = itbody->second->GetLinks()[filenode.collidinglinkindex];
             }
             else {
-                _newnode->_collidinglink = _pcollidingbody->GetLinks().at(collidinglinkindex);
+                // without the link the collision information cannot be reported
+                _newnode->SetType(CNT_Unknown);
             }
-            outs = fread(&_newnode->_robotlinkindex, sizeof(_newnode->_robotlinkindex), 1, pfile);
         }
 
-        outs = fread(&_newnode->_hasselfchild, sizeof(_newnode->_hasselfchild), 1, pfile);
-        outs = fread(&_newnode->_usenn, sizeof(_newnode->_usenn), 1, pfile);
-        int numchildren;
-        outs = fread(&numchildren, sizeof(numchildren), 1, pfile);
-        _newnode->_vchildren.resize(numchildren);
-
-        // create the copies of the children and insert them
-        for(int i = 0; i < numchildren; ++i) {
-            int childid;
-            outs = fread(&childid, sizeof(childid), 1, pfile);
-            _newnode->_vchildren[i] = _vnodes.at(childid);
+        _newnode->_vchildren.resize(filenode.numchildren);
+        for(int i = 0; i < filenode.numchildren; ++i) {
+            _newnode->_vchildren[i] = _vnodes.at(pchildren[filenode.childoffset+i]);
         }
-
         _vsetLevelNodes.at(_EncodeLevel(_newnode->_level)).insert(_newnode);
     }
-
-    fclose(pfile);
-
+    _numnodes = header.numnodes;
     _vnodes.resize(0);
-
-    int numloaded = GetNumKnownNodes();
-    OPENRAVE_ASSERT_OP(numloaded,==,_numnodes);
+    _pcollidingbody.reset();
     return 1;
 }
 
@@ -956,7 +1113,7 @@ int CacheTree::UpdateCollisionConfigurations(KinBodyPtr pbody)
         FOREACH(itlevelnodes, _vsetLevelNodes) {
             FOREACH(itnode, *itlevelnodes) {
                 _newnode = *itnode;
-                if ((_newnode->GetType() == CNT_Collision) && (pbody == _newnode->GetCollidingLink()->GetParent())) {
+                if ((_newnode->GetType() == CNT_Collision) && !!_newnode->GetCollidingLink() && (pbody == _newnode->GetCollidingLink()->GetParent())) {
                     _newnode->SetType(CNT_Unknown);
                     nremoved += 1;
                 }
@@ -968,15 +1125,37 @@ int CacheTree::UpdateCollisionConfigurations(KinBodyPtr pbody)
     return nremoved;
 }
 
-int CacheTree::UpdateFreeConfigurations(KinBodyPtr pbody) //todo only remove those with overlaping linkspheres
+int CacheTree::UpdateFreeConfigurations(const AABB& ab)
 {
     int nremoved=0;
     if (_numnodes > 0) {
-
+        const Vector vmin = ab.pos - ab.extents, vmax = ab.pos + ab.extents;
         FOREACH(itlevelnodes, _vsetLevelNodes) {
             FOREACH(itnode, *itlevelnodes) {
-                if (((*itnode)->GetType() == CNT_Free)) {
-                    (*itnode)->SetType(CNT_Unknown);
+                CacheTreeNodePtr pnode = *itnode;
+                if( pnode->GetType() != CNT_Free ) {
+                    continue;
+                }
+                bool boverlap = !pnode->_plinkspheres;
+                for(int isphere = 0; isphere < _numlinkspheres && !boverlap; ++isphere) {
+                    const Vector& sphere = pnode->_plinkspheres[isphere];
+                    if( sphere.w < 0 ) {
+                        continue;
+                    }
+                    // squared distance from the center to the closest point of the box
+                    dReal dist2 = 0;
+                    for(int j = 0; j < 3; ++j) {
+                        if( sphere[j] < vmin[j] ) {
+                            dist2 += Sqr(vmin[j] - sphere[j]);
+                        }
+                        else if( sphere[j] > vmax[j] ) {
+                            dist2 += Sqr(sphere[j] - vmax[j]);
+                        }
+                    }
+                    boverlap = dist2 <= sphere.w;
+                }
+                if( boverlap ) {
+                    pnode->SetType(CNT_Unknown);
                     nremoved += 1;
                 }
             }
@@ -989,6 +1168,15 @@ int CacheTree::UpdateFreeConfigurations(KinBodyPtr pbody) //todo only remove tho
     return nremoved;
 }
 
+void CacheTree::SetNumLinkSpheres(int numlinkspheres)
+{
+    if( _numlinkspheres != numlinkspheres ) {
+        Reset();
+        _numlinkspheres = numlinkspheres;
+        _poolNodes.reset(new boost::pool<>(_GetNodeMemorySize()));
+    }
+}
+
 int CacheTree::RemoveFreeConfigurations()
 {
     int nremoved=0;
@@ -1185,6 +1373,7 @@ ConfigurationCache::ConfigurationCache(RobotBasePtr pstaterobot, bool envupdates
     _collisionthresh = 1.0; // discretization distance used by the original collisionchecker
     _freespacethresh = 0.2; // half disc. distance used by the original collisionchecker
     _insertiondistancemult = 0.5;
+    _linkspherepadding = 0.01;
 
 
     _handleJointLimitChange = pstaterobot->RegisterChangeCallback(KinBody::Prop_JointLimits, boost::bind(&ConfigurationCache::_UpdateRobotJointLimits, this));
@@ -1199,6 +1388,10 @@ ConfigurationCache::ConfigurationCache(RobotBasePtr pstaterobot, bool envupdates
     }
 
     _cachetree.Init(_vweights, RaveSqrt(maxdistance));
+    if( _envupdates ) {
+        // one sphere per link and one around the grabbed bodies
+        _cachetree.SetNumLinkSpheres(_pstaterobot->GetLinks().size()+1);
+    }
 
     if (IS_DEBUGLEVEL(Level_Verbose)) {
         stringstream ss; ss << std::setprecision(std::numeric_limits<OpenRAVE::dReal>::digits10+1);
@@ -1238,6 +1431,7 @@ ConfigurationCache::~ConfigurationCache()
 
 void ConfigurationCache::SetWeights(const std::vector<dReal>& weights)
 {
+    boost::unique_lock<boost::shared_mutex> lock(_mutex);
     _cachetree.SetWeights(weights);
 }
 
@@ -1248,33 +1442,52 @@ bool ConfigurationCache::InsertConfiguration(const std::vector<dReal>& conf, Col
             std::swap(report->plink1, report->plink2);
         }
     }
-    int ret = _cachetree.InsertNode(conf, report, !report ? _freespacethresh*_insertiondistancemult : _collisionthresh*_insertiondistancemult);
+    std::vector<Vector> vlinkspheres;
+    const Vector* plinkspheres = NULL;
+    if( !report && _envupdates && _cachetree.GetNumLinkSpheres() > 0 ) {
+        // the robot is at conf when the result of its collision check is inserted
+        _ComputeLinkSpheres(vlinkspheres);
+        if( (int)vlinkspheres.size() == _cachetree.GetNumLinkSpheres() ) {
+            plinkspheres = &vlinkspheres[0];
+        }
+    }
+    boost::unique_lock<boost::shared_mutex> lock(_mutex);
+    int ret = _cachetree.InsertNode(conf, report, !report ? _freespacethresh*_insertiondistancemult : _collisionthresh*_insertiondistancemult, plinkspheres);
     BOOST_ASSERT(ret!=0);
     return ret==1;
 }
 
 int ConfigurationCache::GetNumKnownNodes()
 {
+    boost::shared_lock<boost::shared_mutex> lock(_mutex);
     return _cachetree.GetNumKnownNodes();
 }
 
 int ConfigurationCache::RemoveCollisionConfigurations()
 {
+    boost::unique_lock<boost::shared_mutex> lock(_mutex);
     return _cachetree.RemoveCollisionConfigurations();
 }
 
 int ConfigurationCache::UpdateCollisionConfigurations(KinBodyPtr pbody)
 {
+    boost::unique_lock<boost::shared_mutex> lock(_mutex);
     return _cachetree.UpdateCollisionConfigurations(pbody);
 }
 
 int ConfigurationCache::UpdateFreeConfigurations(KinBodyPtr pbody)
 {
-    return _cachetree.UpdateFreeConfigurations(pbody);
+    if( !pbody ) {
+        return RemoveFreeConfigurations();
+    }
+    AABB ab = pbody->ComputeAABB();
+    boost::unique_lock<boost::shared_mutex> lock(_mutex);
+    return _cachetree.UpdateFreeConfigurations(ab);
 }
 
 int ConfigurationCache::RemoveFreeConfigurations()
 {
+    boost::unique_lock<boost::shared_mutex> lock(_mutex);
     return _cachetree.RemoveFreeConfigurations();
 }
 
@@ -1300,9 +1513,11 @@ void ConfigurationCache::GetDOFValues(std::vector<dReal>& values)
     }
 }
 
-int ConfigurationCache::CheckCollision(const std::vector<dReal>& conf, KinBody::LinkConstPtr& robotlink, KinBody::LinkConstPtr& collidinglink, dReal& closestdist)
+int ConfigurationCache::CheckCollision(const std::vector<dReal>& conf, KinBody::LinkConstPtr& robotlink, KinBody::LinkConstPtr& collidinglink, dReal& closestdist, CacheTreeQueryInfo* pinfo)
 {
-    std::pair<CacheTreeNodeConstPtr, dReal> knn = _cachetree.FindNearestNode(conf, _collisionthresh, _freespacethresh);
+    boost::shared_lock<boost::shared_mutex> lock(_mutex);
+    // the node is only valid while the lock is held
+    std::pair<CacheTreeNodeConstPtr, dReal> knn = _cachetree.FindNearestNode(conf, _collisionthresh, _freespacethresh, pinfo);
 
     if( !!knn.first ) {
 
@@ -1325,6 +1540,7 @@ int ConfigurationCache::CheckCollision(const std::vector<dReal>& conf, KinBody::
 
 std::pair<std::vector<dReal>, dReal> ConfigurationCache::FindNearestNode(const std::vector<dReal>& conf, dReal dist)
 {
+    boost::shared_lock<boost::shared_mutex> lock(_mutex);
     std::pair<CacheTreeNodeConstPtr, dReal> knn = _cachetree.FindNearestNode(conf, dist, CNT_Any);
 
     if( !!knn.first ) {
@@ -1333,31 +1549,37 @@ std::pair<std::vector<dReal>, dReal> ConfigurationCache::FindNearestNode(const s
     return make_pair(std::vector<dReal>(0), dReal(0));
 }
 
-int ConfigurationCache::CheckCollision(KinBody::LinkConstPtr& robotlink, KinBody::LinkConstPtr& collidinglink, dReal& closestdist)
+int ConfigurationCache::CheckCollision(KinBody::LinkConstPtr& robotlink, KinBody::LinkConstPtr& collidinglink, dReal& closestdist, CacheTreeQueryInfo* pinfo)
 {
     std::vector<dReal> conf;
     GetDOFValues(conf);
-    return CheckCollision(conf, robotlink, collidinglink, closestdist);
+    return CheckCollision(conf, robotlink, collidinglink, closestdist, pinfo);
 }
 
 void ConfigurationCache::Reset()
 {
     RAVELOG_DEBUG("Resetting cache\n");
+    boost::unique_lock<boost::shared_mutex> lock(_mutex);
     _cachetree.Reset();
 }
 
 bool ConfigurationCache::Validate()
 {
+    boost::unique_lock<boost::shared_mutex> lock(_mutex);
     return _cachetree.Validate();
 }
 
 void ConfigurationCache::_UpdateUntrackedBody(KinBodyPtr pbody)
 {
-    // body's state has changed, so remove collision space and invalidate free space.
+    // body's state has changed, so remove the collisions with it and the free space it could have moved into.
     if(_envupdates) {
+        if( !!_pstaterobot->IsGrabbing(pbody) ) {
+            // moves with the robot and is covered by the grabbed sphere of the free configurations
+            return;
+        }
         RAVELOG_VERBOSE_FORMAT("%s %s","Updating untracked bodies"%pbody->GetName());
         UpdateCollisionConfigurations(pbody);
-        RemoveFreeConfigurations();
+        UpdateFreeConfigurations(pbody);
     }
 }
 
@@ -1365,8 +1587,8 @@ void ConfigurationCache::_UpdateAddRemoveBodies(KinBodyPtr pbody, int action)
 {
     if( action == 1 ) {
         if (_envupdates) {
-            // invalidate the freespace of a cache given a new body in the scene
-            if (RemoveFreeConfigurations() > 0) {
+            // invalidate the freespace of a cache that the new body overlaps
+            if (UpdateFreeConfigurations(pbody) > 0) {
                 RAVELOG_DEBUG_FORMAT("%s %s %d","Updating add/remove bodies"%pbody->GetName()%action);
             }
             KinBodyCachedDataPtr pinfo(new KinBodyCachedData());
@@ -1406,6 +1628,7 @@ void ConfigurationCache::_UpdateRobotJointLimits()
                 maxdistance += f*f;
             }
             maxdistance = RaveSqrt(maxdistance);
+            boost::unique_lock<boost::shared_mutex> lock(_mutex);
             if( maxdistance > _cachetree.GetMaxDistance()+g_fEpsilonLinear ) {
                 _cachetree.SetMaxDistance(maxdistance);
             }
@@ -1441,4 +1664,41 @@ void ConfigurationCache::_UpdateRobotGrabbed()
     }
 }
 
+void ConfigurationCache::_ComputeLinkSpheres(std::vector<Vector>& vlinkspheres)
+{
+    vlinkspheres.resize(0);
+    FOREACHC(itlink, _pstaterobot->GetLinks()) {
+        AABB ab = (*itlink)->ComputeAABB();
+        Vector sphere = ab.pos;
+        sphere.w = Sqr(RaveSqrt(ab.extents.lengthsqr3()) + _linkspherepadding);
+        vlinkspheres.push_back(sphere);
+    }
+
+    // the grabbed bodies can change between insertions, so they share one sphere
+    Vector vmin, vmax;
+    bool bgrabbed = false;
+    std::vector<KinBodyPtr> vgrabbedbodies;
+    _pstaterobot->GetGrabbed(vgrabbedbodies);
+    FOREACHC(itbody, vgrabbedbodies) {
+        AABB ab = (*itbody)->ComputeAABB();
+        if( !bgrabbed ) {
+            vmin = ab.pos - ab.extents;
+            vmax = ab.pos + ab.extents;
+            bgrabbed = true;
+        }
+        else {
+            for(int j = 0; j < 3; ++j) {
+                vmin[j] = min(vmin[j], ab.pos[j] - ab.extents[j]);
+                vmax[j] = max(vmax[j], ab.pos[j] + ab.extents[j]);
+            }
+        }
+    }
+    Vector sphere(0,0,0,-1);
+    if( bgrabbed ) {
+        sphere = 0.5*(vmin + vmax);
+        sphere.w = Sqr(RaveSqrt((0.5*(vmax - vmin)).lengthsqr3()) + _linkspherepadding);
+    }
+    vlinkspheres.push_back(sphere);
+}
+
 }
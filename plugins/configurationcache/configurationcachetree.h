@@ -18,6 +18,8 @@
 #include "openraveplugindefs.h"
 #include <deque>
 #include <boost/pool/pool.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/tss.hpp>
 
 #define _(msgid) OpenRAVE::RaveGetLocalizedTextForDomain("openrave_plugins_configurationcache", msgid)
 
@@ -137,7 +139,7 @@ protected:
 #ifdef _DEBUG
     int id;
 #endif
-    Vector* _plinkspheres; ///< xyz is center, w is radius^2 of every link on the robot, pointer managed by outside pool so do not delete
+    Vector* _plinkspheres; ///< xyz is center, w is radius^2 of every link on the robot, pointer managed by outside pool so do not delete. NULL if the spheres are not known. A negative w marks an unused sphere.
     dReal _pcstate[0]; ///< the state values, pointer managed by outside pool so do not delete. The values always follow the allocation of the structure.
 
 private:
@@ -152,6 +154,15 @@ private:
 typedef CacheTreeNode* CacheTreeNodePtr; ///< boost::shared_ptr might be too slow, and we never expose the pointers outside of CacheTree, so can use raw pointers.
 typedef const CacheTreeNode* CacheTreeNodeConstPtr;
 
+/// \brief how much work one CacheTree::FindNearestNode query did
+struct CacheTreeQueryInfo
+{
+    CacheTreeQueryInfo() : numvisited(0), bAborted(false) {
+    }
+    int numvisited; ///< number of nodes whose distance to the query was computed
+    bool bAborted; ///< true if the query reached the maximum number of visited nodes and gave up, see CacheTree::SetApproximation
+};
+
 /** Cache stores configuration information in a data structure based on the Cover Tree (Beygelzimer et al. 2006 http://hunch.net/~jl/projects/cover_tree/icml_final/final-icml.pdf)
 
     The tree contains nodes with configurations, collision/free-space information, distance/nn statistics (e.g., dispersion, upper bounds on minimum distance to collisions, and admissible nearest neighbor), collision reports, etc. To be expanded to include a lean workspace representation for each node, i.e., enclosing spheres for each link, and an approximation of a connected graph (there is a path from every configuration to every other configuration, possible by considering log(n) neighbors) that is constructed from collision checking procedures (of the form qi to qf) and can be used to attempt to plan with the cache before sampling new configurations.
@@ -160,6 +171,8 @@ typedef const CacheTreeNode* CacheTreeNodeConstPtr;
 
     d(p,q) < (1 + e)d(p,S)
     2^(1+i) (1 + 1/e) <= d(p,Qi)
+
+    The FindNearestNode queries can run concurrently from multiple threads as long as no other method modifies the tree at the same time. ConfigurationCache guarantees this with a reader/writer lock.
  */
 class CacheTree
 {
@@ -175,7 +188,7 @@ public:
     /// \brief resets the nodes for the cache tree to 0
     void Reset();
 
-    /// \brief finds the nearest neighbor in the cover tree of a particular type.
+    /// \brief finds the nearest neighbor in the cover tree of a particular type. Thread-safe with respect to other queries.
     ///
     /// \param distancebound If > 0, the distance bound such that any points as close as distancebound will be immediately returned
     /// \param conftype the type of node to find. If CNT_Any, will return any type.
@@ -184,15 +197,32 @@ public:
     /// \brief finds the nearest node searching both collision and free nodes. collision nodes takes priority.
     ///
     /// if it is a collision node, it is within collisionthresh. If it is a freespace node, distance is within freespacethresh
+    /// The search is approximate if set with \ref SetApproximation. An approximate search never returns a node outside the thresholds, it only misses more nodes.
     /// \param collisionthresh assumes > 0
     /// \param freespacethresh assumes > 0
-    std::pair<CacheTreeNodeConstPtr, dReal> FindNearestNode(const std::vector<dReal>& cs, dReal collisionthresh, dReal freespacethresh) const;
+    /// \param pinfo if not NULL, filled with the number of visited nodes and whether the search stopped early
+    std::pair<CacheTreeNodeConstPtr, dReal> FindNearestNode(const std::vector<dReal>& cs, dReal collisionthresh, dReal freespacethresh, CacheTreeQueryInfo* pinfo=NULL) const;
+
+    /// \brief sets how FindNearestNode with thresholds trades accuracy for speed
+    ///
+    /// \param errorfactor e >= 0. The descent stops once the levels below cannot hold a node closer than 1/(1+e) of the closest node seen so far, i.e. 2^(1+i) (1 + 1/e) <= d(p,Qi). 0 searches exactly.
+    /// \param maxvisitednodes if > 0, a search gives up and returns no node after computing the distance to this many nodes. 0 is unlimited.
+    void SetApproximation(dReal errorfactor, int maxvisitednodes);
+
+    inline dReal GetApproximationErrorFactor() const {
+        return _fApproxErrorFactor;
+    }
+
+    inline int GetMaxVisitedNodes() const {
+        return _nMaxVisitedNodes;
+    }
 
     /// \brief inserts node in the tree. If node is too close to other nodes in the tree, then does not insert.
     ///
     /// \param[in] fMinSeparationDist the max distance a node should be separated from its closest neighbor. If node is collision, then only applies to collision neighbors, free neighbors are ignored.
+    /// \param[in] plinkspheres if not NULL, the GetNumLinkSpheres() bounding spheres of the robot at cs, stored with free nodes so that \ref UpdateFreeConfigurations can keep the nodes far away from a changed body
     /// \return 1 if point is inserted and parent found. 0 if no parent found and point is not inserted. -1 if parent found but point not inserted since it is close to fMinSeparationDist
-    int InsertNode(const std::vector<dReal>& cs, CollisionReportPtr report, dReal fMinSeparationDist);
+    int InsertNode(const std::vector<dReal>& cs, CollisionReportPtr report, dReal fMinSeparationDist, const Vector* plinkspheres=NULL);
 
     /// \brief removes node from the tree
     ///
@@ -213,6 +243,11 @@ public:
     /// \brief retuns the values for all nodes in the tree
     void GetNodeValuesList(std::vector<CacheTreeNodePtr>& lvals);
 
+    /// \brief returns the number of nodes at every level, starting from the root level down to the minimum level
+    ///
+    /// \param[out] vlevelcounts pairs of (level, number of nodes at level)
+    void GetLevelNodeCounts(std::vector< std::pair<int, int> >& vlevelcounts) const;
+
     /// \brief sets the weights
     void SetWeights(const std::vector<dReal>& weights);
 
@@ -252,23 +287,56 @@ public:
     /// \brief sets all collision configurations with pbody in its report to CNT_Unknown
     int UpdateCollisionConfigurations(KinBodyPtr pbody);
 
-    /// \brief sets all free configurations to CNT_Unknown, TODO, only set those that overlap with the new body
-    int UpdateFreeConfigurations(KinBodyPtr pbody);
+    /// \brief sets the free configurations whose link spheres overlap ab to CNT_Unknown. Free configurations without link spheres are always reset.
+    int UpdateFreeConfigurations(const AABB& ab);
+
+    /// \brief sets the number of link spheres stored with every node, resets the tree since the node size changes
+    void SetNumLinkSpheres(int numlinkspheres);
+
+    inline int GetNumLinkSpheres() const {
+        return _numlinkspheres;
+    }
 
     /// \brief returns the number of configurations in the tree that are not CNT_Unknown
     int GetNumKnownNodes();
 
     /// \brief save cache to disk
+    ///
+    /// The nodes are written as contiguous arrays indexed by node so that the file can be memory mapped. The file is written to a temporary file first and then renamed, so other processes loading the cache never see a partial file.
+    /// \param filename the cache hash, the file is selfcache.filename in the database directory
+    /// \return 1 if saved
     int SaveCache(std::string filename);
 
     /// \brief load cache from disk
+    ///
+    /// Maps the file read-only and builds the tree from its arrays in one pass. Files saved with a different format, dReal size, or hash are ignored.
+    /// \return 1 if loaded, 0 if there is no valid cache file
     int LoadCache(std::string filename, EnvironmentBasePtr penv);
 
 private:
+    /// \brief scratch buffers of the nearest neighbor queries
+    struct QueryCache
+    {
+        std::vector< std::pair<CacheTreeNodePtr, dReal> > _vCurrentLevelNodes, _vNextLevelNodes;
+    };
+
+    /// \brief returns the query buffers of the calling thread
+    QueryCache& _GetQueryCache() const;
+
     /// \brief creates new node on the pool
-    CacheTreeNodePtr _CreateCacheTreeNode(const std::vector<dReal>& cs, CollisionReportPtr report);
+    CacheTreeNodePtr _CreateCacheTreeNode(const std::vector<dReal>& cs, CollisionReportPtr report, const Vector* plinkspheres=NULL);
     CacheTreeNodePtr _CloneCacheTreeNode(CacheTreeNodeConstPtr refnode);
 
+    /// \brief returns the memory of one node: the structure followed by the state and the link spheres
+    inline size_t _GetNodeMemorySize() const {
+        return sizeof(CacheTreeNode)+sizeof(dReal)*_statedof+sizeof(Vector)*_numlinkspheres;
+    }
+
+    /// \brief returns where the link spheres of the node allocated at pmemory are stored
+    inline Vector* _GetLinkSpheresMemory(void* pmemory) const {
+        return _numlinkspheres > 0 ? (Vector*)((uint8_t*)pmemory + sizeof(CacheTreeNode) + sizeof(dReal)*_statedof) : NULL;
+    }
+
     /// \brief deletes the node from the pool and calls its destructor.
     void _DeleteCacheTreeNode(CacheTreeNodePtr pnode);
 
@@ -331,13 +399,18 @@ private:
     dReal _base, _fBaseInv, _fBaseInv2, _fBaseChildMult; ///< a constant used to control the max level of traversion. _fBaseInv = 1/_base, _fBaseInv2=Sqr(_fBaseInv), _fBaseChildMult=1/(_base-1)
 
     int _statedof; ///< the state space DOF tree is configured for
+    int _numlinkspheres; ///< number of link spheres following the state of every node
     int _maxlevel; ///< the maximum allowed levels in the tree, this is where the root node starts (inclusive)
     int _minlevel; ///< the minimum allowed levels in the tree (inclusive)
     int _numnodes; ///< the number of nodes in the current tree starting at the root at _vsetLevelNodes.at(_EncodeLevel(_maxlevel))
     dReal _fMaxLevelBound; ///< pow(_base, _maxlevel)
+    dReal _fApproxErrorFactor; ///< the error factor of the approximate searches, 0 if exact
+    dReal _fApproxStopMult; ///< 1+1/_fApproxErrorFactor, 0 if exact
+    int _nMaxVisitedNodes; ///< the maximum number of nodes a search visits before giving up, 0 if unlimited
 
     // cache cache
-    mutable std::vector< std::pair<CacheTreeNodePtr, dReal> > _vCurrentLevelNodes, _vNextLevelNodes;
+    mutable boost::thread_specific_ptr<QueryCache> _querycache; ///< per thread buffers for FindNearestNode so that queries do not share state
+    std::vector< std::pair<CacheTreeNodePtr, dReal> > _vCurrentLevelNodes, _vNextLevelNodes; ///< buffers for InsertNode
     mutable std::vector< std::vector<CacheTreeNodePtr> > _vvCacheNodes;
 
     std::vector<CacheTreeNodePtr> _vnodes; ///< for loading
@@ -348,6 +421,8 @@ typedef boost::shared_ptr<CacheTree> CacheTreePtr;
 
 /** Maintains an up-to-date cache tree synchronized to the openrave environment. Tracks bodies being added removed, states changing, etc.
    The state of cache consists of the active DOFs of the robot that is passed in at constructor time.
+
+   All the methods are thread-safe: lookups hold a shared lock and run concurrently, modifications of the tree hold an exclusive lock. This allows collision checkers of several environments to share one cache.
  */
 class ConfigurationCache
 {
@@ -375,14 +450,26 @@ public:
     /// \brief removes all free configurations
     int RemoveFreeConfigurations();
 
-    /// \brief removes all free configurations, to be updated to only remove those with linkspheres that overlap with the body
+    /// \brief removes the free configurations where the robot could touch the new bounding box of pbody, used to update cache when bodies are added or moved
     int UpdateFreeConfigurations(KinBodyPtr pbody);
 
+    /// \brief the bounding spheres of the robot links stored with the free configurations are enlarged by this distance, so they also cover the configurations within the free space threshold. Default is 0.01.
+    inline void SetLinkSpherePadding(dReal padding)
+    {
+        _linkspherepadding = padding;
+    }
+
+    inline dReal GetLinkSpherePadding() const
+    {
+        return _linkspherepadding;
+    }
+
     /// \brief determine if current configuration is whithin threshold of a collision in the cache (_collisionthresh), known to be in collision, or requires an explicit collision check
+    /// \param pinfo if not NULL, filled with the work done by the lookup
     /// \return 1 if in collision, 0 if not in collision, -1 if unknown
-    int CheckCollision(const std::vector<dReal>& cs, KinBody::LinkConstPtr& robotlink, KinBody::LinkConstPtr& collidinglink, dReal& closestdist);
+    int CheckCollision(const std::vector<dReal>& cs, KinBody::LinkConstPtr& robotlink, KinBody::LinkConstPtr& collidinglink, dReal& closestdist, CacheTreeQueryInfo* pinfo=NULL);
 
-    int CheckCollision(KinBody::LinkConstPtr& robotlink, KinBody::LinkConstPtr& collidinglink, dReal& closestdist);
+    int CheckCollision(KinBody::LinkConstPtr& robotlink, KinBody::LinkConstPtr& collidinglink, dReal& closestdist, CacheTreeQueryInfo* pinfo=NULL);
 
     /// \brief invalidate the entire cache
     void Reset();
@@ -393,6 +480,7 @@ public:
 
     /// \brief number of nodes currently in the cover tree
     int GetNumNodes() const {
+        boost::shared_lock<boost::shared_mutex> lock(_mutex);
         return _cachetree.GetNumNodes();
     }
 
@@ -401,9 +489,16 @@ public:
 
     /// \brief return configuration values for all nodes in the tree, calls cachetree's function
     void GetNodeValues(std::vector<dReal>& vals) const {
+        boost::shared_lock<boost::shared_mutex> lock(_mutex);
         _cachetree.GetNodeValues(vals);
     }
 
+    /// \brief returns the number of nodes at every level of the cover tree, calls cachetree's function
+    void GetLevelNodeCounts(std::vector< std::pair<int, int> >& vlevelcounts) const {
+        boost::shared_lock<boost::shared_mutex> lock(_mutex);
+        _cachetree.GetLevelNodeCounts(vlevelcounts);
+    }
+
     /// \brief return nearest configuration and distance
     std::pair<std::vector<dReal>, dReal> FindNearestNode(const std::vector<dReal>& conf, dReal dist = 0.0);
 
@@ -427,9 +522,27 @@ public:
     /// \brief set the base parameter
     inline void SetBase(dReal base)
     {
+        boost::unique_lock<boost::shared_mutex> lock(_mutex);
         _cachetree.SetBase(base);
     }
 
+    /// \brief sets the approximation of the lookups, see CacheTree::SetApproximation
+    inline void SetApproximation(dReal errorfactor, int maxvisitednodes)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(_mutex);
+        _cachetree.SetApproximation(errorfactor, maxvisitednodes);
+    }
+
+    inline dReal GetApproximationErrorFactor() const
+    {
+        return _cachetree.GetApproximationErrorFactor();
+    }
+
+    inline int GetMaxVisitedNodes() const
+    {
+        return _cachetree.GetMaxVisitedNodes();
+    }
+
     /// \brief disable environment updates
     inline void DisableEnvUpdates()
     {
@@ -486,18 +599,21 @@ public:
     /// \brief remove all nodes in collision with pbody, for testing
     inline void UpdateCollisionNodes(KinBodyPtr pbody)
     {
+        boost::unique_lock<boost::shared_mutex> lock(_mutex);
         _cachetree.UpdateCollisionNodes(pbody);
     }
 
     /// \brief saves the cache to disk
     inline void SaveCache(std::string filename)
     {
+        boost::unique_lock<boost::shared_mutex> lock(_mutex);
         _cachetree.SaveCache(filename);
     }
 
     /// \brief loads cache from disk
     inline void LoadCache(std::string filename, EnvironmentBasePtr penv)
     {
+        boost::unique_lock<boost::shared_mutex> lock(_mutex);
         _cachetree.LoadCache(filename, penv);
     }
 
@@ -514,7 +630,11 @@ private:
     /// \brief called when grabbeb bodies are updated
     void _UpdateRobotGrabbed();
 
+    /// \brief computes the bounding spheres of every robot link and one sphere around all the grabbed bodies at the current robot state. Does not touch any member, so it can run while other threads insert.
+    void _ComputeLinkSpheres(std::vector<Vector>& vlinkspheres);
+
     CacheTree _cachetree; ///< cache tree datastructure with configurations and their collision information
+    mutable boost::shared_mutex _mutex; ///< protects _cachetree, shared for lookups and unique for modifications
 
     RobotBasePtr _pstaterobot;
     std::vector<int> _vRobotActiveIndices;
@@ -543,6 +663,7 @@ public:
 
     dReal _collisionthresh; ///< configurations in this distance range (from a collsion configuration in the tree) will be assumed to be in collision
     dReal _freespacethresh; ///< configurations in this distance range (from a free configuration in the tree)  will be assumed to not be in collision
+    dReal _linkspherepadding; ///< added to the radius of the link spheres of the free configurations
     dReal _insertiondistancemult; ///< only insert nodes if they are far from the nearest node in the tree. The distance is computed by multiplying this number of _collisionthresh or _freespacethresh. Distance a configuration must have from the nearest configuration in the tree in order for it be inserted
     std::string _userdatakey;
     UserDataPtr _handleJointLimitChange, _handleGrabbedChange; ///< handles for changes in the robot's joint limits and grabbed bodies
@@ -554,6 +675,7 @@ public:
 };
 
 typedef boost::shared_ptr<ConfigurationCache> ConfigurationCachePtr;
+typedef boost::shared_ptr<ConfigurationCache const> ConfigurationCacheConstPtr;
 
 }
 
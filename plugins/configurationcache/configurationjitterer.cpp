@@ -24,6 +24,7 @@
 #endif
 
 #include "configurationcachetree.h"
+#include "parallelrangeworkers.h"
 
 namespace configurationcache {
 
@@ -58,8 +59,9 @@ public:
 If the current robot configuration is in collision, then jitters the robot until it is out of collision.\n\
 By default will sample the robot's active DOFs. Parameters part of the interface name::\n\
 \n\
-  [robotname] [samplername]\n\
+  [robotname] [samplername] [usecache]\n\
 \n\
+If usecache is 1 (default), the colliding configurations are cached and the candidates close to them are skipped. The cache is kept between calls as long as the environment and the robot DOFs that are not jittered do not change.\n\
 ";
         RegisterCommand("SetMaxJitter",boost::bind(&ConfigurationJitterer::SetMaxJitterCommand,this,_1,_2),
                         "set a new max jitter");
@@ -82,10 +84,16 @@ By default will sample the robot's active DOFs. Parameters part of the interface
     bias_dir is the workspace direction to bias the sampling in.\n\
     nullsampleprob, nullbiassampleprob, and deltasampleprob are in [0,1]\n\
  //");
+        RegisterCommand("SetNumThreads",boost::bind(&ConfigurationJitterer::SetNumThreadsCommand,this,_1,_2),
+                        "numthreads [blocksize]. If numthreads > 1, samples candidates in blocks of blocksize (default 8*numthreads) and checks them in parallel on environment snapshots, returning the valid candidate of the block that is closest to the original configuration.");
 
-        bool bUseCache = false;
+        bool bUseCache = true;
         std::string robotname, samplername = "MT19937";
-        is >> robotname >> samplername >> bUseCache;
+        is >> robotname >> samplername;
+        int usecache = 1;
+        if( !!(is >> usecache) ) {
+            bUseCache = usecache != 0;
+        }
         _probot = GetEnv()->GetRobot(robotname);
         OPENRAVE_ASSERT_FORMAT(!!_probot, "could not find robot %s", robotname, ORE_InvalidArguments);
 
@@ -118,6 +126,8 @@ By default will sample the robot's active DOFs. Parameters part of the interface
 
         _bSetResultOnRobot = true;
         _busebiasing = false;
+        _nNumThreads = 1;
+        _nBlockSize = 0;
 
         // for selecting sampling modes
         if( samplername.size() == 0 ) {
@@ -137,6 +147,8 @@ By default will sample the robot's active DOFs. Parameters part of the interface
         _nRandomGeneratorSeed = 0;
 
         _report.reset(new CollisionReport());
+        _cachereport.reset(new CollisionReport());
+        _cachehit = 0;
         _maxiterations=5000;
         _maxjitter=0.02;
         _perturbation=1e-5;
@@ -148,6 +160,7 @@ By default will sample the robot's active DOFs. Parameters part of the interface
         _limitscallback = _probot->RegisterChangeCallback(RobotBase::Prop_JointLimits, boost::bind(&ConfigurationJitterer::_UpdateLimits,this));
         _UpdateGrabbed();
         _grabbedcallback = _probot->RegisterChangeCallback(RobotBase::Prop_RobotGrabbed, boost::bind(&ConfigurationJitterer::_UpdateGrabbed,this));
+        _geometrycallback = _probot->RegisterChangeCallback(KinBody::Prop_LinkGeometry|KinBody::Prop_LinkEnable, boost::bind(&ConfigurationJitterer::_ResetCache,this));
 
         if( !!_cache ) {
             _SetCacheMaxDistance();
@@ -207,6 +220,26 @@ By default will sample the robot's active DOFs. Parameters part of the interface
         return true;
     }
 
+    bool SetNumThreadsCommand(std::ostream& sout, std::istream& sinput)
+    {
+        int numthreads=0, blocksize=0;
+        sinput >> numthreads;
+        if( !sinput || numthreads < 1 ) {
+            return false;
+        }
+        sinput >> blocksize;
+        if( blocksize <= 0 ) {
+            blocksize = 8*numthreads;
+        }
+        _nNumThreads = numthreads;
+        _nBlockSize = blocksize;
+        if( numthreads <= 1 ) {
+            _vsnapshots.resize(0);
+            _pworkers.reset();
+        }
+        return true;
+    }
+
     bool SetMaxLinkDistThreshCommand(std::ostream& sout, std::istream& sinput)
     {
         dReal linkdistthresh=0;
@@ -360,8 +393,6 @@ By default will sample the robot's active DOFs. Parameters part of the interface
     {
         RobotBase::RobotStateSaver robotsaver(_probot, KinBody::Save_LinkTransformation|KinBody::Save_ActiveDOF);
         _InitRobotState();
-        const dReal linkdistthresh = _linkdistthresh;
-        const dReal linkdistthresh2 = _linkdistthresh2;
 
         vector<AABB> newLinkAABBs;
         bool bCollision = false;
@@ -427,194 +458,34 @@ By default will sample the robot's active DOFs. Parameters part of the interface
             return -1;
         }
 
-        if( !!_cache ) {
-            _cache->InsertNode(_curdof, CollisionReportPtr(), _neighdistthresh);
-            _cachehit = 0;
+        _cachehit = 0;
+        if( bCollision ) {
+            _InsertCollisionNode(_curdof, _report);
         }
 
-        BOOST_ASSERT(!_busebiasing || _vbiasdofdirection.size() > 0);
-        const boost::array<dReal, 3> rayincs = {{0.5, 0.9, 0.2}};
-
-        bool busebiasing = _busebiasing;
-        const int nMaxIterRadiusThresh=_maxiterations/2;
-        const dReal imaxiterations = 2.0/dReal(_maxiterations);
-        const dReal fJitterLowerThresh=0.2, fJitterHigherThresh=0.8;
-        dReal fBias = _vbiasdirection.lengthsqr3();
-        if( fBias > g_fEpsilon ) {
-            fBias = RaveSqrt(fBias);
+        uint64_t starttime = utils::GetNanoPerformanceTime();
+        if( _nNumThreads > 1 && !bConstraint ) {
+            if( _InitSnapshots() ) {
+                return _SampleParallel(vnewdof, interval, robotsaver, perturbations, starttime);
+            }
+            RAVELOG_WARN_FORMAT("env=%d, failed to set up %d jitter threads, so jittering in this thread", GetEnv()->GetId()%_nNumThreads);
         }
 
-        uint64_t starttime = utils::GetNanoPerformanceTime();
         for(int iter = 0; iter < _maxiterations; ++iter) {
             if( (iter%10) == 0 ) { // not sure what a good rate is...
                 _CallStatusFunctions(iter);
             }
-            if( busebiasing && iter < (int)rayincs.size() ) {
-                // start by checking samples directly above the current configuration
-                for (size_t j = 0; j < vnewdof.size(); ++j) {
-                    vnewdof[j] = _curdof[j] + (rayincs[iter] * _vbiasdofdirection.at(j));
-                }
-            }
-            else {
-                // ramp of the jitter as iterations increase
-                dReal jitter = _maxjitter;
-                if( iter < nMaxIterRadiusThresh ) {
-                    jitter = _maxjitter*dReal(iter+1)*imaxiterations;
-                }
-
-                bool samplebiasdir = false;
-                bool samplenull = false;
-                bool sampledelta = false;
-                if (busebiasing && _ssampler->SampleSequenceOneReal() < _nullsampleprob)
-                {
-                    samplenull = true;
-                }
-                if (busebiasing && _ssampler->SampleSequenceOneReal() < _nullbiassampleprob) {
-                    samplebiasdir = true;
-                }
-                if( (!samplenull && !samplebiasdir) || _ssampler->SampleSequenceOneReal() < _deltasampleprob ) {
-                    sampledelta = true;
-                }
-
-                bool deltasuccess = false;
-                if( sampledelta ) {
-                    // check which third the sampled dof is in
-                    for(size_t j = 0; j < vnewdof.size(); ++j) {
-                        dReal f = 2*_ssampler->SampleSequenceOneReal(interval)-1; // f in [-1,1]
-                        if( RaveFabs(f) < fJitterLowerThresh ) {
-                            _deltadof[j] = 0;
-                        }
-                        else if( f < -fJitterHigherThresh ) {
-                            _deltadof[j] = -jitter;
-                        }
-                        else if( f > fJitterHigherThresh ) {
-                            _deltadof[j] = jitter;
-                        }
-                        else {
-                            _deltadof[j] = jitter*f;
-                        }
-                    }
-                    deltasuccess = true;
-                }
-
-                if (!samplebiasdir && !samplenull && !deltasuccess) {
-                    continue;
-                }
-                // (lambda * biasdir) + (Nx) + delta + _curdofs
-                dReal fNullspaceMultiplier = linkdistthresh*2;
-                if( fNullspaceMultiplier <= 0 ) {
-                    fNullspaceMultiplier = fBias;
-                }
-                for (size_t k = 0; k < vnewdof.size(); ++k) {
-                    vnewdof[k] = _curdof[k];
-                    if (samplebiasdir) {
-                        vnewdof[k] += _ssampler->SampleSequenceOneReal() * _vbiasdofdirection[k];
-                    }
-                    if (samplenull) {
-                        for (size_t j = 0; j < _vbiasnullspace.size(); ++j) {
-                            dReal nullx = (_ssampler->SampleSequenceOneReal()*2-1)*fNullspaceMultiplier;
-                            vnewdof[k] += nullx * _vbiasnullspace[j][k];
-                        }
-                    }
-                    if (sampledelta) {
-                        vnewdof[k] += _deltadof[k];
-                    }
-                }
-            }
-
-            // get new state
-            for(size_t j = 0; j < _deltadof.size(); ++j) {
-                if( vnewdof[j] > _upper.at(j) ) {
-                    vnewdof[j] = _upper.at(j);
-                }
-                else if( vnewdof[j] < _lower.at(j) ) {
-                    vnewdof[j] = _lower.at(j);
-                }
-            }
-
-            if( !!_cache ) {
-                if( !!_cache->FindNearestNode(vnewdof, _neighdistthresh).first ) {
-                    _cachehit++;
-                    continue;
-                }
+            if( !_SampleCandidate(iter, vnewdof, interval) ) {
+                continue;
             }
 
             //int ret = cache.InsertNode(vnewdof, CollisionReportPtr(), _neighdistthresh);
             //BOOST_ASSERT(ret==1);
 
             _probot->SetActiveDOFValues(vnewdof);
-#ifdef _DEBUG
             dReal fmaxtransdist = 0;
-#endif
-            bool bSuccess = true;
-            if( linkdistthresh > 0 ) {
-                for (size_t ilink = 0; ilink < _vLinkAABBs.size(); ++ilink) {
-                    // check for an elipse
-                    // L^2 (b*v)^2 + |v|^2|b|^4 - (b*v)^2 |b|^2 <= |b|^4 * L^2
-                    Transform tnewlink = _vLinks[ilink]->GetTransform();
-                    TransformMatrix projdelta = _vOriginalInvTransforms[ilink] * tnewlink;
-                    projdelta.m[0] -= 1;
-                    projdelta.m[5] -= 1;
-                    projdelta.m[10] -= 1;
-                    Vector projextents = _vLinkAABBs[ilink].extents;
-                    Vector projboxright(projdelta.m[0]*projextents.x, projdelta.m[4]*projextents.x, projdelta.m[8]*projextents.x);
-                    Vector projboxup(projdelta.m[1]*projextents.y, projdelta.m[5]*projextents.y, projdelta.m[9]*projextents.y);
-                    Vector projboxdir(projdelta.m[2]*projextents.z, projdelta.m[6]*projextents.z, projdelta.m[10]*projextents.z);
-                    Vector projboxpos = projdelta * _vLinkAABBs[ilink].pos;
-
-                    Vector b;
-                    if( busebiasing ) {
-                        b = _vOriginalInvTransforms[ilink].rotate(_vbiasdirection); // inside link coordinate system
-                    }
-                    else {
-                        // doesn't matter which vector we pick since it is just a sphere.
-                        b = Vector(0,0,linkdistthresh);
-                    }
-
-                    dReal blength2 = b.lengthsqr3();
-                    dReal blength4 = blength2*blength2;
-                    dReal rhs = blength4 * linkdistthresh2;
-                    //dReal rhs = (b.lengthsqr3()) * linkdistthresh;
-                    dReal ellipdist = 0;
-                    // now figure out what is the max distance
-                    for(int ix = 0; ix < 2; ++ix) {
-                        Vector projvx = ix > 0 ? projboxpos + projboxright : projboxpos - projboxright;
-                        for(int iy = 0; iy < 2; ++iy) {
-                            Vector projvy = iy > 0 ? projvx + projboxup : projvx - projboxup;
-                            for(int iz = 0; iz < 2; ++iz) {
-                                Vector projvz = iz > 0 ? projvy + projboxdir : projvy - projboxdir;
-                                Vector v = projvz; // inside link coordinate system
-                                dReal bv = (v.dot3(b));
-                                dReal bv2 = bv*bv;
-                                dReal flen2 = (linkdistthresh2 - blength2) * bv2 + v.lengthsqr3()*blength4;
-
-                                if( ellipdist < flen2 ) {
-                                    ellipdist = flen2;
-#ifdef _DEBUG
-                                    fmaxtransdist = flen2;
-#endif
-                                    if (ellipdist > rhs) {
-                                        bSuccess = false;
-                                        break;
-                                    }
-                                }
-                            }
-
-                            if (ellipdist > rhs) {
-                                bSuccess = false;
-                                break;
-                            }
-                        }
-                        if (ellipdist > rhs) {
-                            bSuccess = false;
-                            break;
-                        }
-                    }
-                }
-
-                if (!bSuccess) {
-                    continue;
-                }
+            if( !_CheckLinkDistances(_vLinks, fmaxtransdist) ) {
+                continue;
             }
 
             // check perturbation
@@ -675,6 +546,10 @@ By default will sample the robot's active DOFs. Parameters part of the interface
                 }
             }
 
+            if( bCollision ) {
+                _InsertCollisionNode(vnewdof, _report);
+            }
+
             if( !bCollision && !bConstraintFailed ) {
                 // the last perturbation is 0, so state is already set to the correct jittered value
                 if( IS_DEBUGLEVEL(Level_Verbose) ) {
@@ -701,19 +576,375 @@ By default will sample the robot's active DOFs. Parameters part of the interface
                     robotsaver.Release();
                 }
 
-                RAVELOG_DEBUG_FORMAT("succeed iterations=%d, computation=%fs\n",iter%(1e-9*(utils::GetNanoPerformanceTime() - starttime)));
+                RAVELOG_DEBUG_FORMAT("succeed iterations=%d, cachehits=%d, computation=%fs\n",iter%_cachehit%(1e-9*(utils::GetNanoPerformanceTime() - starttime)));
                 //RAVELOG_VERBOSE_FORMAT("succeed iterations=%d, cachehits=%d, cache size=%d, originaldist=%f, computation=%fs\n",iter%_cachehit%cache.GetNumNodes()%cache.ComputeDistance(_curdof, vnewdof)%(1e-9*(utils::GetNanoPerformanceTime() - starttime)));
                 return 1;
             }
         }
 
-        RAVELOG_INFO_FORMAT("failed iterations=%d, computation=%fs\n",_maxiterations%(1e-9*(utils::GetNanoPerformanceTime() - starttime)));
+        RAVELOG_INFO_FORMAT("failed iterations=%d, cachehits=%d, computation=%fs\n",_maxiterations%_cachehit%(1e-9*(utils::GetNanoPerformanceTime() - starttime)));
         //RAVELOG_WARN_FORMAT("failed iterations=%d, cachehits=%d, cache size=%d, jitter time=%fs", _maxiterations%_cachehit%cache.GetNumNodes()%(1e-9*(utils::GetNanoPerformanceTime() - starttime)));
         return 0;
     }
 
 protected:
 
+    /// \brief environment snapshot that a jitter thread checks candidates on
+    struct JitterSnapshot
+    {
+        EnvironmentBasePtr penv;
+        RobotBasePtr probot; ///< the robot of penv with the same active DOFs as _probot
+        std::vector<KinBody::LinkPtr> vlinks; ///< links of probot and its grabbed bodies indexed like _vLinks
+        RobotBase::ManipulatorConstPtr pmanip; ///< manipulator of probot corresponding to _pmanip
+        CollisionReportPtr report;
+        std::vector<dReal> vnewdof, vnewdof2;
+    };
+    typedef boost::shared_ptr<JitterSnapshot> JitterSnapshotPtr;
+
+    /// \brief samples the candidate of iteration iter around _curdof and clamps it to the limits
+    ///
+    /// \return false if no candidate should be checked for this iteration
+    bool _SampleCandidate(int iter, std::vector<dReal>& vnewdof, IntervalType interval)
+    {
+        BOOST_ASSERT(!_busebiasing || _vbiasdofdirection.size() > 0);
+        const boost::array<dReal, 3> rayincs = {{0.5, 0.9, 0.2}};
+
+        const bool busebiasing = _busebiasing;
+        const int nMaxIterRadiusThresh=_maxiterations/2;
+        const dReal imaxiterations = 2.0/dReal(_maxiterations);
+        const dReal fJitterLowerThresh=0.2, fJitterHigherThresh=0.8;
+        dReal fBias = _vbiasdirection.lengthsqr3();
+        if( fBias > g_fEpsilon ) {
+            fBias = RaveSqrt(fBias);
+        }
+
+        if( busebiasing && iter < (int)rayincs.size() ) {
+            // start by checking samples directly above the current configuration
+            for (size_t j = 0; j < vnewdof.size(); ++j) {
+                vnewdof[j] = _curdof[j] + (rayincs[iter] * _vbiasdofdirection.at(j));
+            }
+        }
+        else {
+            // ramp of the jitter as iterations increase
+            dReal jitter = _maxjitter;
+            if( iter < nMaxIterRadiusThresh ) {
+                jitter = _maxjitter*dReal(iter+1)*imaxiterations;
+            }
+
+            bool samplebiasdir = false;
+            bool samplenull = false;
+            bool sampledelta = false;
+            if (busebiasing && _ssampler->SampleSequenceOneReal() < _nullsampleprob)
+            {
+                samplenull = true;
+            }
+            if (busebiasing && _ssampler->SampleSequenceOneReal() < _nullbiassampleprob) {
+                samplebiasdir = true;
+            }
+            if( (!samplenull && !samplebiasdir) || _ssampler->SampleSequenceOneReal() < _deltasampleprob ) {
+                sampledelta = true;
+            }
+
+            bool deltasuccess = false;
+            if( sampledelta ) {
+                // check which third the sampled dof is in
+                for(size_t j = 0; j < vnewdof.size(); ++j) {
+                    dReal f = 2*_ssampler->SampleSequenceOneReal(interval)-1; // f in [-1,1]
+                    if( RaveFabs(f) < fJitterLowerThresh ) {
+                        _deltadof[j] = 0;
+                    }
+                    else if( f < -fJitterHigherThresh ) {
+                        _deltadof[j] = -jitter;
+                    }
+                    else if( f > fJitterHigherThresh ) {
+                        _deltadof[j] = jitter;
+                    }
+                    else {
+                        _deltadof[j] = jitter*f;
+                    }
+                }
+                deltasuccess = true;
+            }
+
+            if (!samplebiasdir && !samplenull && !deltasuccess) {
+                return false;
+            }
+            // (lambda * biasdir) + (Nx) + delta + _curdofs
+            dReal fNullspaceMultiplier = _linkdistthresh*2;
+            if( fNullspaceMultiplier <= 0 ) {
+                fNullspaceMultiplier = fBias;
+            }
+            for (size_t k = 0; k < vnewdof.size(); ++k) {
+                vnewdof[k] = _curdof[k];
+                if (samplebiasdir) {
+                    vnewdof[k] += _ssampler->SampleSequenceOneReal() * _vbiasdofdirection[k];
+                }
+                if (samplenull) {
+                    for (size_t j = 0; j < _vbiasnullspace.size(); ++j) {
+                        dReal nullx = (_ssampler->SampleSequenceOneReal()*2-1)*fNullspaceMultiplier;
+                        vnewdof[k] += nullx * _vbiasnullspace[j][k];
+                    }
+                }
+                if (sampledelta) {
+                    vnewdof[k] += _deltadof[k];
+                }
+            }
+        }
+
+        // get new state
+        for(size_t j = 0; j < _deltadof.size(); ++j) {
+            if( vnewdof[j] > _upper.at(j) ) {
+                vnewdof[j] = _upper.at(j);
+            }
+            else if( vnewdof[j] < _lower.at(j) ) {
+                vnewdof[j] = _lower.at(j);
+            }
+        }
+
+        if( !!_cache ) {
+            if( !!_cache->FindNearestNode(vnewdof, _neighdistthresh, CNT_Collision).first ) {
+                _cachehit++;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// \brief checks that every link of vlinks stays within _linkdistthresh of its original transform, the robot has to be set to the candidate configuration
+    ///
+    /// \param vlinks the links indexed like _vLinks, can belong to an environment snapshot
+    /// \param fmaxtransdist set to the max projected distance that was checked
+    bool _CheckLinkDistances(const std::vector<KinBody::LinkPtr>& vlinks, dReal& fmaxtransdist) const
+    {
+        if( _linkdistthresh <= 0 ) {
+            return true;
+        }
+        for (size_t ilink = 0; ilink < _vLinkAABBs.size(); ++ilink) {
+            // check for an elipse
+            // L^2 (b*v)^2 + |v|^2|b|^4 - (b*v)^2 |b|^2 <= |b|^4 * L^2
+            Transform tnewlink = vlinks[ilink]->GetTransform();
+            TransformMatrix projdelta = _vOriginalInvTransforms[ilink] * tnewlink;
+            projdelta.m[0] -= 1;
+            projdelta.m[5] -= 1;
+            projdelta.m[10] -= 1;
+            Vector projextents = _vLinkAABBs[ilink].extents;
+            Vector projboxright(projdelta.m[0]*projextents.x, projdelta.m[4]*projextents.x, projdelta.m[8]*projextents.x);
+            Vector projboxup(projdelta.m[1]*projextents.y, projdelta.m[5]*projextents.y, projdelta.m[9]*projextents.y);
+            Vector projboxdir(projdelta.m[2]*projextents.z, projdelta.m[6]*projextents.z, projdelta.m[10]*projextents.z);
+            Vector projboxpos = projdelta * _vLinkAABBs[ilink].pos;
+
+            Vector b;
+            if( _busebiasing ) {
+                b = _vOriginalInvTransforms[ilink].rotate(_vbiasdirection); // inside link coordinate system
+            }
+            else {
+                // doesn't matter which vector we pick since it is just a sphere.
+                b = Vector(0,0,_linkdistthresh);
+            }
+
+            dReal blength2 = b.lengthsqr3();
+            dReal blength4 = blength2*blength2;
+            dReal rhs = blength4 * _linkdistthresh2;
+            //dReal rhs = (b.lengthsqr3()) * linkdistthresh;
+            dReal ellipdist = 0;
+            // now figure out what is the max distance
+            for(int ix = 0; ix < 2; ++ix) {
+                Vector projvx = ix > 0 ? projboxpos + projboxright : projboxpos - projboxright;
+                for(int iy = 0; iy < 2; ++iy) {
+                    Vector projvy = iy > 0 ? projvx + projboxup : projvx - projboxup;
+                    for(int iz = 0; iz < 2; ++iz) {
+                        Vector projvz = iz > 0 ? projvy + projboxdir : projvy - projboxdir;
+                        Vector v = projvz; // inside link coordinate system
+                        dReal bv = (v.dot3(b));
+                        dReal bv2 = bv*bv;
+                        dReal flen2 = (_linkdistthresh2 - blength2) * bv2 + v.lengthsqr3()*blength4;
+
+                        if( ellipdist < flen2 ) {
+                            ellipdist = flen2;
+                            fmaxtransdist = flen2;
+                            if (ellipdist > rhs) {
+                                return false;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    /// \brief checks the candidates in blocks of _nBlockSize on the environment snapshots, see SetNumThreads
+    ///
+    /// The candidates are sampled in this thread so that they do not depend on the number of threads.
+    /// Out of the first block that has valid candidates, returns the one closest to the original configuration.
+    int _SampleParallel(std::vector<dReal>& vnewdof, IntervalType interval, RobotBase::RobotStateSaver& robotsaver, const std::vector<dReal>& perturbations, uint64_t starttime)
+    {
+        const size_t dof = vnewdof.size();
+        int iter = 0;
+        while(iter < _maxiterations) {
+            _CallStatusFunctions(iter);
+            _vblocksamples.resize(0);
+            while(iter < _maxiterations && _vblocksamples.size() < _nBlockSize*dof) {
+                if( _SampleCandidate(iter, vnewdof, interval) ) {
+                    _vblocksamples.insert(_vblocksamples.end(), vnewdof.begin(), vnewdof.end());
+                }
+                ++iter;
+            }
+            const size_t numcandidates = _vblocksamples.size()/dof;
+            if( numcandidates == 0 ) {
+                continue;
+            }
+
+            _vblockresults.resize(numcandidates);
+            std::fill(_vblockresults.begin(), _vblockresults.end(), 0);
+            _vblockcollidinglinks.resize(numcandidates);
+            _pworkers->Run(_vsnapshots.size(), boost::bind(&ConfigurationJitterer::_CheckCandidatesRange,this,numcandidates,boost::cref(perturbations),_1,_2));
+
+            int ibest = -1;
+            dReal fbestdist2 = 0;
+            for(size_t icandidate = 0; icandidate < numcandidates; ++icandidate) {
+                if( _vblockresults[icandidate] == 2 ) {
+                    if( !!_cache ) {
+                        _vonesample.assign(_vblocksamples.begin()+icandidate*dof, _vblocksamples.begin()+(icandidate+1)*dof);
+                        _cachereport->plink1 = _vblockcollidinglinks[icandidate].first;
+                        _cachereport->plink2 = _vblockcollidinglinks[icandidate].second;
+                        _InsertCollisionNode(_vonesample, _cachereport);
+                    }
+                    _vblockcollidinglinks[icandidate].first.reset();
+                    _vblockcollidinglinks[icandidate].second.reset();
+                }
+                if( _vblockresults[icandidate] != 1 ) {
+                    continue;
+                }
+                dReal fdist2 = 0;
+                for(size_t j = 0; j < dof; ++j) {
+                    dReal f = _vblocksamples[icandidate*dof+j] - _curdof[j];
+                    fdist2 += f*f;
+                }
+                if( ibest < 0 || fdist2 < fbestdist2 ) {
+                    ibest = icandidate;
+                    fbestdist2 = fdist2;
+                }
+            }
+
+            if( ibest >= 0 ) {
+                vnewdof.assign(_vblocksamples.begin()+ibest*dof, _vblocksamples.begin()+(ibest+1)*dof);
+                _probot->SetActiveDOFValues(vnewdof);
+                if( _bSetResultOnRobot ) {
+                    // have to release the saver so it does not restore the old configuration
+                    robotsaver.Release();
+                }
+                RAVELOG_DEBUG_FORMAT("succeed iterations=%d, candidates=%d, threads=%d, cachehits=%d, computation=%fs\n",iter%numcandidates%_vsnapshots.size()%_cachehit%(1e-9*(utils::GetNanoPerformanceTime() - starttime)));
+                return 1;
+            }
+        }
+
+        RAVELOG_INFO_FORMAT("failed iterations=%d, threads=%d, cachehits=%d, computation=%fs\n",_maxiterations%_vsnapshots.size()%_cachehit%(1e-9*(utils::GetNanoPerformanceTime() - starttime)));
+        return 0;
+    }
+
+    /// \brief checks the candidates of _vblocksamples that belong to snapshots [start, end), called from the worker threads
+    void _CheckCandidatesRange(size_t numcandidates, const std::vector<dReal>& perturbations, size_t start, size_t end)
+    {
+        const size_t dof = _curdof.size();
+        const size_t numsnapshots = _vsnapshots.size();
+        for(size_t isnapshot = start; isnapshot < end; ++isnapshot) {
+            JitterSnapshot& snapshot = *_vsnapshots[isnapshot];
+            EnvironmentMutex::scoped_lock lock(snapshot.penv->GetMutex());
+            for(size_t icandidate = (numcandidates*isnapshot)/numsnapshots; icandidate < (numcandidates*(isnapshot+1))/numsnapshots; ++icandidate) {
+                try {
+                    snapshot.vnewdof.assign(_vblocksamples.begin()+icandidate*dof, _vblocksamples.begin()+(icandidate+1)*dof);
+                    _vblockresults[icandidate] = _CheckSnapshotCandidate(snapshot, perturbations);
+                    if( _vblockresults[icandidate] == 2 ) {
+                        _vblockcollidinglinks[icandidate] = std::make_pair(snapshot.report->plink1, snapshot.report->plink2);
+                    }
+                }
+                catch(const std::exception& ex) {
+                    RAVELOG_WARN_FORMAT("env=%d, failed to check jitter candidate %d: %s", GetEnv()->GetId()%icandidate%ex.what());
+                }
+            }
+        }
+    }
+
+    /// \brief checks the link distances, tool direction, and collisions of snapshot.vnewdof and its perturbations
+    ///
+    /// \return 1 if the candidate is valid, 2 if it is in collision and snapshot.report holds the collision, 0 if it failed the other checks
+    uint8_t _CheckSnapshotCandidate(JitterSnapshot& snapshot, const std::vector<dReal>& perturbations) const
+    {
+        snapshot.probot->SetActiveDOFValues(snapshot.vnewdof);
+        dReal fmaxtransdist = 0;
+        if( !_CheckLinkDistances(snapshot.vlinks, fmaxtransdist) ) {
+            return 0;
+        }
+        FOREACHC(itperturbation,perturbations) {
+            for(size_t j = 0; j < snapshot.vnewdof.size(); ++j) {
+                snapshot.vnewdof2[j] = snapshot.vnewdof[j] + *itperturbation;
+                if( snapshot.vnewdof2[j] > _upper.at(j) ) {
+                    snapshot.vnewdof2[j] = _upper.at(j);
+                }
+                else if( snapshot.vnewdof2[j] < _lower.at(j) ) {
+                    snapshot.vnewdof2[j] = _lower.at(j);
+                }
+            }
+            snapshot.probot->SetActiveDOFValues(snapshot.vnewdof2);
+            if( !!_pConstraintToolDirection && !!snapshot.pmanip ) {
+                if( !_pConstraintToolDirection->IsInConstraints(snapshot.pmanip->GetTransform()) ) {
+                    return 0;
+                }
+            }
+            if( snapshot.penv->CheckCollision(snapshot.probot, snapshot.report) || snapshot.probot->CheckSelfCollision(snapshot.report) ) {
+                return 2;
+            }
+        }
+        return 1;
+    }
+
+    /// \brief updates one environment snapshot per jitter thread, see SetNumThreads
+    ///
+    /// The snapshots are kept between calls so that only the bodies that changed need to be copied.
+    bool _InitSnapshots()
+    {
+        _vsnapshots.resize(_nNumThreads);
+        for(int ithread = 0; ithread < _nNumThreads; ++ithread) {
+            JitterSnapshotPtr& snapshot = _vsnapshots[ithread];
+            if( !snapshot ) {
+                snapshot.reset(new JitterSnapshot());
+                snapshot->penv = GetEnv()->CloneSelf(Clone_Bodies);
+                snapshot->report.reset(new CollisionReport());
+            }
+            else {
+                snapshot->penv->Clone(GetEnv(), Clone_Bodies|Clone_SkipUnchangedBodies);
+            }
+            EnvironmentMutex::scoped_lock lock(snapshot->penv->GetMutex());
+            snapshot->probot = snapshot->penv->GetRobot(_probot->GetName());
+            if( !snapshot->probot ) {
+                RAVELOG_WARN_FORMAT("env=%d, snapshot %d does not have robot %s", GetEnv()->GetId()%ithread%_probot->GetName());
+                return false;
+            }
+            snapshot->probot->SetActiveDOFs(_vActiveIndices, _nActiveAffineDOFs, _vActiveAffineAxis);
+            snapshot->vlinks = snapshot->probot->GetLinks();
+            std::vector<KinBodyPtr> vgrabbedbodies;
+            snapshot->probot->GetGrabbed(vgrabbedbodies);
+            FOREACHC(itgrabbed, vgrabbedbodies) {
+                snapshot->vlinks.insert(snapshot->vlinks.end(), (*itgrabbed)->GetLinks().begin(), (*itgrabbed)->GetLinks().end());
+            }
+            if( snapshot->vlinks.size() != _vLinks.size() ) {
+                RAVELOG_WARN_FORMAT("env=%d, snapshot %d has %d links to track, expected %d", GetEnv()->GetId()%ithread%snapshot->vlinks.size()%_vLinks.size());
+                return false;
+            }
+            snapshot->pmanip.reset();
+            if( !!_pmanip ) {
+                snapshot->pmanip = snapshot->probot->GetManipulator(_pmanip->GetName());
+            }
+            snapshot->vnewdof.resize(_curdof.size());
+            snapshot->vnewdof2.resize(_curdof.size());
+        }
+        if( !_pworkers || _pworkers->GetNumThreads() != _nNumThreads ) {
+            _pworkers.reset(new ParallelRangeWorkers(_nNumThreads, "ConfigurationJitterer"));
+        }
+        return true;
+    }
+
     /// \brief extracts all used bodies from the configurationspecification and computes AABBs, transforms, and limits for links
     void _InitRobotState()
     {
@@ -803,9 +1034,67 @@ protected:
             _vLinkAABBs[i] = _vLinks[i]->ComputeLocalAABB();
         }
 
+        if( !!_cache ) {
+            // the colliding configurations stay valid as long as only the jittered DOFs change
+            _GetCacheState(_vtempbodystamps, _vtemprobotstate);
+            if( _vtempbodystamps != _vcachebodystamps || _vtemprobotstate != _vcacherobotstate ) {
+                _cache->Reset();
+                _vcachebodystamps.swap(_vtempbodystamps);
+                _vcacherobotstate.swap(_vtemprobotstate);
+            }
+        }
+    }
+
+    /// \brief gets the state that the colliding configurations of the cache depend on
+    ///
+    /// \param vbodystamps the (environment id, update stamp) of all the bodies except the robot and its grabbed bodies, followed by the negated environment ids of the grabbed bodies
+    /// \param vrobotstate the values of the robot DOFs that are not jittered, preceded by the robot transform if no affine DOFs are jittered
+    void _GetCacheState(std::vector<int>& vbodystamps, std::vector<dReal>& vrobotstate)
+    {
+        vbodystamps.resize(0);
+        std::vector<KinBodyPtr> vbodies;
+        GetEnv()->GetBodies(vbodies);
+        FOREACHC(itbody, vbodies) {
+            if( *itbody == _probot || !!_probot->IsGrabbing(*itbody) ) {
+                continue;
+            }
+            vbodystamps.push_back((*itbody)->GetEnvironmentId());
+            vbodystamps.push_back((*itbody)->GetUpdateStamp());
+        }
+        std::vector<KinBodyPtr> vgrabbed;
+        _probot->GetGrabbed(vgrabbed);
+        FOREACHC(itbody, vgrabbed) {
+            vbodystamps.push_back(-(*itbody)->GetEnvironmentId());
+        }
+
+        vrobotstate.resize(0);
+        if( _nActiveAffineDOFs == 0 ) {
+            Transform t = _probot->GetTransform();
+            vrobotstate.push_back(t.trans.x); vrobotstate.push_back(t.trans.y); vrobotstate.push_back(t.trans.z);
+            vrobotstate.push_back(t.rot.x); vrobotstate.push_back(t.rot.y); vrobotstate.push_back(t.rot.z); vrobotstate.push_back(t.rot.w);
+        }
+        std::vector<dReal> vdofvalues;
+        _probot->GetDOFValues(vdofvalues);
+        for(size_t idof = 0; idof < vdofvalues.size(); ++idof) {
+            if( find(_vActiveIndices.begin(), _vActiveIndices.end(), (int)idof) == _vActiveIndices.end() ) {
+                vrobotstate.push_back(vdofvalues[idof]);
+            }
+        }
+    }
+
+    /// \brief inserts a configuration that is in collision in the cache
+    void _InsertCollisionNode(const std::vector<dReal>& vdof, CollisionReportPtr report)
+    {
+        // the cache nodes need the robot link that collided
+        if( !!_cache && !!report->plink1 ) {
+            _cache->InsertNode(vdof, report, _neighdistthresh);
+        }
+    }
 
+    void _ResetCache()
+    {
         if( !!_cache ) {
-            _cache->Reset(); // need this here in order to invalidate cache.
+            _cache->Reset();
         }
     }
 
@@ -869,7 +1158,7 @@ protected:
     boost::function<bool (std::vector<dReal>&,const std::vector<dReal>&, int)> _neighstatefn; ///< if initialized, then use this function to get nearest neighbor
     ///< Advantage of using neightstatefn is that user constraints can be met like maintaining a certain orientation of the gripper.
 
-    UserDataPtr _limitscallback, _grabbedcallback; ///< limits,grabbed change handles
+    UserDataPtr _limitscallback, _grabbedcallback, _geometrycallback; ///< limits,grabbed,geometry change handles
 
     /// \return Return 0 if jitter failed and constraints are not satisfied. -1 if constraints are originally satisfied. 1 if jitter succeeded, configuration is different, and constraints are satisfied.
 
@@ -881,8 +1170,11 @@ protected:
 
     std::vector<dReal> _curdof, _newdof2, _deltadof, _deltadof2, _vonesample;
 
-    CacheTreePtr _cache; ///< caches the visisted configurations
-    int _cachehit;
+    CacheTreePtr _cache; ///< caches the configurations that were found in collision
+    int _cachehit; ///< number of candidates skipped because they were close to a colliding configuration of the cache
+    CollisionReportPtr _cachereport; ///< for inserting the collisions found on the snapshots
+    std::vector<int> _vcachebodystamps, _vtempbodystamps; ///< see _GetCacheState
+    std::vector<dReal> _vcacherobotstate, _vtemprobotstate; ///< see _GetCacheState
     dReal _neighdistthresh; ///< the minimum distance that nodes can be with respect to each other for the cache
 
     // for biasing
@@ -900,6 +1192,14 @@ protected:
 
     bool _bSetResultOnRobot; ///< if true, will set the final result on the robot DOF values
     bool _busebiasing; ///< if true will bias the end effector along a certain direction using the jacobian and nullspace.
+
+    int _nNumThreads; ///< if > 1, the candidates are checked in parallel on that many environment snapshots
+    size_t _nBlockSize; ///< number of candidates sampled before checking them in parallel
+    std::vector<JitterSnapshotPtr> _vsnapshots; ///< one per thread
+    ParallelRangeWorkersPtr _pworkers;
+    std::vector<dReal> _vblocksamples; ///< the candidates of the current block, packed by DOF
+    std::vector<uint8_t> _vblockresults; ///< for every candidate of _vblocksamples, 1 if valid, 2 if in collision, 0 otherwise
+    std::vector< std::pair<KinBody::LinkConstPtr, KinBody::LinkConstPtr> > _vblockcollidinglinks; ///< for the candidates in collision, the colliding links on the snapshot
 };
 
 SpaceSamplerBasePtr CreateConfigurationJitterer(EnvironmentBasePtr penv, std::istream& sinput)
@@ -283,6 +283,16 @@ public:
         _cache->SetFreeSpaceThresh(freespacethresh);
     }
 
+    void SetLinkSpherePadding(dReal padding)
+    {
+        _cache->SetLinkSpherePadding(padding);
+    }
+
+    dReal GetLinkSpherePadding()
+    {
+        return _cache->GetLinkSpherePadding();
+    }
+
     void SetWeights(object oweights)
     {
         _cache->SetWeights(ExtractArray<dReal>(oweights));
@@ -363,6 +373,8 @@ BOOST_PYTHON_MODULE(openravepy_configurationcache)
     .def("SetCollisionThresh",&PyConfigurationCache::SetCollisionThresh, args("colthresh"))
     .def("SetFreeSpaceThresh",&PyConfigurationCache::SetFreeSpaceThresh, args("freespacethresh"))
     .def("SetWeights",&PyConfigurationCache::SetWeights, args("weights"))
+    .def("SetLinkSpherePadding",&PyConfigurationCache::SetLinkSpherePadding, args("padding"))
+    .def("GetLinkSpherePadding",&PyConfigurationCache::GetLinkSpherePadding)
     .def("SetInsertionDistanceMult",&PyConfigurationCache::SetInsertionDistanceMult, args("indist"))
     .def("GetRobot",&PyConfigurationCache::GetRobot)
     .def("GetNumNodes",&PyConfigurationCache::GetNumNodes)
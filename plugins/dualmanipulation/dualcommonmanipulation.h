@@ -120,6 +120,273 @@ protected:
         }
     };
 
+    /// \brief collision constraint for planning with both arms that caches the collisions of each arm separately
+    ///
+    /// The robot links are split into the links moved by each arm and the static links that do not move while planning.
+    /// The environment collisions of an arm's links and their self-collisions with each other and the static links only
+    /// depend on that arm's configuration, so they are cached per arm. The collisions between the links of the two arms are
+    /// cached with both arm configurations. A sample that moves only one arm has to check just the pairs of that arm again.
+    /// Robots with grabbed bodies, affine dofs, or active dofs outside of the two arms use the regular collision checks.
+    class DualArmCollisionConstraint : public planningutils::DynamicsCollisionConstraint
+    {
+public:
+        DualArmCollisionConstraint(PlannerBase::PlannerParametersConstPtr parameters, RobotBasePtr probot, RobotBase::ManipulatorConstPtr pmanip0, RobotBase::ManipulatorConstPtr pmanip1) : planningutils::DynamicsCollisionConstraint(parameters, std::list<KinBodyPtr>(1,probot), 0xffffffff&~CFO_CheckTimeBasedConstraints), _probot(probot), _bDecoupled(false), _nStaticEnvCollision(-1), _nStaticSelfCollision(-1), _nCacheHits(0), _nCacheMisses(0)
+        {
+            _bDecoupled = _InitArms(pmanip0, pmanip1);
+        }
+        virtual ~DualArmCollisionConstraint() {
+            RAVELOG_DEBUG_FORMAT("dual arm collision cache hits=%d, misses=%d", _nCacheHits%_nCacheMisses);
+        }
+
+protected:
+        static const int s_nCacheSize = 32; ///< number of configurations cached per arm and for the pairs between the arms
+
+        /// \brief collisions of one arm configuration, -1 if not checked yet
+        struct ArmCacheEntry
+        {
+            ArmCacheEntry() : envcollision(-1), selfcollision(-1) {
+            }
+            std::vector<dReal> q;
+            int8_t envcollision, selfcollision;
+        };
+
+        virtual int _CheckState(const std::vector<dReal>& vdofvelocities, const std::vector<dReal>& vdofaccels, int options, ConstraintFilterReturnPtr filterreturn)
+        {
+            options &= _filtermask;
+            int collisionoptions = options & (CFO_CheckEnvCollisions|CFO_CheckSelfCollisions);
+            if( !_bDecoupled || collisionoptions == 0 || _probot->GetActiveDOF() != (int)(_vArmActiveIndices[0].size()+_vArmActiveIndices[1].size()) ) {
+                return planningutils::DynamicsCollisionConstraint::_CheckState(vdofvelocities, vdofaccels, options, filterreturn);
+            }
+            int ret = planningutils::DynamicsCollisionConstraint::_CheckState(vdofvelocities, vdofaccels, options&~(CFO_CheckEnvCollisions|CFO_CheckSelfCollisions), filterreturn);
+            if( ret != 0 ) {
+                return ret;
+            }
+
+            _probot->GetActiveDOFValues(_vcurvalues);
+            bool bActiveOnly = !!(GetEnv()->GetCollisionChecker()->GetCollisionOptions() & CO_ActiveDOFs);
+            bool bFillReport = (options & CFO_FillCollisionReport) && !!filterreturn;
+            for(int iarm = 0; iarm < 2; ++iarm) {
+                ArmCacheEntry& entry = _FindArmEntry(iarm);
+                if( (collisionoptions & CFO_CheckEnvCollisions) && _UpdateCachedCollision(entry.envcollision, boost::bind(&DualArmCollisionConstraint::_CheckLinksEnv, this, boost::cref(_vArmLinks[iarm])), bFillReport) ) {
+                    return _OnCollision(CFO_CheckEnvCollisions, options, filterreturn);
+                }
+                if( (collisionoptions & CFO_CheckSelfCollisions) && _UpdateCachedCollision(entry.selfcollision, boost::bind(&DualArmCollisionConstraint::_CheckLinkPairs, this, boost::cref(_vArmLinkPairs[iarm])), bFillReport) ) {
+                    return _OnCollision(CFO_CheckSelfCollisions, options, filterreturn);
+                }
+            }
+            if( collisionoptions & CFO_CheckSelfCollisions ) {
+                int8_t& crosscollision = _FindCrossEntry();
+                if( _UpdateCachedCollision(crosscollision, boost::bind(&DualArmCollisionConstraint::_CheckLinkPairs, this, boost::cref(_vCrossLinkPairs)), bFillReport) ) {
+                    return _OnCollision(CFO_CheckSelfCollisions, options, filterreturn);
+                }
+            }
+            if( !bActiveOnly ) {
+                // the static links never move while planning, so have to be checked only once
+                if( (collisionoptions & CFO_CheckEnvCollisions) && _UpdateCachedCollision(_nStaticEnvCollision, boost::bind(&DualArmCollisionConstraint::_CheckLinksEnv, this, boost::cref(_vStaticLinks)), bFillReport) ) {
+                    return _OnCollision(CFO_CheckEnvCollisions, options, filterreturn);
+                }
+                if( (collisionoptions & CFO_CheckSelfCollisions) && _UpdateCachedCollision(_nStaticSelfCollision, boost::bind(&DualArmCollisionConstraint::_CheckLinkPairs, this, boost::cref(_vStaticLinkPairs)), bFillReport) ) {
+                    return _OnCollision(CFO_CheckSelfCollisions, options, filterreturn);
+                }
+            }
+            return 0;
+        }
+
+        /// \brief splits the active dofs, links, and non-adjacent link pairs between the two arms
+        ///
+        /// \return false if the collisions of the two arms cannot be decoupled
+        bool _InitArms(RobotBase::ManipulatorConstPtr pmanip0, RobotBase::ManipulatorConstPtr pmanip1)
+        {
+            if( _probot->GetAffineDOF() != 0 ) {
+                return false;
+            }
+            std::vector<KinBodyPtr> vgrabbed;
+            _probot->GetGrabbed(vgrabbed);
+            if( vgrabbed.size() > 0 ) {
+                return false;
+            }
+
+            const std::vector<int>& vactiveindices = _probot->GetActiveDOFIndices();
+            RobotBase::ManipulatorConstPtr pmanips[2] = { pmanip0, pmanip1 };
+            std::vector<int> vlinkarm(_probot->GetLinks().size(), -1);
+            for(int iarm = 0; iarm < 2; ++iarm) {
+                const std::vector<int>& varmindices = pmanips[iarm]->GetArmIndices();
+                _vArmActiveIndices[iarm].resize(0);
+                for(size_t i = 0; i < vactiveindices.size(); ++i) {
+                    if( find(varmindices.begin(), varmindices.end(), vactiveindices[i]) != varmindices.end() ) {
+                        _vArmActiveIndices[iarm].push_back(i);
+                    }
+                }
+                FOREACHC(itdofindex, varmindices) {
+                    int jointindex = _probot->GetJointFromDOFIndex(*itdofindex)->GetJointIndex();
+                    FOREACHC(itlink, _probot->GetLinks()) {
+                        int linkindex = (*itlink)->GetIndex();
+                        if( _probot->DoesAffect(jointindex, linkindex) ) {
+                            if( vlinkarm[linkindex] >= 0 && vlinkarm[linkindex] != iarm ) {
+                                RAVELOG_DEBUG_FORMAT("link %s is moved by both arms, cannot decouple collisions", (*itlink)->GetName());
+                                return false;
+                            }
+                            vlinkarm[linkindex] = iarm;
+                        }
+                    }
+                }
+            }
+            if( _vArmActiveIndices[0].size()+_vArmActiveIndices[1].size() != vactiveindices.size() ) {
+                return false;
+            }
+
+            for(int iarm = 0; iarm < 2; ++iarm) {
+                _vArmLinks[iarm].resize(0);
+                _vArmLinkPairs[iarm].resize(0);
+                _vArmCache[iarm].resize(0);
+                _vArmCacheNext[iarm] = 0;
+            }
+            _vStaticLinks.resize(0);
+            _vStaticLinkPairs.resize(0);
+            _vCrossLinkPairs.resize(0);
+            _vCrossCache.resize(0);
+            _nCrossCacheNext = 0;
+            FOREACHC(itlink, _probot->GetLinks()) {
+                int iarm = vlinkarm[(*itlink)->GetIndex()];
+                if( iarm >= 0 ) {
+                    _vArmLinks[iarm].push_back(*itlink);
+                }
+                else {
+                    _vStaticLinks.push_back(*itlink);
+                }
+            }
+            FOREACHC(itpair, _probot->GetNonAdjacentLinkPairs(KinBody::AO_Enabled)) {
+                int index0 = itpair->first, index1 = itpair->second;
+                std::pair<KinBody::LinkConstPtr, KinBody::LinkConstPtr> linkpair(_probot->GetLinks().at(index0), _probot->GetLinks().at(index1));
+                int iarm0 = vlinkarm.at(index0), iarm1 = vlinkarm.at(index1);
+                if( iarm0 < 0 && iarm1 < 0 ) {
+                    _vStaticLinkPairs.push_back(linkpair);
+                }
+                else if( iarm0 >= 0 && iarm1 >= 0 && iarm0 != iarm1 ) {
+                    _vCrossLinkPairs.push_back(linkpair);
+                }
+                else {
+                    _vArmLinkPairs[iarm0 >= 0 ? iarm0 : iarm1].push_back(linkpair);
+                }
+            }
+            RAVELOG_DEBUG_FORMAT("decoupled dual arm collisions, arm links=%d,%d, static links=%d, cross pairs=%d", _vArmLinks[0].size()%_vArmLinks[1].size()%_vStaticLinks.size()%_vCrossLinkPairs.size());
+            return true;
+        }
+
+        /// \brief returns the cache entry of the current configuration of arm iarm, replaces the oldest entry if not cached
+        ArmCacheEntry& _FindArmEntry(int iarm)
+        {
+            const std::vector<int>& vindices = _vArmActiveIndices[iarm];
+            std::vector<ArmCacheEntry>& vcache = _vArmCache[iarm];
+            FOREACH(itentry, vcache) {
+                size_t i = 0;
+                while(i < vindices.size() && itentry->q[i] == _vcurvalues[vindices[i]]) {
+                    ++i;
+                }
+                if( i == vindices.size() ) {
+                    return *itentry;
+                }
+            }
+            if( (int)vcache.size() < s_nCacheSize ) {
+                vcache.push_back(ArmCacheEntry());
+                _vArmCacheNext[iarm] = vcache.size()-1;
+            }
+            else {
+                _vArmCacheNext[iarm] = (_vArmCacheNext[iarm]+1)%s_nCacheSize;
+            }
+            ArmCacheEntry& entry = vcache.at(_vArmCacheNext[iarm]);
+            entry.q.resize(vindices.size());
+            for(size_t i = 0; i < vindices.size(); ++i) {
+                entry.q[i] = _vcurvalues[vindices[i]];
+            }
+            entry.envcollision = entry.selfcollision = -1;
+            return entry;
+        }
+
+        /// \brief returns the cached collision between the two arms for the current configuration, replaces the oldest entry if not cached
+        int8_t& _FindCrossEntry()
+        {
+            FOREACH(itentry, _vCrossCache) {
+                if( itentry->q == _vcurvalues ) {
+                    return itentry->selfcollision;
+                }
+            }
+            if( (int)_vCrossCache.size() < s_nCacheSize ) {
+                _vCrossCache.push_back(ArmCacheEntry());
+                _nCrossCacheNext = _vCrossCache.size()-1;
+            }
+            else {
+                _nCrossCacheNext = (_nCrossCacheNext+1)%s_nCacheSize;
+            }
+            ArmCacheEntry& entry = _vCrossCache.at(_nCrossCacheNext);
+            entry.q = _vcurvalues;
+            entry.selfcollision = -1;
+            return entry.selfcollision;
+        }
+
+        /// \brief fills the cached collision with checkfn if not known yet
+        ///
+        /// A cached collision is checked again when the report has to be filled since _report could be from another check.
+        bool _UpdateCachedCollision(int8_t& cachedcollision, const boost::function<bool()>& checkfn, bool bFillReport)
+        {
+            if( cachedcollision < 0 || (cachedcollision > 0 && bFillReport) ) {
+                cachedcollision = checkfn();
+                ++_nCacheMisses;
+            }
+            else {
+                ++_nCacheHits;
+            }
+            return cachedcollision > 0;
+        }
+
+        bool _CheckLinksEnv(const std::vector<KinBody::LinkPtr>& vlinks)
+        {
+            FOREACHC(itlink, vlinks) {
+                if( GetEnv()->CheckCollision(KinBody::LinkConstPtr(*itlink), _report) ) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool _CheckLinkPairs(const std::vector< std::pair<KinBody::LinkConstPtr, KinBody::LinkConstPtr> >& vlinkpairs)
+        {
+            FOREACHC(itpair, vlinkpairs) {
+                if( GetEnv()->CheckCollision(itpair->first, itpair->second, _report) ) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        int _OnCollision(int collisiontype, int options, ConstraintFilterReturnPtr filterreturn)
+        {
+            if( (options & CFO_FillCollisionReport) && !!filterreturn ) {
+                filterreturn->_report = *_report;
+            }
+            if( IS_DEBUGLEVEL(Level_Verbose) ) {
+                _PrintOnFailure(std::string("collision failed ")+_report->__str__());
+            }
+            return collisiontype;
+        }
+
+        EnvironmentBasePtr GetEnv() const {
+            return _probot->GetEnv();
+        }
+
+        RobotBasePtr _probot;
+        bool _bDecoupled; ///< true if the collisions of the two arms are checked separately
+        std::vector<int> _vArmActiveIndices[2]; ///< indices into the active dofs of each arm
+        std::vector<KinBody::LinkPtr> _vArmLinks[2], _vStaticLinks; ///< links moved by each arm and links moved by neither
+        std::vector< std::pair<KinBody::LinkConstPtr, KinBody::LinkConstPtr> > _vArmLinkPairs[2], _vCrossLinkPairs, _vStaticLinkPairs;
+        std::vector<ArmCacheEntry> _vArmCache[2], _vCrossCache;
+        int _vArmCacheNext[2], _nCrossCacheNext;
+        int8_t _nStaticEnvCollision, _nStaticSelfCollision;
+        std::vector<dReal> _vcurvalues;
+        int _nCacheHits, _nCacheMisses;
+    };
+    typedef boost::shared_ptr<DualArmCollisionConstraint> DualArmCollisionConstraintPtr;
+
     static bool SetActiveTrajectory(RobotBasePtr robot, TrajectoryBasePtr pActiveTraj, bool bExecute, const string& strsavetraj, boost::shared_ptr<ostream> pout,dReal fMaxVelMult=1)
     {
         if( pActiveTraj->GetNumWaypoints() == 0 ) {
@@ -279,6 +279,10 @@ protected:
         //set to initial config again before initializing the constraint fn
         robot->SetActiveDOFValues(params->vinitialconfig);
 
+        // each sample usually moves the arms by different amounts, so cache the collisions of each arm separately
+        CM::DualArmCollisionConstraintPtr pcollision(new CM::DualArmCollisionConstraint(params, robot, pmanipA, pmanipI));
+        params->_checkpathvelocityconstraintsfn = boost::bind(&planningutils::DynamicsCollisionConstraint::Check,pcollision,_1, _2, _3, _4, _5, _6, _7, _8);
+
         if( constrainterrorthresh > 0 ) {
             RAVELOG_DEBUG("setting DualArmConstrained function in planner parameters\n");
             boost::shared_ptr<CM::DualArmManipulation<double> > dplanner(new CM::DualArmManipulation<double>(robot,pmanipA,pmanipI));
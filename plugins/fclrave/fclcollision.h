@@ -9,14 +9,16 @@
 
 #include "fclspace.h"
 #include "fclmanagercache.h"
+#include "fclthreadview.h"
+
+#include <thread>
+#include <atomic>
+#include <exception>
 
 #include "fclstatistics.h"
 
 namespace fclrave {
 
-#define START_TIMING_OPT(statistics, label, options, isRobot);           \
-    START_TIMING(statistics, boost::str(boost::format("%s,%x,%d")%label%options%isRobot))
-
 #ifdef FCLRAVE_COLLISION_OBJECTS_STATISTICS
 static EnvironmentMutex log_collision_use_mutex;
 #endif // FCLRAVE_COLLISION_OBJECTS_STATISTIC
@@ -59,7 +61,7 @@ class FCLCollisionChecker : public OpenRAVE::CollisionCheckerBase
 public:
     class CollisionCallbackData {
 public:
-        CollisionCallbackData(boost::shared_ptr<FCLCollisionChecker> pchecker, CollisionReportPtr report, const std::vector<KinBodyConstPtr>& vbodyexcluded = std::vector<KinBodyConstPtr>(), const std::vector<LinkConstPtr>& vlinkexcluded = std::vector<LinkConstPtr>()) : _pchecker(pchecker), _report(report), _vbodyexcluded(vbodyexcluded), _vlinkexcluded(vlinkexcluded), bselfCollision(false), _bStopChecking(false), _bCollision(false)
+        CollisionCallbackData(boost::shared_ptr<FCLCollisionChecker> pchecker, CollisionReportPtr report, const std::vector<KinBodyConstPtr>& vbodyexcluded = std::vector<KinBodyConstPtr>(), const std::vector<LinkConstPtr>& vlinkexcluded = std::vector<LinkConstPtr>()) : _pchecker(pchecker), _report(report), _vbodyexcluded(vbodyexcluded), _vlinkexcluded(vlinkexcluded), bselfCollision(false), _bStopChecking(false), _bCollision(false), _bThreadView(false)
         {
             _bHasCallbacks = _pchecker->GetEnv()->HasRegisteredCollisionCallbacks();
             if( _bHasCallbacks && !_report ) {
@@ -70,6 +72,10 @@ public:
             // TODO not sure what's happening with FCL's contact computation. is it really disabled?
             if( !!report && !!(_pchecker->GetCollisionOptions() & OpenRAVE::CO_Contacts) ) {
                 _request.num_max_contacts = _pchecker->GetNumMaxContacts();
+                if( report->nMaxContacts > 0 && report->nMaxContacts < _request.num_max_contacts ) {
+                    // the narrowphase stops once it has as many contacts as the caller asked for
+                    _request.num_max_contacts = report->nMaxContacts;
+                }
                 _request.enable_contact = true;
             } else {
                 _request.enable_contact = false; // explicitly disable
@@ -103,27 +109,62 @@ public:
         bool _bCollision;  ///< result of the collision
 
         bool _bHasCallbacks; ///< true if there's callbacks registered in the environment
+        bool _bThreadView; ///< true if the query runs in a worker thread of CheckCollisionBatch on a FCLThreadView, so no state of the checker should be modified
         std::list<EnvironmentBase::CollisionCallbackFn> _listcallbacks;
     };
 
     typedef boost::shared_ptr<CollisionCallbackData> CollisionCallbackDataPtr;
 
+    struct EnvManagerCacheEntry;
+    typedef std::map< std::set<int>, EnvManagerCacheEntry > ENVMANAGERSMAP; ///< maps the environment ids of the excluded bodies to their manager
+
+    /// \brief an environment manager cached in _envmanagers
+    struct EnvManagerCacheEntry
+    {
+        EnvManagerCacheEntry() : nbytes(0) {
+        }
+        FCLCollisionManagerInstancePtr pmanager;
+        std::list<ENVMANAGERSMAP::iterator>::iterator itlru; ///< position in _listEnvManagerLRU
+        size_t nbytes; ///< estimated bytes of pmanager when it was last used
+    };
+
+    /// \brief counters of the environment manager cache, see GetEnvManagerCacheStatistics
+    struct EnvManagerCacheStatistics
+    {
+        EnvManagerCacheStatistics() : nHits(0), nMisses(0), nEvictions(0), nRebuildMicroseconds(0) {
+        }
+        uint64_t nHits, nMisses, nEvictions;
+        uint64_t nRebuildMicroseconds; ///< time spent creating and synchronizing the managers of the misses
+    };
+
     FCLCollisionChecker(OpenRAVE::EnvironmentBasePtr penv, std::istream& sinput)
         : OpenRAVE::CollisionCheckerBase(penv), _broadPhaseCollisionManagerAlgorithm("DynamicAABBTree2"), _bIsSelfCollisionChecker(true) // DynamicAABBTree2 should be slightly faster than Naive
     {
+        _bAutoBroadphase = false;
+        _bAutoBroadphaseTiming = false;
+        _nAutoBroadphaseWarmupQueries = 32;
         _userdatakey = std::string("fclcollision") + boost::lexical_cast<std::string>(this);
         _fclspace.reset(new FCLSpace(penv, _userdatakey));
         _options = 0;
         // TODO : Should we put a more reasonable arbitrary value ?
         _numMaxContacts = std::numeric_limits<int>::max();
-        _nGetEnvManagerCacheClearCount = 100000;
+        _nEnvManagerCacheCapacity = 64;
+        _nEnvManagerCacheMaxBytes = 0;
+        _nEnvManagerCacheBytes = 0;
+        _nNumThreads = 1;
+        _bResultCache = false;
         __description = ":Interface Author: Kenji Maillard\n\nFlexible Collision Library collision checker";
 
-        SETUP_STATISTICS(_statistics, _userdatakey, GetEnv()->GetId());
-
         // TODO : Consider removing these which could be more harmful than anything else
-        RegisterCommand("SetBroadphaseAlgorithm", boost::bind(&FCLCollisionChecker::SetBroadphaseAlgorithmCommand, this, _1, _2), "sets the broadphase algorithm (Naive, SaP, SSaP, IntervalTree, DynamicAABBTree, DynamicAABBTree_Array)");
+        RegisterCommand("SetBroadphaseAlgorithm", boost::bind(&FCLCollisionChecker::SetBroadphaseAlgorithmCommand, this, _1, _2), "sets the broadphase algorithm (Naive, SaP, SSaP, IntervalTree, DynamicAABBTree, DynamicAABBTree_Array, Auto). Auto can be followed by the number of environment queries each candidate is timed on");
         RegisterCommand("SetBVHRepresentation", boost::bind(&FCLCollisionChecker::_SetBVHRepresentation, this, _1, _2), "sets the Bouding Volume Hierarchy representation for meshes (AABB, OBB, OBBRSS, RSS, kIDS)");
+        RegisterCommand("SetNumThreads", boost::bind(&FCLCollisionChecker::_SetNumThreadsCommand, this, _1, _2), "sets the number of worker threads used by CheckCollisionBatch. 0 uses the number of hardware threads, 1 (default) checks in the calling thread");
+        RegisterCommand("SetStatisticsEnabled", boost::bind(&FCLCollisionChecker::_SetStatisticsEnabledCommand, this, _1, _2), "enables (1) or disables (0) recording the latency of the queries");
+        RegisterCommand("ResetStatistics", boost::bind(&FCLCollisionChecker::_ResetStatisticsCommand, this, _1, _2), "clears the recorded query latencies and the environment manager cache counters");
+        RegisterCommand("GetStatistics", boost::bind(&FCLCollisionChecker::_GetStatisticsCommand, this, _1, _2), "returns a JSON object with the count, total, mean, max, p50, p90, and p99 latency in seconds of each query type (BodyEnv, BodyBody, LinkEnv, LinkLink, LinkBody, BodySelf, LinkSelf, BodyBatchEnv, Ray, BodyBodyCached)");
+        RegisterCommand("SetResultCacheEnabled", boost::bind(&FCLCollisionChecker::_SetResultCacheEnabledCommand, this, _1, _2), "enables (1) or disables (0) reusing the result of a body-body query while the bodies, their attached bodies and the collision options are unchanged. Hits are counted as BodyBodyCached in GetStatistics");
+        RegisterCommand("SetEnvManagerCacheCapacity", boost::bind(&FCLCollisionChecker::_SetEnvManagerCacheCapacityCommand, this, _1, _2), "sets the maximum number of cached environment broadphase managers (one per set of excluded bodies, default 64) followed optionally by their maximum estimated bytes (0, the default, is unlimited). The least recently used managers are evicted first");
+        RegisterCommand("GetEnvManagerCacheStatistics", boost::bind(&FCLCollisionChecker::_GetEnvManagerCacheStatisticsCommand, this, _1, _2), "returns a JSON object with the hits, misses, evictions, the total time in seconds spent building managers on misses, and the current size and estimated bytes of the environment manager cache");
 
         RAVELOG_VERBOSE_FORMAT("FCLCollisionChecker %s created in env %d", _userdatakey%penv->GetId());
 
@@ -168,11 +209,18 @@ public:
         // We don't clone Kinbody's specific geometry group
         _fclspace->SetGeometryGroup(r->GetGeometryGroup());
         _fclspace->SetBVHRepresentation(r->GetBVHRepresentation());
+        _nAutoBroadphaseWarmupQueries = r->_nAutoBroadphaseWarmupQueries;
         _SetBroadphaseAlgorithm(r->GetBroadphaseAlgorithm());
 
         // We don't want to clone _bIsSelfCollisionChecker since a self collision checker can be created by cloning a environment collision checker
         _options = r->_options;
         _numMaxContacts = r->_numMaxContacts;
+        _nNumThreads = r->_nNumThreads;
+        _nEnvManagerCacheCapacity = r->_nEnvManagerCacheCapacity;
+        _nEnvManagerCacheMaxBytes = r->_nEnvManagerCacheMaxBytes;
+        _statistics.SetEnabled(r->_statistics.IsEnabled());
+        _bResultCache = r->_bResultCache;
+        _mapBodyPairCache.clear();
         RAVELOG_VERBOSE(str(boost::format("FCL User data cloning env %d into env %d") % r->GetEnv()->GetId() % GetEnv()->GetId()));
     }
 
@@ -186,6 +234,7 @@ public:
 
     void SetGeometryGroup(const std::string& groupname)
     {
+        _mapBodyPairCache.clear();
         _fclspace->SetGeometryGroup(groupname);
     }
 
@@ -231,29 +280,48 @@ public:
 
 
     /// Sets the broadphase algorithm for collision checking
-    /// The input algorithm can be one of : Naive, SaP, SSaP, IntervalTree, DynamicAABBTree{,1,2,3}, DynamicAABBTree_Array{,1,2,3}, SpatialHashing
-    /// e.g. "SetBroadPhaseAlgorithm DynamicAABBTree"
+    /// The input algorithm can be one of : Naive, SaP, SSaP, IntervalTree, DynamicAABBTree{,1,2,3}, DynamicAABBTree_Array{,1,2,3}, SpatialHashing, Auto
+    /// Auto can be followed by the number of environment queries each candidate is timed on during the warm-up
+    /// e.g. "SetBroadPhaseAlgorithm DynamicAABBTree", "SetBroadPhaseAlgorithm Auto 64"
     bool SetBroadphaseAlgorithmCommand(ostream& sout, istream& sinput)
     {
         std::string algorithm;
         sinput >> algorithm;
+        if( !sinput ) {
+            return false;
+        }
+        if( algorithm == "Auto" ) {
+            int numqueries = 0;
+            sinput >> numqueries;
+            if( !!sinput && numqueries > 0 ) {
+                _nAutoBroadphaseWarmupQueries = numqueries;
+            }
+        }
         _SetBroadphaseAlgorithm(algorithm);
-        return !!sinput;
+        return true;
     }
 
     void _SetBroadphaseAlgorithm(const std::string &algorithm)
     {
-        if(_broadPhaseCollisionManagerAlgorithm == algorithm) {
+        if( algorithm == "Auto" ) {
+            if( !_bAutoBroadphase ) {
+                _bAutoBroadphase = true;
+                _StartAutoBroadphaseWarmup();
+            }
             return;
         }
-        _broadPhaseCollisionManagerAlgorithm = algorithm;
-
-        // clear all the current cached managers
-        _bodymanagers.clear();
-        _envmanagers.clear();
+        _bAutoBroadphase = false;
+        _SwitchBroadphaseAlgorithm(algorithm);
     }
 
+    /// \brief returns the algorithm set by the user, "Auto" if it is selected automatically
     const std::string & GetBroadphaseAlgorithm() const {
+        static const std::string s_auto("Auto");
+        return _bAutoBroadphase ? s_auto : _broadPhaseCollisionManagerAlgorithm;
+    }
+
+    /// \brief returns the algorithm the managers are currently created with
+    const std::string & GetCurrentBroadphaseAlgorithm() const {
         return _broadPhaseCollisionManagerAlgorithm;
     }
 
@@ -318,6 +386,93 @@ public:
         return _fclspace->GetBVHRepresentation();
     }
 
+    /// Sets the number of threads CheckCollisionBatch splits the configurations on
+    /// e.g. "SetNumThreads 8"
+    bool _SetNumThreadsCommand(ostream& sout, istream& sinput)
+    {
+        int numthreads = 1;
+        sinput >> numthreads;
+        if( !sinput ) {
+            return false;
+        }
+        SetNumThreads(numthreads);
+        return true;
+    }
+
+    void SetNumThreads(int numthreads)
+    {
+        if( numthreads <= 0 ) {
+            numthreads = std::max(1, (int)std::thread::hardware_concurrency());
+        }
+        _nNumThreads = numthreads;
+    }
+
+    int GetNumThreads() const {
+        return _nNumThreads;
+    }
+
+    /// e.g. "SetStatisticsEnabled 1"
+    bool _SetStatisticsEnabledCommand(ostream& sout, istream& sinput)
+    {
+        int benabled = 0;
+        sinput >> benabled;
+        if( !sinput ) {
+            return false;
+        }
+        _statistics.SetEnabled(!!benabled);
+        return true;
+    }
+
+    bool _ResetStatisticsCommand(ostream& sout, istream& sinput)
+    {
+        _statistics.Reset();
+        _envmanagercachestats = EnvManagerCacheStatistics();
+        return true;
+    }
+
+    bool _GetStatisticsCommand(ostream& sout, istream& sinput)
+    {
+        _statistics.ExportJSON(sout);
+        return true;
+    }
+
+    /// e.g. "SetEnvManagerCacheCapacity 16 1000000"
+    bool _SetEnvManagerCacheCapacityCommand(ostream& sout, istream& sinput)
+    {
+        int capacity = 0;
+        sinput >> capacity;
+        if( !sinput || capacity < 1 ) {
+            return false;
+        }
+        uint64_t maxbytes = 0;
+        sinput >> maxbytes;
+        _nEnvManagerCacheCapacity = capacity;
+        _nEnvManagerCacheMaxBytes = !sinput ? 0 : maxbytes;
+        _EvictEnvManagers(_envmanagers.end());
+        return true;
+    }
+
+    bool _GetEnvManagerCacheStatisticsCommand(ostream& sout, istream& sinput)
+    {
+        sout << "{\"hits\": " << _envmanagercachestats.nHits << ", \"misses\": " << _envmanagercachestats.nMisses << ", \"evictions\": " << _envmanagercachestats.nEvictions;
+        sout << ", \"rebuildtime\": " << 1e-6*_envmanagercachestats.nRebuildMicroseconds << ", \"size\": " << _envmanagers.size() << ", \"bytes\": " << _nEnvManagerCacheBytes;
+        sout << ", \"capacity\": " << _nEnvManagerCacheCapacity << ", \"maxbytes\": " << _nEnvManagerCacheMaxBytes << "}";
+        return true;
+    }
+
+    /// e.g. "SetResultCacheEnabled 1"
+    bool _SetResultCacheEnabledCommand(ostream& sout, istream& sinput)
+    {
+        int benabled = 0;
+        sinput >> benabled;
+        if( !sinput ) {
+            return false;
+        }
+        _bResultCache = !!benabled;
+        _mapBodyPairCache.clear();
+        return true;
+    }
+
 
     virtual bool InitEnvironment()
     {
@@ -334,6 +489,7 @@ public:
     virtual void DestroyEnvironment()
     {
         RAVELOG_VERBOSE(str(boost::format("FCL User data destroying %s in env %d") % _userdatakey % GetEnv()->GetId()));
+        _mapBodyPairCache.clear();
         _fclspace->DestroyEnvironment();
     }
 
@@ -353,21 +509,22 @@ public:
         _bodymanagers.erase(std::make_pair(pbody, (int)0));
         _bodymanagers.erase(std::make_pair(pbody, (int)1));
         FOREACH(itmanager, _envmanagers) {
-            itmanager->second->RemoveBody(pbody);
+            itmanager->second.pmanager->RemoveBody(pbody);
         }
+        // the environment id of the body can be reused by a new body
+        _mapBodyPairCache.clear();
         _fclspace->RemoveUserData(pbody);
     }
 
     virtual bool CheckCollision(KinBodyConstPtr pbody1, CollisionReportPtr report = CollisionReportPtr())
     {
-        START_TIMING_OPT(_statistics, "Body/Env",_options,pbody1->IsRobot());
         // TODO : tailor this case when stuff become stable enough
         return CheckCollision(pbody1, std::vector<KinBodyConstPtr>(), std::vector<LinkConstPtr>(), report);
     }
 
     virtual bool CheckCollision(KinBodyConstPtr pbody1, KinBodyConstPtr pbody2, CollisionReportPtr report = CollisionReportPtr())
     {
-        START_TIMING_OPT(_statistics, "Body/Body",_options,(pbody1->IsRobot() || pbody2->IsRobot()));
+        FCLStatistics::Timer statisticstimer(_statistics, FCLStatistics::QT_BodyBody);
         if( !!report ) {
             report->Reset(_options);
         }
@@ -384,6 +541,22 @@ public:
             return false;
         }
 
+        // callbacks can change the result of the same query, so never cache with them
+        bool bUseCache = _bResultCache && !(_options & OpenRAVE::CO_Distance) && !GetEnv()->HasRegisteredCollisionCallbacks();
+        std::pair<int, int> cachekey(pbody1->GetEnvironmentId(), pbody2->GetEnvironmentId());
+        if( bUseCache ) {
+            _vcachestamps.resize(0);
+            _AppendCacheStamps(pbody1, _vcachestamps);
+            _vcachestamps.push_back(-1);
+            _AppendCacheStamps(pbody2, _vcachestamps);
+            std::map< std::pair<int, int>, BodyPairCacheEntry >::const_iterator itcache = _mapBodyPairCache.find(cachekey);
+            // a cached collision still needs the narrow phase when the report has to be filled
+            if( itcache != _mapBodyPairCache.end() && itcache->second.options == _options && itcache->second.vstamps == _vcachestamps && (!itcache->second.bCollision || !report) ) {
+                statisticstimer.SetType(FCLStatistics::QT_BodyBodyCached);
+                return itcache->second.bCollision;
+            }
+        }
+
         _fclspace->Synchronize(pbody1);
         _fclspace->Synchronize(pbody2);
 
@@ -396,23 +569,65 @@ public:
             return false; //TODO
         } else {
             CollisionCallbackData query(shared_checker(), report);
-            ADD_TIMING(_statistics);
             body1Manager->collide(body2Manager.get(), &query, &FCLCollisionChecker::CheckNarrowPhaseCollision);
+            if( bUseCache ) {
+                if( _mapBodyPairCache.size() >= 4096 ) {
+                    _mapBodyPairCache.clear();
+                }
+                BodyPairCacheEntry& entry = _mapBodyPairCache[cachekey];
+                entry.options = _options;
+                entry.vstamps.swap(_vcachestamps);
+                entry.bCollision = query._bCollision;
+            }
             return query._bCollision;
         }
 
     }
 
+    virtual bool ComputeDistance(KinBodyConstPtr pbody1, KinBodyConstPtr pbody2, DistanceReport& report)
+    {
+        report.Reset();
+        if( pbody1->IsAttached(pbody2) ) {
+            return true;
+        }
+        std::set<KinBodyConstPtr> attachedBodies1, attachedBodies2;
+        pbody1->GetAttached(attachedBodies1);
+        pbody2->GetAttached(attachedBodies2);
+        _vdistancelinks1.resize(0);
+        _vdistancelinks2.resize(0);
+        _CollectDistanceLinks(attachedBodies1, _vdistancelinks1);
+        _CollectDistanceLinks(attachedBodies2, _vdistancelinks2);
+        _ComputeDistance(_vdistancelinks1, _vdistancelinks2, _mapClosestFeatures[std::make_pair(pbody1->GetEnvironmentId(), pbody2->GetEnvironmentId())], report);
+        return true;
+    }
+
+    virtual bool ComputeDistance(KinBodyConstPtr pbody, DistanceReport& report)
+    {
+        report.Reset();
+        std::set<KinBodyConstPtr> attachedBodies, envBodies;
+        pbody->GetAttached(attachedBodies);
+        FOREACHC(itbody, _fclspace->GetEnvBodies()) {
+            if( attachedBodies.find(*itbody) == attachedBodies.end() ) {
+                envBodies.insert(*itbody);
+            }
+        }
+        _vdistancelinks1.resize(0);
+        _vdistancelinks2.resize(0);
+        _CollectDistanceLinks(attachedBodies, _vdistancelinks1);
+        _CollectDistanceLinks(envBodies, _vdistancelinks2);
+        _ComputeDistance(_vdistancelinks1, _vdistancelinks2, _mapClosestFeatures[std::make_pair(pbody->GetEnvironmentId(), 0)], report);
+        return true;
+    }
+
     virtual bool CheckCollision(LinkConstPtr plink,CollisionReportPtr report = CollisionReportPtr())
     {
-        START_TIMING_OPT(_statistics, "Link/Env",_options,false);
         // TODO : tailor this case when stuff become stable enough
         return CheckCollision(plink, std::vector<KinBodyConstPtr>(), std::vector<LinkConstPtr>(), report);
     }
 
     virtual bool CheckCollision(LinkConstPtr plink1, LinkConstPtr plink2, CollisionReportPtr report = CollisionReportPtr())
     {
-        START_TIMING_OPT(_statistics, "Link/Link",_options,false);
+        FCLStatistics::Timer statisticstimer(_statistics, FCLStatistics::QT_LinkLink);
         if( !!report ) {
             report->Reset(_options);
         }
@@ -440,7 +655,6 @@ public:
                 return false;
             }
             CollisionCallbackData query(shared_checker(), report);
-            ADD_TIMING(_statistics);
             query.bselfCollision = true;  // for ignoring attached information!
             CheckNarrowPhaseCollision(pcollLink1.get(), pcollLink2.get(), &query);
             return query._bCollision;
@@ -449,7 +663,7 @@ public:
 
     virtual bool CheckCollision(LinkConstPtr plink, KinBodyConstPtr pbody,CollisionReportPtr report = CollisionReportPtr())
     {
-        START_TIMING_OPT(_statistics, "Link/Body",_options,pbody->IsRobot());
+        FCLStatistics::Timer statisticstimer(_statistics, FCLStatistics::QT_LinkBody);
 
         if( !!report ) {
             report->Reset(_options);
@@ -490,7 +704,6 @@ public:
             return false; // TODO
         } else {
             CollisionCallbackData query(shared_checker(), report);
-            ADD_TIMING(_statistics);
             bodyManager->collide(pcollLink.get(), &query, &FCLCollisionChecker::CheckNarrowPhaseCollision);
             return query._bCollision;
         }
@@ -498,6 +711,7 @@ public:
 
     virtual bool CheckCollision(LinkConstPtr plink, std::vector<KinBodyConstPtr> const &vbodyexcluded, std::vector<LinkConstPtr> const &vlinkexcluded, CollisionReportPtr report = CollisionReportPtr())
     {
+        FCLStatistics::Timer statisticstimer(_statistics, FCLStatistics::QT_LinkEnv);
         if( !!report ) {
             report->Reset(_options);
         }
@@ -513,6 +727,7 @@ public:
           return false;
         }
 
+        AutoBroadphaseTiming autotiming(*this);
         std::set<KinBodyConstPtr> attachedBodies;
         plink->GetParent()->GetAttached(attachedBodies);
         BroadPhaseCollisionManagerPtr envManager = _GetEnvManager(attachedBodies);
@@ -522,7 +737,6 @@ public:
         }
         else {
             CollisionCallbackData query(shared_checker(), report, vbodyexcluded, vlinkexcluded);
-            ADD_TIMING(_statistics);
             envManager->collide(pcollLink.get(), &query, &FCLCollisionChecker::CheckNarrowPhaseCollision);
             return query._bCollision;
         }
@@ -530,6 +744,7 @@ public:
 
     virtual bool CheckCollision(KinBodyConstPtr pbody, std::vector<KinBodyConstPtr> const &vbodyexcluded, std::vector<LinkConstPtr> const &vlinkexcluded, CollisionReportPtr report = CollisionReportPtr())
     {
+        FCLStatistics::Timer statisticstimer(_statistics, FCLStatistics::QT_BodyEnv);
         if( !!report ) {
             report->Reset(_options);
         }
@@ -539,6 +754,7 @@ public:
         }
 
         _fclspace->Synchronize();
+        AutoBroadphaseTiming autotiming(*this);
         BroadPhaseCollisionManagerPtr bodyManager = _GetBodyManager(pbody, !!(_options & OpenRAVE::CO_ActiveDOFs));
 
         std::set<KinBodyConstPtr> attachedBodies;
@@ -550,7 +766,6 @@ public:
             return false; // TODO
         } else {
             CollisionCallbackData query(shared_checker(), report, vbodyexcluded, vlinkexcluded);
-            ADD_TIMING(_statistics);
             envManager->collide(bodyManager.get(), &query, &FCLCollisionChecker::CheckNarrowPhaseCollision);
             return query._bCollision;
         }
@@ -558,25 +773,28 @@ public:
 
     virtual bool CheckCollision(RAY const &ray, LinkConstPtr plink,CollisionReportPtr report = CollisionReportPtr())
     {
+        FCLStatistics::Timer statisticstimer(_statistics, FCLStatistics::QT_Ray);
         RAVELOG_WARN("fcl doesn't support Ray collisions\n");
         return false; //TODO
     }
 
     virtual bool CheckCollision(RAY const &ray, KinBodyConstPtr pbody, CollisionReportPtr report = CollisionReportPtr())
     {
+        FCLStatistics::Timer statisticstimer(_statistics, FCLStatistics::QT_Ray);
         RAVELOG_WARN("fcl doesn't support Ray collisions\n");
         return false; //TODO
     }
 
     virtual bool CheckCollision(RAY const &ray, CollisionReportPtr report = CollisionReportPtr())
     {
+        FCLStatistics::Timer statisticstimer(_statistics, FCLStatistics::QT_Ray);
         RAVELOG_WARN("fcl doesn't support Ray collisions\n");
         return false; //TODO
     }
 
     virtual bool CheckStandaloneSelfCollision(KinBodyConstPtr pbody, CollisionReportPtr report = CollisionReportPtr())
     {
-        START_TIMING_OPT(_statistics, "BodySelf",_options,pbody->IsRobot());
+        FCLStatistics::Timer statisticstimer(_statistics, FCLStatistics::QT_BodySelf);
         if( !!report ) {
             report->Reset(_options);
         }
@@ -591,7 +809,8 @@ public:
             adjacentOptions |= KinBody::AO_ActiveDOFs;
         }
 
-        const std::set<int> &nonadjacent = pbody->GetNonAdjacentLinks(adjacentOptions);
+        KinBodyInfoPtr pinfo = _fclspace->GetInfo(pbody);
+        const std::vector< std::pair<int16_t, int16_t> >& vselfpairs = _GetSelfCollisionPairs(pbody, pinfo, adjacentOptions);
         // We need to synchronize after calling GetNonAdjacentLinks since it can move pbody even if it is const
         _fclspace->Synchronize(pbody);
 
@@ -600,21 +819,13 @@ public:
             return false; // TODO
         } else {
             CollisionCallbackData query(shared_checker(), report);
-            ADD_TIMING(_statistics);
             query.bselfCollision = true;
 
-            KinBodyInfoPtr pinfo = _fclspace->GetInfo(pbody);
-            FOREACH(itset, nonadjacent) {
-                size_t index1 = *itset&0xffff, index2 = *itset>>16;
+            FOREACHC(itpair, vselfpairs) {
                 // We don't need to check if the links are enabled since we got adjacency information with AO_Enabled
-                LinkInfoPtr pLINK1 = pinfo->vlinks[index1], pLINK2 = pinfo->vlinks[index2];
-                FOREACH(itgeom1, pLINK1->vgeoms) {
-                    FOREACH(itgeom2, pLINK2->vgeoms) {
-                        CheckNarrowPhaseGeomCollision((*itgeom1).second.get(), (*itgeom2).second.get(), &query);
-                        if( query._bStopChecking ) {
-                            return query._bCollision;
-                        }
-                    }
+                const LinkInfoPtr& pLINK1 = pinfo->vlinks[itpair->first], &pLINK2 = pinfo->vlinks[itpair->second];
+                if( _CheckSelfCollisionLinkPair(*pLINK1, *pLINK2, query) ) {
+                    return query._bCollision;
                 }
             }
             return query._bCollision;
@@ -623,7 +834,7 @@ public:
 
     virtual bool CheckStandaloneSelfCollision(LinkConstPtr plink, CollisionReportPtr report = CollisionReportPtr())
     {
-        START_TIMING_OPT(_statistics, "LinkSelf",_options,false);
+        FCLStatistics::Timer statisticstimer(_statistics, FCLStatistics::QT_LinkSelf);
         if( !!report ) {
             report->Reset(_options);
         }
@@ -639,7 +850,8 @@ public:
             adjacentOptions |= KinBody::AO_ActiveDOFs;
         }
 
-        const std::set<int> &nonadjacent = pbody->GetNonAdjacentLinks(adjacentOptions);
+        KinBodyInfoPtr pinfo = _fclspace->GetInfo(pbody);
+        const std::vector< std::pair<int16_t, int16_t> >& vselfpairs = _GetSelfCollisionPairs(pbody, pinfo, adjacentOptions);
         // We need to synchronize after calling GetNonAdjacentLinks since it can move pbody evn if it is const
         _fclspace->Synchronize(pbody);
 
@@ -648,20 +860,12 @@ public:
             return false; //TODO
         } else {
             CollisionCallbackData query(shared_checker(), report);
-            ADD_TIMING(_statistics);
             query.bselfCollision = true;
-            KinBodyInfoPtr pinfo = _fclspace->GetInfo(pbody);
-            FOREACH(itset, nonadjacent) {
-                int index1 = *itset&0xffff, index2 = *itset>>16;
-                if( plink->GetIndex() == index1 || plink->GetIndex() == index2 ) {
-                    LinkInfoPtr pLINK1 = pinfo->vlinks[index1], pLINK2 = pinfo->vlinks[index2];
-                    FOREACH(itgeom1, pLINK1->vgeoms) {
-                        FOREACH(itgeom2, pLINK2->vgeoms) {
-                            CheckNarrowPhaseGeomCollision((*itgeom1).second.get(), (*itgeom2).second.get(), &query);
-                            if( query._bStopChecking ) {
-                                return query._bCollision;
-                            }
-                        }
+            FOREACHC(itpair, vselfpairs) {
+                if( plink->GetIndex() == itpair->first || plink->GetIndex() == itpair->second ) {
+                    const LinkInfoPtr& pLINK1 = pinfo->vlinks[itpair->first], &pLINK2 = pinfo->vlinks[itpair->second];
+                    if( _CheckSelfCollisionLinkPair(*pLINK1, *pLINK2, query) ) {
+                        return query._bCollision;
                     }
                 }
             }
@@ -669,8 +873,374 @@ public:
         }
     }
 
+    /// \brief checks a batch of configurations of pbody against the environment
+    ///
+    /// Since only pbody and its attached bodies move during the batch, the environment is synchronized and its manager is retrieved only once.
+    /// For every configuration only the attached bodies and the body manager are resynchronized.
+    virtual size_t CheckCollisionBatch(KinBodyPtr pbody, const std::vector<int>& dofindices, const OpenRAVE::dReal* pconfigs, size_t numconfigs, std::vector<uint8_t>& vresults, bool bcheckself=false)
+    {
+        FCLStatistics::Timer statisticstimer(_statistics, FCLStatistics::QT_BodyBatchEnv);
+        vresults.resize(numconfigs);
+        std::fill(vresults.begin(), vresults.end(), 0);
+        if( numconfigs == 0 || pbody->GetLinks().size() == 0 || !pbody->IsEnabled() ) {
+            return 0;
+        }
+
+        KinBody::KinBodyStateSaver saver(pbody, KinBody::Save_LinkTransformation);
+        KinBodyConstPtr pconstbody(pbody);
+        _fclspace->Synchronize();
+        FCLCollisionManagerInstancePtr pbodyinstance = _GetBodyManagerInstance(pconstbody, !!(_options & OpenRAVE::CO_ActiveDOFs));
+
+        std::set<KinBodyConstPtr> attachedBodies;
+        pbody->GetAttached(attachedBodies);
+        BroadPhaseCollisionManagerPtr envManager = _GetEnvManager(attachedBodies);
+
+        // collision callbacks are user code that cannot be called concurrently
+        if( _nNumThreads > 1 && numconfigs > 1 && !GetEnv()->HasRegisteredCollisionCallbacks() ) {
+            return _CheckCollisionBatchParallel(pbody, attachedBodies, envManager, dofindices, pconfigs, numconfigs, vresults, bcheckself);
+        }
+
+        size_t dof = dofindices.size() > 0 ? dofindices.size() : (size_t)pbody->GetDOF();
+        std::vector<OpenRAVE::dReal> vvalues(dof);
+        size_t numcolliding = 0;
+        for(size_t iconfig = 0; iconfig < numconfigs; ++iconfig) {
+            std::copy(pconfigs+iconfig*dof, pconfigs+(iconfig+1)*dof, vvalues.begin());
+            pbody->SetDOFValues(vvalues, KinBody::CLA_Nothing, dofindices);
+            FOREACH(itbody, attachedBodies) {
+                if( (*itbody)->GetEnvironmentId() ) { // for now GetAttached can hold bodies that are not initialized
+                    _fclspace->Synchronize(*itbody);
+                }
+            }
+            pbodyinstance->Synchronize();
+
+            CollisionCallbackData query(shared_checker(), CollisionReportPtr());
+            envManager->collide(pbodyinstance->GetManager().get(), &query, &FCLCollisionChecker::CheckNarrowPhaseCollision);
+            if( query._bCollision || (bcheckself && CheckStandaloneSelfCollision(pconstbody)) ) {
+                vresults[iconfig] = 1;
+                ++numcolliding;
+            }
+        }
+        return numcolliding;
+    }
 
 private:
+    /// \brief a link taking part in a distance query
+    struct DistanceLink
+    {
+        FCLSpace::KinBodyInfo::LINK* plinkinfo;
+        int bodyid; ///< environment id of the body of the link
+        int linkindex;
+    };
+
+    /// \brief the closest geometry pair found by the previous distance query between the same bodies, used to warm start the next query
+    struct ClosestFeatures
+    {
+        ClosestFeatures() : bodyid1(0), linkindex1(-1), geomindex1(-1), bodyid2(0), linkindex2(-1), geomindex2(-1) {
+        }
+        int bodyid1, linkindex1, geomindex1;
+        int bodyid2, linkindex2, geomindex2;
+    };
+
+    /// \brief appends the enabled links that have geometry of the bodies to vlinks, the bodies are synchronized
+    void _CollectDistanceLinks(const std::set<KinBodyConstPtr>& setbodies, std::vector<DistanceLink>& vlinks)
+    {
+        FOREACHC(itbody, setbodies) {
+            if( (*itbody)->GetEnvironmentId() == 0 || !(*itbody)->IsEnabled() ) {
+                continue;
+            }
+            KinBodyInfoPtr pinfo = _fclspace->GetInfo(*itbody);
+            if( !pinfo ) {
+                continue;
+            }
+            _fclspace->Synchronize(*itbody);
+            const std::vector<KinBody::LinkPtr>& vbodylinks = (*itbody)->GetLinks();
+            for(size_t ilink = 0; ilink < vbodylinks.size(); ++ilink) {
+                if( vbodylinks[ilink]->IsEnabled() && pinfo->vlinks.at(ilink)->vgeoms.size() > 0 ) {
+                    DistanceLink link;
+                    link.plinkinfo = pinfo->vlinks[ilink].get();
+                    link.bodyid = (*itbody)->GetEnvironmentId();
+                    link.linkindex = ilink;
+                    vlinks.push_back(link);
+                }
+            }
+        }
+    }
+
+    static const DistanceLink* _FindDistanceLink(const std::vector<DistanceLink>& vlinks, int bodyid, int linkindex)
+    {
+        FOREACHC(itlink, vlinks) {
+            if( itlink->bodyid == bodyid && itlink->linkindex == linkindex ) {
+                return &(*itlink);
+            }
+        }
+        return NULL;
+    }
+
+    static fcl::FCL_REAL _ComputeGeometryDistance(fcl::CollisionObject* o1, fcl::CollisionObject* o2, const fcl::DistanceRequest& request, fcl::DistanceResult& result)
+    {
+        result.clear();
+        fcl::FCL_REAL distance = fcl::distance(o1, o2, request, result);
+        // depending on the geometry types, penetrating geometries return 0 or a negative value
+        return distance > 0 ? distance : 0;
+    }
+
+    /// \brief computes the minimum distance between two sets of links
+    ///
+    /// The closest geometry pair of the previous query is evaluated first. When the bodies moved only slightly, its distance is close to the minimum
+    /// so the bounding boxes of most of the other link and geometry pairs are farther away and their narrow phase is skipped.
+    void _ComputeDistance(const std::vector<DistanceLink>& vlinks1, const std::vector<DistanceLink>& vlinks2, ClosestFeatures& closest, DistanceReport& report)
+    {
+        fcl::DistanceRequest request;
+        fcl::DistanceResult result;
+        const DistanceLink* pbestlink1 = NULL, *pbestlink2 = NULL;
+        int bestgeom1 = -1, bestgeom2 = -1;
+        fcl::FCL_REAL bestdistance = std::numeric_limits<fcl::FCL_REAL>::infinity();
+
+        const DistanceLink* pcachedlink1 = _FindDistanceLink(vlinks1, closest.bodyid1, closest.linkindex1);
+        const DistanceLink* pcachedlink2 = _FindDistanceLink(vlinks2, closest.bodyid2, closest.linkindex2);
+        if( !!pcachedlink1 && !!pcachedlink2 && closest.geomindex1 < (int)pcachedlink1->plinkinfo->vgeoms.size() && closest.geomindex2 < (int)pcachedlink2->plinkinfo->vgeoms.size() ) {
+            bestdistance = _ComputeGeometryDistance(pcachedlink1->plinkinfo->vgeoms[closest.geomindex1].second.get(), pcachedlink2->plinkinfo->vgeoms[closest.geomindex2].second.get(), request, result);
+            pbestlink1 = pcachedlink1;
+            pbestlink2 = pcachedlink2;
+            bestgeom1 = closest.geomindex1;
+            bestgeom2 = closest.geomindex2;
+        }
+        else {
+            pcachedlink1 = pcachedlink2 = NULL;
+        }
+
+        for(size_t ilink1 = 0; ilink1 < vlinks1.size() && bestdistance > 0; ++ilink1) {
+            const FCLSpace::KinBodyInfo::LINK& link1 = *vlinks1[ilink1].plinkinfo;
+            for(size_t ilink2 = 0; ilink2 < vlinks2.size() && bestdistance > 0; ++ilink2) {
+                const FCLSpace::KinBodyInfo::LINK& link2 = *vlinks2[ilink2].plinkinfo;
+                if( link1.linkBV.second->getAABB().distance(link2.linkBV.second->getAABB()) >= bestdistance ) {
+                    continue;
+                }
+                bool bcachedpair = &vlinks1[ilink1] == pcachedlink1 && &vlinks2[ilink2] == pcachedlink2;
+                for(size_t igeom1 = 0; igeom1 < link1.vgeoms.size() && bestdistance > 0; ++igeom1) {
+                    fcl::CollisionObject* pgeom1 = link1.vgeoms[igeom1].second.get();
+                    for(size_t igeom2 = 0; igeom2 < link2.vgeoms.size() && bestdistance > 0; ++igeom2) {
+                        if( bcachedpair && (int)igeom1 == closest.geomindex1 && (int)igeom2 == closest.geomindex2 ) {
+                            continue;
+                        }
+                        fcl::CollisionObject* pgeom2 = link2.vgeoms[igeom2].second.get();
+                        if( pgeom1->getAABB().distance(pgeom2->getAABB()) >= bestdistance ) {
+                            continue;
+                        }
+                        fcl::FCL_REAL distance = _ComputeGeometryDistance(pgeom1, pgeom2, request, result);
+                        if( distance < bestdistance ) {
+                            bestdistance = distance;
+                            pbestlink1 = &vlinks1[ilink1];
+                            pbestlink2 = &vlinks2[ilink2];
+                            bestgeom1 = igeom1;
+                            bestgeom2 = igeom2;
+                        }
+                    }
+                }
+            }
+        }
+
+        if( !!pbestlink1 ) {
+            closest.bodyid1 = pbestlink1->bodyid;
+            closest.linkindex1 = pbestlink1->linkindex;
+            closest.geomindex1 = bestgeom1;
+            closest.bodyid2 = pbestlink2->bodyid;
+            closest.linkindex2 = pbestlink2->linkindex;
+            closest.geomindex2 = bestgeom2;
+            report.distance = bestdistance;
+            report.plink1 = pbestlink1->plinkinfo->GetLink();
+            report.plink2 = pbestlink2->plinkinfo->GetLink();
+        }
+    }
+
+    /// \brief returns the non-adjacent link pairs of pbody where both links have collision geometry
+    ///
+    /// This is the self-collision broadphase of the body. It is built from KinBody::GetNonAdjacentLinkPairs and kept in the body info
+    /// until the non-adjacent links, the adjacent options or the geometries change.
+    /// Has to be called before synchronizing pbody since computing the non-adjacent links can move it.
+    const std::vector< std::pair<int16_t, int16_t> >& _GetSelfCollisionPairs(KinBodyConstPtr pbody, KinBodyInfoPtr pinfo, int adjacentoptions)
+    {
+        const std::vector< std::pair<int16_t, int16_t> >& vnonadjacent = pbody->GetNonAdjacentLinkPairs(adjacentoptions);
+        if( pinfo->nSelfPairsNonAdjacentStamp != pbody->GetNonAdjacentLinksUpdateStamp() || pinfo->nSelfPairsAdjacentOptions != adjacentoptions ) {
+            pinfo->vselfpairs.resize(0);
+            FOREACHC(itpair, vnonadjacent) {
+                if( pinfo->vlinks.at(itpair->first)->vgeoms.size() > 0 && pinfo->vlinks.at(itpair->second)->vgeoms.size() > 0 ) {
+                    pinfo->vselfpairs.push_back(*itpair);
+                }
+            }
+            pinfo->nSelfPairsNonAdjacentStamp = pbody->GetNonAdjacentLinksUpdateStamp();
+            pinfo->nSelfPairsAdjacentOptions = adjacentoptions;
+        }
+        return pinfo->vselfpairs;
+    }
+
+    /// \brief checks the geometries of two links of the same body, skipping the narrow phase when the link or geometry bounding boxes do not overlap
+    ///
+    /// \return true if the checking should stop
+    bool _CheckSelfCollisionLinkPair(const FCLSpace::KinBodyInfo::LINK& link1, const FCLSpace::KinBodyInfo::LINK& link2, CollisionCallbackData& query)
+    {
+        if( !link1.linkBV.second->getAABB().overlap(link2.linkBV.second->getAABB()) ) {
+            return false;
+        }
+        FOREACHC(itgeom1, link1.vgeoms) {
+            FOREACHC(itgeom2, link2.vgeoms) {
+                if( itgeom1->second->getAABB().overlap(itgeom2->second->getAABB()) ) {
+                    CheckNarrowPhaseGeomCollision(itgeom1->second.get(), itgeom2->second.get(), &query);
+                    if( query._bStopChecking ) {
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    /// \brief parallel version of CheckCollisionBatch, each worker thread owns a FCLThreadView of the attached bodies
+    ///
+    /// The forward kinematics is computed in the calling thread for all the configurations, then the workers place
+    /// their views at the computed link transforms and only read the environment manager, which does not change during the batch.
+    size_t _CheckCollisionBatchParallel(KinBodyPtr pbody, const std::set<KinBodyConstPtr>& attachedBodies, BroadPhaseCollisionManagerPtr envManager, const std::vector<int>& dofindices, const OpenRAVE::dReal* pconfigs, size_t numconfigs, std::vector<uint8_t>& vresults, bool bcheckself)
+    {
+        KinBodyConstPtr pconstbody(pbody);
+        std::vector<KinBodyConstPtr> vviewbodies;
+        std::vector<uint64_t> vmanagedlinkmasks;
+        std::vector<int> vTrackingActiveLinks;
+        if( (_options & OpenRAVE::CO_ActiveDOFs) && pbody->IsRobot() ) {
+            RobotBasePtr probot = OpenRAVE::RaveInterfaceCast<RobotBase>(pbody);
+            vTrackingActiveLinks.resize(probot->GetLinks().size(), 0);
+            for(size_t ilink = 0; ilink < probot->GetLinks().size(); ++ilink) {
+                FOREACHC(itindex, probot->GetActiveDOFIndices()) {
+                    if( probot->DoesAffect(probot->GetJointFromDOFIndex(*itindex)->GetJointIndex(), ilink) ) {
+                        vTrackingActiveLinks[ilink] = 1;
+                        break;
+                    }
+                }
+            }
+        }
+        size_t numviewlinks = 0;
+        FOREACHC(itbody, attachedBodies) {
+            if( (*itbody)->GetEnvironmentId() == 0 || !_fclspace->GetInfo(*itbody) ) {
+                continue;
+            }
+            uint64_t linkmask = (*itbody)->GetLinkEnableStatesMask();
+            if( *itbody == pconstbody && vTrackingActiveLinks.size() > 0 ) {
+                for(size_t ilink = 0; ilink < vTrackingActiveLinks.size(); ++ilink) {
+                    if( !vTrackingActiveLinks[ilink] ) {
+                        linkmask &= ~((uint64_t)1 << (uint64_t)ilink);
+                    }
+                }
+            }
+            vviewbodies.push_back(*itbody);
+            vmanagedlinkmasks.push_back(linkmask);
+            numviewlinks += (*itbody)->GetLinks().size();
+        }
+
+        // self collision pairs in view link indices of pbody, has to be computed before moving the body
+        std::vector< std::pair<size_t, size_t> > vselfpairs;
+        if( bcheckself && pbody->GetLinks().size() > 1 ) {
+            int adjacentOptions = KinBody::AO_Enabled;
+            if( vTrackingActiveLinks.size() > 0 ) {
+                adjacentOptions |= KinBody::AO_ActiveDOFs;
+            }
+            const std::vector< std::pair<int16_t, int16_t> >& vnonadjacent = pbody->GetNonAdjacentLinkPairs(adjacentOptions);
+            vselfpairs.reserve(vnonadjacent.size());
+            FOREACHC(itpair, vnonadjacent) {
+                vselfpairs.push_back(std::make_pair((size_t)itpair->first, (size_t)itpair->second));
+            }
+        }
+        size_t selfoffset = 0;
+        for(size_t ibody = 0; ibody < vviewbodies.size(); ++ibody) {
+            if( vviewbodies[ibody] == pconstbody ) {
+                break;
+            }
+            selfoffset += vviewbodies[ibody]->GetLinks().size();
+        }
+
+        // forward kinematics of all the configurations
+        size_t dof = dofindices.size() > 0 ? dofindices.size() : (size_t)pbody->GetDOF();
+        std::vector<OpenRAVE::dReal> vvalues(dof);
+        std::vector<Transform> vlinktransforms(numconfigs*numviewlinks), vbodytransforms;
+        for(size_t iconfig = 0; iconfig < numconfigs; ++iconfig) {
+            std::copy(pconfigs+iconfig*dof, pconfigs+(iconfig+1)*dof, vvalues.begin());
+            pbody->SetDOFValues(vvalues, KinBody::CLA_Nothing, dofindices);
+            std::vector<Transform>::iterator itlinktransform = vlinktransforms.begin() + iconfig*numviewlinks;
+            FOREACHC(itbody, vviewbodies) {
+                (*itbody)->GetLinkTransformations(vbodytransforms);
+                itlinktransform = std::copy(vbodytransforms.begin(), vbodytransforms.end(), itlinktransform);
+            }
+        }
+
+        size_t numthreads = std::min((size_t)_nNumThreads, numconfigs);
+        std::vector<FCLThreadViewPtr> vviews(numthreads);
+        for(size_t ithread = 0; ithread < numthreads; ++ithread) {
+            vviews[ithread].reset(new FCLThreadView(*_fclspace, _CreateManager()));
+            for(size_t ibody = 0; ibody < vviewbodies.size(); ++ibody) {
+                vviews[ithread]->AddBody(vviewbodies[ibody], vmanagedlinkmasks[ibody]);
+            }
+            vviews[ithread]->Setup();
+        }
+
+        std::atomic<size_t> nextconfig(0), numcolliding(0);
+        std::vector<std::exception_ptr> vexceptions(numthreads);
+        boost::shared_ptr<FCLCollisionChecker> pchecker = shared_checker();
+        std::vector<std::thread> vthreads;
+        vthreads.reserve(numthreads);
+        for(size_t ithread = 0; ithread < numthreads; ++ithread) {
+            vthreads.push_back(std::thread([&, ithread]() {
+                try {
+                    FCLThreadView& view = *vviews[ithread];
+                    for(size_t iconfig = nextconfig++; iconfig < numconfigs; iconfig = nextconfig++) {
+                        view.SetLinkTransforms(&vlinktransforms[iconfig*numviewlinks]);
+                        CollisionCallbackData query(pchecker, CollisionReportPtr());
+                        query._bThreadView = true;
+                        envManager->collide(view.GetManager().get(), &query, &FCLCollisionChecker::CheckNarrowPhaseCollision);
+                        if( !query._bCollision && vselfpairs.size() > 0 ) {
+                            query.bselfCollision = true;
+                            FOREACHC(itpair, vselfpairs) {
+                                const FCLSpace::LinkInfoPtr& pLINK1 = view.GetLinkInfo(selfoffset+itpair->first);
+                                const FCLSpace::LinkInfoPtr& pLINK2 = view.GetLinkInfo(selfoffset+itpair->second);
+                                if( !pLINK1 || !pLINK2 ) {
+                                    continue;
+                                }
+                                FOREACH(itgeom1, pLINK1->vgeoms) {
+                                    FOREACH(itgeom2, pLINK2->vgeoms) {
+                                        CheckNarrowPhaseGeomCollision((*itgeom1).second.get(), (*itgeom2).second.get(), &query);
+                                        if( query._bStopChecking ) {
+                                            break;
+                                        }
+                                    }
+                                    if( query._bStopChecking ) {
+                                        break;
+                                    }
+                                }
+                                if( query._bStopChecking ) {
+                                    break;
+                                }
+                            }
+                        }
+                        if( query._bCollision ) {
+                            vresults[iconfig] = 1;
+                            ++numcolliding;
+                        }
+                    }
+                }
+                catch(...) {
+                    vexceptions[ithread] = std::current_exception();
+                    nextconfig = numconfigs; // stop the other threads
+                }
+            }));
+        }
+        FOREACH(itthread, vthreads) {
+            itthread->join();
+        }
+        FOREACH(itexception, vexceptions) {
+            if( !!*itexception ) {
+                std::rethrow_exception(*itexception);
+            }
+        }
+        return numcolliding;
+    }
+
     inline boost::shared_ptr<FCLCollisionChecker> shared_checker() {
         return boost::dynamic_pointer_cast<FCLCollisionChecker>(shared_from_this());
     }
@@ -708,7 +1278,8 @@ private:
             return false;
         }
 
-        LinkInfoPtr pLINK1 = _fclspace->GetLinkInfo(plink1), pLINK2 = _fclspace->GetLinkInfo(plink2);
+        // the user data holds the link info that owns the collision object, which can also come from a FCLThreadView
+        FCLSpace::KinBodyInfo::LINK *pLINK1 = static_cast<FCLSpace::KinBodyInfo::LINK *>(o1->getUserData()), *pLINK2 = static_cast<FCLSpace::KinBodyInfo::LINK *>(o2->getUserData());
 
         //RAVELOG_INFO_FORMAT("link %s:%s with %s:%s", plink1->GetParent()->GetName()%plink1->GetName()%plink2->GetParent()->GetName()%plink2->GetName());
         FOREACH(itgeompair1, pLINK1->vgeoms) {
@@ -744,7 +1315,7 @@ private:
 
 #ifdef NARROW_COLLISION_CACHING
         CollisionPair collpair = MakeCollisionPair(o1, o2);
-        NarrowCollisionCache::iterator it = mCollisionCachedGuesses.find(collpair);
+        NarrowCollisionCache::iterator it = pcb->_bThreadView ? mCollisionCachedGuesses.end() : mCollisionCachedGuesses.find(collpair);
         if( it != mCollisionCachedGuesses.end() ) {
             pcb->_request.cached_gjk_guess = it->second;
         } else {
@@ -756,7 +1327,9 @@ private:
         size_t numContacts = fcl::collide(o1, o2, pcb->_request, pcb->_result);
 
 #ifdef NARROW_COLLISION_CACHING
-        mCollisionCachedGuesses[collpair] = pcb->_result.cached_gjk_guess;
+        if( !pcb->_bThreadView ) {
+            mCollisionCachedGuesses[collpair] = pcb->_result.cached_gjk_guess;
+        }
 #endif
 
         if( numContacts > 0 ) {
@@ -803,6 +1376,10 @@ private:
                     pcb->_report->contacts.reserve(pcb->_report->contacts.size() + numContacts);
                     copy(_reportcache.contacts.begin(),_reportcache.contacts.end(), back_inserter(pcb->_report->contacts));
                 }
+                bool bMaxContacts = pcb->_report->nMaxContacts > 0 && pcb->_report->contacts.size() >= pcb->_report->nMaxContacts;
+                if( bMaxContacts ) {
+                    pcb->_report->contacts.resize(pcb->_report->nMaxContacts);
+                }
 
                 if( _options & OpenRAVE::CO_AllLinkCollisions ) {
                     // We maintain vLinkColliding ordered
@@ -815,7 +1392,7 @@ private:
                 }
 
                 pcb->_bCollision = true;
-                if( !(_options & (OpenRAVE::CO_AllLinkCollisions | OpenRAVE::CO_AllGeometryContacts)) ) {
+                if( !(_options & OpenRAVE::CO_AllLinkCollisions) && (bMaxContacts || !(_options & OpenRAVE::CO_AllGeometryContacts)) ) {
                     pcb->_bStopChecking = true; // stop checking collision
                 }
                 return pcb->_bStopChecking;
@@ -872,7 +1449,103 @@ private:
         return _CreateManagerFromBroadphaseAlgorithm(_broadPhaseCollisionManagerAlgorithm);
     }
 
-    BroadPhaseCollisionManagerPtr _GetBodyManager(KinBodyConstPtr pbody, bool bactiveDOFs)
+    /// \brief changes the algorithm the managers are created with and clears the cached managers
+    void _SwitchBroadphaseAlgorithm(const std::string &algorithm)
+    {
+        if(_broadPhaseCollisionManagerAlgorithm == algorithm) {
+            return;
+        }
+        _broadPhaseCollisionManagerAlgorithm = algorithm;
+
+        // clear all the current cached managers
+        _bodymanagers.clear();
+        _envmanagers.clear();
+        _listEnvManagerLRU.clear();
+        _nEnvManagerCacheBytes = 0;
+    }
+
+    /// \brief times a body/environment or link/environment query for the automatic broadphase selection
+    class AutoBroadphaseTiming
+    {
+public:
+        AutoBroadphaseTiming(FCLCollisionChecker& checker) : _checker(checker), _starttime(0), _bActive(false) {
+            // queries from collision callbacks are part of the outer query and must not switch the managers it uses
+            if( _checker._bAutoBroadphase && !_checker._bAutoBroadphaseTiming ) {
+                _checker._bAutoBroadphaseTiming = true;
+                _bActive = true;
+                _starttime = OpenRAVE::utils::GetMicroTime();
+            }
+        }
+        ~AutoBroadphaseTiming() {
+            if( _bActive ) {
+                _checker._bAutoBroadphaseTiming = false;
+                if( _checker._bAutoBroadphase ) {
+                    _checker._UpdateAutoBroadphase(OpenRAVE::utils::GetMicroTime() - _starttime);
+                }
+            }
+        }
+private:
+        FCLCollisionChecker& _checker;
+        uint64_t _starttime;
+        bool _bActive;
+    };
+
+    /// \brief restarts timing all the candidate algorithms on the current environment
+    void _StartAutoBroadphaseWarmup()
+    {
+        static const char* s_candidates[] = {"Naive", "SaP", "SSaP", "IntervalTree", "DynamicAABBTree2", "DynamicAABBTree2_Array"};
+        _vAutoBroadphaseCandidates.assign(s_candidates, s_candidates + sizeof(s_candidates)/sizeof(s_candidates[0]));
+        _vAutoBroadphaseTimes.assign(_vAutoBroadphaseCandidates.size(), 0);
+        _nAutoBroadphaseCandidate = 0;
+        _nAutoBroadphaseQueries = -1;
+        _nAutoBroadphaseNumBodies = _fclspace->GetEnvBodies().size();
+        _SwitchBroadphaseAlgorithm(_vAutoBroadphaseCandidates[0]);
+    }
+
+    /// \brief accumulates the time of a query with the current candidate, switches to the next candidate once it was timed on enough queries, and selects the fastest at the end of the warm-up.
+    ///
+    /// Once selected, the warm-up restarts when the number of bodies in the environment changed by more than a quarter.
+    void _UpdateAutoBroadphase(uint64_t querytime)
+    {
+        if( _nAutoBroadphaseCandidate >= _vAutoBroadphaseCandidates.size() ) {
+            size_t numbodies = _fclspace->GetEnvBodies().size();
+            size_t numchanged = numbodies > _nAutoBroadphaseNumBodies ? numbodies - _nAutoBroadphaseNumBodies : _nAutoBroadphaseNumBodies - numbodies;
+            if( numchanged > std::max(size_t(4), _nAutoBroadphaseNumBodies/4) ) {
+                RAVELOG_DEBUG_FORMAT("env %d, number of bodies changed from %d to %d, re-evaluating the broadphase algorithms", GetEnv()->GetId()%_nAutoBroadphaseNumBodies%numbodies);
+                _StartAutoBroadphaseWarmup();
+            }
+            return;
+        }
+
+        // the first query after switching builds the managers, so do not count it
+        if( _nAutoBroadphaseQueries >= 0 ) {
+            _vAutoBroadphaseTimes[_nAutoBroadphaseCandidate] += querytime;
+        }
+        if( ++_nAutoBroadphaseQueries < _nAutoBroadphaseWarmupQueries ) {
+            return;
+        }
+
+        ++_nAutoBroadphaseCandidate;
+        if( _nAutoBroadphaseCandidate < _vAutoBroadphaseCandidates.size() ) {
+            _nAutoBroadphaseQueries = -1;
+            _SwitchBroadphaseAlgorithm(_vAutoBroadphaseCandidates[_nAutoBroadphaseCandidate]);
+            return;
+        }
+
+        size_t ibest = std::min_element(_vAutoBroadphaseTimes.begin(), _vAutoBroadphaseTimes.end()) - _vAutoBroadphaseTimes.begin();
+        if( IS_DEBUGLEVEL(OpenRAVE::Level_Debug) ) {
+            std::stringstream ss;
+            for(size_t i = 0; i < _vAutoBroadphaseCandidates.size(); ++i) {
+                ss << " " << _vAutoBroadphaseCandidates[i] << "=" << (1e-6*_vAutoBroadphaseTimes[i]/_nAutoBroadphaseWarmupQueries) << "s";
+            }
+            RAVELOG_DEBUG_FORMAT("env %d, selected broadphase %s with %d bodies, mean query times:%s", GetEnv()->GetId()%_vAutoBroadphaseCandidates[ibest]%_nAutoBroadphaseNumBodies%ss.str());
+        }
+        _nAutoBroadphaseNumBodies = _fclspace->GetEnvBodies().size();
+        _SwitchBroadphaseAlgorithm(_vAutoBroadphaseCandidates[ibest]);
+    }
+
+    /// \brief returns the manager instance of the body without synchronizing it
+    FCLCollisionManagerInstancePtr _GetBodyManagerInstance(KinBodyConstPtr pbody, bool bactiveDOFs)
     {
         BODYMANAGERSMAP::iterator it = _bodymanagers.find(std::make_pair(pbody, (int)bactiveDOFs));
         if( it == _bodymanagers.end() ) {
@@ -880,10 +1553,15 @@ private:
             p->InitBodyManager(pbody, bactiveDOFs);
             it = _bodymanagers.insert(BODYMANAGERSMAP::value_type(std::make_pair(pbody, (int)bactiveDOFs), p)).first;
         }
+        return it->second;
+    }
 
-        it->second->Synchronize();
-        //it->second->PrintStatus(OpenRAVE::Level_Info);
-        return it->second->GetManager();
+    BroadPhaseCollisionManagerPtr _GetBodyManager(KinBodyConstPtr pbody, bool bactiveDOFs)
+    {
+        FCLCollisionManagerInstancePtr pinstance = _GetBodyManagerInstance(pbody, bactiveDOFs);
+        pinstance->Synchronize();
+        //pinstance->PrintStatus(OpenRAVE::Level_Info);
+        return pinstance->GetManager();
     }
 
     BroadPhaseCollisionManagerPtr _GetEnvManager(const std::set<KinBodyConstPtr>& excludedbodies)
@@ -893,31 +1571,90 @@ private:
             setExcludeBodyIds.insert((*itbody)->GetEnvironmentId());
         }
 
-        // check the cache and cleanup any unused environments
-        if( --_nGetEnvManagerCacheClearCount < 0 ) {
-            uint32_t curtime = OpenRAVE::utils::GetMilliTime();
-            _nGetEnvManagerCacheClearCount = 100000;
-            std::map<std::set<int>, FCLCollisionManagerInstancePtr>::iterator it = _envmanagers.begin();
-            while(it != _envmanagers.end()) {
-                if( (it->second->GetLastSyncTimeStamp() - curtime) > 10000 ) {
-                    _envmanagers.erase(it++);
-                }
-                else {
-                    ++it;
-                }
-            }
-        }
-
-        std::map<std::set<int>, FCLCollisionManagerInstancePtr>::iterator it = _envmanagers.find(setExcludeBodyIds);
+        ENVMANAGERSMAP::iterator it = _envmanagers.find(setExcludeBodyIds);
+        uint64_t starttime = 0;
         if( it == _envmanagers.end() ) {
+            ++_envmanagercachestats.nMisses;
+            starttime = OpenRAVE::utils::GetMicroTime();
             FCLCollisionManagerInstancePtr p(new FCLCollisionManagerInstance(*_fclspace, _CreateManager()));
             p->InitEnvironment(excludedbodies);
-            it = _envmanagers.insert(std::map<std::set<int>, FCLCollisionManagerInstancePtr>::value_type(setExcludeBodyIds, p)).first;
+            it = _envmanagers.insert(ENVMANAGERSMAP::value_type(setExcludeBodyIds, EnvManagerCacheEntry())).first;
+            it->second.pmanager = p;
+            it->second.itlru = _listEnvManagerLRU.insert(_listEnvManagerLRU.begin(), it);
+        }
+        else {
+            ++_envmanagercachestats.nHits;
+            _listEnvManagerLRU.splice(_listEnvManagerLRU.begin(), _listEnvManagerLRU, it->second.itlru);
+        }
+        FCLCollisionManagerInstancePtr pmanager = it->second.pmanager;
+        pmanager->EnsureBodies(_fclspace->GetEnvBodies());
+        pmanager->Synchronize();
+        if( starttime > 0 ) {
+            _envmanagercachestats.nRebuildMicroseconds += OpenRAVE::utils::GetMicroTime() - starttime;
+        }
+        // the manager grows when bodies are added to the environment, so its size is updated on every use
+        size_t nbytes = pmanager->GetMemoryUsage();
+        _nEnvManagerCacheBytes += nbytes;
+        _nEnvManagerCacheBytes -= it->second.nbytes;
+        it->second.nbytes = nbytes;
+        _EvictEnvManagers(it);
+        //pmanager->PrintStatus(OpenRAVE::Level_Info);
+        return pmanager->GetManager();
+    }
+
+    /// \brief evicts the least recently used environment managers until the cache fits in its capacity, never evicts itkeep
+    void _EvictEnvManagers(ENVMANAGERSMAP::iterator itkeep)
+    {
+        while( _listEnvManagerLRU.size() > 0 && (_envmanagers.size() > _nEnvManagerCacheCapacity || (_nEnvManagerCacheMaxBytes > 0 && _nEnvManagerCacheBytes > _nEnvManagerCacheMaxBytes)) ) {
+            ENVMANAGERSMAP::iterator itevict = _listEnvManagerLRU.back();
+            if( itevict == itkeep ) {
+                break;
+            }
+            _nEnvManagerCacheBytes -= itevict->second.nbytes;
+            _listEnvManagerLRU.pop_back();
+            _envmanagers.erase(itevict);
+            ++_envmanagercachestats.nEvictions;
+        }
+    }
+
+    /// \brief result of a body-body query, see SetResultCacheEnabled
+    struct BodyPairCacheEntry
+    {
+        int options; ///< collision options of the query
+        std::vector<int> vstamps; ///< stamps of all the bodies attached to the two bodies when the query was run, see _AppendCacheStamps
+        bool bCollision;
+    };
+
+    /// \brief appends the update stamps of pbody and of all the bodies attached to it
+    ///
+    /// The result of a body query can only change if one of these changed: the transforms, link enables, geometries, attached bodies or active dofs.
+    void _AppendCacheStamps(KinBodyConstPtr pbody, std::vector<int>& vstamps)
+    {
+        if( !pbody->HasAttached() ) {
+            _AppendBodyCacheStamps(pbody, vstamps);
+            return;
+        }
+        _setcacheattached.clear();
+        pbody->GetAttached(_setcacheattached);
+        FOREACHC(itbody, _setcacheattached) {
+            _AppendBodyCacheStamps(*itbody, vstamps);
+        }
+    }
+
+    void _AppendBodyCacheStamps(KinBodyConstPtr pbody, std::vector<int>& vstamps)
+    {
+        vstamps.push_back(pbody->GetEnvironmentId());
+        vstamps.push_back(pbody->GetUpdateStamp());
+        FCLSpace::KinBodyInfoPtr pinfo = _fclspace->GetInfo(pbody);
+        if( !!pinfo ) {
+            vstamps.push_back(pinfo->nLinkUpdateStamp);
+            vstamps.push_back(pinfo->nGeometryUpdateStamp);
+            vstamps.push_back(pinfo->nAttachedBodiesUpdateStamp);
+            vstamps.push_back(pinfo->nActiveDOFUpdateStamp);
+        }
+        else {
+            vstamps.push_back(-1);
         }
-        it->second->EnsureBodies(_fclspace->GetEnvBodies());
-        it->second->Synchronize();
-        //it->second->PrintStatus(OpenRAVE::Level_Info);
-        return it->second->GetManager();
     }
 
     int _options;
@@ -926,11 +1663,28 @@ private:
     std::string _userdatakey;
     std::string _broadPhaseCollisionManagerAlgorithm; ///< broadphase algorithm to use to create a manager. tested: Naive, DynamicAABBTree2
 
+    bool _bAutoBroadphase; ///< if true, _broadPhaseCollisionManagerAlgorithm is selected by timing the environment queries, see _UpdateAutoBroadphase
+    bool _bAutoBroadphaseTiming; ///< true while a query is timed by AutoBroadphaseTiming
+    int _nAutoBroadphaseWarmupQueries; ///< number of environment queries each candidate algorithm is timed on
+    std::vector<std::string> _vAutoBroadphaseCandidates; ///< algorithms compared by the automatic selection
+    std::vector<uint64_t> _vAutoBroadphaseTimes; ///< microseconds spent by each candidate during the warm-up
+    size_t _nAutoBroadphaseCandidate; ///< index of the candidate being timed, _vAutoBroadphaseCandidates.size() once the warm-up is over
+    int _nAutoBroadphaseQueries; ///< number of queries timed with the current candidate, -1 before the first one
+    size_t _nAutoBroadphaseNumBodies; ///< number of environment bodies the selection was made with
+
     typedef std::map< std::pair<KinBodyConstPtr, int>, FCLCollisionManagerInstancePtr> BODYMANAGERSMAP; ///< Maps pairs of (body, bactiveDOFs) to oits manager
     BODYMANAGERSMAP _bodymanagers; ///< managers for each of the individual bodies. each manager should be called with InitBodyManager.
     //std::map<KinBodyPtr, FCLCollisionManagerInstancePtr> _activedofbodymanagers; ///< managers for each of the individual bodies specifically when active DOF is used. each manager should be called with InitBodyManager
-    std::map< std::set<int>, FCLCollisionManagerInstancePtr> _envmanagers;
-    int _nGetEnvManagerCacheClearCount; ///< count down until cache can be cleared
+
+    ENVMANAGERSMAP _envmanagers;
+    std::list<ENVMANAGERSMAP::iterator> _listEnvManagerLRU; ///< entries of _envmanagers, the most recently used first
+    size_t _nEnvManagerCacheCapacity; ///< maximum number of entries in _envmanagers
+    uint64_t _nEnvManagerCacheMaxBytes; ///< maximum estimated bytes of _envmanagers, 0 if unlimited
+    uint64_t _nEnvManagerCacheBytes; ///< estimated bytes of _envmanagers
+    EnvManagerCacheStatistics _envmanagercachestats;
+    int _nNumThreads; ///< number of worker threads used by CheckCollisionBatch
+    std::map< std::pair<int, int>, ClosestFeatures > _mapClosestFeatures; ///< closest features of the last distance query, keyed by the environment ids of the two bodies. The second id is 0 for queries against the environment.
+    std::vector<DistanceLink> _vdistancelinks1, _vdistancelinks2; ///< used by ComputeDistance
 
 #ifdef FCLRAVE_COLLISION_OBJECTS_STATISTICS
     std::map<fcl::CollisionObject*, int> _currentlyused;
@@ -941,9 +1695,12 @@ private:
     NarrowCollisionCache mCollisionCachedGuesses;
 #endif
 
-#ifdef FCLUSESTATISTICS
-    FCLStatisticsPtr _statistics;
-#endif
+    FCLStatistics _statistics; ///< latency of the queries, recorded only when enabled with SetStatisticsEnabled
+
+    bool _bResultCache; ///< if true, the results of the body-body queries are cached in _mapBodyPairCache
+    std::map< std::pair<int, int>, BodyPairCacheEntry > _mapBodyPairCache; ///< results of the body-body queries keyed by the environment ids of the two bodies
+    std::vector<int> _vcachestamps; ///< used by CheckCollision to gather the stamps of a query
+    std::set<KinBodyConstPtr> _setcacheattached; ///< used by _AppendCacheStamps
 
     // In order to reduce allocations during collision checking
 
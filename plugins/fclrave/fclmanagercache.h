@@ -23,12 +23,12 @@ class FCLCollisionManagerInstance : public boost::enable_shared_from_this<FCLCol
     ///< cache data of body that is managed
     struct KinBodyCache
     {
-        KinBodyCache() : nLastStamp(0), nLinkUpdateStamp(0), nGeometryUpdateStamp(0), nAttachedBodiesUpdateStamp(0), nActiveDOFUpdateStamp(0), linkmask(0) {
+        KinBodyCache() : nTransformStamp(0), nLinkUpdateStamp(0), nGeometryUpdateStamp(0), nAttachedBodiesUpdateStamp(0), nActiveDOFUpdateStamp(0), linkmask(0) {
         }
         KinBodyCache(KinBodyConstPtr pbody, FCLSpace::KinBodyInfoPtr pinfo) {
             pwbody = pbody;
             pwinfo = pinfo;
-            nLastStamp = pinfo->nLastStamp;
+            nTransformStamp = pinfo->nTransformStamp;
             nLinkUpdateStamp = pinfo->nLinkUpdateStamp;
             nGeometryUpdateStamp = pinfo->nGeometryUpdateStamp;
             geometrygroup = pinfo->_geometrygroup;
@@ -39,12 +39,12 @@ class FCLCollisionManagerInstance : public boost::enable_shared_from_this<FCLCol
 
         KinBodyConstWeakPtr pwbody; ///< weak pointer to body
         FCLSpace::KinBodyInfoWeakPtr pwinfo; ///< weak pointer to info
-        int nLastStamp; ///< copyied from FCLSpace::KinBodyInfo when body was last updated
+        int nTransformStamp; ///< copied from FCLSpace::KinBodyInfo when the collision objects were last updated in the manager
         int nLinkUpdateStamp; ///< copied from FCLSpace::KinBodyInfo when body was last updated
         int nGeometryUpdateStamp; ///< copied from FCLSpace::KinBodyInfo when geometry was last updated
         int nAttachedBodiesUpdateStamp; /// copied from FCLSpace::KinBodyInfo when attached bodies was last updated
         int nActiveDOFUpdateStamp; ///< update stamp when the active dof changed
-        uint64_t linkmask; ///< links that are currently inside the manager
+        uint64_t linkmask; ///< links that are currently inside the manager. Links that get disabled stay inside and are skipped by the narrow phase, so toggling them does not change the broadphase
         std::vector<CollisionObjectPtr> vcolobjs; ///< collision objects used for each link (use link index). have to hold pointers so that KinBodyInfo does not remove them!
         std::string geometrygroup; ///< cached geometry group
     };
@@ -226,14 +226,14 @@ public:
                 itcache->second.pwinfo = pnewinfo;
                 //itcache->second.ResetStamps();
                 // need to update the stamps here so that we do not try to unregisterObject below and get into an error
-                itcache->second.nLastStamp = -1;
+                itcache->second.nTransformStamp = -1;
                 itcache->second.nLinkUpdateStamp = -1;
                 itcache->second.nGeometryUpdateStamp = -1;
                 itcache->second.nAttachedBodiesUpdateStamp = -1;
                 itcache->second.nActiveDOFUpdateStamp = -1;
                 itcache->second.geometrygroup.resize(0);
 
-                itcache->second.nLastStamp = pnewinfo->nLastStamp;
+                itcache->second.nTransformStamp = pnewinfo->nTransformStamp;
                 itcache->second.nLinkUpdateStamp = pnewinfo->nLinkUpdateStamp;
                 itcache->second.nGeometryUpdateStamp = pnewinfo->nGeometryUpdateStamp;
                 itcache->second.nAttachedBodiesUpdateStamp = -1;
@@ -248,8 +248,8 @@ public:
 
             if( pinfo->nLinkUpdateStamp != itcache->second.nLinkUpdateStamp ) {
                 RAVELOG_VERBOSE_FORMAT("%u body %s for cache changed link %d != %d", _lastSyncTimeStamp%pbody->GetName()%pinfo->nLinkUpdateStamp%itcache->second.nLinkUpdateStamp);
-                // links changed
-                uint64_t newlinkmask = pbody->GetLinkEnableStatesMask();
+                // links changed. disabled links are kept in the manager since the narrow phase skips them, only links that were never enabled are added
+                uint64_t newlinkmask = pbody->GetLinkEnableStatesMask() | itcache->second.linkmask;
                 if( _bTrackActiveDOF && ptrackingbody == pbody ) {
                     for(size_t itestlink = 0; itestlink < _vTrackingActiveLinks.size(); ++itestlink) {
                         if( !_vTrackingActiveLinks[itestlink] ) {
@@ -308,8 +308,8 @@ public:
                 }
                 itcache->second.nGeometryUpdateStamp = pinfo->nGeometryUpdateStamp;
             }
-            if( pinfo->nLastStamp != itcache->second.nLastStamp ) {
-                //RAVELOG_VERBOSE_FORMAT("%u body %s for cache changed transform %d != %d", _lastSyncTimeStamp%pbody->GetName()%pinfo->nLastStamp%itcache->second.nLastStamp);
+            if( pinfo->nTransformStamp != itcache->second.nTransformStamp ) {
+                //RAVELOG_VERBOSE_FORMAT("%u body %s for cache changed transform %d != %d", _lastSyncTimeStamp%pbody->GetName()%pinfo->nTransformStamp%itcache->second.nTransformStamp);
                 // transform changed
                 for(uint64_t ilink = 0; ilink < pinfo->vlinks.size(); ++ilink) {
                     if( itcache->second.linkmask & ((uint64_t)1<<ilink) ) {
@@ -325,7 +325,7 @@ public:
                     }
                 }
 
-                itcache->second.nLastStamp = pinfo->nLastStamp;
+                itcache->second.nTransformStamp = pinfo->nTransformStamp;
             }
             if( pinfo->nAttachedBodiesUpdateStamp != itcache->second.nAttachedBodiesUpdateStamp ) {
                 // bodies changed!
@@ -402,6 +402,18 @@ public:
         return _setExcludeBodyIds;
     }
 
+    /// \brief returns an estimate of the bytes held by the instance and its broadphase structure, not counting the shared collision objects
+    size_t GetMemoryUsage() const
+    {
+        size_t nbytes = sizeof(*this) + _tmpbuffer.capacity()*sizeof(CollisionObjectPtr) + _setExcludeBodyIds.size()*(sizeof(int)+4*sizeof(void*));
+        FOREACHC(it, mapCachedBodies) {
+            nbytes += sizeof(*it) + 4*sizeof(void*) + it->second.vcolobjs.capacity()*sizeof(CollisionObjectPtr) + it->second.geometrygroup.capacity();
+        }
+        // every object is a leaf of the broadphase structure, which keeps a bounding box and a few pointers per node
+        nbytes += pmanager->size()*2*(sizeof(fcl::AABB) + 4*sizeof(void*));
+        return nbytes;
+    }
+
     void PrintStatus(uint32_t debuglevel)
     {
         if( IS_DEBUGLEVEL(debuglevel) ) {
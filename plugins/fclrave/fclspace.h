@@ -3,6 +3,8 @@
 #define OPENRAVE_FCL_SPACE
 
 #include <boost/shared_ptr.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/thread/mutex.hpp>
 #include <memory> // c++11
 #include <vector>
 
@@ -57,6 +59,109 @@ CollisionGeometryPtr ConvertMeshToFCL(std::vector<fcl::Vec3f> const &points,std:
     return model;
 }
 
+/// \brief process-wide cache of the fcl meshes so that all the fcl spaces and their environment clones share the same bvh models
+///
+/// The models are keyed by the bvh representation and a hash of the collision mesh. Only weak references are kept,
+/// so a model is freed as soon as no collision object uses it.
+class FCLMeshCache
+{
+public:
+    static FCLMeshCache& GetInstance()
+    {
+        static FCLMeshCache s_cache;
+        return s_cache;
+    }
+
+    /// \brief returns the bvh model of mesh with the bvhRepresentation, builds it with meshFactory if it is not cached yet
+    CollisionGeometryPtr GetMesh(const std::string& bvhRepresentation, const MeshFactory& meshFactory, const OpenRAVE::TriMesh& mesh)
+    {
+        MeshKey key;
+        key.bvhRepresentation = bvhRepresentation;
+        key.numvertices = mesh.vertices.size();
+        key.numindices = mesh.indices.size();
+        key.hash = mesh.ComputeHash();
+
+        {
+            boost::mutex::scoped_lock lock(_mutex);
+            std::map<MeshKey, std::weak_ptr<fcl::CollisionGeometry> >::iterator it = _mapmeshes.find(key);
+            if( it != _mapmeshes.end() ) {
+                CollisionGeometryPtr pgeom = it->second.lock();
+                if( !!pgeom ) {
+                    return pgeom;
+                }
+            }
+        }
+
+        // build outside of the lock since it is the expensive part
+        size_t const num_points = mesh.vertices.size();
+        size_t const num_triangles = mesh.indices.size() / 3;
+        std::vector<fcl::Vec3f> fcl_points(num_points);
+        for (size_t ipoint = 0; ipoint < num_points; ++ipoint) {
+            Vector v = mesh.vertices[ipoint];
+            fcl_points[ipoint] = fcl::Vec3f(v.x, v.y, v.z);
+        }
+
+        std::vector<fcl::Triangle> fcl_triangles(num_triangles);
+        for (size_t itri = 0; itri < num_triangles; ++itri) {
+            int const *const tri_indices = &mesh.indices[3 * itri];
+            fcl_triangles[itri] = fcl::Triangle(tri_indices[0], tri_indices[1], tri_indices[2]);
+        }
+        CollisionGeometryPtr pgeom = meshFactory(fcl_points, fcl_triangles);
+
+        boost::mutex::scoped_lock lock(_mutex);
+        std::weak_ptr<fcl::CollisionGeometry>& pcached = _mapmeshes[key];
+        CollisionGeometryPtr pother = pcached.lock();
+        if( !!pother ) {
+            // another thread built the same mesh in the meantime
+            return pother;
+        }
+        pcached = pgeom;
+        if( _mapmeshes.size() >= 2*_nLastCleanSize ) {
+            // drop the models that are not used anymore
+            std::map<MeshKey, std::weak_ptr<fcl::CollisionGeometry> >::iterator it = _mapmeshes.begin();
+            while(it != _mapmeshes.end()) {
+                if( it->second.expired() ) {
+                    _mapmeshes.erase(it++);
+                }
+                else {
+                    ++it;
+                }
+            }
+            _nLastCleanSize = std::max(_mapmeshes.size(), (size_t)64);
+        }
+        return pgeom;
+    }
+
+private:
+    FCLMeshCache() : _nLastCleanSize(64) {
+    }
+
+    struct MeshKey
+    {
+        bool operator<(const MeshKey& other) const
+        {
+            if( hash != other.hash ) {
+                return hash < other.hash;
+            }
+            if( numvertices != other.numvertices ) {
+                return numvertices < other.numvertices;
+            }
+            if( numindices != other.numindices ) {
+                return numindices < other.numindices;
+            }
+            return bvhRepresentation < other.bvhRepresentation;
+        }
+
+        std::string bvhRepresentation;
+        size_t numvertices, numindices;
+        size_t hash;
+    };
+
+    std::map<MeshKey, std::weak_ptr<fcl::CollisionGeometry> > _mapmeshes; ///< protected by _mutex
+    size_t _nLastCleanSize; ///< size of _mapmeshes after the last removal of the expired models
+    boost::mutex _mutex;
+};
+
 /// \brief fcl spaces manages the individual collision objects and sets up callbacks to track their changes.
 ///
 /// It does not know or manage the broadphase manager
@@ -97,6 +202,8 @@ public:
                     (*itgeompair).second.reset();
                 }
                 vgeoms.resize(0);
+                vgeomstamps.resize(0);
+                vgeomindices.resize(0);
             }
 
             KinBody::LinkPtr GetLink() {
@@ -105,13 +212,15 @@ public:
 
             KinBody::LinkWeakPtr _plink;
 
-            //int nLastStamp; ///< Tracks if the collision geometries are up to date wrt the body update stamp. This is for narrow phase collision
+            int nLastStamp; ///< KinBody::Link::GetUpdateStamp() when the collision objects were last synchronized
             TransformCollisionPair linkBV; ///< pair of the transformation and collision object corresponding to a bounding OBB for the link
             std::vector<TransformCollisionPair> vgeoms; ///< vector of transformations and collision object; one per geometries
+            std::vector< std::pair<KinBody::Link::Geometry const*, int> > vgeomstamps; ///< when tracking the current geometries, each geometry of the link and its KinBody::Link::Geometry::GetUpdateStamp() when its collision object was created
+            std::vector<int> vgeomindices; ///< when tracking the current geometries, the index in vgeoms of each geometry of the link, -1 if it has no collision object
             std::string bodylinkname; // for debugging purposes
         };
 
-        KinBodyInfo() : nLastStamp(0), nLinkUpdateStamp(0), nGeometryUpdateStamp(0), nAttachedBodiesUpdateStamp(0), nActiveDOFUpdateStamp(0)
+        KinBodyInfo() : nLastStamp(0), nTransformStamp(0), nLinkUpdateStamp(0), nGeometryUpdateStamp(0), nAttachedBodiesUpdateStamp(0), nActiveDOFUpdateStamp(0), nSelfPairsAdjacentOptions(0), nSelfPairsNonAdjacentStamp(-1)
         {
         }
 
@@ -125,6 +234,8 @@ public:
                 (*itlink)->Reset();
             }
             vlinks.resize(0);
+            vselfpairs.resize(0);
+            nSelfPairsNonAdjacentStamp = -1;
             _geometrycallback.reset();
             _geometrygroupcallback.reset();
             _linkenablecallback.reset();
@@ -137,12 +248,16 @@ public:
 
         KinBodyWeakPtr _pbody;
         int nLastStamp;  ///< KinBody::GetUpdateStamp() when last synchronized ("is transform up to date")
+        int nTransformStamp; ///< increases every time synchronizing moved the collision object of a link. The managers compare it instead of nLastStamp so that changes that do not move links, like enabling links, do not update the broadphase
         int nLinkUpdateStamp; ///< update stamp for link enable state (increases every time link enables change)
         int nGeometryUpdateStamp; ///< update stamp for geometry update state (increases every time geometry enables change)
         int nAttachedBodiesUpdateStamp; ///< update stamp for when attached bodies change of this body
         int nActiveDOFUpdateStamp; ///< update stamp for when active dofs change of this body
 
         vector< boost::shared_ptr<LINK> > vlinks; ///< info for every link of the kinbody
+        std::vector< std::pair<int16_t, int16_t> > vselfpairs; ///< non-adjacent link pairs of the body where both links have collision geometry, used as the self-collision broadphase
+        int nSelfPairsAdjacentOptions; ///< the adjacent options vselfpairs was built with
+        int nSelfPairsNonAdjacentStamp; ///< KinBody::GetNonAdjacentLinksUpdateStamp() when vselfpairs was built
 
         OpenRAVE::UserDataPtr _bodyAttachedCallback; ///< handle for the callback called when a body is attached or detached
         OpenRAVE::UserDataPtr _activeDOFsCallback; ///< handle for the callback called when a the activeDOFs have changed
@@ -212,6 +327,7 @@ public:
             GeometryInfoIterator begingeom, endgeom;
 
             // Glue code for a unified access to geometries
+            bool bCurrentGeometries = false;
             if(pinfo->_geometrygroup.size() > 0 && (*itlink)->GetGroupNumGeometries(pinfo->_geometrygroup) >= 0) {
                 const std::vector<KinBody::GeometryInfoPtr>& vgeometryinfos = (*itlink)->GetGeometriesFromGroup(pinfo->_geometrygroup);
                 typedef boost::function<KinBody::GeometryInfo const& (KinBody::GeometryInfoPtr const&)> Func;
@@ -229,11 +345,18 @@ public:
                                };
                 begingeom = GeometryInfoIterator(PtrGeomInfoIterator(geoms.begin(), getInfo));
                 endgeom = GeometryInfoIterator(PtrGeomInfoIterator(geoms.end(), getInfo));
+                bCurrentGeometries = true;
+                FOREACHC(itgeom, geoms) {
+                    link->vgeomstamps.push_back(std::make_pair(itgeom->get(), (*itgeom)->GetUpdateStamp()));
+                }
             }
 
             for(GeometryInfoIterator itgeominfo = begingeom; itgeominfo != endgeom; ++itgeominfo) {
-                const CollisionGeometryPtr pfclgeom = _CreateFCLGeomFromGeometryInfo(_meshFactory, *itgeominfo);
+                const CollisionGeometryPtr pfclgeom = _CreateFCLGeomFromGeometryInfo(_bvhRepresentation, _meshFactory, *itgeominfo);
 
+                if( bCurrentGeometries ) {
+                    link->vgeomindices.push_back(!pfclgeom ? -1 : (int)link->vgeoms.size());
+                }
                 if( !pfclgeom ) {
                     continue;
                 }
@@ -255,14 +378,11 @@ public:
                     KinBody::Link::Geometry _tmpgeometry(boost::shared_ptr<KinBody::Link>(), *it);
                     enclosingBV += ConvertAABBToFcl(_tmpgeometry.ComputeAABB(Transform()));
                 }
-                CollisionGeometryPtr pfclgeomBV = std::make_shared<fcl::Box>(enclosingBV.max_ - enclosingBV.min_);
-                CollisionObjectPtr pfclcollBV = boost::make_shared<fcl::CollisionObject>(pfclgeomBV);
-                Transform trans(Vector(1,0,0,0),ConvertVectorFromFCL(0.5 * (enclosingBV.min_ + enclosingBV.max_)));
-                pfclcollBV->setUserData(link.get());
-                link->linkBV = std::make_pair(trans, pfclcollBV);
+                _SetLinkBV(*link, enclosingBV);
             }
 
-            //link->nLastStamp = pinfo->nLastStamp;
+            // make sure that synchronization do occur !
+            link->nLastStamp = (*itlink)->GetUpdateStamp() - 1;
             link->bodylinkname = pbody->GetName() + "/" + (*itlink)->GetName();
             pinfo->vlinks.push_back(link);
 #ifdef FCLRAVE_COLLISION_OBJECTS_STATISTICS
@@ -534,7 +654,8 @@ private:
     }
 
     // what about the tests on non-zero size (eg. box extents) ?
-    static CollisionGeometryPtr _CreateFCLGeomFromGeometryInfo(const MeshFactory &mesh_factory, const KinBody::GeometryInfo &info)
+    // The meshes are taken from FCLMeshCache so that the bodies of all the environments share their bvh models.
+    static CollisionGeometryPtr _CreateFCLGeomFromGeometryInfo(const std::string& bvhRepresentation, const MeshFactory &mesh_factory, const KinBody::GeometryInfo &info)
     {
         switch(info._type) {
 
@@ -550,6 +671,23 @@ private:
         case OpenRAVE::GT_Cylinder:
             return make_shared<fcl::Cylinder>(info._vGeomData.x, info._vGeomData.y);
 
+        case OpenRAVE::GT_Octree:
+#ifdef FCLRAVE_USE_OCTOMAP
+        {
+            if( info._setOctreeVoxels.empty() ) {
+                return CollisionGeometryPtr();
+            }
+            // the keys of the voxels are aligned with the octomap grid of the same resolution
+            std::shared_ptr<octomap::OcTree> poctree = std::make_shared<octomap::OcTree>(info.GetOctreeVoxelSize());
+            FOREACHC(itkey, info._setOctreeVoxels) {
+                Vector vcenter = info.GetOctreeVoxelCenter(*itkey);
+                poctree->updateNode(octomap::point3d(vcenter.x, vcenter.y, vcenter.z), true, true);
+            }
+            poctree->updateInnerOccupancy();
+            return make_shared<fcl::OcTree>(poctree);
+        }
+#endif
+        // without octomap, the voxel boxes of the collision mesh are used
         case OpenRAVE::GT_Container:
         case OpenRAVE::GT_TriMesh:
         {
@@ -559,22 +697,7 @@ private:
             }
 
             OPENRAVE_ASSERT_OP(mesh.indices.size() % 3, ==, 0);
-            size_t const num_points = mesh.vertices.size();
-            size_t const num_triangles = mesh.indices.size() / 3;
-
-            std::vector<fcl::Vec3f> fcl_points(num_points);
-            for (size_t ipoint = 0; ipoint < num_points; ++ipoint) {
-                Vector v = mesh.vertices[ipoint];
-                fcl_points[ipoint] = fcl::Vec3f(v.x, v.y, v.z);
-            }
-
-            std::vector<fcl::Triangle> fcl_triangles(num_triangles);
-            for (size_t itri = 0; itri < num_triangles; ++itri) {
-                int const *const tri_indices = &mesh.indices[3 * itri];
-                fcl_triangles[itri] = fcl::Triangle(tri_indices[0], tri_indices[1], tri_indices[2]);
-            }
-
-            return mesh_factory(fcl_points, fcl_triangles);
+            return FCLMeshCache::GetInstance().GetMesh(bvhRepresentation, mesh_factory, mesh);
         }
 
         default:
@@ -587,17 +710,23 @@ private:
     {
         KinBodyPtr pbody = pinfo->GetBody();
         if( pinfo->nLastStamp != pbody->GetUpdateStamp()) {
-            vector<Transform> vtrans;
-            pbody->GetLinkTransformations(vtrans);
+            const std::vector<KinBody::LinkPtr>& vlinks = pbody->GetLinks();
             pinfo->nLastStamp = pbody->GetUpdateStamp();
-            BOOST_ASSERT( pbody->GetLinks().size() == pinfo->vlinks.size() );
-            BOOST_ASSERT( vtrans.size() == pinfo->vlinks.size() );
-            for(size_t i = 0; i < vtrans.size(); ++i) {
+            BOOST_ASSERT( vlinks.size() == pinfo->vlinks.size() );
+            bool bmoved = false;
+            for(size_t i = 0; i < vlinks.size(); ++i) {
+                // only the links that moved since the last synchronization need to be updated
+                if( pinfo->vlinks[i]->nLastStamp == vlinks[i]->GetUpdateStamp() ) {
+                    continue;
+                }
+                pinfo->vlinks[i]->nLastStamp = vlinks[i]->GetUpdateStamp();
                 CollisionObjectPtr pcoll = pinfo->vlinks[i]->linkBV.second;
                 if( !pcoll ) {
                     continue;
                 }
-                Transform pose = vtrans[i] * pinfo->vlinks[i]->linkBV.first;
+                bmoved = true;
+                Transform tlink = vlinks[i]->GetTransform();
+                Transform pose = tlink * pinfo->vlinks[i]->linkBV.first;
                 fcl::Vec3f newPosition = ConvertVectorToFCL(pose.trans);
                 fcl::Quaternion3f newOrientation = ConvertQuaternionToFCL(pose.rot);
 
@@ -606,10 +735,9 @@ private:
                 // Do not forget to recompute the AABB otherwise getAABB won't give an up to date AABB
                 pcoll->computeAABB();
 
-                //pinfo->vlinks[i]->nLastStamp = pinfo->nLastStamp;
                 FOREACHC(itgeomcoll, pinfo->vlinks[i]->vgeoms) {
                     CollisionObjectPtr pcoll = (*itgeomcoll).second;
-                    Transform pose = vtrans[i] * (*itgeomcoll).first;
+                    Transform pose = tlink * (*itgeomcoll).first;
                     fcl::Vec3f newPosition = ConvertVectorToFCL(pose.trans);
                     fcl::Quaternion3f newOrientation = ConvertQuaternionToFCL(pose.rot);
 
@@ -619,6 +747,9 @@ private:
                     pcoll->computeAABB();
                 }
             }
+            if( bmoved ) {
+                ++pinfo->nTransformStamp;
+            }
 
             // Does this have any use ?
             if( !!_synccallback ) {
@@ -655,13 +786,122 @@ private:
         //RAVELOG_VERBOSE_FORMAT("Resetting current geometry for kinbody %s (in env %d, key %s)", pbody->GetName()%_penv->GetId()%_userdatakey);
         if( !!pinfo && pinfo->_geometrygroup.size() == 0 ) {
             pinfo->nGeometryUpdateStamp++;
-            KinBodyInfoRemover remover(boost::bind(&FCLSpace::RemoveUserData, this, pbody)); // protect
-            InitKinBody(pbody, pinfo);
-            remover.ResetRemove(); // succeeded
+            if( !_UpdateModifiedGeometries(pinfo) ) {
+                KinBodyInfoRemover remover(boost::bind(&FCLSpace::RemoveUserData, this, pbody)); // protect
+                InitKinBody(pbody, pinfo);
+                remover.ResetRemove(); // succeeded
+            }
         }
         _cachedpinfo[pbody->GetEnvironmentId()].erase(std::string());
     }
 
+    /// \brief creates the collision object of the bounding box of link from the local aabb of its geometries
+    static void _SetLinkBV(KinBodyInfo::LINK& link, const fcl::AABB& enclosingBV)
+    {
+        if( !!link.linkBV.second ) {
+            link.linkBV.second->setUserData(nullptr);
+        }
+        CollisionGeometryPtr pfclgeomBV = std::make_shared<fcl::Box>(enclosingBV.max_ - enclosingBV.min_);
+        CollisionObjectPtr pfclcollBV = boost::make_shared<fcl::CollisionObject>(pfclgeomBV);
+        Transform trans(Vector(1,0,0,0),ConvertVectorFromFCL(0.5 * (enclosingBV.min_ + enclosingBV.max_)));
+        pfclcollBV->setUserData(&link);
+        link.linkBV = std::make_pair(trans, pfclcollBV);
+    }
+
+    /// \brief rebuilds only the collision objects of the current geometries that were modified in place, see KinBody::Link::Geometry::GetUpdateStamp
+    ///
+    /// \return false if the whole body has to be reinitialized, because geometries were added, removed or replaced, or because no geometry stamp changed
+    bool _UpdateModifiedGeometries(KinBodyInfoPtr pinfo)
+    {
+        KinBodyPtr pbody = pinfo->GetBody();
+        const std::vector<KinBody::LinkPtr>& vlinks = pbody->GetLinks();
+        if( vlinks.size() != pinfo->vlinks.size() ) {
+            return false;
+        }
+        bool bModified = false;
+        for(size_t ilink = 0; ilink < vlinks.size(); ++ilink) {
+            const std::vector<KinBody::Link::GeometryPtr>& vgeometries = vlinks[ilink]->GetGeometries();
+            const KinBodyInfo::LINK& link = *pinfo->vlinks[ilink];
+            if( vgeometries.size() != link.vgeomstamps.size() || vgeometries.size() != link.vgeomindices.size() ) {
+                return false;
+            }
+            for(size_t igeom = 0; igeom < vgeometries.size(); ++igeom) {
+                if( vgeometries[igeom].get() != link.vgeomstamps[igeom].first ) {
+                    return false;
+                }
+                if( vgeometries[igeom]->GetUpdateStamp() != link.vgeomstamps[igeom].second ) {
+                    bModified = true;
+                }
+            }
+        }
+        if( !bModified ) {
+            // something else changed, cannot tell what
+            return false;
+        }
+
+        for(size_t ilink = 0; ilink < vlinks.size(); ++ilink) {
+            const std::vector<KinBody::Link::GeometryPtr>& vgeometries = vlinks[ilink]->GetGeometries();
+            KinBodyInfo::LINK& link = *pinfo->vlinks[ilink];
+            bool bLinkModified = false;
+            for(size_t igeom = 0; igeom < vgeometries.size(); ++igeom) {
+                if( vgeometries[igeom]->GetUpdateStamp() != link.vgeomstamps[igeom].second ) {
+                    bLinkModified = true;
+                    break;
+                }
+            }
+            if( !bLinkModified ) {
+                continue;
+            }
+
+            // keep the collision objects of the unchanged geometries
+            std::vector<TransformCollisionPair> vnewgeoms;
+            vnewgeoms.reserve(vgeometries.size());
+            for(size_t igeom = 0; igeom < vgeometries.size(); ++igeom) {
+                int oldindex = link.vgeomindices[igeom];
+                if( vgeometries[igeom]->GetUpdateStamp() == link.vgeomstamps[igeom].second ) {
+                    link.vgeomindices[igeom] = oldindex >= 0 ? (int)vnewgeoms.size() : -1;
+                    if( oldindex >= 0 ) {
+                        vnewgeoms.push_back(link.vgeoms.at(oldindex));
+                    }
+                    continue;
+                }
+                if( oldindex >= 0 ) {
+                    link.vgeoms.at(oldindex).second->setUserData(nullptr);
+                }
+                link.vgeomstamps[igeom].second = vgeometries[igeom]->GetUpdateStamp();
+                link.vgeomindices[igeom] = -1;
+                const KinBody::GeometryInfo& info = vgeometries[igeom]->GetInfo();
+                const CollisionGeometryPtr pfclgeom = _CreateFCLGeomFromGeometryInfo(_bvhRepresentation, _meshFactory, info);
+                if( !!pfclgeom ) {
+                    CollisionObjectPtr pfclcoll = boost::make_shared<fcl::CollisionObject>(pfclgeom);
+                    pfclcoll->setUserData(&link);
+                    link.vgeomindices[igeom] = (int)vnewgeoms.size();
+                    vnewgeoms.push_back(TransformCollisionPair(info._t, pfclcoll));
+                }
+            }
+            link.vgeoms.swap(vnewgeoms);
+
+            if( link.vgeoms.size() == 0 ) {
+                if( !!link.linkBV.second ) {
+                    link.linkBV.second->setUserData(nullptr);
+                    link.linkBV.second.reset();
+                }
+            }
+            else {
+                fcl::AABB enclosingBV = ConvertAABBToFcl(vgeometries[0]->ComputeAABB(Transform()));
+                for(size_t igeom = 1; igeom < vgeometries.size(); ++igeom) {
+                    enclosingBV += ConvertAABBToFcl(vgeometries[igeom]->ComputeAABB(Transform()));
+                }
+                _SetLinkBV(link, enclosingBV);
+            }
+            // make sure that synchronization do occur !
+            link.nLastStamp = vlinks[ilink]->GetUpdateStamp() - 1;
+        }
+        pinfo->nLastStamp = pbody->GetUpdateStamp() - 1;
+        _Synchronize(pinfo);
+        return true;
+    }
+
     void _ResetGeometryGroupsCallback(boost::weak_ptr<KinBodyInfo> _pinfo)
     {
         KinBodyInfoPtr pinfo = _pinfo.lock();
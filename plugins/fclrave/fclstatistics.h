@@ -2,145 +2,238 @@
 #ifndef OPENRAVE_FCL_STATISTICS
 #define OPENRAVE_FCL_STATISTICS
 
-
-#ifdef FCLUSESTATISTICS
-
 #include "plugindefs.h"
+#include <atomic>
 #include <sstream>
-#include <fstream>
-
 
 namespace fclrave {
 
-class FCLStatistics;
+/// \brief latency statistics of the collision queries, grouped by call site
+///
+/// Recording is off by default and costs a single relaxed atomic load per query when disabled.
+/// When enabled, each thread records into its own counters so that concurrent queries never share a cache line,
+/// the counters of all the threads are only merged when exporting.
+/// Latencies are kept in log-scale histograms with four buckets per power of two, so percentiles are within 25% of the real value.
+class FCLStatistics
+{
+public:
+    enum QueryType {
+        QT_BodyEnv=0,
+        QT_BodyBody,
+        QT_LinkEnv,
+        QT_LinkLink,
+        QT_LinkBody,
+        QT_BodySelf,
+        QT_LinkSelf,
+        QT_BodyBatchEnv,
+        QT_Ray,
+        QT_BodyBodyCached, ///< BodyBody queries answered by the result cache of the checker
+        QT_NumTypes
+    };
 
-static std::vector<boost::weak_ptr<FCLStatistics> > globalStatistics;
-static EnvironmentMutex log_out_mutex;
-typedef std::chrono::time_point<std::chrono::high_resolution_clock> time_point;
-typedef std::chrono::duration<double> duration;
+    static const char* GetQueryTypeName(QueryType type) {
+        static const char* s_names[QT_NumTypes] = {"BodyEnv", "BodyBody", "LinkEnv", "LinkLink", "LinkBody", "BodySelf", "LinkSelf", "BodyBatchEnv", "Ray", "BodyBodyCached"};
+        return s_names[type];
+    }
 
-class FCLStatistics {
+    /// \brief records the time between its construction and destruction if the statistics are enabled
+    class Timer
+    {
 public:
-    FCLStatistics(std::string const& key, int id) {
-        name = str(boost::format("%d;%s")%id%key);
-        RAVELOG_WARN_FORMAT("FCL STATISTICS %s", name);
-        currentTimings.reserve(64); // so that we don't allocate during the timing
+        Timer(FCLStatistics& statistics, QueryType type) : _statistics(statistics), _type(type), _starttime(0) {
+            if( statistics.IsEnabled() ) {
+                _starttime = OpenRAVE::utils::GetNanoPerformanceTime();
+            }
+        }
+        ~Timer() {
+            if( _starttime != 0 ) {
+                _statistics.Record(_type, OpenRAVE::utils::GetNanoPerformanceTime() - _starttime);
+            }
+        }
+
+        /// \brief changes the query type the time is recorded as, e.g. when the query was answered from a cache
+        inline void SetType(QueryType type) {
+            _type = type;
+        }
+private:
+        FCLStatistics& _statistics;
+        QueryType _type;
+        uint64_t _starttime;
+    };
+
+    FCLStatistics() : _bEnabled(false) {
+        static std::atomic<uint64_t> s_nextid(1);
+        _id = s_nextid.fetch_add(1);
     }
 
-    ~FCLStatistics() {
-#ifndef FCL_STATISTICS_DISPLAY_CONTINUOUSLY
-        Display();
-#endif
+    inline bool IsEnabled() const {
+        return _bEnabled.load(std::memory_order_relaxed);
     }
 
-    void DisplayAll() {
-        FOREACH(itstat, globalStatistics) {
-            boost::shared_ptr<FCLStatistics> pstat = itstat->lock();
-            if( pstat ) {
-                pstat->Display();
-            }
+    void SetEnabled(bool benabled) {
+        _bEnabled.store(benabled, std::memory_order_relaxed);
+    }
+
+    /// \brief adds a query of duration elapsednano to the counters of the calling thread
+    void Record(QueryType type, uint64_t elapsednano)
+    {
+        // ids are never reused, so the cache of a destroyed instance can never be mistaken for this one
+        static thread_local std::pair<uint64_t, ThreadCountersPtr> s_cache;
+        if( s_cache.first != _id ) {
+            s_cache.second = _GetThreadCounters();
+            s_cache.first = _id;
+        }
+        TypeCounters& counters = s_cache.second->types[type];
+        counters.count.fetch_add(1, std::memory_order_relaxed);
+        counters.totalnano.fetch_add(elapsednano, std::memory_order_relaxed);
+        if( elapsednano > counters.maxnano.load(std::memory_order_relaxed) ) {
+            counters.maxnano.store(elapsednano, std::memory_order_relaxed);
         }
+        counters.buckets[_GetBucket(elapsednano)].fetch_add(1, std::memory_order_relaxed);
     }
 
-    void DisplaySingle(const std::string& label, std::vector<time_point> timings) {
-        std::stringstream ss;
-        std::vector<time_point>::iterator it = timings.begin();
-        time_point t = *it;
-        while(++it != timings.end()) {
-            ss << ";" << (*it - t).count();
-            t = *it;
+    /// \brief clears the counters of all the threads
+    void Reset()
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        FOREACH(itcounters, _mapthreadcounters) {
+            for(int itype = 0; itype < QT_NumTypes; ++itype) {
+                TypeCounters& counters = itcounters->second->types[itype];
+                counters.count.store(0, std::memory_order_relaxed);
+                counters.totalnano.store(0, std::memory_order_relaxed);
+                counters.maxnano.store(0, std::memory_order_relaxed);
+                for(int ibucket = 0; ibucket < NUM_BUCKETS; ++ibucket) {
+                    counters.buckets[ibucket].store(0, std::memory_order_relaxed);
+                }
+            }
         }
-        RAVELOG_WARN_FORMAT("FCL STATISTICS;%s%s", label % ss.str());
     }
 
-    void Display() {
-        EnvironmentMutex::scoped_lock lock(log_out_mutex);
-        std::fstream f("fclstatistics.log", std::fstream::out | std::fstream::app);
-        FOREACH(ittiming, timings) {
-            f << ittiming->first;
-            size_t maxTimingCount = 0;
-            FOREACH(ittimingvector, ittiming->second) {
-                f << ";";
-                maxTimingCount = std::max(maxTimingCount, ittimingvector->size() - 1);
-                std::vector<time_point>::iterator it = ittimingvector->begin();
-                time_point t = *it;
-                while(++it != ittimingvector->end()) {
-                    f << "|" << (*it - t).count();
-                    t = *it;
+    /// \brief writes the merged counters as a JSON object keyed by query type, times are in seconds
+    ///
+    /// e.g. {"BodyEnv": {"count": 10, "total": 0.001, "mean": 0.0001, "max": 0.0003, "p50": 0.0001, "p90": 0.0002, "p99": 0.0003}}
+    /// Query types that were never recorded are omitted.
+    void ExportJSON(std::ostream& sout) const
+    {
+        std::vector<uint64_t> vbuckets(NUM_BUCKETS);
+        std::stringstream ss;
+        ss << std::setprecision(9);
+        ss << "{";
+        bool bfirst = true;
+        boost::mutex::scoped_lock lock(_mutex);
+        for(int itype = 0; itype < QT_NumTypes; ++itype) {
+            uint64_t count = 0, totalnano = 0, maxnano = 0;
+            std::fill(vbuckets.begin(), vbuckets.end(), 0);
+            FOREACHC(itcounters, _mapthreadcounters) {
+                const TypeCounters& counters = itcounters->second->types[itype];
+                count += counters.count.load(std::memory_order_relaxed);
+                totalnano += counters.totalnano.load(std::memory_order_relaxed);
+                maxnano = std::max(maxnano, counters.maxnano.load(std::memory_order_relaxed));
+                for(int ibucket = 0; ibucket < NUM_BUCKETS; ++ibucket) {
+                    vbuckets[ibucket] += counters.buckets[ibucket].load(std::memory_order_relaxed);
                 }
             }
-            f << ";" << maxTimingCount << std::endl;
+            if( count == 0 ) {
+                continue;
+            }
+            if( !bfirst ) {
+                ss << ", ";
+            }
+            bfirst = false;
+            ss << "\"" << GetQueryTypeName((QueryType)itype) << "\": {\"count\": " << count << ", \"total\": " << 1e-9*totalnano << ", \"mean\": " << 1e-9*totalnano/count << ", \"max\": " << 1e-9*maxnano;
+            ss << ", \"p50\": " << 1e-9*_GetPercentile(vbuckets, count, 0.5, maxnano);
+            ss << ", \"p90\": " << 1e-9*_GetPercentile(vbuckets, count, 0.9, maxnano);
+            ss << ", \"p99\": " << 1e-9*_GetPercentile(vbuckets, count, 0.99, maxnano) << "}";
         }
+        ss << "}";
+        sout << ss.str();
     }
 
-    void StartManualTiming(std::string const& label) {
-        currentTimingLabel = str(boost::format("%s;%s")%name%label);
-        currentTimings.resize(0);
-        currentTimings.push_back(std::chrono::high_resolution_clock::now());
+private:
+    static const int NUM_BUCKETS = 256; ///< 4 buckets for each of the 64 powers of two
+
+    struct TypeCounters
+    {
+        std::atomic<uint64_t> count, totalnano, maxnano;
+        std::atomic<uint64_t> buckets[NUM_BUCKETS];
+    };
+
+    /// \brief counters written by a single thread
+    struct ThreadCounters
+    {
+        ThreadCounters() {
+            for(int itype = 0; itype < QT_NumTypes; ++itype) {
+                types[itype].count = 0;
+                types[itype].totalnano = 0;
+                types[itype].maxnano = 0;
+                for(int ibucket = 0; ibucket < NUM_BUCKETS; ++ibucket) {
+                    types[itype].buckets[ibucket] = 0;
+                }
+            }
+        }
+        TypeCounters types[QT_NumTypes];
+    };
+    typedef boost::shared_ptr<ThreadCounters> ThreadCountersPtr;
+
+    /// \brief returns the counters of the calling thread, only called when the thread local cache of Record misses
+    ThreadCountersPtr _GetThreadCounters()
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        ThreadCountersPtr& pcounters = _mapthreadcounters[boost::this_thread::get_id()];
+        if( !pcounters ) {
+            pcounters.reset(new ThreadCounters());
+        }
+        return pcounters;
     }
 
-    void StopManualTiming() {
-        currentTimings.push_back(std::chrono::high_resolution_clock::now());
-        timings[currentTimingLabel].push_back(currentTimings);
-#ifdef FCL_STATISTICS_DISPLAY_CONTINUOUSLY
-        DisplaySingle(currentTimingLabel, currentTimings);
+    /// \brief bucket index of a duration, the two bits after the most significant one select the quarter of the power of two
+    static inline int _GetBucket(uint64_t nano)
+    {
+        if( nano < 4 ) {
+            return (int)nano;
+        }
+#ifdef __GNUC__
+        int msb = 63 - __builtin_clzll(nano);
+#else
+        int msb = 63;
+        while( !(nano & (uint64_t(1) << msb)) ) {
+            --msb;
+        }
 #endif
+        return msb*4 + (int)((nano >> (msb-2)) & 3);
     }
 
-    void AddTimepoint() {
-        currentTimings.push_back(std::chrono::high_resolution_clock::now());
+    /// \brief upper bound of the durations falling in bucket
+    static inline double _GetBucketUpperBound(int bucket)
+    {
+        if( bucket < 8 ) {
+            return bucket + 1;
+        }
+        int msb = bucket/4;
+        return double(5 + (bucket&3)) * double(uint64_t(1) << (msb-2));
     }
 
-    struct Timing {
-        Timing(FCLStatistics& statistics) : _statistics(statistics) {
-        }
-        ~Timing() {
-            _statistics.StopManualTiming();
+    static double _GetPercentile(const std::vector<uint64_t>& vbuckets, uint64_t count, double fraction, uint64_t maxnano)
+    {
+        uint64_t target = (uint64_t)ceil(fraction*count);
+        uint64_t accumulated = 0;
+        for(int ibucket = 0; ibucket < NUM_BUCKETS; ++ibucket) {
+            accumulated += vbuckets[ibucket];
+            if( accumulated >= target ) {
+                return std::min(_GetBucketUpperBound(ibucket), (double)maxnano);
+            }
         }
-private:
-        FCLStatistics& _statistics;
-    };
-
-    Timing StartTiming(std::string const& label) {
-        StartManualTiming(label);
-        return Timing(*this);
+        return maxnano;
     }
 
-    std::string name;
-    std::string currentTimingLabel;
-    std::vector<time_point> currentTimings;
-    std::map< std::string, std::vector< std::vector<time_point> > > timings;
+    std::atomic<bool> _bEnabled;
+    uint64_t _id; ///< unique id of the instance, used as the key of the thread local cache of Record
+    std::map<boost::thread::id, ThreadCountersPtr> _mapthreadcounters; ///< counters of all the threads that recorded a query, kept after the threads exit. protected by _mutex
+    mutable boost::mutex _mutex;
 };
 
 typedef boost::shared_ptr<FCLStatistics> FCLStatisticsPtr;
 
-#define SETUP_STATISTICS(statistics, userdatakey, id) \
-    statistics = boost::make_shared<FCLStatistics>(userdatakey, id); \
-    globalStatistics.push_back(boost::weak_ptr<FCLStatistics>(statistics))
-
-#define START_TIMING(statistics, label) FCLStatistics::Timing t = statistics->StartTiming(label)
-
-#define ADD_TIMING(statistics) statistics->AddTimepoint()
-
-#define DISPLAY(statistics) statistics->DisplayAll()
-
 } // fclrave
 
-#else // FCLUSESTATISTICS is not defined
-
-namespace fclrave {
-
-class FCLStatistics {
-};
-
-#define SETUP_STATISTICS(statistics, userdatakey, id) do {} while(false)
-#define START_TIMING(statistics, label) do {} while(false)
-#define ADD_TIMING(statistics) do {} while(false)
-#define DISPLAY(statistics) do {} while(false)
-
-}
-#endif
-
-
-
 #endif
@@ -0,0 +1,128 @@
+// -*- coding: utf-8 -*-
+#ifndef OPENRAVE_FCL_THREADVIEW
+#define OPENRAVE_FCL_THREADVIEW
+
+#include "plugindefs.h"
+#include "fclspace.h"
+#include "fclmanagercache.h"
+
+namespace fclrave {
+
+/// \brief A lightweight view of some bodies of a FCLSpace used by one worker thread
+///
+/// The view holds its own collision objects for the links of the bodies it tracks and its own broadphase manager.
+/// The collision objects share the immutable fcl geometries with the FCLSpace, so the view can be placed at any link
+/// transforms without touching the KinBodyInfo stamps or the cached managers of the checker.
+/// The user data of every collision object points to a LINK owned by the view, so the narrow phase callbacks of the checker work unchanged.
+class FCLThreadView
+{
+public:
+    FCLThreadView(FCLSpace& fclspace, BroadPhaseCollisionManagerPtr pmanager) : _fclspace(fclspace), _pmanager(pmanager) {
+    }
+
+    virtual ~FCLThreadView() {
+        _pmanager->clear();
+        FOREACH(itlink, _vlinks) {
+            if( !!*itlink ) {
+                (*itlink)->Reset();
+            }
+        }
+    }
+
+    /// \brief adds copies of all the enabled links of pbody to the view. Has to be called from the thread owning the environment.
+    ///
+    /// \param managedlinkmask the links that are put inside the broadphase manager of the view
+    /// \return the index of the first link of pbody inside the view
+    size_t AddBody(KinBodyConstPtr pbody, uint64_t managedlinkmask)
+    {
+        size_t offset = _vlinks.size();
+        FCLSpace::KinBodyInfoPtr pinfo = _fclspace.GetInfo(pbody);
+        BOOST_ASSERT( !!pinfo && pinfo->vlinks.size() == pbody->GetLinks().size() );
+        FOREACHC(itlink, pbody->GetLinks()) {
+            FCLSpace::LinkInfoPtr plinkinfo = pinfo->vlinks.at((*itlink)->GetIndex());
+            FCLSpace::LinkInfoPtr pviewlink;
+            if( (*itlink)->IsEnabled() && !!plinkinfo->linkBV.second ) {
+                pviewlink.reset(new FCLSpace::KinBodyInfo::LINK(*itlink));
+                pviewlink->bodylinkname = plinkinfo->bodylinkname;
+                pviewlink->linkBV = TransformCollisionPair(plinkinfo->linkBV.first, _CloneCollisionObject(plinkinfo->linkBV.second, pviewlink.get()));
+                pviewlink->vgeoms.reserve(plinkinfo->vgeoms.size());
+                FOREACHC(itgeom, plinkinfo->vgeoms) {
+                    pviewlink->vgeoms.push_back(TransformCollisionPair(itgeom->first, _CloneCollisionObject(itgeom->second, pviewlink.get())));
+                }
+                if( managedlinkmask & ((uint64_t)1 << (uint64_t)(*itlink)->GetIndex()) ) {
+                    _vmanagedobjs.push_back(pviewlink->linkBV.second.get());
+                }
+            }
+            _vlinks.push_back(pviewlink);
+        }
+        return offset;
+    }
+
+    /// \brief registers the managed objects inside the broadphase manager, called once all the bodies are added
+    void Setup()
+    {
+        _pmanager->clear();
+        if( _vmanagedobjs.size() > 0 ) {
+            _pmanager->registerObjects(_vmanagedobjs);
+        }
+        _pmanager->setup();
+    }
+
+    /// \brief places the view at new link transforms and refits the broadphase manager
+    ///
+    /// \param ptransforms holds GetNumLinks() transforms, one for every link in the order they were added
+    void SetLinkTransforms(const Transform* ptransforms)
+    {
+        for(size_t ilink = 0; ilink < _vlinks.size(); ++ilink) {
+            if( !_vlinks[ilink] ) {
+                continue;
+            }
+            const Transform& tlink = ptransforms[ilink];
+            _SetCollisionObjectTransform(*_vlinks[ilink]->linkBV.second, tlink * _vlinks[ilink]->linkBV.first);
+            FOREACHC(itgeom, _vlinks[ilink]->vgeoms) {
+                _SetCollisionObjectTransform(*itgeom->second, tlink * itgeom->first);
+            }
+        }
+        _pmanager->update();
+    }
+
+    inline size_t GetNumLinks() const {
+        return _vlinks.size();
+    }
+
+    /// \brief returns the view of a link, can be empty if the link is disabled or has no geometry
+    inline const FCLSpace::LinkInfoPtr& GetLinkInfo(size_t index) const {
+        return _vlinks.at(index);
+    }
+
+    inline BroadPhaseCollisionManagerPtr GetManager() const {
+        return _pmanager;
+    }
+
+private:
+    static CollisionObjectPtr _CloneCollisionObject(CollisionObjectPtr pcoll, FCLSpace::KinBodyInfo::LINK* plink)
+    {
+        CollisionObjectPtr pnewcoll = boost::make_shared<fcl::CollisionObject>(pcoll->collisionGeometry(), pcoll->getTransform());
+        pnewcoll->setUserData(plink);
+        return pnewcoll;
+    }
+
+    static void _SetCollisionObjectTransform(fcl::CollisionObject& coll, const Transform& pose)
+    {
+        coll.setTranslation(ConvertVectorToFCL(pose.trans));
+        coll.setQuatRotation(ConvertQuaternionToFCL(pose.rot));
+        // Do not forget to recompute the AABB otherwise getAABB won't give an up to date AABB
+        coll.computeAABB();
+    }
+
+    FCLSpace& _fclspace; ///< reference for speed, only used when adding bodies
+    BroadPhaseCollisionManagerPtr _pmanager; ///< manager owned by the view
+    std::vector<FCLSpace::LinkInfoPtr> _vlinks; ///< copies of the links, one per link of every added body
+    CollisionGroup _vmanagedobjs; ///< objects registered in _pmanager
+};
+
+typedef boost::shared_ptr<FCLThreadView> FCLThreadViewPtr;
+
+} // end namespace fclrave
+
+#endif
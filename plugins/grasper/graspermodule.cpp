@@ -14,6 +14,7 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "plugindefs.h"
+#include "parallelrangeworkers.h"
 
 #include <boost/thread/condition.hpp>
 #include <boost/thread/mutex.hpp>
@@ -63,18 +64,31 @@ class GrasperModule : public ModuleBase
     };
 
 public:
-    GrasperModule(EnvironmentBasePtr penv, std::istream& sinput)  : ModuleBase(penv), errfile(NULL) {
+    GrasperModule(EnvironmentBasePtr penv, std::istream& sinput)  : ModuleBase(penv), _bContinueWorker(false), _nNextGraspId(0), _nNumGraspResults(0), _nNumRunningWorkers(0), errfile(NULL) {
         __description = ":Interface Author: Rosen Diankov\n\nUsed to simulate a hand grasping an object by closing its fingers until collision with all links. ";
         RegisterCommand("Grasp",boost::bind(&GrasperModule::_GraspCommand,this,_1,_2),
                         "Performs a grasp and returns contact points");
         RegisterCommand("GraspThreaded",boost::bind(&GrasperModule::_GraspThreadedCommand,this,_1,_2),
-                        "Parllelizes the computation of the grasp planning and force closure. Number of threads can be specified with 'numthreads'.");
+                        "Parllelizes the computation of the grasp planning and force closure. Number of threads can be specified with 'numthreads'. Only the grasp indices in [startindex,endindex) are tested, which allows splitting the generation into chunks. If 'streamresults' is set, returns immediately and the results are polled with GetGraspThreadedResults.");
+        RegisterCommand("GetGraspThreadedResults",boost::bind(&GrasperModule::_GetGraspThreadedResultsCommand,this,_1,_2),
+                        "Returns the grasps found by a streaming GraspThreaded call since the last query, prefixed by whether all the workers finished and the next grasp index.");
         RegisterCommand("ComputeDistanceMap",boost::bind(&GrasperModule::_ComputeDistanceMapCommand,this,_1,_2),
-                        "Computes a distance map around a particular point in space");
+                        "Computes a distance map around a particular point in space. The rays are checked in parallel with 'numthreads'. The map of a target is cached for the same geometry, placement of the scene, and parameters unless 'usecache 0' is set.");
         RegisterCommand("GetStableContacts",boost::bind(&GrasperModule::_GetStableContactsCommand,this,_1,_2),
                         "Returns the stable contacts as defined by the closing direction");
         RegisterCommand("ConvexHull",boost::bind(&GrasperModule::_ConvexHullCommand,this,_1,_2),
                         "Given a point cloud, returns information about its convex hull like normal planes, vertex indices, and triangle indices. Computed planes point outside the mesh, face indices are not ordered, triangles point outside the mesh (counter-clockwise)");
+        RegisterCommand("ComputeJointSpheres",boost::bind(&GrasperModule::_ComputeJointSpheresCommand,this,_1,_2),
+                        "Computes the spheres swept by the links moved by every revolute joint of a robot in its current configuration, used by the linkstatistics database for the dof weights and resolutions. "
+                        "The links of the joints are bounded from their collision vertices in parallel.\n"
+                        "Usage::\n\n  ComputeJointSpheres robotname [numthreads]\n\n"
+                        "Returns one line per revolute joint with the joint index, sphere center, and sphere radius.");
+        RegisterCommand("GenerateCollisionGeometryGroup",boost::bind(&GrasperModule::_GenerateCollisionGeometryGroupCommand,this,_1,_2),
+                        "Stores a simplified copy of the geometries of bodies in a geometry group that collision checkers can switch to with SetGeometryGroup/SetBodyGeometryGroup. "
+                        "Every trimesh with at least 'minvertices' vertices is replaced by a convex hull that contains it: the vertices are snapped outwards to a grid of 'resolution' cells along the longest side of the mesh and pushed out by 'padding'. "
+                        "The hulls are cached by the hash of the mesh and the parameters unless 'usecache 0' is set.\n"
+                        "Usage::\n\n  GenerateCollisionGeometryGroup [name groupname] [body bodyname]* [resolution n] [padding p] [minvertices n] [usecache 0|1]\n\n"
+                        "If no body is specified, all the bodies in the environment are processed. Returns the number of trimeshes, the number of them that were simplified, and the number of hulls read from the cache.");
     }
     virtual ~GrasperModule() {
         if( !!errfile )
@@ -83,6 +97,11 @@ public:
 
     virtual void Destroy()
     {
+        _StopGraspThreads();
+        FOREACH(itenv, _listCloneEnvPool) {
+            (*itenv)->Destroy();
+        }
+        _listCloneEnvPool.clear();
         _planner.reset();
         _robot.reset();
     }
@@ -195,6 +214,9 @@ public:
                 // initialization
                 sinput >> params->btightgrasp;
             }
+            else if( cmd == "continuouscontact" ) {
+                sinput >> params->bcontinuouscontact;
+            }
             else if( cmd == "execute" ) {
                 // ignore
                 sinput >> bExecute;
@@ -391,6 +413,8 @@ public:
 
         dReal conewidth = 0.25f*PI;
         int nDistMapSamples = 60000;
+        int numthreads = 1;
+        bool busecache = true;
         string cmd;
         KinBodyPtr targetbody;
         Vector vmapcenter;
@@ -413,6 +437,12 @@ public:
             }
             else if( cmd == "center" )
                 sinput >> vmapcenter.x >> vmapcenter.y >> vmapcenter.z;
+            else if( cmd == "numthreads" ) {
+                sinput >> numthreads;
+            }
+            else if( cmd == "usecache" ) {
+                sinput >> busecache;
+            }
             else {
                 RAVELOG_WARN(str(boost::format("unrecognized command: %s\n")%cmd));
                 break;
@@ -429,12 +459,30 @@ public:
         _robot->Enable(false);
         targetbody->Enable(true);
 
-        vector<CollisionReport::CONTACT> vpoints;
-        BoxSample(targetbody,vpoints,nDistMapSamples,vmapcenter);
-        //DeterministicallySample(targetbody, vpoints, 4, vmapcenter);
+        std::string distancemapkey;
+        std::map<std::string, std::vector<CollisionReport::CONTACT> >::const_iterator itcached = _mapDistanceMaps.end();
+        if( busecache ) {
+            distancemapkey = _GetDistanceMapKey(targetbody, conewidth, nDistMapSamples, vmapcenter);
+            itcached = _mapDistanceMaps.find(distancemapkey);
+        }
 
-        targetbody->Enable(false);
-        _ComputeDistanceMap(vpoints, conewidth);
+        vector<CollisionReport::CONTACT> vpoints;
+        if( itcached != _mapDistanceMaps.end() ) {
+            vpoints = itcached->second;
+        }
+        else {
+            BoxSample(targetbody,vpoints,nDistMapSamples,vmapcenter);
+            //DeterministicallySample(targetbody, vpoints, 4, vmapcenter);
+
+            targetbody->Enable(false);
+            _ComputeDistanceMap(vpoints, conewidth, numthreads);
+            if( busecache ) {
+                if( _mapDistanceMaps.size() >= s_nMaxDistanceMaps ) {
+                    _mapDistanceMaps.erase(_mapDistanceMaps.begin());
+                }
+                _mapDistanceMaps[distancemapkey] = vpoints;
+            }
+        }
         FOREACH(itpoint, vpoints) {
             sout << itpoint->depth << " " << itpoint->norm.x << " " << itpoint->norm.y << " " << itpoint->norm.z << " ";
             sout << itpoint->pos.x - vmapcenter.x << " " << itpoint->pos.y - vmapcenter.y << " " << itpoint->pos.z - vmapcenter.z << "\n";
@@ -491,6 +539,124 @@ public:
         return true;
     }
 
+    /// \brief the bounds of the links rigidly attached to the child link of a joint, see _ComputeJointSpheresCommand
+    struct JointLinkBounds
+    {
+        JointLinkBounds() : fradius(0) {
+        }
+        KinBody::JointPtr pjoint;
+        std::vector<KinBody::LinkPtr> vlinks; ///< the links rigidly attached to the child link
+        Vector vcenter; ///< center of the bounding box of the link vertices
+        dReal fradius; ///< max distance from vcenter to the vertices plus the distance from the anchor to vcenter
+    };
+
+    /// \brief bounds the link vertices of the joints [start, end), called from the worker threads
+    void _ComputeJointLinkBoundsRange(std::vector<JointLinkBounds>& vbounds, size_t start, size_t end)
+    {
+        std::vector<Vector> vpoints;
+        for(size_t ijoint = start; ijoint < end; ++ijoint) {
+            JointLinkBounds& bounds = vbounds[ijoint];
+            vpoints.resize(0);
+            FOREACHC(itlink, bounds.vlinks) {
+                Transform tlink = (*itlink)->GetTransform();
+                const TriMesh& trimesh = (*itlink)->GetCollisionData();
+                if( trimesh.vertices.size() == 0 ) {
+                    vpoints.push_back(tlink.trans);
+                }
+                FOREACHC(itvertex, trimesh.vertices) {
+                    vpoints.push_back(tlink * *itvertex);
+                }
+            }
+            Vector vmin = vpoints.at(0), vmax = vpoints.at(0);
+            FOREACHC(itpoint, vpoints) {
+                for(int j = 0; j < 3; ++j) {
+                    vmin[j] = min(vmin[j], (*itpoint)[j]);
+                    vmax[j] = max(vmax[j], (*itpoint)[j]);
+                }
+            }
+            bounds.vcenter = 0.5*(vmin+vmax);
+            dReal fmaxdist2 = 0;
+            FOREACHC(itpoint, vpoints) {
+                fmaxdist2 = max(fmaxdist2, (*itpoint-bounds.vcenter).lengthsqr3());
+            }
+            bounds.fradius = RaveSqrt(fmaxdist2) + RaveSqrt((bounds.pjoint->GetAnchor()-bounds.vcenter).lengthsqr3());
+        }
+    }
+
+    virtual bool _ComputeJointSpheresCommand(std::ostream& sout, std::istream& sinput)
+    {
+        string robotname;
+        int numthreads = 1;
+        sinput >> robotname;
+        if( !sinput ) {
+            return false;
+        }
+        sinput >> numthreads;
+        numthreads = max(1, numthreads);
+
+        EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+        RobotBasePtr probot = GetEnv()->GetRobot(robotname);
+        if( !probot ) {
+            RAVELOG_WARN_FORMAT("env=%d, failed to find robot %s", GetEnv()->GetId()%robotname);
+            return false;
+        }
+
+        // children have to be processed before their parents
+        std::vector<JointLinkBounds> vbounds;
+        const std::vector<KinBody::JointPtr>& vjoints = probot->GetDependencyOrderedJoints();
+        for(std::vector<KinBody::JointPtr>::const_reverse_iterator itjoint = vjoints.rbegin(); itjoint != vjoints.rend(); ++itjoint) {
+            if( (*itjoint)->IsRevolute(0) && !!(*itjoint)->GetHierarchyChildLink() ) {
+                vbounds.push_back(JointLinkBounds());
+                vbounds.back().pjoint = *itjoint;
+                (*itjoint)->GetHierarchyChildLink()->GetRigidlyAttachedLinks(vbounds.back().vlinks);
+            }
+        }
+
+        uint64_t starttime = utils::GetMicroTime();
+        if( numthreads > 1 && vbounds.size() > 1 ) {
+            if( !_pJointSphereWorkers || _pJointSphereWorkers->GetNumThreads() != numthreads ) {
+                _pJointSphereWorkers.reset(new ParallelRangeWorkers(numthreads, "GrasperJointSpheres"));
+            }
+            _pJointSphereWorkers->Run(vbounds.size(), boost::bind(&GrasperModule::_ComputeJointLinkBoundsRange, this, boost::ref(vbounds), _1, _2));
+        }
+        else {
+            _ComputeJointLinkBoundsRange(vbounds, 0, vbounds.size());
+        }
+
+        // merge the spheres of the child joints
+        std::map<int, std::pair<Vector, dReal> > mapjointspheres;
+        FOREACHC(itbounds, vbounds) {
+            Vector vmin = itbounds->vcenter - Vector(itbounds->fradius, itbounds->fradius, itbounds->fradius);
+            Vector vmax = itbounds->vcenter + Vector(itbounds->fradius, itbounds->fradius, itbounds->fradius);
+            std::vector< std::pair<Vector, dReal> > vchildspheres;
+            FOREACHC(itjoint, probot->GetJoints()) {
+                if( find(itbounds->vlinks.begin(), itbounds->vlinks.end(), (*itjoint)->GetHierarchyParentLink()) != itbounds->vlinks.end() ) {
+                    std::map<int, std::pair<Vector, dReal> >::const_iterator itchild = mapjointspheres.find((*itjoint)->GetJointIndex());
+                    if( itchild != mapjointspheres.end() ) {
+                        vchildspheres.push_back(itchild->second);
+                        for(int j = 0; j < 3; ++j) {
+                            vmin[j] = min(vmin[j], itchild->second.first[j] - itbounds->fradius);
+                            vmax[j] = max(vmax[j], itchild->second.first[j] + itbounds->fradius);
+                        }
+                    }
+                }
+            }
+            Vector vcenter = 0.5*(vmin+vmax);
+            dReal fradius = RaveSqrt((vcenter-itbounds->vcenter).lengthsqr3()) + itbounds->fradius;
+            FOREACHC(itchild, vchildspheres) {
+                fradius = max(fradius, RaveSqrt((vcenter-itchild->first).lengthsqr3()) + itchild->second);
+            }
+            mapjointspheres[itbounds->pjoint->GetJointIndex()] = make_pair(vcenter, fradius);
+        }
+        RAVELOG_DEBUG_FORMAT("env=%d, computed %d joint spheres with %d threads in %fs", GetEnv()->GetId()%vbounds.size()%numthreads%(1e-6*(utils::GetMicroTime()-starttime)));
+
+        sout << std::setprecision(std::numeric_limits<dReal>::digits10+1);
+        FOREACHC(itsphere, mapjointspheres) {
+            sout << itsphere->first << " " << itsphere->second.first.x << " " << itsphere->second.first.y << " " << itsphere->second.first.z << " " << itsphere->second.second << endl;
+        }
+        return true;
+    }
+
     virtual bool _ConvexHullCommand(std::ostream& sout, std::istream& sinput)
     {
         string cmd;
@@ -556,69 +722,288 @@ public:
                 RAVELOG_WARN(str(boost::format("cannot triangulate convex hulls of dimension %d\n")%dim));
                 return false;
             }
-            size_t faceindex = 1;
-            int numtriangles = 0;
-            while(faceindex < vconvexfaces->size()) {
-                numtriangles += vconvexfaces->at(faceindex)-2;
-                faceindex += vconvexfaces->at(faceindex)+1;
-            }
-            sout << numtriangles << " ";
-            faceindex = 1;
-            size_t planeindex = 0;
-            vector<double> meanpoint(dim,0), point0(dim,0), point1(dim,0);
-            vector<pair<double,int> > angles;
-            while(faceindex < vconvexfaces->size()) {
-                // have to first sort the vertices of the face before triangulating them
-                // point* = point-mean
-                // atan2(plane^T * (point0* x point1*), point0*^T * point1*) = angle <- sort
-                int numpoints = vconvexfaces->at(faceindex);
+            vector<int> vindices;
+            _TriangulateConvexHull(vpoints, vconvexplanes, *vconvexfaces, vindices);
+            sout << vindices.size()/3 << " ";
+            FOREACH(it, vindices) {
+                sout << *it << " ";
+            }
+        }
+        return true;
+    }
+
+    /// \brief triangulates the faces returned by _ComputeConvexHull for 3D points, the triangles point outside the hull (counter-clockwise)
+    ///
+    /// \param vindices filled with 3 point indices per triangle
+    void _TriangulateConvexHull(const vector<double>& vpoints, const vector<double>& vconvexplanes, const vector<int>& vconvexfaces, vector<int>& vindices)
+    {
+        const int dim = 3;
+        vindices.resize(0);
+        size_t faceindex = 1;
+        size_t planeindex = 0;
+        vector<double> meanpoint(dim,0), point0(dim,0), point1(dim,0);
+        vector<pair<double,int> > angles;
+        while(faceindex < vconvexfaces.size()) {
+            // have to first sort the vertices of the face before triangulating them
+            // point* = point-mean
+            // atan2(plane^T * (point0* x point1*), point0*^T * point1*) = angle <- sort
+            int numpoints = vconvexfaces.at(faceindex);
+            for(int j = 0; j < dim; ++j) {
+                meanpoint[j] = 0;
+                point0[j] = 0;
+                point1[j] = 0;
+            }
+            for(int i = 0; i < numpoints; ++i) {
+                int pointindex = vconvexfaces.at(faceindex+i+1);
                 for(int j = 0; j < dim; ++j) {
-                    meanpoint[j] = 0;
-                    point0[j] = 0;
-                    point1[j] = 0;
-                }
-                for(int i = 0; i < numpoints; ++i) {
-                    int pointindex = vconvexfaces->at(faceindex+i+1);
-                    for(int j = 0; j < dim; ++j) {
-                        meanpoint[j] += vpoints[pointindex*dim+j];
-                    }
+                    meanpoint[j] += vpoints[pointindex*dim+j];
                 }
-                int pointindex0 = vconvexfaces->at(faceindex+1);
+            }
+            int pointindex0 = vconvexfaces.at(faceindex+1);
+            for(int j = 0; j < dim; ++j) {
+                meanpoint[j] /= numpoints;
+                point0[j] = vpoints[pointindex0*dim+j] - meanpoint[j];
+            }
+            angles.resize(numpoints); angles[0].first = 0; angles[0].second = 0;
+            for(int i = 1; i < numpoints; ++i) {
+                int pointindex = vconvexfaces.at(faceindex+i+1);
                 for(int j = 0; j < dim; ++j) {
-                    meanpoint[j] /= numpoints;
-                    point0[j] = vpoints[pointindex0*dim+j] - meanpoint[j];
+                    point1[j] = vpoints[pointindex*dim+j] - meanpoint[j];
+                }
+                dReal sinang = vconvexplanes[planeindex+0] * (point0[1]*point1[2] - point0[2]*point1[1]) + vconvexplanes[planeindex+1] * (point0[2]*point1[0] - point0[0]*point1[2]) + vconvexplanes[planeindex+2] * (point0[0]*point1[1] - point0[1]*point1[0]);
+                dReal cosang = point0[0]*point1[0] + point0[1]*point1[1] + point0[2]*point1[2];
+                angles[i].first = RaveAtan2(sinang,cosang);
+                if( angles[i].first < 0 ) {
+                    angles[i].first += 2*PI;
+                }
+                angles[i].second = i;
+            }
+            sort(angles.begin(),angles.end(),sort_pair_first<double,int>());
+            for(size_t i = 2; i < angles.size(); ++i) {
+                vindices.push_back(vconvexfaces.at(faceindex+1+angles[0].second));
+                vindices.push_back(vconvexfaces.at(faceindex+1+angles[i-1].second));
+                vindices.push_back(vconvexfaces.at(faceindex+1+angles[i].second));
+            }
+            faceindex += numpoints+1;
+            planeindex += dim+1;
+        }
+    }
+
+    virtual bool _GenerateCollisionGeometryGroupCommand(std::ostream& sout, std::istream& sinput)
+    {
+        string cmd, groupname = "simplified";
+        vector<string> vbodynames;
+        int resolution = 16, minvertices = 64;
+        dReal fpadding = 0;
+        bool busecache = true;
+        while(!sinput.eof()) {
+            sinput >> cmd;
+            if( !sinput ) {
+                break;
+            }
+            std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
+
+            if( cmd == "name" ) {
+                sinput >> groupname;
+            }
+            else if( cmd == "body" ) {
+                string bodyname;
+                sinput >> bodyname;
+                vbodynames.push_back(bodyname);
+            }
+            else if( cmd == "resolution" ) {
+                sinput >> resolution;
+            }
+            else if( cmd == "padding" ) {
+                sinput >> fpadding;
+            }
+            else if( cmd == "minvertices" ) {
+                sinput >> minvertices;
+            }
+            else if( cmd == "usecache" ) {
+                sinput >> busecache;
+            }
+            else {
+                RAVELOG_WARN(str(boost::format("unrecognized command: %s\n")%cmd));
+                break;
+            }
+
+            if( !sinput ) {
+                RAVELOG_ERROR(str(boost::format("failed processing command %s\n")%cmd));
+                return false;
+            }
+        }
+        resolution = max(resolution, 1);
+
+        EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+        vector<KinBodyPtr> vbodies;
+        if( vbodynames.size() > 0 ) {
+            FOREACHC(itname, vbodynames) {
+                KinBodyPtr pbody = GetEnv()->GetKinBody(*itname);
+                if( !pbody ) {
+                    RAVELOG_WARN_FORMAT("env=%d, failed to find body %s", GetEnv()->GetId()%*itname);
+                    return false;
                 }
-                angles.resize(numpoints); angles[0].first = 0; angles[0].second = 0;
-                for(int i = 1; i < numpoints; ++i) {
-                    int pointindex = vconvexfaces->at(faceindex+i+1);
-                    for(int j = 0; j < dim; ++j) {
-                        point1[j] = vpoints[pointindex*dim+j] - meanpoint[j];
+                vbodies.push_back(pbody);
+            }
+        }
+        else {
+            GetEnv()->GetBodies(vbodies);
+        }
+
+        int nummeshes = 0, numsimplified = 0, numcached = 0;
+        vector< vector<KinBody::GeometryInfoPtr> > vlinkgeometries;
+        FOREACHC(itbody, vbodies) {
+            const std::vector<KinBody::LinkPtr>& vlinks = (*itbody)->GetLinks();
+            vlinkgeometries.resize(vlinks.size());
+            for(size_t ilink = 0; ilink < vlinks.size(); ++ilink) {
+                const std::vector<KinBody::Link::GeometryPtr>& vgeometries = vlinks[ilink]->GetGeometries();
+                vlinkgeometries[ilink].resize(vgeometries.size());
+                for(size_t igeom = 0; igeom < vgeometries.size(); ++igeom) {
+                    KinBody::GeometryInfoPtr pinfo(new KinBody::GeometryInfo(vgeometries[igeom]->GetInfo()));
+                    vlinkgeometries[ilink][igeom] = pinfo;
+                    if( pinfo->_type != GT_TriMesh ) {
+                        continue;
                     }
-                    dReal sinang = vconvexplanes[planeindex+0] * (point0[1]*point1[2] - point0[2]*point1[1]) + vconvexplanes[planeindex+1] * (point0[2]*point1[0] - point0[0]*point1[2]) + vconvexplanes[planeindex+2] * (point0[0]*point1[1] - point0[1]*point1[0]);
-                    dReal cosang = point0[0]*point1[0] + point0[1]*point1[1] + point0[2]*point1[2];
-                    angles[i].first = RaveAtan2(sinang,cosang);
-                    if( angles[i].first < 0 ) {
-                        angles[i].first += 2*PI;
+                    ++nummeshes;
+                    if( (int)pinfo->_meshcollision.vertices.size() < minvertices ) {
+                        continue;
+                    }
+
+                    std::string hullkey = _GetCollisionHullKey(pinfo->_meshcollision, resolution, fpadding);
+                    std::map<std::string, TriMesh>::iterator ithull = busecache ? _mapCollisionHulls.find(hullkey) : _mapCollisionHulls.end();
+                    if( ithull != _mapCollisionHulls.end() ) {
+                        ++numcached;
+                    }
+                    else {
+                        TriMesh hullmesh;
+                        if( !_ComputeConservativeHull(pinfo->_meshcollision, resolution, fpadding, hullmesh) ) {
+                            RAVELOG_DEBUG_FORMAT("env=%d, could not simplify geometry %d of link %s:%s, keeping the original mesh", GetEnv()->GetId()%igeom%(*itbody)->GetName()%vlinks[ilink]->GetName());
+                        }
+                        if( !busecache ) {
+                            if( hullmesh.indices.size() > 0 ) {
+                                pinfo->_meshcollision.vertices.swap(hullmesh.vertices);
+                                pinfo->_meshcollision.indices.swap(hullmesh.indices);
+                                pinfo->_filenamecollision.clear();
+                                ++numsimplified;
+                            }
+                            continue;
+                        }
+                        // an empty mesh records that the original has to be kept
+                        ithull = _mapCollisionHulls.insert(make_pair(hullkey, hullmesh)).first;
+                    }
+                    if( ithull->second.indices.size() > 0 ) {
+                        pinfo->_meshcollision = ithull->second;
+                        pinfo->_filenamecollision.clear();
+                        ++numsimplified;
                     }
-                    angles[i].second = i;
-                }
-                sort(angles.begin(),angles.end(),sort_pair_first<double,int>());
-                for(size_t i = 2; i < angles.size(); ++i) {
-                    sout << vconvexfaces->at(faceindex+1+angles[0].second) << " " << vconvexfaces->at(faceindex+1+angles[i-1].second) << " " << vconvexfaces->at(faceindex+1+angles[i].second) << " ";
                 }
-                faceindex += numpoints+1;
-                planeindex += dim+1;
             }
+            (*itbody)->SetLinkGroupGeometries(groupname, vlinkgeometries);
         }
+        RAVELOG_DEBUG_FORMAT("env=%d, generated geometry group %s for %d bodies, trimeshes=%d, simplified=%d, cached=%d", GetEnv()->GetId()%groupname%vbodies.size()%nummeshes%numsimplified%numcached);
+        sout << nummeshes << " " << numsimplified << " " << numcached;
         return true;
     }
 
+    /// \brief returns the key of the hull of a mesh in _mapCollisionHulls, the hash of the mesh contents and the simplification parameters
+    std::string _GetCollisionHullKey(const TriMesh& trimesh, int resolution, dReal fpadding)
+    {
+        std::string s;
+        s.reserve(trimesh.vertices.size()*3*sizeof(dReal)+trimesh.indices.size()*sizeof(int32_t)+sizeof(int)+sizeof(dReal));
+        FOREACHC(itvertex, trimesh.vertices) {
+            s.append((const char*)&itvertex->x, sizeof(dReal));
+            s.append((const char*)&itvertex->y, sizeof(dReal));
+            s.append((const char*)&itvertex->z, sizeof(dReal));
+        }
+        if( trimesh.indices.size() > 0 ) {
+            s.append((const char*)&trimesh.indices[0], trimesh.indices.size()*sizeof(trimesh.indices[0]));
+        }
+        s.append((const char*)&resolution, sizeof(resolution));
+        s.append((const char*)&fpadding, sizeof(fpadding));
+        return utils::GetMD5HashString(s);
+    }
+
+    /// \brief computes a convex mesh that contains trimesh and every point within fpadding of it
+    ///
+    /// The vertices are snapped outwards to the corners of their cells in a grid of resolution cells along the longest side of the mesh, so the hull has few triangles.
+    /// Every corner is pushed out by fpadding along all the axes. Flat meshes become one cell thick.
+    /// \return false if the hull could not be computed
+    bool _ComputeConservativeHull(const TriMesh& trimesh, int resolution, dReal fpadding, TriMesh& hullmesh)
+    {
+        hullmesh.vertices.resize(0);
+        hullmesh.indices.resize(0);
+        if( trimesh.vertices.size() == 0 ) {
+            return false;
+        }
+        Vector vmin = trimesh.vertices[0], vmax = trimesh.vertices[0];
+        FOREACHC(itvertex, trimesh.vertices) {
+            vmin.x = min(vmin.x, itvertex->x); vmin.y = min(vmin.y, itvertex->y); vmin.z = min(vmin.z, itvertex->z);
+            vmax.x = max(vmax.x, itvertex->x); vmax.y = max(vmax.y, itvertex->y); vmax.z = max(vmax.z, itvertex->z);
+        }
+        dReal fcellsize = max(vmax.x-vmin.x, max(vmax.y-vmin.y, vmax.z-vmin.z))/resolution;
+        if( fcellsize <= 0 ) {
+            return false;
+        }
+
+        // the corners of the cells holding a vertex, cells are indexed in [0,resolution] along every axis
+        const int64_t numcorners = resolution+2;
+        std::set<int64_t> setcorners;
+        FOREACHC(itvertex, trimesh.vertices) {
+            int64_t ix = max(0, min(resolution, (int)((itvertex->x-vmin.x)/fcellsize)));
+            int64_t iy = max(0, min(resolution, (int)((itvertex->y-vmin.y)/fcellsize)));
+            int64_t iz = max(0, min(resolution, (int)((itvertex->z-vmin.z)/fcellsize)));
+            for(int icorner = 0; icorner < 8; ++icorner) {
+                setcorners.insert(((ix+(icorner&1))*numcorners + iy+((icorner>>1)&1))*numcorners + iz+((icorner>>2)&1));
+            }
+        }
+
+        vector<double> vpoints;
+        vpoints.reserve(setcorners.size()*3*(fpadding > 0 ? 8 : 1));
+        FOREACHC(itcorner, setcorners) {
+            Vector vcorner = vmin + fcellsize*Vector((dReal)(*itcorner/(numcorners*numcorners)), (dReal)((*itcorner/numcorners)%numcorners), (dReal)(*itcorner%numcorners));
+            if( fpadding > 0 ) {
+                for(int ioffset = 0; ioffset < 8; ++ioffset) {
+                    vpoints.push_back(vcorner.x + ((ioffset&1) ? fpadding : -fpadding));
+                    vpoints.push_back(vcorner.y + (((ioffset>>1)&1) ? fpadding : -fpadding));
+                    vpoints.push_back(vcorner.z + (((ioffset>>2)&1) ? fpadding : -fpadding));
+                }
+            }
+            else {
+                vpoints.push_back(vcorner.x);
+                vpoints.push_back(vcorner.y);
+                vpoints.push_back(vcorner.z);
+            }
+        }
+
+        vector<double> vconvexplanes;
+        boost::shared_ptr< vector<int> > vconvexfaces(new vector<int>());
+        if( _ComputeConvexHull(vpoints, vconvexplanes, vconvexfaces, 3) == 0 ) {
+            return false;
+        }
+        vector<int> vindices;
+        _TriangulateConvexHull(vpoints, vconvexplanes, *vconvexfaces, vindices);
+
+        // only keep the points on the hull
+        vector<int> vpointindices(vpoints.size()/3, -1);
+        hullmesh.indices.reserve(vindices.size());
+        FOREACHC(itindex, vindices) {
+            if( vpointindices.at(*itindex) < 0 ) {
+                vpointindices[*itindex] = (int)hullmesh.vertices.size();
+                hullmesh.vertices.push_back(Vector(vpoints[3*(*itindex)], vpoints[3*(*itindex)+1], vpoints[3*(*itindex)+2]));
+            }
+            hullmesh.indices.push_back(vpointindices[*itindex]);
+        }
+        return hullmesh.indices.size() > 0;
+    }
+
     // initialization parameters
     struct WorkerParameters
     {
         WorkerParameters() {
             bonlycontacttarget = true;
             btightgrasp = false;
+            bcontinuouscontact = false;
             fgraspingnoise = 0;
             bComputeForceClosure = false;
             friction = 0.4;
@@ -627,12 +1012,14 @@ public:
             forceclosurethreshold = 0;
             ffinestep = 0.001f;
             bCheckGraspIK = false;
+            collisionoptions = 0;
         }
 
         string targetname;
         vector<string> vavoidlinkgeometry;
         bool bonlycontacttarget;
         bool btightgrasp;
+        bool bcontinuouscontact;
         int nGraspingNoiseRetries;
         dReal fgraspingnoise;
         bool bComputeForceClosure;
@@ -648,6 +1035,7 @@ public:
         Vector affineaxis;
 
         bool bCheckGraspIK;
+        int collisionoptions; ///< collision options of the workers without CO_Contacts
     };
 
     struct GraspParametersThread
@@ -670,20 +1058,60 @@ public:
     typedef boost::shared_ptr<GraspParametersThread> GraspParametersThreadPtr;
     typedef boost::shared_ptr<WorkerParameters> WorkerParametersPtr;
 
-    virtual bool _GraspThreadedCommand(std::ostream& sout, std::istream& sinput)
+    /// \brief the grasps of one GraspThreaded call, grasp ids enumerate all the combinations of the parameters
+    struct GraspTaskSet
     {
-        EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+        GraspTaskSet() : numgrasps(0), maxgrasps(0), endindex(0) {
+        }
+
+        GraspParametersThreadPtr CreateGrasp(size_t id) const
+        {
+            size_t istandoff = id % standoffs.size();
+            size_t ipreshape = (id / standoffs.size()) % preshapes.size();
+            size_t iroll = (id / (preshapes.size() * standoffs.size())) % rolls.size();
+            size_t iapproachray = (id / (rolls.size() * preshapes.size() * standoffs.size()))%approachrays.size();
+            size_t imanipulatordirection = (id / (rolls.size() * preshapes.size() * standoffs.size()*approachrays.size()));
+
+            GraspParametersThreadPtr grasp_params(new GraspParametersThread());
+            grasp_params->id = id;
+            grasp_params->vtargetposition = approachrays.at(iapproachray).first;
+            grasp_params->vtargetdirection = approachrays.at(iapproachray).second;
+            grasp_params->vmanipulatordirection = manipulatordirections.at(imanipulatordirection);
+            grasp_params->ftargetroll = rolls.at(iroll);
+            grasp_params->fstandoff = standoffs.at(istandoff);
+            grasp_params->preshape = preshapes.at(ipreshape);
+            return grasp_params;
+        }
 
-        WorkerParametersPtr worker_params(new WorkerParameters());
-        int numthreads = 2;
-        string cmd;
         vector< pair<Vector, Vector> > approachrays;
         vector<dReal> rolls;
         vector< vector<dReal> > preshapes;
         vector<Vector> manipulatordirections;
         vector<dReal> standoffs;
-        size_t startindex = 0;
+        size_t numgrasps, maxgrasps;
+        size_t endindex; ///< grasps with id >= endindex are not tested
+    };
+    typedef boost::shared_ptr<GraspTaskSet> GraspTaskSetPtr;
+
+    virtual bool _GraspThreadedCommand(std::ostream& sout, std::istream& sinput)
+    {
+        EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+
+        // a previous streaming call might still be running
+        _StopGraspThreads();
+
+        WorkerParametersPtr worker_params(new WorkerParameters());
+        GraspTaskSetPtr tasks(new GraspTaskSet());
+        int numthreads = 2;
+        string cmd;
+        vector< pair<Vector, Vector> >& approachrays = tasks->approachrays;
+        vector<dReal>& rolls = tasks->rolls;
+        vector< vector<dReal> >& preshapes = tasks->preshapes;
+        vector<Vector>& manipulatordirections = tasks->manipulatordirections;
+        vector<dReal>& standoffs = tasks->standoffs;
+        size_t startindex = 0, endindex = 0;
         size_t maxgrasps = 0;
+        bool bStreamResults = false;
 
         while(!sinput.eof()) {
             sinput >> cmd;
@@ -703,6 +1131,9 @@ public:
             else if( cmd == "startindex" ) {
                 sinput >> startindex;
             }
+            else if( cmd == "endindex" ) {
+                sinput >> endindex;
+            }
             else if( cmd == "maxgrasps" ) {
                 sinput >> maxgrasps;
             }
@@ -712,6 +1143,9 @@ public:
             else if( cmd == "tightgrasp" ) {
                 sinput >> worker_params->btightgrasp;
             }
+            else if( cmd == "continuouscontact" ) {
+                sinput >> worker_params->bcontinuouscontact;
+            }
             else if( cmd == "graspingnoise" ) {
                 sinput >> worker_params->fgraspingnoise >> worker_params->nGraspingNoiseRetries;
             }
@@ -733,6 +1167,9 @@ public:
             else if( cmd == "numthreads" ) {
                 sinput >> numthreads;
             }
+            else if( cmd == "streamresults" ) {
+                sinput >> bStreamResults;
+            }
             // grasp specific
             else if( cmd == "approachrays" ) {
                 int numapproachrays = 0;
@@ -796,86 +1233,142 @@ public:
         worker_params->vactiveindices = _robot->GetActiveDOFIndices();
         worker_params->affinedofs = _robot->GetAffineDOF();
         worker_params->affineaxis = _robot->GetAffineRotationAxis();
-
-        EnvironmentBasePtr pcloneenv = GetEnv()->CloneSelf(Clone_Bodies|Clone_Simulation);
-
-        _bContinueWorker = true;
-        // start worker threads
-        vector<boost::shared_ptr<boost::thread> > listthreads(numthreads);
-        FOREACH(itthread,listthreads) {
-            itthread->reset(new boost::thread(boost::bind(&GrasperModule::_WorkerThread,this,worker_params,pcloneenv)));
+        // use CO_ActiveDOFs since might be calling FindIKSolution
+        worker_params->collisionoptions = GetEnv()->GetCollisionChecker()->GetCollisionOptions()|(worker_params->bCheckGraspIK ? CO_ActiveDOFs : 0);
+        worker_params->collisionoptions &= ~CO_Contacts;
+
+        tasks->numgrasps = approachrays.size()*rolls.size()*preshapes.size()*standoffs.size()*manipulatordirections.size();
+        tasks->maxgrasps = maxgrasps > 0 ? maxgrasps : tasks->numgrasps;
+        tasks->endindex = endindex > 0 ? min(endindex, tasks->numgrasps) : tasks->numgrasps;
+        RAVELOG_INFO(str(boost::format("number of grasps to test: %d\n")%tasks->numgrasps));
+
+        // reuse the environment clones of the previous calls, cloning only updates what changed
+        numthreads = max(1, numthreads);
+        vector<EnvironmentBasePtr> vcloneenvs(numthreads);
+        {
+            boost::mutex::scoped_lock lockgrasp(_mutexGrasp);
+            for(int i = 0; i < numthreads && _listCloneEnvPool.size() > 0; ++i) {
+                vcloneenvs[i] = _listCloneEnvPool.front();
+                _listCloneEnvPool.pop_front();
+            }
         }
-
-        _listGraspResults.clear();
-        size_t numgrasps = approachrays.size()*rolls.size()*preshapes.size()*standoffs.size()*manipulatordirections.size();
-        if( maxgrasps == 0 ) {
-            maxgrasps = numgrasps;
+        FOREACH(itenv, vcloneenvs) {
+            if( !!*itenv ) {
+                (*itenv)->Clone(GetEnv(), Clone_Bodies|Clone_Simulation);
+            }
+            else {
+                *itenv = GetEnv()->CloneSelf(Clone_Bodies|Clone_Simulation);
+            }
         }
-        RAVELOG_INFO(str(boost::format("number of grasps to test: %d\n")%numgrasps));
-        size_t id = startindex;
-        for(id=startindex; id < numgrasps; ++id) {
-            size_t istandoff = id % standoffs.size();
-            size_t ipreshape = (id / standoffs.size()) % preshapes.size();
-            size_t iroll = (id / (preshapes.size() * standoffs.size())) % rolls.size();
-            size_t iapproachray = (id / (rolls.size() * preshapes.size() * standoffs.size()))%approachrays.size();
-            size_t imanipulatordirection = (id / (rolls.size() * preshapes.size() * standoffs.size()*approachrays.size()));
 
-            boost::mutex::scoped_lock lock(_mutexGrasp);
-            if( _listGraspResults.size() >= maxgrasps ) {
-                break;
-            }
+        {
+            boost::mutex::scoped_lock lockgrasp(_mutexGrasp);
+            _listGraspResults.clear();
+            _graspTasks = tasks;
+            _nNextGraspId = startindex;
+            _nNumGraspResults = 0;
+            _nNumRunningWorkers = numthreads;
+            _bContinueWorker = true;
+        }
+        for(int i = 0; i < numthreads; ++i) {
+            _listGraspThreads.push_back(boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&GrasperModule::_WorkerThread,this,worker_params,vcloneenvs[i]))));
+        }
 
-            // initialize _graspParamsWork
-            BOOST_ASSERT(!_graspParamsWork);
-            _graspParamsWork.reset(new GraspParametersThread());
-            _graspParamsWork->id = id;
-            _graspParamsWork->vtargetposition = approachrays.at(iapproachray).first;
-            _graspParamsWork->vtargetdirection = approachrays.at(iapproachray).second;
-            _graspParamsWork->vmanipulatordirection = manipulatordirections.at(imanipulatordirection);
-            _graspParamsWork->ftargetroll = rolls.at(iroll);
-            _graspParamsWork->fstandoff = standoffs.at(istandoff);
-            _graspParamsWork->preshape = preshapes.at(ipreshape);
-            _condGraspHasWork.notify_one();     // notify there is work
-            _condGraspReceivedWork.wait(lock);     // wait for more work
+        if( bStreamResults ) {
+            sout << tasks->numgrasps;
+            return true;
         }
 
         // wait for workers
-        _bContinueWorker = false;
-        FOREACH(itthread,listthreads) {
-            _condGraspHasWork.notify_all();     // signal
+        FOREACH(itthread,_listGraspThreads) {
             (*itthread)->join();
         }
-        listthreads.clear();
+        _listGraspThreads.clear();
 
         // parse results to output
-        sout << id << " " << _listGraspResults.size() << " ";
+        boost::mutex::scoped_lock lockgrasp(_mutexGrasp);
+        sout << _nNextGraspId << " " << _listGraspResults.size() << " ";
         FOREACH(itresult, _listGraspResults) {
-            sout << (*itresult)->vtargetposition.x << " " << (*itresult)->vtargetposition.y << " " << (*itresult)->vtargetposition.z << " ";
-            sout << (*itresult)->vtargetdirection.x << " " << (*itresult)->vtargetdirection.y << " " << (*itresult)->vtargetdirection.z << " ";
-            sout << (*itresult)->ftargetroll << " " << (*itresult)->fstandoff << " ";
-            sout << (*itresult)->vmanipulatordirection.x << " " << (*itresult)->vmanipulatordirection.y << " " << (*itresult)->vmanipulatordirection.z << " ";
-            sout << (*itresult)->mindist << " " << (*itresult)->volume << " ";
-            FOREACH(itangle, (*itresult)->preshape) {
-                sout << (*itangle) << " ";
-            }
-            sout << (*itresult)->transfinal.rot.x << " " << (*itresult)->transfinal.rot.y << " " << (*itresult)->transfinal.rot.z << " " << (*itresult)->transfinal.rot.w << " " << (*itresult)->transfinal.trans.x << " " << (*itresult)->transfinal.trans.y << " " << (*itresult)->transfinal.trans.z << " ";
-            FOREACH(itangle, (*itresult)->finalshape) {
-                sout << *itangle << " ";
-            }
-            sout << (*itresult)->contacts.size() << " ";
-            FOREACH(itc, (*itresult)->contacts) {
-                const CollisionReport::CONTACT& c = itc->first;
-                sout << c.pos.x << " " << c.pos.y << " " << c.pos.z << " " << c.norm.x << " " << c.norm.y << " " << c.norm.z << " ";
-            }
+            _WriteGraspResult(sout, **itresult);
         }
+        _listGraspResults.clear();
         return true;
     }
 
-    void _WorkerThread(const WorkerParametersPtr worker_params, EnvironmentBasePtr penv)
+    virtual bool _GetGraspThreadedResultsCommand(std::ostream& sout, std::istream& sinput)
+    {
+        list<GraspParametersThreadPtr> listresults;
+        bool bFinished = false;
+        size_t nextid = 0;
+        {
+            boost::mutex::scoped_lock lock(_mutexGrasp);
+            listresults.swap(_listGraspResults);
+            bFinished = _nNumRunningWorkers == 0;
+            nextid = _nNextGraspId;
+        }
+        if( bFinished ) {
+            _StopGraspThreads();
+        }
+        sout << bFinished << " " << nextid << " " << listresults.size() << " ";
+        FOREACH(itresult, listresults) {
+            _WriteGraspResult(sout, **itresult);
+        }
+        return true;
+    }
+
+    void _WriteGraspResult(std::ostream& sout, const GraspParametersThread& result)
+    {
+        sout << result.vtargetposition.x << " " << result.vtargetposition.y << " " << result.vtargetposition.z << " ";
+        sout << result.vtargetdirection.x << " " << result.vtargetdirection.y << " " << result.vtargetdirection.z << " ";
+        sout << result.ftargetroll << " " << result.fstandoff << " ";
+        sout << result.vmanipulatordirection.x << " " << result.vmanipulatordirection.y << " " << result.vmanipulatordirection.z << " ";
+        sout << result.mindist << " " << result.volume << " ";
+        FOREACHC(itangle, result.preshape) {
+            sout << (*itangle) << " ";
+        }
+        sout << result.transfinal.rot.x << " " << result.transfinal.rot.y << " " << result.transfinal.rot.z << " " << result.transfinal.rot.w << " " << result.transfinal.trans.x << " " << result.transfinal.trans.y << " " << result.transfinal.trans.z << " ";
+        FOREACHC(itangle, result.finalshape) {
+            sout << *itangle << " ";
+        }
+        sout << result.contacts.size() << " ";
+        FOREACHC(itc, result.contacts) {
+            const CollisionReport::CONTACT& c = itc->first;
+            sout << c.pos.x << " " << c.pos.y << " " << c.pos.z << " " << c.norm.x << " " << c.norm.y << " " << c.norm.z << " ";
+        }
+    }
+
+    /// \brief stops the workers of a streaming call and waits for them
+    void _StopGraspThreads()
     {
-        // clone environment
-        EnvironmentBasePtr pcloneenv = penv->CloneSelf(Clone_Bodies|Clone_Simulation);
         {
+            boost::mutex::scoped_lock lock(_mutexGrasp);
+            _bContinueWorker = false;
+        }
+        FOREACH(itthread,_listGraspThreads) {
+            (*itthread)->join();
+        }
+        _listGraspThreads.clear();
+    }
+
+    /// \brief claims the next grasp to evaluate. Workers claim one grasp at a time, so a long grasp never holds up work that other threads could do.
+    GraspParametersThreadPtr _ClaimNextGrasp()
+    {
+        size_t id;
+        GraspTaskSetPtr tasks;
+        {
+            boost::mutex::scoped_lock lock(_mutexGrasp);
+            if( !_bContinueWorker || !_graspTasks || _nNextGraspId >= _graspTasks->endindex || _nNumGraspResults >= _graspTasks->maxgrasps ) {
+                return GraspParametersThreadPtr();
+            }
+            id = _nNextGraspId++;
+            tasks = _graspTasks;
+        }
+        return tasks->CreateGrasp(id);
+    }
+
+    void _WorkerThread(const WorkerParametersPtr worker_params, EnvironmentBasePtr pcloneenv)
+    {
+        try {
             EnvironmentMutex::scoped_lock lock(pcloneenv->GetMutex());
             boost::shared_ptr<CollisionCheckerMngr> pcheckermngr(new CollisionCheckerMngr(pcloneenv, worker_params->collisionchecker));
             PlannerBasePtr planner = RaveCreatePlanner(pcloneenv,"Grasper");
@@ -891,6 +1384,7 @@ public:
             params->btransformrobot = true;
             params->bonlycontacttarget = worker_params->bonlycontacttarget;
             params->btightgrasp = worker_params->btightgrasp;
+            params->bcontinuouscontact = worker_params->bcontinuouscontact;
             params->fgraspingnoise = 0;
             params->ftranslationstepmult = worker_params->ftranslationstepmult;
 
@@ -906,26 +1400,10 @@ public:
 
             vector<dReal> vtrajpoint;
 
-            // use CO_ActiveDOFs since might be calling FindIKSolution
-            int coloptions = GetEnv()->GetCollisionChecker()->GetCollisionOptions()|(worker_params->bCheckGraspIK ? CO_ActiveDOFs : 0);
-            coloptions &= ~CO_Contacts;
+            int coloptions = worker_params->collisionoptions;
             pcloneenv->GetCollisionChecker()->SetCollisionOptions(coloptions|CO_Contacts);
 
-            while(_bContinueWorker) {
-                {
-                    // wait for work
-                    boost::mutex::scoped_lock lock(_mutexGrasp);
-                    if( !_graspParamsWork ) {
-                        _condGraspHasWork.wait(lock);
-                        // after signal
-                        if( !_graspParamsWork ) {
-                            continue;
-                        }
-                    }
-                    grasp_params = _graspParamsWork;
-                    _graspParamsWork.reset();
-                    _condGraspReceivedWork.notify_all();
-                }
+            while(!!(grasp_params = _ClaimNextGrasp())) {
 
                 RAVELOG_DEBUG(str(boost::format("grasp %d: start")%grasp_params->id));
 
@@ -1126,16 +1604,28 @@ public:
 
                 boost::mutex::scoped_lock lock(_mutexGrasp);
                 _listGraspResults.push_back(grasp_params);
+                _nNumGraspResults++;
             }
         }
-        pcloneenv->Destroy();
+        catch(const std::exception& ex) {
+            RAVELOG_ERROR(str(boost::format("grasp worker failed: %s")%ex.what()));
+        }
+
+        // keep the clone for the next call
+        boost::mutex::scoped_lock lock(_mutexGrasp);
+        _listCloneEnvPool.push_back(pcloneenv);
+        _nNumRunningWorkers--;
     }
 
     bool _bContinueWorker;
     boost::mutex _mutexGrasp;
-    GraspParametersThreadPtr _graspParamsWork;
-    list<GraspParametersThreadPtr> _listGraspResults;
-    boost::condition _condGraspHasWork, _condGraspReceivedWork;
+    GraspTaskSetPtr _graspTasks;
+    size_t _nNextGraspId; ///< next grasp to be claimed by a worker
+    size_t _nNumGraspResults; ///< number of grasps found by the current call
+    int _nNumRunningWorkers;
+    list<GraspParametersThreadPtr> _listGraspResults; ///< grasps not yet returned to the caller
+    list<boost::shared_ptr<boost::thread> > _listGraspThreads;
+    list<EnvironmentBasePtr> _listCloneEnvPool; ///< environment clones reused across GraspThreaded calls
 
 protected:
     void _ComputeJointMaxLengths(vector<dReal>& vjointlengths)
@@ -1390,10 +1880,56 @@ protected:
         GetEnv()->GetCollisionChecker()->SetCollisionOptions(0);
     }
 
+    /// \brief returns the key of the distance map of the target in _mapDistanceMaps
+    ///
+    /// The rays hit all the enabled bodies, so the key holds the geometry and the placement of every one of them along with the map parameters.
+    std::string _GetDistanceMapKey(KinBodyConstPtr ptarget, dReal conewidth, int nDistMapSamples, const Vector& vmapcenter)
+    {
+        std::stringstream ss;
+        ss << std::setprecision(std::numeric_limits<dReal>::digits10+1);
+        ss << ptarget->GetKinematicsGeometryHash() << " " << conewidth << " " << nDistMapSamples << " " << vmapcenter << " ";
+        std::vector<KinBodyPtr> vbodies;
+        GetEnv()->GetBodies(vbodies);
+        FOREACHC(itbody, vbodies) {
+            if( (*itbody)->IsEnabled() ) {
+                ss << (*itbody)->GetName() << " " << (*itbody)->GetKinematicsGeometryHash() << " " << (*itbody)->GetTransform() << " ";
+                std::vector<dReal> vdofvalues;
+                (*itbody)->GetDOFValues(vdofvalues);
+                FOREACHC(itvalue, vdofvalues) {
+                    ss << *itvalue << " ";
+                }
+            }
+        }
+        return utils::GetMD5HashString(ss.str());
+    }
+
+    /// \brief environment copy checking a part of the rays of _ComputeDistanceMap
+    struct DistanceMapSnapshot
+    {
+        EnvironmentBasePtr penv;
+        CollisionCheckerBasePtr pchecker;
+    };
+
+    /// \brief checks the rays of the snapshots [startsnapshot, endsnapshot), called from the worker threads
+    void _CheckDistanceMapRaysRange(const std::vector<DistanceMapSnapshot>& vsnapshots, const std::vector<RAY>& vrays, std::vector<dReal>& vdistances, size_t startsnapshot, size_t endsnapshot)
+    {
+        std::vector<RAY> vsnapshotrays;
+        std::vector<dReal> vsnapshotdistances;
+        std::vector<KinBody::LinkConstPtr> vhitlinks;
+        for(size_t isnapshot = startsnapshot; isnapshot < endsnapshot; ++isnapshot) {
+            size_t start = (vrays.size()*isnapshot)/vsnapshots.size(), end = (vrays.size()*(isnapshot+1))/vsnapshots.size();
+            EnvironmentMutex::scoped_lock lock(vsnapshots[isnapshot].penv->GetMutex());
+            vsnapshotrays.assign(vrays.begin()+start, vrays.begin()+end);
+            vsnapshots[isnapshot].pchecker->CheckCollisionRays(vsnapshotrays, vsnapshotdistances, vhitlinks);
+            std::copy(vsnapshotdistances.begin(), vsnapshotdistances.end(), vdistances.begin()+start);
+        }
+    }
+
     // computes a distance map. For every point, samples many vectors around the point's normal such that angle
     // between normal and sampled vector doesn't exceeed fTheta. Returns the minimum distance.
     // vpoints needs to already be initialized
-    void _ComputeDistanceMap(vector<CollisionReport::CONTACT>& vpoints, dReal fTheta)
+    // the rays are checked in batches, split between numthreads copies of the environment if numthreads > 1
+    void _ComputeDistanceMap(vector<CollisionReport::CONTACT>& vpoints, dReal fTheta, int numthreads=1)
     {
         dReal fCosTheta = RaveCos(fTheta);
         int N;
@@ -1411,6 +1947,9 @@ protected:
         else {
             N = (int)ceil(fTheta * (64.0f/(PI/12.0f)));     // sample 64 points when at pi/12
         }
+        // sample all the rays first, so the random sequence does not depend on the number of threads
+        std::vector<RAY> vrays;
+        vrays.reserve(vpoints.size()*N);
         for(int i = 0; i < (int)vpoints.size(); ++i) {
             Vector vright = Vector(1,0,0);
             if( RaveFabs(vpoints[i].norm.x) > 0.9 ) {
@@ -1420,7 +1959,6 @@ protected:
             vright.normalize3();
             Vector vup = vpoints[i].norm.cross(vright);
 
-            dReal fMinDist = 2;
             for(int j = 0; j < N; ++j) {
                 // sample around a cone
                 dReal fAng = fCosTheta + (1-fCosTheta)*RaveRandomFloat();
@@ -1429,13 +1967,55 @@ protected:
                 r.dir = 1000.0f*(fAng * vpoints[i].norm + R * RaveCos(U2) * vright + R * RaveSin(U2) * vup);
 
                 r.pos = vpoints[i].pos;
+                vrays.push_back(r);
+            }
+        }
 
-                if( GetEnv()->CheckCollision(r, _report) ) {
-                    if( _report->minDistance < fMinDist )
-                        fMinDist = _report->minDistance;
+        std::vector<dReal> vdistances(vrays.size());
+        numthreads = max(1, min(numthreads, (int)vpoints.size()));
+        std::vector<DistanceMapSnapshot> vsnapshots;
+        if( numthreads > 1 ) {
+            // every thread casts its rays in its own copy of the environment
+            vsnapshots.resize(numthreads);
+            for(int ithread = 0; ithread < numthreads; ++ithread) {
+                vsnapshots[ithread].penv = GetEnv()->CloneSelf(Clone_Bodies);
+                EnvironmentMutex::scoped_lock locksnapshot(vsnapshots[ithread].penv->GetMutex());
+                vsnapshots[ithread].pchecker = RaveCreateCollisionChecker(vsnapshots[ithread].penv, GetEnv()->GetCollisionChecker()->GetXMLId());
+                if( !vsnapshots[ithread].pchecker ) {
+                    RAVELOG_WARN_FORMAT("env=%d, failed to create collision checker %s, checking the distance map rays in one thread", GetEnv()->GetId()%GetEnv()->GetCollisionChecker()->GetXMLId());
+                    FOREACH(itsnapshot, vsnapshots) {
+                        if( !!itsnapshot->penv ) {
+                            itsnapshot->penv->Destroy();
+                        }
+                    }
+                    vsnapshots.clear();
+                    break;
                 }
+                vsnapshots[ithread].penv->SetCollisionChecker(vsnapshots[ithread].pchecker);
+                vsnapshots[ithread].pchecker->SetCollisionOptions(CO_Distance);
+            }
+        }
+        if( vsnapshots.size() > 0 ) {
+            ParallelRangeWorkers workers(vsnapshots.size(), "GrasperDistanceMap");
+            // one job per snapshot, each job checks a contiguous part of the rays
+            workers.Run(vsnapshots.size(), boost::bind(&GrasperModule::_CheckDistanceMapRaysRange, this, boost::cref(vsnapshots), boost::cref(vrays), boost::ref(vdistances), _1, _2));
+            FOREACH(itsnapshot, vsnapshots) {
+                itsnapshot->penv->Destroy();
             }
+        }
+        else {
+            std::vector<KinBody::LinkConstPtr> vhitlinks;
+            GetEnv()->GetCollisionChecker()->CheckCollisionRays(vrays, vdistances, vhitlinks);
+        }
 
+        for(int i = 0; i < (int)vpoints.size(); ++i) {
+            dReal fMinDist = 2;
+            for(int j = 0; j < N; ++j) {
+                dReal fdist = vdistances[i*N+j];
+                if( fdist >= 0 && fdist < fMinDist ) {
+                    fMinDist = fdist;
+                }
+            }
             vpoints[i].depth = fMinDist;
         }
 
@@ -1700,6 +2280,10 @@ protected:
     boost::mutex _mutex;
     FILE *errfile;
     std::vector<dReal> _vjointmaxlengths;
+    ParallelRangeWorkersPtr _pJointSphereWorkers; ///< bounds the joint links in _ComputeJointSpheresCommand
+    std::map<std::string, std::vector<CollisionReport::CONTACT> > _mapDistanceMaps; ///< the results of _ComputeDistanceMapCommand indexed by _GetDistanceMapKey
+    std::map<std::string, TriMesh> _mapCollisionHulls; ///< the results of _ComputeConservativeHull indexed by _GetCollisionHullKey, empty if the original mesh is kept
+    static const size_t s_nMaxDistanceMaps = 8; ///< maximum number of maps in _mapDistanceMaps
 };
 
 ModuleBasePtr CreateGrasperModule(EnvironmentBasePtr penv, std::istream& sinput)
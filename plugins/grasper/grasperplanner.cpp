@@ -441,6 +441,18 @@ public:
                 continue;
             }
 
+            if( _parameters->bcontinuouscontact ) {
+                int ret = _CloseFingerToContact(ifing, pjoint, vchuckingdir[ifing], vlowerlim[ifing], vupperlim[ifing], fmult, dofvals, ptraj);
+                if( ret < 0 ) {
+                    RAVELOG_VERBOSE(str(boost::format("hit link that needed to be avoided: %s\n")%_report->__str__()));
+                    return PS_Failed;
+                }
+                if( ret > 0 ) {
+                    nLinksCollideObstacle++;
+                }
+                continue;
+            }
+
             while(num_iters-- > 0) {
                 // set manip joints that haven't been covered so far
                 if( (vchuckingdir[ifing] > 0 && dofvals[ifing] > vupperlim[ifing]+step_size ) || ( vchuckingdir[ifing] < 0 && dofvals[ifing] < vlowerlim[ifing]-step_size ) ) {
@@ -522,6 +534,115 @@ public:
         return ptraj->GetNumWaypoints() > 0 ? PS_HasSolution : PS_Failed;     // only return true if there is at least one valid pose!
     }
 
+    /// \brief closes the finger of active DOF ifing until its links make contact, see GraspParameters::bcontinuouscontact
+    ///
+    /// The points of the links moved by the joint cannot move faster than their distance to the joint axis, so the joint can advance by the distance of the links to the environment divided by that bound without reaching the environment. The step that collides is bisected until it is smaller than the fine step.
+    /// \param[inout] dofvals the active DOF values, set to the final finger value
+    /// \return -1 if a link that has to be avoided was hit, 1 if the finger stopped in contact with the target or the environment, 0 if it stopped before a self collision or reached its limit
+    int _CloseFingerToContact(size_t ifing, KinBody::JointPtr pjoint, dReal fchuckingdir, dReal flowerlim, dReal fupperlim, dReal fmult, std::vector<dReal>& dofvals, TrajectoryBasePtr ptraj)
+    {
+        int iaxis = _robot->GetActiveDOFIndices().at(ifing)-pjoint->GetDOFIndex();
+        dReal ffinestep = _parameters->ffinestep*fmult, fcoarsestep = _parameters->fcoarsestep*fmult;
+        dReal flimit = fchuckingdir > 0 ? fupperlim : flowerlim;
+        std::vector<KinBody::LinkPtr> vmovinglinks;
+        FOREACHC(itlink, _vlinks) {
+            if( _robot->DoesAffect(pjoint->GetJointIndex(), (*itlink)->GetIndex()) ) {
+                vmovinglinks.push_back(*itlink);
+            }
+        }
+
+        // bound on the distance a point of the moving links travels per unit of the joint value
+        dReal fspeed = RaveFabs(fchuckingdir);
+        if( pjoint->IsRevolute(iaxis) ) {
+            Vector vanchor = pjoint->GetAnchor(), vaxis = pjoint->GetAxis(iaxis);
+            dReal fmaxradius2 = 0;
+            FOREACHC(itlink, vmovinglinks) {
+                AABB ab = (*itlink)->ComputeAABB();
+                for(int icorner = 0; icorner < 8; ++icorner) {
+                    Vector v = ab.pos - vanchor;
+                    v.x += (icorner&1) ? ab.extents.x : -ab.extents.x;
+                    v.y += (icorner&2) ? ab.extents.y : -ab.extents.y;
+                    v.z += (icorner&4) ? ab.extents.z : -ab.extents.z;
+                    fmaxradius2 = max(fmaxradius2, v.cross(vaxis).lengthsqr3());
+                }
+            }
+            fspeed *= RaveSqrt(fmaxradius2);
+        }
+
+        dReal ffreevalue = dofvals[ifing];
+        while( fchuckingdir*(flimit - ffreevalue) > 0 ) {
+            dReal fstep = fcoarsestep;
+            dReal fdist = fspeed > 0 ? _ComputeLinksDistance(vmovinglinks) : -1;
+            if( fdist >= 0 ) {
+                fstep = max(fdist/fspeed, ffinestep);
+            }
+            dReal fnextvalue = ffreevalue + fchuckingdir*fstep;
+            if( fchuckingdir*(fnextvalue - flimit) > 0 ) {
+                fnextvalue = flimit;
+            }
+            dofvals[ifing] = fnextvalue;
+            _robot->SetActiveDOFValues(dofvals,KinBody::CLA_CheckLimitsSilent);
+            int ct = _CheckCollision(KinBody::JointConstPtr(pjoint),KinBodyPtr());
+            if( !(ct&CT_CollisionMask) ) {
+                ffreevalue = fnextvalue;
+                if(_parameters->breturntrajectory) {
+                    ptraj->Insert(ptraj->GetNumWaypoints(),dofvals,_robot->GetActiveConfigurationSpecification());
+                }
+                continue;
+            }
+
+            dReal fcollidingvalue = fnextvalue;
+            while( RaveFabs(fcollidingvalue - ffreevalue) > ffinestep ) {
+                dofvals[ifing] = 0.5*(ffreevalue + fcollidingvalue);
+                _robot->SetActiveDOFValues(dofvals,KinBody::CLA_CheckLimitsSilent);
+                if( _CheckCollision(KinBody::JointConstPtr(pjoint),KinBodyPtr()) & CT_CollisionMask ) {
+                    fcollidingvalue = dofvals[ifing];
+                }
+                else {
+                    ffreevalue = dofvals[ifing];
+                }
+            }
+            // check again so that _report describes the contact
+            dofvals[ifing] = fcollidingvalue;
+            _robot->SetActiveDOFValues(dofvals,KinBody::CLA_CheckLimitsSilent);
+            ct = _CheckCollision(KinBody::JointConstPtr(pjoint),KinBodyPtr());
+            if( ct & CT_AvoidLinkHit ) {
+                return -1;
+            }
+            if( (ct & CT_SelfCollision) || _parameters->bavoidcontact ) {
+                dofvals[ifing] = ffreevalue;
+                return 0;
+            }
+            if(_parameters->breturntrajectory) {
+                ptraj->Insert(ptraj->GetNumWaypoints(),dofvals,_robot->GetActiveConfigurationSpecification());
+            }
+            return 1;
+        }
+        dofvals[ifing] = ffreevalue;
+        return 0;
+    }
+
+    /// \brief returns the minimum distance from the links to the other bodies, 0 if they collide, or -1 if the collision checker does not compute distances
+    dReal _ComputeLinksDistance(const std::vector<KinBody::LinkPtr>& vlinks)
+    {
+        CollisionCheckerBasePtr pchecker = GetEnv()->GetCollisionChecker();
+        int oldoptions = pchecker->GetCollisionOptions();
+        if( !pchecker->SetCollisionOptions(oldoptions|CO_Distance) ) {
+            pchecker->SetCollisionOptions(oldoptions);
+            return -1;
+        }
+        dReal fmindist = std::numeric_limits<dReal>::infinity();
+        FOREACHC(itlink, vlinks) {
+            if( GetEnv()->CheckCollision(KinBody::LinkConstPtr(*itlink), _report) ) {
+                fmindist = 0;
+                break;
+            }
+            fmindist = min(fmindist, _report->minDistance);
+        }
+        pchecker->SetCollisionOptions(oldoptions);
+        return fmindist;
+    }
+
     virtual int _CheckCollision(KinBody::JointConstPtr pjoint, KinBodyPtr targetbody)
     {
         int ct = 0;
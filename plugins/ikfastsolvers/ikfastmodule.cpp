@@ -14,6 +14,7 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "plugindefs.h"
+#include "parallelrangeworkers.h"
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
 
@@ -141,10 +142,13 @@ public:
             }
         }
 
+        /// \param ikname the solver name to register the library under, can be empty when only preloading the library
         bool Init(const string& ikname, const string& libraryname)
         {
             _viknames.resize(0);
-            AddIkName(ikname);
+            if( ikname.size() > 0 ) {
+                AddIkName(ikname);
+            }
             _libraryname = libraryname;
             plib = SysLoadLibrary(_libraryname.c_str());
             if( plib == NULL ) {
@@ -185,6 +189,7 @@ public:
         {
             LOAD_IKFUNCTION0(ComputeIk);
             LOAD_IKFUNCTION0(ComputeIk2);
+            LOAD_IKFUNCTION0(ComputeIkBatch);
             LOAD_IKFUNCTION(ComputeFk);
             LOAD_IKFUNCTION(GetNumFreeParameters);
             LOAD_IKFUNCTION(GetFreeParameters);
@@ -311,13 +316,17 @@ private:
     }
 
 public:
-    IkFastModule(EnvironmentBasePtr penv, std::istream& sinput) : ModuleBase(penv)
+    IkFastModule(EnvironmentBasePtr penv, std::istream& sinput) : ModuleBase(penv), _nReachabilityNextPosition(0)
     {
         __description = ":Interface Author: Rosen Diankov\n\nAllows dynamic loading and registering of ikfast shared objects to openrave plugins.\nAlso contains several test routines for inverse kinematics.";
         RegisterCommand("AddIkLibrary",boost::bind(&IkFastModule::AddIkLibrary,this,_1,_2),
                         "Dynamically adds an ik solver to openrave by loading a shared object (based on ikfast code generation).\n"
                         "Usage::\n\n  AddIkLibrary iksolvername iklibrarypath\n\n"
                         "return the type of inverse kinematics solver (IkParamterization::Type)");
+        RegisterCommand("PreloadIkLibraries",boost::bind(&IkFastModule::PreloadIkLibraries,this,_1,_2),
+                        "Loads ik shared objects on the thread pool and returns immediately, so that the later AddIkLibrary calls of the robots do not wait on the loading.\n"
+                        "Usage::\n\n  PreloadIkLibraries iklibrarypath [iklibrarypath ...]\n\n"
+                        "The paths are separated by whitespace. Libraries that are already loaded are skipped. Destroying the module skips the loads that did not start yet.");
 #ifdef Boost_IOSTREAMS_FOUND
         RegisterCommand("LoadIKFastSolver",boost::bind(&IkFastModule::LoadIKFastSolver,this,_1,_2),
                         "Dynamically calls the inversekinematics.py script to generate an ik solver for a robot, or to load an existing one\n"
@@ -337,6 +346,12 @@ public:
 * float sampledegeneratecases - probability in [0,1] specifies the probability of sampling joint values on [-pi/2,0,pi/2] (default is 0.2).\n\n\
 * int selfcollision - if true, will check IK only for non-self colliding positions of the robot (default is 0).\n\n\
 * string robot - name of the robot to test. the active manipulator of the roobt is used.\n\n");
+        RegisterCommand("ComputeReachability",boost::bind(&IkFastModule::ComputeReachability,this,_1,_2),
+                        "Counts the IK solutions of a grid of end effector poses in parallel, used for generating kinematic reachability maps. "
+                        "Every thread solves on its own clone of the environment, so the robot should be set up (transform, free joint values) before calling.\n"
+                        "Usage::\n\n  ComputeReachability robotname manipname numthreads usefreespace numrotations [qw qx qy qz]*numrotations numpositions [x y z]*numpositions\n\n"
+                        "Every position is combined with every rotation. If usefreespace is 1, all IK solutions are counted, otherwise only whether one exists. "
+                        "Returns one line per position with the number of reachable rotations followed by the (rotation index, number of solutions) pairs of the reachable rotations.");
     }
 
     virtual ~IkFastModule() {
@@ -349,6 +364,8 @@ public:
 
     virtual void Destroy()
     {
+        boost::mutex::scoped_lock lock(_mutexPreload);
+        _preloadgroup.reset(); // waits for the running loads and skips the queued ones
     }
 
     bool AddIkLibrary(ostream& sout, istream& sinput)
@@ -376,7 +393,28 @@ public:
         return true;
     }
 
-    boost::shared_ptr<IkLibrary> _AddIkLibrary(const string& ikname, const string& _libraryname)
+    bool PreloadIkLibraries(ostream& sout, istream& sinput)
+    {
+        boost::mutex::scoped_lock lock(_mutexPreload);
+        if( !_preloadgroup ) {
+            _preloadgroup.reset(new utils::ThreadPoolTaskGroup("IkFastPreload"));
+        }
+        string libraryname;
+        while(sinput >> libraryname) {
+            _preloadgroup->Submit(boost::bind(&IkFastModule::_PreloadIkLibrary, libraryname));
+        }
+        return true;
+    }
+
+    static void _PreloadIkLibrary(const string& libraryname)
+    {
+        if( !_AddIkLibrary(string(), libraryname) ) {
+            RAVELOG_WARN(str(boost::format("failed to preload ik library %s")%libraryname));
+        }
+    }
+
+    /// \param ikname the solver name to register the library under, can be empty to only load it
+    static boost::shared_ptr<IkLibrary> _AddIkLibrary(const string& ikname, const string& _libraryname)
     {
 #ifdef HAVE_BOOST_FILESYSTEM
         string libraryname = boost::filesystem::system_complete(boost::filesystem::path(_libraryname, boost::filesystem::native)).string();
@@ -385,23 +423,44 @@ public:
 #endif
 
         // before adding a new library, check for existing
+        {
+            boost::mutex::scoped_lock lock(GetLibraryMutex());
+            boost::shared_ptr<IkLibrary> lib = _FindIkLibrary(libraryname);
+            if( !!lib ) {
+                if( ikname.size() > 0 ) {
+                    lib->AddIkName(ikname);
+                }
+                return lib;
+            }
+        }
+
+        // loading can take long for big solvers, so do not block the other libraries while it runs
+        boost::shared_ptr<IkLibrary> newlib(new IkLibrary());
+        if( !newlib->Init(ikname, libraryname) ) {
+            return boost::shared_ptr<IkLibrary>();
+        }
         boost::mutex::scoped_lock lock(GetLibraryMutex());
-        boost::shared_ptr<IkLibrary> lib;
-        FOREACH(it, *GetLibraries()) {
-            if( libraryname == (*it)->GetLibraryName() ) {
-                lib = *it;
+        boost::shared_ptr<IkLibrary> lib = _FindIkLibrary(libraryname);
+        if( !!lib ) {
+            // loaded by another thread in the meantime, newlib only releases its reference to the shared object
+            if( ikname.size() > 0 ) {
                 lib->AddIkName(ikname);
-                break;
             }
+            return lib;
         }
-        if( !lib ) {
-            lib.reset(new IkLibrary());
-            if( !lib->Init(ikname, libraryname) ) {
-                return boost::shared_ptr<IkLibrary>();
+        GetLibraries()->push_back(newlib);
+        return newlib;
+    }
+
+    /// \brief returns the loaded library of libraryname, GetLibraryMutex has to be locked
+    static boost::shared_ptr<IkLibrary> _FindIkLibrary(const string& libraryname)
+    {
+        FOREACH(it, *GetLibraries()) {
+            if( libraryname == (*it)->GetLibraryName() ) {
+                return *it;
             }
-            GetLibraries()->push_back(lib);
         }
-        return lib;
+        return boost::shared_ptr<IkLibrary>();
     }
 
 #ifdef Boost_IOSTREAMS_FOUND
@@ -1430,8 +1489,147 @@ public:
         return IkSolverBasePtr();
     }
 
+    /// \brief the state of a thread computing reachability, see ComputeReachability
+    struct ReachabilityWorker
+    {
+        EnvironmentBasePtr penv; ///< clone of the environment, kept between calls
+        RobotBase::ManipulatorPtr pmanip; ///< the manipulator in penv
+        std::vector<dReal> vsolution;
+        std::vector< std::vector<dReal> > vsolutions;
+    };
+
+    /// \brief solves the positions claimed from _nReachabilityNextPosition on the clone of the worker
+    void _ComputeReachabilityWorker(const std::vector<Transform>& vrotations, const std::vector<Vector>& vpositions, bool bUseFreeSpace, std::vector< std::vector< std::pair<int, int> > >& vresults, size_t start, size_t end)
+    {
+        for(size_t iworker = start; iworker < end; ++iworker) {
+            ReachabilityWorker& worker = _vReachabilityWorkers.at(iworker);
+            EnvironmentMutex::scoped_lock lock(worker.penv->GetMutex());
+            while(1) {
+                size_t iposition;
+                {
+                    // positions take very different times to solve depending on whether they are in reach, so claim them one at a time
+                    boost::mutex::scoped_lock lockposition(_mutexReachability);
+                    if( _nReachabilityNextPosition >= vpositions.size() ) {
+                        break;
+                    }
+                    iposition = _nReachabilityNextPosition++;
+                }
+                std::vector< std::pair<int, int> >& vreachable = vresults[iposition];
+                try {
+                    for(size_t irotation = 0; irotation < vrotations.size(); ++irotation) {
+                        Transform t = vrotations[irotation];
+                        t.trans = vpositions[iposition];
+                        IkParameterization ikparam(t, IKP_Transform6D);
+                        if( bUseFreeSpace ) {
+                            if( worker.pmanip->FindIKSolutions(ikparam, worker.vsolutions, 0) && worker.vsolutions.size() > 0 ) {
+                                vreachable.push_back(make_pair((int)irotation, (int)worker.vsolutions.size()));
+                            }
+                        }
+                        else if( worker.pmanip->FindIKSolution(ikparam, worker.vsolution, 0) ) {
+                            vreachable.push_back(make_pair((int)irotation, 1));
+                        }
+                    }
+                }
+                catch(const std::exception& ex) {
+                    RAVELOG_WARN_FORMAT("env=%d, failed to compute reachability of position %d: %s", GetEnv()->GetId()%iposition%ex.what());
+                }
+            }
+        }
+    }
+
+    bool ComputeReachability(ostream& sout, istream& sinput)
+    {
+        string robotname, manipname;
+        int numthreads = 1, usefreespace = 0;
+        size_t numrotations = 0, numpositions = 0;
+        sinput >> robotname >> manipname >> numthreads >> usefreespace >> numrotations;
+        if( !sinput ) {
+            return false;
+        }
+        std::vector<Transform> vrotations(numrotations);
+        FOREACH(itrotation, vrotations) {
+            sinput >> itrotation->rot.x >> itrotation->rot.y >> itrotation->rot.z >> itrotation->rot.w;
+        }
+        sinput >> numpositions;
+        std::vector<Vector> vpositions(numpositions);
+        FOREACH(itposition, vpositions) {
+            sinput >> itposition->x >> itposition->y >> itposition->z;
+        }
+        if( !sinput ) {
+            RAVELOG_WARN("failed to read the reachability poses\n");
+            return false;
+        }
+        numthreads = max(1, numthreads);
+
+        {
+            EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+            RobotBasePtr probot = GetEnv()->GetRobot(robotname);
+            if( !probot ) {
+                RAVELOG_WARN_FORMAT("env=%d, failed to find robot %s", GetEnv()->GetId()%robotname);
+                return false;
+            }
+            RobotBase::ManipulatorPtr pmanip = probot->GetManipulator(manipname);
+            if( !pmanip || !pmanip->GetIkSolver() ) {
+                RAVELOG_WARN_FORMAT("env=%d, robot %s does not have manipulator %s with an ik solver", GetEnv()->GetId()%robotname%manipname);
+                return false;
+            }
+            IkSolverBasePtr piksolver = pmanip->GetIkSolver();
+            _vReachabilityWorkers.resize(numthreads);
+            FOREACH(itworker, _vReachabilityWorkers) {
+                if( !itworker->penv ) {
+                    itworker->penv = GetEnv()->CloneSelf(Clone_Bodies);
+                }
+                else {
+                    itworker->penv->Clone(GetEnv(), Clone_Bodies|Clone_SkipUnchangedBodies);
+                }
+                EnvironmentMutex::scoped_lock lockclone(itworker->penv->GetMutex());
+                RobotBasePtr pclonerobot = itworker->penv->GetRobot(robotname);
+                itworker->pmanip = !!pclonerobot ? pclonerobot->GetManipulator(manipname) : RobotBase::ManipulatorPtr();
+                if( !itworker->pmanip ) {
+                    RAVELOG_WARN_FORMAT("env=%d, clone does not have robot %s manipulator %s", GetEnv()->GetId()%robotname%manipname);
+                    return false;
+                }
+                // cloned manipulators re-create their ik solvers from the xml id and lose the free increments, so copy the solver
+                IkSolverBasePtr pnewsolver = RaveCreateIkSolver(itworker->penv, piksolver->GetXMLId());
+                if( !pnewsolver ) {
+                    RAVELOG_WARN_FORMAT("env=%d, failed to create ik solver %s", GetEnv()->GetId()%piksolver->GetXMLId());
+                    return false;
+                }
+                pnewsolver->Clone(piksolver, 0);
+                if( !itworker->pmanip->SetIkSolver(pnewsolver) ) {
+                    RAVELOG_WARN_FORMAT("env=%d, failed to set ik solver %s", GetEnv()->GetId()%piksolver->GetXMLId());
+                    return false;
+                }
+            }
+        }
+        if( !_pReachabilityWorkers || _pReachabilityWorkers->GetNumThreads() != numthreads ) {
+            _pReachabilityWorkers.reset(new ParallelRangeWorkers(numthreads, "IkFastReachability"));
+        }
+
+        uint64_t starttime = utils::GetMicroTime();
+        std::vector< std::vector< std::pair<int, int> > > vresults(numpositions);
+        _nReachabilityNextPosition = 0;
+        _pReachabilityWorkers->Run(numthreads, boost::bind(&IkFastModule::_ComputeReachabilityWorker, this, boost::cref(vrotations), boost::cref(vpositions), usefreespace != 0, boost::ref(vresults), _1, _2));
+        RAVELOG_DEBUG_FORMAT("env=%d, computed reachability of %d poses with %d threads in %fs", GetEnv()->GetId()%(numpositions*numrotations)%numthreads%(1e-6*(utils::GetMicroTime()-starttime)));
+
+        FOREACHC(itresult, vresults) {
+            sout << itresult->size();
+            FOREACHC(itreachable, *itresult) {
+                sout << " " << itreachable->first << " " << itreachable->second;
+            }
+            sout << endl;
+        }
+        return true;
+    }
+
     string _ikfastversion; ///< current ikfast version (assuming doesn't change during process lifetime)
     string _platform; ///<  current platform architecture. ie x86-64
+    std::vector<ReachabilityWorker> _vReachabilityWorkers; ///< one per ComputeReachability thread
+    ParallelRangeWorkersPtr _pReachabilityWorkers;
+    size_t _nReachabilityNextPosition; ///< the next position to solve in ComputeReachability, protected by _mutexReachability
+    boost::mutex _mutexReachability;
+    boost::shared_ptr<utils::ThreadPoolTaskGroup> _preloadgroup; ///< the loads of PreloadIkLibraries, protected by _mutexPreload
+    boost::mutex _mutexPreload;
 };
 
 ModuleBasePtr CreateIkFastModule(EnvironmentBasePtr penv, std::istream& sinput)
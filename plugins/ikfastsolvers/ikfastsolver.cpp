@@ -19,9 +19,9 @@
 #include <boost/tuple/tuple.hpp>
 #include <boost/lexical_cast.hpp>
 
-#ifdef OPENRAVE_HAS_LAPACK
+#include "parallelrangeworkers.h"
+
 #include "jacobianinverse.h"
-#endif
 
 template <typename IkReal>
 class IkFastSolver : public IkSolverBase
@@ -35,6 +35,84 @@ public:
         IkReturnPtr ikreturn;
     };
 
+    /** \brief the analytic solutions of the last queried parameterizations, see SetSolutionCache
+
+        The ikfast solutions only depend on the parameterization, the free values, and the local tool transform, so they stay valid when
+        the environment changes and are never invalidated. The joint limits, filters, and collisions are still checked on every query.
+        The oldest entry is dropped when the cache is full. <b>[multi-thread safe]</b>, the free sweep workers and the SolveAllBatch
+        snapshots share it.
+     */
+    class SolutionCache
+    {
+public:
+        SolutionCache(size_t nMaxEntries, dReal fResolution) : _nMaxEntries(nMaxEntries), _fResolution(fResolution), _nhits(0), _nmisses(0) {
+        }
+
+        /// \brief rounds the ik type, parameterization values, free values, and tool transform to the resolution
+        void GetKey(const IkParameterization& param, const std::vector<IkReal>& vfree, const Transform& tLocalTool, std::vector<int64_t>& vkey) const
+        {
+            std::vector<dReal> vvalues(param.GetNumberOfValues());
+            param.GetValues(vvalues.begin());
+            vkey.resize(0);
+            vkey.reserve(1+vvalues.size()+vfree.size()+7);
+            vkey.push_back(param.GetType());
+            FOREACHC(itvalue, vvalues) {
+                vkey.push_back(_Quantize(*itvalue));
+            }
+            FOREACHC(itfree, vfree) {
+                vkey.push_back(_Quantize(*itfree));
+            }
+            for(int i = 0; i < 4; ++i) {
+                vkey.push_back(_Quantize(tLocalTool.rot[i]));
+            }
+            for(int i = 0; i < 3; ++i) {
+                vkey.push_back(_Quantize(tLocalTool.trans[i]));
+            }
+        }
+
+        /// \return true if vkey is cached, in which case solutions and bsuccess are set to the result of the ik call
+        bool Find(const std::vector<int64_t>& vkey, ikfast::IkSolutionList<IkReal>& solutions, bool& bsuccess)
+        {
+            boost::mutex::scoped_lock lock(_mutex);
+            typename SolutionMap::const_iterator it = _mapsolutions.find(vkey);
+            if( it == _mapsolutions.end() ) {
+                ++_nmisses;
+                return false;
+            }
+            ++_nhits;
+            bsuccess = it->second.first;
+            solutions = it->second.second;
+            return true;
+        }
+
+        void Insert(const std::vector<int64_t>& vkey, const ikfast::IkSolutionList<IkReal>& solutions, bool bsuccess)
+        {
+            boost::mutex::scoped_lock lock(_mutex);
+            std::pair<typename SolutionMap::iterator, bool> itinserted = _mapsolutions.insert(std::make_pair(vkey, std::make_pair(bsuccess, solutions)));
+            if( !itinserted.second ) {
+                return; // another thread computed it in the meantime
+            }
+            _listorder.push_back(itinserted.first);
+            while( _mapsolutions.size() > _nMaxEntries ) {
+                _mapsolutions.erase(_listorder.front());
+                _listorder.pop_front();
+            }
+        }
+
+        typedef std::map<std::vector<int64_t>, std::pair<bool, ikfast::IkSolutionList<IkReal> > > SolutionMap;
+        size_t _nMaxEntries;
+        dReal _fResolution;
+        boost::mutex _mutex; ///< protects all the members below
+        SolutionMap _mapsolutions;
+        std::list<typename SolutionMap::iterator> _listorder; ///< the entries of _mapsolutions from the oldest to the newest
+        int _nhits, _nmisses;
+
+private:
+        inline int64_t _Quantize(dReal f) const {
+            return static_cast<int64_t>(std::floor(f/_fResolution+0.5));
+        }
+    };
+
 public:
     IkFastSolver(EnvironmentBasePtr penv, std::istream& sinput, boost::shared_ptr<ikfast::IkFastFunctions<IkReal> > ikfunctions, const vector<dReal>& vfreeinc) : IkSolverBase(penv), _ikfunctions(ikfunctions), _vFreeInc(vfreeinc) {
         OPENRAVE_ASSERT_OP(ikfunctions->_GetIkRealSize(),==,sizeof(IkReal));
@@ -75,6 +153,21 @@ public:
                         "**Can only be called by a custom filter during a Solve function call.** Gets the indices of the current solution being considered. if large-range joints wrap around, (index>>16) holds the index. So (index&0xffff) is unique to robot link pose, while (index>>16) describes the repetition.");
         RegisterCommand("GetRobotLinkStateRepeatCount", boost::bind(&IkFastSolver<IkReal>::_GetRobotLinkStateRepeatCountCommand,this,_1,_2),
                         "**Can only be called by a custom filter during a Solve function call.**. Returns 1 if the filter was called already with the same robot link positions, 0 otherwise. This is useful in saving computation. ");
+        RegisterCommand("SetBatchThreads", boost::bind(&IkFastSolver<IkReal>::_SetBatchThreadsCommand,this,_1,_2),
+                        "sets the number of threads SolveAllBatch splits the parameterizations across. Each additional thread solves on its own environment snapshot, which is only possible when no custom filters or finish callbacks are registered.");
+        RegisterCommand("SetFreeSweepThreads", boost::bind(&IkFastSolver<IkReal>::_SetFreeSweepThreadsCommand,this,_1,_2),
+                        "sets the number of threads SolveAll uses for computing the ik of the free parameter values. The solutions are still validated by the calling thread in the sequential order.");
+        RegisterCommand("SetMaxSolutions", boost::bind(&IkFastSolver<IkReal>::_SetMaxSolutionsCommand,this,_1,_2),
+                        "SolveAll stops the free parameter sweep as soon as this many solutions are found. 0 (default) returns all solutions.");
+        RegisterCommand("SetClosestSolutionSearch", boost::bind(&IkFastSolver<IkReal>::_SetClosestSolutionSearchCommand,this,_1,_2),
+                        "if 1, Solve with a seed returns the solution closest to the seed over all free parameter values instead of the first one found. The free values are visited by their distance to the seed and the search stops once no remaining value can give a closer solution. 0 (default) disables.");
+        RegisterCommand("SetSolutionCache", boost::bind(&IkFastSolver<IkReal>::_SetSolutionCacheCommand,this,_1,_2),
+                        "Takes the maximum number of cached entries and optionally the resolution (default=1e-7). Keeps the analytic ik solutions of the last queried parameterizations and free values, keyed by their values rounded to the resolution, so solving the same poses again only validates the solutions against the joint limits, filters, and collisions. 0 (default) disables the cache.");
+        RegisterCommand("GetSolutionCacheStats", boost::bind(&IkFastSolver<IkReal>::_GetSolutionCacheStatsCommand,this,_1,_2),
+                        "returns the number of hits, misses, and entries of the solution cache.");
+        _nBatchThreads = 1;
+        _nMaxSolutions = 0;
+        _bSearchClosestSolution = false;
     }
     virtual ~IkFastSolver() {
     }
@@ -167,6 +260,87 @@ public:
         return true;
     }
 
+    bool _SetBatchThreadsCommand(ostream& sout, istream& sinput)
+    {
+        int nBatchThreads = 1;
+        sinput >> nBatchThreads;
+        if( !sinput || nBatchThreads < 1 ) {
+            return false;
+        }
+        _nBatchThreads = nBatchThreads;
+        return true;
+    }
+
+    bool _SetFreeSweepThreadsCommand(ostream& sout, istream& sinput)
+    {
+        int nFreeSweepThreads = 1;
+        sinput >> nFreeSweepThreads;
+        if( !sinput || nFreeSweepThreads < 1 ) {
+            return false;
+        }
+        if( nFreeSweepThreads <= 1 ) {
+            _pFreeSweepWorkers.reset();
+        }
+        else if( !_pFreeSweepWorkers || _pFreeSweepWorkers->GetNumThreads() != nFreeSweepThreads ) {
+            _pFreeSweepWorkers.reset(new ParallelRangeWorkers(nFreeSweepThreads, "IkFastFreeSweep"));
+        }
+        return true;
+    }
+
+    bool _SetMaxSolutionsCommand(ostream& sout, istream& sinput)
+    {
+        int nMaxSolutions = 0;
+        sinput >> nMaxSolutions;
+        if( !sinput || nMaxSolutions < 0 ) {
+            return false;
+        }
+        _nMaxSolutions = nMaxSolutions;
+        return true;
+    }
+
+    bool _SetClosestSolutionSearchCommand(ostream& sout, istream& sinput)
+    {
+        int bSearchClosestSolution = 0;
+        sinput >> bSearchClosestSolution;
+        if( !sinput ) {
+            return false;
+        }
+        _bSearchClosestSolution = bSearchClosestSolution != 0;
+        return true;
+    }
+
+    bool _SetSolutionCacheCommand(ostream& sout, istream& sinput)
+    {
+        int nMaxEntries = 0;
+        dReal fResolution = 1e-7;
+        sinput >> nMaxEntries;
+        if( !sinput || nMaxEntries < 0 ) {
+            return false;
+        }
+        sinput >> fResolution;
+        if( fResolution <= 0 ) {
+            return false;
+        }
+        if( nMaxEntries == 0 ) {
+            _psolutioncache.reset();
+        }
+        else {
+            _psolutioncache.reset(new SolutionCache(nMaxEntries, fResolution));
+        }
+        return true;
+    }
+
+    bool _GetSolutionCacheStatsCommand(ostream& sout, istream& sinput)
+    {
+        if( !_psolutioncache ) {
+            sout << "0 0 0";
+            return true;
+        }
+        boost::mutex::scoped_lock lock(_psolutioncache->_mutex);
+        sout << _psolutioncache->_nhits << " " << _psolutioncache->_nmisses << " " << _psolutioncache->_mapsolutions.size();
+        return true;
+    }
+
     virtual IkReturnAction CallFilters(const IkParameterization& param, IkReturnPtr ikreturn, int minpriority, int maxpriority) {
         // have to convert to the manipulator's base coordinate system
         RobotBase::ManipulatorPtr pmanip(_pmanip);
@@ -304,11 +478,9 @@ public:
         }
         pmanip->GetIndependentLinks(_vindependentlinks);
 
-#ifdef OPENRAVE_HAS_LAPACK
         if( !!pmanip ) {
             _jacobinvsolver.Init(*pmanip);
         }
-#endif
         
         // get the joint limits
         RobotBase::RobotStateSaver saver(probot);
@@ -343,6 +515,7 @@ public:
         StateCheckEndEffector(RobotBasePtr probot, const std::vector<KinBody::LinkPtr>& vchildlinks, const std::vector<KinBody::LinkPtr>& vindependentlinks, int filteroptions) : _vchildlinks(vchildlinks), _vindependentlinks(vindependentlinks) {
             _probot = probot;
             _bCheckEndEffectorEnvCollision = !(filteroptions & IKFO_IgnoreEndEffectorEnvCollisions);
+            _bInitialCheckEndEffectorEnvCollision = _bCheckEndEffectorEnvCollision;
             _bCheckEndEffectorSelfCollision = !(filteroptions & (IKFO_IgnoreEndEffectorSelfCollisions|IKFO_IgnoreSelfCollisions));
             _bCheckSelfCollision = !(filteroptions & IKFO_IgnoreSelfCollisions);
             _bDisabled = false;
@@ -398,6 +571,15 @@ public:
             SetEnvironmentCollisionState();
         }
 
+        /// \brief prepares for solving another ik parameterization while keeping the savers, the collision callback, and the registered end effector transforms
+        ///
+        /// ResetCheckEndEffectorEnvCollision is only valid for the parameterization that found the end effector free.
+        void ResetParameterization() {
+            if( _bInitialCheckEndEffectorEnvCollision && !_bCheckEndEffectorEnvCollision ) {
+                RestoreCheckEndEffectorEnvCollision();
+            }
+        }
+
         void RestoreCheckEndEffectorEnvCollision() {
             _bCheckEndEffectorEnvCollision = true;
             if( _bDisabled ) {
@@ -519,6 +701,7 @@ protected:
         const std::vector<KinBody::LinkPtr>& _vchildlinks, &_vindependentlinks;
         std::list<std::pair<Transform, bool> > _listCollidingTransforms;
         bool _bCheckEndEffectorEnvCollision, _bCheckEndEffectorSelfCollision, _bCheckSelfCollision, _bDisabled;
+        bool _bInitialCheckEndEffectorEnvCollision; ///< _bCheckEndEffectorEnvCollision set from the filter options
     };
 
     virtual bool Solve(const IkParameterization& rawparam, const std::vector<dReal>& q0, int filteroptions, boost::shared_ptr< std::vector<dReal> > result)
@@ -597,7 +780,13 @@ protected:
         std::vector<IkReal> vfree(_vfreeparams.size());
         StateCheckEndEffector stateCheck(probot,_vchildlinks,_vindependentlinks,filteroptions);
         CollisionOptionsStateSaver optionstate(GetEnv()->GetCollisionChecker(),GetEnv()->GetCollisionChecker()->GetCollisionOptions()|CO_ActiveDOFs,false);
-        IkReturnAction retaction = ComposeSolution(_vfreeparams, vfree, 0, q0, boost::bind(&IkFastSolver::_SolveSingle,shared_solver(), boost::ref(param),boost::ref(vfree),boost::ref(q0),filteroptions,ikreturn,boost::ref(stateCheck)), _vFreeInc);
+        IkReturnAction retaction;
+        if( _bSearchClosestSolution && _vfreeparams.size() > 0 && q0.size() == _qlower.size() ) {
+            retaction = _SolveClosest(param, vfree, q0, filteroptions, ikreturn, stateCheck);
+        }
+        else {
+            retaction = ComposeSolution(_vfreeparams, vfree, 0, q0, boost::bind(&IkFastSolver::_SolveSingle,shared_solver(), boost::ref(param),boost::ref(vfree),boost::ref(q0),filteroptions,ikreturn,boost::ref(stateCheck)), _vFreeInc);
+        }
         if( !!ikreturn ) {
             ikreturn->_action = retaction;
         }
@@ -616,14 +805,80 @@ protected:
         std::vector<IkReal> vfree(_vfreeparams.size());
         StateCheckEndEffector stateCheck(probot,_vchildlinks,_vindependentlinks,filteroptions);
         CollisionOptionsStateSaver optionstate(GetEnv()->GetCollisionChecker(),GetEnv()->GetCollisionChecker()->GetCollisionOptions()|CO_ActiveDOFs,false);
-        IkReturnAction retaction = ComposeSolution(_vfreeparams, vfree, 0, vector<dReal>(), boost::bind(&IkFastSolver::_SolveAll,shared_solver(), param,boost::ref(vfree),filteroptions,boost::ref(vikreturns), boost::ref(stateCheck)), _vFreeInc);
+        IkReturnAction retaction = _SweepFreeParameters(param, vfree, filteroptions, vikreturns, stateCheck);
         if( retaction & IKRA_Quit ) {
             return false;
         }
+        _TruncateSolutions(vikreturns);
         _SortSolutions(probot, vikreturns);
         return vikreturns.size()>0;
     }
 
+    /// \brief solves all parameterizations with one robot state saver and one end effector state check
+    ///
+    /// If SetBatchThreads was called with n > 1, the batch is split into n ranges and all but the first are solved by copies of this solver on environment snapshots.
+    virtual int SolveAllBatch(const std::vector<IkParameterization>& vrawparams, int filteroptions, std::vector< std::vector<IkReturnPtr> >& vikreturns)
+    {
+        vikreturns.resize(vrawparams.size());
+        int numthreads = min(_nBatchThreads, (int)vrawparams.size());
+        if( numthreads > 1 && ((!(filteroptions & IKFO_IgnoreCustomFilters) && _HasFilterInRange(IKSP_MinPriority, IKSP_MaxPriority)) || _HasFinishCallbacks()) ) {
+            RAVELOG_DEBUG("custom ik filters or finish callbacks are registered, so solving the batch with one thread\n");
+            numthreads = 1;
+        }
+        if( numthreads <= 1 ) {
+            return _SolveAllBatch(vrawparams, 0, vrawparams.size(), filteroptions, vikreturns);
+        }
+
+        RobotBase::ManipulatorPtr pmanip(_pmanip);
+        std::vector< boost::shared_ptr< IkFastSolver<IkReal> > > vsnapshotsolvers(numthreads-1);
+        _vBatchEnvs.resize(numthreads-1);
+        for(int ithread = 0; ithread+1 < numthreads; ++ithread) {
+            if( !_vBatchEnvs[ithread] ) {
+                _vBatchEnvs[ithread] = GetEnv()->CloneSelf(Clone_Bodies);
+            }
+            else {
+                _vBatchEnvs[ithread]->Clone(GetEnv(), Clone_Bodies|Clone_SkipUnchangedBodies);
+            }
+            EnvironmentMutex::scoped_lock locksnapshot(_vBatchEnvs[ithread]->GetMutex());
+            std::stringstream sdummy;
+            boost::shared_ptr< IkFastSolver<IkReal> > psolver(new IkFastSolver<IkReal>(_vBatchEnvs[ithread], sdummy, _ikfunctions, _vFreeInc));
+            psolver->Clone(shared_from_this(), 0);
+            if( !psolver->_pmanip.lock() ) {
+                throw OPENRAVE_EXCEPTION_FORMAT(_("failed to find manipulator %s:%s in the environment snapshot"), pmanip->GetRobot()->GetName()%pmanip->GetName(), ORE_Failed);
+            }
+            psolver->_fRefineWithJacobianInverseAllowedError = _fRefineWithJacobianInverseAllowedError;
+            psolver->_jacobinvsolver.Init(*psolver->_pmanip.lock());
+            psolver->_jacobinvsolver.SetErrorThresh(_fRefineWithJacobianInverseAllowedError);
+            psolver->_psolutioncache = _psolutioncache; // the analytic solutions do not depend on the environment
+            vsnapshotsolvers[ithread] = psolver;
+        }
+
+        std::vector<int> vnumsolved(numthreads, 0);
+        std::vector<std::string> verrors(numthreads);
+        boost::thread_group threads;
+        for(int ithread = 1; ithread < numthreads; ++ithread) {
+            size_t start = (vrawparams.size()*ithread)/numthreads, end = (vrawparams.size()*(ithread+1))/numthreads;
+            threads.create_thread(boost::bind(&IkFastSolver<IkReal>::_SolveAllBatchThread, vsnapshotsolvers[ithread-1], boost::cref(vrawparams), start, end, filteroptions, boost::ref(vikreturns), boost::ref(vnumsolved[ithread]), boost::ref(verrors[ithread])));
+        }
+        try {
+            vnumsolved[0] = _SolveAllBatch(vrawparams, 0, vrawparams.size()/numthreads, filteroptions, vikreturns);
+        }
+        catch(...) {
+            threads.join_all();
+            throw;
+        }
+        threads.join_all();
+
+        int numsolved = 0;
+        for(int ithread = 0; ithread < numthreads; ++ithread) {
+            if( verrors[ithread].size() > 0 ) {
+                throw OPENRAVE_EXCEPTION_FORMAT(_("ik batch thread %d failed: %s"), ithread%verrors[ithread], ORE_Failed);
+            }
+            numsolved += vnumsolved[ithread];
+        }
+        return numsolved;
+    }
+
     virtual bool Solve(const IkParameterization& rawparam, const std::vector<dReal>& q0, const std::vector<dReal>& vFreeParameters, int filteroptions, IkReturnPtr ikreturn)
     {
         IkParameterization ikparamdummy;
@@ -673,6 +928,7 @@ protected:
         if( retaction & IKRA_Quit ) {
             return false;
         }
+        _TruncateSolutions(vikreturns);
         _SortSolutions(probot, vikreturns);
         return vikreturns.size()>0;
     }
@@ -747,11 +1003,62 @@ protected:
 
         _kinematicshash = r->_kinematicshash;
         _ikthreshold = r->_ikthreshold;
+        _nMaxSolutions = r->_nMaxSolutions;
+        _bSearchClosestSolution = r->_bSearchClosestSolution;
+        _psolutioncache.reset();
+        if( !!r->_psolutioncache ) {
+            _psolutioncache.reset(new SolutionCache(r->_psolutioncache->_nMaxEntries, r->_psolutioncache->_fResolution));
+        }
 
         _bEmptyTransform6D = r->_bEmptyTransform6D;
     }
 
 protected:
+    /// \brief solves vrawparams[start:end] into vikreturns[start:end], see SolveAllBatch
+    int _SolveAllBatch(const std::vector<IkParameterization>& vrawparams, size_t start, size_t end, int filteroptions, std::vector< std::vector<IkReturnPtr> >& vikreturns)
+    {
+        RobotBase::ManipulatorPtr pmanip(_pmanip);
+        RobotBasePtr probot = pmanip->GetRobot();
+        RobotBase::RobotStateSaver saver(probot);
+        probot->SetActiveDOFs(pmanip->GetArmIndices());
+        std::vector<dReal> vsortweights;
+        _GetSortWeights(probot, vsortweights);
+        std::vector<IkReal> vfree(_vfreeparams.size());
+        StateCheckEndEffector stateCheck(probot,_vchildlinks,_vindependentlinks,filteroptions);
+        CollisionOptionsStateSaver optionstate(GetEnv()->GetCollisionChecker(),GetEnv()->GetCollisionChecker()->GetCollisionOptions()|CO_ActiveDOFs,false);
+        IkParameterization ikparamdummy;
+        int numsolved = 0;
+        for(size_t i = start; i < end; ++i) {
+            std::vector<IkReturnPtr>& vlocalikreturns = vikreturns[i];
+            vlocalikreturns.resize(0);
+            const IkParameterization& param = _ConvertIkParameterization(vrawparams[i], ikparamdummy);
+            stateCheck.ResetParameterization();
+            IkReturnAction retaction = _SweepFreeParameters(param, vfree, filteroptions, vlocalikreturns, stateCheck);
+            if( retaction & IKRA_Quit ) {
+                vlocalikreturns.resize(0);
+                continue;
+            }
+            _TruncateSolutions(vlocalikreturns);
+            _SortSolutions(probot, vsortweights, vlocalikreturns);
+            if( vlocalikreturns.size() > 0 ) {
+                ++numsolved;
+            }
+        }
+        return numsolved;
+    }
+
+    /// \brief runs _SolveAllBatch of a solver on an environment snapshot
+    static void _SolveAllBatchThread(boost::shared_ptr< IkFastSolver<IkReal> > psolver, const std::vector<IkParameterization>& vrawparams, size_t start, size_t end, int filteroptions, std::vector< std::vector<IkReturnPtr> >& vikreturns, int& numsolved, std::string& error)
+    {
+        try {
+            EnvironmentMutex::scoped_lock lock(psolver->GetEnv()->GetMutex());
+            numsolved = psolver->_SolveAllBatch(vrawparams, start, end, filteroptions, vikreturns);
+        }
+        catch(const std::exception& ex) {
+            error = ex.what();
+        }
+    }
+
     IkReturnAction ComposeSolution(const std::vector<int>& vfreeparams, vector<IkReal>& vfree, int freeindex, const vector<dReal>& q0, const boost::function<IkReturnAction()>& fn, const std::vector<dReal>& vFreeInc)
     {
         if( freeindex >= (int)vfreeparams.size()) {
@@ -826,6 +1133,15 @@ protected:
     /// \param tLocalTool _pmanip->GetLocalToolTransform()
     inline bool _CallIk(const IkParameterization& param, const vector<IkReal>& vfree, const Transform& tLocalTool, ikfast::IkSolutionList<IkReal>& solutions)
     {
+        boost::shared_ptr<SolutionCache> psolutioncache = _psolutioncache;
+        std::vector<int64_t> vkey;
+        if( !!psolutioncache ) {
+            psolutioncache->GetKey(param, vfree, tLocalTool, vkey);
+            bool bcachedsuccess = false;
+            if( psolutioncache->Find(vkey, solutions, bcachedsuccess) ) {
+                return bcachedsuccess;
+            }
+        }
         bool bsuccess = false;
         if( !!_ikfunctions->_ComputeIk2 ) {
             bsuccess = _CallIk2(param, vfree, tLocalTool, solutions);
@@ -833,6 +1149,9 @@ protected:
         else {
             bsuccess = _CallIk1(param, vfree, tLocalTool, solutions);
         }
+        if( !!psolutioncache ) {
+            psolutioncache->Insert(vkey, solutions, bsuccess);
+        }
         return bsuccess;
     }
 
@@ -1118,6 +1437,93 @@ protected:
     }
 
     IkReturnAction _SolveSingle(const IkParameterization& param, const vector<IkReal>& vfree, const vector<dReal>& q0, int filteroptions, IkReturnPtr ikreturn, StateCheckEndEffector& stateCheck)
+    {
+        SolutionInfo bestsolution;
+        IkParameterization paramnewglobal; // needs to be initialized by _ValidateSolutionSingle so we get most accurate result back
+        IkReturnAction res = _SolveSingleBest(param, vfree, q0, filteroptions, bestsolution, paramnewglobal, stateCheck);
+        if( (res & IKRA_Quit) || !bestsolution.ikreturn ) {
+            return res;
+        }
+        // return as soon as a solution is found, since we're visiting phis starting from q0, we are guaranteed
+        // that the solution will be close (ie, phi's dominate in the search). This is to speed things up
+        if( !!ikreturn ) {
+            *ikreturn = *bestsolution.ikreturn;
+        }
+        _CallFinishCallbacks(bestsolution.ikreturn, RobotBase::ManipulatorPtr(_pmanip), paramnewglobal);
+        return bestsolution.ikreturn->_action;
+    }
+
+    /// \brief returns the solution closest to q0 over all the free parameter values
+    ///
+    /// The free joints of every solution take exactly the free values, so the distance of the free joints alone to q0 bounds the distance of
+    /// any solution computed at those values from below. The free values are visited in the increasing order of that bound, and the search
+    /// stops as soon as the bound of the next value is not less than the distance of the best solution found so far. When a solution within
+    /// one free increment of q0 exists, this usually stops after the first few values.
+    IkReturnAction _SolveClosest(const IkParameterization& param, vector<IkReal>& vfree, const vector<dReal>& q0, int filteroptions, IkReturnPtr ikreturn, StateCheckEndEffector& stateCheck)
+    {
+        RobotBase::ManipulatorPtr pmanip(_pmanip);
+        RobotBasePtr probot = pmanip->GetRobot();
+        std::vector<IkReal> vfreevalues; // local since filters can call into this solver again
+        ComposeSolution(_vfreeparams, vfree, 0, q0, boost::bind(&IkFastSolver::_RecordFreeValues, boost::cref(vfree), boost::ref(vfreevalues)), _vFreeInc);
+        size_t numfree = _vfreeparams.size(), numsamples = vfreevalues.size()/numfree;
+
+        // same weighting as _ComputeGeometricConfigDistSqr. Revolute differences are normalized, which can only make the bound smaller
+        std::vector<dReal> vweights2(numfree);
+        for(size_t ifree = 0; ifree < numfree; ++ifree) {
+            int dofindex = pmanip->GetArmIndices().at(_vfreeparams[ifree]);
+            KinBody::JointPtr pjoint = probot->GetJointFromDOFIndex(dofindex);
+            dReal fweight = pjoint->GetWeight(dofindex-pjoint->GetDOFIndex());
+            vweights2[ifree] = fweight*fweight;
+        }
+        std::vector< std::pair<size_t, dReal> > vbounds(numsamples);
+        for(size_t isample = 0; isample < numsamples; ++isample) {
+            dReal fbound = 0;
+            for(size_t ifree = 0; ifree < numfree; ++ifree) {
+                dReal f = vfreevalues[isample*numfree+ifree] - q0.at(_vfreeparams[ifree]);
+                if( _vjointrevolute.at(_vfreeparams[ifree]) ) {
+                    f = utils::NormalizeCircularAngle(f, -PI, PI);
+                }
+                fbound += f*f*vweights2[ifree];
+            }
+            vbounds[isample] = std::make_pair(isample, fbound);
+        }
+        std::stable_sort(vbounds.begin(), vbounds.end(), SortSolutionDistances);
+
+        SolutionInfo bestsolution;
+        IkParameterization paramnewglobal, parambestglobal;
+        int allres = IKRA_Reject;
+        for(size_t ibound = 0; ibound < vbounds.size(); ++ibound) {
+            if( bestsolution.dist <= vbounds[ibound].second ) {
+                break; // no remaining free value can give a closer solution
+            }
+            std::copy(vfreevalues.begin()+vbounds[ibound].first*numfree, vfreevalues.begin()+(vbounds[ibound].first+1)*numfree, vfree.begin());
+            IkReturnPtr pprevbest = bestsolution.ikreturn;
+            // bestsolution is shared across the free values, so candidates that are not closer than it are rejected before any collision checks
+            IkReturnAction res = _SolveSingleBest(param, vfree, q0, filteroptions, bestsolution, paramnewglobal, stateCheck);
+            if( res & IKRA_Quit ) {
+                return res;
+            }
+            allres |= res;
+            if( bestsolution.ikreturn != pprevbest ) {
+                parambestglobal = paramnewglobal;
+            }
+        }
+
+        if( !bestsolution.ikreturn ) {
+            return static_cast<IkReturnAction>(allres);
+        }
+        if( !!ikreturn ) {
+            *ikreturn = *bestsolution.ikreturn;
+        }
+        _CallFinishCallbacks(bestsolution.ikreturn, pmanip, parambestglobal);
+        return bestsolution.ikreturn->_action;
+    }
+
+    /// \brief validates the ik solutions at the free values vfree and stores the closest one to q0 in bestsolution
+    ///
+    /// Solutions that are not closer than bestsolution.dist are rejected, so bestsolution can be carried over several calls.
+    /// \param paramnewglobal[out] the global ik parameterization of the last validated solution
+    IkReturnAction _SolveSingleBest(const IkParameterization& param, const vector<IkReal>& vfree, const vector<dReal>& q0, int filteroptions, SolutionInfo& bestsolution, IkParameterization& paramnewglobal, StateCheckEndEffector& stateCheck)
     {
         RobotBase::ManipulatorPtr pmanip(_pmanip);
         ikfast::IkSolutionList<IkReal> solutions;
@@ -1126,7 +1532,6 @@ protected:
         }
 
         RobotBasePtr probot = pmanip->GetRobot();
-        SolutionInfo bestsolution;
         std::vector<dReal> vravesol(pmanip->GetArmIndices().size());
         std::vector<IkReal> sol(pmanip->GetArmIndices().size()), vsolfree;
         // find the first valid solution that satisfies joint constraints and collisions
@@ -1162,7 +1567,6 @@ protected:
         }
 
         int allres = IKRA_Reject;
-        IkParameterization paramnewglobal; // needs to be initialized by _ValidateSolutionSingle so we get most accurate result back
         FOREACH(itindex,vsolutionorder) {
             const ikfast::IkSolution<IkReal>& iksol = dynamic_cast<const ikfast::IkSolution<IkReal>& >(solutions.GetSolution(*itindex));
             IkReturnAction res;
@@ -1186,16 +1590,6 @@ protected:
                 break;
             }
         }
-
-        // return as soon as a solution is found, since we're visiting phis starting from q0, we are guaranteed
-        // that the solution will be close (ie, phi's dominate in the search). This is to speed things up
-        if( !!bestsolution.ikreturn ) {
-            if( !!ikreturn ) {
-                *ikreturn = *bestsolution.ikreturn;
-            }
-            _CallFinishCallbacks(bestsolution.ikreturn, pmanip, paramnewglobal);
-            return bestsolution.ikreturn->_action;
-        }
         return static_cast<IkReturnAction>(allres);
     }
 
@@ -1578,34 +1972,139 @@ protected:
     IkReturnAction _SolveAll(const IkParameterization& param, const vector<IkReal>& vfree, int filteroptions, std::vector<IkReturnPtr>& vikreturns, StateCheckEndEffector& stateCheck)
     {
         RobotBase::ManipulatorPtr pmanip(_pmanip);
-        RobotBasePtr probot = pmanip->GetRobot();
         ikfast::IkSolutionList<IkReal> solutions;
         if( _CallIk(param,vfree, pmanip->GetLocalToolTransform(), solutions) ) {
-            vector<IkReal> vsolfree;
-            std::vector<IkReal> sol(pmanip->GetArmIndices().size());
-            for(size_t isolution = 0; isolution < solutions.GetNumSolutions(); ++isolution) {
-                const ikfast::IkSolution<IkReal>& iksol = dynamic_cast<const ikfast::IkSolution<IkReal>& >(solutions.GetSolution(isolution));
-                iksol.Validate();
-                if( iksol.GetFree().size() > 0 ) {
-                    // have to search over all the free parameters of the solution!
-                    vsolfree.resize(iksol.GetFree().size());
-                    std::vector<dReal> vFreeInc(_GetFreeIncFromIndices(iksol.GetFree()));
-                    IkReturnAction retaction = ComposeSolution(iksol.GetFree(), vsolfree, 0, vector<dReal>(), boost::bind(&IkFastSolver::_ValidateSolutionAll,shared_solver(), boost::ref(param), boost::ref(iksol), boost::ref(vsolfree), filteroptions, boost::ref(sol), boost::ref(vikreturns), boost::ref(stateCheck)), vFreeInc);
-                    if( retaction & IKRA_Quit) {
-                        return retaction;
-                    }
+            return _ValidateSolutionListAll(param, solutions, filteroptions, vikreturns, stateCheck);
+        }
+        return IKRA_Reject; // signals to continue
+    }
+
+    /// \brief validates all the solutions _CallIk returned for one set of free values
+    ///
+    /// \return IKRA_Reject to continue the search, IKRA_Success if _nMaxSolutions are found, or an action with IKRA_Quit
+    IkReturnAction _ValidateSolutionListAll(const IkParameterization& param, const ikfast::IkSolutionList<IkReal>& solutions, int filteroptions, std::vector<IkReturnPtr>& vikreturns, StateCheckEndEffector& stateCheck)
+    {
+        RobotBase::ManipulatorPtr pmanip(_pmanip);
+        vector<IkReal> vsolfree;
+        std::vector<IkReal> sol(pmanip->GetArmIndices().size());
+        for(size_t isolution = 0; isolution < solutions.GetNumSolutions(); ++isolution) {
+            const ikfast::IkSolution<IkReal>& iksol = dynamic_cast<const ikfast::IkSolution<IkReal>& >(solutions.GetSolution(isolution));
+            iksol.Validate();
+            if( iksol.GetFree().size() > 0 ) {
+                // have to search over all the free parameters of the solution!
+                vsolfree.resize(iksol.GetFree().size());
+                std::vector<dReal> vFreeInc(_GetFreeIncFromIndices(iksol.GetFree()));
+                IkReturnAction retaction = ComposeSolution(iksol.GetFree(), vsolfree, 0, vector<dReal>(), boost::bind(&IkFastSolver::_ValidateSolutionAll,shared_solver(), boost::ref(param), boost::ref(iksol), boost::ref(vsolfree), filteroptions, boost::ref(sol), boost::ref(vikreturns), boost::ref(stateCheck)), vFreeInc);
+                if( retaction & IKRA_Quit) {
+                    return retaction;
                 }
-                else {
-                    IkReturnAction retaction = _ValidateSolutionAll(param, iksol, vector<IkReal>(), filteroptions, sol, vikreturns, stateCheck);
-                    if( retaction & IKRA_Quit ) {
-                        return retaction;
-                    }
+            }
+            else {
+                IkReturnAction retaction = _ValidateSolutionAll(param, iksol, vector<IkReal>(), filteroptions, sol, vikreturns, stateCheck);
+                if( retaction & IKRA_Quit ) {
+                    return retaction;
                 }
             }
+            if( _nMaxSolutions > 0 && (int)vikreturns.size() >= _nMaxSolutions ) {
+                return IKRA_Success; // stops the free parameter search
+            }
         }
         return IKRA_Reject; // signals to continue
     }
 
+    /// \brief calls _SolveAll for every value of the free parameters in the order ComposeSolution visits them
+    ///
+    /// If SetFreeSweepThreads was called, the ik of blocks of free values is computed by the worker threads. Only the numeric ik runs on the
+    /// workers, the solutions are validated (filters and collisions) by the calling thread in the sequential order, so the results do not change.
+    IkReturnAction _SweepFreeParameters(const IkParameterization& param, vector<IkReal>& vfree, int filteroptions, std::vector<IkReturnPtr>& vikreturns, StateCheckEndEffector& stateCheck)
+    {
+        if( _vfreeparams.size() == 0 || !_pFreeSweepWorkers ) {
+            return ComposeSolution(_vfreeparams, vfree, 0, vector<dReal>(), boost::bind(&IkFastSolver::_SolveAll,shared_solver(), boost::cref(param),boost::ref(vfree),filteroptions,boost::ref(vikreturns), boost::ref(stateCheck)), _vFreeInc);
+        }
+
+        // the buffers are local since filters can call into this solver again
+        std::vector<IkReal> vfreevalues;
+        ComposeSolution(_vfreeparams, vfree, 0, vector<dReal>(), boost::bind(&IkFastSolver::_RecordFreeValues, boost::cref(vfree), boost::ref(vfreevalues)), _vFreeInc);
+        size_t numfree = _vfreeparams.size(), numsweep = vfreevalues.size()/numfree;
+        RobotBase::ManipulatorPtr pmanip(_pmanip);
+        Transform tLocalTool = pmanip->GetLocalToolTransform();
+        size_t blocksize = 4*_pFreeSweepWorkers->GetNumThreads();
+        std::vector< ikfast::IkSolutionList<IkReal> > vsolutions(blocksize);
+        std::vector<uint8_t> vsuccess(blocksize);
+        for(size_t blockstart = 0; blockstart < numsweep; blockstart += blocksize) {
+            size_t num = min(blocksize, numsweep-blockstart);
+            _pFreeSweepWorkers->Run(num, boost::bind(&IkFastSolver::_CallIkRange, this, boost::cref(param), boost::cref(tLocalTool), boost::cref(vfreevalues), blockstart, boost::ref(vsolutions), boost::ref(vsuccess), _1, _2));
+            for(size_t i = 0; i < num; ++i) {
+                if( !vsuccess[i] ) {
+                    continue;
+                }
+                IkReturnAction retaction = _ValidateSolutionListAll(param, vsolutions[i], filteroptions, vikreturns, stateCheck);
+                if( !(retaction & IKRA_Reject) || (retaction & IKRA_Quit) ) {
+                    return retaction;
+                }
+            }
+        }
+        return IKRA_Reject;
+    }
+
+    static IkReturnAction _RecordFreeValues(const vector<IkReal>& vfree, std::vector<IkReal>& vfreevalues)
+    {
+        vfreevalues.insert(vfreevalues.end(), vfree.begin(), vfree.end());
+        return IKRA_Reject; // visit all values
+    }
+
+    /// \brief computes the ik of the free values blockstart+[start,end) of vfreevalues, called from the free sweep workers
+    ///
+    /// If the ik library exports ComputeIkBatch and there is no solution cache, Transform6D queries pass the whole range in one call with the free values in structure-of-arrays layout.
+    void _CallIkRange(const IkParameterization& param, const Transform& tLocalTool, const std::vector<IkReal>& vfreevalues, size_t blockstart, std::vector< ikfast::IkSolutionList<IkReal> >& vsolutions, std::vector<uint8_t>& vsuccess, size_t start, size_t end)
+    {
+        size_t numfree = _vfreeparams.size();
+        // with the solution cache, every free value has to go through _CallIk
+        if( !!_ikfunctions->_ComputeIkBatch && !_psolutioncache && param.GetType() == IKP_Transform6D && end > start ) {
+            TransformMatrix t = param.GetTransform6D();
+            if( _bEmptyTransform6D ) {
+                t = t * tLocalTool.inverse();
+            }
+            IkReal eetrans[3] = {t.trans.x, t.trans.y, t.trans.z};
+            IkReal eerot[9] = {t.m[0],t.m[1],t.m[2],t.m[4],t.m[5],t.m[6],t.m[8],t.m[9],t.m[10]};
+            size_t numsamples = end-start;
+            std::vector<IkReal> vfreesoa(numfree*numsamples);
+            std::vector<ikfast::IkSolutionListBase<IkReal>*> vpsolutions(numsamples);
+            for(size_t i = 0; i < numsamples; ++i) {
+                for(size_t ifree = 0; ifree < numfree; ++ifree) {
+                    vfreesoa[ifree*numsamples+i] = vfreevalues[(blockstart+start+i)*numfree+ifree];
+                }
+                vsolutions[start+i].Clear();
+                vpsolutions[i] = &vsolutions[start+i];
+            }
+            try {
+                _ikfunctions->_ComputeIkBatch(eetrans, eerot, vfreesoa.size() > 0 ? &vfreesoa[0] : NULL, (int)numsamples, &vpsolutions[0]);
+                for(size_t i = start; i < end; ++i) {
+                    vsuccess[i] = vsolutions[i].GetNumSolutions() > 0;
+                }
+            }
+            catch(const std::exception& e) {
+                RAVELOG_WARN(str(boost::format("batch ik call failed for ik %s:0x%x: %s")%GetXMLId()%param.GetType()%e.what()));
+                std::fill(vsuccess.begin()+start, vsuccess.begin()+end, 0);
+            }
+            return;
+        }
+        std::vector<IkReal> vfree(numfree);
+        for(size_t i = start; i < end; ++i) {
+            std::copy(vfreevalues.begin()+(blockstart+i)*numfree, vfreevalues.begin()+(blockstart+i+1)*numfree, vfree.begin());
+            vsolutions[i].Clear();
+            vsuccess[i] = _CallIk(param, vfree, tLocalTool, vsolutions[i]);
+        }
+    }
+
+    /// \brief keeps the first _nMaxSolutions solutions
+    inline void _TruncateSolutions(std::vector<IkReturnPtr>& vikreturns) const
+    {
+        if( _nMaxSolutions > 0 && (int)vikreturns.size() > _nMaxSolutions ) {
+            vikreturns.resize(_nMaxSolutions);
+        }
+    }
+
     IkReturnAction _ValidateSolutionAll(const IkParameterization& param, const ikfast::IkSolution<IkReal>& iksol, const vector<IkReal>& vfree, int filteroptions, std::vector<IkReal>& sol, std::vector<IkReturnPtr>& vikreturns, StateCheckEndEffector& stateCheck)
     {
         iksol.GetSolution(sol,vfree);
@@ -1894,16 +2393,30 @@ protected:
         }
     }
 
-    void _SortSolutions(RobotBasePtr probot, std::vector<IkReturnPtr>& vikreturns)
+    /// \brief inverse weights of the active dofs used by _SortSolutions
+    void _GetSortWeights(RobotBasePtr probot, std::vector<dReal>& viweights)
     {
-        // sort with respect to how far it is from limits
-        vector< pair<size_t, dReal> > vdists; vdists.resize(vikreturns.size());
-        vector<dReal> v;
-        vector<dReal> viweights; viweights.reserve(probot->GetActiveDOF());
+        viweights.resize(0);
+        viweights.reserve(probot->GetActiveDOF());
         FOREACHC(it, probot->GetActiveDOFIndices()) {
             KinBody::JointPtr pjoint = probot->GetJointFromDOFIndex(*it);
             viweights.push_back(1/pjoint->GetWeight(*it-pjoint->GetDOFIndex()));
         }
+    }
+
+    void _SortSolutions(RobotBasePtr probot, std::vector<IkReturnPtr>& vikreturns)
+    {
+        vector<dReal> viweights;
+        _GetSortWeights(probot, viweights);
+        _SortSolutions(probot, viweights, vikreturns);
+    }
+
+    /// \param viweights the inverse dof weights from _GetSortWeights
+    void _SortSolutions(RobotBasePtr probot, const std::vector<dReal>& viweights, std::vector<IkReturnPtr>& vikreturns)
+    {
+        // sort with respect to how far it is from limits
+        vector< pair<size_t, dReal> > vdists; vdists.resize(vikreturns.size());
+        vector<dReal> v;
 
         for(size_t i = 0; i < vdists.size(); ++i) {
             v = vikreturns[i]->_vsolution;
@@ -1996,6 +2509,13 @@ protected:
     int _nSameStateRepeatCount;
     //@}
 
+    int _nBatchThreads; ///< number of threads SolveAllBatch uses, see SetBatchThreads
+    std::vector<EnvironmentBasePtr> _vBatchEnvs; ///< environment snapshots of the SolveAllBatch threads, kept between calls so only the changed bodies are copied
+    ParallelRangeWorkersPtr _pFreeSweepWorkers; ///< if set, computes the ik of the free parameter values of SolveAll in parallel, see SetFreeSweepThreads
+    int _nMaxSolutions; ///< if > 0, SolveAll stops after finding this many solutions, see SetMaxSolutions
+    bool _bSearchClosestSolution; ///< if true, Solve with a seed returns the closest solution over all free values, see SetClosestSolutionSearch
+    boost::shared_ptr<SolutionCache> _psolutioncache; ///< if set, the analytic solutions of _CallIk are reused, see SetSolutionCache
+
     bool _bEmptyTransform6D; ///< if true, then the iksolver has been built with identity of the manipulator transform. Only valid for Transform6D IKs.
     
 };
@@ -18,18 +18,13 @@
 
 #include "plugindefs.h"
 
-#ifdef OPENRAVE_HAS_LAPACK
-
-#include <boost/numeric/ublas/vector.hpp>
-#include <boost/numeric/ublas/vector_proxy.hpp>
-#include <boost/numeric/ublas/matrix.hpp>
-#include <boost/numeric/ublas/triangular.hpp>
-#include <boost/numeric/ublas/lu.hpp>
-#include <boost/numeric/ublas/io.hpp>
-
 namespace ikfastsolvers {
 
 /// \brief inverse jacobian solver. although uses RobotBase::Manipulator, should not hold a shared pointer of it
+///
+/// Every iteration solves the damped least squares step dq = J^T (J J^T + lambda I)^-1 e. J J^T is always 6x6 regardless of the arm dof,
+/// so it is factored in place with a fixed size Cholesky decomposition, and the 6xN jacobian is kept in a buffer sized once by Init.
+/// Nothing is allocated inside the iterations.
 template <typename T>
 class JacobianInverseSolver
 {
@@ -59,9 +54,8 @@ public:
     {
         RobotBasePtr probot = manip.GetRobot();
 
-        _J.resize(6,probot->GetActiveDOF());
-        _invJJt.resize(6,6);
-        _error.resize(6,1);
+        _J.resize(6*manip.GetArmIndices().size());
+        _qdelta.resize(manip.GetArmIndices().size());
 
         _viweights.resize(manip.GetArmIndices().size(),0);
         for(size_t i = 0; i < _viweights.size(); ++i) {
@@ -111,7 +105,6 @@ public:
         }
         
         const T lambda2 = 1e-16;         // normalization constant
-        using namespace boost::numeric::ublas;
 
         T firsterror2 = totalerror2;
         _lasterror2 = totalerror2;
@@ -145,70 +138,54 @@ public:
             _lasterror2 = totalerror2;
 
             // compute jacobians, make sure to transform by the world frame
-            manip.CalculateAngularVelocityJacobian(_vjacobian); // doesn't work well...
-            for(size_t j = 0; j < _viweights.size(); ++j) {
-                Vector v = Vector(_vjacobian[j],_vjacobian[armdof+j],_vjacobian[2*armdof+j]);
-                _J(0,j) = v[0]*_viweights[j];
-                _J(1,j) = v[1]*_viweights[j];
-                _J(2,j) = v[2]*_viweights[j];
+            manip.CalculateJacobians(_vjacobian); // angular velocity part doesn't work well...
+            const size_t ndof = _viweights.size();
+            for(size_t j = 0; j < ndof; ++j) {
+                _J[0*ndof+j] = _vjacobian[3*armdof+j]*_viweights[j];
+                _J[1*ndof+j] = _vjacobian[4*armdof+j]*_viweights[j];
+                _J[2*ndof+j] = _vjacobian[5*armdof+j]*_viweights[j];
+                _J[3*ndof+j] = _vjacobian[j]*_viweights[j];
+                _J[4*ndof+j] = _vjacobian[armdof+j]*_viweights[j];
+                _J[5*ndof+j] = _vjacobian[2*armdof+j]*_viweights[j];
             }
-            manip.CalculateJacobian(_vjacobian);
-            for(size_t j = 0; j < _viweights.size(); ++j) {
-                Vector v = Vector(_vjacobian[j],_vjacobian[armdof+j],_vjacobian[2*armdof+j]);
-                _J(0+3,j) = v[0]*_viweights[j];
-                _J(1+3,j) = v[1]*_viweights[j];
-                _J(2+3,j) = v[2]*_viweights[j];
-            }
-            // pseudo inverse of jacobian
-            _Jt = trans(_J);
-            _invJJt = prod(_J,_Jt);
+            // pseudo inverse of jacobian, only the lower triangle of the symmetric J*J^T is needed
             for(int i = 0; i < 6; ++i) {
-                _invJJt(i,i) += lambda2;
-            }
-            try {
-                if( !_InvertMatrix(_invJJt,_invJJt) ) {
-                    RAVELOG_VERBOSE("failed to invert matrix\n");
-                    iter = -1;
-                    break;
+                const T* pJi = &_J[i*ndof];
+                for(int k = 0; k <= i; ++k) {
+                    const T* pJk = &_J[k*ndof];
+                    T f = 0;
+                    for(size_t j = 0; j < ndof; ++j) {
+                        f += pJi[j]*pJk[j];
+                    }
+                    _JJt[i][k] = f;
                 }
+                _JJt[i][i] += lambda2;
             }
-            catch(const std::exception& ex) {
-                RAVELOG_VERBOSE_FORMAT("got exception during constraining, perhaps matix is singular: %s", ex.what());
-                iter = -1;
-                break;
-            }
-            catch(...) {
-                RAVELOG_WARN("got unknown exception during constraining\n");
+            T y[6];
+            if( !_SolveCholesky6(_JJt, _error, y) ) {
+                RAVELOG_VERBOSE("failed to invert matrix\n");
                 iter = -1;
                 break;
             }
-            _invJ = prod(_Jt,_invJJt);
-            _qdelta = prod(_invJ,_error);
-            dReal fmindeltascale = 1.0; // depending on
             bool baddelta = false;
-            for(size_t i = 0; i < vnew.size(); ++i) {
-                if(!isfinite(_qdelta(i,0))) { // don't assert since it is frequent and could destroy the entire plan
-                    RAVELOG_WARN_FORMAT("inverse matrix produced a non-finite value: %e", _qdelta(i,0));
+            for(size_t j = 0; j < ndof; ++j) {
+                T f = 0;
+                for(int i = 0; i < 6; ++i) {
+                    f += _J[i*ndof+j]*y[i];
+                }
+                if(!isfinite(f)) { // don't assert since it is frequent and could destroy the entire plan
+                    RAVELOG_WARN_FORMAT("inverse matrix produced a non-finite value: %e", f);
                     baddelta = true;
                     break;
                 }
-
-                dReal f = _qdelta(i,0)*_viweights.at(i);
-                _qdelta(i,0) = f;
+                _qdelta[j] = f*_viweights[j];
             }
             if( baddelta ) {
                 break;
             }
-            
-            if( fmindeltascale < 1 ) {
-                for(size_t i = 0; i < vnew.size(); ++i) {
-                    vnew.at(i) += _qdelta(i,0)*fmindeltascale;
-                }
-            }
-            else {
-                for(size_t i = 0; i < vnew.size(); ++i) {
-                    vnew.at(i) += _qdelta(i,0);
-                }
+
+            for(size_t j = 0; j < ndof; ++j) {
+                vnew.at(j) += _qdelta[j];
             }
 
             probot->SetActiveDOFValues(vnew,0);
@@ -235,17 +212,17 @@ public:
         return retcode;
     }
 
-    virtual T _ComputeConstraintError(const Transform& tcur, boost::numeric::ublas::matrix<T>& error, int nMaxIterations)
+    virtual T _ComputeConstraintError(const Transform& tcur, T error[6], int nMaxIterations)
     {
         T totalerror2=0;
         const Vector axisangleerror = axisAngleFromQuat(quatMultiply(_vGoalQuat, quatInverse(tcur.rot)));
         for(int i = 0; i < 3; ++i) {
-            error(i,0) = axisangleerror[i];
-            totalerror2 += error(i,0)*error(i,0);
+            error[i] = axisangleerror[i];
+            totalerror2 += error[i]*error[i];
         }
         for(int i = 0; i < 3; ++i) {
-            error(i+3,0) = (_vGoalPosition[i]-tcur.trans[i]);
-            totalerror2 += error(i+3,0)*error(i+3,0);
+            error[i+3] = (_vGoalPosition[i]-tcur.trans[i]);
+            totalerror2 += error[i+3]*error[i+3];
         }
         dReal fallowableerror2 = 0.03; // arbitrary... since solutions are close, is this step necessary?
         if( totalerror2 > _errorthresh2 && totalerror2 > fallowableerror2+1e-7 ) {
@@ -257,29 +234,51 @@ public:
             }
             T fiscale = 1/fscale;
             for(int i = 0; i < 6; ++i) {
-                error(i,0) *= fiscale;
+                error[i] *= fiscale;
             }
         }
         return totalerror2;
     }
 
-    // Matrix inversion routine. Uses lu_factorize and lu_substitute in uBLAS to invert a matrix */
-    static bool _InvertMatrix(const boost::numeric::ublas::matrix<T>& input, boost::numeric::ublas::matrix<T>& inverse) {
-        using namespace boost::numeric::ublas;
-        matrix<T> A(input);         // create a working copy of the input
-        permutation_matrix<std::size_t> pm(A.size1());         // create a permutation matrix for the LU-factorization
-        int res = lu_factorize(A,pm);         // perform LU-factorization
-        if( res != 0 )
-            return false;
-
-        inverse.assign(identity_matrix<T>(A.size1()));         // create identity matrix of "inverse"
-        for(size_t i = 0; i < A.size1(); ++i) {
-            if( RaveFabs(A(i,i)) < 1e-8 ) {
+    /// \brief solves A*y = b for the symmetric positive definite 6x6 A with a Cholesky decomposition
+    ///
+    /// Only the lower triangle of A is read, A is overwritten with its factor.
+    /// \return false if a pivot is too small, in which case the jacobian is most likely singular
+    static bool _SolveCholesky6(T A[6][6], const T b[6], T y[6])
+    {
+        for(int i = 0; i < 6; ++i) {
+            for(int k = 0; k < i; ++k) {
+                T f = A[i][k];
+                for(int j = 0; j < k; ++j) {
+                    f -= A[i][j]*A[k][j];
+                }
+                A[i][k] = f/A[k][k];
+            }
+            T d = A[i][i];
+            for(int j = 0; j < i; ++j) {
+                d -= A[i][j]*A[i][j];
+            }
+            if( !(d >= 1e-8) ) {
                 // most likely matrix is singular, so fail!
                 return false;
             }
+            A[i][i] = sqrt(d);
+        }
+        // forward substitution with L, then backward with L^T
+        for(int i = 0; i < 6; ++i) {
+            T f = b[i];
+            for(int j = 0; j < i; ++j) {
+                f -= A[i][j]*y[j];
+            }
+            y[i] = f/A[i][i];
+        }
+        for(int i = 5; i >= 0; --i) {
+            T f = y[i];
+            for(int j = i+1; j < 6; ++j) {
+                f -= A[j][i]*y[j];
+            }
+            y[i] = f/A[i][i];
         }
-        lu_substitute(A, pm, inverse);         // backsubstitute to get the inverse
         return true;
     }
 
@@ -304,7 +303,10 @@ protected:
     std::vector<dReal> _viweights, _vcachevalues;
     T _errorthresh2;
     std::vector<dReal> _vjacobian;
-    boost::numeric::ublas::matrix<T> _J, _Jt, _invJJt, _invJ, _error, _qdelta;
+    std::vector<T> _J; ///< 6xN weighted jacobian, row major
+    std::vector<T> _qdelta; ///< step of the arm dof
+    T _JJt[6][6]; ///< damped J*J^T, overwritten by its Cholesky factor
+    T _error[6];
     std::vector<dReal> _cachevnew; ///< cache
     dReal _fTighterCosAngleThresh; ///< if _pdirthresh is used, then this is a smaller angle than the one used in _pdirthresh->fCosAngleThresh
 };
@@ -312,5 +314,3 @@ protected:
 } // end namespace ikfastsolvers
 
 #endif
-
-#endif
@@ -0,0 +1,76 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2014 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef OPENRAVE_PLUGIN_PARALLELRANGEWORKERS_H
+#define OPENRAVE_PLUGIN_PARALLELRANGEWORKERS_H
+
+#include <vector>
+#include <string>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <openrave/utils.h>
+
+/// \brief splits a range of independent jobs between the calling thread and the process-wide thread pool, see \ref OpenRAVE::utils::ThreadPoolTaskGroup
+///
+/// Used by the rplanners SpatialTree for evaluating the distances of big cover tree levels in parallel, by the parabolic smoother for checking
+/// shortcut candidates on environment snapshots, by the ikfast solvers for sweeping free parameters, and by the core environment for transforming
+/// the meshes of TriangulateScene. A job can only call into an environment that no other job uses.
+/// The range is always split in the same chunks, so the results do not depend on how many workers the pool has.
+class ParallelRangeWorkers
+{
+public:
+    typedef boost::function<void(size_t, size_t)> RangeFn; ///< evaluates jobs [start, end)
+
+    /// \param numthreads the number of chunks the range is split into
+    /// \param tasktype the name the chunks are aggregated under in the thread pool statistics
+    ParallelRangeWorkers(int numthreads, const std::string& tasktype="ParallelRangeWorkers") : _numthreads(std::max(numthreads, 1)), _tasktype(tasktype) {
+    }
+    virtual ~ParallelRangeWorkers() {
+    }
+
+    /// \brief the number of threads evaluating the jobs including the calling thread
+    inline int GetNumThreads() const {
+        return _numthreads;
+    }
+
+    /// \brief evaluates fn on [0,num) and returns when all the jobs are done
+    ///
+    /// \param cancelfn if set, it is polled by the calling thread and the chunks that did not start are skipped once it returns true, e.g. when the planner was interrupted
+    void Run(size_t num, const RangeFn& fn, const boost::function<bool()>& cancelfn=boost::function<bool()>())
+    {
+        OpenRAVE::utils::ThreadPoolTaskGroup group(_tasktype, cancelfn);
+        for(int ithread = 1; ithread < _numthreads; ++ithread) {
+            size_t start = (num*ithread)/_numthreads, end = (num*(ithread+1))/_numthreads;
+            if( start < end ) {
+                group.Submit(boost::bind(fn, start, end));
+            }
+        }
+        size_t end = num/_numthreads;
+        if( end > 0 && (!cancelfn || !cancelfn()) ) {
+            fn(0, end);
+        }
+        group.Wait();
+    }
+
+private:
+    int _numthreads;
+    std::string _tasktype;
+};
+
+typedef boost::shared_ptr<ParallelRangeWorkers> ParallelRangeWorkersPtr;
+
+#endif
@@ -18,6 +18,8 @@
 #include "plugindefs.h"
 #include <openrave/plugin.h>
 
+ModuleBasePtr CreateStateRecorder(EnvironmentBasePtr penv, std::istream& sinput);
+
 #ifdef ENABLE_VIDEORECORDING
 ModuleBasePtr CreateViewerRecorder(EnvironmentBasePtr penv, std::istream& sinput);
 void DestroyViewerRecordingStaticResources();
@@ -27,6 +29,9 @@ InterfaceBasePtr CreateInterfaceValidated(InterfaceType type, const std::string&
 {
     switch(type) {
     case OpenRAVE::PT_Module:
+        if( interfacename == "staterecorder" ) {
+            return CreateStateRecorder(penv,sinput);
+        }
 #ifdef ENABLE_VIDEORECORDING
         if( interfacename == "viewerrecorder" ) {
             return CreateViewerRecorder(penv,sinput);
@@ -41,6 +46,7 @@ InterfaceBasePtr CreateInterfaceValidated(InterfaceType type, const std::string&
 
 void GetPluginAttributesValidated(PLUGININFO& info)
 {
+    info.interfacenames[OpenRAVE::PT_Module].push_back("StateRecorder");
 #ifdef ENABLE_VIDEORECORDING
     info.interfacenames[OpenRAVE::PT_Module].push_back("ViewerRecorder");
 #endif
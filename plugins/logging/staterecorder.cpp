@@ -0,0 +1,649 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2011 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "plugindefs.h"
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include <set>
+#include <cstring>
+
+/** \brief Records the transforms and dof values of all the bodies into a binary log, and restores the environment to any recorded time.
+
+    The log is a sequence of independent chunks. The first frame of every chunk holds the state of all the bodies, the following frames only
+    the bodies whose KinBody::GetUpdateStamp changed. A body name is only stored the first time the body appears in a chunk. When the recording
+    is stopped, an index of the chunks is appended so that the replay can seek directly to the chunk of a time. Logs that were not stopped
+    cleanly are indexed by scanning the chunk headers. All values are stored in the native byte order.
+
+    Layout::
+
+      header: "ORSTLOG1"
+      chunk: uint32 'CHNK', uint32 numframes, uint64 starttime, uint64 endtime, uint64 payloadsize, payload
+      frame: uint64 stamp, uint32 numrecords, records
+      record: int32 envid, uint8 flags (1 has name, 2 removed), [uint32 namesize, name], [double[7] quaternion and translation, uint32 dof, double[dof] values]
+      index: uint32 'INDX', uint64 numchunks, (uint64 offset, uint64 starttime, uint64 endtime) per chunk
+      footer: uint64 indexoffset, uint32 'ENDX'
+ */
+class StateRecorder : public ModuleBase
+{
+    enum RecordFlags
+    {
+        RF_Name = 1,
+        RF_Removed = 2,
+    };
+
+    static const uint32_t s_nChunkMagic = 0x4b4e4843; // CHNK
+    static const uint32_t s_nIndexMagic = 0x58444e49; // INDX
+    static const uint32_t s_nFooterMagic = 0x58444e45; // ENDX
+
+    /// \brief frames of one chunk serialized in memory, written by the write thread
+    struct StateChunk
+    {
+        StateChunk() : numframes(0), starttime(0), endtime(0) {
+        }
+        std::vector<uint8_t> vdata;
+        uint32_t numframes;
+        uint64_t starttime, endtime;
+    };
+    typedef boost::shared_ptr<StateChunk> StateChunkPtr;
+
+    struct ChunkIndex
+    {
+        uint64_t offset, starttime, endtime;
+    };
+
+    /// \brief state of a body in the replay
+    struct ReplayBodyState
+    {
+        std::string name;
+        Transform t;
+        std::vector<dReal> vdofvalues;
+    };
+
+public:
+    StateRecorder(EnvironmentBasePtr penv, std::istream& sinput) : ModuleBase(penv)
+    {
+        __description = ":Interface Author: Rosen Diankov\n\nRecords the transforms and dof values of all bodies at every simulation step into a chunked binary log, and restores the environment to any recorded time. Only the bodies whose update stamp changed are stored in each frame. The module has to be added to the environment in order to record the simulation steps.";
+        RegisterCommand("Start",boost::bind(&StateRecorder::_StartCommand,this,_1,_2),
+                        "Starts recording into a file, this will stop any previous recording and overwrite the file. Format::\n\n  Start chunkframes [numframes] queuesize [maxchunks] interval [microseconds] timing [simtime/realtime] filename [filename]\\n\n\nchunkframes is the number of frames per chunk (default is 1000), the first frame of a chunk stores all bodies. queuesize bounds the chunks waiting to be written (default is 8), new chunks are dropped when it is full. interval is the minimum time between two frames (default is 0, every simulation step).");
+        RegisterCommand("Stop",boost::bind(&StateRecorder::_StopCommand,this,_1,_2),
+                        "Stops recording, writes the remaining chunks and the index. Format::\n\n  Stop\n\n");
+        RegisterCommand("Capture",boost::bind(&StateRecorder::_CaptureCommand,this,_1,_2),
+                        "Records a frame of the current environment state even if the simulation is not running. Format::\n\n  Capture\n\n");
+        RegisterCommand("GetDroppedChunks",boost::bind(&StateRecorder::_GetDroppedChunksCommand,this,_1,_2),
+                        "Returns the number of chunks dropped since the last Start because the writing could not keep up. Format::\n\n  GetDroppedChunks\n\n");
+        RegisterCommand("Load",boost::bind(&StateRecorder::_LoadCommand,this,_1,_2),
+                        "Opens a log for replay. Format::\n\n  Load [filename]\n\n");
+        RegisterCommand("GetTimeRange",boost::bind(&StateRecorder::_GetTimeRangeCommand,this,_1,_2),
+                        "Returns the first and last time stamps of the loaded log. Format::\n\n  GetTimeRange\n\n");
+        RegisterCommand("Restore",boost::bind(&StateRecorder::_RestoreCommand,this,_1,_2),
+                        "Sets the transforms and dof values of the bodies to their recorded state at the last frame at or before the time stamp. Bodies are matched by name, bodies that are not in the environment are ignored. Format::\n\n  Restore [timestamp]\n\n");
+        _bContinueThread = false;
+        _bRecording = false;
+        _nChunkFrames = 1000;
+        _nMaxQueuedChunks = 8;
+        _nDroppedChunks = 0;
+        _nInterval = 0;
+        _nLastFrameTime = 0;
+        _bHasLastFrame = false;
+        _bUseSimulationTime = true;
+    }
+
+    virtual ~StateRecorder()
+    {
+        RAVELOG_VERBOSE("~StateRecorder\n");
+        _Reset();
+    }
+
+    virtual void Destroy() {
+        _Reset();
+    }
+
+    virtual bool SimulationStep(dReal fElapsedTime)
+    {
+        if( _bRecording ) {
+            _CaptureFrame(false);
+        }
+        return false;
+    }
+
+protected:
+    bool _StartCommand(ostream& sout, istream& sinput)
+    {
+        EnvironmentMutex::scoped_lock lockenv(GetEnv()->GetMutex()); // frames are captured with the environment locked
+        _Reset();
+        string filename;
+        string cmd;
+        while(!sinput.eof()) {
+            sinput >> cmd;
+            if( !sinput ) {
+                break;
+            }
+            std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
+            if( cmd == "chunkframes" ) {
+                sinput >> _nChunkFrames;
+                _nChunkFrames = max(_nChunkFrames, (uint32_t)1);
+            }
+            else if( cmd == "queuesize" ) {
+                sinput >> _nMaxQueuedChunks;
+                _nMaxQueuedChunks = max(_nMaxQueuedChunks, (size_t)1);
+            }
+            else if( cmd == "interval" ) {
+                sinput >> _nInterval;
+            }
+            else if( cmd == "timing" ) {
+                string type;
+                sinput >> type;
+                if( type == "simtime" ) {
+                    _bUseSimulationTime = true;
+                }
+                else if( type == "realtime" ) {
+                    _bUseSimulationTime = false;
+                }
+                else {
+                    RAVELOG_WARN_FORMAT("unknown timing %s", type);
+                }
+            }
+            else if( cmd == "filename" ) {
+                if( !getline(sinput, filename) ) {
+                    return false;
+                }
+                boost::trim(filename);
+            }
+            else {
+                return false;
+            }
+            if( sinput.fail() || !sinput ) {
+                break;
+            }
+        }
+        if( filename.size() == 0 ) {
+            RAVELOG_WARN("need a filename to record to\n");
+            return false;
+        }
+
+        _ofile.open(filename.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+        if( !_ofile ) {
+            RAVELOG_WARN_FORMAT("failed to open %s for recording", filename);
+            return false;
+        }
+        _ofile.write("ORSTLOG1", 8);
+        _vWrittenChunks.resize(0);
+        _nDroppedChunks = 0;
+        _bHasLastFrame = false;
+        _mapLastStamps.clear();
+        _setChunkNames.clear();
+        _pcurchunk.reset();
+        _bContinueThread = true;
+        _threadwrite.reset(new boost::thread(boost::bind(&StateRecorder::_WriteThread,this)));
+        _bRecording = true;
+        RAVELOG_INFO_FORMAT("recording environment state to %s, %d frames per chunk", filename%_nChunkFrames);
+        return true;
+    }
+
+    bool _StopCommand(ostream& sout, istream& sinput)
+    {
+        EnvironmentMutex::scoped_lock lockenv(GetEnv()->GetMutex());
+        _Reset();
+        return true;
+    }
+
+    bool _CaptureCommand(ostream& sout, istream& sinput)
+    {
+        if( !_bRecording ) {
+            return false;
+        }
+        EnvironmentMutex::scoped_lock lockenv(GetEnv()->GetMutex());
+        _CaptureFrame(true);
+        return true;
+    }
+
+    bool _GetDroppedChunksCommand(ostream& sout, istream& sinput)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        sout << _nDroppedChunks;
+        return true;
+    }
+
+    /// \brief stops the recording, the chunks still in memory are written before the index
+    void _Reset()
+    {
+        if( !_bRecording ) {
+            return;
+        }
+        _bRecording = false;
+        {
+            boost::mutex::scoped_lock lock(_mutex);
+            if( !!_pcurchunk && _pcurchunk->numframes > 0 ) {
+                _listQueuedChunks.push_back(_pcurchunk);
+            }
+            _pcurchunk.reset();
+            _bContinueThread = false;
+            _condnewchunk.notify_all();
+        }
+        if( !!_threadwrite ) {
+            _threadwrite->join();
+            _threadwrite.reset();
+        }
+        _WriteIndex();
+        _ofile.close();
+    }
+
+    /// \brief serializes the bodies that changed since the last frame into the current chunk, the environment has to be locked
+    void _CaptureFrame(bool bForce)
+    {
+        uint64_t stamp = _bUseSimulationTime ? GetEnv()->GetSimulationTime() : utils::GetMicroTime();
+        if( !bForce && _bHasLastFrame && stamp < _nLastFrameTime + _nInterval ) {
+            return;
+        }
+        _bHasLastFrame = true;
+        _nLastFrameTime = stamp;
+
+        if( !_pcurchunk ) {
+            _pcurchunk.reset(new StateChunk());
+            _pcurchunk->starttime = stamp;
+            // the first frame of a chunk stores every body
+            _mapLastStamps.clear();
+            _setChunkNames.clear();
+        }
+        StateChunk& chunk = *_pcurchunk;
+        std::vector<uint8_t>& v = chunk.vdata;
+        _Write(v, stamp);
+        size_t numrecordsoffset = v.size();
+        uint32_t numrecords = 0;
+        _Write(v, numrecords);
+
+        GetEnv()->GetBodies(_vbodies);
+        _setCurrentIds.clear();
+        FOREACHC(itbody, _vbodies) {
+            const KinBody& body = **itbody;
+            int32_t envid = body.GetEnvironmentId();
+            _setCurrentIds.insert(envid);
+            std::map<int, int>::iterator itstamp = _mapLastStamps.find(envid);
+            if( itstamp != _mapLastStamps.end() && itstamp->second == body.GetUpdateStamp() ) {
+                continue;
+            }
+            _mapLastStamps[envid] = body.GetUpdateStamp();
+            uint8_t flags = 0;
+            if( _setChunkNames.insert(envid).second ) {
+                flags |= RF_Name;
+            }
+            _Write(v, envid);
+            _Write(v, flags);
+            if( flags & RF_Name ) {
+                _WriteString(v, body.GetName());
+            }
+            Transform t = body.GetTransform();
+            double pose[7] = { t.rot.x, t.rot.y, t.rot.z, t.rot.w, t.trans.x, t.trans.y, t.trans.z};
+            v.insert(v.end(), (const uint8_t*)&pose[0], (const uint8_t*)&pose[7]);
+            body.GetDOFValues(_vdofvalues);
+            uint32_t dof = _vdofvalues.size();
+            _Write(v, dof);
+            for(size_t i = 0; i < _vdofvalues.size(); ++i) {
+                _Write(v, (double)_vdofvalues[i]);
+            }
+            ++numrecords;
+        }
+        std::map<int, int>::iterator itstamp = _mapLastStamps.begin();
+        while(itstamp != _mapLastStamps.end()) {
+            if( _setCurrentIds.find(itstamp->first) == _setCurrentIds.end() ) {
+                int32_t envid = itstamp->first;
+                uint8_t flags = RF_Removed;
+                _Write(v, envid);
+                _Write(v, flags);
+                _setChunkNames.erase(envid);
+                _mapLastStamps.erase(itstamp++);
+                ++numrecords;
+            }
+            else {
+                ++itstamp;
+            }
+        }
+        memcpy(&v[numrecordsoffset], &numrecords, sizeof(numrecords));
+        chunk.endtime = stamp;
+        chunk.numframes++;
+
+        if( chunk.numframes >= _nChunkFrames ) {
+            boost::mutex::scoped_lock lock(_mutex);
+            if( _listQueuedChunks.size() >= _nMaxQueuedChunks ) {
+                // every chunk starts with all bodies, so dropping one only loses its time range
+                ++_nDroppedChunks;
+                RAVELOG_VERBOSE_FORMAT("env=%d, dropping state chunk since writing cannot keep up", GetEnv()->GetId());
+            }
+            else {
+                _listQueuedChunks.push_back(_pcurchunk);
+                _condnewchunk.notify_one();
+            }
+            _pcurchunk.reset();
+        }
+    }
+
+    void _WriteThread()
+    {
+        while(1) {
+            StateChunkPtr pchunk;
+            {
+                boost::mutex::scoped_lock lock(_mutex);
+                while(_bContinueThread && _listQueuedChunks.size() == 0) {
+                    _condnewchunk.wait(lock);
+                }
+                if( _listQueuedChunks.size() == 0 ) {
+                    break;
+                }
+                pchunk = _listQueuedChunks.front();
+                _listQueuedChunks.pop_front();
+            }
+            ChunkIndex index;
+            index.offset = _ofile.tellp();
+            index.starttime = pchunk->starttime;
+            index.endtime = pchunk->endtime;
+            uint64_t payloadsize = pchunk->vdata.size();
+            uint32_t magic = s_nChunkMagic;
+            _ofile.write((const char*)&magic, sizeof(magic));
+            _ofile.write((const char*)&pchunk->numframes, sizeof(pchunk->numframes));
+            _ofile.write((const char*)&pchunk->starttime, sizeof(pchunk->starttime));
+            _ofile.write((const char*)&pchunk->endtime, sizeof(pchunk->endtime));
+            _ofile.write((const char*)&payloadsize, sizeof(payloadsize));
+            _ofile.write((const char*)&pchunk->vdata[0], payloadsize);
+            _ofile.flush();
+            if( !_ofile ) {
+                RAVELOG_WARN("failed to write state chunk\n");
+            }
+            _vWrittenChunks.push_back(index);
+        }
+    }
+
+    void _WriteIndex()
+    {
+        uint64_t indexoffset = _ofile.tellp();
+        uint64_t numchunks = _vWrittenChunks.size();
+        uint32_t magic = s_nIndexMagic;
+        _ofile.write((const char*)&magic, sizeof(magic));
+        _ofile.write((const char*)&numchunks, sizeof(numchunks));
+        FOREACHC(itindex, _vWrittenChunks) {
+            _ofile.write((const char*)&itindex->offset, sizeof(itindex->offset));
+            _ofile.write((const char*)&itindex->starttime, sizeof(itindex->starttime));
+            _ofile.write((const char*)&itindex->endtime, sizeof(itindex->endtime));
+        }
+        magic = s_nFooterMagic;
+        _ofile.write((const char*)&indexoffset, sizeof(indexoffset));
+        _ofile.write((const char*)&magic, sizeof(magic));
+    }
+
+    bool _LoadCommand(ostream& sout, istream& sinput)
+    {
+        string filename;
+        if( !getline(sinput, filename) ) {
+            return false;
+        }
+        boost::trim(filename);
+        boost::mutex::scoped_lock lock(_mutexreplay);
+        _vReplayChunks.resize(0);
+        if( _ifile.is_open() ) {
+            _ifile.close();
+        }
+        _ifile.clear();
+        _ifile.open(filename.c_str(), std::ios::in|std::ios::binary);
+        char header[8];
+        if( !_ifile || !_ifile.read(header, 8) || string(header, 8) != "ORSTLOG1" ) {
+            RAVELOG_WARN_FORMAT("%s is not an environment state log", filename);
+            return false;
+        }
+        if( !_ReadIndex() ) {
+            RAVELOG_INFO_FORMAT("%s has no index, scanning the chunks", filename);
+            _ScanChunks();
+        }
+        RAVELOG_DEBUG_FORMAT("loaded %s with %d chunks", filename%_vReplayChunks.size());
+        return _vReplayChunks.size() > 0;
+    }
+
+    /// \brief reads the index from the end of the file, returns false if the recording was not stopped cleanly
+    bool _ReadIndex()
+    {
+        uint64_t indexoffset = 0;
+        uint32_t magic = 0;
+        _ifile.clear();
+        _ifile.seekg(-(std::streamoff)(sizeof(indexoffset)+sizeof(magic)), std::ios::end);
+        if( !_ifile.read((char*)&indexoffset, sizeof(indexoffset)) || !_ifile.read((char*)&magic, sizeof(magic)) || magic != s_nFooterMagic ) {
+            return false;
+        }
+        uint64_t numchunks = 0;
+        _ifile.seekg(indexoffset);
+        if( !_ifile.read((char*)&magic, sizeof(magic)) || magic != s_nIndexMagic || !_ifile.read((char*)&numchunks, sizeof(numchunks)) ) {
+            return false;
+        }
+        _vReplayChunks.resize(numchunks);
+        for(size_t i = 0; i < _vReplayChunks.size(); ++i) {
+            ChunkIndex& index = _vReplayChunks[i];
+            if( !_ifile.read((char*)&index.offset, sizeof(index.offset)) || !_ifile.read((char*)&index.starttime, sizeof(index.starttime)) || !_ifile.read((char*)&index.endtime, sizeof(index.endtime)) ) {
+                _vReplayChunks.resize(0);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void _ScanChunks()
+    {
+        _ifile.clear();
+        uint64_t offset = 8;
+        while(1) {
+            _ifile.seekg(offset);
+            uint32_t magic = 0, numframes = 0;
+            uint64_t payloadsize = 0;
+            ChunkIndex index;
+            index.offset = offset;
+            if( !_ifile.read((char*)&magic, sizeof(magic)) || magic != s_nChunkMagic ) {
+                break;
+            }
+            if( !_ifile.read((char*)&numframes, sizeof(numframes)) || !_ifile.read((char*)&index.starttime, sizeof(index.starttime)) || !_ifile.read((char*)&index.endtime, sizeof(index.endtime)) || !_ifile.read((char*)&payloadsize, sizeof(payloadsize)) ) {
+                break;
+            }
+            // make sure the chunk was completely written
+            if( payloadsize == 0 ) {
+                break;
+            }
+            _ifile.seekg(payloadsize-1, std::ios::cur);
+            char c;
+            if( !_ifile.read(&c, 1) ) {
+                break;
+            }
+            _vReplayChunks.push_back(index);
+            offset = (uint64_t)_ifile.tellg();
+        }
+        _ifile.clear();
+    }
+
+    bool _GetTimeRangeCommand(ostream& sout, istream& sinput)
+    {
+        boost::mutex::scoped_lock lock(_mutexreplay);
+        if( _vReplayChunks.size() == 0 ) {
+            return false;
+        }
+        sout << _vReplayChunks.front().starttime << " " << _vReplayChunks.back().endtime;
+        return true;
+    }
+
+    bool _RestoreCommand(ostream& sout, istream& sinput)
+    {
+        uint64_t timestamp = 0;
+        sinput >> timestamp;
+        if( !sinput ) {
+            return false;
+        }
+        boost::mutex::scoped_lock lock(_mutexreplay);
+        if( _vReplayChunks.size() == 0 ) {
+            RAVELOG_WARN("no log loaded\n");
+            return false;
+        }
+        // last chunk starting at or before the timestamp
+        size_t ichunk = 0;
+        size_t low = 0, high = _vReplayChunks.size();
+        while(low < high) {
+            size_t mid = (low+high)/2;
+            if( _vReplayChunks[mid].starttime <= timestamp ) {
+                ichunk = mid;
+                low = mid+1;
+            }
+            else {
+                high = mid;
+            }
+        }
+        if( _vReplayChunks[ichunk].starttime > timestamp ) {
+            RAVELOG_WARN_FORMAT("timestamp %d is before the log starts", timestamp);
+            return false;
+        }
+
+        std::map<int, ReplayBodyState> mapstates;
+        _ReadChunkStates(_vReplayChunks[ichunk], timestamp, mapstates);
+
+        EnvironmentMutex::scoped_lock lockenv(GetEnv()->GetMutex());
+        int numrestored = 0;
+        FOREACHC(itstate, mapstates) {
+            KinBodyPtr pbody = GetEnv()->GetKinBody(itstate->second.name);
+            if( !pbody ) {
+                continue;
+            }
+            if( pbody->GetDOF() == (int)itstate->second.vdofvalues.size() ) {
+                pbody->SetDOFValues(itstate->second.vdofvalues, itstate->second.t, KinBody::CLA_Nothing);
+            }
+            else {
+                RAVELOG_WARN_FORMAT("body %s has %d dof, but log has %d", pbody->GetName()%pbody->GetDOF()%itstate->second.vdofvalues.size());
+                pbody->SetTransform(itstate->second.t);
+            }
+            ++numrestored;
+        }
+        sout << numrestored;
+        return true;
+    }
+
+    /// \brief reads the frames of the chunk up to the timestamp and accumulates the body states
+    void _ReadChunkStates(const ChunkIndex& index, uint64_t timestamp, std::map<int, ReplayBodyState>& mapstates)
+    {
+        uint32_t magic = 0, numframes = 0;
+        uint64_t starttime = 0, endtime = 0, payloadsize = 0;
+        _ifile.clear();
+        _ifile.seekg(index.offset);
+        _ifile.read((char*)&magic, sizeof(magic));
+        _ifile.read((char*)&numframes, sizeof(numframes));
+        _ifile.read((char*)&starttime, sizeof(starttime));
+        _ifile.read((char*)&endtime, sizeof(endtime));
+        _ifile.read((char*)&payloadsize, sizeof(payloadsize));
+        if( !_ifile || magic != s_nChunkMagic ) {
+            throw OPENRAVE_EXCEPTION_FORMAT("bad state chunk at offset %d", index.offset, ORE_InvalidState);
+        }
+        _vreadbuffer.resize(payloadsize);
+        if( payloadsize > 0 && !_ifile.read((char*)&_vreadbuffer[0], payloadsize) ) {
+            throw OPENRAVE_EXCEPTION_FORMAT("failed to read state chunk at offset %d", index.offset, ORE_InvalidState);
+        }
+
+        size_t pos = 0;
+        for(uint32_t iframe = 0; iframe < numframes; ++iframe) {
+            uint64_t stamp = _Read<uint64_t>(pos);
+            if( stamp > timestamp ) {
+                break;
+            }
+            uint32_t numrecords = _Read<uint32_t>(pos);
+            for(uint32_t irecord = 0; irecord < numrecords; ++irecord) {
+                int32_t envid = _Read<int32_t>(pos);
+                uint8_t flags = _Read<uint8_t>(pos);
+                if( flags & RF_Removed ) {
+                    mapstates.erase(envid);
+                    continue;
+                }
+                ReplayBodyState& state = mapstates[envid];
+                if( flags & RF_Name ) {
+                    uint32_t namesize = _Read<uint32_t>(pos);
+                    _CheckRead(pos, namesize);
+                    state.name.assign((const char*)&_vreadbuffer[pos], namesize);
+                    pos += namesize;
+                }
+                double pose[7];
+                for(int i = 0; i < 7; ++i) {
+                    pose[i] = _Read<double>(pos);
+                }
+                state.t.rot = Vector(pose[0], pose[1], pose[2], pose[3]);
+                state.t.trans = Vector(pose[4], pose[5], pose[6]);
+                uint32_t dof = _Read<uint32_t>(pos);
+                state.vdofvalues.resize(dof);
+                for(uint32_t i = 0; i < dof; ++i) {
+                    state.vdofvalues[i] = _Read<double>(pos);
+                }
+            }
+        }
+    }
+
+    template <typename T>
+    inline T _Read(size_t& pos)
+    {
+        _CheckRead(pos, sizeof(T));
+        T value;
+        memcpy(&value, &_vreadbuffer[pos], sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+
+    inline void _CheckRead(size_t pos, size_t size)
+    {
+        if( pos + size > _vreadbuffer.size() ) {
+            throw OPENRAVE_EXCEPTION_FORMAT0("state chunk is truncated", ORE_InvalidState);
+        }
+    }
+
+    template <typename T>
+    static inline void _Write(std::vector<uint8_t>& v, const T& value)
+    {
+        const uint8_t* p = (const uint8_t*)&value;
+        v.insert(v.end(), p, p+sizeof(T));
+    }
+
+    static inline void _WriteString(std::vector<uint8_t>& v, const std::string& s)
+    {
+        uint32_t size = s.size();
+        _Write(v, size);
+        v.insert(v.end(), s.begin(), s.end());
+    }
+
+    // recording
+    boost::mutex _mutex; ///< protects the chunk queue
+    boost::condition _condnewchunk;
+    boost::shared_ptr<boost::thread> _threadwrite;
+    bool _bContinueThread, _bRecording;
+    std::ofstream _ofile;
+    std::list<StateChunkPtr> _listQueuedChunks; ///< chunks waiting to be written, bounded by _nMaxQueuedChunks
+    StateChunkPtr _pcurchunk; ///< chunk the frames are currently captured to
+    std::vector<ChunkIndex> _vWrittenChunks; ///< used by the write thread only
+    uint32_t _nChunkFrames;
+    size_t _nMaxQueuedChunks;
+    uint64_t _nDroppedChunks;
+    uint64_t _nInterval, _nLastFrameTime;
+    bool _bHasLastFrame, _bUseSimulationTime;
+    std::map<int, int> _mapLastStamps; ///< environment id to the update stamp of the body when it was last recorded in the current chunk
+    std::set<int> _setChunkNames; ///< environment ids whose names are already stored in the current chunk
+    std::set<int> _setCurrentIds;
+    std::vector<KinBodyPtr> _vbodies;
+    std::vector<dReal> _vdofvalues;
+
+    // replay
+    boost::mutex _mutexreplay;
+    std::ifstream _ifile;
+    std::vector<ChunkIndex> _vReplayChunks;
+    std::vector<uint8_t> _vreadbuffer;
+};
+
+ModuleBasePtr CreateStateRecorder(EnvironmentBasePtr penv, std::istream& sinput) {
+    return ModuleBasePtr(new StateRecorder(penv,sinput));
+}
@@ -111,21 +111,27 @@ class ViewerRecorder : public ModuleBase
     UserDataPtr _callback;
     int _nUseSimulationTime; // 0 to record as is, 1 to record with respect to simulation, 2 to control simulation to viewer updates
     dReal _fSimulationTimeMultiplier; // how many times to make the simulation time faster
-    list<boost::shared_ptr<VideoFrame> > _listAddFrames, _listFinishedFrames;
+    list<boost::shared_ptr<VideoFrame> > _listAddFrames; ///< captured frames waiting to be encoded, bounded by _nMaxQueuedFrames
+    list<boost::shared_ptr<VideoFrame> > _listFinishedFrames; ///< pool of frames whose image memory can be reused by the capture callback
     boost::shared_ptr<VideoFrame> _frameLastAdded;
+    size_t _nMaxQueuedFrames; ///< when the encoder falls behind, the oldest captured frames are dropped so the viewer never waits
+    uint64_t _nDroppedFrames; ///< number of captured frames dropped since the last Start
+    int _nEncoderThreads; ///< number of threads the codec encodes with, 0 lets the library decide
 
 public:
     ViewerRecorder(EnvironmentBasePtr penv, std::istream& sinput) : ModuleBase(penv)
     {
         __description = ":Interface Author: Rosen Diankov\n\nRecords the images produced from a viewer into video file. The recordings can be synchronized to real-time or simulation time, by default simulation time is used. Each instance can record only one file at a time. To record multiple files simultaneously, create multiple VideoRecorder instances";
         RegisterCommand("Start",boost::bind(&ViewerRecorder::_StartCommand,this,_1,_2),
-                        "Starts recording a file, this will stop all previous recordings and overwrite any previous files stored in this location. Format::\n\n  Start [width] [height] [framerate] codec [codec] timing [simtime/realtime/controlsimtime[=timestepmult]] viewer [name]\\n filename [filename]\\n\n\nBecause the viewer and filenames can have spaces, the names are ready until a newline is encountered");
+                        "Starts recording a file, this will stop all previous recordings and overwrite any previous files stored in this location. Format::\n\n  Start [width] [height] [framerate] codec [codec] timing [simtime/realtime/controlsimtime[=timestepmult]] queuesize [maxframes] threads [numthreads] viewer [name]\\n filename [filename]\\n\n\nBecause the viewer and filenames can have spaces, the names are ready until a newline is encountered. queuesize bounds the captured frames waiting for the encoder (default is 16), the oldest are dropped when it is full. threads sets the number of codec encoding threads (default is the number of cores)");
         RegisterCommand("Stop",boost::bind(&ViewerRecorder::_StopCommand,this,_1,_2),
                         "Stops recording and saves the file. Format::\n\n  Stop\n\n");
         RegisterCommand("GetCodecs",boost::bind(&ViewerRecorder::_GetCodecsCommand,this,_1,_2),
                         "Return all the possible codecs, one codec per line:[video_codec id] [name]");
         RegisterCommand("SetWatermark",boost::bind(&ViewerRecorder::_SetWatermarkCommand,this,_1,_2),
                         "Set a WxHx4 image as a watermark. Each color is an unsigned integer ordered as A|B|G|R. The origin should be the top left corner");
+        RegisterCommand("GetDroppedFrames",boost::bind(&ViewerRecorder::_GetDroppedFramesCommand,this,_1,_2),
+                        "Returns the number of captured frames dropped since the last Start because the encoder could not keep up. Format::\n\n  GetDroppedFrames\n\n");
         _nFrameCount = _nVideoWidth = _nVideoHeight = 0;
         _framerate = 0;
         _nUseSimulationTime = 1;
@@ -134,6 +140,9 @@ public:
         _bContinueThread = true;
         _bStopRecord = true;
         _frameindex = 0;
+        _nMaxQueuedFrames = 16;
+        _nDroppedFrames = 0;
+        _nEncoderThreads = 0;
 #ifdef _WIN32
         _pfile = NULL;
         _ps = NULL;
@@ -151,6 +160,9 @@ public:
         _outbuf = NULL;
         _picture_size = 0;
         _outbuf_size = 0;
+#ifdef HAVE_NEW_FFMPEG
+        _swscontext = NULL;
+#endif
 #endif
         _threadrecord.reset(new boost::thread(boost::bind(&ViewerRecorder::_RecordThread,this)));
     }
@@ -217,6 +229,13 @@ protected:
                         RAVELOG_WARN("unknown cmd");
                     }
                 }
+                else if( cmd == "queuesize" ) {
+                    sinput >> _nMaxQueuedFrames;
+                    _nMaxQueuedFrames = max(_nMaxQueuedFrames, (size_t)1);
+                }
+                else if( cmd == "threads" ) {
+                    sinput >> _nEncoderThreads;
+                }
                 else if( cmd == "viewer" ) {
                     string name;
                     if( !getline(sinput, name) ) {
@@ -244,6 +263,7 @@ protected:
             RAVELOG_INFO("video filename: %s, %d x %d @ %f frames/sec\n",_filename.c_str(),_nVideoWidth,_nVideoHeight,_framerate);
             _StartVideo(_filename,_framerate,_nVideoWidth,_nVideoHeight,24,codecid);
             _starttime = 0;
+            _nDroppedFrames = 0;
             if( _nUseSimulationTime == 2 ) {
                 _frametime = (uint64_t)(1000000.0f*_fSimulationTimeMultiplier/_framerate);
             }
@@ -282,6 +302,13 @@ protected:
         return !!sinput;
     }
 
+    bool _GetDroppedFramesCommand(ostream& sout, istream& sinput)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        sout << _nDroppedFrames;
+        return true;
+    }
+
     void _ViewerImageCallback(const uint8_t* memory, int width, int height, int pixeldepth)
     {
         boost::mutex::scoped_lock lock(_mutex);
@@ -300,20 +327,32 @@ protected:
                 _listAddFrames.pop_back();
             }
         }
-        if( !frame ) {
-            if( _listFinishedFrames.size() > 0 ) {
-                frame = _listFinishedFrames.back();
-                _listFinishedFrames.pop_back();
-            }
-            else {
-                frame.reset(new VideoFrame());
+        if( !frame && _listAddFrames.size() >= _nMaxQueuedFrames ) {
+            // the encoder is behind, so drop the oldest frame instead of blocking the viewer. the record thread repeats the last encoded frame to fill the gap
+            frame = _listAddFrames.front();
+            _listAddFrames.pop_front();
+            ++_nDroppedFrames;
+        }
+        if( !!frame && !frame.unique() ) {
+            // the record thread is still encoding from this memory
+            frame.reset();
+        }
+        while( !frame && _listFinishedFrames.size() > 0 ) {
+            frame = _listFinishedFrames.back();
+            _listFinishedFrames.pop_back();
+            if( !frame.unique() ) {
+                frame.reset();
             }
         }
+        if( !frame ) {
+            frame.reset(new VideoFrame());
+        }
         frame->_width = width;
         frame->_height = height;
         frame->_pixeldepth = pixeldepth;
         //RAVELOG_VERBOSE("image frame is %d x %d\n",width,height);
         frame->_timestamp = timestamp;
+        frame->_bProcessed = false;
         frame->_vimagememory.resize(width*height*pixeldepth);
         std::copy(memory,memory+width*height*pixeldepth,frame->_vimagememory.begin());
         _listAddFrames.push_back(frame);
@@ -403,7 +442,7 @@ protected:
                     }
                     frame = *itbest;
                     size_t prevsize = _listAddFrames.size();
-                    _listAddFrames.erase(_listAddFrames.begin(),itbest);
+                    _listFinishedFrames.splice(_listFinishedFrames.end(), _listAddFrames, _listAddFrames.begin(), itbest);
                     if( frame->_timestamp-_starttime <= _frametime ) {
                         // the frame is before the next mark, so erase it
                         _listAddFrames.erase(itbest);
@@ -423,7 +462,14 @@ protected:
                 for(uint64_t i = 0; i < numstores; ++i) {
                     _AddFrame(&frame->_vimagememory.at(0));
                 }
-                _frameLastAdded = frame;
+                if( _frameLastAdded != frame ) {
+                    boost::mutex::scoped_lock lock(_mutex);
+                    if( !!_frameLastAdded && !_bStopRecord ) {
+                        // the previous frame can no longer be repeated, so give its memory back to the capture callback
+                        _listFinishedFrames.push_back(_frameLastAdded);
+                    }
+                    _frameLastAdded = frame;
+                }
             }
             catch(const std::exception& ex) {
                 RAVELOG_WARN("%s\n",ex.what());
@@ -646,9 +692,29 @@ protected:
     int _picture_size;
     int _outbuf_size;
     bool _bWroteURL, _bWroteHeader;
+    vector<char> _vflippeddata; ///< vertically flipped image, reused between frames
+#ifdef HAVE_NEW_FFMPEG
+    struct SwsContext* _swscontext; ///< BGR24 to YUV420P conversion, reused between frames
+#endif
 
     void _ResetLibrary()
     {
+#if LIBAVFORMAT_VERSION_INT >= (54<<16)
+        if( !!_stream && _bWroteHeader ) {
+            try {
+                _FlushEncoder();
+            }
+            catch(const std::exception& ex) {
+                RAVELOG_WARN("%s\n",ex.what());
+            }
+        }
+#endif
+#ifdef HAVE_NEW_FFMPEG
+        if( !!_swscontext ) {
+            sws_freeContext(_swscontext);
+            _swscontext = NULL;
+        }
+#endif
         free(_picture_buf); _picture_buf = NULL;
         free(_picture); _picture = NULL;
         free(_yuv420p); _yuv420p = NULL;
@@ -768,6 +834,11 @@ protected:
         codec_ctx->gop_size = 10;
         codec_ctx->max_b_frames = 1;
         codec_ctx->pix_fmt = PIX_FMT_YUV420P;
+        // encode on the codec's own thread pool so that large frames keep up with the viewer
+        codec_ctx->thread_count = _nEncoderThreads > 0 ? _nEncoderThreads : max(1, (int)boost::thread::hardware_concurrency());
+#ifdef FF_THREAD_FRAME
+        codec_ctx->thread_type = FF_THREAD_FRAME|FF_THREAD_SLICE;
+#endif
 
 #if LIBAVFORMAT_VERSION_INT >= (54<<16)
         // not necessary to set parameters?
@@ -831,26 +902,23 @@ protected:
         }
 
         // flip vertically
-        static vector<char> newdata;
-        newdata.resize(_stream->codec->height*_stream->codec->width*3);
+        _vflippeddata.resize(_stream->codec->height*_stream->codec->width*3);
         char* penddata = (char*)pdata + _stream->codec->height*_stream->codec->width*3;
 
         for(int i = 0; i < _stream->codec->height; ++i) {
-            memcpy(&newdata[i*_stream->codec->width*3], (char*)penddata - (i+1)*_stream->codec->width*3, _stream->codec->width*3);
+            memcpy(&_vflippeddata[i*_stream->codec->width*3], (char*)penddata - (i+1)*_stream->codec->width*3, _stream->codec->width*3);
         }
 
-        _picture->data[0] = (uint8_t*)&newdata[0];
+        _picture->data[0] = (uint8_t*)&_vflippeddata[0];
         _picture->linesize[0] = _stream->codec->width * 3;
 
 #ifdef HAVE_NEW_FFMPEG
-        struct SwsContext *img_convert_ctx;
-        img_convert_ctx = sws_getContext(_stream->codec->width, _stream->codec->height, PIX_FMT_BGR24, _stream->codec->width, _stream->codec->height, PIX_FMT_YUV420P, SWS_BICUBIC /* flags */, NULL, NULL, NULL);
-        if (!sws_scale(img_convert_ctx, _picture->data, _picture->linesize, 0, _stream->codec->height, _yuv420p->data, _yuv420p->linesize)) {
-            sws_freeContext(img_convert_ctx);
+        if( !_swscontext ) {
+            _swscontext = sws_getContext(_stream->codec->width, _stream->codec->height, PIX_FMT_BGR24, _stream->codec->width, _stream->codec->height, PIX_FMT_YUV420P, SWS_BICUBIC /* flags */, NULL, NULL, NULL);
+        }
+        if (!sws_scale(_swscontext, _picture->data, _picture->linesize, 0, _stream->codec->height, _yuv420p->data, _yuv420p->linesize)) {
             throw OPENRAVE_EXCEPTION_FORMAT0("ADD_FRAME sws_scale failed",ORE_Assert);
         }
-
-        sws_freeContext(img_convert_ctx);
 #else
         if( img_convert((AVPicture*)_yuv420p, PIX_FMT_YUV420P, (AVPicture*)_picture, PIX_FMT_BGR24, _stream->codec->width, _stream->codec->height) ) {
             throw OPENRAVE_EXCEPTION_FORMAT0("ADD_FRAME img_convert failed",ORE_Assert);
@@ -898,6 +966,36 @@ protected:
 #endif
         _nFrameCount++;
     }
+
+#if LIBAVFORMAT_VERSION_INT >= (54<<16)
+    /// \brief writes the packets still delayed inside the encoder, frame threading delays up to one frame per thread. _mutexlibrary should be locked.
+    void _FlushEncoder()
+    {
+        if( !_stream->codec->codec || !(_stream->codec->codec->capabilities & CODEC_CAP_DELAY) ) {
+            return;
+        }
+        for(;;) {
+            int got_packet = 0;
+            AVPacket pkt;
+            av_init_packet(&pkt);
+            pkt.data = NULL;
+            pkt.size = 0;
+            int ret = avcodec_encode_video2(_stream->codec, &pkt, NULL, &got_packet);
+            if( ret < 0 ) {
+                av_destruct_packet(&pkt);
+                throw OPENRAVE_EXCEPTION_FORMAT("avcodec_encode_video2 failed with %d when flushing",ret,ORE_Assert);
+            }
+            if( !got_packet ) {
+                break;
+            }
+            if( av_write_frame(_output, &pkt) < 0) {
+                av_destruct_packet(&pkt);
+                throw OPENRAVE_EXCEPTION_FORMAT0("av_write_frame failed",ORE_Assert);
+            }
+            av_destruct_packet(&pkt);
+        }
+    }
+#endif
 #endif
 };
 
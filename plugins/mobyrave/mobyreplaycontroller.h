@@ -111,6 +111,13 @@ public:
     std::vector<dReal> Next(void)
     {
         std::vector<dReal> record;
+        Next(record);
+        return record;
+    }
+
+    /// \brief reads the next record into record, which keeps its memory between the calls
+    void Next(std::vector<dReal>& record)
+    {
         if(_stream == NULL || !_stream->is_open()) 
         {
             throw;
@@ -140,7 +147,6 @@ public:
         }
 
         _cursor++;
-        return record;
     }
 
     int GetPointCount(void)
@@ -184,7 +190,7 @@ public:
         return it->second;
     }
 
-    dReal GetValue(std::vector<dReal> record, unsigned idx)
+    dReal GetValue(const std::vector<dReal>& record, unsigned idx)
     {
         if(idx >= record.size())
         {
@@ -193,7 +199,7 @@ public:
         return record[idx];
     }
 
-    dReal GetValue(std::vector<dReal> record, std::string key)
+    dReal GetValue(const std::vector<dReal>& record, const std::string& key)
     {
         return record[Lookup(key)];
     }
@@ -241,6 +247,10 @@ class MobyReplayController : public ControllerBase
                 //std::cout << "mrd: " << filename << std::endl;
                 _controller->_mrdfilename = filename;
             }
+            else if( name == "playback_timestep" )
+            {
+                _ss >> _controller->_fPlaybackTimeStep;
+            }
             else 
             {
                 RAVELOG_ERROR("unknown field %s\n", name.c_str());
@@ -267,9 +277,9 @@ class MobyReplayController : public ControllerBase
             }
         }
 
-        static const boost::array<string, 1>& GetTags() 
+        static const boost::array<string, 2>& GetTags() 
         {
-            static const boost::array<string, 1> tags = {{"mrd"}};
+            static const boost::array<string, 2> tags = {{"mrd", "playback_timestep"}};
                 return tags;
         }
 
@@ -297,7 +307,15 @@ public:
                         "If set, will throw exceptions instead of print warnings. Format is:\n\n  [0/1]");
         RegisterCommand("SetEnableLogging",boost::bind(&MobyReplayController::_SetEnableLogging,this,_1,_2),
                         "If set, will write trajectories to disk");
+        RegisterCommand("SetPlaybackTimeStep",boost::bind(&MobyReplayController::_SetPlaybackTimeStep,this,_1,_2),
+                        "Sets the time between two samples of the playback buffer the trajectories are sampled into on SetPath. 0 (default) uses the command period of the mrd file. Format is:\n\n  timestep");
         _fCommandTime = 0;
+        _fPlaybackTimeStep = 0;
+        _fPlaybackDuration = 0;
+        _fUsedPlaybackTimeStep = 0;
+        _nPlaybackDOF = 0;
+        _nJointValuesOffset = _nJointVelocitiesOffset = -1;
+        _nTimeTraceIndex = 0;
         _fSpeed = 1;
         _nControlTransformation = 0;
 
@@ -375,6 +393,21 @@ public:
         // compute the command duration (1/freq)
         _commandDuration = 1.0 / (dReal)_mrdfile->GetFrequency();
 
+        // resolve the traces once so that the steps do not look them up by name
+        _nTimeTraceIndex = _mrdfile->Lookup("time");
+        _vtorquetraces.resize(0);
+        if( !!_probot ) {
+            FOREACH(it,_dofindices)
+            {
+                if(*it < 6) {
+                    std::stringstream key;
+                    //key << "trq_d[J" << (*it) + 1 << "]";
+                    key << "trq[J" << (*it) + 1 << "]";
+                    _vtorquetraces.push_back(make_pair(_probot->GetJointFromDOFIndex(*it), _mrdfile->Lookup(key.str())));
+                }
+            }
+        }
+
         RAVELOG_INFO(str(boost::format("Controller Initialized\n")));
         _bPause = false;
 
@@ -384,6 +417,7 @@ public:
     virtual void Reset(int options)
     {
         _ptraj.reset();
+        _vplayback.resize(0);
         _vecdesired.resize(0);
         if( flog.is_open() ) {
             flog.close();
@@ -442,6 +476,7 @@ public:
         _bIsDone = true;
         _vecdesired.resize(0);
         _ptraj.reset();
+        _vplayback.resize(0);
 
         if( !!ptraj ) {
             _samplespec._vgroups.resize(0);
@@ -545,6 +580,8 @@ public:
                 ptraj->serialize(flog);
             }
 
+            _FillPlaybackBuffer(ptraj);
+
             _ptraj = RaveCreateTrajectory(GetEnv(),ptraj->GetXMLId());
             _ptraj->Clone(ptraj,0);
             _bIsDone = false;
@@ -562,14 +599,15 @@ public:
         boost::mutex::scoped_lock lock(_mutex);
         TrajectoryBaseConstPtr ptraj = _ptraj; // because of multi-threading setting issues
         if( !!ptraj ) {
-            vector<dReal> sampledata;
-            ptraj->Sample(sampledata,_fCommandTime,_samplespec);
+            // the grab values do not interpolate, so take the last sample at or before the time
+            dReal fraction;
+            const dReal* sampledata = _GetPlaybackSample(_fCommandTime, fraction);
 
             // already sampled, so change the command times before before setting values
             // incase the below functions fail
             bool bIsDone = _bIsDone;
-            if( _fCommandTime > ptraj->GetDuration() ) {
-                _fCommandTime = ptraj->GetDuration();
+            if( _fCommandTime > _fPlaybackDuration ) {
+                _fCommandTime = _fPlaybackDuration;
                 bIsDone = true;
             }
             else {
@@ -581,7 +619,7 @@ public:
             list<pair<KinBodyPtr, KinBody::LinkPtr> > listgrab;
             list<int> listgrabindices;
             FOREACH(itgrabinfo,_vgrablinks) {
-                int bodyid = int(std::floor(sampledata.at(itgrabinfo->first)+0.5));
+                int bodyid = int(std::floor(sampledata[itgrabinfo->first]+0.5));
                 if( bodyid != 0 ) {
                     KinBodyPtr pbody = GetEnv()->GetBodyFromEnvironmentId(abs(bodyid));
                     if( !pbody ) {
@@ -608,7 +646,7 @@ public:
                 }
             }
             FOREACH(itgrabinfo,_vgrabbodylinks) {
-                int dograb = int(std::floor(sampledata.at(itgrabinfo->offset)+0.5));
+                int dograb = int(std::floor(sampledata[itgrabinfo->offset]+0.5));
                 if( dograb <= 0 ) {
                     if( !!_probot->IsGrabbing(itgrabinfo->pbody) ) {
                         listrelease.push_back(itgrabinfo->pbody);
@@ -623,32 +661,15 @@ public:
                 }
             }
 
-            // sample the trajectory for the current time
-            vector<dReal> sample;
-            ptraj->Sample(sample, _fCommandTime, _samplespec);
-
-            // get the joint positions from the trajectory
-            vector<ConfigurationSpecification::Group>::const_iterator pit;
-            pit = _samplespec.FindCompatibleGroup("joint_values", false);
-            vector<dReal> vdofvalues(pit->dof);
-            for(int i = 0; i < pit->dof; i++) 
-            {
-                vdofvalues[i] = sample[i+pit->offset];
-            } 
-
-            // get the joint velocities from the trajectory
-            vector<ConfigurationSpecification::Group>::const_iterator vit;
-            vit = _samplespec.FindCompatibleGroup("joint_velocities", false);
-            vector<dReal> desiredvelocity(vit->dof);
-            for(int i = 0; i < vit->dof; i++) 
-            {
-                desiredvelocity[i] = sample[i+vit->offset];
-            } 
+            // interpolate the joint positions and velocities for the current time
+            const dReal* sample = _GetPlaybackSample(_fCommandTime, fraction);
+            _InterpolatePlayback(sample, fraction, _nJointValuesOffset, _vdofvalues);
+            _InterpolatePlayback(sample, fraction, _nJointVelocitiesOffset, _vdesiredvelocity);
 
             // compute the controls
-            if( vdofvalues.size() > 0 )
+            if( _vdofvalues.size() > 0 )
             {
-                _SetControls(vdofvalues, desiredvelocity, _fCommandTime > 0 ? fTimeElapsed : 0);
+                _SetControls(_vdofvalues, _vdesiredvelocity, _fCommandTime > 0 ? fTimeElapsed : 0);
             }
 
             // always release after setting dof values
@@ -717,9 +738,9 @@ private:
         if(_firstAction) 
         {
             // get the initial torque record
-            _currentMRDData = _mrdfile->Next();
+            _mrdfile->Next(_currentMRDData);
             // find out the initial time
-            _simTime = _mrdfile->GetValue(_currentMRDData, "time");
+            _simTime = _currentMRDData.at(_nTimeTraceIndex);
             _startTime = _simTime; 
             _currentTime = _simTime;
 
@@ -732,16 +753,16 @@ private:
             if(_simTime >= _currentTime + _commandDuration - EPSILON)
             {
                 // get the next mrd record
-                _currentMRDData = _mrdfile->Next();
+                _mrdfile->Next(_currentMRDData);
 
                 // reset to eliminate aggregate fp error
-                _simTime = _mrdfile->GetValue(_currentMRDData, "time");
+                _simTime = _currentMRDData.at(_nTimeTraceIndex);
                 _currentTime = _simTime;
             }
         } 
 
-        std::vector<dReal> kF(6);
 /*
+        std::vector<dReal> kF(6);
         kF[0] = 2.0;
         kF[1] = 2.38;
         kF[2] = 2.0;
@@ -749,43 +770,116 @@ private:
         kF[4] = 2.0;
         kF[5] = 2.0;
  */
-        FOREACH(it,_dofindices)
+        // the joints and their torque traces are resolved in Init
+        _vtorque.resize(1);
+        FOREACH(it,_vtorquetraces)
         {
-            if(*it < 6) {
-                //double gearRatio = 1;      // assume a 1-to-1 gear ratio
-                //double torqueNominal = 0;  // zero nominal torque indicates no value specified
-                //double torqueStall = 0;    // zero stall torque indicates no value specified
-    
-                // get the joint
-                KinBody::JointPtr pjoint = _probot->GetJointFromDOFIndex(*it);
-/*            
-                // get the motor parameters
-                ElectricMotorActuatorInfoPtr motorInfo = pjoint->GetInfo()._infoElectricMotor;
-    
-                // if the joint has motorInfo map in the local parameters
-                if( !!motorInfo ) 
+            //double gearRatio = 1;      // assume a 1-to-1 gear ratio
+            //double torqueNominal = 0;  // zero nominal torque indicates no value specified
+            //double torqueStall = 0;    // zero stall torque indicates no value specified
+
+            // get the joint
+            KinBody::JointPtr pjoint = it->first;
+/*
+            // get the motor parameters
+            ElectricMotorActuatorInfoPtr motorInfo = pjoint->GetInfo()._infoElectricMotor;
+
+            // if the joint has motorInfo map in the local parameters
+            if( !!motorInfo )
+            {
+                // if the motorInfo gear_ratio is valid, override the local gearRatio
+                if(motorInfo->gear_ratio != 0)
                 {
-                    // if the motorInfo gear_ratio is valid, override the local gearRatio
-                    if(motorInfo->gear_ratio != 0) 
-                    {
-                        gearRatio = motorInfo->gear_ratio;
-                    }
-                    torqueNominal = motorInfo->nominal_torque;
-                    torqueStall = motorInfo->stall_torque;
+                    gearRatio = motorInfo->gear_ratio;
                 }
+                torqueNominal = motorInfo->nominal_torque;
+                torqueStall = motorInfo->stall_torque;
+            }
 */
-                std::stringstream key;
-                //key << "trq_d[J" << (*it) + 1 << "]";
-                key << "trq[J" << (*it) + 1 << "]";
-                dReal value = _mrdfile->GetValue(_currentMRDData, key.str());
-    
-                // apply computed torque
-                vector<dReal> u(1);
-                //u[0] = value / kF[*it];
-                u[0] = value;
-                _mobyPhysics->AddJointTorque( pjoint, u );
+            dReal value = _currentMRDData.at(it->second);
+
+            // apply computed torque
+            //_vtorque[0] = value / kF[*it];
+            _vtorque[0] = value;
+            _mobyPhysics->AddJointTorque( pjoint, _vtorque );
+        }
+    }
+
+    /// \brief samples the whole trajectory into _vplayback every _fPlaybackTimeStep seconds, so that the steps only read from the buffer
+    void _FillPlaybackBuffer(TrajectoryBaseConstPtr ptraj)
+    {
+        _fPlaybackDuration = ptraj->GetDuration();
+        _nPlaybackDOF = _samplespec.GetDOF();
+        dReal timestep = _fPlaybackTimeStep > 0 ? _fPlaybackTimeStep : _commandDuration;
+        if( !(timestep > 0) ) {
+            timestep = 0.001;
+        }
+        _fUsedPlaybackTimeStep = timestep;
+        if( _nPlaybackDOF > 0 ) {
+            ptraj->SamplePointsSameDeltaTime(_vplayback, timestep, true, _samplespec);
+        }
+        if( _vplayback.size() < (size_t)_nPlaybackDOF ) {
+            // keep at least one sample for trajectories that are too short
+            ptraj->Sample(_vplayback, 0, _samplespec);
+        }
+
+        _nJointValuesOffset = _nJointVelocitiesOffset = -1;
+        _vdofvalues.resize(0);
+        _vdesiredvelocity.resize(0);
+        std::vector<ConfigurationSpecification::Group>::const_iterator itgroup = _samplespec.FindCompatibleGroup("joint_values", false);
+        if( itgroup != _samplespec._vgroups.end() ) {
+            _nJointValuesOffset = itgroup->offset;
+            _vdofvalues.resize(itgroup->dof);
+        }
+        itgroup = _samplespec.FindCompatibleGroup("joint_velocities", false);
+        if( itgroup != _samplespec._vgroups.end() ) {
+            _nJointVelocitiesOffset = itgroup->offset;
+            _vdesiredvelocity.resize(itgroup->dof);
+        }
+        RAVELOG_DEBUG(str(boost::format("robot %s playback buffer has %d samples of %d values every %fs")%_probot->GetName()%(_nPlaybackDOF > 0 ? _vplayback.size()/_nPlaybackDOF : 0)%_nPlaybackDOF%timestep));
+    }
+
+    /// \brief returns the last buffered sample at or before time, and the fraction of the way to the next sample
+    ///
+    /// Sample i is at i*_fUsedPlaybackTimeStep except for the last one, which is at _fPlaybackDuration.
+    const dReal* _GetPlaybackSample(dReal time, dReal& fraction) const
+    {
+        fraction = 0;
+        if( _nPlaybackDOF <= 0 || _vplayback.size() == 0 ) {
+            return NULL;
+        }
+        size_t numsamples = _vplayback.size()/_nPlaybackDOF;
+        if( time <= 0 ) {
+            return &_vplayback[0];
+        }
+        if( numsamples <= 1 || time >= _fPlaybackDuration ) {
+            return &_vplayback[(numsamples-1)*_nPlaybackDOF];
+        }
+        size_t index = std::min(size_t(time/_fUsedPlaybackTimeStep), numsamples-2);
+        dReal starttime = index*_fUsedPlaybackTimeStep;
+        dReal endtime = index+2 == numsamples ? _fPlaybackDuration : starttime+_fUsedPlaybackTimeStep;
+        if( endtime > starttime ) {
+            fraction = std::max(dReal(0), std::min(dReal(1), (time-starttime)/(endtime-starttime)));
+        }
+        return &_vplayback[index*_nPlaybackDOF];
+    }
+
+    /// \brief linearly interpolates the values of the group at offset between sample and the sample after it
+    void _InterpolatePlayback(const dReal* sample, dReal fraction, int offset, std::vector<dReal>& values) const
+    {
+        if( !sample || offset < 0 ) {
+            return;
+        }
+        const dReal* sample0 = sample + offset;
+        if( fraction > 0 ) {
+            const dReal* sample1 = sample0 + _nPlaybackDOF;
+            for(size_t i = 0; i < values.size(); ++i) {
+                values[i] = sample0[i] + fraction*(sample1[i]-sample0[i]);
             }
         }
+        else {
+            std::copy(sample0, sample0+values.size(), values.begin());
+        }
     }
 
     virtual bool _Pause(std::ostream& os, std::istream& is)
@@ -815,6 +909,17 @@ private:
         return !!is;
     }
 
+    virtual bool _SetPlaybackTimeStep(std::ostream& os, std::istream& is)
+    {
+        dReal timestep = 0;
+        is >> timestep;
+        if( !is || timestep < 0 ) {
+            return false;
+        }
+        _fPlaybackTimeStep = timestep;
+        return true;
+    }
+
     inline boost::shared_ptr<MobyReplayController> shared_controller()
     {
         return boost::dynamic_pointer_cast<MobyReplayController>(shared_from_this());
@@ -987,6 +1092,17 @@ private:
     dReal _commandDuration;
     std::vector<dReal> _currentMRDData;
     std::vector<std::string> _mrdLookups;
+    int _nTimeTraceIndex; ///< index of the time trace in the mrd records
+    std::vector< std::pair<KinBody::JointPtr, int> > _vtorquetraces; ///< (joint, index of its torque trace in the mrd records)
+    std::vector<dReal> _vtorque;
+
+    dReal _fPlaybackTimeStep; ///< time between the samples of the playback buffer, 0 uses _commandDuration
+    dReal _fUsedPlaybackTimeStep; ///< time step the current playback buffer was sampled with
+    dReal _fPlaybackDuration; ///< duration of the trajectory in the playback buffer
+    std::vector<dReal> _vplayback; ///< the trajectory sampled in _samplespec on SetPath, sample after sample
+    int _nPlaybackDOF; ///< number of values of one sample of _vplayback
+    int _nJointValuesOffset, _nJointVelocitiesOffset; ///< offsets of the joint groups in one sample, -1 if the trajectory does not have them
+    std::vector<dReal> _vdofvalues, _vdesiredvelocity; ///< interpolated at the current time, reused between the steps
 };
 
 ControllerBasePtr CreateMobyReplayController(EnvironmentBasePtr penv, std::istream& sinput)
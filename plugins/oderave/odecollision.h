@@ -118,9 +118,13 @@ public:
         geomray = NULL;
         _nMaxStartContacts = 32;
         _nMaxContacts = 255;     // this is a weird ODE threshold for the new tri-tri collision checker
+        _vStaticQuadTreeExtents = Vector(10,10,10);
+        _nStaticQuadTreeDepth = 6;
         __description = ":Interface Author: Rosen Diankov\n\nOpen Dynamics Engine collision checker (fast, but inaccurate for triangle meshes)";
         RegisterCommand("SetMaxContacts",boost::bind(&ODECollisionChecker::_SetMaxContactsCommand, this,_1,_2),
                         str(boost::format("sets the maximum contacts that can be returned by the checker (limit is %d)")%_nMaxContacts));
+        RegisterCommand("SetStaticSpace",boost::bind(&ODECollisionChecker::_SetStaticSpaceCommand, this,_1,_2),
+                        "\"type [cx cy cz ex ey ez depth]\" puts the bodies without degrees of freedom that did not move into a separate space so large static scenes are not rebuilt for every query. type is none, hash, sap or quadtree, the quadtree also takes its center, half extents and depth.");
 #ifndef ODE_USE_MULTITHREAD
         if( !_bnotifiedmessage ) {
             RAVELOG_DEBUG("ode will be slow in multi-threaded environments\n");
@@ -149,6 +153,12 @@ public:
         _options = r->_options;
         _nMaxStartContacts = r->_nMaxStartContacts;
         _nMaxContacts = r->_nMaxContacts;
+        if( r->_odespace->GetStaticSpaceType() != _odespace->GetStaticSpaceType() ) {
+            _odespace->SetStaticSpaceType(r->_odespace->GetStaticSpaceType(), r->_vStaticQuadTreeCenter, r->_vStaticQuadTreeExtents, r->_nStaticQuadTreeDepth);
+        }
+        _vStaticQuadTreeCenter = r->_vStaticQuadTreeCenter;
+        _vStaticQuadTreeExtents = r->_vStaticQuadTreeExtents;
+        _nStaticQuadTreeDepth = r->_nStaticQuadTreeDepth;
     }
     
     bool _SetMaxContactsCommand(ostream& sout, istream& sinput)
@@ -157,6 +167,26 @@ public:
         return !!sinput;
     }
 
+    bool _SetStaticSpaceCommand(ostream& sout, istream& sinput)
+    {
+        std::string type;
+        sinput >> type;
+        if( !sinput ) {
+            return false;
+        }
+        if( type == "quadtree" ) {
+            sinput >> _vStaticQuadTreeCenter.x >> _vStaticQuadTreeCenter.y >> _vStaticQuadTreeCenter.z >> _vStaticQuadTreeExtents.x >> _vStaticQuadTreeExtents.y >> _vStaticQuadTreeExtents.z >> _nStaticQuadTreeDepth;
+            if( !sinput ) {
+                return false;
+            }
+        }
+        EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+#ifndef ODE_USE_MULTITHREAD
+        boost::mutex::scoped_lock lockode(_mutexode);
+#endif
+        return _odespace->SetStaticSpaceType(type, _vStaticQuadTreeCenter, _vStaticQuadTreeExtents, _nStaticQuadTreeDepth);
+    }
+
     virtual void SetTolerance(OpenRAVE::dReal tolerance) {
     }
 
@@ -232,7 +262,7 @@ public:
         boost::mutex::scoped_lock lock(_mutexode);
 #endif
         _odespace->Synchronize();
-        dSpaceCollide(_odespace->GetSpace(), &cb, KinBodyCollisionCallback);
+        _CollideEnvironment(cb, KinBodyCollisionCallback, pbody);
         return cb._bCollision;
     }
 
@@ -291,13 +321,56 @@ public:
         boost::mutex::scoped_lock lock(_mutexode);
 #endif
         _odespace->Synchronize();
-        dSpaceCollide(_odespace->GetSpace(), &cb, LinkCollisionCallback);
+        _CollideEnvironment(cb, LinkCollisionCallback, plink->GetParent());
         return cb._bCollision;
     }
 
-    int _GeomCollide(dGeomID geom1, dGeomID geom2, vector<dContact>& vcontacts, bool bComputeAllContacts)
+    /// \brief calls callback with the pairs of body spaces like dSpaceCollide on the collision world, taking the static space into account
+    ///
+    /// The bodies in the static space are only collided with each other when pquerybody or one of its attached bodies is static.
+    void _CollideEnvironment(CollisionCallbackData& cb, dNearCallback* callback, KinBodyConstPtr pquerybody)
+    {
+        dSpaceID space = _odespace->GetSpace();
+        dSpaceCollide(space, &cb, callback);
+        dSpaceID staticspace = _odespace->GetStaticSpace();
+        if( !staticspace || cb._bStopChecking ) {
+            return;
+        }
+        // the static space is one sublevel above the body spaces, so every pair has a body space from each side
+        int numgeoms = dSpaceGetNumGeoms(space);
+        for(int igeom = 0; igeom < numgeoms && !cb._bStopChecking; ++igeom) {
+            dSpaceCollide2(dSpaceGetGeom(space, igeom), (dGeomID)staticspace, &cb, callback);
+        }
+        if( !cb._bStopChecking ) {
+            bool bstatic = false;
+            std::set<KinBodyPtr> setattached;
+            pquerybody->GetAttached(setattached);
+            FOREACHC(itbody, setattached) {
+                if( _odespace->IsStatic(*itbody) ) {
+                    bstatic = true;
+                    break;
+                }
+            }
+            if( bstatic ) {
+                dSpaceCollide(staticspace, &cb, callback);
+            }
+        }
+    }
+
+    /// \brief collides geomray with the collision world and the static space
+    void _CollideEnvironmentRay(CollisionCallbackData& cb)
+    {
+        dSpaceCollide2((dGeomID)_odespace->GetSpace(), geomray, &cb, RayCollisionCallback);
+        if( !!_odespace->GetStaticSpace() && !cb._bStopChecking ) {
+            dSpaceCollide2((dGeomID)_odespace->GetStaticSpace(), geomray, &cb, RayCollisionCallback);
+        }
+    }
+
+    /// \param nMaxReportContacts if > 0, stops once this many contacts are found, see CollisionReport::nMaxContacts
+    int _GeomCollide(dGeomID geom1, dGeomID geom2, vector<dContact>& vcontacts, bool bComputeAllContacts, size_t nMaxReportContacts=0)
     {
-        vcontacts.resize(bComputeAllContacts ? _nMaxStartContacts : 1);
+        size_t nMaxContacts = nMaxReportContacts > 0 ? min(nMaxReportContacts, _nMaxContacts) : _nMaxContacts;
+        vcontacts.resize(bComputeAllContacts ? min(_nMaxStartContacts, nMaxContacts) : 1);
         int log2limit = (int)ceil(OpenRAVE::RaveLog(vcontacts.size())/OpenRAVE::RaveLog(2));
         while( 1 ) {
             int N = dCollide (geom1, geom2,vcontacts.size(),&vcontacts[0].geom,sizeof(vcontacts[0]));
@@ -312,17 +385,31 @@ public:
                 vcontacts.resize(N);
                 return N;
             }
-            if( vcontacts.size() >= _nMaxContacts ) {
+            if( vcontacts.size() >= nMaxContacts ) {
                 vcontacts.resize(N);
+                if( nMaxContacts < _nMaxContacts ) {
+                    // the report does not want more contacts
+                    return N;
+                }
                 break;
             }
-            vcontacts.resize(min(_nMaxContacts,vcontacts.size()*2));
+            vcontacts.resize(min(nMaxContacts,vcontacts.size()*2));
             log2limit += 1;
         }
         RAVELOG_WARN(str(boost::format("max contacts %d reached, but still more contacts left! If this is a problem, try increasing the limit with the SetMaxContacts command")%_nMaxContacts));
         return vcontacts.size();
     }
 
+    /// \brief appends the contacts of one colliding pair to the report, keeping at most report.nMaxContacts
+    static void _AppendContacts(CollisionReport& report, const std::vector<CollisionReport::CONTACT>& vcontacts)
+    {
+        size_t numcontacts = vcontacts.size();
+        if( report.nMaxContacts > 0 ) {
+            numcontacts = report.contacts.size() < report.nMaxContacts ? min(numcontacts, report.nMaxContacts-report.contacts.size()) : 0;
+        }
+        report.contacts.insert(report.contacts.end(), vcontacts.begin(), vcontacts.begin()+numcontacts);
+    }
+
     virtual bool CheckCollision(KinBody::LinkConstPtr plink1, KinBody::LinkConstPtr plink2, CollisionReportPtr report)
     {
         if( !!report ) {
@@ -366,7 +453,7 @@ public:
             while(geom2 != NULL) {
                 BOOST_ASSERT(dGeomIsEnabled(geom2));
 
-                int N = _GeomCollide(geom1, geom2, vcontacts, !!preport && !!(preport->options & OpenRAVE::CO_Contacts));
+                int N = _GeomCollide(geom1, geom2, vcontacts, !!preport && !!(preport->options & OpenRAVE::CO_Contacts), !!preport ? preport->nMaxContacts : 0);
                 if (N) {
                     if( !preport && bHasCallbacks ) {
                         preport.reset(new CollisionReport());
@@ -516,7 +603,7 @@ public:
 #endif
 
         _odespace->Synchronize();
-        dSpaceCollide(_odespace->GetSpace(), &cb, KinBodyCollisionCallback);
+        _CollideEnvironment(cb, KinBodyCollisionCallback, pbody);
         return cb._bCollision;
     }
 
@@ -555,7 +642,7 @@ public:
         while(geom1 != NULL) {
             BOOST_ASSERT(dGeomIsEnabled(geom1));
 
-            int N = _GeomCollide(geom1, geomray,vcontacts, !!report && !!(report->options & OpenRAVE::CO_Contacts));
+            int N = _GeomCollide(geom1, geomray,vcontacts, !!report && !!(report->options & OpenRAVE::CO_Contacts), !!report ? report->nMaxContacts : 0);
             if (N > 0) {
 
                 if( !report && bHasCallbacks ) {
@@ -690,11 +777,46 @@ public:
 
         _odespace->Synchronize();
         //dSpaceAdd(_odespace->GetSpace(), geomray);
-        dSpaceCollide2((dGeomID)_odespace->GetSpace(), geomray, &cb, RayCollisionCallback);
+        _CollideEnvironmentRay(cb);
         //dSpaceRemove(_odespace->GetSpace(), geomray);
         return cb._bCollision;
     }
 
+    virtual size_t CheckCollisionRays(const std::vector<RAY>& rays, std::vector<OpenRAVE::dReal>& vdistances, std::vector<KinBody::LinkConstPtr>& vhitlinks)
+    {
+        vdistances.resize(rays.size());
+        vhitlinks.resize(rays.size());
+        CollisionReportPtr report(new CollisionReport());
+        size_t numhits = 0;
+
+        // lock and synchronize once for the whole batch, then reuse the ray geometry
+#ifndef ODE_USE_MULTITHREAD
+        boost::mutex::scoped_lock lock(_mutexode);
+#endif
+        _odespace->Synchronize();
+        dGeomRaySetClosestHit(geomray, !(_options&OpenRAVE::CO_RayAnyHit));
+        dGeomRaySetParams(geomray,0,0);
+        for(size_t i = 0; i < rays.size(); ++i) {
+            const RAY& ray = rays[i];
+            CollisionCallbackData cb(shared_checker(),report,KinBodyPtr(),KinBody::LinkConstPtr());
+            cb.fraymaxdist = OpenRAVE::RaveSqrt(ray.dir.lengthsqr3());
+            Vector vnormdir = cb.fraymaxdist > 0 ? ray.dir*(1/cb.fraymaxdist) : ray.dir;
+            dGeomRaySet(geomray, ray.pos.x, ray.pos.y, ray.pos.z, vnormdir.x, vnormdir.y, vnormdir.z);
+            dGeomRaySetLength(geomray,cb.fraymaxdist);
+            _CollideEnvironmentRay(cb);
+            if( cb._bCollision ) {
+                vdistances[i] = report->minDistance;
+                vhitlinks[i] = !!report->plink1 ? report->plink1 : report->plink2;
+                ++numhits;
+            }
+            else {
+                vdistances[i] = -1;
+                vhitlinks[i].reset();
+            }
+        }
+        return numhits;
+    }
+
     virtual bool CheckStandaloneSelfCollision(KinBodyConstPtr pbody, CollisionReportPtr report)
     {
         if( _options & OpenRAVE::CO_Distance ) {
@@ -713,15 +835,15 @@ public:
             adjacentoptions |= KinBody::AO_ActiveDOFs;
         }
 
-        const std::set<int>& nonadjacent = pbody->GetNonAdjacentLinks(adjacentoptions);
+        const std::vector< std::pair<int16_t, int16_t> >& vnonadjacent = pbody->GetNonAdjacentLinkPairs(adjacentoptions);
 
 #ifndef ODE_USE_MULTITHREAD
         boost::mutex::scoped_lock lock(_mutexode);
 #endif
         _odespace->Synchronize(); // call after GetNonAdjacentLinks since it can modify the body, even though it is const!
         bool bCollision = false;
-        FOREACHC(itset, nonadjacent) {
-            KinBody::LinkConstPtr plink1(pbody->GetLinks().at(*itset&0xffff)), plink2(pbody->GetLinks().at(*itset>>16));
+        FOREACHC(itpair, vnonadjacent) {
+            const KinBody::LinkPtr& plink1 = pbody->GetLinks().at(itpair->first), &plink2 = pbody->GetLinks().at(itpair->second);
             if( !plink1->IsEnabled() || !plink2->IsEnabled() ) {
                 continue;
             }
@@ -770,16 +892,16 @@ public:
             adjacentoptions |= KinBody::AO_ActiveDOFs;
         }
 
-        const std::set<int>& nonadjacent = pbody->GetNonAdjacentLinks(adjacentoptions);
+        const std::vector< std::pair<int16_t, int16_t> >& vnonadjacent = pbody->GetNonAdjacentLinkPairs(adjacentoptions);
 
 #ifndef ODE_USE_MULTITHREAD
         boost::mutex::scoped_lock lock(_mutexode);
 #endif
         _odespace->Synchronize(); // call after GetNonAdjacentLinks since it can modify the body, even though it is const!
         bool bCollision = false;
-        FOREACHC(itset, nonadjacent) {
-            KinBody::LinkConstPtr plink1(pbody->GetLinks().at(*itset&0xffff)), plink2(pbody->GetLinks().at(*itset>>16));
-            if( plink == plink1 || plink == plink2 ) {
+        FOREACHC(itpair, vnonadjacent) {
+            if( plink->GetIndex() == itpair->first || plink->GetIndex() == itpair->second ) {
+                KinBody::LinkConstPtr plink1(pbody->GetLinks().at(itpair->first)), plink2(pbody->GetLinks().at(itpair->second));
                 if( _CheckCollision(plink1,plink2, report) ) {
                     if( IS_DEBUGLEVEL(OpenRAVE::Level_Verbose) ) {
                         RAVELOG_VERBOSE(str(boost::format("selfcol %s, Links %s %s are colliding\n")%pbody->GetName()%plink1->GetName()%plink2->GetName()));
@@ -914,7 +1036,7 @@ private:
         }
 
         vector<dContact> vcontacts;
-        int N = _GeomCollide(o1,o2,vcontacts, !!pcb->_report && !!(_options & OpenRAVE::CO_Contacts));
+        int N = _GeomCollide(o1,o2,vcontacts, !!pcb->_report && !!(_options & OpenRAVE::CO_Contacts), !!pcb->_report ? pcb->_report->nMaxContacts : 0);
         if ( N > 0 ) {
             if( !!pcb->_report || pcb->GetCallbacks().size() > 0 ) {
                 _report.Reset(_options);
@@ -963,7 +1085,7 @@ private:
                                 pcb->_report->vLinkColliding.push_back(*itlinkpair);
                             }
                         }
-                        pcb->_report->contacts.insert(pcb->_report->contacts.end(), _report.contacts.begin(), _report.contacts.end());
+                        _AppendContacts(*pcb->_report, _report.contacts);
                     }
                     else {
                         pcb->_report->vLinkColliding.swap(_report.vLinkColliding);
@@ -1026,7 +1148,7 @@ private:
 
         // only care if one of the bodies is the link
         vector<dContact> vcontacts;
-        int N = _GeomCollide(o1,o2,vcontacts, !!pcb->_report && !!(_options & OpenRAVE::CO_Contacts));
+        int N = _GeomCollide(o1,o2,vcontacts, !!pcb->_report && !!(_options & OpenRAVE::CO_Contacts), !!pcb->_report ? pcb->_report->nMaxContacts : 0);
         if ( N > 0 ) {
 
             if( !!pcb->_report || pcb->GetCallbacks().size() > 0 ) {
@@ -1072,7 +1194,7 @@ private:
                                 pcb->_report->vLinkColliding.push_back(*itlinkpair);
                             }
                         }
-                        pcb->_report->contacts.insert(pcb->_report->contacts.end(), _report.contacts.begin(), _report.contacts.end());
+                        _AppendContacts(*pcb->_report, _report.contacts);
                     }
                     else {
                         pcb->_report->vLinkColliding.swap(_report.vLinkColliding);
@@ -1156,7 +1278,7 @@ private:
         // only care if one of the bodies is the link
         if(( pkb1 == pcb->_plink) ||( pkb2 == pcb->_plink) ) {
             vector<dContact> vcontacts;
-            int N = _GeomCollide(o1,o2,vcontacts, !!pcb->_report && !!(_options & OpenRAVE::CO_Contacts));
+            int N = _GeomCollide(o1,o2,vcontacts, !!pcb->_report && !!(_options & OpenRAVE::CO_Contacts), !!pcb->_report ? pcb->_report->nMaxContacts : 0);
             if (N) {
                 if(!!pcb->_report || pcb->GetCallbacks().size() > 0 ) {
                     _report.Reset(_options);
@@ -1204,7 +1326,7 @@ private:
                                 pcb->_report->vLinkColliding.push_back(*itlinkpair);
                                 }
                             }
-                            pcb->_report->contacts.insert(pcb->_report->contacts.end(), _report.contacts.begin(), _report.contacts.end());
+                            _AppendContacts(*pcb->_report, _report.contacts);
                         }
                         else {
                             pcb->_report->vLinkColliding.swap(_report.vLinkColliding);
@@ -1342,6 +1464,8 @@ private:
     dGeomID geomray;     // used for all ray tests
     boost::shared_ptr<ODESpace> _odespace;
     size_t _nMaxStartContacts, _nMaxContacts;
+    Vector _vStaticQuadTreeCenter, _vStaticQuadTreeExtents; ///< last quadtree sent with SetStaticSpace
+    int _nStaticQuadTreeDepth;
     std::string _userdatakey;
     CollisionReport _report;
 
@@ -17,6 +17,7 @@
 #define RAVE_PHYSICSENGINE_ODE
 
 #include "odespace.h"
+#include "parallelrangeworkers.h"
 
 class ODEPhysicsEngine : public OpenRAVE::PhysicsEngineBase
 {
@@ -216,6 +217,16 @@ The possible properties that can be set are: ";
         _surface_mode = 0;
         _surfacelayer = 0.001;
         _options = OpenRAVE::PEO_SelfCollisions;
+        _nNumThreads = 1;
+#ifdef ODE_HAVE_THREADING_IMPL
+        _threadingimpl = NULL;
+        _threadpool = NULL;
+#endif
+        _bCollectPairs = false;
+        ResetStepTimes();
+        RegisterCommand("SetNumThreads", boost::bind(&ODEPhysicsEngine::_SetNumThreadsCommand, this, _1, _2), "sets the number of threads used for stepping. 0 uses the number of hardware threads, 1 (default) steps in the calling thread");
+        RegisterCommand("GetStepTimes", boost::bind(&ODEPhysicsEngine::_GetStepTimesCommand, this, _1, _2), "returns the number of steps and the accumulated collision, solve and sync times in seconds: numsteps collision solve sync");
+        RegisterCommand("ResetStepTimes", boost::bind(&ODEPhysicsEngine::_ResetStepTimesCommand, this, _1, _2), "resets the accumulated step times");
 
         memset(_jointadd, 0, sizeof(_jointadd));
         _jointadd[dJointTypeBall] = DummyAddForce;
@@ -235,6 +246,7 @@ The possible properties that can be set are: ";
         _jointgetvel[dJointTypeHinge2].push_back(dJointGetHinge2Angle2Rate);
     }
     virtual ~ODEPhysicsEngine() {
+        _DestroyStepThreading();
         _odespace->Destroy();
     }
 
@@ -242,6 +254,7 @@ The possible properties that can be set are: ";
     {
         _report.reset(new CollisionReport());
 
+        _DestroyStepThreading(); // Init recreates the world
         _odespace->SetSynchronizationCallback(boost::bind(&ODEPhysicsEngine::_SyncCallback, shared_physics(),_1));
         if( !_odespace->Init() ) {
             return false;
@@ -260,6 +273,7 @@ The possible properties that can be set are: ";
         dWorldSetCFM(_odespace->GetWorld(),_globalcfm);
         dWorldSetQuickStepNumIterations (_odespace->GetWorld(), _num_iterations);
         dWorldSetContactSurfaceLayer(_odespace->GetWorld(), _surfacelayer);
+        _InitStepThreading();
         return true;
     }
 
@@ -326,6 +340,45 @@ The possible properties that can be set are: ";
             dWorldSetCFM(_odespace->GetWorld(),_globalcfm);
             dWorldSetQuickStepNumIterations (_odespace->GetWorld(), _num_iterations);
         }
+        SetNumThreads(r->_nNumThreads);
+    }
+
+    /// \brief sets the number of threads used by SimulateStep
+    ///
+    /// The narrow phase collision of the candidate geometry pairs is split between the threads (only if ode is built with multi-threading support),
+    /// and the independent islands of connected bodies are solved in parallel by ode's threaded stepping (ode >= 0.13).
+    /// The contact joints are created in the same order as the single threaded version, so the simulation does not change.
+    void SetNumThreads(int numthreads)
+    {
+        if( numthreads <= 0 ) {
+            numthreads = std::max(1, (int)boost::thread::hardware_concurrency());
+        }
+        if( numthreads == _nNumThreads ) {
+            return;
+        }
+        _nNumThreads = numthreads;
+        _pCollideWorkers.reset();
+#ifdef ODE_USE_MULTITHREAD
+        if( _nNumThreads > 1 ) {
+            _pCollideWorkers.reset(new ParallelRangeWorkers(_nNumThreads, "ODECollide"));
+        }
+#else
+        if( _nNumThreads > 1 ) {
+            RAVELOG_WARN("ode is not built with multi-threading support, so collisions are computed in the calling thread\n");
+        }
+#endif
+        _DestroyStepThreading();
+        _InitStepThreading();
+    }
+
+    int GetNumThreads() const {
+        return _nNumThreads;
+    }
+
+    void ResetStepTimes()
+    {
+        _nNumSteps = 0;
+        _nCollisionTime = _nSolveTime = _nSyncTime = 0;
     }
 
     virtual bool SetLinkVelocity(KinBody::LinkPtr plink, const Vector& _linearvel, const Vector& angularvel)
@@ -491,6 +544,7 @@ The possible properties that can be set are: ";
 
     virtual void SimulateStep(OpenRAVE::dReal fTimeElapsed)
     {
+        uint64_t starttime = OpenRAVE::utils::GetMicroTime();
         _odespace->Synchronize();
 
         bool bHasCallbacks = GetEnv()->HasRegisteredCollisionCallbacks();
@@ -501,6 +555,10 @@ The possible properties that can be set are: ";
             _listcallbacks.clear();
         }
 
+        uint64_t collisionstarttime = OpenRAVE::utils::GetMicroTime();
+        // with collision workers, only gather the candidate pairs and compute their contacts in parallel afterwards
+        _bCollectPairs = !!_pCollideWorkers;
+        _vcandidatepairs.resize(0);
         dSpaceCollide (_odespace->GetSpace(),this,nearCallback);
 
         vector<KinBodyPtr> vbodies;
@@ -514,9 +572,23 @@ The possible properties that can be set are: ";
                 }
             }
         }
+        _bCollectPairs = false;
+        if( _vcandidatepairs.size() > 0 ) {
+            _vpaircontacts.resize(_vcandidatepairs.size()*s_nMaxPairContacts);
+            _pCollideWorkers->Run(_vcandidatepairs.size(), boost::bind(&ODEPhysicsEngine::_CollidePairRange, this, _1, _2));
+            for(size_t ipair = 0; ipair < _vcandidatepairs.size(); ++ipair) {
+                CandidatePair& pair = _vcandidatepairs[ipair];
+                if( pair.numcontacts > 0 ) {
+                    _AddContacts(pair.o1, pair.b1, pair.b2, pair.plink1, pair.plink2, &_vpaircontacts[ipair*s_nMaxPairContacts], pair.numcontacts);
+                }
+            }
+            _vcandidatepairs.resize(0);
+        }
 
+        uint64_t solvestarttime = OpenRAVE::utils::GetMicroTime();
         dWorldQuickStep(_odespace->GetWorld(), fTimeElapsed);
         dJointGroupEmpty (_odespace->GetContactGroup());
+        uint64_t syncstarttime = OpenRAVE::utils::GetMicroTime();
 
         // synchronize all the objects from the ODE world to the OpenRAVE world
         Transform t;
@@ -545,6 +617,11 @@ The possible properties that can be set are: ";
         }
 
         _listcallbacks.clear();
+        uint64_t endtime = OpenRAVE::utils::GetMicroTime();
+        ++_nNumSteps;
+        _nCollisionTime += solvestarttime-collisionstarttime;
+        _nSolveTime += syncstarttime-solvestarttime;
+        _nSyncTime += (collisionstarttime-starttime) + (endtime-syncstarttime);
     }
 
 
@@ -601,13 +678,43 @@ private:
                 return;
         }
 
-        const int N = 16;
-        dContact contact[N];
-        int n = dCollide (o1,o2,N,&contact[0].geom,sizeof(dContact));
+        if( _bCollectPairs ) {
+            CandidatePair pair;
+            pair.o1 = o1;
+            pair.o2 = o2;
+            pair.b1 = b1;
+            pair.b2 = b2;
+            pair.plink1 = pkb1;
+            pair.plink2 = pkb2;
+            pair.numcontacts = 0;
+            _vcandidatepairs.push_back(pair);
+            return;
+        }
+
+        dContact contact[s_nMaxPairContacts];
+        int n = dCollide (o1,o2,s_nMaxPairContacts,&contact[0].geom,sizeof(dContact));
         if( n <= 0 ) {
             return;
         }
+        _AddContacts(o1, b1, b2, pkb1, pkb2, contact, n);
+    }
 
+    /// \brief computes the contacts of the candidate pairs [start,end), called from the collision workers
+    void _CollidePairRange(size_t start, size_t end)
+    {
+#ifdef ODE_HAVE_ALLOCATE_DATA_THREAD
+        dAllocateODEDataForThread(dAllocateMaskAll);
+#endif
+        for(size_t ipair = start; ipair < end; ++ipair) {
+            CandidatePair& pair = _vcandidatepairs[ipair];
+            dContact* contact = &_vpaircontacts[ipair*s_nMaxPairContacts];
+            pair.numcontacts = dCollide(pair.o1, pair.o2, s_nMaxPairContacts, &contact[0].geom, sizeof(dContact));
+        }
+    }
+
+    /// \brief calls the collision callbacks and creates the contact joints of a colliding pair
+    void _AddContacts(dGeomID o1, dBodyID b1, dBodyID b2, KinBody::LinkPtr pkb1, KinBody::LinkPtr pkb2, dContact* contact, int n)
+    {
         if( _listcallbacks.size() > 0 ) {
             // fill the collision report
             _report->Reset(OpenRAVE::CO_Contacts);
@@ -667,6 +774,61 @@ private:
         //        dJointAttach (c,b1,b2);
     }
 
+    bool _SetNumThreadsCommand(ostream& sout, istream& sinput)
+    {
+        int numthreads = 1;
+        sinput >> numthreads;
+        if( !sinput ) {
+            return false;
+        }
+        SetNumThreads(numthreads);
+        return true;
+    }
+
+    bool _GetStepTimesCommand(ostream& sout, istream& sinput)
+    {
+        sout << _nNumSteps << " " << _nCollisionTime*1e-6 << " " << _nSolveTime*1e-6 << " " << _nSyncTime*1e-6;
+        return true;
+    }
+
+    bool _ResetStepTimesCommand(ostream& sout, istream& sinput)
+    {
+        ResetStepTimes();
+        return true;
+    }
+
+    /// \brief lets ode solve the islands of the world in parallel if there is more than one thread
+    void _InitStepThreading()
+    {
+#ifdef ODE_HAVE_THREADING_IMPL
+        if( _nNumThreads <= 1 || !_odespace->IsInitialized() || _threadingimpl != NULL ) {
+            return;
+        }
+        _threadingimpl = dThreadingAllocateMultiThreadedImplementation();
+        _threadpool = dThreadingAllocateThreadPool(_nNumThreads, 0, dAllocateFlagBasicData, NULL);
+        dThreadingThreadPoolServeMultiThreadedImplementation(_threadpool, _threadingimpl);
+        dWorldSetStepIslandsProcessingMaxThreadCount(_odespace->GetWorld(), _nNumThreads);
+        dWorldSetStepThreadingImplementation(_odespace->GetWorld(), dThreadingImplementationGetFunctions(_threadingimpl), _threadingimpl);
+#endif
+    }
+
+    void _DestroyStepThreading()
+    {
+#ifdef ODE_HAVE_THREADING_IMPL
+        if( _threadingimpl == NULL ) {
+            return;
+        }
+        dThreadingImplementationShutdownProcessing(_threadingimpl);
+        dThreadingFreeThreadPool(_threadpool);
+        if( _odespace->IsInitialized() ) {
+            dWorldSetStepThreadingImplementation(_odespace->GetWorld(), NULL, NULL);
+        }
+        dThreadingFreeImplementation(_threadingimpl);
+        _threadingimpl = NULL;
+        _threadpool = NULL;
+#endif
+    }
+
     void _SyncCallback(ODESpace::KinBodyInfoConstPtr pinfo)
     {
         // things very difficult when dynamics are not reset
@@ -706,6 +868,29 @@ private:
     vector<JointGetFn> _jointgetvel[12];
     std::list<EnvironmentBase::CollisionCallbackFn> _listcallbacks;
     CollisionReportPtr _report;
+
+    /// \brief a pair of geometries that passed the filters of _nearCallback, its contacts are computed by the collision workers
+    struct CandidatePair
+    {
+        dGeomID o1, o2;
+        dBodyID b1, b2;
+        KinBody::LinkPtr plink1, plink2;
+        int numcontacts;
+    };
+    static const int s_nMaxPairContacts = 16; ///< max contacts computed for a pair of geometries
+
+    int _nNumThreads; ///< number of threads used by SimulateStep
+    ParallelRangeWorkersPtr _pCollideWorkers; ///< computes the contacts of the candidate pairs, only set if _nNumThreads > 1 and ode supports multi-threading
+    bool _bCollectPairs; ///< if true, _nearCallback adds the pairs to _vcandidatepairs instead of colliding them
+    std::vector<CandidatePair> _vcandidatepairs;
+    std::vector<dContact> _vpaircontacts; ///< s_nMaxPairContacts contacts for every candidate pair
+#ifdef ODE_HAVE_THREADING_IMPL
+    dThreadingImplementationID _threadingimpl;
+    dThreadingThreadPoolID _threadpool;
+#endif
+
+    uint64_t _nNumSteps; ///< number of SimulateStep calls since ResetStepTimes
+    uint64_t _nCollisionTime, _nSolveTime, _nSyncTime; ///< accumulated microseconds of the collision, solve and sync (OpenRAVE <-> ode transforms) phases of SimulateStep
 };
 
 #endif
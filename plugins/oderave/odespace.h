@@ -50,6 +50,7 @@ public:
 #endif
             world = dWorldCreate();
             space = dHashSpaceCreate(0);
+            staticspace = NULL;
             contactgroup = dJointGroupCreate(0);
         }
         virtual ~ODEResources() {
@@ -59,6 +60,9 @@ public:
             if( space ) {
                 dSpaceDestroy(space);
             }
+            if( staticspace ) {
+                dSpaceDestroy(staticspace);
+            }
             if( world ) {
                 dWorldDestroy(world);
             }
@@ -68,11 +72,42 @@ public:
         }
         dWorldID world;          ///< the dynamics world
         dSpaceID space;          ///< the collision world
+        dSpaceID staticspace;    ///< if not NULL, holds the spaces of the bodies that did not move since they were added, see ODESpace::SetStaticSpaceType
         dJointGroupID contactgroup;
         boost::mutex _mutex;
     };
 
 public:
+    /// \brief trimesh data built from a collision mesh, shared by all the geometries of the space with an identical mesh
+    class ODETriMeshData
+    {
+public:
+        ODETriMeshData(const OpenRAVE::TriMesh& mesh)
+        {
+            pindices = new dTriIndex[mesh.indices.size()];
+            for(size_t i = 0; i < mesh.indices.size(); ++i) {
+                pindices[i] = mesh.indices[i];
+            }
+            pvertices = new dReal[4*mesh.vertices.size()];
+            for(size_t i = 0; i < mesh.vertices.size(); ++i) {
+                Vector v = mesh.vertices[i];
+                pvertices[4*i+0] = v.x; pvertices[4*i+1] = v.y; pvertices[4*i+2] = v.z;
+            }
+            id = dGeomTriMeshDataCreate();
+            dGeomTriMeshDataBuildSimple(id, pvertices, mesh.vertices.size(), pindices, mesh.indices.size());
+        }
+        virtual ~ODETriMeshData() {
+            dGeomTriMeshDataDestroy(id);
+            delete[] pindices;
+            delete[] pvertices;
+        }
+
+        dTriMeshDataID id;
+        dTriIndex* pindices;
+        dReal* pvertices;
+    };
+    typedef boost::shared_ptr<ODETriMeshData> ODETriMeshDataPtr;
+
     // information about the kinematics of the body
     class KinBodyInfo : public boost::enable_shared_from_this<KinBodyInfo>, public OpenRAVE::UserData
     {
@@ -82,7 +117,7 @@ public:
             LINK() : body(NULL), geom(NULL), _bEnabled(true) {
             }
             virtual ~LINK() {
-                BOOST_ASSERT(listtrimeshinds.size()==0&&listvertices.size()==0&&body==NULL&&geom==NULL);
+                BOOST_ASSERT(listtrimeshdata.size()==0&&body==NULL&&geom==NULL);
             }
 
             dBodyID body;
@@ -127,19 +162,20 @@ public:
                 return _plink.lock();
             }
 
-            list<dTriIndex*> listtrimeshinds;
-            list<dReal*> listvertices;
+            list<ODETriMeshDataPtr> listtrimeshdata; ///< keeps the trimesh data of the geometries alive
             KinBody::LinkWeakPtr _plink;
             bool _bEnabled;
             Transform tlinkmass, tlinkmassinv; // the local mass frame ODE was initialized with
             std::string bodylinkname; // for debugging purposes
         };
 
-        KinBodyInfo(boost::shared_ptr<ODEResources> ode) : _ode(ode)
+        /// \param parentspace the space the space of the body is added to, either the collision world or the static space
+        KinBodyInfo(boost::shared_ptr<ODEResources> ode, dSpaceID parentspace) : _ode(ode)
         {
             jointgroup = dJointGroupCreate(0);
-            space = dHashSpaceCreate(_ode->space);
+            space = dHashSpaceCreate(parentspace);
             nLastStamp = 0;
+            _bStatic = parentspace != NULL && parentspace == _ode->staticspace;
         }
 
         virtual ~KinBodyInfo() {
@@ -155,22 +191,10 @@ public:
         void Reset()
         {
             FOREACH(itlink, vlinks) {
+                // the trimesh data can be shared with other bodies, so only destroy the geometries and release the data below
                 dGeomID curgeom = (*itlink)->geom;
                 while(curgeom) {
                     dGeomID pnextgeom = dBodyGetNextGeom(curgeom);
-                    if( dGeomGetClass(curgeom) == dGeomTransformClass ) {
-                        dGeomID childgeom = dGeomTransformGetGeom(curgeom);
-                        if(( childgeom != NULL) &&( dGeomGetClass(childgeom) == dTriMeshClass) ) {
-                            if( dGeomTriMeshGetData(childgeom) != 0 ) {
-                                dGeomTriMeshDataDestroy(dGeomTriMeshGetData(childgeom));
-                            }
-                        }
-                    }
-                    else if( dGeomGetClass(curgeom) == dTriMeshClass ) {
-                        if( dGeomTriMeshGetData(curgeom) != 0 ) {
-                            dGeomTriMeshDataDestroy(dGeomTriMeshGetData(curgeom));
-                        }
-                    }
                     dGeomDestroy(curgeom);
                     curgeom = pnextgeom;
                 }
@@ -179,14 +203,7 @@ public:
                     dBodyDestroy((*itlink)->body);
                     (*itlink)->body = NULL;
                 }
-                FOREACH(itind, (*itlink)->listtrimeshinds) {
-                    delete[] *itind;
-                }
-                (*itlink)->listtrimeshinds.clear();
-                FOREACH(itind, (*itlink)->listvertices) {
-                    delete[] *itind;
-                }
-                (*itlink)->listvertices.clear();
+                (*itlink)->listtrimeshdata.clear();
                 (*itlink)->_bEnabled = false;
             }
             vlinks.resize(0);
@@ -200,6 +217,7 @@ public:
 
             _geometrycallback.reset();
             _staticcallback.reset();
+            _linkenablecallback.reset();
         }
 
         KinBodyPtr GetBody() {
@@ -216,10 +234,12 @@ public:
         vector<dJointID> vjoints;
         vector<dJointFeedback> vjointfeedback;
         OpenRAVE::UserDataPtr _geometrycallback, _staticcallback;
+        OpenRAVE::UserDataPtr _linkenablecallback; ///< applies link enable changes without resyncing the transforms
         boost::weak_ptr<ODESpace> _odespace;
 
         dSpaceID space;                             ///< space that contanis all the collision objects of this chain
         dJointGroupID jointgroup;
+        bool _bStatic; ///< true if space is in the static space of the resources
 
 private:
         boost::shared_ptr<ODEResources> _ode;
@@ -229,7 +249,7 @@ private:
     typedef boost::shared_ptr<KinBodyInfo const> KinBodyInfoConstPtr;
     typedef boost::function<void (KinBodyInfoPtr)> SynchronizeCallbackFn;
 
-    ODESpace(EnvironmentBasePtr penv, const std::string& userdatakey, bool bUsingPhysics) : _penv(penv), _userdatakey(userdatakey), _bUsingPhysics(bUsingPhysics)
+    ODESpace(EnvironmentBasePtr penv, const std::string& userdatakey, bool bUsingPhysics) : _penv(penv), _userdatakey(userdatakey), _bUsingPhysics(bUsingPhysics), _staticspacetype("none"), _nStaticQuadTreeDepth(0), _nLastTriMeshDataCleanSize(64)
     {
         static bool s_bIsODEInitialized = false;
         if( !s_bIsODEInitialized ) {
@@ -258,9 +278,57 @@ private:
 
         RAVELOG_VERBOSE("init ode collision environment\n");
         _ode.reset(new ODEResources());
+        return _CreateStaticSpace();
+    }
+
+    /** \brief sets the space that holds the bodies that do not move, so the queries do not rebuild its structure every time
+    
+        Bodies without degrees of freedom start in the static space when they are added. The first time one moves it goes to the
+        collision world for good, so the static space only changes when bodies are added or removed. All the bodies are
+        initialized again when the type changes. Only the collision checker can use a static space, the physics engine needs all
+        the bodies in the same world.
+        \param type one of "none" (a single hash space for all the bodies), "hash", "sap" (sweep and prune) or "quadtree"
+        \param center the center of the quadtree
+        \param extents the half extents of the quadtree
+        \param depth the depth of the quadtree
+     */
+    bool SetStaticSpaceType(const std::string& type, const Vector& center=Vector(), const Vector& extents=Vector(10,10,10), int depth=6)
+    {
+        if( type != "none" && type != "hash" && type != "sap" && type != "quadtree" ) {
+            RAVELOG_WARN_FORMAT("unknown static space type %s", type);
+            return false;
+        }
+        if( type != "none" && _bUsingPhysics ) {
+            RAVELOG_WARN("physics needs all the bodies in one space, cannot use a static space\n");
+            return false;
+        }
+#ifndef ODE_HAVE_SPACE_SUBLEVEL
+        if( type != "none" ) {
+            RAVELOG_WARN("ode does not support space sublevels, cannot use a static space\n");
+            return false;
+        }
+#endif
+        _staticspacetype = type;
+        _vStaticQuadTreeCenter = center;
+        _vStaticQuadTreeExtents = extents;
+        _nStaticQuadTreeDepth = depth;
+        if( !!_ode ) {
+            // the spaces of the bodies are children of the old space, they are created again on the next synchronization
+            DestroyEnvironment();
+            boost::mutex::scoped_lock lockode(_ode->_mutex);
+            if( !!_ode->staticspace ) {
+                dSpaceDestroy(_ode->staticspace);
+                _ode->staticspace = NULL;
+            }
+            return _CreateStaticSpace();
+        }
         return true;
     }
 
+    const std::string& GetStaticSpaceType() const {
+        return _staticspacetype;
+    }
+
     void Destroy()
     {
         DestroyEnvironment();
@@ -294,7 +362,8 @@ private:
 
         // create all ode bodies and joints
         if( !pinfo ) {
-            pinfo.reset(new KinBodyInfo(_ode));
+            bool bstatic = !!_ode->staticspace && pbody->GetDOF() == 0 && !pbody->IsRobot();
+            pinfo.reset(new KinBodyInfo(_ode, bstatic ? _ode->staticspace : _ode->space));
         }
         pinfo->Reset();
         pinfo->_pbody = boost::const_pointer_cast<KinBody>(pbody);
@@ -482,6 +551,7 @@ private:
         if( _bUsingPhysics ) {
             pinfo->_staticcallback = pbody->RegisterChangeCallback(KinBody::Prop_LinkStatic|KinBody::Prop_LinkDynamics, boost::bind(&ODESpace::_ResetKinBodyCallback,boost::bind(&OpenRAVE::utils::sptr_from<ODESpace>, weak_space()),boost::weak_ptr<KinBody const>(pbody)));
         }
+        pinfo->_linkenablecallback = pbody->RegisterChangeCallback(KinBody::Prop_LinkEnable, boost::bind(&ODESpace::_LinkEnableCallback,boost::bind(&OpenRAVE::utils::sptr_from<ODESpace>, weak_space()),boost::weak_ptr<KinBodyInfo>(pinfo)));
 
         pbody->SetUserData(_userdatakey, pinfo);
         _setInitializedBodies.insert(pbody);
@@ -597,6 +667,15 @@ private:
     dSpaceID GetSpace() const {
         return _ode->space;
     }
+    /// \brief returns the space of the bodies that did not move or NULL, see \ref SetStaticSpaceType
+    dSpaceID GetStaticSpace() const {
+        return _ode->staticspace;
+    }
+    /// \brief returns true if the space of the body is in the static space
+    bool IsStatic(KinBodyConstPtr pbody) {
+        KinBodyInfoPtr pinfo = GetInfo(pbody);
+        return !!pinfo && pinfo->_bStatic;
+    }
     dJointGroupID GetContactGroup() const {
         return _ode->contactgroup;
     }
@@ -625,6 +704,33 @@ private:
     }
 
 private:
+    /// \brief creates the static space of _ode depending on _staticspacetype
+    bool _CreateStaticSpace()
+    {
+#ifdef ODE_HAVE_SPACE_SUBLEVEL
+        if( _staticspacetype == "hash" ) {
+            _ode->staticspace = dHashSpaceCreate(0);
+        }
+        else if( _staticspacetype == "sap" ) {
+            _ode->staticspace = dSweepAndPruneSpaceCreate(0, dSAP_AXES_XYZ);
+        }
+        else if( _staticspacetype == "quadtree" ) {
+            dVector3 center, extents;
+            for(int j = 0; j < 3; ++j) {
+                center[j] = _vStaticQuadTreeCenter[j];
+                extents[j] = _vStaticQuadTreeExtents[j];
+            }
+            center[3] = extents[3] = 0;
+            _ode->staticspace = dQuadTreeSpaceCreate(0, center, extents, _nStaticQuadTreeDepth);
+        }
+        if( !!_ode->staticspace ) {
+            // one level above the spaces of the bodies, so colliding a body space with it returns pairs of body spaces
+            dSpaceSetSublevel(_ode->staticspace, 1);
+        }
+#endif
+        return true;
+    }
+
     dGeomID _CreateODEGeomFromGeometryInfo(dSpaceID space, boost::shared_ptr<KinBodyInfo::LINK> link, const KinBody::GeometryInfo& info)
     {
         dGeomID odegeom = NULL;
@@ -641,22 +747,12 @@ private:
             odegeom = dCreateCylinder(0,info._vGeomData.x,info._vGeomData.y);
             break;
         case OpenRAVE::GT_Container:
+        case OpenRAVE::GT_Octree:
         case OpenRAVE::GT_TriMesh:
             if( info._meshcollision.indices.size() > 0 ) {
-                dTriIndex* pindices = new dTriIndex[info._meshcollision.indices.size()];
-                for(size_t i = 0; i < info._meshcollision.indices.size(); ++i) {
-                    pindices[i] = info._meshcollision.indices[i];
-                }
-                dReal* pvertices = new dReal[4*info._meshcollision.vertices.size()];
-                for(size_t i = 0; i < info._meshcollision.vertices.size(); ++i) {
-                    Vector v = info._meshcollision.vertices[i];
-                    pvertices[4*i+0] = v.x; pvertices[4*i+1] = v.y; pvertices[4*i+2] = v.z;
-                }
-                dTriMeshDataID id = dGeomTriMeshDataCreate();
-                dGeomTriMeshDataBuildSimple(id, pvertices, info._meshcollision.vertices.size(), pindices, info._meshcollision.indices.size());
-                odegeom = dCreateTriMesh(0, id, NULL, NULL, NULL);
-                link->listtrimeshinds.push_back(pindices);
-                link->listvertices.push_back(pvertices);
+                ODETriMeshDataPtr ptrimeshdata = _GetTriMeshData(info._meshcollision);
+                odegeom = dCreateTriMesh(0, ptrimeshdata->id, NULL, NULL, NULL);
+                link->listtrimeshdata.push_back(ptrimeshdata);
             }
             break;
         default:
@@ -681,6 +777,36 @@ private:
         return odegeomtrans;
     }
 
+    /// \brief returns the trimesh data of mesh, builds it if no other geometry of the space uses an identical mesh
+    ///
+    /// Many instances of the same body share their collision meshes this way. Only weak references are kept, so the data is destroyed
+    /// with the last geometry using it.
+    ODETriMeshDataPtr _GetTriMeshData(const OpenRAVE::TriMesh& mesh)
+    {
+        TriMeshKey key(mesh.ComputeHash(), std::make_pair(mesh.vertices.size(), mesh.indices.size()));
+        boost::mutex::scoped_lock lock(_mutexTriMeshData);
+        boost::weak_ptr<ODETriMeshData>& pcached = _mapTriMeshData[key];
+        ODETriMeshDataPtr ptrimeshdata = pcached.lock();
+        if( !ptrimeshdata ) {
+            ptrimeshdata.reset(new ODETriMeshData(mesh));
+            pcached = ptrimeshdata;
+            if( _mapTriMeshData.size() >= 2*_nLastTriMeshDataCleanSize ) {
+                // drop the data that is not used anymore
+                std::map<TriMeshKey, boost::weak_ptr<ODETriMeshData> >::iterator it = _mapTriMeshData.begin();
+                while(it != _mapTriMeshData.end()) {
+                    if( it->second.expired() ) {
+                        _mapTriMeshData.erase(it++);
+                    }
+                    else {
+                        ++it;
+                    }
+                }
+                _nLastTriMeshDataCleanSize = std::max(_mapTriMeshData.size(), (size_t)64);
+            }
+        }
+        return ptrimeshdata;
+    }
+
     /// \param block if true, then will lock _ode->_mutex. Set to false when mutex is known to be already locked.
     void _Synchronize(KinBodyInfoPtr pinfo, bool block=true)
     {
@@ -689,6 +815,12 @@ private:
             if( block ) {
                 lockode.reset(new boost::mutex::scoped_lock(_ode->_mutex));
             }
+            if( pinfo->_bStatic && pinfo->nLastStamp != 0 ) {
+                // moved after it was added, so keep it out of the static space from now on
+                dSpaceRemove(_ode->staticspace, (dGeomID)pinfo->space);
+                dSpaceAdd(_ode->space, (dGeomID)pinfo->space);
+                pinfo->_bStatic = false;
+            }
             vector<Transform> vtrans;
             KinBodyPtr pbody = pinfo->GetBody();
             pbody->GetLinkTransformations(vtrans, pinfo->_vdofbranches);
@@ -711,6 +843,28 @@ private:
         }
     }
 
+    /// \brief toggles the geoms of the links without touching their transforms
+    ///
+    /// If enabling was the only change since the last synchronization, the stamp is caught up so that the next _Synchronize does not resync the transforms or move a static body out of the static space.
+    void _LinkEnableCallback(boost::weak_ptr<KinBodyInfo> _pinfo)
+    {
+        KinBodyInfoPtr pinfo = _pinfo.lock();
+        if( !pinfo ) {
+            return;
+        }
+        KinBodyPtr pbody = pinfo->GetBody();
+        if( !pbody ) {
+            return;
+        }
+        boost::mutex::scoped_lock lockode(_ode->_mutex);
+        FOREACH(it, pinfo->vlinks) {
+            (*it)->Enable((*it)->GetLink()->IsEnabled());
+        }
+        if( pinfo->nLastStamp != 0 && pinfo->nLastStamp+1 == pbody->GetUpdateStamp() ) {
+            pinfo->nLastStamp = pbody->GetUpdateStamp();
+        }
+    }
+
     void _ResetKinBodyCallback(boost::weak_ptr<KinBody const> _pbody)
     {
         KinBodyConstPtr pbody(_pbody);
@@ -730,6 +884,14 @@ private:
     SynchronizeCallbackFn _synccallback;
     std::set<KinBodyConstPtr> _setInitializedBodies; ///< set of bodies that have been initialized and user data is set
     bool _bUsingPhysics;
+    std::string _staticspacetype; ///< see SetStaticSpaceType
+    Vector _vStaticQuadTreeCenter, _vStaticQuadTreeExtents;
+    int _nStaticQuadTreeDepth;
+
+    typedef std::pair<size_t, std::pair<size_t, size_t> > TriMeshKey; ///< hash, number of vertices and number of indices of a mesh
+    std::map<TriMeshKey, boost::weak_ptr<ODETriMeshData> > _mapTriMeshData; ///< see _GetTriMeshData, protected by _mutexTriMeshData
+    size_t _nLastTriMeshDataCleanSize; ///< size of _mapTriMeshData after the last removal of the expired data
+    boost::mutex _mutexTriMeshData;
 };
 
 #ifdef RAVE_REGISTER_BOOST
@@ -18,6 +18,7 @@
 #define  COLPQP_H
 
 #include "pqp/PQP.h"
+#include "parallelrangeworkers.h"
 #include <boost/lexical_cast.hpp>
 
 //wrapper class for PQP, distance and tolerance checking is _off_ by default, collision checking is _on_ by default
@@ -53,6 +54,9 @@ public:
         _benablecol = true;
         _benabledis = false;
         _benabletol = false;
+        _options = 0;
+        _nNumThreads = 1;
+        RegisterCommand("SetNumThreads", boost::bind(&CollisionCheckerPQP::_SetNumThreadsCommand, this, _1, _2), "sets the number of threads evaluating the link pairs that pass the broadphase. 0 uses the number of hardware threads, 1 (default) evaluates them in the calling thread. Only pure collision queries without distance, tolerance, or collision callbacks are parallelized.");
     }
     virtual ~CollisionCheckerPQP() {
         DestroyEnvironment();
@@ -245,23 +249,18 @@ public:
             report->Reset(_options);
         }
         _pactiverobot.reset();
-        int tmpnumcols = 0;
-        int tmpnumwithintol = 0;
-        bool retval;
 
         _InitKinBody(plink->GetParent());
 
         std::vector<KinBodyPtr> vecbodies;
         GetEnv()->GetBodies(vecbodies);
 
-        PQP_REAL R1[3][3], R2[3][3], T1[3], T2[3];
-
-        std::vector<Transform> vtrans1,vtrans2;
-        plink->GetParent()->GetLinkTransformations(vtrans1);
+        std::vector<LinkBox> vboxes1, vboxes2;
+        _CollectLinkBoxes(std::vector<KinBody::LinkPtr>(1, boost::const_pointer_cast<KinBody::Link>(plink)), std::vector<KinBody::LinkConstPtr>(), vboxes1);
+        std::vector<LinkPair> vpairs;
+        size_t numtestedpairs = 0;
+        int bodygroup = 0;
         FOREACH(itbody,vecbodies) {
-            if(!!report) {
-                report->numWithinTol = 0;
-            }
             KinBodyPtr pbody2 = *itbody;
 
             if(plink->GetParent()->IsAttached(KinBodyConstPtr(pbody2)) ) {
@@ -271,44 +270,12 @@ public:
                 continue;
             }
             _InitKinBody(pbody2);
-            std::vector<KinBody::LinkPtr> veclinks2 = pbody2->GetLinks();
-            pbody2->GetLinkTransformations(vtrans2);
-            GetPQPTransformFromTransform(vtrans1[plink->GetIndex()],R1,T1);
-
-            for(int j = 0; j < (int)vtrans2.size(); j++) {
-                if(plink == veclinks2[j]) {
-                    continue;
-                }
-                if( find(vlinkexcluded.begin(),vlinkexcluded.end(),veclinks2[j]) != vlinkexcluded.end() ) {
-                    continue;
-                }
-                GetPQPTransformFromTransform(vtrans2[j],R2,T2);
-
-                retval = DoPQP(plink,R1,T1,veclinks2[j],R2,T2,report);
-                if(!report && _benablecol && !_benabledis && !_benabletol && retval) {
-                    return true;
-                }
-                //return tolerance check result when it is the only thing enabled and there is no report
-                if(!report && !_benablecol && !_benabledis && _benabletol && retval) {
-                    return true;
-                }
-                if( retval ) {
-                    ++tmpnumcols;
-                }
-            }
-
-            if(!!report) {
-                if(report->numWithinTol > 0) {
-                    tmpnumwithintol++;
-                }
-            }
+            vboxes2.resize(0);
+            _CollectLinkBoxes(pbody2->GetLinks(), vlinkexcluded, vboxes2);
+            numtestedpairs += vboxes1.size()*vboxes2.size();
+            _AddCandidatePairs(vboxes1, vboxes2, bodygroup++, vpairs);
         }
-
-        if(!!report) {
-            report->numWithinTol = tmpnumwithintol;
-        }
-
-        return tmpnumcols>0;
+        return _CheckCandidatePairs(vpairs, report, true, numtestedpairs);
     }
 
     virtual bool CheckCollision(KinBodyConstPtr pbody, const std::vector<KinBodyConstPtr>& vbodyexcluded, const std::vector<KinBody::LinkConstPtr>& vlinkexcluded, CollisionReportPtr report)
@@ -421,98 +388,245 @@ public:
         _benabletol = true; _tolerance = tol;
     }
 
-private:
-    // does not check attached
-    bool CheckCollisionP(KinBodyConstPtr pbody1, const std::vector<KinBodyConstPtr>& vbodyexcluded, const std::vector<KinBody::LinkConstPtr>& vlinkexcluded, CollisionReportPtr report)
+    /// \brief sets the number of threads evaluating the candidate link pairs, 0 uses the number of hardware threads
+    void SetNumThreads(int numthreads)
     {
-        int tmpnumcols = 0;
-        int tmpnumwithintol = 0;
-        bool retval;
+        if( numthreads <= 0 ) {
+            numthreads = std::max(1, (int)boost::thread::hardware_concurrency());
+        }
+        if( numthreads == _nNumThreads ) {
+            return;
+        }
+        _nNumThreads = numthreads;
+        _pCollideWorkers.reset();
+        if( _nNumThreads > 1 ) {
+            _pCollideWorkers.reset(new ParallelRangeWorkers(_nNumThreads, "PQPCollide"));
+        }
+    }
 
-        std::vector<KinBodyPtr> vecbodies;
-        GetEnv()->GetBodies(vecbodies);
+private:
+    /// \brief a pair of links whose AABBs passed the broadphase
+    struct LinkPair
+    {
+        KinBody::LinkConstPtr plink1, plink2;
+        boost::shared_ptr<PQP_Model> pmodel1, pmodel2;
+        PQP_REAL R1[3][3], T1[3], R2[3][3], T2[3];
+        dReal fBoundDistance; ///< distance between the AABBs of the links, a lower bound of their distance
+        int bodygroup; ///< index of the body of plink2 in the query, used for counting the bodies within tolerance
+        bool bCollision; ///< result of the parallel narrowphase
+    };
 
-        PQP_REAL R1[3][3], R2[3][3], T1[3], T2[3];
+    /// \brief a link that can be tested along with its world AABB
+    struct LinkBox
+    {
+        KinBody::LinkConstPtr plink;
+        boost::shared_ptr<PQP_Model> pmodel;
+        AABB ab;
+        inline bool operator<(const LinkBox& r) const {
+            return ab.pos.x - ab.extents.x < r.ab.pos.x - r.ab.extents.x;
+        }
+    };
 
-        std::vector<Transform> vtrans1,vtrans2;
-        pbody1->GetLinkTransformations(vtrans1);
-        _InitKinBody(pbody1);
+    bool _SetNumThreadsCommand(ostream& sout, istream& sinput)
+    {
+        int numthreads = 1;
+        sinput >> numthreads;
+        if( !sinput ) {
+            return false;
+        }
+        SetNumThreads(numthreads);
+        return true;
+    }
 
-        std::vector<KinBody::LinkPtr> veclinks1 = pbody1->GetLinks();
-        FOREACH(itbody,vecbodies) {
-            if(!!report) {
-                report->numWithinTol = 0;
+    /// \brief appends the links that can collide, i.e. enabled, active, and with geometry
+    void _CollectLinkBoxes(const std::vector<KinBody::LinkPtr>& vlinks, const std::vector<KinBody::LinkConstPtr>& vlinkexcluded, std::vector<LinkBox>& vboxes)
+    {
+        FOREACHC(itlink, vlinks) {
+            if( !(*itlink)->IsEnabled() || !_IsActiveLink((*itlink)->GetParent(), (*itlink)->GetIndex()) ) {
+                continue;
             }
-            KinBodyPtr pbody2 = *itbody;
-
-            if(pbody1->IsAttached(KinBodyConstPtr(pbody2)) ) {
+            if( find(vlinkexcluded.begin(),vlinkexcluded.end(),*itlink) != vlinkexcluded.end() ) {
                 continue;
             }
-            if( find(vbodyexcluded.begin(),vbodyexcluded.end(),pbody2) != vbodyexcluded.end() ) {
+            LinkBox box;
+            box.pmodel = GetLinkModel(*itlink);
+            if( !box.pmodel ) {
                 continue;
             }
+            box.plink = *itlink;
+            box.ab = (*itlink)->ComputeAABB();
+            vboxes.push_back(box);
+        }
+    }
 
-            _InitKinBody(pbody2);
-            std::vector<KinBody::LinkPtr> veclinks2 = pbody2->GetLinks();
-            pbody2->GetLinkTransformations(vtrans2);
-            for(int i = 0; i < (int)vtrans1.size(); i++) {
-                if(find(vlinkexcluded.begin(),vlinkexcluded.end(),veclinks1[i]) != vlinkexcluded.end()) {
+    /// \brief broadphase, sweeps the AABBs of vboxes2 along x and appends the pairs that can collide with the links of vboxes1 to vpairs.
+    ///
+    /// When computing distances no pair is culled since the closest pair is needed, the AABB distance is still stored for pruning the narrowphase.
+    void _AddCandidatePairs(const std::vector<LinkBox>& vboxes1, std::vector<LinkBox>& vboxes2, int bodygroup, std::vector<LinkPair>& vpairs)
+    {
+        dReal fmargin = _benabletol ? dReal(_tolerance) : dReal(0);
+        std::sort(vboxes2.begin(), vboxes2.end());
+        FOREACHC(itbox1, vboxes1) {
+            const AABB& ab1 = itbox1->ab;
+            FOREACHC(itbox2, vboxes2) {
+                if( itbox1->plink == itbox2->plink ) {
+                    continue;
+                }
+                const AABB& ab2 = itbox2->ab;
+                if( !_benabledis && ab2.pos.x - ab2.extents.x > ab1.pos.x + ab1.extents.x + fmargin ) {
+                    // all the remaining boxes start after this one ends
+                    break;
+                }
+                dReal fdistsqr = 0;
+                for(int j = 0; j < 3; ++j) {
+                    dReal fgap = RaveFabs(ab1.pos[j] - ab2.pos[j]) - ab1.extents[j] - ab2.extents[j];
+                    if( fgap > 0 ) {
+                        fdistsqr += fgap*fgap;
+                    }
+                }
+                if( !_benabledis && fdistsqr > fmargin*fmargin ) {
                     continue;
                 }
-                GetPQPTransformFromTransform(vtrans1[i],R1,T1);
+                vpairs.push_back(LinkPair());
+                LinkPair& pair = vpairs.back();
+                pair.plink1 = itbox1->plink;
+                pair.plink2 = itbox2->plink;
+                pair.pmodel1 = itbox1->pmodel;
+                pair.pmodel2 = itbox2->pmodel;
+                GetPQPTransformFromTransform(pair.plink1->GetTransform(),pair.R1,pair.T1);
+                GetPQPTransformFromTransform(pair.plink2->GetTransform(),pair.R2,pair.T2);
+                pair.fBoundDistance = RaveSqrt(fdistsqr);
+                pair.bodygroup = bodygroup;
+                pair.bCollision = false;
+            }
+        }
+    }
 
-                for(int j = 0; j < (int)vtrans2.size(); j++) {
-                    if(find(vlinkexcluded.begin(),vlinkexcluded.end(),veclinks2[j]) != vlinkexcluded.end()) {
-                        continue;
+    /// \brief narrowphase of the pairs [start,end), PQP_Collide does not modify the models so the pairs can be split between threads
+    void _CollidePairRange(std::vector<LinkPair>& vpairs, size_t start, size_t end)
+    {
+        PQP_CollideResult colresult;
+        for(size_t ipair = start; ipair < end; ++ipair) {
+            LinkPair& pair = vpairs[ipair];
+            PQP_Collide(&colresult,pair.R1,pair.T1,pair.pmodel1.get(),pair.R2,pair.T2,pair.pmodel2.get(),PQP_FIRST_CONTACT);
+            pair.bCollision = colresult.NumPairs() > 0;
+        }
+    }
+
+    /// \brief evaluates the pairs that passed the broadphase with the same semantics as calling DoPQP on every link pair
+    ///
+    /// \param bCountBodies if true, report->numWithinTol is set to the number of bodies with a link within tolerance instead of the number of link pairs
+    bool _CheckCandidatePairs(std::vector<LinkPair>& vpairs, CollisionReportPtr report, bool bCountBodies, size_t numtestedpairs)
+    {
+        uint64_t starttime = OpenRAVE::utils::GetMicroTime();
+        bool bcollision = false;
+        size_t numnarrowphase = 0;
+        if( _benablecol && !_benabledis && !_benabletol && !GetEnv()->HasRegisteredCollisionCallbacks() ) {
+            if( !!_pCollideWorkers && vpairs.size() >= (size_t)(2*_pCollideWorkers->GetNumThreads()) ) {
+                _pCollideWorkers->Run(vpairs.size(), boost::bind(&CollisionCheckerPQP::_CollidePairRange, this, boost::ref(vpairs), _1, _2));
+            }
+            else {
+                _CollidePairRange(vpairs, 0, vpairs.size());
+            }
+            numnarrowphase = vpairs.size();
+            FOREACH(itpair, vpairs) {
+                if( itpair->bCollision ) {
+                    bcollision = true;
+                    if( !report ) {
+                        break;
                     }
-                    GetPQPTransformFromTransform(vtrans2[j],R2,T2);
-                    retval = DoPQP(veclinks1[i],R1,T1,veclinks2[j],R2,T2,report);
-                    if(!report && _benablecol && !_benabledis && !_benabletol && retval) {
-                        return true;
+                    // fill the report contacts in the same order as the serial version
+                    DoPQP(itpair->plink1,itpair->R1,itpair->T1,itpair->plink2,itpair->R2,itpair->T2,report);
+                }
+            }
+        }
+        else {
+            if( _benabledis ) {
+                // closest pairs first so that the others can be pruned with their AABB distance
+                std::sort(vpairs.begin(), vpairs.end(), boost::bind(&LinkPair::fBoundDistance, _1) < boost::bind(&LinkPair::fBoundDistance, _2));
+            }
+            std::vector<uint8_t> vbodywithintol;
+            if( !!report ) {
+                if( bCountBodies ) {
+                    report->numWithinTol = 0;
+                }
+            }
+            FOREACH(itpair, vpairs) {
+                if( _benabledis && !!report && itpair->fBoundDistance > 0 && itpair->fBoundDistance >= report->minDistance && (!_benabletol || itpair->fBoundDistance > _tolerance) ) {
+                    // cannot collide nor get closer
+                    break;
+                }
+                int prevnumwithintol = !!report ? report->numWithinTol : 0;
+                bool retval = DoPQP(itpair->plink1,itpair->R1,itpair->T1,itpair->plink2,itpair->R2,itpair->T2,report);
+                ++numnarrowphase;
+                if( bCountBodies && !!report && report->numWithinTol > prevnumwithintol ) {
+                    if( (int)vbodywithintol.size() <= itpair->bodygroup ) {
+                        vbodywithintol.resize(itpair->bodygroup+1, 0);
                     }
-                    //return tolerance check result when it is the only thing enabled and there is no report
-                    if(!report && !_benablecol && !_benabledis && _benabletol && retval) {
-                        return true;
+                    vbodywithintol[itpair->bodygroup] = 1;
+                    report->numWithinTol = prevnumwithintol;
+                }
+                if( retval ) {
+                    bcollision = true;
+                    if(!report && _benablecol && !_benabledis && !_benabletol) {
+                        break;
                     }
-                    if( retval ) {
-                        ++tmpnumcols;
+                    //return tolerance check result when it is the only thing enabled and there is no report
+                    if(!report && !_benablecol && !_benabledis && _benabletol) {
+                        break;
                     }
                 }
             }
-            if(!!report) {
-                if(report->numWithinTol > 0) {
-                    tmpnumwithintol++;
-                }
+            if( bCountBodies && !!report ) {
+                report->numWithinTol = std::count(vbodywithintol.begin(), vbodywithintol.end(), 1);
             }
         }
-        if(!!report) {
-            report->numWithinTol = tmpnumwithintol;
-        }
-        return tmpnumcols>0;
+        RAVELOG_VERBOSE_FORMAT("pqp query %fs, %d/%d link pairs passed the broadphase, %d narrowphase tests", (1e-6*(OpenRAVE::utils::GetMicroTime()-starttime))%vpairs.size()%numtestedpairs%numnarrowphase);
+        return bcollision;
     }
 
     // does not check attached
-    bool CheckCollisionP(KinBodyConstPtr pbody1, KinBodyConstPtr pbody2, CollisionReportPtr report)
+    bool CheckCollisionP(KinBodyConstPtr pbody1, const std::vector<KinBodyConstPtr>& vbodyexcluded, const std::vector<KinBody::LinkConstPtr>& vlinkexcluded, CollisionReportPtr report)
     {
+        std::vector<KinBodyPtr> vecbodies;
+        GetEnv()->GetBodies(vecbodies);
         _InitKinBody(pbody1);
-        _InitKinBody(pbody2);
-        PQP_REAL R1[3][3], R2[3][3], T1[3], T2[3];
-        FOREACHC(itlink1,pbody1->GetLinks()) {
-            GetPQPTransformFromTransform((*itlink1)->GetTransform(),R1,T1);
-            FOREACHC(itlink2,pbody2->GetLinks()) {
-                GetPQPTransformFromTransform((*itlink2)->GetTransform(),R2,T2);
-                bool retval = DoPQP(*itlink1,R1,T1,*itlink2,R2,T2,report);
-                if(!report && _benablecol && !_benabledis && !_benabletol && retval) {
-                    return true;
-                }
-                //return tolerance check result when it is the only thing enabled and there is no report
-                if(!report && !_benablecol && !_benabledis && _benabletol && retval) {
-                    return true;
-                }
+
+        std::vector<LinkBox> vboxes1, vboxes2;
+        _CollectLinkBoxes(pbody1->GetLinks(), vlinkexcluded, vboxes1);
+        std::vector<LinkPair> vpairs;
+        size_t numtestedpairs = 0;
+        int bodygroup = 0;
+        FOREACH(itbody,vecbodies) {
+            KinBodyPtr pbody2 = *itbody;
+
+            if(pbody1->IsAttached(KinBodyConstPtr(pbody2)) ) {
+                continue;
             }
+            if( find(vbodyexcluded.begin(),vbodyexcluded.end(),pbody2) != vbodyexcluded.end() ) {
+                continue;
+            }
+
+            _InitKinBody(pbody2);
+            vboxes2.resize(0);
+            _CollectLinkBoxes(pbody2->GetLinks(), vlinkexcluded, vboxes2);
+            numtestedpairs += vboxes1.size()*vboxes2.size();
+            _AddCandidatePairs(vboxes1, vboxes2, bodygroup++, vpairs);
         }
+        return _CheckCandidatePairs(vpairs, report, true, numtestedpairs);
+    }
 
-        return false;
+    // does not check attached
+    bool CheckCollisionP(KinBodyConstPtr pbody1, KinBodyConstPtr pbody2, CollisionReportPtr report)
+    {
+        _InitKinBody(pbody1);
+        _InitKinBody(pbody2);
+        std::vector<LinkBox> vboxes1, vboxes2;
+        _CollectLinkBoxes(pbody1->GetLinks(), std::vector<KinBody::LinkConstPtr>(), vboxes1);
+        _CollectLinkBoxes(pbody2->GetLinks(), std::vector<KinBody::LinkConstPtr>(), vboxes2);
+        std::vector<LinkPair> vpairs;
+        _AddCandidatePairs(vboxes1, vboxes2, 0, vpairs);
+        return _CheckCandidatePairs(vpairs, report, false, vboxes1.size()*vboxes2.size());
     }
 
     // does not check attached
@@ -520,23 +634,12 @@ private:
     {
         _InitKinBody(plink->GetParent());
         _InitKinBody(pbody);
-        bool success = false;
-        PQP_REAL R1[3][3], R2[3][3], T1[3], T2[3];
-        GetPQPTransformFromTransform(plink->GetTransform(),R1,T1);
-        FOREACHC(itlink,pbody->GetLinks()) {
-            GetPQPTransformFromTransform((*itlink)->GetTransform(),R2,T2);
-            bool retval = DoPQP(plink,R1,T1,*itlink,R2,T2,report);
-            success |= retval;
-            if(!report && _benablecol && !_benabledis && !_benabletol && retval) {
-                return true;
-            }
-            //return tolerance check result when it is the only thing enabled and there is no report
-            if(!report && !_benablecol && !_benabledis && _benabletol && retval) {
-                return true;
-            }
-        }
-
-        return success;
+        std::vector<LinkBox> vboxes1, vboxes2;
+        _CollectLinkBoxes(std::vector<KinBody::LinkPtr>(1, boost::const_pointer_cast<KinBody::Link>(plink)), std::vector<KinBody::LinkConstPtr>(), vboxes1);
+        _CollectLinkBoxes(pbody->GetLinks(), std::vector<KinBody::LinkConstPtr>(), vboxes2);
+        std::vector<LinkPair> vpairs;
+        _AddCandidatePairs(vboxes1, vboxes2, 0, vpairs);
+        return _CheckCandidatePairs(vpairs, report, false, vboxes1.size()*vboxes2.size());
     }
 
     Vector PQPRealToVector(const Vector& in, const PQP_REAL R[3][3], const PQP_REAL T[3])
@@ -682,6 +785,9 @@ private:
     PQP_REAL tri1[3][3], tri2[3][3];
     TransformMatrix tmtemp;
 
+    int _nNumThreads; ///< see SetNumThreads
+    ParallelRangeWorkersPtr _pCollideWorkers; ///< evaluates the candidate link pairs, only set if _nNumThreads > 1
+
     RobotBaseConstPtr _pactiverobot;     ///< set if ActiveDOFs option is enabled
     vector<uint8_t> _vactivelinks;
     std::string _userdatakey;
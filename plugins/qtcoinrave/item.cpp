@@ -22,12 +22,361 @@
 
 #include <Inventor/nodes/SoCoordinate3.h>
 #include <Inventor/nodes/SoFaceSet.h>
+#include <Inventor/nodes/SoLevelOfDetail.h>
 #include <Inventor/nodes/SoMaterialBinding.h>
 
 #include <Inventor/actions/SoWriteAction.h>
 #include <Inventor/actions/SoToVRML2Action.h>
 #include <Inventor/VRMLnodes/SoVRMLGroup.h>
 
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+/// \brief inventor nodes of the triangle meshes, shared by all the items with an identical mesh
+///
+/// Scenes with many instances of the same body keep one copy of the vertices of each mesh this way. The shared nodes are skipped when
+/// looking for the item of a picked path, so that the item is found from the separators above them that belong to only one item.
+///
+/// Meshes with many triangles are rendered through a SoLevelOfDetail node, which draws coarser versions of the mesh when it covers fewer
+/// pixels on the screen. The coarser versions are made by clustering the vertices on a grid and are cached in the meshlod directory of
+/// the database, next to the mesh cache of the environment loader. Only the rendering changes, the collision meshes are kept.
+class SharedTriMeshNodes
+{
+public:
+    static SharedTriMeshNodes& GetInstance()
+    {
+        static SharedTriMeshNodes s_nodes;
+        return s_nodes;
+    }
+
+    /// \brief sets the levels of detail of the meshes created from now on
+    ///
+    /// \param mintriangles meshes with at least this many triangles get coarser levels, 0 disables the levels of detail
+    /// \param bUseCache if true, the coarser levels are read from and written to the database directory
+    void SetLevelOfDetail(size_t mintriangles, bool bUseCache)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _nLODMinTriangles = mintriangles;
+        _bUseLODCache = bUseCache;
+    }
+
+    /// \brief returns a group with the coordinates and the face set of mesh
+    SoGroup* GetNode(const TriMesh& mesh)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        bool bLevelOfDetail = _nLODMinTriangles > 0 && mesh.indices.size()/3 >= _nLODMinTriangles;
+        MeshKey key(mesh.ComputeHash(), std::make_pair(mesh.vertices.size(), mesh.indices.size()));
+        std::map<MeshKey, SoGroup*>& mapnodes = bLevelOfDetail ? _maplodnodes : _mapnodes;
+        std::map<MeshKey, SoGroup*>::iterator it = mapnodes.find(key);
+        if( it != mapnodes.end() ) {
+            return it->second;
+        }
+
+        SoGroup* pgroup;
+        if( bLevelOfDetail ) {
+            pgroup = _CreateLevelOfDetailNode(mesh, key);
+        }
+        else {
+            pgroup = _CreateMeshNode(mesh);
+        }
+        pgroup->ref(); // released when no item uses it anymore
+        mapnodes[key] = pgroup;
+        _InsertShared(pgroup);
+        if( _mapnodes.size()+_maplodnodes.size() >= 2*_nLastCleanSize ) {
+            // drop the nodes that only the cache references
+            _EraseUnused(_mapnodes);
+            _EraseUnused(_maplodnodes);
+            _nLastCleanSize = std::max(_mapnodes.size()+_maplodnodes.size(), (size_t)64);
+        }
+        return pgroup;
+    }
+
+    bool IsShared(SoNode* pnode)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _setsharednodes.find(pnode) != _setsharednodes.end();
+    }
+
+private:
+    SharedTriMeshNodes() : _nLastCleanSize(64), _nLODMinTriangles(100000), _bUseLODCache(true) {
+    }
+
+    typedef std::pair<size_t, std::pair<size_t, size_t> > MeshKey; ///< hash, number of vertices and number of indices of a mesh
+
+    static SoGroup* _CreateMeshNode(const TriMesh& mesh)
+    {
+        SoCoordinate3* vprop = new SoCoordinate3();
+        // this makes it crash!
+        //vprop->point.set1Value(mesh.indices.size()-1,SbVec3f(0,0,0)); // resize
+        int i = 0;
+        FOREACHC(itind, mesh.indices) {
+            RaveVector<float> v = mesh.vertices[*itind];
+            vprop->point.set1Value(i++, SbVec3f(v.x,v.y,v.z));
+        }
+
+        SoFaceSet* faceset = new SoFaceSet();
+        // this makes it crash!
+        //faceset->numVertices.set1Value(mesh.indices.size()/3-1,3);
+        for(size_t i = 0; i < mesh.indices.size()/3; ++i) {
+            faceset->numVertices.set1Value(i,3);
+        }
+
+        SoGroup* pgroup = new SoGroup();
+        pgroup->addChild(vprop);
+        pgroup->addChild(faceset);
+        return pgroup;
+    }
+
+    /// \brief the first child is the full mesh, each next one has about a quarter of the triangles of the previous one
+    SoGroup* _CreateLevelOfDetailNode(const TriMesh& mesh, const MeshKey& key)
+    {
+        std::vector<TriMesh> vlevels;
+        std::string cachefilename;
+        if( _bUseLODCache ) {
+            cachefilename = RaveFindDatabaseFile(str(boost::format("meshlod/%x_%d_%d_%d.bin")%key.first%key.second.first%key.second.second%(int)s_lodversion), false);
+        }
+        if( !_LoadLevels(cachefilename, vlevels) ) {
+            vlevels.resize(0);
+            size_t numtriangles = mesh.indices.size()/3;
+            for(size_t target = numtriangles/4; target >= 500 && vlevels.size() < 4; target /= 4) {
+                TriMesh decimated;
+                _DecimateMesh(mesh, std::max(4, (int)RaveSqrt(dReal(target)/2)), decimated);
+                size_t prevtriangles = vlevels.size() > 0 ? vlevels.back().indices.size()/3 : numtriangles;
+                if( decimated.indices.size()/3 > (prevtriangles*3)/4 ) {
+                    // the grid does not reduce this mesh enough anymore
+                    break;
+                }
+                vlevels.push_back(TriMesh());
+                vlevels.back().vertices.swap(decimated.vertices);
+                vlevels.back().indices.swap(decimated.indices);
+            }
+            _SaveLevels(cachefilename, vlevels);
+        }
+        RAVELOG_DEBUG(str(boost::format("mesh with %d triangles has %d coarser levels of detail")%(mesh.indices.size()/3)%vlevels.size()));
+
+        SoLevelOfDetail* plod = new SoLevelOfDetail();
+        plod->addChild(_CreateMeshNode(mesh));
+        float screenarea = 40000; // pixels of the projected bounding box, 200x200 for the full mesh
+        for(size_t ilevel = 0; ilevel < vlevels.size(); ++ilevel) {
+            plod->addChild(_CreateMeshNode(vlevels[ilevel]));
+            plod->screenArea.set1Value(ilevel, screenarea);
+            screenarea *= 0.25f;
+        }
+        return plod;
+    }
+
+    /// \brief merges the vertices of mesh that fall in the same cell of a grid with resolution cells along the longest side of its bounding box
+    ///
+    /// The merged vertex is the average of the cell. Triangles that become degenerate or duplicated are removed.
+    static void _DecimateMesh(const TriMesh& mesh, int resolution, TriMesh& decimated)
+    {
+        decimated.vertices.resize(0);
+        decimated.indices.resize(0);
+        if( mesh.vertices.size() == 0 ) {
+            return;
+        }
+        Vector vmin = mesh.vertices[0], vmax = mesh.vertices[0];
+        FOREACHC(itv, mesh.vertices) {
+            for(int j = 0; j < 3; ++j) {
+                vmin[j] = std::min(vmin[j], (*itv)[j]);
+                vmax[j] = std::max(vmax[j], (*itv)[j]);
+            }
+        }
+        dReal fextent = std::max(vmax.x-vmin.x, std::max(vmax.y-vmin.y, vmax.z-vmin.z));
+        if( fextent <= 0 ) {
+            return;
+        }
+        dReal fcellinv = resolution/fextent;
+        uint64_t numcells = resolution+1;
+        std::vector<uint64_t> vcellkeys(mesh.vertices.size());
+        for(size_t i = 0; i < mesh.vertices.size(); ++i) {
+            const Vector& v = mesh.vertices[i];
+            uint64_t ix = (uint64_t)((v.x-vmin.x)*fcellinv), iy = (uint64_t)((v.y-vmin.y)*fcellinv), iz = (uint64_t)((v.z-vmin.z)*fcellinv);
+            vcellkeys[i] = ix + numcells*(iy + numcells*iz);
+        }
+        std::vector<uint64_t> vsortedkeys = vcellkeys;
+        std::sort(vsortedkeys.begin(), vsortedkeys.end());
+        vsortedkeys.erase(std::unique(vsortedkeys.begin(), vsortedkeys.end()), vsortedkeys.end());
+
+        std::vector<int> vclusters(mesh.vertices.size());
+        std::vector<int> vcounts(vsortedkeys.size(), 0);
+        decimated.vertices.resize(vsortedkeys.size(), Vector(0,0,0));
+        for(size_t i = 0; i < mesh.vertices.size(); ++i) {
+            int icluster = std::lower_bound(vsortedkeys.begin(), vsortedkeys.end(), vcellkeys[i]) - vsortedkeys.begin();
+            vclusters[i] = icluster;
+            decimated.vertices[icluster] += mesh.vertices[i];
+            vcounts[icluster] += 1;
+        }
+        for(size_t i = 0; i < decimated.vertices.size(); ++i) {
+            decimated.vertices[i] *= dReal(1)/vcounts[i];
+        }
+
+        // (sorted indices, position of the triangle) so that the duplicates are next to each other, the first one keeps its orientation
+        std::vector< std::pair<boost::array<int, 3>, size_t> > vtriangles;
+        vtriangles.reserve(mesh.indices.size()/3);
+        for(size_t i = 0; i+2 < mesh.indices.size(); i += 3) {
+            boost::array<int, 3> tri = {{vclusters.at(mesh.indices[i]), vclusters.at(mesh.indices[i+1]), vclusters.at(mesh.indices[i+2])}};
+            if( tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2] ) {
+                continue;
+            }
+            boost::array<int, 3> sortedtri = tri;
+            std::sort(sortedtri.begin(), sortedtri.end());
+            vtriangles.push_back(std::make_pair(sortedtri, i));
+        }
+        std::sort(vtriangles.begin(), vtriangles.end());
+        decimated.indices.reserve(vtriangles.size()*3);
+        for(size_t i = 0; i < vtriangles.size(); ++i) {
+            if( i > 0 && vtriangles[i].first == vtriangles[i-1].first ) {
+                continue;
+            }
+            for(int j = 0; j < 3; ++j) {
+                decimated.indices.push_back(vclusters[mesh.indices[vtriangles[i].second+j]]);
+            }
+        }
+    }
+
+    static bool _LoadLevels(const std::string& cachefilename, std::vector<TriMesh>& vlevels)
+    {
+        if( cachefilename.size() == 0 ) {
+            return false;
+        }
+        ifstream f(cachefilename.c_str(), ios::in|ios::binary);
+        if( !f ) {
+            return false;
+        }
+        uint32_t version = 0, numlevels = 0;
+        f.read((char*)&version, sizeof(version));
+        f.read((char*)&numlevels, sizeof(numlevels));
+        if( !f || version != s_lodversion || numlevels > 16 ) {
+            return false;
+        }
+        vlevels.resize(numlevels);
+        FOREACH(itlevel, vlevels) {
+            uint64_t numvertices = 0, numindices = 0;
+            f.read((char*)&numvertices, sizeof(numvertices));
+            f.read((char*)&numindices, sizeof(numindices));
+            if( !f ) {
+                return false;
+            }
+            std::vector<float> vpoints(3*numvertices);
+            itlevel->indices.resize(numindices);
+            if( numvertices > 0 ) {
+                f.read((char*)&vpoints[0], sizeof(float)*vpoints.size());
+            }
+            if( numindices > 0 ) {
+                f.read((char*)&itlevel->indices[0], sizeof(int)*numindices);
+            }
+            if( !f ) {
+                return false;
+            }
+            itlevel->vertices.resize(numvertices);
+            for(size_t i = 0; i < numvertices; ++i) {
+                itlevel->vertices[i] = Vector(vpoints[3*i], vpoints[3*i+1], vpoints[3*i+2]);
+            }
+            FOREACHC(itindex, itlevel->indices) {
+                if( *itindex < 0 || *itindex >= (int)numvertices ) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /// \brief writes to a temporary file first so that viewers of other processes never read a partial cache file
+    static void _SaveLevels(const std::string& cachefilename, const std::vector<TriMesh>& vlevels)
+    {
+        if( cachefilename.size() == 0 ) {
+            return;
+        }
+#ifndef _WIN32
+        mkdir(cachefilename.substr(0, cachefilename.find_last_of("/\\")).c_str(), S_IRWXU|S_IRGRP|S_IXGRP|S_IROTH|S_IXOTH);
+#endif
+        string tempfilename = str(boost::format("%s.%d.%s")%cachefilename%utils::GetNanoTime()%boost::this_thread::get_id());
+        {
+            ofstream f(tempfilename.c_str(), ios::out|ios::binary);
+            if( !f ) {
+                return;
+            }
+            uint32_t version = s_lodversion, numlevels = vlevels.size();
+            f.write((const char*)&version, sizeof(version));
+            f.write((const char*)&numlevels, sizeof(numlevels));
+            FOREACHC(itlevel, vlevels) {
+                uint64_t numvertices = itlevel->vertices.size(), numindices = itlevel->indices.size();
+                f.write((const char*)&numvertices, sizeof(numvertices));
+                f.write((const char*)&numindices, sizeof(numindices));
+                FOREACHC(itv, itlevel->vertices) {
+                    float v[3] = { (float)itv->x, (float)itv->y, (float)itv->z };
+                    f.write((const char*)v, sizeof(v));
+                }
+                if( numindices > 0 ) {
+                    f.write((const char*)&itlevel->indices[0], sizeof(int)*numindices);
+                }
+            }
+            if( !f ) {
+                f.close();
+                remove(tempfilename.c_str());
+                return;
+            }
+        }
+        if( rename(tempfilename.c_str(), cachefilename.c_str()) != 0 ) {
+            remove(tempfilename.c_str());
+        }
+    }
+
+    /// \brief pnode and all the nodes under it are only referenced by the shared nodes
+    void _InsertShared(SoNode* pnode)
+    {
+        _setsharednodes.insert(pnode);
+        if( pnode->isOfType(SoGroup::getClassTypeId()) ) {
+            SoGroup* pgroup = static_cast<SoGroup*>(pnode);
+            for(int ichild = 0; ichild < pgroup->getNumChildren(); ++ichild) {
+                _InsertShared(pgroup->getChild(ichild));
+            }
+        }
+    }
+
+    void _EraseShared(SoNode* pnode)
+    {
+        _setsharednodes.erase(pnode);
+        if( pnode->isOfType(SoGroup::getClassTypeId()) ) {
+            SoGroup* pgroup = static_cast<SoGroup*>(pnode);
+            for(int ichild = 0; ichild < pgroup->getNumChildren(); ++ichild) {
+                _EraseShared(pgroup->getChild(ichild));
+            }
+        }
+    }
+
+    void _EraseUnused(std::map<MeshKey, SoGroup*>& mapnodes)
+    {
+        std::map<MeshKey, SoGroup*>::iterator it = mapnodes.begin();
+        while(it != mapnodes.end()) {
+            if( it->second->getRefCount() <= 1 ) {
+                _EraseShared(it->second);
+                it->second->unref();
+                mapnodes.erase(it++);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+
+    static const uint32_t s_lodversion = 1; ///< increment whenever the cache layout or the decimation changes
+
+    std::map<MeshKey, SoGroup*> _mapnodes, _maplodnodes; ///< meshes rendered at full resolution and with levels of detail
+    std::set<SoNode*> _setsharednodes; ///< the groups of _mapnodes and _maplodnodes and all the nodes under them
+    size_t _nLastCleanSize; ///< size of _mapnodes and _maplodnodes after the last removal of the unused nodes
+    size_t _nLODMinTriangles; ///< meshes with at least this many triangles get levels of detail, 0 to disable them
+    bool _bUseLODCache;
+    boost::mutex _mutex;
+};
+
+void SetTriMeshLevelOfDetail(size_t mintriangles, bool bUseCache)
+{
+    SharedTriMeshNodes::GetInstance().SetLevelOfDetail(mintriangles, bUseCache);
+}
+
 Item::Item(QtCoinViewerPtr viewer) : _viewer(viewer)
 {
     // set up the Inventor nodes
@@ -58,6 +407,9 @@ Item::~Item()
 
 bool Item::ContainsIvNode(SoNode *pNode)
 {
+    if( SharedTriMeshNodes::GetInstance().IsShared(pNode) ) {
+        return false;
+    }
     SoSearchAction search;
     search.setNode(pNode);
     search.apply(_ivGeom);
@@ -94,6 +446,7 @@ KinBodyItem::KinBodyItem(QtCoinViewerPtr viewer, KinBodyPtr pchain, ViewGeometry
     _userdata = 0;
     _bReload = false;
     _bDrawStateChanged = false;
+    _nPublishedUpdateStamp = -1;
     networkid = pchain->GetEnvironmentId();
     _geometrycallback = pchain->RegisterChangeCallback(KinBody::Prop_LinkGeometry, boost::bind(&KinBodyItem::GeometryChangedCallback,this));
     _drawcallback = pchain->RegisterChangeCallback(KinBody::Prop_LinkDraw, boost::bind(&KinBodyItem::DrawChangedCallback,this));
@@ -261,6 +614,7 @@ void KinBodyItem::Load()
                     break;
                 }
                 case GT_Container:
+                case GT_Octree:
                 case GT_TriMesh: {
                     // actually don't set to dual-sided rendering since flipped triangles can cause problems with collision and user should know about it
                     //phints->shapeType = SoShapeHints::UNKNOWN_SHAPE_TYPE; // set to render for both faces
@@ -275,25 +629,7 @@ void KinBodyItem::Load()
                         psep->addChild(ptype);
                     }
 
-                    const TriMesh& mesh = geom->GetCollisionMesh();
-                    SoCoordinate3* vprop = new SoCoordinate3();
-                    // this makes it crash!
-                    //vprop->point.set1Value(mesh.indices.size()-1,SbVec3f(0,0,0)); // resize
-                    int i = 0;
-                    FOREACHC(itind, mesh.indices) {
-                        RaveVector<float> v = mesh.vertices[*itind];
-                        vprop->point.set1Value(i++, SbVec3f(v.x,v.y,v.z));
-                    }
-
-                    psep->addChild(vprop);
-
-                    SoFaceSet* faceset = new SoFaceSet();
-                    // this makes it crash!
-                    //faceset->numVertices.set1Value(mesh.indices.size()/3-1,3);
-                    for(size_t i = 0; i < mesh.indices.size()/3; ++i) {
-                        faceset->numVertices.set1Value(i,3);
-                    }
-                    psep->addChild(faceset);
+                    psep->addChild(SharedTriMeshNodes::GetInstance().GetNode(geom->GetCollisionMesh()));
                     break;
                 }
                 default:
@@ -311,6 +647,7 @@ void KinBodyItem::Load()
 
     _bReload = false;
     _bDrawStateChanged = false;
+    _nPublishedUpdateStamp = -1;
 }
 
 SoSeparator *KinBodyItem::RenderTrimesh(SoSeparator *psep, TriMesh const &mesh, KinBody::Link::GeometryPtr geom)
@@ -355,24 +692,7 @@ SoSeparator *KinBodyItem::RenderTrimesh(SoSeparator *psep, TriMesh const &mesh,
         psep->addChild(ptype);
     }
 
-    SoCoordinate3* vprop = new SoCoordinate3();
-    // this makes it crash!
-    //vprop->point.set1Value(mesh.indices.size()-1,SbVec3f(0,0,0)); // resize
-    int i = 0;
-    FOREACHC(itind, mesh.indices) {
-        RaveVector<float> v = mesh.vertices[*itind];
-        vprop->point.set1Value(i++, SbVec3f(v.x,v.y,v.z));
-    }
-
-    psep->addChild(vprop);
-
-    SoFaceSet* faceset = new SoFaceSet();
-    // this makes it crash!
-    //faceset->numVertices.set1Value(mesh.indices.size()/3-1,3);
-    for(size_t i = 0; i < mesh.indices.size()/3; ++i) {
-        faceset->numVertices.set1Value(i,3);
-    }
-    psep->addChild(faceset);
+    psep->addChild(SharedTriMeshNodes::GetInstance().GetNode(mesh));
     return psep;
 }
 
@@ -496,6 +816,18 @@ bool KinBodyItem::UpdateFromModel(const vector<dReal>& vjointvalues, const vecto
     return true;
 }
 
+bool KinBodyItem::UpdateFromPublishedState(const KinBody::BodyState& state)
+{
+    if( state.updatestamp == _nPublishedUpdateStamp && !_bReload && !_bDrawStateChanged ) {
+        return true;
+    }
+    if( !UpdateFromModel(state.jointvalues, state.vectrans) ) {
+        return false;
+    }
+    _nPublishedUpdateStamp = state.updatestamp;
+    return true;
+}
+
 void KinBodyItem::SetGrab(bool bGrab, bool bUpdate)
 {
     if(!_pchain ) {
@@ -27,6 +27,12 @@ enum ViewGeometry {
     VG_RenderCollision = 2,
 };
 
+/// \brief sets the levels of detail of the triangle meshes rendered from now on
+///
+/// \param mintriangles meshes with at least this many triangles are drawn coarser when they cover fewer pixels, 0 disables it
+/// \param bUseCache if true, the coarser meshes are cached in the database directory
+void SetTriMeshLevelOfDetail(size_t mintriangles, bool bUseCache);
+
 /// Encapsulate the Inventor rendering of an Item
 class Item : public boost::enable_shared_from_this<Item>, public OpenRAVE::UserData
 {
@@ -153,6 +159,9 @@ public:
     virtual bool UpdateFromModel();
     virtual bool UpdateFromModel(const vector<dReal>& vjointvalues, const vector<Transform>& vtrans);
 
+    /// \brief updates from the state published by the environment, skipped if the body has not changed since the last published state was applied
+    virtual bool UpdateFromPublishedState(const KinBody::BodyState& state);
+
     virtual void SetGrab(bool bGrab, bool bUpdate=true);
 
     inline KinBodyPtr GetBody() const {
@@ -196,6 +205,7 @@ protected:
     bool bGrabbed, _bReload, _bDrawStateChanged;
     ViewGeometry _viewmode;
     int _userdata;
+    int _nPublishedUpdateStamp; ///< KinBody::BodyState::updatestamp of the last applied published state, -1 if the nodes have to be updated
 
     vector<dReal> _vjointvalues;
     vector<Transform> _vtrans;
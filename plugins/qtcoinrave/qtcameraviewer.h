@@ -75,10 +75,8 @@ protected:
     {
 public:
         QtImageWindow(SensorBasePtr psensor) : QWidget(NULL), _psensor(psensor) {
-            _pdata = boost::static_pointer_cast<SensorBase::CameraSensorData>(_psensor->CreateSensorData(SensorBase::ST_Camera));
-            _pdatanew = boost::static_pointer_cast<SensorBase::CameraSensorData>(_psensor->CreateSensorData(SensorBase::ST_Camera));
             _pgeom = boost::static_pointer_cast<SensorBase::CameraGeomData const>(_psensor->GetSensorGeometry(SensorBase::ST_Camera));
-            if( !_pdata || !_pgeom ) {
+            if( !_pgeom ) {
                 throw openrave_exception(str(boost::format("QtImageWindow: failed to create sensor data for sensor %s")%_psensor->GetName()));
             }
             QHBoxLayout *hbox = new QHBoxLayout(this);
@@ -91,24 +89,26 @@ public:
 
         void timerEvent(QTimerEvent* event)
         {
-            if( _psensor->GetSensorData(_pdatanew) &&( _pdatanew->__stamp != _pdata->__stamp) ) {
-                if( _pgeom->width*_pgeom->height*3 != (int)_pdatanew->vimagedata.size() ) {
+            // the latest frame is shared with the sensor, so only keep a reference to it
+            boost::shared_ptr<SensorBase::CameraSensorData const> pdatanew = boost::static_pointer_cast<SensorBase::CameraSensorData const>(_psensor->GetLatestSensorData(SensorBase::ST_Camera));
+            if( !!pdatanew &&( !_pdata || pdatanew->__stamp != _pdata->__stamp || pdatanew->__sequence != _pdata->__sequence) ) {
+                if( _pgeom->width*_pgeom->height*3 != (int)pdatanew->vimagedata.size() ) {
                     RAVELOG_WARN(str(boost::format("QtImageWindow: sensor %s image wrong dims")%_psensor->GetName()));
                 }
                 else {
 #if QT_VERSION >= 0x040400 // qt4.4+
-                    _label->setPixmap(QPixmap::fromImage(QImage(&_pdatanew->vimagedata[0], _pgeom->width,_pgeom->height,QImage::Format_RGB888)));
+                    _label->setPixmap(QPixmap::fromImage(QImage(&pdatanew->vimagedata[0], _pgeom->width,_pgeom->height,QImage::Format_RGB888)));
 #else
                     vimagedata.resize(4*_pgeom->width*_pgeom->height);
                     for(int i = 0; i < _pgeom->width*_pgeom->height; ++i) {
-                        vimagedata[4*i+0] = _pdatanew->vimagedata[3*i+0];
-                        vimagedata[4*i+1] = _pdatanew->vimagedata[3*i+1];
-                        vimagedata[4*i+2] = _pdatanew->vimagedata[3*i+2];
+                        vimagedata[4*i+0] = pdatanew->vimagedata[3*i+0];
+                        vimagedata[4*i+1] = pdatanew->vimagedata[3*i+1];
+                        vimagedata[4*i+2] = pdatanew->vimagedata[3*i+2];
                         vimagedata[4*i+3] = 0xff;
                     }
                     _label->setPixmap(QPixmap::fromImage(QImage(&vimagedata[0], _pgeom->width,_pgeom->height,QImage::Format_RGB32)));
 #endif
-                    swap(_pdatanew,_pdata);
+                    _pdata = pdatanew;
                 }
             }
         }
@@ -116,7 +116,7 @@ public:
 private:
         QLabel *_label;
         SensorBasePtr _psensor;
-        boost::shared_ptr<SensorBase::CameraSensorData> _pdatanew, _pdata;
+        boost::shared_ptr<SensorBase::CameraSensorData const> _pdata; ///< last displayed frame
         SensorBase::CameraGeomDataConstPtr _pgeom;
 #if QT_VERSION < 0x040400 // qt4.4+
         vector<uint8_t> vimagedata;
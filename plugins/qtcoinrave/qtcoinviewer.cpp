@@ -189,6 +189,8 @@ void QtCoinViewer::_InitConstructor(std::istream& sinput)
                     "Saves a body and/or a link to VRML. Format is::\n\n  bodyname linkindex filename\\n\n\nwhere linkindex >= 0 to save for a specific link, or < 0 to save all links");
     RegisterCommand("SetNearPlane", boost::bind(&QtCoinViewer::_SetNearPlaneCommand, this, _1, _2),
                     "Sets the near plane for rendering of the image. Useful when tweaking rendering units");
+    RegisterCommand("SetMeshLevelOfDetail", boost::bind(&QtCoinViewer::_SetMeshLevelOfDetailCommand, this, _1, _2),
+                    "Sets the levels of detail of the meshes loaded from now on. Format is::\n\n  mintriangles [usecache]\n\nMeshes with at least mintriangles triangles are drawn with coarser meshes when small on the screen, 0 disables it. If usecache is 1 (default), the coarser meshes are cached in the database directory.");
     RegisterCommand("StartViewerLoop", boost::bind(&QtCoinViewer::_StartViewerLoopCommand, this, _1, _2),
                     "starts the viewer sync loop and shows the viewer. expects someone else will call the qapplication exec fn");
     RegisterCommand("Show", boost::bind(&QtCoinViewer::_ShowCommand, this, _1, _2),
@@ -2940,7 +2942,6 @@ void QtCoinViewer::UpdateFromModel()
     }
 
     boost::mutex::scoped_lock lock(_mutexUpdateModels);
-    vector<KinBody::BodyState> vecbodies;
 
 
 #if BOOST_VERSION >= 103500
@@ -2961,7 +2962,7 @@ void QtCoinViewer::UpdateFromModel()
     }
 
     try {
-        GetEnv()->GetPublishedBodies(vecbodies,100000); // 0.1s
+        GetEnv()->GetPublishedBodies(_vecbodies,100000); // 0.1s
     }
     catch(const std::exception& ex) {
         RAVELOG_WARN("timeout of GetPublishedBodies\n");
@@ -2971,7 +2972,7 @@ void QtCoinViewer::UpdateFromModel()
         it->second->SetUserData(0);
     }
 
-    FOREACH(itbody, vecbodies) {
+    FOREACH(itbody, _vecbodies) {
         BOOST_ASSERT( !!itbody->pbody );
         KinBodyPtr pbody = itbody->pbody; // try to use only as an id, don't call any methods!
         KinBodyItemPtr pitem = boost::dynamic_pointer_cast<KinBodyItem>(pbody->GetUserData("qtcoinviewer"));
@@ -3002,6 +3003,7 @@ void QtCoinViewer::UpdateFromModel()
                             }
                         }
                         if( !lockenv ) {
+                            _vecbodies.clear(); // do not keep the bodies alive
                             return; // couldn't acquire the lock, try next time. This prevents deadlock situations
                         }
                     }
@@ -3042,7 +3044,10 @@ void QtCoinViewer::UpdateFromModel()
         BOOST_ASSERT( itmap->second == pitem );
 
         pitem->SetUserData(1);
-        pitem->UpdateFromModel(itbody->jointvalues,itbody->vectrans);
+        pitem->UpdateFromPublishedState(*itbody); // only copies bodies that changed
+    }
+    FOREACH(itbody, _vecbodies) {
+        itbody->pbody.reset(); // only the memory of the states is kept for the next update, not the bodies
     }
 
     FOREACH_NOINC(it, _mapbodies) {
@@ -3857,6 +3862,19 @@ bool QtCoinViewer::_SetNearPlaneCommand(ostream& sout, istream& sinput)
     return true;
 }
 
+bool QtCoinViewer::_SetMeshLevelOfDetailCommand(ostream& sout, istream& sinput)
+{
+    size_t mintriangles = 0;
+    int usecache = 1;
+    sinput >> mintriangles;
+    if( !sinput ) {
+        return false;
+    }
+    sinput >> usecache;
+    SetTriMeshLevelOfDetail(mintriangles, usecache != 0);
+    return true;
+}
+
 void QtCoinViewer::_SetNearPlane(dReal nearplane)
 {
     _pviewer->setAutoClippingStrategy(SoQtViewer::CONSTANT_NEAR_PLANE, nearplane);
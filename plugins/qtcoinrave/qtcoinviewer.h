@@ -353,6 +353,7 @@ public:
     bool _CommandResize(ostream& sout, istream& sinput);
     bool _SaveBodyLinkToVRMLCommand(ostream& sout, istream& sinput);
     bool _SetNearPlaneCommand(ostream& sout, istream& sinput);
+    bool _SetMeshLevelOfDetailCommand(ostream& sout, istream& sinput);
     bool _StartViewerLoopCommand(ostream& sout, istream& sinput);
     bool _ShowCommand(ostream& sout, istream& sinput);
     bool _TrackLinkCommand(ostream& sout, istream& sinput);
@@ -436,6 +437,7 @@ public:
 
     bool _bLockEnvironment;
     boost::mutex _mutexUpdateModels, _mutexCallbacks;
+    std::vector<KinBody::BodyState> _vecbodies; ///< published bodies, kept between updates so that their memory is reused. protected by _mutexUpdateModels
     boost::condition _condUpdateModels;     ///< signaled everytime environment models are updated
     boost::mutex _mutexGUI;
     bool _bInIdleThread;
@@ -37,6 +37,7 @@ bool OSGPickHandler::handle(const osgGA::GUIEventAdapter& ea,osgGA::GUIActionAda
     case osgGA::GUIEventAdapter::RELEASE:
     {
         if( (ea.getButton() & osgGA::GUIEventAdapter::LEFT_MOUSE_BUTTON) && _bDoPickCallOnButtonRelease ) {
+            _pendingMoveEvent = NULL;
             _bDoPickCallOnButtonRelease = false;
             if (!!view) {
                 _Pick(view, ea, 1);
@@ -54,7 +55,15 @@ bool OSGPickHandler::handle(const osgGA::GUIEventAdapter& ea,osgGA::GUIActionAda
         return false;
     case osgGA::GUIEventAdapter::MOVE: {
         if (!!view) {
-            _Pick(view, ea, 0);
+            _pendingMoveEvent = &ea;
+        }
+        return false;
+    }
+    case osgGA::GUIEventAdapter::FRAME: {
+        if( !!_pendingMoveEvent && !!view ) {
+            osg::ref_ptr<const osgGA::GUIEventAdapter> moveevent = _pendingMoveEvent;
+            _pendingMoveEvent = NULL;
+            _Pick(view, *moveevent, 0);
         }
         return false;
     }
@@ -44,6 +44,9 @@ protected:
     DragFn _dragfn;
     //bool _select; ///< if true, then will call the _selectLinkFn with the raypicked node
     bool _bDoPickCallOnButtonRelease; ///< if true, then on button release can call _Pick
+
+    /// the mouse moves are picked once per frame with the last position, since the window system can send many more moves than frames
+    osg::ref_ptr<const osgGA::GUIEventAdapter> _pendingMoveEvent;
 };
 
 }
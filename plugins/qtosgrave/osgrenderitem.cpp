@@ -22,6 +22,10 @@
 #include <osg/BlendFunc>
 #include <osg/PolygonOffset>
 #include <osg/LineStipple>
+#include <osg/observer_ptr>
+#include <osg/KdTree>
+
+#include <boost/functional/hash.hpp>
 
 namespace qtosgrave {
 
@@ -97,6 +101,178 @@ OSGGroupPtr CreateOSGXYZAxes(double len, double axisthickness)
 }
 
 
+/// \brief builds the kd-trees that the line segment intersectors of the picking use for the geometries under node
+static void BuildKdTrees(osg::Node& node)
+{
+    osg::ref_ptr<osg::KdTreeBuilder> kdtreebuilder = new osg::KdTreeBuilder();
+    node.accept(*kdtreebuilder);
+}
+
+/// \brief creates the drawables of a primitive or mesh geometry, empty if the geometry type cannot be drawn
+static osg::ref_ptr<osg::Geode> CreateGeometryGeode(const KinBody::Link::Geometry& orgeom)
+{
+    osg::ref_ptr<osg::Geode> geode;
+    switch(orgeom.GetType()) {
+    //  Geometry is defined like a Sphere
+    case GT_Sphere: {
+        osg::Sphere* s = new osg::Sphere();
+        geode = new osg::Geode;
+        s->setRadius(orgeom.GetSphereRadius());
+        osg::ref_ptr<osg::ShapeDrawable> sd = new osg::ShapeDrawable(s);
+        geode->addDrawable(sd.get());
+        break;
+    }
+    //  Geometry is defined like a Box
+    case GT_Box: {
+        osg::ref_ptr<osg::Box> box = new osg::Box();
+        box->setHalfLengths(osg::Vec3f(orgeom.GetBoxExtents().x,orgeom.GetBoxExtents().y,orgeom.GetBoxExtents().z));
+
+        geode = new osg::Geode;
+        osg::ref_ptr<osg::ShapeDrawable> sd = new osg::ShapeDrawable(box.get());
+        geode->addDrawable(sd.get());
+        break;
+    }
+    //  Geometry is defined like a Cylinder
+    case GT_Cylinder: {
+        // make SoCylinder point towards z, not y
+        osg::Cylinder* cy = new osg::Cylinder();
+        cy->setRadius(orgeom.GetCylinderRadius());
+        cy->setHeight(orgeom.GetCylinderHeight());
+        geode = new osg::Geode;
+        osg::ref_ptr<osg::ShapeDrawable> sd = new osg::ShapeDrawable(cy);
+        geode->addDrawable(sd.get());
+        break;
+    }
+    //  Extract geometry from collision Mesh
+    case GT_Container:
+    case GT_Octree:
+    case GT_TriMesh: {
+        // make triangleMesh
+        osg::ref_ptr<osg::Geometry> geom = new osg::Geometry;
+
+        //geom->setColorBinding(osg::Geometry::BIND_OVERALL); // need to call geom->setColorArray first
+
+        const TriMesh& mesh = orgeom.GetCollisionMesh();
+        osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array();
+        vertices->reserveArray(mesh.vertices.size());
+        for(size_t i = 0; i < mesh.vertices.size(); ++i) {
+            RaveVector<float> v = mesh.vertices[i];
+            vertices->push_back(osg::Vec3(v.x, v.y, v.z));
+        }
+        geom->setVertexArray(vertices.get());
+
+
+        osg::DrawElementsUInt* geom_prim = new osg::DrawElementsUInt(osg::PrimitiveSet::TRIANGLES, mesh.indices.size());
+        for(size_t i = 0; i < mesh.indices.size(); ++i) {
+            (*geom_prim)[i] = mesh.indices[i];
+        }
+        geom->addPrimitiveSet(geom_prim);
+
+        osgUtil::SmoothingVisitor::smooth(*geom); // compute vertex normals
+        // the data is shared and never modified, so keep it on the GPU
+        geom->setUseDisplayList(false);
+        geom->setUseVertexBufferObjects(true);
+        geode = new osg::Geode;
+        geode->addDrawable(geom);
+        // picking intersects the tree instead of every triangle. the geode is shared, so the tree is only built once per mesh
+        BuildKdTrees(*geode);
+        break;
+    }
+    default:
+        break;
+    }
+    if( !!geode ) {
+        geode->setDataVariance(osg::Object::STATIC);
+    }
+    return geode;
+}
+
+/// \brief returns a key that is equal for geometries drawn with the same drawables
+static std::string GetGeometryGeodeKey(const KinBody::Link::Geometry& orgeom)
+{
+    switch(orgeom.GetType()) {
+    case GT_Sphere:
+        return str(boost::format("sphere %.9e")%orgeom.GetSphereRadius());
+    case GT_Box:
+        return str(boost::format("box %.9e %.9e %.9e")%orgeom.GetBoxExtents().x%orgeom.GetBoxExtents().y%orgeom.GetBoxExtents().z);
+    case GT_Cylinder:
+        return str(boost::format("cylinder %.9e %.9e")%orgeom.GetCylinderRadius()%orgeom.GetCylinderHeight());
+    case GT_Container:
+    case GT_Octree:
+    case GT_TriMesh: {
+        const TriMesh& mesh = orgeom.GetCollisionMesh();
+        size_t hash = 0;
+        FOREACHC(itvertex, mesh.vertices) {
+            boost::hash_combine(hash, (float)itvertex->x);
+            boost::hash_combine(hash, (float)itvertex->y);
+            boost::hash_combine(hash, (float)itvertex->z);
+        }
+        boost::hash_range(hash, mesh.indices.begin(), mesh.indices.end());
+        return str(boost::format("mesh %d %d %x")%mesh.vertices.size()%mesh.indices.size()%hash);
+    }
+    default:
+        return std::string();
+    }
+}
+
+/// \brief stores node into the cache and removes the entries of released nodes once the cache has grown enough
+template <typename T>
+static void InsertSharedNode(std::map<std::string, osg::observer_ptr<T> >& mapcache, size_t& nsweepsize, const std::string& key, osg::ref_ptr<T> node)
+{
+    mapcache[key] = node;
+    if( mapcache.size() > nsweepsize ) {
+        for(typename std::map<std::string, osg::observer_ptr<T> >::iterator it = mapcache.begin(); it != mapcache.end(); ) {
+            if( !it->second.valid() ) {
+                mapcache.erase(it++);
+            }
+            else {
+                ++it;
+            }
+        }
+        nsweepsize = max((size_t)64, 2*mapcache.size());
+    }
+}
+
+// the caches only observe the nodes, so they are released once the last body using them is removed from the scene. only accessed from the viewer thread.
+static std::map<std::string, osg::observer_ptr<osg::Geode> > s_mapSharedGeodes;
+static size_t s_nSharedGeodesSweepSize = 64;
+static std::map<std::string, osg::observer_ptr<osg::Node> > s_mapSharedRenderFileNodes;
+static size_t s_nSharedRenderFileNodesSweepSize = 64;
+
+osg::ref_ptr<osg::Geode> GetSharedGeometryGeode(const KinBody::Link::Geometry& orgeom)
+{
+    std::string key = GetGeometryGeodeKey(orgeom);
+    if( key.size() == 0 ) {
+        return CreateGeometryGeode(orgeom);
+    }
+    osg::ref_ptr<osg::Geode> geode;
+    std::map<std::string, osg::observer_ptr<osg::Geode> >::iterator it = s_mapSharedGeodes.find(key);
+    if( it != s_mapSharedGeodes.end() && it->second.lock(geode) ) {
+        return geode;
+    }
+    geode = CreateGeometryGeode(orgeom);
+    if( !!geode ) {
+        InsertSharedNode(s_mapSharedGeodes, s_nSharedGeodesSweepSize, key, geode);
+    }
+    return geode;
+}
+
+OSGNodePtr GetSharedRenderFileNode(const std::string& renderfilename)
+{
+    OSGNodePtr node;
+    std::map<std::string, osg::observer_ptr<osg::Node> >::iterator it = s_mapSharedRenderFileNodes.find(renderfilename);
+    if( it != s_mapSharedRenderFileNodes.end() && it->second.lock(node) ) {
+        return node;
+    }
+    node = osgDB::readNodeFile(renderfilename);
+    if( !!node ) {
+        node->setDataVariance(osg::Object::STATIC);
+        BuildKdTrees(*node);
+        InsertSharedNode(s_mapSharedRenderFileNodes, s_nSharedRenderFileNodesSweepSize, renderfilename, node);
+    }
+    return node;
+}
+
 // Visitor to return the coordinates of a node with respect to another node
 class WorldCoordOfNodeVisitor : public osg::NodeVisitor
 {
@@ -229,6 +405,7 @@ KinBodyItem::KinBodyItem(OSGGroupPtr osgSceneRoot, OSGGroupPtr osgFigureRoot, Ki
     _userdata = 0;
     _bReload = false;
     _bDrawStateChanged = false;
+    _nPublishedUpdateStamp = -1;
     _environmentid = pbody->GetEnvironmentId();
     _geometrycallback = pbody->RegisterChangeCallback(KinBody::Prop_LinkGeometry, boost::bind(&KinBodyItem::_HandleGeometryChangedCallback,this));
     _drawcallback = pbody->RegisterChangeCallback(KinBody::Prop_LinkDraw, boost::bind(&KinBodyItem::_HandleDrawChangedCallback,this));
@@ -303,23 +480,25 @@ void KinBodyItem::Load()
                     std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
                 }
                 if( extension == "wrl" || extension == "iv" || extension == "vrml" ) {
-                    OSGNodePtr loadedModel;
-                    osg::Matrix mRotate, mS;
+                    // the loaded model is shared with the other geometries using the same file, so the state is set on a per-instance group
+                    OSGNodePtr loadedModel = GetSharedRenderFileNode(orgeom->GetRenderFilename());
+                    if( !!loadedModel ) {
+                        osg::Matrix mRotate, mS;
 
-                    mRotate.makeRotate(-osg::PI/2,osg::Vec3f(1.0f,0.0f,0.0f));
+                        mRotate.makeRotate(-osg::PI/2,osg::Vec3f(1.0f,0.0f,0.0f));
 
-                    mS.makeScale(orgeom->GetRenderScale().x, orgeom->GetRenderScale().y, orgeom->GetRenderScale().z);
+                        mS.makeScale(orgeom->GetRenderScale().x, orgeom->GetRenderScale().y, orgeom->GetRenderScale().z);
 
-                    pgeometryroot->preMult(mS);
-                    pgeometryroot->preMult(mRotate);
+                        pgeometryroot->preMult(mS);
+                        pgeometryroot->preMult(mRotate);
 
-                    loadedModel = osgDB::readNodeFile(orgeom->GetRenderFilename());
+                        pgeometrydata = new osg::Group();
+                        pgeometrydata->addChild(loadedModel);
+                        osg::StateSet* state = pgeometrydata->getOrCreateStateSet();
+                        state->setMode(GL_RESCALE_NORMAL,osg::StateAttribute::ON);
 
-                    pgeometrydata = loadedModel->asGroup();
-                    osg::StateSet* state = pgeometrydata->getOrCreateStateSet();
-                    state->setMode(GL_RESCALE_NORMAL,osg::StateAttribute::ON);
-
-                    bSucceeded = true;
+                        bSucceeded = true;
+                    }
                 }
             }
 
@@ -372,75 +551,10 @@ void KinBodyItem::Load()
                 state->setAttributeAndModes(mat, osg::StateAttribute::ON | osg::StateAttribute::OVERRIDE);
                 //pgeometrydata->setStateSet(state);
 
-                switch(orgeom->GetType()) {
-                //  Geometry is defined like a Sphere
-                case GT_Sphere: {
-                    osg::Sphere* s = new osg::Sphere();
-                    osg::ref_ptr<osg::Geode> geode = new osg::Geode;
-                    s->setRadius(orgeom->GetSphereRadius());
-                    osg::ref_ptr<osg::ShapeDrawable> sd = new osg::ShapeDrawable(s);
-                    geode->addDrawable(sd.get());
-
-                    pgeometrydata->addChild(geode.get());
-                    break;
-                }
-                //  Geometry is defined like a Box
-                case GT_Box: {
-                    Vector v;
-                    osg::ref_ptr<osg::Box> box = new osg::Box();
-                    box->setHalfLengths(osg::Vec3f(orgeom->GetBoxExtents().x,orgeom->GetBoxExtents().y,orgeom->GetBoxExtents().z));
-
-                    osg::ref_ptr<osg::Geode> geode = new osg::Geode;
-                    osg::ref_ptr<osg::ShapeDrawable> sd = new osg::ShapeDrawable(box.get());
-                    geode->addDrawable(sd.get());
-
-                    pgeometrydata->addChild(geode.get());
-                    break;
-                }
-                //  Geometry is defined like a Cylinder
-                case GT_Cylinder: {
-                    // make SoCylinder point towards z, not y
-                    osg::Cylinder* cy = new osg::Cylinder();
-                    cy->setRadius(orgeom->GetCylinderRadius());
-                    cy->setHeight(orgeom->GetCylinderHeight());
-                    osg::ref_ptr<osg::Geode> geode = new osg::Geode;
-                    osg::ref_ptr<osg::ShapeDrawable> sd = new osg::ShapeDrawable(cy);
-                    geode->addDrawable(sd.get());
+                // identical geometries of all the bodies share the same drawables, the transform and material of each instance are held by its parents
+                osg::ref_ptr<osg::Geode> geode = GetSharedGeometryGeode(*orgeom);
+                if( !!geode ) {
                     pgeometrydata->addChild(geode.get());
-                    break;
-                }
-                //  Extract geometry from collision Mesh
-                case GT_Container:
-                case GT_TriMesh: {
-                    // make triangleMesh
-                    osg::ref_ptr<osg::Geometry> geom = new osg::Geometry;
-
-                    //geom->setColorBinding(osg::Geometry::BIND_OVERALL); // need to call geom->setColorArray first
-
-                    const TriMesh& mesh = orgeom->GetCollisionMesh();
-                    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array();
-                    vertices->reserveArray(mesh.vertices.size());
-                    for(size_t i = 0; i < mesh.vertices.size(); ++i) {
-                        RaveVector<float> v = mesh.vertices[i];
-                        vertices->push_back(osg::Vec3(v.x, v.y, v.z));
-                    }
-                    geom->setVertexArray(vertices.get());
-
-
-                    osg::DrawElementsUInt* geom_prim = new osg::DrawElementsUInt(osg::PrimitiveSet::TRIANGLES, mesh.indices.size());
-                    for(size_t i = 0; i < mesh.indices.size(); ++i) {
-                        (*geom_prim)[i] = mesh.indices[i];
-                    }
-                    geom->addPrimitiveSet(geom_prim);
-
-                    osgUtil::SmoothingVisitor::smooth(*geom); // compute vertex normals
-                    osg::ref_ptr<osg::Geode> geode = new osg::Geode;
-                    geode->addDrawable(geom);
-                    pgeometrydata->addChild(geode);
-                    break;
-                }
-                default:
-                    break;
                 }
             }
 
@@ -493,6 +607,7 @@ void KinBodyItem::Load()
 
     _bReload = false;
     _bDrawStateChanged = false;
+    _nPublishedUpdateStamp = -1;
 }
 
 void KinBodyItem::_PrintMatrix(osg::Matrix& m)
@@ -751,6 +866,18 @@ bool KinBodyItem::UpdateFromModel(const vector<dReal>& vjointvalues, const vecto
     return true;
 }
 
+bool KinBodyItem::UpdateFromPublishedState(const KinBody::BodyState& state)
+{
+    if( state.updatestamp == _nPublishedUpdateStamp && !_bReload && !_bDrawStateChanged ) {
+        return true;
+    }
+    if( !UpdateFromModel(state.jointvalues, state.vectrans) ) {
+        return false;
+    }
+    _nPublishedUpdateStamp = state.updatestamp;
+    return true;
+}
+
 void KinBodyItem::SetGrab(bool bGrab, bool bUpdate)
 {
     if(!_pbody ) {
@@ -30,6 +30,12 @@ enum ViewGeometry {
 /// \brief creates XYZ axes and returns their osg objects
 OSGGroupPtr CreateOSGXYZAxes(double len, double axisthickness);
 
+/// \brief returns the drawables of a geometry, shared with all the other geometries of the same shape in the scene. Empty if the geometry type cannot be drawn.
+osg::ref_ptr<osg::Geode> GetSharedGeometryGeode(const KinBody::Link::Geometry& orgeom);
+
+/// \brief loads a render file once and shares the loaded node between all the geometries using it. Empty if the file cannot be loaded.
+OSGNodePtr GetSharedRenderFileNode(const std::string& renderfilename);
+
 /// \brief Encapsulate the Inventor rendering of an Item
 class Item : public boost::enable_shared_from_this<Item>, public OpenRAVE::UserData
 {
@@ -145,6 +151,9 @@ public:
     /// \brief updates from openrave model
     virtual bool UpdateFromModel(const vector<dReal>& vjointvalues, const vector<Transform>& vtrans);
 
+    /// \brief updates from the state published by the environment, skipped if the body has not changed since the last published state was applied
+    virtual bool UpdateFromPublishedState(const KinBody::BodyState& state);
+
     virtual void SetGrab(bool bGrab, bool bUpdate=true);
 
     inline KinBodyPtr GetBody() const {
@@ -197,6 +206,7 @@ protected:
     bool bGrabbed, _bReload, _bDrawStateChanged;
     ViewGeometry _viewmode;
     int _userdata;
+    int _nPublishedUpdateStamp; ///< KinBody::BodyState::updatestamp of the last applied published state, -1 if the nodes have to be updated
 
     std::vector<dReal> _vjointvalues;
     vector<Transform> _vtrans;
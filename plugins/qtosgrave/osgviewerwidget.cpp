@@ -578,7 +578,14 @@ void ViewerWidget::HandleRayPick(const osgUtil::LineSegmentIntersector::Intersec
         }
     }
     else {
+        // geometries are shared between bodies (see GetSharedGeometryGeode), so use the deepest node above the first shared node to find the hit item
         OSGNodePtr node = intersection.nodePath.back();
+        for(size_t inode = 1; inode < intersection.nodePath.size(); ++inode) {
+            if( intersection.nodePath[inode]->getNumParents() > 1 ) {
+                node = intersection.nodePath[inode-1];
+                break;
+            }
+        }
 
         // something hit
         if( buttonPressed ) {
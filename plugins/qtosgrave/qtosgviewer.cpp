@@ -1356,6 +1356,10 @@ void QtOSGViewer::_Draw(OSGSwitchPtr handle, osg::ref_ptr<osg::Vec3Array> vertic
     osg::ref_ptr<osg::Geode> geode(new osg::Geode());
     osg::ref_ptr<osg::Geometry> geometry(new osg::Geometry());
 
+    // keep the vertices in a buffer object so that _SetGraphPoints only has to re-upload them
+    geometry->setUseDisplayList(false);
+    geometry->setUseVertexBufferObjects(true);
+    geometry->setDataVariance(osg::Object::DYNAMIC);
     geometry->setVertexArray(vertices.get());
     geometry->setColorArray(colors.get());
     geometry->setColorBinding(colors->size() == vertices->size() ? osg::Geometry::BIND_PER_VERTEX : osg::Geometry::BIND_OVERALL);
@@ -1386,7 +1390,7 @@ GraphHandlePtr QtOSGViewer::plot3(const float* ppoints, int numPoints, int strid
     osg::ref_ptr<osg::Vec4Array> vcolors = new osg::Vec4Array(1);
     (*vcolors)[0] = osg::Vec4f(color.x, color.y, color.z, color.w);
     _PostToGUIThread(boost::bind(&QtOSGViewer::_Draw, this, handle, vvertices, vcolors, osg::PrimitiveSet::POINTS, new osg::Point(fPointSize),color.w<1)); // copies ref counts
-    return GraphHandlePtr(new PrivateGraphHandle(shared_viewer(), handle));
+    return GraphHandlePtr(new PrivateGraphHandle(shared_viewer(), handle, numPoints));
 }
 
 GraphHandlePtr QtOSGViewer::plot3(const float* ppoints, int numPoints, int stride, float fPointSize, const float* colors, int drawstyle, bool bhasalpha)
@@ -1407,7 +1411,7 @@ GraphHandlePtr QtOSGViewer::plot3(const float* ppoints, int numPoints, int strid
     }
 
     _PostToGUIThread(boost::bind(&QtOSGViewer::_Draw, this, handle, vvertices, vcolors, osg::PrimitiveSet::POINTS, osg::ref_ptr<osg::Point>(new osg::Point(fPointSize)), bhasalpha)); // copies ref counts
-    return GraphHandlePtr(new PrivateGraphHandle(shared_viewer(), handle));
+    return GraphHandlePtr(new PrivateGraphHandle(shared_viewer(), handle, numPoints));
 }
 
 GraphHandlePtr QtOSGViewer::drawlinestrip(const float* ppoints, int numPoints, int stride, float fwidth, const RaveVector<float>& color)
@@ -1422,7 +1426,7 @@ GraphHandlePtr QtOSGViewer::drawlinestrip(const float* ppoints, int numPoints, i
     osg::ref_ptr<osg::Vec4Array> vcolors = new osg::Vec4Array(1);
     (*vcolors)[0] = osg::Vec4f(color.x, color.y, color.z, color.w);
     _PostToGUIThread(boost::bind(&QtOSGViewer::_Draw, this, handle, vvertices, vcolors, osg::PrimitiveSet::LINE_STRIP, osg::ref_ptr<osg::LineWidth>(new osg::LineWidth(fwidth)), color.w<1)); // copies ref counts
-    return GraphHandlePtr(new PrivateGraphHandle(shared_viewer(), handle));
+    return GraphHandlePtr(new PrivateGraphHandle(shared_viewer(), handle, numPoints));
 }
 GraphHandlePtr QtOSGViewer::drawlinestrip(const float* ppoints, int numPoints, int stride, float fwidth, const float* colors)
 {
@@ -1437,7 +1441,7 @@ GraphHandlePtr QtOSGViewer::drawlinestrip(const float* ppoints, int numPoints, i
     }
 
     _PostToGUIThread(boost::bind(&QtOSGViewer::_Draw, this, handle, vvertices, vcolors, osg::PrimitiveSet::LINE_STRIP, osg::ref_ptr<osg::LineWidth>(new osg::LineWidth(fwidth)), false)); // copies ref counts
-    return GraphHandlePtr(new PrivateGraphHandle(shared_viewer(), handle));
+    return GraphHandlePtr(new PrivateGraphHandle(shared_viewer(), handle, numPoints));
 }
 
 GraphHandlePtr QtOSGViewer::drawlinelist(const float* ppoints, int numPoints, int stride, float fwidth, const RaveVector<float>& color)
@@ -1451,7 +1455,7 @@ GraphHandlePtr QtOSGViewer::drawlinelist(const float* ppoints, int numPoints, in
     osg::ref_ptr<osg::Vec4Array> vcolors = new osg::Vec4Array(1);
     (*vcolors)[0] = osg::Vec4f(color.x, color.y, color.z, color.w);
     _PostToGUIThread(boost::bind(&QtOSGViewer::_Draw, this, handle, vvertices, vcolors, osg::PrimitiveSet::LINES, osg::ref_ptr<osg::LineWidth>(new osg::LineWidth(fwidth)), color.w<1)); // copies ref counts
-    return GraphHandlePtr(new PrivateGraphHandle(shared_viewer(), handle));
+    return GraphHandlePtr(new PrivateGraphHandle(shared_viewer(), handle, numPoints));
 }
 GraphHandlePtr QtOSGViewer::drawlinelist(const float* ppoints, int numPoints, int stride, float fwidth, const float* colors)
 {
@@ -1466,7 +1470,7 @@ GraphHandlePtr QtOSGViewer::drawlinelist(const float* ppoints, int numPoints, in
     }
 
     _PostToGUIThread(boost::bind(&QtOSGViewer::_Draw, this, handle, vvertices, vcolors, osg::PrimitiveSet::LINES, osg::ref_ptr<osg::LineWidth>(new osg::LineWidth(fwidth)), false)); // copies ref counts
-    return GraphHandlePtr(new PrivateGraphHandle(shared_viewer(), handle));
+    return GraphHandlePtr(new PrivateGraphHandle(shared_viewer(), handle, numPoints));
 }
 
 GraphHandlePtr QtOSGViewer::drawarrow(const RaveVector<float>& p1, const RaveVector<float>& p2, float fwidth, const RaveVector<float>& color)
@@ -1748,7 +1752,6 @@ void QtOSGViewer::UpdateFromModel()
     }
 
     boost::mutex::scoped_lock lock(_mutexUpdateModels);
-    vector<KinBody::BodyState> vecbodies;
 
 #if BOOST_VERSION >= 103500
     EnvironmentMutex::scoped_try_lock lockenv(GetEnv()->GetMutex(),boost::defer_lock_t());
@@ -1768,7 +1771,7 @@ void QtOSGViewer::UpdateFromModel()
     }
 
     try {
-        GetEnv()->GetPublishedBodies(vecbodies,100000); // 0.1s
+        GetEnv()->GetPublishedBodies(_vecbodies,100000); // 0.1s
     }
     catch(const std::exception& ex) {
         RAVELOG_WARN("timeout of GetPublishedBodies\n");
@@ -1779,7 +1782,7 @@ void QtOSGViewer::UpdateFromModel()
     }
 
     bool newdata = false; // set to true if new object was created
-    FOREACH(itbody, vecbodies) {
+    FOREACH(itbody, _vecbodies) {
         BOOST_ASSERT( !!itbody->pbody );
         KinBodyPtr pbody = itbody->pbody; // try to use only as an id, don't call any methods!
         KinBodyItemPtr pitem = boost::dynamic_pointer_cast<KinBodyItem>(pbody->GetUserData(_userdatakey));
@@ -1812,6 +1815,7 @@ void QtOSGViewer::UpdateFromModel()
                             }
                         }
                         if( !lockenv ) {
+                            _vecbodies.clear(); // do not keep the bodies alive
                             return; // couldn't acquire the lock, try next time. This prevents deadlock situations
                         }
                     }
@@ -1857,8 +1861,11 @@ void QtOSGViewer::UpdateFromModel()
 
         pitem->SetUserData(1);
 
-        //  Update viewer with core transforms
-        pitem->UpdateFromModel(itbody->jointvalues, itbody->vectrans);
+        //  Update viewer with core transforms, only for bodies that changed
+        pitem->UpdateFromPublishedState(*itbody);
+    }
+    FOREACH(itbody, _vecbodies) {
+        itbody->pbody.reset(); // only the memory of the states is kept for the next update, not the bodies
     }
 
     FOREACH_NOINC(it, _mapbodies) {
@@ -2032,6 +2039,35 @@ void QtOSGViewer::_SetGraphTransform(OSGSwitchPtr handle, const RaveTransform<fl
     SetMatrixTransform(*OSGMatrixTransformPtr(OSGTransformPtr(OSGNodePtr(handle->getChild(0))->asTransform())->asMatrixTransform()), t);
 }
 
+void QtOSGViewer::_SetGraphPoints(OSGSwitchPtr handle, boost::shared_ptr<PendingGraphPoints> ppending)
+{
+    boost::mutex::scoped_lock lock(ppending->_mutex);
+    ppending->_bposted = false;
+    osg::ref_ptr<osg::Geometry> geometry;
+    if( handle->getNumChildren() > 0 ) {
+        osg::ref_ptr<osg::Group> trans = handle->getChild(0)->asGroup();
+        if( !!trans && trans->getNumChildren() > 0 ) {
+            osg::ref_ptr<osg::Geode> geode = trans->getChild(0)->asGeode();
+            if( !!geode && geode->getNumDrawables() > 0 ) {
+                geometry = geode->getDrawable(0)->asGeometry();
+            }
+        }
+    }
+    if( !geometry ) {
+        return;
+    }
+    osg::ref_ptr<osg::Vec3Array> vertices = dynamic_cast<osg::Vec3Array*>(geometry->getVertexArray());
+    osg::ref_ptr<osg::DrawArrays> drawarrays = geometry->getNumPrimitiveSets() > 0 ? dynamic_cast<osg::DrawArrays*>(geometry->getPrimitiveSet(0)) : NULL;
+    if( !vertices || !drawarrays || ppending->_vpoints.size() > vertices->size() ) {
+        return;
+    }
+    std::copy(ppending->_vpoints.begin(), ppending->_vpoints.end(), vertices->begin());
+    vertices->dirty();
+    drawarrays->setCount(ppending->_vpoints.size());
+    drawarrays->dirty();
+    geometry->dirtyBound();
+}
+
 void QtOSGViewer::_SetGraphShow(OSGSwitchPtr handle, bool bShow)
 {
     if (bShow) {
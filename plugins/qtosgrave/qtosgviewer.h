@@ -245,11 +245,23 @@ private:
     };
     typedef boost::shared_ptr<GUIThreadFunction> GUIThreadFunctionPtr;
 
+    /// \brief points of a graph handle waiting to be copied into its vertex buffer by the GUI thread
+    struct PendingGraphPoints
+    {
+        PendingGraphPoints() : _posttime(0), _bposted(false) {
+        }
+        boost::mutex _mutex;
+        std::vector<osg::Vec3> _vpoints;
+        uint64_t _posttime; ///< time _SetGraphPoints was queued
+        bool _bposted; ///< true if _SetGraphPoints is already queued, so further updates only overwrite _vpoints
+    };
+
     /// \brief implementation of graph handles for qtosg
     class PrivateGraphHandle : public GraphHandle
     {
 public:
-        PrivateGraphHandle(QtOSGViewerWeakPtr wviewer, OSGSwitchPtr handle) : _handle(handle), _wviewer(wviewer) {
+        /// \param numpoints the number of vertices of a point or line plot that can be updated with SetPoints, 0 for other plots
+        PrivateGraphHandle(QtOSGViewerWeakPtr wviewer, OSGSwitchPtr handle, int numpoints=0) : _handle(handle), _wviewer(wviewer), _numpoints(numpoints), _ppending(new PendingGraphPoints()) {
             BOOST_ASSERT(_handle != NULL);
         }
         virtual ~PrivateGraphHandle() {
@@ -275,8 +287,35 @@ public:
             }
         }
 
+        virtual bool SetPoints(const float* ppoints, int numPoints, int stride)
+        {
+            if( numPoints > _numpoints ) {
+                return false;
+            }
+            boost::shared_ptr<QtOSGViewer> viewer = _wviewer.lock();
+            if(!viewer) {
+                return false;
+            }
+            boost::mutex::scoped_lock lock(_ppending->_mutex);
+            _ppending->_vpoints.resize(numPoints);
+            for(int i = 0; i < numPoints; ++i) {
+                _ppending->_vpoints[i].set(ppoints[0], ppoints[1], ppoints[2]);
+                ppoints = (const float*)((const char*)ppoints + stride);
+            }
+            // updates faster than the GUI thread are coalesced into one copy. queued functions are dropped when the environment sync is disabled, so re-post stale ones
+            uint64_t curtime = utils::GetMicroTime();
+            if( !_ppending->_bposted || curtime - _ppending->_posttime > 1000000 ) {
+                _ppending->_bposted = true;
+                _ppending->_posttime = curtime;
+                viewer->_PostToGUIThread(boost::bind(&QtOSGViewer::_SetGraphPoints, viewer, _handle, _ppending)); // _handle is copied, so it will maintain the reference
+            }
+            return true;
+        }
+
         OSGSwitchPtr _handle;
         QtOSGViewerWeakPtr _wviewer;
+        int _numpoints;
+        boost::shared_ptr<PendingGraphPoints> _ppending;
     };
 
     inline QtOSGViewerPtr shared_viewer() {
@@ -307,6 +346,7 @@ public:
     virtual void _CloseGraphHandle(OSGSwitchPtr handle);
     virtual void _SetGraphTransform(OSGSwitchPtr handle, const RaveTransform<float> t);
     virtual void _SetGraphShow(OSGSwitchPtr handle, bool bShow);
+    virtual void _SetGraphPoints(OSGSwitchPtr handle, boost::shared_ptr<PendingGraphPoints> ppending);
 
     virtual void _Draw(OSGSwitchPtr handle, osg::ref_ptr<osg::Vec3Array> vertices, osg::ref_ptr<osg::Vec4Array> colors, osg::PrimitiveSet::Mode mode, osg::ref_ptr<osg::StateAttribute> attribute, bool bUsingTransparency=false);
     virtual void _DrawTriMesh(OSGSwitchPtr handle, osg::ref_ptr<osg::Vec3Array> vertices, osg::ref_ptr<osg::Vec4Array> colors, osg::ref_ptr<osg::DrawElementsUInt> osgindices, bool bUsingTransparency);
@@ -385,6 +425,7 @@ public:
 
     boost::mutex _mutexUpdating; ///< when inside an update function, even if just checking if the viewer should be updated, this will be locked.
     boost::mutex _mutexUpdateModels; ///< locked when osg environment is being updated from the underlying openrave environment
+    std::vector<KinBody::BodyState> _vecbodies; ///< published bodies, kept between updates so that their memory is reused. protected by _mutexUpdateModels
     boost::condition _condUpdateModels; ///< signaled everytime environment models are updated
 
     ViewGeometry _viewGeometryMode; ///< the visualization mode of the geometries
@@ -18,6 +18,7 @@
 // Rosen Diankov, Siddhartha Srinivasa, Dave Ferguson, James Kuffner.
 // Manipulation Planning with Caging Grasps. IEEE-RAS Intl. Conf. on Humanoid Robots, December 2008.
 #include "commonmanipulation.h"
+#include "parallelrangeworkers.h"
 
 class TaskCaging : public ModuleBase
 {
@@ -600,7 +601,19 @@ protected:
     class GraspConstraint
     {
 public:
+        /// \brief a copy of the environment that the perturbed configurations are checked in, see InitSnapshots
+        struct CagingSnapshot
+        {
+            EnvironmentBasePtr penv;
+            RobotBasePtr probot;
+            KinBody::LinkPtr plink;
+            SpaceSamplerBasePtr psampler; ///< if not set, RaveRandomFloat is used
+            vector<dReal> vrobotconfig, vsample;
+        };
+
         GraspConstraint() {
+            fCacheResolution = 0.001f;
+            _nCacheHits = 0;
             Nrandconfigs = 10;
             fRandPerturb.resize(7);
             // 0.01 for translation and 0.07 for quaterions (~8-10 degrees)
@@ -608,65 +621,81 @@ public:
             fRandPerturb[3] = fRandPerturb[4] = fRandPerturb[5] = fRandPerturb[6] = 0.07f;
         }
 
+        virtual ~GraspConstraint() {
+            DestroySnapshots();
+        }
+
+        /// \brief the results are memoized per robot configuration, quantized by fCacheResolution, since the caged target transforms do not change after CacheTransforms
         virtual bool Constraint(const vector<dReal>& pSrcConf, const vector<dReal>& pDestConf, IntervalType interval, PlannerBase::ConfigurationListPtr configurations)
         {
             if( !plink ||( vtargetjoints.size() == 0) ) {
                 return true;
             }
-            _robot->SetActiveDOFValues(pDestConf);
-            if( _robot->GetEnv()->CheckCollision(KinBodyConstPtr(_robot)) || _robot->CheckSelfCollision() ) {
-                return false;
-            }
-
-            bool bCaged = false;
-            vector<dReal> vrobotconfig;
-            _robot->GetActiveDOFValues(vrobotconfig);
 
-            // find N noncolliding grasps and check if they still cage the object
-            for(int iter = 0; iter < Nrandconfigs; ++iter) {
-                if( iter > 0 ) {
-                    plink->GetParent()->SetLinkTransformations(_vTargetTransforms);
-
-                    int niter=0;
-                    for(niter = 0; niter < 100; niter++) {
-                        for(int i = 0; i < _robot->GetActiveDOF(); ++i) {
-                            vrobotconfig[i] = pDestConf[i] + fRandPerturb[i]*(RaveRandomFloat()-0.5f);
-                        }
-
-                        _robot->SetActiveDOFValues(vrobotconfig);
-                        if( !_robot->GetEnv()->CheckCollision(KinBodyConstPtr(_robot)) && !_robot->CheckSelfCollision() ) {
-                            break;
-                        }
-                    }
-
-                    if( niter >= 100 ) {
-                        continue;
-                    }
-                }
-
-                FOREACH(itvv, _vvvCachedTransforms) {
-                    bCaged = false;
-                    FOREACH(itv, *itvv) {
-                        plink->GetParent()->SetLinkTransformations(*itv);
-                        if( _robot->GetEnv()->CheckCollision(KinBodyConstPtr(_robot), KinBodyConstPtr(plink->GetParent())) ) {
-                            bCaged = true;
-                            break;
-                        }
-                    }
+            _vcachekey.resize(pDestConf.size());
+            for(size_t i = 0; i < pDestConf.size(); ++i) {
+                _vcachekey[i] = fCacheResolution > 0 ? floor(pDestConf[i]/fCacheResolution+0.5f) : pDestConf[i];
+            }
+            std::map<vector<dReal>, bool>::const_iterator itcached = _mapCachedConstraints.find(_vcachekey);
+            if( itcached != _mapCachedConstraints.end() ) {
+                ++_nCacheHits;
+                return itcached->second;
+            }
+            bool bCaged = _Constraint(pDestConf);
+            _mapCachedConstraints[_vcachekey] = bCaged;
+            return bCaged;
+        }
 
-                    if( !bCaged ) {
-                        break;
-                    }
+        /// \brief creates numthreads copies of the environment that the perturbations of a configuration are split between
+        ///
+        /// Has to be called after the active dofs of the robot are set. If numthreads <= 1 or the copies cannot be created, the perturbations are checked in the original environment.
+        void InitSnapshots(int numthreads)
+        {
+            DestroySnapshots();
+            numthreads = min(numthreads, Nrandconfigs);
+            if( numthreads <= 1 ) {
+                return;
+            }
+            EnvironmentBasePtr penv = _robot->GetEnv();
+            _vsnapshots.resize(numthreads);
+            for(int ithread = 0; ithread < numthreads; ++ithread) {
+                CagingSnapshot& snapshot = _vsnapshots[ithread];
+                snapshot.penv = penv->CloneSelf(Clone_Bodies);
+                EnvironmentMutex::scoped_lock lock(snapshot.penv->GetMutex());
+                CollisionCheckerBasePtr pchecker = RaveCreateCollisionChecker(snapshot.penv, penv->GetCollisionChecker()->GetXMLId());
+                snapshot.probot = snapshot.penv->GetRobot(_robot->GetName());
+                KinBodyPtr ptarget = snapshot.penv->GetKinBody(plink->GetParent()->GetName());
+                snapshot.psampler = RaveCreateSpaceSampler(snapshot.penv, "mt19937");
+                if( !pchecker || !snapshot.probot || !ptarget || !snapshot.psampler ) {
+                    RAVELOG_WARN_FORMAT("env=%d, failed to initialize caging environment %d, checking the perturbations in one thread", penv->GetId()%ithread);
+                    DestroySnapshots();
+                    return;
                 }
+                snapshot.penv->SetCollisionChecker(pchecker);
+                snapshot.probot->SetActiveDOFs(_robot->GetActiveDOFIndices(), _robot->GetAffineDOF(), _robot->GetAffineRotationAxis());
+                snapshot.plink = ptarget->GetLinks().at(plink->GetIndex());
+            }
+            _pworkers.reset(new ParallelRangeWorkers(numthreads, "TaskCagingConstraint"));
+        }
 
-                if( !bCaged ) {
-                    break;
+        void DestroySnapshots()
+        {
+            FOREACH(itsnapshot, _vsnapshots) {
+                if( !!itsnapshot->penv ) {
+                    itsnapshot->penv->Destroy();
                 }
             }
+            _vsnapshots.clear();
+            _pworkers.reset();
+        }
 
-            _robot->SetActiveDOFValues(pDestConf);
-            plink->GetParent()->SetLinkTransformations(_vTargetTransforms);
-            return bCaged;
+        /// \brief the number of Constraint calls that were answered from the memoized results
+        int GetCacheHits() const {
+            return _nCacheHits;
+        }
+
+        size_t GetCacheSize() const {
+            return _mapCachedConstraints.size();
         }
 
         dReal Dist6D(const vector<dReal>& v1, const vector<dReal>& v2)
@@ -738,9 +767,124 @@ public:
         int Nrandconfigs;
         vector<dReal> fRandPerturb;
 
+        dReal fCacheResolution; ///< the resolution the configurations are quantized with for memoizing the Constraint results, 0 only reuses the results of identical configurations
+
 private:
+        bool _Constraint(const vector<dReal>& pDestConf)
+        {
+            _robot->SetActiveDOFValues(pDestConf);
+            if( _robot->GetEnv()->CheckCollision(KinBodyConstPtr(_robot)) || _robot->CheckSelfCollision() ) {
+                return false;
+            }
+
+            bool bCaged;
+            if( _vsnapshots.size() > 0 ) {
+                // draw the seeds here so that the perturbations do not depend on the number of threads
+                _vseeds.resize(Nrandconfigs);
+                FOREACH(itseed, _vseeds) {
+                    *itseed = RaveRandomInt();
+                }
+                _vcaged.resize(_vsnapshots.size());
+                // one job per snapshot, each job checks a contiguous part of the perturbations
+                _pworkers->Run(_vsnapshots.size(), boost::bind(&GraspConstraint::_CheckCagingRange, this, boost::cref(pDestConf), _1, _2));
+                bCaged = std::find(_vcaged.begin(), _vcaged.end(), 0) == _vcaged.end();
+            }
+            else {
+                CagingSnapshot snapshot;
+                snapshot.penv = _robot->GetEnv();
+                snapshot.probot = _robot;
+                snapshot.plink = plink;
+                bCaged = _CheckCaging(snapshot, pDestConf, 0, Nrandconfigs);
+            }
+
+            _robot->SetActiveDOFValues(pDestConf);
+            plink->GetParent()->SetLinkTransformations(_vTargetTransforms);
+            return bCaged;
+        }
+
+        /// \brief checks the perturbations of the snapshots [startsnapshot, endsnapshot), called from the worker threads
+        void _CheckCagingRange(const vector<dReal>& vdestconfig, size_t startsnapshot, size_t endsnapshot)
+        {
+            for(size_t isnapshot = startsnapshot; isnapshot < endsnapshot; ++isnapshot) {
+                CagingSnapshot& snapshot = _vsnapshots[isnapshot];
+                EnvironmentMutex::scoped_lock lock(snapshot.penv->GetMutex());
+                int startiter = (Nrandconfigs*isnapshot)/_vsnapshots.size(), enditer = (Nrandconfigs*(isnapshot+1))/_vsnapshots.size();
+                _vcaged[isnapshot] = _CheckCaging(snapshot, vdestconfig, startiter, enditer);
+            }
+        }
+
+        /// \brief returns true if the perturbations [startiter, enditer) of vdestconfig still cage the target, iteration 0 is vdestconfig itself.
+        ///
+        /// Perturbations that could not be made collision-free are skipped.
+        bool _CheckCaging(CagingSnapshot& snapshot, const vector<dReal>& vdestconfig, int startiter, int enditer)
+        {
+            RobotBasePtr probot = snapshot.probot;
+            KinBodyPtr ptarget = snapshot.plink->GetParent();
+            snapshot.vrobotconfig = vdestconfig;
+            // find N noncolliding grasps and check if they still cage the object
+            for(int iter = startiter; iter < enditer; ++iter) {
+                ptarget->SetLinkTransformations(_vTargetTransforms);
+                if( iter > 0 ) {
+                    if( !!snapshot.psampler ) {
+                        snapshot.psampler->SetSeed(_vseeds.at(iter));
+                    }
+
+                    int niter=0;
+                    for(niter = 0; niter < 100; niter++) {
+                        if( !!snapshot.psampler ) {
+                            snapshot.psampler->SampleSequence(snapshot.vsample, probot->GetActiveDOF(), IT_OpenEnd);
+                        }
+                        for(int i = 0; i < probot->GetActiveDOF(); ++i) {
+                            dReal frand = !!snapshot.psampler ? snapshot.vsample[i] : RaveRandomFloat();
+                            snapshot.vrobotconfig[i] = vdestconfig[i] + fRandPerturb[i]*(frand-0.5f);
+                        }
+
+                        probot->SetActiveDOFValues(snapshot.vrobotconfig);
+                        if( !snapshot.penv->CheckCollision(KinBodyConstPtr(probot)) && !probot->CheckSelfCollision() ) {
+                            break;
+                        }
+                    }
+
+                    if( niter >= 100 ) {
+                        continue;
+                    }
+                }
+                else {
+                    probot->SetActiveDOFValues(vdestconfig);
+                }
+
+                bool bCaged = false;
+                FOREACH(itvv, _vvvCachedTransforms) {
+                    bCaged = false;
+                    FOREACH(itv, *itvv) {
+                        ptarget->SetLinkTransformations(*itv);
+                        if( snapshot.penv->CheckCollision(KinBodyConstPtr(probot), KinBodyConstPtr(ptarget)) ) {
+                            bCaged = true;
+                            break;
+                        }
+                    }
+
+                    if( !bCaged ) {
+                        break;
+                    }
+                }
+
+                if( !bCaged ) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
         vector< vector< vector<Transform> > > _vvvCachedTransforms;
         vector<Transform> _vTargetTransforms;
+        std::map<vector<dReal>, bool> _mapCachedConstraints; ///< memoized Constraint results indexed by the quantized configuration
+        vector<dReal> _vcachekey;
+        int _nCacheHits;
+        vector<CagingSnapshot> _vsnapshots;
+        ParallelRangeWorkersPtr _pworkers;
+        vector<uint32_t> _vseeds; ///< the sampler seed of every perturbation
+        vector<int> _vcaged; ///< the result of every snapshot
     };
 
     inline boost::shared_ptr<TaskCaging> shared_problem() {
@@ -762,7 +906,7 @@ This greatly relaxes the constraints on the robot (see the door manipluation exa
 - Rosen Diankov, Siddhartha Srinivasa, Dave Ferguson, James Kuffner. Manipulation Planning with Caging Grasps. IEEE-RAS Intl. Conf. on Humanoid Robots, December 2008.";
         RegisterCommand("graspset",boost::bind(&TaskCaging::GraspSet, this, _1, _2),
                         "Creates a grasp set given a robot end-effector floating in space.\n"
-                        "Options: step exploreprob size target targetjoint contactconfigdelta cagedconfig");
+                        "Options: step exploreprob size target targetjoint contactconfigdelta cagedconfig cagesides numthreads cacheresolution");
         RegisterCommand("taskconstraintplan", boost::bind(&TaskCaging::TaskConstrainedPlanner, this, _1, _2),
                         "Invokes the relaxed task constrained planner");
         RegisterCommand("simpleconstraintplan", boost::bind(&TaskCaging::SimpleConstrainedPlanner, this, _1, _2),
@@ -844,6 +988,7 @@ private:
         params->_nExpectedDataSize = 1000;
 
         vector<int> vTargetSides;
+        int numthreads = 1;
 
         string cmd;
         while(!sinput.eof()) {
@@ -881,6 +1026,12 @@ private:
                 FOREACH(it, vTargetSides)
                 sinput >> *it;
             }
+            else if( cmd == "numthreads" ) {
+                sinput >> numthreads;
+            }
+            else if( cmd == "cacheresolution" ) {
+                sinput >> graspfn->fCacheResolution;
+            }
             else {
                 RAVELOG_WARN(str(boost::format("unrecognized command: %s\n")%cmd));
                 break;
@@ -939,6 +1090,7 @@ private:
         _robot->SetActiveDOFs(vector<int>(), RobotBase::DOF_X|RobotBase::DOF_Y|RobotBase::DOF_Z|RobotBase::DOF_RotationQuat);
         _robot->GetActiveDOFValues(params->vinitialconfig);
         params->SetRobotActiveJoints(_robot);
+        graspfn->InitSnapshots(numthreads);
         params->_checkpathconstraintsfn = boost::bind(&GraspConstraint::Constraint,graspfn,_1,_2,_3,_4);
         params->_distmetricfn = boost::bind(&GraspConstraint::Dist6D,graspfn,_1,_2);
 
@@ -961,6 +1113,8 @@ private:
 
 
         RAVELOG_INFO(str(boost::format("finished computing grasp set: pts=%d in %dms\n")%ptraj->GetPoints().size()%(utils::GetMilliTime()-basetime)));
+        RAVELOG_DEBUG_FORMAT("caging constraint cache: configurations=%d, hits=%d", graspfn->GetCacheSize()%graspfn->GetCacheHits());
+        graspfn->DestroySnapshots();
 
         vtargetvalues = graspfn->vtargetvalues;
         RobotBase::ManipulatorPtr pmanip = _robot->GetActiveManipulator();
@@ -14,6 +14,7 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "commonmanipulation.h"
+#include "parallelrangeworkers.h"
 
 #define GRASPTHRESH2 dReal(0.002f)
 
@@ -74,6 +75,8 @@ Task-based manipulation planning involving target objects. A lot of the algorith
 * savepreshapetraj\n\
 * grasptranslationstepmult\n\
 * graspfinestep\n\
+* prefiltergrasps - if 1 (default), checks the end-effector collisions and ik of all grasps given with grasptrans_nocol before planning, and plans the valid ones ordered by the distance of their ik solutions\n\
+* prefilterthreads - number of threads checking the grasps in prefiltergrasps, each uses its own copy of the environment\n\
 ");
         RegisterCommand("CloseFingers",boost::bind(&TaskManipulation::ChuckFingers,this,_1,_2),
                         "Chucks the active manipulator fingers using the grasp planner along manip->GetChuckingDirection().");
@@ -101,6 +104,7 @@ Task-based manipulation planning involving target objects. A lot of the algorith
         _fMaxVelMult=1;
         _minimumgoalpaths=1;
         _report.reset(new CollisionReport());
+        _nPrefilterThreads = 1;
     }
     virtual ~TaskManipulation()
     {
@@ -114,6 +118,11 @@ Task-based manipulation planning involving target objects. A lot of the algorith
         _pGrasperPlanner.reset();
         _pRRTPlanner.reset();
         _robot.reset();
+        _pPrefilterWorkers.reset();
+        FOREACH(itprefilterenv, _vPrefilterEnvs) {
+            itprefilterenv->penv->Destroy();
+        }
+        _vPrefilterEnvs.clear();
     }
 
     virtual void Reset()
@@ -376,6 +385,7 @@ protected:
         int nMaxSeedGrasps = 20, nMaxSeedDests = 5, nMaxSeedIkSolutions = 0;
         int nMaxIterations = 4000;
         bool bQuitAfterFirstRun = false;
+        bool bPrefilterGrasps = true;
         dReal jitter = 0.03;
         int nJitterIterations = 5000;
         std::string sPaddedGeometryGroup; // the padded geometry group for the robot that will be switched when planning
@@ -508,6 +518,12 @@ protected:
             else if( cmd == "graspfinestep" ) {
                 sinput >> graspparams->ffinestep;
             }
+            else if( cmd == "prefiltergrasps" ) {
+                sinput >> bPrefilterGrasps;
+            }
+            else if( cmd == "prefilterthreads" ) {
+                sinput >> _nPrefilterThreads;
+            }
             else {
                 RAVELOG_WARN(str(boost::format("unrecognized command: %s\n")%cmd));
                 break;
@@ -630,6 +646,23 @@ protected:
             ikfilter = pmanip->GetIkSolver()->RegisterCustomFilter(0,boost::bind(&TaskManipulation::_FilterIkForGrasping,shared_problem(),_1,_2,_3,ptarget));
             //fApproachOffset = 0; // cannot approach?
         }
+        else if( bPrefilterGrasps && iGraspTransformNoCol >= 0 && !nMobileAffine && pmanip->GetIkSolver()->Supports(IKP_Transform6D) ) {
+            // most grasps fail the end-effector collision or ik checks, so reject them all before planning any of them
+            GraspPrefilterParameters prefilter;
+            prefilter.pgrasps = vgrasps.size() > 0 ? &vgrasps[0] : NULL;
+            prefilter.nGraspDim = nGraspDim;
+            prefilter.iGraspTransformNoCol = iGraspTransformNoCol;
+            prefilter.iGraspPreshape = iGraspPreshape;
+            prefilter.iGraspDir = iGraspDir;
+            prefilter.fApproachOffset = fApproachOffset;
+            prefilter.transTarg = transTarg;
+            prefilter.vCurRobotValues = vCurRobotValues;
+            prefilter.vHandLowerLimits = vHandLowerLimits;
+            prefilter.vHandUpperLimits = vHandUpperLimits;
+            geometrypadder.SwitchRegular();
+            _PrefilterGrasps(prefilter, pmanip, ptarget, vgrasppermuation);
+            geometrypadder.SwitchPadded();
+        }
 
         for(int igraspperm = 0; igraspperm < (int)vgrasppermuation.size(); ++igraspperm) {
             int igrasp = vgrasppermuation[igraspperm];
@@ -1507,6 +1540,26 @@ protected:
     }
 
 protected:
+    /// \brief the grasp set and robot state that _PrefilterGrasps checks the grasps with
+    struct GraspPrefilterParameters
+    {
+        const dReal* pgrasps;
+        int nGraspDim, iGraspTransformNoCol, iGraspPreshape, iGraspDir;
+        dReal fApproachOffset;
+        Transform transTarg;
+        vector<dReal> vCurRobotValues, vHandLowerLimits, vHandUpperLimits;
+    };
+
+    /// \brief the environment that the prefilter checks of one thread run in
+    struct GraspPrefilterEnv
+    {
+        EnvironmentBasePtr penv;
+        RobotBasePtr probot;
+        RobotBase::ManipulatorPtr pmanip;
+        KinBodyPtr ptarget;
+        vector<dReal> vpreshape, viksolution;
+    };
+
     inline boost::shared_ptr<TaskManipulation> shared_problem() {
         return boost::dynamic_pointer_cast<TaskManipulation>(shared_from_this());
     }
@@ -1514,6 +1567,165 @@ protected:
         return boost::dynamic_pointer_cast<TaskManipulation const>(shared_from_this());
     }
 
+    /// \brief removes the grasps that fail the end-effector collision or ik checks from vgraspindices and sorts the rest by the distance of their ik solutions
+    ///
+    /// These are the cheap checks that GraspPlanning does for every grasp given by its grasp transform. With _nPrefilterThreads > 1 the grasps are split between copies of the environment.
+    void _PrefilterGrasps(const GraspPrefilterParameters& prefilter, RobotBase::ManipulatorConstPtr pmanip, KinBodyPtr ptarget, vector<int>& vgraspindices)
+    {
+        uint64_t starttime = utils::GetNanoPerformanceTime();
+        _vPrefilterScores.resize(vgraspindices.size());
+        std::fill(_vPrefilterScores.begin(), _vPrefilterScores.end(), dReal(-1));
+        if( _nPrefilterThreads > 1 && _InitPrefilterEnvs(pmanip, ptarget) ) {
+            _pPrefilterWorkers->Run(_vPrefilterEnvs.size(), boost::bind(&TaskManipulation::_PrefilterGraspsRange,this,boost::cref(prefilter),boost::cref(vgraspindices),_1,_2));
+        }
+        else {
+            RobotBase::RobotStateSaver saver(_robot);
+            GraspPrefilterEnv prefilterenv;
+            prefilterenv.penv = GetEnv();
+            prefilterenv.probot = _robot;
+            prefilterenv.pmanip = _robot->GetManipulator(pmanip->GetName());
+            prefilterenv.ptarget = ptarget;
+            for(size_t i = 0; i < vgraspindices.size(); ++i) {
+                _vPrefilterScores[i] = _PrefilterGrasp(prefilterenv, prefilter, vgraspindices[i]);
+            }
+        }
+
+        vector< std::pair<dReal, int> > vscoredgrasps;
+        vscoredgrasps.reserve(vgraspindices.size());
+        for(size_t i = 0; i < vgraspindices.size(); ++i) {
+            if( _vPrefilterScores[i] >= 0 ) {
+                vscoredgrasps.push_back(std::make_pair(_vPrefilterScores[i], vgraspindices[i]));
+            }
+        }
+        // stable so that grasps with the same distance keep their (possibly random) order
+        std::stable_sort(vscoredgrasps.begin(), vscoredgrasps.end(), boost::bind(&std::pair<dReal, int>::first,_1) < boost::bind(&std::pair<dReal, int>::first,_2));
+        RAVELOG_DEBUG_FORMAT("prefiltered grasps, valid=%d/%d, threads=%d, computation=%fs", vscoredgrasps.size()%vgraspindices.size()%max(1,(int)_vPrefilterEnvs.size())%(1e-9*(utils::GetNanoPerformanceTime() - starttime)));
+        vgraspindices.resize(vscoredgrasps.size());
+        for(size_t i = 0; i < vscoredgrasps.size(); ++i) {
+            vgraspindices[i] = vscoredgrasps[i].second;
+        }
+    }
+
+    /// \brief checks the grasps that belong to prefilter environments [start, end), called from the worker threads
+    void _PrefilterGraspsRange(const GraspPrefilterParameters& prefilter, const vector<int>& vgraspindices, size_t start, size_t end)
+    {
+        const size_t numgrasps = vgraspindices.size();
+        const size_t numenvs = _vPrefilterEnvs.size();
+        for(size_t ienv = start; ienv < end; ++ienv) {
+            GraspPrefilterEnv& prefilterenv = _vPrefilterEnvs[ienv];
+            EnvironmentMutex::scoped_lock lock(prefilterenv.penv->GetMutex());
+            for(size_t i = (numgrasps*ienv)/numenvs; i < (numgrasps*(ienv+1))/numenvs; ++i) {
+                try {
+                    _vPrefilterScores[i] = _PrefilterGrasp(prefilterenv, prefilter, vgraspindices[i]);
+                }
+                catch(const std::exception& ex) {
+                    RAVELOG_WARN_FORMAT("env=%d, failed to prefilter grasp %d: %s", GetEnv()->GetId()%vgraspindices[i]%ex.what());
+                }
+            }
+        }
+    }
+
+    /// \brief checks the preshape, end-effector collision, and ik at the grasp and approach of grasp igrasp
+    ///
+    /// \return the squared distance of the approach ik solution to the current arm values, or -1 if the grasp is not valid
+    dReal _PrefilterGrasp(GraspPrefilterEnv& prefilterenv, const GraspPrefilterParameters& prefilter, int igrasp) const
+    {
+        const dReal* pgrasp = prefilter.pgrasps + igrasp*prefilter.nGraspDim;
+        const vector<int>& vgripperindices = prefilterenv.pmanip->GetGripperIndices();
+        const vector<int>& varmindices = prefilterenv.pmanip->GetArmIndices();
+        prefilterenv.probot->SetDOFValues(prefilter.vCurRobotValues);
+        if( prefilter.iGraspPreshape >= 0 ) {
+            prefilterenv.vpreshape.resize(vgripperindices.size());
+            for(size_t j = 0; j < vgripperindices.size(); ++j) {
+                prefilterenv.vpreshape[j] = pgrasp[prefilter.iGraspPreshape+j];
+                if( prefilter.vHandLowerLimits.at(j) > prefilterenv.vpreshape[j]+0.001 || prefilter.vHandUpperLimits.at(j) < prefilterenv.vpreshape[j]-0.001 ) {
+                    return -1;
+                }
+            }
+            prefilterenv.probot->SetDOFValues(prefilterenv.vpreshape, KinBody::CLA_CheckLimits, vgripperindices);
+        }
+
+        const dReal* pm = pgrasp+prefilter.iGraspTransformNoCol;
+        TransformMatrix tm;
+        tm.m[0] = pm[0]; tm.m[1] = pm[3]; tm.m[2] = pm[6]; tm.trans.x = pm[9];
+        tm.m[4] = pm[1]; tm.m[5] = pm[4]; tm.m[6] = pm[7]; tm.trans.y = pm[10];
+        tm.m[8] = pm[2]; tm.m[9] = pm[5]; tm.m[10] = pm[8]; tm.trans.z = pm[11];
+        Transform tgoal = prefilter.transTarg * Transform(tm);
+        {
+            KinBody::KinBodyStateSaver targetsaver(prefilterenv.ptarget,KinBody::Save_LinkEnable);
+            prefilterenv.ptarget->Enable(false);
+            if( prefilterenv.pmanip->CheckEndEffectorCollision(tgoal) ) {
+                return -1;
+            }
+        }
+        if( !prefilterenv.pmanip->FindIKSolution(IkParameterization(tgoal), prefilterenv.viksolution, IKFO_CheckEnvCollisions) ) {
+            return -1;
+        }
+        if( prefilter.fApproachOffset > 0 ) {
+            Vector vglobalpalmdir;
+            if( prefilter.iGraspDir >= 0 ) {
+                vglobalpalmdir = prefilter.transTarg.rotate(Vector(pgrasp[prefilter.iGraspDir], pgrasp[prefilter.iGraspDir+1], pgrasp[prefilter.iGraspDir+2]));
+            }
+            else {
+                vglobalpalmdir = tgoal.rotate(prefilterenv.pmanip->GetDirection());
+            }
+            Transform tsmalloffset;
+            tsmalloffset.trans = -prefilter.fApproachOffset * vglobalpalmdir;
+            // seed with the grasp solution like GraspPlanning does
+            prefilterenv.probot->SetDOFValues(prefilterenv.viksolution, KinBody::CLA_CheckLimits, varmindices);
+            if( !prefilterenv.pmanip->FindIKSolution(IkParameterization(tsmalloffset*tgoal), prefilterenv.viksolution, IKFO_CheckEnvCollisions) ) {
+                return -1;
+            }
+        }
+        dReal fdist2 = 0;
+        for(size_t j = 0; j < varmindices.size(); ++j) {
+            dReal f = prefilterenv.viksolution.at(j) - prefilter.vCurRobotValues.at(varmindices[j]);
+            fdist2 += f*f;
+        }
+        return fdist2;
+    }
+
+    /// \brief updates one copy of the environment per prefilter thread, see _PrefilterGrasps
+    ///
+    /// The copies are kept between calls so that only the bodies that changed need to be copied.
+    bool _InitPrefilterEnvs(RobotBase::ManipulatorConstPtr pmanip, KinBodyPtr ptarget)
+    {
+        _vPrefilterEnvs.resize(_nPrefilterThreads);
+        for(int ithread = 0; ithread < _nPrefilterThreads; ++ithread) {
+            GraspPrefilterEnv& prefilterenv = _vPrefilterEnvs[ithread];
+            if( !prefilterenv.penv ) {
+                prefilterenv.penv = GetEnv()->CloneSelf(Clone_Bodies);
+            }
+            else {
+                prefilterenv.penv->Clone(GetEnv(), Clone_Bodies|Clone_SkipUnchangedBodies);
+            }
+            EnvironmentMutex::scoped_lock lock(prefilterenv.penv->GetMutex());
+            prefilterenv.probot = prefilterenv.penv->GetRobot(_robot->GetName());
+            prefilterenv.ptarget = prefilterenv.penv->GetKinBody(ptarget->GetName());
+            if( !prefilterenv.probot || !prefilterenv.ptarget ) {
+                RAVELOG_WARN_FORMAT("env=%d, prefilter environment %d does not have robot %s or target %s", GetEnv()->GetId()%ithread%_robot->GetName()%ptarget->GetName());
+                return false;
+            }
+            prefilterenv.pmanip = prefilterenv.probot->GetManipulator(pmanip->GetName());
+            if( !prefilterenv.pmanip ) {
+                return false;
+            }
+            if( !prefilterenv.pmanip->GetIkSolver() ) {
+                // the ik solver was set by the user rather than loaded from the robot file, so copy it
+                IkSolverBasePtr pnewsolver = RaveCreateIkSolver(prefilterenv.penv, pmanip->GetIkSolver()->GetXMLId());
+                if( !pnewsolver ) {
+                    return false;
+                }
+                pnewsolver->Clone(pmanip->GetIkSolver(), 0);
+                prefilterenv.pmanip->SetIkSolver(pnewsolver);
+            }
+        }
+        if( !_pPrefilterWorkers || _pPrefilterWorkers->GetNumThreads() != _nPrefilterThreads ) {
+            _pPrefilterWorkers.reset(new ParallelRangeWorkers(_nPrefilterThreads, "TaskManipulationPrefilter"));
+        }
+        return true;
+    }
+
     /// \brief grasps using the list of grasp goals. Removes all the goals that the planner planned with
     TrajectoryBasePtr _PlanGrasp(list<GRASPGOAL>&listGraspGoals, int nSeedIkSolutions, GRASPGOAL& goalfound, int nMaxIterations,PRESHAPETRAJMAP& mapPreshapeTrajectories, GeometryGroupSaver& geometrypadder, dReal fPadding, dReal fRRTStepLength)
     {
@@ -1844,6 +2056,11 @@ protected:
     std::string _sPostProcessingParameters;
     int _minimumgoalpaths;
     CollisionReportPtr _report;
+
+    int _nPrefilterThreads; ///< see the prefilterthreads option of GraspPlanning
+    std::vector<GraspPrefilterEnv> _vPrefilterEnvs; ///< one environment copy per prefilter thread
+    std::vector<dReal> _vPrefilterScores; ///< result of _PrefilterGrasp for each grasp being prefiltered
+    ParallelRangeWorkersPtr _pPrefilterWorkers;
 };
 
 ModuleBasePtr CreateTaskManipulation(EnvironmentBasePtr penv) {
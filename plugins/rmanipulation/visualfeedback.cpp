@@ -14,14 +14,15 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "commonmanipulation.h"
+#include "parallelrangeworkers.h"
 
-/// samples rays from the projected OBB and returns true if the test function returns true
-/// for all the rays. Otherwise, returns false
+/// samples rays from the projected OBB, appends the ray directions on the z=1 image plane to vpoints
 /// allowableoutliers - specifies the % of allowable outliying rays
-bool SampleProjectedOBBWithTest(const OBB& obb, dReal delta, const boost::function<bool(const Vector&)>& testfn,dReal allowableocclusion=0)
+/// \return the number of rays that are allowed to fail
+int SampleProjectedOBB(const OBB& obb, dReal delta, std::vector<Vector>& vpoints, dReal allowableocclusion=0)
 {
     dReal fscalefactor = 0.95f; // have to make box smaller or else rays might miss
-    Vector vpoints[8] = { obb.pos + fscalefactor*(obb.right*obb.extents.x + obb.up*obb.extents.y + obb.dir*obb.extents.z),
+    Vector vcorners[8] = { obb.pos + fscalefactor*(obb.right*obb.extents.x + obb.up*obb.extents.y + obb.dir*obb.extents.z),
                           obb.pos + fscalefactor*(obb.right*obb.extents.x + obb.up*obb.extents.y - obb.dir*obb.extents.z),
                           obb.pos + fscalefactor*(obb.right*obb.extents.x - obb.up*obb.extents.y + obb.dir*obb.extents.z),
                           obb.pos + fscalefactor*(obb.right*obb.extents.x - obb.up*obb.extents.y - obb.dir*obb.extents.z),
@@ -30,13 +31,13 @@ bool SampleProjectedOBBWithTest(const OBB& obb, dReal delta, const boost::functi
                           obb.pos + fscalefactor*(-obb.right*obb.extents.x - obb.up*obb.extents.y + obb.dir*obb.extents.z),
                           obb.pos + fscalefactor*(-obb.right*obb.extents.x - obb.up*obb.extents.y - obb.dir*obb.extents.z)};
     //    Vector vpoints3d[8];
-    //    for(int j = 0; j < 8; ++j) vpoints3d[j] = tcamera*vpoints[j];
+    //    for(int j = 0; j < 8; ++j) vpoints3d[j] = tcamera*vcorners[j];
 
     for(int i =0; i < 8; ++i) {
-        dReal fz = 1.0f/vpoints[i].z;
-        vpoints[i].x *= fz;
-        vpoints[i].y *= fz;
-        vpoints[i].z = 1;
+        dReal fz = 1.0f/vcorners[i].z;
+        vcorners[i].x *= fz;
+        vcorners[i].y *= fz;
+        vcorners[i].z = 1;
     }
 
     int faceindices[3][4];
@@ -64,9 +65,9 @@ bool SampleProjectedOBBWithTest(const OBB& obb, dReal delta, const boost::functi
         // have to compute the area of all the faces!
         dReal farea=0;
         for(int i = 0; i < 3; ++i) {
-            Vector v0 = vpoints[faceindices[i][0]];
-            Vector v1 = vpoints[faceindices[i][1]]-v0;
-            Vector v2 = vpoints[faceindices[i][2]]-v0;
+            Vector v0 = vcorners[faceindices[i][0]];
+            Vector v1 = vcorners[faceindices[i][1]]-v0;
+            Vector v2 = vcorners[faceindices[i][2]]-v0;
             Vector v = v1.cross(v2);
             farea += v.lengthsqr3();
         }
@@ -74,10 +75,10 @@ bool SampleProjectedOBBWithTest(const OBB& obb, dReal delta, const boost::functi
     }
 
     for(int i = 0; i < 3; ++i) {
-        Vector v0 = vpoints[faceindices[i][0]];
-        Vector v1 = vpoints[faceindices[i][1]]-v0;
-        Vector v2 = vpoints[faceindices[i][2]]-v0;
-        Vector v3 = vpoints[faceindices[i][3]]-v0;
+        Vector v0 = vcorners[faceindices[i][0]];
+        Vector v1 = vcorners[faceindices[i][1]]-v0;
+        Vector v2 = vcorners[faceindices[i][2]]-v0;
+        Vector v3 = vcorners[faceindices[i][3]]-v0;
         dReal f3length = RaveSqrt(v3.lengthsqr2());
         Vector v3norm = v3 * (1.0f/f3length);
         Vector v3perp(-v3norm.y,v3norm.x,0,0);
@@ -94,10 +95,7 @@ bool SampleProjectedOBBWithTest(const OBB& obb, dReal delta, const boost::functi
             int numsteps = (int)(ftotalen/delta);
             Vector vdelta = (vcur2-vcur1)*(1.0f/numsteps), vcur = vcur1;
             for(int k = 0; k <= numsteps; ++k, vcur += vdelta) {
-                if( !testfn(vcur) ) {
-                    if( nallowableoutliers-- <= 0 )
-                        return false;
-                }
+                vpoints.push_back(vcur);
             }
         }
 
@@ -120,14 +118,28 @@ bool SampleProjectedOBBWithTest(const OBB& obb, dReal delta, const boost::functi
             int numsteps = (int)(ftotalen/delta);
             Vector vdelta = (vcur2-vcur1)*(1.0f/numsteps), vcur = vcur1;
             for(int k = 0; k <= numsteps; ++k, vcur += vdelta) {
-                if( !testfn(vcur) ) {
-                    if( nallowableoutliers-- <= 0 )
-                        return false;
-                }
+                vpoints.push_back(vcur);
             }
         }
     }
 
+    return nallowableoutliers;
+}
+
+/// samples rays from the projected OBB and returns true if the test function returns true
+/// for all the rays. Otherwise, returns false
+/// allowableoutliers - specifies the % of allowable outliying rays
+bool SampleProjectedOBBWithTest(const OBB& obb, dReal delta, const boost::function<bool(const Vector&)>& testfn,dReal allowableocclusion=0)
+{
+    std::vector<Vector> vpoints;
+    int nallowableoutliers = SampleProjectedOBB(obb, delta, vpoints, allowableocclusion);
+    FOREACHC(itpoint, vpoints) {
+        if( !testfn(*itpoint) ) {
+            if( nallowableoutliers-- <= 0 ) {
+                return false;
+            }
+        }
+    }
     return true;
 }
 
@@ -165,6 +177,18 @@ private:
             VisibilityConstraintFunction& _vcf;
         };
 public:
+        /// \brief rays sampled on the projected target OBBs for one camera transform in the target coordinate system, see ComputeVisibilityExtent
+        struct VisibilityExtent
+        {
+            VisibilityExtent() : bInConvexHull(false) {
+            }
+            bool bInConvexHull; ///< result of InConvexHull for the camera transform, the rays are only sampled if true
+            std::vector<Vector> vraydirs; ///< ray directions in the camera coordinate system, the rays of target obb i are [vobbrayoffsets[i], vobbrayoffsets[i+1])
+            std::vector<size_t> vobbrayoffsets;
+            std::vector<int> vallowableoutliers; ///< number of rays of each target obb that can be occluded
+        };
+        typedef boost::shared_ptr<VisibilityExtent> VisibilityExtentPtr;
+
         static void GetAABBFromOBB(const OBB& obb, Vector& vMin, Vector& vMax)
         {
             vMax.x = fabsf(obb.right.x) * obb.extents.x + fabsf(obb.up.x) * obb.extents.y + fabsf(obb.dir.x) * obb.extents.z;
@@ -270,7 +294,8 @@ public:
         /// samples the ik
         /// If camera is attached to robot, assume target is not movable and t is the camera position.
         /// If camera is not attached to robot, assume target is movable and t is the target position.
-        bool SampleWithCamera(const TransformMatrix& t, vector<dReal>& pNewSample)
+        /// \param pextent [optional] precomputed visibility extent of the camera transform in the target coordinate system
+        bool SampleWithCamera(const TransformMatrix& t, vector<dReal>& pNewSample, const VisibilityExtent* pextent=NULL)
         {
             Transform tCameraInTarget, ttarget;
             if( _vf->_robot != _vf->_sensorrobot ) {
@@ -281,7 +306,7 @@ public:
                 ttarget = _vf->_target->GetTransform();
                 tCameraInTarget = ttarget.inverse()*t;
             }
-            if( !InConvexHull(tCameraInTarget) ) {
+            if( !(!!pextent ? pextent->bInConvexHull : InConvexHull(tCameraInTarget)) ) {
                 RAVELOG_DEBUG("box not in camera vision hull\n");
                 return false;
             }
@@ -304,6 +329,9 @@ public:
             }
             _vf->_robot->SetActiveDOFValues(pNewSample);
 
+            if( !!pextent ) {
+                return !IsOccluded(tCameraInTarget, *pextent);
+            }
             return !IsOccluded(tCameraInTarget);
         }
 
@@ -324,24 +352,74 @@ public:
             return true;
         }
 
+        /// \brief samples the rays of the target obbs projected on the camera
+        ///
+        /// The extent only depends on the camera transform in the target coordinate system, so it can be computed once per camera transform hypothesis.
+        /// \param tCameraInTarget in target coordinate system
+        void ComputeVisibilityExtent(const TransformMatrix& tCameraInTarget, VisibilityExtent& extent)
+        {
+            extent.vraydirs.resize(0);
+            extent.vobbrayoffsets.resize(0);
+            extent.vallowableoutliers.resize(0);
+            extent.bInConvexHull = InConvexHull(tCameraInTarget);
+            if( !extent.bInConvexHull ) {
+                return;
+            }
+            TransformMatrix tCameraInTargetinv = tCameraInTarget.inverse();
+            FOREACH(itobb,_vTargetOBBs) {
+                OBB cameraobb = geometry::TransformOBB(tCameraInTargetinv,*itobb);
+                extent.vobbrayoffsets.push_back(extent.vraydirs.size());
+                extent.vallowableoutliers.push_back(SampleProjectedOBB(cameraobb, _vf->_fSampleRayDensity, extent.vraydirs, _vf->_fAllowableOcclusion));
+            }
+            extent.vobbrayoffsets.push_back(extent.vraydirs.size());
+            FOREACH(itdir, extent.vraydirs) {
+                dReal filen = 1/RaveSqrt(itdir->lengthsqr3());
+                *itdir *= 2.0f*filen;
+            }
+        }
+
         /// check if any part of the environment or robot is in front of the camera blocking the object
         /// sample object's surface and shoot rays
         /// \param tCameraInTarget in target coordinate system
         bool IsOccluded(const TransformMatrix& tCameraInTarget)
+        {
+            ComputeVisibilityExtent(tCameraInTarget, _extent);
+            return IsOccluded(tCameraInTarget, _extent);
+        }
+
+        /// \brief checks the rays of the extent in batches, stops as soon as one target obb has more occluded rays than allowed
+        /// \param tCameraInTarget in target coordinate system
+        /// \param extent the visibility extent of tCameraInTarget
+        bool IsOccluded(const TransformMatrix& tCameraInTarget, const VisibilityExtent& extent)
         {
             KinBody::KinBodyStateSaver saver1(_ptargetbox), saver2(_vf->_target,KinBody::Save_LinkEnable);
-            TransformMatrix tCameraInTargetinv = tCameraInTarget.inverse();
             Transform ttarget = _vf->_target->GetTransform();
             _ptargetbox->SetTransform(ttarget);
             Transform tworldcamera = ttarget*tCameraInTarget;
             _ptargetbox->Enable(true);
             //_vf->_target->Enable(false);
             SampleRaysScope srs(*this);
-            FOREACH(itobb,_vTargetOBBs) {
-                OBB cameraobb = geometry::TransformOBB(tCameraInTargetinv,*itobb);
-                if( !SampleProjectedOBBWithTest(cameraobb, _vf->_fSampleRayDensity, boost::bind(&VisibilityConstraintFunction::_TestRay, this, _1, boost::ref(tworldcamera)),_vf->_fAllowableOcclusion) ) {
-                    RAVELOG_VERBOSE("box is occluded\n");
-                    return true;
+            CollisionCheckerBasePtr pchecker = _vf->_robot->GetEnv()->GetCollisionChecker();
+            for(size_t iobb = 0; iobb+1 < extent.vobbrayoffsets.size(); ++iobb) {
+                int noccluded = 0;
+                for(size_t istart = extent.vobbrayoffsets[iobb]; istart < extent.vobbrayoffsets[iobb+1]; istart += s_nRayBatchSize) {
+                    size_t iend = std::min(istart+s_nRayBatchSize, extent.vobbrayoffsets[iobb+1]);
+                    _vrays.resize(iend-istart);
+                    for(size_t iray = istart; iray < iend; ++iray) {
+                        RAY& r = _vrays[iray-istart];
+                        r.dir = tworldcamera.rotate(extent.vraydirs[iray]);
+                        r.pos = tworldcamera.trans + 0.5f*_vf->_fRayMinDist*r.dir;         // move the rays a little forward
+                    }
+                    pchecker->CheckCollisionRays(_vrays, _vraydistances, _vrayhitlinks);
+                    for(size_t iray = 0; iray < _vrays.size(); ++iray) {
+                        // a ray that hits nothing is not supposed to happen, but it is OK
+                        if( _vraydistances[iray] >= 0 && !(!!_vrayhitlinks[iray] && _vrayhitlinks[iray]->GetParent() == _ptargetbox) ) {
+                            if( ++noccluded > extent.vallowableoutliers[iobb] ) {
+                                RAVELOG_VERBOSE("box is occluded\n");
+                                return true;
+                            }
+                        }
+                    }
                 }
             }
             return false;
@@ -380,31 +458,7 @@ public:
         }
 
 private:
-        bool _TestRay(const Vector& v, const TransformMatrix& tcamera)
-        {
-            RAY r;
-            dReal filen = 1/RaveSqrt(v.lengthsqr3());
-            r.dir = tcamera.rotate((2.0f*filen)*v);
-            r.pos = tcamera.trans + 0.5f*_vf->_fRayMinDist*r.dir;         // move the rays a little forward
-            if( !_vf->_robot->GetEnv()->CheckCollision(r,_report) ) {
-                return true;         // not supposed to happen, but it is OK
-            }
-
-            //            RaveVector<float> vpoints[2];
-            //            vpoints[0] = r.pos;
-            //            vpoints[1] = _report.contacts[0].pos;
-            //            _vf->_robot->GetEnv()->drawlinestrip(vpoints[0],2,16,1.0f,Vector(0,0,1));
-            if( !(!!_report->plink1 &&( _report->plink1->GetParent() == _ptargetbox) ) ) {
-                if( _report->contacts.size() > 0 ) {
-                    Vector v = _report->contacts.at(0).pos;
-                    RAVELOG_VERBOSE_FORMAT("bad collision: %s: %f %f %f", _report->__str__()%v.x%v.y%v.z);
-                }
-                else {
-                    RAVELOG_VERBOSE_FORMAT("bad collision: %s", _report->__str__());
-                }
-            }
-            return !!_report->plink1 && _report->plink1->GetParent() == _ptargetbox;
-        }
+        static const size_t s_nRayBatchSize = 64; ///< number of rays checked at once by IsOccluded, bounds the work done past the ray that decides the occlusion
 
         bool _TestRayRigid(const Vector& v, const TransformMatrix& tcamera, const vector<KinBody::LinkPtr>& vattachedlinks)
         {
@@ -452,6 +506,10 @@ private:
         CollisionReportPtr _report;
         AABB _abTarget;         // target aabb
         vector<Vector> _vconvexplanes3d;
+        VisibilityExtent _extent; ///< cache for IsOccluded
+        vector<RAY> _vrays; ///< cache for IsOccluded
+        vector<dReal> _vraydistances;
+        vector<KinBody::LinkConstPtr> _vrayhitlinks;
     };
 
     class GoalSampleFunction
@@ -462,6 +520,7 @@ public:
             RAVELOG_DEBUG(str(boost::format("have %d detection extents hypotheses\n")%_visibilitytransforms.size()));
             _ttarget = _vf->_target->GetTransform();
             _sphereperms.PermuteStart(_visibilitytransforms.size());
+            _vextents.resize(_visibilitytransforms.size());
         }
         virtual ~GoalSampleFunction() {
         }
@@ -487,7 +546,17 @@ public:
         bool SampleWithParameters(int isample, vector<dReal>& pNewSample)
         {
             TransformMatrix tcamera = _ttarget*_visibilitytransforms.at(isample);
-            return _vconstraint.SampleWithCamera(tcamera,pNewSample);
+            if( _vf->_robot != _vf->_sensorrobot ) {
+                // the camera in the target coordinate system depends on the sampled target transform
+                return _vconstraint.SampleWithCamera(tcamera,pNewSample);
+            }
+            // the camera in the target coordinate system is the visibility transform, so its rays only have to be sampled once
+            VisibilityConstraintFunction::VisibilityExtentPtr& pextent = _vextents.at(isample);
+            if( !pextent ) {
+                pextent.reset(new VisibilityConstraintFunction::VisibilityExtent());
+                _vconstraint.ComputeVisibilityExtent(_visibilitytransforms.at(isample), *pextent);
+            }
+            return _vconstraint.SampleWithCamera(tcamera,pNewSample,pextent.get());
         }
 
         VisibilityConstraintFunction _vconstraint;
@@ -501,6 +570,7 @@ private:
         Vector _vTargetLocalCenter;
         RandomPermutationExecutor _sphereperms;
         vector<Transform> _vcameras;         ///< camera transformations in local coord systems
+        vector<VisibilityConstraintFunction::VisibilityExtentPtr> _vextents; ///< visibility extents of _visibilitytransforms, computed when first sampled
     };
 
     VisualFeedback(EnvironmentBasePtr penv) : ModuleBase(penv), _preport(new CollisionReport())
@@ -528,7 +598,9 @@ Visibility computation checks occlusion with other objects using ray sampling in
                         "Processes the visibility extents of the target and initializes the camera transforms.\n\
 \n\
 :param sphere: Sets the transforms along a sphere density and the distances\n\
-:param conedirangle: Prunes the currently set transforms along a cone centered at the local target center and directed towards conedirangle with a half-angle of ``|conedirangle|``. Can specify multiple cones for an OR effect.");
+:param conedirangle: Prunes the currently set transforms along a cone centered at the local target center and directed towards conedirangle with a half-angle of ``|conedirangle|``. Can specify multiple cones for an OR effect.\n\
+:param numthreads: Tests the camera transforms on this many copies of the environment in parallel, split by transform index.\n\
+:param checkpoint: File the test result of every camera transform is appended to as it is computed. If the file already has results for the same camera transforms, only the remaining transforms are tested, so an interrupted run can be resumed.");
         RegisterCommand("SetCameraTransforms",boost::bind(&VisualFeedback::SetCameraTransforms,this,_1,_2),
                         "Sets new camera transformations. Can optionally choose a minimum distance from all planes of the camera convex hull (includes gripper mask)");
         RegisterCommand("ComputeVisibility",boost::bind(&VisualFeedback::ComputeVisibility,this,_1,_2),
@@ -820,6 +892,8 @@ Visibility computation checks occlusion with other objects using ray sampling in
         int numrolls=8;
         vector<Vector> vconedirangles;
         vector<Transform> vtransforms;
+        int numthreads = 1;
+        string checkpointfilename;
         while(!sinput.eof()) {
             sinput >> cmd;
             if( !sinput ) {
@@ -841,6 +915,12 @@ Visibility computation checks occlusion with other objects using ray sampling in
             }
             else if( cmd == "numrolls" )
                 sinput >> numrolls;
+            else if( cmd == "numthreads" ) {
+                sinput >> numthreads;
+            }
+            else if( cmd == "checkpoint" ) {
+                sinput >> checkpointfilename;
+            }
             else if( cmd == "extents" ) {
                 if( !bSetTargetCenter && !!_target ) {
                     KinBody::KinBodyStateSaver saver(_target);
@@ -939,37 +1019,197 @@ Visibility computation checks occlusion with other objects using ray sampling in
             }
         }
 
+        // the result of every camera transform, -1 if not tested yet
+        std::vector<int> vvalid(vtransforms.size(), -1);
+        std::ofstream fcheckpoint;
+        if( checkpointfilename.size() > 0 ) {
+            bool bresume = _ReadVisibilityExtentsCheckpoint(checkpointfilename, vtransforms, vvalid);
+            if( bresume ) {
+                fcheckpoint.open(checkpointfilename.c_str(), std::ios::app);
+            }
+            else {
+                fcheckpoint.open(checkpointfilename.c_str(), std::ios::trunc);
+                fcheckpoint << "visibilityextents " << vtransforms.size() << " " << std::setprecision(std::numeric_limits<dReal>::digits10+1) << _ComputeTransformsChecksum(vtransforms) << std::endl;
+            }
+            if( !fcheckpoint ) {
+                RAVELOG_WARN_FORMAT("failed to open checkpoint file %s", checkpointfilename);
+            }
+        }
+        std::vector<int> vpending;
+        vpending.reserve(vtransforms.size());
+        for(size_t i = 0; i < vtransforms.size(); ++i) {
+            if( vvalid[i] < 0 ) {
+                vpending.push_back(i);
+            }
+        }
+        RAVELOG_DEBUG_FORMAT("env=%d, testing %d/%d camera transforms with %d threads", GetEnv()->GetId()%vpending.size()%vtransforms.size()%numthreads);
+
+        if( numthreads > 1 && vpending.size() > 0 && !_InitVisibilityExtentsEnvs(numthreads) ) {
+            RAVELOG_WARN_FORMAT("env=%d, failed to set up %d visibility threads, so testing in this thread", GetEnv()->GetId()%numthreads);
+            numthreads = 1;
+        }
+
         KinBody::KinBodyStateSaver saver(_target,KinBody::Save_LinkTransformation);
         _target->SetTransform(Transform());
-        boost::shared_ptr<VisibilityConstraintFunction> pconstraintfn(new VisibilityConstraintFunction(shared_problem()));
+        boost::shared_ptr<VisibilityConstraintFunction> pconstraintfn;
+        if( numthreads <= 1 ) {
+            pconstraintfn.reset(new VisibilityConstraintFunction(shared_problem()));
+        }
 
-        // get all the camera positions and test them
-        FOREACHC(itcamera, vtransforms) {
-            Transform tCameraInTarget = *itcamera;
-            Transform tTargetInWorld;
-            if( _sensorrobot == _robot ) {
-                //BOOST_ASSERT(0);
-                tTargetInWorld = _sensorrobot->GetTransform() * tCameraInTarget.inverse();
+        // get all the camera positions and test them. The results are written to the checkpoint after every block.
+        size_t blocksize = s_nVisibilityExtentsBlockSize*max(1, numthreads);
+        for(size_t iblockstart = 0; iblockstart < vpending.size(); iblockstart += blocksize) {
+            size_t iblockend = min(iblockstart+blocksize, vpending.size());
+            if( numthreads > 1 ) {
+                _pVisibilityExtentsWorkers->Run(numthreads, boost::bind(&VisualFeedback::_TestVisibilityExtentsRange, this, boost::cref(vtransforms), boost::cref(vpending), iblockstart, iblockend, boost::ref(vvalid), _1, _2));
             }
             else {
-                tTargetInWorld = _sensorrobot->GetTransform() * tCameraInTarget.inverse();
+                for(size_t i = iblockstart; i < iblockend; ++i) {
+                    vvalid[vpending[i]] = _IsValidVisibilityExtent(*pconstraintfn, vtransforms[vpending[i]]);
+                }
             }
-
-            if( pconstraintfn->InConvexHull(*itcamera) ) {
-                if( !_pmanip->CheckEndEffectorCollision(tTargetInWorld*_ttogripper, _preport) ) {
-                    if( !pconstraintfn->IsOccludedByRigid(*itcamera) ) {
-                        sout << *itcamera << " ";
-                    }
-                    else {
-                        RAVELOG_VERBOSE("in convex hull and effector is free, but not occluded by rigid\n");
-                    }
+            if( !!fcheckpoint ) {
+                for(size_t i = iblockstart; i < iblockend; ++i) {
+                    fcheckpoint << vpending[i] << " " << vvalid[vpending[i]] << "\n";
                 }
-                else {
-                    RAVELOG_VERBOSE_FORMAT("in convex hull, but end effector collision: %s", _preport->__str__());
+                fcheckpoint.flush();
+            }
+        }
+
+        for(size_t i = 0; i < vtransforms.size(); ++i) {
+            if( vvalid[i] > 0 ) {
+                sout << vtransforms[i] << " ";
+            }
+        }
+        return true;
+    }
+
+    /// \brief returns true if the camera transform can see the target without the end effector colliding and without the rigidly attached links occluding it
+    ///
+    /// \param tCameraInTarget in target coordinate system, the target has to be at the origin
+    bool _IsValidVisibilityExtent(VisibilityConstraintFunction& constraintfn, const Transform& tCameraInTarget)
+    {
+        if( !constraintfn.InConvexHull(tCameraInTarget) ) {
+            return false;
+        }
+        Transform tTargetInWorld = _sensorrobot->GetTransform() * tCameraInTarget.inverse();
+        if( _pmanip->CheckEndEffectorCollision(tTargetInWorld*_ttogripper, _preport) ) {
+            RAVELOG_VERBOSE_FORMAT("in convex hull, but end effector collision: %s", _preport->__str__());
+            return false;
+        }
+        if( constraintfn.IsOccludedByRigid(tCameraInTarget) ) {
+            RAVELOG_VERBOSE("in convex hull and effector is free, but not occluded by rigid\n");
+            return false;
+        }
+        return true;
+    }
+
+    /// \brief tests the transforms vpending[ipendingstart:ipendingend] on the environment copies [start:end], called from the worker threads
+    ///
+    /// Every copy tests a contiguous part of the pending transforms.
+    void _TestVisibilityExtentsRange(const std::vector<Transform>& vtransforms, const std::vector<int>& vpending, size_t ipendingstart, size_t ipendingend, std::vector<int>& vvalid, size_t start, size_t end)
+    {
+        size_t numthreads = _vVisibilityExtentsEnvs.size(), num = ipendingend-ipendingstart;
+        for(size_t ithread = start; ithread < end; ++ithread) {
+            boost::shared_ptr<VisualFeedback> pvf = _vVisibilityExtentsEnvs.at(ithread).pvf;
+            EnvironmentMutex::scoped_lock lock(pvf->GetEnv()->GetMutex());
+            KinBody::KinBodyStateSaver saver(pvf->_target,KinBody::Save_LinkTransformation);
+            pvf->_target->SetTransform(Transform());
+            VisibilityConstraintFunction constraintfn(pvf);
+            for(size_t i = ipendingstart+(num*ithread)/numthreads; i < ipendingstart+(num*(ithread+1))/numthreads; ++i) {
+                vvalid[vpending[i]] = pvf->_IsValidVisibilityExtent(constraintfn, vtransforms[vpending[i]]);
+            }
+        }
+    }
+
+    /// \brief updates one copy of the environment and of this module per visibility thread, see ProcessVisibilityExtents
+    ///
+    /// The copies are kept between calls so that only the bodies that changed need to be copied.
+    bool _InitVisibilityExtentsEnvs(int numthreads)
+    {
+        _vVisibilityExtentsEnvs.resize(numthreads);
+        for(int ithread = 0; ithread < numthreads; ++ithread) {
+            VisibilityExtentsEnv& extentsenv = _vVisibilityExtentsEnvs[ithread];
+            if( !extentsenv.penv ) {
+                extentsenv.penv = GetEnv()->CloneSelf(Clone_Bodies);
+            }
+            else {
+                extentsenv.penv->Clone(GetEnv(), Clone_Bodies|Clone_SkipUnchangedBodies);
+            }
+            EnvironmentMutex::scoped_lock lock(extentsenv.penv->GetMutex());
+            boost::shared_ptr<VisualFeedback> pvf(new VisualFeedback(extentsenv.penv));
+            pvf->_robot = extentsenv.penv->GetRobot(_robot->GetName());
+            pvf->_sensorrobot = extentsenv.penv->GetRobot(_sensorrobot->GetName());
+            pvf->_target = extentsenv.penv->GetKinBody(_target->GetName());
+            if( !pvf->_robot || !pvf->_sensorrobot || !pvf->_target ) {
+                RAVELOG_WARN_FORMAT("env=%d, visibility environment %d does not have robot %s, sensor robot %s, or target %s", GetEnv()->GetId()%ithread%_robot->GetName()%_sensorrobot->GetName()%_target->GetName());
+                return false;
+            }
+            pvf->_pmanip = pvf->_robot->GetManipulator(_pmanip->GetName());
+            FOREACH(itsensor, pvf->_sensorrobot->GetAttachedSensors()) {
+                if( (*itsensor)->GetName() == _psensor->GetName() ) {
+                    pvf->_psensor = *itsensor;
+                    break;
                 }
             }
+            if( !pvf->_pmanip || !pvf->_psensor ) {
+                return false;
+            }
+            pvf->_bIgnoreSensorCollision = _bIgnoreSensorCollision;
+            pvf->_fMaxVelMult = _fMaxVelMult;
+            pvf->_bCameraOnManip = _bCameraOnManip;
+            pvf->_pcamerageom = _pcamerageom;
+            pvf->_ttogripper = _ttogripper;
+            pvf->_fRayMinDist = _fRayMinDist;
+            pvf->_fAllowableOcclusion = _fAllowableOcclusion;
+            pvf->_fSampleRayDensity = _fSampleRayDensity;
+            pvf->_vconvexplanes = _vconvexplanes;
+            pvf->_vcenterconvex = _vcenterconvex;
+            extentsenv.pvf = pvf;
         }
+        if( !_pVisibilityExtentsWorkers || _pVisibilityExtentsWorkers->GetNumThreads() != numthreads ) {
+            _pVisibilityExtentsWorkers.reset(new ParallelRangeWorkers(numthreads, "VisualFeedbackVisibilityExtents"));
+        }
+        return true;
+    }
 
+    /// \brief a checksum of the camera transforms so that a checkpoint is not resumed with different transforms
+    static dReal _ComputeTransformsChecksum(const std::vector<Transform>& vtransforms)
+    {
+        dReal fchecksum = 0;
+        for(size_t i = 0; i < vtransforms.size(); ++i) {
+            const Transform& t = vtransforms[i];
+            fchecksum += (i+1)*(t.rot.x+t.rot.y+t.rot.z+t.rot.w+t.trans.x+t.trans.y+t.trans.z);
+        }
+        return fchecksum;
+    }
+
+    /// \brief reads the results of a previous ProcessVisibilityExtents call into vvalid
+    ///
+    /// \return true if the checkpoint was written for the same camera transforms, false if it does not exist or has to be started over
+    bool _ReadVisibilityExtentsCheckpoint(const std::string& filename, const std::vector<Transform>& vtransforms, std::vector<int>& vvalid)
+    {
+        std::ifstream f(filename.c_str());
+        if( !f ) {
+            return false;
+        }
+        std::string header;
+        size_t numtransforms = 0;
+        dReal fchecksum = 0;
+        f >> header >> numtransforms >> fchecksum;
+        dReal fexpectedchecksum = _ComputeTransformsChecksum(vtransforms);
+        if( !f || header != "visibilityextents" || numtransforms != vtransforms.size() || RaveFabs(fchecksum-fexpectedchecksum) > 1e-7*max(dReal(1),RaveFabs(fexpectedchecksum)) ) {
+            RAVELOG_WARN_FORMAT("checkpoint %s was computed for different camera transforms, so starting over", filename);
+            return false;
+        }
+        int index = 0, valid = 0, numread = 0;
+        while( f >> index >> valid ) {
+            if( index >= 0 && index < (int)vvalid.size() ) {
+                vvalid[index] = valid != 0;
+                ++numread;
+            }
+        }
+        RAVELOG_INFO_FORMAT("resuming from %d results of checkpoint %s", numread%filename);
         return true;
     }
 
@@ -1429,6 +1669,16 @@ protected:
 
     vector<Vector> _vconvexplanes;     ///< the planes defining the bounding visibility region (posive is inside)
     Vector _vcenterconvex;     ///< center point on the z=1 plane of the convex region
+
+    /// \brief copy of the environment and of this module testing camera transforms in ProcessVisibilityExtents
+    struct VisibilityExtentsEnv
+    {
+        EnvironmentBasePtr penv;
+        boost::shared_ptr<VisualFeedback> pvf; ///< uses the robot, sensor, and target of penv
+    };
+    static const size_t s_nVisibilityExtentsBlockSize = 64; ///< number of camera transforms every thread tests between two writes of the checkpoint
+    std::vector<VisibilityExtentsEnv> _vVisibilityExtentsEnvs;
+    ParallelRangeWorkersPtr _pVisibilityExtentsWorkers;
 };
 
 ModuleBasePtr CreateVisualFeedback(EnvironmentBasePtr penv) {
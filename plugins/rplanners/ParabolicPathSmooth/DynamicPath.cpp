@@ -30,6 +30,7 @@
 
 #include "DynamicPath.h"
 #include "Timer.h"
+#include <openrave/utils.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <list>
@@ -733,6 +734,7 @@ int DynamicPath::Shortcut(int numIters,RampFeasibilityChecker& check, Real minti
 
 int DynamicPath::Shortcut(int numIters,RampFeasibilityChecker& check,RandomNumberGeneratorBase* rng, Real mintimestep)
 {
+    OpenRAVE::utils::ProfileZone profilezone("DynamicPath::Shortcut");
     int shortcuts = 0;
     vector<Real> rampStartTime(ramps.size());
     Real endTime=0;
@@ -120,34 +120,6 @@ void ParabolicRamp1D::SetLinear(Real _x0,Real _x1,Real t)
     ttotal = t;
 }
 
-Real ParabolicRamp1D::Evaluate(Real t) const
-{
-    Real tmT = t - ttotal;
-    if(t < tswitch1) return x0 + 0.5*a1*t*t + dx0*t;
-    else if(t < tswitch2) {
-        Real xswitch = x0 + 0.5*a1*tswitch1*tswitch1 + dx0*tswitch1;
-        return xswitch + (t-tswitch1)*v;
-    }
-    else return x1 + 0.5*a2*tmT*tmT + dx1*tmT;
-}
-
-Real ParabolicRamp1D::Derivative(Real t) const
-{
-    if(t < tswitch1) return a1*t + dx0;
-    else if(t < tswitch2) return v;
-    else {
-        Real tmT = t - ttotal;
-        return a2*tmT + dx1;
-    }
-}
-
-Real ParabolicRamp1D::Accel(Real t) const
-{
-    if(t < tswitch1) return a1;
-    else if(t < tswitch2) return 0;
-    else return a2;
-}
-
 bool ParabolicRamp1D::SolveMinAccel(Real endTime,Real vmax)
 {
     ParabolicRamp p;
@@ -1923,9 +1895,15 @@ void ParabolicRampND::SolveBraking(const Vector& amax)
     PARABOLIC_RAMP_ASSERT(IsValid());
 }
 
+// the DOF of a plan does not change, so the switch on ramps.size() is always predicted
 void ParabolicRampND::Evaluate(Real t,Vector& x) const
 {
     x.resize(ramps.size());
+    switch(ramps.size()) {
+    case 6: ParabolicRampNFixed<6>::Evaluate(&ramps[0],t,&x[0]); return;
+    case 7: ParabolicRampNFixed<7>::Evaluate(&ramps[0],t,&x[0]); return;
+    case 8: ParabolicRampNFixed<8>::Evaluate(&ramps[0],t,&x[0]); return;
+    }
     for(size_t j=0; j<ramps.size(); j++)
         x[j]=ramps[j].Evaluate(t);
 }
@@ -1933,6 +1911,11 @@ void ParabolicRampND::Evaluate(Real t,Vector& x) const
 void ParabolicRampND::Derivative(Real t,Vector& x) const
 {
     x.resize(ramps.size());
+    switch(ramps.size()) {
+    case 6: ParabolicRampNFixed<6>::Derivative(&ramps[0],t,&x[0]); return;
+    case 7: ParabolicRampNFixed<7>::Derivative(&ramps[0],t,&x[0]); return;
+    case 8: ParabolicRampNFixed<8>::Derivative(&ramps[0],t,&x[0]); return;
+    }
     for(size_t j=0; j<ramps.size(); j++)
         x[j]=ramps[j].Derivative(t);
 }
@@ -1940,6 +1923,11 @@ void ParabolicRampND::Derivative(Real t,Vector& x) const
 void ParabolicRampND::Accel(Real t,Vector& x) const
 {
     x.resize(ramps.size());
+    switch(ramps.size()) {
+    case 6: ParabolicRampNFixed<6>::Accel(&ramps[0],t,&x[0]); return;
+    case 7: ParabolicRampNFixed<7>::Accel(&ramps[0],t,&x[0]); return;
+    case 8: ParabolicRampNFixed<8>::Accel(&ramps[0],t,&x[0]); return;
+    }
     for(size_t j=0; j<ramps.size(); j++)
         x[j]=ramps[j].Accel(t);
 }
@@ -1957,9 +1945,7 @@ void ParabolicRampND::Output(Real dt,std::vector<Vector>& path) const
     }
     for(int i=0; i<size; i++) {
         Real t=endTime*Real(i)/Real(size-1);
-        path[i].resize(ramps.size());
-        for(size_t j=0; j<ramps.size(); j++)
-            path[i][j]=ramps[j].Evaluate(t);
+        Evaluate(t,path[i]);
     }
 
     /*
@@ -78,11 +78,30 @@ public:
     /// solves for the ramp given fixed tswitch1 and (ttotal-tswitch2). ttotal and tswitch2 will be solved for.
     bool SolveFixedAccelSwitchTime(Real amax,Real vmax, Real deltaswitch1, Real deltaswitch3);
     /// Evaluates the trajectory
-    Real Evaluate(Real t) const;
+    inline Real Evaluate(Real t) const {
+        Real tmT = t - ttotal;
+        if(t < tswitch1) return x0 + 0.5*a1*t*t + dx0*t;
+        else if(t < tswitch2) {
+            Real xswitch = x0 + 0.5*a1*tswitch1*tswitch1 + dx0*tswitch1;
+            return xswitch + (t-tswitch1)*v;
+        }
+        else return x1 + 0.5*a2*tmT*tmT + dx1*tmT;
+    }
     /// Evaluates the derivative of the trajectory
-    Real Derivative(Real t) const;
+    inline Real Derivative(Real t) const {
+        if(t < tswitch1) return a1*t + dx0;
+        else if(t < tswitch2) return v;
+        else {
+            Real tmT = t - ttotal;
+            return a2*tmT + dx1;
+        }
+    }
     /// Evaluates the second derivative of the trajectory
-    Real Accel(Real t) const;
+    inline Real Accel(Real t) const {
+        if(t < tswitch1) return a1;
+        else if(t < tswitch2) return 0;
+        else return a2;
+    }
     /// Returns the time at which x1 is reached
     Real EndTime() const {
         return ttotal;
@@ -162,6 +181,29 @@ public:
 
 };
 
+/** @brief Per-DOF loops of ParabolicRampND for a DOF count known at compile time.
+ *
+ * The loops have a constant trip count and the 1D ramps are evaluated inline,
+ * so the compiler fully unrolls them. ParabolicRampND dispatches to these for
+ * the common arm sizes (6, 7 and 8 DOF) and keeps its dynamic loops for others.
+ */
+template <int N>
+struct ParabolicRampNFixed
+{
+    static inline void Evaluate(const ParabolicRamp1D* ramps, Real t, Real* x) {
+        for(int j=0; j<N; j++)
+            x[j]=ramps[j].Evaluate(t);
+    }
+    static inline void Derivative(const ParabolicRamp1D* ramps, Real t, Real* dx) {
+        for(int j=0; j<N; j++)
+            dx[j]=ramps[j].Derivative(t);
+    }
+    static inline void Accel(const ParabolicRamp1D* ramps, Real t, Real* ddx) {
+        for(int j=0; j<N; j++)
+            ddx[j]=ramps[j].Accel(t);
+    }
+};
+
 /// Calculates the minimum total duration that a ramp has to be stretched to
 bool CalculateLeastBoundInoperativeInterval(Real x0, Real v0, Real x1, Real v1, Real amax, Real vmax, Real& newEndTime); ////////Puttichai
 
@@ -20,6 +20,7 @@
 
 #include "ParabolicPathSmooth/DynamicPath.h"
 #include "mergewaypoints.h"
+#include "parallelrangeworkers.h"
 
 
 namespace ParabolicRamp = ParabolicRampInternal;
@@ -101,6 +102,8 @@ public:
     {
         __description = ":Interface Author: Rosen Diankov\nConstraint-based smoothing with `Indiana University Intelligent Motion Laboratory <http://www.iu.edu/~motion/software.html>`_ parabolic smoothing library (Kris Hauser).\n\n**Note:** The original trajectory will not be preserved at all, don't use this if the robot has to hit all points of the trajectory.\n";
         _bCheckControllerTimeStep = true;
+        RegisterCommand("GetMergeStatistics",boost::bind(&ConstraintParabolicSmoother::GetMergeStatisticsCommand,this,_1,_2),
+                        "returns the statistics of the time-scaling coefficient searches of the shortcut merges since the last InitPlan as name/value pairs: numthreads, numsearches, numiterations, numcandidates, duration (s), durationpercandidate (s)");
         //_distancechecker = RaveCreateCollisionChecker(penv, "pqp");
         //OPENRAVE_ASSERT_FORMAT0(!!_distancechecker, "need pqp distance checker", ORE_Assert);
     }
@@ -211,6 +214,7 @@ public:
             OPENRAVE_ASSERT_FORMAT0(!!_uniformsampler, "need mt19937 space samplers", ORE_Assert);
         }
         _uniformsampler->SetSeed(_parameters->_nRandomGeneratorSeed);
+        _mergestatistics = mergewaypoints::MergeStatistics();
 
 
         // check and update minswitchtime
@@ -226,6 +230,14 @@ public:
         return _parameters;
     }
 
+    bool GetMergeStatisticsCommand(std::ostream& os, std::istream& is)
+    {
+        int numthreads = max(1, (int)_vMergePlanners.size());
+        dReal fdurationpercandidate = _mergestatistics.numcandidates > 0 ? _mergestatistics.fcandidateduration*numthreads/_mergestatistics.numcandidates : 0;
+        os << "numthreads " << numthreads << " numsearches " << _mergestatistics.numsearches << " numiterations " << _mergestatistics.numiterations << " numcandidates " << _mergestatistics.numcandidates << " duration " << _mergestatistics.fcandidateduration << " durationpercandidate " << fdurationpercandidate;
+        return !!os;
+    }
+
     virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj)
     {
         BOOST_ASSERT(!!_parameters && !!ptraj);
@@ -260,16 +272,12 @@ public:
         ptraj->GetWaypoints(0,ptraj->GetNumWaypoints(),vtrajpoints,posspec);
 
         ParabolicRamp::RampFeasibilityChecker checker(this);
-        checker.tol = _parameters->_vConfigResolution;
-        FOREACH(it, checker.tol) {
-            *it *= _parameters->_pointtolerance;
-        }
-        checker.constraintsmask = CFO_CheckEnvCollisions|CFO_CheckSelfCollisions|CFO_CheckTimeBasedConstraints|CFO_CheckUserConstraints;
+        _InitFeasibilityChecker(checker);
         RAVELOG_VERBOSE_FORMAT("minswitchtime = %f, steplength=%f\n",_parameters->minswitchtime%_parameters->_fStepLength);
 
         try {
             //  Convert to ramps
-            std::list<ParabolicRamp::ParabolicRampND> ramps,ramps2;
+            std::vector<ParabolicRamp::ParabolicRampND> ramps,ramps2;
             std::vector<ConfigurationSpecification::Group>::const_iterator itcompatposgroup = ptraj->GetConfigurationSpecification().FindCompatibleGroup(posspec._vgroups.at(0), false);
             OPENRAVE_ASSERT_FORMAT(itcompatposgroup != ptraj->GetConfigurationSpecification()._vgroups.end(), "failed to find group %s in passed in trajectory", posspec._vgroups.at(0).name, ORE_InvalidArguments);
 
@@ -411,8 +419,12 @@ public:
                 RAVELOG_DEBUG("Start shortcutting\n");
                 _progress._iteration=0;
                 dReal besttime = 1e10;
-                std::list<ParabolicRamp::ParabolicRampND> bestramps,initramps;
+                std::vector<ParabolicRamp::ParabolicRampND> bestramps,initramps;
                 initramps = ramps;
+                if( _parameters->minswitchtime > 0 && !_InitMergePlanners() ) {
+                    RAVELOG_WARN_FORMAT("env=%d, failed to set up %d merge threads, so merging in this thread", GetEnv()->GetId()%_parameters->nshortcutthreads);
+                    _vMergePlanners.resize(0);
+                }
                 for(int rep=0; rep<_parameters->nshortcutcycles; rep++) {
                     ramps = initramps;
                     RAVELOG_VERBOSE_FORMAT("Start shortcut cycle %d\n",rep);
@@ -443,7 +455,7 @@ public:
 
                 int options = 0xffff;
                 dReal upperbound = 1.05;
-                std::list<ParabolicRamp::ParabolicRampND> resramps;
+                std::vector<ParabolicRamp::ParabolicRampND> resramps;
                 bool resmerge = mergewaypoints::FurtherMergeRamps(ramps,resramps, _parameters, upperbound, _bCheckControllerTimeStep, _uniformsampler,checker,options);
                 if(resmerge) {
                     RAVELOG_DEBUG("Great, could further merge ramps!!\n");
@@ -519,7 +531,7 @@ public:
     }
 
     /// \brief converts ramps to an openrave trajectory structure. If return is PS_HasSolution, _dummytraj has the converted result
-    PlannerStatus ConvertRampsToOpenRAVETrajectory(const std::list<ParabolicRamp::ParabolicRampND>& ramps, ParabolicRamp::RampFeasibilityChecker* pchecker, const std::string& sTrajectoryXMLId=std::string())
+    PlannerStatus ConvertRampsToOpenRAVETrajectory(const std::vector<ParabolicRamp::ParabolicRampND>& ramps, ParabolicRamp::RampFeasibilityChecker* pchecker, const std::string& sTrajectoryXMLId=std::string())
     {
         const ConfigurationSpecification& posspec = _parameters->_configurationspecification;
         ConfigurationSpecification velspec = posspec.ConvertToVelocitySpecification();
@@ -598,7 +610,7 @@ public:
         return PS_HasSolution;
     }
 
-    bool SetMilestones(std::list<ParabolicRamp::ParabolicRampND>& ramps, const vector<ParabolicRamp::Vector>& x, ParabolicRamp::RampFeasibilityChecker& check){
+    bool SetMilestones(std::vector<ParabolicRamp::ParabolicRampND>& ramps, const vector<ParabolicRamp::Vector>& x, ParabolicRamp::RampFeasibilityChecker& check){
 
         ramps.clear();
         if(x.size()==1) {
@@ -612,7 +624,7 @@ public:
                 options = options & (~CFO_CheckEnvCollisions) & (~CFO_CheckSelfCollisions); // no collision checking
             }
             for(size_t i=0; i+1<x.size(); i++) {
-                std::list<ParabolicRamp::ParabolicRampND> tmpramps0, tmpramps1;
+                std::vector<ParabolicRamp::ParabolicRampND> tmpramps0, tmpramps1;
                 bool cansetmilestone = mergewaypoints::ComputeLinearRampsWithConstraints(tmpramps0,x[i],x[i+1],_parameters,check,options);
                 if( !cansetmilestone ) {
                     RAVELOG_INFO_FORMAT("linear ramp %d-%d (of %d) failed to pass constraints", i%(i+1)%x.size());
@@ -623,10 +635,10 @@ public:
                     if(_bCheckControllerTimeStep) {
                         bool canscale = mergewaypoints::ScaleRampsTime(tmpramps0,tmpramps1,ComputeStepSizeCeiling(tmpduration,_parameters->_fStepLength*2)/tmpduration,false,_parameters);
                         BOOST_ASSERT(canscale);
-                        ramps.splice(ramps.end(),tmpramps1);
+                        ramps.insert(ramps.end(),tmpramps1.begin(),tmpramps1.end());
                     }
                     else{
-                        ramps.splice(ramps.end(),tmpramps0);
+                        ramps.insert(ramps.end(),tmpramps0.begin(),tmpramps0.end());
                     }
                 }
             }
@@ -690,13 +702,13 @@ public:
 
 
     // Perform the shortcuts
-    int Shortcut(std::list<ParabolicRamp::ParabolicRampND>&ramps, int numIters, ParabolicRamp::RampFeasibilityChecker& check, ParabolicRamp::RandomNumberGeneratorBase* rng)
+    int Shortcut(std::vector<ParabolicRamp::ParabolicRampND>&ramps, int numIters, ParabolicRamp::RampFeasibilityChecker& check, ParabolicRamp::RandomNumberGeneratorBase* rng)
     {
         ParabolicRamp::Vector qstart = ramps.begin()->x0;
         ParabolicRamp::Vector qgoal = ramps.back().x1;
         int rejected = 0;
         int shortcuts = 0;
-        std::list<ParabolicRamp::ParabolicRampND> saveramps;
+        std::vector<ParabolicRamp::ParabolicRampND> saveramps;
         //std::map<int, std::list<int> > mapTestedTimeRanges; // (starttime, list of end times) pairs where the end times are always > than starttime
         std::vector<dReal> rampStartTime; rampStartTime.resize(ramps.size());
         std::list<std::pair<dReal,dReal> > attemptedlist;
@@ -707,8 +719,8 @@ public:
             durationbeforeshortcut += itramp->endTime;
         }
         ParabolicRamp::Vector x0,x1,dx0,dx1;
-        std::list<ParabolicRamp::ParabolicRampND> intermediate;
-        std::list<ParabolicRamp::ParabolicRampND>::iterator itramp1, itramp2;
+        std::vector<ParabolicRamp::ParabolicRampND> intermediate;
+        std::vector<ParabolicRamp::ParabolicRampND>::iterator itramp1, itramp2;
 
         dReal fStepLength = _parameters->_fStepLength;
         dReal shortcutinnovationthreshold = 0;
@@ -820,10 +832,10 @@ public:
 
             //replace intermediate ramps
             ++itramp1;
-            ramps.erase(itramp1, itramp2);
+            itramp2 = ramps.erase(itramp1, itramp2);
 
             mergewaypoints::BreakIntoUnitaryRamps(intermediate);
-            ramps.splice(itramp2, intermediate);
+            ramps.insert(itramp2, intermediate.begin(), intermediate.end());
 
             if( IS_DEBUGLEVEL(Level_Verbose) ) {
                 //check for consistency
@@ -843,13 +855,19 @@ public:
             }
             else{
                 // Merge waypoints
-                std::list<ParabolicRamp::ParabolicRampND> resramps;
+                std::vector<ParabolicRamp::ParabolicRampND> resramps;
                 dReal upperbound = (durationbeforeshortcut-fimprovetimethresh)/mergewaypoints::ComputeRampsDuration(ramps);
                 // Do not check collision during merge, check later
                 int options = 0xffff & (~CFO_CheckEnvCollisions) & (~CFO_CheckSelfCollisions);
 
 
-                bool resmerge = mergewaypoints::IterativeMergeRamps(ramps,resramps, _parameters, upperbound, _bCheckControllerTimeStep, _uniformsampler,check,options);
+                bool resmerge;
+                if( _vMergePlanners.size() > 1 ) {
+                    resmerge = mergewaypoints::IterativeMergeRampsParallel(ramps, resramps, _parameters, upperbound, _vMergePlanners.size(), boost::bind(&ConstraintParabolicSmoother::_EvaluateMergeCandidates,this,_1,_2,_3,_4,options), &_mergestatistics);
+                }
+                else {
+                    resmerge = mergewaypoints::IterativeMergeRamps(ramps,resramps, _parameters, upperbound, _bCheckControllerTimeStep, _uniformsampler,check,options,&_mergestatistics);
+                }
 
                 if(!resmerge) {
                     RAVELOG_VERBOSE("... Could not merge\n");
@@ -1025,7 +1043,12 @@ public:
         //_parameters->_setstatefn(a);
         if(_bmanipconstraints) {
             options = options | CFO_FillCheckedConfiguration;
-            _constraintreturn.reset(new ConstraintFilterReturn());
+            if( !_constraintreturn ) {
+                _constraintreturn.reset(new ConstraintFilterReturn());
+            }
+            else {
+                _constraintreturn->Clear(); // keeps the buffer capacity from the previous segment
+            }
         }
         int pathreturn = _parameters->CheckPathAllConstraints(a,b,da, db, timeelapsed, IT_OpenStart, options, _constraintreturn);
         if( pathreturn != 0 ) {
@@ -1085,6 +1108,96 @@ public:
         return _uniformsampler->SampleSequenceOneReal(IT_OpenEnd);
     }
 
+    void _InitFeasibilityChecker(ParabolicRamp::RampFeasibilityChecker& checker)
+    {
+        checker.tol = _parameters->_vConfigResolution;
+        FOREACH(it, checker.tol) {
+            *it *= _parameters->_pointtolerance;
+        }
+        checker.constraintsmask = CFO_CheckEnvCollisions|CFO_CheckSelfCollisions|CFO_CheckTimeBasedConstraints|CFO_CheckUserConstraints;
+    }
+
+    /// \brief evaluates one coefficient of the merge search on the environment of this planner, called by the snapshot planners
+    bool _EvaluateMergeCoefficient(const std::vector<ParabolicRamp::ParabolicRampND>& origramps, std::vector<ParabolicRamp::ParabolicRampND>& resramps, dReal coef, uint32_t seed, int options)
+    {
+        ParabolicRamp::RampFeasibilityChecker checker(this);
+        _InitFeasibilityChecker(checker);
+        _uniformsampler->SetSeed(seed);
+        return mergewaypoints::EvaluateMergeCoefficient(origramps, resramps, coef, _parameters, _bCheckControllerTimeStep, _uniformsampler, checker, options);
+    }
+
+    /// \brief mergewaypoints::MergeCandidatesFn evaluating every coefficient with its own snapshot planner
+    void _EvaluateMergeCandidates(const std::vector<ParabolicRamp::ParabolicRampND>& origramps, const std::vector<dReal>& vcoefs, std::vector<uint8_t>& vresults, std::vector< std::vector<ParabolicRamp::ParabolicRampND> >& vresramps, int options)
+    {
+        // the seeds are drawn here so that the merges do not depend on which thread evaluates which coefficient
+        _vMergeSeeds.resize(vcoefs.size());
+        FOREACH(itseed, _vMergeSeeds) {
+            *itseed = _uniformsampler->SampleSequenceOneUInt32();
+        }
+        _pMergeWorkers->Run(vcoefs.size(), boost::bind(&ConstraintParabolicSmoother::_EvaluateMergeCandidateRange,this,boost::cref(origramps),boost::cref(vcoefs),boost::ref(vresults),boost::ref(vresramps),options,_1,_2));
+    }
+
+    /// \brief evaluates vcoefs[start:end], called from the worker threads
+    void _EvaluateMergeCandidateRange(const std::vector<ParabolicRamp::ParabolicRampND>& origramps, const std::vector<dReal>& vcoefs, std::vector<uint8_t>& vresults, std::vector< std::vector<ParabolicRamp::ParabolicRampND> >& vresramps, int options, size_t start, size_t end)
+    {
+        for(size_t icandidate = start; icandidate < end; ++icandidate) {
+            boost::shared_ptr<ConstraintParabolicSmoother> planner = _vMergePlanners.at(icandidate);
+            EnvironmentMutex::scoped_lock lock(planner->GetEnv()->GetMutex());
+            vresults[icandidate] = planner->_EvaluateMergeCoefficient(origramps, vresramps[icandidate], vcoefs[icandidate], _vMergeSeeds[icandidate], options);
+        }
+    }
+
+    /// \brief sets up one planner per merge thread on an environment snapshot, see ConstraintTrajectoryTimingParameters::nshortcutthreads
+    ///
+    /// The snapshots are kept between calls so that only the bodies that changed need to be copied. The parameters of the snapshot planners
+    /// are rebuilt from the configuration specification, so custom constraint functions of the original parameters are not used when merging in parallel.
+    bool _InitMergePlanners()
+    {
+        _vMergePlanners.resize(0);
+        _vMergeParameters.resize(0);
+        int numthreads = _parameters->nshortcutthreads;
+        if( numthreads <= 1 ) {
+            _vMergeEnvs.resize(0);
+            _pMergeWorkers.reset();
+            return true;
+        }
+        _vMergeEnvs.resize(numthreads);
+        for(int ithread = 0; ithread < numthreads; ++ithread) {
+            if( !_vMergeEnvs[ithread] ) {
+                _vMergeEnvs[ithread] = GetEnv()->CloneSelf(Clone_Bodies);
+            }
+            else {
+                _vMergeEnvs[ithread]->Clone(GetEnv(), Clone_Bodies|Clone_SkipUnchangedBodies);
+            }
+            EnvironmentMutex::scoped_lock lockmerge(_vMergeEnvs[ithread]->GetMutex());
+            ConstraintTrajectoryTimingParametersPtr params(new ConstraintTrajectoryTimingParameters());
+            params->copy(_parameters);
+            params->SetConfigurationSpecification(_vMergeEnvs[ithread], _parameters->_configurationspecification);
+            // SetConfigurationSpecification resets the limits to the ones of the bodies
+            params->_vConfigLowerLimit = _parameters->_vConfigLowerLimit;
+            params->_vConfigUpperLimit = _parameters->_vConfigUpperLimit;
+            params->_vConfigVelocityLimit = _parameters->_vConfigVelocityLimit;
+            params->_vConfigAccelerationLimit = _parameters->_vConfigAccelerationLimit;
+            params->_vConfigResolution = _parameters->_vConfigResolution;
+            params->nshortcutthreads = 1;
+            boost::shared_ptr<ConstraintParabolicSmoother> planner = boost::dynamic_pointer_cast<ConstraintParabolicSmoother>(RaveCreatePlanner(_vMergeEnvs[ithread], GetXMLId()));
+            if( !planner ) {
+                RAVELOG_WARN_FORMAT("failed to create merge planner %s", GetXMLId());
+                return false;
+            }
+            if( !planner->InitPlan(RobotBasePtr(), params) ) {
+                RAVELOG_WARN_FORMAT("merge planner %d failed to initialize", ithread);
+                return false;
+            }
+            _vMergePlanners.push_back(planner);
+            _vMergeParameters.push_back(params); // the constraint functions of params only hold weak references to it
+        }
+        if( !_pMergeWorkers || _pMergeWorkers->GetNumThreads() != numthreads ) {
+            _pMergeWorkers.reset(new ParallelRangeWorkers(numthreads, "ConstraintParabolicSmootherMerge"));
+        }
+        return true;
+    }
+
 protected:
     ConstraintTrajectoryTimingParametersPtr _parameters;
     SpaceSamplerBasePtr _uniformsampler;
@@ -1101,6 +1214,13 @@ protected:
     bool _bmanipconstraints; /// if true, check workspace manip constraints
     PlannerProgress _progress;
 
+    std::vector<EnvironmentBasePtr> _vMergeEnvs; ///< environment snapshots of the merge planners, see ConstraintTrajectoryTimingParameters::nshortcutthreads
+    std::vector< boost::shared_ptr<ConstraintParabolicSmoother> > _vMergePlanners; ///< initialized planners evaluating the merge coefficients in parallel
+    std::vector<ConstraintTrajectoryTimingParametersPtr> _vMergeParameters; ///< the parameters _vMergePlanners were initialized with
+    std::vector<uint32_t> _vMergeSeeds; ///< seed of the sampler for every coefficient of the current batch
+    ParallelRangeWorkersPtr _pMergeWorkers; ///< threads running _vMergePlanners
+    mergewaypoints::MergeStatistics _mergestatistics; ///< reset in InitPlan
+
 private:
     std::vector<std::vector<ParabolicRamp::ParabolicRamp1D> > __tempramps1d;
 };
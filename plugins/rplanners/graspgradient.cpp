@@ -20,7 +20,7 @@ class GraspGradientPlanner : public PlannerBase
 public:
     struct GRASP
     {
-        GRASP() : fgoaldist(-1),bChecked(false), bProcessed(false) {
+        GRASP() : fgoaldist(-1),bChecked(false), bProcessed(false), index(-1) {
         }
 
         bool operator <(const GRASP& r) const {
@@ -31,9 +31,19 @@ public:
         vector<dReal> qgoal;     ///< ik solution that achieves tgrasp
         bool bChecked;     ///< set to true if grasp is checked for ik solution
         bool bProcessed;     ///< set to true if grasp has already been used in gradient descend
+        int index;     ///< index into GraspSetParameters::_vgrasps
     };
 
-    GraspGradientPlanner(EnvironmentBasePtr penv, std::istream& sinput) : PlannerBase(penv) {
+    /// \brief result of the end-effector collision and ik checks of one grasp of GraspSetParameters::_vgrasps
+    struct GraspCheckCache
+    {
+        GraspCheckCache() : bChecked(false) {
+        }
+        bool bChecked;
+        vector<dReal> qgoal;     ///< ik solution, empty if the grasp failed the checks
+    };
+
+    GraspGradientPlanner(EnvironmentBasePtr penv, std::istream& sinput) : PlannerBase(penv), _nCacheTargetStamp(0) {
         __description = ":Interface Author: Rosen Diankov\n\nGrasp Planning with Stochastic Gradient Descent";
         _report.reset(new CollisionReport());
     }
@@ -54,7 +64,7 @@ public:
             return false;
         }
 
-        if( !_parameters->_checkpathconstraintsfn(parameters->vinitialconfig,parameters->vinitialconfig,IT_OpenStart,ConfigurationListPtr()) ) {
+        if( !parameters->_checkpathconstraintsfn(parameters->vinitialconfig,parameters->vinitialconfig,IT_OpenStart,ConfigurationListPtr()) ) {
             RAVELOG_DEBUG("BirrtPlanner::InitPlan - Error: Initial configuration not in free space\n");
             return false;
         }
@@ -132,6 +142,7 @@ public:
         Transform tcurgrasp = _pmanip->GetTransform();
 
         Transform tobject = _parameters->_ptarget->GetTransform();
+        _UpdateGraspCache();
         vector<GRASP> vgrasps; vgrasps.reserve(_parameters->_vgrasps.size());
         for(size_t i = 0; i < _parameters->_vgrasps.size(); ++i) {
             Transform tgrasp = tobject * _parameters->_vgrasps[i];
@@ -141,6 +152,7 @@ public:
                 vgrasps.push_back(GRASP());
                 vgrasps.back().tgrasp = tgrasp;
                 vgrasps.back().fgraspdist = fgraspdist;
+                vgrasps.back().index = i;
             }
         }
 
@@ -203,6 +215,26 @@ public:
     }
 
 private:
+    /// \brief clears the grasp checks if the target, the robot base, or the grasps changed since they were cached
+    ///
+    /// The end-effector collision and ik checks of a grasp only depend on where the grasp is with respect to the robot base, so they are kept between planning calls as long as the target's KinBody::GetUpdateStamp does not change and the robot base does not move.
+    void _UpdateGraspCache()
+    {
+        Transform tbase = _robot->GetTransform();
+        bool bValid = _cachetarget == _parameters->_ptarget && _nCacheTargetStamp == _parameters->_ptarget->GetUpdateStamp() && _vCacheGrasps.size() == _parameters->_vgrasps.size() && TransformDistance2(tbase, _tCacheRobotBase) <= g_fEpsilonLinear;
+        for(size_t i = 0; i < _vCacheGrasps.size() && bValid; ++i) {
+            bValid = TransformDistance2(_vCacheGrasps[i], _parameters->_vgrasps[i]) <= g_fEpsilonLinear;
+        }
+        if( !bValid ) {
+            _cachetarget = _parameters->_ptarget;
+            _nCacheTargetStamp = _parameters->_ptarget->GetUpdateStamp();
+            _tCacheRobotBase = tbase;
+            _vCacheGrasps = _parameters->_vgrasps;
+            _vgraspcache.resize(0);
+            _vgraspcache.resize(_vCacheGrasps.size());
+        }
+    }
+
     bool StochasticGradientDescent(GraspGradientPlanner::GRASP& g, dReal fGoalThresh, list<vector<dReal> >& listpath)
     {
         vector<dReal> qbest, q(_robot->GetActiveDOF()),qgoaldir;
@@ -217,8 +249,17 @@ private:
             if( g.fgoaldist < 0 )
                 return false;
         }
+        else if( _vgraspcache.at(g.index).bChecked ) {
+            g.bChecked = true;
+            if( _vgraspcache[g.index].qgoal.size() == 0 ) {
+                return false;
+            }
+            g.qgoal = _vgraspcache[g.index].qgoal;
+            g.fgoaldist = _parameters->_distmetricfn(g.qgoal,_parameters->vinitialconfig);
+        }
         else {
             g.bChecked = true;
+            _vgraspcache[g.index].bChecked = true;
 
             if( _pmanip->CheckEndEffectorCollision(g.tgrasp, _report) ) {
                 RAVELOG_DEBUG("gripper collision: (%s:%s)x(%s:%s).\n",
@@ -258,6 +299,7 @@ private:
                 BOOST_ASSERT(g.qgoal.size()>0);
             }
 
+            _vgraspcache[g.index].qgoal = g.qgoal;
             g.fgoaldist = _parameters->_distmetricfn(g.qgoal,_parameters->vinitialconfig);
         }
 
@@ -298,10 +340,10 @@ private:
                     _parameters->_sampleneighfn(q,listpath.back(),fRadius);
                 }
 
-                if( _parameters->_checkpathconstraintsfn(listpath.back(),q,IT_OpenStart,ConfigurationListPtr()) ) {
-                    // if new sample is closer than the best, accept it
-                    dReal dist = _parameters->_distmetricfn(q,g.qgoal);
-                    if(( qbest.size() == 0) ||( dist < bestdist) ) {
+                // if new sample is closer than the best, accept it. check the distance first since it is much cheaper than the path constraints
+                dReal dist = _parameters->_distmetricfn(q,g.qgoal);
+                if(( qbest.size() == 0) ||( dist < bestdist) ) {
+                    if( _parameters->_checkpathconstraintsfn(listpath.back(),q,IT_OpenStart,ConfigurationListPtr()) ) {
                         RAVELOG_DEBUG("dist: %f\n",dist);
                         qbest = q;
                         bestdist = dist;
@@ -331,6 +373,12 @@ private:
 
     std::vector<dReal>         _randomConfig;
     std::vector<std::vector<dReal> > _viksolutions;
+
+    std::vector<GraspCheckCache> _vgraspcache;     ///< indexed like _vCacheGrasps, see _UpdateGraspCache
+    KinBodyPtr _cachetarget;
+    int _nCacheTargetStamp;
+    Transform _tCacheRobotBase;
+    std::vector<Transform> _vCacheGrasps;
 };
 
 PlannerBasePtr CreateGraspGradientPlanner(EnvironmentBasePtr penv, std::istream& sinput) {
@@ -0,0 +1,449 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2014 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "trajectoryretimer.h"
+#include <openrave/planningutils.h>
+#include <openrave/mathextra.h>
+#include <boost/thread/tss.hpp>
+
+namespace rplanners {
+
+/**
+   Every segment is a quintic with zero acceleration at both waypoints, so the acceleration is continuous across waypoints and the jerk stays bounded.
+
+   t,dt,v0,v1,px = symbols('t,dt,v0,v1,px')
+
+   c5 = (6*px - 3*(v0+v1)*dt)/(dt**5)
+   c4 = (-15*px + (8*v0+7*v1)*dt)/(dt**4)
+   c3 = (10*px - (6*v0+4*v1)*dt)/(dt**3)
+   c2 = 0
+   c1 = v0
+   p = c5*t**5 + c4*t**4 + c3*t**3 + c1*t + p0
+
+   When v0 = v1 = 0, the peak velocity is 15/8*px/dt, the peak acceleration is 10/sqrt(3)*px/dt**2 and the peak jerk is 60*px/dt**3,
+   so the minimum time of a segment is the maximum of the three closed-form times over all the DOFs.
+ */
+class JerkLimitedTrajectoryRetimer : public TrajectoryRetimer
+{
+public:
+    class JerkLimitedGroupInfo : public GroupInfo
+    {
+public:
+        JerkLimitedGroupInfo(int degree, const ConfigurationSpecification::Group& gpos, const ConfigurationSpecification::Group &gvel) : GroupInfo(degree, gpos, gvel) {
+        }
+    };
+    typedef boost::shared_ptr<JerkLimitedGroupInfo> JerkLimitedGroupInfoPtr;
+    typedef boost::shared_ptr<JerkLimitedGroupInfo const> JerkLimitedGroupInfoConstPtr;
+
+    JerkLimitedTrajectoryRetimer(EnvironmentBasePtr penv, std::istream& sinput) : TrajectoryRetimer(penv,sinput)
+    {
+        __description = ":Interface Author: Rosen Diankov\n\nJerk-limited quintic trajectory re-timing while passing through all the waypoints, waypoints will not be modified. The accelerations at the waypoints are 0 and the velocities are 0 unless they are given. The jerk limits are set with ConstraintTrajectoryTimingParameters::_vConfigJerkLimit, if they are not set only the velocity and acceleration limits are used.";
+    }
+
+protected:
+    /// \brief the per-DOF values of one segment stored as contiguous arrays, so that the kernels run over all the DOFs in flat loops
+    struct SegmentCache
+    {
+        std::vector<dReal> vpx, vv0, vv1, vc3, vc4, vc5;
+    };
+
+    GroupInfoPtr CreateGroupInfo(int degree, const ConfigurationSpecification& spec, const ConfigurationSpecification::Group& gpos, const ConfigurationSpecification::Group &gvel) {
+        return JerkLimitedGroupInfoPtr(new JerkLimitedGroupInfo(degree, gpos, gvel));
+    }
+
+    void ResetCachedGroupInfo(GroupInfoPtr g)
+    {
+    }
+
+    bool _SupportInterpolation() {
+        if( _parameters->_interpolation.size() == 0 ) {
+            _parameters->_interpolation = "quintic";
+            return true;
+        }
+        else {
+            return _parameters->_interpolation == "quintic";
+        }
+    }
+
+    bool _IsMinimumTimeParallelizable() {
+        FOREACHC(itgroup, _listgroupinfo) {
+            if( (*itgroup)->grouptype != GT_JointValues ) {
+                return false;
+            }
+            if( !_parameters->_hasvelocities && (*itgroup)->orgveloffset >= 0 ) {
+                // the start velocity of a segment is only copied once the previous segment is timed
+                return false;
+            }
+        }
+        return true;
+    }
+
+    SegmentCache& _GetSegmentCache(int dof)
+    {
+        // called concurrently on different segments when _IsMinimumTimeParallelizable, so use the buffers of the calling thread
+        SegmentCache* pcache = _segmentcache.get();
+        if( !pcache ) {
+            pcache = new SegmentCache();
+            _segmentcache.reset(pcache);
+        }
+        pcache->vpx.resize(dof);
+        pcache->vv0.resize(dof);
+        pcache->vv1.resize(dof);
+        pcache->vc3.resize(dof);
+        pcache->vc4.resize(dof);
+        pcache->vc5.resize(dof);
+        return *pcache;
+    }
+
+    /// \brief the minimum time of a segment that starts and ends at rest, exact for the quintic profile
+    ///
+    /// \param maxjerk the jerk limits, can be NULL if jerk is not limited
+    static dReal _ComputeRestToRestTime(int dof, const dReal* px, const dReal* maxvel, const dReal* maxaccel, const dReal* maxjerk)
+    {
+        const dReal fvelcoeff = 1.875, faccelcoeff = 5.773502691896258, fjerkcoeff = 60;
+        dReal fmaxvel = 0, fmaxaccel = 0, fmaxjerk = 0;
+        // kept as independent reductions without branches or library calls so that the compiler can vectorize them
+        for(int i = 0; i < dof; ++i) {
+            dReal fabsx = std::fabs(px[i]);
+            dReal fvel = fabsx/maxvel[i], faccel = fabsx/maxaccel[i];
+            fmaxvel = fvel > fmaxvel ? fvel : fmaxvel;
+            fmaxaccel = faccel > fmaxaccel ? faccel : fmaxaccel;
+        }
+        if( !!maxjerk ) {
+            for(int i = 0; i < dof; ++i) {
+                dReal fjerk = std::fabs(px[i])/maxjerk[i];
+                fmaxjerk = fjerk > fmaxjerk ? fjerk : fmaxjerk;
+            }
+        }
+        dReal mintime = max(fvelcoeff*fmaxvel, std::sqrt(faccelcoeff*fmaxaccel));
+        if( fmaxjerk > 0 ) {
+            mintime = max(mintime, std::pow(fjerkcoeff*fmaxjerk, (dReal)1/(dReal)3));
+        }
+        return mintime;
+    }
+
+    /// \brief computes the quintic coefficients of all the DOFs of a segment
+    static void _ComputeCoefficients(int dof, dReal deltatime, SegmentCache& cache)
+    {
+        dReal ideltatime = 1/deltatime;
+        dReal ideltatime2 = ideltatime*ideltatime;
+        dReal ideltatime3 = ideltatime2*ideltatime;
+        const dReal* px = &cache.vpx[0], *v0 = &cache.vv0[0], *v1 = &cache.vv1[0];
+        dReal* c3 = &cache.vc3[0], *c4 = &cache.vc4[0], *c5 = &cache.vc5[0];
+        for(int i = 0; i < dof; ++i) {
+            dReal pxi = px[i]*ideltatime;
+            c5[i] = (6*pxi - 3*(v0[i] + v1[i]))*ideltatime2*ideltatime2;
+            c4[i] = (-15*pxi + 8*v0[i] + 7*v1[i])*ideltatime3;
+            c3[i] = (10*pxi - 6*v0[i] - 4*v1[i])*ideltatime2;
+        }
+    }
+
+    /// \brief checks the limits of a quintic segment of all the DOFs given the coefficients in the cache
+    ///
+    /// \param p0 the start positions, only used when checking positions
+    /// \param checkoptions If 1 checks positions. If 2, checks velocities, If 4, checks accelerations, If 8, checks jerks
+    bool _CheckQuinticSegment(JerkLimitedGroupInfoConstPtr info, const SegmentCache& cache, std::vector<dReal>::const_iterator p0, dReal deltatime, int checkoptions)
+    {
+        int dof = info->gpos.dof;
+        const dReal* c3 = &cache.vc3[0], *c4 = &cache.vc4[0], *c5 = &cache.vc5[0], *v0 = &cache.vv0[0], *v1 = &cache.vv1[0];
+        for(int i = 0; i < dof; ++i) {
+            dReal roots[4];
+            if( checkoptions & 8 ) {
+                if( (int)info->_vConfigJerkLimit.size() == dof ) {
+                    dReal fjerklimit = info->_vConfigJerkLimit[i] + g_fEpsilonJointLimit;
+                    // jerk = 6*c3 + 24*c4*t + 60*c5*t**2, peaks at the ends and at its vertex
+                    dReal fjerk0 = 6*c3[i], fjerk1 = 6*c3[i] + deltatime*(24*c4[i] + deltatime*60*c5[i]);
+                    if( RaveFabs(fjerk0) > fjerklimit || RaveFabs(fjerk1) > fjerklimit ) {
+                        RAVELOG_VERBOSE_FORMAT("jerk constraints dof=%d, abs(%e) or abs(%e) > %e (limit)", i%fjerk0%fjerk1%info->_vConfigJerkLimit[i]);
+                        return false;
+                    }
+                    if( RaveFabs(c5[i]) > 0 ) {
+                        dReal t = -c4[i]/(5*c5[i]);
+                        if( t > 0 && t < deltatime ) {
+                            dReal fjerk = 6*c3[i] + t*(24*c4[i] + t*60*c5[i]);
+                            if( RaveFabs(fjerk) > fjerklimit ) {
+                                RAVELOG_VERBOSE_FORMAT("jerk constraints dof=%d, abs(%e) > %e (limit)", i%fjerk%info->_vConfigJerkLimit[i]);
+                                return false;
+                            }
+                        }
+                    }
+                }
+            }
+            if( checkoptions & 4 ) {
+                // accel = t*(6*c3 + 12*c4*t + 20*c5*t**2) is 0 at both ends, so peaks where the jerk is 0
+                int nroots = mathextra::solvequad(60*c5[i], 24*c4[i], 6*c3[i], roots[0], roots[1]);
+                for(int iroot = 0; iroot < nroots; ++iroot) {
+                    dReal t = roots[iroot];
+                    if( t > 0 && t < deltatime ) {
+                        dReal faccel = t*(6*c3[i] + t*(12*c4[i] + t*20*c5[i]));
+                        if( RaveFabs(faccel) > info->_vConfigAccelerationLimit[i]+g_fEpsilonJointLimit ) {
+                            RAVELOG_VERBOSE_FORMAT("acceleration constraints dof=%d, abs(%e) > %e (limit)", i%faccel%info->_vConfigAccelerationLimit[i]);
+                            return false;
+                        }
+                    }
+                }
+            }
+            if( checkoptions & 2 ) {
+                dReal fvellimit = info->_vConfigVelocityLimit[i]+g_fEpsilonJointLimit;
+                if( RaveFabs(v0[i]) > fvellimit || RaveFabs(v1[i]) > fvellimit ) {
+                    RAVELOG_VERBOSE_FORMAT("velocity constraints dof=%d, abs(%e) or abs(%e) > %e (limit)", i%v0[i]%v1[i]%info->_vConfigVelocityLimit[i]);
+                    return false;
+                }
+                // vel peaks where accel = 0
+                int nroots = mathextra::solvequad(20*c5[i], 12*c4[i], 6*c3[i], roots[0], roots[1]);
+                for(int iroot = 0; iroot < nroots; ++iroot) {
+                    dReal t = roots[iroot];
+                    if( t > 0 && t < deltatime ) {
+                        dReal fvel = v0[i] + t*t*(3*c3[i] + t*(4*c4[i] + t*5*c5[i]));
+                        if( RaveFabs(fvel) > fvellimit ) {
+                            RAVELOG_VERBOSE_FORMAT("velocity constraints dof=%d, abs(%e) > %e (limit)", i%fvel%info->_vConfigVelocityLimit[i]);
+                            return false;
+                        }
+                    }
+                }
+            }
+            if( (checkoptions & 1) && (RaveFabs(v0[i]) > 0 || RaveFabs(v1[i]) > 0) ) {
+                // starting and ending at rest the segment is monotonic, otherwise it can overshoot where vel = 0
+                int nroots = _SolveVelocityRoots(v0[i], c3[i], c4[i], c5[i], roots);
+                for(int iroot = 0; iroot < nroots; ++iroot) {
+                    dReal t = roots[iroot];
+                    if( t > 0 && t < deltatime ) {
+                        dReal pos = *(p0+i) + t*(v0[i] + t*t*(c3[i] + t*(c4[i] + t*c5[i])));
+                        if( pos < info->_vConfigLowerLimit[i]-g_fEpsilonJointLimit || pos > info->_vConfigUpperLimit[i]+g_fEpsilonJointLimit ) {
+                            RAVELOG_VERBOSE_FORMAT("pos constraints dof=%d, %e (limit) < %e < %e (limit)", i%info->_vConfigLowerLimit[i]%pos%info->_vConfigUpperLimit[i]);
+                            return false;
+                        }
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    /// \brief real roots of 5*c5*t**4 + 4*c4*t**3 + 3*c3*t**2 + v0
+    static int _SolveVelocityRoots(dReal v0, dReal c3, dReal c4, dReal c5, dReal* roots)
+    {
+        int nroots = 0;
+        if( RaveFabs(c5) > g_fEpsilon ) {
+            dReal coeffs[5] = { 5*c5, 4*c4, 3*c3, 0, v0};
+            mathextra::polyroots<dReal,4>(coeffs, roots, nroots);
+        }
+        else if( RaveFabs(c4) > g_fEpsilon ) {
+            dReal coeffs[4] = { 4*c4, 3*c3, 0, v0};
+            mathextra::polyroots<dReal,3>(coeffs, roots, nroots);
+        }
+        else {
+            nroots = mathextra::solvequad(3*c3, (dReal)0, v0, roots[0], roots[1]);
+        }
+        return nroots;
+    }
+
+    dReal _ComputeMinimumTimeJointValues(GroupInfoConstPtr inforaw, std::vector<dReal>::const_iterator itorgdiff, std::vector<dReal>::const_iterator itdataprev, std::vector<dReal>::const_iterator itdata, bool bUseEndVelocity) {
+        JerkLimitedGroupInfoConstPtr info = boost::dynamic_pointer_cast<JerkLimitedGroupInfo const>(inforaw);
+        int dof = info->gpos.dof;
+        SegmentCache& cache = _GetSegmentCache(dof);
+        for(int i = 0; i < dof; ++i) {
+            cache.vpx[i] = *(itorgdiff+info->orgposoffset+i);
+            cache.vv0[i] = *(itdataprev+info->gvel.offset+i);
+        }
+        // the end velocity is the one that _ComputeVelocitiesJointValues writes afterwards
+        if( bUseEndVelocity || _parameters->_hasvelocities ) {
+            for(int i = 0; i < dof; ++i) {
+                cache.vv1[i] = *(itdata+info->gvel.offset+i);
+            }
+        }
+        else if( info->orgveloffset >= 0 ) {
+            for(int i = 0; i < dof; ++i) {
+                cache.vv1[i] = *(itorgdiff+info->orgveloffset+i);
+            }
+        }
+        else {
+            std::fill(cache.vv1.begin(), cache.vv1.end(), 0);
+        }
+
+        bool bAtRest = true;
+        for(int i = 0; i < dof; ++i) {
+            if( cache.vv0[i] != 0 || cache.vv1[i] != 0 ) {
+                bAtRest = false;
+                break;
+            }
+        }
+        const dReal* pmaxjerk = (int)info->_vConfigJerkLimit.size() == dof ? &info->_vConfigJerkLimit[0] : NULL;
+        if( bAtRest ) {
+            return _ComputeRestToRestTime(dof, &cache.vpx[0], &info->_vConfigVelocityLimit[0], &info->_vConfigAccelerationLimit[0], pmaxjerk);
+        }
+
+        // with velocities at the ends the profile is not monotonic anymore, so start from the bounds that hold for any profile and search
+        dReal mintime = g_fEpsilonLinear;
+        for(int i = 0; i < dof; ++i) {
+            mintime = max(mintime, std::fabs(cache.vpx[i])/info->_vConfigVelocityLimit[i]);
+            mintime = max(mintime, std::fabs(cache.vv1[i]-cache.vv0[i])/info->_vConfigAccelerationLimit[i]);
+        }
+        for(int itry = 0; itry < 300; ++itry) {
+            _ComputeCoefficients(dof, mintime, cache);
+            if( _CheckQuinticSegment(info, cache, itdataprev+info->gpos.offset, mintime, 0xf) ) {
+                return mintime;
+            }
+            mintime *= 1.05;
+        }
+        return -1;
+    }
+
+    void _ComputeVelocitiesJointValues(GroupInfoConstPtr info, std::vector<dReal>::const_iterator itorgdiff, std::vector<dReal>::const_iterator itdataprev, std::vector<dReal>::iterator itdata) {
+        if( info->orgveloffset >= 0 ) {
+            for(int i=0; i < info->gvel.dof; ++i) {
+                *(itdata+info->gvel.offset+i) = *(itorgdiff+info->orgveloffset+i);
+            }
+        }
+        else {
+            for(int i=0; i < info->gvel.dof; ++i) {
+                *(itdata+info->gvel.offset+i) = 0;
+            }
+        }
+    }
+
+    bool _CheckJointValues(GroupInfoConstPtr inforaw, std::vector<dReal>::const_iterator itdataprev, std::vector<dReal>::iterator itdata, int checkoptions=0xffffffff) {
+        JerkLimitedGroupInfoConstPtr info = boost::dynamic_pointer_cast<JerkLimitedGroupInfo const>(inforaw);
+        dReal deltatime = *(itdata+_timeoffset);
+        if( deltatime <= g_fEpsilon ) {
+            return true;
+        }
+        int dof = info->gpos.dof;
+        SegmentCache& cache = _GetSegmentCache(dof);
+        for(int i = 0; i < dof; ++i) {
+            cache.vpx[i] = *(itdata+info->gpos.offset+i) - *(itdataprev+info->gpos.offset+i);
+            cache.vv0[i] = *(itdataprev+info->gvel.offset+i);
+            cache.vv1[i] = *(itdata+info->gvel.offset+i);
+        }
+        _ComputeCoefficients(dof, deltatime, cache);
+        // jerk is always checked along with the accelerations
+        return _CheckQuinticSegment(info, cache, itdataprev+info->gpos.offset, deltatime, (checkoptions&7)|((checkoptions&4) ? 8 : 0));
+    }
+
+    bool _WriteJointValues(GroupInfoConstPtr inforaw, std::vector<dReal>::const_iterator itorgdiff, std::vector<dReal>::const_iterator itdataprev, std::vector<dReal>::iterator itdata) {
+        // the accelerations at the waypoints stay 0
+        return true;
+    }
+
+    dReal _ComputeMinimumTimeAffine(GroupInfoConstPtr info, int affinedofs, std::vector<dReal>::const_iterator itorgdiff, std::vector<dReal>::const_iterator itdataprev, std::vector<dReal>::const_iterator itdata, bool bUseEndVelocity) {
+        throw OPENRAVE_EXCEPTION_FORMAT0(_("_ComputeMinimumTimeAffine not implemented"), ORE_NotImplemented);
+    }
+
+    void _ComputeVelocitiesAffine(GroupInfoConstPtr info, int affinedofs, std::vector<dReal>::const_iterator itorgdiff, std::vector<dReal>::const_iterator itdataprev, std::vector<dReal>::iterator itdata) {
+        throw OPENRAVE_EXCEPTION_FORMAT0(_("_ComputeVelocitiesAffine not implemented"), ORE_NotImplemented);
+    }
+
+    dReal _ComputeMinimumTimeIk(GroupInfoConstPtr info, IkParameterizationType iktype, std::vector<dReal>::const_iterator itorgdiff, std::vector<dReal>::const_iterator itdataprev, std::vector<dReal>::const_iterator itdata, bool bUseEndVelocity) {
+        throw OPENRAVE_EXCEPTION_FORMAT0(_("_ComputeMinimumTimeIk not implemented"), ORE_NotImplemented);
+    }
+
+    void _ComputeVelocitiesIk(GroupInfoConstPtr info, IkParameterizationType iktype, std::vector<dReal>::const_iterator itorgdiff, std::vector<dReal>::const_iterator itdataprev, std::vector<dReal>::iterator itdata) {
+        throw OPENRAVE_EXCEPTION_FORMAT0(_("_ComputeVelocitiesIk not implemented"), ORE_NotImplemented);
+    }
+
+    /// \brief writes the trajectory with jerk groups so that the velocities, accelerations and jerks sample exactly
+    ///
+    /// The jerk is discontinuous at the waypoints. A waypoint whose incoming and outgoing jerks differ is written twice with a delta time
+    /// of 0 between the copies, the first copy ends the previous segment and the second starts the next one.
+    void _WriteTrajectory(TrajectoryBasePtr ptraj, const ConfigurationSpecification& newspec, const std::vector<dReal>& data)
+    {
+        ConfigurationSpecification jerkspec = newspec;
+        jerkspec.AddDerivativeGroups(3,false);
+        int dof = newspec.GetDOF(), jerkdof = jerkspec.GetDOF();
+        size_t numpoints = data.size()/dof;
+        _vjerkdata.resize(numpoints*jerkdof);
+        std::fill(_vjerkdata.begin(), _vjerkdata.end(), 0);
+        ConfigurationSpecification::ConvertData(_vjerkdata.begin(), jerkspec, data.begin(), newspec, numpoints, GetEnv());
+        // _vjerkdata holds the outgoing jerks, _vjerkin the incoming ones
+        _vjerkin = _vjerkdata;
+        int timeoffset = jerkspec.GetGroupFromName("deltatime").offset;
+        std::vector<int> vjerkoffsets; // pairs of (offset, dof) of the jerk groups
+        FOREACHC(itgroup, _listgroupinfo) {
+            std::vector<ConfigurationSpecification::Group>::const_iterator itpos = jerkspec.FindCompatibleGroup((*itgroup)->gpos, true);
+            if( itpos == jerkspec._vgroups.end() ) {
+                continue;
+            }
+            std::vector<ConfigurationSpecification::Group>::const_iterator itvel = jerkspec.FindTimeDerivativeGroup(*itpos);
+            if( itvel == jerkspec._vgroups.end() ) {
+                continue;
+            }
+            std::vector<ConfigurationSpecification::Group>::const_iterator itaccel = jerkspec.FindTimeDerivativeGroup(*itvel);
+            if( itaccel == jerkspec._vgroups.end() ) {
+                continue;
+            }
+            std::vector<ConfigurationSpecification::Group>::const_iterator itjerk = jerkspec.FindTimeDerivativeGroup(*itaccel);
+            if( itjerk == jerkspec._vgroups.end() ) {
+                continue;
+            }
+            vjerkoffsets.push_back(itjerk->offset);
+            vjerkoffsets.push_back(itjerk->dof);
+            for(size_t ipoint = 0; ipoint+1 < numpoints; ++ipoint) {
+                std::vector<dReal>::iterator itdata0 = _vjerkdata.begin()+ipoint*jerkdof, itdata1 = itdata0+jerkdof;
+                dReal deltatime = *(itdata1+timeoffset);
+                if( deltatime <= g_fEpsilon ) {
+                    continue;
+                }
+                dReal ideltatime = 1/deltatime;
+                for(int i = 0; i < itpos->dof; ++i) {
+                    dReal px = (*(itdata1+itpos->offset+i) - *(itdata0+itpos->offset+i))*ideltatime;
+                    dReal v0 = *(itdata0+itvel->offset+i), v1 = *(itdata1+itvel->offset+i);
+                    dReal c5 = (6*px - 3*(v0 + v1))*ideltatime*ideltatime*ideltatime*ideltatime;
+                    dReal c4 = (-15*px + 8*v0 + 7*v1)*ideltatime*ideltatime*ideltatime;
+                    dReal c3 = (10*px - 6*v0 - 4*v1)*ideltatime*ideltatime;
+                    *(itdata0+itjerk->offset+i) = 6*c3;
+                    _vjerkin.at((ipoint+1)*jerkdof+itjerk->offset+i) = 6*c3 + deltatime*(24*c4 + deltatime*60*c5);
+                }
+            }
+        }
+
+        _vjerkwritedata.resize(0);
+        _vjerkwritedata.reserve(_vjerkdata.size());
+        for(size_t ipoint = 0; ipoint < numpoints; ++ipoint) {
+            std::vector<dReal>::const_iterator itout = _vjerkdata.begin()+ipoint*jerkdof, itin = _vjerkin.begin()+ipoint*jerkdof;
+            bool bDuplicate = false;
+            if( ipoint > 0 && ipoint+1 < numpoints ) {
+                for(size_t igroup = 0; igroup < vjerkoffsets.size() && !bDuplicate; igroup += 2) {
+                    for(int i = 0; i < vjerkoffsets[igroup+1]; ++i) {
+                        if( RaveFabs(*(itout+vjerkoffsets[igroup]+i) - *(itin+vjerkoffsets[igroup]+i)) > g_fEpsilonLinear ) {
+                            bDuplicate = true;
+                            break;
+                        }
+                    }
+                }
+            }
+            if( bDuplicate || ipoint+1 == numpoints ) {
+                // arrival with the incoming jerk
+                _vjerkwritedata.insert(_vjerkwritedata.end(), itin, itin+jerkdof);
+            }
+            if( ipoint+1 < numpoints ) {
+                _vjerkwritedata.insert(_vjerkwritedata.end(), itout, itout+jerkdof);
+                if( bDuplicate ) {
+                    *(_vjerkwritedata.end()-jerkdof+timeoffset) = 0;
+                }
+            }
+        }
+        ptraj->Init(jerkspec);
+        ptraj->Insert(0,_vjerkwritedata);
+    }
+
+    boost::thread_specific_ptr<SegmentCache> _segmentcache;
+    std::vector<dReal> _vjerkdata, _vjerkin, _vjerkwritedata;
+};
+
+PlannerBasePtr CreateJerkLimitedTrajectoryRetimer(EnvironmentBasePtr penv, std::istream& sinput) {
+    return PlannerBasePtr(new JerkLimitedTrajectoryRetimer(penv, sinput));
+}
+
+} // end namespace rplanners
@@ -42,6 +42,11 @@ protected:
         return TrajectoryRetimer::_InitPlan();
     }
 
+    virtual bool _IsMinimumTimeParallelizable() {
+        // the minimum times only depend on the position differences
+        return true;
+    }
+
     dReal _ComputeMinimumTimeJointValues(GroupInfoConstPtr info, std::vector<dReal>::const_iterator itorgdiff, std::vector<dReal>::const_iterator itdataprev, std::vector<dReal>::const_iterator itdata, bool bUseEndVelocity)
     {
         dReal bestmintime = 0;
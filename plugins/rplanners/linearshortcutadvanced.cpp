@@ -14,14 +14,32 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "openraveplugindefs.h"
+#include "parallelrangeworkers.h"
 
 class ShortcutLinearPlanner : public PlannerBase
 {
+    typedef list< std::pair< vector<dReal>, dReal> > PathList;
+
+    /// \brief a shortcut between two nodes of the path that is checked by one of the environment snapshots
+    struct ShortcutCandidate
+    {
+        PathList::iterator itstartnode, itendnode;
+        uint32_t startIndex, endIndex;
+        dReal totaldistance; ///< the distance of the path between the nodes
+        dReal newtotaldistance; ///< the distance of the shortcut, only valid if bFeasible
+        bool bFeasible;
+        std::vector<dReal> vconfigurations; ///< the checked configurations of the shortcut
+        std::vector<dReal> vdists; ///< the distances between the start node, vconfigurations, and the end node
+    };
+
 public:
     ShortcutLinearPlanner(EnvironmentBasePtr penv, std::istream& sinput) : PlannerBase(penv)
     {
         __description = ":Interface Author: Rosen Diankov\n\npath optimizer using linear shortcuts.";
+        RegisterCommand("SetNumThreads",boost::bind(&ShortcutLinearPlanner::SetNumThreadsCommand,this,_1,_2),
+                        "numthreads - every iteration checks numthreads disjoint shortcuts in parallel on environment snapshots. The shortcuts are sampled and applied in the same order, so the result only depends on the seed and numthreads. Default is 1.");
         _linearretimer = RaveCreatePlanner(GetEnv(), "LinearTrajectoryRetimer");
+        _nNumThreads = 1;
     }
     virtual ~ShortcutLinearPlanner() {
     }
@@ -64,6 +82,17 @@ public:
         return _parameters;
     }
 
+    bool SetNumThreadsCommand(std::ostream& sout, std::istream& sinput)
+    {
+        int numthreads = 1;
+        sinput >> numthreads;
+        if( !sinput || numthreads < 1 ) {
+            return false;
+        }
+        _nNumThreads = numthreads;
+        return true;
+    }
+
     virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj)
     {
         BOOST_ASSERT(!!_parameters && !!ptraj );
@@ -80,9 +109,13 @@ public:
         PlannerParametersConstPtr parameters = GetParameters();
 
         // subsample trajectory and add to list
-        list< std::pair< vector<dReal>, dReal> > listpath;
+        PathList listpath;
         _SubsampleTrajectory(ptraj,listpath);
 
+        if( !_InitShortcutPlanners() ) {
+            RAVELOG_WARN_FORMAT("env=%d, failed to set up %d shortcut threads, so shortcutting in this thread", GetEnv()->GetId()%_nNumThreads);
+            _vShortcutPlanners.resize(0);
+        }
         _OptimizePath(listpath);
 
         ptraj->Init(parameters->_configurationspecification);
@@ -102,97 +135,115 @@ public:
     }
 
 protected:
-    void _OptimizePath(list< std::pair< vector<dReal>, dReal> >& listpath)
+    void _OptimizePath(PathList& listpath)
     {
         PlannerParametersConstPtr parameters = GetParameters();
-        list< std::pair< vector<dReal>, dReal> >::iterator itstartnode, itendnode;
-        if( !_filterreturn ) {
-            _filterreturn.reset(new ConstraintFilterReturn());
-        }
+        PathList::iterator itstartnode, itendnode;
+
+        // every round samples one candidate for this planner, or one disjoint candidate per snapshot
+        bool bParallel = _vShortcutPlanners.size() > 0;
+        size_t numcandidates = bParallel ? _vShortcutPlanners.size() : 1;
+        _vShortcutCandidates.resize(numcandidates);
 
         int dof = parameters->GetDOF();
         int nrejected = 0;
         int iiter = parameters->_nMaxIterations;
-        std::vector<dReal> vnewconfig0(dof), vnewconfig1(dof);
+        std::vector<dReal> vnewconfig1(dof);
         while(iiter > 0  && nrejected < (int)listpath.size()+4 && listpath.size() > 2 ) {
-            --iiter;
-
-            // pick a random node on the listpath, and a random jump ahead
-            uint32_t endIndex = 2+(_puniformsampler->SampleSequenceOneUInt32()%((uint32_t)listpath.size()-2));
-            uint32_t startIndex = _puniformsampler->SampleSequenceOneUInt32()%(endIndex-1);
-
-            itstartnode = listpath.begin();
-            advance(itstartnode, startIndex);
-            itendnode = itstartnode;
-            dReal totaldistance = 0;
-            for(uint32_t j = 0; j < endIndex-startIndex; ++j) {
-                ++itendnode;
-                totaldistance += itendnode->second;
-            }
-            nrejected++;
+            // sample all the candidates in this thread so that the result does not depend on the thread timing
+            size_t nvalid = 0;
+            for(size_t icandidate = 0; icandidate < numcandidates && iiter > 0; ++icandidate) {
+                --iiter;
 
-            dReal expectedtotaldistance = parameters->_distmetricfn(itstartnode->first, itendnode->first);
-            if( expectedtotaldistance > totaldistance-0.1*parameters->_fStepLength ) {
-                // expected total distance is not that great
-                continue;
-            }
+                // pick a random node on the listpath, and a random jump ahead
+                uint32_t endIndex = 2+(_puniformsampler->SampleSequenceOneUInt32()%((uint32_t)listpath.size()-2));
+                uint32_t startIndex = _puniformsampler->SampleSequenceOneUInt32()%(endIndex-1);
+                nrejected++;
 
-            // check if the nodes can be connected by a straight line
-            _filterreturn->Clear();
-            if (parameters->CheckPathAllConstraints(itstartnode->first, itendnode->first, std::vector<dReal>(), std::vector<dReal>(), 0, IT_Open, 0xffff|CFO_FillCheckedConfiguration, _filterreturn) != 0 ) {
-                if( nrejected++ > (int)listpath.size()+8 ) {
-                    break;
+                // the candidates of one round can share their end nodes, but not the nodes they remove
+                bool boverlaps = false;
+                for(size_t iprev = 0; iprev < nvalid; ++iprev) {
+                    if( startIndex < _vShortcutCandidates[iprev].endIndex && _vShortcutCandidates[iprev].startIndex < endIndex ) {
+                        boverlaps = true;
+                        break;
+                    }
                 }
-                continue;
+                if( boverlaps ) {
+                    continue;
+                }
+
+                itstartnode = listpath.begin();
+                advance(itstartnode, startIndex);
+                itendnode = itstartnode;
+                dReal totaldistance = 0;
+                for(uint32_t j = 0; j < endIndex-startIndex; ++j) {
+                    ++itendnode;
+                    totaldistance += itendnode->second;
+                }
+
+                dReal expectedtotaldistance = parameters->_distmetricfn(itstartnode->first, itendnode->first);
+                if( expectedtotaldistance > totaldistance-0.1*parameters->_fStepLength ) {
+                    // expected total distance is not that great
+                    continue;
+                }
+
+                ShortcutCandidate& candidate = _vShortcutCandidates[nvalid++];
+                candidate.itstartnode = itstartnode;
+                candidate.itendnode = itendnode;
+                candidate.startIndex = startIndex;
+                candidate.endIndex = endIndex;
+                candidate.totaldistance = totaldistance;
             }
-            if(_filterreturn->_configurations.size() == 0 ) {
+            if( nvalid == 0 ) {
                 continue;
             }
-            OPENRAVE_ASSERT_OP(_filterreturn->_configurations.size()%dof, ==, 0);
-            // check how long the new path is
-            _vtempdists.resize(_filterreturn->_configurations.size()/dof+1);
-            std::vector<dReal>::iterator itdist = _vtempdists.begin();
-            std::vector<dReal>::iterator itnewconfig = _filterreturn->_configurations.begin();
-            std::copy(itnewconfig, itnewconfig+dof, vnewconfig0.begin());
-            dReal newtotaldistance = parameters->_distmetricfn(itstartnode->first, vnewconfig0);
-            *itdist++ = newtotaldistance;
-            itnewconfig += dof;
-            while(itnewconfig != _filterreturn->_configurations.end() ) {
-                std::copy(itnewconfig, itnewconfig+dof, vnewconfig1.begin());
-                *itdist = parameters->_distmetricfn(vnewconfig0, vnewconfig1);
-                newtotaldistance += *itdist;
-                ++itdist;
-                vnewconfig0.swap(vnewconfig1);
-                itnewconfig += dof;
-            }
-            *itdist = parameters->_distmetricfn(vnewconfig0, itendnode->first);
-            newtotaldistance += *itdist;
-            ++itdist;
-            BOOST_ASSERT(itdist==_vtempdists.end());
 
-            if( newtotaldistance > totaldistance-0.1*parameters->_fStepLength ) {
-                // new path is not that good, so reject
-                nrejected++;
-                continue;
+            if( bParallel ) {
+                _pShortcutWorkers->Run(nvalid, boost::bind(&ShortcutLinearPlanner::_CheckShortcutCandidates, this, _1, _2));
             }
-
-            // finally add
-            itdist = _vtempdists.begin();
-            ++itstartnode;
-            itnewconfig = _filterreturn->_configurations.begin();
-            while(itnewconfig != _filterreturn->_configurations.end()) {
-                std::copy(itnewconfig, itnewconfig+dof, vnewconfig1.begin());
-                listpath.insert(itstartnode, make_pair(vnewconfig1, *itdist++));
-                itnewconfig += dof;
+            else {
+                _CheckShortcut(_vShortcutCandidates[0]);
             }
-            itendnode->second = *itdist++;
-            BOOST_ASSERT(itdist==_vtempdists.end());
 
-            // splice out in-between nodes in path
-            listpath.erase(itstartnode, itendnode);
-            nrejected = 0;
+            // apply the feasible candidates in the order they were sampled. since they do not overlap, the iterators of the later ones stay valid
+            bool bstop = false;
+            for(size_t icandidate = 0; icandidate < nvalid; ++icandidate) {
+                ShortcutCandidate& candidate = _vShortcutCandidates[icandidate];
+                if( !candidate.bFeasible ) {
+                    if( nrejected++ > (int)listpath.size()+8 ) {
+                        bstop = true;
+                        break;
+                    }
+                    continue;
+                }
+                if( candidate.vconfigurations.size() == 0 ) {
+                    continue;
+                }
+                if( candidate.newtotaldistance > candidate.totaldistance-0.1*parameters->_fStepLength ) {
+                    // new path is not that good, so reject
+                    nrejected++;
+                    continue;
+                }
+
+                // finally add
+                std::vector<dReal>::iterator itdist = candidate.vdists.begin();
+                itstartnode = candidate.itstartnode;
+                ++itstartnode;
+                std::vector<dReal>::iterator itnewconfig = candidate.vconfigurations.begin();
+                while(itnewconfig != candidate.vconfigurations.end()) {
+                    std::copy(itnewconfig, itnewconfig+dof, vnewconfig1.begin());
+                    listpath.insert(itstartnode, make_pair(vnewconfig1, *itdist++));
+                    itnewconfig += dof;
+                }
+                candidate.itendnode->second = *itdist++;
+                BOOST_ASSERT(itdist==candidate.vdists.end());
+
+                // splice out in-between nodes in path
+                listpath.erase(itstartnode, candidate.itendnode);
+                nrejected = 0;
+            }
 
-            if( listpath.size() <= 2 ) {
+            if( bstop || listpath.size() <= 2 ) {
                 break;
             }
 
@@ -206,7 +257,113 @@ protected:
         }
     }
 
-    void _SubsampleTrajectory(TrajectoryBasePtr ptraj, list< std::pair< vector<dReal>, dReal> >& listpath) const
+    /// \brief checks if the nodes of the candidate can be connected by a straight line and computes the distance of the new path
+    void _CheckShortcut(ShortcutCandidate& candidate)
+    {
+        PlannerParametersConstPtr parameters = GetParameters();
+        if( !_filterreturn ) {
+            _filterreturn.reset(new ConstraintFilterReturn());
+        }
+        candidate.bFeasible = false;
+        candidate.vconfigurations.resize(0);
+        candidate.vdists.resize(0);
+        _filterreturn->Clear();
+        if (parameters->CheckPathAllConstraints(candidate.itstartnode->first, candidate.itendnode->first, std::vector<dReal>(), std::vector<dReal>(), 0, IT_Open, 0xffff|CFO_FillCheckedConfiguration, _filterreturn) != 0 ) {
+            return;
+        }
+        candidate.bFeasible = true;
+        if(_filterreturn->_configurations.size() == 0 ) {
+            return;
+        }
+        int dof = parameters->GetDOF();
+        OPENRAVE_ASSERT_OP(_filterreturn->_configurations.size()%dof, ==, 0);
+        candidate.vconfigurations.swap(_filterreturn->_configurations);
+
+        // check how long the new path is
+        std::vector<dReal> vnewconfig0(dof), vnewconfig1(dof);
+        candidate.vdists.resize(candidate.vconfigurations.size()/dof+1);
+        std::vector<dReal>::iterator itdist = candidate.vdists.begin();
+        std::vector<dReal>::iterator itnewconfig = candidate.vconfigurations.begin();
+        std::copy(itnewconfig, itnewconfig+dof, vnewconfig0.begin());
+        dReal newtotaldistance = parameters->_distmetricfn(candidate.itstartnode->first, vnewconfig0);
+        *itdist++ = newtotaldistance;
+        itnewconfig += dof;
+        while(itnewconfig != candidate.vconfigurations.end() ) {
+            std::copy(itnewconfig, itnewconfig+dof, vnewconfig1.begin());
+            *itdist = parameters->_distmetricfn(vnewconfig0, vnewconfig1);
+            newtotaldistance += *itdist;
+            ++itdist;
+            vnewconfig0.swap(vnewconfig1);
+            itnewconfig += dof;
+        }
+        *itdist = parameters->_distmetricfn(vnewconfig0, candidate.itendnode->first);
+        newtotaldistance += *itdist;
+        ++itdist;
+        BOOST_ASSERT(itdist==candidate.vdists.end());
+        candidate.newtotaldistance = newtotaldistance;
+    }
+
+    /// \brief checks _vShortcutCandidates[start:end] with the planners of the environment snapshots, called from the worker threads
+    void _CheckShortcutCandidates(size_t start, size_t end)
+    {
+        for(size_t icandidate = start; icandidate < end; ++icandidate) {
+            boost::shared_ptr<ShortcutLinearPlanner> planner = _vShortcutPlanners.at(icandidate);
+            EnvironmentMutex::scoped_lock lock(planner->GetEnv()->GetMutex());
+            planner->_CheckShortcut(_vShortcutCandidates[icandidate]);
+        }
+    }
+
+    /// \brief sets up one planner per thread on an environment snapshot, see SetNumThreadsCommand
+    ///
+    /// The snapshots are kept between calls so that only the bodies that changed need to be copied. The parameters of the snapshot planners
+    /// are rebuilt from the configuration specification, so custom constraint functions of the original parameters are not used when shortcutting in parallel.
+    bool _InitShortcutPlanners()
+    {
+        _vShortcutPlanners.resize(0);
+        _vShortcutParameters.resize(0);
+        if( _nNumThreads <= 1 ) {
+            _vShortcutEnvs.resize(0);
+            _pShortcutWorkers.reset();
+            return true;
+        }
+        _vShortcutEnvs.resize(_nNumThreads);
+        for(int ithread = 0; ithread < _nNumThreads; ++ithread) {
+            if( !_vShortcutEnvs[ithread] ) {
+                _vShortcutEnvs[ithread] = GetEnv()->CloneSelf(Clone_Bodies);
+            }
+            else {
+                _vShortcutEnvs[ithread]->Clone(GetEnv(), Clone_Bodies|Clone_SkipUnchangedBodies);
+            }
+            EnvironmentMutex::scoped_lock lockshortcut(_vShortcutEnvs[ithread]->GetMutex());
+            TrajectoryTimingParametersPtr params(new TrajectoryTimingParameters());
+            params->copy(_parameters);
+            params->SetConfigurationSpecification(_vShortcutEnvs[ithread], _parameters->_configurationspecification);
+            // SetConfigurationSpecification resets the limits to the ones of the bodies
+            params->_vConfigLowerLimit = _parameters->_vConfigLowerLimit;
+            params->_vConfigUpperLimit = _parameters->_vConfigUpperLimit;
+            params->_vConfigVelocityLimit = _parameters->_vConfigVelocityLimit;
+            params->_vConfigAccelerationLimit = _parameters->_vConfigAccelerationLimit;
+            params->_vConfigResolution = _parameters->_vConfigResolution;
+            params->_sPostProcessingPlanner = "";
+            boost::shared_ptr<ShortcutLinearPlanner> planner = boost::dynamic_pointer_cast<ShortcutLinearPlanner>(RaveCreatePlanner(_vShortcutEnvs[ithread], GetXMLId()));
+            if( !planner ) {
+                RAVELOG_WARN_FORMAT("failed to create shortcut planner %s", GetXMLId());
+                return false;
+            }
+            if( !planner->InitPlan(RobotBasePtr(), params) ) {
+                RAVELOG_WARN_FORMAT("shortcut planner %d failed to initialize", ithread);
+                return false;
+            }
+            _vShortcutPlanners.push_back(planner);
+            _vShortcutParameters.push_back(params); // the constraint functions of params only hold weak references to it
+        }
+        if( !_pShortcutWorkers || _pShortcutWorkers->GetNumThreads() != _nNumThreads ) {
+            _pShortcutWorkers.reset(new ParallelRangeWorkers(_nNumThreads, "LinearShortcutAdvanced"));
+        }
+        return true;
+    }
+
+    void _SubsampleTrajectory(TrajectoryBasePtr ptraj, PathList& listpath) const
     {
         PlannerParametersConstPtr parameters = GetParameters();
         vector<dReal> q0(parameters->GetDOF()), q1(parameters->GetDOF()), dq(parameters->GetDOF()), qcur(parameters->GetDOF()), dq2;
@@ -278,7 +435,13 @@ protected:
     RobotBasePtr _probot;
     PlannerBasePtr _linearretimer;
     ConstraintFilterReturnPtr _filterreturn;
-    std::vector<dReal> _vtempdists;
+
+    int _nNumThreads; ///< set by the SetNumThreads command
+    std::vector<EnvironmentBasePtr> _vShortcutEnvs; ///< environment snapshots of _vShortcutPlanners, kept between calls
+    std::vector< boost::shared_ptr<ShortcutLinearPlanner> > _vShortcutPlanners; ///< check the candidates in parallel, empty if shortcutting in this thread
+    std::vector<TrajectoryTimingParametersPtr> _vShortcutParameters; ///< parameters of _vShortcutPlanners
+    std::vector<ShortcutCandidate> _vShortcutCandidates;
+    ParallelRangeWorkersPtr _pShortcutWorkers; ///< threads running _vShortcutPlanners
 };
 
 PlannerBasePtr CreateShortcutLinearPlanner(EnvironmentBasePtr penv, std::istream& sinput) {
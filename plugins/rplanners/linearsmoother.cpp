@@ -14,9 +14,23 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "openraveplugindefs.h"
+#include "parallelrangeworkers.h"
 
 class LinearSmoother : public PlannerBase
 {
+    typedef list< std::pair< vector<dReal>, dReal> > PathList;
+
+    /// \brief a shortcut between two distances along the path that is checked by one of the environment snapshots
+    struct ShortcutCandidate
+    {
+        PathList::iterator itstartnode, itendnode;
+        int startindex, endindex; ///< indices of itstartnode and itendnode in the path
+        dReal fstartdist, fenddist, fstartdistdelta, fenddistdelta;
+        dReal fnewsegmentdist; ///< the distance of the shortcut
+        std::vector< std::pair<std::vector<dReal>, dReal> > vpathvalues; ///< the configurations of the shortcut, the segments between them are checked
+        bool bFeasible;
+    };
+
 public:
     LinearSmoother(EnvironmentBasePtr penv, std::istream& sinput) : PlannerBase(penv)
     {
@@ -24,6 +38,9 @@ public:
         _linearretimer = RaveCreatePlanner(GetEnv(), "LinearTrajectoryRetimer");
         _bUseSingleDOFSmoothing = true;
         sinput >> _bUseSingleDOFSmoothing;
+        RegisterCommand("SetNumThreads",boost::bind(&LinearSmoother::SetNumThreadsCommand,this,_1,_2),
+                        "numthreads - every iteration checks numthreads shortcuts that do not share any nodes in parallel on environment snapshots. The shortcuts are sampled and applied in the same order, so the result only depends on the seed and numthreads. Default is 1.");
+        _nNumThreads = 1;
     }
     virtual ~LinearSmoother() {
     }
@@ -66,6 +83,17 @@ public:
         return _parameters;
     }
 
+    bool SetNumThreadsCommand(std::ostream& sout, std::istream& sinput)
+    {
+        int numthreads = 1;
+        sinput >> numthreads;
+        if( !sinput || numthreads < 1 ) {
+            return false;
+        }
+        _nNumThreads = numthreads;
+        return true;
+    }
+
     virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj)
     {
         BOOST_ASSERT(!!_parameters && !!ptraj );
@@ -82,7 +110,7 @@ public:
         PlannerParametersConstPtr parameters = GetParameters();
 
         // subsample trajectory and add to list
-        list< std::pair< vector<dReal>, dReal> > listpath;
+        PathList listpath;
         vector<dReal> vtrajdata(parameters->GetDOF());
         ptraj->GetWaypoint(0,vtrajdata,parameters->_configurationspecification);
         dReal totaldist = 0;
@@ -97,6 +125,10 @@ public:
         }
 
         if( listpath.size() > 1 ) {
+            if( !_InitShortcutPlanners() ) {
+                RAVELOG_WARN_FORMAT("env=%d, failed to set up %d shortcut threads, so smoothing in this thread", GetEnv()->GetId()%_nNumThreads);
+                _vShortcutPlanners.resize(0);
+            }
             if( _bUseSingleDOFSmoothing ) {
                 dReal newdist1 = _OptimizePath(listpath, totaldist, parameters->_nMaxIterations*8/10);
                 if( newdist1 < 0 ) {
@@ -148,102 +180,136 @@ protected:
         return filename;
     }
 
-    dReal _OptimizePath(list< std::pair< vector<dReal>, dReal> >& listpath, dReal totaldist, int nMaxIterations)
+    dReal _OptimizePath(PathList& listpath, dReal totaldist, int nMaxIterations)
     {
         PlannerParametersConstPtr parameters = GetParameters();
-        list< std::pair< vector<dReal>, dReal> >::iterator itstartnode, itstartnodeprev, itendnode, itendnodeprev;
-        vector<dReal> vstartvalues(parameters->GetDOF()), vendvalues(parameters->GetDOF());
+        PathList::iterator itstartnode, itstartnodeprev, itendnode, itendnodeprev;
+        size_t numdof = parameters->GetDOF();
+        size_t numcandidates = _vShortcutPlanners.size() > 0 ? _vShortcutPlanners.size() : 1;
+        _vShortcutCandidates.resize(numcandidates);
 
         PlannerProgress progress;
 
         int nrejected = 0;
-        for(int curiter = 0; curiter < nMaxIterations; ++curiter ) {
+        int curiter = 0;
+        while(curiter < nMaxIterations) {
             if( nrejected >= 20 ) {
                 RAVELOG_VERBOSE("smoothing quitting early\n");
                 break;
             }
-            dReal fstartdist = max(dReal(0),totaldist-parameters->_fStepLength)*_puniformsampler->SampleSequenceOneReal(IT_OpenEnd);
-            dReal fenddist = fstartdist + (totaldist-fstartdist)*_puniformsampler->SampleSequenceOneReal(IT_OpenStart);
-            dReal fstartdistdelta=0, fenddistdelta=0;
-            dReal fcurdist = 0;
-            itstartnodeprev = itstartnode = listpath.begin();
-            while(itstartnode != listpath.end() ) {
-                if( fstartdist >= fcurdist && fstartdist < fcurdist+itstartnode->second ) {
-                    fstartdistdelta = fstartdist-fcurdist;
-                    break;
+            // sample all the candidates in this thread so that the result does not depend on the thread timing
+            size_t nvalid = 0;
+            for(size_t icandidate = 0; icandidate < numcandidates && curiter < nMaxIterations; ++icandidate, ++curiter) {
+                dReal fstartdist = max(dReal(0),totaldist-parameters->_fStepLength)*_puniformsampler->SampleSequenceOneReal(IT_OpenEnd);
+                dReal fenddist = fstartdist + (totaldist-fstartdist)*_puniformsampler->SampleSequenceOneReal(IT_OpenStart);
+                dReal fstartdistdelta=0, fenddistdelta=0;
+                dReal fcurdist = 0;
+                int startindex = 0;
+                itstartnodeprev = itstartnode = listpath.begin();
+                while(itstartnode != listpath.end() ) {
+                    if( fstartdist >= fcurdist && fstartdist < fcurdist+itstartnode->second ) {
+                        fstartdistdelta = fstartdist-fcurdist;
+                        break;
+                    }
+                    fcurdist += itstartnode->second;
+                    itstartnodeprev = itstartnode;
+                    ++itstartnode;
+                    ++startindex;
                 }
-                fcurdist += itstartnode->second;
-                itstartnodeprev = itstartnode;
-                ++itstartnode;
-            }
 
-            itendnodeprev = itstartnodeprev;
-            itendnode = itstartnode;
-            int numnodes=0;
-            while(itendnode != listpath.end() ) {
-                if( fenddist >= fcurdist && fenddist < fcurdist+itendnode->second ) {
-                    fenddistdelta = fenddist-fcurdist;
-                    break;
+                itendnodeprev = itstartnodeprev;
+                itendnode = itstartnode;
+                int endindex = startindex;
+                while(itendnode != listpath.end() ) {
+                    if( fenddist >= fcurdist && fenddist < fcurdist+itendnode->second ) {
+                        fenddistdelta = fenddist-fcurdist;
+                        break;
+                    }
+                    fcurdist += itendnode->second;
+                    itendnodeprev = itendnode;
+                    ++itendnode;
+                    ++endindex;
                 }
-                fcurdist += itendnode->second;
-                itendnodeprev = itendnode;
-                ++itendnode;
-                ++numnodes;
-            }
 
-            if( itstartnode == itendnode ) {
-                // choose a line, so ignore
-                continue;
-            }
+                if( itstartnode == itendnode ) {
+                    // choose a line, so ignore
+                    continue;
+                }
 
-            nrejected++;
-            BOOST_ASSERT(itstartnode != listpath.end());
-            BOOST_ASSERT(itendnode != listpath.end());
+                nrejected++;
+                BOOST_ASSERT(itstartnode != listpath.end());
+                BOOST_ASSERT(itendnode != listpath.end());
+                if( _OverlapsShortcutCandidates(nvalid, startindex, endindex) ) {
+                    continue;
+                }
 
-            // compute the actual node values
-            if( itstartnode == listpath.begin() ) {
-                vstartvalues = itstartnode->first;
-            }
-            else {
-                dReal f = fstartdistdelta/itstartnode->second;
-                for(size_t i = 0; i < vstartvalues.size(); ++i) {
-                    vstartvalues[i] = itstartnode->first.at(i)*f + itstartnodeprev->first.at(i)*(1-f);
+                // compute the actual node values
+                ShortcutCandidate& candidate = _vShortcutCandidates[nvalid];
+                candidate.vpathvalues.resize(2);
+                vector<dReal>& vstartvalues = candidate.vpathvalues[0].first;
+                vector<dReal>& vendvalues = candidate.vpathvalues[1].first;
+                vstartvalues.resize(numdof);
+                vendvalues.resize(numdof);
+                if( itstartnode == listpath.begin() ) {
+                    vstartvalues = itstartnode->first;
+                }
+                else {
+                    dReal f = fstartdistdelta/itstartnode->second;
+                    for(size_t i = 0; i < vstartvalues.size(); ++i) {
+                        vstartvalues[i] = itstartnode->first.at(i)*f + itstartnodeprev->first.at(i)*(1-f);
+                    }
                 }
-            }
 
-            if( itendnode == --listpath.end() ) {
-                vendvalues = itendnode->first;
-            }
-            else {
-                dReal f = fenddistdelta/itendnode->second;
-                for(size_t i = 0; i < vendvalues.size(); ++i) {
-                    vendvalues[i] = itendnode->first.at(i)*f + itendnodeprev->first.at(i)*(1-f);
+                if( itendnode == --listpath.end() ) {
+                    vendvalues = itendnode->first;
+                }
+                else {
+                    dReal f = fenddistdelta/itendnode->second;
+                    for(size_t i = 0; i < vendvalues.size(); ++i) {
+                        vendvalues[i] = itendnode->first.at(i)*f + itendnodeprev->first.at(i)*(1-f);
+                    }
                 }
-            }
 
-            dReal fnewsegmentdist = parameters->_distmetricfn(vstartvalues, vendvalues);
-            if( fnewsegmentdist > fenddist-fstartdist-0.5*parameters->_fStepLength ) {
-                // expected total distance is not that great
-                continue;
-            }
+                dReal fnewsegmentdist = parameters->_distmetricfn(vstartvalues, vendvalues);
+                if( fnewsegmentdist > fenddist-fstartdist-0.5*parameters->_fStepLength ) {
+                    // expected total distance is not that great
+                    continue;
+                }
+
+                progress._iteration=curiter;
+                if( _CallCallbacks(progress) == PA_Interrupt ) {
+                    return -1;
+                }
 
-            progress._iteration=curiter;
-            if( _CallCallbacks(progress) == PA_Interrupt ) {
-                return -1;
+                candidate.itstartnode = itstartnode;
+                candidate.itendnode = itendnode;
+                candidate.startindex = startindex;
+                candidate.endindex = endindex;
+                candidate.fstartdist = fstartdist;
+                candidate.fenddist = fenddist;
+                candidate.fstartdistdelta = fstartdistdelta;
+                candidate.fenddistdelta = fenddistdelta;
+                candidate.fnewsegmentdist = fnewsegmentdist;
+                ++nvalid;
             }
 
             // check if the nodes can be connected by a straight line
-            if (!SegmentFeasible(vstartvalues, vendvalues, IT_Open)) {
-                continue;
-            }
+            _CheckShortcutCandidates(nvalid);
 
-            listpath.insert(itstartnode, make_pair(vstartvalues, fstartdistdelta));
-            itendnode->second -= fenddistdelta;
-            itendnode = listpath.insert(itendnode, make_pair(vendvalues, fnewsegmentdist)); // get new endnode
-            listpath.erase(itstartnode, itendnode);
-            totaldist += fnewsegmentdist - (fenddist-fstartdist);
-            RAVELOG_VERBOSE(str(boost::format("smoother iter %d, totaldist=%f")%curiter%totaldist));
-            nrejected = 0;
+            // apply the feasible candidates in the order they were sampled. since they do not share any nodes, the iterators of the later ones stay valid
+            for(size_t icandidate = 0; icandidate < nvalid; ++icandidate) {
+                ShortcutCandidate& candidate = _vShortcutCandidates[icandidate];
+                if( !candidate.bFeasible ) {
+                    continue;
+                }
+                listpath.insert(candidate.itstartnode, make_pair(candidate.vpathvalues[0].first, candidate.fstartdistdelta));
+                candidate.itendnode->second -= candidate.fenddistdelta;
+                itendnode = listpath.insert(candidate.itendnode, make_pair(candidate.vpathvalues[1].first, candidate.fnewsegmentdist)); // get new endnode
+                listpath.erase(candidate.itstartnode, itendnode);
+                totaldist += candidate.fnewsegmentdist - (candidate.fenddist-candidate.fstartdist);
+                RAVELOG_VERBOSE(str(boost::format("smoother iter %d, totaldist=%f")%curiter%totaldist));
+                nrejected = 0;
+            }
         }
         // double check the distances
         dReal dist = 0;
@@ -254,172 +320,197 @@ protected:
         return totaldist;
     }
 
-    dReal _OptimizePathSingleDOF(list< std::pair< vector<dReal>, dReal> >& listpath, dReal totaldist, int nMaxIterations)
+    dReal _OptimizePathSingleDOF(PathList& listpath, dReal totaldist, int nMaxIterations)
     {
         PlannerParametersConstPtr parameters = GetParameters();
-        std::vector< std::pair<std::vector<dReal>, dReal> > vpathvalues;
-        list< std::pair< vector<dReal>, dReal> >::iterator itstartnode, itstartnodeprev, itendnode, itendnodeprev, itnode;
+        PathList::iterator itstartnode, itstartnodeprev, itendnode, itendnodeprev, itnode;
         size_t numdof = parameters->GetDOF();
+        size_t numcandidates = _vShortcutPlanners.size() > 0 ? _vShortcutPlanners.size() : 1;
+        _vShortcutCandidates.resize(numcandidates);
         int nrejected = 0;
         PlannerProgress progress;
-        for(int curiter = 0; curiter < nMaxIterations; ++curiter ) {
+        int curiter = 0;
+        while(curiter < nMaxIterations) {
             if( nrejected >= 20 ) {
                 RAVELOG_VERBOSE("smoothing quitting early\n");
                 break;
             }
-            dReal fstartdist = max(dReal(0),totaldist-parameters->_fStepLength)*_puniformsampler->SampleSequenceOneReal(IT_OpenEnd);
-            dReal fenddist = fstartdist + (totaldist-fstartdist)*_puniformsampler->SampleSequenceOneReal(IT_OpenStart);
-            uint32_t ioptdof = _puniformsampler->SampleSequenceOneUInt32()%uint32_t(numdof); // dof to optimize
-
-            dReal fstartdistdelta=0, fenddistdelta=0;
-            dReal fcurdist = 0;
-            itstartnodeprev = itstartnode = listpath.begin();
-            while(itstartnode != listpath.end() ) {
-                if( fstartdist >= fcurdist && fstartdist < fcurdist+itstartnode->second ) {
-                    fstartdistdelta = fstartdist-fcurdist;
-                    break;
+            // sample all the candidates in this thread so that the result does not depend on the thread timing
+            size_t nvalid = 0;
+            for(size_t icandidate = 0; icandidate < numcandidates && curiter < nMaxIterations; ++icandidate, ++curiter) {
+                dReal fstartdist = max(dReal(0),totaldist-parameters->_fStepLength)*_puniformsampler->SampleSequenceOneReal(IT_OpenEnd);
+                dReal fenddist = fstartdist + (totaldist-fstartdist)*_puniformsampler->SampleSequenceOneReal(IT_OpenStart);
+                uint32_t ioptdof = _puniformsampler->SampleSequenceOneUInt32()%uint32_t(numdof); // dof to optimize
+
+                dReal fstartdistdelta=0, fenddistdelta=0;
+                dReal fcurdist = 0;
+                int startindex = 0;
+                itstartnodeprev = itstartnode = listpath.begin();
+                while(itstartnode != listpath.end() ) {
+                    if( fstartdist >= fcurdist && fstartdist < fcurdist+itstartnode->second ) {
+                        fstartdistdelta = fstartdist-fcurdist;
+                        break;
+                    }
+                    fcurdist += itstartnode->second;
+                    itstartnodeprev = itstartnode;
+                    ++itstartnode;
+                    ++startindex;
                 }
-                fcurdist += itstartnode->second;
-                itstartnodeprev = itstartnode;
-                ++itstartnode;
-            }
 
-            itendnodeprev = itstartnodeprev;
-            itendnode = itstartnode;
-            int numnodes=0;
-            while(itendnode != listpath.end() ) {
-                if( fenddist >= fcurdist && fenddist < fcurdist+itendnode->second ) {
-                    fenddistdelta = fenddist-fcurdist;
-                    break;
+                itendnodeprev = itstartnodeprev;
+                itendnode = itstartnode;
+                int numnodes=0;
+                while(itendnode != listpath.end() ) {
+                    if( fenddist >= fcurdist && fenddist < fcurdist+itendnode->second ) {
+                        fenddistdelta = fenddist-fcurdist;
+                        break;
+                    }
+                    fcurdist += itendnode->second;
+                    itendnodeprev = itendnode;
+                    ++itendnode;
+                    ++numnodes;
                 }
-                fcurdist += itendnode->second;
-                itendnodeprev = itendnode;
-                ++itendnode;
-                ++numnodes;
-            }
 
-            if( itstartnode == itendnode ) {
-                // choose a line, so ignore
-                continue;
-            }
-            nrejected++;
-            BOOST_ASSERT(itstartnode != listpath.end());
-            BOOST_ASSERT(itendnode != listpath.end());
+                if( itstartnode == itendnode ) {
+                    // choose a line, so ignore
+                    continue;
+                }
+                nrejected++;
+                BOOST_ASSERT(itstartnode != listpath.end());
+                BOOST_ASSERT(itendnode != listpath.end());
+                if( _OverlapsShortcutCandidates(nvalid, startindex, startindex+numnodes) ) {
+                    continue;
+                }
 
-            vpathvalues.resize(numnodes+2);
+                ShortcutCandidate& candidate = _vShortcutCandidates[nvalid];
+                std::vector< std::pair<std::vector<dReal>, dReal> >& vpathvalues = candidate.vpathvalues;
+                vpathvalues.resize(numnodes+2);
 
-            // compute the actual node values
-            if( RaveFabs(fstartdistdelta) <= g_fEpsilonLinear ) {
-                vpathvalues.at(0).first = itstartnode->first;
-                vpathvalues.at(0).second = 0;
-            }
-            else {
-                std::vector<dReal>& v = vpathvalues.at(0).first;
-                v.resize(numdof);
-                vpathvalues.at(0).second = 0;
-                dReal f = fstartdistdelta/itstartnode->second;
-                for(size_t i = 0; i < numdof; ++i) {
-                    v[i] = itstartnode->first.at(i)*f + itstartnodeprev->first.at(i)*(1-f);
+                // compute the actual node values
+                if( RaveFabs(fstartdistdelta) <= g_fEpsilonLinear ) {
+                    vpathvalues.at(0).first = itstartnode->first;
+                    vpathvalues.at(0).second = 0;
                 }
-            }
-
-            if( RaveFabs(fenddistdelta-itendnode->second) <= g_fEpsilonLinear ) {
-                vpathvalues.at(numnodes+1) = *itendnode;
-            }
-            else {
-                std::vector<dReal>& v = vpathvalues.at(numnodes+1).first;
-                v.resize(numdof);
-                vpathvalues.at(numnodes+1).second = fenddistdelta;
-                dReal f = fenddistdelta/itendnode->second;
-                for(size_t i = 0; i < numdof; ++i) {
-                    v[i] = itendnode->first.at(i)*f + itendnodeprev->first.at(i)*(1-f);
+                else {
+                    std::vector<dReal>& v = vpathvalues.at(0).first;
+                    v.resize(numdof);
+                    vpathvalues.at(0).second = 0;
+                    dReal f = fstartdistdelta/itstartnode->second;
+                    for(size_t i = 0; i < numdof; ++i) {
+                        v[i] = itstartnode->first.at(i)*f + itstartnodeprev->first.at(i)*(1-f);
+                    }
                 }
-            }
 
-            progress._iteration=curiter;
-            if( _CallCallbacks(progress) == PA_Interrupt ) {
-                return -1;
-            }
-            
-            dReal fstartdofvalue = vpathvalues.at(0).first.at(ioptdof), flastdofvalue = vpathvalues.at(numnodes+1).first.at(ioptdof);
-            dReal fdelta = (flastdofvalue-fstartdofvalue)/(fenddist-fstartdist);
-            bool bsuccess = true;
-            fcurdist = 0;
-            dReal fnewsegmentdist = 0;
-            itnode = itstartnode;
-            int pathindex = 0;
-            do {
-                if( pathindex == 0 ) {
-                    fcurdist = itnode->second - fstartdistdelta;
+                if( RaveFabs(fenddistdelta-itendnode->second) <= g_fEpsilonLinear ) {
+                    vpathvalues.at(numnodes+1) = *itendnode;
                 }
                 else {
-                    fcurdist += itnode->second;
+                    std::vector<dReal>& v = vpathvalues.at(numnodes+1).first;
+                    v.resize(numdof);
+                    vpathvalues.at(numnodes+1).second = fenddistdelta;
+                    dReal f = fenddistdelta/itendnode->second;
+                    for(size_t i = 0; i < numdof; ++i) {
+                        v[i] = itendnode->first.at(i)*f + itendnodeprev->first.at(i)*(1-f);
+                    }
+                }
+
+                progress._iteration=curiter;
+                if( _CallCallbacks(progress) == PA_Interrupt ) {
+                    return -1;
                 }
-                vpathvalues.at(pathindex+1).first = itnode->first;
-                vpathvalues.at(pathindex+1).first.at(ioptdof) = fstartdofvalue + fcurdist*fdelta;
-                dReal fdist = parameters->_distmetricfn(vpathvalues.at(pathindex).first, vpathvalues.at(pathindex+1).first);
-                vpathvalues.at(pathindex+1).second = fdist;
+
+                dReal fstartdofvalue = vpathvalues.at(0).first.at(ioptdof), flastdofvalue = vpathvalues.at(numnodes+1).first.at(ioptdof);
+                dReal fdelta = (flastdofvalue-fstartdofvalue)/(fenddist-fstartdist);
+                fcurdist = 0;
+                dReal fnewsegmentdist = 0;
+                itnode = itstartnode;
+                int pathindex = 0;
+                do {
+                    if( pathindex == 0 ) {
+                        fcurdist = itnode->second - fstartdistdelta;
+                    }
+                    else {
+                        fcurdist += itnode->second;
+                    }
+                    vpathvalues.at(pathindex+1).first = itnode->first;
+                    vpathvalues.at(pathindex+1).first.at(ioptdof) = fstartdofvalue + fcurdist*fdelta;
+                    dReal fdist = parameters->_distmetricfn(vpathvalues.at(pathindex).first, vpathvalues.at(pathindex+1).first);
+                    vpathvalues.at(pathindex+1).second = fdist;
+                    fnewsegmentdist += fdist;
+                    ++itnode;
+                    ++pathindex;
+                } while(itnode != itendnode);
+
+                // have to process the time on the last node
+                dReal fdist = parameters->_distmetricfn(vpathvalues.at(numnodes).first, vpathvalues.at(numnodes+1).first);
+                vpathvalues.at(numnodes+1).second = fdist;
                 fnewsegmentdist += fdist;
-                ++itnode;
-                ++pathindex;
-            } while(itnode != itendnode);
-
-            // have to process the time on the last node
-            dReal fdist = parameters->_distmetricfn(vpathvalues.at(numnodes).first, vpathvalues.at(numnodes+1).first);
-            vpathvalues.at(numnodes+1).second = fdist;
-            fnewsegmentdist += fdist;
-
-            if( fnewsegmentdist > fenddist-fstartdist-0.5*parameters->_fStepLength ) {
-                // expected total distance is not that great
-                continue;
-            }
 
-            for(size_t i = 0; i+1 < vpathvalues.size(); ++i) {
-                IntervalType interval = i+2==vpathvalues.size() ? IT_Open : IT_OpenStart;
-                if (!SegmentFeasible(vpathvalues.at(i).first, vpathvalues.at(i+1).first, interval)) {
-                    bsuccess = false;
-                    break;
+                if( fnewsegmentdist > fenddist-fstartdist-0.5*parameters->_fStepLength ) {
+                    // expected total distance is not that great
+                    continue;
                 }
-            }
 
-            progress._iteration=curiter;
-            if( _CallCallbacks(progress) == PA_Interrupt ) {
-                return -1;
-            }
-            
-            if( !bsuccess ) {
-                // rejected due to constraints
-                continue;
+                candidate.itstartnode = itstartnode;
+                candidate.itendnode = itendnode;
+                candidate.startindex = startindex;
+                candidate.endindex = startindex+numnodes;
+                candidate.fstartdist = fstartdist;
+                candidate.fenddist = fenddist;
+                candidate.fstartdistdelta = fstartdistdelta;
+                candidate.fenddistdelta = fenddistdelta;
+                candidate.fnewsegmentdist = fnewsegmentdist;
+                ++nvalid;
             }
 
-            // only insert if not at start
-            if( RaveFabs(fstartdistdelta) > g_fEpsilonLinear ) {
-                vpathvalues.at(0).second = fstartdistdelta;
-                listpath.insert(itstartnode, vpathvalues.at(0));
-            }
+            _CheckShortcutCandidates(nvalid);
 
-            // replace all the values with the new path
-            itnode = itstartnode;
-            pathindex = 1;
-            do {
-                *itnode = vpathvalues.at(pathindex++);
-                ++itnode;
-            } while(itnode != itendnode);
-
-            // only insert if not at end
-            if( RaveFabs(fenddistdelta-itendnode->second) > g_fEpsilonLinear ) {
-                listpath.insert(itendnode, vpathvalues.at(numnodes+1));
-                itendnode->second -= fenddistdelta;
-            }
-            totaldist += fnewsegmentdist - (fenddist-fstartdist);
-            dReal dist = 0;
-            FOREACH(it, listpath) {
-                dist += it->second;
+            if( nvalid > 0 ) {
+                progress._iteration=curiter;
+                if( _CallCallbacks(progress) == PA_Interrupt ) {
+                    return -1;
+                }
             }
-            OPENRAVE_ASSERT_OP(RaveFabs(totaldist-dist),<=,1e-7);
 
-            RAVELOG_VERBOSE(str(boost::format("singledof iter %d, totaldist=%f")%curiter%totaldist));
-            nrejected = 0;
+            // apply the feasible candidates in the order they were sampled. since they do not share any nodes, the iterators of the later ones stay valid
+            for(size_t icandidate = 0; icandidate < nvalid; ++icandidate) {
+                ShortcutCandidate& candidate = _vShortcutCandidates[icandidate];
+                if( !candidate.bFeasible ) {
+                    // rejected due to constraints
+                    continue;
+                }
+                std::vector< std::pair<std::vector<dReal>, dReal> >& vpathvalues = candidate.vpathvalues;
+                int numnodes = (int)vpathvalues.size()-2;
+
+                // only insert if not at start
+                if( RaveFabs(candidate.fstartdistdelta) > g_fEpsilonLinear ) {
+                    vpathvalues.at(0).second = candidate.fstartdistdelta;
+                    listpath.insert(candidate.itstartnode, vpathvalues.at(0));
+                }
+
+                // replace all the values with the new path
+                itnode = candidate.itstartnode;
+                int pathindex = 1;
+                do {
+                    *itnode = vpathvalues.at(pathindex++);
+                    ++itnode;
+                } while(itnode != candidate.itendnode);
+
+                // only insert if not at end
+                if( RaveFabs(candidate.fenddistdelta-candidate.itendnode->second) > g_fEpsilonLinear ) {
+                    listpath.insert(candidate.itendnode, vpathvalues.at(numnodes+1));
+                    candidate.itendnode->second -= candidate.fenddistdelta;
+                }
+                totaldist += candidate.fnewsegmentdist - (candidate.fenddist-candidate.fstartdist);
+                dReal dist = 0;
+                FOREACH(it, listpath) {
+                    dist += it->second;
+                }
+                OPENRAVE_ASSERT_OP(RaveFabs(totaldist-dist),<=,1e-7);
+
+                RAVELOG_VERBOSE(str(boost::format("singledof iter %d, totaldist=%f")%curiter%totaldist));
+                nrejected = 0;
+            }
         }
         // double check the distances
         dReal dist = 0;
@@ -430,6 +521,106 @@ protected:
         return totaldist;
     }
 
+    /// \brief returns true if the nodes [startindex, endindex] of the path touch the nodes of one of the first numcandidates candidates
+    bool _OverlapsShortcutCandidates(size_t numcandidates, int startindex, int endindex) const
+    {
+        for(size_t icandidate = 0; icandidate < numcandidates; ++icandidate) {
+            if( startindex <= _vShortcutCandidates[icandidate].endindex && _vShortcutCandidates[icandidate].startindex <= endindex ) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// \brief sets ShortcutCandidate::bFeasible of the first numcandidates candidates, in parallel if there are snapshot planners
+    void _CheckShortcutCandidates(size_t numcandidates)
+    {
+        if( numcandidates == 0 ) {
+            return;
+        }
+        if( _vShortcutPlanners.size() > 0 ) {
+            _pShortcutWorkers->Run(numcandidates, boost::bind(&LinearSmoother::_CheckShortcutCandidatesRange, this, _1, _2));
+        }
+        else {
+            for(size_t icandidate = 0; icandidate < numcandidates; ++icandidate) {
+                _vShortcutCandidates[icandidate].bFeasible = _CheckShortcutSegments(_vShortcutCandidates[icandidate]);
+            }
+        }
+    }
+
+    /// \brief checks _vShortcutCandidates[start:end] with the planners of the environment snapshots, called from the worker threads
+    void _CheckShortcutCandidatesRange(size_t start, size_t end)
+    {
+        for(size_t icandidate = start; icandidate < end; ++icandidate) {
+            boost::shared_ptr<LinearSmoother> planner = _vShortcutPlanners.at(icandidate);
+            EnvironmentMutex::scoped_lock lock(planner->GetEnv()->GetMutex());
+            _vShortcutCandidates[icandidate].bFeasible = planner->_CheckShortcutSegments(_vShortcutCandidates[icandidate]);
+        }
+    }
+
+    /// \brief checks the segments between consecutive ShortcutCandidate::vpathvalues
+    bool _CheckShortcutSegments(const ShortcutCandidate& candidate)
+    {
+        const std::vector< std::pair<std::vector<dReal>, dReal> >& vpathvalues = candidate.vpathvalues;
+        for(size_t i = 0; i+1 < vpathvalues.size(); ++i) {
+            IntervalType interval = i+2==vpathvalues.size() ? IT_Open : IT_OpenStart;
+            if (!SegmentFeasible(vpathvalues.at(i).first, vpathvalues.at(i+1).first, interval)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// \brief sets up one planner per thread on an environment snapshot, see SetNumThreadsCommand
+    ///
+    /// The snapshots are kept between calls so that only the bodies that changed need to be copied. The parameters of the snapshot planners
+    /// are rebuilt from the configuration specification, so custom constraint functions of the original parameters are not used when smoothing in parallel.
+    bool _InitShortcutPlanners()
+    {
+        _vShortcutPlanners.resize(0);
+        _vShortcutParameters.resize(0);
+        if( _nNumThreads <= 1 ) {
+            _vShortcutEnvs.resize(0);
+            _pShortcutWorkers.reset();
+            return true;
+        }
+        _vShortcutEnvs.resize(_nNumThreads);
+        for(int ithread = 0; ithread < _nNumThreads; ++ithread) {
+            if( !_vShortcutEnvs[ithread] ) {
+                _vShortcutEnvs[ithread] = GetEnv()->CloneSelf(Clone_Bodies);
+            }
+            else {
+                _vShortcutEnvs[ithread]->Clone(GetEnv(), Clone_Bodies|Clone_SkipUnchangedBodies);
+            }
+            EnvironmentMutex::scoped_lock lockshortcut(_vShortcutEnvs[ithread]->GetMutex());
+            TrajectoryTimingParametersPtr params(new TrajectoryTimingParameters());
+            params->copy(_parameters);
+            params->SetConfigurationSpecification(_vShortcutEnvs[ithread], _parameters->_configurationspecification);
+            // SetConfigurationSpecification resets the limits to the ones of the bodies
+            params->_vConfigLowerLimit = _parameters->_vConfigLowerLimit;
+            params->_vConfigUpperLimit = _parameters->_vConfigUpperLimit;
+            params->_vConfigVelocityLimit = _parameters->_vConfigVelocityLimit;
+            params->_vConfigAccelerationLimit = _parameters->_vConfigAccelerationLimit;
+            params->_vConfigResolution = _parameters->_vConfigResolution;
+            params->_sPostProcessingPlanner = "";
+            boost::shared_ptr<LinearSmoother> planner = boost::dynamic_pointer_cast<LinearSmoother>(RaveCreatePlanner(_vShortcutEnvs[ithread], GetXMLId()));
+            if( !planner ) {
+                RAVELOG_WARN_FORMAT("failed to create shortcut planner %s", GetXMLId());
+                return false;
+            }
+            if( !planner->InitPlan(RobotBasePtr(), params) ) {
+                RAVELOG_WARN_FORMAT("shortcut planner %d failed to initialize", ithread);
+                return false;
+            }
+            _vShortcutPlanners.push_back(planner);
+            _vShortcutParameters.push_back(params); // the constraint functions of params only hold weak references to it
+        }
+        if( !_pShortcutWorkers || _pShortcutWorkers->GetNumThreads() != _nNumThreads ) {
+            _pShortcutWorkers.reset(new ParallelRangeWorkers(_nNumThreads, "LinearSmootherShortcut"));
+        }
+        return true;
+    }
+
     /// \brief checks if a segment is feasible using pointtolerance
     inline bool SegmentFeasible(const std::vector<dReal>& a,const std::vector<dReal>& b, IntervalType interval)
     {
@@ -454,6 +645,13 @@ protected:
     RobotBasePtr _probot;
     PlannerBasePtr _linearretimer;
     bool _bUseSingleDOFSmoothing;
+
+    int _nNumThreads; ///< set by the SetNumThreads command
+    std::vector<EnvironmentBasePtr> _vShortcutEnvs; ///< environment snapshots of _vShortcutPlanners, kept between calls
+    std::vector< boost::shared_ptr<LinearSmoother> > _vShortcutPlanners; ///< check the candidates in parallel, empty if smoothing in this thread
+    std::vector<TrajectoryTimingParametersPtr> _vShortcutParameters; ///< parameters of _vShortcutPlanners
+    std::vector<ShortcutCandidate> _vShortcutCandidates;
+    ParallelRangeWorkersPtr _pShortcutWorkers; ///< threads running _vShortcutPlanners
 };
 
 PlannerBasePtr CreateLinearSmoother(EnvironmentBasePtr penv, std::istream& sinput) {
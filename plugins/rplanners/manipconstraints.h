@@ -24,7 +24,7 @@ namespace rplanners {
 
 struct ManipConstraintInfo
 {
-    ManipConstraintInfo() : fmaxdistfromcenter(0) {
+    ManipConstraintInfo() : fmaxdistfromcenter(0), bAccelBound(false) {
     }
     
     RobotBase::ManipulatorPtr pmanip;
@@ -39,6 +39,11 @@ struct ManipConstraintInfo
 
     std::vector<int> vuseddofindices; ///< a vector of unique DOF indices targetted for the body
     std::vector<int> vconfigindices; ///< for every index in vuseddofindices, returns the first configuration space index it came from
+
+    /// for every index in vuseddofindices, a configuration-independent upper bound of the speed of any checkpoint per unit speed of the dof.
+    /// For revolute joints it is the max distance from the joint anchor to the checkpoints, for prismatic joints it is 1. Empty if the chain cannot be bounded (mimic or multi-dof joints).
+    std::vector<dReal> vdofreach;
+    bool bAccelBound; ///< if true, the chain is only revolute joints and vdofreach can also bound the checkpoint accelerations
 };
 
 class ManipConstraintChecker
@@ -165,6 +170,7 @@ public:
                         }
                     }
                     info.fmaxdistfromcenter = RaveSqrt(info.fmaxdistfromcenter);
+                    _ComputeDOFReaches(probot, info);
                     if( IS_DEBUGLEVEL(Level_Verbose) ) {
                         std::stringstream ss; ss << std::setprecision(std::numeric_limits<dReal>::digits10+1);
                         ss << "[";
@@ -314,6 +320,9 @@ public:
 
     
     /// checks at each ramp's edges. This is called in the critical loop
+    ///
+    /// For every ramp, the max speed and acceleration of the checkpoints over the whole ramp are first bounded in closed form from ManipConstraintInfo::vdofreach and the ramp's peak dof velocities and accelerations.
+    /// Only when a bound is above the limit is the end effector state evaluated, in one pass from the batched jacobians (and the hessians for the accelerations) of the end effector.
     ParabolicRampInternal::CheckReturn CheckManipConstraints2(const std::vector<ParabolicRampInternal::ParabolicRampND>& outramps)
     {
         if( _maxmanipspeed<=0 && _maxmanipaccel <=0) {
@@ -330,33 +339,66 @@ public:
 
             // Compute the velocity and accel of the end effector COM
             FOREACHC(itmanipinfo,_listCheckManips) {
+                bool bcheckspeed = _maxmanipspeed > 0, bcheckaccel = _maxmanipaccel > 0;
+                _BoundRampManipSpeedAccel(*itramp, *itmanipinfo, bcheckspeed, bcheckaccel);
+                if( !bcheckspeed && !bcheckaccel ) {
+                    continue;
+                }
+
                 KinBodyPtr probot = itmanipinfo->plink->GetParent();
-                itramp->Accel(0, ac);
-                qfillactive.resize(itmanipinfo->vuseddofindices.size());
-                _vfillactive.resize(itmanipinfo->vuseddofindices.size());
-                _afill.resize(probot->GetDOF());
-                for(size_t index = 0; index < itmanipinfo->vuseddofindices.size(); ++index) {
+                size_t numdof = itmanipinfo->vuseddofindices.size();
+                qfillactive.resize(numdof);
+                _vfillactive.resize(numdof);
+                for(size_t index = 0; index < numdof; ++index) {
                     qfillactive[index] = itramp->x0.at(itmanipinfo->vconfigindices.at(index));
                     _vfillactive[index] = itramp->dx0.at(itmanipinfo->vconfigindices.at(index));
-                    _afill[itmanipinfo->vuseddofindices.at(index)] = ac.at(itmanipinfo->vconfigindices.at(index));
                 }
                 int endeffindex = itmanipinfo->plink->GetIndex();
-                KinBody::KinBodyStateSaver saver(probot, KinBody::Save_LinkTransformation|KinBody::Save_LinkVelocities);
+                KinBody::KinBodyStateSaver saver(probot, KinBody::Save_LinkTransformation);
 
                 // Set robot to new state
                 probot->SetDOFValues(qfillactive, KinBody::CLA_CheckLimits, itmanipinfo->vuseddofindices);
-                probot->SetDOFVelocities(_vfillactive, KinBody::CLA_CheckLimits, itmanipinfo->vuseddofindices);
-                probot->GetLinkVelocities(endeffvels);
-                probot->GetLinkAccelerations(_afill,endeffaccs);
-                endeffvellin = endeffvels.at(endeffindex).first;
-                endeffvelang = endeffvels.at(endeffindex).second;
-                endeffacclin = endeffaccs.at(endeffindex).first;
-                endeffaccang = endeffaccs.at(endeffindex).second;
                 Transform R = itmanipinfo->plink->GetTransform();
+
+                // rows 0-2 are the translation jacobian of the end effector origin, rows 3-5 its angular velocity jacobian
+                _vlinkpositions.resize(1);
+                _vlinkpositions[0] = std::make_pair(endeffindex, R.trans);
+                probot->ComputeJacobians(_vlinkpositions, _vjacobians, itmanipinfo->vuseddofindices);
+                for(int irow = 0; irow < 3; ++irow) {
+                    dReal flin = 0, fang = 0;
+                    for(size_t index = 0; index < numdof; ++index) {
+                        flin += _vjacobians[irow*numdof+index]*_vfillactive[index];
+                        fang += _vjacobians[(3+irow)*numdof+index]*_vfillactive[index];
+                    }
+                    endeffvellin[irow] = flin;
+                    endeffvelang[irow] = fang;
+                }
+                if( bcheckaccel ) {
+                    // accel = Jacobian * dofaccelerations + dofvelocities^T * Hessian * dofvelocities
+                    itramp->Accel(0, ac);
+                    probot->ComputeHessianTranslation(endeffindex, R.trans, _vhessiantrans, itmanipinfo->vuseddofindices);
+                    probot->ComputeHessianAxisAngle(endeffindex, _vhessianangle, itmanipinfo->vuseddofindices);
+                    for(int irow = 0; irow < 3; ++irow) {
+                        dReal flin = 0, fang = 0;
+                        for(size_t i = 0; i < numdof; ++i) {
+                            dReal dofaccel = ac.at(itmanipinfo->vconfigindices[i]);
+                            flin += _vjacobians[irow*numdof+i]*dofaccel;
+                            fang += _vjacobians[(3+irow)*numdof+i]*dofaccel;
+                            size_t offset = numdof*(irow+3*i);
+                            for(size_t k = 0; k < numdof; ++k) {
+                                dReal fvelprod = _vfillactive[i]*_vfillactive[k];
+                                flin += _vhessiantrans[offset+k]*fvelprod;
+                                fang += _vhessianangle[offset+k]*fvelprod;
+                            }
+                        }
+                        endeffacclin[irow] = flin;
+                        endeffaccang[irow] = fang;
+                    }
+                }
                 // For each point in checkpoints, compute its vel and acc and check whether they satisfy the manipulator constraints                
                 FOREACH(itpoint,itmanipinfo->checkpoints) {
                     Vector point = R.rotate(*itpoint);
-                    if(_maxmanipspeed>0) {
+                    if(bcheckspeed) {
                         Vector vpoint = endeffvellin + endeffvelang.cross(point);
                         dReal manipspeed = RaveSqrt(vpoint.lengthsqr3());
                         if( manipspeed > 1e5 ) {
@@ -373,7 +415,7 @@ public:
                             return ParabolicRampInternal::CheckReturn(CFO_CheckTimeBasedConstraints, 0.9*_maxmanipspeed/manipspeed);
                         }
                     }
-                    if(_maxmanipaccel>0) {
+                    if(bcheckaccel) {
                         Vector apoint = endeffacclin + endeffvelang.cross(endeffvelang.cross(point)) + endeffaccang.cross(point);
                         dReal manipaccel = RaveSqrt(apoint.lengthsqr3());
                         if( maxmanipaccel < manipaccel ) {
@@ -394,6 +436,83 @@ public:
     }
 
 private:
+    /// \brief fills info.vdofreach and info.bAccelBound by walking the kinematic chain of info.plink from its tip
+    static void _ComputeDOFReaches(RobotBasePtr probot, ManipConstraintInfo& info)
+    {
+        info.vdofreach.resize(0);
+        info.bAccelBound = true;
+        std::vector<KinBody::JointPtr> vjoints;
+        if( !probot->GetChain(0, info.plink->GetIndex(), vjoints) ) {
+            return;
+        }
+        std::map<int, dReal> mapdofreach;
+        Vector vprevpoint = info.plink->GetTransform().trans;
+        dReal freach = info.fmaxdistfromcenter;
+        std::vector<dReal> vlower, vupper;
+        for(std::vector<KinBody::JointPtr>::reverse_iterator itjoint = vjoints.rbegin(); itjoint != vjoints.rend(); ++itjoint) {
+            KinBody::JointPtr pjoint = *itjoint;
+            if( pjoint->IsMimic() || pjoint->GetDOF() > 1 ) {
+                return;
+            }
+            if( pjoint->GetDOFIndex() < 0 || pjoint->IsStatic() ) {
+                continue;
+            }
+            Vector vanchor = pjoint->GetAnchor();
+            freach += RaveSqrt((vanchor-vprevpoint).lengthsqr3());
+            vprevpoint = vanchor;
+            if( pjoint->IsRevolute(0) ) {
+                mapdofreach[pjoint->GetDOFIndex()] = freach;
+            }
+            else if( pjoint->IsPrismatic(0) ) {
+                // the joints closer to the base see the distance to the tip change by the range of the prismatic joint
+                mapdofreach[pjoint->GetDOFIndex()] = 1;
+                pjoint->GetLimits(vlower, vupper);
+                freach += vupper.at(0) - vlower.at(0);
+                info.bAccelBound = false;
+            }
+            else {
+                return;
+            }
+        }
+        info.vdofreach.resize(info.vuseddofindices.size(), 0);
+        for(size_t index = 0; index < info.vuseddofindices.size(); ++index) {
+            std::map<int, dReal>::const_iterator it = mapdofreach.find(info.vuseddofindices[index]);
+            if( it != mapdofreach.end() ) {
+                info.vdofreach[index] = it->second;
+            }
+        }
+    }
+
+    /// \brief bounds the speed and acceleration of the checkpoints of info over the entire ramp.
+    ///
+    /// \param[inout] bcheckspeed set to false if the speed bound is within _maxmanipspeed
+    /// \param[inout] bcheckaccel set to false if the acceleration bound is within _maxmanipaccel
+    void _BoundRampManipSpeedAccel(const ParabolicRampInternal::ParabolicRampND& ramp, const ManipConstraintInfo& info, bool& bcheckspeed, bool& bcheckaccel) const
+    {
+        if( info.vdofreach.size() == 0 ) {
+            return;
+        }
+        // velocities of a parabolic ramp are piecewise linear, so the peaks are at the switch points
+        dReal fsumvel = 0, fsumreachvel = 0, fsumreachaccel = 0;
+        for(size_t index = 0; index < info.vdofreach.size(); ++index) {
+            const ParabolicRampInternal::ParabolicRamp1D& ramp1d = ramp.ramps.at(info.vconfigindices[index]);
+            dReal fmaxvel = max(max(RaveFabs(ramp1d.dx0), RaveFabs(ramp1d.dx1)), max(RaveFabs(ramp1d.v), RaveFabs(ramp1d.dx0 + ramp1d.a1*ramp1d.tswitch1)));
+            dReal fmaxaccel = max(RaveFabs(ramp1d.a1), RaveFabs(ramp1d.a2));
+            if( info.vdofreach[index] > 0 ) {
+                fsumvel += fmaxvel;
+            }
+            fsumreachvel += info.vdofreach[index]*fmaxvel;
+            fsumreachaccel += info.vdofreach[index]*fmaxaccel;
+        }
+        if( bcheckspeed && fsumreachvel <= _maxmanipspeed ) {
+            bcheckspeed = false;
+        }
+        // for revolute chains |d2p/dqi dqk| <= 2*min(reach_i,reach_k), so the centripetal and coriolis terms are bounded by 2*fsumvel*fsumreachvel
+        if( bcheckaccel && info.bAccelBound && fsumreachaccel + 2*fsumvel*fsumreachvel <= _maxmanipaccel ) {
+            bcheckaccel = false;
+        }
+    }
+
     EnvironmentBasePtr _penv;
     std::string _manipname;
     std::vector<KinBodyPtr> listUsedBodies;
@@ -403,8 +522,8 @@ private:
     //@{ cache
     std::list< ManipConstraintInfo > _listCheckManips; ///< the manipulators and the points on their end efffectors to check for velocity and acceleration constraints
     std::vector<dReal> ac, qfillactive, _vfillactive; // the active DOF
-    std::vector<dReal> _afill; // full robot DOF
-    std::vector<std::pair<Vector,Vector> > endeffvels, endeffaccs;
+    std::vector< std::pair<int, Vector> > _vlinkpositions;
+    std::vector<dReal> _vjacobians, _vhessiantrans, _vhessianangle;
     std::vector<dReal> _vtransjacobian, _vangularjacobian, _vbestvels2, _vbestaccels2;
     //@}
 };
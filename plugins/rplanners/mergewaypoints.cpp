@@ -258,6 +258,14 @@ bool MergeRamps(const ParabolicRamp::ParabolicRampND& ramp0, const ParabolicRamp
     return true;
 }
 
+/// \brief replaces the three ramps starting at index by resramp0 and resramp1, in place
+void ReplaceThreeRamps(std::vector<ParabolicRamp::ParabolicRampND>& ramps, size_t index, const ParabolicRamp::ParabolicRampND& resramp0, const ParabolicRamp::ParabolicRampND& resramp1)
+{
+    ramps[index] = resramp0;
+    ramps[index+1] = resramp1;
+    ramps.erase(ramps.begin()+index+2);
+}
+
 // Small function to compute the factorial of a number
 int factorial(int n)
 {
@@ -269,14 +277,14 @@ int factorial(int n)
    \param ramps input ramps
    \param desireddurations list of desired durations
  */
-bool IterativeFixRamps(std::list<ParabolicRamp::ParabolicRampND>& ramps, std::list<dReal>& desireddurations, ConstraintTrajectoryTimingParametersPtr params)
+bool IterativeFixRamps(std::vector<ParabolicRamp::ParabolicRampND>& ramps, std::vector<dReal>& desireddurations, ConstraintTrajectoryTimingParametersPtr params)
 {
     OPENRAVE_ASSERT_OP(ramps.size(),==,desireddurations.size());
     if( ramps.size() == 0) {
         return false;
     }
     if (ramps.size() == 1) {
-        std::list<ParabolicRamp::ParabolicRampND> resramps;
+        std::vector<ParabolicRamp::ParabolicRampND> resramps;
         dReal coef = desireddurations.back()/ramps.back().endTime;
         // make sure trysmart is false, or otherwise can get into infinite loop
         bool res = ScaleRampsTime(ramps,resramps,coef,false,params);
@@ -289,10 +297,10 @@ bool IterativeFixRamps(std::list<ParabolicRamp::ParabolicRampND>& ramps, std::li
         }
     }
     ParabolicRamp::ParabolicRampND resramp0,resramp1;
-    std::list<ParabolicRamp::ParabolicRampND>::iterator itrampprev = ramps.begin(), itrampnext;
+    std::vector<ParabolicRamp::ParabolicRampND>::iterator itrampprev = ramps.begin(), itrampnext;
     itrampnext = itrampprev;
     ++itrampnext;
-    std::list<dReal>::iterator ittprev = desireddurations.begin(), ittnext;
+    std::vector<dReal>::iterator ittprev = desireddurations.begin(), ittnext;
     ittnext = ittprev;
     ++ittnext;
 
@@ -353,7 +361,7 @@ bool IterativeFixRamps(std::list<ParabolicRamp::ParabolicRampND>& ramps, std::li
     \param ramps result ramps
     \param v3 the velocity at the end of the ramp at T2
  */
-bool IterativeMergeRampsFixedTime(const std::list<ParabolicRamp::ParabolicRampND>& origramps, std::list<ParabolicRamp::ParabolicRampND>& ramps, ConstraintTrajectoryTimingParametersPtr params, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler)
+bool IterativeMergeRampsFixedTime(const std::vector<ParabolicRamp::ParabolicRampND>& origramps, std::vector<ParabolicRamp::ParabolicRampND>& ramps, ConstraintTrajectoryTimingParametersPtr params, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler)
 {
     // Determine the number max of iterations as a function of the number of short ramps
     size_t i = 0;
@@ -368,6 +376,7 @@ bool IterativeMergeRampsFixedTime(const std::list<ParabolicRamp::ParabolicRampND
 
     int itersi=0;
     bool solvedglobal = false;
+    ParabolicRamp::ParabolicRampND resramp0,resramp1;
 
     // This loop could be optimized by caching and re-using results of permutations that begin similarly
     // can also do a uniform random sampling of permutations
@@ -404,25 +413,11 @@ bool IterativeMergeRampsFixedTime(const std::list<ParabolicRamp::ParabolicRampND
                 i++;
             }
             int jramp = invalidrampindices[uniformsampler->SampleSequenceOneUInt32()%invalidrampindices.size()];
-            std::list<ParabolicRamp::ParabolicRampND>::iterator itlist = ramps.begin();
-            std::advance(itlist,jramp+1);
-            ParabolicRamp::ParabolicRampND ramp0,ramp1,ramp2,resramp0,resramp1;
-            ramp2 =*itlist;
-            itlist--;
-            ramp1 = *itlist;
-            itlist--;
-            ramp0 = *itlist;
-            bool res = MergeRamps(ramp0,ramp1,ramp2,resramp0,resramp1,params);
-            if(!res) {
+            if(!MergeRamps(ramps[jramp-1],ramps[jramp],ramps[jramp+1],resramp0,resramp1,params)) {
                 solved = false;
                 break;
             }
-            itlist = ramps.erase(itlist);
-            itlist = ramps.erase(itlist);
-            itlist = ramps.erase(itlist);
-            ramps.insert(itlist,resramp1);
-            itlist--;
-            ramps.insert(itlist,resramp0);
+            ReplaceThreeRamps(ramps,jramp-1,resramp0,resramp1);
         }
         if(!solved) {
             continue;
@@ -433,25 +428,11 @@ bool IterativeMergeRampsFixedTime(const std::list<ParabolicRamp::ParabolicRampND
                 solved = false;
                 break;
             }
-            std::list<ParabolicRamp::ParabolicRampND>::iterator itlist = ramps.begin();
-            std::advance(itlist,2);
-            ParabolicRamp::ParabolicRampND ramp0,ramp1,ramp2,resramp0,resramp1;
-            ramp2 =*itlist;
-            itlist--;
-            ramp1 = *itlist;
-            itlist--;
-            ramp0 = *itlist;
-            bool res = MergeRamps(ramp0,ramp1,ramp2,resramp0,resramp1,params);
-            if(!res) {
+            if(!MergeRamps(ramps[0],ramps[1],ramps[2],resramp0,resramp1,params)) {
                 solved = false;
                 break;
             }
-            itlist = ramps.erase(itlist);
-            itlist = ramps.erase(itlist);
-            itlist = ramps.erase(itlist);
-            ramps.insert(itlist,resramp1);
-            itlist--;
-            ramps.insert(itlist,resramp0);
+            ReplaceThreeRamps(ramps,0,resramp0,resramp1);
         }
         if(!solved) {
             continue;
@@ -462,25 +443,12 @@ bool IterativeMergeRampsFixedTime(const std::list<ParabolicRamp::ParabolicRampND
                 solved= false;
                 break;
             }
-            std::list<ParabolicRamp::ParabolicRampND>::iterator itlist = ramps.end();
-            itlist--;
-            ParabolicRamp::ParabolicRampND ramp0,ramp1,ramp2,resramp0,resramp1;
-            ramp2 =*itlist;
-            itlist--;
-            ramp1 = *itlist;
-            itlist--;
-            ramp0 = *itlist;
-            bool res = MergeRamps(ramp0,ramp1,ramp2,resramp0,resramp1,params);
-            if(!res) {
+            size_t index = ramps.size()-3;
+            if(!MergeRamps(ramps[index],ramps[index+1],ramps[index+2],resramp0,resramp1,params)) {
                 solved= false;
                 break;
             }
-            itlist = ramps.erase(itlist);
-            itlist = ramps.erase(itlist);
-            itlist = ramps.erase(itlist);
-            ramps.insert(itlist,resramp1);
-            itlist--;
-            ramps.insert(itlist,resramp0);
+            ReplaceThreeRamps(ramps,index,resramp0,resramp1);
         }
         if (solved) {
             solvedglobal=true;
@@ -490,7 +458,7 @@ bool IterativeMergeRampsFixedTime(const std::list<ParabolicRamp::ParabolicRampND
         return false;
     }
     if (checkcontrollertime) {
-        std::list<dReal> desireddurations;
+        std::vector<dReal> desireddurations;
         desireddurations.resize(0);
         FOREACHC(itramp, ramps) {
             desireddurations.push_back(ComputeStepSizeCeiling(itramp->endTime,params->_fStepLength));
@@ -502,7 +470,7 @@ bool IterativeMergeRampsFixedTime(const std::list<ParabolicRamp::ParabolicRampND
     }
 }
 
-bool ScaleRampsTime(const std::list<ParabolicRamp::ParabolicRampND>& origramps, std::list<ParabolicRamp::ParabolicRampND>& ramps, dReal coef, bool trysmart, ConstraintTrajectoryTimingParametersPtr params)
+bool ScaleRampsTime(const std::vector<ParabolicRamp::ParabolicRampND>& origramps, std::vector<ParabolicRamp::ParabolicRampND>& ramps, dReal coef, bool trysmart, ConstraintTrajectoryTimingParametersPtr params)
 {
     ramps.resize(0);
     bool doscale = RaveFabs(coef-1)>TINY;
@@ -520,7 +488,7 @@ bool ScaleRampsTime(const std::list<ParabolicRamp::ParabolicRampND>& origramps,
             coef = 1+ (coef-1)*durationbeforescaling/durationmodifiedramps;
             ramps = origramps;
 
-            std::list<dReal> desireddurations;
+            std::vector<dReal> desireddurations;
             desireddurations.resize(0);
             FOREACHC(itramp, ramps) {
                 dReal newtime = itramp->endTime;
@@ -566,7 +534,7 @@ bool ScaleRampsTime(const std::list<ParabolicRamp::ParabolicRampND>& origramps,
 }
 
 // Check whether ramps satisfy constraints associated with checker
-bool CheckRamps(std::list<ParabolicRamp::ParabolicRampND>&ramps, ParabolicRamp::RampFeasibilityChecker& check,int options = 0xffff)
+bool CheckRamps(std::vector<ParabolicRamp::ParabolicRampND>&ramps, ParabolicRamp::RampFeasibilityChecker& check,int options = 0xffff)
 {
     FOREACHC(itramp,ramps) {
         if(!itramp->IsValid() || !check.Check(*itramp,options)) {
@@ -683,7 +651,7 @@ bool SpecialCheckRamp(const ParabolicRamp::ParabolicRampND& ramp,const Parabolic
 
 
 
-dReal ComputeRampQuality(const std::list<ParabolicRamp::ParabolicRampND>& ramps)
+dReal ComputeRampQuality(const std::vector<ParabolicRamp::ParabolicRampND>& ramps)
 {
     dReal res=0;
     FOREACHC(itramp,ramps) {
@@ -699,25 +667,20 @@ dReal ComputeRampQuality(const std::list<ParabolicRamp::ParabolicRampND>& ramps)
     return 1/res;
 }
 
-bool FurtherMergeRamps(const std::list<ParabolicRamp::ParabolicRampND>&origramps,std::list<ParabolicRamp::ParabolicRampND>&resramps, ConstraintTrajectoryTimingParametersPtr params, dReal upperbound, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler, ParabolicRamp::RampFeasibilityChecker& check, int options)
+bool FurtherMergeRamps(const std::vector<ParabolicRamp::ParabolicRampND>&origramps,std::vector<ParabolicRamp::ParabolicRampND>&resramps, ConstraintTrajectoryTimingParametersPtr params, dReal upperbound, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler, ParabolicRamp::RampFeasibilityChecker& check, int options)
 {
     //int nitersfurthermerge = params->nitersfurthermerge;
     int nitersfurthermerge = 0;
     resramps = origramps;
     bool bHasChanged = false;
-    std::list<ParabolicRamp::ParabolicRampND> ramps;
+    std::vector<ParabolicRamp::ParabolicRampND> ramps;
+    ParabolicRamp::ParabolicRampND resramp0,resramp1,resramp0x,resramp1x;
     dReal origrampsduration = ComputeRampsDuration(origramps);
     for(int rep = 0; rep<nitersfurthermerge; rep++) {
         ramps = origramps;
         while(ramps.size()>=3) {
-            std::list<ParabolicRamp::ParabolicRampND>::iterator itlist = ramps.begin();
             int randidx = uniformsampler->SampleSequenceOneUInt32()%(ramps.size()-2);
-            std::advance(itlist,randidx);
-            ParabolicRamp::ParabolicRampND ramp0,ramp1,ramp2,resramp0,resramp1,resramp0x,resramp1x;
-            ramp0 = *itlist++;
-            ramp1 = *itlist++;
-            ramp2 = *itlist++;
-            bool resmerge = MergeRamps(ramp0,ramp1,ramp2,resramp0,resramp1,params);
+            bool resmerge = MergeRamps(ramps[randidx],ramps[randidx+1],ramps[randidx+2],resramp0,resramp1,params);
             if(!resmerge) {
                 break;
             }
@@ -731,14 +694,7 @@ bool FurtherMergeRamps(const std::list<ParabolicRamp::ParabolicRampND>&origramps
                 break;
             }
             bHasChanged = true;
-            itlist--;
-            itlist--;
-            itlist = ramps.erase(itlist);
-            itlist = ramps.erase(itlist);
-            itlist = ramps.erase(itlist);
-            ramps.insert(itlist,resramp1x);
-            itlist--;
-            ramps.insert(itlist,resramp0x);
+            ReplaceThreeRamps(ramps,randidx,resramp0x,resramp1x);
         }
         //PrintRamps(ramps,params,true);
         if(ramps.size()<resramps.size() || (ramps.size()==resramps.size()&& ComputeRampQuality(ramps)>ComputeRampQuality(resramps))) {
@@ -749,59 +705,128 @@ bool FurtherMergeRamps(const std::list<ParabolicRamp::ParabolicRampND>&origramps
     return bHasChanged;
 }
 
-bool IterativeMergeRamps(const std::list<ParabolicRamp::ParabolicRampND>&origramps,std::list<ParabolicRamp::ParabolicRampND>&resramps, ConstraintTrajectoryTimingParametersPtr params, dReal upperbound, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler, ParabolicRamp::RampFeasibilityChecker& check, int options)
+bool EvaluateMergeCoefficient(const std::vector<ParabolicRamp::ParabolicRampND>& origramps, std::vector<ParabolicRamp::ParabolicRampND>& resramps, dReal coef, ConstraintTrajectoryTimingParametersPtr params, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler, ParabolicRamp::RampFeasibilityChecker& check, int options)
 {
-    std::list<ParabolicRamp::ParabolicRampND> ramps,ramps2;
+    if( coef == 1 ) {
+        return IterativeMergeRampsFixedTime(origramps, resramps, params, checkcontrollertime, uniformsampler) && CheckRamps(resramps,check,options);
+    }
+    std::vector<ParabolicRamp::ParabolicRampND> ramps;
+    if( !ScaleRampsTime(origramps, ramps, coef, true, params) ) {
+        return false;
+    }
+    return IterativeMergeRampsFixedTime(ramps, resramps, params, checkcontrollertime, uniformsampler) && CheckRamps(resramps,check,options);
+}
+
+bool IterativeMergeRamps(const std::vector<ParabolicRamp::ParabolicRampND>&origramps,std::vector<ParabolicRamp::ParabolicRampND>&resramps, ConstraintTrajectoryTimingParametersPtr params, dReal upperbound, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler, ParabolicRamp::RampFeasibilityChecker& check, int options, MergeStatistics* pstatistics)
+{
+    std::vector<ParabolicRamp::ParabolicRampND> ramps2;
     dReal testcoef;
+    uint64_t starttime = utils::GetMicroTime();
+    int numcandidates = 1;
+    if( !!pstatistics ) {
+        pstatistics->numsearches++;
+    }
 
     //printf("Coef = 1\n");
-    bool res = IterativeMergeRampsFixedTime(origramps, ramps2, params, checkcontrollertime, uniformsampler);
-    res = res &&  CheckRamps(ramps2,check,options);
+    bool res = EvaluateMergeCoefficient(origramps, ramps2, 1, params, checkcontrollertime, uniformsampler, check, options);
     if (res) {
         resramps.swap(ramps2);
-        return true;
     }
-    dReal durationbeforemerge = ComputeRampsDuration(origramps);
-    dReal maxcoef = upperbound;
-    //printf("Coef = %f\n",maxcoef);
-    bool canscale = ScaleRampsTime(origramps, ramps, maxcoef, true, params);
-    if(!canscale) {
-        return false;
+    else {
+        dReal durationbeforemerge = ComputeRampsDuration(origramps);
+        dReal maxcoef = upperbound;
+        //printf("Coef = %f\n",maxcoef);
+        numcandidates++;
+        res = EvaluateMergeCoefficient(origramps, ramps2, maxcoef, params, checkcontrollertime, uniformsampler, check, options);
+        if (res) {
+            resramps.swap(ramps2);
+
+            dReal hi = maxcoef;
+            dReal lo = 1;
+            while ((hi-lo)*durationbeforemerge > params->_fStepLength) {
+                testcoef = (hi+lo)/2;
+                //printf("Coef = %f\n",testcoef);
+                numcandidates++;
+                if( EvaluateMergeCoefficient(origramps, ramps2, testcoef, params, checkcontrollertime, uniformsampler, check, options) ) {
+                    hi = testcoef;
+                    resramps.swap(ramps2);
+                }
+                else{
+                    lo = testcoef;
+                }
+            }
+        }
     }
-    res = IterativeMergeRampsFixedTime(ramps, ramps2, params, checkcontrollertime, uniformsampler);
-    res = res && CheckRamps(ramps2,check,options);
-    if (!res) {
-        return false;
+    if( !!pstatistics ) {
+        pstatistics->numiterations += numcandidates;
+        pstatistics->numcandidates += numcandidates;
+        pstatistics->fcandidateduration += 1e-6*(utils::GetMicroTime()-starttime);
     }
-    resramps.swap(ramps2);
+    return res;
+}
 
-    dReal hi = maxcoef;
-    dReal lo = 1;
-    while ((hi-lo)*durationbeforemerge > params->_fStepLength) {
-        testcoef = (hi+lo)/2;
-        //printf("Coef = %f\n",testcoef);
-        bool canscale2 = ScaleRampsTime(origramps,ramps,testcoef,true,params);
-        if(!canscale2) {
-            lo = testcoef;
-            continue;
+bool IterativeMergeRampsParallel(const std::vector<ParabolicRamp::ParabolicRampND>& origramps,std::vector<ParabolicRamp::ParabolicRampND>& resramps, ConstraintTrajectoryTimingParametersPtr params, dReal upperbound, int numcandidates, const MergeCandidatesFn& candidatesfn, MergeStatistics* pstatistics)
+{
+    BOOST_ASSERT(numcandidates >= 2);
+    dReal durationbeforemerge = ComputeRampsDuration(origramps);
+    std::vector<dReal> vcoefs(numcandidates);
+    std::vector<uint8_t> vresults;
+    std::vector< std::vector<ParabolicRamp::ParabolicRampND> > vresramps(numcandidates);
+    if( !!pstatistics ) {
+        pstatistics->numsearches++;
+    }
+
+    dReal lo = 1, hi = upperbound;
+    bool bfirst = true;
+    while( bfirst || (hi-lo)*durationbeforemerge > params->_fStepLength ) {
+        for(int i = 0; i < numcandidates; ++i) {
+            // the first iteration includes both 1 and upperbound, the bounds of the later ones are already known
+            vcoefs[i] = bfirst ? lo + (hi-lo)*i/(numcandidates-1) : lo + (hi-lo)*(i+1)/(numcandidates+1);
+        }
+        vresults.resize(0);
+        vresults.resize(numcandidates, 0);
+        uint64_t starttime = utils::GetMicroTime();
+        candidatesfn(origramps, vcoefs, vresults, vresramps);
+        if( !!pstatistics ) {
+            pstatistics->numiterations++;
+            pstatistics->numcandidates += numcandidates;
+            pstatistics->fcandidateduration += 1e-6*(utils::GetMicroTime()-starttime);
+        }
+
+        // like the dichotomy, assume that all the coefficients above a feasible one are feasible
+        int ifeasible = -1;
+        for(int i = 0; i < numcandidates; ++i) {
+            if( vresults[i] ) {
+                ifeasible = i;
+                break;
+            }
         }
-        res = IterativeMergeRampsFixedTime(ramps, ramps2, params, checkcontrollertime, uniformsampler);
-        res = res && CheckRamps(ramps2,check,options);
-        if(res) {
-            hi = testcoef;
-            resramps.swap(ramps2);
+        if( ifeasible < 0 ) {
+            if( bfirst ) {
+                return false;
+            }
+            lo = vcoefs.back();
         }
-        else{
-            lo = testcoef;
+        else {
+            resramps.swap(vresramps[ifeasible]);
+            if( bfirst && ifeasible == 0 ) {
+                // no need to scale
+                return true;
+            }
+            hi = vcoefs[ifeasible];
+            if( ifeasible > 0 ) {
+                lo = vcoefs[ifeasible-1];
+            }
         }
+        bfirst = false;
     }
     return true;
 }
 
 
-bool IterativeMergeRampsNoDichotomy(const std::list<ParabolicRamp::ParabolicRampND>&origramps,std::list<ParabolicRamp::ParabolicRampND>&resramps, ConstraintTrajectoryTimingParametersPtr params, dReal upperbound, dReal stepsize, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler, ParabolicRamp::RampFeasibilityChecker& check, int options)
+bool IterativeMergeRampsNoDichotomy(const std::vector<ParabolicRamp::ParabolicRampND>&origramps,std::vector<ParabolicRamp::ParabolicRampND>&resramps, ConstraintTrajectoryTimingParametersPtr params, dReal upperbound, dReal stepsize, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler, ParabolicRamp::RampFeasibilityChecker& check, int options)
 {
-    std::list<ParabolicRamp::ParabolicRampND> ramps;
+    std::vector<ParabolicRamp::ParabolicRampND> ramps;
     for(dReal testcoef=1; testcoef<=upperbound; testcoef+=stepsize) {
         bool canscale = ScaleRampsTime(origramps,ramps,testcoef,true,params);
         if(!canscale) {
@@ -836,7 +861,7 @@ ParabolicRamp::Vector AddVectors(ParabolicRamp::Vector a,ParabolicRamp::Vector b
 }
 
 
-bool ComputeLinearRampsWithConstraints(std::list<ParabolicRamp::ParabolicRampND>& resramps, const ParabolicRamp::Vector x0, const ParabolicRamp::Vector x1, ConstraintTrajectoryTimingParametersPtr params, ParabolicRamp::RampFeasibilityChecker& check,int options)
+bool ComputeLinearRampsWithConstraints(std::vector<ParabolicRamp::ParabolicRampND>& resramps, const ParabolicRamp::Vector x0, const ParabolicRamp::Vector x1, ConstraintTrajectoryTimingParametersPtr params, ParabolicRamp::RampFeasibilityChecker& check,int options)
 {
     ParabolicRamp::Vector zero(x0.size(),0.0);
     ParabolicRamp::Vector dx = AddVectors(x1,x0,1,-1);
@@ -929,11 +954,11 @@ bool ComputeLinearRampsWithConstraints(std::list<ParabolicRamp::ParabolicRampND>
 
 
 
-bool ComputeLinearRampsWithConstraints2(std::list<ParabolicRamp::ParabolicRampND>& resramps, const ParabolicRamp::Vector x0, const ParabolicRamp::Vector x1, ConstraintTrajectoryTimingParametersPtr params, ParabolicRamp::RampFeasibilityChecker& check,int options)
+bool ComputeLinearRampsWithConstraints2(std::vector<ParabolicRamp::ParabolicRampND>& resramps, const ParabolicRamp::Vector x0, const ParabolicRamp::Vector x1, ConstraintTrajectoryTimingParametersPtr params, ParabolicRamp::RampFeasibilityChecker& check,int options)
 {
     ParabolicRamp::Vector zero(x0.size(),0.0);
     ParabolicRamp::ParabolicRampND newramp;
-    std::list<ParabolicRamp::ParabolicRampND> tmpramps;
+    std::vector<ParabolicRamp::ParabolicRampND> tmpramps;
     newramp.x0 = x0;
     newramp.x1 = x1;
     newramp.dx0 = zero;
@@ -987,7 +1012,7 @@ bool ComputeLinearRampsWithConstraints2(std::list<ParabolicRamp::ParabolicRampND
             }
             else{
                 lo = coef;
-                resramps = tmpramps;
+                resramps.swap(tmpramps);
                 solved = true;
                 if(coef >= 1) {
                     break;
@@ -1000,10 +1025,10 @@ bool ComputeLinearRampsWithConstraints2(std::list<ParabolicRamp::ParabolicRampND
 }
 
 
-bool ComputeQuadraticRampsWithConstraints(std::list<ParabolicRamp::ParabolicRampND>& resramps, const ParabolicRamp::Vector x0, const ParabolicRamp::Vector dx0, const ParabolicRamp::Vector x1, const ParabolicRamp::Vector dx1, dReal fOriginalTrajectorySegmentTime, ConstraintTrajectoryTimingParametersPtr params, ParabolicRamp::RampFeasibilityChecker& check, int options)
+bool ComputeQuadraticRampsWithConstraints(std::vector<ParabolicRamp::ParabolicRampND>& resramps, const ParabolicRamp::Vector x0, const ParabolicRamp::Vector dx0, const ParabolicRamp::Vector x1, const ParabolicRamp::Vector dx1, dReal fOriginalTrajectorySegmentTime, ConstraintTrajectoryTimingParametersPtr params, ParabolicRamp::RampFeasibilityChecker& check, int options)
 {
     std::vector<std::vector<ParabolicRamp::ParabolicRamp1D> > tmpramps1d;
-    std::list<ParabolicRamp::ParabolicRampND> tmpramps;
+    std::vector<ParabolicRamp::ParabolicRampND> tmpramps;
     dReal mintime;
     bool solved = false;
     int numdof = params->GetDOF();
@@ -1059,7 +1084,7 @@ bool ComputeQuadraticRampsWithConstraints(std::list<ParabolicRamp::ParabolicRamp
             }
             else{
                 lo = coef;
-                resramps = tmpramps;
+                resramps.swap(tmpramps);
                 //RAVELOG_VERBOSE("OK\n");
                 solved = true;
                 if(coef>=1) {
@@ -1119,13 +1144,13 @@ bool AreRampsCollinear(ParabolicRamp::ParabolicRampND& ramp0,ParabolicRamp::Para
     return RaveFabs(dotproduct*dotproduct - x0length2*x1length2) <= TINY;
 }
 
-bool FixRampsEnds(std::list<ParabolicRamp::ParabolicRampND>&origramps,std::list<ParabolicRamp::ParabolicRampND>&resramps, ConstraintTrajectoryTimingParametersPtr params, ParabolicRamp::RampFeasibilityChecker& check, int options)
+bool FixRampsEnds(std::vector<ParabolicRamp::ParabolicRampND>&origramps,std::vector<ParabolicRamp::ParabolicRampND>&resramps, ConstraintTrajectoryTimingParametersPtr params, ParabolicRamp::RampFeasibilityChecker& check, int options)
 {
     if (origramps.size()<2) {
         return false;
     }
     bool jittered = false;
-    std::list<ParabolicRamp::ParabolicRampND>::iterator itramp0 = origramps.begin(),itramp1,itramp2;
+    std::vector<ParabolicRamp::ParabolicRampND>::iterator itramp0 = origramps.begin(),itramp1;
 
     if(!params->verifyinitialpath) {
         RAVELOG_WARN("Initial path verification is disabled (in FixRampsEnds)\n");
@@ -1139,7 +1164,7 @@ bool FixRampsEnds(std::list<ParabolicRamp::ParabolicRampND>&origramps,std::list<
     if (CheckIfZero(itramp0->dx0, ParabolicRamp::EpsilonV) && CheckIfZero(itramp1->dx1, ParabolicRamp::EpsilonV) && AreRampsCollinear(*itramp0,*itramp1)) {
         RAVELOG_DEBUG("First two ramps probably come from a jittering operation\n");
         jittered = true;
-        std::list<ParabolicRamp::ParabolicRampND> tmpramps0, tmpramps1;
+        std::vector<ParabolicRamp::ParabolicRampND> tmpramps0, tmpramps1;
         bool res = ComputeLinearRampsWithConstraints(tmpramps0,itramp0->x0,itramp1->x1,params,check,options);
         if(!res) {
             RAVELOG_WARN("Could not make straight ramps out of the two ramps\n");
@@ -1152,14 +1177,8 @@ bool FixRampsEnds(std::list<ParabolicRamp::ParabolicRampND>&origramps,std::list<
             return false;
         }
         // Insert at beginning
-        resramps.resize(0);
-        resramps.splice(resramps.begin(),tmpramps1);
-        itramp0 = origramps.begin();
-        advance(itramp0,2);
-        while(itramp0!=origramps.end()) {
-            resramps.push_back(*itramp0);
-            itramp0++;
-        }
+        resramps.swap(tmpramps1);
+        resramps.insert(resramps.end(),origramps.begin()+2,origramps.end());
     }
     if(!jittered) {
         resramps = origramps;
@@ -1173,7 +1192,7 @@ bool FixRampsEnds(std::list<ParabolicRamp::ParabolicRampND>&origramps,std::list<
     if (CheckIfZero(itramp0->dx0, ParabolicRamp::EpsilonV) && CheckIfZero(itramp1->dx1, ParabolicRamp::EpsilonV) && AreRampsCollinear(*itramp0,*itramp1)) {
         jittered = true;
         RAVELOG_DEBUG("Last two ramps probably come from a jittering operation\n");
-        std::list<ParabolicRamp::ParabolicRampND> tmpramps0, tmpramps1;
+        std::vector<ParabolicRamp::ParabolicRampND> tmpramps0, tmpramps1;
         bool res = ComputeLinearRampsWithConstraints(tmpramps0,itramp0->x0,itramp1->x1,params,check,options);
         if(!res) {
             RAVELOG_WARN("Could not make straight ramps out of the two ramps\n");
@@ -1186,26 +1205,14 @@ bool FixRampsEnds(std::list<ParabolicRamp::ParabolicRampND>&origramps,std::list<
             return false;
         }
         // Insert at end
-        std::list<ParabolicRamp::ParabolicRampND> resramps2;
-        itramp0 = resramps.begin();
-        while(itramp0!=resramps.end()) {
-            itramp1=itramp0;
-            itramp1++;
-            itramp2=itramp1;
-            itramp2++;
-            if(itramp1!=resramps.end() && itramp2!=resramps.end()) {
-                resramps2.push_back(*itramp0);
-            }
-            itramp0 = itramp1;
-        }
-        resramps2.splice(resramps2.end(),tmpramps1);
-        resramps.swap(resramps2);
+        resramps.resize(resramps.size()-2);
+        resramps.insert(resramps.end(),tmpramps1.begin(),tmpramps1.end());
     }
 
     // Final check to make sure everything is right
     if(jittered) {
         BreakIntoUnitaryRamps(resramps);
-        std::list<dReal> desireddurations;
+        std::vector<dReal> desireddurations;
         desireddurations.resize(0);
         FOREACHC(itramp, resramps) {
             desireddurations.push_back(ComputeStepSizeCeiling(itramp->endTime,params->_fStepLength));
@@ -1258,7 +1265,7 @@ dReal DetermineMinswitchtime(const ParabolicRamp::ParabolicRampND& rampnd)
     return res;
 }
 
-dReal DetermineMinswitchtime(const std::list<ParabolicRamp::ParabolicRampND>&ramps)
+dReal DetermineMinswitchtime(const std::vector<ParabolicRamp::ParabolicRampND>&ramps)
 {
     if( ramps.size() == 0 ) {
         return 0;
@@ -1270,7 +1277,7 @@ dReal DetermineMinswitchtime(const std::list<ParabolicRamp::ParabolicRampND>&ram
     return mintime;
 }
 
-size_t CountUnitaryRamps(const std::list<ParabolicRamp::ParabolicRampND>& ramps)
+size_t CountUnitaryRamps(const std::vector<ParabolicRamp::ParabolicRampND>& ramps)
 {
     size_t nbunitramps = 0;
     FOREACHC(itramp,ramps) {
@@ -1314,7 +1321,7 @@ size_t CountUnitaryRamps(const ParabolicRamp::ParabolicRampND& rampnd)
     return result;
 }
 
-dReal ComputeRampsDuration(const std::list<ParabolicRamp::ParabolicRampND>&ramps)
+dReal ComputeRampsDuration(const std::vector<ParabolicRamp::ParabolicRampND>&ramps)
 {
     dReal res=0;
     FOREACH(itramp, ramps) {
@@ -1324,7 +1331,7 @@ dReal ComputeRampsDuration(const std::list<ParabolicRamp::ParabolicRampND>&ramps
 }
 
 // For logging purpose
-void PrintRamps(const std::list<ParabolicRamp::ParabolicRampND>&ramps,ConstraintTrajectoryTimingParametersPtr params,bool checkcontrollertimestep)
+void PrintRamps(const std::vector<ParabolicRamp::ParabolicRampND>&ramps,ConstraintTrajectoryTimingParametersPtr params,bool checkcontrollertimestep)
 {
     int itx = 0;
     dReal totaltime = 0;
@@ -1356,9 +1363,9 @@ void PrintRamps(const std::list<ParabolicRamp::ParabolicRampND>&ramps,Constraint
 
 /** Break one ramp into unitary ramps. A unitary ramp consists of a single acceleration
     \param ramp input ramp
-    \param resramp result ramp
+    \param resramp the unitary ramps are appended to it
  */
-void BreakOneRamp(ParabolicRamp::ParabolicRampND ramp,std::list<ParabolicRamp::ParabolicRampND>&resramp)
+void BreakOneRamp(const ParabolicRamp::ParabolicRampND& ramp,std::vector<ParabolicRamp::ParabolicRampND>&resramp)
 {
     vector<dReal> vswitchtimes;
     vswitchtimes.resize(0);
@@ -1379,7 +1386,6 @@ void BreakOneRamp(ParabolicRamp::ParabolicRampND ramp,std::list<ParabolicRamp::P
         }
     }
     dReal tbeg,tend;
-    resramp.resize(0);
     tbeg = 0;
     for(size_t i=0; i<vswitchtimes.size(); i++) {
         ParabolicRamp::Vector q0,v0,q1,v1;
@@ -1399,12 +1405,12 @@ void BreakOneRamp(ParabolicRamp::ParabolicRampND ramp,std::list<ParabolicRamp::P
     }
 }
 
-void BreakIntoUnitaryRamps(std::list<ParabolicRamp::ParabolicRampND>& ramps)
+void BreakIntoUnitaryRamps(std::vector<ParabolicRamp::ParabolicRampND>& ramps)
 {
-    std::list<ParabolicRamp::ParabolicRampND> tmpramps,resramps;
+    std::vector<ParabolicRamp::ParabolicRampND> resramps;
+    resramps.reserve(ramps.size()*3);
     FOREACHC(itramp,ramps) {
-        BreakOneRamp(*itramp,tmpramps);
-        resramps.splice(resramps.end(),tmpramps);
+        BreakOneRamp(*itramp,resramps);
     }
     ramps.swap(resramps);
 }
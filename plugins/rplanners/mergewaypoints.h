@@ -28,7 +28,33 @@ namespace mergewaypoints
     \param precision precision in the dichotomy search for the best timescaling coef
     \param iters max number of random iterations
  */
-bool IterativeMergeRamps(const std::list<ParabolicRamp::ParabolicRampND>& origramps,std::list<ParabolicRamp::ParabolicRampND>& resramps, ConstraintTrajectoryTimingParametersPtr params, dReal upperbound, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler, ParabolicRamp::RampFeasibilityChecker& check, int options = 0xffff);
+/// \brief statistics of the time-scaling coefficient searches of IterativeMergeRamps and IterativeMergeRampsParallel
+struct MergeStatistics
+{
+    MergeStatistics() : numsearches(0), numiterations(0), numcandidates(0), fcandidateduration(0) {
+    }
+    int numsearches; ///< number of searches
+    int numiterations; ///< number of batches of coefficients, one coefficient per batch for IterativeMergeRamps
+    int numcandidates; ///< number of evaluated coefficients
+    dReal fcandidateduration; ///< seconds spent evaluating the batches
+};
+
+bool IterativeMergeRamps(const std::vector<ParabolicRamp::ParabolicRampND>& origramps,std::vector<ParabolicRamp::ParabolicRampND>& resramps, ConstraintTrajectoryTimingParametersPtr params, dReal upperbound, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler, ParabolicRamp::RampFeasibilityChecker& check, int options = 0xffff, MergeStatistics* pstatistics = NULL);
+
+/** Time-scale the ramps by coef, merge the ramps shorter than minswitchtime and check the result. This is the evaluation of one coefficient of IterativeMergeRamps
+    \param origramps input ramps, not scaled when coef is 1
+    \param resramps the merged ramps, only valid if true is returned
+ */
+bool EvaluateMergeCoefficient(const std::vector<ParabolicRamp::ParabolicRampND>& origramps, std::vector<ParabolicRamp::ParabolicRampND>& resramps, dReal coef, ConstraintTrajectoryTimingParametersPtr params, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler, ParabolicRamp::RampFeasibilityChecker& check, int options = 0xffff);
+
+/// \brief evaluates all the coefficients of vcoefs with EvaluateMergeCoefficient, sets vresults[i] to 1 and vresramps[i] to the merged ramps if vcoefs[i] is feasible
+typedef boost::function<void(const std::vector<ParabolicRamp::ParabolicRampND>& origramps, const std::vector<dReal>& vcoefs, std::vector<uint8_t>& vresults, std::vector< std::vector<ParabolicRamp::ParabolicRampND> >& vresramps)> MergeCandidatesFn;
+
+/** Same as IterativeMergeRamps but every iteration of the search evaluates numcandidates coefficients with candidatesfn, which usually checks them in parallel.
+    The interval of the coefficient shrinks by numcandidates+1 at every iteration instead of 2. The first iteration spreads the coefficients over [1, upperbound].
+    \param numcandidates number of coefficients per iteration, at least 2
+ */
+bool IterativeMergeRampsParallel(const std::vector<ParabolicRamp::ParabolicRampND>& origramps,std::vector<ParabolicRamp::ParabolicRampND>& resramps, ConstraintTrajectoryTimingParametersPtr params, dReal upperbound, int numcandidates, const MergeCandidatesFn& candidatesfn, MergeStatistics* pstatistics = NULL);
 
 /** Once the ramps are all OK, further merge ramps
     \param origramps input ramps
@@ -37,15 +63,15 @@ bool IterativeMergeRamps(const std::list<ParabolicRamp::ParabolicRampND>& origra
     \param precision precision in the dichotomy search for the best timescaling coef
     \param iters max number of random iterations
  */
-bool FurtherMergeRamps(const std::list<ParabolicRamp::ParabolicRampND>&origramps,std::list<ParabolicRamp::ParabolicRampND>&resramps, ConstraintTrajectoryTimingParametersPtr params, dReal upperbound, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler, ParabolicRamp::RampFeasibilityChecker& check, int options = 0xffff);
+bool FurtherMergeRamps(const std::vector<ParabolicRamp::ParabolicRampND>&origramps,std::vector<ParabolicRamp::ParabolicRampND>&resramps, ConstraintTrajectoryTimingParametersPtr params, dReal upperbound, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler, ParabolicRamp::RampFeasibilityChecker& check, int options = 0xffff);
 
 /** Same as IterativeMergeRamps but run a straightforward line search on the trajectory duration instead of dichotomy search
 **/
-bool IterativeMergeRampsNoDichotomy(const std::list<ParabolicRamp::ParabolicRampND>& origramps,std::list<ParabolicRamp::ParabolicRampND>& resramps, ConstraintTrajectoryTimingParametersPtr params, dReal upperbound, dReal stepsize, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler, ParabolicRamp::RampFeasibilityChecker& check, int options = 0xffff);
+bool IterativeMergeRampsNoDichotomy(const std::vector<ParabolicRamp::ParabolicRampND>& origramps,std::vector<ParabolicRamp::ParabolicRampND>& resramps, ConstraintTrajectoryTimingParametersPtr params, dReal upperbound, dReal stepsize, bool checkcontrollertime, SpaceSamplerBasePtr uniformsampler, ParabolicRamp::RampFeasibilityChecker& check, int options = 0xffff);
 
 /** If the beginning or the end of the ramps are linear segments then modify them to pass minswitchtime, controller timestep, and other constraints coming from the check object.
 **/
-bool FixRampsEnds(std::list<ParabolicRamp::ParabolicRampND>& origramps,std::list<ParabolicRamp::ParabolicRampND>& resramps, ConstraintTrajectoryTimingParametersPtr params, ParabolicRamp::RampFeasibilityChecker& check, int options = 0xffff);
+bool FixRampsEnds(std::vector<ParabolicRamp::ParabolicRampND>& origramps,std::vector<ParabolicRamp::ParabolicRampND>& resramps, ConstraintTrajectoryTimingParametersPtr params, ParabolicRamp::RampFeasibilityChecker& check, int options = 0xffff);
 
 /** Compute a straight ramp between x0 and x1, with initial and final velocities equal to zero. Assume that the straight path is collision free. Scale up time duration until the trajectory passes the dynamics check and satisfies minswitchtime and fStepLength conditions
     \param newramp the resulting ramp
@@ -53,11 +79,11 @@ bool FixRampsEnds(std::list<ParabolicRamp::ParabolicRampND>& origramps,std::list
     \param params planner parameters
     \param check checker for collision and dynamics
  **/
-bool ComputeLinearRampsWithConstraints(std::list<ParabolicRamp::ParabolicRampND>& resramps, const ParabolicRamp::Vector x0, const ParabolicRamp::Vector x1, ConstraintTrajectoryTimingParametersPtr params,ParabolicRamp::RampFeasibilityChecker& check, int options = 0xffff);
+bool ComputeLinearRampsWithConstraints(std::vector<ParabolicRamp::ParabolicRampND>& resramps, const ParabolicRamp::Vector x0, const ParabolicRamp::Vector x1, ConstraintTrajectoryTimingParametersPtr params,ParabolicRamp::RampFeasibilityChecker& check, int options = 0xffff);
 
 /// \param fOriginalTrajectorySegmentTime time duration of the original trajectory segment that will be shortcutted
 /// \param x0, x1, dx0, dx1 shortcutted trajectory segment endpoints
-bool ComputeQuadraticRampsWithConstraints(std::list<ParabolicRamp::ParabolicRampND>& resramps, const ParabolicRamp::Vector x0, const ParabolicRamp::Vector dx0, const ParabolicRamp::Vector x1, const ParabolicRamp::Vector dx1, dReal fOriginalTrajectorySegmentTime, ConstraintTrajectoryTimingParametersPtr params, ParabolicRamp::RampFeasibilityChecker& check, int options = 0xffff);
+bool ComputeQuadraticRampsWithConstraints(std::vector<ParabolicRamp::ParabolicRampND>& resramps, const ParabolicRamp::Vector x0, const ParabolicRamp::Vector dx0, const ParabolicRamp::Vector x1, const ParabolicRamp::Vector dx1, dReal fOriginalTrajectorySegmentTime, ConstraintTrajectoryTimingParametersPtr params, ParabolicRamp::RampFeasibilityChecker& check, int options = 0xffff);
 
 /** Timescale a ramp. Assume the ramp is unitary.
     \param origramps input ramp
@@ -66,18 +92,18 @@ bool ComputeQuadraticRampsWithConstraints(std::list<ParabolicRamp::ParabolicRamp
     \param trysmart if false, modify all the ramps by the constant factor. if true, then modify ramps whos modified field is true.
     \param flag
  */
-bool ScaleRampsTime(const std::list<ParabolicRamp::ParabolicRampND>& origramps,std::list<ParabolicRamp::ParabolicRampND>& ramps,dReal coef,bool trysmart, ConstraintTrajectoryTimingParametersPtr params);
+bool ScaleRampsTime(const std::vector<ParabolicRamp::ParabolicRampND>& origramps,std::vector<ParabolicRamp::ParabolicRampND>& ramps,dReal coef,bool trysmart, ConstraintTrajectoryTimingParametersPtr params);
 
 /** Determine the minimum switchtime in a ramp
     \param rampnd input ramp
  */
 dReal DetermineMinswitchtime(const ParabolicRamp::ParabolicRampND& rampnd);
-dReal DetermineMinswitchtime(const std::list<ParabolicRamp::ParabolicRampND>& ramps);
+dReal DetermineMinswitchtime(const std::vector<ParabolicRamp::ParabolicRampND>& ramps);
 
 /** Compute time duration of ramps
     \param rampnd input ramp
  */
-dReal ComputeRampsDuration(const std::list<ParabolicRamp::ParabolicRampND>& ramps);
+dReal ComputeRampsDuration(const std::vector<ParabolicRamp::ParabolicRampND>& ramps);
 
 
 /** Count the number of pieces in a ramp
@@ -85,21 +111,21 @@ dReal ComputeRampsDuration(const std::list<ParabolicRamp::ParabolicRampND>& ramp
  */
 size_t CountUnitaryRamps(const ParabolicRamp::ParabolicRampND& rampnd);
 
-size_t CountUnitaryRamps(const std::list<ParabolicRamp::ParabolicRampND>& ramps);
+size_t CountUnitaryRamps(const std::vector<ParabolicRamp::ParabolicRampND>& ramps);
 
-void PrintRamps(const std::list<ParabolicRamp::ParabolicRampND>& ramps,ConstraintTrajectoryTimingParametersPtr params,bool warning);
+void PrintRamps(const std::vector<ParabolicRamp::ParabolicRampND>& ramps,ConstraintTrajectoryTimingParametersPtr params,bool warning);
 
 /** Break ramps into unitary ramps (in place)
     \param ramps the ramps to be broken
  */
-void BreakIntoUnitaryRamps(std::list<ParabolicRamp::ParabolicRampND>& ramps);
+void BreakIntoUnitaryRamps(std::vector<ParabolicRamp::ParabolicRampND>& ramps);
 
 /// check if all numbers in the vector are zero
 bool CheckIfZero(const ParabolicRamp::Vector& v, dReal epsilon=g_fEpsilonLinear);
 
 // Provides a measure of quality of a ramps
 // Now set to the 1/sum(1/rampduration^2) toi penalize small ramps
-dReal ComputeRampQuality(const std::list<ParabolicRamp::ParabolicRampND>& ramps);
+dReal ComputeRampQuality(const std::vector<ParabolicRamp::ParabolicRampND>& ramps);
 
 // The parts of the ramps that are very close to qstart and qgoal are not checked with perturbations
 bool SpecialCheckRamp(const ParabolicRamp::ParabolicRampND& ramp,const ParabolicRamp::Vector& qstart, const ParabolicRamp::Vector& qgoal, dReal radius, ConstraintTrajectoryTimingParametersPtr params, ParabolicRamp::RampFeasibilityChecker& check, int options);
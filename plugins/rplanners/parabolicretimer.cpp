@@ -17,6 +17,7 @@
 #include <openrave/planningutils.h>
 
 #include "ParabolicPathSmooth/ParabolicRamp.h"
+#include <boost/thread/tss.hpp>
 
 namespace rplanners {
 
@@ -70,6 +71,23 @@ protected:
         }
     }
 
+    bool _IsMinimumTimeParallelizable() {
+        if( _bmanipconstraints ) {
+            // the manip constraints are checked by setting the robot
+            return false;
+        }
+        FOREACHC(itgroup, _listgroupinfo) {
+            if( (*itgroup)->grouptype != GT_JointValues ) {
+                return false;
+            }
+            if( !_parameters->_hasvelocities && (*itgroup)->orgveloffset >= 0 ) {
+                // the start velocity of a segment is only copied once the previous segment is timed
+                return false;
+            }
+        }
+        return true;
+    }
+
     bool _SupportInterpolation() {
         if( _parameters->_interpolation.size() == 0 ) {
             _parameters->_interpolation = "quadratic";
@@ -81,25 +99,32 @@ protected:
     }
 
     dReal _ComputeMinimumTimeJointValues(GroupInfoConstPtr info, std::vector<dReal>::const_iterator itorgdiff, std::vector<dReal>::const_iterator itdataprev, std::vector<dReal>::const_iterator itdata, bool bUseEndVelocity) {
-        
-        _v0pos.resize(info->gpos.dof);
-        _v1pos.resize(info->gpos.dof);
+        // called concurrently on different segments when _IsMinimumTimeParallelizable, so use the buffers of the calling thread
+        MinimumTimeCache* pcache = _mintimecache.get();
+        if( !pcache ) {
+            pcache = new MinimumTimeCache();
+            _mintimecache.reset(pcache);
+        }
+        ParabolicRamp::Vector& v0pos = pcache->v0pos, &v0vel = pcache->v0vel, &v1pos = pcache->v1pos, &v1vel = pcache->v1vel;
+        std::vector<std::vector<ParabolicRamp::ParabolicRamp1D> >& ramps = pcache->ramps;
+        v0pos.resize(info->gpos.dof);
+        v1pos.resize(info->gpos.dof);
         for(int i = 0; i < info->gpos.dof; ++i) {
-            _v0pos[i] = *(itdataprev+info->gpos.offset+i);
-            _v1pos[i] = _v0pos[i] + *(itorgdiff+info->orgposoffset+i);
+            v0pos[i] = *(itdataprev+info->gpos.offset+i);
+            v1pos[i] = v0pos[i] + *(itorgdiff+info->orgposoffset+i);
         }
-        _v0vel.resize(info->gvel.dof);
-        _v1vel.resize(info->gvel.dof);
+        v0vel.resize(info->gvel.dof);
+        v1vel.resize(info->gvel.dof);
         for(int i = 0; i < info->gvel.dof; ++i) {
-            _v0vel[i] = *(itdataprev+info->gvel.offset+i);
+            v0vel[i] = *(itdataprev+info->gvel.offset+i);
             if( bUseEndVelocity ) {
-                _v1vel[i] = *(itdata+info->gvel.offset+i);
+                v1vel[i] = *(itdata+info->gvel.offset+i);
             }
             else {
-                _v1vel[i] = 0;
+                v1vel[i] = 0;
             }
         }
-        _ramps.resize(info->gpos.dof);
+        ramps.resize(info->gpos.dof);
         dReal mintime = -1;
         
         // succeeded, check if manipulator constraints are in effect
@@ -116,15 +141,15 @@ protected:
             accellimits = info->_vConfigAccelerationLimit;
 
             // cannot use _parameters->SetStateValues...
-            pmanip->GetRobot()->SetDOFValues(_v0pos, KinBody::CLA_CheckLimits, pmanip->GetArmIndices());
-            _manipconstraintchecker->GetMaxVelocitiesAccelerations(_v0vel, vellimits, accellimits);
+            pmanip->GetRobot()->SetDOFValues(v0pos, KinBody::CLA_CheckLimits, pmanip->GetArmIndices());
+            _manipconstraintchecker->GetMaxVelocitiesAccelerations(v0vel, vellimits, accellimits);
 
-            pmanip->GetRobot()->SetDOFValues(_v1pos, KinBody::CLA_CheckLimits, pmanip->GetArmIndices());
-            _manipconstraintchecker->GetMaxVelocitiesAccelerations(_v1vel, vellimits, accellimits);
+            pmanip->GetRobot()->SetDOFValues(v1pos, KinBody::CLA_CheckLimits, pmanip->GetArmIndices());
+            _manipconstraintchecker->GetMaxVelocitiesAccelerations(v1vel, vellimits, accellimits);
 
             for(size_t j = 0; j < info->_vConfigVelocityLimit.size(); ++j) {
                 // have to watch out that velocities don't drop under dx0 & dx1!
-                dReal fminvel = max(RaveFabs(_v0vel[j]), RaveFabs(_v1vel[j]));
+                dReal fminvel = max(RaveFabs(v0vel[j]), RaveFabs(v1vel[j]));
                 if( vellimits[j] < fminvel ) {
                     vellimits[j] = fminvel;
                 }
@@ -143,7 +168,7 @@ protected:
             }
 
             for(size_t islowdowntry = 0; islowdowntry < 4; ++islowdowntry ) {
-                mintime = ParabolicRamp::SolveMinTimeBounded(_v0pos, _v0vel, _v1pos, _v1vel, accellimits, vellimits, info->_vConfigLowerLimit,info->_vConfigUpperLimit, _ramps, _parameters->_multidofinterp);
+                mintime = ParabolicRamp::SolveMinTimeBounded(v0pos, v0vel, v1pos, v1vel, accellimits, vellimits, info->_vConfigLowerLimit,info->_vConfigUpperLimit, ramps, _parameters->_multidofinterp);
                 if( mintime < 0 ) {
                     break;
                 }
@@ -152,7 +177,7 @@ protected:
                 }
 
                 _rampsnd.resize(0);
-                ParabolicRampInternal::CombineRamps(_ramps, _rampsnd);
+                ParabolicRampInternal::CombineRamps(ramps, _rampsnd);
                 ParabolicRampInternal::CheckReturn retseg = _manipconstraintchecker->CheckManipConstraints2(_rampsnd);
                 if( retseg.retcode == 0 ) {
                     break;
@@ -161,7 +186,7 @@ protected:
                 // have to slow down the ramp and check again
                 for(size_t j = 0; j < vellimits.size(); ++j) {
                     // have to watch out that velocities don't drop under dx0 & dx1!
-                    dReal fminvel = max(RaveFabs(_v0vel[j]), RaveFabs(_v1vel[j]));
+                    dReal fminvel = max(RaveFabs(v0vel[j]), RaveFabs(v1vel[j]));
                     vellimits[j] = max(vellimits[j]*retseg.fTimeBasedSurpassMult, fminvel);
                     accellimits[j] *= retseg.fTimeBasedSurpassMult;
                 }
@@ -173,11 +198,11 @@ protected:
         }
         else {
             // no manip constraints
-            mintime = ParabolicRamp::SolveMinTimeBounded(_v0pos, _v0vel, _v1pos, _v1vel, info->_vConfigAccelerationLimit, info->_vConfigVelocityLimit, info->_vConfigLowerLimit,info->_vConfigUpperLimit, _ramps,_parameters->_multidofinterp);
+            mintime = ParabolicRamp::SolveMinTimeBounded(v0pos, v0vel, v1pos, v1vel, info->_vConfigAccelerationLimit, info->_vConfigVelocityLimit, info->_vConfigLowerLimit,info->_vConfigUpperLimit, ramps,_parameters->_multidofinterp);
 #ifdef _DEBUG
             if( mintime < 0 && IS_DEBUGLEVEL(Level_Verbose) ) {
                 // do again for debugging reproduction
-                mintime = ParabolicRamp::SolveMinTimeBounded(_v0pos, _v0vel, _v1pos, _v1vel, info->_vConfigAccelerationLimit, info->_vConfigVelocityLimit, info->_vConfigLowerLimit,info->_vConfigUpperLimit, _ramps,_parameters->_multidofinterp);
+                mintime = ParabolicRamp::SolveMinTimeBounded(v0pos, v0vel, v1pos, v1vel, info->_vConfigAccelerationLimit, info->_vConfigVelocityLimit, info->_vConfigLowerLimit,info->_vConfigUpperLimit, ramps,_parameters->_multidofinterp);
             }
 #endif
         }
@@ -907,7 +932,15 @@ protected:
 
     string _trajxmlid;
 
+    /// \brief buffers of _ComputeMinimumTimeJointValues
+    struct MinimumTimeCache
+    {
+        ParabolicRamp::Vector v0pos, v0vel, v1pos, v1vel;
+        std::vector<std::vector<ParabolicRamp::ParabolicRamp1D> > ramps;
+    };
+
     // cache
+    boost::thread_specific_ptr<MinimumTimeCache> _mintimecache;
     ParabolicRamp::Vector _v0pos, _v0vel, _v1pos, _v1vel;
     vector<dReal> _vtrajpoints;
     std::vector<std::vector<ParabolicRamp::ParabolicRamp1D> > _ramps;
@@ -18,6 +18,7 @@
 
 #include <openrave/planningutils.h>
 
+#include "rplanners.h"
 #include "manipconstraints.h"
 #include "ParabolicPathSmooth/DynamicPath.h"
 
@@ -30,7 +31,7 @@ class ParabolicSmoother : public PlannerBase, public ParabolicRamp::FeasibilityC
     class MyRampFeasibilityChecker : public ParabolicRamp::RampFeasibilityChecker
     {
 public:
-        MyRampFeasibilityChecker(ParabolicRamp::FeasibilityCheckerBase* feas) : ParabolicRamp::RampFeasibilityChecker(feas) {
+        MyRampFeasibilityChecker(ParabolicRamp::FeasibilityCheckerBase* feas) : ParabolicRamp::RampFeasibilityChecker(feas), bBisectionOrder(false) {
         }
 
         /// \brief checks a ramp for collisions.
@@ -56,12 +57,28 @@ public:
             }
 
             // check if configurations are feasible for all the switch times.
-            _vsearchsegments.resize(vswitchtimes.size(), 0);
-            for(size_t i = 0; i < _vsearchsegments.size(); ++i) {
-                _vsearchsegments[i] = i;
+            if( bBisectionOrder ) {
+                // van der Corput order: the odd multiples of every stride, largest stride first
+                _vsearchsegments.resize(0);
+                int nstride = 1;
+                while(nstride < (int)vswitchtimes.size()) {
+                    nstride <<= 1;
+                }
+                for(; nstride >= 1; nstride >>= 1) {
+                    for(int i = nstride; i < (int)vswitchtimes.size(); i += 2*nstride) {
+                        _vsearchsegments.push_back(i);
+                    }
+                }
+                _vsearchsegments.push_back(0);
+            }
+            else {
+                _vsearchsegments.resize(vswitchtimes.size(), 0);
+                for(size_t i = 0; i < _vsearchsegments.size(); ++i) {
+                    _vsearchsegments[i] = i;
+                }
+                int midindex = _vsearchsegments.size()/2;
+                std::swap(_vsearchsegments[0], _vsearchsegments[midindex]); // put the mid point as the first point to be considered
             }
-            int midindex = _vsearchsegments.size()/2;
-            std::swap(_vsearchsegments[0], _vsearchsegments[midindex]); // put the mid point as the first point to be considered
             for(size_t i = 0; i < vswitchtimes.size(); ++i) {
                 dReal switchtime = vswitchtimes[_vsearchsegments[i]];
                 rampnd.Evaluate(switchtime,q0);
@@ -165,19 +182,31 @@ public:
             return finalret;
         }
 
+        bool bBisectionOrder; ///< if true, checks the switch times in bisection order instead of only putting the mid point first
+
 private:
         std::vector<dReal> vswitchtimes;
         std::vector<dReal> q0, q1, dq0, dq1;
-        std::vector<uint8_t> _vsearchsegments; ///< 1 if searched
+        std::vector<int> _vsearchsegments; ///< the order in which the indices of vswitchtimes are checked
         std::vector<ParabolicRamp::ParabolicRampND> segmentoutramps;
     };
 
 public:
-    ParabolicSmoother(EnvironmentBasePtr penv, std::istream& sinput) : PlannerBase(penv), _feasibilitychecker(this)
+    ParabolicSmoother(EnvironmentBasePtr penv, std::istream& sinput, bool bOnline=false) : PlannerBase(penv), _feasibilitychecker(this), _bOnline(bOnline), _nPlanStartTime(0), _bShortcutInterrupted(false)
     {
-        __description = ":Interface Author: Rosen Diankov\n\nInterface to `Indiana University Intelligent Motion Laboratory <http://www.iu.edu/~motion/software.html>`_ parabolic smoothing library (Kris Hauser).\n\n**Note:** The original trajectory will not be preserved at all, don't use this if the robot has to hit all points of the trajectory.\n";
+        __description = ":Interface Author: Rosen Diankov\n\nInterface to `Indiana University Intelligent Motion Laboratory <http://www.iu.edu/~motion/software.html>`_ parabolic smoothing library (Kris Hauser).\n\n**Note:** The original trajectory will not be preserved at all, don't use this if the robot has to hit all points of the trajectory.\n\nIf PlannerParameters::_nMaxPlanningTime is set, shortcutting stops once that many milliseconds have passed since PlanPath was called and the best path so far is returned.\n";
+        if( _bOnline ) {
+            __description += "\n**Online:** the path is assumed to start executing ConstraintTrajectoryTimingParameters::onlineleadtime seconds after PlanPath is called, and only the portion that is not executed yet is shortcut (see DynamicPath::OnlineShortcut). Shortcutting stops when the execution reaches the end of the path, the deadline passes, or the iterations run out. Since the timing of the executed portion never changes, the returned trajectory can replace the one being executed without a jump.\n";
+        }
         _bmanipconstraints = false;
+        _nShortcutCandidates = 0;
+        _nShortcutsAccepted = 0;
+        _fShortcutDuration = 0;
+        _nSegmentsAccepted = _nSegmentsRejected = 0;
+        _nCheckedAccepted = _nCheckedRejected = 0;
         _constraintreturn.reset(new ConstraintFilterReturn());
+        RegisterCommand("GetStatistics",boost::bind(&ParabolicSmoother::GetStatisticsCommand,this,_1,_2),
+                        "returns the statistics of the last PlanPath call as name/value pairs per line. shortcut: numthreads, numcandidates, numaccepted, duration (s), candidatespersecond, acceptancerate. segments: bisection, numaccepted, checkedperaccepted, numrejected, checkedperrejected");
         _logginguniformsampler = RaveCreateSpaceSampler(GetEnv(),"mt19937");
         if( !!_logginguniformsampler ) {
             _logginguniformsampler->SetSeed(utils::GetMicroTime());
@@ -208,6 +237,7 @@ public:
         _bUsePerturbation = true;
 
         _bmanipconstraints = _parameters->manipname.size() > 0 && (_parameters->maxmanipspeed>0 || _parameters->maxmanipaccel>0);
+        _feasibilitychecker.bBisectionOrder = _parameters->bisectioncheckorder != 0;
 
         // initialize workspace constraints on manipulators
         if(_bmanipconstraints ) {
@@ -256,6 +286,12 @@ public:
             RAVELOG_VERBOSE_FORMAT("saved parabolic parameters to %s", filename);
         }
         _DumpTrajectory(ptraj, Level_Verbose);
+        _nShortcutCandidates = 0;
+        _nShortcutsAccepted = 0;
+        _fShortcutDuration = 0;
+        _nSegmentsAccepted = _nSegmentsRejected = 0;
+        _nCheckedAccepted = _nCheckedRejected = 0;
+        _nPlanStartTime = utils::GetMicroTime();
 
         // save velocities
         std::vector<KinBody::KinBodyStateSaverPtr> vstatesavers;
@@ -448,7 +484,16 @@ public:
                 // no idea what a good mintimestep is... _parameters->_fStepLength*0.5?
                 //numshortcuts = dynamicpath.Shortcut(parameters->_nMaxIterations,_feasibilitychecker,this, parameters->_fStepLength*0.99);
                 //DumpDynamicPath(dynamicpath);
-                numshortcuts = _Shortcut(dynamicpath, parameters->_nMaxIterations,this, parameters->_fStepLength*0.99);
+                if( !_InitShortcutPlanners() ) {
+                    RAVELOG_WARN_FORMAT("env=%d, failed to set up %d shortcut threads, so shortcutting in this thread", GetEnv()->GetId()%parameters->nshortcutthreads);
+                    _vShortcutPlanners.resize(0);
+                }
+                if( _vShortcutPlanners.size() > 0 && parameters->nshortcutwindowsize > 0 && !_bOnline && (int)dynamicpath.ramps.size() > 2*parameters->nshortcutwindowsize ) {
+                    numshortcuts = _ShortcutWindows(dynamicpath, parameters->_nMaxIterations, parameters->_fStepLength*0.99);
+                }
+                else {
+                    numshortcuts = _Shortcut(dynamicpath, parameters->_nMaxIterations,this, parameters->_fStepLength*0.99);
+                }
                 if( numshortcuts < 0 ) {
                     return PS_Interrupted;
                 }
@@ -767,11 +812,17 @@ public:
         bool bExpectModifiedConfigurations = _parameters->fCosManipAngleThresh > -1+g_fEpsilonLinear;
         if(bExpectModifiedConfigurations || _bmanipconstraints) {
             options |= CFO_FillCheckedConfiguration;
-            _constraintreturn->Clear();
         }
+        else if( _parameters->bisectioncheckorder ) {
+            // the ramps are interpolated directly from the start, so the swept bound of the whole ramp is valid too
+            options |= CFO_BisectionCheckOrder|CFO_SweptBoundCulling;
+        }
+        _constraintreturn->Clear();
         try {
             int ret = _parameters->CheckPathAllConstraints(a,b,da, db, timeelapsed, IT_OpenStart, options, _constraintreturn);
             if( ret != 0 ) {
+                _nSegmentsRejected++;
+                _nCheckedRejected += _constraintreturn->_numcheckedconfigurations;
                 ParabolicRamp::CheckReturn checkret(ret);
                 if( ret == CFO_CheckTimeBasedConstraints ) {
                     checkret.fTimeBasedSurpassMult = 0.8; // don't have any other info, so just pick a multiple
@@ -784,6 +835,8 @@ public:
             RAVELOG_WARN_FORMAT("env=%d, rrtparams path constraints threw an exception: %s", GetEnv()->GetId()%ex.what());
             return ParabolicRamp::CheckReturn(0xffff); // could be anything
         }
+        _nSegmentsAccepted++;
+        _nCheckedAccepted += _constraintreturn->_numcheckedconfigurations;
         // Test for collision and/or dynamics has succeeded, now test for manip constraint
         if( bExpectModifiedConfigurations ) {
             // the configurations are getting constrained, therefore the path checked is not equal to the simply interpolated path by (a,b, da, db).
@@ -1085,296 +1138,667 @@ protected:
         return true;
     }
 
-    int _Shortcut(ParabolicRamp::DynamicPath& dynamicpath, int numIters, ParabolicRamp::RandomNumberGeneratorBase* rng, dReal mintimestep)
+    /// \brief a shortcut between two times of the path and the result of checking it
+    struct ShortcutCandidate
     {
-        std::vector<ParabolicRamp::ParabolicRampND>& ramps = dynamicpath.ramps;
-        int shortcuts = 0;
-        vector<dReal> rampStartTime(ramps.size());
-        dReal endTime=0;
-        for(size_t i=0; i<ramps.size(); i++) {
-            rampStartTime[i] = endTime;
-            endTime += ramps[i].endTime;
+        ShortcutCandidate() : t1(0), t2(0), u1(0), u2(0), i1(0), i2(0), fcurmult(1), numslowdowns(0) {
+        }
+
+        /// \brief how much shorter the path gets with the shortcut
+        dReal GetTimeSaved() const {
+            dReal newramptime = 0;
+            FOREACHC(itramp, accumoutramps) {
+                newramptime += itramp->endTime;
+            }
+            return t2-t1-newramptime;
+        }
+
+        dReal t1, t2; ///< the times on the path the shortcut connects
+        dReal u1, u2; ///< t1 and t2 relative to the start of ramps i1 and i2
+        int i1, i2; ///< the indices of the ramps t1 and t2 are in
+        ParabolicRamp::Vector x0, dx0, x1, dx1; ///< the states at t1 and t2
+        std::vector<ParabolicRamp::ParabolicRampND> accumoutramps; ///< the checked ramps replacing the path between t1 and t2
+        dReal fcurmult; ///< the velocity/acceleration multiplier accumoutramps were computed with
+        int numslowdowns; ///< the number of times the ramps had to be slowed down because of time based constraints
+    };
+
+    /// \brief a window of the path shortcut by one snapshot planner, see _ShortcutWindows
+    struct ShortcutWindow
+    {
+        ShortcutWindow() : istartramp(0), iendramp(0), numshortcuts(0) {
         }
-        ParabolicRamp::Vector x0, x1, dx0, dx1;
+
+        size_t istartramp, iendramp; ///< the ramps [istartramp, iendramp) of the path in the window
+        ParabolicRamp::DynamicPath path; ///< the ramps of the window, shortcut in place
+        int numshortcuts; ///< the return value of _Shortcut, -1 if it failed
+    };
+
+    /// \brief checks if the shortcut between candidate.t1 and candidate.t2 is feasible and fills the rest of candidate
+    ///
+    /// Does not modify ramps, so the candidates of one shortcut iteration can be checked at the same time by different planners.
+    /// \param fstarttimemult the multiplier of the velocity/acceleration limits to start the search with
+    /// \return 1 if the shortcut is feasible and shortens the path, 0 if not, -1 if interrupted
+    int _CheckShortcut(const std::vector<ParabolicRamp::ParabolicRampND>& ramps, const std::vector<dReal>& rampStartTime, dReal endTime, dReal mintimestep, dReal fstarttimemult, int iters, ShortcutCandidate& candidate)
+    {
+        dReal t1 = candidate.t1, t2 = candidate.t2;
+        ParabolicRamp::Vector &x0 = candidate.x0, &x1 = candidate.x1, &dx0 = candidate.dx0, &dx1 = candidate.dx1;
         ParabolicRamp::DynamicPath &intermediate=_cacheintermediate, &intermediate2=_cacheintermediate2;
         std::vector<dReal>& vellimits=_cachevellimits, &accellimits=_cacheaccellimits;
         vellimits.resize(_parameters->_vConfigVelocityLimit.size());
         accellimits.resize(_parameters->_vConfigAccelerationLimit.size());
-        std::vector<ParabolicRamp::ParabolicRampND>& accumoutramps=_cacheaccumoutramps, &outramps=_cacheoutramps;
-
-        int numslowdowns = 0; // total number of times a ramp has been slowed down.
+        std::vector<ParabolicRamp::ParabolicRampND>& accumoutramps=candidate.accumoutramps, &outramps=_cacheoutramps;
+        accumoutramps.resize(0);
+        candidate.numslowdowns = 0;
         bool bExpectModifiedConfigurations = _parameters->fCosManipAngleThresh > -1+g_fEpsilonLinear;
 
-        dReal fiSearchVelAccelMult = 1.0/_parameters->fSearchVelAccelMult; // for slowing down when timing constraints
-        dReal fstarttimemult = 1.0; // the start velocity/accel multiplier for the velocity and acceleration computations. If manip speed/accel or dynamics constraints are used, then this will track the last successful multipler. Basically if the last successful one is 0.1, it's very unlikely than a muliplier of 0.8 will meet the constraints the next time.
-        int iters=0;
-        for(iters=0; iters<numIters; iters++) {
-            dReal t1=rng->Rand()*endTime,t2=rng->Rand()*endTime;
-            if( iters == 0 ) {
-                t1 = 0;
-                t2 = endTime;
-            }
-            if(t1 > t2) {
-                ParabolicRamp::Swap(t1,t2);
+        int i1 = std::upper_bound(rampStartTime.begin(),rampStartTime.end(),t1)-rampStartTime.begin()-1;
+        int i2 = std::upper_bound(rampStartTime.begin(),rampStartTime.end(),t2)-rampStartTime.begin()-1;
+        // i1 can be equal to i2 and that is valid and should be rechecked again
+        candidate.i1 = i1;
+        candidate.i2 = i2;
+
+        uint32_t iIterProgress = 0; // used for debug purposes
+        try {
+            //same ramp
+            dReal u1 = t1-rampStartTime.at(i1); // at the same time check for boundaries
+            dReal u2 = t2-rampStartTime.at(i2); // at the same time check for boundaries
+            OPENRAVE_ASSERT_OP(u1, >=, 0);
+            OPENRAVE_ASSERT_OP(u1, <=, ramps[i1].endTime+ParabolicRamp::EpsilonT);
+            OPENRAVE_ASSERT_OP(u2, >=, 0);
+            OPENRAVE_ASSERT_OP(u2, <=, ramps[i2].endTime+ParabolicRamp::EpsilonT);
+            u1 = ParabolicRamp::Min(u1,ramps[i1].endTime);
+            u2 = ParabolicRamp::Min(u2,ramps[i2].endTime);
+            candidate.u1 = u1;
+            candidate.u2 = u2;
+            ramps[i1].Evaluate(u1,x0);
+            if( _parameters->SetStateValues(x0) != 0 ) {
+                return 0;
             }
-            if( t2 - t1 < mintimestep ) {
-                continue;
+            iIterProgress += 0x10000000;
+            _parameters->_getstatefn(x0);
+            iIterProgress += 0x10000000;
+            ramps[i2].Evaluate(u2,x1);
+            iIterProgress += 0x10000000;
+            if( _parameters->SetStateValues(x1) != 0 ) {
+                return 0;
             }
-            int i1 = std::upper_bound(rampStartTime.begin(),rampStartTime.end(),t1)-rampStartTime.begin()-1;
-            int i2 = std::upper_bound(rampStartTime.begin(),rampStartTime.end(),t2)-rampStartTime.begin()-1;
-            // i1 can be equal to i2 and that is valid and should be rechecked again
+            iIterProgress += 0x10000000;
+            _parameters->_getstatefn(x1);
+            ramps[i1].Derivative(u1,dx0);
+            ramps[i2].Derivative(u2,dx1);
+            ++_progress._iteration;
 
-            uint32_t iIterProgress = 0; // used for debug purposes
-            try {
-                //same ramp
-                dReal u1 = t1-rampStartTime.at(i1); // at the same time check for boundaries
-                dReal u2 = t2-rampStartTime.at(i2); // at the same time check for boundaries
-                OPENRAVE_ASSERT_OP(u1, >=, 0);
-                OPENRAVE_ASSERT_OP(u1, <=, ramps[i1].endTime+ParabolicRamp::EpsilonT);
-                OPENRAVE_ASSERT_OP(u2, >=, 0);
-                OPENRAVE_ASSERT_OP(u2, <=, ramps[i2].endTime+ParabolicRamp::EpsilonT);
-                u1 = ParabolicRamp::Min(u1,ramps[i1].endTime);
-                u2 = ParabolicRamp::Min(u2,ramps[i2].endTime);
-                ramps[i1].Evaluate(u1,x0);
+            bool bsuccess = false;
+
+            vellimits = _parameters->_vConfigVelocityLimit;
+            accellimits = _parameters->_vConfigAccelerationLimit;
+            if( _bmanipconstraints && !!_manipconstraintchecker ) {
                 if( _parameters->SetStateValues(x0) != 0 ) {
-                    continue;
+                    RAVELOG_VERBOSE("state set error\n");
+                    return 0;
                 }
-                iIterProgress += 0x10000000;
-                _parameters->_getstatefn(x0);
-                iIterProgress += 0x10000000;
-                ramps[i2].Evaluate(u2,x1);
-                iIterProgress += 0x10000000;
+                _manipconstraintchecker->GetMaxVelocitiesAccelerations(dx0, vellimits, accellimits);
                 if( _parameters->SetStateValues(x1) != 0 ) {
-                    continue;
+                    RAVELOG_VERBOSE("state set error\n");
+                    return 0;
                 }
-                iIterProgress += 0x10000000;
-                _parameters->_getstatefn(x1);
-                ramps[i1].Derivative(u1,dx0);
-                ramps[i2].Derivative(u2,dx1);
-                ++_progress._iteration;
-
-                bool bsuccess = false;
-
-                vellimits = _parameters->_vConfigVelocityLimit;
-                accellimits = _parameters->_vConfigAccelerationLimit;
-                if( _bmanipconstraints && !!_manipconstraintchecker ) {
-                    if( _parameters->SetStateValues(x0) != 0 ) {
-                        RAVELOG_VERBOSE("state set error\n");
-                        continue;
-                    }
-                    _manipconstraintchecker->GetMaxVelocitiesAccelerations(dx0, vellimits, accellimits);
-                    if( _parameters->SetStateValues(x1) != 0 ) {
-                        RAVELOG_VERBOSE("state set error\n");
-                        continue;
-                    }
-                    _manipconstraintchecker->GetMaxVelocitiesAccelerations(dx1, vellimits, accellimits);
+                _manipconstraintchecker->GetMaxVelocitiesAccelerations(dx1, vellimits, accellimits);
+            }
+            for(size_t j = 0; j < _parameters->_vConfigVelocityLimit.size(); ++j) {
+                // have to watch out that velocities don't drop under dx0 & dx1!
+                dReal fminvel = max(RaveFabs(dx0[j]), RaveFabs(dx1[j]));
+                if( vellimits[j] < fminvel ) {
+                    vellimits[j] = fminvel;
                 }
-                for(size_t j = 0; j < _parameters->_vConfigVelocityLimit.size(); ++j) {
-                    // have to watch out that velocities don't drop under dx0 & dx1!
-                    dReal fminvel = max(RaveFabs(dx0[j]), RaveFabs(dx1[j]));
-                    if( vellimits[j] < fminvel ) {
-                        vellimits[j] = fminvel;
+                else {
+                    dReal f = max(fminvel, _parameters->_vConfigVelocityLimit[j]*fstarttimemult);
+                    if( vellimits[j] > f ) {
+                        vellimits[j] = f;
                     }
-                    else {
-                        dReal f = max(fminvel, _parameters->_vConfigVelocityLimit[j]*fstarttimemult);
-                        if( vellimits[j] > f ) {
-                            vellimits[j] = f;
-                        }
-                    }
-                    {
-                        dReal f = _parameters->_vConfigAccelerationLimit[j]*fstarttimemult;
-                        if( accellimits[j] > f ) {
-                            accellimits[j] = f;
-                        }
+                }
+                {
+                    dReal f = _parameters->_vConfigAccelerationLimit[j]*fstarttimemult;
+                    if( accellimits[j] > f ) {
+                        accellimits[j] = f;
                     }
                 }
+            }
 
-                dReal fcurmult = fstarttimemult;
+            dReal fcurmult = fstarttimemult;
 
-                RAVELOG_VERBOSE_FORMAT("env=%d, shortcutting from t1 = %.15e to t2 = %.15e", GetEnv()->GetId()%t1%t2);
+            RAVELOG_VERBOSE_FORMAT("env=%d, shortcutting from t1 = %.15e to t2 = %.15e", GetEnv()->GetId()%t1%t2);
 
-                for(size_t islowdowntry = 0; islowdowntry < 4; ++islowdowntry ) {
-                    bool res=ParabolicRamp::SolveMinTime(x0, dx0, x1, dx1, accellimits, vellimits, _parameters->_vConfigLowerLimit, _parameters->_vConfigUpperLimit, intermediate, _parameters->_multidofinterp);
-                    iIterProgress += 0x1000;
-                    if(!res) {
-                        break;
+            for(size_t islowdowntry = 0; islowdowntry < 4; ++islowdowntry ) {
+                bool res=ParabolicRamp::SolveMinTime(x0, dx0, x1, dx1, accellimits, vellimits, _parameters->_vConfigLowerLimit, _parameters->_vConfigUpperLimit, intermediate, _parameters->_multidofinterp);
+                iIterProgress += 0x1000;
+                if(!res) {
+                    break;
+                }
+                // check the new ramp time makes significant steps
+                dReal newramptime = intermediate.GetTotalTime();
+                if( newramptime+mintimestep > t2-t1 ) {
+                    // reject since it didn't make significant improvement
+                    RAVELOG_VERBOSE_FORMAT("env=%d, shortcut iter=%d rejected times [%f, %f]. final trajtime=%fs", GetEnv()->GetId()%iters%t1%t2%(endTime-(t2-t1)+newramptime));
+                    break;
+                }
+
+                if( _CallCallbacks(_progress) == PA_Interrupt ) {
+                    return -1;
+                }
+
+                iIterProgress += 0x1000;
+                accumoutramps.resize(0);
+                ParabolicRamp::CheckReturn retcheck(0);
+                for(size_t iramp=0; iramp<intermediate.ramps.size(); iramp++) {
+                    iIterProgress += 0x10;
+                    if( iramp > 0 ) {
+                        intermediate.ramps[iramp].x0 = intermediate.ramps[iramp-1].x1; // to remove noise?
+                        intermediate.ramps[iramp].dx0 = intermediate.ramps[iramp-1].dx1; // to remove noise?
                     }
-                    // check the new ramp time makes significant steps
-                    dReal newramptime = intermediate.GetTotalTime();
-                    if( newramptime+mintimestep > t2-t1 ) {
-                        // reject since it didn't make significant improvement
-                        RAVELOG_VERBOSE_FORMAT("env=%d, shortcut iter=%d rejected times [%f, %f]. final trajtime=%fs", GetEnv()->GetId()%iters%t1%t2%(endTime-(t2-t1)+newramptime));
+                    if( _parameters->SetStateValues(intermediate.ramps[iramp].x1) != 0 ) {
+                        retcheck.retcode = CFO_StateSettingError;
                         break;
                     }
-
-                    if( _CallCallbacks(_progress) == PA_Interrupt ) {
-                        return -1;
+                    _parameters->_getstatefn(intermediate.ramps[iramp].x1);
+                    // have to resolve for the ramp since the positions might have changed?
+                    //                for(size_t j = 0; j < intermediate.rams[iramp].x1.size(); ++j) {
+                    //                    intermediate.ramps[iramp].SolveFixedSwitchTime();
+                    //                }
+
+                    iIterProgress += 0x10;
+                    retcheck = _feasibilitychecker.Check2(intermediate.ramps[iramp], 0xffff, outramps);
+                    iIterProgress += 0x10;
+                    if( retcheck.retcode != 0) {
+                        break;
                     }
 
-                    iIterProgress += 0x1000;
-                    accumoutramps.resize(0);
-                    ParabolicRamp::CheckReturn retcheck(0);
-                    for(size_t iramp=0; iramp<intermediate.ramps.size(); iramp++) {
-                        iIterProgress += 0x10;
-                        if( iramp > 0 ) {
-                            intermediate.ramps[iramp].x0 = intermediate.ramps[iramp-1].x1; // to remove noise?
-                            intermediate.ramps[iramp].dx0 = intermediate.ramps[iramp-1].dx1; // to remove noise?
-                        }
-                        if( _parameters->SetStateValues(intermediate.ramps[iramp].x1) != 0 ) {
-                            retcheck.retcode = CFO_StateSettingError;
-                            break;
-                        }
-                        _parameters->_getstatefn(intermediate.ramps[iramp].x1);
-                        // have to resolve for the ramp since the positions might have changed?
-                        //                for(size_t j = 0; j < intermediate.rams[iramp].x1.size(); ++j) {
-                        //                    intermediate.ramps[iramp].SolveFixedSwitchTime();
-                        //                }
-
-                        iIterProgress += 0x10;
-                        retcheck = _feasibilitychecker.Check2(intermediate.ramps[iramp], 0xffff, outramps);
-                        iIterProgress += 0x10;
-                        if( retcheck.retcode != 0) {
-                            break;
-                        }
-
-                        // if SegmentFeasible2 is modifying the original ramps due to jacobian project constraints inside of CheckPathAllConstraints, then have to reset the velocity and accel limits so that they are above the waypoints of the intermediate ramps.
-                        if( bExpectModifiedConfigurations ) {
-                            for(size_t i=0; i+1<outramps.size(); i++) {
-                                for(size_t j = 0; j < outramps[i].x1.size(); ++j) {
-                                    // have to watch out that velocities don't drop under dx0 & dx1!
-                                    dReal fminvel = max(RaveFabs(outramps[i].dx0[j]), RaveFabs(outramps[i].dx1[j]));
-                                    if( vellimits[j] < fminvel ) {
-                                        vellimits[j] = fminvel;
-                                    }
-
-                                    // maybe do accel limits depending on (dx1-dx0)/elapsedtime?
+                    // if SegmentFeasible2 is modifying the original ramps due to jacobian project constraints inside of CheckPathAllConstraints, then have to reset the velocity and accel limits so that they are above the waypoints of the intermediate ramps.
+                    if( bExpectModifiedConfigurations ) {
+                        for(size_t i=0; i+1<outramps.size(); i++) {
+                            for(size_t j = 0; j < outramps[i].x1.size(); ++j) {
+                                // have to watch out that velocities don't drop under dx0 & dx1!
+                                dReal fminvel = max(RaveFabs(outramps[i].dx0[j]), RaveFabs(outramps[i].dx1[j]));
+                                if( vellimits[j] < fminvel ) {
+                                    vellimits[j] = fminvel;
                                 }
-                            }
-                        }
 
-                        if( IS_DEBUGLEVEL(Level_Verbose) ) {
-                            for(size_t i=0; i+1<outramps.size(); i++) {
-                                for(size_t j = 0; j < outramps[i].x1.size(); ++j) {
-                                    OPENRAVE_ASSERT_OP(RaveFabs(outramps[i].x1[j]-outramps[i+1].x0[j]), <=, ParabolicRamp::EpsilonX);
-                                    OPENRAVE_ASSERT_OP(RaveFabs(outramps[i].dx1[j]-outramps[i+1].dx0[j]), <=, ParabolicRamp::EpsilonV);
-                                }
+                                // maybe do accel limits depending on (dx1-dx0)/elapsedtime?
                             }
                         }
+                    }
 
-                        if( retcheck.bDifferentVelocity && outramps.size() > 0 ) {
-                            ParabolicRamp::ParabolicRampND& outramp = outramps.at(outramps.size()-1);
-
-                            bool res=ParabolicRamp::SolveMinTime(outramp.x0, outramp.dx0, intermediate.ramps[iramp].x1, intermediate.ramps[iramp].dx1, accellimits, vellimits, _parameters->_vConfigLowerLimit, _parameters->_vConfigUpperLimit, intermediate2, _parameters->_multidofinterp);
-                            if( !res ) {
-                                RAVELOG_WARN("failed to SolveMinTime for different vel ramp\n");
-                                break;
-                            }
-                            if( RaveFabs(intermediate2.GetTotalTime()-outramp.endTime) > 0.01 ) {
-                                RAVELOG_DEBUG_FORMAT("env=%d, intermediate2 ramp duration is too long %fs", GetEnv()->GetId()%intermediate2.GetTotalTime());
-                                retcheck.retcode = CFO_FinalValuesNotReached;
-                                break;
+                    if( IS_DEBUGLEVEL(Level_Verbose) ) {
+                        for(size_t i=0; i+1<outramps.size(); i++) {
+                            for(size_t j = 0; j < outramps[i].x1.size(); ++j) {
+                                OPENRAVE_ASSERT_OP(RaveFabs(outramps[i].x1[j]-outramps[i+1].x0[j]), <=, ParabolicRamp::EpsilonX);
+                                OPENRAVE_ASSERT_OP(RaveFabs(outramps[i].dx1[j]-outramps[i+1].dx0[j]), <=, ParabolicRamp::EpsilonV);
                             }
-                            // intermediate2 should be pretty close to outramp, so just insert directly
-                            outramps.pop_back();
-                            outramps.insert(outramps.end(), intermediate2.ramps.begin(), intermediate2.ramps.end());
                         }
-                        accumoutramps.insert(accumoutramps.end(), outramps.begin(), outramps.end());
-                    }
-                    iIterProgress += 0x1000;
-                    if(retcheck.retcode == 0) {
-                        bsuccess = true;
-                        break;
                     }
 
-                    if( retcheck.retcode == CFO_CheckTimeBasedConstraints ) {
-                        RAVELOG_VERBOSE_FORMAT("env=%d, shortcut iter=%d, slow down ramp by fTimeBasedSurpassMult=%.15e, fcurmult=%.15e", GetEnv()->GetId()%iters%retcheck.fTimeBasedSurpassMult%fcurmult);
-                        for(size_t j = 0; j < vellimits.size(); ++j) {
-                            // have to watch out that velocities don't drop under dx0 & dx1!
-                            dReal fminvel = max(RaveFabs(dx0[j]), RaveFabs(dx1[j]));
-                            vellimits[j] = max(vellimits[j]*retcheck.fTimeBasedSurpassMult, fminvel);
-                            accellimits[j] *= retcheck.fTimeBasedSurpassMult;
+                    if( retcheck.bDifferentVelocity && outramps.size() > 0 ) {
+                        ParabolicRamp::ParabolicRampND& outramp = outramps.at(outramps.size()-1);
+
+                        bool res=ParabolicRamp::SolveMinTime(outramp.x0, outramp.dx0, intermediate.ramps[iramp].x1, intermediate.ramps[iramp].dx1, accellimits, vellimits, _parameters->_vConfigLowerLimit, _parameters->_vConfigUpperLimit, intermediate2, _parameters->_multidofinterp);
+                        if( !res ) {
+                            RAVELOG_WARN("failed to SolveMinTime for different vel ramp\n");
+                            break;
                         }
-                        fcurmult *= retcheck.fTimeBasedSurpassMult;
-                        if( fcurmult < 0.01 ) {
-                            RAVELOG_DEBUG_FORMAT("env=%d, shortcut iter=%d, fcurmult is too small (%.15e) so giving up on this ramp", GetEnv()->GetId()%iters%fcurmult);
-                            //retcheck = check.Check2(intermediate.ramps.at(0), 0xffff, outramps);
+                        if( RaveFabs(intermediate2.GetTotalTime()-outramp.endTime) > 0.01 ) {
+                            RAVELOG_DEBUG_FORMAT("env=%d, intermediate2 ramp duration is too long %fs", GetEnv()->GetId()%intermediate2.GetTotalTime());
+                            retcheck.retcode = CFO_FinalValuesNotReached;
                             break;
                         }
-                        numslowdowns += 1;
+                        // intermediate2 should be pretty close to outramp, so just insert directly
+                        outramps.pop_back();
+                        outramps.insert(outramps.end(), intermediate2.ramps.begin(), intermediate2.ramps.end());
                     }
-                    else {
-                        RAVELOG_VERBOSE_FORMAT("env=%d, shortcut iter=%d rejected due to constraints 0x%x", GetEnv()->GetId()%iters%retcheck.retcode);
+                    accumoutramps.insert(accumoutramps.end(), outramps.begin(), outramps.end());
+                }
+                iIterProgress += 0x1000;
+                if(retcheck.retcode == 0) {
+                    bsuccess = true;
+                    break;
+                }
+
+                if( retcheck.retcode == CFO_CheckTimeBasedConstraints ) {
+                    RAVELOG_VERBOSE_FORMAT("env=%d, shortcut iter=%d, slow down ramp by fTimeBasedSurpassMult=%.15e, fcurmult=%.15e", GetEnv()->GetId()%iters%retcheck.fTimeBasedSurpassMult%fcurmult);
+                    for(size_t j = 0; j < vellimits.size(); ++j) {
+                        // have to watch out that velocities don't drop under dx0 & dx1!
+                        dReal fminvel = max(RaveFabs(dx0[j]), RaveFabs(dx1[j]));
+                        vellimits[j] = max(vellimits[j]*retcheck.fTimeBasedSurpassMult, fminvel);
+                        accellimits[j] *= retcheck.fTimeBasedSurpassMult;
+                    }
+                    fcurmult *= retcheck.fTimeBasedSurpassMult;
+                    if( fcurmult < 0.01 ) {
+                        RAVELOG_DEBUG_FORMAT("env=%d, shortcut iter=%d, fcurmult is too small (%.15e) so giving up on this ramp", GetEnv()->GetId()%iters%fcurmult);
+                        //retcheck = check.Check2(intermediate.ramps.at(0), 0xffff, outramps);
                         break;
                     }
-                    iIterProgress += 0x1000;
+                    candidate.numslowdowns += 1;
                 }
-
-                if( !bsuccess ) {
-                    continue;
+                else {
+                    RAVELOG_VERBOSE_FORMAT("env=%d, shortcut iter=%d rejected due to constraints 0x%x", GetEnv()->GetId()%iters%retcheck.retcode);
+                    break;
                 }
+                iIterProgress += 0x1000;
+            }
 
-                if( accumoutramps.size() == 0 ) {
-                    RAVELOG_WARN("accumulated ramps are empty!\n");
-                    continue;
+            if( !bsuccess ) {
+                return 0;
+            }
+
+            if( accumoutramps.size() == 0 ) {
+                RAVELOG_WARN("accumulated ramps are empty!\n");
+                return 0;
+            }
+            candidate.fcurmult = fcurmult;
+        }
+        catch(const std::exception& ex) {
+            RAVELOG_WARN_FORMAT("env=%d, exception happened during shortcut iteration progress=0x%x: %s", GetEnv()->GetId()%iIterProgress%ex.what());
+            return 0;
+        }
+        return 1;
+    }
+
+    /// \brief replaces the path between candidate.t1 and candidate.t2 with the checked ramps of the candidate and updates the ramp start times
+    ///
+    /// \return the new duration of the path
+    dReal _ApplyShortcut(std::vector<ParabolicRamp::ParabolicRampND>& ramps, const ShortcutCandidate& candidate, std::vector<dReal>& rampStartTime)
+    {
+        const std::vector<ParabolicRamp::ParabolicRampND>& accumoutramps = candidate.accumoutramps;
+        int i1 = candidate.i1, i2 = candidate.i2;
+        if( i1 == i2 ) {
+            // the same ramp is being cut on both sides, so copy the ramp
+            ramps.insert(ramps.begin()+i1, ramps.at(i1));
+            i2 = i1+1;
+        }
+
+        ramps.at(i1).TrimBack(ramps[i1].endTime-candidate.u1); // use at for bounds checking
+        ramps[i1].x1 = accumoutramps.front().x0;
+        ramps[i1].dx1 = accumoutramps.front().dx0;
+        ramps.at(i2).TrimFront(candidate.u2); // use at for bounds checking
+        ramps[i2].x0 = accumoutramps.back().x1;
+        ramps[i2].dx0 = accumoutramps.back().dx1;
+
+        //RAVELOG_VERBOSE_FORMAT("replacing [%d, %d] with %d ramps", i1%i2%accumoutramps.size());
+        // replace with accumoutramps
+        if( i1+1 < i2 ) {
+            ramps.erase(ramps.begin()+i1+1, ramps.begin()+i2);
+        }
+        ramps.insert(ramps.begin()+i1+1,accumoutramps.begin(),accumoutramps.end());
+
+        //check for consistency
+        if( IS_DEBUGLEVEL(Level_Verbose) ) {
+            for(size_t i=0; i+1<ramps.size(); i++) {
+                for(size_t j = 0; j < ramps[i].x1.size(); ++j) {
+                    OPENRAVE_ASSERT_OP(RaveFabs(ramps[i].x1[j]-ramps[i+1].x0[j]), <=, ParabolicRamp::EpsilonX);
+                    OPENRAVE_ASSERT_OP(RaveFabs(ramps[i].dx1[j]-ramps[i+1].dx0[j]), <=, ParabolicRamp::EpsilonV);
                 }
-                fstarttimemult = min(1.0, fcurmult*fiSearchVelAccelMult); // the new start time mult should be increased by one timemult
+            }
+        }
 
-                // perform shortcut. use accumoutramps rather than intermediate.ramps!
-                shortcuts++;
+        //revise the timing
+        return _ComputeRampStartTimes(ramps, rampStartTime);
+    }
 
-                if( i1 == i2 ) {
-                    // the same ramp is being cut on both sides, so copy the ramp
-                    ramps.insert(ramps.begin()+i1, ramps.at(i1));
-                    i2 = i1+1;
+    /// \brief fills the start time of every ramp and returns the total duration
+    static dReal _ComputeRampStartTimes(const std::vector<ParabolicRamp::ParabolicRampND>& ramps, std::vector<dReal>& rampStartTime)
+    {
+        rampStartTime.resize(ramps.size());
+        dReal endTime=0;
+        for(size_t i=0; i<ramps.size(); i++) {
+            rampStartTime[i] = endTime;
+            endTime += ramps[i].endTime;
+        }
+        return endTime;
+    }
+
+    /// \param vseamtimes if not empty, only shortcuts that start at most fseamradius before and end at most fseamradius after one of these times are sampled
+    int _Shortcut(ParabolicRamp::DynamicPath& dynamicpath, int numIters, ParabolicRamp::RandomNumberGeneratorBase* rng, dReal mintimestep, const std::vector<dReal>& vseamtimes=std::vector<dReal>(), dReal fseamradius=0)
+    {
+        std::vector<ParabolicRamp::ParabolicRampND>& ramps = dynamicpath.ramps;
+        int shortcuts = 0;
+        vector<dReal> rampStartTime;
+        dReal endTime = _ComputeRampStartTimes(ramps, rampStartTime);
+        std::vector<dReal> vseams = vseamtimes; // moved as the shortcuts change the timing of the path
+
+        // every iteration checks one candidate with this planner, or one candidate per snapshot in parallel
+        bool bParallel = _vShortcutPlanners.size() > 0;
+        size_t numcandidates = bParallel ? _vShortcutPlanners.size() : 1;
+        _vShortcutCandidates.resize(numcandidates);
+        _vShortcutResults.resize(numcandidates);
+        FOREACH(itplanner, _vShortcutPlanners) {
+            (*itplanner)->_feasibilitychecker.tol = _feasibilitychecker.tol;
+            (*itplanner)->_bUsePerturbation = _bUsePerturbation;
+            (*itplanner)->_nSegmentsAccepted = (*itplanner)->_nSegmentsRejected = 0;
+            (*itplanner)->_nCheckedAccepted = (*itplanner)->_nCheckedRejected = 0;
+        }
+        uint32_t basetime = utils::GetMilliTime();
+
+        int numslowdowns = 0; // total number of times a ramp has been slowed down.
+        dReal fiSearchVelAccelMult = 1.0/_parameters->fSearchVelAccelMult; // for slowing down when timing constraints
+        dReal fstarttimemult = 1.0; // the start velocity/accel multiplier for the velocity and acceleration computations. If manip speed/accel or dynamics constraints are used, then this will track the last successful multipler. Basically if the last successful one is 0.1, it's very unlikely than a muliplier of 0.8 will meet the constraints the next time.
+        int iters=0;
+        for(iters=0; iters<numIters; iters++) {
+            if( _parameters->_nMaxPlanningTime > 0 && utils::GetMicroTime()-_nPlanStartTime >= 1000*(uint64_t)_parameters->_nMaxPlanningTime ) {
+                RAVELOG_DEBUG_FORMAT("env=%d, shortcut deadline of %dms reached at iter=%d, endTime=%f", GetEnv()->GetId()%_parameters->_nMaxPlanningTime%iters%endTime);
+                break;
+            }
+            dReal fexecutiontime = 0; // the path before this time is already executed or will be before a shortcut can be checked
+            if( _bOnline ) {
+                fexecutiontime = _GetOnlineExecutionTime() + _parameters->onlinepadtime;
+                if( fexecutiontime >= endTime ) {
+                    RAVELOG_DEBUG_FORMAT("env=%d, execution reached the end of the path at iter=%d, endTime=%f", GetEnv()->GetId()%iters%endTime);
+                    break;
+                }
+                fexecutiontime = max(dReal(0), fexecutiontime);
+            }
+
+            // sample all the candidates in this thread so that the result does not depend on the thread timing
+            size_t nvalid = 0;
+            for(size_t icandidate = 0; icandidate < numcandidates; ++icandidate) {
+                dReal t1, t2;
+                if( vseams.size() > 0 ) {
+                    dReal fseam = vseams[min(vseams.size()-1, (size_t)(rng->Rand()*vseams.size()))];
+                    t1 = max(fexecutiontime, fseam-rng->Rand()*fseamradius);
+                    t2 = min(endTime, fseam+rng->Rand()*fseamradius);
+                }
+                else {
+                    t1=fexecutiontime+rng->Rand()*(endTime-fexecutiontime);
+                    t2=fexecutiontime+rng->Rand()*(endTime-fexecutiontime);
+                    if( iters == 0 && icandidate == 0 ) {
+                        t1 = fexecutiontime;
+                        t2 = endTime;
+                    }
+                }
+                if(t1 > t2) {
+                    ParabolicRamp::Swap(t1,t2);
+                }
+                if( t2 - t1 < mintimestep ) {
+                    continue;
                 }
+                _vShortcutCandidates[nvalid].t1 = t1;
+                _vShortcutCandidates[nvalid].t2 = t2;
+                ++nvalid;
+            }
+            if( nvalid == 0 ) {
+                continue;
+            }
+            _nShortcutCandidates += nvalid;
 
-                ramps.at(i1).TrimBack(ramps[i1].endTime-u1); // use at for bounds checking
-                ramps[i1].x1 = accumoutramps.front().x0;
-                ramps[i1].dx1 = accumoutramps.front().dx0;
-                ramps.at(i2).TrimFront(u2); // use at for bounds checking
-                ramps[i2].x0 = accumoutramps.back().x1;
-                ramps[i2].dx0 = accumoutramps.back().dx1;
-
-                //RAVELOG_VERBOSE_FORMAT("replacing [%d, %d] with %d ramps", i1%i2%accumoutramps.size());
-                // replace with accumoutramps
-                if( i1+1 < i2 ) {
-                    ramps.erase(ramps.begin()+i1+1, ramps.begin()+i2);
+            if( bParallel ) {
+                if( _CallCallbacks(_progress) == PA_Interrupt ) {
+                    return -1;
+                }
+                _progress._iteration += nvalid;
+                _bShortcutInterrupted = false;
+                _pShortcutWorkers->Run(nvalid, boost::bind(&ParabolicSmoother::_CheckShortcutCandidates, this, boost::cref(ramps), boost::cref(rampStartTime), endTime, mintimestep, fstarttimemult, iters, _1, _2), boost::bind(&ParabolicSmoother::_IsShortcutInterrupted, this));
+                if( _bShortcutInterrupted ) {
+                    return -1;
+                }
+            }
+            else {
+                _vShortcutResults[0] = _CheckShortcut(ramps, rampStartTime, endTime, mintimestep, fstarttimemult, iters, _vShortcutCandidates[0]);
+                if( _vShortcutResults[0] < 0 ) {
+                    return -1;
                 }
-                ramps.insert(ramps.begin()+i1+1,accumoutramps.begin(),accumoutramps.end());
-                iIterProgress += 0x10000000;
+            }
 
-                //check for consistency
-                if( IS_DEBUGLEVEL(Level_Verbose) ) {
-                    for(size_t i=0; i+1<ramps.size(); i++) {
-                        for(size_t j = 0; j < ramps[i].x1.size(); ++j) {
-                            OPENRAVE_ASSERT_OP(RaveFabs(ramps[i].x1[j]-ramps[i+1].x0[j]), <=, ParabolicRamp::EpsilonX);
-                            OPENRAVE_ASSERT_OP(RaveFabs(ramps[i].dx1[j]-ramps[i+1].dx0[j]), <=, ParabolicRamp::EpsilonV);
-                        }
+            // keep the feasible candidate that shortens the path the most
+            int ibest = -1;
+            dReal fbesttimesaved = 0;
+            for(size_t icandidate = 0; icandidate < nvalid; ++icandidate) {
+                numslowdowns += _vShortcutCandidates[icandidate].numslowdowns;
+                if( _vShortcutResults[icandidate] > 0 ) {
+                    dReal ftimesaved = _vShortcutCandidates[icandidate].GetTimeSaved();
+                    if( ibest < 0 || ftimesaved > fbesttimesaved ) {
+                        ibest = icandidate;
+                        fbesttimesaved = ftimesaved;
                     }
                 }
-                iIterProgress += 0x10000000;
-
-                //revise the timing
-                rampStartTime.resize(ramps.size());
-                endTime=0;
-                for(size_t i=0; i<ramps.size(); i++) {
-                    rampStartTime[i] = endTime;
-                    endTime += ramps[i].endTime;
+            }
+            if( ibest < 0 ) {
+                continue;
+            }
+
+            const ShortcutCandidate& candidate = _vShortcutCandidates[ibest];
+            if( _bOnline && _GetOnlineExecutionTime() > candidate.t1 ) {
+                // the execution passed the start of the shortcut while it was being checked
+                continue;
+            }
+            fstarttimemult = min(1.0, candidate.fcurmult*fiSearchVelAccelMult); // the new start time mult should be increased by one timemult
+            if( vseams.size() > 0 ) {
+                dReal ftimesaved = candidate.GetTimeSaved();
+                FOREACH(itseam, vseams) {
+                    if( *itseam >= candidate.t2 ) {
+                        *itseam -= ftimesaved;
+                    }
+                    else if( *itseam > candidate.t1 ) {
+                        *itseam = candidate.t1 + (*itseam-candidate.t1)*(candidate.t2-candidate.t1-ftimesaved)/(candidate.t2-candidate.t1);
+                    }
                 }
-                RAVELOG_VERBOSE_FORMAT("env=%d, shortcut iter=%d slowdowns=%d, endTime=%f",GetEnv()->GetId()%iters%numslowdowns%endTime);
-                //DumpDynamicPath(dynamicpath);
+            }
+
+            // perform shortcut. use accumoutramps rather than intermediate.ramps!
+            try {
+                endTime = _ApplyShortcut(ramps, candidate, rampStartTime);
             }
             catch(const std::exception& ex) {
-                RAVELOG_WARN_FORMAT("env=%d, exception happened during shortcut iteration progress=0x%x: %s", GetEnv()->GetId()%iIterProgress%ex.what());
-                // continue to next iteration...
+                RAVELOG_WARN_FORMAT("env=%d, exception happened while applying shortcut iteration %d: %s", GetEnv()->GetId()%iters%ex.what());
+                endTime = _ComputeRampStartTimes(ramps, rampStartTime);
+                continue;
             }
+            shortcuts++;
+            _nShortcutsAccepted++;
+            RAVELOG_VERBOSE_FORMAT("env=%d, shortcut iter=%d slowdowns=%d, endTime=%f",GetEnv()->GetId()%iters%numslowdowns%endTime);
+            //DumpDynamicPath(dynamicpath);
         }
 
+        _fShortcutDuration += 0.001*(dReal)(utils::GetMilliTime()-basetime);
         RAVELOG_VERBOSE_FORMAT("finished at shortcut iter=%d slowdowns=%d, endTime=%f",iters%numslowdowns%endTime);
         //DumpDynamicPath(dynamicpath);
         return shortcuts;
     }
 
+    /// \brief shortcuts the windows of ConstraintTrajectoryTimingParameters::nshortcutwindowsize ramps of dynamicpath concurrently on the snapshot planners, then shortcuts across the window boundaries
+    ///
+    /// _Shortcut keeps the start and end states of the path it is given, so the windows can be stitched back together. Window i is shortcut by
+    /// snapshot planner i%nshortcutthreads with the seed _nRandomGeneratorSeed+i, so the result does not depend on the thread timing.
+    /// \return the number of shortcuts, -1 if interrupted
+    int _ShortcutWindows(ParabolicRamp::DynamicPath& dynamicpath, int numIters, dReal mintimestep)
+    {
+        std::vector<ParabolicRamp::ParabolicRampND>& ramps = dynamicpath.ramps;
+        size_t numthreads = _vShortcutPlanners.size();
+        size_t numwindows = ramps.size()/_parameters->nshortcutwindowsize;
+        _vShortcutWindows.resize(numwindows);
+        for(size_t iwindow = 0; iwindow < numwindows; ++iwindow) {
+            ShortcutWindow& window = _vShortcutWindows[iwindow];
+            window.istartramp = (ramps.size()*iwindow)/numwindows;
+            window.iendramp = (ramps.size()*(iwindow+1))/numwindows;
+            window.path.Init(dynamicpath.velMax, dynamicpath.accMax);
+            window.path._multidofinterp = dynamicpath._multidofinterp;
+            window.path.SetJointLimits(dynamicpath.xMin, dynamicpath.xMax);
+            window.path.ramps.assign(ramps.begin()+window.istartramp, ramps.begin()+window.iendramp);
+            window.numshortcuts = 0;
+        }
+        FOREACH(itplanner, _vShortcutPlanners) {
+            (*itplanner)->_feasibilitychecker.tol = _feasibilitychecker.tol;
+            (*itplanner)->_bUsePerturbation = _bUsePerturbation;
+            (*itplanner)->_nPlanStartTime = _nPlanStartTime;
+            (*itplanner)->_nShortcutCandidates = (*itplanner)->_nShortcutsAccepted = 0;
+            (*itplanner)->_fShortcutDuration = 0;
+            (*itplanner)->_nSegmentsAccepted = (*itplanner)->_nSegmentsRejected = 0;
+            (*itplanner)->_nCheckedAccepted = (*itplanner)->_nCheckedRejected = 0;
+        }
+
+        // every thread gets as many iterations as the whole path would have had
+        int numwindowiters = min(numIters, max(1, (int)((numIters*numthreads)/numwindows)));
+        uint32_t basetime = utils::GetMilliTime();
+        _bShortcutInterrupted = false;
+        _pShortcutWorkers->Run(numthreads, boost::bind(&ParabolicSmoother::_ShortcutWindowsRange, this, numwindowiters, mintimestep, _1, _2), boost::bind(&ParabolicSmoother::_IsShortcutInterrupted, this));
+        if( _bShortcutInterrupted ) {
+            return -1;
+        }
+
+        int shortcuts = 0;
+        std::vector<ParabolicRamp::ParabolicRampND> newramps;
+        newramps.reserve(ramps.size());
+        std::vector<dReal> vseamtimes;
+        dReal fseamtime = 0;
+        for(size_t iwindow = 0; iwindow < numwindows; ++iwindow) {
+            ShortcutWindow& window = _vShortcutWindows[iwindow];
+            if( window.numshortcuts < 0 ) {
+                // keep the original ramps of the window
+                window.path.ramps.assign(ramps.begin()+window.istartramp, ramps.begin()+window.iendramp);
+            }
+            else {
+                shortcuts += window.numshortcuts;
+            }
+            newramps.insert(newramps.end(), window.path.ramps.begin(), window.path.ramps.end());
+            fseamtime += window.path.GetTotalTime();
+            if( iwindow+1 < numwindows ) {
+                vseamtimes.push_back(fseamtime);
+            }
+        }
+        ramps.swap(newramps);
+        _fShortcutDuration += 0.001*(dReal)(utils::GetMilliTime()-basetime);
+        FOREACHC(itplanner, _vShortcutPlanners) {
+            _nShortcutCandidates += (*itplanner)->_nShortcutCandidates;
+            _nShortcutsAccepted += (*itplanner)->_nShortcutsAccepted;
+            _nSegmentsAccepted += (*itplanner)->_nSegmentsAccepted;
+            _nSegmentsRejected += (*itplanner)->_nSegmentsRejected;
+            _nCheckedAccepted += (*itplanner)->_nCheckedAccepted;
+            _nCheckedRejected += (*itplanner)->_nCheckedRejected;
+        }
+        RAVELOG_DEBUG_FORMAT("env=%d, shortcut %d windows with %d shortcuts, duration=%f", GetEnv()->GetId()%numwindows%shortcuts%fseamtime);
+
+        // the windows could not shortcut across their boundaries, so give every boundary a quarter of the iterations of a window around it
+        dReal fseamradius = 0.25*fseamtime/numwindows;
+        int numseamiters = min(numIters, max(1, (int)vseamtimes.size()*numwindowiters/4));
+        int seamshortcuts = _Shortcut(dynamicpath, numseamiters, this, mintimestep, vseamtimes, fseamradius);
+        if( seamshortcuts < 0 ) {
+            return -1;
+        }
+        return shortcuts + seamshortcuts;
+    }
+
+    /// \brief shortcuts the windows of the snapshot planners [start:end], called from the worker threads
+    void _ShortcutWindowsRange(int numIters, dReal mintimestep, size_t start, size_t end)
+    {
+        for(size_t ithread = start; ithread < end; ++ithread) {
+            boost::shared_ptr<ParabolicSmoother> planner = _vShortcutPlanners.at(ithread);
+            EnvironmentMutex::scoped_lock lock(planner->GetEnv()->GetMutex());
+            for(size_t iwindow = ithread; iwindow < _vShortcutWindows.size(); iwindow += _vShortcutPlanners.size()) {
+                ShortcutWindow& window = _vShortcutWindows[iwindow];
+                planner->_uniformsampler->SetSeed(_parameters->_nRandomGeneratorSeed+iwindow);
+                try {
+                    window.numshortcuts = planner->_Shortcut(window.path, numIters, planner.get(), mintimestep);
+                }
+                catch(const std::exception& ex) {
+                    RAVELOG_WARN_FORMAT("env=%d, exception while shortcutting window %d: %s", GetEnv()->GetId()%iwindow%ex.what());
+                    window.numshortcuts = -1;
+                }
+            }
+        }
+    }
+
+    /// \brief the time in the path that is executed now, negative before the execution starts. Only used in online mode
+    inline dReal _GetOnlineExecutionTime() const
+    {
+        return 1e-6*(dReal)(utils::GetMicroTime()-_nPlanStartTime) - _parameters->onlineleadtime;
+    }
+
+    /// \brief checks _vShortcutCandidates[start:end] with the planners of the environment snapshots, called from the worker threads
+    void _CheckShortcutCandidates(const std::vector<ParabolicRamp::ParabolicRampND>& ramps, const std::vector<dReal>& rampStartTime, dReal endTime, dReal mintimestep, dReal fstarttimemult, int iters, size_t start, size_t end)
+    {
+        for(size_t icandidate = start; icandidate < end; ++icandidate) {
+            boost::shared_ptr<ParabolicSmoother> planner = _vShortcutPlanners.at(icandidate);
+            EnvironmentMutex::scoped_lock lock(planner->GetEnv()->GetMutex());
+            _vShortcutResults[icandidate] = planner->_CheckShortcut(ramps, rampStartTime, endTime, mintimestep, fstarttimemult, iters, _vShortcutCandidates[icandidate]);
+        }
+    }
+
+    /// \brief polled by _pShortcutWorkers while the candidates are checked, the candidates that did not start are skipped once the callbacks interrupt the planner
+    bool _IsShortcutInterrupted()
+    {
+        if( !_bShortcutInterrupted && _CallCallbacks(_progress) == PA_Interrupt ) {
+            _bShortcutInterrupted = true;
+        }
+        return _bShortcutInterrupted;
+    }
+
+    /// \brief sets up one planner per shortcut thread on an environment snapshot, see ConstraintTrajectoryTimingParameters::nshortcutthreads
+    ///
+    /// The snapshots are kept between calls so that only the bodies that changed need to be copied. The parameters of the snapshot planners
+    /// are rebuilt from the configuration specification, so custom constraint functions of the original parameters are not used when shortcutting in parallel.
+    bool _InitShortcutPlanners()
+    {
+        _vShortcutPlanners.resize(0);
+        _vShortcutParameters.resize(0);
+        int numthreads = _parameters->nshortcutthreads;
+        if( numthreads <= 1 ) {
+            _vShortcutEnvs.resize(0);
+            _pShortcutWorkers.reset();
+            return true;
+        }
+        _vShortcutEnvs.resize(numthreads);
+        for(int ithread = 0; ithread < numthreads; ++ithread) {
+            if( !_vShortcutEnvs[ithread] ) {
+                _vShortcutEnvs[ithread] = GetEnv()->CloneSelf(Clone_Bodies);
+            }
+            else {
+                _vShortcutEnvs[ithread]->Clone(GetEnv(), Clone_Bodies|Clone_SkipUnchangedBodies);
+            }
+            EnvironmentMutex::scoped_lock lockshortcut(_vShortcutEnvs[ithread]->GetMutex());
+            ConstraintTrajectoryTimingParametersPtr params(new ConstraintTrajectoryTimingParameters());
+            params->copy(_parameters);
+            params->SetConfigurationSpecification(_vShortcutEnvs[ithread], _parameters->_configurationspecification);
+            // SetConfigurationSpecification resets the limits to the ones of the bodies
+            params->_vConfigLowerLimit = _parameters->_vConfigLowerLimit;
+            params->_vConfigUpperLimit = _parameters->_vConfigUpperLimit;
+            params->_vConfigVelocityLimit = _parameters->_vConfigVelocityLimit;
+            params->_vConfigAccelerationLimit = _parameters->_vConfigAccelerationLimit;
+            params->_vConfigResolution = _parameters->_vConfigResolution;
+            params->nshortcutthreads = 1;
+            boost::shared_ptr<ParabolicSmoother> planner = boost::dynamic_pointer_cast<ParabolicSmoother>(RaveCreatePlanner(_vShortcutEnvs[ithread], GetXMLId()));
+            if( !planner ) {
+                RAVELOG_WARN_FORMAT("failed to create shortcut planner %s", GetXMLId());
+                return false;
+            }
+            if( !planner->InitPlan(RobotBasePtr(), params) ) {
+                RAVELOG_WARN_FORMAT("shortcut planner %d failed to initialize", ithread);
+                return false;
+            }
+            _vShortcutPlanners.push_back(planner);
+            _vShortcutParameters.push_back(params); // the constraint functions of params only hold weak references to it
+        }
+        if( !_pShortcutWorkers || _pShortcutWorkers->GetNumThreads() != numthreads ) {
+            _pShortcutWorkers.reset(new ParallelRangeWorkers(numthreads, "ParabolicSmootherShortcut"));
+        }
+        return true;
+    }
+
+    bool GetStatisticsCommand(std::ostream& os, std::istream& is)
+    {
+        int numthreads = !!_parameters ? max(1, _parameters->nshortcutthreads) : 1;
+        dReal fcandidatespersecond = _fShortcutDuration > 0 ? _nShortcutCandidates/_fShortcutDuration : 0;
+        dReal facceptancerate = _nShortcutCandidates > 0 ? (dReal)_nShortcutsAccepted/(dReal)_nShortcutCandidates : 0;
+        os << "shortcut numthreads " << numthreads << " numcandidates " << _nShortcutCandidates << " numaccepted " << _nShortcutsAccepted << " duration " << _fShortcutDuration << " candidatespersecond " << fcandidatespersecond << " acceptancerate " << facceptancerate << std::endl;
+        // the segments checked by the snapshot planners count as well
+        int nsegmentsaccepted = _nSegmentsAccepted, nsegmentsrejected = _nSegmentsRejected, ncheckedaccepted = _nCheckedAccepted, ncheckedrejected = _nCheckedRejected;
+        FOREACHC(itplanner, _vShortcutPlanners) {
+            nsegmentsaccepted += (*itplanner)->_nSegmentsAccepted;
+            nsegmentsrejected += (*itplanner)->_nSegmentsRejected;
+            ncheckedaccepted += (*itplanner)->_nCheckedAccepted;
+            ncheckedrejected += (*itplanner)->_nCheckedRejected;
+        }
+        dReal fcheckedperaccepted = nsegmentsaccepted > 0 ? (dReal)ncheckedaccepted/(dReal)nsegmentsaccepted : 0;
+        dReal fcheckedperrejected = nsegmentsrejected > 0 ? (dReal)ncheckedrejected/(dReal)nsegmentsrejected : 0;
+        os << "segments bisection " << (!!_parameters ? _parameters->bisectioncheckorder : 0) << " numaccepted " << nsegmentsaccepted << " checkedperaccepted " << fcheckedperaccepted << " numrejected " << nsegmentsrejected << " checkedperrejected " << fcheckedperrejected << std::endl;
+        return !!os;
+    }
+
     /// \brief extracts the unique switch points for every 1D ramp. endtime is included.
     ///
     /// \param binitialized if false then 0 is *not* included.
@@ -1461,17 +1885,34 @@ protected:
 
     //@{ cache
     ParabolicRamp::DynamicPath _cacheintermediate, _cacheintermediate2, _cachedynamicpath;
-    std::vector<ParabolicRamp::ParabolicRampND> _cacheaccumoutramps, _cacheoutramps;
+    std::vector<ParabolicRamp::ParabolicRampND> _cacheoutramps;
     std::vector<dReal> _cachetrajpoints, _cacheswitchtimes;
     vector<ParabolicRamp::Vector> _cachepath;
     std::vector<dReal> _cachevellimits, _cacheaccellimits;
     std::vector<dReal> _x0cache, _dx0cache, _x1cache, _dx1cache;
+    std::vector<ShortcutCandidate> _vShortcutCandidates; ///< the candidates of the current shortcut iteration
+    std::vector<int> _vShortcutResults; ///< the return values of _CheckShortcut for _vShortcutCandidates
+    std::vector<ShortcutWindow> _vShortcutWindows; ///< the windows of the path in _ShortcutWindows
     //@}
 
+    std::vector<EnvironmentBasePtr> _vShortcutEnvs; ///< environment snapshots of the shortcut planners, see ConstraintTrajectoryTimingParameters::nshortcutthreads
+    std::vector< boost::shared_ptr<ParabolicSmoother> > _vShortcutPlanners; ///< initialized planners checking the shortcut candidates in parallel
+    std::vector<ConstraintTrajectoryTimingParametersPtr> _vShortcutParameters; ///< the parameters _vShortcutPlanners were initialized with
+    ParallelRangeWorkersPtr _pShortcutWorkers; ///< threads running _vShortcutPlanners
+    bool _bShortcutInterrupted; ///< set by _IsShortcutInterrupted when the callbacks interrupted checking the shortcut candidates
+
+    int _nShortcutCandidates; ///< number of shortcut candidates checked in the last PlanPath
+    int _nShortcutsAccepted; ///< number of shortcuts applied in the last PlanPath
+    dReal _fShortcutDuration; ///< time in seconds spent shortcutting in the last PlanPath
+    int _nSegmentsAccepted, _nSegmentsRejected; ///< number of segments passing/failing the path constraints in SegmentFeasible2
+    int _nCheckedAccepted, _nCheckedRejected; ///< total ConstraintFilterReturn::_numcheckedconfigurations of the accepted/rejected segments
+
     TrajectoryBasePtr _dummytraj;
     PlannerProgress _progress;
     bool _bUsePerturbation;
     bool _bmanipconstraints; /// if true, check workspace manip constraints
+    bool _bOnline; ///< if true, the path is executed while it is shortcut, see ConstraintTrajectoryTimingParameters::onlineleadtime
+    uint64_t _nPlanStartTime; ///< time in microseconds the last PlanPath was called, used for the deadline and the online execution time
 };
 
 
@@ -1480,6 +1921,11 @@ PlannerBasePtr CreateParabolicSmoother(EnvironmentBasePtr penv, std::istream& si
     return PlannerBasePtr(new ParabolicSmoother(penv,sinput));
 }
 
+PlannerBasePtr CreateOnlineParabolicSmoother(EnvironmentBasePtr penv, std::istream& sinput)
+{
+    return PlannerBasePtr(new ParabolicSmoother(penv,sinput,true));
+}
+
 } // using namespace rplanners
 
 #ifdef RAVE_REGISTER_BOOST
@@ -0,0 +1,431 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2014 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "rplanners.h"
+
+/// \brief plans by retrieving and repairing the paths of previous queries
+///
+/// Every successful path is stored in a library indexed by its start and goal configurations. A new query takes the paths whose
+/// start and goal are closest to its own, replaces their end points with the query configurations and checks them. Only the invalid
+/// segments are planned again with BiRRT. If no retrieved path can be repaired, the whole query is planned with BiRRT.
+class PathLibraryPlanner : public PlannerBase
+{
+public:
+    class PathLibraryParameters : public PlannerBase::PlannerParameters {
+public:
+        PathLibraryParameters() : _nRetrievedPaths(3), _nRepairIterations(1000), _bProcessingLibrary(false) {
+            _vXMLParameters.push_back("retrievedpaths");
+            _vXMLParameters.push_back("repairiterations");
+        }
+
+        int _nRetrievedPaths; ///< number of closest library paths that are tried before planning from scratch
+        int _nRepairIterations; ///< maximum iterations of BiRRT when repairing one invalid part of a retrieved path
+protected:
+        bool _bProcessingLibrary;
+        virtual bool serialize(std::ostream& O) const
+        {
+            if( !PlannerParameters::serialize(O) ) {
+                return false;
+            }
+            O << "<retrievedpaths>" << _nRetrievedPaths << "</retrievedpaths>" << endl;
+            O << "<repairiterations>" << _nRepairIterations << "</repairiterations>" << endl;
+            return !!O;
+        }
+
+        ProcessElement startElement(const std::string& name, const AttributesList& atts)
+        {
+            if( _bProcessingLibrary ) {
+                return PE_Ignore;
+            }
+            switch( PlannerBase::PlannerParameters::startElement(name,atts) ) {
+            case PE_Pass: break;
+            case PE_Support: return PE_Support;
+            case PE_Ignore: return PE_Ignore;
+            }
+            _bProcessingLibrary = name=="retrievedpaths"||name=="repairiterations";
+            return _bProcessingLibrary ? PE_Support : PE_Pass;
+        }
+        virtual bool endElement(const string& name)
+        {
+            if( _bProcessingLibrary ) {
+                if( name == "retrievedpaths" ) {
+                    _ss >> _nRetrievedPaths;
+                }
+                else if( name == "repairiterations" ) {
+                    _ss >> _nRepairIterations;
+                }
+                else {
+                    RAVELOG_WARN(str(boost::format("unknown tag %s\n")%name));
+                }
+                _bProcessingLibrary = false;
+                return false;
+            }
+            // give a chance for the default parameters to get processed
+            return PlannerParameters::endElement(name);
+        }
+    };
+    typedef boost::shared_ptr<PathLibraryParameters> PathLibraryParametersPtr;
+
+    /// \brief how the queries since the library was reset were answered
+    class Statistics
+    {
+public:
+        Statistics() : numqueries(0), numhits(0), numrepaired(0), numfallbacks(0), numfailures(0), numrepairedsegments(0) {
+        }
+        int numqueries;
+        int numhits; ///< retrieved paths that were valid without any repair
+        int numrepaired; ///< retrieved paths that were valid after repairing some segments
+        int numfallbacks; ///< queries planned from scratch
+        int numfailures;
+        int numrepairedsegments; ///< number of invalid parts of retrieved paths that BiRRT connected
+    };
+
+    PathLibraryPlanner(EnvironmentBasePtr penv, std::istream& sinput) : PlannerBase(penv), _bBatchCheck(false), _librarytree(0)
+    {
+        __description = ":Interface Author: Rosen Diankov\n\nExperience based planning that retrieves and repairs the paths of previous queries. See\n\n\
+- D. Berenson, P. Abbeel, K. Goldberg. A robot path planning framework that learns from experience. In Proc. IEEE Int'l Conf. on Robotics and Automation (ICRA'2012).\n\n\
+Successful paths are stored in a library indexed by their start and goal configurations. A query checks the closest library paths after replacing their end points with its own, \
+using CollisionCheckerBase::CheckCollisionBatch when the planning space is made of the active joints of the robot. The invalid parts are planned again with BiRRT. \
+If no path can be repaired, the query is planned with BiRRT from scratch. The library is kept as long as the robot and its planning space do not change.\n";
+        RegisterCommand("ResetLibrary",boost::bind(&PathLibraryPlanner::_ResetLibraryCommand,this,_1,_2),
+                        "removes all the stored paths");
+        RegisterCommand("GetStatistics",boost::bind(&PathLibraryPlanner::_GetStatisticsCommand,this,_1,_2),
+                        "returns the name 'library' followed by name/value pairs of numpaths, numqueries, numhits, numrepaired, numfallbacks, numfailures, numrepairedsegments and hitrate. hitrate is the fraction of queries answered with a retrieved path, repaired or not.");
+    }
+    virtual ~PathLibraryPlanner() {
+    }
+
+    virtual PlannerParametersConstPtr GetParameters() const {
+        return _parameters;
+    }
+
+    virtual bool InitPlan(RobotBasePtr pbase, PlannerParametersConstPtr pparams)
+    {
+        EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+        _parameters.reset();
+        PathLibraryParametersPtr parameters(new PathLibraryParameters());
+        parameters->copy(pparams);
+        parameters->Validate();
+        const int dof = parameters->GetDOF();
+        if( (int)parameters->vinitialconfig.size() < dof || (int)parameters->vgoalconfig.size() < dof ) {
+            RAVELOG_WARN_FORMAT("env=%d, path library needs an initial and a goal configuration", GetEnv()->GetId());
+            return false;
+        }
+        _robot = pbase;
+
+        std::stringstream ss;
+        ss << _robot->GetRobotStructureHash() << " " << parameters->_configurationspecification;
+        std::string libraryhash = utils::GetMD5HashString(ss.str());
+        _parameters = parameters;
+        if( libraryhash != _libraryhash ) {
+            _libraryhash = libraryhash;
+            _ResetLibrary();
+        }
+
+        // the batch collision api sets the dof values of the robot directly, so it can only be used when planning for the active joints
+        ConfigurationSpecification robotspec = _robot->GetActiveConfigurationSpecification();
+        const std::vector<ConfigurationSpecification::Group>& vgroups = _parameters->_configurationspecification._vgroups;
+        _bBatchCheck = _robot->GetAffineDOF() == 0 && vgroups.size() == 1 && robotspec._vgroups.size() == 1 && vgroups[0].name == robotspec._vgroups[0].name;
+
+        if( !_birrt ) {
+            _birrt = RaveCreatePlanner(GetEnv(), "BiRRT");
+            if( !_birrt ) {
+                RAVELOG_WARN("path library needs the BiRRT planner\n");
+                _parameters.reset();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj)
+    {
+        if( !_parameters ) {
+            RAVELOG_ERROR("PathLibraryPlanner::PlanPath - Error, planner not initialized\n");
+            return PS_Failed;
+        }
+
+        EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+        uint32_t basetime = utils::GetMilliTime();
+        PlannerParameters::StateSaver savestate(_parameters);
+        CollisionOptionsStateSaver optionstate(GetEnv()->GetCollisionChecker(),GetEnv()->GetCollisionChecker()->GetCollisionOptions()|CO_ActiveDOFs,false);
+
+        const int dof = _parameters->GetDOF();
+        std::vector<dReal> vstart(_parameters->vinitialconfig.begin(), _parameters->vinitialconfig.begin()+dof);
+        std::vector<dReal> vgoal(_parameters->vgoalconfig.begin(), _parameters->vgoalconfig.begin()+dof);
+        std::vector<dReal> vkey(vstart);
+        vkey.insert(vkey.end(), vgoal.begin(), vgoal.end());
+        ++_stats.numqueries;
+
+        bool bFound = false;
+        _librarytree.FindNearestNodes(vkey, _parameters->_nRetrievedPaths, std::numeric_limits<dReal>::infinity(), _vnearest);
+        FOREACHC(itnearest, _vnearest) {
+            const std::vector<dReal>& vlibrarypath = _vpaths.at(((SimpleNode*)itnearest->first)->_userdata);
+            if( (int)vlibrarypath.size() < 2*dof ) {
+                continue;
+            }
+            // the stored end points are replaced by the query configurations
+            _vcandidate = vstart;
+            _vcandidate.insert(_vcandidate.end(), vlibrarypath.begin()+dof, vlibrarypath.end()-dof);
+            _vcandidate.insert(_vcandidate.end(), vgoal.begin(), vgoal.end());
+            int numrepaired = 0;
+            if( _RepairPath(_vcandidate, _vpath, numrepaired) ) {
+                if( numrepaired == 0 ) {
+                    ++_stats.numhits;
+                }
+                else {
+                    ++_stats.numrepaired;
+                    _stats.numrepairedsegments += numrepaired;
+                }
+                RAVELOG_DEBUG_FORMAT("env=%d, retrieved library path with %d waypoints, repaired %d parts", GetEnv()->GetId()%(_vcandidate.size()/dof)%numrepaired);
+                bFound = true;
+                break;
+            }
+        }
+
+        if( !bFound ) {
+            ++_stats.numfallbacks;
+            if( !_PlanSegment(_parameters->vinitialconfig, _parameters->vgoalconfig, _parameters->_nMaxIterations, _vpath) ) {
+                ++_stats.numfailures;
+                RAVELOG_WARN_FORMAT("env=%d, path library plan failed, %fs", GetEnv()->GetId()%(0.001f*(float)(utils::GetMilliTime()-basetime)));
+                return PS_Failed;
+            }
+        }
+
+        if( (int)_vpath.size() >= 2*dof ) {
+            _AddPath(_vpath);
+        }
+        if( ptraj->GetConfigurationSpecification().GetDOF() == 0 ) {
+            ptraj->Init(_parameters->_configurationspecification);
+        }
+        ptraj->Insert(ptraj->GetNumWaypoints(), _vpath, _parameters->_configurationspecification);
+        RAVELOG_DEBUG_FORMAT("env=%d, path library plan success, path=%d points, library=%d paths, computation time=%fs", GetEnv()->GetId()%ptraj->GetNumWaypoints()%_vpaths.size()%(0.001f*(float)(utils::GetMilliTime()-basetime)));
+        return _ProcessPostPlanners(_robot,ptraj);
+    }
+
+protected:
+    void _ResetLibrary()
+    {
+        _vpaths.resize(0);
+        if( !!_parameters ) {
+            const int dof = _parameters->GetDOF();
+            _vkeydistconfig0.resize(dof);
+            _vkeydistconfig1.resize(dof);
+            _keydistmetricfn = boost::bind(&PathLibraryPlanner::_ComputeKeyDistance, this, _1, _2);
+            _librarytree.Init(boost::static_pointer_cast<PlannerBase>(shared_from_this()), 2*dof, _keydistmetricfn, _parameters->_fStepLength, 2*_parameters->_distmetricfn(_parameters->_vConfigLowerLimit, _parameters->_vConfigUpperLimit));
+        }
+        else {
+            _librarytree.Reset();
+        }
+    }
+
+    /// \brief distance of two library keys, the sum of the distances of their start and goal configurations
+    dReal _ComputeKeyDistance(const std::vector<dReal>& vkey0, const std::vector<dReal>& vkey1)
+    {
+        const size_t dof = _vkeydistconfig0.size();
+        std::copy(vkey0.begin(), vkey0.begin()+dof, _vkeydistconfig0.begin());
+        std::copy(vkey1.begin(), vkey1.begin()+dof, _vkeydistconfig1.begin());
+        dReal fdist = _parameters->_distmetricfn(_vkeydistconfig0, _vkeydistconfig1);
+        std::copy(vkey0.begin()+dof, vkey0.begin()+2*dof, _vkeydistconfig0.begin());
+        std::copy(vkey1.begin()+dof, vkey1.begin()+2*dof, _vkeydistconfig1.begin());
+        return fdist + _parameters->_distmetricfn(_vkeydistconfig0, _vkeydistconfig1);
+    }
+
+    /// \brief stores the path, replacing the stored path of the same start and goal
+    void _AddPath(const std::vector<dReal>& vpath)
+    {
+        const int dof = _parameters->GetDOF();
+        std::vector<dReal> vkey(vpath.begin(), vpath.begin()+dof);
+        vkey.insert(vkey.end(), vpath.end()-dof, vpath.end());
+        if( !!_librarytree.InsertNode(NULL, vkey, _vpaths.size()) ) {
+            _vpaths.push_back(vpath);
+        }
+        else {
+            std::pair<NodeBasePtr, dReal> nearest = _librarytree.FindNearestNode(vkey);
+            if( !!nearest.first ) {
+                _vpaths.at(((SimpleNode*)nearest.first)->_userdata) = vpath;
+            }
+        }
+    }
+
+    /// \brief checks the waypoints and segments of vcandidate and plans again between the valid waypoints around the invalid segments
+    ///
+    /// \param vpath filled with the repaired path
+    /// \param numrepaired the number of parts that were planned again
+    bool _RepairPath(const std::vector<dReal>& vcandidate, std::vector<dReal>& vpath, int& numrepaired)
+    {
+        const int dof = _parameters->GetDOF();
+        const int numwaypoints = vcandidate.size()/dof;
+        numrepaired = 0;
+        _CheckPath(vcandidate, _vwaypointvalid, _vsegmentvalid);
+        if( !_vwaypointvalid.at(0) || !_vwaypointvalid.at(numwaypoints-1) ) {
+            return false;
+        }
+
+        vpath.assign(vcandidate.begin(), vcandidate.begin()+dof);
+        int iwaypoint = 0;
+        while(iwaypoint+1 < numwaypoints) {
+            if( _vsegmentvalid[iwaypoint] ) {
+                ++iwaypoint;
+                vpath.insert(vpath.end(), vcandidate.begin()+iwaypoint*dof, vcandidate.begin()+(iwaypoint+1)*dof);
+                continue;
+            }
+            // connect to the next waypoint that is not in collision
+            int inextwaypoint = iwaypoint+1;
+            while(!_vwaypointvalid[inextwaypoint]) {
+                ++inextwaypoint;
+            }
+            _vsegmentstart.assign(vcandidate.begin()+iwaypoint*dof, vcandidate.begin()+(iwaypoint+1)*dof);
+            _vsegmentgoal.assign(vcandidate.begin()+inextwaypoint*dof, vcandidate.begin()+(inextwaypoint+1)*dof);
+            if( !_PlanSegment(_vsegmentstart, _vsegmentgoal, _parameters->_nRepairIterations, _vsegmentpath) ) {
+                return false;
+            }
+            vpath.insert(vpath.end(), _vsegmentpath.begin()+dof, _vsegmentpath.end());
+            ++numrepaired;
+            iwaypoint = inextwaypoint;
+        }
+        return true;
+    }
+
+    /// \brief fills which waypoints satisfy the constraints and which segments connect their waypoints without violating them
+    void _CheckPath(const std::vector<dReal>& vcandidate, std::vector<uint8_t>& vwaypointvalid, std::vector<uint8_t>& vsegmentvalid)
+    {
+        const int dof = _parameters->GetDOF();
+        const int numwaypoints = vcandidate.size()/dof;
+        vwaypointvalid.resize(0); vwaypointvalid.resize(numwaypoints, 1);
+        vsegmentvalid.resize(0); vsegmentvalid.resize(max(0, numwaypoints-1), 1);
+        std::vector<dReal> vconfig0(dof), vconfig1(dof);
+        if( !_bBatchCheck ) {
+            for(int iwaypoint = 0; iwaypoint < numwaypoints; ++iwaypoint) {
+                vconfig0.assign(vcandidate.begin()+iwaypoint*dof, vcandidate.begin()+(iwaypoint+1)*dof);
+                vwaypointvalid[iwaypoint] = _parameters->CheckPathAllConstraints(vconfig0, vconfig0, std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenStart) == 0;
+            }
+            for(int iwaypoint = 0; iwaypoint+1 < numwaypoints; ++iwaypoint) {
+                if( vwaypointvalid[iwaypoint] && vwaypointvalid[iwaypoint+1] ) {
+                    vconfig0.assign(vcandidate.begin()+iwaypoint*dof, vcandidate.begin()+(iwaypoint+1)*dof);
+                    vconfig1.assign(vcandidate.begin()+(iwaypoint+1)*dof, vcandidate.begin()+(iwaypoint+2)*dof);
+                    vsegmentvalid[iwaypoint] = _parameters->CheckPathAllConstraints(vconfig0, vconfig1, std::vector<dReal>(), std::vector<dReal>(), 0, IT_Open) == 0;
+                }
+                else {
+                    vsegmentvalid[iwaypoint] = 0;
+                }
+            }
+            return;
+        }
+
+        // gather the waypoints and the interpolated configurations of all segments, checking the constraints other than collisions on the way,
+        // then check all the collisions with one batch call
+        if( !_filterreturn ) {
+            _filterreturn.reset(new ConstraintFilterReturn());
+        }
+        const int options = (CFO_RecommendedOptions&~(CFO_CheckEnvCollisions|CFO_CheckSelfCollisions))|CFO_FillCheckedConfiguration;
+        _vbatchconfigs = vcandidate;
+        _vbatchsegments.resize(0); _vbatchsegments.resize(numwaypoints, -1);
+        for(int iwaypoint = 0; iwaypoint+1 < numwaypoints; ++iwaypoint) {
+            vconfig0.assign(vcandidate.begin()+iwaypoint*dof, vcandidate.begin()+(iwaypoint+1)*dof);
+            vconfig1.assign(vcandidate.begin()+(iwaypoint+1)*dof, vcandidate.begin()+(iwaypoint+2)*dof);
+            _filterreturn->Clear();
+            if( _parameters->CheckPathAllConstraints(vconfig0, vconfig1, std::vector<dReal>(), std::vector<dReal>(), 0, IT_Open, options, _filterreturn) != 0 ) {
+                vsegmentvalid[iwaypoint] = 0;
+                continue;
+            }
+            _vbatchconfigs.insert(_vbatchconfigs.end(), _filterreturn->_configurations.begin(), _filterreturn->_configurations.end());
+            _vbatchsegments.resize(_vbatchconfigs.size()/dof, iwaypoint);
+        }
+        GetEnv()->GetCollisionChecker()->CheckCollisionBatch(_robot, _robot->GetActiveDOFIndices(), &_vbatchconfigs[0], _vbatchconfigs.size()/dof, _vbatchresults, true);
+        for(int iwaypoint = 0; iwaypoint < numwaypoints; ++iwaypoint) {
+            if( _vbatchresults[iwaypoint] ) {
+                vwaypointvalid[iwaypoint] = 0;
+                if( iwaypoint > 0 ) {
+                    vsegmentvalid[iwaypoint-1] = 0;
+                }
+                if( iwaypoint+1 < numwaypoints ) {
+                    vsegmentvalid[iwaypoint] = 0;
+                }
+            }
+        }
+        for(size_t iconfig = numwaypoints; iconfig < _vbatchresults.size(); ++iconfig) {
+            if( _vbatchresults[iconfig] ) {
+                vsegmentvalid.at(_vbatchsegments[iconfig]) = 0;
+            }
+        }
+    }
+
+    /// \brief plans between two configurations with BiRRT without post processing, vpath is filled with the waypoints
+    bool _PlanSegment(const std::vector<dReal>& vstart, const std::vector<dReal>& vgoal, int nMaxIterations, std::vector<dReal>& vpath)
+    {
+        PlannerParametersPtr params(new PlannerParameters());
+        params->copy(_parameters);
+        params->vinitialconfig = vstart;
+        params->vgoalconfig = vgoal;
+        params->_nMaxIterations = nMaxIterations;
+        params->_sPostProcessingPlanner = "";
+        params->_sPostProcessingParameters = "";
+        if( !_birrt->InitPlan(_robot, params) ) {
+            return false;
+        }
+        if( !_segmenttraj ) {
+            _segmenttraj = RaveCreateTrajectory(GetEnv(), "");
+        }
+        _segmenttraj->Init(_parameters->_configurationspecification);
+        if( !(_birrt->PlanPath(_segmenttraj) & PS_HasSolution) ) {
+            return false;
+        }
+        _segmenttraj->GetWaypoints(0, _segmenttraj->GetNumWaypoints(), vpath, _parameters->_configurationspecification);
+        return vpath.size() > 0;
+    }
+
+    bool _ResetLibraryCommand(std::ostream& sout, std::istream& sinput)
+    {
+        EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+        _ResetLibrary();
+        _stats = Statistics();
+        return true;
+    }
+
+    bool _GetStatisticsCommand(std::ostream& sout, std::istream& sinput)
+    {
+        dReal fhitrate = _stats.numqueries > 0 ? dReal(_stats.numhits+_stats.numrepaired)/dReal(_stats.numqueries) : dReal(0);
+        sout << "library numpaths " << _vpaths.size() << " numqueries " << _stats.numqueries << " numhits " << _stats.numhits << " numrepaired " << _stats.numrepaired << " numfallbacks " << _stats.numfallbacks << " numfailures " << _stats.numfailures << " numrepairedsegments " << _stats.numrepairedsegments << " hitrate " << fhitrate;
+        return true;
+    }
+
+    PathLibraryParametersPtr _parameters;
+    RobotBasePtr _robot;
+    PlannerBasePtr _birrt; ///< plans the repairs and the queries that cannot be answered from the library
+    std::string _libraryhash; ///< hash of the robot structure and planning space the library is built for
+    bool _bBatchCheck; ///< if true, the collisions of the retrieved paths are checked with CollisionCheckerBase::CheckCollisionBatch
+
+    SpatialTree<SimpleNode> _librarytree; ///< the concatenated start and goal configurations of the stored paths, SimpleNode::_userdata indexes _vpaths
+    std::vector< std::vector<dReal> > _vpaths; ///< the waypoints of the stored paths
+    boost::function<dReal(const std::vector<dReal>&, const std::vector<dReal>&)> _keydistmetricfn;
+    Statistics _stats;
+
+    // cache
+    ConstraintFilterReturnPtr _filterreturn;
+    TrajectoryBasePtr _segmenttraj;
+    std::vector< std::pair<NodeBasePtr, dReal> > _vnearest;
+    std::vector<dReal> _vkeydistconfig0, _vkeydistconfig1;
+    std::vector<dReal> _vcandidate, _vpath, _vsegmentstart, _vsegmentgoal, _vsegmentpath;
+    std::vector<dReal> _vbatchconfigs;
+    std::vector<int> _vbatchsegments; ///< for every configuration of _vbatchconfigs the segment it belongs to, -1 for the waypoints
+    std::vector<uint8_t> _vbatchresults, _vwaypointvalid, _vsegmentvalid;
+};
+
+PlannerBasePtr CreatePathLibraryPlanner(EnvironmentBasePtr penv, std::istream& sinput)
+{
+    return PlannerBasePtr(new PathLibraryPlanner(penv, sinput));
+}
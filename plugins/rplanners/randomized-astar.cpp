@@ -13,7 +13,7 @@
 //
 // You should have received a copy of the GNU Lesser General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
-#include "openraveplugindefs.h"
+#include "rplanners.h"
 
 class RandomizedAStarPlanner : public PlannerBase
 {
@@ -50,87 +50,16 @@ private:
     };
 
 
-    // sorted by increasing getvalue
-    template <class T, class S> class BinarySearchTree
-    {
-public:
-        BinarySearchTree() {
-            Reset();
-        }
-
-        // other global definitions
-        void Add(T& pex)
-        {
-            BOOST_ASSERT( pex != NULL );
-
-            switch(blocks.size()) {
-            case 0:
-                blocks.push_back(pex);
-                return;
-            case 1:
-                if( blocks.front()->getvalue() < pex->getvalue() ) {
-                    blocks.push_back(pex);
-                }
-                else blocks.insert(blocks.begin(), pex);
-
-                return;
-
-            default: {
-                int imin = 0, imax = (int)blocks.size(), imid;
-
-                while(imin < imax) {
-                    imid = (imin+imax)>>1;
-
-                    if( blocks[imid]->getvalue() > pex->getvalue() ) imax = imid;
-                    else imin = imid+1;
-                }
-
-                blocks.insert(blocks.begin()+imin, pex);
-                return;
-            }
-            }
-        }
-
-        ///< returns the index into blocks
-        int Get(S& s)
-        {
-            switch(blocks.size()) {
-            case 1: return 0;
-            case 2: return blocks.front()->getvalue() < s;
-            default: {
-                int imin = 0, imax = blocks.size()-1, imid;
-
-                while(imin < imax) {
-                    imid = (imin+imax)>>1;
-
-                    if( blocks[imid]->getvalue() > s ) imax = imid;
-                    else if( blocks[imid]->getvalue() == s ) return imid;
-                    else imin = imid+1;
-                }
-
-                return imin;
-            }
-            }
-        }
-
-        void Reset()
-        {
-            blocks.clear();
-            blocks.reserve(1<<16);
-        }
-
-        vector<T> blocks;
-    };
-
 public:
     class RAStarParameters : public PlannerBase::PlannerParameters {
 public:
-        RAStarParameters() : fRadius(0.1f), fDistThresh(0.03f), fGoalCoeff(1), nMaxChildren(5), nMaxSampleTries(10), _bProcessingRA(false) {
+        RAStarParameters() : fRadius(0.1f), fDistThresh(0.03f), fGoalCoeff(1), nMaxChildren(5), nMaxSampleTries(10), nMaxOpenNodes(16384), _bProcessingRA(false) {
             _vXMLParameters.push_back("radius");
             _vXMLParameters.push_back("distthresh");
             _vXMLParameters.push_back("goalcoeff");
             _vXMLParameters.push_back("maxchildren");
             _vXMLParameters.push_back("maxsampletries");
+            _vXMLParameters.push_back("maxopennodes");
         }
 
         dReal fRadius;              ///< _pDistMetric thresh is the radius that children must be within parents
@@ -138,6 +67,7 @@ public:
         dReal fGoalCoeff;           ///< balancees exploratino vs cost
         int nMaxChildren;           ///< limit on number of children
         int nMaxSampleTries;         ///< max sample tries before giving up on creating a child
+        int nMaxOpenNodes;           ///< max size of the open list, when exceeded the nodes with the worst total cost are dropped from it. If <= 0, the open list is unbounded
 protected:
         bool _bProcessingRA;
         virtual bool serialize(std::ostream& O) const
@@ -150,6 +80,7 @@ protected:
             O << "<goalcoeff>" << fGoalCoeff << "</goalcoeff>" << endl;
             O << "<maxchildren>" << nMaxChildren << "</maxchildren>" << endl;
             O << "<maxsampletries>" << nMaxSampleTries << "</maxsampletries>" << endl;
+            O << "<maxopennodes>" << nMaxOpenNodes << "</maxopennodes>" << endl;
 
             return !!O;
         }
@@ -163,7 +94,7 @@ protected:
             case PE_Support: return PE_Support;
             case PE_Ignore: return PE_Ignore;
             }
-            _bProcessingRA = name=="radius"||name=="distthresh"||name=="goalcoeff"||name=="maxchildren"||name=="maxsampletries";
+            _bProcessingRA = name=="radius"||name=="distthresh"||name=="goalcoeff"||name=="maxchildren"||name=="maxsampletries"||name=="maxopennodes";
             return _bProcessingRA ? PE_Support : PE_Pass;
         }
         virtual bool endElement(const string& name)
@@ -179,6 +110,8 @@ protected:
                     _ss >> nMaxChildren;
                 else if( name == "maxsampletries")
                     _ss >> nMaxSampleTries;
+                else if( name == "maxopennodes")
+                    _ss >> nMaxOpenNodes;
                 else
                     RAVELOG_WARN(str(boost::format("unknown tag %s\n")%name));
                 _bProcessingRA = false;
@@ -189,87 +122,20 @@ protected:
         }
     };
 
-    struct Node
+    /// \brief A* information of a node in the spatial tree, the node stores its index in SimpleNode::_userdata
+    struct NodeInfo
     {
-        Node() {
-            parent = NULL; level = 0; numchildren = 0;
-        }
-
-        // negative because those are most likely to be popped first
-        dReal getvalue() {
-            return -ftotal;
-        }
-
-        bool compare(const Node* r) {
-            BOOST_ASSERT(r != NULL); return ftotal < r->ftotal;
+        NodeInfo(SimpleNode* node, int parent, dReal fcost, dReal ftotal) : node(node), parent(parent), fcost(fcost), ftotal(ftotal), numchildren(0) {
         }
 
+        SimpleNode* node;
+        int parent; ///< index of the parent info, -1 for the root
         dReal fcost, ftotal;
-        int level;
-        Node* parent;
         int numchildren;
-        vector<dReal> q;     // the configuration immediately follows the struct
     };
 
-    static bool SortChildGoal(const RandomizedAStarPlanner::Node* p1, const RandomizedAStarPlanner::Node* p2)
-    {
-        return p1->ftotal < p2->ftotal;    //p1->ftotal-p1->fcost < p2->ftotal-p2->fcost;
-    }
-
-    // implement kd-tree or approx-nn in the future, deallocates memory from Node
-    class SpatialTree
-    {
-public:
-        SpatialTree() {
-            _fBestDist = 0;
-        }
-        ~SpatialTree() {
-            Destroy();
-        }
-
-        void Destroy()
-        {
-            list<Node*>::iterator it;
-            FORIT(it, _nodes)
-            delete *it;
-            FORIT(it, _dead)
-            delete *it;
-            _nodes.clear();
-        }
-
-        inline void AddNode(Node* pnode) {
-            _nodes.push_back(pnode);
-        }
-        Node* GetNN(const vector<dReal>& q)
-        {
-            if( _nodes.size() == 0 )
-                return NULL;
-
-            list<Node*>::iterator itnode = _nodes.begin(), itbest = _nodes.begin();
-            dReal fbest = _pDistMetric(q, _nodes.front()->q);
-            ++itnode;
-
-            while(itnode != _nodes.end()) {
-                dReal f = _pDistMetric(q, (*itnode)->q);
-                if( f < fbest ) {
-                    itbest = itnode;
-                    fbest = f;
-                }
-                ++itnode;
-            }
-
-            _fBestDist = fbest;
-            return *itbest;
-        }
-        inline void RemoveNode(Node* pnode) {
-            _nodes.remove(pnode);
-        }
-
-        list<Node*> _nodes;
-        list<Node*> _dead;
-        boost::function<dReal(const std::vector<dReal>&, const std::vector<dReal>&)> _pDistMetric;
-        dReal _fBestDist;         ///< valid after a call to GetNN
-    };
+    /// \brief entry of the open list, (ftotal, node info index)
+    typedef std::pair<dReal, int> OpenEntry;
 
     enum IntervalType {
         OPEN = 0,
@@ -278,10 +144,11 @@ public:
         CLOSED
     };
 
-    RandomizedAStarPlanner(EnvironmentBasePtr penv, std::istream& sinput) : PlannerBase(penv)
+    RandomizedAStarPlanner(EnvironmentBasePtr penv, std::istream& sinput) : PlannerBase(penv), _spatialtree(0), _iClosestNode(-1), _nNumPrunedNodes(0)
     {
         __description = ":Interface Author: Rosen Diankov\n\nRandomized A*. A continuous version of A*. See:\n\
-Rosen Diankov, James Kuffner. \"Randomized Statistical Path Planning. Intl. Conf. on Intelligent Robots and Systems, October 2007.\"\n";
+Rosen Diankov, James Kuffner. \"Randomized Statistical Path Planning. Intl. Conf. on Intelligent Robots and Systems, October 2007.\"\n\n\
+The open list is a binary heap bounded by maxopennodes. If _nMaxPlanningTime is set and expires before the goal is reached, returns the path to the node closest to the goal with PS_InterruptedWithSolution.\n";
         bUseGauss = false;
         nIndex = 0;
     }
@@ -295,15 +162,9 @@ Rosen Diankov, James Kuffner. \"Randomized Statistical Path Planning. Intl. Conf
 
     void Destroy()
     {
-        _spatialtree.Destroy();
-        _sortedtree.Reset();
-
-        //    for(size_t i = 0; i < _vdeadnodes.size(); ++i) {
-        //        _vdeadnodes[i]->~Node();
-        //        free(_vdeadnodes[i]);
-        //    }
-        _vdeadnodes.clear();
-        _vdeadnodes.reserve(1<<16);
+        _spatialtree.Reset();
+        _vnodeinfos.clear();
+        _vopen.clear();
     }
 
     // Planning Methods
@@ -324,10 +185,14 @@ Rosen Diankov, James Kuffner. \"Randomized Statistical Path Planning. Intl. Conf
         if( !parameters->_costfn )
             parameters->_costfn = boost::bind(&SimpleCostMetric::Eval,boost::shared_ptr<SimpleCostMetric>(new SimpleCostMetric(_robot)),_1);
 
-        _vSampleConfig.resize(GetDOF());
-        _jointIncrement.resize(GetDOF());
-        _vzero.resize(GetDOF(),0);
-        _spatialtree._pDistMetric = parameters->_distmetricfn;
+        _vSampleConfig.resize(parameters->GetDOF());
+        _vCurConfig.resize(parameters->GetDOF());
+        _jointIncrement.resize(parameters->GetDOF());
+        _vzero.resize(parameters->GetDOF(),0);
+        _spatialtree.SetMemoryArena(parameters->_parena);
+        _spatialtree.Init(boost::static_pointer_cast<PlannerBase>(shared_from_this()), parameters->GetDOF(), parameters->_distmetricfn, parameters->fDistThresh, parameters->_distmetricfn(parameters->_vConfigLowerLimit, parameters->_vConfigUpperLimit));
+        _spatialtree.SetDistanceMetricBatchFn(parameters->_distmetricbatchfn);
+        _spatialtree.SetStateSpace(planningutils::GetActiveDOFStateSpace(*parameters));
 
         _jointResolutionInv.resize(0);
         FOREACH(itj, parameters->_vConfigResolution) {
@@ -350,10 +215,10 @@ Rosen Diankov, James Kuffner. \"Randomized Statistical Path Planning. Intl. Conf
             return PS_Failed;
         }
         EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+        uint32_t basetime = utils::GetMilliTime();
         Destroy();
 
         RobotBase::RobotStateSaver saver(_robot);
-        Node* pcurrent=NULL, *pbest = NULL;
 
         if( _parameters->CheckPathAllConstraints(_parameters->vinitialconfig,_parameters->vinitialconfig,std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenStart) != 0 ) {
             return PS_Failed;
@@ -362,43 +227,50 @@ Rosen Diankov, James Kuffner. \"Randomized Statistical Path Planning. Intl. Conf
         if( _parameters->SetStateValues(_parameters->vinitialconfig) != 0 ) {
             return PS_Failed;
         }
-        pcurrent = CreateNode(0, NULL, _parameters->vinitialconfig);
+        _iClosestNode = -1;
+        _nNumPrunedNodes = 0;
+        if( _CreateNode(0, -1, _parameters->vinitialconfig) < 0 ) {
+            return PS_Failed;
+        }
 
-        vector<dReal> tempconfig(GetDOF());
         int nMaxIter = _parameters->_nMaxIterations > 0 ? _parameters->_nMaxIterations : 8000;
+        int ibest = -1;
+        bool bTimeExpired = false;
+        PlannerProgress progress;
 
-        while(1) {
-            if( _sortedtree.blocks.size() == 0 ) {
+        while(_vopen.size() > 0) {
+            if( _parameters->_nMaxPlanningTime > 0 && utils::GetMilliTime()-basetime >= _parameters->_nMaxPlanningTime ) {
+                bTimeExpired = true;
                 break;
             }
-            else {
-                pcurrent = _sortedtree.blocks.back();
+            progress._iteration = (int)_vnodeinfos.size();
+            if( _CallCallbacks(progress) == PA_Interrupt ) {
+                return PS_Interrupted;
             }
 
-            // delete from current lists
-            _sortedtree.blocks.pop_back();
-            _vdeadnodes.push_back(pcurrent);
-            BOOST_ASSERT( pcurrent->numchildren < _parameters->nMaxChildren );
+            // pop the node with the lowest total cost
+            std::pop_heap(_vopen.begin(), _vopen.end(), std::greater<OpenEntry>());
+            int icurrent = _vopen.back().second;
+            _vopen.pop_back();
+            BOOST_ASSERT( _vnodeinfos[icurrent].numchildren < _parameters->nMaxChildren );
 
-            if( pcurrent->ftotal - pcurrent->fcost < 1e-4f ) {
-                pbest = pcurrent;
+            if( _vnodeinfos[icurrent].ftotal - _vnodeinfos[icurrent].fcost < 1e-4f ) {
+                ibest = icurrent;
                 break;
             }
 
-            list<Node*> children;
-            int i;
-
-            for(i = 0; i < _parameters->nMaxChildren && pcurrent->numchildren < _parameters->nMaxChildren; ++i) {
+            _spatialtree.GetVectorConfig(_vnodeinfos[icurrent].node, _vCurConfig);
+            for(int i = 0; i < _parameters->nMaxChildren && _vnodeinfos[icurrent].numchildren < _parameters->nMaxChildren; ++i) {
 
                 // keep on sampling until a valid config
                 int sample;
                 for(sample = 0; sample < _parameters->nMaxSampleTries; ++sample) {
-                    if( !_parameters->_sampleneighfn(_vSampleConfig, pcurrent->q, _parameters->fRadius) ) {
+                    if( !_parameters->_sampleneighfn(_vSampleConfig, _vCurConfig, _parameters->fRadius) ) {
                         sample = 1000;
                         break;
                     }
 
-                    if ( _parameters->CheckPathAllConstraints(pcurrent->q, _vSampleConfig, std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenStart) == 0 ) {
+                    if ( _parameters->CheckPathAllConstraints(_vCurConfig, _vSampleConfig, std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenStart) == 0 ) {
                         continue;
                     }
                     if( _parameters->SetStateValues(_vSampleConfig) != 0 ) {
@@ -410,94 +282,117 @@ Rosen Diankov, James Kuffner. \"Randomized Statistical Path Planning. Intl. Conf
                     continue;
                 }
 
-                //while (getchar() != '\n') usleep(1000);
-
-                Node* nearestnode = _spatialtree.GetNN(_vSampleConfig);
-                if( _spatialtree._fBestDist > _parameters->fDistThresh ) {
-                    dReal fdist = _parameters->_distmetricfn(pcurrent->q, _vSampleConfig);
-                    CreateNode(nearestnode->fcost + fdist * _parameters->_costfn(_vSampleConfig), nearestnode, _vSampleConfig, true);
-                    pcurrent->numchildren++;
+                std::pair<NodeBasePtr, dReal> nn = _spatialtree.FindNearestNode(_vSampleConfig);
+                if( nn.second > _parameters->fDistThresh ) {
+                    int inearest = ((SimpleNode*)nn.first)->_userdata;
+                    dReal fdist = _parameters->_distmetricfn(_vCurConfig, _vSampleConfig);
+                    if( _CreateNode(_vnodeinfos[inearest].fcost + fdist * _parameters->_costfn(_vSampleConfig), inearest, _vSampleConfig) >= 0 ) {
+                        _vnodeinfos[icurrent].numchildren++;
+                    }
 
-                    if( (_spatialtree._nodes.size() % 50) == 0 ) {
+                    if( (_vnodeinfos.size() % 50) == 0 ) {
                         //DumpNodes();
-                        RAVELOG_VERBOSE(str(boost::format("trees at %d(%d) : to goal at %f,%f\n")%_sortedtree.blocks.size()%_spatialtree._nodes.size()%((pcurrent->ftotal-pcurrent->fcost)/_parameters->fGoalCoeff)%pcurrent->fcost));
+                        RAVELOG_VERBOSE(str(boost::format("trees at %d(%d) : to goal at %f,%f\n")%_vopen.size()%_vnodeinfos.size()%((_vnodeinfos[icurrent].ftotal-_vnodeinfos[icurrent].fcost)/_parameters->fGoalCoeff)%_vnodeinfos[icurrent].fcost));
                     }
                 }
             }
 
-            if( (int)_spatialtree._nodes.size() > nMaxIter ) {
+            if( (int)_vnodeinfos.size() > nMaxIter ) {
                 break;
             }
         }
 
-        if( !pbest ) {
-            return PS_Failed;
+        PlannerStatus status = PS_HasSolution;
+        if( ibest < 0 ) {
+            if( !bTimeExpired || _iClosestNode <= 0 ) {
+                RAVELOG_DEBUG_FORMAT("env=%d, RA* failed, nodes=%d, pruned=%d, computation time=%fs", GetEnv()->GetId()%_vnodeinfos.size()%_nNumPrunedNodes%(0.001f*(float)(utils::GetMilliTime()-basetime)));
+                return PS_Failed;
+            }
+            // anytime behavior, return the path to the node that got closest to the goal
+            ibest = _iClosestNode;
+            status = PS_InterruptedWithSolution;
+            RAVELOG_DEBUG_FORMAT("env=%d, RA* time exceeded, returning partial path to goal distance %f", GetEnv()->GetId()%((_vnodeinfos[ibest].ftotal-_vnodeinfos[ibest].fcost)/_parameters->fGoalCoeff));
         }
 
-        RAVELOG_DEBUG("Path found, final node: %f, %f\n", pbest->fcost, pbest->ftotal-pbest->fcost);
-        if( _parameters->CheckPathAllConstraints(pbest->q,pbest->q,std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenStart) != 0 ) {
+        _spatialtree.GetVectorConfig(_vnodeinfos[ibest].node, _vCurConfig);
+        RAVELOG_DEBUG("Path found, final node: %f, %f\n", _vnodeinfos[ibest].fcost, _vnodeinfos[ibest].ftotal-_vnodeinfos[ibest].fcost);
+        if( _parameters->CheckPathAllConstraints(_vCurConfig,_vCurConfig,std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenStart) != 0 ) {
             RAVELOG_WARN("RA* bad initial config\n");
         }
 
         stringstream ss;
-        ss << endl << "Path found, final node: cost: " << pbest->fcost << ", goal: " << (pbest->ftotal-pbest->fcost)/_parameters->fGoalCoeff << endl;
+        ss << endl << "Path found, final node: cost: " << _vnodeinfos[ibest].fcost << ", goal: " << (_vnodeinfos[ibest].ftotal-_vnodeinfos[ibest].fcost)/_parameters->fGoalCoeff << endl;
         for(int i = 0; i < GetDOF(); ++i) {
-            ss << pbest->q[i] << " ";
+            ss << _vCurConfig[i] << " ";
         }
         ss << "\n-------\n";
         RAVELOG_DEBUG(ss.str());
 
-        list<Node*> vecnodes;
+        NodeArena::Statistics memstats;
+        _spatialtree.GetMemoryStatistics(memstats);
+        RAVELOG_DEBUG_FORMAT("env=%d, RA* nodes=%d, pruned=%d, peak pool chunks=%d, computation time=%fs", GetEnv()->GetId()%_vnodeinfos.size()%_nNumPrunedNodes%memstats.numpeak%(0.001f*(float)(utils::GetMilliTime()-basetime)));
 
-        while(pcurrent != NULL) {
-            vecnodes.push_back(pcurrent);
-            pcurrent = pcurrent->parent;
+        list< vector<dReal> > listpath;
+        for(int inode = ibest; inode >= 0; inode = _vnodeinfos[inode].parent) {
+            listpath.push_back(vector<dReal>());
+            _spatialtree.GetVectorConfig(_vnodeinfos[inode].node, listpath.back());
         }
 
-        _SimpleOptimizePath(vecnodes);
+        _SimpleOptimizePath(listpath);
 
         if( _parameters->_configurationspecification != ptraj->GetConfigurationSpecification() ) {
             ptraj->Init(_parameters->_configurationspecification);
         }
         ptraj->Insert(ptraj->GetNumWaypoints(),_parameters->vinitialconfig);
 
-        list<Node*>::reverse_iterator itcur, itprev;
-        itcur = vecnodes.rbegin();
+        list< vector<dReal> >::reverse_iterator itcur, itprev;
+        itcur = listpath.rbegin();
         itprev = itcur++;
-        while(itcur != vecnodes.rend() ) {
-            _InterpolateNodes((*itprev)->q, (*itcur)->q, ptraj);
+        while(itcur != listpath.rend() ) {
+            _InterpolateNodes(*itprev, *itcur, ptraj);
             itprev = itcur;
             ++itcur;
         }
 
         _ProcessPostPlanners(_robot,ptraj);
-        return PS_HasSolution;
+        return status;
     }
 
     int GetTotalNodes() {
-        return (int)_sortedtree.blocks.size();
+        return (int)_vopen.size();
     }
 
     bool bUseGauss;
 
 private:
 
-    Node* CreateNode(dReal fcost, Node* parent, const vector<dReal>& pfConfig, bool add = true)
+    /// \brief inserts the configuration in the spatial tree and the open list
+    ///
+    /// \return the index of the new node info, -1 if the spatial tree rejected the configuration
+    int _CreateNode(dReal fcost, int parent, const vector<dReal>& pfConfig)
     {
-        Node* p = new Node();
-        p->parent = parent;
-        if( parent != NULL )
-            p->level = parent->level + 1;
-
-        p->q = pfConfig;
-        p->fcost = fcost;
-        p->ftotal = _parameters->fGoalCoeff*_parameters->_goalfn(pfConfig) + fcost;
-
-        if( add ) {
-            _spatialtree.AddNode(p);
-            _sortedtree.Add(p);
-        }
-        return p;
+        SimpleNode* node = (SimpleNode*)_spatialtree.InsertNode(parent >= 0 ? _vnodeinfos[parent].node : NULL, pfConfig, (uint32_t)_vnodeinfos.size());
+        if( !node ) {
+            return -1;
+        }
+        dReal fgoal = _parameters->fGoalCoeff*_parameters->_goalfn(pfConfig);
+        int index = (int)_vnodeinfos.size();
+        _vnodeinfos.push_back(NodeInfo(node, parent, fcost, fgoal + fcost));
+        if( _iClosestNode < 0 || fgoal < _vnodeinfos[_iClosestNode].ftotal - _vnodeinfos[_iClosestNode].fcost ) {
+            _iClosestNode = index;
+        }
+
+        _vopen.push_back(OpenEntry(fgoal + fcost, index));
+        std::push_heap(_vopen.begin(), _vopen.end(), std::greater<OpenEntry>());
+        if( _parameters->nMaxOpenNodes > 0 && (int)_vopen.size() > _parameters->nMaxOpenNodes ) {
+            // drop the worst quarter at once so that the cost of rebuilding the heap is amortized over many insertions
+            size_t numkeep = std::max(1, _parameters->nMaxOpenNodes - _parameters->nMaxOpenNodes/4);
+            std::nth_element(_vopen.begin(), _vopen.begin()+numkeep, _vopen.end());
+            _nNumPrunedNodes += _vopen.size()-numkeep;
+            _vopen.resize(numkeep);
+            std::make_heap(_vopen.begin(), _vopen.end(), std::greater<OpenEntry>());
+        }
+        return index;
     }
 
     void _InterpolateNodes(const vector<dReal>& pQ0, const vector<dReal>& pQ1, TrajectoryBasePtr ptraj)
@@ -525,12 +420,12 @@ private:
         }
     }
 
-    void _SimpleOptimizePath(list<Node*>& path)
+    void _SimpleOptimizePath(list< vector<dReal> >& path)
     {
         if( path.size() <= 2 )
             return;
 
-        list<Node*>::iterator startNode, endNode;
+        list< vector<dReal> >::iterator startNode, endNode;
 
         for(int i =10; i > 0; --i) {
             // pick a random node on the path, and a random jump ahead
@@ -544,7 +439,7 @@ private:
             advance(endNode, endIndex-startIndex);
 
             // check if the nodes can be connected by a straight line
-            if( _parameters->CheckPathAllConstraints((*startNode)->q, (*endNode)->q, std::vector<dReal>(), std::vector<dReal>(), 0, IT_Open)  != 0 ) {
+            if( _parameters->CheckPathAllConstraints(*startNode, *endNode, std::vector<dReal>(), std::vector<dReal>(), 0, IT_Open)  != 0 ) {
                 continue;
             }
 
@@ -565,39 +460,18 @@ private:
             return;
         }
 
-        vector<Node*>::iterator it;
-
-        vector<Node*>* allnodes[2] = { &_vdeadnodes, &_sortedtree.blocks };
-
         fprintf(f, "allnodes = [");
 
-        for(int n = 0; n < 2; ++n) {
-
-            FORIT(it, *allnodes[n]) {
-                for(int i = 0; i < GetDOF(); ++i) {
-                    fprintf(f, "%f ", (*it)->q[i]);
-                }
-
-                int index = 0;
-                if( (*it)->parent != NULL ) {
-
-                    index = 0;
-                    for(size_t j = 0; j < 2; ++j) {
-                        vector<Node*>::iterator itfound = find(allnodes[j]->begin(), allnodes[j]->end(), (*it)->parent);
-                        if( itfound != allnodes[j]->end() ) {
-                            index += (int)(itfound-allnodes[j]->begin());
-                            break;
-                        }
-                        index += (int)_vdeadnodes.size();
-                    }
-                }
-
-                fprintf(f, "%f %d\n", ((*it)->ftotal-(*it)->fcost)/_parameters->fGoalCoeff, index+1);
+        FOREACHC(itinfo, _vnodeinfos) {
+            const vector<dReal>& q = _spatialtree.GetVectorConfig(itinfo->node);
+            for(int i = 0; i < GetDOF(); ++i) {
+                fprintf(f, "%f ", q[i]);
             }
+            fprintf(f, "%f %d\n", (itinfo->ftotal-itinfo->fcost)/_parameters->fGoalCoeff, itinfo->parent+1);
         }
 
         fprintf(f,"];\r\n\r\n");
-        fprintf(f, "%s", str(boost::format("startindex = %d")%(_vdeadnodes.size()+1)).c_str());
+        fprintf(f, "%s", str(boost::format("startindex = %d")%1).c_str());
 
         fclose(f);
     }
@@ -607,13 +481,15 @@ private:
     }
 
     boost::shared_ptr<RAStarParameters> _parameters;
-    SpatialTree _spatialtree;
-    BinarySearchTree<Node*, dReal> _sortedtree;       // sorted by decreasing value
+    SpatialTree<SimpleNode> _spatialtree; ///< nearest neighbor structure, also owns the pooled node memory
+    std::vector<NodeInfo> _vnodeinfos; ///< indexed by SimpleNode::_userdata
+    std::vector<OpenEntry> _vopen; ///< binary heap of the open nodes with the lowest ftotal at the front, bounded by RAStarParameters::nMaxOpenNodes
+    int _iClosestNode; ///< index of the node with the lowest goal cost, returned when the planning time expires
+    size_t _nNumPrunedNodes; ///< number of nodes dropped from the open list
 
     RobotBasePtr _robot;
 
-    vector<Node*> _vdeadnodes;     ///< dead nodes
-    vector<dReal> _vSampleConfig;
+    vector<dReal> _vSampleConfig, _vCurConfig;
     vector<dReal> _jointIncrement, _jointResolutionInv;
     vector<dReal> _vzero;
 
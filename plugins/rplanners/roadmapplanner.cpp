@@ -0,0 +1,882 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2014 Rosen Diankov <rosen.diankov@gmail.com>
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "rplanners.h"
+
+#include <queue>
+
+static const char s_RoadmapFileMagic[8] = { 'O', 'R', 'R', 'O', 'A', 'D', 'M', 'P' };
+static const int32_t s_RoadmapFileVersion = 1;
+
+/// \brief binary layout of the beginning of a roadmap file, followed by numvertices*dof configuration values and numedges pairs of int32 vertex indices
+struct RoadmapFileHeader
+{
+    char magic[8];
+    int32_t version;
+    int32_t realsize; ///< sizeof(dReal) of the process that saved the file
+    int32_t dof;
+    int32_t numvertices;
+    int32_t numedges;
+    char hash[36]; ///< the md5 hash of the robot structure and the planning space the roadmap was built for
+};
+
+/// \brief multi-query probabilistic roadmap that is kept between planning calls
+///
+/// Vertices and edges are validated lazily, only when they are part of the shortest path of a query. For every validated vertex and edge the world
+/// bounding box swept by the robot is stored, so when bodies move only the results whose boxes intersect the old or new box of a moved body
+/// are forgotten. Moved bodies are found by comparing their KinBody::GetUpdateStamp with the stamp of the previous planning call.
+class RoadmapPlanner : public PlannerBase
+{
+public:
+    class RoadmapParameters : public PlannerBase::PlannerParameters {
+public:
+        RoadmapParameters() : _nNeighbors(10), _fConnectionRadius(0), _nExpandSamples(50), _bProcessingRoadmap(false) {
+            _vXMLParameters.push_back("neighbors");
+            _vXMLParameters.push_back("connectionradius");
+            _vXMLParameters.push_back("expandsamples");
+        }
+
+        int _nNeighbors; ///< number of closest vertices every new vertex is connected to
+        dReal _fConnectionRadius; ///< maximum distance of connected vertices. If 0 or less, there is no limit
+        int _nExpandSamples; ///< number of configurations sampled every time the roadmap does not connect the query
+protected:
+        bool _bProcessingRoadmap;
+        virtual bool serialize(std::ostream& O) const
+        {
+            if( !PlannerParameters::serialize(O) ) {
+                return false;
+            }
+            O << "<neighbors>" << _nNeighbors << "</neighbors>" << endl;
+            O << "<connectionradius>" << _fConnectionRadius << "</connectionradius>" << endl;
+            O << "<expandsamples>" << _nExpandSamples << "</expandsamples>" << endl;
+            return !!O;
+        }
+
+        ProcessElement startElement(const std::string& name, const AttributesList& atts)
+        {
+            if( _bProcessingRoadmap ) {
+                return PE_Ignore;
+            }
+            switch( PlannerBase::PlannerParameters::startElement(name,atts) ) {
+            case PE_Pass: break;
+            case PE_Support: return PE_Support;
+            case PE_Ignore: return PE_Ignore;
+            }
+            _bProcessingRoadmap = name=="neighbors"||name=="connectionradius"||name=="expandsamples";
+            return _bProcessingRoadmap ? PE_Support : PE_Pass;
+        }
+        virtual bool endElement(const string& name)
+        {
+            if( _bProcessingRoadmap ) {
+                if( name == "neighbors" ) {
+                    _ss >> _nNeighbors;
+                }
+                else if( name == "connectionradius" ) {
+                    _ss >> _fConnectionRadius;
+                }
+                else if( name == "expandsamples" ) {
+                    _ss >> _nExpandSamples;
+                }
+                else {
+                    RAVELOG_WARN(str(boost::format("unknown tag %s\n")%name));
+                }
+                _bProcessingRoadmap = false;
+                return false;
+            }
+            // give a chance for the default parameters to get processed
+            return PlannerParameters::endElement(name);
+        }
+    };
+    typedef boost::shared_ptr<RoadmapParameters> RoadmapParametersPtr;
+
+    enum RoadmapStatus {
+        RS_Unknown = 0, ///< not checked since the last change of the environment around it
+        RS_Valid = 1,
+        RS_Invalid = 2
+    };
+
+    /// \brief vertex of the roadmap, the configuration is stored in the node of the spatial tree whose _userdata is the index of the vertex
+    struct RoadmapVertex
+    {
+        RoadmapVertex(SimpleNode* node) : node(node), status(RS_Unknown) {
+        }
+        SimpleNode* node;
+        std::vector<int> vedges; ///< indices into _vedges
+        int status;
+        AABB ab; ///< world box of the robot at the configuration, set when status is not RS_Unknown
+    };
+
+    struct RoadmapEdge
+    {
+        RoadmapEdge(int vertex0, int vertex1, dReal length) : vertex0(vertex0), vertex1(vertex1), length(length), status(RS_Unknown) {
+        }
+        int vertex0, vertex1;
+        dReal length;
+        int status;
+        AABB ab; ///< world box swept by the robot along the checked configurations, set when status is not RS_Unknown
+    };
+
+    /// \brief state of a body of the environment at the last synchronization
+    struct BodyState
+    {
+        BodyState() : updatestamp(0), benabled(false) {
+        }
+        int updatestamp;
+        bool benabled;
+        AABB ab;
+    };
+
+    RoadmapPlanner(EnvironmentBasePtr penv, std::istream& sinput) : PlannerBase(penv), _spatialtree(0)
+    {
+        __description = ":Interface Author: Rosen Diankov\n\nMulti-query probabilistic roadmap (PRM) with lazy collision checking. See\n\n\
+- R. Bohlin and L.E. Kavraki. Path planning using lazy PRM. In Proc. IEEE Int'l Conf. on Robotics and Automation (ICRA'2000), pages 521-528.\n\n\
+The roadmap is kept between planning calls as long as the robot and its active dofs do not change, so repeated queries between the same configurations only search the roadmap. \
+Vertices and edges are only checked when they are on the shortest path of a query. When bodies of the environment move (their update stamps change), only the checked vertices and edges whose swept bounding boxes intersect the moved bodies are checked again. \
+The constraint functions of the parameters are assumed to stay the same between calls, use ResetRoadmap if they change.\n";
+        RegisterCommand("ResetRoadmap",boost::bind(&RoadmapPlanner::_ResetRoadmapCommand,this,_1,_2),
+                        "removes all vertices and edges of the roadmap");
+        RegisterCommand("GetRoadmapStatistics",boost::bind(&RoadmapPlanner::_GetRoadmapStatisticsCommand,this,_1,_2),
+                        "returns numvertices numedges numvalidedges numinvalidedges");
+        RegisterCommand("SaveRoadmap",boost::bind(&RoadmapPlanner::_SaveRoadmapCommand,this,_1,_2),
+                        "[filename] - after InitPlan, saves the vertices and edges of the roadmap. If no filename is given, the roadmap is saved in the database directory next to the configuration caches under a name hashed from the robot structure and the active dofs.");
+        RegisterCommand("LoadRoadmap",boost::bind(&RoadmapPlanner::_LoadRoadmapCommand,this,_1,_2),
+                        "[filename] - after InitPlan, replaces the roadmap with the one saved by SaveRoadmap. All loaded vertices and edges are checked again when used.");
+    }
+    virtual ~RoadmapPlanner() {
+    }
+
+    virtual PlannerParametersConstPtr GetParameters() const {
+        return _parameters;
+    }
+
+    virtual bool InitPlan(RobotBasePtr pbase, PlannerParametersConstPtr pparams)
+    {
+        EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+        _parameters.reset();
+        RoadmapParametersPtr parameters(new RoadmapParameters());
+        parameters->copy(pparams);
+        parameters->Validate();
+        if( (int)parameters->vinitialconfig.size() % parameters->GetDOF() || (int)parameters->vgoalconfig.size() % parameters->GetDOF() ) {
+            RAVELOG_ERROR_FORMAT("env=%d, initial or goal configurations have the wrong dimension", GetEnv()->GetId());
+            return false;
+        }
+        if( parameters->vinitialconfig.size() == 0 || parameters->vgoalconfig.size() == 0 ) {
+            RAVELOG_WARN_FORMAT("env=%d, roadmap planner needs initial and goal configurations", GetEnv()->GetId());
+            return false;
+        }
+        if( parameters->_nMaxIterations <= 0 ) {
+            parameters->_nMaxIterations = 100;
+        }
+        if( parameters->_nExpandSamples <= 0 ) {
+            parameters->_nExpandSamples = 50;
+        }
+
+        _robot = pbase;
+        if( !_uniformsampler ) {
+            _uniformsampler = RaveCreateSpaceSampler(GetEnv(),"mt19937");
+        }
+        _uniformsampler->SetSeed(parameters->_nRandomGeneratorSeed);
+        FOREACH(it, parameters->_listInternalSamplers) {
+            (*it)->SetSeed(parameters->_nRandomGeneratorSeed);
+        }
+
+        std::string roadmaphash = _ComputeRoadmapHash(parameters);
+        _parameters = parameters;
+        if( roadmaphash != _roadmaphash ) {
+            // the roadmap was built for another robot or planning space
+            _roadmaphash = roadmaphash;
+            _ResetRoadmap();
+        }
+        RAVELOG_DEBUG_FORMAT("env=%d, roadmap planner initialized with %d vertices and %d edges", GetEnv()->GetId()%_vvertices.size()%_vedges.size());
+        return true;
+    }
+
+    virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj)
+    {
+        if( !_parameters ) {
+            RAVELOG_ERROR("RoadmapPlanner::PlanPath - Error, planner not initialized\n");
+            return PS_Failed;
+        }
+
+        EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+        uint32_t basetime = utils::GetMilliTime();
+        PlannerParameters::StateSaver savestate(_parameters);
+        CollisionOptionsStateSaver optionstate(GetEnv()->GetCollisionChecker(),GetEnv()->GetCollisionChecker()->GetCollisionOptions()|CO_ActiveDOFs,false);
+
+        _SynchronizeEnvironment();
+
+        const int dof = _parameters->GetDOF();
+        std::vector<dReal> vconfig(dof);
+        std::vector<int> vstartvertices, vgoalvertices;
+        for(size_t index = 0; index < _parameters->vinitialconfig.size(); index += dof) {
+            std::copy(_parameters->vinitialconfig.begin()+index, _parameters->vinitialconfig.begin()+index+dof, vconfig.begin());
+            int ivertex = _AddQueryVertex(vconfig);
+            if( ivertex >= 0 ) {
+                vstartvertices.push_back(ivertex);
+            }
+        }
+        for(size_t index = 0; index < _parameters->vgoalconfig.size(); index += dof) {
+            std::copy(_parameters->vgoalconfig.begin()+index, _parameters->vgoalconfig.begin()+index+dof, vconfig.begin());
+            int ivertex = _AddQueryVertex(vconfig);
+            if( ivertex >= 0 ) {
+                vgoalvertices.push_back(ivertex);
+            }
+        }
+        if( vstartvertices.size() == 0 || vgoalvertices.size() == 0 ) {
+            RAVELOG_WARN_FORMAT("env=%d, no valid initial or goal configurations", GetEnv()->GetId());
+            return PS_Failed;
+        }
+
+        PlannerProgress progress;
+        std::vector<int> vpath;
+        bool bFound = false;
+        int numexpansions = 0, numsearches = 0;
+        while(numexpansions <= _parameters->_nMaxIterations) {
+            if( _parameters->_nMaxPlanningTime > 0 && utils::GetMilliTime()-basetime > _parameters->_nMaxPlanningTime ) {
+                RAVELOG_DEBUG_FORMAT("env=%d, roadmap planning time exceeded", GetEnv()->GetId());
+                break;
+            }
+            ++numsearches;
+            if( _SearchRoadmap(vstartvertices, vgoalvertices, vpath) ) {
+                if( _ValidatePath(vpath) ) {
+                    bFound = true;
+                    break;
+                }
+                // invalid vertices and edges are marked, so search again
+            }
+            else {
+                if( numexpansions >= _parameters->_nMaxIterations ) {
+                    break;
+                }
+                _ExpandRoadmap(_parameters->_nExpandSamples);
+                ++numexpansions;
+            }
+
+            progress._iteration = numsearches;
+            if( _CallCallbacks(progress) == PA_Interrupt ) {
+                return PS_Interrupted;
+            }
+        }
+
+        if( !bFound ) {
+            RAVELOG_WARN_FORMAT("env=%d, roadmap plan failed after %d expansions, vertices=%d, edges=%d, %fs", GetEnv()->GetId()%numexpansions%_vvertices.size()%_vedges.size()%(0.001f*(float)(utils::GetMilliTime()-basetime)));
+            return PS_Failed;
+        }
+
+        if( !_ExtractPath(vpath, _vpathconfigs) ) {
+            return PS_Failed;
+        }
+        if( ptraj->GetConfigurationSpecification().GetDOF() == 0 ) {
+            ptraj->Init(_parameters->_configurationspecification);
+        }
+        ptraj->Insert(ptraj->GetNumWaypoints(), _vpathconfigs, _parameters->_configurationspecification);
+        RAVELOG_DEBUG_FORMAT("env=%d, roadmap plan success, searches=%d, expansions=%d, path=%d points, vertices=%d, edges=%d, computation time=%fs", GetEnv()->GetId()%numsearches%numexpansions%ptraj->GetNumWaypoints()%_vvertices.size()%_vedges.size()%(0.001f*(float)(utils::GetMilliTime()-basetime)));
+        return _ProcessPostPlanners(_robot,ptraj);
+    }
+
+protected:
+    std::string _ComputeRoadmapHash(RoadmapParametersPtr parameters) const
+    {
+        std::stringstream ss;
+        ss << _robot->GetRobotStructureHash() << " " << parameters->_configurationspecification;
+        return utils::GetMD5HashString(ss.str());
+    }
+
+    void _ResetRoadmap()
+    {
+        _vvertices.clear();
+        _vedges.clear();
+        _mapBodyStates.clear();
+        _vRobotStateValues.resize(0);
+        _vGrabbedIds.resize(0);
+        if( !!_parameters ) {
+            _spatialtree.Init(boost::static_pointer_cast<PlannerBase>(shared_from_this()), _parameters->GetDOF(), _parameters->_distmetricfn, _parameters->_fStepLength, _parameters->_distmetricfn(_parameters->_vConfigLowerLimit, _parameters->_vConfigUpperLimit));
+            _spatialtree.SetDistanceMetricBatchFn(_parameters->_distmetricbatchfn);
+            _spatialtree.SetStateSpace(planningutils::GetActiveDOFStateSpace(*_parameters));
+        }
+        else {
+            _spatialtree.Reset();
+        }
+    }
+
+    /// \brief adds the configuration as a vertex connected to its closest vertices, returns an existing vertex if it is too close to one
+    int _AddVertex(const std::vector<dReal>& vconfig)
+    {
+        dReal fradius = _parameters->_fConnectionRadius > 0 ? _parameters->_fConnectionRadius : std::numeric_limits<dReal>::infinity();
+        _spatialtree.FindNearestNodes(vconfig, _parameters->_nNeighbors, fradius, _vnearest);
+        SimpleNode* pnode = (SimpleNode*)_spatialtree.InsertNode(NULL, vconfig, _vvertices.size());
+        if( !pnode ) {
+            std::pair<NodeBasePtr, dReal> nearest = _spatialtree.FindNearestNode(vconfig);
+            return !nearest.first ? -1 : (int)((SimpleNode*)nearest.first)->_userdata;
+        }
+        int ivertex = _vvertices.size();
+        _vvertices.push_back(RoadmapVertex(pnode));
+        FOREACH(itnearest, _vnearest) {
+            _AddEdge(ivertex, ((SimpleNode*)itnearest->first)->_userdata, itnearest->second);
+        }
+        return ivertex;
+    }
+
+    void _AddEdge(int ivertex0, int ivertex1, dReal length)
+    {
+        if( ivertex0 == ivertex1 ) {
+            return;
+        }
+        int iedge = _vedges.size();
+        _vedges.push_back(RoadmapEdge(ivertex0, ivertex1, length));
+        _vvertices.at(ivertex0).vedges.push_back(iedge);
+        _vvertices.at(ivertex1).vedges.push_back(iedge);
+    }
+
+    /// \brief returns the vertex of an initial or goal configuration after checking it, or -1 if it does not satisfy the constraints
+    int _AddQueryVertex(const std::vector<dReal>& vconfig)
+    {
+        int ivertex = _AddVertex(vconfig);
+        if( ivertex < 0 || !_ValidateVertex(ivertex) ) {
+            return -1;
+        }
+        if( _spatialtree.GetVectorConfig(_vvertices[ivertex].node) != vconfig ) {
+            // an existing vertex is very close, the segment to it is checked when the path is extracted
+            if( _parameters->CheckPathAllConstraints(vconfig, vconfig, std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenStart) != 0 ) {
+                return -1;
+            }
+        }
+        return ivertex;
+    }
+
+    /// \brief samples numsamples configurations and adds the ones that satisfy the constraints
+    void _ExpandRoadmap(int numsamples)
+    {
+        for(int isample = 0; isample < numsamples; ++isample) {
+            if( !_parameters->_samplefn(_vsampleconfig) ) {
+                continue;
+            }
+            if( _parameters->CheckPathAllConstraints(_vsampleconfig, _vsampleconfig, std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenStart) != 0 ) {
+                continue;
+            }
+            int ivertex = _AddVertex(_vsampleconfig);
+            if( ivertex >= 0 && _vvertices[ivertex].status == RS_Unknown && _parameters->SetStateValues(_vsampleconfig) == 0 ) {
+                _vvertices[ivertex].status = RS_Valid;
+                _vvertices[ivertex].ab = _ComputeRobotAABB();
+            }
+        }
+    }
+
+    /// \brief A* search from any of the start vertices to any of the goal vertices through the vertices and edges not known to be invalid
+    bool _SearchRoadmap(const std::vector<int>& vstartvertices, const std::vector<int>& vgoalvertices, std::vector<int>& vpath)
+    {
+        vpath.resize(0);
+        size_t numvertices = _vvertices.size();
+        _vcost.resize(0); _vcost.resize(numvertices, std::numeric_limits<dReal>::infinity());
+        _vheuristic.resize(0); _vheuristic.resize(numvertices, dReal(-1));
+        _vparentedge.resize(0); _vparentedge.resize(numvertices, -1);
+        _visgoal.resize(0); _visgoal.resize(numvertices, 0);
+        _vgoalconfigs.resize(0);
+        FOREACHC(itgoal, vgoalvertices) {
+            if( _vvertices[*itgoal].status != RS_Invalid ) {
+                _visgoal[*itgoal] = 1;
+                _vgoalconfigs.push_back(_spatialtree.GetVectorConfig(_vvertices[*itgoal].node));
+            }
+        }
+
+        std::priority_queue< std::pair<dReal, int>, std::vector< std::pair<dReal, int> >, std::greater< std::pair<dReal, int> > > openset;
+        FOREACHC(itstart, vstartvertices) {
+            if( _vvertices[*itstart].status != RS_Invalid ) {
+                _vcost[*itstart] = 0;
+                openset.push(make_pair(_ComputeHeuristic(*itstart), *itstart));
+            }
+        }
+        int ifoundgoal = -1;
+        while(!openset.empty()) {
+            std::pair<dReal, int> top = openset.top();
+            openset.pop();
+            int ivertex = top.second;
+            if( top.first > _vcost[ivertex] + _vheuristic[ivertex] ) {
+                continue; // stale entry
+            }
+            if( _visgoal[ivertex] ) {
+                ifoundgoal = ivertex;
+                break;
+            }
+            FOREACHC(itedge, _vvertices[ivertex].vedges) {
+                const RoadmapEdge& edge = _vedges[*itedge];
+                if( edge.status == RS_Invalid ) {
+                    continue;
+                }
+                int inext = edge.vertex0 == ivertex ? edge.vertex1 : edge.vertex0;
+                if( _vvertices[inext].status == RS_Invalid ) {
+                    continue;
+                }
+                dReal fcost = _vcost[ivertex] + edge.length;
+                if( fcost < _vcost[inext] ) {
+                    _vcost[inext] = fcost;
+                    _vparentedge[inext] = *itedge;
+                    openset.push(make_pair(fcost + _ComputeHeuristic(inext), inext));
+                }
+            }
+        }
+        if( ifoundgoal < 0 ) {
+            return false;
+        }
+
+        for(int ivertex = ifoundgoal; ivertex >= 0; ) {
+            vpath.push_back(ivertex);
+            int iedge = _vparentedge[ivertex];
+            if( iedge < 0 ) {
+                break;
+            }
+            ivertex = _vedges[iedge].vertex0 == ivertex ? _vedges[iedge].vertex1 : _vedges[iedge].vertex0;
+        }
+        std::reverse(vpath.begin(), vpath.end());
+        return true;
+    }
+
+    /// \brief distance to the closest goal, cached for the current search
+    dReal _ComputeHeuristic(int ivertex)
+    {
+        if( _vheuristic[ivertex] < 0 ) {
+            dReal fmin = std::numeric_limits<dReal>::infinity();
+            const std::vector<dReal>& vconfig = _spatialtree.GetVectorConfig(_vvertices[ivertex].node);
+            FOREACHC(itgoal, _vgoalconfigs) {
+                fmin = min(fmin, _parameters->_distmetricfn(vconfig, *itgoal));
+            }
+            _vheuristic[ivertex] = fmin;
+        }
+        return _vheuristic[ivertex];
+    }
+
+    /// \brief checks the unchecked vertices and edges of the path, returns false at the first invalid one
+    bool _ValidatePath(const std::vector<int>& vpath)
+    {
+        FOREACHC(itvertex, vpath) {
+            if( !_ValidateVertex(*itvertex) ) {
+                return false;
+            }
+        }
+        for(size_t i = 0; i+1 < vpath.size(); ++i) {
+            if( !_ValidateEdge(_vparentedge.at(vpath[i+1])) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool _ValidateVertex(int ivertex)
+    {
+        RoadmapVertex& vertex = _vvertices.at(ivertex);
+        if( vertex.status == RS_Unknown ) {
+            _spatialtree.GetVectorConfig(vertex.node, _vsampleconfig);
+            vertex.status = _parameters->CheckPathAllConstraints(_vsampleconfig, _vsampleconfig, std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenStart) == 0 ? RS_Valid : RS_Invalid;
+            if( _parameters->SetStateValues(_vsampleconfig) == 0 ) {
+                vertex.ab = _ComputeRobotAABB();
+            }
+        }
+        return vertex.status == RS_Valid;
+    }
+
+    bool _ValidateEdge(int iedge)
+    {
+        RoadmapEdge& edge = _vedges.at(iedge);
+        if( edge.status == RS_Unknown ) {
+            const int dof = _parameters->GetDOF();
+            _spatialtree.GetVectorConfig(_vvertices[edge.vertex0].node, _vsampleconfig);
+            _spatialtree.GetVectorConfig(_vvertices[edge.vertex1].node, _vsampleconfig2);
+            if( !_filterreturn ) {
+                _filterreturn.reset(new ConstraintFilterReturn());
+            }
+            _filterreturn->Clear();
+            int ret = _parameters->CheckPathAllConstraints(_vsampleconfig, _vsampleconfig2, std::vector<dReal>(), std::vector<dReal>(), 0, IT_Open, CFO_RecommendedOptions|CFO_FillCheckedConfiguration, _filterreturn);
+            edge.status = ret == 0 ? RS_Valid : RS_Invalid;
+            // the box of the checked configurations contains the collision if there was one, so the edge is checked again when the colliding body moves
+            edge.ab = _vvertices[edge.vertex0].ab;
+            if( edge.status == RS_Valid ) {
+                _MergeAABB(edge.ab, _vvertices[edge.vertex1].ab);
+            }
+            for(size_t index = 0; index+dof <= _filterreturn->_configurations.size(); index += dof) {
+                _vsampleconfig.assign(_filterreturn->_configurations.begin()+index, _filterreturn->_configurations.begin()+index+dof);
+                if( _parameters->SetStateValues(_vsampleconfig) == 0 ) {
+                    _MergeAABB(edge.ab, _ComputeRobotAABB());
+                }
+            }
+        }
+        return edge.status == RS_Valid;
+    }
+
+    /// \brief fills the configurations of the path, adding the exact initial and goal configurations if their vertices are only close to them
+    bool _ExtractPath(const std::vector<int>& vpath, std::vector<dReal>& vpathconfigs)
+    {
+        const int dof = _parameters->GetDOF();
+        vpathconfigs.resize(0);
+        FOREACHC(itvertex, vpath) {
+            const std::vector<dReal>& vconfig = _spatialtree.GetVectorConfig(_vvertices[*itvertex].node);
+            vpathconfigs.insert(vpathconfigs.end(), vconfig.begin(), vconfig.end());
+        }
+        std::vector<dReal> vquery(dof), vvertex(dof);
+        std::copy(vpathconfigs.begin(), vpathconfigs.begin()+dof, vvertex.begin());
+        if( _FindQueryConfig(_parameters->vinitialconfig, vvertex, vquery) && vquery != vvertex ) {
+            if( _parameters->CheckPathAllConstraints(vquery, vvertex, std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenEnd) != 0 ) {
+                return false;
+            }
+            vpathconfigs.insert(vpathconfigs.begin(), vquery.begin(), vquery.end());
+        }
+        std::copy(vpathconfigs.end()-dof, vpathconfigs.end(), vvertex.begin());
+        if( _FindQueryConfig(_parameters->vgoalconfig, vvertex, vquery) && vquery != vvertex ) {
+            if( _parameters->CheckPathAllConstraints(vvertex, vquery, std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenStart) != 0 ) {
+                return false;
+            }
+            vpathconfigs.insert(vpathconfigs.end(), vquery.begin(), vquery.end());
+        }
+        return true;
+    }
+
+    /// \brief finds the query configuration of vqueryconfigs closest to the vertex configuration
+    bool _FindQueryConfig(const std::vector<dReal>& vqueryconfigs, const std::vector<dReal>& vvertex, std::vector<dReal>& vquery)
+    {
+        const int dof = _parameters->GetDOF();
+        dReal fbestdist = std::numeric_limits<dReal>::infinity();
+        std::vector<dReal> vtemp(dof);
+        for(size_t index = 0; index+dof <= vqueryconfigs.size(); index += dof) {
+            std::copy(vqueryconfigs.begin()+index, vqueryconfigs.begin()+index+dof, vtemp.begin());
+            dReal fdist = _parameters->_distmetricfn(vtemp, vvertex);
+            if( fdist < fbestdist ) {
+                fbestdist = fdist;
+                vquery = vtemp;
+            }
+        }
+        return fbestdist < std::numeric_limits<dReal>::infinity();
+    }
+
+    /// \brief world box of the robot and its grabbed bodies at the current state
+    AABB _ComputeRobotAABB()
+    {
+        AABB ab = _robot->ComputeAABB();
+        _robot->GetGrabbed(_vgrabbed);
+        FOREACHC(itgrabbed, _vgrabbed) {
+            _MergeAABB(ab, (*itgrabbed)->ComputeAABB());
+        }
+        return ab;
+    }
+
+    static void _MergeAABB(AABB& ab, const AABB& ab2)
+    {
+        Vector vmin = ab.pos - ab.extents, vmax = ab.pos + ab.extents;
+        Vector vmin2 = ab2.pos - ab2.extents, vmax2 = ab2.pos + ab2.extents;
+        for(int i = 0; i < 3; ++i) {
+            vmin[i] = min(vmin[i], vmin2[i]);
+            vmax[i] = max(vmax[i], vmax2[i]);
+        }
+        ab.pos = dReal(0.5)*(vmin+vmax);
+        ab.extents = dReal(0.5)*(vmax-vmin);
+    }
+
+    static bool _IntersectAABB(const AABB& ab, const AABB& ab2)
+    {
+        for(int i = 0; i < 3; ++i) {
+            if( RaveFabs(ab.pos[i]-ab2.pos[i]) > ab.extents[i]+ab2.extents[i] ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// \brief forgets the checks that depend on the bodies that moved since the last call
+    ///
+    /// Valid results intersecting the new boxes of the moved bodies and invalid results intersecting their old boxes become unknown.
+    /// If the robot itself changed outside of the planning space or grabbed other bodies, all results become unknown.
+    void _SynchronizeEnvironment()
+    {
+        // the dofs and transform of the robot that are not planned for
+        std::vector<dReal> vrobotvalues;
+        _robot->GetDOFValues(vrobotvalues);
+        FOREACHC(itindex, _robot->GetActiveDOFIndices()) {
+            vrobotvalues.at(*itindex) = 0;
+        }
+        if( _robot->GetAffineDOF() == 0 ) {
+            Transform t = _robot->GetTransform();
+            vrobotvalues.push_back(t.trans.x); vrobotvalues.push_back(t.trans.y); vrobotvalues.push_back(t.trans.z);
+            vrobotvalues.push_back(t.rot.x); vrobotvalues.push_back(t.rot.y); vrobotvalues.push_back(t.rot.z); vrobotvalues.push_back(t.rot.w);
+        }
+        _robot->GetGrabbed(_vgrabbed);
+        std::vector<int> vgrabbedids;
+        FOREACHC(itgrabbed, _vgrabbed) {
+            vgrabbedids.push_back((*itgrabbed)->GetEnvironmentId());
+        }
+        std::sort(vgrabbedids.begin(), vgrabbedids.end());
+        if( vrobotvalues != _vRobotStateValues || vgrabbedids != _vGrabbedIds ) {
+            FOREACH(itvertex, _vvertices) {
+                itvertex->status = RS_Unknown;
+            }
+            FOREACH(itedge, _vedges) {
+                itedge->status = RS_Unknown;
+            }
+            _vRobotStateValues.swap(vrobotvalues);
+            _vGrabbedIds.swap(vgrabbedids);
+        }
+
+        std::vector<KinBodyPtr> vbodies;
+        GetEnv()->GetBodies(vbodies);
+        std::map<int, BodyState> mapBodyStates;
+        std::vector<AABB> vnewboxes, voldboxes;
+        FOREACHC(itbody, vbodies) {
+            if( *itbody == _robot || std::binary_search(_vGrabbedIds.begin(), _vGrabbedIds.end(), (*itbody)->GetEnvironmentId()) ) {
+                continue;
+            }
+            int bodyid = (*itbody)->GetEnvironmentId();
+            BodyState& state = mapBodyStates[bodyid];
+            std::map<int, BodyState>::iterator itold = _mapBodyStates.find(bodyid);
+            if( itold != _mapBodyStates.end() && itold->second.updatestamp == (*itbody)->GetUpdateStamp() ) {
+                state = itold->second;
+                _mapBodyStates.erase(itold);
+                continue;
+            }
+            state.updatestamp = (*itbody)->GetUpdateStamp();
+            state.benabled = (*itbody)->IsEnabled();
+            if( state.benabled ) {
+                state.ab = (*itbody)->ComputeAABB();
+                vnewboxes.push_back(state.ab);
+            }
+            if( itold != _mapBodyStates.end() ) {
+                if( itold->second.benabled ) {
+                    voldboxes.push_back(itold->second.ab);
+                }
+                _mapBodyStates.erase(itold);
+            }
+        }
+        // bodies that were removed from the environment
+        FOREACHC(itold, _mapBodyStates) {
+            if( itold->second.benabled ) {
+                voldboxes.push_back(itold->second.ab);
+            }
+        }
+        _mapBodyStates.swap(mapBodyStates);
+
+        if( vnewboxes.size() > 0 || voldboxes.size() > 0 ) {
+            int numinvalidated = 0;
+            FOREACH(itvertex, _vvertices) {
+                if( _IsAffected(itvertex->status, itvertex->ab, vnewboxes, voldboxes) ) {
+                    itvertex->status = RS_Unknown;
+                    ++numinvalidated;
+                }
+            }
+            FOREACH(itedge, _vedges) {
+                if( _IsAffected(itedge->status, itedge->ab, vnewboxes, voldboxes) ) {
+                    itedge->status = RS_Unknown;
+                    ++numinvalidated;
+                }
+            }
+            RAVELOG_VERBOSE_FORMAT("env=%d, %d bodies changed, %d checked vertices and edges have to be checked again", GetEnv()->GetId()%(vnewboxes.size()+voldboxes.size())%numinvalidated);
+        }
+    }
+
+    static bool _IsAffected(int status, const AABB& ab, const std::vector<AABB>& vnewboxes, const std::vector<AABB>& voldboxes)
+    {
+        const std::vector<AABB>& vboxes = status == RS_Valid ? vnewboxes : voldboxes;
+        if( status == RS_Unknown ) {
+            return false;
+        }
+        FOREACHC(itbox, vboxes) {
+            if( _IntersectAABB(ab, *itbox) ) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::string _GetRoadmapFilename(std::istream& sinput)
+    {
+        std::string filename;
+        sinput >> filename;
+        if( filename.size() == 0 ) {
+            filename = RaveFindDatabaseFile(std::string("roadmap.")+_roadmaphash, false);
+        }
+        return filename;
+    }
+
+    bool _ResetRoadmapCommand(std::ostream& sout, std::istream& sinput)
+    {
+        EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+        _ResetRoadmap();
+        return true;
+    }
+
+    bool _GetRoadmapStatisticsCommand(std::ostream& sout, std::istream& sinput)
+    {
+        int numvalid = 0, numinvalid = 0;
+        FOREACHC(itedge, _vedges) {
+            if( itedge->status == RS_Valid ) {
+                ++numvalid;
+            }
+            else if( itedge->status == RS_Invalid ) {
+                ++numinvalid;
+            }
+        }
+        sout << _vvertices.size() << " " << _vedges.size() << " " << numvalid << " " << numinvalid;
+        return true;
+    }
+
+    bool _SaveRoadmapCommand(std::ostream& sout, std::istream& sinput)
+    {
+        if( !_parameters ) {
+            RAVELOG_WARN("roadmap planner not initialized\n");
+            return false;
+        }
+        std::string filename = _GetRoadmapFilename(sinput);
+        const int dof = _parameters->GetDOF();
+        RoadmapFileHeader header;
+        memset(&header, 0, sizeof(header));
+        std::copy(s_RoadmapFileMagic, s_RoadmapFileMagic+sizeof(s_RoadmapFileMagic), header.magic);
+        header.version = s_RoadmapFileVersion;
+        header.realsize = sizeof(dReal);
+        header.dof = dof;
+        header.numvertices = _vvertices.size();
+        header.numedges = _vedges.size();
+        strncpy(header.hash, _roadmaphash.c_str(), sizeof(header.hash)-1);
+
+        std::vector<dReal> vconfigs(_vvertices.size()*dof);
+        for(size_t ivertex = 0; ivertex < _vvertices.size(); ++ivertex) {
+            std::copy(_vvertices[ivertex].node->q, _vvertices[ivertex].node->q+dof, vconfigs.begin()+ivertex*dof);
+        }
+        std::vector<int32_t> vedgevertices(_vedges.size()*2);
+        for(size_t iedge = 0; iedge < _vedges.size(); ++iedge) {
+            vedgevertices[2*iedge] = _vedges[iedge].vertex0;
+            vedgevertices[2*iedge+1] = _vedges[iedge].vertex1;
+        }
+
+        // write to a temporary file and rename it, so that a process loading the roadmap never sees a partially written file
+        std::string tempfilename = str(boost::format("%s.%d.tmp")%filename%utils::GetMicroTime());
+        FILE* pfile = fopen(tempfilename.c_str(),"wb");
+        if( !pfile ) {
+            RAVELOG_WARN_FORMAT("failed to open %s for writing the roadmap", tempfilename);
+            return false;
+        }
+        bool bsuccess = fwrite(&header, sizeof(header), 1, pfile) == 1;
+        bsuccess &= vconfigs.size() == 0 || fwrite(&vconfigs[0], sizeof(dReal)*vconfigs.size(), 1, pfile) == 1;
+        bsuccess &= vedgevertices.size() == 0 || fwrite(&vedgevertices[0], sizeof(int32_t)*vedgevertices.size(), 1, pfile) == 1;
+        bsuccess &= fclose(pfile) == 0;
+        if( !bsuccess || rename(tempfilename.c_str(), filename.c_str()) != 0 ) {
+            RAVELOG_WARN_FORMAT("failed to write the roadmap to %s", filename);
+            remove(tempfilename.c_str());
+            return false;
+        }
+        RAVELOG_DEBUG_FORMAT("env=%d, saved roadmap with %d vertices and %d edges to %s", GetEnv()->GetId()%header.numvertices%header.numedges%filename);
+        sout << filename;
+        return true;
+    }
+
+    bool _LoadRoadmapCommand(std::ostream& sout, std::istream& sinput)
+    {
+        if( !_parameters ) {
+            RAVELOG_WARN("roadmap planner not initialized\n");
+            return false;
+        }
+        EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+        std::string filename = _GetRoadmapFilename(sinput);
+        FILE* pfile = fopen(filename.c_str(), "rb");
+        if( !pfile ) {
+            RAVELOG_WARN_FORMAT("failed to open roadmap %s", filename);
+            return false;
+        }
+        const int dof = _parameters->GetDOF();
+        RoadmapFileHeader header;
+        std::vector<dReal> vconfigs;
+        std::vector<int32_t> vedgevertices;
+        bool bsuccess = fread(&header, sizeof(header), 1, pfile) == 1;
+        if( bsuccess ) {
+            if( !std::equal(s_RoadmapFileMagic, s_RoadmapFileMagic+sizeof(s_RoadmapFileMagic), header.magic) || header.version != s_RoadmapFileVersion || header.realsize != sizeof(dReal) ) {
+                RAVELOG_WARN_FORMAT("roadmap %s has an unsupported format", filename);
+                bsuccess = false;
+            }
+            else if( header.dof != dof || _roadmaphash.compare(0, sizeof(header.hash)-1, std::string(header.hash, strnlen(header.hash, sizeof(header.hash)))) != 0 ) {
+                RAVELOG_WARN_FORMAT("roadmap %s was saved for another robot or planning space", filename);
+                bsuccess = false;
+            }
+            else if( header.numvertices < 0 || header.numedges < 0 ) {
+                bsuccess = false;
+            }
+        }
+        if( bsuccess ) {
+            vconfigs.resize(header.numvertices*dof);
+            vedgevertices.resize(header.numedges*2);
+            bsuccess &= vconfigs.size() == 0 || fread(&vconfigs[0], sizeof(dReal)*vconfigs.size(), 1, pfile) == 1;
+            bsuccess &= vedgevertices.size() == 0 || fread(&vedgevertices[0], sizeof(int32_t)*vedgevertices.size(), 1, pfile) == 1;
+        }
+        fclose(pfile);
+        if( !bsuccess ) {
+            RAVELOG_WARN_FORMAT("failed to load roadmap %s", filename);
+            return false;
+        }
+
+        _ResetRoadmap();
+        // vertices that fall onto an earlier vertex are merged with it
+        std::vector<int> vvertexmap(header.numvertices, -1);
+        std::vector<dReal> vconfig(dof), vconfig2(dof);
+        for(int ivertex = 0; ivertex < header.numvertices; ++ivertex) {
+            std::copy(vconfigs.begin()+ivertex*dof, vconfigs.begin()+(ivertex+1)*dof, vconfig.begin());
+            SimpleNode* pnode = (SimpleNode*)_spatialtree.InsertNode(NULL, vconfig, _vvertices.size());
+            if( !!pnode ) {
+                vvertexmap[ivertex] = _vvertices.size();
+                _vvertices.push_back(RoadmapVertex(pnode));
+            }
+            else {
+                std::pair<NodeBasePtr, dReal> nearest = _spatialtree.FindNearestNode(vconfig);
+                vvertexmap[ivertex] = !nearest.first ? -1 : (int)((SimpleNode*)nearest.first)->_userdata;
+            }
+        }
+        for(int iedge = 0; iedge < header.numedges; ++iedge) {
+            int ivertex0 = vedgevertices[2*iedge], ivertex1 = vedgevertices[2*iedge+1];
+            if( ivertex0 < 0 || ivertex0 >= header.numvertices || ivertex1 < 0 || ivertex1 >= header.numvertices ) {
+                continue;
+            }
+            ivertex0 = vvertexmap[ivertex0];
+            ivertex1 = vvertexmap[ivertex1];
+            if( ivertex0 >= 0 && ivertex1 >= 0 ) {
+                _spatialtree.GetVectorConfig(_vvertices[ivertex0].node, vconfig);
+                _spatialtree.GetVectorConfig(_vvertices[ivertex1].node, vconfig2);
+                _AddEdge(ivertex0, ivertex1, _parameters->_distmetricfn(vconfig, vconfig2));
+            }
+        }
+        RAVELOG_DEBUG_FORMAT("env=%d, loaded roadmap with %d vertices and %d edges from %s", GetEnv()->GetId()%_vvertices.size()%_vedges.size()%filename);
+        return true;
+    }
+
+    RoadmapParametersPtr _parameters;
+    RobotBasePtr _robot;
+    SpaceSamplerBasePtr _uniformsampler;
+    std::string _roadmaphash; ///< hash of the robot structure and planning space the roadmap is built for
+
+    SpatialTree<SimpleNode> _spatialtree; ///< nearest neighbor structure of the vertices, also owns the configurations
+    std::vector<RoadmapVertex> _vvertices; ///< indexed by SimpleNode::_userdata
+    std::vector<RoadmapEdge> _vedges;
+
+    std::map<int, BodyState> _mapBodyStates; ///< environment id of the bodies -> state at the last synchronization
+    std::vector<dReal> _vRobotStateValues; ///< dof values not planned for and transform of the robot at the last synchronization
+    std::vector<int> _vGrabbedIds; ///< sorted environment ids of the grabbed bodies at the last synchronization
+
+    // cache
+    ConstraintFilterReturnPtr _filterreturn;
+    std::vector< std::pair<NodeBasePtr, dReal> > _vnearest;
+    std::vector<dReal> _vcost, _vheuristic;
+    std::vector<int> _vparentedge;
+    std::vector<uint8_t> _visgoal;
+    std::vector< std::vector<dReal> > _vgoalconfigs;
+    std::vector<dReal> _vsampleconfig, _vsampleconfig2, _vpathconfigs;
+    std::vector<KinBodyPtr> _vgrabbed;
+};
+
+PlannerBasePtr CreateRoadmapPlanner(EnvironmentBasePtr penv, std::istream& sinput)
+{
+    return PlannerBasePtr(new RoadmapPlanner(penv, sinput));
+}
@@ -25,12 +25,16 @@ PlannerBasePtr CreateRandomizedAStarPlanner(EnvironmentBasePtr penv, std::istrea
 PlannerBasePtr CreateWorkspaceTrajectoryTracker(EnvironmentBasePtr penv, std::istream& sinput);
 PlannerBasePtr CreateLinearSmoother(EnvironmentBasePtr penv, std::istream& sinput);
 PlannerBasePtr CreateConstraintParabolicSmoother(EnvironmentBasePtr penv, std::istream& sinput);
+PlannerBasePtr CreateRoadmapPlanner(EnvironmentBasePtr penv, std::istream& sinput);
+PlannerBasePtr CreatePathLibraryPlanner(EnvironmentBasePtr penv, std::istream& sinput);
 
 namespace rplanners {    
 PlannerBasePtr CreateParabolicSmoother(EnvironmentBasePtr penv, std::istream& sinput);
+PlannerBasePtr CreateOnlineParabolicSmoother(EnvironmentBasePtr penv, std::istream& sinput);
 PlannerBasePtr CreateLinearTrajectoryRetimer(EnvironmentBasePtr penv, std::istream& sinput);
 PlannerBasePtr CreateParabolicTrajectoryRetimer(EnvironmentBasePtr penv, std::istream& sinput);
 PlannerBasePtr CreateCubicTrajectoryRetimer(EnvironmentBasePtr penv, std::istream& sinput);
+PlannerBasePtr CreateJerkLimitedTrajectoryRetimer(EnvironmentBasePtr penv, std::istream& sinput);
 }
 
 InterfaceBasePtr CreateInterfaceValidated(InterfaceType type, const std::string& interfacename, std::istream& sinput, EnvironmentBasePtr penv)
@@ -53,6 +57,12 @@ InterfaceBasePtr CreateInterfaceValidated(InterfaceType type, const std::string&
         else if( interfacename == "explorationrrt" ) {
             return InterfaceBasePtr(new ExplorationPlanner(penv));
         }
+        else if( interfacename == "prm" ) {
+            return CreateRoadmapPlanner(penv,sinput);
+        }
+        else if( interfacename == "pathlibrary" ) {
+            return CreatePathLibraryPlanner(penv,sinput);
+        }
         else if( interfacename == "graspgradient" ) {
             return CreateGraspGradientPlanner(penv,sinput);
         }
@@ -68,6 +78,9 @@ InterfaceBasePtr CreateInterfaceValidated(InterfaceType type, const std::string&
         else if( interfacename == "cubictrajectoryretimer" ) {
             return rplanners::CreateCubicTrajectoryRetimer(penv,sinput);
         }
+        else if( interfacename == "jerklimitedtrajectoryretimer" ) {
+            return rplanners::CreateJerkLimitedTrajectoryRetimer(penv,sinput);
+        }
         else if( interfacename == "workspacetrajectorytracker" ) {
             return CreateWorkspaceTrajectoryTracker(penv,sinput);
         }
@@ -77,6 +90,9 @@ InterfaceBasePtr CreateInterfaceValidated(InterfaceType type, const std::string&
         else if( interfacename == "parabolicsmoother" ) {
             return rplanners::CreateParabolicSmoother(penv,sinput);
         }
+        else if( interfacename == "onlineparabolicsmoother" ) {
+            return rplanners::CreateOnlineParabolicSmoother(penv,sinput);
+        }
         else if( interfacename == "constraintparabolicsmoother" ) {
             return CreateConstraintParabolicSmoother(penv,sinput);
         }
@@ -93,14 +109,18 @@ void GetPluginAttributesValidated(PLUGININFO& info)
     info.interfacenames[PT_Planner].push_back("BiRRT");
     info.interfacenames[PT_Planner].push_back("BasicRRT");
     info.interfacenames[PT_Planner].push_back("ExplorationRRT");
+    info.interfacenames[PT_Planner].push_back("PRM");
+    info.interfacenames[PT_Planner].push_back("PathLibrary");
     info.interfacenames[PT_Planner].push_back("GraspGradient");
     info.interfacenames[PT_Planner].push_back("shortcut_linear");
     info.interfacenames[PT_Planner].push_back("LinearTrajectoryRetimer");
     info.interfacenames[PT_Planner].push_back("ParabolicTrajectoryRetimer");
     info.interfacenames[PT_Planner].push_back("CubicTrajectoryRetimer");
+    info.interfacenames[PT_Planner].push_back("JerkLimitedTrajectoryRetimer");
     info.interfacenames[PT_Planner].push_back("WorkspaceTrajectoryTracker");
     info.interfacenames[PT_Planner].push_back("LinearSmoother");
     info.interfacenames[PT_Planner].push_back("ParabolicSmoother");
+    info.interfacenames[PT_Planner].push_back("OnlineParabolicSmoother");
     info.interfacenames[PT_Planner].push_back("ConstraintParabolicSmoother");
 }
 
@@ -18,8 +18,9 @@
 #define RAVE_PLANNERS_H
 
 #include "openraveplugindefs.h"
+#include "parallelrangeworkers.h"
 
-#include <boost/pool/pool.hpp>
+#include <boost/thread/condition.hpp>
 
 #define _(msgid) OpenRAVE::RaveGetLocalizedTextForDomain("openrave_plugins_rplanners", msgid)
 
@@ -108,6 +109,117 @@ public:
     dReal q[0]; // the configuration immediately follows the struct
 };
 
+/// \brief hands out fixed size chunks from big blocks of memory
+///
+/// Reset makes all chunks available again without giving the blocks back to the heap, so a tree that is re-initialized
+/// for every planning call keeps reusing the same memory instead of fragmenting it. Freed chunks go to a free list.
+class NodeArena
+{
+public:
+    class Statistics
+    {
+public:
+        Statistics() : chunksize(0), numblocks(0), reservedbytes(0), numused(0), numpeak(0), numresets(0) {
+        }
+        size_t chunksize; ///< size of one chunk in bytes
+        size_t numblocks; ///< number of allocated blocks
+        size_t reservedbytes; ///< total bytes held by the blocks
+        size_t numused; ///< chunks currently in use
+        size_t numpeak; ///< maximum number of chunks ever used at the same time
+        size_t numresets; ///< number of times Reset was called
+    };
+
+    /// \param chunksize the minimum size of each chunk, rounded up so that every chunk is aligned for pointers and dReal
+    /// \param numblockchunks the number of chunks allocated at once
+    /// \param parena if set, the blocks are taken from it and given back when the arena is released instead of by the destructor
+    NodeArena(size_t chunksize, size_t numblockchunks=1024, utils::MonotonicArenaPtr parena=utils::MonotonicArenaPtr()) : _numblockchunks(numblockchunks), _curblock(0), _nextchunk(0), _pfree(NULL), _numused(0), _numpeak(0), _numresets(0), _parena(parena) {
+        const size_t align = std::max(sizeof(void*), sizeof(dReal));
+        _chunksize = std::max(chunksize, sizeof(void*));
+        _chunksize = ((_chunksize+align-1)/align)*align;
+    }
+    virtual ~NodeArena() {
+        if( !_parena ) {
+            FOREACH(itblock, _vblocks) {
+                delete[] *itblock;
+            }
+        }
+    }
+
+    void* Allocate()
+    {
+        void* p;
+        if( !!_pfree ) {
+            p = _pfree;
+            _pfree = *static_cast<void**>(_pfree);
+        }
+        else {
+            if( _curblock >= _vblocks.size() ) {
+                if( !!_parena ) {
+                    _vblocks.push_back(static_cast<char*>(_parena->Allocate(_chunksize*_numblockchunks, std::max(sizeof(void*), sizeof(dReal)))));
+                }
+                else {
+                    _vblocks.push_back(new char[_chunksize*_numblockchunks]);
+                }
+            }
+            p = _vblocks[_curblock] + _nextchunk*_chunksize;
+            if( ++_nextchunk >= _numblockchunks ) {
+                ++_curblock;
+                _nextchunk = 0;
+            }
+        }
+        if( ++_numused > _numpeak ) {
+            _numpeak = _numused;
+        }
+        return p;
+    }
+
+    /// \brief returns a chunk so it can be reused by the next Allocate
+    void Free(void* p)
+    {
+        *static_cast<void**>(p) = _pfree;
+        _pfree = p;
+        --_numused;
+    }
+
+    /// \brief makes all chunks available again. Any objects still living in the chunks have to be destroyed before.
+    void Reset()
+    {
+        _curblock = 0;
+        _nextchunk = 0;
+        _pfree = NULL;
+        _numused = 0;
+        ++_numresets;
+    }
+
+    inline size_t GetChunkSize() const {
+        return _chunksize;
+    }
+
+    inline const utils::MonotonicArenaPtr& GetArena() const {
+        return _parena;
+    }
+
+    void GetStatistics(Statistics& stats) const
+    {
+        stats.chunksize = _chunksize;
+        stats.numblocks = _vblocks.size();
+        stats.reservedbytes = _vblocks.size()*_numblockchunks*_chunksize;
+        stats.numused = _numused;
+        stats.numpeak = _numpeak;
+        stats.numresets = _numresets;
+    }
+
+private:
+    std::vector<char*> _vblocks;
+    size_t _chunksize, _numblockchunks;
+    size_t _curblock, _nextchunk; ///< the next chunk that was never handed out since the last Reset
+    void* _pfree; ///< singly linked list of freed chunks, the link is stored in the chunk itself
+    size_t _numused, _numpeak, _numresets;
+    utils::MonotonicArenaPtr _parena; ///< keeps the blocks alive when they come from a request arena
+};
+
+typedef boost::shared_ptr<NodeArena> NodeArenaPtr;
+
 class SpatialTreeBase
 {
 public:
@@ -116,9 +228,33 @@ public:
     /// inserts a node in the try
     virtual NodeBasePtr InsertNode(NodeBasePtr parent, const vector<dReal>& config, uint32_t userdata) = 0;
 
+    /// \brief inserts several configurations stored one after the other in vconfigs
+    ///
+    /// \param bChain if true, every inserted node becomes the rrt parent of the next one, otherwise all the nodes are children of parent
+    /// \param vnewnodes filled with the inserted nodes, NULL for configurations that were too close to existing nodes
+    /// \return the number of inserted nodes
+    virtual int InsertNodes(NodeBasePtr parent, const vector<dReal>& vconfigs, uint32_t userdata, bool bChain, std::vector<NodeBasePtr>& vnewnodes) = 0;
+
+    /// \brief sets up a faster nearest neighbor search
+    ///
+    /// \param vweights if not empty, distances are computed with sqrt(sum_i vweights[i]*(a_i-b_i)^2) directly on the node storage instead of calling the distance metric. Only valid if the distance metric computes exactly this.
+    /// \param numthreads if > 1 and vweights is not empty, the distances of big cover tree levels are computed in parallel
+    virtual void SetNearestNeighborOptions(const std::vector<dReal>& vweights, int numthreads) = 0;
+
+    /// \brief if not empty, the nearest neighbor search evaluates each cover tree level with one call to distmetricbatchfn instead of calling the distance metric per node. Ignored when nearest neighbor weights are set. Reset by Init.
+    virtual void SetDistanceMetricBatchFn(const PlannerBase::PlannerParameters::DistMetricBatchFn& distmetricbatchfn) = 0;
+
+    /// \brief if not empty, distances and extensions call the inline functions of statespace instead of the functions of the planner parameters. Has to be the space returned by planningutils::GetActiveDOFStateSpace for the parameters. Reset by Init.
+    virtual void SetStateSpace(planningutils::ActiveDOFStateSpacePtr statespace) = 0;
+
     /// returns the nearest neighbor
     virtual std::pair<NodeBasePtr, dReal> FindNearestNode(const vector<dReal>& q) const = 0;
 
+    /// \brief returns up to k nodes closest to q that are within maxdistance, sorted by increasing distance
+    ///
+    /// Each configuration is returned once even though the cover tree keeps copies of it at several levels. The levels are pruned with the same bounds as FindNearestNode.
+    virtual void FindNearestNodes(const vector<dReal>& q, int k, dReal maxdistance, std::vector< std::pair<NodeBasePtr, dReal> >& vnearest) const = 0;
+
     /// \brief returns a temporary config stored on the local class. Next time this function is called, it will overwrite the config
     virtual const vector<dReal>& GetVectorConfig(NodeBasePtr node) const = 0;
 
@@ -135,6 +271,15 @@ public:
 
     virtual int GetNumNodes() const = 0;
 
+    /// \brief sets the options Extend passes to PlannerParameters::CheckPathAllConstraints, reset to CFO_RecommendedOptions by Init
+    virtual void SetExtendCheckOptions(int options) = 0;
+
+    /// \brief returns the usage of the memory the nodes are allocated from
+    virtual void GetMemoryStatistics(NodeArena::Statistics& stats) const = 0;
+
+    /// \brief if set, the next Init takes the memory of the nodes from parena (see PlannerParameters::_parena) instead of the heap
+    virtual void SetMemoryArena(utils::MonotonicArenaPtr parena) = 0;
+
     /// invalidates any nodes that point to parentbase. nodes can still be references from outside, but just won't be used as part of the nearest neighbor search
     virtual void InvalidateNodesWithParent(NodeBasePtr parentbase) = 0;
 };
@@ -159,6 +304,8 @@ public:
         _maxlevel = 0;
         _minlevel = 0;
         _fMaxLevelBound = 0;
+        _nParallelMinNodes = 256;
+        _nExtendCheckOptions = CFO_RecommendedOptions;
     }
 
     ~SpatialTree() {
@@ -170,15 +317,19 @@ public:
         Reset();
         if( !!_pNodesPool ) {
             // see if pool can be preserved
-            if( _dof != dof ) {
+            if( _dof != dof || _pNodesPool->GetArena() != _parena ) {
                 _pNodesPool.reset();
             }
         }
         if( !_pNodesPool ) {
-            _pNodesPool.reset(new boost::pool<>(sizeof(Node)+dof*sizeof(dReal)));
+            _pNodesPool.reset(new NodeArena(sizeof(Node)+dof*sizeof(dReal), 1024, _parena));
         }
         _planner = planner;
         _distmetricfn = distmetricfn;
+        _vdistweights.clear(); // depends on the distance metric, so has to be set again with SetNearestNeighborOptions
+        _distmetricbatchfn.clear();
+        _statespace.reset();
+        _nExtendCheckOptions = CFO_RecommendedOptions;
         _dof = dof;
         _vNewConfig.resize(dof);
         _vDeltaConfig.resize(dof);
@@ -206,24 +357,91 @@ public:
             FOREACH(itchildren, _vsetLevelNodes) {
                 itchildren->clear();
             }
-            //_pNodesPool->purge_memory();
-            _pNodesPool.reset(new boost::pool<>(sizeof(Node)+_dof*sizeof(dReal)));
+            _pNodesPool->Reset(); // keep the memory for the next planning call
         }
         _numnodes = 0;
     }
 
+    virtual void SetNearestNeighborOptions(const std::vector<dReal>& vweights, int numthreads)
+    {
+        if( vweights.size() > 0 ) {
+            OPENRAVE_ASSERT_OP((int)vweights.size(),==,_dof);
+        }
+        _vdistweights = vweights;
+        if( vweights.size() > 0 && numthreads > 1 ) {
+            if( !_pworkers || _pworkers->GetNumThreads() != numthreads ) {
+                _pworkers.reset(new ParallelRangeWorkers(numthreads, "SpatialTreeDistances"));
+            }
+        }
+        else {
+            _pworkers.reset();
+        }
+    }
+
+    virtual void SetDistanceMetricBatchFn(const PlannerBase::PlannerParameters::DistMetricBatchFn& distmetricbatchfn)
+    {
+        _distmetricbatchfn = distmetricbatchfn;
+    }
+
+    virtual void SetStateSpace(planningutils::ActiveDOFStateSpacePtr statespace)
+    {
+        if( !!statespace ) {
+            OPENRAVE_ASSERT_OP(statespace->GetDOF(),==,_dof);
+        }
+        _statespace = statespace;
+    }
+
+    /// \brief weighted euclidean distance computed directly on the contiguous configuration values, see SetNearestNeighborOptions
+    inline dReal _ComputeWeightedDistance(const dReal* config0, const dReal* config1) const
+    {
+        const dReal* pweights = &_vdistweights[0];
+        // independent sums so the compiler can pipeline and vectorize them
+        dReal fsum0 = 0, fsum1 = 0, fsum2 = 0, fsum3 = 0;
+        int i = 0;
+        for(; i+4 <= _dof; i += 4) {
+            dReal f0 = config0[i]-config1[i], f1 = config0[i+1]-config1[i+1], f2 = config0[i+2]-config1[i+2], f3 = config0[i+3]-config1[i+3];
+            fsum0 += pweights[i]*f0*f0;
+            fsum1 += pweights[i+1]*f1*f1;
+            fsum2 += pweights[i+2]*f2*f2;
+            fsum3 += pweights[i+3]*f3*f3;
+        }
+        for(; i < _dof; ++i) {
+            dReal f = config0[i]-config1[i];
+            fsum0 += pweights[i]*f*f;
+        }
+        return RaveSqrt((fsum0+fsum1)+(fsum2+fsum3));
+    }
+
     inline dReal _ComputeDistance(const dReal* config0, const dReal* config1) const
     {
-        return _distmetricfn(VectorWrapper<const dReal>(config0, config0+_dof), VectorWrapper<dReal>(config1, config1+_dof));
+        if( _vdistweights.size() > 0 ) {
+            return _ComputeWeightedDistance(config0, config1);
+        }
+        if( !!_statespace ) {
+            return _statespace->ComputeDistance(config0, config1);
+        }
+        return _distmetricfn(VectorWrapper<dReal>(config0, config0+_dof), VectorWrapper<dReal>(config1, config1+_dof));
     }
 
     inline dReal _ComputeDistance(const dReal* config0, const std::vector<dReal>& config1) const
     {
+        if( _vdistweights.size() > 0 ) {
+            return _ComputeWeightedDistance(config0, &config1[0]);
+        }
+        if( !!_statespace ) {
+            return _statespace->ComputeDistance(config0, &config1[0]);
+        }
         return _distmetricfn(VectorWrapper<dReal>(config0,config0+_dof), config1);
     }
 
     inline dReal _ComputeDistance(NodePtr node0, NodePtr node1) const
     {
+        if( _vdistweights.size() > 0 ) {
+            return _ComputeWeightedDistance(node0->q, node1->q);
+        }
+        if( !!_statespace ) {
+            return _statespace->ComputeDistance(node0->q, node1->q);
+        }
         return _distmetricfn(VectorWrapper<dReal>(node0->q, &node0->q[_dof]), VectorWrapper<dReal>(node1->q, &node1->q[_dof]));
     }
 
@@ -232,11 +450,94 @@ public:
         return _FindNearestNode(vquerystate);
     }
 
+    /// \brief fills vdistances with the distances from vquerystate to the configurations stored one after the other in vconfigs
+    ///
+    /// Uses the same kernels as the nearest neighbor search: the weighted distance when weights are set, otherwise one call to the batch distance metric if set.
+    void ComputeDistances(const std::vector<dReal>& vquerystate, const std::vector<dReal>& vconfigs, std::vector<dReal>& vdistances) const
+    {
+        size_t numconfigs = vconfigs.size()/_dof;
+        vdistances.resize(numconfigs);
+        if( numconfigs == 0 ) {
+            return;
+        }
+        if( _vdistweights.size() > 0 ) {
+            for(size_t iconfig = 0; iconfig < numconfigs; ++iconfig) {
+                vdistances[iconfig] = _ComputeWeightedDistance(&vconfigs[iconfig*_dof], &vquerystate[0]);
+            }
+        }
+        else if( !!_distmetricbatchfn ) {
+            _distmetricbatchfn(vquerystate, vconfigs, vdistances);
+        }
+        else {
+            for(size_t iconfig = 0; iconfig < numconfigs; ++iconfig) {
+                vdistances[iconfig] = _ComputeDistance(&vconfigs[iconfig*_dof], vquerystate);
+            }
+        }
+    }
+
+    virtual void FindNearestNodes(const std::vector<dReal>& vquerystate, int k, dReal maxdistance, std::vector< std::pair<NodeBasePtr, dReal> >& vnearest) const
+    {
+        vnearest.resize(0);
+        if( _numnodes == 0 || k <= 0 ) {
+            return;
+        }
+        OPENRAVE_ASSERT_OP((int)vquerystate.size(),==,_dof);
+
+        dReal fLevelBound = _fMaxLevelBound;
+        _vCurrentLevelNodes.resize(1);
+        _vCurrentLevelNodes[0].first = *_vsetLevelNodes.at(_EncodeLevel(_maxlevel)).begin();
+        _vCurrentLevelNodes[0].second = _ComputeDistance(_vCurrentLevelNodes[0].first->q, vquerystate);
+        _AddNearestNode(_vCurrentLevelNodes[0], k, maxdistance, vnearest);
+        while(_vCurrentLevelNodes.size() > 0 ) {
+            _vNextLevelNodes.resize(0);
+            FOREACH(itcurrentnode, _vCurrentLevelNodes) {
+                FOREACHC(itchild, itcurrentnode->first->_vchildren) {
+                    _vNextLevelNodes.push_back(make_pair(*itchild, _ComputeDistance((*itchild)->q, vquerystate)));
+                    _AddNearestNode(_vNextLevelNodes.back(), k, maxdistance, vnearest);
+                }
+            }
+
+            // only the children closer than the k-th node found so far can lead to closer nodes
+            dReal ftestbound = maxdistance;
+            if( (int)vnearest.size() >= k && vnearest.back().second < ftestbound ) {
+                ftestbound = vnearest.back().second;
+            }
+            ftestbound += fLevelBound;
+            _vCurrentLevelNodes.resize(0);
+            FOREACH(itnode, _vNextLevelNodes) {
+                if( itnode->second <= ftestbound ) {
+                    _vCurrentLevelNodes.push_back(*itnode);
+                }
+            }
+            fLevelBound *= _fBaseInv;
+        }
+    }
+
     virtual NodeBasePtr InsertNode(NodeBasePtr parent, const vector<dReal>& config, uint32_t userdata)
     {
         return _InsertNode((NodePtr)parent, config, userdata);
     }
 
+    virtual int InsertNodes(NodeBasePtr parent, const vector<dReal>& vconfigs, uint32_t userdata, bool bChain, std::vector<NodeBasePtr>& vnewnodes)
+    {
+        OPENRAVE_ASSERT_OP((int)vconfigs.size()%_dof,==,0);
+        size_t numconfigs = vconfigs.size()/_dof;
+        vnewnodes.resize(numconfigs);
+        NodePtr pparent = (NodePtr)parent;
+        int numinserted = 0;
+        for(size_t iconfig = 0; iconfig < numconfigs; ++iconfig) {
+            NodePtr pnewnode = _InsertNode(pparent, &vconfigs[iconfig*_dof], userdata);
+            vnewnodes[iconfig] = pnewnode;
+            if( !!pnewnode ) {
+                ++numinserted;
+                if( bChain ) {
+                    pparent = pnewnode;
+                }
+            }
+        }
+        return numinserted;
+    }
+
     virtual void InvalidateNodesWithParent(NodeBasePtr parentbase)
     {
         //BOOST_ASSERT(Validate());
@@ -245,20 +546,43 @@ public:
         NodePtr parent = (NodePtr)parentbase;
         parent->_usenn = 0;
         _setchildcache.clear(); _setchildcache.insert(parent);
-        int numruns=0;
-        bool bchanged=true;
-        while(bchanged) {
-            bchanged=false;
-            FOREACHC(itchildren, _vsetLevelNodes) {
-                FOREACHC(itchild, *itchildren) {
-                    if( _setchildcache.find(*itchild) == _setchildcache.end() && _setchildcache.find((*itchild)->rrtparent) != _setchildcache.end() ) {
-                        (*itchild)->_usenn = 0;
-                        _setchildcache.insert(*itchild);
-                        bchanged=true;
+        _setvalidcache.clear();
+        // the clones of parent in the lower levels represent the same rrt node, and new nodes could have been extended from them
+        FOREACHC(itchildren, _vsetLevelNodes) {
+            FOREACHC(itchild, *itchildren) {
+                if( (*itchild)->rrtparent == parent->rrtparent && std::equal(parent->q, parent->q+_dof, (*itchild)->q) ) {
+                    (*itchild)->_usenn = 0;
+                    _setchildcache.insert(*itchild);
+                }
+            }
+        }
+        FOREACHC(itchildren, _vsetLevelNodes) {
+            FOREACHC(itchild, *itchildren) {
+                // walk up the rrt parents until reaching a node that is already classified, so every node is visited only once
+                _vchildcache.resize(0);
+                NodePtr pnode = *itchild;
+                bool binvalid = false;
+                while(!!pnode) {
+                    if( _setchildcache.find(pnode) != _setchildcache.end() ) {
+                        binvalid = true;
+                        break;
+                    }
+                    if( _setvalidcache.find(pnode) != _setvalidcache.end() ) {
+                        break;
+                    }
+                    _vchildcache.push_back(pnode);
+                    pnode = pnode->rrtparent;
+                }
+                FOREACH(itnode, _vchildcache) {
+                    if( binvalid ) {
+                        (*itnode)->_usenn = 0;
+                        _setchildcache.insert(*itnode);
+                    }
+                    else {
+                        _setvalidcache.insert(*itnode);
                     }
                 }
             }
-            ++numruns;
         }
         RAVELOG_VERBOSE("computed in %fs", (1e-9*(utils::GetNanoPerformanceTime()-starttime)));
     }
@@ -333,7 +657,12 @@ public:
 
             _vNewConfig = _vCurConfig;
             _vDeltaConfig = vTargetConfig;
-            params->_diffstatefn(_vDeltaConfig, _vCurConfig);
+            if( !!_statespace ) {
+                _statespace->Subtract(&_vDeltaConfig[0], &_vCurConfig[0]);
+            }
+            else {
+                params->_diffstatefn(_vDeltaConfig, _vCurConfig);
+            }
             for(int i = 0; i < _dof; ++i) {
                 _vDeltaConfig[i] *= fdist;
             }
@@ -343,7 +672,10 @@ public:
                 }
                 return ET_Failed;
             }
-            if( !params->_neighstatefn(_vNewConfig,_vDeltaConfig,_fromgoal ? NSO_GoalToInitial : 0) ) {
+            if( !!_statespace ) {
+                _statespace->AddStates(&_vNewConfig[0], &_vDeltaConfig[0], &params->_vConfigLowerLimit[0], &params->_vConfigUpperLimit[0]);
+            }
+            else if( !params->_neighstatefn(_vNewConfig,_vDeltaConfig,_fromgoal ? NSO_GoalToInitial : 0) ) {
                 if(bHasAdded) {
                     return ET_Sucess;
                 }
@@ -359,12 +691,12 @@ public:
             }
 
             if( _fromgoal ) {
-                if( params->CheckPathAllConstraints(_vNewConfig, _vCurConfig, std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenEnd) != 0 ) {
+                if( params->CheckPathAllConstraints(_vNewConfig, _vCurConfig, std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenEnd, _nExtendCheckOptions) != 0 ) {
                     return bHasAdded ? ET_Sucess : ET_Failed;
                 }
             }
             else {
-                if( params->CheckPathAllConstraints(_vCurConfig, _vNewConfig, std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenStart) != 0 ) {
+                if( params->CheckPathAllConstraints(_vCurConfig, _vNewConfig, std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenStart, _nExtendCheckOptions) != 0 ) {
                     return bHasAdded ? ET_Sucess : ET_Failed;
                 }
             }
@@ -388,6 +720,26 @@ public:
         return _numnodes;
     }
 
+    virtual void SetExtendCheckOptions(int options)
+    {
+        _nExtendCheckOptions = options;
+    }
+
+    virtual void SetMemoryArena(utils::MonotonicArenaPtr parena)
+    {
+        _parena = parena;
+    }
+
+    virtual void GetMemoryStatistics(NodeArena::Statistics& stats) const
+    {
+        if( !!_pNodesPool ) {
+            _pNodesPool->GetStatistics(stats);
+        }
+        else {
+            stats = NodeArena::Statistics();
+        }
+    }
+
     virtual const vector<dReal>& GetVectorConfig(NodeBasePtr nodebase) const
     {
         NodePtr node = (NodePtr)nodebase;
@@ -549,11 +901,11 @@ private:
         int retid = s_id++;
         return retid;
     }
-    inline NodePtr _CreateNode(NodePtr rrtparent, const vector<dReal>& config, uint32_t userdata)
+    inline NodePtr _CreateNode(NodePtr rrtparent, const dReal* pconfig, uint32_t userdata)
     {
         // allocate memory for the structur and the internal state vectors
-        void* pmemory = _pNodesPool->malloc();
-        NodePtr node = new (pmemory) Node(rrtparent, config);
+        void* pmemory = _pNodesPool->Allocate();
+        NodePtr node = new (pmemory) Node(rrtparent, pconfig, _dof);
         node->_userdata = userdata;
 #ifdef _DEBUG
         node->id = GetNewStaticId();
@@ -564,7 +916,7 @@ private:
     inline NodePtr _CloneNode(NodePtr refnode)
     {
         // allocate memory for the structur and the internal state vectors
-        void* pmemory = _pNodesPool->malloc();
+        void* pmemory = _pNodesPool->Allocate();
         NodePtr node = new (pmemory) Node(refnode->rrtparent, refnode->q, _dof);
         node->_userdata = refnode->_userdata;
 #ifdef _DEBUG
@@ -577,7 +929,7 @@ private:
     {
         if( !!p ) {
             p->~Node();
-            _pNodesPool->free(p);
+            _pNodesPool->Free(p);
         }
     }
 
@@ -613,16 +965,43 @@ private:
             _vNextLevelNodes.resize(0);
             //RAVELOG_VERBOSE_FORMAT("level %d (%f) has %d nodes", currentlevel%fLevelBound%_vCurrentLevelNodes.size());
             dReal minchilddist=std::numeric_limits<dReal>::infinity();
-            FOREACH(itcurrentnode, _vCurrentLevelNodes) {
-                // only take the children whose distances are within the bound
-                FOREACHC(itchild, itcurrentnode->first->_vchildren) {
-                    dReal curdist = _ComputeDistance((*itchild)->q, vquerystate);
-                    if( !bestnode.first || (curdist < bestnode.second && bestnode.first->_usenn)) {
-                        bestnode = make_pair(*itchild, curdist);
+            if( (!!_pworkers && _vdistweights.size() > 0) || (!!_distmetricbatchfn && _vdistweights.size() == 0) ) {
+                // gather the children first so that big levels can be evaluated in parallel or with one batch call
+                FOREACH(itcurrentnode, _vCurrentLevelNodes) {
+                    FOREACHC(itchild, itcurrentnode->first->_vchildren) {
+                        _vNextLevelNodes.push_back(make_pair(*itchild, dReal(0)));
                     }
-                    _vNextLevelNodes.push_back(make_pair(*itchild, curdist));
-                    if( minchilddist > curdist ) {
-                        minchilddist = curdist;
+                }
+                if( _vdistweights.size() == 0 ) {
+                    _ComputeLevelDistancesBatch(vquerystate);
+                }
+                else if( _vNextLevelNodes.size() >= _nParallelMinNodes ) {
+                    _pworkers->Run(_vNextLevelNodes.size(), boost::bind(&SpatialTree<Node>::_ComputeLevelDistances, this, &vquerystate[0], _1, _2));
+                }
+                else {
+                    _ComputeLevelDistances(&vquerystate[0], 0, _vNextLevelNodes.size());
+                }
+                FOREACH(itnode, _vNextLevelNodes) {
+                    if( itnode->first->_usenn && (!bestnode.first || itnode->second < bestnode.second) ) {
+                        bestnode = *itnode;
+                    }
+                    if( minchilddist > itnode->second ) {
+                        minchilddist = itnode->second;
+                    }
+                }
+            }
+            else {
+                FOREACH(itcurrentnode, _vCurrentLevelNodes) {
+                    // only take the children whose distances are within the bound
+                    FOREACHC(itchild, itcurrentnode->first->_vchildren) {
+                        dReal curdist = _ComputeDistance((*itchild)->q, vquerystate);
+                        if( (*itchild)->_usenn && (!bestnode.first || curdist < bestnode.second) ) {
+                            bestnode = make_pair(*itchild, curdist);
+                        }
+                        _vNextLevelNodes.push_back(make_pair(*itchild, curdist));
+                        if( minchilddist > curdist ) {
+                            minchilddist = curdist;
+                        }
                     }
                 }
             }
@@ -641,9 +1020,64 @@ private:
         return bestnode;
     }
 
+    static bool _CompareNearestNodes(const std::pair<NodeBasePtr, dReal>& node0, const std::pair<NodeBasePtr, dReal>& node1)
+    {
+        return node0.second < node1.second;
+    }
+
+    /// \brief inserts node into the sorted vnearest if it is one of the k closest nodes within maxdistance
+    ///
+    /// Nodes with a clone in the level below are skipped since the clone is visited whenever the node could be one of the closest.
+    inline void _AddNearestNode(const std::pair<NodePtr, dReal>& node, int k, dReal maxdistance, std::vector< std::pair<NodeBasePtr, dReal> >& vnearest) const
+    {
+        if( node.first->_hasselfchild || !node.first->_usenn || node.second > maxdistance ) {
+            return;
+        }
+        if( (int)vnearest.size() >= k ) {
+            if( node.second >= vnearest.back().second ) {
+                return;
+            }
+            vnearest.pop_back();
+        }
+        std::pair<NodeBasePtr, dReal> newnode(node.first, node.second);
+        vnearest.insert(std::upper_bound(vnearest.begin(), vnearest.end(), newnode, _CompareNearestNodes), newnode);
+    }
+
+    /// \brief fills the distances of all _vNextLevelNodes to vquerystate with one call to _distmetricbatchfn
+    void _ComputeLevelDistancesBatch(const std::vector<dReal>& vquerystate) const
+    {
+        if( _vNextLevelNodes.size() == 0 ) {
+            return;
+        }
+        _vBatchConfigs.resize(_vNextLevelNodes.size()*_dof);
+        std::vector<dReal>::iterator itconfig = _vBatchConfigs.begin();
+        FOREACHC(itnode, _vNextLevelNodes) {
+            itconfig = std::copy(itnode->first->q, itnode->first->q+_dof, itconfig);
+        }
+        _distmetricbatchfn(vquerystate, _vBatchConfigs, _vBatchDistances);
+        OPENRAVE_ASSERT_OP(_vBatchDistances.size(),==,_vNextLevelNodes.size());
+        for(size_t inode = 0; inode < _vNextLevelNodes.size(); ++inode) {
+            _vNextLevelNodes[inode].second = _vBatchDistances[inode];
+        }
+    }
+
+    /// \brief fills the distances of _vNextLevelNodes[start:end] to pquerystate, can be called from the worker threads
+    void _ComputeLevelDistances(const dReal* pquerystate, size_t start, size_t end) const
+    {
+        for(size_t inode = start; inode < end; ++inode) {
+            _vNextLevelNodes[inode].second = _ComputeWeightedDistance(_vNextLevelNodes[inode].first->q, pquerystate);
+        }
+    }
+
     NodePtr _InsertNode(NodePtr parent, const vector<dReal>& config, uint32_t userdata)
     {
-        NodePtr newnode = _CreateNode(parent, config, userdata);
+        OPENRAVE_ASSERT_OP((int)config.size(),==,_dof);
+        return _InsertNode(parent, &config[0], userdata);
+    }
+
+    NodePtr _InsertNode(NodePtr parent, const dReal* pconfig, uint32_t userdata)
+    {
+        NodePtr newnode = _CreateNode(parent, pconfig, userdata);
         if( _numnodes == 0 ) {
             // no root
             _vsetLevelNodes.at(_EncodeLevel(_maxlevel)).insert(newnode); // add to the level
@@ -653,7 +1087,7 @@ private:
         else {
             _vCurrentLevelNodes.resize(1);
             _vCurrentLevelNodes[0].first = *_vsetLevelNodes.at(_EncodeLevel(_maxlevel)).begin();
-            _vCurrentLevelNodes[0].second = _ComputeDistance(_vCurrentLevelNodes[0].first->q, config);
+            _vCurrentLevelNodes[0].second = _ComputeDistance(_vCurrentLevelNodes[0].first->q, pconfig);
             int nParentFound = _InsertRecursive(newnode, _vCurrentLevelNodes, _maxlevel, _fMaxLevelBound);
             BOOST_ASSERT(nParentFound!=0);
             if( nParentFound < 0 ) {
@@ -968,13 +1402,16 @@ private:
 
 
     boost::function<dReal(const std::vector<dReal>&, const std::vector<dReal>&)> _distmetricfn;
+    planningutils::ActiveDOFStateSpacePtr _statespace; ///< see SetStateSpace
+    PlannerBase::PlannerParameters::DistMetricBatchFn _distmetricbatchfn; ///< see SetDistanceMetricBatchFn
     boost::weak_ptr<PlannerBase> _planner;
     dReal _fStepLength;
     int _dof; ///< the number of values of each state
     int _fromgoal;
 
     // cover tree data structures
-    boost::shared_ptr< boost::pool<> > _pNodesPool; ///< pool nodes are created from
+    NodeArenaPtr _pNodesPool; ///< pool nodes are created from, kept between calls to Init
+    utils::MonotonicArenaPtr _parena; ///< if set, the blocks of _pNodesPool come from it
 
     std::vector< std::set<NodePtr> > _vsetLevelNodes; ///< _vsetLevelNodes[enc(level)][node] holds the indices of the children of "node" of a given the level. enc(level) maps (-inf,inf) into [0,inf) so it can be indexed by the vector. Every node has an entry in a map here. If the node doesn't hold any children, then it is at the leaf of the tree. _vsetLevelNodes.at(_EncodeLevel(_maxlevel)) is the root.
 
@@ -989,11 +1426,20 @@ private:
     // cache
     vector<NodePtr> _vchildcache;
     set<NodePtr> _setchildcache;
+    set<NodePtr> _setvalidcache; ///< used by InvalidateNodesWithParent
     vector<dReal> _vNewConfig, _vDeltaConfig, _vCurConfig;
     mutable vector<dReal> _vTempConfig;
 
     mutable std::vector< std::pair<NodePtr, dReal> > _vCurrentLevelNodes, _vNextLevelNodes;
     mutable std::vector< std::vector<NodePtr> > _vvCacheNodes;
+    mutable std::vector<dReal> _vBatchConfigs, _vBatchDistances; ///< packed configurations and distances of a level for _distmetricbatchfn
+
+    // nearest neighbor options, see SetNearestNeighborOptions
+    std::vector<dReal> _vdistweights; ///< if not empty, the weights of the weighted euclidean distance used instead of _distmetricfn
+    ParallelRangeWorkersPtr _pworkers; ///< if not empty, evaluates the distances of the big levels in parallel
+    size_t _nParallelMinNodes; ///< minimum number of nodes in a level for evaluating it in parallel
+
+    int _nExtendCheckOptions; ///< options Extend checks the constraints with, see SetExtendCheckOptions
 };
 
 #ifdef RAVE_REGISTER_BOOST
@@ -36,7 +36,17 @@ Uses the Rapidly-Exploring Random Trees Algorithm.\n\
                         "returns the goal index of the plan");
         RegisterCommand("GetInitGoalIndices",boost::bind(&RrtPlanner<Node>::GetInitGoalIndicesCommand,this,_1,_2),
                         "returns the start and goal indices");
+        RegisterCommand("SetNearestNeighborOptions",boost::bind(&RrtPlanner<Node>::SetNearestNeighborOptionsCommand,this,_1,_2),
+                        "Speeds up the nearest neighbor search of the trees, applied at the next InitPlan. Options:\n\n\
+- weights [robot|w_1 ... w_dof|none] - computes the distances with sqrt(sum_i w_i*(a_i-b_i)^2) instead of calling the distance metric of the parameters. robot uses the squared active dof weights of the robot, which is exactly the default metric when no dof is circular.\n\
+- numthreads n - evaluates the distances of big tree levels with n threads, only used when weights are set.\n");
+        RegisterCommand("BenchmarkNearestNeighbor",boost::bind(&RrtPlanner<Node>::BenchmarkNearestNeighborCommand,this,_1,_2),
+                        "[numnodes] [numqueries] - after InitPlan, fills temporary trees with random configurations and returns the inserted nodes/s and queries/s of the distance metric and of the nearest neighbor options");
+        RegisterCommand("GetStatistics",boost::bind(&RrtPlanner<Node>::GetStatisticsCommand,this,_1,_2),
+                        "returns one line per tree with the name of the tree followed by name/value pairs of the number of nodes and of the memory the nodes are allocated from: numnodes, chunksize, numblocks, reservedbytes, numused, numpeak, numresets. The memory is kept between planning calls.");
         _filterreturn.reset(new ConstraintFilterReturn());
+        _bNearestNeighborRobotWeights = false;
+        _nNearestNeighborThreads = 1;
     }
     virtual ~RrtPlanner() {
     }
@@ -67,7 +77,9 @@ Uses the Rapidly-Exploring Random Trees Algorithm.\n\
 
         _vecInitialNodes.resize(0);
         _sampleConfig.resize(params->GetDOF());
+        _treeForward.SetMemoryArena(params->_parena);
         _treeForward.Init(shared_planner(), params->GetDOF(), params->_distmetricfn, params->_fStepLength, params->_distmetricfn(params->_vConfigLowerLimit, params->_vConfigUpperLimit));
+        _SetupNearestNeighbor(_treeForward, params);
         std::vector<dReal> vinitialconfig(params->GetDOF());
         for(size_t index = 0; index < params->vinitialconfig.size(); index += params->GetDOF()) {
             std::copy(params->vinitialconfig.begin()+index,params->vinitialconfig.begin()+index+params->GetDOF(),vinitialconfig.begin());
@@ -243,6 +255,99 @@ Uses the Rapidly-Exploring Random Trees Algorithm.\n\
         return !!os;
     }
 
+    virtual bool GetStatisticsCommand(std::ostream& os, std::istream& is)
+    {
+        _WriteTreeStatistics(os, "forward", _treeForward);
+        return !!os;
+    }
+
+    bool SetNearestNeighborOptionsCommand(std::ostream& os, std::istream& is)
+    {
+        std::vector<std::string> vtokens((istream_iterator<std::string>(is)), istream_iterator<std::string>());
+        size_t itoken = 0;
+        while(itoken < vtokens.size()) {
+            std::string cmd = vtokens[itoken++];
+            std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
+            if( cmd == "weights" ) {
+                _vNearestNeighborWeights.resize(0);
+                _bNearestNeighborRobotWeights = false;
+                if( itoken < vtokens.size() && (vtokens[itoken] == "robot" || vtokens[itoken] == "none") ) {
+                    _bNearestNeighborRobotWeights = vtokens[itoken] == "robot";
+                    ++itoken;
+                }
+                else {
+                    // read all the values until the next option
+                    while(itoken < vtokens.size()) {
+                        std::stringstream ss(vtokens[itoken]);
+                        dReal fweight;
+                        ss >> fweight;
+                        if( !ss ) {
+                            break;
+                        }
+                        _vNearestNeighborWeights.push_back(fweight);
+                        ++itoken;
+                    }
+                }
+            }
+            else if( cmd == "numthreads" && itoken < vtokens.size() ) {
+                std::stringstream ss(vtokens[itoken++]);
+                ss >> _nNearestNeighborThreads;
+                if( _nNearestNeighborThreads <= 0 ) {
+                    _nNearestNeighborThreads = boost::thread::hardware_concurrency();
+                }
+            }
+            else {
+                RAVELOG_WARN(str(boost::format("unrecognized command: %s\n")%cmd));
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool BenchmarkNearestNeighborCommand(std::ostream& os, std::istream& is)
+    {
+        PlannerParametersConstPtr params = GetParameters();
+        if( !params ) {
+            RAVELOG_WARN("planner has to be initialized first\n");
+            return false;
+        }
+        int numnodes = 10000, numqueries = 1000;
+        is >> numnodes >> numqueries;
+        const int dof = params->GetDOF();
+        std::vector<dReal> vconfigs(numnodes*dof), vqueries(numqueries*dof), vsample;
+        for(int iconfig = 0; iconfig < numnodes+numqueries; ++iconfig) {
+            _uniformsampler->SampleSequence(vsample, dof, IT_Closed);
+            dReal* pconfig = iconfig < numnodes ? &vconfigs[iconfig*dof] : &vqueries[(iconfig-numnodes)*dof];
+            for(int idof = 0; idof < dof; ++idof) {
+                pconfig[idof] = params->_vConfigLowerLimit[idof] + vsample[idof]*(params->_vConfigUpperLimit[idof]-params->_vConfigLowerLimit[idof]);
+            }
+        }
+
+        PlannerBase::PlannerParameters::DistMetricFn distmetricfn = params->_distmetricfn;
+        dReal fmaxdistance = params->_distmetricfn(params->_vConfigLowerLimit, params->_vConfigUpperLimit);
+        std::vector<NodeBasePtr> vnewnodes;
+        std::vector<dReal> vquery(dof);
+        for(int itest = 0; itest < 2; ++itest) {
+            // first test the distance metric, then the nearest neighbor options
+            SpatialTree<Node> tree(0);
+            tree.Init(shared_planner(), dof, distmetricfn, params->_fStepLength, fmaxdistance);
+            if( itest == 1 ) {
+                _SetupNearestNeighbor(tree, params);
+            }
+            uint64_t starttime = utils::GetNanoPerformanceTime();
+            tree.InsertNodes(NULL, vconfigs, 0, false, vnewnodes);
+            uint64_t inserttime = utils::GetNanoPerformanceTime()-starttime;
+            starttime = utils::GetNanoPerformanceTime();
+            for(int iquery = 0; iquery < numqueries; ++iquery) {
+                std::copy(vqueries.begin()+iquery*dof, vqueries.begin()+(iquery+1)*dof, vquery.begin());
+                tree.FindNearestNode(vquery);
+            }
+            uint64_t querytime = utils::GetNanoPerformanceTime()-starttime;
+            os << (itest == 0 ? "metric" : "options") << " " << (1e9*numnodes/std::max(inserttime,(uint64_t)1)) << " " << (1e9*numqueries/std::max(querytime,(uint64_t)1)) << " ";
+        }
+        return !!os;
+    }
+
 protected:
     RobotBasePtr _robot;
     std::vector<dReal> _sampleConfig;
@@ -254,6 +359,229 @@ protected:
     SpatialTree< Node > _treeForward;
     std::vector< NodeBase* > _vecInitialNodes;
 
+    static void _WriteTreeStatistics(std::ostream& os, const std::string& treename, const SpatialTreeBase& tree)
+    {
+        NodeArena::Statistics stats;
+        tree.GetMemoryStatistics(stats);
+        os << treename << " numnodes " << tree.GetNumNodes() << " chunksize " << stats.chunksize << " numblocks " << stats.numblocks << " reservedbytes " << stats.reservedbytes << " numused " << stats.numused << " numpeak " << stats.numpeak << " numresets " << stats.numresets << std::endl;
+    }
+
+    /// \brief sets the nearest neighbor options of a tree that was just initialized, see SetNearestNeighborOptionsCommand
+    void _SetupNearestNeighbor(SpatialTree<Node>& tree, PlannerParametersConstPtr params)
+    {
+        std::vector<dReal> vweights = _vNearestNeighborWeights;
+        if( _bNearestNeighborRobotWeights ) {
+            vweights.resize(0);
+            if( !!_robot && _robot->GetActiveDOF() == params->GetDOF() && _robot->GetAffineDOF() == 0 ) {
+                bool bcircular = false;
+                FOREACHC(itindex, _robot->GetActiveDOFIndices()) {
+                    KinBody::JointPtr pjoint = _robot->GetJointFromDOFIndex(*itindex);
+                    if( pjoint->IsCircular(*itindex-pjoint->GetDOFIndex()) ) {
+                        bcircular = true;
+                        break;
+                    }
+                }
+                if( !bcircular ) {
+                    _robot->GetActiveDOFWeights(vweights);
+                    FOREACH(itweight, vweights) {
+                        *itweight *= *itweight;
+                    }
+                }
+            }
+            if( vweights.size() == 0 ) {
+                RAVELOG_WARN("robot weights cannot be used for the nearest neighbor search, using the distance metric\n");
+            }
+        }
+        if( vweights.size() > 0 && (int)vweights.size() != params->GetDOF() ) {
+            RAVELOG_WARN_FORMAT("nearest neighbor weights have %d values, but planner has %d dof. using the distance metric", vweights.size()%params->GetDOF());
+            vweights.resize(0);
+        }
+        tree.SetNearestNeighborOptions(vweights, _nNearestNeighborThreads);
+        tree.SetDistanceMetricBatchFn(params->_distmetricbatchfn);
+        tree.SetStateSpace(planningutils::GetActiveDOFStateSpace(*params));
+    }
+
+    std::vector<dReal> _vNearestNeighborWeights; ///< see SetNearestNeighborOptionsCommand
+    bool _bNearestNeighborRobotWeights; ///< if true, use the active dof weights of the robot for the nearest neighbor search
+    int _nNearestNeighborThreads; ///< number of threads evaluating the big levels of the nearest neighbor search
+
+    /// \brief one extension of a batch, computed on an environment snapshot by _ExtendBatch
+    struct ExtendJob
+    {
+        ExtendJob() : pstartnode(NULL), bDirect(false), bOneStep(false), bConnected(false) {
+        }
+        NodeBase* pstartnode; ///< the node to extend, set by _ExtendBatch to the nearest node of vtarget unless bDirect is set
+        std::vector<dReal> vtarget; ///< the configuration to extend towards
+        bool bDirect; ///< if true, only the straight path from pstartnode to vtarget is checked instead of stepping towards vtarget
+        bool bOneStep; ///< if true, stops after the first step like SpatialTree::Extend
+        std::vector<dReal> vstart; ///< the configuration of pstartnode
+        std::vector<dReal> vconfigs; ///< the configurations that satisfied the constraints one after the other, each one is the child of the previous one
+        bool bConnected; ///< true if vtarget was reached or the first step was taken with bOneStep
+    };
+
+    /// \brief sets up numthreads environment snapshots computing the extensions of _ExtendBatch in parallel
+    ///
+    /// The snapshots are kept between calls so that only the bodies that changed need to be copied. The parameters of the snapshots
+    /// are rebuilt from the configuration specification, so custom constraint functions of the original parameters are not used by the extensions.
+    bool _InitExtendSnapshots(PlannerParametersConstPtr params, int numthreads)
+    {
+        _vExtendParameters.resize(0);
+        if( numthreads <= 1 ) {
+            _vExtendEnvs.resize(0);
+            _pExtendWorkers.reset();
+            return true;
+        }
+        _vExtendEnvs.resize(numthreads);
+        for(int ithread = 0; ithread < numthreads; ++ithread) {
+            if( !_vExtendEnvs[ithread] ) {
+                _vExtendEnvs[ithread] = GetEnv()->CloneSelf(Clone_Bodies);
+            }
+            else {
+                _vExtendEnvs[ithread]->Clone(GetEnv(), Clone_Bodies|Clone_SkipUnchangedBodies);
+            }
+            EnvironmentMutex::scoped_lock lockextend(_vExtendEnvs[ithread]->GetMutex());
+            PlannerParametersPtr pextendparams(new PlannerParameters());
+            pextendparams->copy(params);
+            pextendparams->SetConfigurationSpecification(_vExtendEnvs[ithread], params->_configurationspecification);
+            // SetConfigurationSpecification resets the limits to the ones of the bodies
+            pextendparams->_vConfigLowerLimit = params->_vConfigLowerLimit;
+            pextendparams->_vConfigUpperLimit = params->_vConfigUpperLimit;
+            pextendparams->_vConfigVelocityLimit = params->_vConfigVelocityLimit;
+            pextendparams->_vConfigAccelerationLimit = params->_vConfigAccelerationLimit;
+            pextendparams->_vConfigResolution = params->_vConfigResolution;
+            _vExtendParameters.push_back(pextendparams);
+        }
+        _vExtendJobs.resize(numthreads);
+        if( !_pExtendWorkers || _pExtendWorkers->GetNumThreads() != numthreads ) {
+            _pExtendWorkers.reset(new ParallelRangeWorkers(numthreads, "RrtExtend"));
+        }
+        return true;
+    }
+
+    /// \brief computes _vExtendJobs[0:numjobs] in parallel and inserts the resulting configurations into tree
+    ///
+    /// The nearest nodes are searched and the nodes inserted in this thread, only the constraint checks run on the snapshots.
+    /// \param vresults filled with the extend type and the last node of every job like SpatialTree::Extend
+    void _ExtendBatch(SpatialTree<Node>& tree, size_t numjobs, std::vector< std::pair<ExtendType, NodeBase*> >& vresults)
+    {
+        OPENRAVE_ASSERT_OP(numjobs,<=,_vExtendParameters.size());
+        vresults.resize(0);
+        for(size_t ijob = 0; ijob < numjobs; ++ijob) {
+            ExtendJob& job = _vExtendJobs[ijob];
+            if( !job.bDirect ) {
+                job.pstartnode = tree.FindNearestNode(job.vtarget).first;
+            }
+            job.vconfigs.resize(0);
+            job.bConnected = false;
+            if( !!job.pstartnode ) {
+                tree.GetVectorConfig(job.pstartnode, job.vstart);
+            }
+        }
+        if( numjobs == 0 ) {
+            return;
+        }
+        _pExtendWorkers->Run(numjobs, boost::bind(&RrtPlanner<Node>::_ExtendJobsRange, this, _1, _2));
+        for(size_t ijob = 0; ijob < numjobs; ++ijob) {
+            ExtendJob& job = _vExtendJobs[ijob];
+            if( !job.pstartnode ) {
+                vresults.push_back(std::make_pair(ET_Failed, (NodeBase*)NULL));
+                continue;
+            }
+            NodeBase* plastnode = job.pstartnode;
+            int numinserted = tree.InsertNodes(job.pstartnode, job.vconfigs, 0, true, _vExtendNewNodes);
+            FOREACH(itnode, _vExtendNewNodes) {
+                if( !!*itnode ) {
+                    plastnode = *itnode;
+                }
+            }
+            vresults.push_back(std::make_pair(job.bConnected ? ET_Connected : (numinserted > 0 ? ET_Sucess : ET_Failed), plastnode));
+        }
+    }
+
+    /// \brief computes _vExtendJobs[start:end] on the environment snapshots, called from the worker threads
+    void _ExtendJobsRange(size_t start, size_t end)
+    {
+        for(size_t ijob = start; ijob < end; ++ijob) {
+            ExtendJob& job = _vExtendJobs[ijob];
+            if( !job.pstartnode ) {
+                continue;
+            }
+            EnvironmentBasePtr penv = _vExtendEnvs.at(ijob);
+            EnvironmentMutex::scoped_lock lock(penv->GetMutex());
+            CollisionOptionsStateSaver optionstate(penv->GetCollisionChecker(),penv->GetCollisionChecker()->GetCollisionOptions()|CO_ActiveDOFs,false);
+            _ExtendJob(_vExtendParameters.at(ijob), job);
+        }
+    }
+
+    /// \brief steps from job.vstart towards job.vtarget the same way as SpatialTree::Extend without inserting any node
+    static void _ExtendJob(PlannerParametersPtr params, ExtendJob& job)
+    {
+        if( job.bDirect ) {
+            if( params->CheckPathAllConstraints(job.vstart, job.vtarget, std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenStart) == 0 ) {
+                job.vconfigs = job.vtarget;
+                job.bConnected = true;
+            }
+            return;
+        }
+        const size_t dof = job.vstart.size();
+        // the snapshot parameters are set with SetRobotActiveJoints, so usually the state space can be called directly
+        planningutils::ActiveDOFStateSpacePtr statespace = planningutils::GetActiveDOFStateSpace(*params);
+        std::vector<dReal> vcurconfig = job.vstart, vnewconfig, vdeltaconfig;
+        for(int iter = 0; iter < 100; ++iter) {     // to avoid infinite loops
+            dReal fdist = !!statespace ? statespace->ComputeDistance(&vcurconfig[0], &job.vtarget[0]) : params->_distmetricfn(vcurconfig, job.vtarget);
+            if( fdist > params->_fStepLength ) {
+                fdist = params->_fStepLength / fdist;
+            }
+            else if( fdist <= dReal(0.01) * params->_fStepLength ) {
+                job.bConnected = true;
+                return;
+            }
+            else {
+                fdist = 1;
+            }
+            vnewconfig = vcurconfig;
+            vdeltaconfig = job.vtarget;
+            if( !!statespace ) {
+                statespace->Subtract(&vdeltaconfig[0], &vcurconfig[0]);
+            }
+            else {
+                params->_diffstatefn(vdeltaconfig, vcurconfig);
+            }
+            for(size_t i = 0; i < dof; ++i) {
+                vdeltaconfig[i] *= fdist;
+            }
+            if( params->SetStateValues(vnewconfig) != 0 ) {
+                return;
+            }
+            if( !!statespace ) {
+                statespace->AddStates(&vnewconfig[0], &vdeltaconfig[0], &params->_vConfigLowerLimit[0], &params->_vConfigUpperLimit[0]);
+            }
+            else if( !params->_neighstatefn(vnewconfig,vdeltaconfig,0) ) {
+                return;
+            }
+            // the node might not have moved, in which case the loop would never end
+            if( (!!statespace ? statespace->ComputeDistance(&vcurconfig[0], &vnewconfig[0]) : params->_distmetricfn(vcurconfig, vnewconfig)) <= dReal(0.01)*params->_fStepLength ) {
+                return;
+            }
+            if( params->CheckPathAllConstraints(vcurconfig, vnewconfig, std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenStart, CFO_RecommendedOptions) != 0 ) {
+                return;
+            }
+            job.vconfigs.insert(job.vconfigs.end(), vnewconfig.begin(), vnewconfig.end());
+            if( job.bOneStep ) {
+                job.bConnected = true;
+                return;
+            }
+            vcurconfig.swap(vnewconfig);
+        }
+    }
+
+    std::vector<EnvironmentBasePtr> _vExtendEnvs; ///< environment snapshots of _ExtendBatch, kept between calls
+    std::vector<PlannerParametersPtr> _vExtendParameters; ///< the parameters of the robots in _vExtendEnvs, empty if extending in this thread
+    std::vector<ExtendJob> _vExtendJobs; ///< one job per snapshot
+    std::vector<NodeBasePtr> _vExtendNewNodes; ///< cache
+    std::vector< std::pair<ExtendType, NodeBase*> > _vExtendResults; ///< cache
+    ParallelRangeWorkersPtr _pExtendWorkers; ///< threads running the jobs of _ExtendBatch
+
     inline boost::shared_ptr<RrtPlanner> shared_planner() {
         return boost::dynamic_pointer_cast<RrtPlanner>(shared_from_this());
     }
@@ -280,6 +608,8 @@ Some python code to display data::\n\
 \n\
 ");
         _nValidGoals = 0;
+        _nLazyValidatedEdges = 0;
+        _nLazyInvalidatedEdges = 0;
     }
     virtual ~BirrtPlanner() {
     }
@@ -307,7 +637,9 @@ Some python code to display data::\n\
         PlannerParameters::StateSaver savestate(_parameters);
         CollisionOptionsStateSaver optionstate(GetEnv()->GetCollisionChecker(),GetEnv()->GetCollisionChecker()->GetCollisionOptions()|CO_ActiveDOFs,false);
 
+        _treeBackward.SetMemoryArena(_parameters->_parena);
         _treeBackward.Init(shared_planner(), _parameters->GetDOF(), _parameters->_distmetricfn, _parameters->_fStepLength, _parameters->_distmetricfn(_parameters->_vConfigLowerLimit, _parameters->_vConfigUpperLimit));
+        _SetupNearestNeighbor(_treeBackward, _parameters);
 
         //read in all goals
         if( (_parameters->vgoalconfig.size() % _parameters->GetDOF()) != 0 ) {
@@ -348,11 +680,30 @@ Some python code to display data::\n\
         if( _vgoalpaths.capacity() < _parameters->_minimumgoalpaths ) {
             _vgoalpaths.reserve(_parameters->_minimumgoalpaths);
         }
+        _setLazyValidatedNodes.clear();
+        _nLazyValidatedEdges = 0;
+        _nLazyInvalidatedEdges = 0;
+        if( _parameters->_nLazyCollisionChecking > 0 ) {
+            _treeForward.SetExtendCheckOptions(CFO_RecommendedOptions&~CFO_CheckEnvCollisions);
+            _treeBackward.SetExtendCheckOptions(CFO_RecommendedOptions&~CFO_CheckEnvCollisions);
+        }
+        if( !_InitRacingPlanners() ) {
+            _parameters.reset();
+            return false;
+        }
         RAVELOG_DEBUG_FORMAT("BiRRT Planner Initialized, initial=%d, goal=%d", _vecInitialNodes.size()%_treeBackward.GetNumNodes());
         return true;
     }
 
     virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj)
+    {
+        if( _vRacingPlanners.size() > 0 ) {
+            return _PlanPathRacing(ptraj);
+        }
+        return _PlanPath(ptraj);
+    }
+
+    virtual PlannerStatus _PlanPath(TrajectoryBasePtr ptraj)
     {
         _goalindex = -1;
         _startindex = -1;
@@ -446,6 +797,17 @@ Some python code to display data::\n\
 
             et = TreeB->Extend(TreeA->GetVectorConfig(iConnectedA), iConnectedB);     // extend B toward A
 
+            if( et == ET_Connected && _parameters->_nLazyCollisionChecking > 0 && !_ValidateLazyPath(TreeA == &_treeForward ? iConnectedA : iConnectedB, TreeA == &_treeBackward ? iConnectedA : iConnectedB) ) {
+                // the nodes behind the invalid edge were removed from the trees, so keep growing them
+                et = ET_Failed;
+                if( _nLazyInvalidatedEdges == _parameters->_nLazyCollisionChecking ) {
+                    // too cluttered for lazy checking, the trees would keep growing into the obstacles
+                    RAVELOG_DEBUG_FORMAT("env=%d, %d lazy paths failed, checking all constraints when extending", GetEnv()->GetId()%_nLazyInvalidatedEdges);
+                    _treeForward.SetExtendCheckOptions(CFO_RecommendedOptions);
+                    _treeBackward.SetExtendCheckOptions(CFO_RecommendedOptions);
+                }
+            }
+
             if( et == ET_Connected ) {
                 // connected, process goal
                 _vgoalpaths.push_back(GOALPATH());
@@ -611,6 +973,46 @@ Some python code to display data::\n\
         }
     }
 
+    /// \brief fully checks the edges of the path between the roots of the trees that were only checked without environment collisions
+    ///
+    /// \return true if the path is valid, otherwise the nodes behind the first invalid edge are removed from the nearest neighbor search of their tree
+    virtual bool _ValidateLazyPath(NodeBase* iConnectedForward, NodeBase* iConnectedBackward)
+    {
+        return _ValidateLazyBranch(_treeForward, (SimpleNode*)iConnectedForward, false) && _ValidateLazyBranch(_treeBackward, (SimpleNode*)iConnectedBackward, true);
+    }
+
+    bool _ValidateLazyBranch(SpatialTreeBase& tree, SimpleNode* pnode, bool bFromGoal)
+    {
+        const int dof = _parameters->GetDOF();
+        // gather the unchecked edges, the roots were fully checked when inserted
+        _vLazyBranch.resize(0);
+        while(!!pnode->rrtparent && _setLazyValidatedNodes.find(pnode) == _setLazyValidatedNodes.end()) {
+            _vLazyBranch.push_back(pnode);
+            pnode = pnode->rrtparent;
+        }
+        std::vector<dReal> vparent(dof), vchild(dof);
+        // check starting from the root so that the biggest invalid subtree is removed
+        for(std::vector<SimpleNode*>::reverse_iterator itnode = _vLazyBranch.rbegin(); itnode != _vLazyBranch.rend(); ++itnode) {
+            std::copy((*itnode)->rrtparent->q, (*itnode)->rrtparent->q+dof, vparent.begin());
+            std::copy((*itnode)->q, (*itnode)->q+dof, vchild.begin());
+            int ret;
+            if( bFromGoal ) {
+                ret = _parameters->CheckPathAllConstraints(vchild, vparent, std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenEnd);
+            }
+            else {
+                ret = _parameters->CheckPathAllConstraints(vparent, vchild, std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenStart);
+            }
+            if( ret != 0 ) {
+                ++_nLazyInvalidatedEdges;
+                tree.InvalidateNodesWithParent(*itnode);
+                return false;
+            }
+            ++_nLazyValidatedEdges;
+            _setLazyValidatedNodes.insert(*itnode);
+        }
+        return true;
+    }
+
     virtual PlannerParametersConstPtr GetParameters() const {
         return _parameters;
     }
@@ -627,13 +1029,188 @@ Some python code to display data::\n\
         return true;
     }
 
+    virtual bool GetStatisticsCommand(std::ostream& os, std::istream& is)
+    {
+        _WriteTreeStatistics(os, "forward", _treeForward);
+        _WriteTreeStatistics(os, "backward", _treeBackward);
+        if( !!_parameters && _parameters->_nLazyCollisionChecking > 0 ) {
+            os << "lazy numvalidated " << _nLazyValidatedEdges << " numinvalidated " << _nLazyInvalidatedEdges << std::endl;
+        }
+        return !!os;
+    }
+
 protected:
+    /// \brief shared between the racing planners, interrupts all of them once one has a solution
+    class RacingData
+    {
+public:
+        RacingData() : _winner(-1), _bStop(false) {
+        }
+
+        PlannerAction PlanCallback(const PlannerProgress& progress) {
+            boost::mutex::scoped_lock lock(_mutex);
+            return _bStop ? PA_Interrupt : PA_None;
+        }
+
+        /// \brief called by planner index when its PlanPath returns
+        void SetStatus(int index, PlannerStatus status) {
+            boost::mutex::scoped_lock lock(_mutex);
+            if( (status & PS_HasSolution) && _winner < 0 ) {
+                _winner = index;
+                _bStop = true;
+            }
+        }
+
+        int GetWinner() {
+            boost::mutex::scoped_lock lock(_mutex);
+            return _winner;
+        }
+
+        void Stop() {
+            boost::mutex::scoped_lock lock(_mutex);
+            _bStop = true;
+        }
+
+protected:
+        boost::mutex _mutex;
+        int _winner; ///< the index of the first planner with a solution, 0 is this planner
+        bool _bStop; ///< if true, all planners should be interrupted
+    };
+
+    /// \brief sets up _parameters->_nNumThreads-1 planners on environment snapshots that race this planner in PlanPath
+    ///
+    /// The snapshots are kept between calls so that only the bodies that changed need to be copied. The parameters of the racing planners
+    /// are rebuilt from the configuration specification, so custom constraint functions of the original parameters are not used by them.
+    bool _InitRacingPlanners()
+    {
+        _vRacingPlanners.resize(0);
+        _vRacingParameters.resize(0);
+        int numracing = _parameters->_nNumThreads-1;
+        if( numracing <= 0 ) {
+            _vRacingEnvs.resize(0);
+            return true;
+        }
+        _vRacingEnvs.resize(numracing);
+        for(int iracing = 0; iracing < numracing; ++iracing) {
+            if( !_vRacingEnvs[iracing] ) {
+                _vRacingEnvs[iracing] = GetEnv()->CloneSelf(Clone_Bodies);
+            }
+            else {
+                _vRacingEnvs[iracing]->Clone(GetEnv(), Clone_Bodies|Clone_SkipUnchangedBodies);
+            }
+            EnvironmentMutex::scoped_lock lockracing(_vRacingEnvs[iracing]->GetMutex());
+            RobotBasePtr pracingrobot = _vRacingEnvs[iracing]->GetRobot(_robot->GetName());
+            if( !pracingrobot ) {
+                RAVELOG_WARN_FORMAT("failed to find robot %s in the environment snapshot", _robot->GetName());
+                return false;
+            }
+            RRTParametersPtr params(new RRTParameters());
+            params->copy(_parameters);
+            params->SetConfigurationSpecification(_vRacingEnvs[iracing], _parameters->_configurationspecification);
+            params->vinitialconfig = _parameters->vinitialconfig; // SetConfigurationSpecification resets it to the state of the snapshot
+            params->_nNumThreads = 1;
+            params->_nRandomGeneratorSeed = _parameters->_nRandomGeneratorSeed + iracing + 1;
+            boost::shared_ptr<BirrtPlanner> pracingplanner = boost::dynamic_pointer_cast<BirrtPlanner>(RaveCreatePlanner(_vRacingEnvs[iracing], GetXMLId()));
+            if( !pracingplanner ) {
+                RAVELOG_WARN_FORMAT("failed to create racing planner %s", GetXMLId());
+                return false;
+            }
+            pracingplanner->_vNearestNeighborWeights = _vNearestNeighborWeights;
+            pracingplanner->_bNearestNeighborRobotWeights = _bNearestNeighborRobotWeights;
+            pracingplanner->_nNearestNeighborThreads = 1;
+            if( !pracingplanner->InitPlan(pracingrobot, params) ) {
+                RAVELOG_WARN_FORMAT("racing planner %d failed to initialize", iracing);
+                return false;
+            }
+            _vRacingPlanners.push_back(pracingplanner);
+            _vRacingParameters.push_back(params); // the constraint functions of params only hold weak references to it
+        }
+        return true;
+    }
+
+    static void _RacingPlanThread(boost::shared_ptr<RacingData> racingdata, PlannerBasePtr planner, TrajectoryBasePtr ptraj, int index)
+    {
+        PlannerStatus status = PS_Failed;
+        try {
+            status = planner->PlanPath(ptraj);
+        }
+        catch(const std::exception& ex) {
+            RAVELOG_WARN_FORMAT("racing planner %d failed: %s", index%ex.what());
+        }
+        racingdata->SetStatus(index, status);
+    }
+
+    /// \brief runs this planner and the racing planners at the same time and returns the first solution found
+    PlannerStatus _PlanPathRacing(TrajectoryBasePtr ptraj)
+    {
+        uint32_t basetime = utils::GetMilliTime();
+        boost::shared_ptr<RacingData> racingdata(new RacingData());
+        std::list<UserDataPtr> listhandles;
+        listhandles.push_back(RegisterPlanCallback(boost::bind(&RacingData::PlanCallback, racingdata, _1)));
+        std::vector<TrajectoryBasePtr> vracingtrajs(_vRacingPlanners.size());
+        std::vector< boost::shared_ptr<boost::thread> > vthreads;
+        for(size_t iracing = 0; iracing < _vRacingPlanners.size(); ++iracing) {
+            vracingtrajs[iracing] = RaveCreateTrajectory(_vRacingPlanners[iracing]->GetEnv(), ptraj->GetXMLId());
+            listhandles.push_back(_vRacingPlanners[iracing]->RegisterPlanCallback(boost::bind(&RacingData::PlanCallback, racingdata, _1)));
+            vthreads.push_back(boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&BirrtPlanner::_RacingPlanThread, racingdata, _vRacingPlanners[iracing], vracingtrajs[iracing], iracing+1))));
+        }
+
+        PlannerStatus status = PS_Failed;
+        try {
+            status = _PlanPath(ptraj);
+        }
+        catch(...) {
+            racingdata->Stop();
+            FOREACH(itthread, vthreads) {
+                (*itthread)->join();
+            }
+            throw;
+        }
+        racingdata->SetStatus(0, status);
+        if( status == PS_Interrupted && racingdata->GetWinner() < 0 ) {
+            // interrupted by the user
+            racingdata->Stop();
+        }
+        FOREACH(itthread, vthreads) {
+            (*itthread)->join();
+        }
+        listhandles.clear();
+
+        int winner = racingdata->GetWinner();
+        if( winner <= 0 ) {
+            // either this planner found the solution or no one did
+            return winner == 0 || status == PS_Interrupted ? status : PS_Failed;
+        }
+
+        TrajectoryBasePtr pracingtraj = vracingtrajs.at(winner-1);
+        std::vector<dReal> vdata;
+        pracingtraj->GetWaypoints(0, pracingtraj->GetNumWaypoints(), vdata);
+        // this planner might have inserted a partial path before being interrupted, so start over
+        ptraj->Init(pracingtraj->GetConfigurationSpecification());
+        ptraj->Insert(0, vdata);
+        std::stringstream sout, sinput("GetInitGoalIndices");
+        if( _vRacingPlanners.at(winner-1)->SendCommand(sout, sinput) ) {
+            sout >> _startindex >> _goalindex;
+        }
+        RAVELOG_DEBUG_FORMAT("env=%d, racing planner %d found the solution first, computation time=%fs", GetEnv()->GetId()%winner%(0.001f*(float)(utils::GetMilliTime()-basetime)));
+        return PS_HasSolution;
+    }
+
     RRTParametersPtr _parameters;
     SpatialTree< SimpleNode > _treeBackward;
     dReal _fGoalBiasProb;
     std::vector< NodeBase* > _vecGoalNodes;
     size_t _nValidGoals; ///< num valid goals
     std::vector<GOALPATH> _vgoalpaths;
+
+    // lazy collision checking, see RRTParameters::_nLazyCollisionChecking
+    std::set<NodeBase*> _setLazyValidatedNodes; ///< nodes whose edge to their rrt parent passed all constraints
+    std::vector<SimpleNode*> _vLazyBranch; ///< cache
+    int _nLazyValidatedEdges, _nLazyInvalidatedEdges;
+
+    std::vector<EnvironmentBasePtr> _vRacingEnvs; ///< environment snapshots of the racing planners, see RRTParameters::_nNumThreads
+    std::vector< boost::shared_ptr<BirrtPlanner> > _vRacingPlanners; ///< initialized planners racing this planner
+    std::vector<RRTParametersPtr> _vRacingParameters; ///< the parameters _vRacingPlanners were initialized with
 };
 
 class BasicRrtPlanner : public RrtPlanner<SimpleNode>
@@ -644,6 +1221,9 @@ public:
         __description = "Rosen's Basic RRT planner";
         _fGoalBiasProb = dReal(0.05);
         _bOneStep = false;
+        _bestGoalNode = NULL;
+        _fBestGoalNodeDist = 0;
+        _numFoundGoals = 0;
         RegisterCommand("DumpTree", boost::bind(&BasicRrtPlanner::_DumpTreeCommand,this,_1,_2),
                         "dumps the source and goal trees to $OPENRAVE_HOME/basicrrtdump.txt. The first N values are the DOF values, the last value is the parent index.\n");
     }
@@ -666,6 +1246,7 @@ public:
         int goal_index = 0;
         vector<dReal> vgoal(_parameters->GetDOF());
         _vecGoals.resize(0);
+        _vGoalConfigs.resize(0);
         while(_parameters->vgoalconfig.size() > 0) {
             for(int i = 0; i < _parameters->GetDOF(); i++) {
                 if(goal_index < (int)_parameters->vgoalconfig.size())
@@ -680,6 +1261,7 @@ public:
 
             if( GetParameters()->CheckPathAllConstraints(vgoal,vgoal, std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenStart) == 0 ) {
                 _vecGoals.push_back(vgoal);
+                _vGoalConfigs.insert(_vGoalConfigs.end(), vgoal.begin(), vgoal.end());
             }
             else {
                 RAVELOG_WARN("goal in collision\n");
@@ -712,25 +1294,27 @@ public:
         uint32_t basetime = utils::GetMilliTime();
 
         NodeBasePtr lastnode; // the last node visited by the RRT
-        NodeBase* bestGoalNode = NULL; // the best goal node found already by the RRT. If this is not NULL, then RRT succeeded
-        dReal fBestGoalNodeDist = 0; // configuration distance from initial position to the goal node
+        _bestGoalNode = NULL;
+        _fBestGoalNodeDist = 0;
+        _numFoundGoals = 0;
 
         // the main planning loop
         PlannerParameters::StateSaver savestate(_parameters);
         CollisionOptionsStateSaver optionstate(GetEnv()->GetCollisionChecker(),GetEnv()->GetCollisionChecker()->GetCollisionOptions()|CO_ActiveDOFs,false);
 
-        std::vector<dReal> vtempinitialconfig;
+        if( !_InitExtendSnapshots(_parameters, _parameters->_nNumThreads) ) {
+            return PS_Failed;
+        }
+
         PlannerAction callbackaction = PA_None;
         PlannerProgress progress;
         int iter = 0;
         _goalindex = -1; // index into vgoalconfig if the goal is found
         _startindex = -1;
 
-        int numfoundgoals = 0;
-        
         while(iter < _parameters->_nMaxIterations) {
             iter++;
-            if( !!bestGoalNode && iter >= _parameters->_nMinIterations ) {
+            if( !!_bestGoalNode && iter >= _parameters->_nMinIterations ) {
                 break;
             }
             if( !!_parameters->_samplegoalfn ) {
@@ -738,6 +1322,7 @@ public:
                 if( _parameters->_samplegoalfn(vgoal) ) {
                     RAVELOG_VERBOSE("found goal\n");
                     _vecGoals.push_back(vgoal);
+                    _vGoalConfigs.insert(_vGoalConfigs.end(), vgoal.begin(), vgoal.end());
                 }
             }
             if( !!_parameters->_sampleinitialfn ) {
@@ -748,80 +1333,49 @@ public:
                 }
             }
 
-            if( (iter == 1 || RaveRandomFloat() < _fGoalBiasProb ) && _vecGoals.size() > 0 ) {
-                _sampleConfig = _vecGoals[RaveRandomInt()%_vecGoals.size()];
-            }
-            else if( !_parameters->_samplefn(_sampleConfig) ) {
-                continue;
-            }
-
-            // extend A
-            ExtendType et = _treeForward.Extend(_sampleConfig, lastnode, _bOneStep);
-
-            if( et == ET_Connected ) {
-                FOREACH(itgoal, _vecGoals) {
-                    if( _parameters->_distmetricfn(*itgoal, _treeForward.GetVectorConfig(lastnode)) < 2*_parameters->_fStepLength ) {
-                        SimpleNode* pforward = (SimpleNode*)lastnode;
-                        while(1) {
-                            if(!pforward->rrtparent) {
-                                break;
-                            }
-                            pforward = pforward->rrtparent;
-                        }
-                        vtempinitialconfig = _treeForward.GetVectorConfig(pforward); // GetVectorConfig returns the same reference, so need to make a copy
-                        dReal fGoalNodeDist = _parameters->_distmetricfn(vtempinitialconfig, _treeForward.GetVectorConfig(lastnode));
-                        if( !bestGoalNode || fBestGoalNodeDist > fGoalNodeDist ) {
-                            bestGoalNode = lastnode;
-                            fBestGoalNodeDist = fGoalNodeDist;
-                            _goalindex = (int)(itgoal-_vecGoals.begin());
-                        }
-                        if( iter >= _parameters->_nMinIterations ) {
-                            RAVELOG_DEBUG_FORMAT("env=%d, found goal index: %d", GetEnv()->GetId()%_goalindex);
-                            break;
-                        }
+            _vExtendResults.resize(0);
+            if( _vExtendParameters.size() > 0 ) {
+                // extend towards one sample per snapshot, every extension counts as an iteration
+                size_t numjobs = 0;
+                for(size_t ijob = 0; ijob < _vExtendParameters.size(); ++ijob) {
+                    if( !_SampleTarget(iter == 1 && ijob == 0) ) {
+                        continue;
                     }
+                    ExtendJob& job = _vExtendJobs[numjobs++];
+                    job.vtarget = _sampleConfig;
+                    job.bDirect = false;
+                    job.bOneStep = _bOneStep;
+                }
+                _ExtendBatch(_treeForward, numjobs, _vExtendResults);
+                if( numjobs > 1 ) {
+                    iter += numjobs-1;
                 }
             }
+            else {
+                if( !_SampleTarget(iter == 1) ) {
+                    continue;
+                }
+                // extend A
+                ExtendType et = _treeForward.Extend(_sampleConfig, lastnode, _bOneStep);
+                _vExtendResults.push_back(std::make_pair(et, lastnode));
+            }
 
-            // check the goal heuristic more often
-            if(( et != ET_Failed) && !!_parameters->_goalfn ) {
-                // have to check all the newly created nodes since anyone could be already in the goal (do not have to do this with _vecGoals since that is being sampled)
-                bool bfound = false;
-                SimpleNode* ptestnode = (SimpleNode*)lastnode;
-                while(!!ptestnode && ptestnode->_userdata==0) { // when userdata is 0, then it hasn't been checked for goal yet
-                    if( _parameters->_goalfn(_treeForward.GetVectorConfig(ptestnode)) <= 1e-4f ) {
-                        bfound = true;
-                        numfoundgoals++;
-                        ptestnode->_userdata = 1;
-                        SimpleNode* pforward = ptestnode;
-                        while(1) {
-                            if(!pforward->rrtparent) {
-                                break;
-                            }
-                            pforward = pforward->rrtparent;
-                        }
-                        vtempinitialconfig = _treeForward.GetVectorConfig(pforward); // GetVectorConfig returns the same reference, so need to make a copy
-                        dReal fGoalNodeDist = _parameters->_distmetricfn(vtempinitialconfig, _treeForward.GetVectorConfig(ptestnode));
-                        if( !bestGoalNode || fBestGoalNodeDist > fGoalNodeDist ) {
-                            bestGoalNode = ptestnode;
-                            fBestGoalNodeDist = fGoalNodeDist;
-                            _goalindex = -1;
-                            RAVELOG_DEBUG_FORMAT("env=%d, found node at goal at dist=%f at %d iterations, computation time=%fs", GetEnv()->GetId()%fBestGoalNodeDist%iter%(0.001f*(float)(utils::GetMilliTime()-basetime)));
-                        }
-                    }
-
-                    ptestnode->_userdata = 1;
-                    ptestnode = ptestnode->rrtparent;
+            bool bstop = false;
+            FOREACH(itresult, _vExtendResults) {
+                if( itresult->first == ET_Connected ) {
+                    _CheckGoalConfigs(itresult->second, iter);
                 }
-                if( bfound ) {
-                    if( iter >= _parameters->_nMinIterations ) {
-                        // check how many times we've got a goal?
-                        if( numfoundgoals >= _parameters->_minimumgoalpaths ) {
-                            break;
-                        }
+                // check the goal heuristic more often
+                if(( itresult->first != ET_Failed) && !!_parameters->_goalfn ) {
+                    if( _CheckGoalFn(itresult->second, iter, basetime) ) {
+                        bstop = true;
+                        break;
                     }
                 }
             }
+            if( bstop ) {
+                break;
+            }
 
             // check if reached any goals
             if( iter > _parameters->_nMaxIterations ) {
@@ -829,10 +1383,10 @@ public:
                 break;
             }
 
-            if( !!bestGoalNode && _parameters->_nMaxPlanningTime > 0 ) {
+            if( !!_bestGoalNode && _parameters->_nMaxPlanningTime > 0 ) {
                 uint32_t elapsedtime = utils::GetMilliTime()-basetime;
                 if( elapsedtime >= _parameters->_nMaxPlanningTime ) {
-                    RAVELOG_VERBOSE_FORMAT("time exceeded (%d) so breaking with bestdist=%f", elapsedtime%fBestGoalNodeDist);
+                    RAVELOG_VERBOSE_FORMAT("time exceeded (%d) so breaking with bestdist=%f", elapsedtime%_fBestGoalNodeDist);
                     break;
                 }
             }
@@ -843,13 +1397,13 @@ public:
                 return PS_Interrupted;
             }
             else if( callbackaction == PA_ReturnWithAnySolution ) {
-                if( !!bestGoalNode ) {
+                if( !!_bestGoalNode ) {
                     break;
                 }
             }
         }
 
-        if( !bestGoalNode ) {
+        if( !_bestGoalNode ) {
             RAVELOG_DEBUG_FORMAT("plan failed, %fs",(0.001f*(float)(utils::GetMilliTime()-basetime)));
             return PS_Failed;
         }
@@ -858,7 +1412,7 @@ public:
         _cachedpath.resize(0);
 
         // add nodes from the forward tree
-        SimpleNode* pforward = (SimpleNode*)bestGoalNode;
+        SimpleNode* pforward = (SimpleNode*)_bestGoalNode;
         while(1) {
             _cachedpath.insert(_cachedpath.begin(), pforward->q, pforward->q+dof);
             if(!pforward->rrtparent) {
@@ -894,11 +1448,90 @@ public:
         return true;
     }
 protected:
+    /// \brief sets _sampleConfig to one of the goals with probability _fGoalBiasProb or if bforcegoal is true, otherwise samples it
+    bool _SampleTarget(bool bforcegoal)
+    {
+        if( (bforcegoal || RaveRandomFloat() < _fGoalBiasProb ) && _vecGoals.size() > 0 ) {
+            _sampleConfig = _vecGoals[RaveRandomInt()%_vecGoals.size()];
+            return true;
+        }
+        return _parameters->_samplefn(_sampleConfig);
+    }
+
+    /// \brief returns the distance from the root of the tree of pnode to pnode
+    dReal _ComputeRootDistance(SimpleNode* pnode)
+    {
+        SimpleNode* pforward = pnode;
+        while(!!pforward->rrtparent) {
+            pforward = pforward->rrtparent;
+        }
+        _treeForward.GetVectorConfig(pforward, _vTempInitialConfig);
+        _treeForward.GetVectorConfig(pnode, _vTempNodeConfig);
+        return _parameters->_distmetricfn(_vTempInitialConfig, _vTempNodeConfig);
+    }
+
+    /// \brief updates _bestGoalNode if plastnode is close to one of _vecGoals, the distances to all the goals are computed in one call with the nearest neighbor kernel
+    void _CheckGoalConfigs(NodeBase* plastnode, int iter)
+    {
+        if( _vecGoals.size() == 0 ) {
+            return;
+        }
+        _treeForward.GetVectorConfig(plastnode, _vLastConfig);
+        _treeForward.ComputeDistances(_vLastConfig, _vGoalConfigs, _vGoalDistances);
+        for(size_t igoal = 0; igoal < _vGoalDistances.size(); ++igoal) {
+            if( _vGoalDistances[igoal] < 2*_parameters->_fStepLength ) {
+                dReal fGoalNodeDist = _ComputeRootDistance((SimpleNode*)plastnode);
+                if( !_bestGoalNode || _fBestGoalNodeDist > fGoalNodeDist ) {
+                    _bestGoalNode = plastnode;
+                    _fBestGoalNodeDist = fGoalNodeDist;
+                    _goalindex = (int)igoal;
+                }
+                if( iter >= _parameters->_nMinIterations ) {
+                    RAVELOG_DEBUG_FORMAT("env=%d, found goal index: %d", GetEnv()->GetId()%_goalindex);
+                    break;
+                }
+            }
+        }
+    }
+
+    /// \brief checks _goalfn on all the nodes from plastnode to the root that were not checked yet, returns true if enough goals were found to stop planning
+    bool _CheckGoalFn(NodeBase* plastnode, int iter, uint32_t basetime)
+    {
+        // have to check all the newly created nodes since anyone could be already in the goal (do not have to do this with _vecGoals since that is being sampled)
+        bool bfound = false;
+        SimpleNode* ptestnode = (SimpleNode*)plastnode;
+        while(!!ptestnode && ptestnode->_userdata==0) { // when userdata is 0, then it hasn't been checked for goal yet
+            if( _parameters->_goalfn(_treeForward.GetVectorConfig(ptestnode)) <= 1e-4f ) {
+                bfound = true;
+                _numFoundGoals++;
+                ptestnode->_userdata = 1;
+                dReal fGoalNodeDist = _ComputeRootDistance(ptestnode);
+                if( !_bestGoalNode || _fBestGoalNodeDist > fGoalNodeDist ) {
+                    _bestGoalNode = ptestnode;
+                    _fBestGoalNodeDist = fGoalNodeDist;
+                    _goalindex = -1;
+                    RAVELOG_DEBUG_FORMAT("env=%d, found node at goal at dist=%f at %d iterations, computation time=%fs", GetEnv()->GetId()%_fBestGoalNodeDist%iter%(0.001f*(float)(utils::GetMilliTime()-basetime)));
+                }
+            }
+
+            ptestnode->_userdata = 1;
+            ptestnode = ptestnode->rrtparent;
+        }
+        // check how many times we've got a goal?
+        return bfound && iter >= _parameters->_nMinIterations && _numFoundGoals >= (int)_parameters->_minimumgoalpaths;
+    }
+
     boost::shared_ptr<BasicRRTParameters> _parameters;
     dReal _fGoalBiasProb;
     bool _bOneStep;
     std::vector< std::vector<dReal> > _vecGoals;
+    std::vector<dReal> _vGoalConfigs; ///< _vecGoals stored one after the other for SpatialTree::ComputeDistances
     int _nValidGoals; ///< num valid goals
+
+    NodeBase* _bestGoalNode; ///< the best goal node found already by the RRT. If this is not NULL, then RRT succeeded
+    dReal _fBestGoalNodeDist; ///< configuration distance from initial position to _bestGoalNode
+    int _numFoundGoals; ///< number of nodes that satisfied _goalfn
+    std::vector<dReal> _vGoalDistances, _vLastConfig, _vTempInitialConfig, _vTempNodeConfig; ///< cache
 };
 
 class ExplorationPlanner : public RrtPlanner<SimpleNode>
@@ -936,10 +1569,44 @@ public:
         PlannerParameters::StateSaver savestate(_parameters);
         CollisionOptionsStateSaver optionstate(GetEnv()->GetCollisionChecker(),GetEnv()->GetCollisionChecker()->GetCollisionOptions()|CO_ActiveDOFs,false);
 
+        if( !_InitExtendSnapshots(_parameters, _parameters->_nNumThreads) ) {
+            return PS_Failed;
+        }
+
         int iter = 0;
         while(iter < _parameters->_nMaxIterations && _treeForward.GetNumNodes() < _parameters->_nExpectedDataSize ) {
             ++iter;
 
+            if( _vExtendParameters.size() > 0 ) {
+                // one exploration or rrt extension per snapshot, every extension counts as an iteration
+                size_t numjobs = 0;
+                for(size_t ijob = 0; ijob < _vExtendParameters.size(); ++ijob) {
+                    ExtendJob& job = _vExtendJobs[numjobs];
+                    if( RaveRandomFloat() < _parameters->_fExploreProb ) {
+                        NodeBase* pnode = _treeForward.GetNodeFromIndex(RaveRandomInt()%_treeForward.GetNumNodes());
+                        if( !_parameters->_sampleneighfn(job.vtarget, _treeForward.GetVectorConfig(pnode), _parameters->_fStepLength) ) {
+                            continue;
+                        }
+                        job.pstartnode = pnode;
+                        job.bDirect = true;
+                    }
+                    else {
+                        if( !_parameters->_samplefn(job.vtarget) ) {
+                            continue;
+                        }
+                        job.bDirect = false;
+                    }
+                    job.bOneStep = true;
+                    ++numjobs;
+                }
+                _ExtendBatch(_treeForward, numjobs, _vExtendResults);
+                if( numjobs > 1 ) {
+                    iter += numjobs-1;
+                }
+                RAVELOG_DEBUG_FORMAT("size %d", _treeForward.GetNumNodes());
+                continue;
+            }
+
             if( RaveRandomFloat() < _parameters->_fExploreProb ) {
                 // explore
                 int inode = RaveRandomInt()%_treeForward.GetNumNodes();
@@ -18,6 +18,7 @@
 
 #include "openraveplugindefs.h"
 #include "manipconstraints.h"
+#include "parallelrangeworkers.h"
 
 #define _(msgid) OpenRAVE::RaveGetLocalizedTextForDomain("openrave_plugins_rplanners", msgid)
 
@@ -26,16 +27,26 @@ namespace rplanners {
 class TrajectoryRetimer : public PlannerBase
 {
 protected:
+    /// \brief the supported groups, selects the _ComputeMinimumTime*, _ComputeVelocities*, _Check* and _Write* functions called for a group
+    enum GroupType {
+        GT_JointValues=0, ///< joint_values
+        GT_Affine=1, ///< affine_transform, uses GroupInfo::affinedofs
+        GT_Ik=2, ///< ikparam_values, uses GroupInfo::iktype
+    };
+
     class GroupInfo
     {
 public:
-        GroupInfo(int degree, const ConfigurationSpecification::Group& gpos, const ConfigurationSpecification::Group &gvel) : degree(degree), gpos(gpos), gvel(gvel), orgposoffset(-1), orgveloffset(-1) {
+        GroupInfo(int degree, const ConfigurationSpecification::Group& gpos, const ConfigurationSpecification::Group &gvel) : degree(degree), gpos(gpos), gvel(gvel), orgposoffset(-1), orgveloffset(-1), grouptype(GT_JointValues), affinedofs(0), iktype(IKP_None) {
         }
         virtual ~GroupInfo() {
         }
         int degree;
         const ConfigurationSpecification::Group& gpos, &gvel;
         int orgposoffset, orgveloffset;
+        GroupType grouptype;
+        int affinedofs;
+        IkParameterizationType iktype;
         std::vector<dReal> _vConfigVelocityLimit, _vConfigAccelerationLimit, _vConfigLowerLimit, _vConfigUpperLimit;
         // optional
         std::vector<dReal> _vConfigJerkLimit;
@@ -47,7 +58,10 @@ public:
     TrajectoryRetimer(EnvironmentBasePtr penv, std::istream& sinput) : PlannerBase(penv)
     {
         __description = ":Interface Author: Rosen Diankov\nTrajectory re-timing without modifying any of the points. Overwrites the velocities and timestamps.";
-        _bmanipconstraints = false;        
+        RegisterCommand("SetNumThreads",boost::bind(&TrajectoryRetimer::SetNumThreadsCommand,this,_1,_2),
+                        "numthreads - computes the minimum times of the segments with numthreads threads when the retimer supports it and the segments do not depend on each other. Default is 1.");
+        _bmanipconstraints = false;
+        _nNumThreads = 1;
     }
 
     virtual bool InitPlan(RobotBasePtr pbase, PlannerParametersConstPtr params)
@@ -101,6 +115,25 @@ public:
         return _parameters;
     }
 
+    bool SetNumThreadsCommand(std::ostream& sout, std::istream& sinput)
+    {
+        int numthreads = 1;
+        sinput >> numthreads;
+        if( !sinput || numthreads < 1 ) {
+            return false;
+        }
+        _nNumThreads = numthreads;
+        if( _nNumThreads > 1 ) {
+            if( !_pworkers || _pworkers->GetNumThreads() != _nNumThreads ) {
+                _pworkers.reset(new ParallelRangeWorkers(_nNumThreads, "TrajectoryRetimer"));
+            }
+        }
+        else {
+            _pworkers.reset();
+        }
+        return true;
+    }
+
     virtual PlannerStatus PlanPath(TrajectoryBasePtr ptraj)
     {
         // TODO there's a lot of info that is being recomputed which could be cached depending on the configurationspace of the incoming trajectory
@@ -173,10 +206,6 @@ public:
             const string& posinterpolation = _parameters->_interpolation;
             if( _cachedoldspec != _parameters->_configurationspecification || posinterpolation != _cachedposinterpolation ) {
                 _listgroupinfo.clear();
-                _listmintimefns.clear();
-                _listvelocityfns.clear();
-                _listcheckvelocityfns.clear();
-                _listwritefns.clear();
                 _cachednewspec = newspec;
                 _cachedoldspec = _parameters->_configurationspecification;
                 _cachedposinterpolation = posinterpolation;
@@ -205,10 +234,14 @@ public:
                     std::vector<ConfigurationSpecification::Group>::const_iterator itaccelgroupc = _cachednewspec.FindTimeDerivativeGroup(*itvelgroup);
                     _listgroupinfo.push_back(CreateGroupInfo(degree, _cachednewspec, gpos, *itvelgroup));
                     _listgroupinfo.back()->orgposoffset = orgposoffset;
+                    _listgroupinfo.back()->grouptype = static_cast<GroupType>(igrouptype);
                     _listgroupinfo.back()->_vConfigVelocityLimit = std::vector<dReal>(_parameters->_vConfigVelocityLimit.begin()+itgroup->offset, _parameters->_vConfigVelocityLimit.begin()+itgroup->offset+itgroup->dof);
                     _listgroupinfo.back()->_vConfigAccelerationLimit = std::vector<dReal>(_parameters->_vConfigAccelerationLimit.begin()+itgroup->offset, _parameters->_vConfigAccelerationLimit.begin()+itgroup->offset+itgroup->dof);
                     _listgroupinfo.back()->_vConfigLowerLimit = std::vector<dReal>(_parameters->_vConfigLowerLimit.begin()+itgroup->offset, _parameters->_vConfigLowerLimit.begin()+itgroup->offset+itgroup->dof);
                     _listgroupinfo.back()->_vConfigUpperLimit = std::vector<dReal>(_parameters->_vConfigUpperLimit.begin()+itgroup->offset, _parameters->_vConfigUpperLimit.begin()+itgroup->offset+itgroup->dof);
+                    if( (int)_parameters->_vConfigJerkLimit.size() == _parameters->GetDOF() ) {
+                        _listgroupinfo.back()->_vConfigJerkLimit = std::vector<dReal>(_parameters->_vConfigJerkLimit.begin()+itgroup->offset, _parameters->_vConfigJerkLimit.begin()+itgroup->offset+itgroup->dof);
+                    }
 
                     itgroup = _cachedoldspec.FindCompatibleGroup(*itvelgroup);
                     if( itgroup != _cachedoldspec._vgroups.end() ) {
@@ -217,57 +250,14 @@ public:
                     }
 
                     stringstream ss(gpos.name.substr(supportedgroups[igrouptype].size()));
-                    string bodyname;
-                    int affinedofs=0;
-                    IkParameterizationType iktype=IKP_None;
-                    if( igrouptype == 1 ) {
-                        ss >> bodyname >> affinedofs;
+                    if( igrouptype == GT_Affine ) {
+                        string bodyname;
+                        ss >> bodyname >> _listgroupinfo.back()->affinedofs;
                     }
-                    else if( igrouptype == 2 ) {
+                    else if( igrouptype == GT_Ik ) {
                         int niktype=0;
                         ss >> niktype;
-                        iktype = static_cast<IkParameterizationType>(niktype);
-                    }
-
-                    {
-                        // if _parameters->_hastimestamps, then use this for double checking that times are feasible
-                        if( igrouptype == 0 ) {
-                            _listmintimefns.push_back(boost::bind(&TrajectoryRetimer::_ComputeMinimumTimeJointValues,this,_listgroupinfo.back(),_1,_2,_3,_4));
-                        }
-                        else if( igrouptype == 1 ) {
-                            _listmintimefns.push_back(boost::bind(&TrajectoryRetimer::_ComputeMinimumTimeAffine,this,_listgroupinfo.back(),affinedofs,_1,_2,_3,_4));
-                        }
-                        else if( igrouptype == 2 ) {
-                            _listmintimefns.push_back(boost::bind(&TrajectoryRetimer::_ComputeMinimumTimeIk,this,_listgroupinfo.back(),iktype,_1,_2,_3,_4));
-                        }
-                    }
-
-                    if( igrouptype == 0 ) {
-                        if( _parameters->_hasvelocities ) {
-                            _listcheckvelocityfns.push_back(boost::bind(&TrajectoryRetimer::_CheckJointValues,this,_listgroupinfo.back(),_1,_2,_3));
-                        }
-                        else {
-                            _listvelocityfns.push_back(boost::bind(&TrajectoryRetimer::_ComputeVelocitiesJointValues,this,_listgroupinfo.back(),_1,_2,_3));
-                        }
-                        _listwritefns.push_back(boost::bind(&TrajectoryRetimer::_WriteJointValues,this,_listgroupinfo.back(),_1,_2,_3));
-                    }
-                    else if( igrouptype == 1 ) {
-                        if( _parameters->_hasvelocities ) {
-                            _listcheckvelocityfns.push_back(boost::bind(&TrajectoryRetimer::_CheckAffine,this,_listgroupinfo.back(),affinedofs,_1,_2,_3));
-                        }
-                        else {
-                            _listvelocityfns.push_back(boost::bind(&TrajectoryRetimer::_ComputeVelocitiesAffine,this,_listgroupinfo.back(),affinedofs,_1,_2,_3));
-                        }
-                        _listwritefns.push_back(boost::bind(&TrajectoryRetimer::_WriteAffine,this,_listgroupinfo.back(),affinedofs,_1,_2,_3));
-                    }
-                    else if( igrouptype == 2 ) {
-                        if( _parameters->_hasvelocities ) {
-                            _listcheckvelocityfns.push_back(boost::bind(&TrajectoryRetimer::_CheckIk,this,_listgroupinfo.back(),iktype,_1,_2,_3));
-                        }
-                        else {
-                            _listvelocityfns.push_back(boost::bind(&TrajectoryRetimer::_ComputeVelocitiesIk,this,_listgroupinfo.back(),iktype,_1,_2,_3));
-                        }
-                        _listwritefns.push_back(boost::bind(&TrajectoryRetimer::_WriteIk,this,_listgroupinfo.back(),iktype,_1,_2,_3));
+                        _listgroupinfo.back()->iktype = static_cast<IkParameterizationType>(niktype);
                     }
 
                     gpos.interpolation = posinterpolation;
@@ -323,43 +313,49 @@ public:
                 ConfigurationSpecification::ConvertData(_vdata.begin(),_cachednewspec,_vtempdata0.begin(),velspec,numpoints,GetEnv(),false);
             }
             try {
+                // the minimum times of all the segments are computed up front when they do not depend on the velocities written by the previous segments
+                bool bprecomputedmintimes = false;
+                if( !(_parameters->_hastimestamps && _parameters->_hasvelocities) && !!_pworkers && numpoints > s_minParallelSegments && _IsMinimumTimeParallelizable() ) {
+                    _vsegmentmintimes.resize(numpoints-1);
+                    _pworkers->Run(numpoints-1, boost::bind(&TrajectoryRetimer::_ComputeSegmentMinimumTimes, this, _1, _2, numpoints));
+                    bprecomputedmintimes = true;
+                }
+
                 std::vector<dReal>::iterator itorgdiff = _vdiffdata.begin()+_cachedoldspec.GetDOF();
                 std::vector<dReal>::iterator itdataprev = itdata;
                 itdata += dof;
+                PlannerProgress progress;
                 for(size_t i = 1; i < numpoints; ++i, itdata += dof, itorgdiff += _cachedoldspec.GetDOF()) {
-                    dReal mintime = 0;
+                    if( (i % s_nCallbackPeriod) == 0 ) {
+                        progress._iteration = i;
+                        if( _CallCallbacks(progress) == PA_Interrupt ) {
+                            return PS_Interrupted;
+                        }
+                    }
                     bool bUseEndVelocity = i+1==numpoints;
                     if( _parameters->_hastimestamps && _parameters->_hasvelocities ) {
                         // positions, velocities, and timestamps already filled, so check everything
-                        FOREACH(itfn, _listcheckvelocityfns) {
-                            if( !(*itfn)(itdataprev, itdata, 7) ) {
+                        FOREACHC(itgroup, _listgroupinfo) {
+                            if( !_Check(*itgroup, itdataprev, itdata, 7) ) {
                                 RAVELOG_VERBOSE_FORMAT("point %d/%d has unreachable velocity", i%numpoints);
                                 if( IS_DEBUGLEVEL(Level_Verbose) ) {
-                                    (*itfn)(itdataprev, itdata, 7);
+                                    _Check(*itgroup, itdataprev, itdata, 7);
                                 }
                                 return PS_Failed;
                             }
                         }
                     }
                     else {
-                        FOREACH(itmin, _listmintimefns) {
-                            dReal fgrouptime = (*itmin)(itorgdiff, itdataprev, itdata,bUseEndVelocity);
-                            if( fgrouptime < 0 ) {
-                                RAVELOG_VERBOSE_FORMAT("point %d/%d has uncomputable minimum time, possibly due to boundary constraints", i%numpoints);
-                                return PS_Failed;
-                            }
-
-                            if( _parameters->_fStepLength > 0 ) {
-                                if( fgrouptime < _parameters->_fStepLength ) {
-                                    fgrouptime = _parameters->_fStepLength;
-                                }
-                                else {
-                                    fgrouptime = std::ceil(fgrouptime/_parameters->_fStepLength-g_fEpsilonJointLimit)*_parameters->_fStepLength;
-                                }
-                            }
-                            if( mintime < fgrouptime ) {
-                                mintime = fgrouptime;
-                            }
+                        dReal mintime;
+                        if( bprecomputedmintimes && !std::isnan(_vsegmentmintimes[i-1]) ) {
+                            mintime = _vsegmentmintimes[i-1];
+                        }
+                        else {
+                            mintime = _ComputeSegmentMinimumTime(itorgdiff, itdataprev, itdata, bUseEndVelocity);
+                        }
+                        if( mintime < 0 ) {
+                            RAVELOG_VERBOSE_FORMAT("point %d/%d has uncomputable minimum time, possibly due to boundary constraints", i%numpoints);
+                            return PS_Failed;
                         }
                         if( _parameters->_hastimestamps ) {
                             if( *(itdata+_timeoffset) < mintime-g_fEpsilonJointLimit ) {
@@ -372,8 +368,8 @@ public:
                             *(itdata+_timeoffset) = mintime;
                         }
                         if( _parameters->_hasvelocities ) {
-                            FOREACH(itfn,_listcheckvelocityfns) {
-                                if( !(*itfn)(itdataprev, itdata, 6) ) {
+                            FOREACHC(itgroup, _listgroupinfo) {
+                                if( !_Check(*itgroup, itdataprev, itdata, 6) ) {
                                     RAVELOG_WARN(str(boost::format("point %d/%d has unreachable velocity")%i%numpoints));
                                     return PS_Failed;
                                 }
@@ -381,14 +377,14 @@ public:
                         }
                         else {
                             // given the mintime, fill the velocities
-                            FOREACH(itfn,_listvelocityfns) {
-                                (*itfn)(itorgdiff, itdataprev, itdata);
+                            FOREACHC(itgroup, _listgroupinfo) {
+                                _ComputeVelocities(*itgroup, itorgdiff, itdataprev, itdata);
                             }
                         }
                     }
-                    FOREACH(itfn,_listwritefns) {
+                    FOREACHC(itgroup, _listgroupinfo) {
                         // because the initial time for each ramp could have been stretched to accomodate other points, it is possible for this to fail
-                        if( !(*itfn)(itorgdiff, itdataprev, itdata) ) {
+                        if( !_Write(*itgroup, itorgdiff, itdataprev, itdata) ) {
                             RAVELOG_VERBOSE_FORMAT("point %d/%d has unreachable new time %es, probably due to acceleration limtis violated.", i%numpoints%(*(itdata+_timeoffset)));
                             return PS_Failed;
                         }
@@ -430,6 +426,14 @@ protected:
     }
 
     virtual bool _SupportInterpolation() = 0;
+
+    /// \brief returns true if the _ComputeMinimumTime* functions of all the groups in _listgroupinfo can be called concurrently on different segments
+    ///
+    /// Requires that the functions do not touch the environment or shared buffers, and that the velocities they read at the segment
+    /// endpoints are already in _vdata before the velocities of the previous segments are computed.
+    virtual bool _IsMinimumTimeParallelizable() {
+        return false;
+    }
     
     /// \brief compute the minimum time to achieve the point. returns a mintime>=0 if successeeded, otherwise returns value < 0.
     virtual dReal _ComputeMinimumTimeJointValues(GroupInfoConstPtr info, std::vector<dReal>::const_iterator itorgdiff, std::vector<dReal>::const_iterator itdataprev, std::vector<dReal>::const_iterator itdata, bool bUseEndVelocity) = 0;
@@ -469,23 +473,96 @@ protected:
         ptraj->Insert(0,data);
     }
 
+    // dispatch on GroupInfo::grouptype
+    inline dReal _ComputeMinimumTime(const GroupInfoPtr& info, std::vector<dReal>::const_iterator itorgdiff, std::vector<dReal>::const_iterator itdataprev, std::vector<dReal>::const_iterator itdata, bool bUseEndVelocity) {
+        switch(info->grouptype) {
+        case GT_Affine: return _ComputeMinimumTimeAffine(info, info->affinedofs, itorgdiff, itdataprev, itdata, bUseEndVelocity);
+        case GT_Ik: return _ComputeMinimumTimeIk(info, info->iktype, itorgdiff, itdataprev, itdata, bUseEndVelocity);
+        default: return _ComputeMinimumTimeJointValues(info, itorgdiff, itdataprev, itdata, bUseEndVelocity);
+        }
+    }
+    inline void _ComputeVelocities(const GroupInfoPtr& info, std::vector<dReal>::const_iterator itorgdiff, std::vector<dReal>::const_iterator itdataprev, std::vector<dReal>::iterator itdata) {
+        switch(info->grouptype) {
+        case GT_Affine: _ComputeVelocitiesAffine(info, info->affinedofs, itorgdiff, itdataprev, itdata); break;
+        case GT_Ik: _ComputeVelocitiesIk(info, info->iktype, itorgdiff, itdataprev, itdata); break;
+        default: _ComputeVelocitiesJointValues(info, itorgdiff, itdataprev, itdata); break;
+        }
+    }
+    inline bool _Check(const GroupInfoPtr& info, std::vector<dReal>::const_iterator itdataprev, std::vector<dReal>::iterator itdata, int checkoptions) {
+        switch(info->grouptype) {
+        case GT_Affine: return _CheckAffine(info, info->affinedofs, itdataprev, itdata, checkoptions);
+        case GT_Ik: return _CheckIk(info, info->iktype, itdataprev, itdata, checkoptions);
+        default: return _CheckJointValues(info, itdataprev, itdata, checkoptions);
+        }
+    }
+    inline bool _Write(const GroupInfoPtr& info, std::vector<dReal>::const_iterator itorgdiff, std::vector<dReal>::const_iterator itdataprev, std::vector<dReal>::iterator itdata) {
+        switch(info->grouptype) {
+        case GT_Affine: return _WriteAffine(info, info->affinedofs, itorgdiff, itdataprev, itdata);
+        case GT_Ik: return _WriteIk(info, info->iktype, itorgdiff, itdataprev, itdata);
+        default: return _WriteJointValues(info, itorgdiff, itdataprev, itdata);
+        }
+    }
+
+    /// \brief the maximum of the minimum times of all the groups rounded up to the step length, returns a value < 0 if one group has no solution
+    dReal _ComputeSegmentMinimumTime(std::vector<dReal>::const_iterator itorgdiff, std::vector<dReal>::const_iterator itdataprev, std::vector<dReal>::const_iterator itdata, bool bUseEndVelocity)
+    {
+        dReal mintime = 0;
+        FOREACHC(itgroup, _listgroupinfo) {
+            dReal fgrouptime = _ComputeMinimumTime(*itgroup, itorgdiff, itdataprev, itdata, bUseEndVelocity);
+            if( fgrouptime < 0 ) {
+                return fgrouptime;
+            }
+
+            if( _parameters->_fStepLength > 0 ) {
+                if( fgrouptime < _parameters->_fStepLength ) {
+                    fgrouptime = _parameters->_fStepLength;
+                }
+                else {
+                    fgrouptime = std::ceil(fgrouptime/_parameters->_fStepLength-g_fEpsilonJointLimit)*_parameters->_fStepLength;
+                }
+            }
+            if( mintime < fgrouptime ) {
+                mintime = fgrouptime;
+            }
+        }
+        return mintime;
+    }
+
+    /// \brief fills _vsegmentmintimes[istart:iend], segment i goes from point i to point i+1
+    void _ComputeSegmentMinimumTimes(size_t istart, size_t iend, size_t numpoints)
+    {
+        int dof = _cachednewspec.GetDOF(), orgdof = _cachedoldspec.GetDOF();
+        for(size_t i = istart; i < iend; ++i) {
+            std::vector<dReal>::const_iterator itdataprev = _vdata.begin()+i*dof;
+            try {
+                _vsegmentmintimes[i] = _ComputeSegmentMinimumTime(_vdiffdata.begin()+(i+1)*orgdof, itdataprev, itdataprev+dof, i+2==numpoints);
+            }
+            catch(const std::exception&) {
+                // recomputed by PlanPath so that the exception is handled there
+                _vsegmentmintimes[i] = std::numeric_limits<dReal>::quiet_NaN();
+            }
+        }
+    }
+
     ConstraintTrajectoryTimingParametersPtr _parameters;
     boost::shared_ptr<ManipConstraintChecker> _manipconstraintchecker;
     
     // caching
     ConfigurationSpecification _cachedoldspec, _cachednewspec; ///< the configuration specification that the cached structures have been set for
     std::string _cachedposinterpolation;
-    std::list< boost::function<dReal(std::vector<dReal>::const_iterator,std::vector<dReal>::const_iterator,std::vector<dReal>::const_iterator,bool) > > _listmintimefns;
-    std::list< boost::function<void(std::vector<dReal>::const_iterator,std::vector<dReal>::const_iterator,std::vector<dReal>::iterator) > > _listvelocityfns;
-    std::list< boost::function<bool(std::vector<dReal>::const_iterator,std::vector<dReal>::iterator, int) > > _listcheckvelocityfns;
-    std::list< boost::function<bool(std::vector<dReal>::const_iterator,std::vector<dReal>::const_iterator,std::vector<dReal>::iterator) > > _listwritefns;
     std::vector<dReal> _vimaxvel, _vimaxaccel;
     std::vector<dReal> _vdiffdata, _vdata;
     int _timeoffset;
     std::list<GroupInfoPtr> _listgroupinfo;
     vector<dReal> _vtempdata0, _vtempdata1;
+    std::vector<dReal> _vsegmentmintimes; ///< minimum time of each segment computed by _pworkers, nan if it has to be recomputed by PlanPath
 
     bool _bmanipconstraints; /// if true, check workspace manip constraints
+    int _nNumThreads; ///< set by the SetNumThreads command
+    ParallelRangeWorkersPtr _pworkers; ///< computes the minimum times of the segments, only set if _nNumThreads > 1
+
+    static const size_t s_minParallelSegments = 64; ///< shorter trajectories are not worth waking up the threads for
+    static const size_t s_nCallbackPeriod = 256; ///< number of segments retimed between calls to the planner callbacks, so that long trajectories can be interrupted
 };
 
 } // end namespace rplanners
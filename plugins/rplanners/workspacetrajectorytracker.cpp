@@ -40,8 +40,14 @@ Planner Parameters\n\
 - **TrajectoryBasePtr workspacetraj** - workspace trajectory of the end effector, needs to hold 'ikparam_values' groups\n\
 \n\
 ";
+        RegisterCommand("SetJacobianTracking",boost::bind(&WorkspaceTrajectoryTracker::SetJacobianTrackingCommand,this,_1,_2),
+                        "enable [errorthresh] - if enable is 1, every sample is first tracked from the previous solution with damped least squares steps that reuse the factorization of the last jacobian, and the ik solver is only called if the steps do not converge or the solution is rejected. errorthresh is the maximum translation+rotation error of a tracked solution, default is 1e-6.");
         _report.reset(new CollisionReport());
         _filteroptions = 0;
+        _bJacobianTracking = false;
+        _fTrackingErrorThresh2 = 1e-12;
+        _bHasTrackingFactorization = false;
+        _nNumTrackedSamples = _nNumTrackingFactorizations = 0;
     }
     virtual ~WorkspaceTrajectoryTracker() {
     }
@@ -220,6 +226,8 @@ Planner Parameters\n\
 
         _mjacobian.resize(boost::extents[0][0]);
         _vprevsolution.resize(0);
+        _bHasTrackingFactorization = false;
+        _nNumTrackedSamples = _nNumTrackingFactorizations = 0;
         _tbaseinv = _manip->GetBase()->GetTransform().inverse();
         if( (int)_parameters->vinitialconfig.size() == _parameters->GetDOF() ) {
             if( _parameters->SetStateValues(_parameters->vinitialconfig) != 0 ) {
@@ -242,7 +250,25 @@ Planner Parameters\n\
         for(; ittrans != listtransforms.end(); ftime += _parameters->_fStepLength, ++ittrans) {
             _filteroptions = (ftime >= fstarttime) ? IKFO_CheckEnvCollisions : 0;
             IkParameterization ikparam(*ittrans,IKP_Transform6D);
-            if( !_manip->FindIKSolution(ikparam,vsolution,_filteroptions) ) {
+            bool bTracked = false;
+            if( _bJacobianTracking && _vprevsolution.size() > 0 ) {
+                bTracked = _TrackWithJacobian(*ittrans, ikparam, vsolution);
+                if( bTracked ) {
+                    ++_nNumTrackedSamples;
+                }
+                else {
+                    // the ik filter needs the robot and the jacobians at the previous solution
+                    if( _parameters->SetStateValues(_vprevsolution) != 0 ) {
+                        RAVELOG_ERROR("failed to set state\n");
+                        return PS_Failed;
+                    }
+                    _SetPreviousSolution(_vprevsolution);
+                }
+            }
+            if( bTracked ) {
+                bPrevInCollision = false;
+            }
+            else if( !_manip->FindIKSolution(ikparam,vsolution,_filteroptions) ) {
                 if( _filteroptions == 0 ) {
                     // haven't even checked with environment collisions, so a solution really doesn't exist
                     return PS_Failed;
@@ -272,7 +298,8 @@ Planner Parameters\n\
                 RAVELOG_ERROR("failed to set state\n");
                 return PS_Failed;
             }
-            _SetPreviousSolution(vsolution);
+            // when tracking, the jacobians for the ik filter are only computed if the ik solver has to be called
+            _SetPreviousSolution(vsolution, !_bJacobianTracking);
         }
 
         if( bPrevInCollision ) {
@@ -283,7 +310,7 @@ Planner Parameters\n\
             return PS_Failed;
         }
 
-        RAVELOG_DEBUG(str(boost::format("workspace trajectory tracker plan success, path=%d points, traj time=%e computed in %fs\n")%poutputtraj->GetNumWaypoints()%poutputtraj->GetDuration()%((0.001f*(float)(utils::GetMilliTime()-basetime)))));
+        RAVELOG_DEBUG(str(boost::format("workspace trajectory tracker plan success, path=%d points, traj time=%e computed in %fs, tracked=%d, factorizations=%d\n")%poutputtraj->GetNumWaypoints()%poutputtraj->GetDuration()%((0.001f*(float)(utils::GetMilliTime()-basetime)))%_nNumTrackedSamples%_nNumTrackingFactorizations));
         return PS_HasSolution;
     }
 
@@ -292,6 +319,131 @@ Planner Parameters\n\
     }
 
 protected:
+    bool SetJacobianTrackingCommand(std::ostream& sout, std::istream& sinput)
+    {
+        int enable = 0;
+        sinput >> enable;
+        if( !sinput ) {
+            return false;
+        }
+        dReal errorthresh = 0;
+        sinput >> errorthresh;
+        if( !!sinput ) {
+            if( errorthresh <= 0 ) {
+                return false;
+            }
+            _fTrackingErrorThresh2 = errorthresh*errorthresh;
+        }
+        _bJacobianTracking = enable != 0;
+        return true;
+    }
+
+    /// \brief computes the cholesky factorization of J*J^T + damping of the 6xN jacobian [translation; angular velocity] at the current robot configuration
+    bool _FactorizeTrackingJacobian()
+    {
+        _manip->CalculateJacobian(_mtrackjacobian);
+        _manip->CalculateAngularVelocityJacobian(_mtrackangularjacobian);
+        const size_t dof = _mtrackjacobian.shape()[1];
+        _vtrackjacobian.resize(6*dof);
+        for(size_t j = 0; j < dof; ++j) {
+            for(int i = 0; i < 3; ++i) {
+                _vtrackjacobian[i*dof+j] = _mtrackjacobian[i][j];
+                _vtrackjacobian[(i+3)*dof+j] = _mtrackangularjacobian[i][j];
+            }
+        }
+        for(int i = 0; i < 6; ++i) {
+            for(int k = 0; k <= i; ++k) {
+                dReal f = i == k ? s_fTrackingDamping : dReal(0);
+                for(size_t j = 0; j < dof; ++j) {
+                    f += _vtrackjacobian[i*dof+j]*_vtrackjacobian[k*dof+j];
+                }
+                for(int m = 0; m < k; ++m) {
+                    f -= _vtrackfactor[i*6+m]*_vtrackfactor[k*6+m];
+                }
+                if( i == k ) {
+                    if( f <= 0 ) {
+                        return false;
+                    }
+                    _vtrackfactor[i*6+i] = RaveSqrt(f);
+                }
+                else {
+                    _vtrackfactor[i*6+k] = f/_vtrackfactor[k*6+k];
+                }
+            }
+        }
+        ++_nNumTrackingFactorizations;
+        return true;
+    }
+
+    /// \brief tries to reach ttarget from _vprevsolution with damped least squares steps, the robot has to be at _vprevsolution
+    ///
+    /// The factorization of the last jacobian is reused as long as the steps contract the error by at least half, so consecutive close samples of a workspace trajectory usually only need one forward kinematics evaluation each.
+    /// The solution goes through the same checks as the ik solutions.
+    bool _TrackWithJacobian(const Transform& ttarget, const IkParameterization& ikparam, std::vector<dReal>& vsolution)
+    {
+        const size_t dof = _vprevsolution.size();
+        vsolution = _vprevsolution;
+        dReal fpreverror2 = -1;
+        boost::array<dReal,6> verror;
+        bool bConverged = false;
+        for(int iter = 0; iter < s_nMaxTrackingIterations; ++iter) {
+            if( iter > 0 && _parameters->SetStateValues(vsolution) != 0 ) {
+                return false;
+            }
+            Transform tcur = _manip->GetTransform();
+            Vector qerror = quatMultiply(ttarget.rot, quatInverse(tcur.rot));
+            if( qerror.x < 0 ) {
+                qerror = -qerror;
+            }
+            Vector vtranserror = ttarget.trans - tcur.trans;
+            verror[0] = vtranserror.x; verror[1] = vtranserror.y; verror[2] = vtranserror.z;
+            verror[3] = 2*qerror.y; verror[4] = 2*qerror.z; verror[5] = 2*qerror.w;
+            dReal ferror2 = 0;
+            for(int i = 0; i < 6; ++i) {
+                ferror2 += verror[i]*verror[i];
+            }
+            if( ferror2 <= _fTrackingErrorThresh2 ) {
+                bConverged = true;
+                break;
+            }
+            if( !_bHasTrackingFactorization || (fpreverror2 >= 0 && ferror2 > 0.25*fpreverror2) ) {
+                _bHasTrackingFactorization = _FactorizeTrackingJacobian();
+                if( !_bHasTrackingFactorization ) {
+                    return false;
+                }
+            }
+            fpreverror2 = ferror2;
+
+            // solve (J*J^T + damping)*y = error with the cholesky factor, the step is J^T*y
+            for(int i = 0; i < 6; ++i) {
+                for(int k = 0; k < i; ++k) {
+                    verror[i] -= _vtrackfactor[i*6+k]*verror[k];
+                }
+                verror[i] /= _vtrackfactor[i*6+i];
+            }
+            for(int i = 5; i >= 0; --i) {
+                for(int k = i+1; k < 6; ++k) {
+                    verror[i] -= _vtrackfactor[k*6+i]*verror[k];
+                }
+                verror[i] /= _vtrackfactor[i*6+i];
+            }
+            for(size_t j = 0; j < dof; ++j) {
+                dReal fstep = 0;
+                for(int i = 0; i < 6; ++i) {
+                    fstep += _vtrackjacobian[i*dof+j]*verror[i];
+                }
+                vsolution[j] += fstep;
+                if( vsolution[j] < _parameters->_vConfigLowerLimit.at(j) || vsolution[j] > _parameters->_vConfigUpperLimit.at(j) ) {
+                    return false;
+                }
+            }
+        }
+        if( !bConverged ) {
+            return false;
+        }
+        return _ValidateSolution(vsolution, _manip, ikparam) == IKRA_Success;
+    }
+
     void _SetPreviousSolution(const std::vector<dReal>& vsolution, bool bsetjacobian=true)
     {
         if( bsetjacobian ) {
@@ -429,8 +581,22 @@ protected:
     IkParameterization _ikprev;
     vector<dReal> _vprevsolution;
     PlannerBasePtr _retimerplanner;
+
+    // jacobian tracking, see SetJacobianTrackingCommand
+    bool _bJacobianTracking;
+    dReal _fTrackingErrorThresh2;
+    bool _bHasTrackingFactorization; ///< if true, _vtrackjacobian and _vtrackfactor hold the jacobian and its factorization of a recent configuration
+    boost::multi_array<dReal,2> _mtrackjacobian, _mtrackangularjacobian;
+    std::vector<dReal> _vtrackjacobian; ///< 6xN row major
+    boost::array<dReal,36> _vtrackfactor; ///< lower triangular cholesky factor of J*J^T + s_fTrackingDamping, row major
+    int _nNumTrackedSamples, _nNumTrackingFactorizations;
+
+    static const int s_nMaxTrackingIterations = 6;
+    static const dReal s_fTrackingDamping;
 };
 
+const dReal WorkspaceTrajectoryTracker::s_fTrackingDamping = 1e-8;
+
 PlannerBasePtr CreateWorkspaceTrajectoryTracker(EnvironmentBasePtr penv, std::istream& sinput) {
     return PlannerBasePtr(new WorkspaceTrajectoryTracker(penv, sinput));
 }
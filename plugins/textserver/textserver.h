@@ -32,12 +32,15 @@
 #endif
 
 #include <sstream>
+#include <boost/thread/tss.hpp>
 
 #ifdef _WIN32
 #define CLOSESOCKET closesocket
 typedef int socklen_t;
 #else
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #define CLOSESOCKET close
 #endif
 
@@ -103,6 +106,7 @@ public:
 
         void SendData(const void* pdata, int size_to_write)
         {
+            boost::mutex::scoped_lock lock(_mutexSend);
             if( client_sockfd == 0 )
                 return;
 
@@ -170,6 +174,75 @@ public:
         }
 
 
+        /// \brief sends a binary protocol response: length, requestid and status in network byte order followed by the data
+        ///
+        /// Can be called from any thread.
+        void SendFrame(uint32_t requestid, uint8_t status, const string& data)
+        {
+            boost::mutex::scoped_lock lock(_mutexSend);
+            if( client_sockfd == 0 ) {
+                return;
+            }
+            string frame(9+data.size(), '\0');
+            uint32_t length = htonl(5+data.size());
+            requestid = htonl(requestid);
+            memcpy(&frame[0], &length, 4);
+            memcpy(&frame[4], &requestid, 4);
+            frame[8] = status;
+            if( data.size() > 0 ) {
+                memcpy(&frame[9], data.c_str(), data.size());
+            }
+            const char* pbuf = frame.c_str();
+            int size_to_write = frame.size();
+            while(size_to_write > 0 ) {
+                int nBytesSent = send(client_sockfd, pbuf, size_to_write, 0);
+                if( nBytesSent <= 0 ) {
+                    RAVELOG_ERROR("failed to send response %d\n", ntohl(requestid));
+                    return;
+                }
+                size_to_write -= nBytesSent;
+                pbuf += nBytesSent;
+            }
+        }
+
+        /// \brief returns true if data can be read within timeoutus microseconds
+        bool HasData(int timeoutus)
+        {
+            if( client_sockfd == 0 ) {
+                return false;
+            }
+            struct timeval tv;
+            tv.tv_sec = timeoutus/1000000;
+            tv.tv_usec = timeoutus%1000000;
+            fd_set readfds;
+            FD_ZERO(&readfds);
+            FD_SET(client_sockfd, &readfds);
+            int num = select(client_sockfd+1, &readfds, NULL, NULL, &tv);
+            return num > 0 && FD_ISSET(client_sockfd, &readfds);
+        }
+
+        /// \brief reads exactly size bytes. Returns false if the connection is closed or bStop is set while waiting.
+        bool ReadData(void* pdata, int size, const bool& bStop)
+        {
+            char* pbuf = (char*)pdata;
+            while(size > 0) {
+                if( bStop || client_sockfd == 0 ) {
+                    return false;
+                }
+                if( !HasData(100000) ) {
+                    continue;
+                }
+                long nBytesReceived = recv(client_sockfd, pbuf, size, 0);
+                if( nBytesReceived <= 0 ) {
+                    Close();
+                    return false;
+                }
+                size -= nBytesReceived;
+                pbuf += nBytesReceived;
+            }
+            return true;
+        }
+
         bool ReadLine(string& s)
         {
             struct timeval tv;
@@ -237,6 +310,7 @@ public:
 private:
         int client_sockfd;
         int client_len;
+        boost::mutex _mutexSend; ///< responses of the binary protocol are sent from the worker pool
 
         struct sockaddr_in client_address;
         bool bInit;
@@ -244,6 +318,78 @@ private:
     typedef boost::shared_ptr<Socket> SocketPtr;
     typedef boost::shared_ptr<Socket const> SocketConstPtr;
 
+    /// \brief shared memory segment of a text protocol connection that large numeric results are written to, see the sharedmemory command
+    ///
+    /// The values are always doubles. The segment grows when a result does not fit, so the client maps it for every result.
+    class SharedMemoryChannel
+    {
+public:
+        SharedMemoryChannel(const string& name) : _name(name), _fd(-1), _pdata(NULL), _size(0) {
+        }
+        ~SharedMemoryChannel() {
+#ifndef _WIN32
+            if( !!_pdata ) {
+                munmap(_pdata, _size);
+            }
+            if( _fd >= 0 ) {
+                close(_fd);
+                shm_unlink(_name.c_str());
+            }
+#endif
+        }
+
+        /// \brief creates the segment, fails if a segment with the same name exists
+        bool Init()
+        {
+#ifndef _WIN32
+            _fd = shm_open(_name.c_str(), O_RDWR|O_CREAT|O_EXCL, 0600);
+            return _fd >= 0 && !!Reserve(s_nInitialValues);
+#else
+            return false;
+#endif
+        }
+
+        /// \brief returns a buffer that can hold num values, or NULL if the segment cannot grow
+        double* Reserve(size_t num)
+        {
+#ifndef _WIN32
+            size_t size = max(num, (size_t)1)*sizeof(double);
+            if( size > _size ) {
+                size_t newsize = max(size, 2*_size);
+                if( !!_pdata ) {
+                    munmap(_pdata, _size);
+                    _pdata = NULL;
+                    _size = 0;
+                }
+                if( ftruncate(_fd, newsize) != 0 ) {
+                    return NULL;
+                }
+                void* pdata = mmap(NULL, newsize, PROT_READ|PROT_WRITE, MAP_SHARED, _fd, 0);
+                if( pdata == MAP_FAILED ) {
+                    return NULL;
+                }
+                _pdata = static_cast<double*>(pdata);
+                _size = newsize;
+            }
+            return _pdata;
+#else
+            return NULL;
+#endif
+        }
+
+        const string& GetName() const {
+            return _name;
+        }
+
+private:
+        static const size_t s_nInitialValues = 1<<16;
+        string _name;
+        int _fd;
+        double* _pdata;
+        size_t _size; ///< mapped size in bytes
+    };
+    typedef boost::shared_ptr<SharedMemoryChannel> SharedMemoryChannelPtr;
+
     /// \param in is the data passed from the network
     /// \param out is the return data that will be passed to the client
     /// \param boost::shared_ptr<void> is a pointer to a void that willl be passed to the worker thread function
@@ -254,15 +400,46 @@ private:
     /// and one that is executed on the main worker thread to avoid multithreading data synchronization issues
     struct RAVENETWORKFN
     {
-        RAVENETWORKFN() : bReturnResult(false) {
+        RAVENETWORKFN() : bReturnResult(false), bReadOnly(false) {
         }
-        RAVENETWORKFN(const OpenRaveNetworkFn& socket, const OpenRaveWorkerFn& worker, bool bReturnResult) : fnSocketThread(socket), fnWorker(worker), bReturnResult(bReturnResult) {
+        RAVENETWORKFN(const OpenRaveNetworkFn& socket, const OpenRaveWorkerFn& worker, bool bReturnResult, bool bReadOnly=false) : fnSocketThread(socket), fnWorker(worker), bReturnResult(bReturnResult), bReadOnly(bReadOnly) {
         }
 
         OpenRaveNetworkFn fnSocketThread;
         OpenRaveWorkerFn fnWorker;
         bool bReturnResult;     // if true, function is expected to return a result
+        bool bReadOnly;     // if true, fnSocketThread does not modify the environment and has no fnWorker, so the binary protocol can run it on the worker pool
+    };
+
+    /// latency of the commands, in microseconds
+    struct CommandStatistics
+    {
+        CommandStatistics() : count(0), errors(0), totaltime(0), maxtime(0) {
+        }
+        uint64_t count, errors, totaltime, maxtime;
+    };
+
+    /// a request received with the binary protocol
+    struct BinaryRequest
+    {
+        uint32_t requestid;
+        string cmd;
+        boost::shared_ptr<istream> is;
+        stringstream::streampos inputpos;
+        map<string, RAVENETWORKFN>::iterator itfn;
+    };
+    typedef boost::shared_ptr<BinaryRequest> BinaryRequestPtr;
+
+    /// read-only requests of a connection that are still executing on the worker pool
+    struct PendingRequests
+    {
+        PendingRequests() : num(0) {
+        }
+        boost::mutex mutex;
+        boost::condition cond;
+        int num;
     };
+    typedef boost::shared_ptr<PendingRequests> PendingRequestsPtr;
 
 public:
     SimpleTextServer(EnvironmentBasePtr penv) : ModuleBase(penv) {
@@ -270,15 +447,19 @@ public:
         _nNextFigureId = 1;
         _bWorking = false;
         bDestroying = false;
-        __description=":Interface Author: Rosen Diankov\n\nSimple text-based server using sockets.";
+        bInitThread = false;
+        bCloseThread = false;
+        _nNumPoolThreads = 0;
+        __description=":Interface Author: Rosen Diankov\n\nSimple text-based server using sockets.\n\n\
+The module is started with \"port [numpoolthreads]\". Sending the line \"sharedmemory 1\" on a text connection creates a POSIX shared memory segment for that connection and returns its name, afterwards commands with large numeric results like \"body_getlinks\" and \"env_triangulate\" write the values as doubles to the segment and only return \"shm numvalues\". \"sharedmemory 0\" removes it. Sending the line \"binaryprotocol\" switches the connection to length-prefixed frames: the request is a uint32 length followed by a uint32 request id and the text command, the response is a uint32 length followed by the uint32 request id, a uint8 status (0 for success) and the result. All integers are in network byte order. Requests can be pipelined, read-only commands are executed on a pool of numpoolthreads threads and their responses might arrive out of order. \"server_status\" returns the latency of every command.\n\nThe server can act as a remote planning worker for clients that have the same scene: \"env_fingerprint\" returns the name and kinematics geometry hash of every body, and \"plan_run\" only sends the poses and joint values of the bodies plus the planner parameters. The planning runs on a cached copy of the scene, so several connections can plan at the same time, and the trajectory is returned in the binary format. Replicas of the scene stay in sync with \"env_getpublisheddelta stamp\", which only returns the published bodies that changed since the stamp of their previous request.";
         mapNetworkFns["body_checkcollision"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvCheckCollision, this, _1, _2, _3), OpenRaveWorkerFn(), true);
-        mapNetworkFns["body_getjoints"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orBodyGetJointValues, this,_1, _2, _3), OpenRaveWorkerFn(), true);
+        mapNetworkFns["body_getjoints"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orBodyGetJointValues, this,_1, _2, _3), OpenRaveWorkerFn(), true, true);
         mapNetworkFns["body_destroy"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orBodyDestroy,this,_1,_2,_3), OpenRaveWorkerFn(), false);
         mapNetworkFns["body_enable"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orBodyEnable,this,_1,_2,_3), OpenRaveWorkerFn(), false);
-        mapNetworkFns["body_getaabb"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orBodyGetAABB,this,_1,_2,_3), OpenRaveWorkerFn(), true);
-        mapNetworkFns["body_getaabbs"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orBodyGetAABBs,this,_1,_2,_3), OpenRaveWorkerFn(), true);
-        mapNetworkFns["body_getlinks"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orBodyGetLinks,this,_1,_2,_3),OpenRaveWorkerFn(), true);
-        mapNetworkFns["body_getdof"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orBodyGetDOF,this,_1,_2,_3),OpenRaveWorkerFn(), true);
+        mapNetworkFns["body_getaabb"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orBodyGetAABB,this,_1,_2,_3), OpenRaveWorkerFn(), true, true);
+        mapNetworkFns["body_getaabbs"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orBodyGetAABBs,this,_1,_2,_3), OpenRaveWorkerFn(), true, true);
+        mapNetworkFns["body_getlinks"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orBodyGetLinks,this,_1,_2,_3),OpenRaveWorkerFn(), true, true);
+        mapNetworkFns["body_getdof"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orBodyGetDOF,this,_1,_2,_3),OpenRaveWorkerFn(), true, true);
         mapNetworkFns["body_settransform"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orKinBodySetTransform,this,_1,_2,_3),OpenRaveWorkerFn(), false);
         mapNetworkFns["body_setjoints"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orBodySetJointValues,this,_1,_2,_3), OpenRaveWorkerFn(), false);
         mapNetworkFns["body_setjointtorques"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orBodySetJointTorques,this,_1,_2,_3), OpenRaveWorkerFn(), false);
@@ -287,24 +468,27 @@ public:
         mapNetworkFns["createbody"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvCreateKinBody,this,_1,_2,_3), OpenRaveWorkerFn(), true);
         mapNetworkFns["createmodule"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvCreateModule,this,_1,_2,_3), boost::bind(&SimpleTextServer::worEnvCreateModule,this,_1,_2), true);
         mapNetworkFns["env_dstrprob"] = RAVENETWORKFN(OpenRaveNetworkFn(), boost::bind(&SimpleTextServer::worEnvDestroyProblem,this,_1,_2), false);
-        mapNetworkFns["env_getbodies"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvGetBodies,this,_1,_2,_3), OpenRaveWorkerFn(), true);
-        mapNetworkFns["env_getrobots"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvGetRobots,this,_1,_2,_3), OpenRaveWorkerFn(), true);
-        mapNetworkFns["env_getbody"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvGetBody,this,_1,_2,_3), OpenRaveWorkerFn(), true);
+        mapNetworkFns["env_getbodies"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvGetBodies,this,_1,_2,_3), OpenRaveWorkerFn(), true, true);
+        mapNetworkFns["env_getrobots"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvGetRobots,this,_1,_2,_3), OpenRaveWorkerFn(), true, true);
+        mapNetworkFns["env_getbody"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvGetBody,this,_1,_2,_3), OpenRaveWorkerFn(), true, true);
+        mapNetworkFns["env_getpublisheddelta"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvGetPublishedDelta,this,_1,_2,_3), OpenRaveWorkerFn(), true, true);
+        mapNetworkFns["env_fingerprint"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvGetFingerprint,this,_1,_2,_3), OpenRaveWorkerFn(), true, true);
         mapNetworkFns["env_loadplugin"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvLoadPlugin,this,_1,_2,_3), OpenRaveWorkerFn(), true);
         mapNetworkFns["env_raycollision"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvRayCollision,this,_1,_2,_3), OpenRaveWorkerFn(), true);
         mapNetworkFns["env_stepsimulation"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvStepSimulation,this,_1,_2,_3), boost::bind(&SimpleTextServer::worEnvStepSimulation,this,_1,_2), false);
         mapNetworkFns["env_triangulate"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvTriangulate,this,_1,_2,_3), OpenRaveWorkerFn(), true);
         mapNetworkFns["loadscene"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvLoadScene,this,_1,_2,_3), OpenRaveWorkerFn(), true);
+        mapNetworkFns["plan_run"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orPlannerRun,this,_1,_2,_3), OpenRaveWorkerFn(), true);
         mapNetworkFns["plot"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvPlot,this,_1,_2,_3), OpenRaveWorkerFn(), true);
         mapNetworkFns["problem_sendcmd"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orProblemSendCommand,this,_1,_2,_3), OpenRaveWorkerFn(), true);
         mapNetworkFns["robot_checkselfcollision"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotCheckSelfCollision,this,_1,_2,_3), OpenRaveWorkerFn(), true);
         mapNetworkFns["robot_controllersend"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotControllerSend,this,_1,_2,_3), OpenRaveWorkerFn(), true);
         mapNetworkFns["robot_controllerset"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotControllerSet,this,_1,_2,_3), OpenRaveWorkerFn(), true);
-        mapNetworkFns["robot_getactivedof"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotGetActiveDOF,this,_1,_2,_3), OpenRaveWorkerFn(), true);
-        mapNetworkFns["robot_getdofvalues"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotGetDOFValues,this,_1,_2,_3), OpenRaveWorkerFn(), true);
-        mapNetworkFns["robot_getlimits"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotGetDOFLimits,this,_1,_2,_3), OpenRaveWorkerFn(), true);
-        mapNetworkFns["robot_getmanipulators"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotGetManipulators,this,_1,_2,_3), OpenRaveWorkerFn(), true);
-        mapNetworkFns["robot_getsensors"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotGetAttachedSensors,this,_1,_2,_3), OpenRaveWorkerFn(), true);
+        mapNetworkFns["robot_getactivedof"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotGetActiveDOF,this,_1,_2,_3), OpenRaveWorkerFn(), true, true);
+        mapNetworkFns["robot_getdofvalues"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotGetDOFValues,this,_1,_2,_3), OpenRaveWorkerFn(), true, true);
+        mapNetworkFns["robot_getlimits"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotGetDOFLimits,this,_1,_2,_3), OpenRaveWorkerFn(), true, true);
+        mapNetworkFns["robot_getmanipulators"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotGetManipulators,this,_1,_2,_3), OpenRaveWorkerFn(), true, true);
+        mapNetworkFns["robot_getsensors"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotGetAttachedSensors,this,_1,_2,_3), OpenRaveWorkerFn(), true, true);
         mapNetworkFns["robot_sensorsend"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotSensorSend,this,_1,_2,_3), OpenRaveWorkerFn(), true);
         mapNetworkFns["robot_sensorconfigure"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotSensorConfigure,this,_1,_2,_3), OpenRaveWorkerFn(), true);
         mapNetworkFns["robot_sensordata"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orRobotSensorData,this,_1,_2,_3), OpenRaveWorkerFn(), true);
@@ -314,6 +498,7 @@ public:
         mapNetworkFns["robot_traj"] = RAVENETWORKFN(OpenRaveNetworkFn(), boost::bind(&SimpleTextServer::worRobotStartActiveTrajectory,this,_1,_2), false);
         mapNetworkFns["render"] = RAVENETWORKFN(OpenRaveNetworkFn(), boost::bind(&SimpleTextServer::worRender,this,_1,_2), false);
         mapNetworkFns["setoptions"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvSetOptions,this,_1,_2,_3), boost::bind(&SimpleTextServer::worSetOptions,this,_1,_2), false);
+        mapNetworkFns["server_status"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orServerStatus,this,_1,_2,_3), OpenRaveWorkerFn(), true, true);
         mapNetworkFns["test"] = RAVENETWORKFN(OpenRaveNetworkFn(), OpenRaveWorkerFn(), false);
         mapNetworkFns["wait"] = RAVENETWORKFN(boost::bind(&SimpleTextServer::orEnvWait,this,_1,_2,_3), OpenRaveWorkerFn(), true);
 
@@ -332,6 +517,11 @@ public:
         _nPort = 4765;
         stringstream ss(cmd);
         ss >> _nPort;
+        _nNumPoolThreads = 0;
+        ss >> _nNumPoolThreads;
+        if( _nNumPoolThreads <= 0 ) {
+            _nNumPoolThreads = max(1, (int)boost::thread::hardware_concurrency());
+        }
 
         Destroy();
 
@@ -403,6 +593,9 @@ public:
         RAVELOG_DEBUG("text server listening on port %d\n",_nPort);
         _servthread.reset(new boost::thread(boost::bind(&SimpleTextServer::_listen_threadcb,this)));
         _workerthread.reset(new boost::thread(boost::bind(&SimpleTextServer::_worker_threadcb,this)));
+        for(int i = 0; i < _nNumPoolThreads; ++i) {
+            _listPoolThreads.push_back(boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&SimpleTextServer::_pool_threadcb,this))));
+        }
         bInitThread = true;
         return 0;
     }
@@ -439,6 +632,22 @@ public:
                 _workerthread->join();
             }
             _workerthread.reset();
+            {
+                boost::mutex::scoped_lock lock(_mutexPool);
+                _condPool.notify_all();
+            }
+            FOREACH(it, _listPoolThreads) {
+                (*it)->join();
+            }
+            _listPoolThreads.clear();
+            _listPoolJobs.clear();
+            {
+                boost::mutex::scoped_lock lock(_mutexPlanningEnvironments);
+                FOREACH(itenv, _listPlanningEnvironments) {
+                    (*itenv)->Destroy();
+                }
+                _listPlanningEnvironments.clear();
+            }
 
             bCloseThread = false;
             bInitThread = false;
@@ -481,6 +690,10 @@ private:
     // called from threads other than the main worker to wait until
     void _SyncWithWorkerThread()
     {
+        if( !!_tlsInReadOnlyBatch.get() ) {
+            // already synchronized by _RunReadOnlyBatch, which holds the environment lock
+            return;
+        }
         boost::mutex::scoped_lock lock(_mutexWorker);
         while((listWorkers.size() > 0 || _bWorking) && !bCloseThread) {
             _condHasWork.notify_all();
@@ -558,6 +771,7 @@ private:
         RAVELOG_VERBOSE("started new server connection\n");
         string cmd, line;
         stringstream sout;
+        SharedMemoryChannelPtr psharedmemory;
         while(!bCloseThread) {
             if( psocket->ReadLine(line) && line.length() ) {
 
@@ -574,6 +788,16 @@ private:
                     continue;
                 }
                 std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
+                if( cmd == "binaryprotocol" ) {
+                    psocket->SendData("1",1);
+                    _read_binary(psocket);
+                    break;
+                }
+                if( cmd == "sharedmemory" ) {
+                    string response = _SetSharedMemory(*is, psharedmemory);
+                    psocket->SendData(response.c_str(), response.size());
+                    continue;
+                }
                 stringstream::streampos inputpos = is->tellg();
 
                 map<string, RAVENETWORKFN>::iterator itfn = mapNetworkFns.find(cmd);
@@ -584,16 +808,11 @@ private:
                     // need to set w.args before pcmdend is modified
                     sout.str(""); sout.clear();
                     if( !!itfn->second.fnSocketThread ) {
-                        bool bSuccess = false;
-                        try {
-                            bSuccess = itfn->second.fnSocketThread(*is, sout, pdata);
-                        }
-                        catch(const std::exception& ex) {
-                            RAVELOG_FATAL("server caught exception: %s\n",ex.what());
-                        }
-                        catch(...) {
-                            RAVELOG_FATAL("unknown exception!!\n");
+                        if( !!psharedmemory ) {
+                            _tlsSharedMemory.reset(new SharedMemoryChannelPtr(psharedmemory));
                         }
+                        bool bSuccess = _CallNetworkFn(itfn, *is, sout, pdata);
+                        _tlsSharedMemory.reset();
 
                         if( bSuccess ) {
                             if( itfn->second.bReturnResult ) {
@@ -641,11 +860,260 @@ private:
         RAVELOG_VERBOSE("Closing socket connection\n");
     }
 
+    /// \brief handles \"sharedmemory enable\" of a text connection and returns the response
+    string _SetSharedMemory(istream& is, SharedMemoryChannelPtr& psharedmemory)
+    {
+        int enable = 1;
+        is >> enable;
+        psharedmemory.reset();
+        if( !enable ) {
+            return "0";
+        }
+#ifdef _WIN32
+        RAVELOG_WARN("shared memory is not supported on windows\n");
+        return "error";
+#else
+        static int s_nSharedMemoryIndex = 0;
+        SharedMemoryChannelPtr pnewsharedmemory(new SharedMemoryChannel(str(boost::format("/openrave_textserver_%d_%d")%getpid()%(++s_nSharedMemoryIndex))));
+        if( !pnewsharedmemory->Init() ) {
+            RAVELOG_WARN_FORMAT("failed to create shared memory %s", pnewsharedmemory->GetName());
+            return "error";
+        }
+        psharedmemory = pnewsharedmemory;
+        return psharedmemory->GetName();
+#endif
+    }
+
+    /// \brief writes numeric results to the shared memory of the connection if it has one, otherwise as text
+    void _WriteArray(ostream& os, const vector<double>& vvalues)
+    {
+        SharedMemoryChannelPtr* ppsharedmemory = _tlsSharedMemory.get();
+        if( !!ppsharedmemory ) {
+            double* pdata = (*ppsharedmemory)->Reserve(vvalues.size());
+            if( !!pdata ) {
+                if( vvalues.size() > 0 ) {
+                    memcpy(pdata, &vvalues[0], vvalues.size()*sizeof(double));
+                }
+                os << "shm " << vvalues.size();
+                return;
+            }
+        }
+        FOREACHC(it, vvalues) {
+            os << *it << " ";
+        }
+    }
+
+    /// \brief calls the socket function of a command and records its latency
+    bool _CallNetworkFn(map<string, RAVENETWORKFN>::iterator itfn, istream& is, ostream& os, boost::shared_ptr<void>& pdata)
+    {
+        uint64_t starttime = utils::GetMicroTime();
+        bool bSuccess = false;
+        try {
+            bSuccess = itfn->second.fnSocketThread(is, os, pdata);
+        }
+        catch(const std::exception& ex) {
+            RAVELOG_FATAL("server caught exception: %s\n",ex.what());
+        }
+        catch(...) {
+            RAVELOG_FATAL("unknown exception!!\n");
+        }
+        uint64_t elapsedtime = utils::GetMicroTime()-starttime;
+        boost::mutex::scoped_lock lock(_mutexStatistics);
+        CommandStatistics& stats = _mapCommandStatistics[itfn->first];
+        stats.count++;
+        if( !bSuccess ) {
+            stats.errors++;
+        }
+        stats.totaltime += elapsedtime;
+        stats.maxtime = max(stats.maxtime, elapsedtime);
+        return bSuccess;
+    }
+
+    /// \brief reads the next binary protocol request. Returns an empty pointer if the connection closed.
+    BinaryRequestPtr _ReadBinaryRequest(SocketPtr psocket)
+    {
+        uint32_t length = 0;
+        if( !psocket->ReadData(&length, 4, bCloseThread) ) {
+            return BinaryRequestPtr();
+        }
+        length = ntohl(length);
+        if( length < 4 || length > s_nMaxFrameLength ) {
+            RAVELOG_ERROR("invalid frame length %d, closing connection\n", length);
+            psocket->Close();
+            return BinaryRequestPtr();
+        }
+        string data(length, '\0');
+        if( !psocket->ReadData(&data[0], length, bCloseThread) ) {
+            return BinaryRequestPtr();
+        }
+        BinaryRequestPtr preq(new BinaryRequest());
+        memcpy(&preq->requestid, &data[0], 4);
+        preq->requestid = ntohl(preq->requestid);
+        preq->is.reset(new stringstream(data.substr(4)));
+        *preq->is >> preq->cmd;
+        std::transform(preq->cmd.begin(), preq->cmd.end(), preq->cmd.begin(), ::tolower);
+        preq->inputpos = preq->is->tellg();
+        preq->itfn = mapNetworkFns.find(preq->cmd);
+        return preq;
+    }
+
+    /// \brief reads pipelined binary protocol requests of a connection
+    ///
+    /// Consecutive read-only requests are batched and executed on the worker pool. Other requests wait for the pending
+    /// read-only requests of the connection and are executed in order on this thread like in the text protocol.
+    void _read_binary(SocketPtr psocket)
+    {
+        RAVELOG_VERBOSE("connection switched to binary protocol\n");
+        PendingRequestsPtr ppending(new PendingRequests());
+        std::vector<BinaryRequestPtr> vbatch;
+        while(!bCloseThread && psocket->IsInit()) {
+            if( !psocket->HasData(vbatch.size() > 0 ? 0 : 1000) ) {
+                // no more pipelined requests, so start the batch
+                if( vbatch.size() > 0 ) {
+                    _ScheduleReadOnlyBatch(psocket, ppending, vbatch);
+                }
+                continue;
+            }
+            BinaryRequestPtr preq = _ReadBinaryRequest(psocket);
+            if( !preq ) {
+                break;
+            }
+            if( !!flog &&( GetEnv()->GetDebugLevel()>0) ) {
+                flog << preq->requestid << ": " << preq->cmd << endl;
+            }
+            if( preq->itfn == mapNetworkFns.end() ) {
+                RAVELOG_ERROR("Failed to recognize command: %s\n", preq->cmd.c_str());
+                psocket->SendFrame(preq->requestid, 1, "unknown command");
+                continue;
+            }
+            const RAVENETWORKFN& fn = preq->itfn->second;
+            if( fn.bReadOnly && !!fn.fnSocketThread && !fn.fnWorker ) {
+                vbatch.push_back(preq);
+                if( (int)vbatch.size() >= s_nMaxBatchSize ) {
+                    _ScheduleReadOnlyBatch(psocket, ppending, vbatch);
+                }
+                continue;
+            }
+
+            if( vbatch.size() > 0 ) {
+                _ScheduleReadOnlyBatch(psocket, ppending, vbatch);
+            }
+            _WaitForPendingRequests(ppending);
+            stringstream sout;
+            boost::shared_ptr<void> pdata;
+            bool bSuccess = true;
+            if( !!fn.fnSocketThread ) {
+                bSuccess = _CallNetworkFn(preq->itfn, *preq->is, sout, pdata);
+            }
+            if( bSuccess && !!fn.fnWorker ) {
+                preq->is->clear();
+                preq->is->seekg(preq->inputpos);
+                ScheduleWorker(boost::bind(fn.fnWorker,preq->is,pdata));
+            }
+            psocket->SendFrame(preq->requestid, bSuccess ? 0 : 1, bSuccess ? sout.str() : string("error"));
+        }
+        _WaitForPendingRequests(ppending);
+    }
+
+    void _ScheduleReadOnlyBatch(SocketPtr psocket, PendingRequestsPtr ppending, std::vector<BinaryRequestPtr>& vbatch)
+    {
+        {
+            boost::mutex::scoped_lock lock(ppending->mutex);
+            ppending->num++;
+        }
+        boost::shared_ptr< std::vector<BinaryRequestPtr> > pbatch(new std::vector<BinaryRequestPtr>());
+        pbatch->swap(vbatch);
+        boost::mutex::scoped_lock lock(_mutexPool);
+        _listPoolJobs.push_back(boost::bind(&SimpleTextServer::_RunReadOnlyBatch, this, psocket, ppending, pbatch));
+        _condPool.notify_one();
+    }
+
+    void _WaitForPendingRequests(PendingRequestsPtr ppending)
+    {
+        boost::mutex::scoped_lock lock(ppending->mutex);
+        while(ppending->num > 0) {
+            ppending->cond.wait(lock);
+        }
+    }
+
+    /// \brief executes read-only requests under one environment lock and sends their responses
+    void _RunReadOnlyBatch(SocketPtr psocket, PendingRequestsPtr ppending, boost::shared_ptr< std::vector<BinaryRequestPtr> > pbatch)
+    {
+        std::vector<string> vresults(pbatch->size());
+        std::vector<uint8_t> vstatus(pbatch->size(), 1);
+        _SyncWithWorkerThread();
+        {
+            EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+            _tlsInReadOnlyBatch.reset(new bool(true));
+            stringstream sout;
+            for(size_t i = 0; i < pbatch->size(); ++i) {
+                BinaryRequest& req = *pbatch->at(i);
+                sout.str(""); sout.clear();
+                boost::shared_ptr<void> pdata;
+                if( _CallNetworkFn(req.itfn, *req.is, sout, pdata) ) {
+                    vstatus[i] = 0;
+                    vresults[i] = sout.str();
+                }
+                else {
+                    vresults[i] = "error";
+                }
+            }
+            _tlsInReadOnlyBatch.reset();
+        }
+        for(size_t i = 0; i < pbatch->size(); ++i) {
+            psocket->SendFrame(pbatch->at(i)->requestid, vstatus[i], vresults[i]);
+        }
+        boost::mutex::scoped_lock lock(ppending->mutex);
+        ppending->num--;
+        ppending->cond.notify_all();
+    }
+
+    void _pool_threadcb()
+    {
+        while(!bCloseThread) {
+            boost::function<void()> fn;
+            {
+                boost::mutex::scoped_lock lock(_mutexPool);
+                if( _listPoolJobs.size() == 0 ) {
+                    _condPool.wait(lock);
+                    continue;
+                }
+                fn = _listPoolJobs.front();
+                _listPoolJobs.pop_front();
+            }
+            try {
+                fn();
+            }
+            catch(const std::exception& ex) {
+                RAVELOG_FATAL("server caught exception: %s\n",ex.what());
+            }
+            catch(...) {
+                RAVELOG_FATAL("unknown exception!!\n");
+            }
+        }
+    }
+
     int _nPort;     ///< port used for listening to incoming connections
 
     boost::shared_ptr<boost::thread> _servthread, _workerthread;
     list<boost::shared_ptr<boost::thread> > _listReadThreads;
 
+    static const uint32_t s_nMaxFrameLength = 1<<26; ///< maximum length of a binary protocol request
+    static const int s_nMaxBatchSize = 64; ///< maximum number of read-only requests executed under one environment lock
+    int _nNumPoolThreads;
+    list<boost::shared_ptr<boost::thread> > _listPoolThreads;
+    list<boost::function<void()> > _listPoolJobs;
+    boost::mutex _mutexPool;
+    boost::condition _condPool;
+    boost::thread_specific_ptr<bool> _tlsInReadOnlyBatch; ///< set while a pool thread executes a read-only batch
+    boost::thread_specific_ptr<SharedMemoryChannelPtr> _tlsSharedMemory; ///< set while a text connection with shared memory executes a command, see _WriteArray
+
+    boost::mutex _mutexStatistics;
+    map<string, CommandStatistics> _mapCommandStatistics;
+
+    boost::mutex _mutexPlanningEnvironments;
+    list<EnvironmentBasePtr> _listPlanningEnvironments; ///< copies of the scene that are not used by a plan_run, one per connection that planned at the same time
+
     boost::mutex _mutexWorker;
     boost::condition _condWorker;
     boost::condition _condHasWork;
@@ -1122,9 +1590,21 @@ protected:
         }
         vector<Transform> trans;
         body->GetLinkTransformations(trans);
+        // column order like the serialization of TransformMatrix
+        vector<double> vvalues;
+        vvalues.reserve(12*trans.size());
         FOREACHC(it, trans) {
-            os << TransformMatrix(*it) << " ";
+            TransformMatrix t(*it);
+            for(int j = 0; j < 3; ++j) {
+                vvalues.push_back(t.m[j]);
+                vvalues.push_back(t.m[4+j]);
+                vvalues.push_back(t.m[8+j]);
+            }
+            vvalues.push_back(t.trans.x);
+            vvalues.push_back(t.trans.y);
+            vvalues.push_back(t.trans.z);
         }
+        _WriteArray(os, vvalues);
         return true;
     }
 
@@ -1584,6 +2064,164 @@ protected:
         return true;
     }
 
+    /// [stamp delta] = orEnvGetPublishedDelta(stamp) - returns the published bodies that changed after stamp, see EnvironmentBase::WritePublishedBodiesDelta
+    ///
+    /// The new stamp is followed by a space and the binary delta, so the command should be sent with the binary protocol. Replicas pass the returned stamp to the next request.
+    bool orEnvGetPublishedDelta(istream& is, ostream& os, boost::shared_ptr<void>& pdata)
+    {
+        uint64_t stamp = 0;
+        is >> stamp;
+        // the published bodies do not need the environment lock
+        stringstream ssdelta;
+        uint64_t newstamp = GetEnv()->WritePublishedBodiesDelta(ssdelta, stamp);
+        os << newstamp << " " << ssdelta.str();
+        return true;
+    }
+
+    /// fingerprint = orEnvGetFingerprint() - returns one line per body with its name and kinematics geometry hash
+    ///
+    /// Planning clients compare it with their own scene to know which bodies they can refer to in plan_run, and send the scene with loadscene when it differs.
+    bool orEnvGetFingerprint(istream& is, ostream& os, boost::shared_ptr<void>& pdata)
+    {
+        _SyncWithWorkerThread();
+        EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+        vector<KinBodyPtr> vbodies;
+        GetEnv()->GetBodies(vbodies);
+        FOREACHC(itbody, vbodies) {
+            os << (*itbody)->GetName() << " " << (*itbody)->GetKinematicsGeometryHash() << endl;
+        }
+        return true;
+    }
+
+    /// [status trajectory] = orPlannerRun(robot, planner, numbodies, [body hash qw qx qy qz tx ty tz numdofs dofvalues]*, parameters) - plans on a copy of the scene
+    ///
+    /// Every body has to be in the scene of the server with the hash returned by env_fingerprint, otherwise the request fails. Bodies with 0 dofs only have their pose set.
+    /// The rest of the input are the planner parameters in XML. Returns the planner status followed by a space and, if the planner has a solution,
+    /// the trajectory in the binary format, so the command should be sent with the binary protocol.
+    bool orPlannerRun(istream& is, ostream& os, boost::shared_ptr<void>& pdata)
+    {
+        string robotname, plannername;
+        int numbodies = 0;
+        is >> robotname >> plannername >> numbodies;
+        if( !is || numbodies < 0 ) {
+            return false;
+        }
+        EnvironmentBasePtr penv = _AcquirePlanningEnvironment();
+        boost::shared_ptr<void> releaser((void*)0, boost::bind(&SimpleTextServer::_ReleasePlanningEnvironment, this, penv));
+        EnvironmentMutex::scoped_lock lock(penv->GetMutex());
+        vector<dReal> vvalues;
+        for(int ibody = 0; ibody < numbodies; ++ibody) {
+            string bodyname, hash;
+            Transform t;
+            int numdofs = 0;
+            is >> bodyname >> hash >> t.rot.x >> t.rot.y >> t.rot.z >> t.rot.w >> t.trans.x >> t.trans.y >> t.trans.z >> numdofs;
+            if( !is || numdofs < 0 ) {
+                return false;
+            }
+            vvalues.resize(numdofs);
+            FOREACH(itvalue, vvalues) {
+                is >> *itvalue;
+            }
+            if( !is ) {
+                return false;
+            }
+            KinBodyPtr pbody = penv->GetKinBody(bodyname);
+            if( !pbody ) {
+                RAVELOG_WARN_FORMAT("plan_run body %s is not in the scene", bodyname);
+                return false;
+            }
+            if( pbody->GetKinematicsGeometryHash() != hash ) {
+                RAVELOG_WARN_FORMAT("plan_run body %s has a different hash than the client, the scene has to be sent again", bodyname);
+                return false;
+            }
+            pbody->SetTransform(t);
+            if( numdofs > 0 ) {
+                if( numdofs != pbody->GetDOF() ) {
+                    RAVELOG_WARN_FORMAT("plan_run body %s has %d dofs, but %d values were sent", bodyname%pbody->GetDOF()%numdofs);
+                    return false;
+                }
+                pbody->SetDOFValues(vvalues, KinBody::CLA_CheckLimitsSilent);
+            }
+        }
+
+        RobotBasePtr probot = penv->GetRobot(robotname);
+        PlannerBasePtr planner = RaveCreatePlanner(penv, plannername);
+        if( !probot || !planner ) {
+            RAVELOG_WARN_FORMAT("plan_run failed to get robot %s or create planner %s", robotname%plannername);
+            return false;
+        }
+        PlannerBase::PlannerParametersPtr readparams(new PlannerBase::PlannerParameters());
+        is >> *readparams;
+        // the state functions are not serialized, so set them up for the copy of the scene
+        PlannerBase::PlannerParametersPtr params(new PlannerBase::PlannerParameters());
+        params->copy(readparams);
+        params->SetConfigurationSpecification(penv, readparams->_configurationspecification);
+        // SetConfigurationSpecification resets the limits to the ones of the bodies
+        if( readparams->_vConfigLowerLimit.size() > 0 ) {
+            params->_vConfigLowerLimit = readparams->_vConfigLowerLimit;
+            params->_vConfigUpperLimit = readparams->_vConfigUpperLimit;
+        }
+        if( readparams->_vConfigVelocityLimit.size() > 0 ) {
+            params->_vConfigVelocityLimit = readparams->_vConfigVelocityLimit;
+        }
+        if( readparams->_vConfigAccelerationLimit.size() > 0 ) {
+            params->_vConfigAccelerationLimit = readparams->_vConfigAccelerationLimit;
+        }
+        if( readparams->_vConfigResolution.size() > 0 ) {
+            params->_vConfigResolution = readparams->_vConfigResolution;
+        }
+        // the planner is only used for this request, so all its memory goes back at once when it is destroyed
+        params->_parena.reset(new utils::MonotonicArena());
+        if( !planner->InitPlan(probot, params) ) {
+            return false;
+        }
+        TrajectoryBasePtr ptraj = RaveCreateTrajectory(penv, "");
+        PlannerStatus status = planner->PlanPath(ptraj);
+        os << status << " ";
+        if( status & PS_HasSolution ) {
+            ptraj->serialize(os, SO_BinaryTrajectory);
+        }
+        return true;
+    }
+
+    /// \brief returns a copy of the scene that no other plan_run uses, updated with the bodies that changed since it was last used
+    EnvironmentBasePtr _AcquirePlanningEnvironment()
+    {
+        EnvironmentBasePtr penv;
+        {
+            boost::mutex::scoped_lock lock(_mutexPlanningEnvironments);
+            if( _listPlanningEnvironments.size() > 0 ) {
+                penv = _listPlanningEnvironments.front();
+                _listPlanningEnvironments.pop_front();
+            }
+        }
+        _SyncWithWorkerThread();
+        EnvironmentMutex::scoped_lock lock(GetEnv()->GetMutex());
+        if( !penv ) {
+            penv = GetEnv()->CloneSelf(Clone_Bodies);
+        }
+        else {
+            penv->Clone(GetEnv(), Clone_Bodies);
+        }
+        return penv;
+    }
+
+    void _ReleasePlanningEnvironment(EnvironmentBasePtr penv)
+    {
+        boost::mutex::scoped_lock lock(_mutexPlanningEnvironments);
+        _listPlanningEnvironments.push_back(penv);
+    }
+
+    /// stats = orServerStatus() - returns one line per executed command: name count errors meanus maxus
+    bool orServerStatus(istream& is, ostream& os, boost::shared_ptr<void>& pdata)
+    {
+        boost::mutex::scoped_lock lock(_mutexStatistics);
+        FOREACHC(it, _mapCommandStatistics) {
+            os << it->first << " " << it->second.count << " " << it->second.errors << " " << (it->second.count > 0 ? it->second.totaltime/it->second.count : 0) << " " << it->second.maxtime << endl;
+        }
+        return true;
+    }
+
     /// dofs = orBodyGetDOF(body) - returns the number of active joints of the body
     bool orBodyGetDOF(istream& is, ostream& os, boost::shared_ptr<void>& pdata)
     {
@@ -2194,13 +2832,17 @@ protected:
         }
 
         BOOST_ASSERT( (trimesh.indices.size()%3) == 0 );
-        os << trimesh.vertices.size() << " " << trimesh.indices.size()/3 << " ";
+        vector<double> vvalues;
+        vvalues.reserve(2+3*trimesh.vertices.size()+trimesh.indices.size());
+        vvalues.push_back(trimesh.vertices.size());
+        vvalues.push_back(trimesh.indices.size()/3);
         FOREACH(itvert, trimesh.vertices) {
-            os << itvert->x << " " << itvert->y << " " << itvert->z << " ";
-        }
-        FOREACH(itind, trimesh.indices) {
-            os << *itind << " ";
+            vvalues.push_back(itvert->x);
+            vvalues.push_back(itvert->y);
+            vvalues.push_back(itvert->z);
         }
+        vvalues.insert(vvalues.end(), trimesh.indices.begin(), trimesh.indices.end());
+        _WriteArray(os, vvalues);
         return true;
     }
 
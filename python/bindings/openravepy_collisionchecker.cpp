@@ -166,12 +166,17 @@ public:
     bool CheckCollision(PyKinBodyPtr pbody1)
     {
         CHECK_POINTER(pbody1);
+        openravepy::PythonThreadSaver threadsaver;
         return _pCollisionChecker->CheckCollision(KinBodyConstPtr(openravepy::GetKinBody(pbody1)));
     }
     bool CheckCollision(PyKinBodyPtr pbody1, PyCollisionReportPtr pReport)
     {
         CHECK_POINTER(pbody1);
-        bool bCollision = _pCollisionChecker->CheckCollision(KinBodyConstPtr(openravepy::GetKinBody(pbody1)), openravepy::GetCollisionReport(pReport));
+        bool bCollision;
+        {
+            openravepy::PythonThreadSaver threadsaver;
+            bCollision = _pCollisionChecker->CheckCollision(KinBodyConstPtr(openravepy::GetKinBody(pbody1)), openravepy::GetCollisionReport(pReport));
+        }
         openravepy::UpdateCollisionReport(pReport,_pyenv);
         return bCollision;
     }
@@ -180,6 +185,7 @@ public:
     {
         CHECK_POINTER(pbody1);
         CHECK_POINTER(pbody2);
+        openravepy::PythonThreadSaver threadsaver;
         return _pCollisionChecker->CheckCollision(KinBodyConstPtr(openravepy::GetKinBody(pbody1)), KinBodyConstPtr(openravepy::GetKinBody(pbody2)));
     }
 
@@ -187,7 +193,11 @@ public:
     {
         CHECK_POINTER(pbody1);
         CHECK_POINTER(pbody2);
-        bool bCollision = _pCollisionChecker->CheckCollision(KinBodyConstPtr(openravepy::GetKinBody(pbody1)), KinBodyConstPtr(openravepy::GetKinBody(pbody2)), openravepy::GetCollisionReport(pReport));
+        bool bCollision;
+        {
+            openravepy::PythonThreadSaver threadsaver;
+            bCollision = _pCollisionChecker->CheckCollision(KinBodyConstPtr(openravepy::GetKinBody(pbody1)), KinBodyConstPtr(openravepy::GetKinBody(pbody2)), openravepy::GetCollisionReport(pReport));
+        }
         openravepy::UpdateCollisionReport(pReport,_pyenv);
         return bCollision;
     }
@@ -197,10 +207,12 @@ public:
         CHECK_POINTER(o1);
         KinBody::LinkConstPtr plink = openravepy::GetKinBodyLinkConst(o1);
         if( !!plink ) {
+            openravepy::PythonThreadSaver threadsaver;
             return _pCollisionChecker->CheckCollision(plink);
         }
         KinBodyConstPtr pbody = openravepy::GetKinBody(o1);
         if( !!pbody ) {
+            openravepy::PythonThreadSaver threadsaver;
             return _pCollisionChecker->CheckCollision(pbody);
         }
         throw OPENRAVE_EXCEPTION_FORMAT0(_("CheckCollision(object) invalid argument"),ORE_InvalidArguments);
@@ -212,11 +224,13 @@ public:
         KinBody::LinkConstPtr plink = openravepy::GetKinBodyLinkConst(o1);
         bool bCollision;
         if( !!plink ) {
+            openravepy::PythonThreadSaver threadsaver;
             bCollision = _pCollisionChecker->CheckCollision(plink,openravepy::GetCollisionReport(pReport));
         }
         else {
             KinBodyConstPtr pbody = openravepy::GetKinBody(o1);
             if( !!pbody ) {
+                openravepy::PythonThreadSaver threadsaver;
                 bCollision = _pCollisionChecker->CheckCollision(pbody,openravepy::GetCollisionReport(pReport));
             }
             else {
@@ -235,15 +249,21 @@ public:
         if( !!plink ) {
             KinBody::LinkConstPtr plink2 = openravepy::GetKinBodyLinkConst(o2);
             if( !!plink2 ) {
+                openravepy::PythonThreadSaver threadsaver;
                 return _pCollisionChecker->CheckCollision(plink,plink2);
             }
             KinBodyConstPtr pbody2 = openravepy::GetKinBody(o2);
             if( !!pbody2 ) {
+                openravepy::PythonThreadSaver threadsaver;
                 return _pCollisionChecker->CheckCollision(plink,pbody2);
             }
             CollisionReportPtr preport2 = openravepy::GetCollisionReport(o2);
             if( !!preport2 ) {
-                bool bCollision = _pCollisionChecker->CheckCollision(plink,preport2);
+                bool bCollision;
+                {
+                    openravepy::PythonThreadSaver threadsaver;
+                    bCollision = _pCollisionChecker->CheckCollision(plink,preport2);
+                }
                 openravepy::UpdateCollisionReport(o2,_pyenv);
                 return bCollision;
             }
@@ -253,15 +273,21 @@ public:
         if( !!pbody ) {
             KinBody::LinkConstPtr plink2 = openravepy::GetKinBodyLinkConst(o2);
             if( !!plink2 ) {
+                openravepy::PythonThreadSaver threadsaver;
                 return _pCollisionChecker->CheckCollision(plink2,pbody);
             }
             KinBodyConstPtr pbody2 = openravepy::GetKinBody(o2);
             if( !!pbody2 ) {
+                openravepy::PythonThreadSaver threadsaver;
                 return _pCollisionChecker->CheckCollision(pbody,pbody2);
             }
             CollisionReportPtr preport2 = openravepy::GetCollisionReport(o2);
             if( !!preport2 ) {
-                bool bCollision = _pCollisionChecker->CheckCollision(pbody,preport2);
+                bool bCollision;
+                {
+                    openravepy::PythonThreadSaver threadsaver;
+                    bCollision = _pCollisionChecker->CheckCollision(pbody,preport2);
+                }
                 openravepy::UpdateCollisionReport(o2,_pyenv);
                 return bCollision;
             }
@@ -278,11 +304,13 @@ public:
         if( !!plink ) {
             KinBody::LinkConstPtr plink2 = openravepy::GetKinBodyLinkConst(o2);
             if( !!plink2 ) {
+                openravepy::PythonThreadSaver threadsaver;
                 bCollision = _pCollisionChecker->CheckCollision(plink,plink2, openravepy::GetCollisionReport(pReport));
             }
             else {
                 KinBodyConstPtr pbody2 = openravepy::GetKinBody(o2);
                 if( !!pbody2 ) {
+                    openravepy::PythonThreadSaver threadsaver;
                     bCollision = _pCollisionChecker->CheckCollision(plink,pbody2, openravepy::GetCollisionReport(pReport));
                 }
                 else {
@@ -295,11 +323,13 @@ public:
             if( !!pbody ) {
                 KinBody::LinkConstPtr plink2 = openravepy::GetKinBodyLinkConst(o2);
                 if( !!plink2 ) {
+                    openravepy::PythonThreadSaver threadsaver;
                     bCollision = _pCollisionChecker->CheckCollision(plink2,pbody, openravepy::GetCollisionReport(pReport));
                 }
                 else {
                     KinBodyConstPtr pbody2 = openravepy::GetKinBody(o2);
                     if( !!pbody2 ) {
+                        openravepy::PythonThreadSaver threadsaver;
                         bCollision = _pCollisionChecker->CheckCollision(pbody,pbody2, openravepy::GetCollisionReport(pReport));
                     }
                     else {
@@ -322,10 +352,12 @@ public:
         KinBodyConstPtr pbody2 = openravepy::GetKinBody(pybody2);
         KinBody::LinkConstPtr plink = openravepy::GetKinBodyLinkConst(o1);
         if( !!plink ) {
+            openravepy::PythonThreadSaver threadsaver;
             return _pCollisionChecker->CheckCollision(plink,pbody2);
         }
         KinBodyConstPtr pbody1 = openravepy::GetKinBody(o1);
         if( !!pbody1 ) {
+            openravepy::PythonThreadSaver threadsaver;
             return _pCollisionChecker->CheckCollision(pbody1,pbody2);
         }
         throw OPENRAVE_EXCEPTION_FORMAT0(_("CheckCollision(object) invalid argument"),ORE_InvalidArguments);
@@ -339,11 +371,13 @@ public:
         KinBody::LinkConstPtr plink = openravepy::GetKinBodyLinkConst(o1);
         bool bCollision = false;
         if( !!plink ) {
+            openravepy::PythonThreadSaver threadsaver;
             bCollision = _pCollisionChecker->CheckCollision(plink,pbody2,openravepy::GetCollisionReport(pReport));
         }
         else {
             KinBodyConstPtr pbody1 = openravepy::GetKinBody(o1);
             if( !!pbody1 ) {
+                openravepy::PythonThreadSaver threadsaver;
                 bCollision = _pCollisionChecker->CheckCollision(pbody1,pbody2,openravepy::GetCollisionReport(pReport));
             }
             else {
@@ -385,9 +419,11 @@ public:
             }
         }
         if( !!plink1 ) {
+            openravepy::PythonThreadSaver threadsaver;
             return _pCollisionChecker->CheckCollision(plink1,vbodyexcluded,vlinkexcluded);
         }
         else if( !!pbody1 ) {
+            openravepy::PythonThreadSaver threadsaver;
             return _pCollisionChecker->CheckCollision(pbody1,vbodyexcluded,vlinkexcluded);
         }
         else {
@@ -423,9 +459,11 @@ public:
 
         bool bCollision=false;
         if( !!plink1 ) {
+            openravepy::PythonThreadSaver threadsaver;
             bCollision = _pCollisionChecker->CheckCollision(plink1, vbodyexcluded, vlinkexcluded, openravepy::GetCollisionReport(pReport));
         }
         else if( !!pbody1 ) {
+            openravepy::PythonThreadSaver threadsaver;
             bCollision = _pCollisionChecker->CheckCollision(pbody1, vbodyexcluded, vlinkexcluded, openravepy::GetCollisionReport(pReport));
         }
         else {
@@ -458,6 +496,7 @@ public:
                 RAVELOG_ERROR("failed to get excluded link\n");
             }
         }
+        openravepy::PythonThreadSaver threadsaver;
         return _pCollisionChecker->CheckCollision(KinBodyConstPtr(openravepy::GetKinBody(pbody)),vbodyexcluded,vlinkexcluded);
     }
 
@@ -484,23 +523,60 @@ public:
             }
         }
 
-        bool bCollision = _pCollisionChecker->CheckCollision(KinBodyConstPtr(openravepy::GetKinBody(pbody)), vbodyexcluded, vlinkexcluded, openravepy::GetCollisionReport(pReport));
+        bool bCollision;
+        {
+            openravepy::PythonThreadSaver threadsaver;
+            bCollision = _pCollisionChecker->CheckCollision(KinBodyConstPtr(openravepy::GetKinBody(pbody)), vbodyexcluded, vlinkexcluded, openravepy::GetCollisionReport(pReport));
+        }
         openravepy::UpdateCollisionReport(pReport,_pyenv);
         return bCollision;
     }
 
     bool CheckCollision(boost::shared_ptr<PyRay> pyray, PyKinBodyPtr pbody)
     {
+        openravepy::PythonThreadSaver threadsaver;
         return _pCollisionChecker->CheckCollision(pyray->r,KinBodyConstPtr(openravepy::GetKinBody(pbody)));
     }
 
     bool CheckCollision(boost::shared_ptr<PyRay> pyray, PyKinBodyPtr pbody, PyCollisionReportPtr pReport)
     {
-        bool bCollision = _pCollisionChecker->CheckCollision(pyray->r, KinBodyConstPtr(openravepy::GetKinBody(pbody)), openravepy::GetCollisionReport(pReport));
+        bool bCollision;
+        {
+            openravepy::PythonThreadSaver threadsaver;
+            bCollision = _pCollisionChecker->CheckCollision(pyray->r, KinBodyConstPtr(openravepy::GetKinBody(pbody)), openravepy::GetCollisionReport(pReport));
+        }
         openravepy::UpdateCollisionReport(pReport,_pyenv);
         return bCollision;
     }
 
+    object CheckCollisionBatch(PyKinBodyPtr pybody, object oconfigs, object odofindices=object(), bool bcheckself=false)
+    {
+        KinBodyPtr pbody = openravepy::GetKinBody(pybody);
+        std::vector<int> vdofindices;
+        if( !IS_PYTHONOBJECT_NONE(odofindices) ) {
+            vdofindices = ExtractArray<int>(odofindices);
+        }
+        size_t numvalues = vdofindices.size() > 0 ? vdofindices.size() : (size_t)pbody->GetDOF();
+        size_t numconfigs = 0;
+        object oholder;
+        const dReal* pconfigs = GetPyArrayConfigurations(oconfigs, numvalues, numconfigs, oholder);
+        npy_intp dims[] = { (npy_intp)numconfigs };
+        PyObject* pycollision = PyArray_SimpleNew(1, dims, PyArray_BOOL);
+        object ocollision = static_cast<numeric::array>(handle<>(pycollision));
+        bool* pcollision = (bool*)PyArray_DATA((PyArrayObject*)pycollision);
+        if( numconfigs > 0 ) {
+            std::vector<uint8_t> vresults;
+            {
+                openravepy::PythonThreadSaver threadsaver;
+                _pCollisionChecker->CheckCollisionBatch(pbody, vdofindices, pconfigs, numconfigs, vresults, bcheckself);
+            }
+            for(size_t i = 0; i < numconfigs; ++i) {
+                pcollision[i] = vresults.at(i) != 0;
+            }
+        }
+        return ocollision;
+    }
+
     object CheckCollisionRays(object rays, PyKinBodyPtr pbody,bool bFrontFacingOnly=false)
     {
         object shape = rays.attr("shape");
@@ -553,14 +629,84 @@ public:
         return boost::python::make_tuple(static_cast<numeric::array>(handle<>(pycollision)),static_cast<numeric::array>(handle<>(pypos)));
     }
 
+    object CheckCollisionRayDistances(object rays)
+    {
+        object shape = rays.attr("shape");
+        int num = extract<int>(shape[0]);
+        std::vector<RAY> vrays(num);
+        if( num > 0 && extract<int>(shape[1]) != 6 ) {
+            throw openrave_exception(_("rays object needs to be a Nx6 vector\n"));
+        }
+        for(int i = 0; i < num; ++i) {
+            vector<dReal> ray = ExtractArray<dReal>(rays[i]);
+            vrays[i].pos = Vector(ray[0], ray[1], ray[2]);
+            vrays[i].dir = Vector(ray[3], ray[4], ray[5]);
+        }
+        std::vector<dReal> vdistances;
+        std::vector<KinBody::LinkConstPtr> vhitlinks;
+        {
+            openravepy::PythonThreadSaver threadsaver;
+            _pCollisionChecker->CheckCollisionRays(vrays, vdistances, vhitlinks);
+        }
+        return toPyArray(vdistances);
+    }
+
+    object ComputeDistance(PyKinBodyPtr pybody1, PyKinBodyPtr pybody2=PyKinBodyPtr())
+    {
+        DistanceReport report;
+        bool bComputed;
+        {
+            openravepy::PythonThreadSaver threadsaver;
+            if( !!pybody2 ) {
+                bComputed = _pCollisionChecker->ComputeDistance(KinBodyConstPtr(openravepy::GetKinBody(pybody1)), KinBodyConstPtr(openravepy::GetKinBody(pybody2)), report);
+            }
+            else {
+                bComputed = _pCollisionChecker->ComputeDistance(KinBodyConstPtr(openravepy::GetKinBody(pybody1)), report);
+            }
+        }
+        if( !bComputed ) {
+            return object();
+        }
+        object plink1, plink2;
+        if( !!report.plink1 ) {
+            plink1 = openravepy::toPyKinBodyLink(boost::const_pointer_cast<KinBody::Link>(report.plink1), _pyenv);
+        }
+        if( !!report.plink2 ) {
+            plink2 = openravepy::toPyKinBodyLink(boost::const_pointer_cast<KinBody::Link>(report.plink2), _pyenv);
+        }
+        return boost::python::make_tuple(report.distance, plink1, plink2);
+    }
+
+    object CheckContinuousCollision(PyKinBodyPtr pybody, object odofindices, object ostart, object oend, dReal fdistancetolerance=0.001)
+    {
+        std::vector<int> dofindices = ExtractArray<int>(odofindices);
+        std::vector<dReal> vstart = ExtractArray<dReal>(ostart);
+        std::vector<dReal> vend = ExtractArray<dReal>(oend);
+        dReal fcollisiontime = 0;
+        bool bCollision;
+        {
+            openravepy::PythonThreadSaver threadsaver;
+            bCollision = _pCollisionChecker->CheckContinuousCollision(openravepy::GetKinBody(pybody), dofindices, vstart, vend, fcollisiontime, fdistancetolerance);
+        }
+        if( !bCollision ) {
+            return object();
+        }
+        return object(fcollisiontime);
+    }
+
     bool CheckCollision(boost::shared_ptr<PyRay> pyray)
     {
+        openravepy::PythonThreadSaver threadsaver;
         return _pCollisionChecker->CheckCollision(pyray->r);
     }
 
     bool CheckCollision(boost::shared_ptr<PyRay> pyray, PyCollisionReportPtr pReport)
     {
-        bool bCollision = _pCollisionChecker->CheckCollision(pyray->r, openravepy::GetCollisionReport(pReport));
+        bool bCollision;
+        {
+            openravepy::PythonThreadSaver threadsaver;
+            bCollision = _pCollisionChecker->CheckCollision(pyray->r, openravepy::GetCollisionReport(pReport));
+        }
         openravepy::UpdateCollisionReport(pReport,_pyenv);
         return bCollision;
     }
@@ -571,9 +717,11 @@ public:
         KinBodyConstPtr pbody1 = openravepy::GetKinBody(o1);
         bool bCollision;
         if( !!plink1 ) {
+            openravepy::PythonThreadSaver threadsaver;
             bCollision = _pCollisionChecker->CheckSelfCollision(plink1, openravepy::GetCollisionReport(pReport));
         }
         else if( !!pbody1 ) {
+            openravepy::PythonThreadSaver threadsaver;
             bCollision = _pCollisionChecker->CheckSelfCollision(pbody1, openravepy::GetCollisionReport(pReport));
         }
         else {
@@ -646,6 +794,9 @@ PyCollisionCheckerBasePtr RaveCreateCollisionChecker(PyEnvironmentBasePtr pyenv,
 }
 
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(CheckCollisionRays_overloads, CheckCollisionRays, 2, 3)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(CheckCollisionBatch_overloads, CheckCollisionBatch, 2, 4)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(ComputeDistance_overloads, ComputeDistance, 1, 2)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(CheckContinuousCollision_overloads, CheckContinuousCollision, 4, 5)
 
 void init_openravepy_collisionchecker()
 {
@@ -730,9 +881,13 @@ void init_openravepy_collisionchecker()
     .def("CheckCollision",pcoly,args("ray"), DOXY_FN(CollisionCheckerBase,CheckCollision "const RAY; CollisionReportPtr"))
     .def("CheckCollision",pcolyr,args("ray", "report"), DOXY_FN(CollisionCheckerBase,CheckCollision "const RAY; CollisionReportPtr"))
     .def("CheckSelfCollision",&PyCollisionCheckerBase::CheckSelfCollision,args("linkbody", "report"), DOXY_FN(CollisionCheckerBase,CheckSelfCollision "KinBodyConstPtr, CollisionReportPtr"))
+    .def("CheckCollisionBatch",&PyCollisionCheckerBase::CheckCollisionBatch, CheckCollisionBatch_overloads(args("body","configs","dofindices","checkself"), "Checks the collision of body with the environment for every row of the (N,dof) array configs without the GIL, returns an array of N booleans. If dofindices is set, the configurations only set those dofs. If checkself is true, self collisions are reported too. The state of the body is restored."))
     .def("CheckCollisionRays",&PyCollisionCheckerBase::CheckCollisionRays,
          CheckCollisionRays_overloads(args("rays","body","front_facing_only"),
                                       "Check if any rays hit the body and returns their contact points along with a vector specifying if a collision occured or not. Rays is a Nx6 array, first 3 columsn are position, last 3 are direction+range."))
+    .def("CheckCollisionRayDistances",&PyCollisionCheckerBase::CheckCollisionRayDistances,args("rays"), DOXY_FN(CollisionCheckerBase,CheckCollisionRays))
+    .def("ComputeDistance",&PyCollisionCheckerBase::ComputeDistance, ComputeDistance_overloads(args("body1","body2"), "Computes the minimum distance between body1 and body2, or between body1 and the environment if body2 is None.\n\n:return: (distance, link1, link2) or None if the checker does not support distance queries\n\n"))
+    .def("CheckContinuousCollision",&PyCollisionCheckerBase::CheckContinuousCollision, CheckContinuousCollision_overloads(args("body","dofindices","start","end","distancetolerance"), "Checks if body collides with the environment while its dofindices move linearly from start to end. Self-collisions are not checked.\n\n:return: the path parameter in [0,1] of the first contact, or None if there is no collision\n\n"))
     ;
 
     def("RaveCreateCollisionChecker",openravepy::RaveCreateCollisionChecker,args("env","name"),DOXY_FN1(RaveCreateCollisionChecker));
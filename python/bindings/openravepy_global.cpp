@@ -959,10 +959,11 @@ object poseTransformPoints(object opose, object opoints)
     npy_intp dims[] = { N,3};
     PyObject *pytrans = PyArray_SimpleNew(2,dims, sizeof(dReal)==8 ? PyArray_DOUBLE : PyArray_FLOAT);
     dReal* ptrans = (dReal*)PyArray_DATA(pytrans);
-    for(int i = 0; i < N; ++i, ptrans += 3) {
-        Vector newpoint = t*ExtractVector3(opoints[i]);
-        ptrans[0] = newpoint.x; ptrans[1] = newpoint.y; ptrans[2] = newpoint.z;
+    for(int i = 0; i < N; ++i) {
+        Vector point = ExtractVector3(opoints[i]);
+        ptrans[3*i+0] = point.x; ptrans[3*i+1] = point.y; ptrans[3*i+2] = point.z;
     }
+    OpenRAVE::geometry::transformPoints(t, ptrans, ptrans, N);
     return static_cast<numeric::array>(handle<>(pytrans));
 }
 
@@ -1046,6 +1047,8 @@ void init_openravepy_global()
     .value("RobotManipulators",SO_RobotManipulators)
     .value("RobotSensors",SO_RobotSensors)
     .value("Geometry",SO_Geometry)
+    .value("InverseKinematics",SO_InverseKinematics)
+    .value("BinaryTrajectory",SO_BinaryTrajectory)
     ;
     enum_<InterfaceType>("InterfaceType" DOXY_ENUM(InterfaceType))
     .value(RaveGetInterfaceName(PT_Planner).c_str(),PT_Planner)
@@ -1070,6 +1073,7 @@ void init_openravepy_global()
     .value("RealControllers",Clone_RealControllers)
     .value("Sensors",Clone_Sensors)
     .value("Modules",Clone_Modules)
+    .value("SkipUnchangedBodies",Clone_SkipUnchangedBodies)
     ;
     enum_<PhysicsEngineOptions>("PhysicsEngineOptions" DOXY_ENUM(PhysicsEngineOptions))
     .value("SelfCollisions",PEO_SelfCollisions)
@@ -1094,6 +1098,7 @@ void init_openravepy_global()
     class_<PyGraphHandle, boost::shared_ptr<PyGraphHandle> >("GraphHandle", DOXY_CLASS(GraphHandle), no_init)
     .def("SetTransform",&PyGraphHandle::SetTransform,DOXY_FN(GraphHandle,SetTransform))
     .def("SetShow",&PyGraphHandle::SetShow,DOXY_FN(GraphHandle,SetShow))
+    .def("SetPoints",&PyGraphHandle::SetPoints,args("points"),DOXY_FN(GraphHandle,SetPoints))
     .def("Close",&PyGraphHandle::Close,DOXY_FN(GraphHandle,Close))
     ;
 
@@ -232,6 +232,29 @@ public:
         return _param.ComputeDistanceSqr(pyikparam->_param);
     }
 
+    object ComputeDistancesSqr(object ovalues)
+    {
+        // accepts a Nx(number of values) array as well as a flat one
+        std::vector<dReal> vvalues = ExtractArray<dReal>(numeric::array(ovalues).attr("flatten")());
+        std::vector<dReal> vdists;
+        _param.ComputeDistancesSqr(vvalues, vdists);
+        return toPyArray(vdists);
+    }
+
+    object SerializeBinary() const
+    {
+        std::stringstream ss(std::ios::out|std::ios::binary);
+        _param.SerializeBinary(ss);
+        std::string s = ss.str();
+        return boost::python::str(s.c_str(), s.size());
+    }
+
+    void DeserializeBinary(const std::string& s)
+    {
+        std::stringstream ss(s, std::ios::in|std::ios::binary);
+        _param.DeserializeBinary(ss);
+    }
+
     object Transform(object otrans) const
     {
         return toPyIkParameterization(ExtractTransform(otrans) * _param);
@@ -459,6 +482,9 @@ void init_openravepy_ikparameterization()
                                    .def("GetConfigurationSpecificationFromType", PyIkParameterization::GetConfigurationSpecificationFromType, GetConfigurationSpecificationFromType_overloads(args("type","interpolation","robotname","manipname"), DOXY_FN(IkParameterization,GetConfigurationSpecification)))
                                    .staticmethod("GetConfigurationSpecificationFromType")
                                    .def("ComputeDistanceSqr",&PyIkParameterization::ComputeDistanceSqr,DOXY_FN(IkParameterization,ComputeDistanceSqr))
+                                   .def("ComputeDistancesSqr",&PyIkParameterization::ComputeDistancesSqr,args("values"),DOXY_FN(IkParameterization,ComputeDistancesSqr))
+                                   .def("SerializeBinary",&PyIkParameterization::SerializeBinary,DOXY_FN(IkParameterization,SerializeBinary))
+                                   .def("DeserializeBinary",&PyIkParameterization::DeserializeBinary,args("data"),DOXY_FN(IkParameterization,DeserializeBinary))
                                    .def("Transform",&PyIkParameterization::Transform,"Returns a new parameterization with transformed by the transformation T (T * ik)")
                                    .def("MultiplyTransform",&PyIkParameterization::MultiplyTransform,DOXY_FN(IkParameterization,MultiplyTransform))
                                    .def("MultiplyTransformRight",&PyIkParameterization::MultiplyTransformRight,DOXY_FN(IkParameterization,MultiplyTransformRight))
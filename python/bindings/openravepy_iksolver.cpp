@@ -73,35 +73,36 @@ class PyIkSolverBase : public PyInterfaceBase
 protected:
     IkSolverBasePtr _pIkSolver;
 
-    static IkReturn _CallCustomFilter(object fncallback, PyEnvironmentBasePtr pyenv, IkSolverBasePtr pIkSolver, std::vector<dReal>& values, RobotBase::ManipulatorConstPtr pmanip, const IkParameterization& ikparam)
+    static IkReturn _CallCustomFilter(const object& fncallback, PyEnvironmentBasePtr pyenv, IkSolverBasePtr pIkSolver, std::vector<dReal>& values, RobotBase::ManipulatorConstPtr pmanip, const IkParameterization& ikparam)
     {
-        object res;
-        PyGILState_STATE gstate = PyGILState_Ensure();
         std::string errmsg;
-        try {
-            RobotBase::ManipulatorPtr pmanip2 = boost::const_pointer_cast<RobotBase::Manipulator>(pmanip);
-            res = fncallback(toPyArray(values), openravepy::toPyRobotManipulator(pmanip2,pyenv),toPyIkParameterization(ikparam));
-        }
-        catch(...) {
-            errmsg = boost::str(boost::format("exception occured in python custom filter callback of iksolver %s: %s")%pIkSolver->GetXMLId()%GetPyErrorString());
-        }
         IkReturn ikfr(IKRA_Success);
-        if( IS_PYTHONOBJECT_NONE(res) ) {
-            ikfr._action = IKRA_Reject;
-        }
-        else {
-            if( !openravepy::ExtractIkReturn(res,ikfr) ) {
-                extract<IkReturnAction> ikfra(res);
-                if( ikfra.check() ) {
-                    ikfr._action = (IkReturnAction)ikfra;
-                }
-                else {
-                    errmsg = "failed to convert return type of filter to IkReturn";
+        {
+            // the solver might be called with the GIL released
+            PythonGILEnsurer gilensurer;
+            object res;
+            try {
+                RobotBase::ManipulatorPtr pmanip2 = boost::const_pointer_cast<RobotBase::Manipulator>(pmanip);
+                res = fncallback(toPyArray(values), openravepy::toPyRobotManipulator(pmanip2,pyenv),toPyIkParameterization(ikparam));
+            }
+            catch(...) {
+                errmsg = boost::str(boost::format("exception occured in python custom filter callback of iksolver %s: %s")%pIkSolver->GetXMLId()%GetPyErrorString());
+            }
+            if( IS_PYTHONOBJECT_NONE(res) ) {
+                ikfr._action = IKRA_Reject;
+            }
+            else {
+                if( !openravepy::ExtractIkReturn(res,ikfr) ) {
+                    extract<IkReturnAction> ikfra(res);
+                    if( ikfra.check() ) {
+                        ikfr._action = (IkReturnAction)ikfra;
+                    }
+                    else {
+                        errmsg = "failed to convert return type of filter to IkReturn";
+                    }
                 }
             }
         }
-
-        PyGILState_Release(gstate);
         if( errmsg.size() > 0 ) {
             throw openrave_exception(errmsg,ORE_Assert);
         }
@@ -142,7 +143,10 @@ public:
         if( !ExtractIkParameterization(oparam,ikparam) ) {
             throw openrave_exception(_("first argument to IkSolver.Solve needs to be IkParameterization"),ORE_InvalidArguments);
         }
-        _pIkSolver->Solve(ikparam, q0, filteroptions, preturn);
+        {
+            openravepy::PythonThreadSaver threadsaver;
+            _pIkSolver->Solve(ikparam, q0, filteroptions, preturn);
+        }
         return pyreturn;
     }
 
@@ -154,13 +158,40 @@ public:
         if( !ExtractIkParameterization(oparam,ikparam) ) {
             throw openrave_exception(_("first argument to IkSolver.Solve needs to be IkParameterization"),ORE_InvalidArguments);
         }
-        _pIkSolver->SolveAll(ikparam, filteroptions, vikreturns);
+        {
+            openravepy::PythonThreadSaver threadsaver;
+            _pIkSolver->SolveAll(ikparam, filteroptions, vikreturns);
+        }
         FOREACH(itikreturn,vikreturns) {
             pyreturns.append(object(PyIkReturnPtr(new PyIkReturn(*itikreturn))));
         }
         return pyreturns;
     }
 
+    object SolveAllBatch(object oparams, int filteroptions)
+    {
+        std::vector<IkParameterization> vikparams(len(oparams));
+        for(size_t i = 0; i < vikparams.size(); ++i) {
+            if( !ExtractIkParameterization(oparams[i],vikparams[i]) ) {
+                throw openrave_exception(_("first argument to IkSolver.SolveAllBatch needs to be a list of IkParameterization"),ORE_InvalidArguments);
+            }
+        }
+        std::vector< std::vector<IkReturnPtr> > vikreturns;
+        {
+            openravepy::PythonThreadSaver threadsaver;
+            _pIkSolver->SolveAllBatch(vikparams, filteroptions, vikreturns);
+        }
+        boost::python::list pyreturns;
+        FOREACH(itikreturns,vikreturns) {
+            boost::python::list pyikreturns;
+            FOREACH(itikreturn,*itikreturns) {
+                pyikreturns.append(object(PyIkReturnPtr(new PyIkReturn(*itikreturn))));
+            }
+            pyreturns.append(pyikreturns);
+        }
+        return pyreturns;
+    }
+
     PyIkReturnPtr Solve(object oparam, object oq0, object oFreeParameters, int filteroptions)
     {
         PyIkReturnPtr pyreturn(new PyIkReturn(IKRA_Reject));
@@ -176,7 +207,10 @@ public:
         if( !ExtractIkParameterization(oparam,ikparam) ) {
             throw openrave_exception(_("first argument to IkSolver.Solve needs to be IkParameterization"),ORE_InvalidArguments);
         }
-        _pIkSolver->Solve(ikparam, q0, vFreeParameters,filteroptions, preturn);
+        {
+            openravepy::PythonThreadSaver threadsaver;
+            _pIkSolver->Solve(ikparam, q0, vFreeParameters,filteroptions, preturn);
+        }
         return pyreturn;
     }
 
@@ -192,7 +226,10 @@ public:
         if( !IS_PYTHONOBJECT_NONE(oFreeParameters) ) {
             vFreeParameters = ExtractArray<dReal>(oFreeParameters);
         }
-        _pIkSolver->SolveAll(ikparam, vFreeParameters, filteroptions, vikreturns);
+        {
+            openravepy::PythonThreadSaver threadsaver;
+            _pIkSolver->SolveAll(ikparam, vFreeParameters, filteroptions, vikreturns);
+        }
         FOREACH(itikreturn,vikreturns) {
             pyreturns.append(object(PyIkReturnPtr(new PyIkReturn(*itikreturn))));
         }
@@ -307,6 +344,7 @@ void init_openravepy_iksolver()
         .def("Solve",SolveFree,args("ikparam","q0","freeparameters", "filteroptions"), DOXY_FN(IkSolverBase, Solve "const IkParameterization&; const std::vector; const std::vector; int; IkReturnPtr"))
         .def("SolveAll",SolveAll,args("ikparam","filteroptions"), DOXY_FN(IkSolverBase, SolveAll "const IkParameterization&; int; std::vector<IkReturnPtr>"))
         .def("SolveAll",SolveAllFree,args("ikparam","freeparameters","filteroptions"), DOXY_FN(IkSolverBase, SolveAll "const IkParameterization&; const std::vector; int; std::vector<IkReturnPtr>"))
+        .def("SolveAllBatch",&PyIkSolverBase::SolveAllBatch,args("ikparams","filteroptions"), DOXY_FN(IkSolverBase, SolveAllBatch))
         .def("GetNumFreeParameters",&PyIkSolverBase::GetNumFreeParameters, DOXY_FN(IkSolverBase,GetNumFreeParameters))
         .def("GetFreeParameters",&PyIkSolverBase::GetFreeParameters, DOXY_FN(IkSolverBase,GetFreeParameters))
         .def("Supports",&PyIkSolverBase::Supports, args("iktype"), DOXY_FN(IkSolverBase,Supports))
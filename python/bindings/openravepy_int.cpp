@@ -465,10 +465,9 @@ protected:
         return PyInterfaceBasePtr();
     }
 
-    void _BodyCallback(object fncallback, KinBodyPtr pbody, int action)
+    void _BodyCallback(const object& fncallback, KinBodyPtr pbody, int action)
     {
-        object res;
-        PyGILState_STATE gstate = PyGILState_Ensure();
+        PythonGILEnsurer gilensurer;
         try {
             fncallback(openravepy::toPyKinBody(pbody, shared_from_this()), action);
         }
@@ -476,13 +475,13 @@ protected:
             RAVELOG_ERROR("exception occured in python body callback:\n");
             PyErr_Print();
         }
-        PyGILState_Release(gstate);
     }
 
-    CollisionAction _CollisionCallback(object fncallback, CollisionReportPtr preport, bool bFromPhysics)
+    CollisionAction _CollisionCallback(const object& fncallback, CollisionReportPtr preport, bool bFromPhysics)
     {
+        // collision checks might be called with the GIL released
+        PythonGILEnsurer gilensurer;
         object res;
-        PyGILState_STATE gstate = PyGILState_Ensure();
         try {
             res = fncallback(openravepy::toPyCollisionReport(preport,shared_from_this()),bFromPhysics);
         }
@@ -504,7 +503,6 @@ protected:
                 RAVELOG_WARN("collision callback nothing returning, so executing default action\n");
             }
         }
-        PyGILState_Release(gstate);
         return ret;
     }
 
@@ -531,6 +529,18 @@ public:
     void Reset() {
         _penv->Reset();
     }
+
+    object SendCommand(const string& in)
+    {
+        stringstream sin(in), sout;
+        {
+            openravepy::PythonThreadSaver statesaver;
+            if( !_penv->SendCommand(sout,sin) ) {
+                return object();
+            }
+        }
+        return object(sout.str());
+    }
     void Destroy() {
         GetViewerManager()->RemoveViewersOfEnvironment(_penv);        
         _penv->Destroy();
@@ -577,12 +587,17 @@ public:
     bool CheckCollision(PyKinBodyPtr pbody1)
     {
         CHECK_POINTER(pbody1);
+        openravepy::PythonThreadSaver threadsaver;
         return _penv->CheckCollision(KinBodyConstPtr(openravepy::GetKinBody(pbody1)));
     }
     bool CheckCollision(PyKinBodyPtr pbody1, PyCollisionReportPtr pReport)
     {
         CHECK_POINTER(pbody1);
-        bool bCollision = _penv->CheckCollision(KinBodyConstPtr(openravepy::GetKinBody(pbody1)), openravepy::GetCollisionReport(pReport));
+        bool bCollision;
+        {
+            openravepy::PythonThreadSaver threadsaver;
+            bCollision = _penv->CheckCollision(KinBodyConstPtr(openravepy::GetKinBody(pbody1)), openravepy::GetCollisionReport(pReport));
+        }
         openravepy::UpdateCollisionReport(pReport,shared_from_this());
         return bCollision;
     }
@@ -591,6 +606,7 @@ public:
     {
         CHECK_POINTER(pbody1);
         CHECK_POINTER(pbody2);
+        openravepy::PythonThreadSaver threadsaver;
         return _penv->CheckCollision(KinBodyConstPtr(openravepy::GetKinBody(pbody1)), KinBodyConstPtr(openravepy::GetKinBody(pbody2)));
     }
 
@@ -598,7 +614,11 @@ public:
     {
         CHECK_POINTER(pbody1);
         CHECK_POINTER(pbody2);
-        bool bCollision = _penv->CheckCollision(KinBodyConstPtr(openravepy::GetKinBody(pbody1)), KinBodyConstPtr(openravepy::GetKinBody(pbody2)), openravepy::GetCollisionReport(pReport));
+        bool bCollision;
+        {
+            openravepy::PythonThreadSaver threadsaver;
+            bCollision = _penv->CheckCollision(KinBodyConstPtr(openravepy::GetKinBody(pbody1)), KinBodyConstPtr(openravepy::GetKinBody(pbody2)), openravepy::GetCollisionReport(pReport));
+        }
         openravepy::UpdateCollisionReport(pReport,shared_from_this());
         return bCollision;
     }
@@ -608,10 +628,12 @@ public:
         CHECK_POINTER(o1);
         KinBody::LinkConstPtr plink = openravepy::GetKinBodyLinkConst(o1);
         if( !!plink ) {
+            openravepy::PythonThreadSaver threadsaver;
             return _penv->CheckCollision(plink);
         }
         KinBodyConstPtr pbody = openravepy::GetKinBody(o1);
         if( !!pbody ) {
+            openravepy::PythonThreadSaver threadsaver;
             return _penv->CheckCollision(pbody);
         }
         throw OPENRAVE_EXCEPTION_FORMAT0(_("CheckCollision(object) invalid argument"),ORE_InvalidArguments);
@@ -623,11 +645,13 @@ public:
         KinBody::LinkConstPtr plink = openravepy::GetKinBodyLinkConst(o1);
         bool bCollision;
         if( !!plink ) {
+            openravepy::PythonThreadSaver threadsaver;
             bCollision = _penv->CheckCollision(plink,openravepy::GetCollisionReport(pReport));
         }
         else {
             KinBodyConstPtr pbody = openravepy::GetKinBody(o1);
             if( !!pbody ) {
+                openravepy::PythonThreadSaver threadsaver;
                 bCollision = _penv->CheckCollision(pbody,openravepy::GetCollisionReport(pReport));
             }
             else {
@@ -646,15 +670,21 @@ public:
         if( !!plink ) {
             KinBody::LinkConstPtr plink2 = openravepy::GetKinBodyLinkConst(o2);
             if( !!plink2 ) {
+                openravepy::PythonThreadSaver threadsaver;
                 return _penv->CheckCollision(plink,plink2);
             }
             KinBodyConstPtr pbody2 = openravepy::GetKinBody(o2);
             if( !!pbody2 ) {
+                openravepy::PythonThreadSaver threadsaver;
                 return _penv->CheckCollision(plink,pbody2);
             }
             CollisionReportPtr preport2 = openravepy::GetCollisionReport(o2);
             if( !!preport2 ) {
-                bool bCollision = _penv->CheckCollision(plink,preport2);
+                bool bCollision;
+                {
+                    openravepy::PythonThreadSaver threadsaver;
+                    bCollision = _penv->CheckCollision(plink,preport2);
+                }
                 openravepy::UpdateCollisionReport(o2,shared_from_this());
                 return bCollision;
             }
@@ -664,15 +694,21 @@ public:
         if( !!pbody ) {
             KinBody::LinkConstPtr plink2 = openravepy::GetKinBodyLinkConst(o2);
             if( !!plink2 ) {
+                openravepy::PythonThreadSaver threadsaver;
                 return _penv->CheckCollision(plink2,pbody);
             }
             KinBodyConstPtr pbody2 = openravepy::GetKinBody(o2);
             if( !!pbody2 ) {
+                openravepy::PythonThreadSaver threadsaver;
                 return _penv->CheckCollision(pbody,pbody2);
             }
             CollisionReportPtr preport2 = openravepy::GetCollisionReport(o2);
             if( !!preport2 ) {
-                bool bCollision = _penv->CheckCollision(pbody,preport2);
+                bool bCollision;
+                {
+                    openravepy::PythonThreadSaver threadsaver;
+                    bCollision = _penv->CheckCollision(pbody,preport2);
+                }
                 openravepy::UpdateCollisionReport(o2,shared_from_this());
                 return bCollision;
             }
@@ -689,11 +725,13 @@ public:
         if( !!plink ) {
             KinBody::LinkConstPtr plink2 = openravepy::GetKinBodyLinkConst(o2);
             if( !!plink2 ) {
+                openravepy::PythonThreadSaver threadsaver;
                 bCollision = _penv->CheckCollision(plink,plink2, openravepy::GetCollisionReport(pReport));
             }
             else {
                 KinBodyConstPtr pbody2 = openravepy::GetKinBody(o2);
                 if( !!pbody2 ) {
+                    openravepy::PythonThreadSaver threadsaver;
                     bCollision = _penv->CheckCollision(plink,pbody2, openravepy::GetCollisionReport(pReport));
                 }
                 else {
@@ -706,11 +744,13 @@ public:
             if( !!pbody ) {
                 KinBody::LinkConstPtr plink2 = openravepy::GetKinBodyLinkConst(o2);
                 if( !!plink2 ) {
+                    openravepy::PythonThreadSaver threadsaver;
                     bCollision = _penv->CheckCollision(plink2,pbody, openravepy::GetCollisionReport(pReport));
                 }
                 else {
                     KinBodyConstPtr pbody2 = openravepy::GetKinBody(o2);
                     if( !!pbody2 ) {
+                        openravepy::PythonThreadSaver threadsaver;
                         bCollision = _penv->CheckCollision(pbody,pbody2, openravepy::GetCollisionReport(pReport));
                     }
                     else {
@@ -733,10 +773,12 @@ public:
         KinBodyConstPtr pbody2 = openravepy::GetKinBody(pybody2);
         KinBody::LinkConstPtr plink = openravepy::GetKinBodyLinkConst(o1);
         if( !!plink ) {
+            openravepy::PythonThreadSaver threadsaver;
             return _penv->CheckCollision(plink,pbody2);
         }
         KinBodyConstPtr pbody1 = openravepy::GetKinBody(o1);
         if( !!pbody1 ) {
+            openravepy::PythonThreadSaver threadsaver;
             return _penv->CheckCollision(pbody1,pbody2);
         }
         throw OPENRAVE_EXCEPTION_FORMAT0(_("CheckCollision(object) invalid argument"),ORE_InvalidArguments);
@@ -750,11 +792,13 @@ public:
         KinBody::LinkConstPtr plink = openravepy::GetKinBodyLinkConst(o1);
         bool bCollision = false;
         if( !!plink ) {
+            openravepy::PythonThreadSaver threadsaver;
             bCollision = _penv->CheckCollision(plink,pbody2,openravepy::GetCollisionReport(pReport));
         }
         else {
             KinBodyConstPtr pbody1 = openravepy::GetKinBody(o1);
             if( !!pbody1 ) {
+                openravepy::PythonThreadSaver threadsaver;
                 bCollision = _penv->CheckCollision(pbody1,pbody2,openravepy::GetCollisionReport(pReport));
             }
             else {
@@ -796,9 +840,11 @@ public:
             }
         }
         if( !!plink1 ) {
+            openravepy::PythonThreadSaver threadsaver;
             return _penv->CheckCollision(plink1,vbodyexcluded,vlinkexcluded);
         }
         else if( !!pbody1 ) {
+            openravepy::PythonThreadSaver threadsaver;
             return _penv->CheckCollision(pbody1,vbodyexcluded,vlinkexcluded);
         }
         else {
@@ -834,9 +880,11 @@ public:
 
         bool bCollision=false;
         if( !!plink1 ) {
+            openravepy::PythonThreadSaver threadsaver;
             bCollision = _penv->CheckCollision(plink1, vbodyexcluded, vlinkexcluded, openravepy::GetCollisionReport(pReport));
         }
         else if( !!pbody1 ) {
+            openravepy::PythonThreadSaver threadsaver;
             bCollision = _penv->CheckCollision(pbody1, vbodyexcluded, vlinkexcluded, openravepy::GetCollisionReport(pReport));
         }
         else {
@@ -869,6 +917,7 @@ public:
                 RAVELOG_ERROR("failed to get excluded link\n");
             }
         }
+        openravepy::PythonThreadSaver threadsaver;
         return _penv->CheckCollision(KinBodyConstPtr(openravepy::GetKinBody(pbody)),vbodyexcluded,vlinkexcluded);
     }
 
@@ -895,19 +944,28 @@ public:
             }
         }
 
-        bool bCollision = _penv->CheckCollision(KinBodyConstPtr(openravepy::GetKinBody(pbody)), vbodyexcluded, vlinkexcluded, openravepy::GetCollisionReport(pReport));
+        bool bCollision;
+        {
+            openravepy::PythonThreadSaver threadsaver;
+            bCollision = _penv->CheckCollision(KinBodyConstPtr(openravepy::GetKinBody(pbody)), vbodyexcluded, vlinkexcluded, openravepy::GetCollisionReport(pReport));
+        }
         openravepy::UpdateCollisionReport(pReport,shared_from_this());
         return bCollision;
     }
 
     bool CheckCollision(boost::shared_ptr<PyRay> pyray, PyKinBodyPtr pbody)
     {
+        openravepy::PythonThreadSaver threadsaver;
         return _penv->CheckCollision(pyray->r,KinBodyConstPtr(openravepy::GetKinBody(pbody)));
     }
 
     bool CheckCollision(boost::shared_ptr<PyRay> pyray, PyKinBodyPtr pbody, PyCollisionReportPtr pReport)
     {
-        bool bCollision = _penv->CheckCollision(pyray->r, KinBodyConstPtr(openravepy::GetKinBody(pbody)), openravepy::GetCollisionReport(pReport));
+        bool bCollision;
+        {
+            openravepy::PythonThreadSaver threadsaver;
+            bCollision = _penv->CheckCollision(pyray->r, KinBodyConstPtr(openravepy::GetKinBody(pbody)), openravepy::GetCollisionReport(pReport));
+        }
         openravepy::UpdateCollisionReport(pReport,shared_from_this());
         return bCollision;
     }
@@ -966,12 +1024,17 @@ public:
 
     bool CheckCollision(boost::shared_ptr<PyRay> pyray)
     {
+        openravepy::PythonThreadSaver threadsaver;
         return _penv->CheckCollision(pyray->r);
     }
 
     bool CheckCollision(boost::shared_ptr<PyRay> pyray, PyCollisionReportPtr pReport)
     {
-        bool bCollision = _penv->CheckCollision(pyray->r, openravepy::GetCollisionReport(pReport));
+        bool bCollision;
+        {
+            openravepy::PythonThreadSaver threadsaver;
+            bCollision = _penv->CheckCollision(pyray->r, openravepy::GetCollisionReport(pReport));
+        }
         openravepy::UpdateCollisionReport(pReport,shared_from_this());
         return bCollision;
     }
@@ -1227,6 +1290,46 @@ public:
         return _penv->IsSimulationRunning();
     }
 
+    void BeginBodyChangeBatch() {
+        _penv->BeginBodyChangeBatch();
+    }
+    void EndBodyChangeBatch() {
+        _penv->EndBodyChangeBatch();
+    }
+    bool IsBodyChangeBatchActive() {
+        return _penv->IsBodyChangeBatchActive();
+    }
+
+    void EnableBodies(object obodies, bool bEnable)
+    {
+        std::vector<KinBodyPtr> vbodies;
+        vbodies.reserve(len(obodies));
+        for(int i = 0; i < len(obodies); ++i) {
+            vbodies.push_back(openravepy::GetKinBody(obodies[i]));
+            if( !vbodies.back() ) {
+                throw OPENRAVE_EXCEPTION_FORMAT(_("body %d is not a KinBody"),i,ORE_InvalidArguments);
+            }
+        }
+        _penv->EnableBodies(vbodies, bEnable);
+    }
+
+    void SetBodiesLinkEnableStates(object obodies, object olinkenablestates)
+    {
+        std::vector<KinBodyPtr> vbodies;
+        std::vector< std::vector<uint8_t> > vlinkenablestates(len(olinkenablestates));
+        vbodies.reserve(len(obodies));
+        for(int i = 0; i < len(obodies); ++i) {
+            vbodies.push_back(openravepy::GetKinBody(obodies[i]));
+            if( !vbodies.back() ) {
+                throw OPENRAVE_EXCEPTION_FORMAT(_("body %d is not a KinBody"),i,ORE_InvalidArguments);
+            }
+        }
+        for(size_t i = 0; i < vlinkenablestates.size(); ++i) {
+            vlinkenablestates[i] = ExtractArray<uint8_t>(olinkenablestates[i]);
+        }
+        _penv->SetBodiesLinkEnableStates(vbodies, vlinkenablestates);
+    }
+
     void Lock()
     {
         // first try to lock without releasing the GIL since it is faster
@@ -1552,6 +1655,24 @@ public:
         return toPyGraphHandle(_penv->drawtrimesh(&vpoints[0],sizeof(float)*3,pindices,numTriangles,RaveVector<float>(1,0.5,0.5,1)));
     }
 
+    object ComputeBodiesAABB()
+    {
+        std::vector<KinBodyPtr> vbodies;
+        std::vector<AABB> vaabbs;
+        _penv->ComputeBodiesAABB(vbodies, vaabbs);
+        boost::python::list bodies, aabbs;
+        for(size_t i = 0; i < vbodies.size(); ++i) {
+            if( vbodies[i]->IsRobot() ) {
+                bodies.append(openravepy::toPyRobot(RaveInterfaceCast<RobotBase>(vbodies[i]),shared_from_this()));
+            }
+            else {
+                bodies.append(openravepy::toPyKinBody(vbodies[i],shared_from_this()));
+            }
+            aabbs.append(toPyAABB(vaabbs[i]));
+        }
+        return boost::python::make_tuple(bodies, aabbs);
+    }
+
     object GetBodies()
     {
         std::vector<KinBodyPtr> vbodies;
@@ -1620,6 +1741,67 @@ public:
         return ostates;
     }
 
+    uint64_t GetPublishedBodiesStamp() const
+    {
+        return _penv->GetPublishedBodiesStamp();
+    }
+
+    object WritePublishedBodiesDelta(uint64_t stamp=0)
+    {
+        std::stringstream ss;
+        uint64_t newstamp = _penv->WritePublishedBodiesDelta(ss, stamp);
+        return boost::python::make_tuple(newstamp, object(ss.str()));
+    }
+
+    object GetLockStatistics(bool bReset=false)
+    {
+        EnvironmentBase::LockStatistics stats;
+        _penv->GetLockStatistics(stats, bReset);
+        boost::python::dict ostats;
+        ostats["numEnvironmentContended"] = stats.numEnvironmentContended;
+        ostats["environmentWaitTime"] = stats.environmentWaitTime;
+        ostats["numInterfacesSharedContended"] = stats.numInterfacesSharedContended;
+        ostats["interfacesSharedWaitTime"] = stats.interfacesSharedWaitTime;
+        ostats["numInterfacesExclusiveContended"] = stats.numInterfacesExclusiveContended;
+        ostats["interfacesExclusiveWaitTime"] = stats.interfacesExclusiveWaitTime;
+        return ostats;
+    }
+
+    void SetSimulationSubsystemPeriod(EnvironmentBase::SimulationSubsystem subsystem, dReal period)
+    {
+        _penv->SetSimulationSubsystemPeriod(subsystem, period);
+    }
+
+    dReal GetSimulationSubsystemPeriod(EnvironmentBase::SimulationSubsystem subsystem)
+    {
+        return _penv->GetSimulationSubsystemPeriod(subsystem);
+    }
+
+    object GetSimulationStatistics(bool bReset=false)
+    {
+        EnvironmentBase::SimulationStatistics stats;
+        _penv->GetSimulationStatistics(stats, bReset);
+        boost::python::dict ostats;
+        ostats["numSteps"] = stats.numSteps;
+        ostats["numLateSteps"] = stats.numLateSteps;
+        ostats["simulationTime"] = stats.simulationTime;
+        ostats["realTime"] = stats.realTime;
+        ostats["realTimeFactor"] = stats.GetRealTimeFactor();
+        boost::python::list osubsystems;
+        for(int i = 0; i < EnvironmentBase::SS_NumSubsystems; ++i) {
+            const EnvironmentBase::SimulationStatistics::SubsystemStatistics& substats = stats.subsystems[i];
+            boost::python::dict osubstats;
+            osubstats["numSteps"] = substats.numSteps;
+            osubstats["numOverruns"] = substats.numOverruns;
+            osubstats["numSkippedTicks"] = substats.numSkippedTicks;
+            osubstats["totalStepTime"] = substats.totalStepTime;
+            osubstats["maxStepTime"] = substats.maxStepTime;
+            osubsystems.append(osubstats);
+        }
+        ostats["subsystems"] = osubsystems;
+        return ostats;
+    }
+
     object Triangulate(PyKinBodyPtr pbody)
     {
         CHECK_POINTER(pbody);
@@ -1817,6 +1999,9 @@ BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(Add_overloads, Add, 1, 3)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(Save_overloads, Save, 1, 3)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(GetUserData_overloads, GetUserData, 0, 1)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(GetPublishedBodies_overloads, GetPublishedBodies, 0, 1)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(WritePublishedBodiesDelta_overloads, WritePublishedBodiesDelta, 0, 1)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(GetLockStatistics_overloads, GetLockStatistics, 0, 1)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(GetSimulationStatistics_overloads, GetSimulationStatistics, 0, 1)
 
 object get_openrave_exception_unicode(openrave_exception* p)
 {
@@ -1979,6 +2164,7 @@ Because race conditions can pop up when trying to lock the openrave environment
         scope env = classenv
                     .def(init<optional<int> >(args("options")))
                     .def("Reset",&PyEnvironmentBase::Reset, DOXY_FN(EnvironmentBase,Reset))
+                    .def("SendCommand",&PyEnvironmentBase::SendCommand, args("cmd"), DOXY_FN(EnvironmentBase,SendCommand))
                     .def("Destroy",&PyEnvironmentBase::Destroy, DOXY_FN(EnvironmentBase,Destroy))
                     .def("CloneSelf",&PyEnvironmentBase::CloneSelf,args("options"), DOXY_FN(EnvironmentBase,CloneSelf))
                     .def("Clone",&PyEnvironmentBase::Clone,args("reference","options"), DOXY_FN(EnvironmentBase,Clone))
@@ -2066,7 +2252,15 @@ Because race conditions can pop up when trying to lock the openrave environment
                     .def("StartSimulation",&PyEnvironmentBase::StartSimulation,StartSimulation_overloads(args("timestep","realtime"), DOXY_FN(EnvironmentBase,StartSimulation)))
                     .def("StopSimulation",&PyEnvironmentBase::StopSimulation, StopSimulation_overloads(args("shutdownthread"), DOXY_FN(EnvironmentBase,StopSimulation)))
                     .def("GetSimulationTime",&PyEnvironmentBase::GetSimulationTime, DOXY_FN(EnvironmentBase,GetSimulationTime))
+                    .def("SetSimulationSubsystemPeriod",&PyEnvironmentBase::SetSimulationSubsystemPeriod,args("subsystem","period"), DOXY_FN(EnvironmentBase,SetSimulationSubsystemPeriod))
+                    .def("GetSimulationSubsystemPeriod",&PyEnvironmentBase::GetSimulationSubsystemPeriod,args("subsystem"), DOXY_FN(EnvironmentBase,GetSimulationSubsystemPeriod))
+                    .def("GetSimulationStatistics",&PyEnvironmentBase::GetSimulationStatistics, GetSimulationStatistics_overloads(args("reset"), DOXY_FN(EnvironmentBase,GetSimulationStatistics)))
                     .def("IsSimulationRunning",&PyEnvironmentBase::IsSimulationRunning, DOXY_FN(EnvironmentBase,IsSimulationRunning))
+                    .def("BeginBodyChangeBatch",&PyEnvironmentBase::BeginBodyChangeBatch, DOXY_FN(EnvironmentBase,BeginBodyChangeBatch))
+                    .def("EndBodyChangeBatch",&PyEnvironmentBase::EndBodyChangeBatch, DOXY_FN(EnvironmentBase,EndBodyChangeBatch))
+                    .def("IsBodyChangeBatchActive",&PyEnvironmentBase::IsBodyChangeBatchActive, DOXY_FN(EnvironmentBase,IsBodyChangeBatchActive))
+                    .def("EnableBodies",&PyEnvironmentBase::EnableBodies, args("bodies","enable"), DOXY_FN(EnvironmentBase,EnableBodies))
+                    .def("SetBodiesLinkEnableStates",&PyEnvironmentBase::SetBodiesLinkEnableStates, args("bodies","linkenablestates"), DOXY_FN(EnvironmentBase,SetBodiesLinkEnableStates))
                     .def("Lock",Lock1,"Locks the environment mutex.")
                     .def("Lock",Lock2,args("timeout"), "Locks the environment mutex with a timeout.")
                     .def("Unlock",&PyEnvironmentBase::Unlock,"Unlocks the environment mutex.")
@@ -2086,9 +2280,13 @@ Because race conditions can pop up when trying to lock the openrave environment
                     .def("drawtrimesh",&PyEnvironmentBase::drawtrimesh,drawtrimesh_overloads(args("points","indices","colors"), DOXY_FN(EnvironmentBase,drawtrimesh "const float; int; const int; int; const boost::multi_array")))
                     .def("GetRobots",&PyEnvironmentBase::GetRobots, DOXY_FN(EnvironmentBase,GetRobots))
                     .def("GetBodies",&PyEnvironmentBase::GetBodies, DOXY_FN(EnvironmentBase,GetBodies))
+                    .def("ComputeBodiesAABB",&PyEnvironmentBase::ComputeBodiesAABB, DOXY_FN(EnvironmentBase,ComputeBodiesAABB))
                     .def("GetSensors",&PyEnvironmentBase::GetSensors, DOXY_FN(EnvironmentBase,GetSensors))
                     .def("UpdatePublishedBodies",&PyEnvironmentBase::UpdatePublishedBodies, DOXY_FN(EnvironmentBase,UpdatePublishedBodies))
                     .def("GetPublishedBodies",&PyEnvironmentBase::GetPublishedBodies, GetPublishedBodies_overloads(args("timeout"), DOXY_FN(EnvironmentBase,GetPublishedBodies)))
+                    .def("GetPublishedBodiesStamp",&PyEnvironmentBase::GetPublishedBodiesStamp, DOXY_FN(EnvironmentBase,GetPublishedBodiesStamp))
+                    .def("WritePublishedBodiesDelta",&PyEnvironmentBase::WritePublishedBodiesDelta, WritePublishedBodiesDelta_overloads(args("stamp"), "returns the new stamp and the binary delta of the published bodies that changed after stamp, see EnvironmentBase::WritePublishedBodiesDelta"))
+                    .def("GetLockStatistics",&PyEnvironmentBase::GetLockStatistics, GetLockStatistics_overloads(args("reset"), DOXY_FN(EnvironmentBase,GetLockStatistics)))
                     .def("Triangulate",&PyEnvironmentBase::Triangulate,args("body"), DOXY_FN(EnvironmentBase,Triangulate))
                     .def("TriangulateScene",&PyEnvironmentBase::TriangulateScene,args("options","name"), DOXY_FN(EnvironmentBase,TriangulateScene))
                     .def("SetDebugLevel",&PyEnvironmentBase::SetDebugLevel,args("level"), DOXY_FN(EnvironmentBase,SetDebugLevel))
@@ -2116,6 +2314,12 @@ Because race conditions can pop up when trying to lock the openrave environment
                                   .value("AllExceptBody",EnvironmentBase::SO_AllExceptBody)
         ;
         env.attr("TriangulateOptions") = selectionoptions;
+
+        object simulationsubsystem = enum_<EnvironmentBase::SimulationSubsystem>("SimulationSubsystem" DOXY_ENUM(SimulationSubsystem))
+                                     .value("Physics",EnvironmentBase::SS_Physics)
+                                     .value("Controllers",EnvironmentBase::SS_Controllers)
+                                     .value("Sensors",EnvironmentBase::SS_Sensors)
+        ;
     }
 
     {
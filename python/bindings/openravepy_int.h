@@ -188,6 +188,22 @@ public:
 
 typedef boost::shared_ptr<PythonThreadSaver> PythonThreadSaverPtr;
 
+/// \brief acquires the python GIL for the current scope.
+///
+/// Used by python callbacks that are called from C++ code that might have released the GIL with \ref PythonThreadSaver. Python objects used in the callback should be created and destroyed inside the scope.
+class PythonGILEnsurer
+{
+public:
+    PythonGILEnsurer() {
+        _state = PyGILState_Ensure();
+    }
+    virtual ~PythonGILEnsurer() {
+        PyGILState_Release(_state);
+    }
+protected:
+    PyGILState_STATE _state;
+};
+
 inline RaveVector<float> ExtractFloat3(const object& o)
 {
     return RaveVector<float>(extract<float>(o[0]), extract<float>(o[1]), extract<float>(o[2]));
@@ -345,6 +361,65 @@ inline object toPyVector4(Vector v)
     return numeric::array(boost::python::make_tuple(v.x,v.y,v.z,v.w));
 }
 
+/// \brief returns an array sharing the memory of pvalues instead of copying it.
+///
+/// owner is set as the base of the array, so it stays alive as long as the array does. The memory is only valid until owner modifies it.
+/// \param bWriteable if false, the array is read-only
+inline object toPyArrayView(const dReal* pvalues, std::vector<npy_intp>& dims, object owner, bool bWriteable=false)
+{
+    PyObject *pyvalues = PyArray_SimpleNewFromData(dims.size(), &dims[0], sizeof(dReal)==8 ? PyArray_DOUBLE : PyArray_FLOAT, (void*)pvalues);
+    Py_INCREF(owner.ptr());
+#if NPY_API_VERSION >= 0x00000007
+    PyArray_SetBaseObject((PyArrayObject*)pyvalues, owner.ptr());
+    if( !bWriteable ) {
+        PyArray_CLEARFLAGS((PyArrayObject*)pyvalues, NPY_ARRAY_WRITEABLE);
+    }
+#else
+    PyArray_BASE(pyvalues) = owner.ptr();
+    if( !bWriteable ) {
+        ((PyArrayObject*)pyvalues)->flags &= ~NPY_WRITEABLE;
+    }
+#endif
+    return static_cast<numeric::array>(handle<>(pyvalues));
+}
+
+/// \brief returns the memory of a preallocated array of N dReal values, so that results can be written without allocating a new array.
+///
+/// Throws if o is not a writeable contiguous array of dReal with N elements.
+inline dReal* GetPyArrayOutputData(object o, size_t N)
+{
+    if( !PyArray_Check(o.ptr()) ) {
+        throw OPENRAVE_EXCEPTION_FORMAT0(_("output is not a numpy array"), ORE_InvalidArguments);
+    }
+    PyArrayObject* pyarray = (PyArrayObject*)o.ptr();
+    if( PyArray_TYPE(pyarray) != (sizeof(dReal)==8 ? PyArray_DOUBLE : PyArray_FLOAT) || !PyArray_ISCARRAY(pyarray) ) {
+        throw OPENRAVE_EXCEPTION_FORMAT0(_("output needs to be a writeable contiguous array of dReal"), ORE_InvalidArguments);
+    }
+    if( (size_t)PyArray_SIZE(pyarray) != N ) {
+        throw OPENRAVE_EXCEPTION_FORMAT(_("output has %d elements, expected %d"), (size_t)PyArray_SIZE(pyarray)%N, ORE_InvalidArguments);
+    }
+    return (dReal*)PyArray_DATA(pyarray);
+}
+
+/// \brief returns the data of a (N,numvalues) array of configurations, o is only copied if it is not a contiguous array of dReal already.
+///
+/// The data can be read while the GIL is released.
+/// \param[out] numconfigs N
+/// \param[out] oholder keeps the data alive, has to outlive its use
+inline const dReal* GetPyArrayConfigurations(object o, size_t numvalues, size_t& numconfigs, object& oholder)
+{
+    PyObject* pyarray = PyArray_ContiguousFromAny(o.ptr(), sizeof(dReal)==8 ? PyArray_DOUBLE : PyArray_FLOAT, 2, 2);
+    if( !pyarray ) {
+        throw_error_already_set();
+    }
+    oholder = object(handle<>(pyarray));
+    if( (size_t)PyArray_DIM((PyArrayObject*)pyarray,1) != numvalues ) {
+        throw OPENRAVE_EXCEPTION_FORMAT(_("configurations have %d values, expected %d"), (size_t)PyArray_DIM((PyArrayObject*)pyarray,1)%numvalues, ORE_InvalidArguments);
+    }
+    numconfigs = PyArray_DIM((PyArrayObject*)pyarray,0);
+    return (const dReal*)PyArray_DATA((PyArrayObject*)pyarray);
+}
+
 /// \brief converts dictionary of keyvalue pairs
 AttributesList toAttributesList(boost::python::dict odict);
 /// \brief converts list of tuples [(key,value),(key,value)], it is possible for keys to repeat
@@ -398,6 +473,14 @@ public:
     void SetShow(bool bshow) {
         _handle->SetShow(bshow);
     }
+    bool SetPoints(object opoints) {
+        object oflatpoints = PyObject_HasAttrString(opoints.ptr(),"flat") ? object(opoints.attr("flat")) : opoints;
+        std::vector<float> vpoints = ExtractArray<float>(oflatpoints);
+        if( vpoints.size() % 3 ) {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("points have bad size %d"), vpoints.size(),ORE_InvalidArguments);
+        }
+        return _handle->SetPoints(vpoints.empty() ? NULL : &vpoints[0], vpoints.size()/3, sizeof(float)*3);
+    }
     void Close()
     {
         _handle.reset();
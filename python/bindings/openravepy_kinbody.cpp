@@ -552,6 +552,28 @@ public:
             return _pgeometry->InitCollisionMesh(fTessellation);
         }
 
+        size_t UpdateOctreeVoxels(object opoints, bool bOccupied) {
+            std::vector<Vector> vpoints(len(opoints));
+            for(size_t i = 0; i < vpoints.size(); ++i) {
+                vpoints[i] = ExtractVector3(opoints[i]);
+            }
+            return _pgeometry->UpdateOctreeVoxels(vpoints, bOccupied);
+        }
+        void ClearOctreeVoxels() {
+            _pgeometry->ClearOctreeVoxels();
+        }
+        dReal GetOctreeVoxelSize() const {
+            return _pgeometry->GetOctreeVoxelSize();
+        }
+        object GetOctreeVoxelCenters() const {
+            std::vector<Vector> vcenters;
+            vcenters.reserve(_pgeometry->GetOctreeVoxels().size());
+            FOREACHC(itkey, _pgeometry->GetOctreeVoxels()) {
+                vcenters.push_back(_pgeometry->GetInfo().GetOctreeVoxelCenter(*itkey));
+            }
+            return toPyArray3(vcenters);
+        }
+
         object GetCollisionMesh() {
             return toPyTriMesh(_pgeometry->GetCollisionMesh());
         }
@@ -1508,6 +1530,16 @@ object PyKinBody::GetDOFValues(object oindices) const
     return toPyArray(values);
 }
 
+void PyKinBody::GetDOFValuesToArray(object out) const
+{
+    dReal* poutdata = GetPyArrayOutputData(out, _pbody->GetDOF());
+    if( _pbody->GetDOF() > 0 ) {
+        vector<dReal> values;
+        _pbody->GetDOFValues(values);
+        std::copy(values.begin(), values.end(), poutdata);
+    }
+}
+
 object PyKinBody::GetDOFVelocities() const
 {
     vector<dReal> values;
@@ -1864,6 +1896,98 @@ object PyKinBody::GetLinkTransformations(bool returndoflastvlaues) const
     return otransforms;
 }
 
+void PyKinBody::GetLinkTransformationsToArray(object out) const
+{
+    size_t numlinks = _pbody->GetLinks().size();
+    if( !PyArray_Check(out.ptr()) ) {
+        throw OPENRAVE_EXCEPTION_FORMAT0(_("output is not a numpy array"), ORE_InvalidArguments);
+    }
+    // a 7 value quaternion and translation or a 4x4 matrix for every link
+    bool bquaternion = (size_t)PyArray_SIZE((PyArrayObject*)out.ptr()) == 7*numlinks && numlinks > 0;
+    dReal* pdata = GetPyArrayOutputData(out, (bquaternion ? 7 : 16)*numlinks);
+    FOREACHC(itlink, _pbody->GetLinks()) {
+        const Transform& t = (*itlink)->GetTransform();
+        if( bquaternion ) {
+            pdata[0] = t.rot.x; pdata[1] = t.rot.y; pdata[2] = t.rot.z; pdata[3] = t.rot.w;
+            pdata[4] = t.trans.x; pdata[5] = t.trans.y; pdata[6] = t.trans.z;
+            pdata += 7;
+        }
+        else {
+            TransformMatrix m(t);
+            pdata[0] = m.m[0]; pdata[1] = m.m[1]; pdata[2] = m.m[2]; pdata[3] = m.trans.x;
+            pdata[4] = m.m[4]; pdata[5] = m.m[5]; pdata[6] = m.m[6]; pdata[7] = m.trans.y;
+            pdata[8] = m.m[8]; pdata[9] = m.m[9]; pdata[10] = m.m[10]; pdata[11] = m.trans.z;
+            pdata[12] = 0; pdata[13] = 0; pdata[14] = 0; pdata[15] = 1;
+            pdata += 16;
+        }
+    }
+}
+
+object PyKinBody::ComputeLinkTransformationsBatch(object oconfigs, object odofindices) const
+{
+    std::vector<int> vdofindices;
+    if( !IS_PYTHONOBJECT_NONE(odofindices) ) {
+        vdofindices = ExtractArray<int>(odofindices);
+    }
+    size_t numvalues = vdofindices.size() > 0 ? vdofindices.size() : (size_t)_pbody->GetDOF();
+    size_t numconfigs = 0;
+    object oholder;
+    const dReal* pconfigs = GetPyArrayConfigurations(oconfigs, numvalues, numconfigs, oholder);
+    size_t numlinks = _pbody->GetLinks().size();
+    // a 7 value quaternion and translation or a 4x4 matrix for every link, like GetLinkTransformations
+    bool bquaternion = GetReturnTransformQuaternions();
+    std::vector<npy_intp> dims(3);
+    dims[0] = numconfigs; dims[1] = numlinks; dims[2] = 7;
+    if( !bquaternion ) {
+        dims[2] = 4;
+        dims.push_back(4);
+    }
+    PyObject *pyvalues = PyArray_SimpleNew(dims.size(), &dims[0], sizeof(dReal)==8 ? PyArray_DOUBLE : PyArray_FLOAT);
+    object ovalues = static_cast<numeric::array>(handle<>(pyvalues));
+    dReal* pdata = (dReal*)PyArray_DATA((PyArrayObject*)pyvalues);
+    if( numconfigs > 0 && numlinks > 0 ) {
+        openravepy::PythonThreadSaver threadsaver;
+        std::vector<dReal> vfullconfigs;
+        if( vdofindices.size() > 0 ) {
+            // the other dofs keep their current values
+            std::vector<dReal> vcurvalues;
+            _pbody->GetDOFValues(vcurvalues);
+            vfullconfigs.resize(numconfigs*vcurvalues.size());
+            for(size_t iconfig = 0; iconfig < numconfigs; ++iconfig) {
+                std::copy(vcurvalues.begin(), vcurvalues.end(), vfullconfigs.begin()+iconfig*vcurvalues.size());
+                for(size_t i = 0; i < vdofindices.size(); ++i) {
+                    vfullconfigs.at(iconfig*vcurvalues.size()+vdofindices[i]) = pconfigs[iconfig*numvalues+i];
+                }
+            }
+            pconfigs = vfullconfigs.size() > 0 ? &vfullconfigs[0] : NULL;
+        }
+        std::vector<dReal> vlinkposes;
+        _pbody->ComputeLinkTransformations(pconfigs, numconfigs, vlinkposes);
+        for(size_t iconfig = 0; iconfig < numconfigs; ++iconfig) {
+            for(size_t ilink = 0; ilink < numlinks; ++ilink) {
+                const dReal* pposes = &vlinkposes[ilink*7*numconfigs];
+                Transform t;
+                t.rot = Vector(pposes[iconfig], pposes[numconfigs+iconfig], pposes[2*numconfigs+iconfig], pposes[3*numconfigs+iconfig]);
+                t.trans = Vector(pposes[4*numconfigs+iconfig], pposes[5*numconfigs+iconfig], pposes[6*numconfigs+iconfig]);
+                if( bquaternion ) {
+                    pdata[0] = t.rot.x; pdata[1] = t.rot.y; pdata[2] = t.rot.z; pdata[3] = t.rot.w;
+                    pdata[4] = t.trans.x; pdata[5] = t.trans.y; pdata[6] = t.trans.z;
+                    pdata += 7;
+                }
+                else {
+                    TransformMatrix m(t);
+                    pdata[0] = m.m[0]; pdata[1] = m.m[1]; pdata[2] = m.m[2]; pdata[3] = m.trans.x;
+                    pdata[4] = m.m[4]; pdata[5] = m.m[5]; pdata[6] = m.m[6]; pdata[7] = m.trans.y;
+                    pdata[8] = m.m[8]; pdata[9] = m.m[9]; pdata[10] = m.m[10]; pdata[11] = m.trans.z;
+                    pdata[12] = 0; pdata[13] = 0; pdata[14] = 0; pdata[15] = 1;
+                    pdata += 16;
+                }
+            }
+        }
+    }
+    return ovalues;
+}
+
 void PyKinBody::SetLinkTransformations(object transforms, object odoflastvalues)
 {
     size_t numtransforms = len(transforms);
@@ -2229,6 +2353,23 @@ object PyKinBody::ComputeJacobianAxisAngle(int index, object oindices)
     return toPyArray(vjacobian,dims);
 }
 
+object PyKinBody::ComputeJacobians(object olinkpositions, object oindices)
+{
+    vector<int> vindices;
+    if( !IS_PYTHONOBJECT_NONE(oindices) ) {
+        vindices = ExtractArray<int>(oindices);
+    }
+    std::vector< std::pair<int, Vector> > vlinkpositions(len(olinkpositions));
+    for(size_t i = 0; i < vlinkpositions.size(); ++i) {
+        vlinkpositions[i].first = extract<int>(olinkpositions[i][0]);
+        vlinkpositions[i].second = ExtractVector3(olinkpositions[i][1]);
+    }
+    std::vector<dReal> vjacobians;
+    _pbody->ComputeJacobians(vlinkpositions,vjacobians,vindices);
+    std::vector<npy_intp> dims(3); dims[0] = vlinkpositions.size(); dims[1] = 6; dims[2] = vindices.size() > 0 ? vindices.size() : _pbody->GetDOF();
+    return toPyArray(vjacobians,dims);
+}
+
 object PyKinBody::CalculateJacobian(int index, object oposition)
 {
     std::vector<dReal> vjacobian;
@@ -2279,17 +2420,13 @@ object PyKinBody::ComputeHessianAxisAngle(int index, object oindices)
     return toPyArray(vhessian,dims);
 }
 
-object PyKinBody::ComputeInverseDynamics(object odofaccelerations, object oexternalforcetorque, bool returncomponents)
+/// \brief converts a dictionary of link indices and 6-element force/torque arrays
+static void _ExtractForceTorqueMap(object oexternalforcetorque, KinBody::ForceTorqueMap& mapExternalForceTorque)
 {
-    vector<dReal> vDOFAccelerations;
-    if( !IS_PYTHONOBJECT_NONE(odofaccelerations) ) {
-        vDOFAccelerations = ExtractArray<dReal>(odofaccelerations);
-    }
-    KinBody::ForceTorqueMap mapExternalForceTorque;
+    mapExternalForceTorque.clear();
     if( !IS_PYTHONOBJECT_NONE(oexternalforcetorque) ) {
         boost::python::dict odict = (boost::python::dict)oexternalforcetorque;
         boost::python::list iterkeys = (boost::python::list)odict.iterkeys();
-        vector<dReal> v;
         for (int i = 0; i < boost::python::len(iterkeys); i++) {
             int linkindex = boost::python::extract<int>(iterkeys[i]);
             object oforcetorque = odict[iterkeys[i]];
@@ -2297,6 +2434,16 @@ object PyKinBody::ComputeInverseDynamics(object odofaccelerations, object oexter
             mapExternalForceTorque[linkindex] = make_pair(Vector(boost::python::extract<dReal>(oforcetorque[0]),boost::python::extract<dReal>(oforcetorque[1]),boost::python::extract<dReal>(oforcetorque[2])),Vector(boost::python::extract<dReal>(oforcetorque[3]),boost::python::extract<dReal>(oforcetorque[4]),boost::python::extract<dReal>(oforcetorque[5])));
         }
     }
+}
+
+object PyKinBody::ComputeInverseDynamics(object odofaccelerations, object oexternalforcetorque, bool returncomponents)
+{
+    vector<dReal> vDOFAccelerations;
+    if( !IS_PYTHONOBJECT_NONE(odofaccelerations) ) {
+        vDOFAccelerations = ExtractArray<dReal>(odofaccelerations);
+    }
+    KinBody::ForceTorqueMap mapExternalForceTorque;
+    _ExtractForceTorqueMap(oexternalforcetorque, mapExternalForceTorque);
     if( returncomponents ) {
         boost::array< vector<dReal>, 3> vDOFTorqueComponents;
         _pbody->ComputeInverseDynamics(vDOFTorqueComponents,vDOFAccelerations,mapExternalForceTorque);
@@ -2309,6 +2456,22 @@ object PyKinBody::ComputeInverseDynamics(object odofaccelerations, object oexter
     }
 }
 
+object PyKinBody::ComputeInverseDynamicsSequence(object odofvalues, object odofvelocities, object odofaccelerations, object oexternalforcetorque)
+{
+    vector<dReal> vDOFValues = ExtractArray<dReal>(odofvalues.attr("flat"));
+    vector<dReal> vDOFVelocities = ExtractArray<dReal>(odofvelocities.attr("flat"));
+    vector<dReal> vDOFAccelerations;
+    if( !IS_PYTHONOBJECT_NONE(odofaccelerations) ) {
+        vDOFAccelerations = ExtractArray<dReal>(odofaccelerations.attr("flat"));
+    }
+    KinBody::ForceTorqueMap mapExternalForceTorque;
+    _ExtractForceTorqueMap(oexternalforcetorque, mapExternalForceTorque);
+    vector<dReal> vDOFTorques;
+    _pbody->ComputeInverseDynamicsSequence(vDOFTorques,vDOFValues,vDOFVelocities,vDOFAccelerations,mapExternalForceTorque);
+    std::vector<npy_intp> dims(2); dims[0] = _pbody->GetDOF() > 0 ? vDOFTorques.size()/_pbody->GetDOF() : 0; dims[1] = _pbody->GetDOF();
+    return toPyArray(vDOFTorques,dims);
+}
+
 void PyKinBody::SetSelfCollisionChecker(PyCollisionCheckerBasePtr pycollisionchecker)
 {
     _pbody->SetSelfCollisionChecker(openravepy::GetCollisionChecker(pycollisionchecker));
@@ -2326,6 +2489,36 @@ bool PyKinBody::CheckSelfCollision(PyCollisionReportPtr pReport, PyCollisionChec
     return bCollision;
 }
 
+bool PyKinBody::CheckSelfCollisionSpheres(int adjacentoptions)
+{
+    return _pbody->CheckSelfCollisionSpheres(adjacentoptions);
+}
+
+object PyKinBody::CheckSelfCollisionBatch(object oconfigs, object odofindices)
+{
+    std::vector<int> vdofindices;
+    if( !IS_PYTHONOBJECT_NONE(odofindices) ) {
+        vdofindices = ExtractArray<int>(odofindices);
+    }
+    size_t numvalues = vdofindices.size() > 0 ? vdofindices.size() : (size_t)_pbody->GetDOF();
+    size_t numconfigs = 0;
+    object oholder;
+    const dReal* pconfigs = GetPyArrayConfigurations(oconfigs, numvalues, numconfigs, oholder);
+    npy_intp dims[] = { (npy_intp)numconfigs };
+    PyObject* pycollision = PyArray_SimpleNew(1, dims, PyArray_BOOL);
+    object ocollision = static_cast<numeric::array>(handle<>(pycollision));
+    bool* pcollision = (bool*)PyArray_DATA((PyArrayObject*)pycollision);
+    if( numconfigs > 0 ) {
+        openravepy::PythonThreadSaver threadsaver;
+        KinBody::KinBodyStateSaver saver(_pbody, KinBody::Save_LinkTransformation);
+        for(size_t iconfig = 0; iconfig < numconfigs; ++iconfig) {
+            _pbody->SetDOFValues(pconfigs+iconfig*numvalues, numvalues, KinBody::CLA_Nothing, vdofindices);
+            pcollision[iconfig] = _pbody->CheckSelfCollision();
+        }
+    }
+    return ocollision;
+}
+
 bool PyKinBody::IsAttached(PyKinBodyPtr pattachbody)
 {
     CHECK_POINTER(pattachbody);
@@ -2407,22 +2600,27 @@ object PyKinBody::GetURI() const
 object PyKinBody::GetNonAdjacentLinks() const
 {
     boost::python::list ononadjacent;
-    const std::set<int>& nonadjacent = _pbody->GetNonAdjacentLinks();
-    FOREACHC(it,nonadjacent) {
-        ononadjacent.append(boost::python::make_tuple((int)(*it)&0xffff,(int)(*it)>>16));
+    const std::vector< std::pair<int16_t, int16_t> >& vnonadjacent = _pbody->GetNonAdjacentLinkPairs();
+    FOREACHC(it,vnonadjacent) {
+        ononadjacent.append(boost::python::make_tuple((int)it->first,(int)it->second));
     }
     return ononadjacent;
 }
 object PyKinBody::GetNonAdjacentLinks(int adjacentoptions) const
 {
     boost::python::list ononadjacent;
-    const std::set<int>& nonadjacent = _pbody->GetNonAdjacentLinks(adjacentoptions);
-    FOREACHC(it,nonadjacent) {
-        ononadjacent.append(boost::python::make_tuple((int)(*it)&0xffff,(int)(*it)>>16));
+    const std::vector< std::pair<int16_t, int16_t> >& vnonadjacent = _pbody->GetNonAdjacentLinkPairs(adjacentoptions);
+    FOREACHC(it,vnonadjacent) {
+        ononadjacent.append(boost::python::make_tuple((int)it->first,(int)it->second));
     }
     return ononadjacent;
 }
 
+int PyKinBody::GetNonAdjacentLinksUpdateStamp() const
+{
+    return _pbody->GetNonAdjacentLinksUpdateStamp();
+}
+
 object PyKinBody::GetAdjacentLinks() const
 {
     boost::python::list adjacent;
@@ -2779,9 +2977,11 @@ BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(SetDOFLimits_overloads, SetDOFLimits, 2,
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(SubtractDOFValues_overloads, SubtractDOFValues, 2, 3)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(ComputeJacobianTranslation_overloads, ComputeJacobianTranslation, 2, 3)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(ComputeJacobianAxisAngle_overloads, ComputeJacobianAxisAngle, 1, 2)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(ComputeJacobians_overloads, ComputeJacobians, 1, 2)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(ComputeHessianTranslation_overloads, ComputeHessianTranslation, 2, 3)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(ComputeHessianAxisAngle_overloads, ComputeHessianAxisAngle, 1, 2)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(ComputeInverseDynamics_overloads, ComputeInverseDynamics, 1, 3)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(ComputeInverseDynamicsSequence_overloads, ComputeInverseDynamicsSequence, 2, 4)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(Restore_overloads, Restore, 0,1)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(CreateKinBodyStateSaver_overloads, CreateKinBodyStateSaver, 0,1)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(SetConfigurationValues_overloads, SetConfigurationValues, 1,2)
@@ -2789,6 +2989,9 @@ BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(GetFloatParameters_overloads, GetFloatPar
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(GetIntParameters_overloads, GetIntParameters, 0, 2)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(GetStringParameters_overloads, GetStringParameters, 0, 1)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(CheckSelfCollision_overloads, CheckSelfCollision, 0, 2)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(CheckSelfCollisionSpheres_overloads, CheckSelfCollisionSpheres, 0, 1)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(CheckSelfCollisionBatch_overloads, CheckSelfCollisionBatch, 1, 2)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(ComputeLinkTransformationsBatch_overloads, ComputeLinkTransformationsBatch, 1, 2)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(GetLinkAccelerations_overloads, GetLinkAccelerations, 1, 2)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(InitCollisionMesh_overloads, InitCollisionMesh, 0, 1)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(InitFromBoxes_overloads, InitFromBoxes, 1, 3)
@@ -2816,6 +3019,7 @@ void init_openravepy_kinbody()
                           .value("Cylinder",GT_Cylinder)
                           .value("Trimesh",GT_TriMesh)
                           .value("Container",GT_Container)
+                          .value("Octree",GT_Octree)
     ;
     object electricmotoractuatorinfo = class_<PyElectricMotorActuatorInfo, boost::shared_ptr<PyElectricMotorActuatorInfo> >("ElectricMotorActuatorInfo", DOXY_CLASS(KinBody::ElectricMotorActuatorInfo))
                                        .def_readwrite("model_type",&PyElectricMotorActuatorInfo::model_type)
@@ -2951,6 +3155,7 @@ void init_openravepy_kinbody()
         std::string sInitFromBoxesDoc = std::string(DOXY_FN(KinBody,InitFromBoxes "const std::vector< AABB; bool")) + std::string("\nboxes is a Nx6 array, first 3 columsn are position, last 3 are extents");
         std::string sGetChainDoc = std::string(DOXY_FN(KinBody,GetChain)) + std::string("If returnjoints is false will return a list of links, otherwise will return a list of links (default is true)");
         std::string sComputeInverseDynamicsDoc = std::string(":param returncomponents: If True will return three N-element arrays that represents the torque contributions to M, C, and G.\n\n:param externalforcetorque: A dictionary of link indices and a 6-element array of forces/torques in that order.\n\n") + std::string(DOXY_FN(KinBody, ComputeInverseDynamics));
+        std::string sComputeInverseDynamicsSequenceDoc = std::string(":param dofvalues: NxDOF array of dof values, one row per state.\n\n:param dofvelocities: NxDOF array of dof velocities.\n\n:param dofaccelerations: NxDOF array of dof accelerations, or None if all zero.\n\n:return: NxDOF array of torques\n\n") + std::string(DOXY_FN(KinBody, ComputeInverseDynamicsSequence));
         scope kinbody = class_<PyKinBody, boost::shared_ptr<PyKinBody>, bases<PyInterfaceBase> >("KinBody", DOXY_CLASS(KinBody), no_init)
                         .def("InitFromBoxes",&PyKinBody::InitFromBoxes,InitFromBoxes_overloads(args("boxes","draw","uri"), sInitFromBoxesDoc.c_str()))
                         .def("InitFromSpheres",&PyKinBody::InitFromSpheres,InitFromSpheres_overloads(args("spherex","draw","uri"), DOXY_FN(KinBody,InitFromSpheres)))
@@ -2964,6 +3169,7 @@ void init_openravepy_kinbody()
                         .def("GetDOF",&PyKinBody::GetDOF,DOXY_FN(KinBody,GetDOF))
                         .def("GetDOFValues",getdofvalues1,DOXY_FN(KinBody,GetDOFValues))
                         .def("GetDOFValues",getdofvalues2,args("indices"),DOXY_FN(KinBody,GetDOFValues))
+                        .def("GetDOFValuesToArray",&PyKinBody::GetDOFValuesToArray,args("out"),"Copies the dof values into a preallocated array of GetDOF() values.")
                         .def("GetDOFVelocities",getdofvelocities1, DOXY_FN(KinBody,GetDOFVelocities))
                         .def("GetDOFVelocities",getdofvelocities2, args("indices"), DOXY_FN(KinBody,GetDOFVelocities))
                         .def("GetDOFLimits",getdoflimits1, DOXY_FN(KinBody,GetDOFLimits))
@@ -3005,6 +3211,8 @@ void init_openravepy_kinbody()
                         .def("GetTransformPose",&PyKinBody::GetTransformPose, DOXY_FN(KinBody,GetTransform))
                         .def("GetLinkTransformations",&PyKinBody::GetLinkTransformations, GetLinkTransformations_overloads(args("returndoflastvlaues"), DOXY_FN(KinBody,GetLinkTransformations)))
                         .def("GetBodyTransformations",&PyKinBody::GetLinkTransformations, DOXY_FN(KinBody,GetLinkTransformations))
+                        .def("GetLinkTransformationsToArray",&PyKinBody::GetLinkTransformationsToArray,args("out"),"Copies the link transformations into a preallocated array of shape (numlinks,4,4), or (numlinks,7) for quaternion and translation.")
+                        .def("ComputeLinkTransformationsBatch",&PyKinBody::ComputeLinkTransformationsBatch, ComputeLinkTransformationsBatch_overloads(args("configs","dofindices"), "Computes the link transformations of every row of the (N,dof) array configs without the GIL, returns an array of shape (N,numlinks,4,4), or (N,numlinks,7) when transforms are returned as quaternions. If dofindices is set, the configurations only set those dofs. The state of the body is not changed."))
                         .def("SetLinkTransformations",&PyKinBody::SetLinkTransformations,SetLinkTransformations_overloads(args("transforms","doflastsetvalues"), DOXY_FN(KinBody,SetLinkTransformations)))
                         .def("SetBodyTransformations",&PyKinBody::SetLinkTransformations,args("transforms"), DOXY_FN(KinBody,SetLinkTransformations))
                         .def("SetLinkVelocities",&PyKinBody::SetLinkVelocities,args("velocities"), DOXY_FN(KinBody,SetLinkVelocities))
@@ -3038,15 +3246,19 @@ void init_openravepy_kinbody()
                         .def("SetTransformWithDOFValues",&PyKinBody::SetTransformWithDOFValues,args("transform","values"), DOXY_FN(KinBody,SetDOFValues "const std::vector; const Transform; uint32_t"))
                         .def("ComputeJacobianTranslation",&PyKinBody::ComputeJacobianTranslation,ComputeJacobianTranslation_overloads(args("linkindex","position","indices"), DOXY_FN(KinBody,ComputeJacobianTranslation)))
                         .def("ComputeJacobianAxisAngle",&PyKinBody::ComputeJacobianAxisAngle,ComputeJacobianAxisAngle_overloads(args("linkindex","indices"), DOXY_FN(KinBody,ComputeJacobianAxisAngle)))
+                        .def("ComputeJacobians",&PyKinBody::ComputeJacobians,ComputeJacobians_overloads(args("linkpositions","indices"), DOXY_FN(KinBody,ComputeJacobians)))
                         .def("CalculateJacobian",&PyKinBody::CalculateJacobian,args("linkindex","position"), DOXY_FN(KinBody,CalculateJacobian "int; const Vector; std::vector"))
                         .def("CalculateRotationJacobian",&PyKinBody::CalculateRotationJacobian,args("linkindex","quat"), DOXY_FN(KinBody,CalculateRotationJacobian "int; const Vector; std::vector"))
                         .def("CalculateAngularVelocityJacobian",&PyKinBody::CalculateAngularVelocityJacobian,args("linkindex"), DOXY_FN(KinBody,CalculateAngularVelocityJacobian "int; std::vector"))
                         .def("ComputeHessianTranslation",&PyKinBody::ComputeHessianTranslation,ComputeHessianTranslation_overloads(args("linkindex","position","indices"), DOXY_FN(KinBody,ComputeHessianTranslation)))
                         .def("ComputeHessianAxisAngle",&PyKinBody::ComputeHessianAxisAngle,ComputeHessianAxisAngle_overloads(args("linkindex","indices"), DOXY_FN(KinBody,ComputeHessianAxisAngle)))
                         .def("ComputeInverseDynamics",&PyKinBody::ComputeInverseDynamics, ComputeInverseDynamics_overloads(args("dofaccelerations","externalforcetorque","returncomponents"), sComputeInverseDynamicsDoc.c_str()))
+                        .def("ComputeInverseDynamicsSequence",&PyKinBody::ComputeInverseDynamicsSequence, ComputeInverseDynamicsSequence_overloads(args("dofvalues","dofvelocities","dofaccelerations","externalforcetorque"), sComputeInverseDynamicsSequenceDoc.c_str()))
                         .def("SetSelfCollisionChecker",&PyKinBody::SetSelfCollisionChecker,args("collisionchecker"), DOXY_FN(KinBody,SetSelfCollisionChecker))
                         .def("GetSelfCollisionChecker",&PyKinBody::GetSelfCollisionChecker,args("collisionchecker"), DOXY_FN(KinBody,GetSelfCollisionChecker))
                         .def("CheckSelfCollision",&PyKinBody::CheckSelfCollision, CheckSelfCollision_overloads(args("report","collisionchecker"), DOXY_FN(KinBody,CheckSelfCollision)))
+                        .def("CheckSelfCollisionSpheres",&PyKinBody::CheckSelfCollisionSpheres, CheckSelfCollisionSpheres_overloads(args("adjacentoptions"), DOXY_FN(KinBody,CheckSelfCollisionSpheres)))
+                        .def("CheckSelfCollisionBatch",&PyKinBody::CheckSelfCollisionBatch, CheckSelfCollisionBatch_overloads(args("configs","dofindices"), "Checks the self collision of every row of the (N,dof) array configs without the GIL, returns an array of N booleans. If dofindices is set, the configurations only set those dofs. The state of the body is restored."))
                         .def("IsAttached",&PyKinBody::IsAttached,args("body"), DOXY_FN(KinBody,IsAttached))
                         .def("GetAttached",&PyKinBody::GetAttached, DOXY_FN(KinBody,GetAttached))
                         .def("SetZeroConfiguration",&PyKinBody::SetZeroConfiguration, DOXY_FN(KinBody,SetZeroConfiguration))
@@ -3065,6 +3277,7 @@ void init_openravepy_kinbody()
                         .def("GetXMLFilename",&PyKinBody::GetURI, DOXY_FN(InterfaceBase,GetURI))
                         .def("GetNonAdjacentLinks",GetNonAdjacentLinks1, DOXY_FN(KinBody,GetNonAdjacentLinks))
                         .def("GetNonAdjacentLinks",GetNonAdjacentLinks2, args("adjacentoptions"), DOXY_FN(KinBody,GetNonAdjacentLinks))
+                        .def("GetNonAdjacentLinksUpdateStamp",&PyKinBody::GetNonAdjacentLinksUpdateStamp, DOXY_FN(KinBody,GetNonAdjacentLinksUpdateStamp))
                         .def("GetAdjacentLinks",&PyKinBody::GetAdjacentLinks, DOXY_FN(KinBody,GetAdjacentLinks))
                         .def("GetPhysicsData",&PyKinBody::GetPhysicsData, DOXY_FN(KinBody,GetPhysicsData))
                         .def("GetCollisionData",&PyKinBody::GetCollisionData, DOXY_FN(KinBody,GetCollisionData))
@@ -3175,6 +3388,10 @@ void init_openravepy_kinbody()
                                  .def("GetCollisionMesh",&PyLink::PyGeometry::GetCollisionMesh, DOXY_FN(KinBody::Link::Geometry,GetCollisionMesh))
                                  .def("InitCollisionMesh",&PyLink::PyGeometry::InitCollisionMesh, InitCollisionMesh_overloads(args("tesselation"), DOXY_FN(KinBody::Link::Geometry,GetCollisionMesh)))
                                  .def("ComputeAABB",&PyLink::PyGeometry::ComputeAABB, args("transform"), DOXY_FN(KinBody::Link::Geometry,ComputeAABB))
+                                 .def("UpdateOctreeVoxels",&PyLink::PyGeometry::UpdateOctreeVoxels, args("points","occupied"), DOXY_FN(KinBody::Link::Geometry,UpdateOctreeVoxels))
+                                 .def("ClearOctreeVoxels",&PyLink::PyGeometry::ClearOctreeVoxels, DOXY_FN(KinBody::Link::Geometry,ClearOctreeVoxels))
+                                 .def("GetOctreeVoxelSize",&PyLink::PyGeometry::GetOctreeVoxelSize, DOXY_FN(KinBody::Link::Geometry,GetOctreeVoxelSize))
+                                 .def("GetOctreeVoxelCenters",&PyLink::PyGeometry::GetOctreeVoxelCenters, "returns the centers of the occupied voxels of an octree in the local coordinate system of the geometry")
                                  .def("SetDraw",&PyLink::PyGeometry::SetDraw,args("draw"), DOXY_FN(KinBody::Link::Geometry,SetDraw))
                                  .def("SetTransparency",&PyLink::PyGeometry::SetTransparency,args("transparency"), DOXY_FN(KinBody::Link::Geometry,SetTransparency))
                                  .def("SetDiffuseColor",&PyLink::PyGeometry::SetDiffuseColor,args("color"), DOXY_FN(KinBody::Link::Geometry,SetDiffuseColor))
@@ -107,6 +107,7 @@ public:
     int GetDOF() const;
     object GetDOFValues() const;
     object GetDOFValues(object oindices) const;
+    void GetDOFValuesToArray(object out) const;
     object GetDOFVelocities() const;
     object GetDOFVelocities(object oindices) const;
     object GetDOFLimits() const;
@@ -141,6 +142,8 @@ public:
     object GetTransform() const;
     object GetTransformPose() const;
     object GetLinkTransformations(bool returndoflastvlaues=false) const;
+    void GetLinkTransformationsToArray(object out) const;
+    object ComputeLinkTransformationsBatch(object oconfigs, object odofindices=object()) const;
     void SetLinkTransformations(object transforms, object odoflastvalues=object());
     void SetLinkVelocities(object ovelocities);
     object GetLinkEnableStates() const;
@@ -175,15 +178,19 @@ public:
     void SetDOFTorques(object otorques, bool bAdd);
     object ComputeJacobianTranslation(int index, object oposition, object oindices=object());
     object ComputeJacobianAxisAngle(int index, object oindices=object());
+    object ComputeJacobians(object olinkpositions, object oindices=object());
     object CalculateJacobian(int index, object oposition);
     object CalculateRotationJacobian(int index, object q) const;
     object CalculateAngularVelocityJacobian(int index) const;
     object ComputeHessianTranslation(int index, object oposition, object oindices=object());
     object ComputeHessianAxisAngle(int index, object oindices=object());
     object ComputeInverseDynamics(object odofaccelerations, object oexternalforcetorque=object(), bool returncomponents=false);
+    object ComputeInverseDynamicsSequence(object odofvalues, object odofvelocities, object odofaccelerations=object(), object oexternalforcetorque=object());
     void SetSelfCollisionChecker(PyCollisionCheckerBasePtr pycollisionchecker);
     PyInterfaceBasePtr GetSelfCollisionChecker();
     bool CheckSelfCollision(PyCollisionReportPtr pReport=PyCollisionReportPtr(), PyCollisionCheckerBasePtr pycollisionchecker=PyCollisionCheckerBasePtr());
+    bool CheckSelfCollisionSpheres(int adjacentoptions=KinBody::AO_Enabled);
+    object CheckSelfCollisionBatch(object oconfigs, object odofindices=object());
     bool IsAttached(PyKinBodyPtr pattachbody);
     object GetAttached() const;
     void SetZeroConfiguration();
@@ -200,6 +207,7 @@ public:
     object GetURI() const;
     object GetNonAdjacentLinks() const;
     object GetNonAdjacentLinks(int adjacentoptions) const;
+    int GetNonAdjacentLinksUpdateStamp() const;
     object GetAdjacentLinks() const;
     object GetPhysicsData() const;
     object GetCollisionData() const;
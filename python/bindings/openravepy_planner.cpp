@@ -17,6 +17,8 @@
 #define NO_IMPORT_ARRAY
 #include "openravepy_int.h"
 
+#include <openrave/utils.h>
+
 namespace openravepy {
 
 class PyPlannerProgress
@@ -34,6 +36,67 @@ public:
     int _iteration;
 };
 
+class PyPlanPathHandle
+{
+public:
+    PyPlanPathHandle(PlannerBase::PlanPathHandlePtr phandle) : _phandle(phandle) {
+    }
+
+    PlannerStatus Wait()
+    {
+        openravepy::PythonThreadSaver statesaver;
+        return _phandle->Wait();
+    }
+
+    bool WaitFor(uint32_t timeout)
+    {
+        openravepy::PythonThreadSaver statesaver;
+        return _phandle->WaitFor(timeout);
+    }
+
+    bool IsDone() const {
+        return _phandle->IsDone();
+    }
+
+    void Cancel() {
+        _phandle->Cancel();
+    }
+
+    void RequestAnySolution() {
+        _phandle->RequestAnySolution();
+    }
+
+    bool IsCancelled() const {
+        return _phandle->IsCancelled();
+    }
+
+    boost::shared_ptr<PyPlannerProgress> GetProgress() const {
+        return boost::shared_ptr<PyPlannerProgress>(new PyPlannerProgress(_phandle->GetProgress()));
+    }
+
+    int GetNumProgressUpdates() const {
+        return _phandle->GetNumProgressUpdates();
+    }
+
+    void Close()
+    {
+        // the handle destructor would wait for PlanPath while holding the GIL, which the plan callbacks need
+        _phandle->Cancel();
+        openravepy::PythonThreadSaver statesaver;
+        try {
+            _phandle->Wait();
+        }
+        catch(const std::exception& ex) {
+            RAVELOG_DEBUG_FORMAT("closed plan path handle failed: %s", ex.what());
+        }
+    }
+
+private:
+    PlannerBase::PlanPathHandlePtr _phandle;
+};
+
+typedef boost::shared_ptr<PyPlanPathHandle> PyPlanPathHandlePtr;
+
 class PyPlannerBase : public PyInterfaceBase
 {
 protected:
@@ -162,6 +225,34 @@ public:
             _paramswrite->_sPostProcessingParameters = plannerparameters;
         }
 
+        // The python hooks below receive numpy arrays that share the memory of the planner's vectors instead of lists converted on every call.
+        // The arrays are only valid during the call, so they have to be copied if kept.
+
+        void SetDistanceMetricFn(object fn)
+        {
+            _paramswrite->_distmetricfn = boost::bind(&PyPlannerParameters::_CallDistMetricFn, fn, _1, _2);
+        }
+
+        void SetDistanceMetricBatchFn(object fn)
+        {
+            if( IS_PYTHONOBJECT_NONE(fn) ) {
+                _paramswrite->_distmetricbatchfn.clear();
+            }
+            else {
+                _paramswrite->_distmetricbatchfn = boost::bind(&PyPlannerParameters::_CallDistMetricBatchFn, fn, _1, _2, _3);
+            }
+        }
+
+        void SetNeighStateFn(object fn)
+        {
+            _paramswrite->_neighstatefn = boost::bind(&PyPlannerParameters::_CallNeighStateFn, fn, _1, _2, _3);
+        }
+
+        void SetCheckPathVelocityConstraintsFn(object fn)
+        {
+            _paramswrite->_checkpathvelocityconstraintsfn = boost::bind(&PyPlannerParameters::_CallCheckPathVelocityConstraintsFn, fn, _1, _2, _3, _4, _5, _6, _7, _8);
+        }
+
         string __repr__() {
             stringstream ss;
             ss << std::setprecision(std::numeric_limits<dReal>::digits10+1);         /// have to do this or otherwise precision gets lost
@@ -169,6 +260,14 @@ public:
             ss << *_paramsread << "\"\"\")" << endl;
             return ss.str();
         }
+        /// \brief returns the xml of PlannerBase::PlannerParameters::serialize that PlannerBase::InitPlan(robot,istream) reads back
+        string Serialize() {
+            stringstream ss;
+            ss << std::setprecision(std::numeric_limits<dReal>::digits10+1);
+            ss << *_paramsread;
+            return ss.str();
+        }
+
         string __str__() {
             return boost::str(boost::format("<PlannerParameters, dof=%d>")%_paramsread->GetDOF());
         }
@@ -181,6 +280,84 @@ public:
         bool __ne__(boost::shared_ptr<PyPlannerParameters> p) {
             return !p || _paramsread != p->_paramsread;
         }
+
+protected:
+        static object _GetValuesView(const std::vector<dReal>& v, bool bWriteable=false)
+        {
+            std::vector<npy_intp> dims(1, v.size());
+            return toPyArrayView(v.size() > 0 ? &v[0] : NULL, dims, object(), bWriteable);
+        }
+
+        /// \brief throws after printing the python error, planners have no sensible default for a failed hook
+        static void _ThrowHookError(const char* hookname)
+        {
+            if( PyErr_Occurred() ) {
+                PyErr_Print();
+            }
+            throw OPENRAVE_EXCEPTION_FORMAT(_("exception occured in python %s"), hookname, ORE_Failed);
+        }
+
+        static dReal _CallDistMetricFn(object fn, const std::vector<dReal>& q0, const std::vector<dReal>& q1)
+        {
+            // PlanPath releases the GIL
+            PythonGILEnsurer gilensurer;
+            try {
+                return extract<dReal>(fn(_GetValuesView(q0), _GetValuesView(q1)));
+            }
+            catch(const error_already_set&) {
+                _ThrowHookError("distance metric");
+            }
+            return 0;
+        }
+
+        static void _CallDistMetricBatchFn(object fn, const std::vector<dReal>& q, const std::vector<dReal>& vconfigs, std::vector<dReal>& vdistances)
+        {
+            size_t numconfigs = q.size() > 0 ? vconfigs.size()/q.size() : 0;
+            vdistances.resize(numconfigs);
+            if( numconfigs == 0 ) {
+                return;
+            }
+            PythonGILEnsurer gilensurer;
+            try {
+                std::vector<npy_intp> dims(2);
+                dims[0] = numconfigs;
+                dims[1] = q.size();
+                // distances are written by the hook directly into vdistances
+                fn(_GetValuesView(q), toPyArrayView(&vconfigs[0], dims, object()), _GetValuesView(vdistances, true));
+            }
+            catch(const error_already_set&) {
+                _ThrowHookError("batch distance metric");
+            }
+        }
+
+        static bool _CallNeighStateFn(object fn, std::vector<dReal>& q, const std::vector<dReal>& qdelta, int options)
+        {
+            PythonGILEnsurer gilensurer;
+            try {
+                // q is modified in place by the hook
+                return extract<bool>(fn(_GetValuesView(q, true), _GetValuesView(qdelta), options));
+            }
+            catch(const error_already_set&) {
+                _ThrowHookError("neighbor state function");
+            }
+            return false;
+        }
+
+        static int _CallCheckPathVelocityConstraintsFn(object fn, const std::vector<dReal>& q0, const std::vector<dReal>& q1, const std::vector<dReal>& dq0, const std::vector<dReal>& dq1, dReal timeelapsed, IntervalType interval, int options, ConstraintFilterReturnPtr filterreturn)
+        {
+            PythonGILEnsurer gilensurer;
+            int ret = 0;
+            try {
+                ret = extract<int>(fn(_GetValuesView(q0), _GetValuesView(q1), _GetValuesView(dq0), _GetValuesView(dq1), timeelapsed, interval, options));
+            }
+            catch(const error_already_set&) {
+                _ThrowHookError("path constraints function");
+            }
+            if( !!filterreturn ) {
+                filterreturn->_returncode = ret;
+            }
+            return ret;
+        }
     };
 
     typedef boost::shared_ptr<PyPlannerParameters> PyPlannerParametersPtr;
@@ -215,9 +392,15 @@ public:
         if( releasegil ) {
             statesaver.reset(new openravepy::PythonThreadSaver());
         }
+        OpenRAVE::utils::ProfileZone profilezone("PlannerBase::PlanPath");
         return _pplanner->PlanPath(ptraj);
     }
 
+    PyPlanPathHandlePtr PlanPathAsync(PyTrajectoryBasePtr pytraj, uint32_t timeout=0)
+    {
+        return PyPlanPathHandlePtr(new PyPlanPathHandle(_pplanner->PlanPathAsync(openravepy::GetTrajectory(pytraj), PlannerBase::PlanCallbackFn(), timeout)));
+    }
+
     PyPlannerParametersPtr GetParameters() const
     {
         PlannerBase::PlannerParametersConstPtr params = _pplanner->GetParameters();
@@ -227,10 +410,11 @@ public:
         return PyPlannerParametersPtr(new PyPlannerParameters(params));
     }
 
-    static PlannerAction _PlanCallback(object fncallback, PyEnvironmentBasePtr pyenv, const PlannerBase::PlannerProgress& progress)
+    static PlannerAction _PlanCallback(const object& fncallback, PyEnvironmentBasePtr pyenv, const PlannerBase::PlannerProgress& progress)
     {
+        // PlanPath releases the GIL
+        PythonGILEnsurer gilensurer;
         object res;
-        PyGILState_STATE gstate = PyGILState_Ensure();
         try {
             boost::shared_ptr<PyPlannerProgress> pyprogress(new PyPlannerProgress(progress));
             res = fncallback(object(pyprogress));
@@ -253,7 +437,6 @@ public:
                 RAVELOG_WARN("plan callback nothing returning, so executing default action\n");
             }
         }
-        PyGILState_Release(gstate);
         return ret;
     }
 
@@ -322,6 +505,7 @@ PyPlannerBasePtr RaveCreatePlanner(PyEnvironmentBasePtr pyenv, const std::string
 
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(InitPlan_overloads, InitPlan, 2, 3)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(PlanPath_overloads, PlanPath, 1, 2)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(PlanPathAsync_overloads, PlanPathAsync, 1, 2)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(CheckPathAllConstraints_overloads, CheckPathAllConstraints, 6, 8)
 
 void init_openravepy_planner()
@@ -349,10 +533,23 @@ void init_openravepy_planner()
                         .def("InitPlan",InitPlan1,InitPlan_overloads(args("robot","params","releasegil"), DOXY_FN(PlannerBase,InitPlan "RobotBasePtr; PlannerParametersConstPtr")))
                         .def("InitPlan",InitPlan2,args("robot","xmlparams"), DOXY_FN(PlannerBase,InitPlan "RobotBasePtr; std::istream"))
                         .def("PlanPath",&PyPlannerBase::PlanPath,PlanPath_overloads(args("traj","releasegil"), DOXY_FN(PlannerBase,PlanPath)))
+                        .def("PlanPathAsync",&PyPlannerBase::PlanPathAsync,PlanPathAsync_overloads(args("traj","timeout"), DOXY_FN(PlannerBase,PlanPathAsync)))
                         .def("GetParameters",&PyPlannerBase::GetParameters, DOXY_FN(PlannerBase,GetParameters))
                         .def("RegisterPlanCallback",&PyPlannerBase::RegisterPlanCallback, DOXY_FN(PlannerBase,RegisterPlanCallback))
         ;
 
+        class_<PyPlanPathHandle, PyPlanPathHandlePtr >("PlanPathHandle", DOXY_CLASS(PlannerBase::PlanPathHandle), no_init)
+        .def("Wait",&PyPlanPathHandle::Wait, DOXY_FN(PlannerBase::PlanPathHandle,Wait))
+        .def("WaitFor",&PyPlanPathHandle::WaitFor, args("timeout"), DOXY_FN(PlannerBase::PlanPathHandle,WaitFor))
+        .def("IsDone",&PyPlanPathHandle::IsDone, DOXY_FN(PlannerBase::PlanPathHandle,IsDone))
+        .def("Cancel",&PyPlanPathHandle::Cancel, DOXY_FN(PlannerBase::PlanPathHandle,Cancel))
+        .def("RequestAnySolution",&PyPlanPathHandle::RequestAnySolution, DOXY_FN(PlannerBase::PlanPathHandle,RequestAnySolution))
+        .def("IsCancelled",&PyPlanPathHandle::IsCancelled, DOXY_FN(PlannerBase::PlanPathHandle,IsCancelled))
+        .def("GetProgress",&PyPlanPathHandle::GetProgress, DOXY_FN(PlannerBase::PlanPathHandle,GetProgress))
+        .def("GetNumProgressUpdates",&PyPlanPathHandle::GetNumProgressUpdates, DOXY_FN(PlannerBase::PlanPathHandle,GetNumProgressUpdates))
+        .def("Close",&PyPlanPathHandle::Close, "cancels the planning if it is still running and waits for it to return")
+        ;
+
         class_<PyPlannerBase::PyPlannerParameters, PyPlannerBase::PyPlannerParametersPtr >("PlannerParameters", DOXY_CLASS(PlannerBase::PlannerParameters))
         .def(init<>())
         .def(init<PyPlannerBase::PyPlannerParametersPtr>(args("parameters")))
@@ -371,6 +568,11 @@ void init_openravepy_planner()
         .def("SetMaxIterations",&PyPlannerBase::PyPlannerParameters::SetMaxIterations,args("maxiterations"),"sets PlannerParameters::_nMaxIterations")
         .def("CheckPathAllConstraints",&PyPlannerBase::PyPlannerParameters::CheckPathAllConstraints,CheckPathAllConstraints_overloads(args("q0","q1","dq0","dq1","timeelapsed","interval","options", "filterreturn"),DOXY_FN(PlannerBase::PlannerParameters, CheckPathAllConstraints)))
         .def("SetPostProcessing", &PyPlannerBase::PyPlannerParameters::SetPostProcessing, args("plannername", "plannerparameters"), "sets the post processing parameters")
+        .def("SetDistanceMetricFn", &PyPlannerBase::PyPlannerParameters::SetDistanceMetricFn, args("fn"), "sets PlannerParameters::_distmetricfn to fn(q0,q1) -> distance. q0 and q1 are read-only arrays only valid during the call")
+        .def("SetDistanceMetricBatchFn", &PyPlannerBase::PyPlannerParameters::SetDistanceMetricBatchFn, args("fn"), "sets PlannerParameters::_distmetricbatchfn to fn(q,configs,distances), which fills the N distances between q and the rows of the Nxdof array configs. distances is a writeable array, the other arrays are read-only and all are only valid during the call. None clears it")
+        .def("SetNeighStateFn", &PyPlannerBase::PyPlannerParameters::SetNeighStateFn, args("fn"), "sets PlannerParameters::_neighstatefn to fn(q,qdelta,options) -> success, which modifies the writeable array q in place. The arrays are only valid during the call")
+        .def("SetCheckPathVelocityConstraintsFn", &PyPlannerBase::PyPlannerParameters::SetCheckPathVelocityConstraintsFn, args("fn"), "sets PlannerParameters::_checkpathvelocityconstraintsfn to fn(q0,q1,dq0,dq1,timeelapsed,interval,options) -> returncode, 0 if the path is valid. The arrays are read-only and only valid during the call")
+        .def("Serialize",&PyPlannerBase::PyPlannerParameters::Serialize, "returns the xml of all the parameters, which can be passed to Planner.InitPlan(robot,xmlparams)")
         .def("__str__",&PyPlannerBase::PyPlannerParameters::__str__)
         .def("__unicode__",&PyPlannerBase::PyPlannerParameters::__unicode__)
         .def("__repr__",&PyPlannerBase::PyPlannerParameters::__repr__)
@@ -59,14 +59,36 @@ object pyGetReverseTrajectory(PyTrajectoryBasePtr pytraj)
     return object(openravepy::toPyTrajectory(OpenRAVE::planningutils::GetReverseTrajectory(openravepy::GetTrajectory(pytraj)),openravepy::toPyEnvironment(pytraj)));
 }
 
+object pyGetReverseTrajectoryView(PyTrajectoryBasePtr pytraj)
+{
+    return object(openravepy::toPyTrajectory(OpenRAVE::planningutils::GetReverseTrajectoryView(openravepy::GetTrajectory(pytraj)),openravepy::toPyEnvironment(pytraj)));
+}
+
 void pyVerifyTrajectory(object pyparameters, PyTrajectoryBasePtr pytraj, dReal samplingstep)
 {
     OpenRAVE::planningutils::VerifyTrajectory(openravepy::GetPlannerParametersConst(pyparameters), openravepy::GetTrajectory(pytraj),samplingstep);
 }
 
-PlannerStatus pySmoothActiveDOFTrajectory(PyTrajectoryBasePtr pytraj, PyRobotBasePtr pyrobot, dReal fmaxvelmult=1.0, dReal fmaxaccelmult=1.0, const std::string& plannername="", const std::string& plannerparameters="")
+object pyVerifyTrajectoryIntervals(object pyparameters, PyTrajectoryBasePtr pytraj, dReal samplingstep=0.002, int numthreads=1, bool bstopatfirst=true)
 {
-    return OpenRAVE::planningutils::SmoothActiveDOFTrajectory(openravepy::GetTrajectory(pytraj),openravepy::GetRobot(pyrobot),fmaxvelmult,fmaxaccelmult,plannername,plannerparameters);
+    std::vector<OpenRAVE::planningutils::InvalidTrajectoryInterval> vinvalidintervals;
+    OpenRAVE::planningutils::VerifyTrajectoryIntervals(openravepy::GetPlannerParametersConst(pyparameters), openravepy::GetTrajectory(pytraj), vinvalidintervals, samplingstep, numthreads, bstopatfirst);
+    boost::python::list ointervals;
+    FOREACHC(itinterval, vinvalidintervals) {
+        ointervals.append(boost::python::make_tuple(itinterval->starttime, itinterval->endtime, itinterval->message));
+    }
+    return ointervals;
+}
+
+PlannerStatus pySmoothActiveDOFTrajectory(PyTrajectoryBasePtr pytraj, PyRobotBasePtr pyrobot, dReal fmaxvelmult=1.0, dReal fmaxaccelmult=1.0, const std::string& plannername="", const std::string& plannerparameters="", bool releasegil=true)
+{
+    openravepy::PythonThreadSaverPtr statesaver;
+    TrajectoryBasePtr ptraj = openravepy::GetTrajectory(pytraj);
+    RobotBasePtr probot = openravepy::GetRobot(pyrobot);
+    if( releasegil ) {
+        statesaver.reset(new openravepy::PythonThreadSaver());
+    }
+    return OpenRAVE::planningutils::SmoothActiveDOFTrajectory(ptraj,probot,fmaxvelmult,fmaxaccelmult,plannername,plannerparameters);
 }
 
 class PyActiveDOFTrajectorySmoother
@@ -92,19 +114,37 @@ public:
 
 typedef boost::shared_ptr<PyActiveDOFTrajectorySmoother> PyActiveDOFTrajectorySmootherPtr;
 
-PlannerStatus pySmoothAffineTrajectory(PyTrajectoryBasePtr pytraj, object omaxvelocities, object omaxaccelerations, const std::string& plannername="", const std::string& plannerparameters="")
+PlannerStatus pySmoothAffineTrajectory(PyTrajectoryBasePtr pytraj, object omaxvelocities, object omaxaccelerations, const std::string& plannername="", const std::string& plannerparameters="", bool releasegil=true)
 {
-    return OpenRAVE::planningutils::SmoothAffineTrajectory(openravepy::GetTrajectory(pytraj),ExtractArray<dReal>(omaxvelocities), ExtractArray<dReal>(omaxaccelerations),plannername,plannerparameters);
+    openravepy::PythonThreadSaverPtr statesaver;
+    TrajectoryBasePtr ptraj = openravepy::GetTrajectory(pytraj);
+    std::vector<dReal> vmaxvelocities = ExtractArray<dReal>(omaxvelocities);
+    std::vector<dReal> vmaxaccelerations = ExtractArray<dReal>(omaxaccelerations);
+    if( releasegil ) {
+        statesaver.reset(new openravepy::PythonThreadSaver());
+    }
+    return OpenRAVE::planningutils::SmoothAffineTrajectory(ptraj,vmaxvelocities,vmaxaccelerations,plannername,plannerparameters);
 }
 
-PlannerStatus pySmoothTrajectory(PyTrajectoryBasePtr pytraj, dReal fmaxvelmult=1.0, dReal fmaxaccelmult=1.0, const std::string& plannername="", const std::string& plannerparameters="")
+PlannerStatus pySmoothTrajectory(PyTrajectoryBasePtr pytraj, dReal fmaxvelmult=1.0, dReal fmaxaccelmult=1.0, const std::string& plannername="", const std::string& plannerparameters="", bool releasegil=true)
 {
-    return OpenRAVE::planningutils::SmoothTrajectory(openravepy::GetTrajectory(pytraj),fmaxvelmult,fmaxaccelmult,plannername,plannerparameters);
+    openravepy::PythonThreadSaverPtr statesaver;
+    TrajectoryBasePtr ptraj = openravepy::GetTrajectory(pytraj);
+    if( releasegil ) {
+        statesaver.reset(new openravepy::PythonThreadSaver());
+    }
+    return OpenRAVE::planningutils::SmoothTrajectory(ptraj,fmaxvelmult,fmaxaccelmult,plannername,plannerparameters);
 }
 
-PlannerStatus pyRetimeActiveDOFTrajectory(PyTrajectoryBasePtr pytraj, PyRobotBasePtr pyrobot, bool hastimestamps=false, dReal fmaxvelmult=1.0, dReal fmaxaccelmult=1.0, const std::string& plannername="", const std::string& plannerparameters="")
+PlannerStatus pyRetimeActiveDOFTrajectory(PyTrajectoryBasePtr pytraj, PyRobotBasePtr pyrobot, bool hastimestamps=false, dReal fmaxvelmult=1.0, dReal fmaxaccelmult=1.0, const std::string& plannername="", const std::string& plannerparameters="", bool releasegil=true)
 {
-    return OpenRAVE::planningutils::RetimeActiveDOFTrajectory(openravepy::GetTrajectory(pytraj),openravepy::GetRobot(pyrobot),hastimestamps,fmaxvelmult,fmaxaccelmult,plannername,plannerparameters);
+    openravepy::PythonThreadSaverPtr statesaver;
+    TrajectoryBasePtr ptraj = openravepy::GetTrajectory(pytraj);
+    RobotBasePtr probot = openravepy::GetRobot(pyrobot);
+    if( releasegil ) {
+        statesaver.reset(new openravepy::PythonThreadSaver());
+    }
+    return OpenRAVE::planningutils::RetimeActiveDOFTrajectory(ptraj,probot,hastimestamps,fmaxvelmult,fmaxaccelmult,plannername,plannerparameters);
 }
 
 class PyActiveDOFTrajectoryRetimer
@@ -190,6 +230,7 @@ public:
             ofilterreturn["invalidvelocities"] = toPyArray(pfilterreturn->_invalidvelocities);
             ofilterreturn["fTimeWhenInvalid"] = pfilterreturn->_fTimeWhenInvalid;
             ofilterreturn["returncode"] = pfilterreturn->_returncode;
+            ofilterreturn["numcheckedconfigurations"] = pfilterreturn->_numcheckedconfigurations;
             ofilterreturn["reportstr"] = pfilterreturn->_report.__str__();
             return ofilterreturn;
         }
@@ -229,24 +270,27 @@ public:
 
 typedef boost::shared_ptr<PyDynamicsCollisionConstraint> PyDynamicsCollisionConstraintPtr;
 
-PlannerStatus pyRetimeAffineTrajectory(PyTrajectoryBasePtr pytraj, object omaxvelocities, object omaxaccelerations, bool hastimestamps=false, const std::string& plannername="", const std::string& plannerparameters="", bool releasegil=false)
+PlannerStatus pyRetimeAffineTrajectory(PyTrajectoryBasePtr pytraj, object omaxvelocities, object omaxaccelerations, bool hastimestamps=false, const std::string& plannername="", const std::string& plannerparameters="", bool releasegil=true)
 {
     openravepy::PythonThreadSaverPtr statesaver;
+    // extract python objects before releasing the gil
+    TrajectoryBasePtr ptraj = openravepy::GetTrajectory(pytraj);
+    std::vector<dReal> vmaxvelocities = ExtractArray<dReal>(omaxvelocities);
+    std::vector<dReal> vmaxaccelerations = ExtractArray<dReal>(omaxaccelerations);
     if( releasegil ) {
         statesaver.reset(new openravepy::PythonThreadSaver());
     }
-
-    return OpenRAVE::planningutils::RetimeAffineTrajectory(openravepy::GetTrajectory(pytraj),ExtractArray<dReal>(omaxvelocities), ExtractArray<dReal>(omaxaccelerations),hastimestamps,plannername,plannerparameters);
+    return OpenRAVE::planningutils::RetimeAffineTrajectory(ptraj,vmaxvelocities,vmaxaccelerations,hastimestamps,plannername,plannerparameters);
 }
 
-PlannerStatus pyRetimeTrajectory(PyTrajectoryBasePtr pytraj, bool hastimestamps=false, dReal fmaxvelmult=1.0, dReal fmaxaccelmult=1.0, const std::string& plannername="", const std::string& plannerparameters="", bool releasegil=false)
+PlannerStatus pyRetimeTrajectory(PyTrajectoryBasePtr pytraj, bool hastimestamps=false, dReal fmaxvelmult=1.0, dReal fmaxaccelmult=1.0, const std::string& plannername="", const std::string& plannerparameters="", bool releasegil=true)
 {
     openravepy::PythonThreadSaverPtr statesaver;
+    TrajectoryBasePtr ptraj = openravepy::GetTrajectory(pytraj);
     if( releasegil ) {
         statesaver.reset(new openravepy::PythonThreadSaver());
     }
-
-    return OpenRAVE::planningutils::RetimeTrajectory(openravepy::GetTrajectory(pytraj),hastimestamps,fmaxvelmult,fmaxaccelmult,plannername,plannerparameters);
+    return OpenRAVE::planningutils::RetimeTrajectory(ptraj,hastimestamps,fmaxvelmult,fmaxaccelmult,plannername,plannerparameters);
 }
 
 size_t pyExtendWaypoint(int index, object odofvalues, object odofvelocities, PyTrajectoryBasePtr pytraj, PyPlannerBasePtr pyplanner)
@@ -269,6 +313,16 @@ size_t pyInsertWaypointWithSmoothing(int index, object odofvalues, object odofve
     return OpenRAVE::planningutils::InsertWaypointWithSmoothing(index,ExtractArray<dReal>(odofvalues),ExtractArray<dReal>(odofvelocities),openravepy::GetTrajectory(pytraj),fmaxvelmult,fmaxaccelmult,plannername);
 }
 
+object pyGetTrajectorySegment(PyTrajectoryBasePtr pytraj, dReal starttime, dReal endtime)
+{
+    return object(openravepy::toPyTrajectory(OpenRAVE::planningutils::GetTrajectorySegment(openravepy::GetTrajectory(pytraj),starttime,endtime),openravepy::toPyEnvironment(pytraj)));
+}
+
+object pyGetTrajectorySegmentView(PyTrajectoryBasePtr pytraj, dReal starttime, dReal endtime)
+{
+    return object(openravepy::toPyTrajectory(OpenRAVE::planningutils::GetTrajectorySegmentView(openravepy::GetTrajectory(pytraj),starttime,endtime),openravepy::toPyEnvironment(pytraj)));
+}
+
 void pySegmentTrajectory(PyTrajectoryBasePtr pytraj, dReal starttime, dReal endtime)
 {
     OpenRAVE::planningutils::SegmentTrajectory(openravepy::GetTrajectory(pytraj), starttime, endtime);
@@ -371,14 +425,29 @@ public:
     object Sample(bool ikreturn = false, bool releasegil = false)
     {
         if( ikreturn ) {
-            IkReturnPtr pikreturn = _sampler->Sample();
+            IkReturnPtr pikreturn;
+            {
+                openravepy::PythonThreadSaverPtr statesaver;
+                if( releasegil ) {
+                    statesaver.reset(new openravepy::PythonThreadSaver());
+                }
+                pikreturn = _sampler->Sample();
+            }
             if( !!pikreturn ) {
                 return openravepy::toPyIkReturn(*pikreturn);
             }
         }
         else {
             std::vector<dReal> vgoal;
-            if( _sampler->Sample(vgoal) ) {
+            bool bsuccess;
+            {
+                openravepy::PythonThreadSaverPtr statesaver;
+                if( releasegil ) {
+                    statesaver.reset(new openravepy::PythonThreadSaver());
+                }
+                bsuccess = _sampler->Sample(vgoal);
+            }
+            if( bsuccess ) {
                 return toPyArray(vgoal);
             }
         }
@@ -407,6 +476,25 @@ public:
         return _sampler->GetIkParameterizationIndex(index);
     }
 
+    void SetBatchSolving(bool bbatch)
+    {
+        _sampler->SetBatchSolving(bbatch);
+    }
+
+    object FindClosestIkParameterization(object oikparam)
+    {
+        IkParameterization ikparam;
+        if( !ExtractIkParameterization(oikparam,ikparam) ) {
+            throw OPENRAVE_EXCEPTION_FORMAT0(_("FindClosestIkParameterization needs an IkParameterization"),ORE_InvalidArguments);
+        }
+        dReal fdistsqr = 0;
+        int index = _sampler->FindClosestIkParameterization(ikparam, fdistsqr);
+        if( index < 0 ) {
+            return object();
+        }
+        return boost::python::make_tuple(index, fdistsqr);
+    }
+
     OpenRAVE::planningutils::ManipulatorIKGoalSamplerPtr _sampler;
 };
 
@@ -419,10 +507,11 @@ BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(SampleAll_overloads, SampleAll, 0, 3)
 
 BOOST_PYTHON_FUNCTION_OVERLOADS(JitterCurrentConfiguration_overloads, planningutils::pyJitterCurrentConfiguration, 1, 4);
 BOOST_PYTHON_FUNCTION_OVERLOADS(JitterTransform_overloads, planningutils::pyJitterTransform, 2, 3);
-BOOST_PYTHON_FUNCTION_OVERLOADS(SmoothActiveDOFTrajectory_overloads, planningutils::pySmoothActiveDOFTrajectory, 2, 6)
-BOOST_PYTHON_FUNCTION_OVERLOADS(SmoothAffineTrajectory_overloads, planningutils::pySmoothAffineTrajectory, 3, 5)
-BOOST_PYTHON_FUNCTION_OVERLOADS(SmoothTrajectory_overloads, planningutils::pySmoothTrajectory, 1, 5)
-BOOST_PYTHON_FUNCTION_OVERLOADS(RetimeActiveDOFTrajectory_overloads, planningutils::pyRetimeActiveDOFTrajectory, 2, 7)
+BOOST_PYTHON_FUNCTION_OVERLOADS(VerifyTrajectoryIntervals_overloads, planningutils::pyVerifyTrajectoryIntervals, 2, 5);
+BOOST_PYTHON_FUNCTION_OVERLOADS(SmoothActiveDOFTrajectory_overloads, planningutils::pySmoothActiveDOFTrajectory, 2, 7)
+BOOST_PYTHON_FUNCTION_OVERLOADS(SmoothAffineTrajectory_overloads, planningutils::pySmoothAffineTrajectory, 3, 6)
+BOOST_PYTHON_FUNCTION_OVERLOADS(SmoothTrajectory_overloads, planningutils::pySmoothTrajectory, 1, 6)
+BOOST_PYTHON_FUNCTION_OVERLOADS(RetimeActiveDOFTrajectory_overloads, planningutils::pyRetimeActiveDOFTrajectory, 2, 8)
 BOOST_PYTHON_FUNCTION_OVERLOADS(RetimeAffineTrajectory_overloads, planningutils::pyRetimeAffineTrajectory, 3, 7)
 BOOST_PYTHON_FUNCTION_OVERLOADS(RetimeTrajectory_overloads, planningutils::pyRetimeTrajectory, 1, 7)
 BOOST_PYTHON_FUNCTION_OVERLOADS(ExtendActiveDOFWaypoint_overloads, planningutils::pyExtendActiveDOFWaypoint, 5, 8)
@@ -448,15 +537,21 @@ void InitPlanningUtils()
                   .staticmethod("ComputeTrajectoryDerivatives")
                   .def("ReverseTrajectory",planningutils::pyReverseTrajectory,args("trajectory"),DOXY_FN1(ReverseTrajectory))
                   .staticmethod("ReverseTrajectory")
+                  .def("GetReverseTrajectory",planningutils::pyGetReverseTrajectory,args("trajectory"),DOXY_FN1(GetReverseTrajectory))
+                  .staticmethod("GetReverseTrajectory")
+                  .def("GetReverseTrajectoryView",planningutils::pyGetReverseTrajectoryView,args("trajectory"),DOXY_FN1(GetReverseTrajectoryView))
+                  .staticmethod("GetReverseTrajectoryView")
                   .def("VerifyTrajectory",planningutils::pyVerifyTrajectory,args("parameters","trajectory","samplingstep"),DOXY_FN1(VerifyTrajectory))
                   .staticmethod("VerifyTrajectory")
-                  .def("SmoothActiveDOFTrajectory",planningutils::pySmoothActiveDOFTrajectory, SmoothActiveDOFTrajectory_overloads(args("trajectory","robot","maxvelmult","maxaccelmult","plannername","plannerparameters"),DOXY_FN1(SmoothActiveDOFTrajectory)))
+                  .def("VerifyTrajectoryIntervals",planningutils::pyVerifyTrajectoryIntervals,VerifyTrajectoryIntervals_overloads(args("parameters","trajectory","samplingstep","numthreads","stopatfirst"),DOXY_FN1(VerifyTrajectoryIntervals)))
+                  .staticmethod("VerifyTrajectoryIntervals")
+                  .def("SmoothActiveDOFTrajectory",planningutils::pySmoothActiveDOFTrajectory, SmoothActiveDOFTrajectory_overloads(args("trajectory","robot","maxvelmult","maxaccelmult","plannername","plannerparameters","releasegil"),DOXY_FN1(SmoothActiveDOFTrajectory)))
                   .staticmethod("SmoothActiveDOFTrajectory")
-                  .def("SmoothAffineTrajectory",planningutils::pySmoothAffineTrajectory, SmoothAffineTrajectory_overloads(args("trajectory","maxvelocities","maxaccelerations","plannername","plannerparameters"),DOXY_FN1(SmoothAffineTrajectory)))
+                  .def("SmoothAffineTrajectory",planningutils::pySmoothAffineTrajectory, SmoothAffineTrajectory_overloads(args("trajectory","maxvelocities","maxaccelerations","plannername","plannerparameters","releasegil"),DOXY_FN1(SmoothAffineTrajectory)))
                   .staticmethod("SmoothAffineTrajectory")
-                  .def("SmoothTrajectory",planningutils::pySmoothTrajectory, SmoothTrajectory_overloads(args("trajectory","maxvelmult","maxaccelmult","plannername","plannerparameters"),DOXY_FN1(SmoothTrajectory)))
+                  .def("SmoothTrajectory",planningutils::pySmoothTrajectory, SmoothTrajectory_overloads(args("trajectory","maxvelmult","maxaccelmult","plannername","plannerparameters","releasegil"),DOXY_FN1(SmoothTrajectory)))
                   .staticmethod("SmoothTrajectory")
-                  .def("RetimeActiveDOFTrajectory",planningutils::pyRetimeActiveDOFTrajectory, RetimeActiveDOFTrajectory_overloads(args("trajectory","robot","hastimestamps","maxvelmult","maxaccelmult","plannername","plannerparameters"),DOXY_FN1(RetimeActiveDOFTrajectory)))
+                  .def("RetimeActiveDOFTrajectory",planningutils::pyRetimeActiveDOFTrajectory, RetimeActiveDOFTrajectory_overloads(args("trajectory","robot","hastimestamps","maxvelmult","maxaccelmult","plannername","plannerparameters","releasegil"),DOXY_FN1(RetimeActiveDOFTrajectory)))
                   .staticmethod("RetimeActiveDOFTrajectory")
                   .def("RetimeAffineTrajectory",planningutils::pyRetimeAffineTrajectory, RetimeAffineTrajectory_overloads(args("trajectory","maxvelocities","maxaccelerations","hastimestamps","plannername","plannerparameters", "releasegil"),DOXY_FN1(RetimeAffineTrajectory)))
                   .staticmethod("RetimeAffineTrajectory")
@@ -472,6 +567,10 @@ void InitPlanningUtils()
                   .staticmethod("InsertWaypointWithSmoothing")
                   .def("SegmentTrajectory",planningutils::pySegmentTrajectory,args("trajectory","starttime", "endtime"),DOXY_FN1(SegmentTrajectory))
                   .staticmethod("SegmentTrajectory")
+                  .def("GetTrajectorySegment",planningutils::pyGetTrajectorySegment,args("trajectory","starttime", "endtime"),DOXY_FN1(GetTrajectorySegment))
+                  .staticmethod("GetTrajectorySegment")
+                  .def("GetTrajectorySegmentView",planningutils::pyGetTrajectorySegmentView,args("trajectory","starttime", "endtime"),DOXY_FN1(GetTrajectorySegmentView))
+                  .staticmethod("GetTrajectorySegmentView")
                   .def("MergeTrajectories",planningutils::pyMergeTrajectories,args("trajectories"),DOXY_FN1(MergeTrajectories))
                   .staticmethod("MergeTrajectories")
                   .def("GetDHParameters",planningutils::pyGetDHParameters,args("body"),DOXY_FN1(GetDHParameters))
@@ -500,6 +599,8 @@ void InitPlanningUtils()
         .def("Sample",&planningutils::PyManipulatorIKGoalSampler::Sample, Sample_overloads(args("ikreturn","releasegil"),DOXY_FN(planningutils::ManipulatorIKGoalSampler, Sample)))
         .def("SampleAll",&planningutils::PyManipulatorIKGoalSampler::SampleAll, SampleAll_overloads(args("maxsamples", "maxchecksamples", "releasegil"),DOXY_FN(planningutils::ManipulatorIKGoalSampler, SampleAll)))
         .def("GetIkParameterizationIndex", &planningutils::PyManipulatorIKGoalSampler::GetIkParameterizationIndex, args("index"), DOXY_FN(planningutils::ManipulatorIKGoalSampler, GetIkParameterizationIndex))
+        .def("SetBatchSolving", &planningutils::PyManipulatorIKGoalSampler::SetBatchSolving, args("batch"), DOXY_FN(planningutils::ManipulatorIKGoalSampler, SetBatchSolving))
+        .def("FindClosestIkParameterization", &planningutils::PyManipulatorIKGoalSampler::FindClosestIkParameterization, args("ikparam"), "Returns (index, squared distance) of the closest goal parameterization, or None if no goal has the type of ikparam")
         ;
 
         class_<planningutils::PyActiveDOFTrajectorySmoother, planningutils::PyActiveDOFTrajectorySmootherPtr >("ActiveDOFTrajectorySmoother", DOXY_CLASS(planningutils::ActiveDOFTrajectorySmoother), no_init)
@@ -579,6 +579,14 @@ public:
             return toPyArray(vjacobian,dims);
         }
 
+        object CalculateJacobians()
+        {
+            std::vector<dReal> vjacobian;
+            _pmanip->CalculateJacobians(vjacobian);
+            std::vector<npy_intp> dims(2); dims[0] = 6; dims[1] = vjacobian.size()/6;
+            return toPyArray(vjacobian,dims);
+        }
+
         object GetInfo() {
             return object(PyManipulatorInfoPtr(new PyManipulatorInfo(_pmanip->GetInfo())));
         }
@@ -1260,6 +1268,12 @@ public:
     void RegrabAll() {
         _probot->RegrabAll();
     }
+    void SetGrabbedCollidingLinksCacheResolution(dReal fResolution) {
+        _probot->SetGrabbedCollidingLinksCacheResolution(fResolution);
+    }
+    dReal GetGrabbedCollidingLinksCacheResolution() const {
+        return _probot->GetGrabbedCollidingLinksCacheResolution();
+    }
     object IsGrabbing(PyKinBodyPtr pbody) const {
         CHECK_POINTER(pbody);
         KinBody::LinkPtr plink = _probot->IsGrabbing(pbody->GetBody());
@@ -1609,6 +1623,8 @@ void init_openravepy_robot()
                       .def("Release",&PyRobotBase::Release,args("body"), DOXY_FN(RobotBase,Release))
                       .def("ReleaseAllGrabbed",&PyRobotBase::ReleaseAllGrabbed, DOXY_FN(RobotBase,ReleaseAllGrabbed))
                       .def("RegrabAll",&PyRobotBase::RegrabAll, DOXY_FN(RobotBase,RegrabAll))
+                      .def("SetGrabbedCollidingLinksCacheResolution",&PyRobotBase::SetGrabbedCollidingLinksCacheResolution,args("resolution"), DOXY_FN(RobotBase,SetGrabbedCollidingLinksCacheResolution))
+                      .def("GetGrabbedCollidingLinksCacheResolution",&PyRobotBase::GetGrabbedCollidingLinksCacheResolution, DOXY_FN(RobotBase,GetGrabbedCollidingLinksCacheResolution))
                       .def("IsGrabbing",&PyRobotBase::IsGrabbing,args("body"), DOXY_FN(RobotBase,IsGrabbing))
                       .def("GetGrabbed",&PyRobotBase::GetGrabbed, DOXY_FN(RobotBase,GetGrabbed))
                       .def("GetGrabbedInfo",&PyRobotBase::GetGrabbedInfo, DOXY_FN(RobotBase,GetGrabbedInfo))
@@ -1691,6 +1707,7 @@ void init_openravepy_robot()
         .def("CalculateJacobian",&PyRobotBase::PyManipulator::CalculateJacobian,DOXY_FN(RobotBase::Manipulator,CalculateJacobian))
         .def("CalculateRotationJacobian",&PyRobotBase::PyManipulator::CalculateRotationJacobian,DOXY_FN(RobotBase::Manipulator,CalculateRotationJacobian))
         .def("CalculateAngularVelocityJacobian",&PyRobotBase::PyManipulator::CalculateAngularVelocityJacobian,DOXY_FN(RobotBase::Manipulator,CalculateAngularVelocityJacobian))
+        .def("CalculateJacobians",&PyRobotBase::PyManipulator::CalculateJacobians,DOXY_FN(RobotBase::Manipulator,CalculateJacobians))
         .def("GetStructureHash",&PyRobotBase::PyManipulator::GetStructureHash, DOXY_FN(RobotBase::Manipulator,GetStructureHash))
         .def("GetKinematicsStructureHash",&PyRobotBase::PyManipulator::GetKinematicsStructureHash, DOXY_FN(RobotBase::Manipulator,GetKinematicsStructureHash))
         .def("GetInverseKinematicsStructureHash",&PyRobotBase::PyManipulator::GetInverseKinematicsStructureHash, args("iktype"), DOXY_FN(RobotBase::Manipulator,GetInverseKinematicsStructureHash))
@@ -328,12 +328,13 @@ public:
     class PySensorData
     {
 public:
-        PySensorData(SensorBase::SensorType type) : type(type), stamp(0) {
+        PySensorData(SensorBase::SensorType type) : type(type), stamp(0), sequence(0) {
         }
         PySensorData(SensorBase::SensorDataPtr pdata)
         {
             type = pdata->GetType();
             stamp = pdata->__stamp;
+            sequence = pdata->__sequence;
             transform = ReturnTransform(pdata->__trans);
         }
         virtual ~PySensorData() {
@@ -342,6 +343,7 @@ public:
 
         SensorBase::SensorType type;
         uint64_t stamp;
+        uint64_t sequence;
         object transform;
     };
 
@@ -377,6 +379,12 @@ public:
                 }
                 imagedata = static_cast<numeric::array>(handle<>(pyvalues));
             }
+            if( (int)pdata->vdepthdata.size() == pgeom->height*pgeom->width && pdata->vdepthdata.size() > 0 ) {
+                npy_intp dims[] = { pgeom->height,pgeom->width};
+                PyObject *pyvalues = PyArray_SimpleNew(2,dims, PyArray_FLOAT);
+                memcpy(PyArray_DATA(pyvalues),&pdata->vdepthdata[0],pdata->vdepthdata.size()*sizeof(float));
+                depthdata = static_cast<numeric::array>(handle<>(pyvalues));
+            }
         }
         PyCameraSensorData(boost::shared_ptr<SensorBase::CameraGeomData const> pgeom) : PySensorData(SensorBase::ST_Camera), intrinsics(pgeom->intrinsics)
         {
@@ -394,7 +402,7 @@ public:
         }
         virtual ~PyCameraSensorData() {
         }
-        object imagedata, KK;
+        object imagedata, depthdata, KK;
         PyCameraIntrinsics intrinsics;
     };
 
@@ -614,6 +622,20 @@ public:
         return ConvertToPySensorData(psensordata);
     }
 
+    boost::shared_ptr<PySensorData> GetLatestSensorData()
+    {
+        return GetLatestSensorData(SensorBase::ST_Invalid);
+    }
+    boost::shared_ptr<PySensorData> GetLatestSensorData(SensorBase::SensorType type)
+    {
+        SensorBase::SensorDataConstPtr psensordata = _psensor->GetLatestSensorData(type);
+        if( !psensordata ) {
+            return boost::shared_ptr<PySensorData>();
+        }
+        // the converters only read the data
+        return ConvertToPySensorData(boost::const_pointer_cast<SensorBase::SensorData>(psensordata));
+    }
+
     boost::shared_ptr<PySensorData> ConvertToPySensorData(SensorBase::SensorDataPtr psensordata)
     {
         if( !psensordata ) {
@@ -735,11 +757,15 @@ void init_openravepy_sensor()
     {
         boost::shared_ptr<PySensorBase::PySensorData> (PySensorBase::*GetSensorData1)() = &PySensorBase::GetSensorData;
         boost::shared_ptr<PySensorBase::PySensorData> (PySensorBase::*GetSensorData2)(SensorBase::SensorType) = &PySensorBase::GetSensorData;
+        boost::shared_ptr<PySensorBase::PySensorData> (PySensorBase::*GetLatestSensorData1)() = &PySensorBase::GetLatestSensorData;
+        boost::shared_ptr<PySensorBase::PySensorData> (PySensorBase::*GetLatestSensorData2)(SensorBase::SensorType) = &PySensorBase::GetLatestSensorData;
         scope sensor = class_<PySensorBase, boost::shared_ptr<PySensorBase>, bases<PyInterfaceBase> >("Sensor", DOXY_CLASS(SensorBase), no_init)
                        .def("Configure",&PySensorBase::Configure, Configure_overloads(args("command","blocking"), DOXY_FN(SensorBase,Configure)))
                        .def("SimulationStep",&PySensorBase::SimulationStep, args("timeelapsed"), DOXY_FN(SensorBase,SimulationStep))
                        .def("GetSensorData",GetSensorData1, DOXY_FN(SensorBase,GetSensorData))
                        .def("GetSensorData",GetSensorData2, DOXY_FN(SensorBase,GetSensorData))
+                       .def("GetLatestSensorData",GetLatestSensorData1, DOXY_FN(SensorBase,GetLatestSensorData))
+                       .def("GetLatestSensorData",GetLatestSensorData2, args("type"), DOXY_FN(SensorBase,GetLatestSensorData))
                        .def("CreateSensorData",&PySensorBase::CreateSensorData, DOXY_FN(SensorBase,CreateSensorData))
                        .def("GetSensorGeometry",&PySensorBase::GetSensorGeometry,DOXY_FN(SensorBase,GetSensorGeometry))
                        .def("SetSensorGeometry",&PySensorBase::SetSensorGeometry, DOXY_FN(SensorBase,SetSensorGeometry))
@@ -763,6 +789,7 @@ void init_openravepy_sensor()
         class_<PySensorBase::PySensorData, boost::shared_ptr<PySensorBase::PySensorData> >("SensorData", DOXY_CLASS(SensorBase::SensorData),no_init)
         .def_readonly("type",&PySensorBase::PySensorData::type)
         .def_readonly("stamp",&PySensorBase::PySensorData::stamp)
+        .def_readonly("sequence",&PySensorBase::PySensorData::sequence)
         ;
         class_<PySensorBase::PyLaserSensorData, boost::shared_ptr<PySensorBase::PyLaserSensorData>, bases<PySensorBase::PySensorData> >("LaserSensorData", DOXY_CLASS(SensorBase::LaserSensorData),no_init)
         .def_readonly("positions",&PySensorBase::PyLaserSensorData::positions)
@@ -772,6 +799,7 @@ void init_openravepy_sensor()
         class_<PySensorBase::PyCameraSensorData, boost::shared_ptr<PySensorBase::PyCameraSensorData>, bases<PySensorBase::PySensorData> >("CameraSensorData", DOXY_CLASS(SensorBase::CameraSensorData),no_init)
         .def_readonly("transform",&PySensorBase::PyCameraSensorData::transform)
         .def_readonly("imagedata",&PySensorBase::PyCameraSensorData::imagedata)
+        .def_readonly("depthdata",&PySensorBase::PyCameraSensorData::depthdata)
         .def_readonly("KK",&PySensorBase::PyCameraSensorData::KK)
         .def_readonly("intrinsics",&PySensorBase::PyCameraSensorData::intrinsics)
         ;
@@ -39,6 +39,13 @@ public:
     void SetSpaceDOF(int dof) {
         _pspacesampler->SetSpaceDOF(dof);
     }
+    object CreateSubstream(uint32_t index, uint32_t numsubstreams) {
+        SpaceSamplerBasePtr psubstream = _pspacesampler->CreateSubstream(index, numsubstreams);
+        if( !psubstream ) {
+            return object();
+        }
+        return object(boost::shared_ptr<PySpaceSamplerBase>(new PySpaceSamplerBase(psubstream, _pyenv)));
+    }
     int GetDOF() {
         return _pspacesampler->GetDOF();
     }
@@ -83,9 +90,16 @@ public:
     object SampleSequence2D(SampleDataType type, size_t num,IntervalType interval=IT_Closed)
     {
         if( type == SDT_Real ) {
-            std::vector<dReal> samples;
-            _pspacesampler->SampleSequence(samples,num,interval);
-            return _ReturnSamples2D(samples);
+            // sample directly into the numpy array
+            int dim = _pspacesampler->GetNumberOfValues();
+            npy_intp dims[] = { npy_intp(num), npy_intp(dim) };
+            PyObject *pyvalues = PyArray_SimpleNew(2,dims, sizeof(dReal)==8 ? PyArray_DOUBLE : PyArray_FLOAT);
+            handle<> hvalues(pyvalues);
+            int ret = num*dim > 0 ? _pspacesampler->SampleSequence((dReal*)PyArray_DATA(pyvalues),num,interval) : 0;
+            if( ret <= 0 ) {
+                return _ReturnSamples2D(std::vector<dReal>());
+            }
+            return static_cast<numeric::array>(hvalues);
         }
         else if( type == SDT_Uint32 ) {
             std::vector<uint32_t> samples;
@@ -191,6 +205,7 @@ void init_openravepy_spacesampler()
         scope spacesampler = class_<PySpaceSamplerBase, boost::shared_ptr<PySpaceSamplerBase>, bases<PyInterfaceBase> >("SpaceSampler", DOXY_CLASS(SpaceSamplerBase), no_init)
                              .def("SetSeed",&PySpaceSamplerBase::SetSeed, args("seed"), DOXY_FN(SpaceSamplerBase,SetSeed))
                              .def("SetSpaceDOF",&PySpaceSamplerBase::SetSpaceDOF, args("dof"), DOXY_FN(SpaceSamplerBase,SetSpaceDOF))
+                             .def("CreateSubstream",&PySpaceSamplerBase::CreateSubstream, args("index","numsubstreams"), DOXY_FN(SpaceSamplerBase,CreateSubstream))
                              .def("GetDOF",&PySpaceSamplerBase::GetDOF, DOXY_FN(SpaceSamplerBase,GetDOF))
                              .def("GetNumberOfValues",&PySpaceSamplerBase::GetNumberOfValues, args("seed"), DOXY_FN(SpaceSamplerBase,GetNumberOfValues))
                              .def("Supports",&PySpaceSamplerBase::Supports, args("seed"), DOXY_FN(SpaceSamplerBase,Supports))
@@ -106,6 +106,34 @@ public:
         return static_cast<numeric::array>(handle<>(pypos));
     }
 
+    object SamplePointsSameDeltaTime2D(dReal deltatime, bool ensureLastPoint) const
+    {
+        vector<dReal> values;
+        _ptrajectory->SamplePointsSameDeltaTime(values,deltatime,ensureLastPoint);
+
+        int numdof = _ptrajectory->GetConfigurationSpecification().GetDOF();
+        npy_intp dims[] = { npy_intp(values.size()/numdof), npy_intp(numdof) };
+        PyObject *pypos = PyArray_SimpleNew(2,dims, sizeof(dReal)==8 ? PyArray_DOUBLE : PyArray_FLOAT);
+        if( values.size() > 0 ) {
+            memcpy(PyArray_DATA(pypos), &values[0], values.size()*sizeof(values[0]));
+        }
+        return static_cast<numeric::array>(handle<>(pypos));
+    }
+
+    object SamplePointsSameDeltaTime2D(dReal deltatime, bool ensureLastPoint, PyConfigurationSpecificationPtr pyspec) const
+    {
+        vector<dReal> values;
+        ConfigurationSpecification spec = openravepy::GetConfigurationSpecification(pyspec);
+        _ptrajectory->SamplePointsSameDeltaTime(values,deltatime,ensureLastPoint,spec);
+
+        npy_intp dims[] = { npy_intp(values.size()/spec.GetDOF()), npy_intp(spec.GetDOF()) };
+        PyObject *pypos = PyArray_SimpleNew(2,dims, sizeof(dReal)==8 ? PyArray_DOUBLE : PyArray_FLOAT);
+        if( values.size() > 0 ) {
+            memcpy(PyArray_DATA(pypos), &values[0], values.size()*sizeof(values[0]));
+        }
+        return static_cast<numeric::array>(handle<>(pypos));
+    }
+
     object GetConfigurationSpecification() const {
         return object(openravepy::toPyConfigurationSpecification(_ptrajectory->GetConfigurationSpecification()));
     }
@@ -165,6 +193,48 @@ public:
         return GetWaypoints2D(0, _ptrajectory->GetNumWaypoints(), pyspec);
     }
 
+    /// \brief similar to GetWaypoints2D except the returned array is a read-only view of the trajectory data. The view is invalidated when the trajectory is modified.
+    object GetWaypointsView(size_t startindex, size_t endindex) const
+    {
+        const dReal* pdata = _ptrajectory->GetWaypointsData(startindex);
+        if( !pdata || startindex >= endindex ) {
+            // trajectory does not support sharing its data
+            return GetWaypoints2D(startindex, endindex);
+        }
+        OPENRAVE_ASSERT_OP(endindex,<=,_ptrajectory->GetNumWaypoints());
+        std::vector<npy_intp> dims(2);
+        dims[0] = endindex-startindex;
+        dims[1] = _ptrajectory->GetConfigurationSpecification().GetDOF();
+        // the view keeps a reference to the trajectory
+        return toPyArrayView(pdata, dims, object(PyTrajectoryBasePtr(new PyTrajectoryBase(_ptrajectory,_pyenv))));
+    }
+
+    object GetAllWaypointsView() const
+    {
+        return GetWaypointsView(0, _ptrajectory->GetNumWaypoints());
+    }
+
+    /// \brief copies the waypoints into a preallocated array of (endindex-startindex)*dof values
+    void GetWaypointsToArray(size_t startindex, size_t endindex, object out) const
+    {
+        OPENRAVE_ASSERT_OP(startindex,<=,endindex);
+        OPENRAVE_ASSERT_OP(endindex,<=,_ptrajectory->GetNumWaypoints());
+        int dof = _ptrajectory->GetConfigurationSpecification().GetDOF();
+        dReal* poutdata = GetPyArrayOutputData(out, (endindex-startindex)*dof);
+        if( startindex == endindex ) {
+            return;
+        }
+        const dReal* pdata = _ptrajectory->GetWaypointsData(startindex);
+        if( !!pdata ) {
+            std::copy(pdata, pdata+(endindex-startindex)*dof, poutdata);
+        }
+        else {
+            vector<dReal> values;
+            _ptrajectory->GetWaypoints(startindex,endindex,values);
+            std::copy(values.begin(), values.end(), poutdata);
+        }
+    }
+
     object GetWaypoint(int index) const
     {
         vector<dReal> values;
@@ -273,6 +343,8 @@ void init_openravepy_trajectory()
     object (PyTrajectoryBase::*Sample2)(dReal, PyConfigurationSpecificationPtr) const = &PyTrajectoryBase::Sample;
     object (PyTrajectoryBase::*SamplePoints2D1)(object) const = &PyTrajectoryBase::SamplePoints2D;
     object (PyTrajectoryBase::*SamplePoints2D2)(object, PyConfigurationSpecificationPtr) const = &PyTrajectoryBase::SamplePoints2D;
+    object (PyTrajectoryBase::*SamplePointsSameDeltaTime2D1)(dReal, bool) const = &PyTrajectoryBase::SamplePointsSameDeltaTime2D;
+    object (PyTrajectoryBase::*SamplePointsSameDeltaTime2D2)(dReal, bool, PyConfigurationSpecificationPtr) const = &PyTrajectoryBase::SamplePointsSameDeltaTime2D;
     object (PyTrajectoryBase::*GetWaypoints1)(size_t,size_t) const = &PyTrajectoryBase::GetWaypoints;
     object (PyTrajectoryBase::*GetWaypoints2)(size_t,size_t,PyConfigurationSpecificationPtr) const = &PyTrajectoryBase::GetWaypoints;
     object (PyTrajectoryBase::*GetWaypoints2D1)(size_t,size_t) const = &PyTrajectoryBase::GetWaypoints2D;
@@ -292,6 +364,8 @@ void init_openravepy_trajectory()
     .def("Sample",Sample2,args("time","spec"),DOXY_FN(TrajectoryBase,Sample "std::vector; dReal; const ConfigurationSpecification"))
     .def("SamplePoints2D",SamplePoints2D1,args("times"),DOXY_FN(TrajectoryBase,SamplePoints2D "std::vector; std::vector"))
     .def("SamplePoints2D",SamplePoints2D2,args("times","spec"),DOXY_FN(TrajectoryBase,SamplePoints2D "std::vector; std::vector; const ConfigurationSpecification"))
+    .def("SamplePointsSameDeltaTime2D",SamplePointsSameDeltaTime2D1,args("deltatime","ensurelastpoint"),DOXY_FN(TrajectoryBase,SamplePointsSameDeltaTime "std::vector; dReal; bool"))
+    .def("SamplePointsSameDeltaTime2D",SamplePointsSameDeltaTime2D2,args("deltatime","ensurelastpoint","spec"),DOXY_FN(TrajectoryBase,SamplePointsSameDeltaTime "std::vector; dReal; bool; const ConfigurationSpecification"))
     .def("GetConfigurationSpecification",&PyTrajectoryBase::GetConfigurationSpecification,DOXY_FN(TrajectoryBase,GetConfigurationSpecification))
     .def("GetNumWaypoints",&PyTrajectoryBase::GetNumWaypoints,DOXY_FN(TrajectoryBase,GetNumWaypoints))
     .def("GetWaypoints",GetWaypoints1,args("startindex","endindex"),DOXY_FN(TrajectoryBase, GetWaypoints "size_t; size_t; std::vector"))
@@ -300,6 +374,9 @@ void init_openravepy_trajectory()
     .def("GetWaypoints2D",GetWaypoints2D2,args("startindex","endindex","spec"),DOXY_FN(TrajectoryBase, GetWaypoints "size_t; size_t; std::vector, const ConfigurationSpecification&"))
     .def("GetAllWaypoints2D",GetAllWaypoints2D1,DOXY_FN(TrajectoryBase, GetWaypoints "size_t; size_t; std::vector"))
     .def("GetAllWaypoints2D",GetAllWaypoints2D2,args("spec"),DOXY_FN(TrajectoryBase, GetWaypoints "size_t; size_t; std::vector, const ConfigurationSpecification&"))
+    .def("GetWaypointsView",&PyTrajectoryBase::GetWaypointsView,args("startindex","endindex"),DOXY_FN(TrajectoryBase, GetWaypointsData))
+    .def("GetAllWaypointsView",&PyTrajectoryBase::GetAllWaypointsView,DOXY_FN(TrajectoryBase, GetWaypointsData))
+    .def("GetWaypointsToArray",&PyTrajectoryBase::GetWaypointsToArray,args("startindex","endindex","out"),DOXY_FN(TrajectoryBase, GetWaypoints "size_t; size_t; std::vector"))
     .def("GetWaypoint",GetWaypoint1,args("index"),DOXY_FN(TrajectoryBase, GetWaypoint "int; std::vector"))
     .def("GetWaypoint",GetWaypoint2,args("index","spec"),DOXY_FN(TrajectoryBase, GetWaypoint "int; std::vector; const ConfigurationSpecification"))
     .def("GetFirstWaypointIndexAfterTime",&PyTrajectoryBase::GetFirstWaypointIndexAfterTime, DOXY_FN(TrajectoryBase, GetFirstWaypointIndexAfterTime))
@@ -26,6 +26,9 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/format.hpp>
 #include <boost/assert.hpp>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
 
 #define OPENRAVE_BININGS_PYARRAY
 #include "bindings.h"
@@ -268,6 +271,142 @@ object k_fixed_radius_search_array(ANNkd_tree& kdtree, object qarray, double sqR
     return boost::python::make_tuple(static_cast<numeric::array>(handle<>(pyidx)), static_cast<numeric::array>(handle<>(pydists)),static_cast<numeric::array>(handle<>(pykball)));
 }
 
+/// \brief releases the python GIL in its scope
+class PythonThreadSaver
+{
+public:
+    PythonThreadSaver() {
+        _save = PyEval_SaveThread();
+    }
+    virtual ~PythonThreadSaver() {
+        PyEval_RestoreThread(_save);
+    }
+protected:
+    PyThreadState *_save;
+};
+
+/// \brief minimum number of queries given to a thread by the batch searches, fewer are not worth starting a thread for
+static const int s_nMinBatchQueriesPerThread = 64;
+
+/// \brief output buffers of a batch search, the rows of query i start at i*k
+struct BatchSearchOutput
+{
+    ANNidx* pidx;
+    ANNdist* pdists;
+    int* pkball; ///< number of points in the radius, only for fixed radius searches
+};
+
+/// \brief k-nearest neighbor queries [start,end) of a batch search, the query points are rows of pqueries
+static void _BatchKSearchRange(const ANNkd_tree& kdtree, const ANNcoord* pqueries, int k, double eps, bool priority, BatchSearchOutput output, int start, int end)
+{
+    ANNkd_tree& tree = const_cast<ANNkd_tree&>(kdtree); // search does not modify the tree, but is not declared const
+    const int dim = tree.theDim();
+    for(int i = start; i < end; ++i) {
+        ANNpoint q = const_cast<ANNcoord*>(pqueries + (size_t)i*dim);
+        if( priority ) {
+            tree.annkPriSearch(q, k, output.pidx + (size_t)i*k, output.pdists + (size_t)i*k, eps);
+        }
+        else {
+            tree.annkSearch(q, k, output.pidx + (size_t)i*k, output.pdists + (size_t)i*k, eps);
+        }
+    }
+}
+
+/// \brief fixed radius queries [start,end) of a batch search, if k <= 0 only the number of points in the radius is computed
+static void _BatchKFRSearchRange(const ANNkd_tree& kdtree, const ANNcoord* pqueries, ANNdist sqRad, int k, double eps, BatchSearchOutput output, int start, int end)
+{
+    ANNkd_tree& tree = const_cast<ANNkd_tree&>(kdtree);
+    const int dim = tree.theDim();
+    for(int i = start; i < end; ++i) {
+        ANNpoint q = const_cast<ANNcoord*>(pqueries + (size_t)i*dim);
+        if( k <= 0 ) {
+            output.pkball[i] = tree.annkFRSearch(q, sqRad, k, NULL, NULL, eps);
+        }
+        else {
+            output.pkball[i] = tree.annkFRSearch(q, sqRad, k, output.pidx + (size_t)i*k, output.pdists + (size_t)i*k, eps);
+        }
+    }
+}
+
+/// \brief calls fn(start,end) on numthreads contiguous ranges of [0,N), the first range is run in the calling thread
+///
+/// If numthreads is 0, uses the number of hardware threads. Only splits the queries when ANN searches are reentrant.
+static void _RunBatch(int N, int numthreads, const boost::function<void(int,int)>& fn)
+{
+#ifdef ANN_REENTRANT_SEARCH
+    if( numthreads <= 0 ) {
+        numthreads = std::max(1, (int)boost::thread::hardware_concurrency());
+    }
+    numthreads = std::max(1, std::min(numthreads, N/s_nMinBatchQueriesPerThread));
+#else
+    numthreads = 1;
+#endif
+    std::vector<boost::shared_ptr<boost::thread> > vthreads(numthreads-1);
+    for(int ithread = 1; ithread < numthreads; ++ithread) {
+        vthreads[ithread-1].reset(new boost::thread(boost::bind(fn, (int)(((int64_t)N*ithread)/numthreads), (int)(((int64_t)N*(ithread+1))/numthreads))));
+    }
+    fn(0, N/numthreads);
+    for(size_t ithread = 0; ithread < vthreads.size(); ++ithread) {
+        vthreads[ithread]->join();
+    }
+}
+
+/// \brief returns the query points as a contiguous NxD array of ANNcoord, only copies if the input is not already one
+static handle<> _GetQueryArray(ANNkd_tree& kdtree, object qarray)
+{
+    PyObject* pyqueries = PyArray_FROMANY(qarray.ptr(), sizeof(ANNcoord)==8 ? PyArray_DOUBLE : PyArray_FLOAT, 2, 2, NPY_IN_ARRAY);
+    if( !pyqueries ) {
+        throw_error_already_set();
+    }
+    handle<> hqueries(pyqueries);
+    if( PyArray_DIM(pyqueries,1) != kdtree.theDim() ) {
+        throw pyann_exception(boost::str(boost::format("query points have dimension %d, expected %d")%PyArray_DIM(pyqueries,1)%kdtree.theDim()));
+    }
+    return hqueries;
+}
+
+object search_batch(ANNkd_tree& kdtree, object qarray, int k, double eps, int numthreads, bool priority)
+{
+    BOOST_ASSERT(k > 0 && k <= kdtree.nPoints());
+    handle<> hqueries = _GetQueryArray(kdtree, qarray);
+    int N = PyArray_DIM(hqueries.get(),0);
+    npy_intp dims[] = { N,k};
+    handle<> hdists(PyArray_SimpleNew(2,dims, sizeof(ANNdist)==8 ? PyArray_DOUBLE : PyArray_FLOAT));
+    handle<> hidx(PyArray_SimpleNew(2,dims, PyArray_INT));
+    const ANNcoord* pqueries = (const ANNcoord*)PyArray_DATA(hqueries.get());
+    BatchSearchOutput output;
+    output.pidx = (ANNidx*)PyArray_DATA(hidx.get());
+    output.pdists = (ANNdist*)PyArray_DATA(hdists.get());
+    output.pkball = NULL;
+    if( N > 0 ) {
+        PythonThreadSaver threadsaver;
+        _RunBatch(N, numthreads, boost::bind(_BatchKSearchRange, boost::cref(kdtree), pqueries, k, eps, priority, output, _1, _2));
+    }
+    return boost::python::make_tuple(static_cast<numeric::array>(hidx), static_cast<numeric::array>(hdists));
+}
+
+object k_fixed_radius_search_batch(ANNkd_tree& kdtree, object qarray, double sqRad, int k, double eps, int numthreads)
+{
+    BOOST_ASSERT(k <= kdtree.nPoints());
+    handle<> hqueries = _GetQueryArray(kdtree, qarray);
+    int N = PyArray_DIM(hqueries.get(),0);
+    npy_intp dims[] = { N,std::max(k,0)};
+    handle<> hdists(PyArray_SimpleNew(2,dims, sizeof(ANNdist)==8 ? PyArray_DOUBLE : PyArray_FLOAT));
+    handle<> hidx(PyArray_SimpleNew(2,dims, PyArray_INT));
+    npy_intp dimsball[] = { N};
+    handle<> hkball(PyArray_SimpleNew(1,dimsball, PyArray_INT));
+    const ANNcoord* pqueries = (const ANNcoord*)PyArray_DATA(hqueries.get());
+    BatchSearchOutput output;
+    output.pidx = (ANNidx*)PyArray_DATA(hidx.get());
+    output.pdists = (ANNdist*)PyArray_DATA(hdists.get());
+    output.pkball = (int*)PyArray_DATA(hkball.get());
+    if( N > 0 ) {
+        PythonThreadSaver threadsaver;
+        _RunBatch(N, numthreads, boost::bind(_BatchKFRSearchRange, boost::cref(kdtree), pqueries, (ANNdist)sqRad, k, eps, output, _1, _2));
+    }
+    return boost::python::make_tuple(static_cast<numeric::array>(hidx), static_cast<numeric::array>(hdists), static_cast<numeric::array>(hkball));
+}
+
 object ksearch(ANNkd_tree& kdtree, object q, int k, double eps)
 {
     return search(kdtree, q, k, eps, false);
@@ -288,6 +427,16 @@ object k_priority_search_array(ANNkd_tree& kdtree, object q, int k, double eps)
     return search_array(kdtree, q, k, eps, true);
 }
 
+object ksearch_batch(ANNkd_tree& kdtree, object q, int k, double eps, int numthreads)
+{
+    return search_batch(kdtree, q, k, eps, numthreads, false);
+}
+
+object k_priority_search_batch(ANNkd_tree& kdtree, object q, int k, double eps, int numthreads)
+{
+    return search_batch(kdtree, q, k, eps, numthreads, true);
+}
+
 BOOST_PYTHON_MODULE(pyANN_int)
 {
     import_array();
@@ -315,6 +464,9 @@ BOOST_PYTHON_MODULE(pyANN_int)
     .def("kPriSearchArray", &k_priority_search_array,args("q","k","eps"))
     .def("kFRSearch", &k_fixed_radius_search,args("q","sqrad","k","eps"))
     .def("kFRSearchArray", &k_fixed_radius_search_array,args("qarray","sqrad","k","eps"))
+    .def("kSearchBatch", &ksearch_batch,(arg("qarray"),arg("k"),arg("eps"),arg("numthreads")=1), "k-nearest neighbors of each row of the numpy array qarray, returns (NxK indices, NxK squared distances). The GIL is released during the search, which is split across numthreads threads (0 for all hardware threads).")
+    .def("kPriSearchBatch", &k_priority_search_batch,(arg("qarray"),arg("k"),arg("eps"),arg("numthreads")=1), "priority search version of kSearchBatch")
+    .def("kFRSearchBatch", &k_fixed_radius_search_batch,(arg("qarray"),arg("sqrad"),arg("k"),arg("eps"),arg("numthreads")=1), "fixed radius search of each row of the numpy array qarray, returns (NxK indices, NxK squared distances, N number of points in the radius). Unused entries have index -1. The GIL is released during the search, which is split across numthreads threads (0 for all hardware threads).")
 
     .def("__len__",             &ANNkd_tree::nPoints)
     .def("dim",                 &ANNkd_tree::theDim)
@@ -119,6 +119,18 @@ class DatabaseGenerator(metaclass.AutoReloader):
             return value.value
         else:
             return value
+
+    @staticmethod
+    def _MemoryMapDataset(dataset):
+        """returns a read-only numpy.memmap of an h5py dataset, so its pages are only read when accessed and are shared between all the processes that load the same database.
+
+        Chunked, compressed, and empty datasets cannot be mapped and are read instead.
+        """
+        import numpy
+        offset = dataset.id.get_offset()
+        if offset is None or dataset.chunks is not None or dataset.compression is not None or dataset.size == 0:
+            return dataset[...]
+        return numpy.memmap(dataset.file.filename,mode='r',dtype=dataset.dtype,shape=dataset.shape,offset=offset)
     def autogenerateparams(self,options=None):
         """Caches parameters for most commonly used robots/objects and starts the generation process for them"""
         raise NotImplementedError()
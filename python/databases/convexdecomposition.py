@@ -79,6 +79,7 @@ from . import DatabaseGenerator
 import numpy
 import time
 import os.path
+import hashlib
 from os import makedirs
 from optparse import OptionParser
 from itertools import izip
@@ -87,6 +88,11 @@ try:
     from cStringIO import StringIO
 except:
     from StringIO import StringIO
+
+try:
+    import cPickle as pickle
+except:
+    import pickle
     
 import logging
 log = logging.getLogger('openravepy.'+__name__.split('.',2)[-1])
@@ -104,8 +110,22 @@ class ConvexDecompositionError(Exception):
     def __str__(self):
         return unicode(self).encode('utf-8')
 
+def _ComputePaddedConvexDecompositionJob(args):
+    """computes the padded convex decomposition of one mesh, module level so that it can be run in worker processes
+    
+    :param args: (vertices, indices, padding, convexparams)
+    """
+    vertices, indices, padding, convexparams = args
+    from .. import convexdecompositionpy
+    orghulls = convexdecompositionpy.computeConvexDecomposition(vertices,indices,**convexparams)
+    if len(orghulls) > 0 and padding != 0:
+        orghulls = [ConvexDecompositionModel.PadMesh(hull[0],hull[1],padding) for hull in orghulls]
+    return [(array(hull[0],float64),array(hull[1],int)) for hull in orghulls]
+
 class ConvexDecompositionModel(DatabaseGenerator):
     """Computes the convex decomposition of all of the robot's links"""
+    _meshcache = {} # mesh cache key -> list of padded hulls (vertices,indices), shared by all models of the process
+    
     def __init__(self,robot,padding=0.0):
         """
         :param padding: the desired padding
@@ -250,15 +270,17 @@ class ConvexDecompositionModel(DatabaseGenerator):
     
     def autogenerate(self,options=None):
         if options is not None:
-            self.generate(padding=options.padding,skinWidth=options.skinWidth, decompositionDepth=options.decompositionDepth, maxHullVertices=options.maxHullVertices,concavityThresholdPercent=options.concavityThresholdPercent, mergeThresholdPercent=options.mergeThresholdPercent, volumeSplitThresholdPercent=options.volumeSplitThresholdPercent, useInitialIslandGeneration=options.useInitialIslandGeneration, useIslandGeneration=options.useIslandGeneration,convexHullLinks=options.convexHullLinks.split(','))
+            self.generate(padding=options.padding,numthreads=options.numthreads,skinWidth=options.skinWidth, decompositionDepth=options.decompositionDepth, maxHullVertices=options.maxHullVertices,concavityThresholdPercent=options.concavityThresholdPercent, mergeThresholdPercent=options.mergeThresholdPercent, volumeSplitThresholdPercent=options.volumeSplitThresholdPercent, useInitialIslandGeneration=options.useInitialIslandGeneration, useIslandGeneration=options.useIslandGeneration,convexHullLinks=options.convexHullLinks.split(','))
         else:
             self.generate()
         self.save()
-    def generate(self,padding=None,minTriangleConvexHullThresh=None,convexHullLinks=None,**kwargs):
+    def generate(self,padding=None,minTriangleConvexHullThresh=None,convexHullLinks=None,numthreads=None,usecache=True,**kwargs):
         """
         :param padding: the padding in meters
         :param minTriangleConvexHullThresh: If not None, then describes the minimum number of triangles needed to use convex hull rather than convex decomposition. Although this might seem counter intuitive, the current convex decomposition module cannot handle really complex meshes and it takes a long time if it does handle them.
         :param convexHullLinks: a list of link names to compute convex hulls instead of decomposition
+        :param numthreads: the number of processes to compute the decompositions with. If None, uses all the cpus.
+        :param usecache: if True, looks up and stores each decomposition in a cache keyed by the hash of the mesh and the parameters, see GetMeshCacheKey
         """
         self.convexparams = kwargs
         if padding is None:
@@ -267,13 +289,17 @@ class ConvexDecompositionModel(DatabaseGenerator):
                 padding = 0.0
         if convexHullLinks is None:
             convexHullLinks = []
+        if numthreads is None:
+            import multiprocessing
+            numthreads = multiprocessing.cpu_count()
         log.info(u'Generating Convex Decomposition: %r',self.convexparams)
         starttime = time.time()
-        self.linkgeometry = []
+        linkorghulls = []
+        decompositionjobs = [] # (il, ig, trimesh, cachekey)
         with self.env:
             links = self.robot.GetLinks()
             for il,link in enumerate(links):
-                geomhulls = []
+                geomorghulls = []
                 geometries = link.GetGeometries()
                 for ig,geom in enumerate(geometries):
                     if geom.GetType() == KinBody.Link.GeomType.Trimesh or padding > 0:
@@ -283,30 +309,116 @@ class ConvexDecompositionModel(DatabaseGenerator):
                             trimesh = geom.GetCollisionMesh()
                         if link.GetName() in convexHullLinks or (minTriangleConvexHullThresh is not None and len(trimesh.indices) > minTriangleConvexHullThresh):
                             log.info(u'computing hull for link %d/%d geom %d/%d',il,len(links), ig, len(geometries))
-                            orghulls = [self.ComputePaddedConvexHullFromTriMesh(trimesh,padding)]
+                            geomorghulls.append([ig,[self.ComputePaddedConvexHullFromTriMesh(trimesh,padding)]])
                         else:
-                            log.info(u'computing decomposition for link %d/%d geom %d/%d',il,len(links), ig, len(geometries))
-                            orghulls = self.ComputePaddedConvexDecompositionFromTriMesh(trimesh,padding)
-                        cdhulls = []
-                        for hull in orghulls:
-                            if any(isnan(hull[0])):
-                                raise ConvexDecompositionError(u'geom link %s has NaNs', link.GetName())
-                            cdhulls.append((hull[0],hull[1],self.ComputeHullPlanes(hull)))
-                        geomhulls.append((ig,cdhulls))
-                self.linkgeometry.append(geomhulls)
+                            geomorghulls.append([ig,None])
+                            decompositionjobs.append((il,len(geomorghulls)-1,trimesh,self.GetMeshCacheKey(trimesh,padding,self.convexparams)))
+                linkorghulls.append(geomorghulls)
+        
+        # the decompositions do not need the environment, so compute the ones not in the cache in parallel
+        missingjobs = []
+        for il,igeomhull,trimesh,cachekey in decompositionjobs:
+            orghulls = self._LoadMeshCache(cachekey) if usecache else None
+            if orghulls is None:
+                missingjobs.append((il,igeomhull,trimesh,cachekey))
+            else:
+                linkorghulls[il][igeomhull][1] = orghulls
+        log.info(u'computing %d/%d decompositions with %d processes',len(missingjobs),len(decompositionjobs),numthreads)
+        jobargs = [(trimesh.vertices,trimesh.indices,padding,self.convexparams) for il,igeomhull,trimesh,cachekey in missingjobs if len(trimesh.indices) > 0]
+        if numthreads > 1 and len(jobargs) > 1:
+            import multiprocessing
+            pool = multiprocessing.Pool(min(numthreads,len(jobargs)))
+            try:
+                jobresults = pool.map(_ComputePaddedConvexDecompositionJob,jobargs,chunksize=1)
+            finally:
+                pool.terminate()
+        else:
+            jobresults = [_ComputePaddedConvexDecompositionJob(args) for args in jobargs]
+        ijobresult = 0
+        for il,igeomhull,trimesh,cachekey in missingjobs:
+            if len(trimesh.indices) > 0:
+                orghulls = jobresults[ijobresult]
+                ijobresult += 1
+            else:
+                orghulls = []
+            linkorghulls[il][igeomhull][1] = orghulls
+            if usecache:
+                self._SaveMeshCache(cachekey,orghulls)
+        
+        self.linkgeometry = []
+        for il,geomorghulls in enumerate(linkorghulls):
+            geomhulls = []
+            for ig,orghulls in geomorghulls:
+                cdhulls = []
+                for hull in orghulls:
+                    if any(isnan(hull[0])):
+                        raise ConvexDecompositionError(u'geom link %s has NaNs'%self.robot.GetLinks()[il].GetName())
+                    cdhulls.append((hull[0],hull[1],self.ComputeHullPlanes(hull)))
+                geomhulls.append((ig,cdhulls))
+            self.linkgeometry.append(geomhulls)
         self._padding = padding
         log.info(u'all convex decomposition finished in %fs',time.time()-starttime)
 
+    @staticmethod
+    def GetMeshCacheKey(trimesh,padding,convexparams):
+        """returns the hash of the mesh contents, padding, and decomposition parameters that the decomposition is cached with
+        """
+        h = hashlib.sha1()
+        h.update(ascontiguousarray(trimesh.vertices,float64).tostring())
+        h.update(ascontiguousarray(trimesh.indices,int32).tostring())
+        h.update(repr((float(padding),sorted(convexparams.iteritems()))))
+        return h.hexdigest()
+    
+    @staticmethod
+    def _GetMeshCacheFilename(cachekey,read=False):
+        return RaveFindDatabaseFile(os.path.join('convexdecomposition_cache',cachekey+'.pp'),read)
+    
+    def _LoadMeshCache(self,cachekey):
+        orghulls = self._meshcache.get(cachekey,None)
+        if orghulls is not None:
+            return orghulls
+        filename = self._GetMeshCacheFilename(cachekey,True)
+        if len(filename) == 0:
+            return None
+        try:
+            modelversion,orghulls = pickle.load(open(filename,'rb'))
+            if modelversion != self.getversion():
+                return None
+        except Exception, e:
+            log.warn(u'failed to load convex decomposition cache %s: %s',filename,e)
+            return None
+        self._meshcache[cachekey] = orghulls
+        return orghulls
+    
+    def _SaveMeshCache(self,cachekey,orghulls):
+        self._meshcache[cachekey] = orghulls
+        filename = self._GetMeshCacheFilename(cachekey,False)
+        try:
+            makedirs(os.path.split(filename)[0])
+        except OSError:
+            pass
+        try:
+            pickle.dump((self.getversion(),orghulls),open(filename,'wb'),pickle.HIGHEST_PROTOCOL)
+        except Exception, e:
+            log.warn(u'failed to save convex decomposition cache %s: %s',filename,e)
+    
+    def SetGeometryGroup(self,groupname='convexdecomposition'):
+        """stores the padded hulls of every link in the geometry group groupname of the robot, so collision checkers can use them with SetGeometryGroup/SetBodyGeometryGroup without replacing the original geometries.
+
+        Geometries that were not decomposed are stored with their original info.
+        """
+        with self.env:
+            linkgeometryinfos = []
+            for ilink,link in enumerate(self.robot.GetLinks()):
+                hullinfos = self.GetGeometryInfosFromLink(ilink,preservetransform=True)
+                decomposed = dict((ig,ihull) for ihull,(ig,hulls) in enumerate(self.linkgeometry[ilink]))
+                linkgeometryinfos.append([hullinfos[decomposed[ig]] if ig in decomposed else geom.GetInfo() for ig,geom in enumerate(link.GetGeometries())])
+            self.robot.SetLinkGroupGeometries(groupname,linkgeometryinfos)
+
     def ComputePaddedConvexDecompositionFromTriMesh(self, trimesh, padding=0.0):
         if len(trimesh.indices) > 0:
-            orghulls = convexdecompositionpy.computeConvexDecomposition(trimesh.vertices,trimesh.indices,**self.convexparams)
-        else:
-            orghulls = []
-        if len(orghulls) > 0:
-            # add in the padding
-            if padding != 0:
-                orghulls = [self.PadMesh(hull[0],hull[1],padding) for hull in orghulls]
-        return orghulls
+            return _ComputePaddedConvexDecompositionJob((trimesh.vertices,trimesh.indices,padding,self.convexparams))
+        return []
     
     def ComputePaddedConvexHullFromTriMesh(self, trimesh, padding=0.0):
         """computes a padded convex hull from all the links and returns it as a list of trimeshes
@@ -156,6 +156,7 @@ __license__ = 'Apache License, Version 2.0'
 from traceback import print_exc
 import time
 import os.path
+from os import makedirs
 try:
     import cPickle as pickle
 except:
@@ -238,6 +239,8 @@ class GraspingModel(DatabaseGenerator):
         self.approachgraphs = None
         self.contactgraph = None
         self.numthreads=None
+        self.chunksize=None # if set, the threaded generation saves its progress to disk every chunksize grasp indices
+        self.graspindexrange=None # if set, (startindex,endindex) of the grasp indices to generate, used to split the generation across machines
         self.disableallbodies=True
         self.translationstepmult = None
         self.finestep = None
@@ -266,12 +269,21 @@ class GraspingModel(DatabaseGenerator):
         self.basemanip = interfaces.BaseManipulation(self.robot,maxvelmult=self.maxvelmult)
         self.grasper = interfaces.Grasper(self.robot,friction=friction,avoidlinks=avoidlinks,plannername=plannername)
         self.grasps = []
-    def load(self, filename=None):
+    def load(self, filename=None, memorymap=True):
+        """
+        :param memorymap: if True and the database was saved in HDF5, memory maps the grasps instead of reading them, see LoadHDF5
+        """
         if filename is None:
             filename = self.getfilename(True)
         if len(filename) == 0:
             return None
         try:
+            if self.LoadHDF5(filename,memorymap):
+                return True
+        except ImportError:
+            pass
+        try:
+            # databases saved before the HDF5 format
             modelversion,params = pickle.load(open(filename, 'r'))
             if modelversion == self.getversion():
                 self.grasps,self.graspindices,friction,linknames,plannername,self.translationstepmult,self.finestep,self.graspsetname = params
@@ -292,8 +304,85 @@ class GraspingModel(DatabaseGenerator):
             print '%s failed: '%filename,e
         return False
 
+    def LoadHDF5(self,filename,memorymap=True):
+        """
+        :param memorymap: if True, the grasps are memory mapped from the file as a read-only array, so loading does not read them and all the processes share their pages.
+        """
+        import h5py
+        if not h5py.is_hdf5(filename):
+            return False
+
+        self._CloseDatabase()
+        f = None
+        try:
+            f = h5py.File(filename,'r')
+            if f['version'].value != self.getversion():
+                log.error('version is wrong %s!=%s ',f['version'].value,self.getversion())
+                return False
+
+            self.grasps = self._MemoryMapDataset(f['grasps']) if memorymap else f['grasps'].value
+            self.graspindices = dict((name,[int(index) for index in dataset.value]) for name,dataset in f['graspindices'].iteritems())
+            friction = f.attrs['friction']
+            linknames = [name for name in f.attrs['avoidlinks'].split('\n') if len(name) > 0]
+            plannername = f.attrs['plannername'] if len(f.attrs['plannername']) > 0 else None
+            self.translationstepmult = f.attrs['translationstepmult'] if 'translationstepmult' in f.attrs else None
+            self.finestep = f.attrs['finestep'] if 'finestep' in f.attrs else None
+            self.graspsetname = unicode(f.attrs['graspsetname'])
+            self._databasefile = f
+            f = None
+            self.basemanip = interfaces.BaseManipulation(self.robot,maxvelmult=self.maxvelmult)
+            self.grasper = interfaces.Grasper(self.robot,friction,avoidlinks = [self.robot.GetLink(name) for name in linknames],plannername=plannername)
+            return self.has()
+
+        except Exception,e:
+            log.debug('LoadHDF5 for %s: %s',filename,e)
+            return False
+        finally:
+            if f is not None:
+                f.close()
+
     def save(self):
+        try:
+            self.SaveHDF5()
+        except ImportError:
+            log.warn('python h5py library not found, will not be able to speedup database access')
+            self.SavePickle()
+
+    def SavePickle(self):
         DatabaseGenerator.save(self,(self.grasps,self.graspindices,self.grasper.friction,[link.GetName() for link in self.grasper.avoidlinks],self.grasper.plannername,self.translationstepmult,self.finestep,self.graspsetname))
+
+    def SaveHDF5(self):
+        """stores the grasps in one contiguous dataset so that LoadHDF5 can memory map it
+        """
+        import h5py
+        filename=self.getfilename(False)
+        log.info(u'saving model to %s',filename)
+        try:
+            makedirs(os.path.split(filename)[0])
+        except OSError:
+            pass
+
+        f=h5py.File(filename,'w')
+        try:
+            f['version'] = self.getversion()
+            grasps = array(self.grasps,float64)
+            if len(grasps) == 0:
+                f.create_dataset('grasps',(0,self.totaldof),dtype=float64)
+            else:
+                f['grasps'] = grasps
+            ggraspindices = f.create_group('graspindices')
+            for name,indices in self.graspindices.iteritems():
+                ggraspindices.create_dataset(name,data=array(indices,int32).reshape(len(indices)))
+            f.attrs['friction'] = self.grasper.friction
+            f.attrs['avoidlinks'] = '\n'.join(link.GetName() for link in self.grasper.avoidlinks)
+            f.attrs['plannername'] = self.grasper.plannername if self.grasper.plannername is not None else ''
+            if self.translationstepmult is not None:
+                f.attrs['translationstepmult'] = self.translationstepmult
+            if self.finestep is not None:
+                f.attrs['finestep'] = self.finestep
+            f.attrs['graspsetname'] = self.graspsetname
+        finally:
+            f.close()
     def getfilename(self,read=False):
         return RaveFindDatabaseFile(os.path.join('robot.'+self.robot.GetKinematicsGeometryHash(), 'graspset.' + self.manip.GetStructureHash() + '.' + self.target.GetKinematicsGeometryHash()+'.pp'),read)
 
@@ -363,6 +452,10 @@ class GraspingModel(DatabaseGenerator):
                 finestep = options.finestep
             if hasattr(options,'numthreads') and options.numthreads is not None:
                 self.numthreads = options.numthreads
+            if hasattr(options,'chunksize') and options.chunksize is not None:
+                self.chunksize = options.chunksize
+            if hasattr(options,'graspindexrange') and options.graspindexrange is not None:
+                self.graspindexrange = options.graspindexrange
         # check for specific robots
         if self.robot.GetRobotStructureHash() == '2b0b07cce5d2f9c321010e74273a77f2' or self.robot.GetRobotStructureHash() == 'ca823aed89e08c7020b2cd7d2e5ff145': # wam+barretthand
             if preshapes is None:
@@ -397,7 +490,7 @@ class GraspingModel(DatabaseGenerator):
             for b in bodies:
                 b[0].Enable(False)
         try:
-            if self.numthreads is not None and self.numthreads > 1:
+            if (self.numthreads is not None and self.numthreads > 1) or self.chunksize is not None or self.graspindexrange is not None:
                 self._generateThreaded(*args,**kwargs)
             else:
                 with self.GripperVisibility(self.manip):
@@ -587,52 +680,160 @@ class GraspingModel(DatabaseGenerator):
             self.robot.SetTransform(eye(4)) # have to reset transform in order to remove randomness
             self.robot.SetActiveDOFs(self.manip.GetGripperIndices(),DOFAffine.X+DOFAffine.Y+DOFAffine.Z if translate else 0)
             approachrays[:,3:6] = -approachrays[:,3:6]
-            self.nextid, self.resultgrasps = self.grasper.GraspThreaded(approachrays=approachrays, rolls=rolls, standoffs=standoffs, preshapes=preshapes, manipulatordirections=manipulatordirections, target=self.target, graspingnoise=graspingnoise, forceclosurethreshold=forceclosurethreshold,numthreads=numthreads,translationstepmult=self.translationstepmult,finestep=self.finestep)
-            print 'graspthreaded done, processing grasps %d'%len(self.resultgrasps)
-
-            for resultgrasp in self.resultgrasps:
-                grasp = zeros(self.totaldof)
-                grasp[self.graspindices.get('igrasppos')] = resultgrasp[0]
-                grasp[self.graspindices.get('igraspdir')] = resultgrasp[1]
-                grasp[self.graspindices.get('igrasproll')] = resultgrasp[2]
-                grasp[self.graspindices.get('igraspstandoff')] = resultgrasp[3]
-                grasp[self.graspindices.get('imanipulatordirection')] = resultgrasp[4]
-                mindist = resultgrasp[5]
-                volume = resultgrasp[6]
-                grasp[self.graspindices.get('igrasppreshape')] = resultgrasp[7]
-                grasp[self.graspindices.get('ichuckingdirection')] = chuckingdirection
-                Tfinal = resultgrasp[8]
-                finalshape = resultgrasp[9]
-                contacts = resultgrasp[10]
-
-                with self.robot:
-                    Tlocalgrasp = eye(4)
-                    self.robot.SetTransform(Tfinal)
-                    Tgrasp = self.manip.GetEndEffectorTransform()
-                    Tlocalgrasp = dot(linalg.inv(self.target.GetTransform()),Tgrasp)
-                    # find a non-colliding transform
-                    direction = self.getGlobalApproachDir(grasp)
-                    Tgrasp_nocol = array(Tgrasp)
-                    while self.manip.CheckEndEffectorCollision(Tgrasp_nocol):
-                        Tgrasp_nocol[0:3,3] -= direction*self.collision_escape_offset
-                    Tlocalgrasp_nocol = dot(linalg.inv(self.target.GetTransform()),Tgrasp_nocol)
-                    self.robot.SetDOFValues(finalshape)
-
-                    grasp[self.graspindices.get('igrasptrans')] = reshape(transpose(Tlocalgrasp[0:3,0:4]),12)
-                    grasp[self.graspindices.get('grasptrans_nocol')] = reshape(transpose(Tlocalgrasp_nocol[0:3,0:4]),12)
-                    grasp[self.graspindices.get('graspikparam_nocol')] = r_[int(IkParameterizationType.Transform6D), poseFromMatrix(Tlocalgrasp_nocol)]
-                    grasp[self.graspindices.get('igraspfinalfingers')] = finalshape[self.manip.GetGripperIndices()]
-                    grasp[self.graspindices.get('forceclosure')] = mindist if mindist is not None else 0
-                    if not forceclosurethreshold or mindist >= forceclosurethreshold:
-                        grasp[self.graspindices.get('performance')] = self._ComputeGraspPerformance(grasp)
-                        if checkgraspfn is None or checkgraspfn(contacts,[Tfinal,finalshape],grasp,{'mindist':mindist,'volume':volume}):
-                            self.grasps.append(grasp)
+            numgrasps = len(approachrays)*len(rolls)*len(standoffs)*len(preshapes)*len(manipulatordirections)
+            startindex,endindex = self.graspindexrange if self.graspindexrange is not None else (0,numgrasps)
+            endindex = min(endindex,numgrasps)
+            chunkfile = None
+            if self.chunksize is not None:
+                paramshash = self._getGenerationHash(approachrays,rolls,standoffs,preshapes,manipulatordirections,graspingnoise,forceclosurethreshold,friction)
+                chunkfile = self._openGraspChunkFile(self.getchunkfilename(paramshash,startindex,endindex),paramshash,startindex,endindex)
+                startindex = chunkfile.attrs['completedindex']
+                if startindex > 0:
+                    log.info('resuming grasp generation from index %d/%d',startindex,endindex)
+            chunksize = self.chunksize if self.chunksize is not None else max(1,endindex-startindex)
+            try:
+                for chunkstart in range(startindex,endindex,chunksize):
+                    chunkend = min(chunkstart+chunksize,endindex)
+                    self.nextid, self.resultgrasps = self.grasper.GraspThreaded(approachrays=approachrays, rolls=rolls, standoffs=standoffs, preshapes=preshapes, manipulatordirections=manipulatordirections, target=self.target, graspingnoise=graspingnoise, forceclosurethreshold=forceclosurethreshold,numthreads=numthreads,translationstepmult=self.translationstepmult,finestep=self.finestep,startindex=chunkstart,endindex=chunkend)
+                    print 'graspthreaded done, processing grasps %d [%d,%d)'%(len(self.resultgrasps),chunkstart,chunkend)
+                    grasps = self._processThreadedGrasps(self.resultgrasps,chuckingdirection,forceclosurethreshold,checkgraspfn)
+                    self.resultgrasps = None
+                    if chunkfile is not None:
+                        self._appendGraspChunk(chunkfile,grasps,chunkend)
+                    else:
+                        self.grasps += grasps
+                if chunkfile is not None:
+                    self.grasps = list(chunkfile['grasps'][:])
+            finally:
+                if chunkfile is not None:
+                    chunkfile.close()
 
             self.grasps = array(self.grasps)
             if len(self.grasps) > 0:
                 order = argsort(self.grasps[:,self.graspindices.get('performance')[0]])
                 self.grasps = self.grasps[order]
-                
+
+    def _processThreadedGrasps(self,resultgrasps,chuckingdirection,forceclosurethreshold,checkgraspfn):
+        """converts the results of :meth:`.interfaces.Grasper.GraspThreaded` to grasps
+        """
+        grasps = []
+        for resultgrasp in resultgrasps:
+            grasp = zeros(self.totaldof)
+            grasp[self.graspindices.get('igrasppos')] = resultgrasp[0]
+            grasp[self.graspindices.get('igraspdir')] = resultgrasp[1]
+            grasp[self.graspindices.get('igrasproll')] = resultgrasp[2]
+            grasp[self.graspindices.get('igraspstandoff')] = resultgrasp[3]
+            grasp[self.graspindices.get('imanipulatordirection')] = resultgrasp[4]
+            mindist = resultgrasp[5]
+            volume = resultgrasp[6]
+            grasp[self.graspindices.get('igrasppreshape')] = resultgrasp[7]
+            grasp[self.graspindices.get('ichuckingdirection')] = chuckingdirection
+            Tfinal = resultgrasp[8]
+            finalshape = resultgrasp[9]
+            contacts = resultgrasp[10]
+
+            with self.robot:
+                Tlocalgrasp = eye(4)
+                self.robot.SetTransform(Tfinal)
+                Tgrasp = self.manip.GetEndEffectorTransform()
+                Tlocalgrasp = dot(linalg.inv(self.target.GetTransform()),Tgrasp)
+                # find a non-colliding transform
+                direction = self.getGlobalApproachDir(grasp)
+                Tgrasp_nocol = array(Tgrasp)
+                while self.manip.CheckEndEffectorCollision(Tgrasp_nocol):
+                    Tgrasp_nocol[0:3,3] -= direction*self.collision_escape_offset
+                Tlocalgrasp_nocol = dot(linalg.inv(self.target.GetTransform()),Tgrasp_nocol)
+                self.robot.SetDOFValues(finalshape)
+
+                grasp[self.graspindices.get('igrasptrans')] = reshape(transpose(Tlocalgrasp[0:3,0:4]),12)
+                grasp[self.graspindices.get('grasptrans_nocol')] = reshape(transpose(Tlocalgrasp_nocol[0:3,0:4]),12)
+                grasp[self.graspindices.get('graspikparam_nocol')] = r_[int(IkParameterizationType.Transform6D), poseFromMatrix(Tlocalgrasp_nocol)]
+                grasp[self.graspindices.get('igraspfinalfingers')] = finalshape[self.manip.GetGripperIndices()]
+                grasp[self.graspindices.get('forceclosure')] = mindist if mindist is not None else 0
+                if not forceclosurethreshold or mindist >= forceclosurethreshold:
+                    grasp[self.graspindices.get('performance')] = self._ComputeGraspPerformance(grasp)
+                    if checkgraspfn is None or checkgraspfn(contacts,[Tfinal,finalshape],grasp,{'mindist':mindist,'volume':volume}):
+                        grasps.append(grasp)
+        return grasps
+
+    def _getGenerationHash(self,*params):
+        """hash of the generation parameters, the robot, and the target used to key the chunk files
+        """
+        import hashlib
+        m = hashlib.md5()
+        m.update(self.robot.GetKinematicsGeometryHash())
+        m.update(self.manip.GetStructureHash())
+        m.update(self.target.GetKinematicsGeometryHash())
+        m.update(repr(sorted(self.graspindices.items())))
+        m.update(repr((self.grasper.friction,[link.GetName() for link in self.grasper.avoidlinks],self.grasper.plannername,self.translationstepmult,self.finestep)))
+        for param in params:
+            m.update(array(param).tostring() if param is not None and not isinstance(param,tuple) else repr(param))
+        return m.hexdigest()
+
+    def getchunkfilename(self,paramshash,startindex,endindex):
+        """filename of the store holding the grasps generated so far for the grasp indices [startindex,endindex)
+        """
+        filename = self.getfilename(False)
+        return '%s.%s.%d-%d.chunks.h5'%(filename[:-3] if filename.endswith('.pp') else filename,paramshash[:8],startindex,endindex)
+
+    def _openGraspChunkFile(self,filename,paramshash,startindex,endindex):
+        """opens the chunk store of a generation, creating it if it does not exist or was generated with different parameters
+        """
+        import h5py
+        try:
+            makedirs(os.path.split(filename)[0])
+        except OSError:
+            pass
+        if os.path.isfile(filename):
+            try:
+                f = h5py.File(filename,'r+')
+                if f.attrs['version'] == self.getversion() and f.attrs['paramshash'] == paramshash and f['grasps'].shape[1] == self.totaldof:
+                    return f
+                f.close()
+            except Exception,e:
+                log.warn('failed to open grasp chunks %s, restarting generation: %s',filename,e)
+        f = h5py.File(filename,'w')
+        f.attrs['version'] = self.getversion()
+        f.attrs['paramshash'] = paramshash
+        f.attrs['startindex'] = startindex
+        f.attrs['endindex'] = endindex
+        f.attrs['completedindex'] = startindex
+        f.create_dataset('grasps',(0,self.totaldof),maxshape=(None,self.totaldof),dtype=float64,chunks=True)
+        f.flush()
+        return f
+
+    def _appendGraspChunk(self,f,grasps,completedindex):
+        """appends the grasps of a chunk and marks all indices before completedindex as done. Grasps are written before the index, so an interrupted generation never skips grasps.
+        """
+        dataset = f['grasps']
+        if len(grasps) > 0:
+            offset = dataset.shape[0]
+            dataset.resize((offset+len(grasps),self.totaldof))
+            dataset[offset:] = array(grasps)
+        f.attrs['completedindex'] = completedindex
+        f.flush()
+
+    def loadGraspChunks(self,filenames):
+        """Loads the grasps from the chunk stores of several generations, for example when the indices were split across machines.
+
+        Call :meth:`save` afterwards to store the merged grasp set.
+        """
+        import h5py
+        grasps = []
+        for filename in filenames:
+            f = h5py.File(filename,'r')
+            try:
+                if f.attrs['completedindex'] < f.attrs['endindex']:
+                    log.warn('%s only completed grasp indices [%d,%d) of [%d,%d)',filename,f.attrs['startindex'],f.attrs['completedindex'],f.attrs['startindex'],f.attrs['endindex'])
+                grasps += list(f['grasps'][:])
+            finally:
+                f.close()
+        self.grasps = array(grasps)
+        if len(self.grasps) > 0:
+            order = argsort(self.grasps[:,self.graspindices.get('performance')[0]])
+            self.grasps = self.grasps[order]
+        return len(self.grasps)
+
     def show(self,delay=0.1,options=None,forceclosure=True,showcontacts=True):
         with self.robot.CreateRobotStateSaver():
             # disable all links not children to the manipulator
@@ -1128,6 +1329,10 @@ class GraspingModel(DatabaseGenerator):
                           help='Friction between robot and target object (default=0.3)')
         parser.add_option('--graspingnoise', action='store', type='float',dest='graspingnoise',default=None,
                           help='Random undeterministic noise to add to the target object, represents the max possible displacement of any point on the object. Noise is added after global direction and start have been determined (default=0)')
+        parser.add_option('--chunksize', action='store', type='int',dest='chunksize',default=None,
+                          help='If set, saves the generated grasps to disk every chunksize grasp indices so an interrupted generation can resume (requires h5py)')
+        parser.add_option('--graspindexrange', action='store', type='int',nargs=2,dest='graspindexrange',default=None,
+                          help='Only generate the grasp indices in [start,end), used to split a generation across machines')
         parser.add_option('--graspindex', action='store', type='int',dest='graspindex',default=None,
                           help='If set, then will only show this grasp index')
         return parser
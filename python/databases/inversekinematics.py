@@ -153,7 +153,7 @@ from ..openravepy_ext import RobotStateSaver
 from ..openravepy_int import RaveCreateModule, RaveCreateIkSolver, IkParameterization, IkParameterizationType, RaveFindDatabaseFile, RaveDestroy, Environment, openravepyCompilerVersion, IkFilterOptions, KinBody, normalizeAxisRotation, quatFromRotationMatrix, RaveGetDefaultViewerType
 from . import DatabaseGenerator
 from ..misc import relpath, TSP
-import time,platform,shutil,sys
+import time,platform,shutil,sys,threading
 import os.path
 from os import getcwd, remove
 import distutils
@@ -669,11 +669,14 @@ class InverseKinematicsModel(DatabaseGenerator):
         print 'getIndicesFromJointNames',freeindices,freejoints
         return freeindices
 
-    def generate(self,iktype=None, freejoints=None, freeinc=None, freeindices=None, precision=None, forceikbuild=True, outputlang=None, avoidPrismaticAsFree=False, ipython=False, ikfastoptions=0, ikfastmaxcasedepth=3):
+    def generate(self,iktype=None, freejoints=None, freeinc=None, freeindices=None, precision=None, forceikbuild=True, outputlang=None, avoidPrismaticAsFree=False, ipython=False, ikfastoptions=0, ikfastmaxcasedepth=3, ikfastbatchsize=0, docompile=True):
         """
+        :param forceikbuild: if False, a library already built for the same kinematics hash, ik type and free joints in any of the database directories is loaded instead, so a directory shared between machines only builds each solver once
         :param ikfastoptions: see IKFastSolver.generateIkSolver
         :param ikfastmaxcasedepth: the max level of degenerate cases to solve for
+        :param ikfastbatchsize: if > 0, the generated solver also exports ComputeIkBatch, see IKFastSolver.writeIkSolver
         :param avoidPrismaticAsFree: if True for redundant manipulators, will attempt to avoid setting prismatic joints as free joints.
+        :param docompile: if False, only the c++ file is generated, so that the files of several models can be compiled together with CompileIkSolvers
         """
         self.iksolver = None
         if iktype is not None:
@@ -841,6 +844,10 @@ class InverseKinematicsModel(DatabaseGenerator):
         if self.freeinc is None:
             self.freeinc = self.getDefaultFreeIncrements(0.1,0.01)
         
+        if not forceikbuild and docompile and len(self.getfilename(True)) > 0 and self.load(freeinc=freeinc,checkforloaded=False):
+            log.info('using the cached ik library %s',self.getfilename(True))
+            return
+        
         log.info('Generating inverse kinematics for manip %s: %s %s, precision=%s, maxcasedepth=%d (this might take up to 10 min)',self.manip.GetName(),self.iktype,self.solveindices, precision, ikfastmaxcasedepth)
         if outputlang is None:
             outputlang = 'cpp'
@@ -883,7 +890,7 @@ class InverseKinematicsModel(DatabaseGenerator):
                 generationstart = time.time()
                 chaintree = solver.generateIkSolver(baselink=baselink,eelink=eelink,freeindices=self.freeindices,solvefn=solvefn)
                 self.ikfeasibility = None
-                code = solver.writeIkSolver(chaintree,lang=outputlang)
+                code = solver.writeIkSolver(chaintree,lang=outputlang,batchsize=ikfastbatchsize)
                 if len(code) == 0:
                     raise InverseKinematicsError(u'failed to generate ik solver for robot %s:%s'%(self.robot.GetName(),self.manip.GetName()))
                 
@@ -902,52 +909,101 @@ class InverseKinematicsModel(DatabaseGenerator):
                 log.warn(e)
 
         if self.ikfeasibility is None:
-            log.info('compiling ik file to %s',output_filename)
             if outputlang == 'cpp':
-                # compile the code and create the shared object
-                compiler,compile_flags = self.getcompiler()
-                try:
-                   output_dir = os.path.relpath('/',getcwd())
-                except AttributeError: # python 2.5 does not have os.path.relpath
-                   output_dir = relpath('/',getcwd())
-
-                platformsourcefilename = os.path.splitext(output_filename)[0]+'.cpp' # needed in order to prevent interference with machines with different architectures 
-                shutil.copyfile(sourcefilename, platformsourcefilename)
-                objectfiles=[]
-                try:
-                    objectfiles = compiler.compile(sources=[platformsourcefilename],macros=[('IKFAST_CLIBRARY',1),('IKFAST_NO_MAIN',1)],extra_postargs=compile_flags,output_dir=output_dir)
-                    # because some parts of ikfast require lapack, always try to link with it
-                    try:
-                        iswindows = sys.platform.startswith('win') or platform.system().lower() == 'windows'
-                        libraries = None
-                        if self.statistics.get('usinglapack',False) or not iswindows:
-                            libraries = ['lapack']
-                        compiler.link_shared_object(objectfiles,output_filename=output_filename, libraries=libraries)
-                    except distutils.errors.LinkError,e:
-                        log.warn(e)
-                        if libraries is not None and 'lapack' in libraries:
-                            libraries.remove('lapack')
-                            if len(libraries) == 0:
-                                libraries = None
-                        log.info('linking again with %r... (MSVC bug?)',libraries)
-                        compiler.link_shared_object(objectfiles,output_filename=output_filename, libraries=libraries)
-                        
+                if docompile:
+                    self.compile(sourcefilename,output_filename)
                     if not self.setrobot():
                         return ValueError('failed to generate ik solver')
-                finally:
-                    # cleanup intermediate files
-                    if os.path.isfile(platformsourcefilename):
-                        remove(platformsourcefilename)
-                    for objectfile in objectfiles:
-                        try:
-                            remove(objectfile)
-                        except:
-                            pass
             else:
                 log.warn('cannot continue further if outputlang %s is not cpp',outputlang)
                 
         self._cachedKinematicsHash = self.manip.GetInverseKinematicsStructureHash(self.iktype)
         
+    def compile(self,sourcefilename=None,output_filename=None):
+        """Compiles the generated c++ file into the shared object, without loading it.
+
+        Only runs the compiler and the linker, so it can be called from several threads at once, see CompileIkSolvers.
+        """
+        if sourcefilename is None:
+            sourcefilename = self.getsourcefilename(True)
+        if output_filename is None:
+            output_filename = self.getfilename(False)
+        log.info('compiling ik file to %s',output_filename)
+        # compile the code and create the shared object
+        compiler,compile_flags = self.getcompiler()
+        try:
+           output_dir = os.path.relpath('/',getcwd())
+        except AttributeError: # python 2.5 does not have os.path.relpath
+           output_dir = relpath('/',getcwd())
+
+        platformsourcefilename = os.path.splitext(output_filename)[0]+'.cpp' # needed in order to prevent interference with machines with different architectures 
+        shutil.copyfile(sourcefilename, platformsourcefilename)
+        objectfiles=[]
+        try:
+            objectfiles = compiler.compile(sources=[platformsourcefilename],macros=[('IKFAST_CLIBRARY',1),('IKFAST_NO_MAIN',1)],extra_postargs=compile_flags,output_dir=output_dir)
+            # because some parts of ikfast require lapack, always try to link with it
+            try:
+                iswindows = sys.platform.startswith('win') or platform.system().lower() == 'windows'
+                libraries = None
+                if self.statistics.get('usinglapack',False) or not iswindows:
+                    libraries = ['lapack']
+                compiler.link_shared_object(objectfiles,output_filename=output_filename, libraries=libraries)
+            except distutils.errors.LinkError,e:
+                log.warn(e)
+                if libraries is not None and 'lapack' in libraries:
+                    libraries.remove('lapack')
+                    if len(libraries) == 0:
+                        libraries = None
+                log.info('linking again with %r... (MSVC bug?)',libraries)
+                compiler.link_shared_object(objectfiles,output_filename=output_filename, libraries=libraries)
+        finally:
+            # cleanup intermediate files
+            if os.path.isfile(platformsourcefilename):
+                remove(platformsourcefilename)
+            for objectfile in objectfiles:
+                try:
+                    remove(objectfile)
+                except:
+                    pass
+
+    @staticmethod
+    def CompileIkSolvers(ikmodels,numthreads=None):
+        """Compiles the c++ files of several models generated with generate(docompile=False) in parallel, then sets their ik solvers.
+
+        The compilers are separate processes, so the threads only wait on them.
+        :param numthreads: the number of compilers running at once, the number of cpus if None
+        :return: the models whose ik solver could not be compiled or set
+        """
+        if numthreads is None:
+            import multiprocessing
+            numthreads = multiprocessing.cpu_count()
+        # the filenames need the environment, so get them before starting the threads
+        jobs = [(ikmodel,ikmodel.getsourcefilename(True),ikmodel.getfilename(False)) for ikmodel in ikmodels if ikmodel.ikfeasibility is None]
+        failedmodels = [ikmodel for ikmodel in ikmodels if ikmodel.ikfeasibility is not None]
+        lock = threading.Lock()
+        def compileworker():
+            while True:
+                with lock:
+                    if len(jobs) == 0:
+                        return
+                    ikmodel,sourcefilename,output_filename = jobs.pop()
+                try:
+                    ikmodel.compile(sourcefilename,output_filename)
+                except Exception,e:
+                    log.warn(u'failed to compile %s: %s',sourcefilename,e)
+                    with lock:
+                        failedmodels.append(ikmodel)
+        
+        threads = [threading.Thread(target=compileworker) for i in range(max(1,min(numthreads,len(jobs))))]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        for ikmodel in ikmodels:
+            if not ikmodel in failedmodels and not ikmodel.setrobot():
+                failedmodels.append(ikmodel)
+        return failedmodels
+        
     def perftiming(self,num):
         with self.env:
             results = self.ikfastproblem.SendCommand('PerfTiming num %d %s'%(num,self.getfilename(True)))
@@ -56,7 +56,7 @@ if not __openravepy_build_doc__:
 else:
     from numpy import array
 
-from ..openravepy_int import RaveFindDatabaseFile, RaveCreateRobot, IkParameterization, rotationMatrixFromAxisAngle, poseFromMatrix, matrixFromPose, matrixFromQuat, matrixFromAxisAngle, poseMult, quatFromAxisAngle, IkFilterOptions
+from ..openravepy_int import RaveFindDatabaseFile, RaveCreateRobot, IkParameterization, rotationMatrixFromAxisAngle, poseFromMatrix, matrixFromPose, matrixFromQuat, matrixFromAxisAngle, poseMult, quatFromAxisAngle, IkFilterOptions, RaveCreateSpaceSampler, SampleDataType
 from ..openravepy_ext import quatArrayTMult, quatArrayTDist, poseMultArrayT, normalizeZRotation
 from . import DatabaseGenerator
 from .. import pyANN
@@ -64,6 +64,7 @@ from . import kinematicreachability, linkstatistics, inversekinematics
 
 import numpy
 import os.path
+from os import makedirs
 from optparse import OptionParser
 
 import logging
@@ -92,18 +93,70 @@ class InverseReachabilityModel(DatabaseGenerator):
         return self.equivalenceclasses is not None and len(self.equivalenceclasses) > 0
     def getversion(self):
         return 3
-    def load(self):
+    def load(self,memorymap=True):
+        """
+        :param memorymap: if True, memory maps the samples of the equivalence classes instead of reading them, see LoadHDF5
+        """
         try:
             if not self.ikmodel.load():
                 self.ikmodel.autogenerate()
-            params = DatabaseGenerator.load(self)
-            if params is None:
+            try:
+                if self.LoadHDF5(memorymap):
+                    return True
+            except ImportError:
+                log.warn('python h5py library not found, will not be able to speedup database access')
+            # databases saved before the HDF5 format
+            return self.LoadPickle()
+        except Exception, e:
+            log.warn(e)
+            return False
+
+    def LoadPickle(self):
+        params = DatabaseGenerator.load(self)
+        if params is None:
+            return False
+        self.equivalenceclasses,self.rotweight,self.xyzdelta,self.quatdelta,self.jointvalues = params
+        self.preprocess()
+        return self.has()
+
+    def LoadHDF5(self,memorymap=True):
+        """
+        :param memorymap: if True, the samples of all the equivalence classes are memory mapped from the file, so loading only reads the class statistics and all the processes share the pages of the samples.
+        """
+        import h5py
+        filename = self.getfilename(True)
+        if len(filename) == 0 or not h5py.is_hdf5(filename):
+            return False
+
+        self._CloseDatabase()
+        f = None
+        try:
+            f=h5py.File(filename,'r')
+            if f['version'].value != self.getversion():
+                log.error('version is wrong %s!=%s ',f['version'],self.getversion())
                 return False
-            self.equivalenceclasses,self.rotweight,self.xyzdelta,self.quatdelta,self.jointvalues = params
+
+            self.rotweight = f['rotweight'].value
+            self.xyzdelta = f['xyzdelta'].value
+            self.quatdelta = f['quatdelta'].value
+            self.jointvalues = f['jointvalues'].value
+            means = f['means'].value
+            stds = f['stds'].value
+            sampleoffsets = f['sampleoffsets'].value
+            samples = self._MemoryMapDataset(f['samples']) if memorymap else f['samples'].value
+            # slices of the mapped samples are views, so they are not read here
+            self.equivalenceclasses = [(means[i],stds[i],samples[sampleoffsets[i]:sampleoffsets[i+1]]) for i in range(len(means))]
+            self._databasefile = f
+            f = None
             self.preprocess()
             return self.has()
-        except e:
+
+        except Exception,e:
+            log.debug('LoadHDF5 for %s: %s',filename,e)
             return False
+        finally:
+            if f is not None:
+                f.close()
     @staticmethod
     def classnormalizationconst(classstd):
         """normalization const for the equation exp(dot(-0.5/bandwidth**2,r_[arccos(x[0])**2,x[1:]**2]))"""
@@ -119,8 +172,40 @@ class InverseReachabilityModel(DatabaseGenerator):
         self.equivalenceoffset = array([self.classnormalizationconst(e[1]+samplingbandwidth) for e in self.equivalenceclasses])
 
     def save(self):
+        try:
+            self.SaveHDF5()
+        except ImportError:
+            log.warn('python h5py library not found, will not be able to speedup database access')
+            self.SavePickle()
+
+    def SavePickle(self):
         DatabaseGenerator.save(self,(self.equivalenceclasses,self.rotweight,self.xyzdelta,self.quatdelta,self.jointvalues))
 
+    def SaveHDF5(self):
+        """stores the samples of all the equivalence classes in one contiguous dataset so that LoadHDF5 can memory map it
+        """
+        import h5py
+        filename=self.getfilename(False)
+        log.info(u'saving model to %s',filename)
+        try:
+            makedirs(os.path.split(filename)[0])
+        except OSError:
+            pass
+
+        f=h5py.File(filename,'w')
+        try:
+            f['version'] = self.getversion()
+            f['rotweight'] = self.rotweight
+            f['xyzdelta'] = self.xyzdelta
+            f['quatdelta'] = self.quatdelta
+            f['jointvalues'] = array(self.jointvalues,float64)
+            f['means'] = array([e[0] for e in self.equivalenceclasses],float64)
+            f['stds'] = array([e[1] for e in self.equivalenceclasses],float64)
+            f['sampleoffsets'] = r_[0,cumsum([len(e[2]) for e in self.equivalenceclasses])].astype(int64)
+            f['samples'] = concatenate([e[2] for e in self.equivalenceclasses]).astype(float64)
+        finally:
+            f.close()
+
     def getfilename(self,read=False):
         if self.id is None:
             basename='invreachability.' + self.manip.GetStructureHash() + '.pp'
@@ -211,7 +296,7 @@ class InverseReachabilityModel(DatabaseGenerator):
             # find the density of the points
             searchtrans = c_[basetrans[:,0:4],basetrans[:,6:7]]
             kdtree = kinematicreachability.ReachabilityModel.QuaternionKDTree(searchtrans,1.0/self.rotweight)
-            transdensity = kdtree.kFRSearchArray(searchtrans,0.25*quateucdist2,0,quatthresh*0.2)[2]
+            transdensity = kdtree.kFRSearchArray(searchtrans,0.25*quateucdist2,0,quatthresh*0.2,numthreads=0)[2]
             basetrans = basetrans[argsort(-transdensity),:]
             Nminimum = max(Nminimum,4)
             # find all equivalence classes
@@ -222,12 +307,11 @@ class InverseReachabilityModel(DatabaseGenerator):
                 kdtree = kinematicreachability.ReachabilityModel.QuaternionKDTree(searchtrans,1.0/self.rotweight)
                 querypoints = c_[quatArrayTMult(quatrolls, searchtrans[0][0:4]),tile(searchtrans[0][4:],(len(quatrolls),1))]
                 foundindices = zeros(len(searchtrans),bool)
-                for querypoint in querypoints:
-                    k = min(len(searchtrans),1000)
-                    neighs,dists,kball = kdtree.kFRSearchArray(reshape(querypoint,(1,5)),quateucdist2,k,quatthresh*0.01)
-                    if k < kball:
-                        neighs,dists,kball = kdtree.kFRSearchArray(reshape(querypoint,(1,5)),quateucdist2,kball,quatthresh*0.01)
-                    foundindices[neighs] = True
+                k = min(len(searchtrans),1000)
+                neighs,dists,kball = kdtree.kFRSearchArray(querypoints,quateucdist2,k,quatthresh*0.01)
+                if k < max(kball):
+                    neighs,dists,kball = kdtree.kFRSearchArray(querypoints,quateucdist2,max(kball),quatthresh*0.01)
+                foundindices[neighs[neighs>=0]] = True
                 equivalenttrans = basetrans[flatnonzero(foundindices),:]
                 normalizedqarray,zangles = normalizeZRotation(equivalenttrans[:,0:4])
                 # get the 'mean' of the normalized quaternions best describing the distribution
@@ -328,7 +412,7 @@ class InverseReachabilityModel(DatabaseGenerator):
             """returns the density"""
             qposes,zposeangles = normalizeZRotation(poses[:,0:4])
             p = c_[zposeangles*rotweight,poses[:,4:6]]
-            neighs,dists,kball = kdtree.kFRSearchArray(p,searchradius,16,searcheps)
+            neighs,dists,kball = kdtree.kFRSearchBatch(p,searchradius,16,searcheps)
             probs = zeros(p.shape[0])
             for i in range(p.shape[0]):
                 inds = neighs[i,neighs[i,:]>=0]
@@ -410,7 +494,7 @@ class InverseReachabilityModel(DatabaseGenerator):
             """returns the density"""
             qposes,zposeangles = normalizeZRotation(poses[:,0:4])
             p = c_[zposeangles*rotweight,poses[:,4:6]]
-            neighs,dists,kball = kdtree.kFRSearchArray(p,searchradius,16,searcheps)
+            neighs,dists,kball = kdtree.kFRSearchBatch(p,searchradius,16,searcheps)
             probs = zeros(p.shape[0])
             for i in range(p.shape[0]):
                 inds = neighs[i,neighs[i,:]>=0]
@@ -452,7 +536,9 @@ class InverseReachabilityModel(DatabaseGenerator):
         graspindices = []
         graspindexoffsets = []
         Tbaserot = c_[rotationMatrixFromAxisAngle([0,0,1],zbaseangle)[0:2,0:2],posebase[4:6]]
+        allgrasps = [] # Tgrasps can be an iterator
         for Tgrasp,graspindex in Tgrasps:
+            allgrasps.append((Tgrasp,graspindex))
             posetarget = poseFromMatrix(dot(linalg.inv(Tbase),Tgrasp))
             qnormalized,znormangle = normalizeZRotation(reshape(posetarget[0:4],(1,4)))
             # find the closest cluster
@@ -483,8 +569,14 @@ class InverseReachabilityModel(DatabaseGenerator):
 
         if len(points) == 0:
             raise planning_error('could not find base distribution')
-        
-        kdtree = pyANN.KDTree(points)
+
+        sampler = self.createBaseSampler(allgrasps,logllthresh,weight)
+        if sampler is not None:
+            jointstate = self.necessaryjointstate()
+            while True:
+                for sample in sampler.SampleSequence2D(SampleDataType.Real,100):
+                    yield sample[0:7],int(sample[7]),jointstate
+
         cumweights = cumsum(weights)
         cumweights = cumweights[1:]/cumweights[-1]
         while True:
@@ -494,6 +586,27 @@ class InverseReachabilityModel(DatabaseGenerator):
             sample[0] *= 0.5*irotweight
             yield poseMult(poserobot,r_[cos(sample[0]),0,0,sin(sample[0]),sample[1:3],Tbase[2,3]]),sampledgraspindex,self.necessaryjointstate()
 
+    def createBaseSampler(self,Tgrasps,logllthresh=2.0,weight=1.0):
+        """Creates the native InverseReachability space sampler for the grasps, returns None if no grasp has a base distribution.
+
+        Each sample of SampleSequence2D(SampleDataType.Real,N) is the robot pose followed by the grasp index, the robot joints should be set with necessaryjointstate.
+        :param Tgrasps: list of (Tgrasp,graspindex) in the world coordinate system, uses the current transforms of the robot and manipulator base
+        """
+        sampler = RaveCreateSpaceSampler(self.env,'InverseReachability %s %s'%(self.robot.GetName(),self.manip.GetName()))
+        if sampler is None:
+            return None
+        cmd = 'LoadEquivalenceClasses %.16g %.16g %.16g %d '%(self.rotweight,self.quatdelta,self.xyzdelta,len(self.equivalenceclasses))
+        cmd += ' '.join('%s %s %d %s'%(' '.join('%.16g'%f for f in e[0]),' '.join('%.16g'%f for f in e[1]),len(e[2]),' '.join('%.16g'%f for f in e[2][:,0:4].flat)) for e in self.equivalenceclasses)
+        if sampler.SendCommand(cmd) is None:
+            return None
+        cmd = 'SetGrasps %.16g %d '%(logllthresh,len(Tgrasps))
+        cmd += ' '.join('%d %s'%(graspindex,' '.join('%.16g'%f for f in poseFromMatrix(Tgrasp))) for Tgrasp,graspindex in Tgrasps)
+        numaccepted = sampler.SendCommand(cmd)
+        if numaccepted is None or int(numaccepted) == 0:
+            return None
+        sampler.SendCommand('SetBandwidthWeight %.16g'%weight)
+        return sampler
+
     def randomBaseDistributionIterator(self,Tgrasps,Nprematuresamples=1,bounds=None,**kwargs):
         """randomly sample base positions given the grasps. This is mostly used for comparison"""
         if bounds is None:
@@ -57,7 +57,7 @@ if not __openravepy_build_doc__:
 else:
     from numpy import array
 
-from ..openravepy_int import RaveFindDatabaseFile, IkParameterization, rotationMatrixFromQArray, poseFromMatrix
+from ..openravepy_int import RaveFindDatabaseFile, IkParameterization, rotationMatrixFromQArray, poseFromMatrix, quatFromRotationMatrix
 from ..openravepy_ext import transformPoints, quatArrayTDist
 from .. import metaclass, pyANN
 from ..misc import SpaceSamplerExtra
@@ -69,6 +69,7 @@ import time
 import os.path
 from os import makedirs
 from heapq import nsmallest # for nth smallest element
+from itertools import izip
 from optparse import OptionParser
 
 import logging
@@ -89,11 +90,10 @@ class ReachabilityModel(DatabaseGenerator):
             allposes = r_[searchposes,searchposes]
             allposes[self.numposes:,0:4] *= -1
             self.nnposes = pyANN.KDTree(allposes)
-        def kSearch(self,poses,k,eps):
+        def kSearch(self,poses,k,eps,numthreads=1):
             """returns distance squared"""
             poses[:,4:] *= self.transmult
-#            neighs,dists = self.nnposes.kSearch(poses,k,eps)
-            neighs,dists = zip(*[self.nnposes.kSearch(pose,k,eps) for pose in poses])
+            neighs,dists = self.nnposes.kSearchBatch(poses,k,eps,numthreads)
             neighs[neighs>=self.numposes] -= self.numposes
             poses[:,4:] *= self.itransmult
             return neighs,dists
@@ -104,10 +104,10 @@ class ReachabilityModel(DatabaseGenerator):
             neighs[neighs>=self.numposes] -= self.numposes
             pose[4:] *= self.itransmult
             return neighs,dists,kball
-        def kFRSearchArray(self,poses,radiussq,k,eps):
+        def kFRSearchArray(self,poses,radiussq,k,eps,numthreads=1):
             """returns distance squared"""
             poses[:,4:] *= self.transmult
-            neighs,dists,kball = self.nnposes.kFRSearchArray(poses,radiussq,k,eps)
+            neighs,dists,kball = self.nnposes.kFRSearchBatch(poses,radiussq,k,eps,numthreads)
             neighs[neighs>=self.numposes] -= self.numposes
             poses[:,4:] *= self.itransmult
             return neighs,dists,kball
@@ -142,13 +142,16 @@ class ReachabilityModel(DatabaseGenerator):
             log.warn('python h5py library not found, will not be able to speedup database access')
             self.SavePickle()
 
-    def load(self):
+    def load(self,memorymap=True):
+        """
+        :param memorymap: if True, memory maps the reachability arrays instead of reading them, see LoadHDF5
+        """
         try:
             if not self.ikmodel.load():
                 self.ikmodel.autogenerate()
 
             try:
-                return self.LoadHDF5()
+                return self.LoadHDF5(memorymap)
             except ImportError:
                 log.warn('python h5py library not found, will not be able to speedup database access')
                 return self.LoadPickle()
@@ -187,22 +190,31 @@ class ReachabilityModel(DatabaseGenerator):
         finally:
             f.close()
 
-    def LoadHDF5(self):
+    def LoadHDF5(self,memorymap=True):
+        """
+        :param memorymap: if True, the reachability arrays are memory mapped from the file, so loading does not read them and all the processes share their pages. The kd-trees are built from the mapped arrays on the first ComputeNN. Otherwise the arrays are h5py datasets.
+        """
         import h5py
         filename = self.getfilename(True)
         if len(filename) == 0:
             return False
 
         self._CloseDatabase()
+        self.kdtree3d = self.kdtree6d = None
         try:
             f=h5py.File(filename,'r')
             if f['version'].value != self.getversion():
                 log.error('version is wrong %s!=%s ',f['version'],self.getversion())
                 return False
 
-            self.reachabilitystats = f['reachabilitystats']
-            self.reachabilitydensity3d = f['reachabilitydensity3d']
-            self.reachability3d = f['reachability3d']
+            if memorymap:
+                self.reachabilitystats = self._MemoryMapDataset(f['reachabilitystats'])
+                self.reachabilitydensity3d = self._MemoryMapDataset(f['reachabilitydensity3d'])
+                self.reachability3d = self._MemoryMapDataset(f['reachability3d'])
+            else:
+                self.reachabilitystats = f['reachabilitystats']
+                self.reachabilitydensity3d = f['reachabilitydensity3d']
+                self.reachability3d = f['reachability3d']
             self.pointscale = f['pointscale'].value
             self.xyzdelta = f['xyzdelta'].value
             self.quatdelta = f['quatdelta'].value
@@ -226,6 +238,7 @@ class ReachabilityModel(DatabaseGenerator):
         xyzdelta=None
         quatdelta=None
         usefreespace=False
+        numthreads=None
         if options is not None:
             if options.maxradius is not None:
                 maxradius = options.maxradius
@@ -234,6 +247,8 @@ class ReachabilityModel(DatabaseGenerator):
             if options.quatdelta is not None:
                 quatdelta=options.quatdelta
             usefreespace=options.usefreespace
+            if options.numthreads is not None:
+                numthreads=options.numthreads
         if self.robot.GetKinematicsGeometryHash() == 'e829feb384e6417bbf5bd015f1c6b49a' or self.robot.GetKinematicsGeometryHash() == '22548f4f2ecf83e88ae7e2f3b2a0bd08': # wam 7dof
             if maxradius is None:
                 maxradius = 1.1
@@ -242,7 +257,7 @@ class ReachabilityModel(DatabaseGenerator):
                 xyzdelta = 0.03
             if quatdelta is None:
                 quatdelta = 0.2
-        return maxradius,translationonly,xyzdelta,quatdelta,usefreespace
+        return maxradius,translationonly,xyzdelta,quatdelta,usefreespace,numthreads
 
     def getOrderedArmJoints(self):
         return [j for j in self.robot.GetDependencyOrderedJoints() if j.GetJointIndex() in self.manip.GetArmIndices()]
@@ -268,11 +283,55 @@ class ReachabilityModel(DatabaseGenerator):
                     links.append(newlink)
         return links
 
-    def generatepcg(self,maxradius=None,translationonly=False,xyzdelta=None,quatdelta=None,usefreespace=False):
-        """Generate producer, consumer, and gatherer functions allowing parallelization
+    def generate(self,maxradius=None,translationonly=False,xyzdelta=None,quatdelta=None,usefreespace=False,numthreads=None):
+        """Computes the reachability maps.
+
+        The IK solutions are counted by the ComputeReachability command of the ikfast module with numthreads threads. Falls back to solving from python if the module is not available.
         """
         if not self.ikmodel.load():
             self.ikmodel.autogenerate()
+        if self.ikmodel.ikfastproblem is None:
+            return DatabaseGenerator.generate(self,maxradius,translationonly,xyzdelta,quatdelta,usefreespace)
+        if numthreads is None:
+            import multiprocessing
+            numthreads = multiprocessing.cpu_count()
+        starttime = time.time()
+        Trobot,baseanchor,allpoints,insideinds,shape,rotations = self._initsampling(maxradius,translationonly,xyzdelta,quatdelta,usefreespace)
+        log.info('database %s has %d items, computing with %d threads',self.__class__.__name__.split()[-1],len(insideinds),numthreads)
+        quats = array([quatFromRotationMatrix(rotation) for rotation in rotations])
+        positions = allpoints[insideinds]+baseanchor
+        cmd = 'ComputeReachability %s %s %d %d %d %s %d %s'%(self.robot.GetName(),self.manip.GetName(),numthreads,usefreespace,len(quats),' '.join(repr(f) for f in quats.flat),len(positions),' '.join(repr(f) for f in positions.flat))
+        with self.env:
+            with self.robot:
+                self.robot.SetTransform(Trobot)
+                res = self.ikmodel.ikfastproblem.SendCommand(cmd)
+        if res is None:
+            raise ValueError('failed to compute reachability of robot %s manipulator %s'%(self.robot.GetName(),self.manip.GetName()))
+
+        self.reachabilitydensity3d = zeros(prod(shape))
+        self.reachability3d = zeros(prod(shape))
+        self.reachabilitystats = []
+        T = eye(4)
+        for ind,position,line in izip(insideinds,positions,res.splitlines()):
+            values = [int(s) for s in line.split()]
+            numvalid = 0
+            T[0:3,3] = position
+            for irotation,numsolutions in izip(values[1::2],values[2::2]):
+                T[0:3,0:3] = rotations[irotation]
+                self.reachabilitystats.append(r_[poseFromMatrix(T),numsolutions])
+                numvalid += numsolutions
+            self.reachabilitydensity3d[ind] = numvalid/float(len(rotations))
+            self.reachability3d[ind] = values[0]/float(len(rotations))
+        self.reachability3d = reshape(self.reachability3d,shape)
+        self.reachabilitydensity3d = reshape(self.reachabilitydensity3d,shape)
+        self.reachabilitystats = array(self.reachabilitystats)
+        log.info('database %s finished in %fs',self.__class__.__name__,time.time()-starttime)
+
+    def _initsampling(self,maxradius=None,translationonly=False,xyzdelta=None,quatdelta=None,usefreespace=False):
+        """Computes the sampled positions and rotations relative to the manipulator base
+
+        :return: Trobot, baseanchor, allpoints, insideinds, shape, rotations
+        """
         # disable every body but the target and robot\
         if xyzdelta is None:
             xyzdelta=0.04
@@ -311,7 +370,14 @@ class ReachabilityModel(DatabaseGenerator):
                     neighdists.append(nsmallest(2,quatArrayTDist(q,qarray))[1])
                 self.quatdelta = mean(neighdists)
             log.info('radius: %f, xyzsamples: %d, quatdelta: %f, rot samples: %d, freespace: %d',maxradius,len(insideinds),self.quatdelta,len(rotations),usefreespace)
-            
+        return Trobot,baseanchor,allpoints,insideinds,shape,rotations
+
+    def generatepcg(self,maxradius=None,translationonly=False,xyzdelta=None,quatdelta=None,usefreespace=False):
+        """Generate producer, consumer, and gatherer functions allowing parallelization
+        """
+        if not self.ikmodel.load():
+            self.ikmodel.autogenerate()
+        Trobot,baseanchor,allpoints,insideinds,shape,rotations = self._initsampling(maxradius,translationonly,xyzdelta,quatdelta,usefreespace)
         self.reachabilitydensity3d = zeros(prod(shape))
         self.reachability3d = zeros(prod(shape))
         self.reachabilitystats = []
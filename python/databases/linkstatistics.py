@@ -67,7 +67,7 @@ else:
 
 import numpy
 from ..openravepy_ext import transformPoints, openrave_exception
-from ..openravepy_int import RaveFindDatabaseFile, RaveDestroy, Environment, KinBody, rotationMatrixFromQuat, quatRotateDirection, rotationMatrixFromAxisAngle, RaveGetDefaultViewerType
+from ..openravepy_int import RaveFindDatabaseFile, RaveDestroy, Environment, KinBody, rotationMatrixFromQuat, quatRotateDirection, rotationMatrixFromAxisAngle, RaveGetDefaultViewerType, RaveCreateModule
 from . import DatabaseGenerator
 from .. import pyANN
 import convexdecomposition
@@ -85,8 +85,10 @@ class LinkStatisticsModel(DatabaseGenerator):
     """Computes the convex decomposition of all of the robot's links"""
     
     grabbedjointspheres = None # a list of (grabbedinfo, dict) that stores swept spheres of each joint. key is joint index. 
+    numthreads = None # number of threads for computing the joint spheres, if None uses all the cpus
     def __init__(self,robot):
         DatabaseGenerator.__init__(self,robot=robot)
+        self._graspermodule = None # for ComputeJointSpheres
     
     def has(self):
         return self.grabbedjointspheres is not None and len(self.grabbedjointspheres) > 0
@@ -99,7 +101,7 @@ class LinkStatisticsModel(DatabaseGenerator):
             return value
 
     def getversion(self):
-        return 6
+        return 7
     
     def save(self):
         self.SavePickle()
@@ -181,13 +183,18 @@ class LinkStatisticsModel(DatabaseGenerator):
                 raise ValueError('no such type')
     
     def autogenerate(self,options=None):
-        self.generate()
+        if options is not None:
+            self.generate(numthreads=options.numthreads)
+        else:
+            self.generate()
         self.save()
     
-    def generate(self,**kwargs):
+    def generate(self,numthreads=None,**kwargs):
         """
-        :param computeaffinevolumes: if True will compute affine volumes
+        :param numthreads: the number of threads to compute the joint spheres with. If None, uses all the cpus.
         """
+        if numthreads is not None:
+            self.numthreads = numthreads
         with self.robot:
             self.robot.SetTransform(eye(4))
             self.robot.SetDOFValues(zeros(self.robot.GetDOF()))
@@ -205,6 +212,30 @@ class LinkStatisticsModel(DatabaseGenerator):
         return jointspheres
     
     def _ComputeJointSpheres(self):
+        """computes the joint spheres with the ComputeJointSpheres command of the grasper module, which bounds the link vertices in parallel. Falls back to bounding the link aabbs from python if the module is not available.
+        """
+        numthreads = self.numthreads
+        if numthreads is None:
+            import multiprocessing
+            numthreads = multiprocessing.cpu_count()
+        with self.env:
+            if self._graspermodule is None:
+                self._graspermodule = RaveCreateModule(self.env,'grasper')
+                if self._graspermodule is not None:
+                    self.env.AddModule(self._graspermodule,self.robot.GetName())
+            if self._graspermodule is not None:
+                res = self._graspermodule.SendCommand('ComputeJointSpheres %s %d'%(self.robot.GetName(),numthreads))
+                if res is not None:
+                    jointspheres = {}
+                    for line in res.splitlines():
+                        values = line.split()
+                        if len(values) == 5:
+                            jointspheres[int(values[0])] = (array([float64(f) for f in values[1:4]]), float64(values[4]))
+                    return jointspheres
+                log.warn(u'failed to compute joint spheres with grasper module, computing from python')
+            return self._ComputeJointSpheresFromAABBs()
+    
+    def _ComputeJointSpheresFromAABBs(self):
         jointspheres = {}
         for j in self.robot.GetDependencyOrderedJoints()[::-1]:
             if not j.IsRevolute(0):
@@ -204,9 +204,20 @@ class VisibilityModel(DatabaseGenerator):
                 preshapes = array([final])
         else:
             preshapes = array(())
-        self.generate(preshapes=preshapes,sphere=sphere,conedirangles=conedirangles)
+        numthreads = options.numthreads if options is not None else None
+        # results are checkpointed next to the database so that an interrupted generation resumes
+        checkpointfilename = self.getfilename(False)+'.checkpoint'
+        if not os.path.isdir(os.path.dirname(checkpointfilename)):
+            os.makedirs(os.path.dirname(checkpointfilename))
+        self.generate(preshapes=preshapes,sphere=sphere,conedirangles=conedirangles,numthreads=numthreads,checkpointfilename=checkpointfilename)
         self.save()
-    def generate(self,preshapes,sphere=None,conedirangles=None,localtransforms=None):
+        if os.path.isfile(checkpointfilename):
+            os.remove(checkpointfilename)
+    def generate(self,preshapes,sphere=None,conedirangles=None,localtransforms=None,numthreads=None,checkpointfilename=None):
+        """
+        :param numthreads: number of threads the camera transforms are tested with
+        :param checkpointfilename: if not None, the test results are saved to this file as they are computed so an interrupted call resumes from them
+        """
         self.preshapes=preshapes
         self.preprocess()
         self.sensorname = self.attachedsensor.GetName()
@@ -229,13 +240,13 @@ class VisibilityModel(DatabaseGenerator):
                             self.robot.SetDOFValues(self.preshapes[0],self.manip.GetGripperIndices())
                     extentsfile = os.path.join(RaveGetHomeDirectory(),'kinbody.'+self.target.GetKinematicsGeometryHash(),'visibility.txt')
                     if sphere is None and os.path.isfile(extentsfile):
-                        self.visibilitytransforms = self.visualprob.ProcessVisibilityExtents(extents=loadtxt(extentsfile,float),conedirangles=conedirangles)
+                        self.visibilitytransforms = self.visualprob.ProcessVisibilityExtents(extents=loadtxt(extentsfile,float),conedirangles=conedirangles,numthreads=numthreads,checkpoint=checkpointfilename)
                     elif localtransforms is not None:
-                        self.visibilitytransforms = self.visualprob.ProcessVisibilityExtents(transforms=localtransforms)
+                        self.visibilitytransforms = self.visualprob.ProcessVisibilityExtents(transforms=localtransforms,numthreads=numthreads,checkpoint=checkpointfilename)
                     else:
                         if sphere is None:
                             sphere = [3,0.1,0.15,0.2,0.25,0.3]
-                        self.visibilitytransforms = self.visualprob.ProcessVisibilityExtents(sphere=sphere,conedirangles=conedirangles)
+                        self.visibilitytransforms = self.visualprob.ProcessVisibilityExtents(sphere=sphere,conedirangles=conedirangles,numthreads=numthreads,checkpoint=checkpointfilename)
                 print 'total transforms: ',len(self.visibilitytransforms)
                 self.visualprob.SetCameraTransforms(transforms=self.visibilitytransforms)
         finally:
@@ -120,7 +120,7 @@ template <typename T>
 class IkFastFunctions
 {
 public:
-    IkFastFunctions() : _ComputeIk(NULL), _ComputeIk2(NULL), _ComputeFk(NULL), _GetNumFreeParameters(NULL), _GetFreeParameters(NULL), _GetNumJoints(NULL), _GetIkRealSize(NULL), _GetIkFastVersion(NULL), _GetIkType(NULL), _GetKinematicsHash(NULL) {
+    IkFastFunctions() : _ComputeIk(NULL), _ComputeIk2(NULL), _ComputeIkBatch(NULL), _ComputeFk(NULL), _GetNumFreeParameters(NULL), _GetFreeParameters(NULL), _GetNumJoints(NULL), _GetIkRealSize(NULL), _GetIkFastVersion(NULL), _GetIkType(NULL), _GetKinematicsHash(NULL) {
     }
     virtual ~IkFastFunctions() {
     }
@@ -128,6 +128,8 @@ public:
     ComputeIkFn _ComputeIk;
     typedef bool (*ComputeIk2Fn)(const T*, const T*, const T*, IkSolutionListBase<T>&, void*);
     ComputeIk2Fn _ComputeIk2;
+    typedef int (*ComputeIkBatchFn)(const T*, const T*, const T*, int, IkSolutionListBase<T>**);
+    ComputeIkBatchFn _ComputeIkBatch; ///< optional, only exported when the solver was generated with a batch size
     typedef void (*ComputeFkFn)(const T*, T*, T*);
     ComputeFkFn _ComputeFk;
     typedef int (*GetNumFreeParametersFn)();
@@ -309,6 +311,16 @@ IKFAST_API bool ComputeIk(const IkReal* eetrans, const IkReal* eerot, const IkRe
  */
 IKFAST_API bool ComputeIk2(const IkReal* eetrans, const IkReal* eerot, const IkReal* pfree, ikfast::IkSolutionListBase<IkReal>& solutions, void* pOpenRAVEManip);
 
+/** \brief Computes IK solutions of the same end effector coordinates for many free parameter samples at once.
+
+   Only exported when the solver was generated with a batch size (ikfast.py --batchsize).
+
+   - ``pfrees`` - structure-of-arrays layout, the value of free parameter i for sample j is pfrees[i*numsamples+j]. Can be NULL if there are no free parameters.
+   - ``solutions`` - numsamples solution lists, the solutions of sample j are stored in solutions[j].
+   \return the number of samples that have at least one solution
+ */
+IKFAST_API int ComputeIkBatch(const IkReal* eetrans, const IkReal* eerot, const IkReal* pfrees, int numsamples, ikfast::IkSolutionListBase<IkReal>** solutions);
+
 /// \brief Computes the end effector coordinates given the joint values. This function is used to double check ik.
 IKFAST_API void ComputeFk(const IkReal* joints, IkReal* eetrans, IkReal* eerot);
 
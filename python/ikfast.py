@@ -2120,8 +2120,10 @@ class IKFastSolver(AutoReloader):
         if not found:
             raise self.IKFeasibilityError(AllEquations,checkvars)
         
-    def writeIkSolver(self,chaintree,lang=None):
+    def writeIkSolver(self,chaintree,lang=None,batchsize=0):
         """write the ast into a specific langauge, prioritize c++
+
+        :param batchsize: if > 0, the c++ generator also exports ComputeIkBatch that evaluates free parameter samples in blocks of batchsize
         """
         if lang is None:
             if CodeGenerators.has_key('cpp'):
@@ -2129,6 +2131,8 @@ class IKFastSolver(AutoReloader):
             else:
                 lang = CodeGenerators.keys()[0]
         log.info('generating %s code...'%lang)
+        if batchsize > 0:
+            return CodeGenerators[lang](kinematicshash=self.kinematicshash,version=__version__,batchsize=batchsize).generate(chaintree)
         return CodeGenerators[lang](kinematicshash=self.kinematicshash,version=__version__).generate(chaintree)
     
     def generateIkSolver(self, baselink, eelink, freeindices=None, solvefn=None, ikfastoptions=0):
@@ -9496,6 +9500,8 @@ python ikfast.py --robot=robots/barrettwam.robot.xml --baselink=0 --eelink=7 --s
                       help='The max depth to go into degenerate cases. If ikfast file is too big, try reducing this, (default=%default).')
     parser.add_option('--lang', action='store',type='string',dest='lang',default='cpp',
                       help='The language to generate the code in (default=%default), available=('+','.join(name for name,value in CodeGenerators.iteritems())+')')
+    parser.add_option('--batchsize', action='store',type='int',dest='batchsize',default=0,
+                      help='If > 0, also export ComputeIkBatch that evaluates free parameter samples in blocks of this size, usually 4 or 8 (default=%default).')
     parser.add_option('--debug','-d', action='store', type='int',dest='debug',default=logging.INFO,
                       help='Debug level for python nose (smaller values allow more text).')
     
@@ -9519,7 +9525,7 @@ python ikfast.py --robot=robots/barrettwam.robot.xml --baselink=0 --eelink=7 --s
             solver = IKFastSolver(kinbody,kinbody)
             solver.maxcasedepth = options.maxcasedepth
             chaintree = solver.generateIkSolver(options.baselink,options.eelink,options.freeindices,solvefn=solvefn)
-            code=solver.writeIkSolver(chaintree,lang=options.lang)
+            code=solver.writeIkSolver(chaintree,lang=options.lang,batchsize=options.batchsize)
         finally:
             openravepy.RaveDestroy()
 
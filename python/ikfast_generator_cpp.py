@@ -197,7 +197,10 @@ def customcse(rawexprs,symbols=None):
 class CodeGenerator(AutoReloader):
     """Generates C++ code from an AST generated by IKFastSolver.
     """
-    def __init__(self,kinematicshash='',version='0'):
+    def __init__(self,kinematicshash='',version='0',batchsize=0):
+        """
+        :param batchsize: if > 0, also export ComputeIkBatch that processes the free parameter samples in blocks of batchsize lanes
+        """
         self.symbolgen = cse_main.numbered_symbols('x')
         self.strprinter = printing.StrPrinter({'full_prec':False})
         self.freevars = None # list of free variables in the solution
@@ -208,6 +211,8 @@ class CodeGenerator(AutoReloader):
         self._globalvariables = {} # a set of global variables already written
         self._solutioncounter = 0
         self.version=version
+        self.batchsize=batchsize
+        self._numfreeparameters = 0
 
     def resetequations(self):
         self.dictequations = [[],[]]
@@ -531,6 +536,7 @@ IKSolver solver;
 return solver.ComputeIk(eetrans,eerot,pfree,solutions);
 }
 
+%s
 IKFAST_API const char* GetKinematicsHash() { return "%s"; }
 
 IKFAST_API const char* GetIkFastVersion() { return "%s"; }
@@ -538,7 +544,7 @@ IKFAST_API const char* GetIkFastVersion() { return "%s"; }
 #ifdef IKFAST_NAMESPACE
 } // end namespace
 #endif
-"""%(self.kinematicshash, self.version)
+"""%(self.getBatchEntryPoint(), self.kinematicshash, self.version)
 
         code += """
 #ifndef IKFAST_NO_MAIN
@@ -590,7 +596,45 @@ int main(int argc, char** argv)
 """
         return code
 
+    def getBatchEntryPoint(self):
+        """returns the code of ComputeIkBatch if batchsize > 0.
+
+        The free parameter samples are passed in structure-of-arrays layout and are gathered in blocks of batchsize lanes so that
+        the loads of each block are contiguous. Every lane still goes through the solver tree on its own since the tree branches on the
+        values of each sample.
+        """
+        if self.batchsize <= 0:
+            return ''
+        return """
+/// solves the inverse kinematics equations for numsamples free parameter samples of the same end effector coordinates.
+/// \\param pfrees the free parameters in structure-of-arrays layout, free parameter i of sample j is pfrees[i*numsamples+j].
+/// \\param solutions numsamples solution lists, the solutions of sample j are stored in solutions[j]
+/// \\return the number of samples that have at least one solution
+IKFAST_API int ComputeIkBatch(const IkReal* eetrans, const IkReal* eerot, const IkReal* pfrees, int numsamples, IkSolutionListBase<IkReal>** solutions) {
+const int batchsize = %d, numfree = %d;
+IkReal lanefrees[batchsize][numfree > 0 ? numfree : 1];
+IKSolver solver;
+int numsuccess = 0;
+for(int iblock = 0; iblock < numsamples; iblock += batchsize) {
+    const int numlanes = numsamples-iblock < batchsize ? numsamples-iblock : batchsize;
+    for(int ifree = 0; ifree < numfree; ++ifree) {
+        const IkReal* psrc = pfrees + ifree*numsamples + iblock;
+        for(int ilane = 0; ilane < numlanes; ++ilane) {
+            lanefrees[ilane][ifree] = psrc[ilane];
+        }
+    }
+    for(int ilane = 0; ilane < numlanes; ++ilane) {
+        if( solver.ComputeIk(eetrans,eerot,numfree > 0 ? lanefrees[ilane] : NULL,*solutions[iblock+ilane]) ) {
+            ++numsuccess;
+        }
+    }
+}
+return numsuccess;
+}
+"""%(self.batchsize,self._numfreeparameters)
+
     def getClassInit(self,node,iktype,userotation=7,usetranslation=7):
+        self._numfreeparameters = len(node.freejointvars)
         code = "IKFAST_API int GetNumFreeParameters() { return %d; }\n"%len(node.freejointvars)
         if len(node.freejointvars) == 0:
             code += "IKFAST_API int* GetFreeParameters() { return NULL; }\n"
@@ -58,8 +58,10 @@ class Grasper:
         clone.avoidlinks = [clone.robot.GetLink(link.GetName()) for link in self.avoidlinks]
         envother.Add(clone.prob,True,clone.args)
         return clone
-    def Grasp(self,direction=None,roll=None,position=None,standoff=None,target=None,stablecontacts=False,forceclosure=False,transformrobot=True,onlycontacttarget=True,tightgrasp=False,graspingnoise=None,execute=None,translationstepmult=None,outputfinal=False,manipulatordirection=None,finestep=None,vintersectplane=None,chuckingdirection=None):
+    def Grasp(self,direction=None,roll=None,position=None,standoff=None,target=None,stablecontacts=False,forceclosure=False,transformrobot=True,onlycontacttarget=True,tightgrasp=False,graspingnoise=None,execute=None,translationstepmult=None,outputfinal=False,manipulatordirection=None,finestep=None,vintersectplane=None,chuckingdirection=None,continuouscontact=False):
         """See :ref:`module-grasper-grasp`
+
+        :param continuouscontact: if True, the fingers jump to their contacts using distance queries and bisection instead of fixed steps
         """
         cmd = 'Grasp '
         if direction is not None:
@@ -81,6 +83,8 @@ class Grasper:
             cmd += 'translationstepmult %.15e '%translationstepmult
         if finestep is not None:
             cmd += 'finestep %.15e '%finestep
+        if continuouscontact:
+            cmd += 'continuouscontact 1 '
         if vintersectplane is not None:
             cmd += 'vintersectplane %.15e %.15e %.15e %.15e '%(vintersectplane[0], vintersectplane[1], vintersectplane[2], vintersectplane[3])
         if chuckingdirection is not None:
@@ -111,8 +115,12 @@ class Grasper:
         contacts = reshape(array([float64(s) for s in resvalues],float64),(len(resvalues)/6,6))
         return contacts,finalconfig,mindist,volume
 
-    def GraspThreaded(self,approachrays,standoffs,preshapes,rolls,manipulatordirections=None,target=None,transformrobot=True,onlycontacttarget=True,tightgrasp=False,graspingnoise=None,forceclosurethreshold=None,collisionchecker=None,translationstepmult=None,numthreads=None,startindex=None,maxgrasps=None,finestep=None):
+    def GraspThreaded(self,approachrays,standoffs,preshapes,rolls,manipulatordirections=None,target=None,transformrobot=True,onlycontacttarget=True,tightgrasp=False,graspingnoise=None,forceclosurethreshold=None,collisionchecker=None,translationstepmult=None,numthreads=None,startindex=None,maxgrasps=None,finestep=None,streamresults=False,endindex=None,continuouscontact=False):
         """See :ref:`module-grasper-graspthreaded`
+
+        :param endindex: if set, only the grasp indices in [startindex,endindex) are tested
+        :param streamresults: if True, returns the number of grasps to test immediately and the results are retrieved with :meth:`GetGraspThreadedResults` as they are found.
+        :param continuouscontact: if True, the fingers jump to their contacts using distance queries and bisection instead of fixed steps
         """
         cmd = 'GraspThreaded '
         if target is not None:
@@ -122,6 +130,8 @@ class Grasper:
             cmd += 'friction %.15e '%self.friction
         if startindex is not None:
             cmd += 'startindex %d '%startindex
+        if endindex is not None:
+            cmd += 'endindex %d '%endindex
         if maxgrasps is not None:
             cmd += 'maxgrasps %d '%maxgrasps
         for link in self.avoidlinks:
@@ -132,8 +142,12 @@ class Grasper:
             cmd += 'translationstepmult %.15e '%translationstepmult
         if finestep is not None:
             cmd += 'finestep %.15e '%finestep
+        if continuouscontact:
+            cmd += 'continuouscontact 1 '
         if numthreads is not None:
             cmd += 'numthreads %d '%numthreads
+        if streamresults:
+            cmd += 'streamresults 1 '
         cmd += 'approachrays %d '%len(approachrays)
         for f in approachrays.flat:
             cmd += str(f) + ' '
@@ -153,8 +167,26 @@ class Grasper:
         if res is None:
             raise PlanningError('Grasp failed')
         resultgrasps = res.split()
-        resvalues=[]
+        if streamresults:
+            return int(resultgrasps.pop(0))
+        nextid = int(resultgrasps.pop(0))
+        return nextid, self._ParseGraspResults(resultgrasps)
+
+    def GetGraspThreadedResults(self):
+        """Returns the grasps found by a GraspThreaded call with streamresults since the last call.
+
+        :return: finished, nextid, resvalues where finished is True when all the grasps have been evaluated
+        """
+        res = self.prob.SendCommand('GetGraspThreadedResults')
+        if res is None:
+            raise PlanningError('GetGraspThreadedResults failed')
+        resultgrasps = res.split()
+        finished = int(resultgrasps.pop(0)) != 0
         nextid = int(resultgrasps.pop(0))
+        return finished, nextid, self._ParseGraspResults(resultgrasps)
+
+    def _ParseGraspResults(self,resultgrasps):
+        resvalues=[]
         preshapelen = len(self.robot.GetActiveManipulator().GetGripperIndices())
         for i in range(int(resultgrasps.pop(0))):
             position = array([float64(resultgrasps.pop(0)) for i in range(3)])
@@ -171,7 +203,7 @@ class Grasper:
             contacts=[float64(resultgrasps.pop(0)) for i in range(contacts_num*6)]
             contacts = reshape(contacts,(contacts_num,6))
             resvalues.append([position, direction, roll, standoff, manipulatordirection, mindist, volume, preshape,Tfinal,finalshape,contacts])
-        return nextid, resvalues
+        return resvalues
 
     def ConvexHull(self,points,returnplanes=True,returnfaces=True,returntriangles=True):
         """See :ref:`module-grasper-convexhull`
@@ -204,3 +236,30 @@ class Grasper:
             numtriangles = int(resvalues.pop(0))
             triangles = reshape(array([int(resvalues.pop(0)) for i in range(3*numtriangles)],int),(numtriangles,3))
         return planes,faces,triangles
+
+    def GenerateCollisionGeometryGroup(self,groupname='simplified',bodies=None,resolution=None,padding=None,minvertices=None,usecache=None):
+        """Stores conservative convex hulls of the trimeshes of the bodies in the geometry group groupname, collision checkers can use it with SetGeometryGroup/SetBodyGeometryGroup. See :ref:`module-grasper-generatecollisiongeometrygroup`
+
+        :param bodies: the bodies to process, if None processes all the bodies in the environment
+        :param resolution: the number of grid cells along the longest side of a mesh that its vertices are snapped outwards to
+        :param padding: the distance in meters the hulls are pushed out by
+        :param minvertices: trimeshes with fewer vertices are kept as they are
+        :param usecache: if False, recomputes hulls that are already cached
+        :return: (number of trimeshes, number of simplified trimeshes, number of hulls read from the cache)
+        """
+        cmd = 'GenerateCollisionGeometryGroup name %s '%groupname
+        if bodies is not None:
+            for body in bodies:
+                cmd += 'body %s '%body.GetName()
+        if resolution is not None:
+            cmd += 'resolution %d '%resolution
+        if padding is not None:
+            cmd += 'padding %.15e '%padding
+        if minvertices is not None:
+            cmd += 'minvertices %d '%minvertices
+        if usecache is not None:
+            cmd += 'usecache %d '%usecache
+        res = self.prob.SendCommand(cmd)
+        if res is None:
+            raise PlanningError('GenerateCollisionGeometryGroup')
+        return tuple(int(s) for s in res.split())
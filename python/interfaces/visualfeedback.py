@@ -79,7 +79,7 @@ class VisualFeedback:
         if res is None:
             raise PlanningError()
         return res
-    def ProcessVisibilityExtents(self,localtargetcenter=None,numrolls=None,transforms=None,extents=None,sphere=None,invertsphere=None,conedirangles=None):
+    def ProcessVisibilityExtents(self,localtargetcenter=None,numrolls=None,transforms=None,extents=None,sphere=None,invertsphere=None,conedirangles=None,numthreads=None,checkpoint=None):
         """See :ref:`module-visualfeedback-processvisibilityextents`
         """
         cmd = 'ProcessVisibilityExtents '
@@ -106,6 +106,10 @@ class VisualFeedback:
         if conedirangles is not None:
             for conedirangle in conedirangles:
                 cmd += 'conedirangle %.15e %.15e %.15e '%(conedirangle[0],conedirangle[1],conedirangle[2])
+        if numthreads is not None:
+            cmd += 'numthreads %d '%numthreads
+        if checkpoint is not None:
+            cmd += 'checkpoint %s '%checkpoint
         res = self.prob.SendCommand(cmd)
         if res is None:
             raise PlanningError()
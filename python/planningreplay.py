@@ -0,0 +1,237 @@
+# -*- coding: utf-8 -*-
+# Copyright (C) 2009-2011 Rosen Diankov <rosen.diankov@gmail.com>
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+"""Records planning requests and replays them to benchmark the planning pipeline on realistic workloads.
+
+A request is a directory holding the environment saved as collada (env.dae) and request.json with the planner name, the robot and its active dofs, the collision checker, the random seed, and the xml of the planner parameters from PlannerParameters.Serialize. Record right after a successful InitPlan:
+
+.. code-block:: python
+
+  planner.InitPlan(robot,params)
+  planningreplay.RecordPlanningRequest(planner,robot,'requests')
+
+Replay every request under a directory against the current build with:
+
+.. code-block:: bash
+
+  openrave.py --replayplanning requests --repeat=5 --output=timings.json
+
+Each replay times the stages separately: **planning** runs the planner with its post-processing disabled, **smoothing** runs the post-processing planner that was recorded, **retiming** retimes the result, and **verification** checks it with planningutils.VerifyTrajectory. The report has the per-stage timings, the success rate, and the trajectory durations.
+"""
+from __future__ import with_statement # for python 2.5
+from . import openravepy_int, openravepy_ext
+from .misc import mkdir_recursive
+import os, time, json
+from optparse import OptionParser
+
+def RecordPlanningRequest(planner,robot,directory,name=None,seed=None):
+    """Saves the request the planner was initialized with into a new sub-directory of directory and returns its path.
+
+    :param planner: planner after a successful InitPlan, its parameters are serialized
+    :param seed: if not None, overrides the random generator seed of the parameters
+    """
+    env = planner.GetEnv()
+    params = planner.GetParameters()
+    if params is None:
+        raise ValueError('planner %s was not initialized'%planner.GetXMLId())
+    if name is None:
+        name = 'request%d'%int(time.time()*1000)
+    requestdir = os.path.join(directory,name)
+    mkdir_recursive(requestdir)
+    with env:
+        env.Save(os.path.join(requestdir,'env.dae'))
+        checker = env.GetCollisionChecker()
+        request = {'name':name,
+                   'planner':planner.GetXMLId(),
+                   'robot':robot.GetName(),
+                   'activedofs':[int(index) for index in robot.GetActiveDOFIndices()],
+                   'affinedofs':int(robot.GetAffineDOF()),
+                   'rotationaxis':[float(x) for x in robot.GetAffineRotationAxis()],
+                   'collisionchecker':checker.GetXMLId() if checker is not None else '',
+                   'seed':seed,
+                   'parameters':params.Serialize()}
+    with open(os.path.join(requestdir,'request.json'),'w') as f:
+        json.dump(request,f,indent=1)
+    return requestdir
+
+def LoadPlanningRequests(directory):
+    """Returns the (requestdir,request) pairs of all the requests under directory sorted by path. directory can also be a single request.
+    """
+    requests = []
+    for root,dirs,files in os.walk(directory):
+        if 'request.json' in files:
+            with open(os.path.join(root,'request.json'),'r') as f:
+                requests.append((root,json.load(f)))
+    requests.sort(key=lambda x: x[0])
+    return requests
+
+def _OverrideParameters(xmlparameters,overrides):
+    """appends the xml overrides before the closing tag, the parameters reader keeps the last value of a tag
+    """
+    index = xmlparameters.rfind('</')
+    if index < 0:
+        raise ValueError('planner parameters are not xml')
+    return xmlparameters[:index] + overrides + xmlparameters[index:]
+
+def _GetPostProcessing(xmlparameters):
+    """returns the (plannername,plannerparameters) of the _postprocessing tag
+    """
+    start = xmlparameters.find('<_postprocessing')
+    if start < 0:
+        return '',''
+    end = xmlparameters.find('>',start)
+    tag = xmlparameters[start:end]
+    plannername = ''
+    nameindex = tag.find('planner="')
+    if nameindex >= 0:
+        plannername = tag[nameindex+9:tag.find('"',nameindex+9)]
+    if tag.endswith('/'):
+        return plannername,''
+    # the parameters of the post-processing planner can have their own nested _postprocessing
+    closeindex = xmlparameters.rfind('</_postprocessing>')
+    return plannername,xmlparameters[end+1:closeindex]
+
+def ReplayPlanningRequest(env,requestdir,request,seed=None,retimername='',verifystep=0.002):
+    """Loads the request into env and runs it once, returns a dict with the success, the failed stage, the seconds of each stage, and the trajectory duration.
+
+    :param seed: if not None, overrides the recorded seed
+    :param retimername: planner used to retime the trajectory, the default retimer if empty
+    """
+    result = {'name':request['name'],'success':False,'failedstage':None,'stages':{},'duration':None}
+    env.Reset()
+    if not env.Load(os.path.join(requestdir,'env.dae')):
+        result['failedstage'] = 'load'
+        return result
+    with env:
+        robot = env.GetRobot(request['robot'])
+        if robot is None:
+            result['failedstage'] = 'load'
+            return result
+        if len(request.get('collisionchecker','')) > 0:
+            checker = openravepy_int.RaveCreateCollisionChecker(env,request['collisionchecker'])
+            if checker is not None:
+                env.SetCollisionChecker(checker)
+        robot.SetActiveDOFs(request['activedofs'],request['affinedofs'],request['rotationaxis'])
+        xmlparameters = request['parameters']
+        postplannername,postparameters = _GetPostProcessing(xmlparameters)
+        overrides = '<_postprocessing planner=""></_postprocessing>'
+        if seed is None:
+            seed = request.get('seed',None)
+        if seed is not None:
+            overrides += '<_nrandomgeneratorseed>%d</_nrandomgeneratorseed>'%seed
+        planner = openravepy_int.RaveCreatePlanner(env,request['planner'])
+        if planner is None:
+            result['failedstage'] = 'load'
+            return result
+        traj = openravepy_int.RaveCreateTrajectory(env,'')
+
+        starttime = time.time()
+        status = openravepy_int.PlannerStatus.Failed
+        if planner.InitPlan(robot,_OverrideParameters(xmlparameters,overrides)):
+            status = planner.PlanPath(traj)
+        result['stages']['planning'] = time.time()-starttime
+        if status != openravepy_int.PlannerStatus.HasSolution:
+            result['failedstage'] = 'planning'
+            return result
+
+        if len(postplannername) > 0:
+            starttime = time.time()
+            status = openravepy_int.planningutils.SmoothActiveDOFTrajectory(traj,robot,plannername=postplannername,plannerparameters=postparameters)
+            result['stages']['smoothing'] = time.time()-starttime
+            if status != openravepy_int.PlannerStatus.HasSolution:
+                result['failedstage'] = 'smoothing'
+                return result
+
+        starttime = time.time()
+        status = openravepy_int.planningutils.RetimeActiveDOFTrajectory(traj,robot,hastimestamps=traj.GetDuration()>0,plannername=retimername)
+        result['stages']['retiming'] = time.time()-starttime
+        if status != openravepy_int.PlannerStatus.HasSolution:
+            result['failedstage'] = 'retiming'
+            return result
+
+        starttime = time.time()
+        try:
+            openravepy_int.planningutils.VerifyTrajectory(planner.GetParameters(),traj,samplingstep=verifystep)
+        except openravepy_ext.openrave_exception:
+            result['stages']['verification'] = time.time()-starttime
+            result['failedstage'] = 'verification'
+            return result
+        result['stages']['verification'] = time.time()-starttime
+        result['duration'] = traj.GetDuration()
+        result['success'] = True
+    return result
+
+def SummarizeReplays(results):
+    """Returns the success rate, the mean/min/max seconds of every stage, and the mean/min/max trajectory duration of the results of ReplayPlanningRequest.
+    """
+    def _stats(values):
+        if len(values) == 0:
+            return None
+        return {'count':len(values),'mean':sum(values)/len(values),'min':min(values),'max':max(values)}
+    summary = {'replays':len(results),
+               'successrate':float(sum(1 for result in results if result['success']))/len(results) if len(results) > 0 else 0.0,
+               'failures':{},
+               'stages':{}}
+    for result in results:
+        if result['failedstage'] is not None:
+            summary['failures'][result['failedstage']] = summary['failures'].get(result['failedstage'],0)+1
+    for stage in ['planning','smoothing','retiming','verification']:
+        stagestats = _stats([result['stages'][stage] for result in results if stage in result['stages']])
+        if stagestats is not None:
+            summary['stages'][stage] = stagestats
+    summary['duration'] = _stats([result['duration'] for result in results if result['success']])
+    return summary
+
+def run(args=None):
+    """Command-line execution, called by openrave.py --replayplanning.
+    """
+    parser = OptionParser(description='Replays recorded planning requests and reports the per-stage timings, success rate, and trajectory durations.',
+                          usage='openrave.py --replayplanning [options] requestdirectory...')
+    parser.add_option('--repeat',action='store',type='int',dest='repeat',default=1,
+                      help='Number of times every request is replayed (default=%default)')
+    parser.add_option('--seed',action='store',type='int',dest='seed',default=None,
+                      help='Overrides the recorded random seed of the planners, every repetition adds its index to it')
+    parser.add_option('--retimer',action='store',type='string',dest='retimer',default='',
+                      help='Planner used to retime the trajectories, the default retimer if empty')
+    parser.add_option('--verifystep',action='store',type='float',dest='verifystep',default=0.002,
+                      help='Sampling step in seconds of the trajectory verification (default=%default)')
+    parser.add_option('--output',action='store',type='string',dest='output',default=None,
+                      help='Writes the summary and every replay as JSON to a file')
+    (options, leftargs) = parser.parse_args(args=args)
+    requests = []
+    for directory in leftargs:
+        requests += LoadPlanningRequests(directory)
+    if len(requests) == 0:
+        parser.error('no planning requests found')
+
+    openravepy_int.RaveInitialize(True)
+    env = openravepy_int.Environment()
+    try:
+        results = []
+        for requestdir,request in requests:
+            for irepeat in range(options.repeat):
+                seed = options.seed+irepeat if options.seed is not None else None
+                result = ReplayPlanningRequest(env,requestdir,request,seed=seed,retimername=options.retimer,verifystep=options.verifystep)
+                print '%s: success=%d failedstage=%s duration=%s %s'%(request['name'],result['success'],result['failedstage'],result['duration'],' '.join('%s=%.4fs'%(stage,t) for stage,t in result['stages'].iteritems()))
+                results.append(result)
+        summary = SummarizeReplays(results)
+        print 'success rate: %.3f (%d replays)'%(summary['successrate'],summary['replays'])
+        for stage,stagestats in summary['stages'].iteritems():
+            print '%s: mean=%.4fs min=%.4fs max=%.4fs'%(stage,stagestats['mean'],stagestats['min'],stagestats['max'])
+        if summary['duration'] is not None:
+            print 'trajectory duration: mean=%.4fs min=%.4fs max=%.4fs'%(summary['duration']['mean'],summary['duration']['min'],summary['duration']['max'])
+        if options.output is not None:
+            with open(options.output,'w') as f:
+                json.dump({'version':openravepy_int.__version__,'summary':summary,'replays':results},f,indent=1)
+    finally:
+        env.Destroy()
@@ -0,0 +1,428 @@
+/** \example openrave_benchmarks.cpp
+
+    Measures the hot paths of the core on a reference scene and writes the timings as JSON so that they can be compared
+    between releases: forward kinematics, jacobians, self and environment collision for every collision checker,
+    inverse kinematics for every requested solver, BiRRT planning, parabolic smoothing, and trajectory sampling.
+
+    Usage:
+    \verbatim
+    openrave_benchmarks [--scene filename] [--checker name]* [--iksolver name]* [--duration seconds] [--filter substring] [--seed seed] [--output filename]
+    \endverbatim
+
+    - \b --scene - scene to load, the first robot is used with its active manipulator (default data/lab1.env.xml)
+    - \b --checker - collision checker to benchmark, can be repeated (default fcl_, ode, pqp). Checkers that cannot be created are skipped.
+    - \b --iksolver - ik solver to benchmark, can be repeated. \b ikfast generates or loads the Transform6D ikfast solver of the manipulator, other names are created with RaveCreateIkSolver. By default no ik is benchmarked since generating an ikfast solver can take minutes.
+    - \b --duration - minimum time each benchmark runs for (default 1)
+    - \b --filter - only run the benchmarks whose name contains the substring
+    - \b --seed - seed of the random configurations (default 0)
+    - \b --output - write the JSON to a file instead of the standard output
+
+    Every benchmark reports the number of iterations and the total, mean, min, p50, p90, and max time of an iteration in seconds.
+    When an iteration processes several items (e.g. trajectory samples), \b itemspersecond is the throughput.
+
+    Example:
+    \verbatim
+    openrave_benchmarks --checker fcl_ --iksolver ikfast --output benchmarks.json
+    \endverbatim
+
+    <b>Full Example Code:</b>
+ */
+#include <openrave-core.h>
+#include <openrave/utils.h>
+#include <openrave/planningutils.h>
+#include <vector>
+#include <cstring>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+
+using namespace OpenRAVE;
+using namespace std;
+
+namespace cppexamples {
+
+/// \brief timings of the iterations of one benchmark
+struct BenchmarkResult
+{
+    string name; ///< what is measured
+    string variant; ///< the collision checker, ik solver, or planner used
+    vector<uint64_t> vtimes; ///< nanoseconds of each iteration
+    size_t numitems; ///< number of items processed by an iteration
+};
+
+class BenchmarkSuite
+{
+public:
+    BenchmarkSuite(EnvironmentBasePtr penv, RobotBasePtr probot, dReal fduration, const string& filter) : _penv(penv), _probot(probot), _fduration(fduration), _filter(filter), _iconfig(0) {
+        _pmanip = probot->GetActiveManipulator();
+        probot->SetActiveDOFs(_pmanip->GetArmIndices());
+    }
+
+    /// \brief samples the random configurations the benchmarks cycle through, half of them are collision-free for planning and ik
+    void SampleConfigurations(size_t numconfigs)
+    {
+        vector<dReal> vlower, vupper, vconfig(_probot->GetActiveDOF());
+        _probot->GetActiveDOFLimits(vlower, vupper);
+        RobotBase::RobotStateSaver saver(_probot);
+        _vconfigs.resize(0);
+        _vfreeconfigs.resize(0);
+        size_t numtries = 0;
+        while( _vconfigs.size() < numconfigs && numtries++ < 100*numconfigs ) {
+            for(size_t i = 0; i < vconfig.size(); ++i) {
+                vconfig[i] = vlower[i] + (vupper[i]-vlower[i])*RaveRandomDouble();
+            }
+            _probot->SetActiveDOFValues(vconfig);
+            bool bfree = !_penv->CheckCollision(_probot) && !_probot->CheckSelfCollision();
+            if( bfree ) {
+                _vfreeconfigs.push_back(vconfig);
+                _vconfigs.push_back(vconfig);
+            }
+            else if( _vconfigs.size() < numconfigs/2 + _vfreeconfigs.size() ) {
+                _vconfigs.push_back(vconfig);
+            }
+        }
+        if( _vconfigs.size() == 0 ) {
+            throw OPENRAVE_EXCEPTION_FORMAT0("failed to sample configurations", ORE_Failed);
+        }
+    }
+
+    /// \brief calls fn until the duration elapsed, at least 10 times
+    void Run(const string& name, const string& variant, const boost::function<void()>& fn, size_t numitems=1)
+    {
+        if( _filter.size() > 0 && name.find(_filter) == string::npos ) {
+            return;
+        }
+        RAVELOG_INFO_FORMAT("benchmarking %s %s", name%variant);
+        BenchmarkResult result;
+        result.name = name;
+        result.variant = variant;
+        result.numitems = numitems;
+        uint64_t starttime = utils::GetNanoPerformanceTime();
+        uint64_t endtime = starttime + (uint64_t)(_fduration*1e9);
+        uint64_t curtime = starttime;
+        while( result.vtimes.size() < 10 || curtime < endtime ) {
+            fn();
+            uint64_t newtime = utils::GetNanoPerformanceTime();
+            result.vtimes.push_back(newtime - curtime);
+            curtime = newtime;
+        }
+        _vresults.push_back(result);
+    }
+
+    void RunKinematics()
+    {
+        Run("SetActiveDOFValues", "", boost::bind(&BenchmarkSuite::_SetNextConfiguration, this));
+        Run("CalculateJacobian", "", boost::bind(&BenchmarkSuite::_CalculateJacobian, this));
+        Run("CalculateJacobians", "", boost::bind(&BenchmarkSuite::_CalculateJacobians, this));
+    }
+
+    void RunCollision(const string& checkername)
+    {
+        Run("CheckSelfCollision", checkername, boost::bind(&BenchmarkSuite::_CheckSelfCollision, this));
+        Run("CheckCollision", checkername, boost::bind(&BenchmarkSuite::_CheckEnvCollision, this));
+    }
+
+    void RunInverseKinematics(const string& solvername)
+    {
+        if( !_pmanip->GetIkSolver() ) {
+            return;
+        }
+        // reachable poses from the collision-free configurations
+        _vikparams.resize(0);
+        {
+            RobotBase::RobotStateSaver saver(_probot);
+            for(size_t i = 0; i < _vfreeconfigs.size(); ++i) {
+                _probot->SetActiveDOFValues(_vfreeconfigs[i]);
+                _vikparams.push_back(_pmanip->GetIkParameterization(_pmanip->GetIkSolver()->Supports(IKP_Transform6D) ? IKP_Transform6D : IKP_Translation3D));
+            }
+        }
+        if( _vikparams.size() == 0 ) {
+            return;
+        }
+        Run("FindIKSolution", solvername, boost::bind(&BenchmarkSuite::_FindIKSolution, this, 0));
+        Run("FindIKSolution(CheckEnvCollisions)", solvername, boost::bind(&BenchmarkSuite::_FindIKSolution, this, (int)IKFO_CheckEnvCollisions));
+    }
+
+    /// \brief plans between collision-free configurations with BiRRT, then smooths and samples the last trajectory
+    void RunPlanning(const string& checkername)
+    {
+        if( _vfreeconfigs.size() < 2 ) {
+            RAVELOG_WARN("not enough collision-free configurations for planning\n");
+            return;
+        }
+        _pplanner = RaveCreatePlanner(_penv, "birrt");
+        if( !_pplanner ) {
+            return;
+        }
+        _ptraj = RaveCreateTrajectory(_penv, "");
+        Run("BiRRT", checkername, boost::bind(&BenchmarkSuite::_PlanBiRRT, this));
+        if( _ptraj->GetNumWaypoints() == 0 ) {
+            return;
+        }
+        _ptrajoriginal = RaveCreateTrajectory(_penv, "");
+        _ptrajoriginal->Clone(_ptraj, 0);
+        Run("SmoothActiveDOFTrajectory", "parabolicsmoother", boost::bind(&BenchmarkSuite::_SmoothTrajectory, this));
+        if( _ptraj->GetDuration() <= 0 ) {
+            return;
+        }
+        const size_t numsamples = 1000;
+        _vsampletimes.resize(numsamples);
+        for(size_t i = 0; i < numsamples; ++i) {
+            _vsampletimes[i] = _ptraj->GetDuration()*i/(numsamples-1);
+        }
+        Run("TrajectorySample", "", boost::bind(&BenchmarkSuite::_SampleTrajectory, this), numsamples);
+        Run("TrajectorySamplePoints", "", boost::bind(&BenchmarkSuite::_SampleTrajectoryPoints, this), numsamples);
+    }
+
+    void WriteJSON(ostream& sout, const string& scenefilename) const
+    {
+        sout << setprecision(9);
+        sout << "{\"version\": \"" << OPENRAVE_VERSION_STRING << "\", \"scene\": \"" << scenefilename << "\", \"robot\": \"" << _probot->GetName() << "\", \"manipulator\": \"" << _pmanip->GetName() << "\", \"benchmarks\": [";
+        for(size_t iresult = 0; iresult < _vresults.size(); ++iresult) {
+            const BenchmarkResult& result = _vresults[iresult];
+            vector<uint64_t> vsorted = result.vtimes;
+            sort(vsorted.begin(), vsorted.end());
+            uint64_t total = 0;
+            for(size_t i = 0; i < vsorted.size(); ++i) {
+                total += vsorted[i];
+            }
+            if( iresult > 0 ) {
+                sout << ",";
+            }
+            sout << endl << "  {\"name\": \"" << result.name << "\", \"variant\": \"" << result.variant << "\", \"iterations\": " << vsorted.size();
+            sout << ", \"total\": " << 1e-9*total << ", \"mean\": " << 1e-9*total/vsorted.size();
+            sout << ", \"min\": " << 1e-9*vsorted.front() << ", \"p50\": " << 1e-9*vsorted[vsorted.size()/2] << ", \"p90\": " << 1e-9*vsorted[(vsorted.size()*9)/10] << ", \"max\": " << 1e-9*vsorted.back();
+            if( result.numitems > 1 ) {
+                sout << ", \"itemspersecond\": " << (total > 0 ? 1e9*result.numitems*vsorted.size()/total : 0);
+            }
+            sout << "}";
+        }
+        sout << endl << "]}" << endl;
+    }
+
+protected:
+    const vector<dReal>& _GetNextConfiguration() {
+        _iconfig = (_iconfig+1) % _vconfigs.size();
+        return _vconfigs[_iconfig];
+    }
+
+    void _SetNextConfiguration() {
+        _probot->SetActiveDOFValues(_GetNextConfiguration(), KinBody::CLA_Nothing);
+    }
+
+    void _CalculateJacobian() {
+        _SetNextConfiguration();
+        _pmanip->CalculateJacobian(_vjacobian);
+        _pmanip->CalculateAngularVelocityJacobian(_vangularjacobian);
+    }
+
+    void _CalculateJacobians() {
+        _SetNextConfiguration();
+        _pmanip->CalculateJacobians(_vjacobian);
+    }
+
+    void _CheckSelfCollision() {
+        _SetNextConfiguration();
+        _probot->CheckSelfCollision();
+    }
+
+    void _CheckEnvCollision() {
+        _SetNextConfiguration();
+        _penv->CheckCollision(_probot);
+    }
+
+    void _FindIKSolution(int filteroptions) {
+        _iconfig = (_iconfig+1) % _vikparams.size();
+        _pmanip->FindIKSolution(_vikparams[_iconfig], _vsolution, filteroptions);
+    }
+
+    void _PlanBiRRT() {
+        _iconfig = (_iconfig+1) % _vfreeconfigs.size();
+        PlannerBase::PlannerParametersPtr params(new PlannerBase::PlannerParameters());
+        params->_nMaxIterations = 4000;
+        params->SetRobotActiveJoints(_probot);
+        params->vinitialconfig = _vfreeconfigs[_iconfig];
+        params->vgoalconfig = _vfreeconfigs[(_iconfig+1) % _vfreeconfigs.size()];
+        RobotBase::RobotStateSaver saver(_probot);
+        _probot->SetActiveDOFValues(params->vinitialconfig);
+        if( _pplanner->InitPlan(_probot, params) ) {
+            _pplanner->PlanPath(_ptraj);
+        }
+    }
+
+    void _SmoothTrajectory() {
+        _ptraj->Clone(_ptrajoriginal, 0);
+        RobotBase::RobotStateSaver saver(_probot);
+        planningutils::SmoothActiveDOFTrajectory(_ptraj, _probot, 1, 1, "parabolicsmoother");
+    }
+
+    void _SampleTrajectory() {
+        for(size_t i = 0; i < _vsampletimes.size(); ++i) {
+            _ptraj->Sample(_vsample, _vsampletimes[i]);
+        }
+    }
+
+    void _SampleTrajectoryPoints() {
+        _ptraj->SamplePoints(_vsample, _vsampletimes);
+    }
+
+    EnvironmentBasePtr _penv;
+    RobotBasePtr _probot;
+    RobotBase::ManipulatorPtr _pmanip;
+    dReal _fduration;
+    string _filter;
+    vector< vector<dReal> > _vconfigs; ///< random configurations of the active dofs
+    vector< vector<dReal> > _vfreeconfigs; ///< collision-free configurations of the active dofs
+    vector<IkParameterization> _vikparams;
+    size_t _iconfig;
+    vector<dReal> _vjacobian, _vangularjacobian, _vsolution, _vsample, _vsampletimes;
+    PlannerBasePtr _pplanner;
+    TrajectoryBasePtr _ptraj, _ptrajoriginal;
+    vector<BenchmarkResult> _vresults;
+};
+
+} // end namespace cppexamples
+
+using namespace cppexamples;
+
+void printhelp()
+{
+    RAVELOG_INFO("openrave_benchmarks [--scene filename] [--checker name]* [--iksolver name]* [--duration seconds] [--filter substring] [--seed seed] [--output filename]\n");
+}
+
+/// \brief sets the ik solver of the active manipulator, returns false if it is not available
+bool SetIkSolver(EnvironmentBasePtr penv, RobotBasePtr probot, const string& solvername)
+{
+    RobotBase::ManipulatorPtr pmanip = probot->GetActiveManipulator();
+    if( solvername == "ikfast" ) {
+        ModuleBasePtr pikfast = RaveCreateModule(penv, "ikfast");
+        if( !pikfast ) {
+            return false;
+        }
+        penv->Add(pikfast, true, "");
+        stringstream ssin, ssout;
+        ssin << "LoadIKFastSolver " << probot->GetName() << " " << (int)IKP_Transform6D;
+        if( !pikfast->SendCommand(ssout, ssin) ) {
+            return false;
+        }
+        return !!pmanip->GetIkSolver();
+    }
+    IkSolverBasePtr psolver = RaveCreateIkSolver(penv, solvername);
+    return !!psolver && pmanip->SetIkSolver(psolver);
+}
+
+int main(int argc, char ** argv)
+{
+    string scenefilename = "data/lab1.env.xml", outputfilename, filter;
+    vector<string> vcheckers, viksolvers;
+    dReal fduration = 1;
+    uint32_t seed = 0;
+
+    for(int i = 1; i < argc; ++i) {
+        if((strcmp(argv[i], "-h") == 0)||(strcmp(argv[i], "-?") == 0)||(strcmp(argv[i], "/?") == 0)||(strcmp(argv[i], "--help") == 0)||(strcmp(argv[i], "-help") == 0)) {
+            printhelp();
+            return 0;
+        }
+        if( i+1 >= argc ) {
+            printhelp();
+            return 1;
+        }
+        if( strcmp(argv[i], "--scene") == 0 ) {
+            scenefilename = argv[++i];
+        }
+        else if( strcmp(argv[i], "--checker") == 0 ) {
+            vcheckers.push_back(argv[++i]);
+        }
+        else if( strcmp(argv[i], "--iksolver") == 0 ) {
+            viksolvers.push_back(argv[++i]);
+        }
+        else if( strcmp(argv[i], "--duration") == 0 ) {
+            fduration = atof(argv[++i]);
+        }
+        else if( strcmp(argv[i], "--filter") == 0 ) {
+            filter = argv[++i];
+        }
+        else if( strcmp(argv[i], "--seed") == 0 ) {
+            seed = atoi(argv[++i]);
+        }
+        else if( strcmp(argv[i], "--output") == 0 ) {
+            outputfilename = argv[++i];
+        }
+        else {
+            RAVELOG_ERROR_FORMAT("unknown option %s", argv[i]);
+            printhelp();
+            return 1;
+        }
+    }
+    if( vcheckers.size() == 0 ) {
+        vcheckers.push_back("fcl_");
+        vcheckers.push_back("ode");
+        vcheckers.push_back("pqp");
+    }
+
+    RaveInitialize(true);
+    RaveInitRandomGeneration(seed);
+    EnvironmentBasePtr penv = RaveCreateEnvironment();
+    int ret = 0;
+    try {
+        if( !penv->Load(scenefilename) ) {
+            RAVELOG_ERROR_FORMAT("failed to load %s", scenefilename);
+            RaveDestroy();
+            return 2;
+        }
+        EnvironmentMutex::scoped_lock lock(penv->GetMutex());
+        vector<RobotBasePtr> vrobots;
+        penv->GetRobots(vrobots);
+        if( vrobots.size() == 0 || !vrobots[0]->GetActiveManipulator() ) {
+            RAVELOG_ERROR_FORMAT("%s does not have a robot with a manipulator", scenefilename);
+            RaveDestroy();
+            return 3;
+        }
+
+        BenchmarkSuite suite(penv, vrobots[0], fduration, filter);
+        suite.SampleConfigurations(200);
+        suite.RunKinematics();
+
+        bool bplanned = false;
+        for(size_t ichecker = 0; ichecker < vcheckers.size(); ++ichecker) {
+            CollisionCheckerBasePtr pchecker = RaveCreateCollisionChecker(penv, vcheckers[ichecker]);
+            if( !pchecker ) {
+                RAVELOG_WARN_FORMAT("collision checker %s is not available, skipping", vcheckers[ichecker]);
+                continue;
+            }
+            penv->SetCollisionChecker(pchecker);
+            suite.RunCollision(vcheckers[ichecker]);
+            if( !bplanned ) {
+                // planning is dominated by collision checking, so only plan with the first checker to bound the running time
+                suite.RunPlanning(vcheckers[ichecker]);
+                bplanned = true;
+            }
+        }
+
+        for(size_t isolver = 0; isolver < viksolvers.size(); ++isolver) {
+            if( !SetIkSolver(penv, vrobots[0], viksolvers[isolver]) ) {
+                RAVELOG_WARN_FORMAT("ik solver %s is not available, skipping", viksolvers[isolver]);
+                continue;
+            }
+            suite.RunInverseKinematics(viksolvers[isolver]);
+        }
+
+        if( outputfilename.size() > 0 ) {
+            ofstream fout(outputfilename.c_str());
+            suite.WriteJSON(fout, scenefilename);
+        }
+        else {
+            suite.WriteJSON(cout, scenefilename);
+        }
+    }
+    catch(const openrave_exception& ex) {
+        RAVELOG_ERROR_FORMAT("benchmarks failed: %s", ex.what());
+        ret = 4;
+    }
+    RaveDestroy();
+    return ret;
+}
@@ -101,6 +101,19 @@ public:
 
 typedef boost::shared_ptr<ColladaXMLReadable> ColladaXMLReadablePtr;
 
+/** \brief how mesh data is stored in a binary sidecar file
+
+    The sidecar starts with the 8 byte magic \ref COLLADA_BINARY_MESH_MAGIC. Each mesh referenced by a <extra type="binary_mesh"> is a block at the given offset holding 3*vertices doubles followed by indices int32 values in native byte order. For BMC_Zlib the block is deflated.
+ */
+enum BinaryMeshCompression
+{
+    BMC_None=0, ///< mesh is written as text in the document
+    BMC_Raw=1, ///< mesh block is stored uncompressed
+    BMC_Zlib=2 ///< mesh block is compressed with zlib
+};
+
+#define COLLADA_BINARY_MESH_MAGIC "ORMESH01"
+
 /** Have to maintain a global DAE pointer that is only destroyed on OpenRAVE destruction. The reasons are:
 
    1. destroying DAE unconditionally calls xmlCleanupParser (libxml2)
@@ -16,8 +16,14 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "colladacommon.h"
 #include <boost/algorithm/string.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #include <openrave/xmlreaders.h>
 
+#ifdef OPENRAVE_HAS_ZLIB
+#include <zlib.h>
+#endif
+
 namespace OpenRAVE
 {
 
@@ -2633,6 +2639,154 @@ public:
     /// \param  domgeom    Geometry to extract of the COLLADA's model
     /// \param  mapmaterials    Materials applied to the geometry
     /// \param  listGeometryInfos the geometry infos to output
+    /// \brief if the mesh has an <extra type="binary_mesh">, reads its vertices and indices from the binary sidecar file into one geometry
+    ///
+    /// \return true if the binary mesh was read
+    bool _ExtractBinaryMesh(const domMeshRef meshRef, const map<string,domMaterialRef>& mapmaterials, const Transform& tlocalgeom, bool bgeomvisible, std::list<KinBody::GeometryInfo>& listGeometryInfos)
+    {
+        for(size_t ie = 0; ie < meshRef->getExtra_array().getCount(); ++ie) {
+            domExtraRef pextra = meshRef->getExtra_array()[ie];
+            if( !pextra->getType() || string(pextra->getType()) != "binary_mesh" ) {
+                continue;
+            }
+            daeElementRef ptec = _ExtractOpenRAVEProfile(pextra);
+            if( !ptec ) {
+                continue;
+            }
+            daeElementRef pdata = ptec->getChild("data");
+            if( !pdata ) {
+                RAVELOG_WARN("binary_mesh does not have a data element\n");
+                continue;
+            }
+
+            std::string file = pdata->getAttribute("file"), compression = pdata->getAttribute("compression");
+            size_t offset = 0, blocksize = 0, numvertices = 0, numindices = 0;
+            try {
+                offset = boost::lexical_cast<size_t>(pdata->getAttribute("offset"));
+                blocksize = boost::lexical_cast<size_t>(pdata->getAttribute("size"));
+                numvertices = boost::lexical_cast<size_t>(pdata->getAttribute("vertices"));
+                numindices = boost::lexical_cast<size_t>(pdata->getAttribute("indices"));
+            }
+            catch(const boost::bad_lexical_cast&) {
+                RAVELOG_WARN_FORMAT("binary_mesh in %s has invalid data attributes", file);
+                return false;
+            }
+
+            boost::shared_ptr<boost::interprocess::mapped_region> pregion = _GetBinaryMeshRegion(meshRef, file);
+            if( !pregion ) {
+                RAVELOG_WARN_FORMAT("failed to open binary mesh file %s", file);
+                return false;
+            }
+            const char* pfiledata = static_cast<const char*>(pregion->get_address());
+            size_t magiclength = strlen(COLLADA_BINARY_MESH_MAGIC);
+            if( pregion->get_size() < magiclength || strncmp(pfiledata, COLLADA_BINARY_MESH_MAGIC, magiclength) != 0 || offset < magiclength || offset + blocksize > pregion->get_size() ) {
+                RAVELOG_WARN_FORMAT("binary mesh file %s is invalid or does not hold offset %d size %d", file%offset%blocksize);
+                return false;
+            }
+
+            size_t expectedsize = sizeof(double)*3*numvertices + sizeof(int32_t)*numindices;
+            const char* pblock = pfiledata + offset;
+            std::vector<char> vinflated;
+            if( compression == "zlib" ) {
+#ifdef OPENRAVE_HAS_ZLIB
+                vinflated.resize(expectedsize);
+                uLongf inflatedsize = expectedsize;
+                if( expectedsize == 0 || uncompress(reinterpret_cast<Bytef*>(&vinflated[0]), &inflatedsize, reinterpret_cast<const Bytef*>(pblock), blocksize) != Z_OK || inflatedsize != expectedsize ) {
+                    RAVELOG_WARN_FORMAT("failed to decompress binary mesh at offset %d of %s", offset%file);
+                    return false;
+                }
+                pblock = &vinflated[0];
+#else
+                RAVELOG_WARN_FORMAT("binary mesh in %s is compressed with zlib, but openrave was not compiled with zlib", file);
+                return false;
+#endif
+            }
+            else if( blocksize != expectedsize ) {
+                RAVELOG_WARN_FORMAT("binary mesh at offset %d of %s has size %d, expected %d", offset%file%blocksize%expectedsize);
+                return false;
+            }
+
+            listGeometryInfos.push_back(KinBody::GeometryInfo());
+            KinBody::GeometryInfo& geom = listGeometryInfos.back();
+            geom._type = GT_TriMesh;
+            if( meshRef->getTriangles_array().getCount() > 0 && !!meshRef->getTriangles_array()[0]->getMaterial() ) {
+                map<string,domMaterialRef>::const_iterator itmat = mapmaterials.find(meshRef->getTriangles_array()[0]->getMaterial());
+                if( itmat != mapmaterials.end() ) {
+                    FillGeometryColor(itmat->second,geom);
+                }
+            }
+
+            // the block is not necessarily aligned, so copy the values out
+            Transform tlocalgeominv = tlocalgeom.inverse();
+            dReal fUnitScale = _GetUnitScale(meshRef,_fGlobalScale);
+            TriMesh& trimesh = geom._meshcollision;
+            trimesh.vertices.resize(numvertices);
+            double vertex[3];
+            for(size_t ind = 0; ind < numvertices; ++ind) {
+                memcpy(vertex, pblock + sizeof(vertex)*ind, sizeof(vertex));
+                trimesh.vertices[ind] = tlocalgeominv*Vector(vertex[0]*fUnitScale, vertex[1]*fUnitScale, vertex[2]*fUnitScale);
+            }
+            const char* pindices = pblock + sizeof(double)*3*numvertices;
+            trimesh.indices.resize(numindices);
+            for(size_t ind = 0; ind < numindices; ++ind) {
+                int32_t index;
+                memcpy(&index, pindices + sizeof(int32_t)*ind, sizeof(int32_t));
+                if( index < 0 || size_t(index) >= numvertices ) {
+                    RAVELOG_WARN_FORMAT("binary mesh at offset %d of %s has out of range index %d", offset%file%index);
+                    listGeometryInfos.pop_back();
+                    return false;
+                }
+                trimesh.indices[ind] = index;
+            }
+            geom._t = tlocalgeom;
+            geom._bVisible = bgeomvisible;
+            return true;
+        }
+        return false;
+    }
+
+    /// \brief maps the binary mesh file referenced from pelt's document, caching the region so every mesh in the file shares one mapping
+    boost::shared_ptr<boost::interprocess::mapped_region> _GetBinaryMeshRegion(daeElementRef pelt, const std::string& file)
+    {
+        if( file.size() == 0 ) {
+            return boost::shared_ptr<boost::interprocess::mapped_region>();
+        }
+        // look next to the document first, and next to the opened file for documents extracted from a zae
+        std::vector<std::string> vcandidates;
+        if( file.at(0) == '/' ) {
+            vcandidates.push_back(file);
+        }
+        else {
+            std::vector<std::string> vnativepaths;
+            daeDocument* doc = pelt->getDocument();
+            if( !!doc && !!doc->getDocumentURI() ) {
+                vnativepaths.push_back(cdom::uriToNativePath(doc->getDocumentURI()->str()));
+            }
+            vnativepaths.push_back(_filename);
+            FOREACH(itpath, vnativepaths) {
+                size_t sepindex = itpath->find_last_of("/\\");
+                vcandidates.push_back(sepindex != std::string::npos ? itpath->substr(0, sepindex+1) + file : file);
+            }
+        }
+
+        FOREACH(itcandidate, vcandidates) {
+            std::map<std::string, boost::shared_ptr<boost::interprocess::mapped_region> >::iterator itregion = _mapBinaryMeshRegions.find(*itcandidate);
+            if( itregion != _mapBinaryMeshRegions.end() ) {
+                return itregion->second;
+            }
+            try {
+                boost::interprocess::file_mapping filemapping(itcandidate->c_str(), boost::interprocess::read_only);
+                boost::shared_ptr<boost::interprocess::mapped_region> pregion(new boost::interprocess::mapped_region(filemapping, boost::interprocess::read_only));
+                _mapBinaryMeshRegions[*itcandidate] = pregion;
+                return pregion;
+            }
+            catch(const boost::interprocess::interprocess_exception&) {
+                RAVELOG_VERBOSE_FORMAT("could not map binary mesh file %s", *itcandidate);
+            }
+        }
+        return boost::shared_ptr<boost::interprocess::mapped_region>();
+    }
+
     bool ExtractGeometry(const domGeometryRef domgeom, const map<string,domMaterialRef>& mapmaterials, std::list<KinBody::GeometryInfo>& listGeometryInfos)
     {
         if( !domgeom ) {
@@ -2766,6 +2920,9 @@ public:
         Transform tlocalgeominv = tlocalgeom.inverse();
         if (!!domgeom->getMesh()) {
             const domMeshRef meshRef = domgeom->getMesh();
+            if( _ExtractBinaryMesh(meshRef, mapmaterials, tlocalgeom, bgeomvisible, listGeometryInfos) ) {
+                return true;
+            }
             for (size_t tg = 0; tg<meshRef->getTriangles_array().getCount(); tg++) {
                 listGeometryInfos.push_back(KinBody::GeometryInfo());
                 _ExtractGeometry(meshRef->getTriangles_array()[tg], meshRef->getVertices(), mapmaterials, listGeometryInfos.back(),tlocalgeominv);
@@ -5003,6 +5160,7 @@ private:
     std::set<RobotBase::AttachedSensorPtr> _setInitialSensors;
     std::vector<std::string> _vOpenRAVESchemeAliases;
     std::map<std::string,daeURI> _mapInverseResolvedURIList; ///< holds a list of inverse resolved relationships file:// -> openrave://
+    std::map<std::string, boost::shared_ptr<boost::interprocess::mapped_region> > _mapBinaryMeshRegions; ///< mapped binary mesh sidecar files indexed by their full path
     std::map<domNodeRef, std::pair<domInstance_nodeRef, std::string> > _mapInstantiatedNodes; ///< holds a map of the instantiated (cloned) node and the original instance_node elements. Also contains the idsuffix used to instantiate the node.
 
     bool _bOpeningZAE; ///< true if currently opening a zae
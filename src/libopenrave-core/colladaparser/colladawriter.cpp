@@ -22,6 +22,10 @@ using namespace ColladaDOM150;
 #include <boost/date_time/time_facet.hpp>
 #include <boost/algorithm/string.hpp>
 
+#ifdef OPENRAVE_HAS_ZLIB
+#include <zlib.h>
+#endif
+
 #define LIBXML_SAX1_ENABLED
 #include <libxml/globals.h>
 #include <libxml/xmlerror.h>
@@ -304,6 +308,8 @@ private:
         _bExternalRefAllBodies = false;
         _bForceWriteAll = false;
         _bReuseSimilar = false;
+        _binarymeshcompression = BMC_None;
+        _nBinaryMeshMinVertices = 1000;
         _listExternalRefExports.clear();
         _listIgnoreExternalURIs.clear();
         FOREACHC(itatt,atts) {
@@ -346,6 +352,25 @@ private:
             else if( itatt->first == "reusesimilar" ) {
                 _bReuseSimilar = _stricmp(itatt->second.c_str(), "true") == 0 || itatt->second=="1";
             }
+            else if( itatt->first == "binarymeshes" ) {
+                if( itatt->second == "zlib" ) {
+#ifdef OPENRAVE_HAS_ZLIB
+                    _binarymeshcompression = BMC_Zlib;
+#else
+                    RAVELOG_WARN("binarymeshes=zlib requested, but openrave was not compiled with zlib, so writing raw binary meshes\n");
+                    _binarymeshcompression = BMC_Raw;
+#endif
+                }
+                else if( _stricmp(itatt->second.c_str(), "true") == 0 || itatt->second == "1" || itatt->second == "raw" ) {
+                    _binarymeshcompression = BMC_Raw;
+                }
+                else {
+                    _binarymeshcompression = BMC_None;
+                }
+            }
+            else if( itatt->first == "binarymeshminvertices" ) {
+                _nBinaryMeshMinVertices = boost::lexical_cast<size_t>(itatt->second);
+            }
             else {
                 if( !!_dae->getIOPlugin() ) {
                     // catch all
@@ -444,6 +469,21 @@ private:
 
     virtual void Save(const string& filename)
     {
+        if( _listBinaryMeshDataElements.size() > 0 ) {
+            std::string meshesfilename = filename + ".meshes";
+            std::ofstream fmeshes(meshesfilename.c_str(), std::ios::out|std::ios::binary);
+            fmeshes.write(&_vbinarymeshdata[0], _vbinarymeshdata.size());
+            fmeshes.close();
+            if( !fmeshes ) {
+                throw openrave_exception(str(boost::format(_("failed to save binary meshes to %s"))%meshesfilename));
+            }
+            // reference the sidecar relative to the document
+            size_t sepindex = meshesfilename.find_last_of("/\\");
+            std::string meshesbasename = sepindex != std::string::npos ? meshesfilename.substr(sepindex+1) : meshesfilename;
+            FOREACH(itdata, _listBinaryMeshDataElements) {
+                (*itdata)->setAttribute("file", meshesbasename.c_str());
+            }
+        }
         if(!_dae->writeTo(_doc->getDocumentURI()->getURI(), filename.c_str()) ) {
             throw openrave_exception(str(boost::format(_("failed to save collada file to %s"))%filename));
         }
@@ -1597,10 +1637,68 @@ private:
     /// \brief Write geometry properties
     /// \param geom Link geometry
     /// \param parentid Parent Identifier
+    /// \brief appends the transformed mesh to the binary sidecar data and references it from an <extra type="binary_mesh"> of pdommesh
+    void _WriteBinaryMesh(domMeshRef pdommesh, const TriMesh& mesh, const Transform& t)
+    {
+        if( _vbinarymeshdata.size() == 0 ) {
+            const char* pmagic = COLLADA_BINARY_MESH_MAGIC;
+            _vbinarymeshdata.insert(_vbinarymeshdata.end(), pmagic, pmagic+strlen(pmagic));
+        }
+
+        std::vector<char> vblock(sizeof(double)*3*mesh.vertices.size() + sizeof(int32_t)*mesh.indices.size());
+        double* pvertices = reinterpret_cast<double*>(&vblock[0]);
+        for(size_t ind = 0; ind < mesh.vertices.size(); ++ind) {
+            Vector v = t*mesh.vertices[ind];
+            pvertices[3*ind+0] = v.x;
+            pvertices[3*ind+1] = v.y;
+            pvertices[3*ind+2] = v.z;
+        }
+        int32_t* pindices = reinterpret_cast<int32_t*>(&vblock[0] + sizeof(double)*3*mesh.vertices.size());
+        for(size_t ind = 0; ind < mesh.indices.size(); ++ind) {
+            pindices[ind] = mesh.indices[ind];
+        }
+
+        size_t offset = _vbinarymeshdata.size();
+        size_t blocksize = vblock.size();
+        const char* compression = "none";
+#ifdef OPENRAVE_HAS_ZLIB
+        if( _binarymeshcompression == BMC_Zlib ) {
+            uLongf compressedsize = compressBound(vblock.size());
+            _vbinarymeshdata.resize(offset + compressedsize);
+            if( compress2(reinterpret_cast<Bytef*>(&_vbinarymeshdata[offset]), &compressedsize, reinterpret_cast<const Bytef*>(&vblock[0]), vblock.size(), Z_DEFAULT_COMPRESSION) != Z_OK ) {
+                throw openrave_exception(_("failed to compress binary mesh"));
+            }
+            _vbinarymeshdata.resize(offset + compressedsize);
+            blocksize = compressedsize;
+            compression = "zlib";
+        }
+        else
+#endif
+        {
+            _vbinarymeshdata.insert(_vbinarymeshdata.end(), vblock.begin(), vblock.end());
+        }
+
+        domExtraRef pextra = daeSafeCast<domExtra>(pdommesh->add(COLLADA_ELEMENT_EXTRA));
+        pextra->setType("binary_mesh");
+        domTechniqueRef ptec = daeSafeCast<domTechnique>(pextra->add(COLLADA_ELEMENT_TECHNIQUE));
+        ptec->setProfile("OpenRAVE");
+        daeElementRef pdata = ptec->add("data");
+        pdata->setAttribute("offset", boost::lexical_cast<std::string>(offset).c_str());
+        pdata->setAttribute("size", boost::lexical_cast<std::string>(blocksize).c_str());
+        pdata->setAttribute("compression", compression);
+        pdata->setAttribute("vertices", boost::lexical_cast<std::string>(mesh.vertices.size()).c_str());
+        pdata->setAttribute("indices", boost::lexical_cast<std::string>(mesh.indices.size()).c_str());
+        _listBinaryMeshDataElements.push_back(pdata);
+    }
+
     virtual domGeometryRef WriteGeometry(KinBody::Link::GeometryConstPtr geom, const string& parentid)
     {
         const TriMesh& mesh = geom->GetCollisionMesh();
         Transform t = geom->GetTransform();
+        // large meshes go to the binary sidecar, the text arrays are left empty
+        bool bbinarymesh = _binarymeshcompression != BMC_None && mesh.vertices.size() > 0 && mesh.vertices.size() >= _nBinaryMeshMinVertices;
+        size_t ntextvertices = bbinarymesh ? 0 : mesh.vertices.size();
+        size_t ntextindices = bbinarymesh ? 0 : mesh.indices.size();
 
         string effid = parentid+string("_eff");
         string matid = parentid+string("_mat");
@@ -1624,11 +1722,11 @@ private:
 
                     domFloat_arrayRef parray = daeSafeCast<domFloat_array>(pvertsource->add(COLLADA_ELEMENT_FLOAT_ARRAY));
                     parray->setId((parentid+string("_positions-array")).c_str());
-                    parray->setCount(3*mesh.vertices.size());
+                    parray->setCount(3*ntextvertices);
                     parray->setDigits(std::numeric_limits<OpenRAVE::dReal>::digits10+1);
-                    parray->getValue().setCount(3*mesh.vertices.size());
+                    parray->getValue().setCount(3*ntextvertices);
 
-                    for(size_t ind = 0; ind < mesh.vertices.size(); ++ind) {
+                    for(size_t ind = 0; ind < ntextvertices; ++ind) {
                         Vector v = t*mesh.vertices[ind];
                         parray->getValue()[3*ind+0] = v.x;
                         parray->getValue()[3*ind+1] = v.y;
@@ -1637,7 +1735,7 @@ private:
 
                     domSource::domTechnique_commonRef psourcetec = daeSafeCast<domSource::domTechnique_common>(pvertsource->add(COLLADA_ELEMENT_TECHNIQUE_COMMON));
                     domAccessorRef pacc = daeSafeCast<domAccessor>(psourcetec->add(COLLADA_ELEMENT_ACCESSOR));
-                    pacc->setCount(mesh.vertices.size());
+                    pacc->setCount(ntextvertices);
                     pacc->setSource(daeURI(*pacc, string("#")+parentid+string("_positions-array")));
                     pacc->setStride(3);
 
@@ -1659,7 +1757,7 @@ private:
 
                 domTrianglesRef ptris = daeSafeCast<domTriangles>(pdommesh->add(COLLADA_ELEMENT_TRIANGLES));
                 {
-                    ptris->setCount(mesh.indices.size()/3);
+                    ptris->setCount(ntextindices/3);
                     ptris->setMaterial("mat0");
 
                     domInput_local_offsetRef pvertoffset = daeSafeCast<domInput_local_offset>(ptris->add(COLLADA_ELEMENT_INPUT));
@@ -1667,11 +1765,15 @@ private:
                     pvertoffset->setOffset(0);
                     pvertoffset->setSource(domUrifragment(*pverts, string("#")+parentid+string("_vertices")));
                     domPRef pindices = daeSafeCast<domP>(ptris->add(COLLADA_ELEMENT_P));
-                    pindices->getValue().setCount(mesh.indices.size());
-                    for(size_t ind = 0; ind < mesh.indices.size(); ++ind) {
+                    pindices->getValue().setCount(ntextindices);
+                    for(size_t ind = 0; ind < ntextindices; ++ind) {
                         pindices->getValue()[ind] = mesh.indices[ind];
                     }
                 }
+
+                if( bbinarymesh ) {
+                    _WriteBinaryMesh(pdommesh, mesh, t);
+                }
             }
         }
 
@@ -2417,6 +2519,11 @@ private:
     bool _bExternalRefAllBodies; ///< if true, attempts to externally write all bodies
     bool _bForceWriteAll; ///< if true, attemps to write all modifiable data to externally saved bodies
     bool _bReuseSimilar; ///< if true, attemps to resuse similar looking meshes and structures to reduce size
+
+    BinaryMeshCompression _binarymeshcompression; ///< if not BMC_None, large meshes are written to a binary sidecar file instead of as text
+    size_t _nBinaryMeshMinVertices; ///< meshes with at least this many vertices are written to the sidecar
+    std::vector<char> _vbinarymeshdata; ///< the contents of the sidecar file, written on Save
+    std::list<daeElementRef> _listBinaryMeshDataElements; ///< the <data> elements that need their file attribute set on Save
 };
 
 // register for typeof (MSVC only)
@@ -25,6 +25,9 @@
 #endif
 
 #include <pcrecpp.h>
+#include <boost/unordered_map.hpp>
+
+#include "parallelrangeworkers.h"
 
 #define CHECK_INTERFACE(pinterface) { \
         if( (pinterface)->GetEnv() != shared_from_this() ) \
@@ -58,6 +61,15 @@ public:
             }
         }
 
+        bool SetPoints(const float* ppoints, int numPoints, int stride)
+        {
+            bool bsuccess = true;
+            FOREACH(it,listhandles) {
+                bsuccess &= (*it)->SetPoints(ppoints, numPoints, stride);
+            }
+            return bsuccess;
+        }
+
         void Add(OpenRAVE::GraphHandlePtr phandle) {
             if( !!phandle) {
                 listhandles.push_back(phandle);
@@ -76,7 +88,7 @@ public:
         virtual ~CollisionCallbackData() {
             boost::shared_ptr<Environment> penv = _pweakenv.lock();
             if( !!penv ) {
-                boost::timed_mutex::scoped_lock lock(penv->_mutexInterfaces);
+                InterfacesExclusiveLock lock(*penv);
                 penv->_listRegisteredCollisionCallbacks.erase(_iterator);
             }
         }
@@ -97,7 +109,7 @@ public:
         virtual ~BodyCallbackData() {
             boost::shared_ptr<Environment> penv = _pweakenv.lock();
             if( !!penv ) {
-                boost::timed_mutex::scoped_lock lock(penv->_mutexInterfaces);
+                InterfacesExclusiveLock lock(*penv);
                 penv->_listRegisteredBodyCallbacks.erase(_iterator);
             }
         }
@@ -110,6 +122,59 @@ protected:
     friend class BodyCallbackData;
     typedef boost::shared_ptr<BodyCallbackData> BodyCallbackDataPtr;
 
+    /// \brief scoped lock of the environment mutex that records in the lock statistics when it had to wait
+    class EnvironmentLock : public EnvironmentMutex::scoped_try_lock
+    {
+public:
+        EnvironmentLock(const Environment& env) : EnvironmentMutex::scoped_try_lock(env._mutexEnvironment, boost::try_to_lock) {
+            if( !this->owns_lock() ) {
+                uint64_t starttime = utils::GetMicroTime();
+                this->lock();
+                env._RecordLockContention(&LockStatistics::numEnvironmentContended, &LockStatistics::environmentWaitTime, utils::GetMicroTime()-starttime);
+            }
+        }
+    };
+    friend class EnvironmentLock;
+
+    /// \brief scoped lock of _mutexInterfaces that records in the lock statistics when it had to wait
+    ///
+    /// \tparam LockType boost::shared_lock for read accesses, boost::unique_lock for write accesses
+    template <typename LockType, bool bShared>
+    class InterfacesLock : public LockType
+    {
+public:
+        InterfacesLock(const Environment& env) : LockType(env._mutexInterfaces, boost::try_to_lock) {
+            if( !this->owns_lock() ) {
+                uint64_t starttime = utils::GetMicroTime();
+                this->lock();
+                _Record(env, utils::GetMicroTime()-starttime);
+            }
+        }
+
+        /// \param timeout microseconds to wait for the lock, if it could not be acquired owns_lock() returns false
+        InterfacesLock(const Environment& env, uint64_t timeout) : LockType(env._mutexInterfaces, boost::try_to_lock) {
+            if( !this->owns_lock() ) {
+                uint64_t starttime = utils::GetMicroTime();
+                this->timed_lock(boost::get_system_time() + boost::posix_time::microseconds(timeout));
+                _Record(env, utils::GetMicroTime()-starttime);
+            }
+        }
+
+private:
+        static void _Record(const Environment& env, uint64_t waittime) {
+            if( bShared ) {
+                env._RecordLockContention(&LockStatistics::numInterfacesSharedContended, &LockStatistics::interfacesSharedWaitTime, waittime);
+            }
+            else {
+                env._RecordLockContention(&LockStatistics::numInterfacesExclusiveContended, &LockStatistics::interfacesExclusiveWaitTime, waittime);
+            }
+        }
+    };
+    typedef InterfacesLock<boost::shared_lock<boost::shared_mutex>, true> InterfacesSharedLock; ///< for only reading the interface lists
+    typedef InterfacesLock<boost::unique_lock<boost::shared_mutex>, false> InterfacesExclusiveLock; ///< for modifying the interface lists
+    friend class InterfacesLock<boost::shared_lock<boost::shared_mutex>, true>;
+    friend class InterfacesLock<boost::unique_lock<boost::shared_mutex>, false>;
+
 public:
     Environment() : EnvironmentBase()
     {
@@ -117,13 +182,23 @@ public:
         RAVELOG_DEBUG_FORMAT("setting openrave home directory to %s", _homedirectory);
 
         _nBodiesModifiedStamp = 0;
+        _nPublishedBodiesStamp = 0;
+        FOREACH(itbuffer, _vPublishedBodiesBuffers) {
+            itbuffer->reset(new std::vector<KinBody::BodyState>());
+        }
         _nEnvironmentIndex = 1;
+        _bBodyNamesDirty = false;
+        _bBodyNamesDuplicate = false;
 
         _fDeltaSimTime = 0.01f;
         _nCurSimTime = 0;
         _nSimStartTime = utils::GetMicroTime();
         _bRealTime = true;
         _bInit = false;
+        for(int isubsystem = 0; isubsystem < SS_NumSubsystems; ++isubsystem) {
+            _vSubsystemPeriods[isubsystem] = 0;
+        }
+        _ResetSimulationSubsystems();
         _bEnableSimulation = true;     // need to start by default
         _unit = std::make_pair("meter",1.0); //default unit settings
 
@@ -155,6 +230,7 @@ public:
         _nSimStartTime = utils::GetMicroTime();
         _bRealTime = true;
         _bEnableSimulation = true;     // need to start by default
+        _ResetSimulationSubsystems();
 
         if( !_pCurrentChecker ) {
             _pCurrentChecker = RaveCreateCollisionChecker(shared_from_this(), "GenericCollisionChecker");
@@ -232,7 +308,7 @@ public:
         list< pair<ModuleBasePtr, std::string> > listModules;
         list<ViewerBasePtr> listViewers = _listViewers;
         {
-            boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+            InterfacesExclusiveLock lock(*this);
             listModules = _listModules;
             listViewers = _listViewers;
         }
@@ -251,7 +327,7 @@ public:
 
         // lock the environment
         {
-            EnvironmentMutex::scoped_lock lockenv(GetMutex());
+            EnvironmentLock lockenv(*this);
             _bEnableSimulation = false;
             if( !!_pPhysicsEngine ) {
                 _pPhysicsEngine->DestroyEnvironment();
@@ -262,7 +338,7 @@ public:
 
             // clear internal interface lists
             {
-                boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+                InterfacesExclusiveLock lock(*this);
                 // release all grabbed
                 FOREACH(itrobot,_vecrobots) {
                     (*itrobot)->ReleaseAllGrabbed();
@@ -275,7 +351,9 @@ public:
                     (*itrobot)->Destroy();
                 }
                 _vecrobots.clear();
-                _vPublishedBodies.clear();
+                _ClearBodyNames();
+                _mapTriangulateCache.clear();
+                _ClearPublishedBodies();
                 _nBodiesModifiedStamp++;
                 FOREACH(itsensor,_listSensors) {
                     (*itsensor)->Configure(SensorBase::CC_PowerOff);
@@ -304,7 +382,7 @@ public:
             (*itviewer)->Reset();
         }
 
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        EnvironmentLock lockenv(*this);
 
         if( !!_pPhysicsEngine ) {
             _pPhysicsEngine->DestroyEnvironment();
@@ -314,7 +392,7 @@ public:
         }
         std::vector<KinBodyPtr> vcallbackbodies;
         {
-            boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+            InterfacesExclusiveLock lock(*this);
             boost::mutex::scoped_lock locknetworkid(_mutexEnvironmentIds);
 
             FOREACH(itbody,_vecbodies) {
@@ -333,10 +411,13 @@ public:
                 vcallbackbodies.insert(vcallbackbodies.end(), _vecrobots.begin(), _vecrobots.end());
             }
             _vecrobots.clear();
-            _vPublishedBodies.clear();
+            _ClearBodyNames();
+            _mapTriangulateCache.clear();
+            _ClearPublishedBodies();
             _nBodiesModifiedStamp++;
 
             _mapBodies.clear();
+            _InvalidateBodiesSnapshot();
 
             FOREACH(itsensor,_listSensors) {
                 (*itsensor)->Configure(SensorBase::CC_PowerOff);
@@ -353,7 +434,7 @@ public:
 
         list< pair<ModuleBasePtr, std::string> > listModules;
         {
-            boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+            InterfacesExclusiveLock lock(*this);
             listModules = _listModules;
         }
 
@@ -378,21 +459,21 @@ public:
     virtual void OwnInterface(InterfaceBasePtr pinterface)
     {
         CHECK_INTERFACE(pinterface);
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
-        boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+        EnvironmentLock lockenv(*this);
+        InterfacesExclusiveLock lock(*this);
         _listOwnedInterfaces.push_back(pinterface);
     }
     virtual void DisownInterface(InterfaceBasePtr pinterface)
     {
         CHECK_INTERFACE(pinterface);
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
-        boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+        EnvironmentLock lockenv(*this);
+        InterfacesExclusiveLock lock(*this);
         _listOwnedInterfaces.remove(pinterface);
     }
 
     virtual EnvironmentBasePtr CloneSelf(int options)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        EnvironmentLock lockenv(*this);
         boost::shared_ptr<Environment> penv(new Environment());
         penv->_Clone(boost::static_pointer_cast<Environment const>(shared_from_this()),options,false);
         return penv;
@@ -400,7 +481,7 @@ public:
 
     virtual void Clone(EnvironmentBaseConstPtr preference, int cloningoptions)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        EnvironmentLock lockenv(*this);
         _Clone(boost::static_pointer_cast<Environment const>(preference),cloningoptions,true);
     }
 
@@ -412,8 +493,8 @@ public:
             RAVELOG_WARN_FORMAT("Error %d with executing module %s", ret%module->GetXMLId());
         }
         else {
-            EnvironmentMutex::scoped_lock lockenv(GetMutex());
-            boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+            EnvironmentLock lockenv(*this);
+            InterfacesExclusiveLock lock(*this);
             _listModules.push_back(make_pair(module, cmdargs));
         }
 
@@ -423,14 +504,14 @@ public:
     void GetModules(std::list<ModuleBasePtr>& listModules, uint64_t timeout) const
     {
         if( timeout == 0 ) {
-            boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+            InterfacesSharedLock lock(*this);
             listModules.clear();
             FOREACHC(it, _listModules) {
                 listModules.push_back(it->first);
             }
         }
         else {
-            boost::timed_mutex::scoped_timed_lock lock(_mutexInterfaces, boost::get_system_time() + boost::posix_time::microseconds(timeout));
+            InterfacesSharedLock lock(*this, timeout);
             if (!lock.owns_lock()) {
                 throw OPENRAVE_EXCEPTION_FORMAT(_("timeout of %f s failed"),(1e-6*static_cast<double>(timeout)),ORE_Timeout);
             }
@@ -448,7 +529,8 @@ public:
 
     virtual bool Load(const std::string& filename, const AttributesList& atts)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        EnvironmentLock lockenv(*this);
+        EnvironmentBodyChangeBatch bodychangebatch(shared_from_this()); // the loaded bodies notify their listeners once
         OpenRAVEXMLParser::GetXMLErrorCount() = 0;
         if( _IsColladaURI(filename) ) {
             if( RaveParseColladaURI(shared_from_this(), filename, atts) ) {
@@ -488,7 +570,8 @@ public:
 
     virtual bool LoadData(const std::string& data, const AttributesList& atts)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        EnvironmentLock lockenv(*this);
+        EnvironmentBodyChangeBatch bodychangebatch(shared_from_this()); // the loaded bodies notify their listeners once
         if( _IsColladaData(data) ) {
             return RaveParseColladaData(shared_from_this(), data, atts);
         }
@@ -497,7 +580,7 @@ public:
 
     virtual void Save(const std::string& filename, SelectionOptions options, const AttributesList& atts)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        EnvironmentLock lockenv(*this);
         std::list<KinBodyPtr> listbodies;
         switch(options) {
         case SO_Everything:
@@ -575,7 +658,7 @@ public:
 
     virtual void _AddKinBody(KinBodyPtr pbody, bool bAnonymous)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        EnvironmentLock lockenv(*this);
         CHECK_INTERFACE(pbody);
         if( !utils::IsValidName(pbody->GetName()) ) {
             throw openrave_exception(str(boost::format(_("kinbody name: \"%s\" is not valid"))%pbody->GetName()));
@@ -592,8 +675,9 @@ public:
             }
         }
         {
-            boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+            InterfacesExclusiveLock lock(*this);
             _vecbodies.push_back(pbody);
+            _AddBodyName(pbody);
             SetEnvironmentId(pbody);
             _nBodiesModifiedStamp++;
         }
@@ -607,7 +691,7 @@ public:
 
     virtual void _AddRobot(RobotBasePtr robot, bool bAnonymous)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        EnvironmentLock lockenv(*this);
         CHECK_INTERFACE(robot);
         if( !robot->IsRobot() ) {
             throw openrave_exception(str(boost::format(_("kinbody \"%s\" is not a robot"))%robot->GetName()));
@@ -627,9 +711,10 @@ public:
             }
         }
         {
-            boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+            InterfacesExclusiveLock lock(*this);
             _vecbodies.push_back(robot);
             _vecrobots.push_back(robot);
+            _AddBodyName(robot);
             SetEnvironmentId(robot);
             _nBodiesModifiedStamp++;
         }
@@ -643,7 +728,7 @@ public:
 
     virtual void _AddSensor(SensorBasePtr psensor, bool bAnonymous)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        EnvironmentLock lockenv(*this);
         CHECK_INTERFACE(psensor);
         if( !utils::IsValidName(psensor->GetName()) ) {
             throw openrave_exception(str(boost::format(_("sensor name: \"%s\" is not valid"))%psensor->GetName()));
@@ -660,7 +745,7 @@ public:
             }
         }
         {
-            boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+            InterfacesExclusiveLock lock(*this);
             _listSensors.push_back(psensor);
         }
         psensor->Configure(SensorBase::CC_PowerOn);
@@ -668,14 +753,14 @@ public:
 
     virtual bool Remove(InterfaceBasePtr pinterface)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        EnvironmentLock lockenv(*this);
         CHECK_INTERFACE(pinterface);
         switch(pinterface->GetInterfaceType()) {
         case PT_KinBody:
         case PT_Robot: {
             KinBodyPtr pbody = RaveInterfaceCast<KinBody>(pinterface);
             {
-                boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+                InterfacesExclusiveLock lock(*this);
                 vector<KinBodyPtr>::iterator it = std::find(_vecbodies.begin(), _vecbodies.end(), pbody);
                 if( it == _vecbodies.end() ) {
                     return false;
@@ -701,6 +786,7 @@ public:
                     _pPhysicsEngine->RemoveKinBody(*it);
                 }
                 RemoveEnvironmentId(pbody);
+                _RemoveBodyName(pbody);
                 _vecbodies.erase(it);
                 _nBodiesModifiedStamp++;
             }
@@ -747,7 +833,7 @@ public:
 
     virtual UserDataPtr RegisterBodyCallback(const BodyCallbackFn& callback)
     {
-        boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+        InterfacesExclusiveLock lock(*this);
         BodyCallbackDataPtr pdata(new BodyCallbackData(callback,boost::dynamic_pointer_cast<Environment>(shared_from_this())));
         pdata->_iterator = _listRegisteredBodyCallbacks.insert(_listRegisteredBodyCallbacks.end(),pdata);
         return pdata;
@@ -755,29 +841,23 @@ public:
 
     virtual KinBodyPtr GetKinBody(const std::string& pname) const
     {
-        boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
-        FOREACHC(it, _vecbodies) {
-            if((*it)->GetName()==pname) {
-                return *it;
-            }
-        }
-        return KinBodyPtr();
+        InterfacesSharedLock lock(*this);
+        return _FindBodyByName(pname);
     }
 
     virtual RobotBasePtr GetRobot(const std::string& pname) const
     {
-        boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
-        FOREACHC(it, _vecrobots) {
-            if((*it)->GetName()==pname) {
-                return *it;
-            }
+        InterfacesSharedLock lock(*this);
+        KinBodyPtr pbody = _FindBodyByName(pname);
+        if( !!pbody && pbody->IsRobot() ) {
+            return RaveInterfaceCast<RobotBase>(pbody);
         }
         return RobotBasePtr();
     }
 
     virtual SensorBasePtr GetSensor(const std::string& name) const
     {
-        boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+        InterfacesSharedLock lock(*this);
         FOREACHC(itrobot,_vecrobots) {
             FOREACHC(itsensor, (*itrobot)->GetAttachedSensors()) {
                 SensorBasePtr psensor = (*itsensor)->GetSensor();
@@ -796,7 +876,7 @@ public:
 
     virtual bool SetPhysicsEngine(PhysicsEngineBasePtr pengine)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        EnvironmentLock lockenv(*this);
         if( !!_pPhysicsEngine ) {
             _pPhysicsEngine->DestroyEnvironment();
         }
@@ -819,20 +899,20 @@ public:
 
     virtual UserDataPtr RegisterCollisionCallback(const CollisionCallbackFn& callback)
     {
-        boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+        InterfacesExclusiveLock lock(*this);
         CollisionCallbackDataPtr pdata(new CollisionCallbackData(callback,boost::dynamic_pointer_cast<Environment>(shared_from_this())));
         pdata->_iterator = _listRegisteredCollisionCallbacks.insert(_listRegisteredCollisionCallbacks.end(),pdata);
         return pdata;
     }
     virtual bool HasRegisteredCollisionCallbacks() const
     {
-        boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+        InterfacesSharedLock lock(*this);
         return _listRegisteredCollisionCallbacks.size() > 0;
     }
 
     virtual void GetRegisteredCollisionCallbacks(std::list<CollisionCallbackFn>& listcallbacks) const
     {
-        boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+        InterfacesSharedLock lock(*this);
         listcallbacks.clear();
         FOREACHC(it, _listRegisteredCollisionCallbacks) {
             CollisionCallbackDataPtr pdata = boost::dynamic_pointer_cast<CollisionCallbackData>(it->lock());
@@ -842,7 +922,7 @@ public:
 
     virtual bool SetCollisionChecker(CollisionCheckerBasePtr pchecker)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        EnvironmentLock lockenv(*this);
         if( _pCurrentChecker == pchecker ) {
             return true;
         }
@@ -869,14 +949,16 @@ public:
 
     virtual bool CheckCollision(KinBodyConstPtr pbody1, CollisionReportPtr report)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        utils::ProfileZone profilezone("EnvironmentBase::CheckCollision");
+        EnvironmentLock lockenv(*this);
         CHECK_COLLISION_BODY(pbody1);
         return _pCurrentChecker->CheckCollision(pbody1,report);
     }
 
     virtual bool CheckCollision(KinBodyConstPtr pbody1, KinBodyConstPtr pbody2, CollisionReportPtr report)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        utils::ProfileZone profilezone("EnvironmentBase::CheckCollision");
+        EnvironmentLock lockenv(*this);
         CHECK_COLLISION_BODY(pbody1);
         CHECK_COLLISION_BODY(pbody2);
         return _pCurrentChecker->CheckCollision(pbody1,pbody2,report);
@@ -884,14 +966,16 @@ public:
 
     virtual bool CheckCollision(KinBody::LinkConstPtr plink, CollisionReportPtr report )
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        utils::ProfileZone profilezone("EnvironmentBase::CheckCollision");
+        EnvironmentLock lockenv(*this);
         CHECK_COLLISION_BODY(plink->GetParent());
         return _pCurrentChecker->CheckCollision(plink,report);
     }
 
     virtual bool CheckCollision(KinBody::LinkConstPtr plink1, KinBody::LinkConstPtr plink2, CollisionReportPtr report)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        utils::ProfileZone profilezone("EnvironmentBase::CheckCollision");
+        EnvironmentLock lockenv(*this);
         CHECK_COLLISION_BODY(plink1->GetParent());
         CHECK_COLLISION_BODY(plink2->GetParent());
         return _pCurrentChecker->CheckCollision(plink1,plink2,report);
@@ -899,7 +983,8 @@ public:
 
     virtual bool CheckCollision(KinBody::LinkConstPtr plink, KinBodyConstPtr pbody, CollisionReportPtr report)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        utils::ProfileZone profilezone("EnvironmentBase::CheckCollision");
+        EnvironmentLock lockenv(*this);
         CHECK_COLLISION_BODY(plink->GetParent());
         CHECK_COLLISION_BODY(pbody);
         return _pCurrentChecker->CheckCollision(plink,pbody,report);
@@ -907,100 +992,105 @@ public:
 
     virtual bool CheckCollision(KinBody::LinkConstPtr plink, const std::vector<KinBodyConstPtr>& vbodyexcluded, const std::vector<KinBody::LinkConstPtr>& vlinkexcluded, CollisionReportPtr report)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        utils::ProfileZone profilezone("EnvironmentBase::CheckCollision");
+        EnvironmentLock lockenv(*this);
         CHECK_COLLISION_BODY(plink->GetParent());
         return _pCurrentChecker->CheckCollision(plink,vbodyexcluded,vlinkexcluded,report);
     }
 
     virtual bool CheckCollision(KinBodyConstPtr pbody, const std::vector<KinBodyConstPtr>& vbodyexcluded, const std::vector<KinBody::LinkConstPtr>& vlinkexcluded, CollisionReportPtr report)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        utils::ProfileZone profilezone("EnvironmentBase::CheckCollision");
+        EnvironmentLock lockenv(*this);
         CHECK_COLLISION_BODY(pbody);
         return _pCurrentChecker->CheckCollision(pbody,vbodyexcluded,vlinkexcluded,report);
     }
 
     virtual bool CheckCollision(const RAY& ray, KinBody::LinkConstPtr plink, CollisionReportPtr report)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        utils::ProfileZone profilezone("EnvironmentBase::CheckCollision");
+        EnvironmentLock lockenv(*this);
         CHECK_COLLISION_BODY(plink->GetParent());
         return _pCurrentChecker->CheckCollision(ray,plink,report);
     }
     virtual bool CheckCollision(const RAY& ray, KinBodyConstPtr pbody, CollisionReportPtr report)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        utils::ProfileZone profilezone("EnvironmentBase::CheckCollision");
+        EnvironmentLock lockenv(*this);
         CHECK_COLLISION_BODY(pbody);
         return _pCurrentChecker->CheckCollision(ray,pbody,report);
     }
     virtual bool CheckCollision(const RAY& ray, CollisionReportPtr report)
     {
+        utils::ProfileZone profilezone("EnvironmentBase::CheckCollision");
         return _pCurrentChecker->CheckCollision(ray,report);
     }
 
     virtual bool CheckStandaloneSelfCollision(KinBodyConstPtr pbody, CollisionReportPtr report)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        utils::ProfileZone profilezone("EnvironmentBase::CheckStandaloneSelfCollision");
+        EnvironmentLock lockenv(*this);
         CHECK_COLLISION_BODY(pbody);
         return _pCurrentChecker->CheckStandaloneSelfCollision(pbody,report);
     }
 
     virtual void StepSimulation(dReal fTimeStep)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
-
-        uint64_t step = (uint64_t)ceil(1000000.0 * (double)fTimeStep);
-        fTimeStep = (dReal)((double)step * 0.000001);
-
-        // call the physics first to get forces
-        _pPhysicsEngine->SimulateStep(fTimeStep);
+        _StepSimulation(fTimeStep, false);
+    }
 
-        // make a copy instead of locking the mutex pointer since will be calling into user functions
-        vector<KinBodyPtr> vecbodies;
-        vector<RobotBasePtr> vecrobots;
-        list<SensorBasePtr> listSensors;
-        list< pair<ModuleBasePtr, std::string> > listModules;
-        {
-            boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
-            vecbodies = _vecbodies;
-            vecrobots = _vecrobots;
-            listSensors = _listSensors;
-            listModules = _listModules;
-        }
+    virtual void SetSimulationSubsystemPeriod(SimulationSubsystem subsystem, dReal period)
+    {
+        OPENRAVE_ASSERT_OP((int)subsystem,>=,0);
+        OPENRAVE_ASSERT_OP((int)subsystem,<,(int)SS_NumSubsystems);
+        EnvironmentLock lockenv(*this);
+        _vSubsystemPeriods[subsystem] = max(period, dReal(0));
+        _vSubsystemAccumTime[subsystem] = 0;
+        _vSubsystemBusyUntil[subsystem] = 0;
+    }
 
-        FOREACH(it, vecbodies) {
-            if( (*it)->GetEnvironmentId() ) {     // have to check if valid
-                (*it)->SimulationStep(fTimeStep);
-            }
-        }
-        FOREACH(itmodule, listModules) {
-            itmodule->first->SimulationStep(fTimeStep);
-        }
+    virtual dReal GetSimulationSubsystemPeriod(SimulationSubsystem subsystem) const
+    {
+        OPENRAVE_ASSERT_OP((int)subsystem,>=,0);
+        OPENRAVE_ASSERT_OP((int)subsystem,<,(int)SS_NumSubsystems);
+        return _vSubsystemPeriods[subsystem];
+    }
 
-        // simulate the sensors last (ie, they always reflect the most recent bodies
-        FOREACH(itsensor, listSensors) {
-            (*itsensor)->SimulationStep(fTimeStep);
-        }
-        FOREACH(itrobot, vecrobots) {
-            FOREACH(itsensor, (*itrobot)->GetAttachedSensors()) {
-                if( !!(*itsensor)->GetSensor() ) {
-                    (*itsensor)->GetSensor()->SimulationStep(fTimeStep);
-                }
-            }
+    virtual void GetSimulationStatistics(SimulationStatistics& stats, bool bReset)
+    {
+        boost::mutex::scoped_lock lock(_mutexSimulationStatistics);
+        uint64_t curtime = utils::GetMicroTime(), cursimtime = _nCurSimTime;
+        stats = _simulationstatistics;
+        stats.simulationTime = cursimtime-_nStatisticsStartSimTime;
+        stats.realTime = curtime-_nStatisticsStartRealTime;
+        if( bReset ) {
+            _simulationstatistics = SimulationStatistics();
+            _nStatisticsStartSimTime = cursimtime;
+            _nStatisticsStartRealTime = curtime;
         }
-        _nCurSimTime += step;
     }
 
     virtual EnvironmentMutex& GetMutex() const {
         return _mutexEnvironment;
     }
 
+    virtual void GetLockStatistics(LockStatistics& stats, bool bReset)
+    {
+        boost::mutex::scoped_lock lock(_mutexLockStatistics);
+        stats = _lockstatistics;
+        if( bReset ) {
+            _lockstatistics = LockStatistics();
+        }
+    }
+
     virtual void GetBodies(std::vector<KinBodyPtr>& bodies, uint64_t timeout) const
     {
         if( timeout == 0 ) {
-            boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+            InterfacesSharedLock lock(*this);
             bodies = _vecbodies;
         }
         else {
-            boost::timed_mutex::scoped_timed_lock lock(_mutexInterfaces, boost::get_system_time() + boost::posix_time::microseconds(timeout));
+            InterfacesSharedLock lock(*this, timeout);
             if (!lock.owns_lock()) {
                 throw OPENRAVE_EXCEPTION_FORMAT(_("timeout of %f s failed"),(1e-6*static_cast<double>(timeout)),ORE_Timeout);
             }
@@ -1011,11 +1101,11 @@ public:
     virtual void GetRobots(std::vector<RobotBasePtr>& robots, uint64_t timeout) const
     {
         if( timeout == 0 ) {
-            boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+            InterfacesSharedLock lock(*this);
             robots = _vecrobots;
         }
         else {
-            boost::timed_mutex::scoped_timed_lock lock(_mutexInterfaces, boost::get_system_time() + boost::posix_time::microseconds(timeout));
+            InterfacesSharedLock lock(*this, timeout);
             if (!lock.owns_lock()) {
                 throw OPENRAVE_EXCEPTION_FORMAT(_("timeout of %f s failed"),(1e-6*static_cast<double>(timeout)),ORE_Timeout);
             }
@@ -1026,11 +1116,11 @@ public:
     virtual void GetSensors(std::vector<SensorBasePtr>& vsensors, uint64_t timeout) const
     {
         if( timeout == 0 ) {
-            boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+            InterfacesSharedLock lock(*this);
             _GetSensors(vsensors);
         }
         else {
-            boost::timed_mutex::scoped_timed_lock lock(_mutexInterfaces, boost::get_system_time() + boost::posix_time::microseconds(timeout));
+            InterfacesSharedLock lock(*this, timeout);
             if (!lock.owns_lock()) {
                 throw OPENRAVE_EXCEPTION_FORMAT(_("timeout of %f s failed"),(1e-6*static_cast<double>(timeout)),ORE_Timeout);
             }
@@ -1053,7 +1143,7 @@ public:
 
     virtual void Triangulate(TriMesh& trimesh, KinBodyConstPtr pbody)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());     // reading collision data, so don't want anyone modifying it
+        EnvironmentLock lockenv(*this);     // reading collision data, so don't want anyone modifying it
         FOREACHC(it, pbody->GetLinks()) {
             trimesh.Append((*it)->GetCollisionData(), (*it)->GetTransform());
         }
@@ -1061,43 +1151,31 @@ public:
 
     virtual void TriangulateScene(TriMesh& trimesh, SelectionOptions options,const std::string& selectname)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
-        FOREACH(itbody, _vecbodies) {
-            RobotBasePtr robot;
-            if( (*itbody)->IsRobot() ) {
-                robot = RaveInterfaceCast<RobotBase>(*itbody);
-            }
-            switch(options) {
-            case SO_NoRobots:
-                if( !robot ) {
-                    Triangulate(trimesh, *itbody);
-                }
-                break;
+        EnvironmentLock lockenv(*this);
+        _UpdateTriangulateCache(options, selectname);
+        size_t numvertices = trimesh.vertices.size(), numindices = trimesh.indices.size();
+        FOREACHC(itcache, _vTriangulateSelected) {
+            numvertices += (*itcache)->ptrimesh->vertices.size();
+            numindices += (*itcache)->ptrimesh->indices.size();
+        }
+        trimesh.vertices.reserve(numvertices);
+        trimesh.indices.reserve(numindices);
+        FOREACHC(itcache, _vTriangulateSelected) {
+            trimesh.Append(*(*itcache)->ptrimesh);
+        }
+        _vTriangulateSelected.resize(0);
+    }
 
-            case SO_Robots:
-                if( !!robot ) {
-                    Triangulate(trimesh, *itbody);
-                }
-                break;
-            case SO_Everything:
-                Triangulate(trimesh, *itbody);
-                break;
-            case SO_Body:
-                if( (*itbody)->GetName() == selectname ) {
-                    Triangulate(trimesh, *itbody);
-                }
-                break;
-            case SO_AllExceptBody:
-                if( (*itbody)->GetName() != selectname ) {
-                    Triangulate(trimesh, *itbody);
-                }
-                break;
-//            case SO_BodyList:
-//                if( find(listnames.begin(),listnames.end(),(*itbody)->GetName()) != listnames.end() ) {
-//                    Triangulate(trimesh,*itbody);
-//                }
-            }
+    virtual void TriangulateSceneMeshes(std::vector< std::pair<KinBodyConstPtr, boost::shared_ptr<TriMesh const> > >& vmeshes, SelectionOptions options, const std::string& selectname)
+    {
+        EnvironmentLock lockenv(*this);
+        _UpdateTriangulateCache(options, selectname);
+        vmeshes.resize(_vTriangulateSelected.size());
+        for(size_t i = 0; i < _vTriangulateSelected.size(); ++i) {
+            vmeshes[i].first = _vTriangulateSelected[i]->pbody.lock();
+            vmeshes[i].second = _vTriangulateSelected[i]->ptrimesh;
         }
+        _vTriangulateSelected.resize(0);
     }
 
     virtual void TriangulateScene(TriMesh& trimesh, TriangulateOptions options)
@@ -1107,10 +1185,10 @@ public:
 
     virtual RobotBasePtr ReadRobotURI(RobotBasePtr robot, const std::string& filename, const AttributesList& atts)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        EnvironmentLock lockenv(*this);
 
         if( !!robot ) {
-            boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+            InterfacesExclusiveLock lock(*this);
             FOREACH(itviewer, _listViewers) {
                 (*itviewer)->RemoveKinBody(robot);
             }
@@ -1193,10 +1271,10 @@ public:
 
     virtual RobotBasePtr ReadRobotData(RobotBasePtr robot, const std::string& data, const AttributesList& atts)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        EnvironmentLock lockenv(*this);
 
         if( !!robot ) {
-            boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+            InterfacesExclusiveLock lock(*this);
             FOREACH(itviewer, _listViewers) {
                 (*itviewer)->RemoveKinBody(robot);
             }
@@ -1250,10 +1328,10 @@ public:
 
     virtual KinBodyPtr ReadKinBodyURI(KinBodyPtr body, const std::string& filename, const AttributesList& atts)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        EnvironmentLock lockenv(*this);
 
         if( !!body ) {
-            boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+            InterfacesExclusiveLock lock(*this);
             FOREACH(itviewer, _listViewers) {
                 (*itviewer)->RemoveKinBody(body);
             }
@@ -1334,10 +1412,10 @@ public:
 
     virtual KinBodyPtr ReadKinBodyData(KinBodyPtr body, const std::string& data, const AttributesList& atts)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        EnvironmentLock lockenv(*this);
 
         if( !!body ) {
-            boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+            InterfacesExclusiveLock lock(*this);
             FOREACH(itviewer, _listViewers) {
                 (*itviewer)->RemoveKinBody(body);
             }
@@ -1391,7 +1469,7 @@ public:
     virtual InterfaceBasePtr ReadInterfaceURI(const std::string& filename, const AttributesList& atts)
     {
         try {
-            EnvironmentMutex::scoped_lock lockenv(GetMutex());
+            EnvironmentLock lockenv(*this);
             BaseXMLReaderPtr preader = OpenRAVEXMLParser::CreateInterfaceReader(shared_from_this(),atts,false);
             if( !preader ) {
                 return InterfaceBasePtr();
@@ -1413,7 +1491,7 @@ public:
 
     virtual InterfaceBasePtr ReadInterfaceURI(InterfaceBasePtr pinterface, InterfaceType type, const std::string& filename, const AttributesList& atts)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        EnvironmentLock lockenv(*this);
         bool bIsColladaURI=false, bIsColladaFile=false, bIsXFile = false;
         if( _IsColladaURI(filename) ) {
             bIsColladaURI = true;
@@ -1494,7 +1572,7 @@ public:
 
     virtual InterfaceBasePtr ReadInterfaceData(InterfaceBasePtr pinterface, InterfaceType type, const std::string& data, const AttributesList& atts)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        EnvironmentLock lockenv(*this);
 
         // check for collada?
         BaseXMLReaderPtr preader = OpenRAVEXMLParser::CreateInterfaceReader(shared_from_this(), type, pinterface, RaveGetInterfaceName(type), atts);
@@ -1580,7 +1658,7 @@ public:
     /// \param[in] listGeometries geometry list to be filled
     virtual std::string _ReadGeometriesFile(std::list<KinBody::GeometryInfo>& listGeometries, const std::string& filename, const AttributesList& atts)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        EnvironmentLock lockenv(*this);
         string filedata = RaveFindLocalFile(filename);
         if( filedata.size() == 0 ) {
             return std::string();
@@ -1605,8 +1683,8 @@ public:
     virtual void _AddViewer(ViewerBasePtr pnewviewer)
     {
         CHECK_INTERFACE(pnewviewer);
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
-        boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+        EnvironmentLock lockenv(*this);
+        InterfacesExclusiveLock lock(*this);
         BOOST_ASSERT(find(_listViewers.begin(),_listViewers.end(),pnewviewer) == _listViewers.end() );
         _CheckUniqueName(ViewerBaseConstPtr(pnewviewer),true);
         _listViewers.push_back(pnewviewer);
@@ -1614,7 +1692,7 @@ public:
 
     virtual ViewerBasePtr GetViewer(const std::string& name) const
     {
-        boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+        InterfacesSharedLock lock(*this);
         if( name.size() == 0 ) {
             return _listViewers.size() > 0 ? _listViewers.front() : ViewerBasePtr();
         }
@@ -1628,13 +1706,13 @@ public:
 
     void GetViewers(std::list<ViewerBasePtr>& listViewers) const
     {
-        boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+        InterfacesSharedLock lock(*this);
         listViewers = _listViewers;
     }
 
     virtual OpenRAVE::GraphHandlePtr plot3(const float* ppoints, int numPoints, int stride, float fPointSize, const RaveVector<float>& color, int drawstyle)
     {
-        boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+        InterfacesExclusiveLock lock(*this);
         if( _listViewers.size() == 0 ) {
             return OpenRAVE::GraphHandlePtr();
         }
@@ -1646,7 +1724,7 @@ public:
     }
     virtual OpenRAVE::GraphHandlePtr plot3(const float* ppoints, int numPoints, int stride, float fPointSize, const float* colors, int drawstyle, bool bhasalpha)
     {
-        boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+        InterfacesExclusiveLock lock(*this);
         if( _listViewers.size() == 0 ) {
             return OpenRAVE::GraphHandlePtr();
         }
@@ -1658,7 +1736,7 @@ public:
     }
     virtual OpenRAVE::GraphHandlePtr drawlinestrip(const float* ppoints, int numPoints, int stride, float fwidth, const RaveVector<float>& color)
     {
-        boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+        InterfacesExclusiveLock lock(*this);
         if( _listViewers.size() == 0 ) {
             return OpenRAVE::GraphHandlePtr();
         }
@@ -1670,7 +1748,7 @@ public:
     }
     virtual OpenRAVE::GraphHandlePtr drawlinestrip(const float* ppoints, int numPoints, int stride, float fwidth, const float* colors)
     {
-        boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+        InterfacesExclusiveLock lock(*this);
         if( _listViewers.size() == 0 ) {
             return OpenRAVE::GraphHandlePtr();
         }
@@ -1682,7 +1760,7 @@ public:
     }
     virtual OpenRAVE::GraphHandlePtr drawlinelist(const float* ppoints, int numPoints, int stride, float fwidth, const RaveVector<float>& color)
     {
-        boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+        InterfacesExclusiveLock lock(*this);
         if( _listViewers.size() == 0 ) {
             return OpenRAVE::GraphHandlePtr();
         }
@@ -1694,7 +1772,7 @@ public:
     }
     virtual OpenRAVE::GraphHandlePtr drawlinelist(const float* ppoints, int numPoints, int stride, float fwidth, const float* colors)
     {
-        boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+        InterfacesExclusiveLock lock(*this);
         if( _listViewers.size() == 0 ) {
             return OpenRAVE::GraphHandlePtr();
         }
@@ -1706,7 +1784,7 @@ public:
     }
     virtual OpenRAVE::GraphHandlePtr drawarrow(const RaveVector<float>& p1, const RaveVector<float>& p2, float fwidth, const RaveVector<float>& color)
     {
-        boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+        InterfacesExclusiveLock lock(*this);
         if( _listViewers.size() == 0 ) {
             return OpenRAVE::GraphHandlePtr();
         }
@@ -1718,7 +1796,7 @@ public:
     }
     virtual OpenRAVE::GraphHandlePtr drawbox(const RaveVector<float>& vpos, const RaveVector<float>& vextents)
     {
-        boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+        InterfacesExclusiveLock lock(*this);
         if( _listViewers.size() == 0 ) {
             return OpenRAVE::GraphHandlePtr();
         }
@@ -1730,7 +1808,7 @@ public:
     }
     virtual OpenRAVE::GraphHandlePtr drawplane(const RaveTransform<float>& tplane, const RaveVector<float>& vextents, const boost::multi_array<float,3>& vtexture)
     {
-        boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+        InterfacesExclusiveLock lock(*this);
         if( _listViewers.size() == 0 ) {
             return OpenRAVE::GraphHandlePtr();
         }
@@ -1742,7 +1820,7 @@ public:
     }
     virtual OpenRAVE::GraphHandlePtr drawtrimesh(const float* ppoints, int stride, const int* pIndices, int numTriangles, const RaveVector<float>& color)
     {
-        boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+        InterfacesExclusiveLock lock(*this);
         if( _listViewers.size() == 0 ) {
             return OpenRAVE::GraphHandlePtr();
         }
@@ -1754,7 +1832,7 @@ public:
     }
     virtual OpenRAVE::GraphHandlePtr drawtrimesh(const float* ppoints, int stride, const int* pIndices, int numTriangles, const boost::multi_array<float,2>& colors)
     {
-        boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+        InterfacesExclusiveLock lock(*this);
         if( _listViewers.size() == 0 ) {
             return OpenRAVE::GraphHandlePtr();
         }
@@ -1767,19 +1845,35 @@ public:
 
     virtual KinBodyPtr GetBodyFromEnvironmentId(int id)
     {
-        boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+#if BOOST_VERSION >= 105300
+        // readers share an immutable copy of _mapBodies that is only rebuilt after bodies were added or removed, so no lock is taken in the common case
+        boost::shared_ptr<BodyIdMap const> pmapbodies = boost::atomic_load(&_pmapBodiesSnapshot);
+        if( !pmapbodies ) {
+            InterfacesSharedLock lock(*this);
+            boost::mutex::scoped_lock locknetwork(_mutexEnvironmentIds);
+            pmapbodies.reset(new BodyIdMap(_mapBodies));
+            boost::atomic_store(&_pmapBodiesSnapshot, pmapbodies);
+        }
+        BodyIdMap::const_iterator it = pmapbodies->find(id);
+        if( it != pmapbodies->end() ) {
+            return it->second.lock();
+        }
+        return KinBodyPtr();
+#else
+        InterfacesSharedLock lock(*this);
         boost::mutex::scoped_lock locknetwork(_mutexEnvironmentIds);
         map<int, KinBodyWeakPtr>::iterator it = _mapBodies.find(id);
         if( it != _mapBodies.end() ) {
             return KinBodyPtr(it->second);
         }
         return KinBodyPtr();
+#endif
     }
 
     virtual void StartSimulation(dReal fDeltaTime, bool bRealTime)
     {
         {
-            EnvironmentMutex::scoped_lock lockenv(GetMutex());
+            EnvironmentLock lockenv(*this);
             _bEnableSimulation = true;
             _fDeltaSimTime = fDeltaTime;
             _bRealTime = bRealTime;
@@ -1796,7 +1890,7 @@ public:
     virtual void StopSimulation(int shutdownthread=1)
     {
         {
-            EnvironmentMutex::scoped_lock lockenv(GetMutex());
+            EnvironmentLock lockenv(*this);
             _bEnableSimulation = false;
             _fDeltaSimTime = 1.0f;
         }
@@ -1818,28 +1912,53 @@ public:
 
     virtual void GetPublishedBodies(std::vector<KinBody::BodyState>& vbodies, uint64_t timeout)
     {
-        if( timeout == 0 ) {
-            boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
-            vbodies = _vPublishedBodies;
+        // _mutexPublishedBodies is only held to copy the pointer, so timeout never triggers
+        PublishedBodiesConstPtr ppublishedbodies;
+        {
+            boost::mutex::scoped_lock lock(_mutexPublishedBodies);
+            ppublishedbodies = _pPublishedBodies;
+        }
+        if( !!ppublishedbodies ) {
+            vbodies = *ppublishedbodies;
         }
         else {
-            boost::timed_mutex::scoped_timed_lock lock(_mutexInterfaces, boost::get_system_time() + boost::posix_time::microseconds(timeout));
-            if (!lock.owns_lock()) {
-                throw OPENRAVE_EXCEPTION_FORMAT(_("timeout of %f s failed"),(1e-6*static_cast<double>(timeout)),ORE_Timeout);
-            }
-            vbodies = _vPublishedBodies;
+            vbodies.clear();
         }
     }
 
+    virtual uint64_t GetPublishedBodiesStamp() const
+    {
+        boost::mutex::scoped_lock lock(_mutexPublishedBodies);
+        return _nPublishedBodiesStamp;
+    }
+
+    virtual uint64_t WritePublishedBodiesDelta(std::ostream& O, uint64_t stamp)
+    {
+        PublishedBodiesConstPtr ppublishedbodies;
+        uint64_t newstamp;
+        {
+            boost::mutex::scoped_lock lock(_mutexPublishedBodies);
+            ppublishedbodies = _pPublishedBodies;
+            newstamp = _nPublishedBodiesStamp;
+        }
+        if( !!ppublishedbodies ) {
+            _WritePublishedBodiesDelta(O, *ppublishedbodies, stamp, newstamp);
+        }
+        else {
+            _WritePublishedBodiesDelta(O, std::vector<KinBody::BodyState>(), stamp, newstamp);
+        }
+        return newstamp;
+    }
+
     virtual void UpdatePublishedBodies(uint64_t timeout=0)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        EnvironmentLock lockenv(*this);
         if( timeout == 0 ) {
-            boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+            InterfacesSharedLock lock(*this);
             _UpdatePublishedBodies();
         }
         else {
-            boost::timed_mutex::scoped_timed_lock lock(_mutexInterfaces, boost::get_system_time() + boost::posix_time::microseconds(timeout));
+            InterfacesSharedLock lock(*this, timeout);
             if (!lock.owns_lock()) {
                 throw OPENRAVE_EXCEPTION_FORMAT(_("timeout of %f s failed"),(1e-6*static_cast<double>(timeout)),ORE_Timeout);
             }
@@ -1847,28 +1966,79 @@ public:
         }
     }
 
+    /// \brief fills a free buffer of _vPublishedBodiesBuffers and publishes it, environment has to be locked.
+    ///
+    /// Published buffers are never modified, so a buffer is only refilled once no reader holds it. Its memory is recycled
+    /// and bodies whose update stamp did not change are copied from the buffer itself or from the current snapshot instead of being recomputed.
     virtual void _UpdatePublishedBodies()
     {
-        // updated the published bodies, resize dynamically in case an exception occurs
-        // when creating an item and bad data is left inside _vPublishedBodies
-        _vPublishedBodies.resize(0);
-        if( _vPublishedBodies.capacity() < _vecbodies.size() ) {
-            _vPublishedBodies.reserve(_vecbodies.size());
+        PublishedBodiesConstPtr pcurrent;
+        uint64_t nextstamp;
+        {
+            boost::mutex::scoped_lock lock(_mutexPublishedBodies);
+            pcurrent = _pPublishedBodies;
+            nextstamp = _nPublishedBodiesStamp+1;
+        }
+
+        PublishedBodiesPtr pnext;
+        FOREACH(itbuffer, _vPublishedBodiesBuffers) {
+            // a use_count of 1 means no reader holds the buffer anymore
+            if( *itbuffer != pcurrent && itbuffer->use_count() == 1 ) {
+                pnext = *itbuffer;
+                break;
+            }
+        }
+        if( !pnext ) {
+            // readers still hold all buffers, so replace one of the held ones
+            pnext.reset(new std::vector<KinBody::BodyState>());
+            FOREACH(itbuffer, _vPublishedBodiesBuffers) {
+                if( *itbuffer != pcurrent ) {
+                    *itbuffer = pnext;
+                    break;
+                }
+            }
         }
 
+        std::vector<KinBody::BodyState>& vnextbodies = *pnext;
+        vnextbodies.resize(_vecbodies.size());
         std::vector<dReal> vdoflastsetvalues;
-        FOREACH(itbody, _vecbodies) {
-            _vPublishedBodies.push_back(KinBody::BodyState());
-            KinBody::BodyState& state = _vPublishedBodies.back();
-            state.pbody = *itbody;
-            (*itbody)->GetLinkTransformations(state.vectrans, vdoflastsetvalues);
-            (*itbody)->GetDOFValues(state.jointvalues);
-            state.strname =(*itbody)->GetName();
-            state.uri = (*itbody)->GetURI();
-            state.updatestamp = (*itbody)->GetUpdateStamp();
-            state.environmentid = (*itbody)->GetEnvironmentId();
-            if( (*itbody)->IsRobot() ) {
-                RobotBasePtr probot = RaveInterfaceCast<RobotBase>(*itbody);
+        size_t iprevious = 0;
+        for(size_t ibody = 0; ibody < _vecbodies.size(); ++ibody) {
+            const KinBodyPtr& pbody = _vecbodies[ibody];
+            KinBody::BodyState& state = vnextbodies[ibody];
+            int updatestamp = pbody->GetUpdateStamp();
+            if( state.pbody != pbody || state.updatestamp != updatestamp ) {
+                // bodies are usually published in the same order, so search from the last match
+                const KinBody::BodyState* ppreviousstate = NULL;
+                if( !!pcurrent ) {
+                    for(size_t i = iprevious; i < pcurrent->size(); ++i) {
+                        if( (*pcurrent)[i].pbody == pbody ) {
+                            ppreviousstate = &(*pcurrent)[i];
+                            iprevious = i+1;
+                            break;
+                        }
+                    }
+                }
+                if( !!ppreviousstate && ppreviousstate->updatestamp == updatestamp ) {
+                    state.vectrans = ppreviousstate->vectrans;
+                    state.jointvalues = ppreviousstate->jointvalues;
+                    state.publishedstamp = ppreviousstate->publishedstamp;
+                }
+                else {
+                    pbody->GetLinkTransformations(state.vectrans, vdoflastsetvalues);
+                    pbody->GetDOFValues(state.jointvalues);
+                    state.publishedstamp = nextstamp;
+                }
+                state.pbody = pbody;
+                state.updatestamp = updatestamp;
+            }
+            state.strname = pbody->GetName();
+            state.uri = pbody->GetURI();
+            state.environmentid = pbody->GetEnvironmentId();
+            state.activeManipulatorName.clear();
+            state.activeManipulatorTransform = Transform();
+            if( pbody->IsRobot() ) {
+                RobotBasePtr probot = RaveInterfaceCast<RobotBase>(pbody);
                 if( !!probot ) {
                     RobotBase::ManipulatorPtr pmanip = probot->GetActiveManipulator();
                     if( !!pmanip ) {
@@ -1877,8 +2047,22 @@ public:
                     }
                 }
             }
-            _vPublishedBodies.push_back(state);
         }
+
+        boost::mutex::scoped_lock lock(_mutexPublishedBodies);
+        _pPublishedBodies = pnext;
+        _nPublishedBodiesStamp = nextstamp;
+    }
+
+    /// \brief publishes an empty snapshot and releases the bodies held by the buffers
+    void _ClearPublishedBodies()
+    {
+        FOREACH(itbuffer, _vPublishedBodiesBuffers) {
+            itbuffer->reset(new std::vector<KinBody::BodyState>());
+        }
+        boost::mutex::scoped_lock lock(_mutexPublishedBodies);
+        _pPublishedBodies.reset();
+        ++_nPublishedBodiesStamp;
     }
 
     virtual std::pair<std::string, dReal> GetUnit() const
@@ -1907,13 +2091,13 @@ protected:
 
     virtual bool _ParseXMLFile(BaseXMLReaderPtr preader, const std::string& filename)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        EnvironmentLock lockenv(*this);
         return OpenRAVEXMLParser::ParseXMLFile(preader, filename);
     }
 
     virtual bool _ParseXMLData(BaseXMLReaderPtr preader, const std::string& pdata)
     {
-        EnvironmentMutex::scoped_lock lockenv(GetMutex());
+        EnvironmentLock lockenv(*this);
         return OpenRAVEXMLParser::ParseXMLData(preader, pdata);
     }
 
@@ -1936,6 +2120,10 @@ protected:
         _nSimStartTime = utils::GetMicroTime();
         _nEnvironmentIndex = r->_nEnvironmentIndex;
         _bRealTime = r->_bRealTime;
+        for(int isubsystem = 0; isubsystem < SS_NumSubsystems; ++isubsystem) {
+            _vSubsystemPeriods[isubsystem] = r->_vSubsystemPeriods[isubsystem];
+        }
+        _ResetSimulationSubsystems();
 
         _bInit = true;
         _bEnableSimulation = r->_bEnableSimulation;
@@ -1945,7 +2133,7 @@ protected:
         if( !bCheckSharedResources || !(options & Clone_Bodies) ) {
             {
                 // clear internal interface lists
-                boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+                InterfacesExclusiveLock lock(*this);
                 // release all grabbed
                 FOREACH(itrobot,_vecrobots) {
                     (*itrobot)->ReleaseAllGrabbed();
@@ -1958,7 +2146,9 @@ protected:
                     (*itrobot)->Destroy();
                 }
                 _vecrobots.clear();
-                _vPublishedBodies.clear();
+                _ClearBodyNames();
+                _mapTriangulateCache.clear();
+                _ClearPublishedBodies();
             }
             // a little tricky due to a deadlocking situation
             std::map<int, KinBodyWeakPtr> mapBodies;
@@ -1966,6 +2156,7 @@ protected:
                 boost::mutex::scoped_lock locknetworkid(_mutexEnvironmentIds);
                 mapBodies = _mapBodies;
                 _mapBodies.clear();
+                _InvalidateBodiesSnapshot();
             }
             mapBodies.clear();
         }
@@ -1973,7 +2164,7 @@ protected:
         list<ViewerBasePtr> listViewers = _listViewers;
         list< pair<ModuleBasePtr, std::string> > listModules = _listModules;
         {
-            boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+            InterfacesExclusiveLock lock(*this);
             _listViewers.clear();
             _listModules.clear();
         }
@@ -1992,7 +2183,7 @@ protected:
             listModules.clear();
         }
 
-        EnvironmentMutex::scoped_lock lock(GetMutex());
+        EnvironmentLock lock(*this);
         //boost::mutex::scoped_lock locknetworkid(_mutexEnvironmentIds); // why is this here? if locked, then KinBody::_ComputeInternalInformation freezes on GetBodyFromEnvironmentId call
 
         bool bCollisionCheckerChanged = false;
@@ -2032,7 +2223,7 @@ protected:
         }
 
         if( options & Clone_Bodies ) {
-            boost::timed_mutex::scoped_lock lock(r->_mutexInterfaces);
+            InterfacesSharedLock lock(*r);
             std::vector<RobotBasePtr> vecrobots;
             std::vector<KinBodyPtr> vecbodies;
             std::vector<std::pair<Vector,Vector> > linkvelocities;
@@ -2106,6 +2297,21 @@ protected:
                 }
             }
 
+            // bodies that did not change in both environments since the last clone from r do not need their state copied
+            if( (options & Clone_SkipUnchangedBodies) && !bCollisionCheckerChanged && !bPhysicsEngineChanged && _pCloneSource.lock() == r ) {
+                list<KinBodyPtr>::iterator itbody = listToCopyState.begin();
+                while(itbody != listToCopyState.end()) {
+                    KinBodyPtr pnewbody = _mapBodies[(*itbody)->GetEnvironmentId()].lock();
+                    std::map<int, std::pair<int, int> >::const_iterator itstamps = _mapCloneUpdateStamps.find((*itbody)->GetEnvironmentId());
+                    if( !!pnewbody && itstamps != _mapCloneUpdateStamps.end() && itstamps->second.first == (*itbody)->GetUpdateStamp() && itstamps->second.second == pnewbody->GetUpdateStamp() ) {
+                        itbody = listToCopyState.erase(itbody);
+                    }
+                    else {
+                        ++itbody;
+                    }
+                }
+            }
+
             // copy state before cloning
             if( listToCopyState.size() > 0 ) {
                 FOREACH(itbody,listToCopyState) {
@@ -2182,9 +2388,31 @@ protected:
                     }
                 }
             }
+
+            {
+                // the bodies were added without going through _AddBodyName/SetEnvironmentId
+                boost::mutex::scoped_lock locknetworkid(_mutexEnvironmentIds);
+                _InvalidateBodiesSnapshot();
+            }
+            _ClearBodyNames();
+            _mapTriangulateCache.clear();
+            {
+                boost::mutex::scoped_lock lockbodynames(_mutexBodyNames);
+                _bBodyNamesDirty = true;
+            }
+
+            // remember the stamps so that the next clone from r can skip the unchanged bodies
+            _mapCloneUpdateStamps.clear();
+            FOREACHC(itbody, r->_vecbodies) {
+                KinBodyPtr pnewbody = _mapBodies[(*itbody)->GetEnvironmentId()].lock();
+                if( !!pnewbody ) {
+                    _mapCloneUpdateStamps[(*itbody)->GetEnvironmentId()] = std::make_pair((*itbody)->GetUpdateStamp(), pnewbody->GetUpdateStamp());
+                }
+            }
+            _pCloneSource = r;
         }
         if( options & Clone_Sensors ) {
-            boost::timed_mutex::scoped_lock lock(r->_mutexInterfaces);
+            InterfacesSharedLock lock(*r);
             FOREACHC(itsensor,r->_listSensors) {
                 try {
                     SensorBasePtr pnewsensor = RaveCreateSensor(shared_from_this(), (*itsensor)->GetXMLId());
@@ -2281,6 +2509,13 @@ protected:
 
     virtual bool _CheckUniqueName(KinBodyConstPtr pbody, bool bDoThrow=false) const
     {
+        KinBodyPtr pother = _FindBodyByName(pbody->GetName());
+        if( !pother || pother == pbody ) {
+            boost::mutex::scoped_lock lock(_mutexBodyNames);
+            if( !_bBodyNamesDuplicate ) {
+                return true; // the index holds all the names, so no other body can have this name
+            }
+        }
         FOREACHC(itbody,_vecbodies) {
             if(( *itbody != pbody) &&( (*itbody)->GetName() == pbody->GetName()) ) {
                 if( bDoThrow ) {
@@ -2323,15 +2558,214 @@ protected:
         BOOST_ASSERT( _mapBodies.find(id) == _mapBodies.end() );
         pbody->_environmentid=id;
         _mapBodies[id] = pbody;
+        _InvalidateBodiesSnapshot();
     }
 
     virtual void RemoveEnvironmentId(KinBodyPtr pbody)
     {
         boost::mutex::scoped_lock locknetworkid(_mutexEnvironmentIds);
         _mapBodies.erase(pbody->_environmentid);
+        _InvalidateBodiesSnapshot();
         pbody->_environmentid = 0;
     }
 
+    /// \brief drops the copy of _mapBodies read by GetBodyFromEnvironmentId, has to be called with _mutexEnvironmentIds locked after _mapBodies changes
+    inline void _InvalidateBodiesSnapshot()
+    {
+#if BOOST_VERSION >= 105300
+        boost::atomic_store(&_pmapBodiesSnapshot, boost::shared_ptr<BodyIdMap const>());
+#endif
+    }
+
+    /// \brief adds pbody to the name index, called with _mutexInterfaces exclusively locked whenever pbody is added to _vecbodies
+    void _AddBodyName(KinBodyPtr pbody)
+    {
+        UserDataPtr pcallback = pbody->RegisterChangeCallback(KinBody::Prop_Name, boost::bind(&Environment::_OnBodyNameChanged, this, pbody.get()));
+        boost::mutex::scoped_lock lock(_mutexBodyNames);
+        _mapBodyNameCallbacks[pbody.get()] = pcallback;
+        if( !_mapBodyNames.insert(make_pair(pbody->GetName(), pbody)).second ) {
+            _bBodyNamesDuplicate = true;
+        }
+    }
+
+    /// \brief removes pbody from the name index, called with _mutexInterfaces exclusively locked whenever pbody is removed from _vecbodies
+    void _RemoveBodyName(KinBodyPtr pbody)
+    {
+        UserDataPtr pcallback; // released after _mutexBodyNames since unregistering locks the body
+        boost::mutex::scoped_lock lock(_mutexBodyNames);
+        std::map<KinBody*, UserDataPtr>::iterator itcallback = _mapBodyNameCallbacks.find(pbody.get());
+        if( itcallback != _mapBodyNameCallbacks.end() ) {
+            pcallback = itcallback->second;
+            _mapBodyNameCallbacks.erase(itcallback);
+        }
+        BodyNameMap::iterator it = _mapBodyNames.find(pbody->GetName());
+        if( it != _mapBodyNames.end() && it->second == pbody ) {
+            _mapBodyNames.erase(it);
+            if( _bBodyNamesDuplicate ) {
+                // another body with the same name has to take its place
+                _bBodyNamesDirty = true;
+            }
+        }
+        else {
+            _bBodyNamesDirty = true;
+        }
+    }
+
+    /// \brief clears the name index, called with _mutexInterfaces exclusively locked whenever _vecbodies is cleared
+    /// \brief world-space triangulation of a body kept between calls to TriangulateScene
+    struct TriangulateCache
+    {
+        TriangulateCache() : updatestamp(-1) {
+        }
+        KinBodyWeakPtr pbody;
+        int updatestamp; ///< KinBody::GetUpdateStamp when ptrimesh was computed, -1 if the geometry changed since
+        UserDataPtr geometrycallback; ///< invalidates the cache when the link geometries change
+        boost::shared_ptr<TriMesh> ptrimesh; ///< never modified once it is shared outside of the cache, see TriangulateSceneMeshes
+    };
+    typedef boost::shared_ptr<TriangulateCache> TriangulateCachePtr;
+
+    static void _InvalidateTriangulateCache(boost::weak_ptr<TriangulateCache> pweakcache)
+    {
+        TriangulateCachePtr pcache = pweakcache.lock();
+        if( !!pcache ) {
+            pcache->updatestamp = -1;
+        }
+    }
+
+    /// \brief fills _vTriangulateSelected with the up to date caches of the bodies selected by options. Environment has to be locked.
+    void _UpdateTriangulateCache(SelectionOptions options, const std::string& selectname)
+    {
+        _vTriangulateSelected.resize(0);
+        _vTriangulateChanged.resize(0);
+        size_t numchangedvertices = 0;
+        FOREACH(itbody, _vecbodies) {
+            bool bselected = false;
+            switch(options) {
+            case SO_NoRobots: bselected = !(*itbody)->IsRobot(); break;
+            case SO_Robots: bselected = (*itbody)->IsRobot(); break;
+            case SO_Everything: bselected = true; break;
+            case SO_Body: bselected = (*itbody)->GetName() == selectname; break;
+            case SO_AllExceptBody: bselected = (*itbody)->GetName() != selectname; break;
+            default: break;
+            }
+            if( !bselected ) {
+                continue;
+            }
+            TriangulateCachePtr& pcache = _mapTriangulateCache[(*itbody)->GetEnvironmentId()];
+            if( !pcache || pcache->pbody.lock() != *itbody ) {
+                pcache.reset(new TriangulateCache());
+                pcache->pbody = *itbody;
+                pcache->geometrycallback = (*itbody)->RegisterChangeCallback(KinBody::Prop_LinkGeometry|KinBody::Prop_LinkGeometryGroup, boost::bind(&Environment::_InvalidateTriangulateCache, boost::weak_ptr<TriangulateCache>(pcache)));
+            }
+            if( pcache->updatestamp != (*itbody)->GetUpdateStamp() || !pcache->ptrimesh ) {
+                if( !pcache->ptrimesh || !pcache->ptrimesh.unique() ) {
+                    // the previous mesh is still held by a TriangulateSceneMeshes caller, so leave it untouched
+                    pcache->ptrimesh.reset(new TriMesh());
+                }
+                FOREACHC(itlink, (*itbody)->GetLinks()) {
+                    numchangedvertices += (*itlink)->GetCollisionData().vertices.size();
+                }
+                _vTriangulateChanged.push_back(pcache);
+            }
+            _vTriangulateSelected.push_back(pcache);
+        }
+
+        if( _vTriangulateChanged.size() > 1 && numchangedvertices >= s_nTriangulateParallelMinVertices ) {
+            if( !_pTriangulateWorkers ) {
+                int numthreads = std::max(1, std::min(4, (int)boost::thread::hardware_concurrency()));
+                _pTriangulateWorkers.reset(new ParallelRangeWorkers(numthreads, "TriangulateScene"));
+            }
+            _pTriangulateWorkers->Run(_vTriangulateChanged.size(), boost::bind(&Environment::_TriangulateChangedBodies, this, _1, _2));
+        }
+        else {
+            _TriangulateChangedBodies(0, _vTriangulateChanged.size());
+        }
+        _vTriangulateChanged.resize(0);
+
+        if( _mapTriangulateCache.size() > _vecbodies.size() ) {
+            // prune the bodies that were removed, their environment id is reset and never reused
+            std::map<int, TriangulateCachePtr>::iterator itcache = _mapTriangulateCache.begin();
+            while(itcache != _mapTriangulateCache.end()) {
+                KinBodyPtr pbody = !!itcache->second ? itcache->second->pbody.lock() : KinBodyPtr();
+                if( !pbody || pbody->GetEnvironmentId() != itcache->first ) {
+                    _mapTriangulateCache.erase(itcache++);
+                }
+                else {
+                    ++itcache;
+                }
+            }
+        }
+    }
+
+    /// \brief transforms the link meshes of _vTriangulateChanged[start:end] into world coordinates, can be called from the worker threads since it only reads the bodies
+    void _TriangulateChangedBodies(size_t start, size_t end)
+    {
+        for(size_t i = start; i < end; ++i) {
+            TriangulateCache& cache = *_vTriangulateChanged[i];
+            KinBodyPtr pbody = cache.pbody.lock();
+            TriMesh& trimesh = *cache.ptrimesh;
+            trimesh.vertices.resize(0);
+            trimesh.indices.resize(0);
+            size_t numvertices = 0, numindices = 0;
+            FOREACHC(itlink, pbody->GetLinks()) {
+                numvertices += (*itlink)->GetCollisionData().vertices.size();
+                numindices += (*itlink)->GetCollisionData().indices.size();
+            }
+            trimesh.vertices.reserve(numvertices);
+            trimesh.indices.reserve(numindices);
+            FOREACHC(itlink, pbody->GetLinks()) {
+                trimesh.Append((*itlink)->GetCollisionData(), (*itlink)->GetTransform());
+            }
+            cache.updatestamp = pbody->GetUpdateStamp();
+        }
+    }
+
+    void _ClearBodyNames()
+    {
+        std::map<KinBody*, UserDataPtr> mapcallbacks; // released after _mutexBodyNames since unregistering locks the bodies
+        boost::mutex::scoped_lock lock(_mutexBodyNames);
+        mapcallbacks.swap(_mapBodyNameCallbacks);
+        _mapBodyNames.clear();
+        _bBodyNamesDirty = false;
+        _bBodyNamesDuplicate = false;
+    }
+
+    /// \brief called from KinBody::SetName, marks the name index for rebuilding if the body is not indexed with its new name
+    void _OnBodyNameChanged(KinBody* pbody) const
+    {
+        boost::mutex::scoped_lock lock(_mutexBodyNames);
+        BodyNameMap::const_iterator it = _mapBodyNames.find(pbody->GetName());
+        if( it == _mapBodyNames.end() || it->second.get() != pbody ) {
+            _bBodyNamesDirty = true;
+        }
+    }
+
+    /// \brief returns the first body of _vecbodies with the name, _mutexInterfaces has to be locked
+    ///
+    /// The index is rebuilt from _vecbodies after bodies were renamed or cloned.
+    KinBodyPtr _FindBodyByName(const std::string& name) const
+    {
+        boost::mutex::scoped_lock lock(_mutexBodyNames);
+        if( _bBodyNamesDirty ) {
+            _mapBodyNames.clear();
+            _bBodyNamesDuplicate = false;
+            FOREACHC(itbody, _vecbodies) {
+                if( !_mapBodyNames.insert(make_pair((*itbody)->GetName(), *itbody)).second ) {
+                    _bBodyNamesDuplicate = true;
+                }
+                if( _mapBodyNameCallbacks.find(itbody->get()) == _mapBodyNameCallbacks.end() ) {
+                    _mapBodyNameCallbacks[itbody->get()] = (*itbody)->RegisterChangeCallback(KinBody::Prop_Name, boost::bind(&Environment::_OnBodyNameChanged, this, itbody->get()));
+                }
+            }
+            _bBodyNamesDirty = false;
+        }
+        BodyNameMap::const_iterator it = _mapBodyNames.find(name);
+        if( it != _mapBodyNames.end() ) {
+            return it->second;
+        }
+        return KinBodyPtr();
+    }
+
     void _StartSimulationThread()
     {
         if( !_threadSimulation ) {
@@ -2349,6 +2783,129 @@ protected:
         }
     }
 
+    /// \brief resets the subsystem accumulators and the simulation statistics, the periods are kept
+    void _ResetSimulationSubsystems()
+    {
+        for(int isubsystem = 0; isubsystem < SS_NumSubsystems; ++isubsystem) {
+            _vSubsystemAccumTime[isubsystem] = 0;
+            _vSubsystemBusyUntil[isubsystem] = 0;
+        }
+        boost::mutex::scoped_lock lock(_mutexSimulationStatistics);
+        _simulationstatistics = SimulationStatistics();
+        _nStatisticsStartSimTime = _nCurSimTime;
+        _nStatisticsStartRealTime = utils::GetMicroTime();
+    }
+
+    /// \brief accumulates step into the subsystem and returns true if it has to be stepped, environment has to be locked
+    ///
+    /// \param simtime the simulation time at the end of this step
+    /// \param[out] substep the time step of the subsystem (us)
+    bool _IsSubsystemDue(int isubsystem, uint64_t step, uint64_t simtime, bool bSkipOverruns, uint64_t& substep)
+    {
+        _vSubsystemAccumTime[isubsystem] += step;
+        if( (double)_vSubsystemAccumTime[isubsystem] < 1000000.0*(double)_vSubsystemPeriods[isubsystem] ) {
+            return false;
+        }
+        if( bSkipOverruns && simtime < _vSubsystemBusyUntil[isubsystem] ) {
+            // still overrunning, coalesce the tick into the next step
+            boost::mutex::scoped_lock lock(_mutexSimulationStatistics);
+            _simulationstatistics.subsystems[isubsystem].numSkippedTicks += 1;
+            return false;
+        }
+        substep = _vSubsystemAccumTime[isubsystem];
+        _vSubsystemAccumTime[isubsystem] = 0;
+        return true;
+    }
+
+    /// \brief records the real time a subsystem took for a step of substep simulation time
+    void _RecordSubsystemStep(int isubsystem, uint64_t substep, uint64_t simtime, uint64_t steptime, bool bSkipOverruns)
+    {
+        bool bOverrun = steptime > substep;
+        if( bOverrun && bSkipOverruns ) {
+            _vSubsystemBusyUntil[isubsystem] = simtime + steptime;
+        }
+        boost::mutex::scoped_lock lock(_mutexSimulationStatistics);
+        SimulationStatistics::SubsystemStatistics& substats = _simulationstatistics.subsystems[isubsystem];
+        substats.numSteps += 1;
+        substats.totalStepTime += steptime;
+        substats.maxStepTime = max(substats.maxStepTime, steptime);
+        if( bOverrun ) {
+            substats.numOverruns += 1;
+        }
+    }
+
+    /// \brief steps the subsystems that are due
+    ///
+    /// \param bSkipOverruns if true, skips the ticks of subsystems that are overrunning in real time. Only the real-time simulation thread sets it so that manual stepping stays deterministic.
+    void _StepSimulation(dReal fTimeStep, bool bSkipOverruns)
+    {
+        EnvironmentLock lockenv(*this);
+
+        uint64_t step = (uint64_t)ceil(1000000.0 * (double)fTimeStep);
+        uint64_t simtime = _nCurSimTime + step;
+        uint64_t vsubsteps[SS_NumSubsystems];
+        bool vdue[SS_NumSubsystems];
+        for(int isubsystem = 0; isubsystem < SS_NumSubsystems; ++isubsystem) {
+            vdue[isubsystem] = _IsSubsystemDue(isubsystem, step, simtime, bSkipOverruns, vsubsteps[isubsystem]);
+        }
+
+        // call the physics first to get forces
+        if( vdue[SS_Physics] ) {
+            uint64_t starttime = utils::GetMicroTime();
+            _pPhysicsEngine->SimulateStep((dReal)((double)vsubsteps[SS_Physics] * 0.000001));
+            _RecordSubsystemStep(SS_Physics, vsubsteps[SS_Physics], simtime, utils::GetMicroTime()-starttime, bSkipOverruns);
+        }
+
+        if( vdue[SS_Controllers] || vdue[SS_Sensors] ) {
+            // make a copy instead of locking the mutex pointer since will be calling into user functions
+            vector<KinBodyPtr> vecbodies;
+            vector<RobotBasePtr> vecrobots;
+            list<SensorBasePtr> listSensors;
+            list< pair<ModuleBasePtr, std::string> > listModules;
+            {
+                InterfacesSharedLock lock(*this);
+                vecbodies = _vecbodies;
+                vecrobots = _vecrobots;
+                listSensors = _listSensors;
+                listModules = _listModules;
+            }
+
+            if( vdue[SS_Controllers] ) {
+                uint64_t starttime = utils::GetMicroTime();
+                dReal fSubTimeStep = (dReal)((double)vsubsteps[SS_Controllers] * 0.000001);
+                FOREACH(it, vecbodies) {
+                    if( (*it)->GetEnvironmentId() ) {     // have to check if valid
+                        (*it)->SimulationStep(fSubTimeStep);
+                    }
+                }
+                FOREACH(itmodule, listModules) {
+                    itmodule->first->SimulationStep(fSubTimeStep);
+                }
+                _RecordSubsystemStep(SS_Controllers, vsubsteps[SS_Controllers], simtime, utils::GetMicroTime()-starttime, bSkipOverruns);
+            }
+
+            // simulate the sensors last (ie, they always reflect the most recent bodies
+            if( vdue[SS_Sensors] ) {
+                uint64_t starttime = utils::GetMicroTime();
+                dReal fSubTimeStep = (dReal)((double)vsubsteps[SS_Sensors] * 0.000001);
+                FOREACH(itsensor, listSensors) {
+                    (*itsensor)->SimulationStep(fSubTimeStep);
+                }
+                FOREACH(itrobot, vecrobots) {
+                    FOREACH(itsensor, (*itrobot)->GetAttachedSensors()) {
+                        if( !!(*itsensor)->GetSensor() ) {
+                            (*itsensor)->GetSensor()->SimulationStep(fSubTimeStep);
+                        }
+                    }
+                }
+                _RecordSubsystemStep(SS_Sensors, vsubsteps[SS_Sensors], simtime, utils::GetMicroTime()-starttime, bSkipOverruns);
+            }
+        }
+        _nCurSimTime = simtime;
+        boost::mutex::scoped_lock lock(_mutexSimulationStatistics);
+        _simulationstatistics.numSteps += 1;
+    }
+
     void _SimulationThread()
     {
         int environmentid = RaveGetEnvironmentId(shared_from_this());
@@ -2366,7 +2923,7 @@ protected:
                     //Get deltasimtime in microseconds
                     int64_t deltasimtime = (int64_t)(_fDeltaSimTime*1000000.0f);
                     try {
-                        StepSimulation(_fDeltaSimTime);
+                        _StepSimulation(_fDeltaSimTime, _bRealTime);
                     }
                     catch(const std::exception &ex) {
                         RAVELOG_ERROR("simulation thread exception: %s\n",ex.what());
@@ -2390,6 +2947,8 @@ protected:
                             // simulation is getting late, so catch up (doesn't happen often in light loads)
                             //RAVELOG_INFO("sim catching up: %d\n",-(int)sleeptime);
                             _nSimStartTime += -sleeptime;     //deltasimtime;
+                            boost::mutex::scoped_lock lockstats(_mutexSimulationStatistics);
+                            _simulationstatistics.numLateSteps += 1;
                         }
                     }
                     else {
@@ -2431,12 +2990,20 @@ protected:
         }
     }
 
+    /// \brief adds a contended lock acquisition to the lock statistics
+    void _RecordLockContention(uint64_t LockStatistics::* pcount, uint64_t LockStatistics::* pwaittime, uint64_t waittime) const
+    {
+        boost::mutex::scoped_lock lock(_mutexLockStatistics);
+        _lockstatistics.*pcount += 1;
+        _lockstatistics.*pwaittime += waittime;
+    }
+
     /// _mutexInterfaces should not be locked
     void _CallBodyCallbacks(KinBodyPtr pbody, int action)
     {
         std::list<UserDataWeakPtr> listRegisteredBodyCallbacks;
         {
-            boost::timed_mutex::scoped_lock lock(_mutexInterfaces);
+            InterfacesSharedLock lock(*this);
             listRegisteredBodyCallbacks = _listRegisteredBodyCallbacks;
         }
         FOREACH(it, listRegisteredBodyCallbacks) {
@@ -2566,21 +3133,44 @@ protected:
     uint64_t _nCurSimTime;                        ///< simulation time since the start of the environment
     uint64_t _nSimStartTime;
     int _nBodiesModifiedStamp;     ///< incremented every tiem bodies vector is modified
+    boost::weak_ptr<Environment const> _pCloneSource; ///< the environment the bodies were last cloned from
+    std::map<int, std::pair<int, int> > _mapCloneUpdateStamps; ///< environment id -> (update stamp of the body in _pCloneSource, update stamp of the body in this environment) right after the last clone
 
     CollisionCheckerBasePtr _pCurrentChecker;
     PhysicsEngineBasePtr _pPhysicsEngine;
 
     int _nEnvironmentIndex;                   ///< next network index
     std::map<int, KinBodyWeakPtr> _mapBodies;     ///< a map of all the bodies in the environment. Controlled through the KinBody constructor and destructors
+    typedef std::map<int, KinBodyWeakPtr> BodyIdMap;
+    mutable boost::shared_ptr<BodyIdMap const> _pmapBodiesSnapshot; ///< copy of _mapBodies read by GetBodyFromEnvironmentId without locking, empty when it has to be rebuilt. Only accessed atomically.
+
+    typedef boost::unordered_map<std::string, KinBodyPtr> BodyNameMap;
+    mutable BodyNameMap _mapBodyNames; ///< the first body of _vecbodies with each name, see _FindBodyByName. Protected by _mutexBodyNames
+    mutable std::map<KinBody*, UserDataPtr> _mapBodyNameCallbacks; ///< the Prop_Name callbacks of the bodies in _vecbodies, protected by _mutexBodyNames
+    mutable bool _bBodyNamesDirty; ///< if true, _mapBodyNames has to be rebuilt from _vecbodies
+    mutable bool _bBodyNamesDuplicate; ///< if true, some bodies of _vecbodies share a name and are not all in _mapBodyNames
+    mutable boost::mutex _mutexBodyNames; ///< protects the name index. Never held while calling into other locks except to (un)register the name callbacks of the bodies
+
+    std::map<int, TriangulateCachePtr> _mapTriangulateCache; ///< environment id -> world-space triangulation, see TriangulateScene. Protected by the environment lock
+    std::vector<TriangulateCachePtr> _vTriangulateSelected, _vTriangulateChanged; ///< cache of _UpdateTriangulateCache
+    ParallelRangeWorkersPtr _pTriangulateWorkers; ///< transforms the changed bodies of big scenes in parallel, created on first use
+    static const size_t s_nTriangulateParallelMinVertices = 20000; ///< minimum number of vertices to transform for using _pTriangulateWorkers
 
     boost::shared_ptr<boost::thread> _threadSimulation;                      ///< main loop for environment simulation
 
     mutable EnvironmentMutex _mutexEnvironment;          ///< protects internal data from multithreading issues
     mutable boost::mutex _mutexEnvironmentIds;      ///< protects _vecbodies/_vecrobots from multithreading issues
-    mutable boost::timed_mutex _mutexInterfaces;     ///< lock when managing interfaces like _listOwnedInterfaces, _listModules, _mapBodies
+    mutable boost::shared_mutex _mutexInterfaces;     ///< lock when managing interfaces like _listOwnedInterfaces, _listModules, _mapBodies. Use InterfacesSharedLock when only reading them.
+    mutable boost::mutex _mutexLockStatistics; ///< protects _lockstatistics
+    mutable LockStatistics _lockstatistics; ///< contention counters of _mutexEnvironment and _mutexInterfaces, see EnvironmentBase::GetLockStatistics
     mutable boost::mutex _mutexInit;     ///< lock for destroying the environment
 
-    vector<KinBody::BodyState> _vPublishedBodies;
+    typedef boost::shared_ptr< std::vector<KinBody::BodyState> > PublishedBodiesPtr;
+    typedef boost::shared_ptr< std::vector<KinBody::BodyState> const > PublishedBodiesConstPtr;
+    mutable boost::mutex _mutexPublishedBodies; ///< protects _pPublishedBodies and _nPublishedBodiesStamp, only held to copy them
+    PublishedBodiesConstPtr _pPublishedBodies; ///< the latest published snapshot, never modified after it is published
+    uint64_t _nPublishedBodiesStamp; ///< incremented every time _pPublishedBodies changes
+    boost::array<PublishedBodiesPtr, 3> _vPublishedBodiesBuffers; ///< the published, the being filled, and a spare buffer that a slow reader can hold on to. Only accessed with the environment locked
     string _homedirectory;
     std::pair<std::string, dReal> _unit; ///< unit name mm, cm, inches, m and the conversion for meters
 
@@ -2595,6 +3185,12 @@ protected:
     bool _bEnableSimulation;            ///< enable simulation loop
     bool _bShutdownSimulation; ///< if true, the simulation thread should shutdown
     bool _bRealTime;
+    dReal _vSubsystemPeriods[SS_NumSubsystems]; ///< see EnvironmentBase::SetSimulationSubsystemPeriod
+    uint64_t _vSubsystemAccumTime[SS_NumSubsystems]; ///< simulation time accumulated since the last step of each subsystem (us)
+    uint64_t _vSubsystemBusyUntil[SS_NumSubsystems]; ///< simulation time before which an overrunning subsystem is not stepped by the simulation thread (us)
+    mutable boost::mutex _mutexSimulationStatistics; ///< protects _simulationstatistics
+    SimulationStatistics _simulationstatistics; ///< see EnvironmentBase::GetSimulationStatistics
+    uint64_t _nStatisticsStartSimTime, _nStatisticsStartRealTime; ///< simulation and real time when _simulationstatistics was reset (us)
 
     friend class EnvironmentXMLReader;
 };
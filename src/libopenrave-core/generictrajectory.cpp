@@ -24,11 +24,13 @@ namespace OpenRAVE {
 static const dReal g_fEpsilonLinear = RavePow(g_fEpsilon,0.9);
 static const dReal g_fEpsilonQuadratic = RavePow(g_fEpsilon,0.45); // should be 0.6...perhaps this is related to parabolic smoother epsilons?
 
+class GenericTrajectorySampler;
+
 class GenericTrajectory : public TrajectoryBase
 {
     std::map<string,int> _maporder;
 public:
-    GenericTrajectory(EnvironmentBasePtr penv, std::istream& sinput) : TrajectoryBase(penv), _timeoffset(-1)
+    GenericTrajectory(EnvironmentBasePtr penv, std::istream& sinput) : TrajectoryBase(penv), _timeoffset(-1), _specversion(0), _nNumTimedWaypoints(0)
     {
         _maporder["deltatime"] = 0;
         _maporder["joint_snaps"] = 1;
@@ -43,7 +45,26 @@ public:
         _maporder["affine_transform"] = 10;
         _maporder["joint_torques"] = 11;
         _bInit = false;
+        _bCompact = false;
         _bSamplingVerified = false;
+        RegisterCommand("SetCompactStorage",boost::bind(&GenericTrajectory::_SetCompactStorageCommand,this,_1,_2),
+                        "compact - if 1, stores the waypoints in single precision except for the deltatime values, which halves the memory of trajectories that are kept for caching and replay. Sampling converts the waypoints it needs back to double precision. Modifying a trajectory in the compact storage converts all of its waypoints, so it is meant for trajectories that are sampled far more often than modified. Default is 0.");
+        RegisterCommand("GetCompactStorage",boost::bind(&GenericTrajectory::_GetCompactStorageCommand,this,_1,_2),
+                        "returns 1 if the waypoints are stored in single precision");
+    }
+
+    /// \brief sets whether the waypoints are stored in single precision, see the SetCompactStorage command
+    void SetCompactStorage(bool bCompact)
+    {
+        if( _bInit ) {
+            if( bCompact ) {
+                _CompactData();
+            }
+            else {
+                _ExpandData();
+            }
+        }
+        _bCompact = bCompact;
     }
 
     bool SortGroups(const ConfigurationSpecification::Group& g1, const ConfigurationSpecification::Group& g2)
@@ -81,6 +102,7 @@ public:
             _vddoffsets.resize(0);
             _vdddoffsets.resize(0);
             _vintegraloffsets.resize(0);
+            _vcachedconverters.resize(0);
             _spec = spec;
             // order the groups based on computation order
             stable_sort(_spec._vgroups.begin(),_spec._vgroups.end(),boost::bind(&GenericTrajectory::SortGroups,this,_1,_2));
@@ -93,9 +115,12 @@ public:
             _InitializeGroupFunctions();
         }
         _vtrajdata.resize(0);
+        _vcompactdata.resize(0);
+        _vcompactdeltatimes.resize(0);
+        _vexpandeddata.resize(0);
         _vaccumtime.resize(0);
         _vdeltainvtime.resize(0);
-        _bChanged = true;
+        _InvalidateTimes(0);
         _bSamplingVerified = false;
         _bInit = true;
     }
@@ -108,7 +133,8 @@ public:
         }
         BOOST_ASSERT(_spec.GetDOF()>0);
         OPENRAVE_ASSERT_FORMAT((data.size()%_spec.GetDOF()) == 0, "%d does not divide dof %d", data.size()%_spec.GetDOF(), ORE_InvalidArguments);
-        OPENRAVE_ASSERT_OP(index*_spec.GetDOF(),<=,_vtrajdata.size());
+        OPENRAVE_ASSERT_OP(index,<=,GetNumWaypoints());
+        _ExpandData();
         if( bOverwrite && index*_spec.GetDOF() < _vtrajdata.size() ) {
             size_t copysize = min(data.size(),_vtrajdata.size()-index*_spec.GetDOF());
             std::copy(data.begin(),data.begin()+copysize,_vtrajdata.begin()+index*_spec.GetDOF());
@@ -119,7 +145,10 @@ public:
         else {
             _vtrajdata.insert(_vtrajdata.begin()+index*_spec.GetDOF(),data.begin(),data.end());
         }
-        _bChanged = true;
+        _InvalidateTimes(index);
+        if( _bCompact ) {
+            _CompactData();
+        }
     }
 
     void Insert(size_t index, const std::vector<dReal>& data, const ConfigurationSpecification& spec, bool bOverwrite)
@@ -130,11 +159,12 @@ public:
         }
         BOOST_ASSERT(spec.GetDOF()>0);
         OPENRAVE_ASSERT_FORMAT((data.size()%spec.GetDOF()) == 0, "%d does not divide dof %d", data.size()%spec.GetDOF(), ORE_InvalidArguments);
-        OPENRAVE_ASSERT_OP(index*_spec.GetDOF(),<=,_vtrajdata.size());
+        OPENRAVE_ASSERT_OP(index,<=,GetNumWaypoints());
         if( _spec == spec ) {
             Insert(index,data,bOverwrite);
         }
         else {
+            _ExpandData();
             std::vector< std::vector<ConfigurationSpecification::Group>::const_iterator > vconvertgroups(_spec._vgroups.size());
             for(size_t i = 0; i < vconvertgroups.size(); ++i) {
                 vconvertgroups[i] = spec.FindCompatibleGroup(_spec._vgroups[i]);
@@ -159,7 +189,10 @@ public:
                 _ConvertData(ittargetdata,itsourcedata,vconvertgroups,spec,numelements,true);
                 _vtrajdata.insert(_vtrajdata.begin()+index*_spec.GetDOF(),vtemp.begin(),vtemp.end());
             }
-            _bChanged = true;
+            _InvalidateTimes(index);
+            if( _bCompact ) {
+                _CompactData();
+            }
         }
     }
 
@@ -169,80 +202,45 @@ public:
         if( startindex == endindex ) {
             return;
         }
-        BOOST_ASSERT(startindex*_spec.GetDOF() <= _vtrajdata.size() && endindex*_spec.GetDOF() <= _vtrajdata.size());
+        BOOST_ASSERT(startindex <= GetNumWaypoints() && endindex <= GetNumWaypoints());
         OPENRAVE_ASSERT_OP(startindex,<,endindex);
+        _ExpandData();
         _vtrajdata.erase(_vtrajdata.begin()+startindex*_spec.GetDOF(),_vtrajdata.begin()+endindex*_spec.GetDOF());
-        _bChanged = true;
+        _InvalidateTimes(startindex);
+        if( _bCompact ) {
+            _CompactData();
+        }
     }
 
     void Sample(std::vector<dReal>& data, dReal time) const
     {
-        BOOST_ASSERT(_bInit);
-        BOOST_ASSERT(_timeoffset>=0);
         BOOST_ASSERT(time >= 0);
-        _ComputeInternal();
-        if( IS_DEBUGLEVEL(Level_Verbose) || (RaveGetDebugLevel() & Level_VerifyPlans) ) {
-            _VerifySampling();
-        }
-        data.resize(0);
-        data.resize(_spec.GetDOF(),0);
-        if( time >= GetDuration() ) {
-            std::copy(_vtrajdata.end()-_spec.GetDOF(),_vtrajdata.end(),data.begin());
-        }
-        else {
-            std::vector<dReal>::iterator it = std::lower_bound(_vaccumtime.begin(),_vaccumtime.end(),time);
-            if( it == _vaccumtime.begin() ) {
-                std::copy(_vtrajdata.begin(),_vtrajdata.begin()+_spec.GetDOF(),data.begin());
-            }
-            else {
-                size_t index = it-_vaccumtime.begin();
-                dReal deltatime = time-_vaccumtime.at(index-1);
-                for(size_t i = 0; i < _vgroupinterpolators.size(); ++i) {
-                    if( !!_vgroupinterpolators[i] ) {
-                        _vgroupinterpolators[i](index-1,deltatime,data);
-                    }
-                }
-                // should return the sample time relative to the last endpoint so it is easier to re-insert in the trajectory
-                data.at(_timeoffset) = deltatime;
-            }
-        }
+        _PrepareSampling();
+        std::vector<dReal> vinternaldata(_spec.GetDOF(),0), vsegmentdata;
+        // should return the sample time relative to the last endpoint so it is easier to re-insert in the trajectory
+        std::vector<dReal>::const_iterator itsource = _SampleIndex(_FindTimeIndex(time,0),time,vinternaldata,vsegmentdata,true);
+        data.resize(_spec.GetDOF());
+        std::copy(itsource,itsource+_spec.GetDOF(),data.begin());
     }
 
     void Sample(std::vector<dReal>& data, dReal time, const ConfigurationSpecification& spec) const
     {
-        BOOST_ASSERT(_bInit);
-        OPENRAVE_ASSERT_OP(_timeoffset,>=,0);
         OPENRAVE_ASSERT_OP(time, >=, -g_fEpsilon);
-        _ComputeInternal();
-        OPENRAVE_ASSERT_OP_FORMAT0((int)_vtrajdata.size(),>=,_spec.GetDOF(), "trajectory needs at least one point to sample from", ORE_InvalidArguments);
-        if( IS_DEBUGLEVEL(Level_Verbose) || (RaveGetDebugLevel() & Level_VerifyPlans) ) {
-            _VerifySampling();
-        }
+        _PrepareSampling();
+        std::vector<dReal> vinternaldata(_spec.GetDOF(),0), vsegmentdata;
+        std::vector<dReal>::const_iterator itsource = _SampleIndex(_FindTimeIndex(time,0),time,vinternaldata,vsegmentdata,false);
         data.resize(0);
         data.resize(spec.GetDOF(),0);
-        if( time >= GetDuration() ) {
-            ConfigurationSpecification::ConvertData(data.begin(),spec,_vtrajdata.end()-_spec.GetDOF(),_spec,1,GetEnv());
-        }
-        else {
-            std::vector<dReal>::iterator it = std::lower_bound(_vaccumtime.begin(),_vaccumtime.end(),time);
-            if( it == _vaccumtime.begin() ) {
-                ConfigurationSpecification::ConvertData(data.begin(),spec,_vtrajdata.begin(),_spec,1,GetEnv());
-            }
-            else {
-                // could be faster
-                vector<dReal> vinternaldata(_spec.GetDOF(),0);
-                size_t index = it-_vaccumtime.begin();
-                dReal deltatime = time-_vaccumtime.at(index-1);
-                for(size_t i = 0; i < _vgroupinterpolators.size(); ++i) {
-                    if( !!_vgroupinterpolators[i] ) {
-                        _vgroupinterpolators[i](index-1,deltatime,vinternaldata);
-                    }
-                }
-                ConfigurationSpecification::ConvertData(data.begin(),spec,vinternaldata.begin(),_spec,1,GetEnv());
-            }
-        }
+        _GetConverter(spec)->Convert(data.begin(),itsource,1);
     }
 
+    void SamplePoints(std::vector<dReal>& data, const std::vector<dReal>& times) const;
+    void SamplePoints(std::vector<dReal>& data, const std::vector<dReal>& times, const ConfigurationSpecification& spec) const;
+    void SamplePointsSameDeltaTime(std::vector<dReal>& data, dReal deltatime, bool ensureLastPoint) const;
+    void SamplePointsSameDeltaTime(std::vector<dReal>& data, dReal deltatime, bool ensureLastPoint, const ConfigurationSpecification& spec) const;
+
+    SamplerPtr CreateSampler(const ConfigurationSpecification& spec) const;
+
     const ConfigurationSpecification& GetConfigurationSpecification() const
     {
         return _spec;
@@ -251,25 +249,54 @@ public:
     size_t GetNumWaypoints() const
     {
         BOOST_ASSERT(_bInit);
-        return _vtrajdata.size()/_spec.GetDOF();
+        // only one of the storages holds the waypoints
+        return (_vtrajdata.size()+_vcompactdata.size())/_spec.GetDOF();
     }
 
     void GetWaypoints(size_t startindex, size_t endindex, std::vector<dReal>& data) const
     {
         BOOST_ASSERT(_bInit);
-        BOOST_ASSERT(startindex<=endindex && startindex*_spec.GetDOF() <= _vtrajdata.size() && endindex*_spec.GetDOF() <= _vtrajdata.size());
+        BOOST_ASSERT(startindex<=endindex && endindex <= GetNumWaypoints());
         data.resize((endindex-startindex)*_spec.GetDOF(),0);
-        std::copy(_vtrajdata.begin()+startindex*_spec.GetDOF(),_vtrajdata.begin()+endindex*_spec.GetDOF(),data.begin());
+        if( _IsStoredCompact() ) {
+            _ExpandWaypoints(startindex,endindex,data.begin());
+        }
+        else {
+            std::copy(_vtrajdata.begin()+startindex*_spec.GetDOF(),_vtrajdata.begin()+endindex*_spec.GetDOF(),data.begin());
+        }
     }
 
     void GetWaypoints(size_t startindex, size_t endindex, std::vector<dReal>& data, const ConfigurationSpecification& spec) const
     {
         BOOST_ASSERT(_bInit);
-        BOOST_ASSERT(startindex<=endindex && startindex*_spec.GetDOF() <= _vtrajdata.size() && endindex*_spec.GetDOF() <= _vtrajdata.size());
+        BOOST_ASSERT(startindex<=endindex && endindex <= GetNumWaypoints());
         data.resize(spec.GetDOF()*(endindex-startindex),0);
         if( startindex < endindex ) {
-            ConfigurationSpecification::ConvertData(data.begin(),spec,_vtrajdata.begin()+startindex*_spec.GetDOF(),_spec,endindex-startindex,GetEnv());
+            if( _IsStoredCompact() ) {
+                std::vector<dReal> vexpanded((endindex-startindex)*_spec.GetDOF());
+                _ExpandWaypoints(startindex,endindex,vexpanded.begin());
+                _GetConverter(spec)->Convert(data.begin(),vexpanded.begin(),endindex-startindex);
+            }
+            else {
+                _GetConverter(spec)->Convert(data.begin(),_vtrajdata.begin()+startindex*_spec.GetDOF(),endindex-startindex);
+            }
+        }
+    }
+
+    const dReal* GetWaypointsData(size_t startindex) const
+    {
+        BOOST_ASSERT(_bInit);
+        if( startindex >= GetNumWaypoints() ) {
+            return NULL;
+        }
+        if( _IsStoredCompact() ) {
+            if( _vexpandeddata.size() != _vcompactdata.size() ) {
+                _vexpandeddata.resize(_vcompactdata.size());
+                _ExpandWaypoints(0,GetNumWaypoints(),_vexpandeddata.begin());
+            }
+            return &_vexpandeddata[startindex*_spec.GetDOF()];
         }
+        return &_vtrajdata[startindex*_spec.GetDOF()];
     }
 
     size_t GetFirstWaypointIndexAfterTime(dReal time) const
@@ -299,9 +326,15 @@ public:
 
     void serialize(std::ostream& O, int options) const
     {
+        std::vector<dReal> vexpanded;
+        const std::vector<dReal>& vtrajdata = _GetExpandedData(vexpanded);
+        if( options & SO_BinaryTrajectory ) {
+            _SerializeBinary(O, _spec, vtrajdata.size() > 0 ? &vtrajdata[0] : NULL, GetNumWaypoints(), options);
+            return;
+        }
         O << "<trajectory>" << endl << _spec;
         O << "<data count=\"" << GetNumWaypoints() << "\">" << endl;
-        FOREACHC(it,_vtrajdata) {
+        FOREACHC(it,vtrajdata) {
             O << *it << " ";
         }
         O << "</data>" << endl;
@@ -319,13 +352,40 @@ public:
         O << "</trajectory>" << endl;
     }
 
+    InterfaceBasePtr deserialize(std::istream& I)
+    {
+        if( !_IsBinaryFormat(I) ) {
+            return TrajectoryBase::deserialize(I);
+        }
+        ConfigurationSpecification spec;
+        size_t numwaypoints = 0;
+        _DeserializeBinaryHeader(I, spec, numwaypoints);
+        Init(spec);
+        // read directly into the waypoint buffer
+        _vtrajdata.resize(numwaypoints*_spec.GetDOF());
+        _DeserializeBinaryData(I, _vtrajdata.size() > 0 ? &_vtrajdata[0] : NULL, _vtrajdata.size());
+        _InvalidateTimes(0);
+        if( _bCompact ) {
+            _CompactData();
+        }
+        _DeserializeBinaryFooter(I);
+        return shared_from_this();
+    }
+
     void Clone(InterfaceBaseConstPtr preference, int cloningoptions)
     {
         InterfaceBase::Clone(preference,cloningoptions);
         TrajectoryBaseConstPtr r = RaveInterfaceConstCast<TrajectoryBase>(preference);
         Init(r->GetConfigurationSpecification());
         r->GetWaypoints(0,r->GetNumWaypoints(),_vtrajdata);
-        _bChanged = true;
+        _InvalidateTimes(0);
+        boost::shared_ptr<GenericTrajectory const> pgeneric = boost::dynamic_pointer_cast<GenericTrajectory const>(r);
+        if( !!pgeneric ) {
+            _bCompact = pgeneric->_bCompact;
+        }
+        if( _bCompact ) {
+            _CompactData();
+        }
     }
 
     void Swap(TrajectoryBasePtr rawtraj)
@@ -340,14 +400,211 @@ public:
         std::swap(_timeoffset, traj->_timeoffset);
         std::swap(_bInit, traj->_bInit);
         std::swap(_vtrajdata, traj->_vtrajdata);
+        std::swap(_vcompactdata, traj->_vcompactdata);
+        std::swap(_vcompactdeltatimes, traj->_vcompactdeltatimes);
+        std::swap(_vexpandeddata, traj->_vexpandeddata);
+        std::swap(_bCompact, traj->_bCompact);
         std::swap(_vaccumtime, traj->_vaccumtime);
         std::swap(_vdeltainvtime, traj->_vdeltainvtime);
         std::swap(_bChanged, traj->_bChanged);
+        std::swap(_nNumTimedWaypoints, traj->_nNumTimedWaypoints);
         std::swap(_bSamplingVerified, traj->_bSamplingVerified);
         _InitializeGroupFunctions();
+        traj->_InitializeGroupFunctions();
     }
 
 protected:
+    /// \brief returns the index of the first accumulated time >= time, same as std::lower_bound.
+    ///
+    /// Checks the segment ending at hint and the one after it before falling back to a binary search, which only covers the
+    /// segments after hint when time is past it. assumes _ComputeInternal has finished
+    size_t _FindTimeIndex(dReal time, size_t hint) const
+    {
+        std::vector<dReal>::iterator itbegin = _vaccumtime.begin();
+        if( hint > 0 && hint < _vaccumtime.size() && _vaccumtime[hint-1] < time ) {
+            if( time <= _vaccumtime[hint] ) {
+                return hint;
+            }
+            if( hint+1 < _vaccumtime.size() && time <= _vaccumtime[hint+1] ) {
+                return hint+1;
+            }
+            itbegin += hint+1;
+        }
+        return std::lower_bound(itbegin,_vaccumtime.end(),time)-_vaccumtime.begin();
+    }
+
+    /// \brief samples the trajectory at time given the index returned by _FindTimeIndex. assumes _ComputeInternal has finished
+    ///
+    /// \param vinternaldata temporary buffer of size _spec.GetDOF() that interpolated points are written to
+    /// \param vsegmentdata temporary buffer for _GetSegmentData
+    /// \param bSetDeltaTime if true, the deltatime of interpolated points is set to the time from the previous waypoint like \ref Sample does
+    /// \return the sampled point, which is either in _vtrajdata or vinternaldata
+    std::vector<dReal>::const_iterator _SampleIndex(size_t index, dReal time, std::vector<dReal>& vinternaldata, std::vector<dReal>& vsegmentdata, bool bSetDeltaTime) const
+    {
+        if( time >= _vaccumtime.back() || index == 0 ) {
+            size_t ipoint = time >= _vaccumtime.back() ? _vaccumtime.size()-1 : 0;
+            if( _IsStoredCompact() ) {
+                _ExpandWaypoints(ipoint,ipoint+1,vinternaldata.begin());
+                return vinternaldata.begin();
+            }
+            return _vtrajdata.begin()+ipoint*_spec.GetDOF();
+        }
+        std::fill(vinternaldata.begin(),vinternaldata.end(),dReal(0));
+        dReal deltatime = time-_vaccumtime[index-1];
+        const dReal* psegment = _GetSegmentData(index-1,vsegmentdata);
+        for(size_t i = 0; i < _vgroupinterpolators.size(); ++i) {
+            if( !!_vgroupinterpolators[i] ) {
+                _vgroupinterpolators[i](psegment,index-1,deltatime,vinternaldata);
+            }
+        }
+        if( bSetDeltaTime ) {
+            vinternaldata.at(_timeoffset) = deltatime;
+        }
+        return vinternaldata.begin();
+    }
+
+    /// \brief returns the waypoint ipoint followed by the waypoint ipoint+1 if it exists, in double precision
+    ///
+    /// \param vsegmentdata buffer the waypoints are expanded into when they are in the compact storage
+    const dReal* _GetSegmentData(size_t ipoint, std::vector<dReal>& vsegmentdata) const
+    {
+        if( !_IsStoredCompact() ) {
+            return &_vtrajdata[ipoint*_spec.GetDOF()];
+        }
+        vsegmentdata.resize(2*_spec.GetDOF());
+        _ExpandWaypoints(ipoint,min(ipoint+2,GetNumWaypoints()),vsegmentdata.begin());
+        return &vsegmentdata[0];
+    }
+
+    /// \brief true if the waypoints are currently in _vcompactdata rather than _vtrajdata
+    inline bool _IsStoredCompact() const
+    {
+        return _vcompactdata.size() > 0;
+    }
+
+    /// \brief returns the deltatime of the waypoint at index
+    inline dReal _GetDeltaTime(size_t index) const
+    {
+        return _IsStoredCompact() ? _vcompactdeltatimes[index] : _vtrajdata[_spec.GetDOF()*index+_timeoffset];
+    }
+
+    /// \brief writes the waypoints [startindex,endindex) of the compact storage in double precision starting at itdata
+    void _ExpandWaypoints(size_t startindex, size_t endindex, std::vector<dReal>::iterator itdata) const
+    {
+        int dof = _spec.GetDOF();
+        std::copy(_vcompactdata.begin()+startindex*dof,_vcompactdata.begin()+endindex*dof,itdata);
+        if( _timeoffset >= 0 ) {
+            for(size_t i = startindex; i < endindex; ++i) {
+                *(itdata+(i-startindex)*dof+_timeoffset) = _vcompactdeltatimes[i];
+            }
+        }
+    }
+
+    /// \brief returns all the waypoints in double precision, vexpanded is filled only if they are in the compact storage
+    const std::vector<dReal>& _GetExpandedData(std::vector<dReal>& vexpanded) const
+    {
+        if( !_IsStoredCompact() ) {
+            return _vtrajdata;
+        }
+        vexpanded.resize(_vcompactdata.size());
+        _ExpandWaypoints(0,GetNumWaypoints(),vexpanded.begin());
+        return vexpanded;
+    }
+
+    /// \brief moves the waypoints of _vtrajdata to the compact storage
+    void _CompactData()
+    {
+        if( _vtrajdata.size() == 0 ) {
+            return;
+        }
+        int dof = _spec.GetDOF();
+        size_t numpoints = _vtrajdata.size()/dof;
+        _vcompactdata.resize(_vtrajdata.size());
+        std::copy(_vtrajdata.begin(),_vtrajdata.end(),_vcompactdata.begin());
+        _vcompactdeltatimes.resize(_timeoffset >= 0 ? numpoints : 0);
+        for(size_t i = 0; i < _vcompactdeltatimes.size(); ++i) {
+            _vcompactdeltatimes[i] = _vtrajdata[i*dof+_timeoffset];
+        }
+        std::vector<dReal>().swap(_vtrajdata);
+        std::vector<dReal>().swap(_vexpandeddata);
+    }
+
+    /// \brief moves the waypoints of the compact storage back to _vtrajdata
+    void _ExpandData()
+    {
+        if( !_IsStoredCompact() ) {
+            return;
+        }
+        size_t numpoints = GetNumWaypoints();
+        _vtrajdata.resize(_vcompactdata.size());
+        _ExpandWaypoints(0,numpoints,_vtrajdata.begin());
+        std::vector<float>().swap(_vcompactdata);
+        std::vector<dReal>().swap(_vcompactdeltatimes);
+        std::vector<dReal>().swap(_vexpandeddata);
+    }
+
+    bool _SetCompactStorageCommand(std::ostream& sout, std::istream& sinput)
+    {
+        int compact = 0;
+        sinput >> compact;
+        if( !sinput ) {
+            return false;
+        }
+        SetCompactStorage(compact != 0);
+        return true;
+    }
+
+    bool _GetCompactStorageCommand(std::ostream& sout, std::istream& sinput)
+    {
+        sout << (int)_bCompact;
+        return true;
+    }
+
+    /// \brief returns the conversion from _spec to spec
+    ///
+    /// The last few conversions are cached since the trajectory is usually read with the same specifications over and over.
+    /// Conversions that filled data from the current state of the environment are not cached since the environment can change.
+    ConfigurationSpecification::ConverterConstPtr _GetConverter(const ConfigurationSpecification& spec) const
+    {
+        FOREACHC(itconverter,_vcachedconverters) {
+            if( itconverter->first == spec ) {
+                return itconverter->second;
+            }
+        }
+        ConfigurationSpecification::ConverterConstPtr pconverter(new ConfigurationSpecification::Converter(spec,_spec,GetEnv(),true));
+        if( !pconverter->HasEnvironmentDefaults() ) {
+            if( _vcachedconverters.size() >= 4 ) {
+                _vcachedconverters.erase(_vcachedconverters.begin());
+            }
+            _vcachedconverters.push_back(make_pair(spec,pconverter));
+        }
+        return pconverter;
+    }
+
+    /// \brief checks that the trajectory can be sampled and computes the internal information
+    void _PrepareSampling() const
+    {
+        BOOST_ASSERT(_bInit);
+        OPENRAVE_ASSERT_OP(_timeoffset,>=,0);
+        _ComputeInternal();
+        OPENRAVE_ASSERT_OP_FORMAT0(GetNumWaypoints(),>=,1, "trajectory needs at least one point to sample from", ORE_InvalidArguments);
+        if( IS_DEBUGLEVEL(Level_Verbose) || (RaveGetDebugLevel() & Level_VerifyPlans) ) {
+            _VerifySampling();
+        }
+    }
+
+    /// \brief returns the number of points SamplePointsSameDeltaTime outputs
+    size_t _GetNumSameDeltaTimePoints(dReal deltatime, bool ensureLastPoint) const
+    {
+        OPENRAVE_ASSERT_OP(deltatime,>,0);
+        dReal duration = GetDuration();
+        size_t numpoints = (size_t)(duration/deltatime)+1;
+        if( ensureLastPoint && (numpoints-1)*deltatime+g_fEpsilon < duration ) {
+            ++numpoints;
+        }
+        return numpoints;
+    }
+
     void _ConvertData(std::vector<dReal>::iterator ittargetdata, std::vector<dReal>::const_iterator itsourcedata, const std::vector< std::vector<ConfigurationSpecification::Group>::const_iterator >& vconvertgroups, const ConfigurationSpecification& spec, size_t numelements, bool filluninitialized)
     {
         for(size_t igroup = 0; igroup < vconvertgroups.size(); ++igroup) {
@@ -377,6 +634,16 @@ protected:
         }
     }
 
+    /// \brief marks the accumulated times of the waypoints starting at index as stale
+    inline void _InvalidateTimes(size_t index)
+    {
+        _bChanged = true;
+        _nNumTimedWaypoints = min(_nNumTimedWaypoints, index);
+    }
+
+    /// \brief computes _vaccumtime and _vdeltainvtime
+    ///
+    /// Only the waypoints after the first _nNumTimedWaypoints are recomputed, so appending to or removing from the end of the trajectory is amortized O(1).
     void _ComputeInternal() const
     {
         if( !_bChanged ) {
@@ -390,12 +657,19 @@ protected:
             _vaccumtime.resize(GetNumWaypoints());
             _vdeltainvtime.resize(_vaccumtime.size());
             if( _vaccumtime.size() == 0 ) {
+                _nNumTimedWaypoints = 0;
+                _bChanged = false;
+                _bSamplingVerified = false;
                 return;
             }
-            _vaccumtime.at(0) = _vtrajdata.at(_timeoffset);
-            _vdeltainvtime.at(0) = 1/_vtrajdata.at(_timeoffset);
-            for(size_t i = 1; i < _vaccumtime.size(); ++i) {
-                dReal deltatime = _vtrajdata[_spec.GetDOF()*i+_timeoffset];
+            size_t istart = _nNumTimedWaypoints;
+            if( istart == 0 ) {
+                _vaccumtime.at(0) = _GetDeltaTime(0);
+                _vdeltainvtime.at(0) = 1/_vaccumtime.at(0);
+                istart = 1;
+            }
+            for(size_t i = istart; i < _vaccumtime.size(); ++i) {
+                dReal deltatime = _GetDeltaTime(i);
                 if( deltatime < 0 ) {
                     throw OPENRAVE_EXCEPTION_FORMAT("deltatime (%.15e) is < 0 at point %d/%d", deltatime%i%_vaccumtime.size(), ORE_InvalidState);
                 }
@@ -403,6 +677,7 @@ protected:
                 _vaccumtime[i] = _vaccumtime[i-1] + deltatime;
             }
         }
+        _nNumTimedWaypoints = _vaccumtime.size();
         _bChanged = false;
         _bSamplingVerified = false;
     }
@@ -435,11 +710,13 @@ protected:
 
         if( IS_DEBUGLEVEL(Level_Debug) || (RaveGetDebugLevel() & Level_VerifyPlans) ) {
             // go through all the points
+            std::vector<dReal> vsegmentdata;
             for(size_t ipoint = 0; ipoint+1 < _vaccumtime.size(); ++ipoint) {
                 dReal deltatime = _vaccumtime[ipoint+1] - _vaccumtime[ipoint];
+                const dReal* psegment = _GetSegmentData(ipoint,vsegmentdata);
                 for(size_t i = 0; i < _vgroupvalidators.size(); ++i) {
                     if( !!_vgroupvalidators[i] ) {
-                        _vgroupvalidators[i](ipoint,deltatime);
+                        _vgroupvalidators[i](psegment,ipoint,deltatime);
                     }
                 }
             }
@@ -450,6 +727,7 @@ protected:
     /// \brief called in order to initialize _vgroupinterpolators and _vgroupvalidators, _vderivoffsets, _vintegraloffsets
     void _InitializeGroupFunctions()
     {
+        ++_specversion;
         // first set sizes to 0
         _vgroupinterpolators.resize(0);
         _vgroupvalidators.resize(0);
@@ -467,22 +745,22 @@ protected:
             const string& interpolation = _spec._vgroups[i].interpolation;
             int nNeedNeighboringInfo = 0;
             if( interpolation == "previous" ) {
-                _vgroupinterpolators[i] = boost::bind(&GenericTrajectory::_InterpolatePrevious,this,boost::ref(_spec._vgroups[i]),_1,_2,_3);
+                _vgroupinterpolators[i] = boost::bind(&GenericTrajectory::_InterpolatePrevious,this,boost::ref(_spec._vgroups[i]),_1,_2,_3,_4);
             }
             else if( interpolation == "next" ) {
-                _vgroupinterpolators[i] = boost::bind(&GenericTrajectory::_InterpolateNext,this,boost::ref(_spec._vgroups[i]),_1,_2,_3);
+                _vgroupinterpolators[i] = boost::bind(&GenericTrajectory::_InterpolateNext,this,boost::ref(_spec._vgroups[i]),_1,_2,_3,_4);
             }
             else if( interpolation == "linear" ) {
                 if( _spec._vgroups[i].name.size() >= 14 && _spec._vgroups[i].name.substr(0,14) == "ikparam_values" ) {
                     stringstream ss(_spec._vgroups[i].name.substr(14));
                     int niktype=0;
                     ss >> niktype;
-                    _vgroupinterpolators[i] = boost::bind(&GenericTrajectory::_InterpolateLinearIk,this,boost::ref(_spec._vgroups[i]),_1,_2,_3,static_cast<IkParameterizationType>(niktype));
+                    _vgroupinterpolators[i] = boost::bind(&GenericTrajectory::_InterpolateLinearIk,this,boost::ref(_spec._vgroups[i]),_1,_2,_3,_4,static_cast<IkParameterizationType>(niktype));
                     // TODO add validation for ikparam until
                 }
                 else {
-                    _vgroupinterpolators[i] = boost::bind(&GenericTrajectory::_InterpolateLinear,this,boost::ref(_spec._vgroups[i]),_1,_2,_3);
-                    _vgroupvalidators[i] = boost::bind(&GenericTrajectory::_ValidateLinear,this,boost::ref(_spec._vgroups[i]),_1,_2);
+                    _vgroupinterpolators[i] = boost::bind(&GenericTrajectory::_InterpolateLinear,this,boost::ref(_spec._vgroups[i]),_1,_2,_3,_4);
+                    _vgroupvalidators[i] = boost::bind(&GenericTrajectory::_ValidateLinear,this,boost::ref(_spec._vgroups[i]),_1,_2,_3);
                 }
                 nNeedNeighboringInfo = 2;
             }
@@ -491,38 +769,38 @@ protected:
                     stringstream ss(_spec._vgroups[i].name.substr(14));
                     int niktype=0;
                     ss >> niktype;
-                    _vgroupinterpolators[i] = boost::bind(&GenericTrajectory::_InterpolateQuadraticIk,this,boost::ref(_spec._vgroups[i]),_1,_2,_3,static_cast<IkParameterizationType>(niktype));
+                    _vgroupinterpolators[i] = boost::bind(&GenericTrajectory::_InterpolateQuadraticIk,this,boost::ref(_spec._vgroups[i]),_1,_2,_3,_4,static_cast<IkParameterizationType>(niktype));
                     // TODO add validation for ikparam until
                 }
                 else {
-                    _vgroupinterpolators[i] = boost::bind(&GenericTrajectory::_InterpolateQuadratic,this,boost::ref(_spec._vgroups[i]),_1,_2,_3);
-                    _vgroupvalidators[i] = boost::bind(&GenericTrajectory::_ValidateQuadratic,this,boost::ref(_spec._vgroups[i]),_1,_2);
+                    _vgroupinterpolators[i] = boost::bind(&GenericTrajectory::_InterpolateQuadratic,this,boost::ref(_spec._vgroups[i]),_1,_2,_3,_4);
+                    _vgroupvalidators[i] = boost::bind(&GenericTrajectory::_ValidateQuadratic,this,boost::ref(_spec._vgroups[i]),_1,_2,_3);
                 }
                 nNeedNeighboringInfo = 3;
             }
             else if( interpolation == "cubic" ) {
-                _vgroupinterpolators[i] = boost::bind(&GenericTrajectory::_InterpolateCubic,this,boost::ref(_spec._vgroups[i]),_1,_2,_3);
-                _vgroupvalidators[i] = boost::bind(&GenericTrajectory::_ValidateCubic,this,boost::ref(_spec._vgroups[i]),_1,_2);
+                _vgroupinterpolators[i] = boost::bind(&GenericTrajectory::_InterpolateCubic,this,boost::ref(_spec._vgroups[i]),_1,_2,_3,_4);
+                _vgroupvalidators[i] = boost::bind(&GenericTrajectory::_ValidateCubic,this,boost::ref(_spec._vgroups[i]),_1,_2,_3);
                 nNeedNeighboringInfo = 3;
             }
             else if( interpolation == "quartic" ) {
-                _vgroupinterpolators[i] = boost::bind(&GenericTrajectory::_InterpolateQuartic,this,boost::ref(_spec._vgroups[i]),_1,_2,_3);
-                _vgroupvalidators[i] = boost::bind(&GenericTrajectory::_ValidateQuartic,this,boost::ref(_spec._vgroups[i]),_1,_2);
+                _vgroupinterpolators[i] = boost::bind(&GenericTrajectory::_InterpolateQuartic,this,boost::ref(_spec._vgroups[i]),_1,_2,_3,_4);
+                _vgroupvalidators[i] = boost::bind(&GenericTrajectory::_ValidateQuartic,this,boost::ref(_spec._vgroups[i]),_1,_2,_3);
                 nNeedNeighboringInfo = 3;
             }
             else if( interpolation == "quintic" ) {
-                _vgroupinterpolators[i] = boost::bind(&GenericTrajectory::_InterpolateQuintic,this,boost::ref(_spec._vgroups[i]),_1,_2,_3);
-                _vgroupvalidators[i] = boost::bind(&GenericTrajectory::_ValidateQuintic,this,boost::ref(_spec._vgroups[i]),_1,_2);
+                _vgroupinterpolators[i] = boost::bind(&GenericTrajectory::_InterpolateQuintic,this,boost::ref(_spec._vgroups[i]),_1,_2,_3,_4);
+                _vgroupvalidators[i] = boost::bind(&GenericTrajectory::_ValidateQuintic,this,boost::ref(_spec._vgroups[i]),_1,_2,_3);
                 nNeedNeighboringInfo = 3;
             }
             else if( interpolation == "sextic" ) {
-                _vgroupinterpolators[i] = boost::bind(&GenericTrajectory::_InterpolateSextic,this,boost::ref(_spec._vgroups[i]),_1,_2,_3);
-                _vgroupvalidators[i] = boost::bind(&GenericTrajectory::_ValidateSextic,this,boost::ref(_spec._vgroups[i]),_1,_2);
+                _vgroupinterpolators[i] = boost::bind(&GenericTrajectory::_InterpolateSextic,this,boost::ref(_spec._vgroups[i]),_1,_2,_3,_4);
+                _vgroupvalidators[i] = boost::bind(&GenericTrajectory::_ValidateSextic,this,boost::ref(_spec._vgroups[i]),_1,_2,_3);
                 nNeedNeighboringInfo = 3;
             }
             else if( interpolation == "" ) {
                 // if there is no interpolation, default to "next". deltatime is such a group, but that is overwritten
-                _vgroupinterpolators[i] = boost::bind(&GenericTrajectory::_InterpolateNext,this,boost::ref(_spec._vgroups[i]),_1,_2,_3);
+                _vgroupinterpolators[i] = boost::bind(&GenericTrajectory::_InterpolateNext,this,boost::ref(_spec._vgroups[i]),_1,_2,_3,_4);
             }
 
 
@@ -579,63 +857,58 @@ protected:
         }
     }
 
-    void _InterpolatePrevious(const ConfigurationSpecification::Group& g, size_t ipoint, dReal deltatime, std::vector<dReal>& data)
+    void _InterpolatePrevious(const ConfigurationSpecification::Group& g, const dReal* psegment, size_t ipoint, dReal deltatime, std::vector<dReal>& data)
     {
-        size_t offset = ipoint*_spec.GetDOF()+g.offset;
-        if( (ipoint+1)*_spec.GetDOF() < _vtrajdata.size() ) {
+        size_t offset = g.offset;
+        if( ipoint+1 < GetNumWaypoints() ) {
             // if point is so close the previous, then choose the next
             dReal f = _vdeltainvtime.at(ipoint+1)*deltatime;
             if( f > 1-g_fEpsilon ) {
                 offset += _spec.GetDOF();
             }
         }
-        std::copy(_vtrajdata.begin()+offset,_vtrajdata.begin()+offset+g.dof,data.begin()+g.offset);
+        std::copy(psegment+offset,psegment+offset+g.dof,data.begin()+g.offset);
     }
 
-    void _InterpolateNext(const ConfigurationSpecification::Group& g, size_t ipoint, dReal deltatime, std::vector<dReal>& data)
+    void _InterpolateNext(const ConfigurationSpecification::Group& g, const dReal* psegment, size_t ipoint, dReal deltatime, std::vector<dReal>& data)
     {
-        if( (ipoint+1)*_spec.GetDOF() < _vtrajdata.size() ) {
-            ipoint += 1;
-        }
-        size_t offset = ipoint*_spec.GetDOF() + g.offset;
-        if( deltatime <= g_fEpsilon && ipoint > 0 ) {
-            // if point is so close the previous, then choose the previous
-            offset -= _spec.GetDOF();
+        size_t offset = g.offset;
+        if( ipoint+1 < GetNumWaypoints() && deltatime > g_fEpsilon ) {
+            // unless the point is so close to the previous, choose the next
+            offset += _spec.GetDOF();
         }
-        std::copy(_vtrajdata.begin()+offset,_vtrajdata.begin()+offset+g.dof,data.begin()+g.offset);
+        std::copy(psegment+offset,psegment+offset+g.dof,data.begin()+g.offset);
     }
 
-    void _InterpolateLinear(const ConfigurationSpecification::Group& g, size_t ipoint, dReal deltatime, std::vector<dReal>& data)
+    void _InterpolateLinear(const ConfigurationSpecification::Group& g, const dReal* psegment, size_t ipoint, dReal deltatime, std::vector<dReal>& data)
     {
-        size_t offset = ipoint*_spec.GetDOF();
         int derivoffset = _vderivoffsets[g.offset];
         if( derivoffset < 0 ) {
             // expected derivative offset, interpolation can be wrong for circular joints
             dReal f = _vdeltainvtime.at(ipoint+1)*deltatime;
             for(int i = 0; i < g.dof; ++i) {
-                data[g.offset+i] = _vtrajdata[offset+g.offset+i]*(1-f) + f*_vtrajdata[_spec.GetDOF()+offset+g.offset+i];
+                data[g.offset+i] = psegment[g.offset+i]*(1-f) + f*psegment[_spec.GetDOF()+g.offset+i];
             }
         }
         else {
             for(int i = 0; i < g.dof; ++i) {
-                dReal deriv0 = _vtrajdata[_spec.GetDOF()+offset+derivoffset+i];
-                data[g.offset+i] = _vtrajdata[offset+g.offset+i] + deltatime*deriv0;
+                dReal deriv0 = psegment[_spec.GetDOF()+derivoffset+i];
+                data[g.offset+i] = psegment[g.offset+i] + deltatime*deriv0;
             }
         }
     }
 
-    void _InterpolateLinearIk(const ConfigurationSpecification::Group& g, size_t ipoint, dReal deltatime, std::vector<dReal>& data, IkParameterizationType iktype)
+    void _InterpolateLinearIk(const ConfigurationSpecification::Group& g, const dReal* psegment, size_t ipoint, dReal deltatime, std::vector<dReal>& data, IkParameterizationType iktype)
     {
-        _InterpolateLinear(g,ipoint,deltatime,data);
+        _InterpolateLinear(g,psegment,ipoint,deltatime,data);
         if( deltatime > g_fEpsilon ) {
-            size_t offset = ipoint*_spec.GetDOF();
-            dReal f = _vdeltainvtime.at(ipoint+1)*deltatime;
+                dReal f = _vdeltainvtime.at(ipoint+1)*deltatime;
             switch(iktype) {
             case IKP_Rotation3D:
             case IKP_Transform6D: {
                 Vector q0, q1;
-                q0.Set4(&_vtrajdata[offset+g.offset]);
-                q1.Set4(&_vtrajdata[_spec.GetDOF()+offset+g.offset]);
+                q0.Set4(&psegment[g.offset]);
+                q1.Set4(&psegment[_spec.GetDOF()+g.offset]);
                 Vector q = quatSlerp(q0,q1,f);
                 data[g.offset+0] = q[0];
                 data[g.offset+1] = q[1];
@@ -644,8 +917,8 @@ protected:
                 break;
             }
             case IKP_TranslationDirection5D: {
-                Vector dir0(_vtrajdata[offset+g.offset+0],_vtrajdata[offset+g.offset+1],_vtrajdata[offset+g.offset+2]);
-                Vector dir1(_vtrajdata[_spec.GetDOF()+offset+g.offset+0],_vtrajdata[_spec.GetDOF()+offset+g.offset+1],_vtrajdata[_spec.GetDOF()+offset+g.offset+2]);
+                Vector dir0(psegment[g.offset+0],psegment[g.offset+1],psegment[g.offset+2]);
+                Vector dir1(psegment[_spec.GetDOF()+g.offset+0],psegment[_spec.GetDOF()+g.offset+1],psegment[_spec.GetDOF()+g.offset+2]);
                 Vector axisangle = dir0.cross(dir1);
                 dReal fsinangle = RaveSqrt(axisangle.lengthsqr3());
                 if( fsinangle > g_fEpsilon ) {
@@ -663,18 +936,17 @@ protected:
         }
     }
 
-    void _InterpolateQuadratic(const ConfigurationSpecification::Group& g, size_t ipoint, dReal deltatime, std::vector<dReal>& data)
+    void _InterpolateQuadratic(const ConfigurationSpecification::Group& g, const dReal* psegment, size_t ipoint, dReal deltatime, std::vector<dReal>& data)
     {
-        size_t offset = ipoint*_spec.GetDOF();
         if( deltatime > g_fEpsilon ) {
             int derivoffset = _vderivoffsets[g.offset];
             if( derivoffset >= 0 ) {
                 for(int i = 0; i < g.dof; ++i) {
                     // coeff*t^2 + deriv0*t + pos0
-                    dReal deriv0 = _vtrajdata[offset+derivoffset+i];
-                    dReal deriv1 = _vtrajdata[_spec.GetDOF()+offset+derivoffset+i];
+                    dReal deriv0 = psegment[derivoffset+i];
+                    dReal deriv1 = psegment[_spec.GetDOF()+derivoffset+i];
                     dReal coeff = 0.5*_vdeltainvtime.at(ipoint+1)*(deriv1-deriv0);
-                    data[g.offset+i] = _vtrajdata[offset+g.offset+i] + deltatime*(deriv0 + deltatime*coeff);
+                    data[g.offset+i] = psegment[g.offset+i] + deltatime*(deriv0 + deltatime*coeff);
                 }
             }
             else {
@@ -688,10 +960,10 @@ protected:
                     // mult by (3/deltatime): c2*deltatime**2 + 3/2*c1*deltatime + 3*v0 = 3*(p1-p0)/deltatime
                     // subtract by original: 0.5*c1*deltatime + 2*v0 - 3*(p1-p0)/deltatime + v1 = 0
                     // c1*deltatime = 6*(p1-p0)/deltatime - 4*v0 - 2*v1
-                    dReal integral0 = _vtrajdata[offset+integraloffset+i];
-                    dReal integral1 = _vtrajdata[_spec.GetDOF()+offset+integraloffset+i];
-                    dReal value0 = _vtrajdata[offset+g.offset+i];
-                    dReal value1 = _vtrajdata[_spec.GetDOF()+offset+g.offset+i];
+                    dReal integral0 = psegment[integraloffset+i];
+                    dReal integral1 = psegment[_spec.GetDOF()+integraloffset+i];
+                    dReal value0 = psegment[g.offset+i];
+                    dReal value1 = psegment[_spec.GetDOF()+g.offset+i];
                     dReal c1TimesDelta = 6*(integral1-integral0)*ideltatime - 4*value0 - 2*value1;
                     dReal c1 = c1TimesDelta*ideltatime;
                     dReal c2 = (value1 - value0 - c1TimesDelta)*ideltatime2;
@@ -701,25 +973,24 @@ protected:
         }
         else {
             for(int i = 0; i < g.dof; ++i) {
-                data[g.offset+i] = _vtrajdata[offset+g.offset+i];
+                data[g.offset+i] = psegment[g.offset+i];
             }
         }
     }
 
-    void _InterpolateQuadraticIk(const ConfigurationSpecification::Group& g, size_t ipoint, dReal deltatime, std::vector<dReal>& data, IkParameterizationType iktype)
+    void _InterpolateQuadraticIk(const ConfigurationSpecification::Group& g, const dReal* psegment, size_t ipoint, dReal deltatime, std::vector<dReal>& data, IkParameterizationType iktype)
     {
-        _InterpolateQuadratic(g, ipoint, deltatime, data);
+        _InterpolateQuadratic(g, psegment, ipoint, deltatime, data);
         if( deltatime > g_fEpsilon ) {
             int derivoffset = _vderivoffsets[g.offset];
-            size_t offset = ipoint*_spec.GetDOF();
-            Vector q0, q0vel, q1, q1vel;
+                Vector q0, q0vel, q1, q1vel;
             switch(iktype) {
             case IKP_Rotation3D:
             case IKP_Transform6D: {
-                q0.Set4(&_vtrajdata[offset+g.offset]);
-                q0vel.Set4(&_vtrajdata[offset+derivoffset]);
-                q1.Set4(&_vtrajdata[_spec.GetDOF()+offset+g.offset]);
-                q1vel.Set4(&_vtrajdata[_spec.GetDOF()+offset+derivoffset]);
+                q0.Set4(&psegment[g.offset]);
+                q0vel.Set4(&psegment[derivoffset]);
+                q1.Set4(&psegment[_spec.GetDOF()+g.offset]);
+                q1vel.Set4(&psegment[_spec.GetDOF()+derivoffset]);
                 Vector angularvelocity0 = quatMultiply(q0vel,quatInverse(q0))*2;
                 Vector angularvelocity1 = quatMultiply(q1vel,quatInverse(q1))*2;
                 Vector coeff = (angularvelocity1-angularvelocity0)*(0.5*_vdeltainvtime.at(ipoint+1));
@@ -733,12 +1004,12 @@ protected:
             }
             case IKP_TranslationDirection5D: {
                 Vector dir0, dir1, angularvelocity0, angularvelocity1;
-                dir0.Set3(&_vtrajdata[offset+g.offset]);
-                dir1.Set3(&_vtrajdata[_spec.GetDOF()+offset+g.offset]);
+                dir0.Set3(&psegment[g.offset]);
+                dir1.Set3(&psegment[_spec.GetDOF()+g.offset]);
                 Vector axisangle = dir0.cross(dir1);
                 if( axisangle.lengthsqr3() > g_fEpsilon ) {
-                    angularvelocity0.Set3(&_vtrajdata[offset+derivoffset]);
-                    angularvelocity1.Set3(&_vtrajdata[_spec.GetDOF()+offset+derivoffset]);
+                    angularvelocity0.Set3(&psegment[derivoffset]);
+                    angularvelocity1.Set3(&psegment[_spec.GetDOF()+derivoffset]);
                     Vector coeff = (angularvelocity1-angularvelocity0)*(0.5*_vdeltainvtime.at(ipoint+1));
                     Vector vtotaldelta = angularvelocity0*deltatime + coeff*(deltatime*deltatime);
                     Vector newdir = quatRotate(quatFromAxisAngle(vtotaldelta),dir0);
@@ -754,14 +1025,13 @@ protected:
         }
     }
 
-    void _InterpolateCubic(const ConfigurationSpecification::Group& g, size_t ipoint, dReal deltatime, std::vector<dReal>& data)
+    void _InterpolateCubic(const ConfigurationSpecification::Group& g, const dReal* psegment, size_t ipoint, dReal deltatime, std::vector<dReal>& data)
     {
         // p = c3*t**3 + c2*t**2 + c1*t + c0
         // c3 = (v1*dt + v0*dt - 2*px)/(dt**3)
         // c2 = (3*px - 2*v0*dt - v1*dt)/(dt**2)
         // c1 = v0
         // c0 = p0
-        size_t offset = ipoint*_spec.GetDOF();
         if( deltatime > g_fEpsilon ) {
             int derivoffset = _vderivoffsets[g.offset];
             if( derivoffset >= 0 ) {
@@ -770,12 +1040,12 @@ protected:
                 dReal ideltatime3 = ideltatime2*ideltatime;
                 for(int i = 0; i < g.dof; ++i) {
                     // coeff*t^2 + deriv0*t + pos0
-                    dReal deriv0 = _vtrajdata[offset+derivoffset+i];
-                    dReal deriv1 = _vtrajdata[_spec.GetDOF()+offset+derivoffset+i];
-                    dReal px = _vtrajdata.at(_spec.GetDOF()+offset+g.offset+i) - _vtrajdata[offset+g.offset+i];
+                    dReal deriv0 = psegment[derivoffset+i];
+                    dReal deriv1 = psegment[_spec.GetDOF()+derivoffset+i];
+                    dReal px = psegment[_spec.GetDOF()+g.offset+i] - psegment[g.offset+i];
                     dReal c3 = (deriv1+deriv0)*ideltatime2 - 2*px*ideltatime3;
                     dReal c2 = 3*px*ideltatime2 - (2*deriv0+deriv1)*ideltatime;
-                    data[g.offset+i] = _vtrajdata[offset+g.offset+i] + deltatime*(deriv0 + deltatime*(c2 + deltatime*c3));
+                    data[g.offset+i] = psegment[g.offset+i] + deltatime*(deriv0 + deltatime*(c2 + deltatime*c3));
                 }
             }
             else {
@@ -784,12 +1054,12 @@ protected:
         }
         else {
             for(int i = 0; i < g.dof; ++i) {
-                data[g.offset+i] = _vtrajdata[offset+g.offset+i];
+                data[g.offset+i] = psegment[g.offset+i];
             }
         }
     }
 
-    void _InterpolateQuartic(const ConfigurationSpecification::Group& g, size_t ipoint, dReal deltatime, std::vector<dReal>& data)
+    void _InterpolateQuartic(const ConfigurationSpecification::Group& g, const dReal* psegment, size_t ipoint, dReal deltatime, std::vector<dReal>& data)
     {
         // p = c4*t**4 + c3*t**3 + c2*t**2 + c1*t + c0
         //
@@ -801,7 +1071,6 @@ protected:
         // c2 = a0/2
         // c1 = v0
         // c0 = p0
-        size_t offset = ipoint*_spec.GetDOF();
         if( deltatime > g_fEpsilon ) {
             int derivoffset = _vderivoffsets[g.offset];
             int ddoffset = _vddoffsets[g.offset];
@@ -810,13 +1079,13 @@ protected:
                 dReal ideltatime2 = ideltatime*ideltatime;
                 dReal ideltatime3 = ideltatime2*ideltatime;
                 for(int i = 0; i < g.dof; ++i) {
-                    dReal deriv0 = _vtrajdata[offset+derivoffset+i];
-                    dReal deriv1 = _vtrajdata[_spec.GetDOF()+offset+derivoffset+i];
-                    dReal dd0 = _vtrajdata[offset+ddoffset+i];
-                    dReal dd1 = _vtrajdata[_spec.GetDOF()+offset+ddoffset+i];
+                    dReal deriv0 = psegment[derivoffset+i];
+                    dReal deriv1 = psegment[_spec.GetDOF()+derivoffset+i];
+                    dReal dd0 = psegment[ddoffset+i];
+                    dReal dd1 = psegment[_spec.GetDOF()+ddoffset+i];
                     dReal c4 = -0.5*(deriv1-deriv0)*ideltatime3 + (dd0 + dd1)*ideltatime2*0.25;
                     dReal c3 = (deriv1-deriv0)*ideltatime2 - (2*dd0+dd1)*ideltatime/3.0;
-                    data[g.offset+i] = _vtrajdata[offset+g.offset+i] + deltatime*(deriv0 + deltatime*(0.5*dd0 + deltatime*(c3 + deltatime*c4)));
+                    data[g.offset+i] = psegment[g.offset+i] + deltatime*(deriv0 + deltatime*(0.5*dd0 + deltatime*(c3 + deltatime*c4)));
                 }
             }
             else {
@@ -825,12 +1094,12 @@ protected:
         }
         else {
             for(int i = 0; i < g.dof; ++i) {
-                data[g.offset+i] = _vtrajdata[offset+g.offset+i];
+                data[g.offset+i] = psegment[g.offset+i];
             }
         }
     }
 
-    void _InterpolateQuintic(const ConfigurationSpecification::Group& g, size_t ipoint, dReal deltatime, std::vector<dReal>& data)
+    void _InterpolateQuintic(const ConfigurationSpecification::Group& g, const dReal* psegment, size_t ipoint, dReal deltatime, std::vector<dReal>& data)
     {
         // p0, p1, v0, v1, a0, a1, dt, t, c5, c4, c3 = symbols('p0, p1, v0, v1, a0, a1, dt, t, c5, c4, c3')
         // p = c5*t**5 + c4*t**4 + c3*t**3 + c2*t**2 + c1*t + c0
@@ -847,7 +1116,6 @@ protected:
         // c2 = a0/2
         // c1 = v0
         // c0 = p0
-        size_t offset = ipoint*_spec.GetDOF();
         if( deltatime > g_fEpsilon ) {
             int derivoffset = _vderivoffsets[g.offset];
             int ddoffset = _vddoffsets[g.offset];
@@ -858,12 +1126,12 @@ protected:
                 dReal ideltatime4 = ideltatime2*ideltatime2;
                 dReal ideltatime5 = ideltatime4*ideltatime;
                 for(int i = 0; i < g.dof; ++i) {
-                    dReal p0 = _vtrajdata[offset+g.offset+i];
-                    dReal px = _vtrajdata[_spec.GetDOF()+offset+g.offset+i] - p0;
-                    dReal deriv0 = _vtrajdata[offset+derivoffset+i];
-                    dReal deriv1 = _vtrajdata[_spec.GetDOF()+offset+derivoffset+i];
-                    dReal dd0 = _vtrajdata[offset+ddoffset+i];
-                    dReal dd1 = _vtrajdata[_spec.GetDOF()+offset+ddoffset+i];
+                    dReal p0 = psegment[g.offset+i];
+                    dReal px = psegment[_spec.GetDOF()+g.offset+i] - p0;
+                    dReal deriv0 = psegment[derivoffset+i];
+                    dReal deriv1 = psegment[_spec.GetDOF()+derivoffset+i];
+                    dReal dd0 = psegment[ddoffset+i];
+                    dReal dd1 = psegment[_spec.GetDOF()+ddoffset+i];
                     dReal c5 = (-0.5*dd0 + dd1*0.5)*ideltatime3 - (3*deriv0 + 3*deriv1)*ideltatime4 + px*6*ideltatime5;
                     dReal c4 = (1.5*dd0 - dd1)*ideltatime2 + (8*deriv0 + 7*deriv1)*ideltatime3 - px*15*ideltatime4;
                     dReal c3 = (-1.5*dd0 + dd1*0.5)*ideltatime + (- 6*deriv0 - 4*deriv1)*ideltatime2 + px*10*ideltatime3;
@@ -876,12 +1144,12 @@ protected:
         }
         else {
             for(int i = 0; i < g.dof; ++i) {
-                data[g.offset+i] = _vtrajdata[offset+g.offset+i];
+                data[g.offset+i] = psegment[g.offset+i];
             }
         }
     }
 
-    void _InterpolateSextic(const ConfigurationSpecification::Group& g, size_t ipoint, dReal deltatime, std::vector<dReal>& data)
+    void _InterpolateSextic(const ConfigurationSpecification::Group& g, const dReal* psegment, size_t ipoint, dReal deltatime, std::vector<dReal>& data)
     {
         // p = c6*t**6 + c5*t**5 + c4*t**4 + c3*t**3 + c2*t**2 + c1*t + c0
         //
@@ -896,7 +1164,6 @@ protected:
         // c2 = a0/2
         // c1 = v0
         // c0 = p0
-        size_t offset = ipoint*_spec.GetDOF();
         if( deltatime > g_fEpsilon ) {
             int derivoffset = _vderivoffsets[g.offset];
             int ddoffset = _vddoffsets[g.offset];
@@ -912,14 +1179,14 @@ protected:
                 //dReal deltatime4 = deltatime2*deltatime2;
                 //dReal deltatime5 = deltatime4*deltatime;
                 for(int i = 0; i < g.dof; ++i) {
-                    dReal p0 = _vtrajdata[offset+g.offset+i];
-                    //dReal px = _vtrajdata[_spec.GetDOF()+offset+g.offset+i] - p0;
-                    dReal deriv0 = _vtrajdata[offset+derivoffset+i];
-                    dReal deriv1 = _vtrajdata[_spec.GetDOF()+offset+derivoffset+i];
-                    dReal dd0 = _vtrajdata[offset+ddoffset+i];
-                    dReal dd1 = _vtrajdata[_spec.GetDOF()+offset+ddoffset+i];
-                    dReal ddd0 = _vtrajdata[offset+dddoffset+i];
-                    dReal ddd1 = _vtrajdata[_spec.GetDOF()+offset+dddoffset+i];
+                    dReal p0 = psegment[g.offset+i];
+                    //dReal px = psegment[_spec.GetDOF()+g.offset+i] - p0;
+                    dReal deriv0 = psegment[derivoffset+i];
+                    dReal deriv1 = psegment[_spec.GetDOF()+derivoffset+i];
+                    dReal dd0 = psegment[ddoffset+i];
+                    dReal dd1 = psegment[_spec.GetDOF()+ddoffset+i];
+                    dReal ddd0 = psegment[dddoffset+i];
+                    dReal ddd1 = psegment[_spec.GetDOF()+dddoffset+i];
                     // matrix inverse is slow but at least it will work for now
                     // A=Matrix(3,3,[6*dt**5, 5*dt**4, 4*dt**3, 30*dt**4, 20*dt**3, 12*dt**2, 120*dt**3, 60*dt**2, 24*dt])
                     // A.inv() = [   dt**(-5), -1/(2*dt**4), 1/(12*dt**3)]
@@ -946,20 +1213,19 @@ protected:
         }
         else {
             for(int i = 0; i < g.dof; ++i) {
-                data[g.offset+i] = _vtrajdata[offset+g.offset+i];
+                data[g.offset+i] = psegment[g.offset+i];
             }
         }
     }
 
-    void _ValidateLinear(const ConfigurationSpecification::Group& g, size_t ipoint, dReal deltatime)
+    void _ValidateLinear(const ConfigurationSpecification::Group& g, const dReal* psegment, size_t ipoint, dReal deltatime)
     {
-        size_t offset = ipoint*_spec.GetDOF();
         int derivoffset = _vderivoffsets[g.offset];
         if( derivoffset >= 0 ) {
             for(int i = 0; i < g.dof; ++i) {
-                dReal deriv0 = _vtrajdata[_spec.GetDOF()+offset+derivoffset+i];
-                dReal expected = _vtrajdata[offset+g.offset+i] + deltatime*deriv0;
-                dReal error = RaveFabs(_vtrajdata[_spec.GetDOF()+offset+g.offset+i] - expected);
+                dReal deriv0 = psegment[_spec.GetDOF()+derivoffset+i];
+                dReal expected = psegment[g.offset+i] + deltatime*deriv0;
+                dReal error = RaveFabs(psegment[_spec.GetDOF()+g.offset+i] - expected);
                 if( RaveFabs(error-2*PI) > g_fEpsilonLinear ) { // TODO, officially track circular joints
                     OPENRAVE_ASSERT_OP_FORMAT(error,<=,g_fEpsilonLinear, "trajectory segment for group %s interpolation %s points %d-%d dof %d is invalid", g.name%g.interpolation%ipoint%(ipoint+1)%i, ORE_InvalidState);
                 }
@@ -967,18 +1233,17 @@ protected:
         }
     }
 
-    void _ValidateQuadratic(const ConfigurationSpecification::Group& g, size_t ipoint, dReal deltatime)
+    void _ValidateQuadratic(const ConfigurationSpecification::Group& g, const dReal* psegment, size_t ipoint, dReal deltatime)
     {
         if( deltatime > g_fEpsilon ) {
-            size_t offset = ipoint*_spec.GetDOF();
-            int derivoffset = _vderivoffsets[g.offset];
+                int derivoffset = _vderivoffsets[g.offset];
             if( derivoffset >= 0 ) {
                 for(int i = 0; i < g.dof; ++i) {
                     // coeff*t^2 + deriv0*t + pos0
-                    dReal deriv0 = _vtrajdata[offset+derivoffset+i];
-                    dReal coeff = 0.5*_vdeltainvtime.at(ipoint+1)*(_vtrajdata[_spec.GetDOF()+offset+derivoffset+i]-deriv0);
-                    dReal expected = _vtrajdata[offset+g.offset+i] + deltatime*(deriv0 + deltatime*coeff);
-                    dReal error = RaveFabs(_vtrajdata.at(_spec.GetDOF()+offset+g.offset+i)-expected);
+                    dReal deriv0 = psegment[derivoffset+i];
+                    dReal coeff = 0.5*_vdeltainvtime.at(ipoint+1)*(psegment[_spec.GetDOF()+derivoffset+i]-deriv0);
+                    dReal expected = psegment[g.offset+i] + deltatime*(deriv0 + deltatime*coeff);
+                    dReal error = RaveFabs(psegment[_spec.GetDOF()+g.offset+i]-expected);
                     if( RaveFabs(error-2*PI) > 1e-5 ) { // TODO, officially track circular joints
                         OPENRAVE_ASSERT_OP_FORMAT(error,<=,1e-4, "trajectory segment for group %s interpolation %s time %f points %d-%d dof %d is invalid", g.name%g.interpolation%deltatime%ipoint%(ipoint+1)%i, ORE_InvalidState);
                     }
@@ -992,37 +1257,160 @@ protected:
         }
     }
 
-    void _ValidateCubic(const ConfigurationSpecification::Group& g, size_t ipoint, dReal deltatime)
+    void _ValidateCubic(const ConfigurationSpecification::Group& g, const dReal* psegment, size_t ipoint, dReal deltatime)
     {
         // TODO, need 3 groups to verify
     }
 
-    void _ValidateQuartic(const ConfigurationSpecification::Group& g, size_t ipoint, dReal deltatime)
+    void _ValidateQuartic(const ConfigurationSpecification::Group& g, const dReal* psegment, size_t ipoint, dReal deltatime)
     {
     }
 
-    void _ValidateQuintic(const ConfigurationSpecification::Group& g, size_t ipoint, dReal deltatime)
+    void _ValidateQuintic(const ConfigurationSpecification::Group& g, const dReal* psegment, size_t ipoint, dReal deltatime)
     {
     }
 
-    void _ValidateSextic(const ConfigurationSpecification::Group& g, size_t ipoint, dReal deltatime)
+    void _ValidateSextic(const ConfigurationSpecification::Group& g, const dReal* psegment, size_t ipoint, dReal deltatime)
     {
     }
 
     ConfigurationSpecification _spec;
-    std::vector< boost::function<void(size_t,dReal,std::vector<dReal>&)> > _vgroupinterpolators;
-    std::vector< boost::function<void(size_t,dReal)> > _vgroupvalidators;
+    std::vector< boost::function<void(const dReal*,size_t,dReal,std::vector<dReal>&)> > _vgroupinterpolators; ///< called with the data of the segment returned by _GetSegmentData
+    std::vector< boost::function<void(const dReal*,size_t,dReal)> > _vgroupvalidators;
     std::vector<int> _vderivoffsets, _vddoffsets, _vdddoffsets; ///< for every group that relies on other info to compute its position, this will point to the derivative offset. -1 if invalid and not needed, -2 if invalid and needed
     std::vector<int> _vintegraloffsets; ///< for every group that relies on other info to compute its position, this will point to the integral offset (ie the position for a velocity group). -1 if invalid and not needed, -2 if invalid and needed
     int _timeoffset;
+    int _specversion; ///< incremented every time the group functions are re-initialized, samplers use it to know when to recompute their conversions
 
     std::vector<dReal> _vtrajdata;
+    std::vector<float> _vcompactdata; ///< the waypoints in single precision when they are in the compact storage, see SetCompactStorage
+    std::vector<dReal> _vcompactdeltatimes; ///< the deltatime of every waypoint in the compact storage, kept in double precision so that the accumulated times are exact
+    mutable std::vector<dReal> _vexpandeddata; ///< the expanded compact storage returned by GetWaypointsData, released on the next modification
     mutable std::vector<dReal> _vaccumtime, _vdeltainvtime;
+    mutable std::vector< std::pair<ConfigurationSpecification, ConfigurationSpecification::ConverterConstPtr> > _vcachedconverters; ///< conversions from _spec to the specifications the trajectory was recently read with, see _GetConverter
     bool _bInit;
+    bool _bCompact; ///< if true, the waypoints are kept in _vcompactdata and _vcompactdeltatimes after every modification
     mutable bool _bChanged; ///< if true, then _ComputeInternal() has to be called in order to compute _vaccumtime and _vdeltainvtime
+    mutable size_t _nNumTimedWaypoints; ///< number of leading waypoints whose _vaccumtime and _vdeltainvtime are up to date
     mutable bool _bSamplingVerified; ///< if false, then _VerifySampling() has not be called yet to verify that all points can be sampled.
+
+    friend class GenericTrajectorySampler;
 };
 
+/// \brief samples a GenericTrajectory by remembering the last segment and precomputing the conversion to the user specification
+class GenericTrajectorySampler : public TrajectoryBase::Sampler
+{
+public:
+    GenericTrajectorySampler(boost::shared_ptr<GenericTrajectory const> traj, const ConfigurationSpecification& spec) : TrajectoryBase::Sampler(traj,spec), _gtraj(traj), _index(0), _specversion(-1)
+    {
+    }
+
+    virtual void Sample(std::vector<dReal>& data, dReal time)
+    {
+        data.resize(_spec.GetDOF());
+        SampleInto(data.begin(),time);
+    }
+
+    /// \brief samples the point at time and writes _spec.GetDOF() values starting at itdata
+    void SampleInto(std::vector<dReal>::iterator itdata, dReal time)
+    {
+        const GenericTrajectory& traj = *_gtraj;
+        OPENRAVE_ASSERT_OP(time, >=, -g_fEpsilon);
+        traj._PrepareSampling();
+        if( _specversion != traj._specversion ) {
+            _InitConversion();
+        }
+        _index = traj._FindTimeIndex(time,_index);
+        std::vector<dReal>::const_iterator itsource = traj._SampleIndex(_index,time,_vinternaldata,_vsegmentdata,false);
+        _converter.Convert(itdata,itsource,1);
+    }
+
+    virtual void Reset()
+    {
+        _index = 0;
+    }
+
+protected:
+    /// \brief computes how every group of _spec is filled from the trajectory specification
+    void _InitConversion()
+    {
+        _vinternaldata.resize(_gtraj->_spec.GetDOF());
+        // groups not in the trajectory are initialized from the environment once rather than every sample
+        _converter = ConfigurationSpecification::Converter(_spec,_gtraj->_spec,_gtraj->GetEnv(),true);
+        _index = 0;
+        _specversion = _gtraj->_specversion;
+    }
+
+    boost::shared_ptr<GenericTrajectory const> _gtraj;
+    std::vector<dReal> _vinternaldata; ///< interpolated point in the trajectory specification
+    std::vector<dReal> _vsegmentdata; ///< the waypoints of the sampled segment when the trajectory is in the compact storage
+    ConfigurationSpecification::Converter _converter; ///< conversion from the trajectory specification to _spec
+    size_t _index; ///< the last index returned by _FindTimeIndex
+    int _specversion; ///< the GenericTrajectory::_specversion the conversion was computed for
+};
+
+TrajectoryBase::SamplerPtr GenericTrajectory::CreateSampler(const ConfigurationSpecification& spec) const
+{
+    return SamplerPtr(new GenericTrajectorySampler(boost::static_pointer_cast<GenericTrajectory const>(shared_trajectory_const()),spec));
+}
+
+void GenericTrajectory::SamplePoints(std::vector<dReal>& data, const std::vector<dReal>& times) const
+{
+    _PrepareSampling();
+    int dof = _spec.GetDOF();
+    std::vector<dReal> vinternaldata(dof,0), vsegmentdata;
+    data.resize(dof*times.size());
+    std::vector<dReal>::iterator itdata = data.begin();
+    size_t index = 0;
+    for(size_t i = 0; i < times.size(); ++i, itdata += dof) {
+        index = _FindTimeIndex(times[i],index);
+        std::vector<dReal>::const_iterator itsource = _SampleIndex(index,times[i],vinternaldata,vsegmentdata,true);
+        std::copy(itsource,itsource+dof,itdata);
+    }
+}
+
+void GenericTrajectory::SamplePoints(std::vector<dReal>& data, const std::vector<dReal>& times, const ConfigurationSpecification& spec) const
+{
+    GenericTrajectorySampler sampler(boost::static_pointer_cast<GenericTrajectory const>(shared_trajectory_const()),spec);
+    data.resize(spec.GetDOF()*times.size());
+    std::vector<dReal>::iterator itdata = data.begin();
+    for(size_t i = 0; i < times.size(); ++i, itdata += spec.GetDOF()) {
+        sampler.SampleInto(itdata,times[i]);
+    }
+}
+
+void GenericTrajectory::SamplePointsSameDeltaTime(std::vector<dReal>& data, dReal deltatime, bool ensureLastPoint) const
+{
+    _PrepareSampling();
+    int dof = _spec.GetDOF();
+    size_t numpoints = _GetNumSameDeltaTimePoints(deltatime,ensureLastPoint);
+    std::vector<dReal> vinternaldata(dof,0), vsegmentdata;
+    data.resize(dof*numpoints);
+    std::vector<dReal>::iterator itdata = data.begin();
+    size_t index = 0;
+    for(size_t i = 0; i < numpoints; ++i, itdata += dof) {
+        dReal time = i+1 < numpoints ? i*deltatime : min(i*deltatime,GetDuration());
+        // times are increasing, so step through the segments
+        while( index < _vaccumtime.size() && _vaccumtime[index] < time ) {
+            ++index;
+        }
+        std::vector<dReal>::const_iterator itsource = _SampleIndex(index,time,vinternaldata,vsegmentdata,true);
+        std::copy(itsource,itsource+dof,itdata);
+    }
+}
+
+void GenericTrajectory::SamplePointsSameDeltaTime(std::vector<dReal>& data, dReal deltatime, bool ensureLastPoint, const ConfigurationSpecification& spec) const
+{
+    _PrepareSampling();
+    size_t numpoints = _GetNumSameDeltaTimePoints(deltatime,ensureLastPoint);
+    GenericTrajectorySampler sampler(boost::static_pointer_cast<GenericTrajectory const>(shared_trajectory_const()),spec);
+    data.resize(spec.GetDOF()*numpoints);
+    std::vector<dReal>::iterator itdata = data.begin();
+    for(size_t i = 0; i < numpoints; ++i, itdata += spec.GetDOF()) {
+        sampler.SampleInto(itdata, i+1 < numpoints ? i*deltatime : min(i*deltatime,GetDuration()));
+    }
+}
+
 TrajectoryBasePtr CreateGenericTrajectory(EnvironmentBasePtr penv, std::istream& sinput)
 {
     return TrajectoryBasePtr(new GenericTrajectory(penv,sinput));
@@ -14,13 +14,29 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "ravep.h"
+#include "parallelrangeworkers.h"
 
 namespace OpenRAVE {
 
 class MultiController : public MultiControllerBase
 {
+    /// \brief timing of the SimulationStep calls of one attached controller
+    struct ControllerStepStatistics
+    {
+        ControllerStepStatistics() : numsteps(0), laststeptime(0), totalsteptime(0), maxsteptime(0) {
+        }
+        uint64_t numsteps;
+        uint64_t laststeptime, totalsteptime, maxsteptime; ///< microseconds
+    };
+
 public:
-    MultiController(EnvironmentBasePtr penv) : MultiControllerBase(penv), _nControlTransformation(0) {
+    MultiController(EnvironmentBasePtr penv) : MultiControllerBase(penv), _nControlTransformation(0), _nNumThreads(1) {
+        RegisterCommand("SetNumThreads",boost::bind(&MultiController::_SetNumThreadsCommand,this,_1,_2),
+                        "numthreads - steps the attached controllers with numthreads threads. The controller of the transformation is stepped first by itself, the other controllers do not share any dofs and are stepped in parallel. SimulationStep returns only after all of them are done, so physics always sees the result of every controller. Only use this when the SimulationStep of the attached controllers does not set the state of the robot and does not lock the environment, for example controllers that forward their commands to hardware. Default is 1.");
+        RegisterCommand("GetStepStatistics",boost::bind(&MultiController::_GetStepStatisticsCommand,this,_1,_2),
+                        "returns one line per attached controller in the order they were attached: controllername numsteps laststeptime meansteptime maxsteptime, with the times in seconds.");
+        RegisterCommand("ResetStepStatistics",boost::bind(&MultiController::_ResetStepStatisticsCommand,this,_1,_2),
+                        "resets the statistics returned by GetStepStatistics");
     }
 
     virtual ~MultiController() {
@@ -47,6 +63,7 @@ public:
         _vcontrollersbydofs.resize(0); _vcontrollersbydofs.resize(_dofindices.size());
         _nControlTransformation = nControlTransformation;
         _ptransformcontroller.reset();
+        _mapstepstatistics.clear();
         return true;
     }
 
@@ -88,6 +105,7 @@ public:
     {
         boost::mutex::scoped_lock lock(_mutex);
         _listcontrollers.remove(controller);
+        _mapstepstatistics.erase(controller);
         if( _ptransformcontroller == controller ) {
             _ptransformcontroller.reset();
         }
@@ -149,8 +167,33 @@ public:
 
     virtual void SimulationStep(dReal fTimeElapsed) {
         boost::mutex::scoped_lock lock(_mutex);
+        if( !_pStepWorkers || _listcontrollers.size() <= 1 ) {
+            FOREACH(it,_listcontrollers) {
+                _StepController(*it, _mapstepstatistics[*it], fTimeElapsed);
+            }
+            return;
+        }
+
+        // the transformation moves all the links, so step it before the others
+        _vstepcontrollers.resize(0);
         FOREACH(it,_listcontrollers) {
-            (*it)->SimulationStep(fTimeElapsed);
+            if( *it == _ptransformcontroller ) {
+                _StepController(*it, _mapstepstatistics[*it], fTimeElapsed);
+            }
+            else {
+                _vstepcontrollers.push_back(make_pair(*it, &_mapstepstatistics[*it]));
+            }
+        }
+        _vsteperrors.resize(_vstepcontrollers.size());
+        FOREACH(iterror, _vsteperrors) {
+            iterror->resize(0);
+        }
+        _pStepWorkers->Run(_vstepcontrollers.size(), boost::bind(&MultiController::_StepControllers, this, fTimeElapsed, _1, _2));
+        // the exceptions of the worker threads are raised in the simulation thread like when stepping sequentially
+        for(size_t icontroller = 0; icontroller < _vsteperrors.size(); ++icontroller) {
+            if( _vsteperrors[icontroller].size() > 0 ) {
+                throw openrave_exception(str(boost::format(_("controller %s failed to step: %s"))%_vstepcontrollers[icontroller].first->GetXMLId()%_vsteperrors[icontroller]));
+            }
         }
     }
 
@@ -221,6 +264,71 @@ public:
     }
 
 protected:
+    /// \brief steps _vstepcontrollers[start:end], called from the worker threads
+    void _StepControllers(dReal fTimeElapsed, size_t start, size_t end)
+    {
+        for(size_t icontroller = start; icontroller < end; ++icontroller) {
+            try {
+                _StepController(_vstepcontrollers[icontroller].first, *_vstepcontrollers[icontroller].second, fTimeElapsed);
+            }
+            catch(const std::exception& ex) {
+                _vsteperrors[icontroller] = ex.what();
+            }
+        }
+    }
+
+    static void _StepController(ControllerBasePtr controller, ControllerStepStatistics& stats, dReal fTimeElapsed)
+    {
+        uint64_t starttime = utils::GetMicroTime();
+        controller->SimulationStep(fTimeElapsed);
+        stats.laststeptime = utils::GetMicroTime()-starttime;
+        stats.totalsteptime += stats.laststeptime;
+        stats.maxsteptime = max(stats.maxsteptime, stats.laststeptime);
+        stats.numsteps++;
+    }
+
+    bool _SetNumThreadsCommand(std::ostream& sout, std::istream& sinput)
+    {
+        int numthreads = 1;
+        sinput >> numthreads;
+        if( !sinput || numthreads < 1 ) {
+            return false;
+        }
+        boost::mutex::scoped_lock lock(_mutex);
+        _nNumThreads = numthreads;
+        if( _nNumThreads > 1 ) {
+            if( !_pStepWorkers || _pStepWorkers->GetNumThreads() != _nNumThreads ) {
+                _pStepWorkers.reset(new ParallelRangeWorkers(_nNumThreads, "MultiControllerStep"));
+            }
+        }
+        else {
+            _pStepWorkers.reset();
+        }
+        return true;
+    }
+
+    bool _GetStepStatisticsCommand(std::ostream& sout, std::istream& sinput)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        FOREACHC(itcontroller,_listcontrollers) {
+            ControllerStepStatistics stats;
+            std::map<ControllerBasePtr, ControllerStepStatistics>::const_iterator itstats = _mapstepstatistics.find(*itcontroller);
+            if( itstats != _mapstepstatistics.end() ) {
+                stats = itstats->second;
+            }
+            dReal fmeansteptime = stats.numsteps > 0 ? 1e-6*(dReal)stats.totalsteptime/(dReal)stats.numsteps : 0;
+            sout << (*itcontroller)->GetXMLId() << " " << stats.numsteps << " " << 1e-6*(dReal)stats.laststeptime << " " << fmeansteptime << " " << 1e-6*(dReal)stats.maxsteptime << std::endl;
+        }
+        return true;
+    }
+
+    bool _ResetStepStatisticsCommand(std::ostream& sout, std::istream& sinput)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _mapstepstatistics.clear();
+        return true;
+    }
+
     RobotBasePtr _probot;
     std::vector<int> _dofindices, _dofreverseindices;
     int _nControlTransformation;
@@ -229,6 +337,12 @@ protected:
     ControllerBasePtr _ptransformcontroller;
     TrajectoryBasePtr _ptraj;
     mutable boost::mutex _mutex;
+
+    int _nNumThreads; ///< set by the SetNumThreads command
+    ParallelRangeWorkersPtr _pStepWorkers; ///< steps the controllers in parallel, only set if _nNumThreads > 1
+    std::map<ControllerBasePtr, ControllerStepStatistics> _mapstepstatistics; ///< the entries are only added by the simulation thread, the workers only write to the ones of their controllers
+    std::vector< std::pair<ControllerBasePtr, ControllerStepStatistics*> > _vstepcontrollers; ///< the controllers stepped in parallel
+    std::vector<std::string> _vsteperrors; ///< the exception messages of _vstepcontrollers
 };
 
 MultiControllerBasePtr CreateMultiController(EnvironmentBasePtr penv, std::istream& sinput)
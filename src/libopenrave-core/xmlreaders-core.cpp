@@ -34,6 +34,8 @@
 
 #ifdef HAVE_BOOST_FILESYSTEM
 #include <boost/filesystem.hpp>
+#elif !defined(_WIN32)
+#include <sys/stat.h>
 #endif
 
 #include <boost/utility.hpp>
@@ -137,6 +139,146 @@ int& GetXMLErrorCount()
     return errorcount;
 }
 
+/** \brief on-disk cache of the geometries converted from mesh files
+
+    Converting mesh files into TriMesh is where most of the scene loading time goes, so the converted geometries are stored in the meshcache
+    directory of the openrave database. The cache files are keyed by the md5 hash of the mesh file contents, its extension, the scale and the
+    conversion, so an edited mesh file never hits a stale entry. Set the OPENRAVE_MESHCACHE environment variable to 0 to disable the cache.
+ */
+class MeshCache
+{
+public:
+    static bool IsEnabled()
+    {
+        const char* pOPENRAVE_MESHCACHE = std::getenv("OPENRAVE_MESHCACHE");
+        return pOPENRAVE_MESHCACHE == NULL || string(pOPENRAVE_MESHCACHE) != "0";
+    }
+
+    /// \brief returns the cache filename of a mesh file, or an empty string if the cache is disabled or the mesh file cannot be read
+    ///
+    /// \param conversion distinguishes the different ways a mesh file is converted
+    static std::string GetCacheFilename(const std::string& filename, const Vector& vscale, const std::string& conversion)
+    {
+        if( !IsEnabled() ) {
+            return std::string();
+        }
+        ifstream f(filename.c_str(), ios::in|ios::binary);
+        if( !f ) {
+            return std::string();
+        }
+        std::vector<uint8_t> vdata((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+        if( vdata.size() == 0 ) {
+            return std::string();
+        }
+        string extension;
+        if( filename.find_last_of('.') != string::npos ) {
+            extension = filename.substr(filename.find_last_of('.')+1);
+            std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        }
+        string suffix = str(boost::format("%s %s %.15e %.15e %.15e %d %d")%extension%conversion%vscale.x%vscale.y%vscale.z%sizeof(dReal)%(int)s_version);
+        vdata.insert(vdata.end(), suffix.begin(), suffix.end());
+        return RaveFindDatabaseFile(str(boost::format("meshcache%c%s.bin")%s_filesep%utils::GetMD5HashString(vdata)), false);
+    }
+
+    static bool Load(const std::string& cachefilename, std::list<KinBody::GeometryInfo>& listGeometries)
+    {
+        ifstream f(cachefilename.c_str(), ios::in|ios::binary);
+        if( !f ) {
+            return false;
+        }
+        uint32_t version=0, numgeometries=0;
+        f.read((char*)&version, sizeof(version));
+        f.read((char*)&numgeometries, sizeof(numgeometries));
+        if( !f || version != s_version ) {
+            return false;
+        }
+        std::list<KinBody::GeometryInfo> listnew;
+        for(uint32_t igeom = 0; igeom < numgeometries; ++igeom) {
+            listnew.push_back(KinBody::GeometryInfo());
+            KinBody::GeometryInfo& g = listnew.back();
+            g._type = GT_TriMesh;
+            uint64_t numvertices=0, numindices=0;
+            f.read((char*)&g._vRenderScale.x, sizeof(dReal)*4);
+            f.read((char*)&g._vDiffuseColor.x, sizeof(float)*4);
+            f.read((char*)&g._vAmbientColor.x, sizeof(float)*4);
+            f.read((char*)&g._fTransparency, sizeof(g._fTransparency));
+            f.read((char*)&numvertices, sizeof(numvertices));
+            f.read((char*)&numindices, sizeof(numindices));
+            if( !f ) {
+                return false;
+            }
+            g._meshcollision.vertices.resize(numvertices);
+            for(size_t i = 0; i < g._meshcollision.vertices.size(); ++i) {
+                f.read((char*)&g._meshcollision.vertices[i].x, sizeof(dReal)*3);
+            }
+            g._meshcollision.indices.resize(numindices);
+            if( numindices > 0 ) {
+                f.read((char*)&g._meshcollision.indices[0], sizeof(int)*numindices);
+            }
+            if( !f ) {
+                return false;
+            }
+        }
+        listGeometries.splice(listGeometries.end(), listnew);
+        return true;
+    }
+
+    /// \brief writes to a temporary file first so that concurrent loaders never read a partial cache file
+    static void Save(const std::string& cachefilename, const std::list<KinBody::GeometryInfo>& listGeometries)
+    {
+        if( cachefilename.size() == 0 ) {
+            return;
+        }
+#ifdef HAVE_BOOST_FILESYSTEM
+        try {
+            boost::filesystem::create_directories(boost::filesystem::path(cachefilename).parent_path());
+        }
+        catch(const std::exception& ex) {
+            RAVELOG_DEBUG(str(boost::format("failed to create mesh cache directory for %s: %s")%cachefilename%ex.what()));
+            return;
+        }
+#elif !defined(_WIN32)
+        mkdir(cachefilename.substr(0, cachefilename.find_last_of(s_filesep)).c_str(), S_IRWXU|S_IRGRP|S_IXGRP|S_IROTH|S_IXOTH);
+#endif
+        string tempfilename = str(boost::format("%s.%d.%s")%cachefilename%utils::GetNanoTime()%boost::this_thread::get_id());
+        {
+            ofstream f(tempfilename.c_str(), ios::out|ios::binary);
+            if( !f ) {
+                return;
+            }
+            uint32_t version = s_version, numgeometries = listGeometries.size();
+            f.write((const char*)&version, sizeof(version));
+            f.write((const char*)&numgeometries, sizeof(numgeometries));
+            FOREACHC(itgeom, listGeometries) {
+                uint64_t numvertices = itgeom->_meshcollision.vertices.size(), numindices = itgeom->_meshcollision.indices.size();
+                f.write((const char*)&itgeom->_vRenderScale.x, sizeof(dReal)*4);
+                f.write((const char*)&itgeom->_vDiffuseColor.x, sizeof(float)*4);
+                f.write((const char*)&itgeom->_vAmbientColor.x, sizeof(float)*4);
+                f.write((const char*)&itgeom->_fTransparency, sizeof(itgeom->_fTransparency));
+                f.write((const char*)&numvertices, sizeof(numvertices));
+                f.write((const char*)&numindices, sizeof(numindices));
+                FOREACHC(itv, itgeom->_meshcollision.vertices) {
+                    f.write((const char*)&itv->x, sizeof(dReal)*3);
+                }
+                if( numindices > 0 ) {
+                    f.write((const char*)&itgeom->_meshcollision.indices[0], sizeof(int)*numindices);
+                }
+            }
+            if( !f ) {
+                f.close();
+                std::remove(tempfilename.c_str());
+                return;
+            }
+        }
+        if( std::rename(tempfilename.c_str(), cachefilename.c_str()) != 0 ) {
+            std::remove(tempfilename.c_str());
+        }
+    }
+
+private:
+    static const uint32_t s_version = 1; ///< increment whenever the cache layout or the mesh conversion changes
+};
+
 #ifdef OPENRAVE_ASSIMP
 class aiSceneManaged
 {
@@ -229,7 +371,7 @@ static bool _AssimpCreateTriMesh(const aiScene* scene, aiNode* node, const Vecto
 
 #endif
 
-bool CreateTriMeshFromFile(EnvironmentBasePtr penv, const std::string& filename, const Vector& vscale, TriMesh& trimesh, RaveVector<float>& diffuseColor, RaveVector<float>& ambientColor, float& ftransparency)
+static bool _CreateTriMeshFromFile(EnvironmentBasePtr penv, const std::string& filename, const Vector& vscale, TriMesh& trimesh, RaveVector<float>& diffuseColor, RaveVector<float>& ambientColor, float& ftransparency)
 {
     string extension;
     if( filename.find_last_of('.') != string::npos ) {
@@ -287,6 +429,9 @@ bool CreateTriMeshFromFile(EnvironmentBasePtr penv, const std::string& filename,
     }
 #endif
 
+    // meshes can be loaded from several threads (see GeometryLoadQueue), but the coin3d and ivcon importers are not reentrant
+    static boost::mutex s_mutexImporters;
+    boost::mutex::scoped_lock lock(s_mutexImporters);
     ModuleBasePtr ivmodelloader = RaveCreateModule(penv,"ivmodelloader");
     if( !!ivmodelloader ) {
         stringstream sout, sin;
@@ -319,6 +464,38 @@ bool CreateTriMeshFromFile(EnvironmentBasePtr penv, const std::string& filename,
     return false;
 }
 
+bool CreateTriMeshFromFile(EnvironmentBasePtr penv, const std::string& filename, const Vector& vscale, TriMesh& trimesh, RaveVector<float>& diffuseColor, RaveVector<float>& ambientColor, float& ftransparency)
+{
+    string cachefilename = MeshCache::GetCacheFilename(filename, vscale, "trimesh");
+    std::list<KinBody::GeometryInfo> listGeometries;
+    if( cachefilename.size() > 0 && MeshCache::Load(cachefilename, listGeometries) && listGeometries.size() == 1 ) {
+        KinBody::GeometryInfo& g = listGeometries.front();
+        trimesh.vertices.insert(trimesh.vertices.end(), g._meshcollision.vertices.begin(), g._meshcollision.vertices.end());
+        trimesh.indices.insert(trimesh.indices.end(), g._meshcollision.indices.begin(), g._meshcollision.indices.end());
+        diffuseColor = g._vDiffuseColor;
+        ambientColor = g._vAmbientColor;
+        ftransparency = g._fTransparency;
+        return true;
+    }
+
+    // convert into an empty mesh so that exactly what the conversion added is cached
+    listGeometries.clear();
+    listGeometries.push_back(KinBody::GeometryInfo());
+    KinBody::GeometryInfo& g = listGeometries.back();
+    g._vDiffuseColor = diffuseColor;
+    g._vAmbientColor = ambientColor;
+    g._fTransparency = ftransparency;
+    if( !_CreateTriMeshFromFile(penv, filename, vscale, g._meshcollision, g._vDiffuseColor, g._vAmbientColor, g._fTransparency) ) {
+        return false;
+    }
+    MeshCache::Save(cachefilename, listGeometries);
+    trimesh.Append(g._meshcollision);
+    diffuseColor = g._vDiffuseColor;
+    ambientColor = g._vAmbientColor;
+    ftransparency = g._fTransparency;
+    return true;
+}
+
 bool CreateTriMeshFromData(const std::string& data, const std::string& formathint, const Vector& vscale, TriMesh& trimesh, RaveVector<float>& diffuseColor, RaveVector<float>& ambientColor, float& ftransparency)
 {
 #ifdef OPENRAVE_ASSIMP
@@ -534,12 +711,16 @@ bool ParseXMLFile(BaseXMLReaderPtr preader, const string& filename)
 #endif
     preader->_filename = filedata;
 
+    utils::ProfileZone profilezone("OpenRAVEXMLParser::ParseXMLFile");
+    uint64_t starttime = utils::GetMicroTime();
     int ret=-1;
     try {
         ret = raveXmlSAXUserParseFile(GetSAXHandler(), preader, filedata.c_str());
         if( ret != 0 ) {
             RAVELOG_WARN(str(boost::format("xmlSAXUserParseFile: error parsing %s (error %d)\n")%filedata%ret));
         }
+        // includes the time of the files it includes
+        RAVELOG_DEBUG_FORMAT("parsed %s in %.3fs", filedata%(1e-6*(utils::GetMicroTime()-starttime)));
     }
     catch(const std::exception& ex) {
         RAVELOG_ERROR(str(boost::format("xmlSAXUserParseFile: error parsing %s: %s\n")%filedata%ex.what()));
@@ -605,9 +786,138 @@ public:
     }
 protected:
     stringstream _ss;
+    std::string _sbuffer; ///< storage for utils::ParseRealValues
     boost::shared_ptr<BaseXMLReader> _pcurreader;
 };
 
+/** \brief loads the mesh files of the parsed geometries with a pool of threads
+
+    While parsing, the link readers queue the loading of their mesh files together with a function attaching the loaded geometries to the link.
+    Flush loads all the queued files in parallel, and then calls the attach functions on the calling thread in the order they were queued, so the
+    resulting bodies do not depend on the thread timing. Attach-only entries (empty load function) let the readers queue post-processing that
+    has to see the attached geometries.
+
+    While a queue is active (see \ref ActiveScope), the kinbody readers queue into it and leave flushing to its owner, which lets the
+    environment reader load the meshes of all its bodies together. The parser is serialized by the xml mutex, so the active queue is not thread-local.
+ */
+class GeometryLoadQueue
+{
+public:
+    typedef boost::function<bool(std::list<KinBody::GeometryInfo>&)> LoadFn;
+    typedef boost::function<void(std::list<KinBody::GeometryInfo>&, bool)> AttachFn;
+
+    GeometryLoadQueue() : _nextjob(0) {
+    }
+
+    /// \brief sets the active queue for the lifetime of the scope
+    class ActiveScope
+    {
+public:
+        ActiveScope(boost::shared_ptr<GeometryLoadQueue> pqueue) {
+            _pprevious = GetActive();
+            GetActive() = pqueue;
+        }
+        ~ActiveScope() {
+            GetActive() = _pprevious;
+        }
+private:
+        boost::shared_ptr<GeometryLoadQueue> _pprevious;
+    };
+
+    static boost::shared_ptr<GeometryLoadQueue>& GetActive() {
+        static boost::shared_ptr<GeometryLoadQueue> s_pactive;
+        return s_pactive;
+    }
+
+    /// \param bThreadSafe if false, loadfn is called on the flushing thread (the ivmodelloader and ivcon importers are not reentrant)
+    void Add(const LoadFn& loadfn, const AttachFn& attachfn, bool bThreadSafe)
+    {
+        _listjobs.push_back(Job());
+        _listjobs.back().loadfn = loadfn;
+        _listjobs.back().attachfn = attachfn;
+        _listjobs.back().bThreadSafe = bThreadSafe;
+    }
+
+    void Flush()
+    {
+        std::list<Job> listjobs;
+        listjobs.swap(_listjobs);
+        std::vector<Job*> vparalleljobs;
+        FOREACH(itjob, listjobs) {
+            if( !itjob->loadfn ) {
+                continue;
+            }
+            if( itjob->bThreadSafe ) {
+                vparalleljobs.push_back(&*itjob);
+            }
+            else {
+                _LoadJob(*itjob);
+            }
+        }
+
+        if( vparalleljobs.size() > 0 ) {
+            size_t numthreads = std::max(1u, boost::thread::hardware_concurrency());
+            numthreads = std::min(numthreads, vparalleljobs.size());
+            _nextjob = 0;
+            boost::thread_group workers;
+            for(size_t i = 1; i < numthreads; ++i) {
+                workers.create_thread(boost::bind(&GeometryLoadQueue::_LoadJobs, this, boost::ref(vparalleljobs)));
+            }
+            _LoadJobs(vparalleljobs);
+            workers.join_all();
+        }
+
+        FOREACH(itjob, listjobs) {
+            itjob->attachfn(itjob->listGeometries, itjob->bSuccess);
+        }
+    }
+
+private:
+    struct Job
+    {
+        Job() : bThreadSafe(false), bSuccess(false) {
+        }
+        LoadFn loadfn;
+        AttachFn attachfn;
+        bool bThreadSafe;
+        bool bSuccess;
+        std::list<KinBody::GeometryInfo> listGeometries;
+    };
+
+    void _LoadJobs(std::vector<Job*>& vjobs)
+    {
+        while(1) {
+            size_t ijob;
+            {
+                boost::mutex::scoped_lock lock(_mutex);
+                if( _nextjob >= vjobs.size() ) {
+                    return;
+                }
+                ijob = _nextjob++;
+            }
+            _LoadJob(*vjobs[ijob]);
+        }
+    }
+
+    static void _LoadJob(Job& job)
+    {
+        try {
+            job.bSuccess = job.loadfn(job.listGeometries);
+        }
+        catch(const std::exception& ex) {
+            RAVELOG_WARN(str(boost::format("failed to load geometry: %s")%ex.what()));
+            job.listGeometries.clear();
+            job.bSuccess = false;
+        }
+    }
+
+    std::list<Job> _listjobs;
+    boost::mutex _mutex;
+    size_t _nextjob; ///< next index into the parallel jobs, protected by _mutex
+};
+
+typedef boost::shared_ptr<GeometryLoadQueue> GeometryLoadQueuePtr;
+
 class LinkXMLReader : public StreamXMLReader
 {
 public:
@@ -750,6 +1060,21 @@ public:
 #endif
 
     static bool CreateGeometries(EnvironmentBasePtr penv, const std::string& filename, const Vector& vscale, std::list<KinBody::GeometryInfo>& listGeometries)
+    {
+        string cachefilename = MeshCache::GetCacheFilename(filename, vscale, "geometries");
+        if( cachefilename.size() > 0 && MeshCache::Load(cachefilename, listGeometries) ) {
+            return true;
+        }
+        std::list<KinBody::GeometryInfo> listnew;
+        if( !_CreateGeometries(penv, filename, vscale, listnew) ) {
+            return false;
+        }
+        MeshCache::Save(cachefilename, listnew);
+        listGeometries.splice(listGeometries.end(), listnew);
+        return true;
+    }
+
+    static bool _CreateGeometries(EnvironmentBasePtr penv, const std::string& filename, const Vector& vscale, std::list<KinBody::GeometryInfo>& listGeometries)
     {
         string extension;
         if( filename.find_last_of('.') != string::npos ) {
@@ -794,6 +1119,153 @@ public:
         return true;
     }
 
+    /** \brief loads the mesh file of a trimesh geometry and attaches the loaded geometries to the link
+
+        An empty placeholder geometry is added to the link when the geometry is parsed, and is replaced by the loaded geometries when
+        attaching, so the geometries keep their parsing order even when the mesh files are loaded later by a \ref GeometryLoadQueue.
+     */
+    class MeshGeometryLoader
+    {
+public:
+        MeshGeometryLoader(EnvironmentBasePtr penv, KinBody::LinkPtr plink, KinBody::GeometryInfoPtr info, xmlreaders::GeometryInfoReaderPtr geomreader, const TransformMatrix& tmres, const Vector& geomspacescale, const Vector& vScaleGeometry) : _penv(penv), _plink(plink), _info(info), _tmres(tmres), _geomspacescale(geomspacescale), _vScaleGeometry(vScaleGeometry) {
+            _bOverwriteDiffuse = geomreader->IsOverwriteDiffuse();
+            _bOverwriteAmbient = geomreader->IsOverwriteAmbient();
+            _bOverwriteTransparency = geomreader->IsOverwriteTransparency();
+            _pplaceholder.reset(new KinBody::Link::Geometry(plink, KinBody::GeometryInfo()));
+            plink->_vGeometries.push_back(_pplaceholder);
+        }
+
+        /// \brief true if the mesh files can be loaded outside of the parsing thread
+        bool IsThreadSafe() const
+        {
+            return _IsThreadSafe(_info->_filenamecollision) && _IsThreadSafe(_info->_filenamerender);
+        }
+
+        bool Load(std::list<KinBody::GeometryInfo>& listGeometries)
+        {
+            bool bSuccess = false;
+            if( _info->_filenamecollision.size() > 0 ) {
+                if( !CreateGeometries(_penv, _info->_filenamecollision, _info->_vCollisionScale, listGeometries) ) {
+                    RAVELOG_WARN(str(boost::format("failed to find %s\n")%_info->_filenamecollision));
+                }
+                else {
+                    bSuccess = true;
+                }
+            }
+            if( _info->_filenamerender.size() > 0 ) {
+                if( !bSuccess ) {
+                    if( !CreateGeometries(_penv, _info->_filenamerender, _info->_vRenderScale, listGeometries) ) {
+                        RAVELOG_WARN(str(boost::format("failed to find %s\n")%_info->_filenamerender));
+                    }
+                    else {
+                        bSuccess = true;
+                    }
+                }
+            }
+            return bSuccess;
+        }
+
+        void Attach(std::list<KinBody::GeometryInfo>& listGeometries, bool bSuccess)
+        {
+            TriMesh collision;
+            if( listGeometries.size() > 0 ) {
+                // append all the geometries to the link. make sure the render filename is specified in only one geometry.
+                string extension;
+                if( _info->_filenamerender.find_last_of('.') != string::npos ) {
+                    extension = _info->_filenamerender.substr(_info->_filenamerender.find_last_of('.')+1);
+                }
+                FOREACH(itnewgeom,listGeometries) {
+                    itnewgeom->_bVisible = _info->_bVisible;
+                    itnewgeom->_bModifiable = _info->_bModifiable;
+                    itnewgeom->_t = _info->_t;
+                    itnewgeom->_fTransparency = _info->_fTransparency;
+                    itnewgeom->_filenamerender = string("__norenderif__:")+extension;
+                    FOREACH(it,itnewgeom->_meshcollision.vertices) {
+                        *it = _tmres * *it;
+                    }
+                    if( _bOverwriteDiffuse ) {
+                        itnewgeom->_vDiffuseColor = _info->_vDiffuseColor;
+                    }
+                    if( _bOverwriteAmbient ) {
+                        itnewgeom->_vAmbientColor = _info->_vAmbientColor;
+                    }
+                    if( _bOverwriteTransparency ) {
+                        itnewgeom->_fTransparency = _info->_fTransparency;
+                    }
+                    itnewgeom->_t.trans *= _vScaleGeometry;
+                    collision.Append(itnewgeom->_meshcollision, itnewgeom->_t);
+                }
+                listGeometries.front()._vRenderScale = _info->_vRenderScale*_geomspacescale;
+                listGeometries.front()._filenamerender = _info->_filenamerender;
+                listGeometries.front()._vCollisionScale = _info->_vCollisionScale*_geomspacescale;
+                listGeometries.front()._filenamecollision = _info->_filenamecollision;
+                listGeometries.front()._bVisible = _info->_bVisible;
+            }
+            else {
+                _info->_vRenderScale = _info->_vRenderScale*_geomspacescale;
+                FOREACH(it,_info->_meshcollision.vertices) {
+                    *it = _tmres * *it;
+                }
+                _info->_t.trans *= _vScaleGeometry;
+                collision.Append(_info->_meshcollision, _info->_t);
+                listGeometries.push_back(*_info);
+            }
+
+            // replace the placeholder, the geometries before it make up the beginning of the link collision mesh
+            std::vector<KinBody::Link::GeometryPtr>& vgeometries = _plink->_vGeometries;
+            std::vector<KinBody::Link::GeometryPtr>::iterator itplaceholder = std::find(vgeometries.begin(), vgeometries.end(), _pplaceholder);
+            size_t ivertex = 0, iindex = 0;
+            for(std::vector<KinBody::Link::GeometryPtr>::iterator itgeom = vgeometries.begin(); itgeom != itplaceholder; ++itgeom) {
+                ivertex += (*itgeom)->GetCollisionMesh().vertices.size();
+                iindex += (*itgeom)->GetCollisionMesh().indices.size();
+            }
+            TriMesh& linkcollision = _plink->_collision;
+            ivertex = std::min(ivertex, linkcollision.vertices.size());
+            iindex = std::min(iindex, linkcollision.indices.size());
+            for(std::vector<int>::iterator itindex = linkcollision.indices.begin()+iindex; itindex != linkcollision.indices.end(); ++itindex) {
+                *itindex += collision.vertices.size();
+            }
+            FOREACH(itindex, collision.indices) {
+                *itindex += ivertex;
+            }
+            linkcollision.vertices.insert(linkcollision.vertices.begin()+ivertex, collision.vertices.begin(), collision.vertices.end());
+            linkcollision.indices.insert(linkcollision.indices.begin()+iindex, collision.indices.begin(), collision.indices.end());
+
+            std::vector<KinBody::Link::GeometryPtr> vnewgeometries;
+            FOREACH(itinfo, listGeometries) {
+                vnewgeometries.push_back(KinBody::Link::GeometryPtr(new KinBody::Link::Geometry(_plink,*itinfo)));
+            }
+            if( itplaceholder != vgeometries.end() ) {
+                itplaceholder = vgeometries.erase(itplaceholder);
+            }
+            vgeometries.insert(itplaceholder, vnewgeometries.begin(), vnewgeometries.end());
+        }
+
+private:
+        static bool _IsThreadSafe(const std::string& filename)
+        {
+            string extension;
+            if( filename.find_last_of('.') != string::npos ) {
+                extension = filename.substr(filename.find_last_of('.')+1);
+                std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+            }
+#ifdef OPENRAVE_ASSIMP
+            // everything else goes through assimp, which has one importer per file
+            return extension != "iv" && extension != "wrl" && extension != "vrml";
+#else
+            return filename.size() == 0;
+#endif
+        }
+
+        EnvironmentBasePtr _penv;
+        KinBody::LinkPtr _plink;
+        KinBody::GeometryInfoPtr _info;
+        KinBody::Link::GeometryPtr _pplaceholder;
+        TransformMatrix _tmres;
+        Vector _geomspacescale, _vScaleGeometry;
+        bool _bOverwriteDiffuse, _bOverwriteAmbient, _bOverwriteTransparency;
+    };
+
     LinkXMLReader(KinBody::LinkPtr& plink, KinBodyPtr pparent, const AttributesList &atts) : _plink(plink) {
         _pparent = pparent;
         _masstype = MT_None;
@@ -888,7 +1360,9 @@ public:
             AttributesList newatts = atts;
             newatts.push_back(make_pair("skipgeometry",_bSkipGeometry ? "1" : "0"));
             newatts.push_back(make_pair("scalegeometry",str(boost::format("%f %f %f")%_vScaleGeometry.x%_vScaleGeometry.y%_vScaleGeometry.z)));
-            _pcurreader.reset(new LinkXMLReader(_plink, _pparent, newatts));
+            boost::shared_ptr<LinkXMLReader> plinkreader(new LinkXMLReader(_plink, _pparent, newatts));
+            plinkreader->_pgeometryqueue = _pgeometryqueue;
+            _pcurreader = plinkreader;
             return PE_Support;
         }
 
@@ -936,6 +1410,10 @@ public:
         if( !!_pcurreader ) {
             if( _pcurreader->endElement(xmlname) ) {
                 if( xmlname == "body" ) {
+                    if( !!_pgeometryqueue ) {
+                        // the queued geometries have to be attached before they can be transformed
+                        _pgeometryqueue->Flush();
+                    }
                     // directly apply transform to all geomteries
                     Transform tnew = _plink->GetTransform();
                     FOREACH(itgeom, _plink->_vGeometries) {
@@ -976,71 +1454,15 @@ public:
                             info->_filenamecollision = _fnGetModelsDir(info->_filenamecollision);
                         }
                     }
-                    std::list<KinBody::GeometryInfo> listGeometries;
                     if( info->_type == GT_TriMesh ) {
-                        bool bSuccess = false;
-                        if( info->_filenamecollision.size() > 0 ) {
-                            if( !CreateGeometries(_pparent->GetEnv(),info->_filenamecollision, info->_vCollisionScale, listGeometries) ) {
-                                RAVELOG_WARN(str(boost::format("failed to find %s\n")%info->_filenamecollision));
-                            }
-                            else {
-                                bSuccess = true;
-                            }
-                        }
-                        if( info->_filenamerender.size() > 0 ) {
-                            if( !bSuccess ) {
-                                if( !CreateGeometries(_pparent->GetEnv(), info->_filenamerender, info->_vRenderScale, listGeometries) ) {
-                                    RAVELOG_WARN(str(boost::format("failed to find %s\n")%info->_filenamerender));
-                                }
-                                else {
-                                    bSuccess = true;
-                                }
-                            }
-                        }
-                        if( listGeometries.size() > 0 ) {
-                            // append all the geometries to the link. make sure the render filename is specified in only one geometry.
-                            string extension;
-                            if( info->_filenamerender.find_last_of('.') != string::npos ) {
-                                extension = info->_filenamerender.substr(info->_filenamerender.find_last_of('.')+1);
-                            }
-                            FOREACH(itnewgeom,listGeometries) {
-                                itnewgeom->_bVisible = info->_bVisible;
-                                itnewgeom->_bModifiable = info->_bModifiable;
-                                itnewgeom->_t = info->_t;
-                                itnewgeom->_fTransparency = info->_fTransparency;
-                                itnewgeom->_filenamerender = string("__norenderif__:")+extension;
-                                FOREACH(it,itnewgeom->_meshcollision.vertices) {
-                                    *it = tmres * *it;
-                                }
-                                if( geomreader->IsOverwriteDiffuse() ) {
-                                    itnewgeom->_vDiffuseColor = info->_vDiffuseColor;
-                                }
-                                if( geomreader->IsOverwriteAmbient() ) {
-                                    itnewgeom->_vAmbientColor = info->_vAmbientColor;
-                                }
-                                if( geomreader->IsOverwriteTransparency() ) {
-                                    itnewgeom->_fTransparency = info->_fTransparency;
-                                }
-                                itnewgeom->_t.trans *= _vScaleGeometry;
-                                _plink->_collision.Append(itnewgeom->_meshcollision, itnewgeom->_t);
-                            }
-                            listGeometries.front()._vRenderScale = info->_vRenderScale*geomspacescale;
-                            listGeometries.front()._filenamerender = info->_filenamerender;
-                            listGeometries.front()._vCollisionScale = info->_vCollisionScale*geomspacescale;
-                            listGeometries.front()._filenamecollision = info->_filenamecollision;
-                            listGeometries.front()._bVisible = info->_bVisible;
-                            FOREACH(itinfo, listGeometries) {
-                                _plink->_vGeometries.push_back(KinBody::Link::GeometryPtr(new KinBody::Link::Geometry(_plink,*itinfo)));
-                            }
+                        boost::shared_ptr<MeshGeometryLoader> ploader(new MeshGeometryLoader(_pparent->GetEnv(), _plink, info, geomreader, tmres, geomspacescale, _vScaleGeometry));
+                        if( !!_pgeometryqueue ) {
+                            _pgeometryqueue->Add(boost::bind(&MeshGeometryLoader::Load, ploader, _1), boost::bind(&MeshGeometryLoader::Attach, ploader, _1, _2), ploader->IsThreadSafe());
                         }
                         else {
-                            info->_vRenderScale = info->_vRenderScale*geomspacescale;
-                            FOREACH(it,info->_meshcollision.vertices) {
-                                *it = tmres * *it;
-                            }
-                            info->_t.trans *= _vScaleGeometry;
-                            _plink->_collision.Append(info->_meshcollision, info->_t);
-                            _plink->_vGeometries.push_back(KinBody::Link::GeometryPtr(new KinBody::Link::Geometry(_plink,*info)));
+                            std::list<KinBody::GeometryInfo> listGeometries;
+                            bool bSuccess = ploader->Load(listGeometries);
+                            ploader->Attach(listGeometries, bSuccess);
                         }
                     }
                     else {
@@ -1286,6 +1708,7 @@ public:
 
     boost::function<string(const std::string&)> _fnGetModelsDir;
     boost::function<Transform(KinBody::LinkPtr)> _fnGetOffsetFrom;
+    GeometryLoadQueuePtr _pgeometryqueue; ///< if set, the mesh files are queued into it instead of loaded while parsing
 
 private:
     MASS _mass;                            ///< current mass of the object
@@ -1506,7 +1929,7 @@ public:
             }
         }
         else if( xmlname == "initial" ) {
-            _vinitialvalues = std::vector<dReal>((istream_iterator<dReal>(_ss)), istream_iterator<dReal>());
+            utils::ParseRealValues(_ss, _vinitialvalues, _sbuffer);
         }
         else if( xmlname == "body" ) {
             // figure out which body
@@ -1533,7 +1956,8 @@ public:
                 throw openrave_exception(_("cannot specify <limits> with <lostop> and <histop>, choose one"));
             }
             dReal fmult = xmlname == "limitsdeg" ? fRatio : dReal(1.0);
-            vector<dReal> values = vector<dReal>((istream_iterator<dReal>(_ss)), istream_iterator<dReal>());
+            vector<dReal> values;
+            utils::ParseRealValues(_ss, values, _sbuffer);
             if( (int)values.size() == 2*_pjoint->GetDOF() ) {
                 for(int i = 0; i < _pjoint->GetDOF(); ++i ) {
                     _pjoint->_info._vlowerlimit.at(i) = fmult*min(values[2*i+0],values[2*i+1]);
@@ -1961,6 +2385,32 @@ protected:
 class KinBodyXMLReader : public InterfaceXMLReader
 {
 public:
+    /// \brief overwrites the colors of all the geometries of the body with the colors set in the kinbody tag
+    struct GeometryColorOverwriter
+    {
+        void operator()(std::list<KinBody::GeometryInfo>&, bool)
+        {
+            FOREACH(itlink, _pbody->_veclinks) {
+                FOREACH(itgeom, (*itlink)->_vGeometries) {
+                    if( _bOverwriteDiffuse ) {
+                        (*itgeom)->_info._vDiffuseColor = _diffusecol;
+                    }
+                    if( _bOverwriteAmbient ) {
+                        (*itgeom)->_info._vAmbientColor = _ambientcol;
+                    }
+                    if( _bOverwriteTransparency ) {
+                        (*itgeom)->_info._fTransparency = _transparency;
+                    }
+                }
+            }
+        }
+
+        KinBodyPtr _pbody;
+        bool _bOverwriteDiffuse, _bOverwriteAmbient, _bOverwriteTransparency;
+        RaveVector<float> _diffusecol, _ambientcol;
+        float _transparency;
+    };
+
     KinBodyXMLReader(EnvironmentBasePtr penv, InterfaceBasePtr& pchain, InterfaceType type, const AttributesList &atts, int roottransoffset) : InterfaceXMLReader(penv,pchain,type,"kinbody",atts), roottransoffset(roottransoffset) {
         _bSkipGeometry = false;
         _vScaleGeometry = Vector(1,1,1);
@@ -1972,6 +2422,11 @@ public:
         _bOverwriteTransparency = false;
         _bMakeJoinedLinksAdjacent = true;
         rootoffset = rootjoffset = rootjpoffset = -1;
+        _pgeometryqueue = GeometryLoadQueue::GetActive();
+        _bFlushGeometries = !_pgeometryqueue;
+        if( !_pgeometryqueue ) {
+            _pgeometryqueue.reset(new GeometryLoadQueue());
+        }
         FOREACHC(itatt,atts) {
             if( itatt->first == "prefix" ) {
                 _prefix = itatt->second;
@@ -2096,6 +2551,7 @@ public:
             plinkreader->SetMassType(_masstype, _fMassValue, _vMassExtents);
             plinkreader->_fnGetModelsDir = boost::bind(&KinBodyXMLReader::GetModelsDir,this,_1);
             plinkreader->_fnGetOffsetFrom = boost::bind(&KinBodyXMLReader::GetOffsetFrom,this,_1);
+            plinkreader->_pgeometryqueue = _pgeometryqueue;
             _pcurreader = plinkreader;
             return PE_Support;
         }
@@ -2262,7 +2718,8 @@ public:
                 _bOverwriteTransparency = true;
             }
             else if( xmlname == "jointvalues" ) {
-                _vjointvalues.reset(new std::vector<dReal>((istream_iterator<dReal>(_ss)), istream_iterator<dReal>()));
+                _vjointvalues.reset(new std::vector<dReal>());
+                utils::ParseRealValues(_ss, *_vjointvalues, _sbuffer);
             }
 
             if( xmlname !=_processingtag ) {
@@ -2295,29 +2752,22 @@ public:
                 }
             }
 
-            if( _bOverwriteDiffuse ) {
-                // overwrite the color
-                FOREACH(itlink, _pchain->_veclinks) {
-                    FOREACH(itgeom, (*itlink)->_vGeometries) {
-                        (*itgeom)->_info._vDiffuseColor = _diffusecol;
-                    }
-                }
+            GeometryColorOverwriter overwriter;
+            overwriter._pbody = _pchain;
+            overwriter._bOverwriteDiffuse = _bOverwriteDiffuse;
+            overwriter._bOverwriteAmbient = _bOverwriteAmbient;
+            overwriter._bOverwriteTransparency = _bOverwriteTransparency;
+            overwriter._diffusecol = _diffusecol;
+            overwriter._ambientcol = _ambientcol;
+            overwriter._transparency = _transparency;
+            if( _bFlushGeometries ) {
+                _pgeometryqueue->Flush();
+                std::list<KinBody::GeometryInfo> listGeometries;
+                overwriter(listGeometries, true);
             }
-            if( _bOverwriteAmbient ) {
-                // overwrite the color
-                FOREACH(itlink, _pchain->_veclinks) {
-                    FOREACH(itgeom, (*itlink)->_vGeometries) {
-                        (*itgeom)->_info._vAmbientColor = _ambientcol;
-                    }
-                }
-            }
-            if( _bOverwriteTransparency ) {
-                // overwrite the color
-                FOREACH(itlink, _pchain->_veclinks) {
-                    FOREACH(itgeom, (*itlink)->_vGeometries) {
-                        (*itgeom)->_info._fTransparency = _transparency;
-                    }
-                }
+            else if( _bOverwriteDiffuse || _bOverwriteAmbient || _bOverwriteTransparency ) {
+                // the owner of the queue flushes it, the colors have to be overwritten after the queued geometries are attached
+                _pgeometryqueue->Add(GeometryLoadQueue::LoadFn(), overwriter, true);
             }
 
             // transform all the bodies with trans
@@ -2373,6 +2823,8 @@ protected:
 
     string _processingtag;         /// if not empty, currently processing
     bool _bOverwriteDiffuse, _bOverwriteAmbient, _bOverwriteTransparency;
+    GeometryLoadQueuePtr _pgeometryqueue; ///< the link readers queue their mesh files into it
+    bool _bFlushGeometries; ///< if true, owns _pgeometryqueue and flushes it when the body is finished
 };
 
 class ControllerXMLReader : public InterfaceXMLReader
@@ -2598,7 +3050,7 @@ public:
             }
         }
         else if( xmlname == "closingdirection" || xmlname == "closingdir" || xmlname == "chuckingdirection" ) {
-            _manipinfo._vChuckingDirection = vector<dReal>((istream_iterator<dReal>(_ss)), istream_iterator<dReal>());
+            utils::ParseRealValues(_ss, _manipinfo._vChuckingDirection, _sbuffer);
             FOREACH(it, _manipinfo._vChuckingDirection) {
                 if( *it > 0 ) {
                     *it = 1;
@@ -2941,7 +3393,8 @@ public:
             else if( xmlname == "controller" ) {
             }
             else if( xmlname == "jointvalues" ) {
-                _vjointvalues.reset(new std::vector<dReal>((istream_iterator<dReal>(_ss)), istream_iterator<dReal>()));
+                _vjointvalues.reset(new std::vector<dReal>());
+                utils::ParseRealValues(_ss, *_vjointvalues, _sbuffer);
             }
 
             if( xmlname !=_processingtag ) {
@@ -3263,6 +3716,7 @@ public:
                 _penv->Load(filedata);
             }
         }
+        _pgeometryqueue.reset(new GeometryLoadQueue());
         _tCamera.trans = Vector(0, 1.5f, 0.8f);
         _tCamera.rot = quatFromAxisAngle(Vector(1, 0, 0), (dReal)-0.5);
         _fCameraFocalDistance = 0;
@@ -3272,6 +3726,7 @@ public:
 
     virtual ProcessElement startElement(const std::string& xmlname, const AttributesList &atts)
     {
+        GeometryLoadQueue::ActiveScope geometryscope(_pgeometryqueue);
         switch( StreamXMLReader::startElement(xmlname,atts) ) {
         case PE_Pass: break;
         case PE_Support: return PE_Support;
@@ -3310,6 +3765,7 @@ public:
 
     virtual bool endElement(const std::string& xmlname)
     {
+        GeometryLoadQueue::ActiveScope geometryscope(_pgeometryqueue);
         if( !!_pcurreader ) {
             if( _pcurreader->endElement(xmlname) ) {
                 if( !_bInEnvironment ) {
@@ -3322,56 +3778,42 @@ public:
                 if( !!boost::dynamic_pointer_cast<RobotXMLReader>(_pcurreader) ) {
                     boost::shared_ptr<RobotXMLReader> robotreader = boost::dynamic_pointer_cast<RobotXMLReader>(_pcurreader);
                     BOOST_ASSERT(_pinterface->GetInterfaceType()==PT_Robot);
-                    RobotBasePtr probot = RaveInterfaceCast<RobotBase>(_pinterface);
-                    _penv->Add(probot);
-                    if( !!robotreader->GetJointValues() ) {
-                        if( (int)robotreader->GetJointValues()->size() != probot->GetDOF() ) {
-                            RAVELOG_WARN(str(boost::format("<jointvalues> wrong number of values %d!=%d, robot=%s")%robotreader->GetJointValues()->size()%probot->GetDOF()%probot->GetName()));
-                        }
-                        else {
-                            probot->SetDOFValues(*robotreader->GetJointValues());
-                        }
-                    }
+                    _listPendingBodies.push_back(make_pair(KinBodyPtr(RaveInterfaceCast<RobotBase>(_pinterface)), robotreader->GetJointValues()));
                 }
                 else if( !!boost::dynamic_pointer_cast<KinBodyXMLReader>(_pcurreader) ) {
                     KinBodyXMLReaderPtr kinbodyreader = boost::dynamic_pointer_cast<KinBodyXMLReader>(_pcurreader);
                     BOOST_ASSERT(_pinterface->GetInterfaceType()==PT_KinBody);
-                    KinBodyPtr pbody = RaveInterfaceCast<KinBody>(_pinterface);
-                    _penv->Add(pbody);
-                    if( !!kinbodyreader->GetJointValues() ) {
-                        if( (int)kinbodyreader->GetJointValues()->size() != pbody->GetDOF() ) {
-                            RAVELOG_WARN(str(boost::format("<jointvalues> wrong number of values %d!=%d, body=%s")%kinbodyreader->GetJointValues()->size()%pbody->GetDOF()%pbody->GetName()));
-                        }
-                        else {
-                            pbody->SetDOFValues(*kinbodyreader->GetJointValues());
-                        }
-                    }
-                }
-                else if( !!boost::dynamic_pointer_cast<SensorXMLReader>(_pcurreader) ) {
-                    BOOST_ASSERT(_pinterface->GetInterfaceType()==PT_Sensor);
-                    _penv->Add(RaveInterfaceCast<SensorBase>(_pinterface));
+                    _listPendingBodies.push_back(make_pair(RaveInterfaceCast<KinBody>(_pinterface), kinbodyreader->GetJointValues()));
                 }
-                else if( !!boost::dynamic_pointer_cast< DummyInterfaceXMLReader<PT_PhysicsEngine> >(_pcurreader) ) {
-                    BOOST_ASSERT(_pinterface->GetInterfaceType()==PT_PhysicsEngine);
-                    _penv->SetPhysicsEngine(RaveInterfaceCast<PhysicsEngineBase>(_pinterface));
-                }
-                else if( !!boost::dynamic_pointer_cast< DummyInterfaceXMLReader<PT_CollisionChecker> >(_pcurreader) ) {
-                    BOOST_ASSERT(_pinterface->GetInterfaceType()==PT_CollisionChecker);
-                    _penv->SetCollisionChecker(RaveInterfaceCast<CollisionCheckerBase>(_pinterface));
-                }
-                else if( !!boost::dynamic_pointer_cast<ModuleXMLReader>(_pcurreader) ) {
-                    ModuleXMLReaderPtr modulereader = boost::dynamic_pointer_cast<ModuleXMLReader>(_pcurreader);
-                    ModuleBasePtr module = RaveInterfaceCast<ModuleBase>(_pinterface);
-                    if( !!module ) {
-                        int ret = _penv->AddModule(module,modulereader->GetArgs());
-                        if( ret ) {
-                            RAVELOG_WARN(str(boost::format("module %s returned %d\n")%module->GetXMLId()%ret));
+                else {
+                    // the other interfaces can refer to the bodies, so add the bodies first
+                    _AddPendingBodies();
+                    if( !!boost::dynamic_pointer_cast<SensorXMLReader>(_pcurreader) ) {
+                        BOOST_ASSERT(_pinterface->GetInterfaceType()==PT_Sensor);
+                        _penv->Add(RaveInterfaceCast<SensorBase>(_pinterface));
+                    }
+                    else if( !!boost::dynamic_pointer_cast< DummyInterfaceXMLReader<PT_PhysicsEngine> >(_pcurreader) ) {
+                        BOOST_ASSERT(_pinterface->GetInterfaceType()==PT_PhysicsEngine);
+                        _penv->SetPhysicsEngine(RaveInterfaceCast<PhysicsEngineBase>(_pinterface));
+                    }
+                    else if( !!boost::dynamic_pointer_cast< DummyInterfaceXMLReader<PT_CollisionChecker> >(_pcurreader) ) {
+                        BOOST_ASSERT(_pinterface->GetInterfaceType()==PT_CollisionChecker);
+                        _penv->SetCollisionChecker(RaveInterfaceCast<CollisionCheckerBase>(_pinterface));
+                    }
+                    else if( !!boost::dynamic_pointer_cast<ModuleXMLReader>(_pcurreader) ) {
+                        ModuleXMLReaderPtr modulereader = boost::dynamic_pointer_cast<ModuleXMLReader>(_pcurreader);
+                        ModuleBasePtr module = RaveInterfaceCast<ModuleBase>(_pinterface);
+                        if( !!module ) {
+                            int ret = _penv->AddModule(module,modulereader->GetArgs());
+                            if( ret ) {
+                                RAVELOG_WARN(str(boost::format("module %s returned %d\n")%module->GetXMLId()%ret));
+                            }
                         }
                     }
-                }
-                else if( !!_pinterface ) {
-                    RAVELOG_DEBUG("owning interface %s, type: %s\n",_pinterface->GetXMLId().c_str(),RaveGetInterfaceName(_pinterface->GetInterfaceType()).c_str());
-                    _penv->OwnInterface(_pinterface);
+                    else if( !!_pinterface ) {
+                        RAVELOG_DEBUG("owning interface %s, type: %s\n",_pinterface->GetXMLId().c_str(),RaveGetInterfaceName(_pinterface->GetInterfaceType()).c_str());
+                        _penv->OwnInterface(_pinterface);
+                    }
                 }
                 _pinterface.reset();
                 _pcurreader.reset();
@@ -3379,6 +3821,7 @@ public:
             return false;
         }
         if( xmlname == "environment" ) {
+            _AddPendingBodies();
             // only move the camera if trans is specified
             if( !!_penv->GetViewer() ) {
                 if( bTransSpecified ) {
@@ -3441,6 +3884,26 @@ public:
     }
 
 protected:
+    /// \brief loads the queued meshes of the parsed bodies in parallel and adds the bodies to the environment in parsing order
+    void _AddPendingBodies()
+    {
+        _pgeometryqueue->Flush();
+        std::list< std::pair<KinBodyPtr, boost::shared_ptr< std::vector<dReal> > > > listPendingBodies;
+        listPendingBodies.swap(_listPendingBodies);
+        FOREACH(itpending, listPendingBodies) {
+            KinBodyPtr pbody = itpending->first;
+            _penv->Add(pbody);
+            if( !!itpending->second ) {
+                if( (int)itpending->second->size() != pbody->GetDOF() ) {
+                    RAVELOG_WARN(str(boost::format("<jointvalues> wrong number of values %d!=%d, body=%s")%itpending->second->size()%pbody->GetDOF()%pbody->GetName()));
+                }
+                else {
+                    pbody->SetDOFValues(*itpending->second);
+                }
+            }
+        }
+    }
+
     EnvironmentBasePtr _penv;
     InterfaceBasePtr _pinterface;         // current processed interface
     Vector vBkgndColor;
@@ -3449,6 +3912,8 @@ protected:
     string _processingtag;
     bool bTransSpecified;
     bool _bInEnvironment;
+    GeometryLoadQueuePtr _pgeometryqueue; ///< the bodies parsed in the environment queue their mesh files into it
+    std::list< std::pair<KinBodyPtr, boost::shared_ptr< std::vector<dReal> > > > _listPendingBodies; ///< parsed bodies and their joint values waiting for their meshes before being added
 };
 
 BaseXMLReaderPtr CreateEnvironmentReader(EnvironmentBasePtr penv, const AttributesList &atts)
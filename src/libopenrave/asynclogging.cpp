@@ -0,0 +1,353 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2011 Rosen Diankov (rosen.diankov@gmail.com)
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "libopenrave.h"
+
+#include <stdarg.h>
+#include <boost/thread/tss.hpp>
+
+#if BOOST_VERSION >= 105300
+#define OPENRAVE_HAS_ASYNC_LOGGING
+#include <boost/atomic.hpp>
+#endif
+
+namespace OpenRAVE {
+
+#ifdef OPENRAVE_HAS_ASYNC_LOGGING
+
+/// \brief one formatted message, the header with the source location is already prepended
+struct AsyncLogRecord
+{
+    int level;
+    size_t length;
+    char message[512];
+};
+
+/// \brief ring of records written by exactly one logging thread and read by the one thread that holds AsyncLogger::_mutexconsume
+class AsyncLogRecordQueue
+{
+public:
+    AsyncLogRecordQueue(size_t size) : _vrecords(size), _head(0), _tail(0) {
+    }
+
+    /// \brief returns the record to fill, or NULL if the queue is full
+    AsyncLogRecord* BeginPush()
+    {
+        size_t tail = _tail.load(boost::memory_order_relaxed);
+        if( tail - _head.load(boost::memory_order_acquire) >= _vrecords.size() ) {
+            return NULL;
+        }
+        return &_vrecords[tail % _vrecords.size()];
+    }
+
+    /// \brief publishes the record returned by BeginPush to the consumer
+    void EndPush()
+    {
+        _tail.store(_tail.load(boost::memory_order_relaxed)+1, boost::memory_order_release);
+    }
+
+    /// \brief returns the oldest record, or NULL if the queue is empty
+    const AsyncLogRecord* Front() const
+    {
+        size_t head = _head.load(boost::memory_order_relaxed);
+        if( head == _tail.load(boost::memory_order_acquire) ) {
+            return NULL;
+        }
+        return &_vrecords[head % _vrecords.size()];
+    }
+
+    void Pop()
+    {
+        _head.store(_head.load(boost::memory_order_relaxed)+1, boost::memory_order_release);
+    }
+
+private:
+    std::vector<AsyncLogRecord> _vrecords;
+    boost::atomic<size_t> _head, _tail; ///< only the consumer writes _head and only the producer writes _tail
+};
+
+typedef boost::shared_ptr<AsyncLogRecordQueue> AsyncLogRecordQueuePtr;
+
+class AsyncLogger
+{
+public:
+    AsyncLogger() : _bAsync(false), _bStop(false), _nDropped(0), _queuesize(256) {
+    }
+
+    ~AsyncLogger() {
+        SetAsync(false, _queuesize);
+    }
+
+    void SetAsync(bool bAsync, size_t queuesize)
+    {
+        boost::mutex::scoped_lock lock(_mutexthread);
+        _queuesize = max(queuesize, size_t(1));
+        if( bAsync ) {
+            if( !_thread ) {
+                _bStop = false;
+                _thread.reset(new boost::thread(boost::bind(&AsyncLogger::_WriterThread, this)));
+            }
+            _bAsync.store(true, boost::memory_order_release);
+        }
+        else {
+            _bAsync.store(false, boost::memory_order_release);
+            if( !!_thread ) {
+                _bStop = true;
+                _thread->join();
+                _thread.reset();
+            }
+            Flush();
+        }
+    }
+
+    inline bool IsAsync() const {
+        return _bAsync.load(boost::memory_order_relaxed);
+    }
+
+    /// \brief returns the queue of the calling thread, creating it the first time
+    AsyncLogRecordQueue& GetThreadQueue()
+    {
+        AsyncLogRecordQueuePtr* ppqueue = _threadqueue.get();
+        if( !ppqueue ) {
+            ppqueue = new AsyncLogRecordQueuePtr(new AsyncLogRecordQueue(_queuesize));
+            _threadqueue.reset(ppqueue);
+            boost::mutex::scoped_lock lock(_mutexqueues);
+            _vqueues.push_back(*ppqueue);
+        }
+        return **ppqueue;
+    }
+
+    void AddDropped() {
+        _nDropped.fetch_add(1, boost::memory_order_relaxed);
+    }
+
+    uint64_t GetDropped() const {
+        return _nDropped.load(boost::memory_order_relaxed);
+    }
+
+    /// \brief writes all the pending records, can be called from any thread
+    void Flush()
+    {
+        boost::mutex::scoped_lock lock(_mutexconsume);
+        _Drain();
+    }
+
+private:
+    /// \brief writes the pending records of every queue and forgets the queues of the threads that exited. _mutexconsume has to be locked
+    bool _Drain()
+    {
+        {
+            boost::mutex::scoped_lock lock(_mutexqueues);
+            _vdrainqueues = _vqueues;
+            for(size_t i = 0; i < _vqueues.size(); ) {
+                // only held by _vqueues and _vdrainqueues, so its thread exited and it will not be pushed to anymore
+                if( _vqueues[i].use_count() <= 2 && !_vqueues[i]->Front() ) {
+                    _vqueues.erase(_vqueues.begin()+i);
+                }
+                else {
+                    ++i;
+                }
+            }
+        }
+        bool bwritten = false;
+        FOREACH(itqueue, _vdrainqueues) {
+            while(const AsyncLogRecord* precord = (*itqueue)->Front()) {
+                _message.assign(precord->message, precord->length);
+                RavePrintfA(_message, precord->level);
+                (*itqueue)->Pop();
+                bwritten = true;
+            }
+        }
+        _vdrainqueues.resize(0);
+        return bwritten;
+    }
+
+    void _WriterThread()
+    {
+        while(!_bStop) {
+            bool bwritten;
+            {
+                boost::mutex::scoped_lock lock(_mutexconsume);
+                bwritten = _Drain();
+            }
+            if( !bwritten ) {
+                boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+            }
+        }
+    }
+
+    boost::atomic<bool> _bAsync;
+    volatile bool _bStop;
+    boost::atomic<uint64_t> _nDropped;
+    size_t _queuesize;
+    boost::thread_specific_ptr<AsyncLogRecordQueuePtr> _threadqueue;
+    std::vector<AsyncLogRecordQueuePtr> _vqueues; ///< protected by _mutexqueues
+    std::vector<AsyncLogRecordQueuePtr> _vdrainqueues; ///< protected by _mutexconsume
+    std::string _message; ///< protected by _mutexconsume
+    boost::shared_ptr<boost::thread> _thread;
+    boost::mutex _mutexthread, _mutexqueues, _mutexconsume;
+};
+
+static AsyncLogger& GetAsyncLogger()
+{
+    static AsyncLogger logger;
+    return logger;
+}
+
+/// \brief returns the record to fill for the calling thread with the source location already written, or NULL if its queue is full
+static AsyncLogRecord* BeginAsyncLogRecord(int level, const char* pfilename, int line, const char* pfunction)
+{
+    AsyncLogger& logger = GetAsyncLogger();
+    AsyncLogRecord* precord = logger.GetThreadQueue().BeginPush();
+    if( !precord ) {
+        logger.AddDropped();
+        return NULL;
+    }
+    precord->level = level;
+    int n = snprintf(precord->message, sizeof(precord->message), "[%s:%d %s] ", pfilename, line, pfunction);
+    precord->length = n > 0 ? min(size_t(n), sizeof(precord->message)-1) : 0;
+    return precord;
+}
+
+static void EndAsyncLogRecord(AsyncLogRecord* precord, int n)
+{
+    if( n > 0 ) {
+        precord->length = min(precord->length + size_t(n), sizeof(precord->message)-1);
+    }
+    GetAsyncLogger().GetThreadQueue().EndPush();
+}
+
+bool RaveSetAsyncLogging(bool bAsync, size_t queuesize)
+{
+    GetAsyncLogger().SetAsync(bAsync, queuesize);
+    return true;
+}
+
+bool RaveIsAsyncLogging()
+{
+    return GetAsyncLogger().IsAsync();
+}
+
+void RaveFlushAsyncLogging()
+{
+    GetAsyncLogger().Flush();
+}
+
+uint64_t RaveGetAsyncLoggingDroppedCount()
+{
+    return GetAsyncLogger().GetDropped();
+}
+
+void RaveLogAsyncA(int level, const char* pfilename, int line, const char* pfunction, const std::string& s)
+{
+    AsyncLogRecord* precord = BeginAsyncLogRecord(level, pfilename, line, pfunction);
+    if( !!precord ) {
+        size_t n = min(s.size(), sizeof(precord->message)-1-precord->length);
+        memcpy(precord->message+precord->length, s.c_str(), n);
+        EndAsyncLogRecord(precord, (int)n);
+    }
+}
+
+void RaveLogAsyncA(int level, const char* pfilename, int line, const char* pfunction, const char* fmt, ...)
+{
+    AsyncLogRecord* precord = BeginAsyncLogRecord(level, pfilename, line, pfunction);
+    if( !!precord ) {
+        va_list list;
+        va_start(list, fmt);
+        int n = vsnprintf(precord->message+precord->length, sizeof(precord->message)-precord->length, fmt, list);
+        va_end(list);
+        EndAsyncLogRecord(precord, n);
+    }
+}
+
+void RaveLogAsyncW(int level, const char* pfilename, int line, const char* pfunction, const wchar_t* wfmt, ...)
+{
+    AsyncLogRecord* precord = BeginAsyncLogRecord(level, pfilename, line, pfunction);
+    if( !!precord ) {
+        wchar_t wmessage[sizeof(precord->message)];
+        va_list list;
+        va_start(list, wfmt);
+        int n = vswprintf(wmessage, sizeof(precord->message)-precord->length, wfmt, list);
+        va_end(list);
+        if( n < 0 ) {
+            // truncated messages fail with vswprintf, keep what was written
+            wmessage[sizeof(precord->message)-precord->length-1] = 0;
+        }
+        size_t nbytes = wcstombs(precord->message+precord->length, wmessage, sizeof(precord->message)-precord->length-1);
+        EndAsyncLogRecord(precord, nbytes == size_t(-1) ? 0 : (int)nbytes);
+    }
+}
+
+#else
+
+bool RaveSetAsyncLogging(bool bAsync, size_t queuesize)
+{
+    if( bAsync ) {
+        RAVELOG_WARN("asynchronous logging needs boost 1.53 or later, logging stays synchronous\n");
+    }
+    return !bAsync;
+}
+
+bool RaveIsAsyncLogging()
+{
+    return false;
+}
+
+void RaveFlushAsyncLogging()
+{
+}
+
+uint64_t RaveGetAsyncLoggingDroppedCount()
+{
+    return 0;
+}
+
+void RaveLogAsyncA(int level, const char* pfilename, int line, const char* pfunction, const std::string& s)
+{
+    RavePrintfA(s, level);
+}
+
+void RaveLogAsyncA(int level, const char* pfilename, int line, const char* pfunction, const char* fmt, ...)
+{
+    char message[512];
+    va_list list;
+    va_start(list, fmt);
+    vsnprintf(message, sizeof(message), fmt, list);
+    va_end(list);
+    RavePrintfA(std::string(message), level);
+}
+
+void RaveLogAsyncW(int level, const char* pfilename, int line, const char* pfunction, const wchar_t* wfmt, ...)
+{
+    wchar_t wmessage[512];
+    va_list list;
+    va_start(list, wfmt);
+    int n = vswprintf(wmessage, 512, wfmt, list);
+    va_end(list);
+    if( n < 0 ) {
+        wmessage[511] = 0;
+    }
+    char message[512];
+    if( wcstombs(message, wmessage, sizeof(message)-1) == size_t(-1) ) {
+        message[0] = 0;
+    }
+    message[sizeof(message)-1] = 0;
+    RavePrintfA(std::string(message), level);
+}
+
+#endif
+
+}
@@ -1337,359 +1337,395 @@ static void ConvertDOFRotation_QuatFrom3D(std::vector<dReal>::iterator ittarget,
     *(ittarget+3) = quat[3];
 }
 
-void ConfigurationSpecification::ConvertGroupData(std::vector<dReal>::iterator ittargetdata, size_t targetstride, const ConfigurationSpecification::Group& gtarget, std::vector<dReal>::const_iterator itsourcedata, size_t sourcestride, const ConfigurationSpecification::Group& gsource, size_t numpoints, EnvironmentBaseConstPtr penv, bool filluninitialized)
+ConfigurationSpecification::Converter::Converter() : _targetstride(0), _sourcestride(0), _bEnvironmentDefaults(false)
 {
+}
+
+ConfigurationSpecification::Converter::Converter(const ConfigurationSpecification& targetspec, const ConfigurationSpecification& sourcespec, EnvironmentBaseConstPtr penv, bool filluninitialized) : _targetstride(targetspec.GetDOF()), _sourcestride(sourcespec.GetDOF()), _bEnvironmentDefaults(false)
+{
+    for(size_t igroup = 0; igroup < targetspec._vgroups.size(); ++igroup) {
+        const ConfigurationSpecification::Group& gtarget = targetspec._vgroups[igroup];
+        std::vector<ConfigurationSpecification::Group>::const_iterator itcompatgroup = sourcespec.FindCompatibleGroup(gtarget);
+        if( itcompatgroup != sourcespec._vgroups.end() ) {
+            _AddGroup(gtarget, gtarget.offset, *itcompatgroup, itcompatgroup->offset, penv, filluninitialized);
+        }
+        else if( filluninitialized ) {
+            vector<dReal> vdefaultvalues(gtarget.dof,0);
+            const string& name = gtarget.name;
+            if( name.size() >= 12 && name.substr(0,12) == "joint_values" ) {
+                string bodyname;
+                stringstream ss(name.substr(12));
+                ss >> bodyname;
+                if( !!ss ) {
+                    if( !!penv ) {
+                        KinBodyPtr body = penv->GetKinBody(bodyname);
+                        if( !!body ) {
+                            vector<dReal> values;
+                            body->GetDOFValues(values);
+                            std::vector<int> indices((istream_iterator<int>(ss)), istream_iterator<int>());
+                            for(size_t i = 0; i < indices.size(); ++i) {
+                                vdefaultvalues.at(i) = values.at(indices[i]);
+                            }
+                            _bEnvironmentDefaults = true;
+                        }
+                    }
+                }
+            }
+            else if( name.size() >= 16 && name.substr(0,16) == "affine_transform" ) {
+                string bodyname;
+                int affinedofs;
+                stringstream ss(name.substr(16));
+                ss >> bodyname >> affinedofs;
+                if( !!ss ) {
+                    Transform tdefault;
+                    if( !!penv ) {
+                        KinBodyPtr body = penv->GetKinBody(bodyname);
+                        if( !!body ) {
+                            tdefault = body->GetTransform();
+                            _bEnvironmentDefaults = true;
+                        }
+                    }
+                    BOOST_ASSERT((int)vdefaultvalues.size() == RaveGetAffineDOF(affinedofs));
+                    RaveGetAffineDOFValuesFromTransform(vdefaultvalues.begin(),tdefault,affinedofs);
+                }
+            }
+            else if( name != "deltatime" ) {
+                // messages are too frequent
+                //RAVELOG_VERBOSE(str(boost::format("cannot initialize unknown group '%s'")%name));
+            }
+            for(int j = 0; j < gtarget.dof; ++j) {
+                _vfills.push_back(make_pair(gtarget.offset+j, vdefaultvalues[j]));
+            }
+        }
+    }
+}
+
+void ConfigurationSpecification::Converter::Convert(std::vector<dReal>::iterator ittargetdata, std::vector<dReal>::const_iterator itsourcedata, size_t numpoints) const
+{
+    if( numpoints == 0 ) {
+        return;
+    }
     if( numpoints > 1 ) {
-        BOOST_ASSERT(targetstride != 0 && sourcestride != 0 );
+        BOOST_ASSERT(_targetstride != 0 && _sourcestride != 0 );
+    }
+    if( _vcopies.size() == 1 && _vfills.size() == 0 && _vrotations.size() == 0 && _vcopies[0].second == _targetstride && _targetstride == _sourcestride ) {
+        // the points have the same layout, so all of them are one contiguous block
+        std::copy(itsourcedata, itsourcedata+numpoints*_targetstride, ittargetdata);
+        return;
+    }
+    for(size_t ipoint = 0; ipoint < numpoints; ++ipoint, ittargetdata += _targetstride, itsourcedata += _sourcestride) {
+        FOREACHC(itcopy, _vcopies) {
+            std::copy(itsourcedata+itcopy->first.first, itsourcedata+itcopy->first.first+itcopy->second, ittargetdata+itcopy->first.second);
+        }
+        FOREACHC(itfill, _vfills) {
+            *(ittargetdata+itfill->first) = itfill->second;
+        }
+        FOREACHC(itrotation, _vrotations) {
+            itrotation->second(ittargetdata+itrotation->first.second, itsourcedata+itrotation->first.first);
+        }
+    }
+}
+
+void ConfigurationSpecification::Converter::_AddCopy(int sourceindex, int targetindex)
+{
+    if( _vcopies.size() > 0 ) {
+        std::pair<std::pair<int,int>, int>& lastcopy = _vcopies.back();
+        if( lastcopy.first.first+lastcopy.second == sourceindex && lastcopy.first.second+lastcopy.second == targetindex ) {
+            lastcopy.second += 1;
+            return;
+        }
     }
+    _vcopies.push_back(make_pair(make_pair(sourceindex, targetindex), 1));
+}
+
+void ConfigurationSpecification::Converter::_AddGroup(const ConfigurationSpecification::Group& gtarget, int targetoffset, const ConfigurationSpecification::Group& gsource, int sourceoffset, EnvironmentBaseConstPtr penv, bool filluninitialized)
+{
     if( gsource.name == gtarget.name ) {
         BOOST_ASSERT(gsource.dof==gtarget.dof);
-        for(size_t i = 0; i < numpoints; ++i) {
-            if( i != 0 ) {
-                itsourcedata += sourcestride;
-                ittargetdata += targetstride;
-            }
-            std::copy(itsourcedata,itsourcedata+gsource.dof,ittargetdata);
+        for(int i = 0; i < gtarget.dof; ++i) {
+            _AddCopy(sourceoffset+i, targetoffset+i);
         }
+        return;
     }
-    else {
-        stringstream ss(gtarget.name);
-        std::vector<std::string> targettokens((istream_iterator<std::string>(ss)), istream_iterator<std::string>());
-        ss.clear();
-        ss.str(gsource.name);
-        std::vector<std::string> sourcetokens((istream_iterator<std::string>(ss)), istream_iterator<std::string>());
-
-        BOOST_ASSERT(targettokens.at(0) == sourcetokens.at(0));
-        vector<int> vtransferindices; vtransferindices.reserve(gtarget.dof);
-        std::vector<dReal> vdefaultvalues;
-        if( targettokens.at(0).size() >= 6 && targettokens.at(0).substr(0,6) == "joint_") {
-            std::vector<int> vsourceindices(gsource.dof), vtargetindices(gtarget.dof);
-            if( (int)sourcetokens.size() < gsource.dof+2 ) {
-                RAVELOG_DEBUG(str(boost::format("source tokens '%s' do not have %d dof indices, guessing....")%gsource.name%gsource.dof));
-                for(int i = 0; i < gsource.dof; ++i) {
-                    vsourceindices[i] = i;
-                }
+
+    stringstream ss(gtarget.name);
+    std::vector<std::string> targettokens((istream_iterator<std::string>(ss)), istream_iterator<std::string>());
+    ss.clear();
+    ss.str(gsource.name);
+    std::vector<std::string> sourcetokens((istream_iterator<std::string>(ss)), istream_iterator<std::string>());
+
+    BOOST_ASSERT(targettokens.at(0) == sourcetokens.at(0));
+    vector<int> vtransferindices; vtransferindices.reserve(gtarget.dof);
+    std::vector<dReal> vdefaultvalues;
+    int targetrotationstart = -1, targetrotationend = -1;
+    if( targettokens.at(0).size() >= 6 && targettokens.at(0).substr(0,6) == "joint_") {
+        std::vector<int> vsourceindices(gsource.dof), vtargetindices(gtarget.dof);
+        if( (int)sourcetokens.size() < gsource.dof+2 ) {
+            RAVELOG_DEBUG(str(boost::format("source tokens '%s' do not have %d dof indices, guessing....")%gsource.name%gsource.dof));
+            for(int i = 0; i < gsource.dof; ++i) {
+                vsourceindices[i] = i;
             }
-            else {
-                for(int i = 0; i < gsource.dof; ++i) {
-                    vsourceindices[i] = boost::lexical_cast<int>(sourcetokens.at(i+2));
-                }
+        }
+        else {
+            for(int i = 0; i < gsource.dof; ++i) {
+                vsourceindices[i] = boost::lexical_cast<int>(sourcetokens.at(i+2));
             }
-            if( (int)targettokens.size() < gtarget.dof+2 ) {
-                RAVELOG_WARN(str(boost::format("target tokens '%s' do not match dof '%d', guessing....")%gtarget.name%gtarget.dof));
-                for(int i = 0; i < gtarget.dof; ++i) {
-                    vtargetindices[i] = i;
-                }
+        }
+        if( (int)targettokens.size() < gtarget.dof+2 ) {
+            RAVELOG_WARN(str(boost::format("target tokens '%s' do not match dof '%d', guessing....")%gtarget.name%gtarget.dof));
+            for(int i = 0; i < gtarget.dof; ++i) {
+                vtargetindices[i] = i;
             }
-            else {
-                for(int i = 0; i < gtarget.dof; ++i) {
-                    vtargetindices[i] = boost::lexical_cast<int>(targettokens.at(i+2));
-                }
+        }
+        else {
+            for(int i = 0; i < gtarget.dof; ++i) {
+                vtargetindices[i] = boost::lexical_cast<int>(targettokens.at(i+2));
             }
+        }
 
-            bool bUninitializedData=false;
-            FOREACH(ittargetindex,vtargetindices) {
-                std::vector<int>::iterator it = find(vsourceindices.begin(),vsourceindices.end(),*ittargetindex);
-                if( it == vsourceindices.end() ) {
-                    bUninitializedData = true;
-                    vtransferindices.push_back(-1);
-                }
-                else {
-                    vtransferindices.push_back(static_cast<int>(it-vsourceindices.begin()));
-                }
+        bool bUninitializedData=false;
+        FOREACH(ittargetindex,vtargetindices) {
+            std::vector<int>::iterator it = find(vsourceindices.begin(),vsourceindices.end(),*ittargetindex);
+            if( it == vsourceindices.end() ) {
+                bUninitializedData = true;
+                vtransferindices.push_back(-1);
             }
+            else {
+                vtransferindices.push_back(static_cast<int>(it-vsourceindices.begin()));
+            }
+        }
 
-            if( bUninitializedData && filluninitialized ) {
-                KinBodyPtr pbody;
-                if( targettokens.size() > 1 ) {
-                    pbody = penv->GetKinBody(targettokens.at(1));
-                }
-                if( !pbody && sourcetokens.size() > 1 ) {
-                    pbody = penv->GetKinBody(sourcetokens.at(1));
+        if( bUninitializedData && filluninitialized ) {
+            KinBodyPtr pbody;
+            if( !!penv && targettokens.size() > 1 ) {
+                pbody = penv->GetKinBody(targettokens.at(1));
+            }
+            if( !!penv && !pbody && sourcetokens.size() > 1 ) {
+                pbody = penv->GetKinBody(sourcetokens.at(1));
+            }
+            if( !pbody ) {
+                RAVELOG_WARN(str(boost::format("could not find body '%s' or '%s'")%gtarget.name%gsource.name));
+                vdefaultvalues.resize(vtargetindices.size(),0);
+            }
+            else {
+                std::vector<dReal> vbodyvalues;
+                vdefaultvalues.resize(vtargetindices.size(),0);
+                if( targettokens[0] == "joint_values" ) {
+                    pbody->GetDOFValues(vbodyvalues);
                 }
-                if( !pbody ) {
-                    RAVELOG_WARN(str(boost::format("could not find body '%s' or '%s'")%gtarget.name%gsource.name));
-                    vdefaultvalues.resize(vtargetindices.size(),0);
+                else if( targettokens[0] == "joint_velocities" ) {
+                    pbody->GetDOFVelocities(vbodyvalues);
                 }
-                else {
-                    std::vector<dReal> vbodyvalues;
-                    vdefaultvalues.resize(vtargetindices.size(),0);
-                    if( targettokens[0] == "joint_values" ) {
-                        pbody->GetDOFValues(vbodyvalues);
-                    }
-                    else if( targettokens[0] == "joint_velocities" ) {
-                        pbody->GetDOFVelocities(vbodyvalues);
-                    }
-                    if( vbodyvalues.size() > 0 ) {
-                        for(size_t i = 0; i < vdefaultvalues.size(); ++i) {
-                            vdefaultvalues[i] = vbodyvalues.at(vtargetindices[i]);
-                        }
+                if( vbodyvalues.size() > 0 ) {
+                    for(size_t i = 0; i < vdefaultvalues.size(); ++i) {
+                        vdefaultvalues[i] = vbodyvalues.at(vtargetindices[i]);
                     }
                 }
+                _bEnvironmentDefaults = true;
             }
         }
-        else if( targettokens.at(0).size() >= 7 && targettokens.at(0).substr(0,7) == "affine_") {
-            int affinesource = 0, affinetarget = 0;
-            Vector sourceaxis(0,0,1), targetaxis(0,0,1);
-            if( sourcetokens.size() < 3 ) {
-                if( targettokens.size() < 3 && gsource.dof == gtarget.dof ) {
-                    for(size_t i = 0; i < targettokens.size(); ++i) {
-                        vtransferindices[i] = i;
-                    }
-                }
-                else {
-                    throw OPENRAVE_EXCEPTION_FORMAT(_("source affine information not present '%s'\n"),gsource.name,ORE_InvalidArguments);
+    }
+    else if( targettokens.at(0).size() >= 7 && targettokens.at(0).substr(0,7) == "affine_") {
+        int affinesource = 0, affinetarget = 0;
+        Vector sourceaxis(0,0,1), targetaxis(0,0,1);
+        if( sourcetokens.size() < 3 ) {
+            if( targettokens.size() < 3 && gsource.dof == gtarget.dof ) {
+                for(int i = 0; i < gtarget.dof; ++i) {
+                    vtransferindices.push_back(i);
                 }
             }
             else {
-                affinesource = boost::lexical_cast<int>(sourcetokens.at(2));
-                BOOST_ASSERT(RaveGetAffineDOF(affinesource) == gsource.dof);
-                if( (affinesource & DOF_RotationAxis) && sourcetokens.size() >= 6 ) {
-                    sourceaxis.x = boost::lexical_cast<dReal>(sourcetokens.at(3));
-                    sourceaxis.y = boost::lexical_cast<dReal>(sourcetokens.at(4));
-                    sourceaxis.z = boost::lexical_cast<dReal>(sourcetokens.at(5));
-                }
+                throw OPENRAVE_EXCEPTION_FORMAT(_("source affine information not present '%s'\n"),gsource.name,ORE_InvalidArguments);
             }
-            if( vtransferindices.size() == 0 ) {
-                if( targettokens.size() < 3 ) {
-                    throw OPENRAVE_EXCEPTION_FORMAT(_("target affine information not present '%s'\n"),gtarget.name,ORE_InvalidArguments);
-                }
-                else {
-                    affinetarget = boost::lexical_cast<int>(targettokens.at(2));
-                    BOOST_ASSERT(RaveGetAffineDOF(affinetarget) == gtarget.dof);
-                    if( (affinetarget & DOF_RotationAxis) && targettokens.size() >= 6 ) {
-                        targetaxis.x = boost::lexical_cast<dReal>(targettokens.at(3));
-                        targetaxis.y = boost::lexical_cast<dReal>(targettokens.at(4));
-                        targetaxis.z = boost::lexical_cast<dReal>(targettokens.at(5));
-                    }
+        }
+        else {
+            affinesource = boost::lexical_cast<int>(sourcetokens.at(2));
+            BOOST_ASSERT(RaveGetAffineDOF(affinesource) == gsource.dof);
+            if( (affinesource & DOF_RotationAxis) && sourcetokens.size() >= 6 ) {
+                sourceaxis.x = boost::lexical_cast<dReal>(sourcetokens.at(3));
+                sourceaxis.y = boost::lexical_cast<dReal>(sourcetokens.at(4));
+                sourceaxis.z = boost::lexical_cast<dReal>(sourcetokens.at(5));
+            }
+        }
+        if( vtransferindices.size() == 0 ) {
+            if( targettokens.size() < 3 ) {
+                throw OPENRAVE_EXCEPTION_FORMAT(_("target affine information not present '%s'\n"),gtarget.name,ORE_InvalidArguments);
+            }
+            else {
+                affinetarget = boost::lexical_cast<int>(targettokens.at(2));
+                BOOST_ASSERT(RaveGetAffineDOF(affinetarget) == gtarget.dof);
+                if( (affinetarget & DOF_RotationAxis) && targettokens.size() >= 6 ) {
+                    targetaxis.x = boost::lexical_cast<dReal>(targettokens.at(3));
+                    targetaxis.y = boost::lexical_cast<dReal>(targettokens.at(4));
+                    targetaxis.z = boost::lexical_cast<dReal>(targettokens.at(5));
                 }
+            }
 
-                int commondata = affinesource&affinetarget;
-                int uninitdata = affinetarget&(~commondata);
-                int sourcerotationstart = -1, targetrotationstart = -1, targetrotationend = -1;
-                boost::function< void(std::vector<dReal>::iterator, std::vector<dReal>::const_iterator) > rotconverterfn;
-                if( (uninitdata & DOF_RotationMask) && (affinetarget & DOF_RotationMask) && (affinesource & DOF_RotationMask) ) {
-                    // both hold rotations, but need to convert
-                    uninitdata &= ~DOF_RotationMask;
-                    sourcerotationstart = RaveGetIndexFromAffineDOF(affinesource,DOF_RotationMask);
-                    targetrotationstart = RaveGetIndexFromAffineDOF(affinetarget,DOF_RotationMask);
-                    targetrotationend = targetrotationstart+RaveGetAffineDOF(affinetarget&DOF_RotationMask);
-                    if( affinetarget & DOF_RotationAxis ) {
-                        if( affinesource & DOF_Rotation3D ) {
-                            rotconverterfn = boost::bind(ConvertDOFRotation_AxisFrom3D,_1,_2,targetaxis);
-                        }
-                        else if( affinesource & DOF_RotationQuat ) {
-                            rotconverterfn = boost::bind(ConvertDOFRotation_AxisFromQuat,_1,_2,targetaxis);
-                        }
+            int commondata = affinesource&affinetarget;
+            int uninitdata = affinetarget&(~commondata);
+            if( (uninitdata & DOF_RotationMask) && (affinetarget & DOF_RotationMask) && (affinesource & DOF_RotationMask) ) {
+                // both hold rotations, but need to convert
+                RotationConverterFn rotconverterfn;
+                uninitdata &= ~DOF_RotationMask;
+                int sourcerotationstart = RaveGetIndexFromAffineDOF(affinesource,DOF_RotationMask);
+                targetrotationstart = RaveGetIndexFromAffineDOF(affinetarget,DOF_RotationMask);
+                targetrotationend = targetrotationstart+RaveGetAffineDOF(affinetarget&DOF_RotationMask);
+                if( affinetarget & DOF_RotationAxis ) {
+                    if( affinesource & DOF_Rotation3D ) {
+                        rotconverterfn = boost::bind(ConvertDOFRotation_AxisFrom3D,_1,_2,targetaxis);
                     }
-                    else if( affinetarget & DOF_Rotation3D ) {
-                        if( affinesource & DOF_RotationAxis ) {
-                            rotconverterfn = boost::bind(ConvertDOFRotation_3DFromAxis,_1,_2,sourceaxis);
-                        }
-                        else if( affinesource & DOF_RotationQuat ) {
-                            rotconverterfn = ConvertDOFRotation_3DFromQuat;
-                        }
+                    else if( affinesource & DOF_RotationQuat ) {
+                        rotconverterfn = boost::bind(ConvertDOFRotation_AxisFromQuat,_1,_2,targetaxis);
                     }
-                    else if( affinetarget & DOF_RotationQuat ) {
-                        if( affinesource & DOF_RotationAxis ) {
-                            rotconverterfn = boost::bind(ConvertDOFRotation_QuatFromAxis,_1,_2,sourceaxis);
-                        }
-                        else if( affinesource & DOF_Rotation3D ) {
-                            rotconverterfn = ConvertDOFRotation_QuatFrom3D;
-                        }
-                    }
-                    BOOST_ASSERT(!!rotconverterfn);
                 }
-                if( uninitdata && filluninitialized ) {
-                    // initialize with the current body values
-                    KinBodyPtr pbody;
-                    if( targettokens.size() > 1 ) {
-                        pbody = penv->GetKinBody(targettokens.at(1));
-                    }
-                    if( !pbody && sourcetokens.size() > 1 ) {
-                        pbody = penv->GetKinBody(sourcetokens.at(1));
+                else if( affinetarget & DOF_Rotation3D ) {
+                    if( affinesource & DOF_RotationAxis ) {
+                        rotconverterfn = boost::bind(ConvertDOFRotation_3DFromAxis,_1,_2,sourceaxis);
                     }
-                    if( !pbody ) {
-                        RAVELOG_WARN(str(boost::format("could not find body '%s' or '%s'")%gtarget.name%gsource.name));
-                        vdefaultvalues.resize(gtarget.dof,0);
-                    }
-                    else {
-                        vdefaultvalues.resize(gtarget.dof);
-                        RaveGetAffineDOFValuesFromTransform(vdefaultvalues.begin(),pbody->GetTransform(),affinetarget);
+                    else if( affinesource & DOF_RotationQuat ) {
+                        rotconverterfn = ConvertDOFRotation_3DFromQuat;
                     }
                 }
-
-                for(int index = 0; index < gtarget.dof; ++index) {
-                    DOFAffine dof = RaveGetAffineDOFFromIndex(affinetarget,index);
-                    int startindex = RaveGetIndexFromAffineDOF(affinetarget,dof);
-                    if( affinesource & dof ) {
-                        int sourceindex = RaveGetIndexFromAffineDOF(affinesource,dof);
-                        vtransferindices.push_back(sourceindex + (index-startindex));
+                else if( affinetarget & DOF_RotationQuat ) {
+                    if( affinesource & DOF_RotationAxis ) {
+                        rotconverterfn = boost::bind(ConvertDOFRotation_QuatFromAxis,_1,_2,sourceaxis);
                     }
-                    else {
-                        vtransferindices.push_back(-1);
+                    else if( affinesource & DOF_Rotation3D ) {
+                        rotconverterfn = ConvertDOFRotation_QuatFrom3D;
                     }
                 }
-
-                for(size_t i = 0; i < numpoints; ++i, itsourcedata += sourcestride, ittargetdata += targetstride) {
-                    for(int j = 0; j < (int)vtransferindices.size(); ++j) {
-                        if( vtransferindices[j] >= 0 ) {
-                            *(ittargetdata+j) = *(itsourcedata+vtransferindices[j]);
-                        }
-                        else {
-                            if( j >= targetrotationstart && j < targetrotationend ) {
-                                if( j == targetrotationstart ) {
-                                    // only convert when at first index
-                                    rotconverterfn(ittargetdata+targetrotationstart,itsourcedata+sourcerotationstart);
-                                }
-                            }
-                            else if( filluninitialized ) {
-                                *(ittargetdata+j) = vdefaultvalues.at(j);
-                            }
-                        }
-                    }
-                }
-                return;
-            }
-        }
-        else if( targettokens.at(0).size() >= 8 && targettokens.at(0).substr(0,8) == "ikparam_") {
-            IkParameterizationType iktypesource, iktypetarget;
-            if( sourcetokens.size() >= 2 ) {
-                iktypesource = static_cast<IkParameterizationType>(boost::lexical_cast<int>(sourcetokens[1]));
-            }
-            else {
-                throw OPENRAVE_EXCEPTION_FORMAT(_("ikparam type not present '%s'\n"),gsource.name,ORE_InvalidArguments);
-            }
-            if( targettokens.size() >= 2 ) {
-                iktypetarget = static_cast<IkParameterizationType>(boost::lexical_cast<int>(targettokens[1]));
-            }
-            else {
-                throw OPENRAVE_EXCEPTION_FORMAT(_("ikparam type not present '%s'\n"),gtarget.name,ORE_InvalidArguments);
+                BOOST_ASSERT(!!rotconverterfn);
+                _vrotations.push_back(make_pair(make_pair(sourceoffset+sourcerotationstart, targetoffset+targetrotationstart), rotconverterfn));
             }
-
-            if( iktypetarget == iktypesource ) {
-                vtransferindices.resize(IkParameterization::GetDOF(iktypetarget));
-                for(size_t i = 0; i < vtransferindices.size(); ++i) {
-                    vtransferindices[i] = i;
+            if( uninitdata && filluninitialized ) {
+                // initialize with the current body values
+                KinBodyPtr pbody;
+                if( !!penv && targettokens.size() > 1 ) {
+                    pbody = penv->GetKinBody(targettokens.at(1));
                 }
-            }
-            else {
-                RAVELOG_WARN("ikparam types do not match");
-            }
-        }
-        // need a space since grabbody is also a group
-        else if( targettokens.at(0) == std::string("grab") ) {
-            std::vector<int> vsourceindices(gsource.dof), vtargetindices(gtarget.dof);
-            if( (int)sourcetokens.size() < gsource.dof+2 ) {
-                throw OPENRAVE_EXCEPTION_FORMAT(_("source tokens '%s' do not have %d dof indices, guessing...."), gsource.name%gsource.dof, ORE_InvalidArguments);
-            }
-            else {
-                for(int i = 0; i < gsource.dof; ++i) {
-                    vsourceindices[i] = boost::lexical_cast<int>(sourcetokens.at(i+2));
+                if( !!penv && !pbody && sourcetokens.size() > 1 ) {
+                    pbody = penv->GetKinBody(sourcetokens.at(1));
                 }
-            }
-            if( (int)targettokens.size() < gtarget.dof+2 ) {
-                throw OPENRAVE_EXCEPTION_FORMAT(_("target tokens '%s' do not match dof '%d', guessing...."), gtarget.name%gtarget.dof, ORE_InvalidArguments);
-            }
-            else {
-                for(int i = 0; i < gtarget.dof; ++i) {
-                    vtargetindices[i] = boost::lexical_cast<int>(targettokens.at(i+2));
+                if( !pbody ) {
+                    RAVELOG_WARN(str(boost::format("could not find body '%s' or '%s'")%gtarget.name%gsource.name));
+                    vdefaultvalues.resize(gtarget.dof,0);
+                }
+                else {
+                    vdefaultvalues.resize(gtarget.dof);
+                    RaveGetAffineDOFValuesFromTransform(vdefaultvalues.begin(),pbody->GetTransform(),affinetarget);
+                    _bEnvironmentDefaults = true;
                 }
             }
 
-            bool bUninitializedData=false;
-            FOREACH(ittargetindex,vtargetindices) {
-                std::vector<int>::iterator it = find(vsourceindices.begin(),vsourceindices.end(),*ittargetindex);
-                if( it == vsourceindices.end() ) {
-                    bUninitializedData = true;
-                    vtransferindices.push_back(-1);
+            for(int index = 0; index < gtarget.dof; ++index) {
+                DOFAffine dof = RaveGetAffineDOFFromIndex(affinetarget,index);
+                int startindex = RaveGetIndexFromAffineDOF(affinetarget,dof);
+                if( affinesource & dof ) {
+                    int sourceindex = RaveGetIndexFromAffineDOF(affinesource,dof);
+                    vtransferindices.push_back(sourceindex + (index-startindex));
                 }
                 else {
-                    vtransferindices.push_back(static_cast<int>(it-vsourceindices.begin()));
+                    vtransferindices.push_back(-1);
                 }
             }
-
-            if( bUninitializedData && filluninitialized ) {
-                vdefaultvalues.resize(vtargetindices.size(),0);
-            }
         }
-        else if( targettokens.at(0) == std::string("grabbody") ) {
-            // TODO
+    }
+    else if( targettokens.at(0).size() >= 8 && targettokens.at(0).substr(0,8) == "ikparam_") {
+        IkParameterizationType iktypesource, iktypetarget;
+        if( sourcetokens.size() >= 2 ) {
+            iktypesource = static_cast<IkParameterizationType>(boost::lexical_cast<int>(sourcetokens[1]));
+        }
+        else {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("ikparam type not present '%s'\n"),gsource.name,ORE_InvalidArguments);
+        }
+        if( targettokens.size() >= 2 ) {
+            iktypetarget = static_cast<IkParameterizationType>(boost::lexical_cast<int>(targettokens[1]));
         }
         else {
-            throw OPENRAVE_EXCEPTION_FORMAT(_("unsupported token conversion: %s"),gtarget.name,ORE_InvalidArguments);
+            throw OPENRAVE_EXCEPTION_FORMAT(_("ikparam type not present '%s'\n"),gtarget.name,ORE_InvalidArguments);
         }
 
-        for(size_t i = 0; i < numpoints; ++i, itsourcedata += sourcestride, ittargetdata += targetstride) {
-            for(size_t j = 0; j < vtransferindices.size(); ++j) {
-                if( vtransferindices[j] >= 0 ) {
-                    *(ittargetdata+j) = *(itsourcedata+vtransferindices[j]);
-                }
-                else if( filluninitialized ) {
-                    *(ittargetdata+j) = vdefaultvalues.at(j);
-                }
+        if( iktypetarget == iktypesource ) {
+            vtransferindices.resize(IkParameterization::GetDOF(iktypetarget));
+            for(size_t i = 0; i < vtransferindices.size(); ++i) {
+                vtransferindices[i] = i;
             }
         }
+        else {
+            RAVELOG_WARN("ikparam types do not match");
+        }
     }
-}
-
-void ConfigurationSpecification::ConvertData(std::vector<dReal>::iterator ittargetdata, const ConfigurationSpecification &targetspec, std::vector<dReal>::const_iterator itsourcedata, const ConfigurationSpecification &sourcespec, size_t numpoints, EnvironmentBaseConstPtr penv, bool filluninitialized)
-{
-    for(size_t igroup = 0; igroup < targetspec._vgroups.size(); ++igroup) {
-        std::vector<ConfigurationSpecification::Group>::const_iterator itcompatgroup = sourcespec.FindCompatibleGroup(targetspec._vgroups[igroup]);
-        if( itcompatgroup != sourcespec._vgroups.end() ) {
-            ConfigurationSpecification::ConvertGroupData(ittargetdata+targetspec._vgroups[igroup].offset, targetspec.GetDOF(), targetspec._vgroups[igroup], itsourcedata+itcompatgroup->offset, sourcespec.GetDOF(), *itcompatgroup,numpoints,penv,filluninitialized);
+    // need a space since grabbody is also a group
+    else if( targettokens.at(0) == std::string("grab") ) {
+        std::vector<int> vsourceindices(gsource.dof), vtargetindices(gtarget.dof);
+        if( (int)sourcetokens.size() < gsource.dof+2 ) {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("source tokens '%s' do not have %d dof indices, guessing...."), gsource.name%gsource.dof, ORE_InvalidArguments);
         }
-        else if( filluninitialized ) {
-            vector<dReal> vdefaultvalues(targetspec._vgroups[igroup].dof,0);
-            const string& name = targetspec._vgroups[igroup].name;
-            if( name.size() >= 12 && name.substr(0,12) == "joint_values" ) {
-                string bodyname;
-                stringstream ss(name.substr(12));
-                ss >> bodyname;
-                if( !!ss ) {
-                    if( !!penv ) {
-                        KinBodyPtr body = penv->GetKinBody(bodyname);
-                        if( !!body ) {
-                            vector<dReal> values;
-                            body->GetDOFValues(values);
-                            std::vector<int> indices((istream_iterator<int>(ss)), istream_iterator<int>());
-                            for(size_t i = 0; i < indices.size(); ++i) {
-                                vdefaultvalues.at(i) = values.at(indices[i]);
-                            }
-                        }
-                    }
-                }
+        else {
+            for(int i = 0; i < gsource.dof; ++i) {
+                vsourceindices[i] = boost::lexical_cast<int>(sourcetokens.at(i+2));
             }
-            else if( name.size() >= 16 && name.substr(0,16) == "affine_transform" ) {
-                string bodyname;
-                int affinedofs;
-                stringstream ss(name.substr(16));
-                ss >> bodyname >> affinedofs;
-                if( !!ss ) {
-                    Transform tdefault;
-                    if( !!penv ) {
-                        KinBodyPtr body = penv->GetKinBody(bodyname);
-                        if( !!body ) {
-                            tdefault = body->GetTransform();
-                        }
-                    }
-                    BOOST_ASSERT((int)vdefaultvalues.size() == RaveGetAffineDOF(affinedofs));
-                    RaveGetAffineDOFValuesFromTransform(vdefaultvalues.begin(),tdefault,affinedofs);
-                }
+        }
+        if( (int)targettokens.size() < gtarget.dof+2 ) {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("target tokens '%s' do not match dof '%d', guessing...."), gtarget.name%gtarget.dof, ORE_InvalidArguments);
+        }
+        else {
+            for(int i = 0; i < gtarget.dof; ++i) {
+                vtargetindices[i] = boost::lexical_cast<int>(targettokens.at(i+2));
             }
-            else if( name != "deltatime" ) {
-                // messages are too frequent
-                //RAVELOG_VERBOSE(str(boost::format("cannot initialize unknown group '%s'")%name));
+        }
+
+        bool bUninitializedData=false;
+        FOREACH(ittargetindex,vtargetindices) {
+            std::vector<int>::iterator it = find(vsourceindices.begin(),vsourceindices.end(),*ittargetindex);
+            if( it == vsourceindices.end() ) {
+                bUninitializedData = true;
+                vtransferindices.push_back(-1);
             }
-            int offset = targetspec._vgroups[igroup].offset;
-            for(size_t i = 0; i < numpoints; ++i, offset += targetspec.GetDOF()) {
-                for(size_t j = 0; j < vdefaultvalues.size(); ++j) {
-                    *(ittargetdata+offset+j) = vdefaultvalues[j];
-                }
+            else {
+                vtransferindices.push_back(static_cast<int>(it-vsourceindices.begin()));
             }
         }
+
+        if( bUninitializedData && filluninitialized ) {
+            vdefaultvalues.resize(vtargetindices.size(),0);
+        }
+    }
+    else if( targettokens.at(0) == std::string("grabbody") ) {
+        // TODO
+    }
+    else {
+        throw OPENRAVE_EXCEPTION_FORMAT(_("unsupported token conversion: %s"),gtarget.name,ORE_InvalidArguments);
+    }
+
+    for(int j = 0; j < (int)vtransferindices.size(); ++j) {
+        if( vtransferindices[j] >= 0 ) {
+            _AddCopy(sourceoffset+vtransferindices[j], targetoffset+j);
+        }
+        else if( j >= targetrotationstart && j < targetrotationend ) {
+            // computed by the rotation converter
+        }
+        else if( filluninitialized ) {
+            _vfills.push_back(make_pair(targetoffset+j, vdefaultvalues.at(j)));
+        }
+    }
+}
+
+void ConfigurationSpecification::ConvertGroupData(std::vector<dReal>::iterator ittargetdata, size_t targetstride, const ConfigurationSpecification::Group& gtarget, std::vector<dReal>::const_iterator itsourcedata, size_t sourcestride, const ConfigurationSpecification::Group& gsource, size_t numpoints, EnvironmentBaseConstPtr penv, bool filluninitialized)
+{
+    if( numpoints > 1 ) {
+        BOOST_ASSERT(targetstride != 0 && sourcestride != 0 );
     }
+    Converter converter;
+    converter._targetstride = targetstride;
+    converter._sourcestride = sourcestride;
+    converter._AddGroup(gtarget, 0, gsource, 0, penv, filluninitialized);
+    converter.Convert(ittargetdata, itsourcedata, numpoints);
+}
+
+void ConfigurationSpecification::ConvertData(std::vector<dReal>::iterator ittargetdata, const ConfigurationSpecification &targetspec, std::vector<dReal>::const_iterator itsourcedata, const ConfigurationSpecification &sourcespec, size_t numpoints, EnvironmentBaseConstPtr penv, bool filluninitialized)
+{
+    Converter(targetspec, sourcespec, penv, filluninitialized).Convert(ittargetdata, itsourcedata, numpoints);
 }
 
 std::string ConfigurationSpecification::GetInterpolationDerivative(const std::string& interpolation, int deriv)
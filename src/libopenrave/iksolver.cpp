@@ -67,6 +67,7 @@ public:
         IkSolverBasePtr iksolver = _iksolverweak.lock();
         if( !!iksolver ) {
             iksolver->__listRegisteredFilters.erase(_iterator);
+            ++iksolver->__nFilterStamp;
         }
     }
 
@@ -133,6 +134,21 @@ bool IkSolverBase::SolveAll(const IkParameterization& param, int filteroptions,
     return vsolutions.size() > 0;
 }
 
+int IkSolverBase::SolveAllBatch(const std::vector<IkParameterization>& vparams, int filteroptions, std::vector< std::vector<IkReturnPtr> >& vikreturns)
+{
+    vikreturns.resize(vparams.size());
+    int numsolved = 0;
+    for(size_t i = 0; i < vparams.size(); ++i) {
+        if( SolveAll(vparams[i], filteroptions, vikreturns[i]) ) {
+            ++numsolved;
+        }
+        else {
+            vikreturns[i].resize(0);
+        }
+    }
+    return numsolved;
+}
+
 bool IkSolverBase::Solve(const IkParameterization& param, const std::vector<dReal>& q0, const std::vector<dReal>& vFreeParameters, int filteroptions, IkReturnPtr ikreturn)
 {
     if( !ikreturn ) {
@@ -175,6 +191,7 @@ UserDataPtr IkSolverBase::RegisterCustomFilter(int32_t priority, const IkSolverB
         }
     }
     pdata->_iterator = __listRegisteredFilters.insert(it,pdata);
+    ++__nFilterStamp;
     return pdata;
 }
 
@@ -185,10 +202,35 @@ UserDataPtr IkSolverBase::RegisterFinishCallback(const IkFinishCallbackFn& finis
     return pdata;
 }
 
+void IkSolverBase::__UpdateFilterDispatch() const
+{
+    // __listRegisteredFilters is already sorted by descending priority
+    __vFilterDispatch.resize(0);
+    FOREACHC(it,__listRegisteredFilters) {
+        CustomIkSolverFilterDataPtr pitdata = boost::dynamic_pointer_cast<CustomIkSolverFilterData>(it->lock());
+        if( !!pitdata ) {
+            __vFilterDispatch.push_back(pitdata.get());
+        }
+    }
+    __nFilterDispatchStamp = __nFilterStamp;
+}
+
+/// \brief orders the filters by descending priority
+static bool CustomIkSolverFilterDataPriorityGreater(const CustomIkSolverFilterData* pdata, int32_t priority)
+{
+    return pdata->_priority > priority;
+}
+
+size_t IkSolverBase::__FindFirstFilter(int32_t maxpriority) const
+{
+    return std::lower_bound(__vFilterDispatch.begin(), __vFilterDispatch.end(), maxpriority, CustomIkSolverFilterDataPriorityGreater) - __vFilterDispatch.begin();
+}
+
 IkReturnAction IkSolverBase::_CallFilters(std::vector<dReal>& solution, RobotBase::ManipulatorPtr manipulator, const IkParameterization& param, IkReturnPtr filterreturn, int32_t minpriority, int32_t maxpriority)
 {
-    vector<dReal> vtestsolution,vtestsolution2;
+    vector<dReal> vtestsolution;
     if( IS_DEBUGLEVEL(Level_Verbose) || (RaveGetDebugLevel() & Level_VerifyPlans) ) {
+        // the robot has to be set to the solution once before the filters are called
         RobotBasePtr robot = manipulator->GetRobot();
         robot->GetConfigurationValues(vtestsolution);
         for(size_t i = 0; i < manipulator->GetArmIndices().size(); ++i) {
@@ -202,33 +244,50 @@ IkReturnAction IkSolverBase::_CallFilters(std::vector<dReal>& solution, RobotBas
         }
     }
 
-    FOREACHC(it,__listRegisteredFilters) {
-        CustomIkSolverFilterDataPtr pitdata = boost::dynamic_pointer_cast<CustomIkSolverFilterData>(it->lock());
-        if( !!pitdata && pitdata->_priority >= minpriority && pitdata->_priority <= maxpriority) {
-            IkReturn ret = pitdata->_filterfn(solution,manipulator,param);
-            if( ret != IKRA_Success ) {
-                return ret._action; // just return the action
+    if( __nFilterDispatchStamp != __nFilterStamp ) {
+        __UpdateFilterDispatch();
+    }
+    size_t index = __FindFirstFilter(maxpriority);
+    while(index < __vFilterDispatch.size() ) {
+        CustomIkSolverFilterData* pdata = __vFilterDispatch[index];
+        int32_t priority = pdata->_priority;
+        if( priority < minpriority ) {
+            break;
+        }
+        IkReturn ret = pdata->_filterfn(solution,manipulator,param);
+        if( ret != IKRA_Success ) {
+            return ret._action; // just return the action
+        }
+        if( !!filterreturn ) {
+            filterreturn->Append(ret);
+        }
+        if( __nFilterDispatchStamp != __nFilterStamp ) {
+            // the filter registered or released filters, so continue after it in the new order
+            __UpdateFilterDispatch();
+            std::vector<CustomIkSolverFilterData*>::iterator itdata = std::find(__vFilterDispatch.begin(), __vFilterDispatch.end(), pdata);
+            if( itdata != __vFilterDispatch.end() ) {
+                index = (itdata - __vFilterDispatch.begin()) + 1;
             }
-            if( vtestsolution.size() > 0 ) {
-                // check that the robot is set to solution
-                RobotBasePtr robot = manipulator->GetRobot();
-                vector<dReal> vtestsolution2;
-                robot->GetConfigurationValues(vtestsolution2);
-                for(size_t i = 0; i < manipulator->GetArmIndices().size(); ++i) {
-                    vtestsolution.at(manipulator->GetArmIndices()[i]) = solution.at(i);
-                }
-                for(size_t i = 0; i < vtestsolution.size(); ++i) {
-                    if( RaveFabs(vtestsolution.at(i)-vtestsolution2.at(i)) > g_fEpsilonJointLimit ) {
-                        int dofindex = manipulator->GetArmIndices()[i];
-                        KinBody::JointPtr pjoint = robot->GetJointFromDOFIndex(dofindex); // for debugging
-                        robot->GetConfigurationValues(vtestsolution2);
-                        pitdata->_filterfn(solution,manipulator,param); // for debugging internals
-                        throw OPENRAVE_EXCEPTION_FORMAT(_("one of the filters set on robot %s manip %s did not restore the robot configuraiton. config dof %d (%f -> %f)"),robot->GetName()%manipulator->GetName()%i%vtestsolution.at(i)%vtestsolution2.at(i), ORE_InconsistentConstraints);
-                    }
-                }
+            else {
+                index = __FindFirstFilter(priority-1);
             }
-            if( !!filterreturn ) {
-                filterreturn->Append(ret);
+        }
+        else {
+            ++index;
+        }
+    }
+
+    if( vtestsolution.size() > 0 ) {
+        // check that the filters restored the robot to the solution
+        RobotBasePtr robot = manipulator->GetRobot();
+        vector<dReal> vtestsolution2;
+        robot->GetConfigurationValues(vtestsolution2);
+        for(size_t i = 0; i < manipulator->GetArmIndices().size(); ++i) {
+            vtestsolution.at(manipulator->GetArmIndices()[i]) = solution.at(i);
+        }
+        for(size_t i = 0; i < vtestsolution.size(); ++i) {
+            if( RaveFabs(vtestsolution.at(i)-vtestsolution2.at(i)) > g_fEpsilonJointLimit ) {
+                throw OPENRAVE_EXCEPTION_FORMAT(_("one of the filters set on robot %s manip %s did not restore the robot configuraiton. config dof %d (%f -> %f)"),robot->GetName()%manipulator->GetName()%i%vtestsolution.at(i)%vtestsolution2.at(i), ORE_InconsistentConstraints);
             }
         }
     }
@@ -240,16 +299,12 @@ IkReturnAction IkSolverBase::_CallFilters(std::vector<dReal>& solution, RobotBas
 
 bool IkSolverBase::_HasFilterInRange(int32_t minpriority, int32_t maxpriority) const
 {
-    // priorities are descending
-    FOREACHC(it,__listRegisteredFilters) {
-        CustomIkSolverFilterDataPtr pitdata = boost::dynamic_pointer_cast<CustomIkSolverFilterData>(it->lock());
-        if( !!pitdata ) {
-            if( pitdata->_priority <= maxpriority && pitdata->_priority >= minpriority ) {
-                return true;
-            }
-        }
+    if( __nFilterDispatchStamp != __nFilterStamp ) {
+        __UpdateFilterDispatch();
     }
-    return false;
+    // priorities are descending
+    size_t index = __FindFirstFilter(maxpriority);
+    return index < __vFilterDispatch.size() && __vFilterDispatch[index]->_priority >= minpriority;
 }
 
 void IkSolverBase::_CallFinishCallbacks(IkReturnPtr ikreturn, RobotBase::ManipulatorConstPtr pmanip, const IkParameterization& ikparam)
@@ -262,4 +317,14 @@ void IkSolverBase::_CallFinishCallbacks(IkReturnPtr ikreturn, RobotBase::Manipul
     }
 }
 
+bool IkSolverBase::_HasFinishCallbacks() const
+{
+    FOREACHC(it, __listRegisteredFinishCallbacks) {
+        if( !!it->lock() ) {
+            return true;
+        }
+    }
+    return false;
+}
+
 }
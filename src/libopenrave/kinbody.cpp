@@ -16,6 +16,7 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "libopenrave.h"
 #include <algorithm>
+#include <boost/thread/tss.hpp>
 
 // used for functions that are also used internally
 #define CHECK_INTERNAL_COMPUTATION0 OPENRAVE_ASSERT_FORMAT(_nHierarchyComputed != 0, "body %s internal structures need to be computed, current value is %d. Are you sure Environment::AddRobot/AddKinBody was called?", GetName()%_nHierarchyComputed, ORE_NotInitialized);
@@ -60,6 +61,51 @@ protected:
 
 typedef boost::shared_ptr<ChangeCallbackData> ChangeCallbackDataPtr;
 
+/// \brief storage of a KinBodyStateSaver that is kept after the saver is destroyed so that the next savers do not have to allocate
+struct StateSaverBuffers
+{
+    std::vector<Transform> vLinkTransforms;
+    std::vector<uint8_t> vEnabledLinks;
+    std::vector<dReal> vdoflastsetvalues;
+};
+
+static const size_t s_maxStateSaverBuffers = 16; ///< savers are nested only a few levels deep
+static boost::thread_specific_ptr< std::vector<StateSaverBuffers> > s_vStateSaverBuffers; ///< free buffers of the calling thread
+
+/// \brief moves free buffers of the calling thread into the vectors of a new saver
+static void AcquireStateSaverBuffers(std::vector<Transform>& vLinkTransforms, std::vector<uint8_t>& vEnabledLinks, std::vector<dReal>& vdoflastsetvalues)
+{
+    std::vector<StateSaverBuffers>* pvbuffers = s_vStateSaverBuffers.get();
+    if( !!pvbuffers && pvbuffers->size() > 0 ) {
+        StateSaverBuffers& buffers = pvbuffers->back();
+        vLinkTransforms.swap(buffers.vLinkTransforms);
+        vEnabledLinks.swap(buffers.vEnabledLinks);
+        vdoflastsetvalues.swap(buffers.vdoflastsetvalues);
+        pvbuffers->pop_back();
+    }
+}
+
+/// \brief gives the vectors of a destroyed saver back to the free buffers of the calling thread
+static void ReleaseStateSaverBuffers(std::vector<Transform>& vLinkTransforms, std::vector<uint8_t>& vEnabledLinks, std::vector<dReal>& vdoflastsetvalues)
+{
+    if( vLinkTransforms.capacity() == 0 && vEnabledLinks.capacity() == 0 && vdoflastsetvalues.capacity() == 0 ) {
+        return;
+    }
+    std::vector<StateSaverBuffers>* pvbuffers = s_vStateSaverBuffers.get();
+    if( !pvbuffers ) {
+        pvbuffers = new std::vector<StateSaverBuffers>();
+        pvbuffers->reserve(s_maxStateSaverBuffers);
+        s_vStateSaverBuffers.reset(pvbuffers);
+    }
+    if( pvbuffers->size() < s_maxStateSaverBuffers ) {
+        pvbuffers->push_back(StateSaverBuffers());
+        StateSaverBuffers& buffers = pvbuffers->back();
+        buffers.vLinkTransforms.swap(vLinkTransforms);
+        buffers.vEnabledLinks.swap(vEnabledLinks);
+        buffers.vdoflastsetvalues.swap(vdoflastsetvalues);
+    }
+}
+
 ElectricMotorActuatorInfo::ElectricMotorActuatorInfo()
 {
     gear_ratio = 0;
@@ -81,6 +127,10 @@ ElectricMotorActuatorInfo::ElectricMotorActuatorInfo()
 
 KinBody::KinBodyStateSaver::KinBodyStateSaver(KinBodyPtr pbody, int options) : _options(options), _pbody(pbody), _bRestoreOnDestructor(true)
 {
+    _nUpdateStamp = _pbody->GetUpdateStamp();
+    if( _options & (Save_LinkTransformation|Save_LinkEnable) ) {
+        AcquireStateSaverBuffers(_vLinkTransforms, _vEnabledLinks, _vdoflastsetvalues);
+    }
     if( _options & Save_LinkTransformation ) {
         _pbody->GetLinkTransformations(_vLinkTransforms, _vdoflastsetvalues);
     }
@@ -110,6 +160,7 @@ KinBody::KinBodyStateSaver::~KinBodyStateSaver()
     if( _bRestoreOnDestructor && !!_pbody && _pbody->GetEnvironmentId() != 0 ) {
         _RestoreKinBody(_pbody);
     }
+    ReleaseStateSaverBuffers(_vLinkTransforms, _vEnabledLinks, _vdoflastsetvalues);
 }
 
 void KinBody::KinBodyStateSaver::Restore(boost::shared_ptr<KinBody> body)
@@ -136,10 +187,13 @@ void KinBody::KinBodyStateSaver::_RestoreKinBody(boost::shared_ptr<KinBody> pbod
         RAVELOG_WARN(str(boost::format("body %s not added to environment, skipping restore")%pbody->GetName()));
         return;
     }
+    // every change of the link transforms or enable states increments the update stamp, so if it did not change, there is nothing to restore for them.
+    // this makes the savers that are not followed by any change (early exits of the checks) almost free
+    bool bUnchanged = pbody == _pbody && pbody->GetUpdateStamp() == _nUpdateStamp;
     if( _options & Save_JointLimits ) {
         _pbody->SetDOFLimits(_vDOFLimits[0], _vDOFLimits[1]);
     }
-    if( _options & Save_LinkTransformation ) {
+    if( (_options & Save_LinkTransformation) && !bUnchanged ) {
         pbody->SetLinkTransformations(_vLinkTransforms, _vdoflastsetvalues);
 //        if( IS_DEBUGLEVEL(Level_Warn) ) {
 //            stringstream ss; ss << std::setprecision(std::numeric_limits<dReal>::digits10+1);
@@ -153,7 +207,7 @@ void KinBody::KinBodyStateSaver::_RestoreKinBody(boost::shared_ptr<KinBody> pbod
 //            RAVELOG_WARN(ss.str());
 //        }
     }
-    if( _options & Save_LinkEnable ) {
+    if( (_options & Save_LinkEnable) && !bUnchanged ) {
         // should first enable before calling the parameter callbacks
         bool bchanged = false;
         for(size_t i = 0; i < _vEnabledLinks.size(); ++i) {
@@ -186,7 +240,11 @@ KinBody::KinBody(InterfaceType type, EnvironmentBasePtr penv) : InterfaceBase(ty
     _bMakeJoinedLinksAdjacent = true;
     _environmentid = 0;
     _nNonAdjacentLinkCache = 0x80000000;
+    _nNonAdjacentLinkUpdateStamp = 0;
+    _vNonAdjacentLinkPairsStamps.assign(-1);
     _nUpdateStampId = 0;
+    _nAABBUpdateStamp = -1;
+    _nLastSetDOFValuesStamp = -1;
 }
 
 KinBody::~KinBody()
@@ -211,6 +269,7 @@ void KinBody::Destroy()
     _listAttachedBodies.clear();
 
     _veclinks.clear();
+    _nAABBUpdateStamp = -1;
     _vecjoints.clear();
     _vTopologicallySortedJoints.clear();
     _vTopologicallySortedJointsAll.clear();
@@ -579,6 +638,27 @@ void KinBody::GetDOFValues(std::vector<dReal>& v, const std::vector<int>& dofind
     }
 }
 
+void KinBody::GetDOFValues(dReal* pValues, size_t numvalues, const std::vector<int>& dofindices) const
+{
+    CHECK_INTERNAL_COMPUTATION;
+    if( dofindices.size() == 0 ) {
+        OPENRAVE_ASSERT_OP_FORMAT((int)numvalues,>=,GetDOF(), "not enough space for values %d<%d", numvalues%GetDOF(),ORE_InvalidArguments);
+        FOREACHC(it, _vDOFOrderedJoints) {
+            dReal* p = pValues+(*it)->GetDOFIndex();
+            for(int i = 0; i < (*it)->GetDOF(); ++i) {
+                p[i] = (*it)->GetValue(i);
+            }
+        }
+    }
+    else {
+        OPENRAVE_ASSERT_OP_FORMAT(numvalues,>=,dofindices.size(), "not enough space for values %d<%d", numvalues%dofindices.size(),ORE_InvalidArguments);
+        for(size_t i = 0; i < dofindices.size(); ++i) {
+            JointPtr pjoint = GetJointFromDOFIndex(dofindices[i]);
+            pValues[i] = pjoint->GetValue(dofindices[i]-pjoint->GetDOFIndex());
+        }
+    }
+}
+
 void KinBody::GetDOFVelocities(std::vector<dReal>& v, const std::vector<int>& dofindices) const
 {
     if( dofindices.size() == 0 ) {
@@ -1223,6 +1303,14 @@ void KinBody::GetLinkTransformations(vector<Transform>& vtrans) const
     }
 }
 
+void KinBody::GetLinkTransformations(Transform* ptransforms, size_t numtransforms) const
+{
+    OPENRAVE_ASSERT_OP_FORMAT(numtransforms,>=,_veclinks.size(), "not enough space for transforms %d<%d", numtransforms%_veclinks.size(),ORE_InvalidArguments);
+    for(size_t ilink = 0; ilink < _veclinks.size(); ++ilink) {
+        ptransforms[ilink] = _veclinks[ilink]->GetTransform();
+    }
+}
+
 void KinBody::GetLinkTransformations(std::vector<Transform>& transforms, std::vector<dReal>& doflastsetvalues) const
 {
     transforms.resize(_veclinks.size());
@@ -1292,6 +1380,9 @@ KinBody::JointPtr KinBody::GetJointFromDOFIndex(int dofindex) const
 
 AABB KinBody::ComputeAABB() const
 {
+    if( _nAABBUpdateStamp == _nUpdateStampId ) {
+        return _aabb;
+    }
     Vector vmin, vmax;
     bool binitialized=false;
     AABB ab;
@@ -1336,6 +1427,8 @@ AABB KinBody::ComputeAABB() const
         ab.pos = (dReal)0.5 * (vmin + vmax);
         ab.extents = vmax - ab.pos;
     }
+    _aabb = ab;
+    _nAABBUpdateStamp = _nUpdateStampId;
     return ab;
 }
 
@@ -1433,14 +1526,24 @@ void KinBody::SetDOFValues(const std::vector<dReal>& vJointValues, const Transfo
 
 void KinBody::SetDOFValues(const std::vector<dReal>& vJointValues, uint32_t checklimits, const std::vector<int>& dofindices)
 {
+    if( vJointValues.size() == 0 ) {
+        return;
+    }
+    // call the KinBody implementation directly so that derived classes do not postprocess twice
+    KinBody::SetDOFValues(&vJointValues[0], vJointValues.size(), checklimits, dofindices);
+}
+
+void KinBody::SetDOFValues(const dReal* pValues, size_t numvalues, uint32_t checklimits, const std::vector<int>& dofindices)
+{
+    utils::ProfileZone profilezone("KinBody::SetDOFValues");
     CHECK_INTERNAL_COMPUTATION;
-    if( vJointValues.size() == 0 || _veclinks.size() == 0) {
+    if( numvalues == 0 || _veclinks.size() == 0) {
         return;
     }
     int expecteddof = dofindices.size() > 0 ? (int)dofindices.size() : GetDOF();
-    OPENRAVE_ASSERT_OP_FORMAT((int)vJointValues.size(),>=,expecteddof, "not enough values %d<%d", vJointValues.size()%GetDOF(),ORE_InvalidArguments);
+    OPENRAVE_ASSERT_OP_FORMAT((int)numvalues,>=,expecteddof, "not enough values %d<%d", numvalues%expecteddof,ORE_InvalidArguments);
 
-    const dReal* pJointValues = &vJointValues[0];
+    const dReal* pJointValues = pValues;
     if( checklimits != CLA_Nothing || dofindices.size() > 0 ) {
         _vTempJoints.resize(GetDOF());
         if( dofindices.size() > 0 ) {
@@ -1455,7 +1558,8 @@ void KinBody::SetDOFValues(const std::vector<dReal>& vJointValues, uint32_t chec
         dReal* ptempjoints = &_vTempJoints[0];
 
         // check the limits
-        vector<dReal> upperlim, lowerlim;
+        std::vector<dReal>& upperlim = _vTempUpperLimits;
+        std::vector<dReal>& lowerlim = _vTempLowerLimits;
         FOREACHC(it, _vecjoints) {
             const dReal* p = pJointValues+(*it)->GetDOFIndex();
             if( checklimits == CLA_Nothing ) {
@@ -1531,10 +1635,12 @@ void KinBody::SetDOFValues(const std::vector<dReal>& vJointValues, uint32_t chec
     }
 
     boost::array<dReal,3> dummyvalues; // dummy values for a joint
-    std::vector<dReal> vtempvalues, veval;
+    std::vector<dReal>& vtempvalues = _vTempMimicValues;
+    std::vector<dReal>& veval = _vTempMimicEval;
 
     // have to compute the angles ahead of time since they are dependent on the link transformations
-    std::vector< std::vector<dReal> > vPassiveJointValues(_vPassiveJoints.size());
+    std::vector< std::vector<dReal> >& vPassiveJointValues = _vTempPassiveJointValues;
+    vPassiveJointValues.resize(_vPassiveJoints.size());
     for(size_t i = 0; i < vPassiveJointValues.size(); ++i) {
         if( !_vPassiveJoints[i]->IsMimic() ) {
             _vPassiveJoints[i]->GetValues(vPassiveJointValues[i]);
@@ -1557,13 +1663,25 @@ void KinBody::SetDOFValues(const std::vector<dReal>& vJointValues, uint32_t chec
             }
         }
         else {
+            vPassiveJointValues[i].resize(0);
             vPassiveJointValues[i].reserve(_vPassiveJoints[i]->GetDOF()); // do not resize so that we can catch hierarchy errors
         }
     }
 
-    std::vector<uint8_t> vlinkscomputed(_veclinks.size(),0);
+    std::vector<uint8_t>& vlinkscomputed = _vTempLinksComputed;
+    vlinkscomputed.resize(0);
+    vlinkscomputed.resize(_veclinks.size(),0);
     vlinkscomputed[0] = 1;
 
+    // if nothing touched the link transformations since the last call, only the links below joints whose values changed have to be recomputed
+    bool bIncremental = _nLastSetDOFValuesStamp == _nUpdateStampId && (int)_vLastSetDOFValues.size() == GetDOF();
+    std::vector<uint8_t>& vlinksmoved = _vTempLinksMoved;
+    bool bAnyLinkMoved = false;
+    if( bIncremental ) {
+        vlinksmoved.resize(0);
+        vlinksmoved.resize(_veclinks.size(),0);
+    }
+
     for(size_t ijoint = 0; ijoint < _vTopologicallySortedJointsAll.size(); ++ijoint) {
         JointPtr pjoint = _vTopologicallySortedJointsAll[ijoint];
         int jointindex = _vTopologicallySortedJointIndicesAll[ijoint];
@@ -1587,7 +1705,8 @@ void KinBody::SetDOFValues(const std::vector<dReal>& vJointValues, uint32_t chec
                         RAVELOG_WARN(str(boost::format("failed to evaluate joint %s, fparser error %d")%pjoint->GetName()%err));
                     }
                     else {
-                        vector<dReal> vevalcopy = veval;
+                        std::vector<dReal>& vevalcopy = _vTempMimicEvalCopy;
+                        vevalcopy = veval;
                         vector<dReal>::iterator iteval = veval.begin();
                         while(iteval != veval.end()) {
                             bool removevalue = false;
@@ -1682,6 +1801,24 @@ void KinBody::SetDOFValues(const std::vector<dReal>& vJointValues, uint32_t chec
             // has to be a passive joint
             pvalues = &vPassiveJointValues.at(jointindex-(int)_vecjoints.size()).at(0);
         }
+        if( bIncremental ) {
+            // mimic joints are always recomputed since their values can depend on any dof
+            bool bLinkMoves = pjoint->IsMimic() || (!!pjoint->GetHierarchyParentLink() && vlinksmoved[pjoint->GetHierarchyParentLink()->GetIndex()]);
+            if( !bLinkMoves && dofindex >= 0 ) {
+                for(int i = 0; i < pjoint->GetDOF(); ++i) {
+                    if( pvalues[i] != _vLastSetDOFValues[dofindex+i] ) {
+                        bLinkMoves = true;
+                        break;
+                    }
+                }
+            }
+            if( !bLinkMoves ) {
+                vlinkscomputed[pjoint->GetHierarchyChildLink()->GetIndex()] = 1;
+                continue;
+            }
+            vlinksmoved[pjoint->GetHierarchyChildLink()->GetIndex()] = 1;
+            bAnyLinkMoved = true;
+        }
 
         Transform tjoint;
         if( pjoint->GetType() & JointSpecialBit ) {
@@ -1717,7 +1854,7 @@ void KinBody::SetDOFValues(const std::vector<dReal>& vJointValues, uint32_t chec
                 if( !pjoint->_info._trajfollow->GetConfigurationSpecification().ExtractTransform(tjoint,vdata.begin(),KinBodyConstPtr()) ) {
                     RAVELOG_WARN(str(boost::format("trajectory sampling for joint %s failed")%pjoint->GetName()));
                 }
-                pjoint->_doflastsetvalues[0] = 0;
+                pjoint->_doflastsetvalues[0] = fvalue;
                 break;
             }
             default:
@@ -1759,7 +1896,254 @@ void KinBody::SetDOFValues(const std::vector<dReal>& vJointValues, uint32_t chec
         vlinkscomputed[pjoint->GetHierarchyChildLink()->GetIndex()] = 1;
     }
 
+    if( bIncremental && !bAnyLinkMoved ) {
+        // same values as before, so nothing changed
+        return;
+    }
+    _vLastSetDOFValues.resize(GetDOF());
+    std::copy(pJointValues,pJointValues+GetDOF(),_vLastSetDOFValues.begin());
     _PostprocessChangedParameters(Prop_LinkTransforms);
+    _nLastSetDOFValuesStamp = _nUpdateStampId;
+}
+
+/// \brief poses[i] = poses[i] * t for numposes poses stored as 7 arrays of numposes values, see KinBody::ComputeLinkTransformations. pout can be pin.
+static inline void _MultiplyPosesSoA(const dReal* pin, const Transform& t, dReal* pout, size_t numposes)
+{
+    const dReal* pqs = pin; const dReal* pqx = pin+numposes; const dReal* pqy = pin+2*numposes; const dReal* pqz = pin+3*numposes;
+    const dReal* ptx = pin+4*numposes; const dReal* pty = pin+5*numposes; const dReal* ptz = pin+6*numposes;
+    dReal* poqs = pout; dReal* poqx = pout+numposes; dReal* poqy = pout+2*numposes; dReal* poqz = pout+3*numposes;
+    dReal* potx = pout+4*numposes; dReal* poty = pout+5*numposes; dReal* potz = pout+6*numposes;
+    const dReal rs = t.rot.x, rx = t.rot.y, ry = t.rot.z, rz = t.rot.w;
+    const dReal tx = t.trans.x, ty = t.trans.y, tz = t.trans.z;
+    for(size_t i = 0; i < numposes; ++i) {
+        dReal qs = pqs[i], qx = pqx[i], qy = pqy[i], qz = pqz[i];
+        // same as RaveAffineKernels::QuatRotate
+        dReal xx = 2*qx*qx, xy = 2*qx*qy, xz = 2*qx*qz, xw = 2*qx*qs, yy = 2*qy*qy, yz = 2*qy*qz, yw = 2*qy*qs, zz = 2*qz*qz, zw = 2*qz*qs;
+        dReal ox = (1-yy-zz)*tx + (xy-zw)*ty + (xz+yw)*tz + ptx[i];
+        dReal oy = (xy+zw)*tx + (1-xx-zz)*ty + (yz-xw)*tz + pty[i];
+        dReal oz = (xz-yw)*tx + (yz+xw)*ty + (1-xx-yy)*tz + ptz[i];
+        poqs[i] = qs*rs - qx*rx - qy*ry - qz*rz;
+        poqx[i] = qs*rx + qx*rs + qy*rz - qz*ry;
+        poqy[i] = qs*ry + qy*rs + qz*rx - qx*rz;
+        poqz[i] = qs*rz + qz*rs + qx*ry - qy*rx;
+        potx[i] = ox; poty[i] = oy; potz[i] = oz;
+    }
+}
+
+/// \brief rotates the poses by the angles pangles around axis, the quaternions of quatFromAxisAngle are applied on the right
+static inline void _RotatePosesSoA(dReal* pposes, const Vector& axis, const dReal* pangles, size_t numposes, std::vector<dReal>& vtemp)
+{
+    dReal axislen = RaveSqrt(axis.lengthsqr3());
+    if( axislen == 0 ) {
+        return;
+    }
+    // sin and cos first, then the quaternion products can be vectorized
+    vtemp.resize(2*numposes);
+    dReal* pcos = &vtemp[0]; dReal* psin = &vtemp[numposes];
+    for(size_t i = 0; i < numposes; ++i) {
+        pcos[i] = RaveCos(dReal(0.5)*pangles[i]);
+        psin[i] = RaveSin(dReal(0.5)*pangles[i]);
+    }
+    const dReal ax = axis.x/axislen, ay = axis.y/axislen, az = axis.z/axislen;
+    dReal* pqs = pposes; dReal* pqx = pposes+numposes; dReal* pqy = pposes+2*numposes; dReal* pqz = pposes+3*numposes;
+    for(size_t i = 0; i < numposes; ++i) {
+        dReal qs = pqs[i], qx = pqx[i], qy = pqy[i], qz = pqz[i];
+        dReal rs = pcos[i], rx = ax*psin[i], ry = ay*psin[i], rz = az*psin[i];
+        pqs[i] = qs*rs - qx*rx - qy*ry - qz*rz;
+        pqx[i] = qs*rx + qx*rs + qy*rz - qz*ry;
+        pqy[i] = qs*ry + qy*rs + qz*rx - qx*rz;
+        pqz[i] = qs*rz + qz*rs + qx*ry - qy*rx;
+    }
+}
+
+/// \brief translates the poses by axis*pvalues in their own frames
+static inline void _TranslatePosesSoA(dReal* pposes, const Vector& axis, const dReal* pvalues, size_t numposes)
+{
+    const dReal* pqs = pposes; const dReal* pqx = pposes+numposes; const dReal* pqy = pposes+2*numposes; const dReal* pqz = pposes+3*numposes;
+    dReal* ptx = pposes+4*numposes; dReal* pty = pposes+5*numposes; dReal* ptz = pposes+6*numposes;
+    for(size_t i = 0; i < numposes; ++i) {
+        dReal qs = pqs[i], qx = pqx[i], qy = pqy[i], qz = pqz[i];
+        dReal vx = axis.x*pvalues[i], vy = axis.y*pvalues[i], vz = axis.z*pvalues[i];
+        dReal xx = 2*qx*qx, xy = 2*qx*qy, xz = 2*qx*qz, xw = 2*qx*qs, yy = 2*qy*qy, yz = 2*qy*qz, yw = 2*qy*qs, zz = 2*qz*qz, zw = 2*qz*qs;
+        ptx[i] += (1-yy-zz)*vx + (xy-zw)*vy + (xz+yw)*vz;
+        pty[i] += (xy+zw)*vx + (1-xx-zz)*vy + (yz-xw)*vz;
+        ptz[i] += (xz-yw)*vx + (yz+xw)*vy + (1-xx-yy)*vz;
+    }
+}
+
+static inline Transform _GetPoseSoA(const dReal* pposes, size_t numposes, size_t index)
+{
+    Transform t;
+    t.rot = Vector(pposes[index], pposes[numposes+index], pposes[2*numposes+index], pposes[3*numposes+index]);
+    t.trans = Vector(pposes[4*numposes+index], pposes[5*numposes+index], pposes[6*numposes+index]);
+    return t;
+}
+
+static inline void _SetPoseSoA(dReal* pposes, size_t numposes, size_t index, const Transform& t)
+{
+    pposes[index] = t.rot.x; pposes[numposes+index] = t.rot.y; pposes[2*numposes+index] = t.rot.z; pposes[3*numposes+index] = t.rot.w;
+    pposes[4*numposes+index] = t.trans.x; pposes[5*numposes+index] = t.trans.y; pposes[6*numposes+index] = t.trans.z;
+}
+
+void KinBody::ComputeLinkTransformations(const dReal* pconfigs, size_t numconfigs, std::vector<dReal>& vlinkposes) const
+{
+    CHECK_INTERNAL_COMPUTATION;
+    const size_t numlinks = _veclinks.size();
+    const size_t dof = GetDOF();
+    vlinkposes.resize(numlinks*7*numconfigs);
+    if( numconfigs == 0 || numlinks == 0 ) {
+        return;
+    }
+
+    // links that no joint moves keep their current transformations
+    for(size_t ilink = 0; ilink < numlinks; ++ilink) {
+        const Transform& t = _veclinks[ilink]->GetTransform();
+        dReal* pposes = &vlinkposes[ilink*7*numconfigs];
+        const dReal values[7] = { t.rot.x, t.rot.y, t.rot.z, t.rot.w, t.trans.x, t.trans.y, t.trans.z };
+        for(int icomponent = 0; icomponent < 7; ++icomponent) {
+            std::fill(pposes+icomponent*numconfigs, pposes+(icomponent+1)*numconfigs, values[icomponent]);
+        }
+    }
+
+    // every dof is contiguous over the configurations
+    std::vector<dReal> vdofvalues(dof*numconfigs);
+    for(size_t iconfig = 0; iconfig < numconfigs; ++iconfig) {
+        const dReal* pconfig = pconfigs+iconfig*dof;
+        for(size_t idof = 0; idof < dof; ++idof) {
+            vdofvalues[idof*numconfigs+iconfig] = pconfig[idof];
+        }
+    }
+
+    // 3 axes per passive joint, mimic joints are filled when they are evaluated since other mimic joints can depend on them
+    std::vector<dReal> vpassivevalues(_vPassiveJoints.size()*3*numconfigs, 0);
+    std::vector<dReal> vcurvalues;
+    for(size_t ipassive = 0; ipassive < _vPassiveJoints.size(); ++ipassive) {
+        const JointPtr& pjoint = _vPassiveJoints[ipassive];
+        if( pjoint->IsMimic() ) {
+            continue;
+        }
+        pjoint->GetValues(vcurvalues);
+        for(int iaxis = 0; iaxis < pjoint->GetDOF(); ++iaxis) {
+            dReal fvalue = vcurvalues.at(iaxis);
+            if( !pjoint->IsCircular(iaxis) ) {
+                fvalue = utils::ClampOnRange(fvalue, pjoint->_info._vlowerlimit.at(iaxis), pjoint->_info._vupperlimit.at(iaxis));
+            }
+            dReal* pvalues = &vpassivevalues[(ipassive*3+iaxis)*numconfigs];
+            std::fill(pvalues, pvalues+numconfigs, fvalue);
+        }
+    }
+
+    std::vector<uint8_t> vlinkscomputed(numlinks,0);
+    vlinkscomputed[0] = 1;
+    std::vector<dReal> vmimicvalues(3*numconfigs), vjointposes(7*numconfigs), vtemp, vdependentvalues, veval;
+    for(size_t ijoint = 0; ijoint < _vTopologicallySortedJointsAll.size(); ++ijoint) {
+        const JointPtr& pjoint = _vTopologicallySortedJointsAll[ijoint];
+        int jointindex = _vTopologicallySortedJointIndicesAll[ijoint];
+        int dofindex = pjoint->GetDOFIndex();
+        int passiveindex = dofindex < 0 ? jointindex-(int)_vecjoints.size() : -1;
+        boost::array<const dReal*, 3> paxisvalues;
+        for(int iaxis = 0; iaxis < pjoint->GetDOF(); ++iaxis) {
+            if( pjoint->IsMimic(iaxis) ) {
+                dReal* pvalues = passiveindex >= 0 ? &vpassivevalues[(passiveindex*3+iaxis)*numconfigs] : &vmimicvalues[iaxis*numconfigs];
+                const std::vector<Mimic::DOFFormat>& vdofformat = pjoint->_vmimic[iaxis]->_vdofformat;
+                for(size_t iconfig = 0; iconfig < numconfigs; ++iconfig) {
+                    vdependentvalues.resize(0);
+                    FOREACHC(itdof,vdofformat) {
+                        if( itdof->dofindex >= 0 ) {
+                            vdependentvalues.push_back(vdofvalues[itdof->dofindex*numconfigs+iconfig]);
+                        }
+                        else {
+                            vdependentvalues.push_back(vpassivevalues[((itdof->jointindex-_vecjoints.size())*3+itdof->axis)*numconfigs+iconfig]);
+                        }
+                    }
+                    int err = pjoint->_Eval(iaxis, 0, vdependentvalues, veval);
+                    if( err || veval.size() == 0 ) {
+                        RAVELOG_WARN_FORMAT("failed to evaluate joint %s, fparser error %d", pjoint->GetName()%err);
+                        pvalues[iconfig] = 0;
+                        continue;
+                    }
+                    // take the first value inside the limits like SetDOFValues, otherwise the first value
+                    pvalues[iconfig] = veval[0];
+                    if( pjoint->GetType() != JointSpherical && !pjoint->IsCircular(iaxis) ) {
+                        FOREACHC(iteval, veval) {
+                            if( *iteval >= pjoint->_info._vlowerlimit[iaxis]-g_fEpsilonJointLimit && *iteval <= pjoint->_info._vupperlimit[iaxis]+g_fEpsilonJointLimit ) {
+                                pvalues[iconfig] = utils::ClampOnRange(*iteval, pjoint->_info._vlowerlimit[iaxis], pjoint->_info._vupperlimit[iaxis]);
+                                break;
+                            }
+                        }
+                    }
+                }
+                paxisvalues[iaxis] = pvalues;
+            }
+            else if( dofindex >= 0 ) {
+                paxisvalues[iaxis] = &vdofvalues[(dofindex+iaxis)*numconfigs];
+            }
+            else {
+                paxisvalues[iaxis] = &vpassivevalues[(passiveindex*3+iaxis)*numconfigs];
+            }
+        }
+        int childindex = pjoint->GetHierarchyChildLink()->GetIndex();
+        if( vlinkscomputed[childindex] ) {
+            continue;
+        }
+
+        int parentindex = !pjoint->GetHierarchyParentLink() ? 0 : pjoint->GetHierarchyParentLink()->GetIndex();
+        dReal* pjointposes = &vjointposes[0];
+        _MultiplyPosesSoA(&vlinkposes[parentindex*7*numconfigs], pjoint->GetInternalHierarchyLeftTransform(), pjointposes, numconfigs);
+        if( pjoint->GetType() & JointSpecialBit ) {
+            // special joints are rare, so compute their transformations one configuration at a time like SetDOFValues
+            for(size_t iconfig = 0; iconfig < numconfigs; ++iconfig) {
+                Transform tjoint;
+                switch(pjoint->GetType()) {
+                case JointHinge2: {
+                    Transform tfirst;
+                    tfirst.rot = quatFromAxisAngle(pjoint->GetInternalHierarchyAxis(0), paxisvalues[0][iconfig]);
+                    Transform tsecond;
+                    tsecond.rot = quatFromAxisAngle(tfirst.rotate(pjoint->GetInternalHierarchyAxis(1)), paxisvalues[1][iconfig]);
+                    tjoint = tsecond * tfirst;
+                    break;
+                }
+                case JointSpherical: {
+                    Vector vaxisangle(paxisvalues[0][iconfig], paxisvalues[1][iconfig], paxisvalues[2][iconfig]);
+                    dReal fang = vaxisangle.lengthsqr3();
+                    if( fang > 0 ) {
+                        fang = RaveSqrt(fang);
+                        tjoint.rot = quatFromAxisAngle(vaxisangle*(1/fang),fang);
+                    }
+                    break;
+                }
+                case JointTrajectory: {
+                    vector<dReal> vdata;
+                    dReal fvalue = paxisvalues[0][iconfig];
+                    if( pjoint->IsCircular(0) ) {
+                        fvalue = utils::NormalizeCircularAngle(fvalue,pjoint->_vcircularlowerlimit.at(0), pjoint->_vcircularupperlimit.at(0));
+                    }
+                    pjoint->_info._trajfollow->Sample(vdata,fvalue);
+                    if( !pjoint->_info._trajfollow->GetConfigurationSpecification().ExtractTransform(tjoint,vdata.begin(),KinBodyConstPtr()) ) {
+                        RAVELOG_WARN(str(boost::format("trajectory sampling for joint %s failed")%pjoint->GetName()));
+                    }
+                    break;
+                }
+                default:
+                    RAVELOG_WARN(str(boost::format("forward kinematic type 0x%x not supported")%pjoint->GetType()));
+                    break;
+                }
+                _SetPoseSoA(pjointposes, numconfigs, iconfig, _GetPoseSoA(pjointposes, numconfigs, iconfig) * tjoint);
+            }
+        }
+        else {
+            for(int iaxis = 0; iaxis < pjoint->GetDOF(); ++iaxis) {
+                if( pjoint->IsRevolute(iaxis) ) {
+                    _RotatePosesSoA(pjointposes, pjoint->GetInternalHierarchyAxis(iaxis), paxisvalues[iaxis], numconfigs, vtemp);
+                }
+                else {
+                    _TranslatePosesSoA(pjointposes, pjoint->GetInternalHierarchyAxis(iaxis), paxisvalues[iaxis], numconfigs);
+                }
+            }
+        }
+        _MultiplyPosesSoA(pjointposes, pjoint->GetInternalHierarchyRightTransform(), &vlinkposes[childindex*7*numconfigs], numconfigs);
+        vlinkscomputed[childindex] = 1;
+    }
 }
 
 bool KinBody::IsDOFRevolute(int dofindex) const
@@ -2193,6 +2577,111 @@ void KinBody::ComputeJacobianAxisAngle(int linkindex, std::vector<dReal>& vjacob
     }
 }
 
+void KinBody::ComputeJacobians(const std::vector< std::pair<int, Vector> >& vlinkpositions, std::vector<dReal>& vjacobians, const std::vector<int>& dofindices) const
+{
+    size_t dofstride = dofindices.size() > 0 ? dofindices.size() : GetDOF();
+    vjacobians.resize(6*dofstride*vlinkpositions.size());
+    if( vjacobians.size() > 0 ) {
+        ComputeJacobians(vlinkpositions, &vjacobians[0], dofindices);
+    }
+}
+
+void KinBody::ComputeJacobians(const std::vector< std::pair<int, Vector> >& vlinkpositions, dReal* pjacobians, const std::vector<int>& dofindices) const
+{
+    CHECK_INTERNAL_COMPUTATION;
+    size_t dofstride = dofindices.size() > 0 ? dofindices.size() : GetDOF();
+    if( dofstride == 0 || vlinkpositions.size() == 0 ) {
+        return;
+    }
+    std::fill(pjacobians, pjacobians+6*dofstride*vlinkpositions.size(), dReal(0));
+
+    // column of each dof in the output, -1 if not requested
+    std::vector<int> vdofcolumns(GetDOF(), -1);
+    if( dofindices.size() > 0 ) {
+        for(size_t i = 0; i < dofindices.size(); ++i) {
+            OPENRAVE_ASSERT_FORMAT(dofindices[i] >= 0 && dofindices[i] < GetDOF(), "body %s bad dof index %d", GetName()%dofindices[i], ORE_InvalidArguments);
+            if( vdofcolumns[dofindices[i]] < 0 ) {
+                vdofcolumns[dofindices[i]] = i;
+            }
+        }
+    }
+    else {
+        for(size_t i = 0; i < vdofcolumns.size(); ++i) {
+            vdofcolumns[i] = i;
+        }
+    }
+
+    // (jointindex, pair index) for every joint on the chain of every pair, sorted so each joint is visited once
+    std::vector< std::pair<int, int> > vjointpairs;
+    for(size_t ipair = 0; ipair < vlinkpositions.size(); ++ipair) {
+        int linkindex = vlinkpositions[ipair].first;
+        OPENRAVE_ASSERT_FORMAT(linkindex >= 0 && linkindex < (int)_veclinks.size(), "body %s bad link index %d (num links %d)", GetName()%linkindex%_veclinks.size(),ORE_InvalidArguments);
+        int offset = linkindex*_veclinks.size();
+        int curlink = 0;
+        while(_vAllPairsShortestPaths[offset+curlink].first>=0) {
+            vjointpairs.push_back(std::make_pair(_vAllPairsShortestPaths[offset+curlink].second, (int)ipair));
+            curlink = _vAllPairsShortestPaths[offset+curlink].first;
+        }
+    }
+    std::sort(vjointpairs.begin(), vjointpairs.end());
+
+    std::vector<std::pair<int,dReal> > vpartials;
+    std::map< std::pair<Mimic::DOFFormat, int>, dReal > mapcachedpartials;
+    std::vector< std::pair<int, int> >::const_iterator itjointpair = vjointpairs.begin();
+    while(itjointpair != vjointpairs.end()) {
+        int jointindex = itjointpair->first;
+        std::vector< std::pair<int, int> >::const_iterator itjointend = itjointpair;
+        while(itjointend != vjointpairs.end() && itjointend->first == jointindex) {
+            ++itjointend;
+        }
+        bool bactive = jointindex < (int)_vecjoints.size();
+        JointPtr pjoint = bactive ? _vecjoints.at(jointindex) : _vPassiveJoints.at(jointindex-_vecjoints.size());
+        Vector anchor = pjoint->GetAnchor();
+        for(int idof = 0; idof < pjoint->GetDOF(); ++idof) {
+            if( !bactive && !pjoint->IsMimic(idof) ) {
+                continue;
+            }
+            bool brevolute = pjoint->IsRevolute(idof);
+            if( !brevolute && !pjoint->IsPrismatic(idof) ) {
+                RAVELOG_WARN("ComputeJacobians joint %d not supported\n", pjoint->GetType());
+                continue;
+            }
+            Vector axis = pjoint->GetAxis(idof);
+            if( bactive ) {
+                vpartials.resize(1);
+                vpartials[0].first = pjoint->GetDOFIndex()+idof;
+                vpartials[0].second = 1;
+            }
+            else {
+                pjoint->_ComputePartialVelocities(vpartials,idof,mapcachedpartials);
+            }
+            for(std::vector< std::pair<int, int> >::const_iterator it = itjointpair; it != itjointend; ++it) {
+                const std::pair<int, Vector>& linkposition = vlinkpositions[it->second];
+                if( bactive && DoesAffect(jointindex, linkposition.first) == 0 ) {
+                    continue;
+                }
+                Vector vtrans = brevolute ? axis.cross(linkposition.second-anchor) : axis;
+                dReal* pjacobian = pjacobians + 6*dofstride*it->second;
+                FOREACHC(itpartial,vpartials) {
+                    int column = vdofcolumns.at(itpartial->first);
+                    if( column < 0 ) {
+                        continue;
+                    }
+                    pjacobian[column] += vtrans.x*itpartial->second;
+                    pjacobian[dofstride+column] += vtrans.y*itpartial->second;
+                    pjacobian[2*dofstride+column] += vtrans.z*itpartial->second;
+                    if( brevolute ) {
+                        pjacobian[3*dofstride+column] += axis.x*itpartial->second;
+                        pjacobian[4*dofstride+column] += axis.y*itpartial->second;
+                        pjacobian[5*dofstride+column] += axis.z*itpartial->second;
+                    }
+                }
+            }
+        }
+        itjointpair = itjointend;
+    }
+}
+
 void KinBody::CalculateAngularVelocityJacobian(int linkindex, boost::multi_array<dReal,2>& mjacobian) const
 {
     mjacobian.resize(boost::extents[3][GetDOF()]);
@@ -2649,9 +3138,17 @@ void KinBody::ComputeInverseDynamics(std::vector<dReal>& doftorques, const std::
         return;
     }
 
+    if( _vLinkLocalInertias.size() != _veclinks.size() ) {
+        // inertias about the COM in the link frame only change when the link dynamics change, so cache them
+        _vLinkLocalInertias.resize(_veclinks.size());
+        for(size_t i = 0; i < _veclinks.size(); ++i) {
+            _vLinkLocalInertias[i] = _veclinks[i]->GetLocalInertia();
+        }
+    }
+
     Vector vgravity = GetEnv()->GetPhysicsEngine()->GetGravity();
-    std::vector<dReal> vDOFVelocities;
-    std::vector<pair<Vector, Vector> > vLinkVelocities, vLinkAccelerations; // linear, angular
+    std::vector<dReal>& vDOFVelocities = _vTempDOFVelocities;
+    std::vector<pair<Vector, Vector> >& vLinkVelocities = _vTempLinkVelocities, &vLinkAccelerations = _vTempLinkAccelerations; // linear, angular
     _ComputeDOFLinkVelocities(vDOFVelocities, vLinkVelocities);
     // check if all velocities are 0, if yes, then can simplify some computations since only have contributions from dofacell and external forces
     bool bHasVelocity = false;
@@ -2664,9 +3161,9 @@ void KinBody::ComputeInverseDynamics(std::vector<dReal>& doftorques, const std::
     if( !bHasVelocity ) {
         vDOFVelocities.resize(0);
     }
-    AccelerationMap externalaccelerations;
-    externalaccelerations[0] = make_pair(-vgravity, Vector());
-    AccelerationMapPtr pexternalaccelerations(&externalaccelerations, utils::null_deleter());
+    _mapTempExternalAccelerations[0] = make_pair(-vgravity, Vector());
+    AccelerationMapPtr pexternalaccelerations(&_mapTempExternalAccelerations, utils::null_deleter());
+    vLinkAccelerations.assign(_veclinks.size(), pair<Vector, Vector>()); // _ComputeLinkAccelerations accumulates into the initial values
     _ComputeLinkAccelerations(vDOFVelocities, vDOFAccelerations, vLinkVelocities, vLinkAccelerations, pexternalaccelerations);
 
     // all valuess are in the global coordinate system
@@ -2674,24 +3171,34 @@ void KinBody::ComputeInverseDynamics(std::vector<dReal>& doftorques, const std::
     // v_B = v_A + angularvel x (B-A)
     // a_B = a_A + angularaccel x (B-A) + angularvel x (angularvel x (B-A))
     // forward recursion
-    std::vector<Vector> vLinkCOMLinearAccelerations(_veclinks.size()), vLinkCOMMomentOfInertia(_veclinks.size());
+    std::vector<Vector>& vLinkGlobalCOMs = _vTempLinkGlobalCOMs, &vLinkCOMLinearAccelerations = _vTempLinkCOMLinearAccelerations, &vLinkCOMMomentOfInertia = _vTempLinkCOMMomentOfInertia;
+    vLinkGlobalCOMs.resize(_veclinks.size());
+    vLinkCOMLinearAccelerations.resize(_veclinks.size());
+    vLinkCOMMomentOfInertia.resize(_veclinks.size());
     for(size_t i = 0; i < vLinkVelocities.size(); ++i) {
-        Vector vglobalcomfromlink = _veclinks.at(i)->GetGlobalCOM() - _veclinks.at(i)->_info._t.trans;
+        const Transform& tlink = _veclinks[i]->_info._t;
+        vLinkGlobalCOMs[i] = tlink*_veclinks[i]->_info._tMassFrame.trans;
+        Vector vglobalcomfromlink = vLinkGlobalCOMs[i] - tlink.trans;
         Vector vangularaccel = vLinkAccelerations.at(i).second;
         Vector vangularvelocity = vLinkVelocities.at(i).second;
         vLinkCOMLinearAccelerations[i] = vLinkAccelerations.at(i).first + vangularaccel.cross(vglobalcomfromlink) + vangularvelocity.cross(vangularvelocity.cross(vglobalcomfromlink));
-        TransformMatrix tm = _veclinks.at(i)->GetGlobalInertia();
-        vLinkCOMMomentOfInertia[i] = tm.rotate(vangularaccel) + vangularvelocity.cross(tm.rotate(vangularvelocity));
+        // global inertia is R*I*R^T, so rotate into the link frame, apply the cached local inertia, and rotate back
+        Vector vlocalrotinv = quatInverse(tlink.rot);
+        const TransformMatrix& tm = _vLinkLocalInertias[i];
+        Vector vinertiaaccel = quatRotate(tlink.rot, tm.rotate(quatRotate(vlocalrotinv, vangularaccel)));
+        Vector vinertiavelocity = quatRotate(tlink.rot, tm.rotate(quatRotate(vlocalrotinv, vangularvelocity)));
+        vLinkCOMMomentOfInertia[i] = vinertiaaccel + vangularvelocity.cross(vinertiavelocity);
     }
 
     // backward recursion
-    std::vector< std::pair<Vector, Vector> > vLinkForceTorques(_veclinks.size());
+    std::vector< std::pair<Vector, Vector> >& vLinkForceTorques = _vTempLinkForceTorques;
+    vLinkForceTorques.assign(_veclinks.size(), pair<Vector, Vector>());
     FOREACHC(it,mapExternalForceTorque) {
         vLinkForceTorques.at(it->first) = it->second;
     }
     std::fill(doftorques.begin(),doftorques.end(),0);
 
-    std::vector<std::pair<int,dReal> > vpartials;
+    std::vector<std::pair<int,dReal> >& vpartials = _vTempPartials;
     std::map< std::pair<Mimic::DOFFormat, int>, dReal > mapcachedpartials;
 
     // go backwards
@@ -2702,13 +3209,13 @@ void KinBody::ComputeInverseDynamics(std::vector<dReal>& doftorques, const std::
         Vector vjointtorque = vLinkForceTorques.at(childindex).second + vLinkCOMMomentOfInertia.at(childindex);
 
         if( !!pjoint->GetHierarchyParentLink() ) {
-            Vector vchildcomtoparentcom = pjoint->GetHierarchyChildLink()->GetGlobalCOM() - pjoint->GetHierarchyParentLink()->GetGlobalCOM();
             int parentindex = pjoint->GetHierarchyParentLink()->GetIndex();
+            Vector vchildcomtoparentcom = vLinkGlobalCOMs[childindex] - vLinkGlobalCOMs[parentindex];
             vLinkForceTorques.at(parentindex).first += vcomforce;
             vLinkForceTorques.at(parentindex).second += vjointtorque + vchildcomtoparentcom.cross(vcomforce);
         }
 
-        Vector vcomtoanchor = pjoint->GetHierarchyChildLink()->GetGlobalCOM() - pjoint->GetAnchor();
+        Vector vcomtoanchor = vLinkGlobalCOMs[childindex] - pjoint->GetAnchor();
         if( pjoint->GetDOFIndex() >= 0 ) {
             if( pjoint->GetType() == JointHinge ) {
                 doftorques.at(pjoint->GetDOFIndex()) += pjoint->GetAxis(0).dot3(vjointtorque + vcomtoanchor.cross(vcomforce));
@@ -2965,6 +3472,38 @@ void KinBody::ComputeInverseDynamics(boost::array< std::vector<dReal>, 3>& vDOFT
     }
 }
 
+void KinBody::ComputeInverseDynamicsSequence(std::vector<dReal>& doftorques, const std::vector<dReal>& dofvalues, const std::vector<dReal>& dofvelocities, const std::vector<dReal>& dofaccelerations, const KinBody::ForceTorqueMap& mapExternalForceTorque)
+{
+    CHECK_INTERNAL_COMPUTATION;
+    int dof = GetDOF();
+    if( dof == 0 ) {
+        doftorques.resize(0);
+        return;
+    }
+    OPENRAVE_ASSERT_FORMAT(dofvalues.size() % dof == 0, "body %s dof values size %d is not a multiple of dof %d", GetName()%dofvalues.size()%dof, ORE_InvalidArguments);
+    size_t numstates = dofvalues.size()/dof;
+    OPENRAVE_ASSERT_OP_FORMAT(dofvelocities.size(), ==, dofvalues.size(), "body %s velocities need to match the values", GetName(), ORE_InvalidArguments);
+    if( dofaccelerations.size() > 0 ) {
+        OPENRAVE_ASSERT_OP_FORMAT(dofaccelerations.size(), ==, dofvalues.size(), "body %s accelerations need to match the values", GetName(), ORE_InvalidArguments);
+    }
+    doftorques.resize(numstates*dof);
+
+    // the velocities are read back from the physics engine, so the state has to be set for every tuple
+    KinBodyStateSaver saver(shared_kinbody(), Save_LinkTransformation|Save_LinkVelocities);
+    _vTempSequenceDOFVelocities.resize(dof);
+    _vTempSequenceDOFAccelerations.resize(dofaccelerations.size() > 0 ? dof : 0);
+    for(size_t istate = 0; istate < numstates; ++istate) {
+        SetDOFValues(&dofvalues[istate*dof], dof, CLA_Nothing);
+        std::copy(dofvelocities.begin()+istate*dof, dofvelocities.begin()+(istate+1)*dof, _vTempSequenceDOFVelocities.begin());
+        SetDOFVelocities(_vTempSequenceDOFVelocities, CLA_Nothing);
+        if( dofaccelerations.size() > 0 ) {
+            std::copy(dofaccelerations.begin()+istate*dof, dofaccelerations.begin()+(istate+1)*dof, _vTempSequenceDOFAccelerations.begin());
+        }
+        ComputeInverseDynamics(_vTempSequenceDOFTorques, _vTempSequenceDOFAccelerations, mapExternalForceTorque);
+        std::copy(_vTempSequenceDOFTorques.begin(), _vTempSequenceDOFTorques.end(), doftorques.begin()+istate*dof);
+    }
+}
+
 void KinBody::GetLinkAccelerations(const std::vector<dReal>&vDOFAccelerations, std::vector<std::pair<Vector,Vector> >&vLinkAccelerations, AccelerationMapConstPtr externalaccelerations) const
 {
     CHECK_INTERNAL_COMPUTATION;
@@ -3268,6 +3807,21 @@ bool KinBody::CheckSelfCollision(CollisionReportPtr report, CollisionCheckerBase
         }
     }
 
+    // distance queries need the checker even when the links are far apart
+    int coloptions = collisionchecker->GetCollisionOptions();
+    if( !(coloptions & CO_Distance) ) {
+        int adjacentoptions = AO_Enabled;
+        if( (coloptions & CO_ActiveDOFs) && IsRobot() ) {
+            adjacentoptions |= AO_ActiveDOFs;
+        }
+        if( !CheckSelfCollisionSpheres(adjacentoptions) ) {
+            if( !!report ) {
+                report->Reset(coloptions);
+            }
+            return false;
+        }
+    }
+
     if( collisionchecker->CheckStandaloneSelfCollision(shared_kinbody_const(), report) ) {
         if( !!report ) {
             if( IS_DEBUGLEVEL(Level_Verbose) ) {
@@ -3292,14 +3846,159 @@ bool KinBody::CheckSelfCollision(CollisionReportPtr report, CollisionCheckerBase
     return false;
 }
 
+/// \brief returns the bounding sphere of the geometry in the link frame with the radius in w, the radius is negative if the geometry has no volume
+static Vector _ComputeGeometryInfoBoundingSphere(const KinBody::GeometryInfo& info)
+{
+    Vector vsphere(0,0,0,-1);
+    switch(info._type) {
+    case GT_None:
+        break;
+    case GT_Box:
+        vsphere = info._t.trans;
+        vsphere.w = RaveSqrt(info._vGeomData.lengthsqr3());
+        break;
+    case GT_Container: // origin of container is at the bottom
+        vsphere = info._t * Vector(0,0,0.5*info._vGeomData.z);
+        vsphere.w = 0.5*RaveSqrt(info._vGeomData.lengthsqr3());
+        break;
+    case GT_Sphere:
+        vsphere = info._t.trans;
+        vsphere.w = info._vGeomData.x;
+        break;
+    case GT_Cylinder:
+        vsphere = info._t.trans;
+        vsphere.w = RaveSqrt(info._vGeomData.x*info._vGeomData.x + 0.25*info._vGeomData.y*info._vGeomData.y);
+        break;
+    default:
+        // meshes and anything that is checked as one
+        if( info._meshcollision.vertices.size() > 0 ) {
+            Vector vmin = info._meshcollision.vertices.at(0), vmax = vmin;
+            FOREACHC(itv, info._meshcollision.vertices) {
+                vmin.x = min(vmin.x, itv->x); vmin.y = min(vmin.y, itv->y); vmin.z = min(vmin.z, itv->z);
+                vmax.x = max(vmax.x, itv->x); vmax.y = max(vmax.y, itv->y); vmax.z = max(vmax.z, itv->z);
+            }
+            Vector vcenter = 0.5*(vmin+vmax);
+            dReal fmaxdist2 = 0;
+            FOREACHC(itv, info._meshcollision.vertices) {
+                fmaxdist2 = max(fmaxdist2, (*itv-vcenter).lengthsqr3());
+            }
+            vsphere = info._t * vcenter;
+            vsphere.w = RaveSqrt(fmaxdist2);
+        }
+        break;
+    }
+    return vsphere;
+}
+
+void KinBody::_ComputeLinkBoundingSpheres() const
+{
+    _vLinkBoundingSpheres.resize(_veclinks.size());
+    _vLinkGeometrySpheres.resize(_veclinks.size());
+    for(size_t ilink = 0; ilink < _veclinks.size(); ++ilink) {
+        const Link& link = *_veclinks[ilink];
+        std::vector<Vector>& vgeomspheres = _vLinkGeometrySpheres[ilink];
+        vgeomspheres.resize(0);
+        FOREACHC(itgeom, link.GetGeometries()) {
+            Vector vsphere = _ComputeGeometryInfoBoundingSphere((*itgeom)->GetInfo());
+            if( vsphere.w >= 0 ) {
+                vgeomspheres.push_back(vsphere);
+            }
+        }
+        FOREACHC(itgroup, link.GetInfo()._mapExtraGeometries) {
+            FOREACHC(itinfo, itgroup->second) {
+                if( !!*itinfo ) {
+                    Vector vsphere = _ComputeGeometryInfoBoundingSphere(**itinfo);
+                    if( vsphere.w >= 0 ) {
+                        vgeomspheres.push_back(vsphere);
+                    }
+                }
+            }
+        }
+
+        Vector& vlinksphere = _vLinkBoundingSpheres[ilink];
+        vlinksphere = Vector(0,0,0,-1);
+        if( vgeomspheres.size() > 0 ) {
+            Vector vmin = vgeomspheres[0] - Vector(vgeomspheres[0].w,vgeomspheres[0].w,vgeomspheres[0].w);
+            Vector vmax = vgeomspheres[0] + Vector(vgeomspheres[0].w,vgeomspheres[0].w,vgeomspheres[0].w);
+            FOREACHC(itsphere, vgeomspheres) {
+                vmin.x = min(vmin.x, itsphere->x-itsphere->w); vmin.y = min(vmin.y, itsphere->y-itsphere->w); vmin.z = min(vmin.z, itsphere->z-itsphere->w);
+                vmax.x = max(vmax.x, itsphere->x+itsphere->w); vmax.y = max(vmax.y, itsphere->y+itsphere->w); vmax.z = max(vmax.z, itsphere->z+itsphere->w);
+            }
+            vlinksphere = 0.5*(vmin+vmax);
+            vlinksphere.w = 0;
+            FOREACHC(itsphere, vgeomspheres) {
+                vlinksphere.w = max(vlinksphere.w, RaveSqrt((*itsphere-vlinksphere).lengthsqr3()) + itsphere->w);
+            }
+        }
+    }
+}
+
+bool KinBody::CheckSelfCollisionSpheres(int adjacentoptions) const
+{
+    const std::vector< std::pair<int16_t, int16_t> >& vpairs = GetNonAdjacentLinkPairs(adjacentoptions);
+    if( vpairs.size() == 0 ) {
+        return false;
+    }
+    if( _vLinkBoundingSpheres.size() != _veclinks.size() ) {
+        _ComputeLinkBoundingSpheres();
+    }
+
+    // the link spheres are tested first on flat arrays so that the pair loop has no branches
+    const size_t numlinks = _veclinks.size();
+    _vLinkSphereWorldCoords.resize(4*numlinks);
+    dReal* px = &_vLinkSphereWorldCoords[0], *py = px+numlinks, *pz = py+numlinks, *pradius = pz+numlinks;
+    for(size_t ilink = 0; ilink < numlinks; ++ilink) {
+        Vector v = _veclinks[ilink]->GetTransform() * _vLinkBoundingSpheres[ilink];
+        px[ilink] = v.x; py[ilink] = v.y; pz[ilink] = v.z;
+        pradius[ilink] = _vLinkBoundingSpheres[ilink].w;
+    }
+    _vLinkSpherePairOverlaps.resize(vpairs.size());
+    for(size_t ipair = 0; ipair < vpairs.size(); ++ipair) {
+        int i0 = vpairs[ipair].first, i1 = vpairs[ipair].second;
+        dReal dx = px[i0]-px[i1], dy = py[i0]-py[i1], dz = pz[i0]-pz[i1], r = pradius[i0]+pradius[i1];
+        _vLinkSpherePairOverlaps[ipair] = (pradius[i0] >= 0) & (pradius[i1] >= 0) & (dx*dx+dy*dy+dz*dz <= r*r);
+    }
+
+    // for the overlapping links, test the geometry spheres
+    for(size_t ipair = 0; ipair < vpairs.size(); ++ipair) {
+        if( !_vLinkSpherePairOverlaps[ipair] ) {
+            continue;
+        }
+        int i0 = vpairs[ipair].first, i1 = vpairs[ipair].second;
+        const std::vector<Vector>& vspheres0 = _vLinkGeometrySpheres[i0], &vspheres1 = _vLinkGeometrySpheres[i1];
+        if( vspheres0.size() == 1 && vspheres1.size() == 1 ) {
+            return true; // same as the link spheres
+        }
+        Transform t0 = _veclinks[i0]->GetTransform(), t1 = _veclinks[i1]->GetTransform();
+        FOREACHC(itsphere1, vspheres1) {
+            Vector v1 = t1 * *itsphere1;
+            // only test the geometries of link0 that can touch the link1 sphere
+            dReal dlink0 = RaveSqrt((v1-Vector(px[i0],py[i0],pz[i0])).lengthsqr3());
+            if( dlink0 > pradius[i0] + itsphere1->w ) {
+                continue;
+            }
+            FOREACHC(itsphere0, vspheres0) {
+                dReal r = itsphere0->w + itsphere1->w;
+                if( (t0 * *itsphere0 - v1).lengthsqr3() <= r*r ) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
 void KinBody::_ComputeInternalInformation()
 {
     uint64_t starttime = utils::GetMicroTime();
     _nHierarchyComputed = 1;
+    _vLinkLocalInertias.resize(0);
+    _nAABBUpdateStamp = -1;
 
     int lindex=0;
     FOREACH(itlink,_veclinks) {
         (*itlink)->_index = lindex; // always reset, necessary since index cannot be initialized by custom links
+        ++(*itlink)->_nGeometryStamp; // the readers can modify the geometries directly
         (*itlink)->_vParentLinks.clear();
         if((_veclinks.size() > 1)&&((*itlink)->GetName().size() == 0)) {
             RAVELOG_WARN(str(boost::format("%s link index %d has no name")%GetName()%lindex));
@@ -4344,6 +5043,7 @@ void KinBody::_ResetInternalCollisionCache()
     FOREACH(it,_setNonAdjacentLinks) {
         it->clear();
     }
+    _nNonAdjacentLinkUpdateStamp++;
 }
 
 const std::set<int>& KinBody::GetNonAdjacentLinks(int adjacentoptions) const
@@ -4355,8 +5055,10 @@ public:
             _pbody->GetLinkTransformations(vcurtrans, _vdoflastsetvalues);
         }
         ~TransformsSaver() {
+            ++_pbody->_nUpdateStampId;
             for(size_t i = 0; i < _pbody->_veclinks.size(); ++i) {
                 boost::static_pointer_cast<Link>(_pbody->_veclinks[i])->_info._t = vcurtrans.at(i);
+                boost::static_pointer_cast<Link>(_pbody->_veclinks[i])->_nUpdateStampId = _pbody->_nUpdateStampId;
             }
             for(size_t i = 0; i < _pbody->_vecjoints.size(); ++i) {
                 for(int j = 0; j < _pbody->_vecjoints[i]->GetDOF(); ++j) {
@@ -4377,10 +5079,11 @@ private:
         TransformsSaver saver(shared_kinbody_const());
         CollisionCheckerBasePtr collisionchecker = !!_selfcollisionchecker ? _selfcollisionchecker : GetEnv()->GetCollisionChecker();
         CollisionOptionsStateSaver colsaver(collisionchecker,0); // have to reset the collision options
+        _nUpdateStampId++; // because transforms were modified
         for(size_t i = 0; i < _veclinks.size(); ++i) {
             boost::static_pointer_cast<Link>(_veclinks[i])->_info._t = _vInitialLinkTransformations.at(i);
+            boost::static_pointer_cast<Link>(_veclinks[i])->_nUpdateStampId = _nUpdateStampId;
         }
-        _nUpdateStampId++; // because transforms were modified
         for(size_t i = 0; i < _veclinks.size(); ++i) {
             for(size_t j = i+1; j < _veclinks.size(); ++j) {
                 if((_setAdjacentLinks.find(i|(j<<16)) == _setAdjacentLinks.end())&& !collisionchecker->CheckCollision(LinkConstPtr(_veclinks[i]), LinkConstPtr(_veclinks[j])) ) {
@@ -4390,9 +5093,11 @@ private:
         }
         _nUpdateStampId++; // because transforms were modified
         _nNonAdjacentLinkCache = 0;
+        _nNonAdjacentLinkUpdateStamp++;
     }
     if( (_nNonAdjacentLinkCache&adjacentoptions) != adjacentoptions ) {
         int requestedoptions = (~_nNonAdjacentLinkCache)&adjacentoptions;
+        _nNonAdjacentLinkUpdateStamp++;
         // find out what needs to computed
         if( requestedoptions & AO_Enabled ) {
             _setNonAdjacentLinks.at(AO_Enabled).clear();
@@ -4411,6 +5116,21 @@ private:
     return _setNonAdjacentLinks.at(adjacentoptions);
 }
 
+const std::vector< std::pair<int16_t, int16_t> >& KinBody::GetNonAdjacentLinkPairs(int adjacentoptions) const
+{
+    const std::set<int>& setnonadjacent = GetNonAdjacentLinks(adjacentoptions);
+    std::vector< std::pair<int16_t, int16_t> >& vpairs = _vNonAdjacentLinkPairs.at(adjacentoptions);
+    if( _vNonAdjacentLinkPairsStamps[adjacentoptions] != _nNonAdjacentLinkUpdateStamp ) {
+        vpairs.resize(0);
+        vpairs.reserve(setnonadjacent.size());
+        FOREACHC(itset, setnonadjacent) {
+            vpairs.push_back(std::make_pair((int16_t)(*itset&0xffff), (int16_t)(*itset>>16)));
+        }
+        _vNonAdjacentLinkPairsStamps[adjacentoptions] = _nNonAdjacentLinkUpdateStamp;
+    }
+    return vpairs;
+}
+
 const std::set<int>& KinBody::GetAdjacentLinks() const
 {
     CHECK_INTERNAL_COMPUTATION;
@@ -4427,6 +5147,7 @@ void KinBody::Clone(InterfaceBaseConstPtr preference, int cloningoptions)
     _bMakeJoinedLinksAdjacent = r->_bMakeJoinedLinksAdjacent;
     __hashkinematics = r->__hashkinematics;
     _vTempJoints = r->_vTempJoints;
+    _vLinkBoundingSpheres.resize(0);
 
     _veclinks.resize(0); _veclinks.reserve(r->_veclinks.size());
     FOREACHC(itlink, r->_veclinks) {
@@ -4434,6 +5155,7 @@ void KinBody::Clone(InterfaceBaseConstPtr preference, int cloningoptions)
         // TODO should create a Link::Clone method
         *pnewlink = **itlink; // be careful of copying pointers
         pnewlink->_parent = shared_kinbody();
+        pnewlink->_nAABBUpdateStamp = -1; // the link stamps are reset below and could match the cached box
         // have to copy all the geometries too!
         std::vector<Link::GeometryPtr> vnewgeometries(pnewlink->_vGeometries.size());
         for(size_t igeom = 0; igeom < vnewgeometries.size(); ++igeom) {
@@ -4533,11 +5255,20 @@ void KinBody::Clone(InterfaceBaseConstPtr preference, int cloningoptions)
     // cache
     _ResetInternalCollisionCache();
     _nUpdateStampId++; // update the stamp instead of copying
+    FOREACH(itlink, _veclinks) {
+        (*itlink)->_nUpdateStampId = _nUpdateStampId; // link stamps were copied from the reference body
+    }
 }
 
 void KinBody::_PostprocessChangedParameters(uint32_t parameters)
 {
     _nUpdateStampId++;
+    if( !!(parameters & (Prop_LinkGeometry|Prop_LinkGeometryGroup)) ) {
+        _vLinkBoundingSpheres.resize(0);
+    }
+    if( !!(parameters & Prop_LinkDynamics) ) {
+        _vLinkLocalInertias.resize(0);
+    }
     if( _nHierarchyComputed == 1 ) {
         _nParametersChanged |= parameters;
         return;
@@ -4554,6 +5285,14 @@ void KinBody::_PostprocessChangedParameters(uint32_t parameters)
         __hashkinematics.resize(0);
     }
 
+    if( GetEnv()->IsBodyChangeBatchActive() && GetEnv()->_QueueBodyChangeCallbacks(shared_kinbody(), parameters) ) {
+        return;
+    }
+    _FireChangeCallbacks(parameters);
+}
+
+void KinBody::_FireChangeCallbacks(uint32_t parameters)
+{
     std::list<UserDataWeakPtr> listRegisteredCallbacks;
     uint32_t index = 0;
     while(parameters && index < _vlistRegisteredCallbacks.size()) {
@@ -4613,7 +5352,22 @@ const std::string& KinBody::GetKinematicsGeometryHash() const
     if( __hashkinematics.size() == 0 ) {
         ostringstream ss;
         ss << std::fixed << std::setprecision(SERIALIZATION_PRECISION);
-        serialize(ss,SO_Kinematics|SO_Geometry);
+        // same as serialize(ss,SO_Kinematics|SO_Geometry) except that each geometry is replaced by its cached hash
+        ss << _veclinks.size() << " ";
+        FOREACHC(itlink,_veclinks) {
+            ss << (*itlink)->GetIndex() << " " << (*itlink)->_vGeometries.size() << " ";
+            FOREACHC(itgeom,(*itlink)->_vGeometries) {
+                ss << (*itgeom)->GetHash() << " ";
+            }
+        }
+        ss << _vecjoints.size() << " ";
+        FOREACHC(it,_vecjoints) {
+            (*it)->serialize(ss,SO_Kinematics|SO_Geometry);
+        }
+        ss << _vPassiveJoints.size() << " ";
+        FOREACHC(it,_vPassiveJoints) {
+            (*it)->serialize(ss,SO_Kinematics|SO_Geometry);
+        }
         __hashkinematics = utils::GetMD5HashString(ss.str());
     }
     return __hashkinematics;
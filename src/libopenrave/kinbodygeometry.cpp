@@ -170,6 +170,36 @@ KinBody::GeometryInfo::GeometryInfo() : XMLReadable("geometry")
     _bModifiable = true;
 }
 
+/// each coordinate of a voxel key uses 21 bits offset by OCTREE_KEY_OFFSET
+static const int64_t OCTREE_KEY_OFFSET = 1<<20;
+
+int64_t KinBody::GeometryInfo::GetOctreeVoxelKey(const Vector& point) const
+{
+    OPENRAVE_ASSERT_OP(_vGeomData.x,>,0);
+    int64_t key = 0;
+    for(int i = 0; i < 3; ++i) {
+        int64_t index = (int64_t)floor(point[i]/_vGeomData.x) + OCTREE_KEY_OFFSET;
+        if( index < 0 ) {
+            index = 0;
+        }
+        else if( index >= 2*OCTREE_KEY_OFFSET ) {
+            index = 2*OCTREE_KEY_OFFSET-1;
+        }
+        key = (key<<21)|index;
+    }
+    return key;
+}
+
+Vector KinBody::GeometryInfo::GetOctreeVoxelCenter(int64_t key) const
+{
+    Vector center;
+    for(int i = 2; i >= 0; --i) {
+        center[i] = ((dReal)((key & (2*OCTREE_KEY_OFFSET-1)) - OCTREE_KEY_OFFSET) + 0.5)*_vGeomData.x;
+        key >>= 21;
+    }
+    return center;
+}
+
 bool KinBody::GeometryInfo::InitCollisionMesh(float fTessellation)
 {
     if( _type == GT_TriMesh || _type == GT_None ) {
@@ -276,6 +306,15 @@ bool KinBody::GeometryInfo::InitCollisionMesh(float fTessellation)
         }
         break;
     }
+    case GT_Octree: {
+        Vector vhalfextents(0.5*_vGeomData.x, 0.5*_vGeomData.x, 0.5*_vGeomData.x);
+        _meshcollision.vertices.reserve(8*_setOctreeVoxels.size());
+        _meshcollision.indices.reserve(36*_setOctreeVoxels.size());
+        FOREACHC(itkey, _setOctreeVoxels) {
+            AppendBoxTriangulation(GetOctreeVoxelCenter(*itkey), vhalfextents, _meshcollision);
+        }
+        break;
+    }
     default:
         throw OPENRAVE_EXCEPTION_FORMAT(_("unrecognized geom type %d!"), _type, ORE_InvalidArguments);
     }
@@ -283,12 +322,40 @@ bool KinBody::GeometryInfo::InitCollisionMesh(float fTessellation)
     return true;
 }
 
-KinBody::Link::Geometry::Geometry(KinBody::LinkPtr parent, const KinBody::GeometryInfo& info) : _parent(parent), _info(info)
+KinBody::Link::Geometry::Geometry(KinBody::LinkPtr parent, const KinBody::GeometryInfo& info) : _parent(parent), _info(info), _nUpdateStamp(0), __nHashUpdateStamp(-1), __nMeshBoundsUpdateStamp(-1)
+{
+}
+
+/// \brief computes the bounds of the vertices transformed by t
+static void _ComputeVerticesBounds(const TransformMatrix& t, const std::vector<Vector>& vertices, Vector& vmin, Vector& vmax)
 {
+    vmin = vmax = t*vertices.at(0);
+    FOREACHC(itv, vertices) {
+        Vector v = t * *itv;
+        if( vmin.x > v.x ) {
+            vmin.x = v.x;
+        }
+        if( vmin.y > v.y ) {
+            vmin.y = v.y;
+        }
+        if( vmin.z > v.z ) {
+            vmin.z = v.z;
+        }
+        if( vmax.x < v.x ) {
+            vmax.x = v.x;
+        }
+        if( vmax.y < v.y ) {
+            vmax.y = v.y;
+        }
+        if( vmax.z < v.z ) {
+            vmax.z = v.z;
+        }
+    }
 }
 
 bool KinBody::Link::Geometry::InitCollisionMesh(float fTessellation)
 {
+    ++_nUpdateStamp;
     return _info.InitCollisionMesh(fTessellation);
 }
 
@@ -328,27 +395,18 @@ AABB KinBody::Link::Geometry::ComputeAABB(const Transform& t) const
     case GT_TriMesh:
         // just use _info._meshcollision
         if( _info._meshcollision.vertices.size() > 0) {
-            Vector vmin, vmax; vmin = vmax = tglobal*_info._meshcollision.vertices.at(0);
-            FOREACHC(itv, _info._meshcollision.vertices) {
-                Vector v = tglobal * *itv;
-                if( vmin.x > v.x ) {
-                    vmin.x = v.x;
-                }
-                if( vmin.y > v.y ) {
-                    vmin.y = v.y;
-                }
-                if( vmin.z > v.z ) {
-                    vmin.z = v.z;
-                }
-                if( vmax.x < v.x ) {
-                    vmax.x = v.x;
-                }
-                if( vmax.y < v.y ) {
-                    vmax.y = v.y;
-                }
-                if( vmax.z < v.z ) {
-                    vmax.z = v.z;
+            Vector vmin, vmax;
+            if( tglobal.m[0] == 1 && tglobal.m[5] == 1 && tglobal.m[10] == 1 && tglobal.m[1] == 0 && tglobal.m[2] == 0 && tglobal.m[4] == 0 && tglobal.m[6] == 0 && tglobal.m[8] == 0 && tglobal.m[9] == 0 ) {
+                // only translated, so the cached bounds give the same box without going through the vertices
+                if( __nMeshBoundsUpdateStamp != _nUpdateStamp ) {
+                    _ComputeVerticesBounds(TransformMatrix(), _info._meshcollision.vertices, __vMeshMin, __vMeshMax);
+                    __nMeshBoundsUpdateStamp = _nUpdateStamp;
                 }
+                vmin = __vMeshMin + tglobal.trans;
+                vmax = __vMeshMax + tglobal.trans;
+            }
+            else {
+                _ComputeVerticesBounds(tglobal, _info._meshcollision.vertices, vmin, vmax);
             }
             ab.extents = (dReal)0.5*(vmax-vmin);
             ab.pos = (dReal)0.5*(vmax+vmin);
@@ -357,6 +415,28 @@ AABB KinBody::Link::Geometry::ComputeAABB(const Transform& t) const
             ab.pos = tglobal.trans;
         }
         break;
+    case GT_Octree:
+        // bounds of the occupied voxels, transformed like a box
+        if( _info._setOctreeVoxels.size() > 0 ) {
+            Vector vmin, vmax;
+            vmin = vmax = _info.GetOctreeVoxelCenter(*_info._setOctreeVoxels.begin());
+            FOREACHC(itkey, _info._setOctreeVoxels) {
+                Vector v = _info.GetOctreeVoxelCenter(*itkey);
+                for(int i = 0; i < 3; ++i) {
+                    vmin[i] = min(vmin[i], v[i]);
+                    vmax[i] = max(vmax[i], v[i]);
+                }
+            }
+            Vector vextents = (dReal)0.5*(vmax-vmin) + Vector(0.5*_info._vGeomData.x, 0.5*_info._vGeomData.x, 0.5*_info._vGeomData.x);
+            ab.extents.x = RaveFabs(tglobal.m[0])*vextents.x + RaveFabs(tglobal.m[1])*vextents.y + RaveFabs(tglobal.m[2])*vextents.z;
+            ab.extents.y = RaveFabs(tglobal.m[4])*vextents.x + RaveFabs(tglobal.m[5])*vextents.y + RaveFabs(tglobal.m[6])*vextents.z;
+            ab.extents.z = RaveFabs(tglobal.m[8])*vextents.x + RaveFabs(tglobal.m[9])*vextents.y + RaveFabs(tglobal.m[10])*vextents.z;
+            ab.pos = tglobal*((dReal)0.5*(vmax+vmin));
+        }
+        else {
+            ab.pos = tglobal.trans;
+        }
+        break;
     default:
         throw OPENRAVE_EXCEPTION_FORMAT(_("unknown geometry type %d"), _info._type, ORE_InvalidArguments);
     }
@@ -372,19 +452,77 @@ void KinBody::Link::Geometry::serialize(std::ostream& o, int options) const
     if( _info._type == GT_TriMesh ) {
         _info._meshcollision.serialize(o,options);
     }
+    else if( _info._type == GT_Octree ) {
+        SerializeRound(o,_info._vGeomData.x);
+        o << _info._setOctreeVoxels.size() << " ";
+        FOREACHC(itkey, _info._setOctreeVoxels) {
+            o << *itkey << " ";
+        }
+    }
     else {
         SerializeRound3(o,_info._vGeomData);
     }
 }
 
+const std::string& KinBody::Link::Geometry::GetHash() const
+{
+    if( __nHashUpdateStamp != _nUpdateStamp || __hash.size() == 0 ) {
+        ostringstream ss;
+        ss << std::fixed << std::setprecision(SERIALIZATION_PRECISION);
+        serialize(ss,SO_Geometry);
+        __hash = utils::GetMD5HashString(ss.str());
+        __nHashUpdateStamp = _nUpdateStamp;
+    }
+    return __hash;
+}
+
 void KinBody::Link::Geometry::SetCollisionMesh(const TriMesh& mesh)
 {
     OPENRAVE_ASSERT_FORMAT0(_info._bModifiable, "geometry cannot be modified", ORE_Failed);
     LinkPtr parent(_parent);
     _info._meshcollision = mesh;
+    ++_nUpdateStamp;
     parent->_Update();
 }
 
+size_t KinBody::Link::Geometry::UpdateOctreeVoxels(const std::vector<Vector>& vpoints, bool bOccupied)
+{
+    OPENRAVE_ASSERT_FORMAT0(_info._bModifiable, "geometry cannot be modified", ORE_Failed);
+    OPENRAVE_ASSERT_FORMAT(_info._type == GT_Octree, "geometry type %d is not an octree", _info._type, ORE_InvalidArguments);
+    size_t numchanged = 0;
+    FOREACHC(itpoint, vpoints) {
+        int64_t key = _info.GetOctreeVoxelKey(*itpoint);
+        if( bOccupied ) {
+            if( _info._setOctreeVoxels.insert(key).second ) {
+                ++numchanged;
+            }
+        }
+        else {
+            numchanged += _info._setOctreeVoxels.erase(key);
+        }
+    }
+    if( numchanged > 0 ) {
+        _info.InitCollisionMesh();
+        ++_nUpdateStamp;
+        LinkPtr parent(_parent);
+        parent->_Update();
+    }
+    return numchanged;
+}
+
+void KinBody::Link::Geometry::ClearOctreeVoxels()
+{
+    OPENRAVE_ASSERT_FORMAT0(_info._bModifiable, "geometry cannot be modified", ORE_Failed);
+    OPENRAVE_ASSERT_FORMAT(_info._type == GT_Octree, "geometry type %d is not an octree", _info._type, ORE_InvalidArguments);
+    if( _info._setOctreeVoxels.size() > 0 ) {
+        _info._setOctreeVoxels.clear();
+        _info.InitCollisionMesh();
+        ++_nUpdateStamp;
+        LinkPtr parent(_parent);
+        parent->_Update();
+    }
+}
+
 bool KinBody::Link::Geometry::SetVisible(bool visible)
 {
     if( _info._bVisible != visible ) {
@@ -104,6 +104,305 @@ OpenRAVEFunctionParserRealPtr CreateJointFunctionParser()
     return parser;
 }
 
+/// \brief compiles mimic equations into KinBody::Mimic::Polynomial when they only use polynomial operations on the equation variables
+class MimicPolynomialCompiler
+{
+public:
+    MimicPolynomialCompiler(const std::vector<std::string>& vvars) : _vvars(vvars) {
+    }
+
+    /// \brief returns the compiled equation, or an empty pointer if the equation has another shape and has to be evaluated by the function parser
+    KinBody::Mimic::PolynomialConstPtr Compile(const std::string& eq)
+    {
+        _p = eq.c_str();
+        _pend = _p + eq.size();
+        TermMap terms;
+        if( !_ParseExpression(terms, 0) ) {
+            return KinBody::Mimic::PolynomialConstPtr();
+        }
+        _SkipSpaces();
+        if( _p != _pend ) {
+            return KinBody::Mimic::PolynomialConstPtr();
+        }
+        boost::shared_ptr<KinBody::Mimic::Polynomial> poly(new KinBody::Mimic::Polynomial());
+        poly->_numvars = _vvars.size();
+        FOREACHC(itterm, terms) {
+            if( itterm->second != 0 ) {
+                poly->_vcoeffs.push_back(itterm->second);
+                poly->_vpowers.insert(poly->_vpowers.end(), itterm->first.begin(), itterm->first.end());
+            }
+        }
+        return poly;
+    }
+
+    /// \brief returns the partial derivative of poly with respect to variable ivar
+    static KinBody::Mimic::PolynomialConstPtr Differentiate(const KinBody::Mimic::Polynomial& poly, size_t ivar)
+    {
+        // decrementing the same power keeps the terms distinct, so nothing has to be merged
+        boost::shared_ptr<KinBody::Mimic::Polynomial> deriv(new KinBody::Mimic::Polynomial());
+        deriv->_numvars = poly._numvars;
+        for(size_t iterm = 0; iterm < poly._vcoeffs.size(); ++iterm) {
+            const uint8_t* ppowers = &poly._vpowers[iterm*poly._numvars];
+            if( ppowers[ivar] > 0 ) {
+                deriv->_vcoeffs.push_back(poly._vcoeffs[iterm]*ppowers[ivar]);
+                deriv->_vpowers.insert(deriv->_vpowers.end(), ppowers, ppowers+poly._numvars);
+                deriv->_vpowers[deriv->_vpowers.size()-poly._numvars+ivar] -= 1;
+            }
+        }
+        return deriv;
+    }
+
+    /// \brief writes poly in the function parser syntax so that it can also be kept as a regular equation
+    static std::string ToString(const KinBody::Mimic::Polynomial& poly, const std::vector<std::string>& vvars)
+    {
+        if( poly._vcoeffs.size() == 0 ) {
+            return "0";
+        }
+        std::stringstream ss;
+        ss.imbue(std::locale::classic());
+        ss << std::setprecision(std::numeric_limits<dReal>::digits10+1);
+        for(size_t iterm = 0; iterm < poly._vcoeffs.size(); ++iterm) {
+            if( iterm > 0 ) {
+                ss << "+";
+            }
+            ss << "(" << poly._vcoeffs[iterm] << ")";
+            for(size_t ivar = 0; ivar < poly._numvars; ++ivar) {
+                int power = poly._vpowers[iterm*poly._numvars+ivar];
+                if( power == 1 ) {
+                    ss << "*" << vvars.at(ivar);
+                }
+                else if( power > 1 ) {
+                    ss << "*" << vvars.at(ivar) << "^" << power;
+                }
+            }
+        }
+        return ss.str();
+    }
+
+private:
+    typedef std::map<std::vector<uint8_t>, dReal> TermMap; ///< powers of each variable -> coefficient
+
+    static const int s_nMaxDepth = 64; ///< nesting limit of parentheses and unary operators
+    static const int s_nMaxPower = 16; ///< largest power of a single variable
+
+    void _SkipSpaces()
+    {
+        while( _p != _pend && isspace((unsigned char)*_p) ) {
+            ++_p;
+        }
+    }
+
+    void _SetConstant(TermMap& terms, dReal f) const
+    {
+        terms.clear();
+        terms[std::vector<uint8_t>(_vvars.size(),0)] = f;
+    }
+
+    /// \brief returns true if terms has no variables, and sets f to its value
+    bool _GetConstant(const TermMap& terms, dReal& f) const
+    {
+        f = 0;
+        FOREACHC(itterm, terms) {
+            if( itterm->second != 0 && std::count(itterm->first.begin(), itterm->first.end(), 0) != (int)itterm->first.size() ) {
+                return false;
+            }
+            f += itterm->second;
+        }
+        return true;
+    }
+
+    static void _Add(TermMap& terms, const TermMap& other, dReal fmult)
+    {
+        FOREACHC(itterm, other) {
+            terms[itterm->first] += fmult*itterm->second;
+        }
+    }
+
+    bool _Multiply(TermMap& terms, const TermMap& other) const
+    {
+        TermMap result;
+        std::vector<uint8_t> vpowers(_vvars.size());
+        FOREACHC(itterm0, terms) {
+            FOREACHC(itterm1, other) {
+                for(size_t ivar = 0; ivar < vpowers.size(); ++ivar) {
+                    int power = itterm0->first[ivar] + itterm1->first[ivar];
+                    if( power > s_nMaxPower ) {
+                        return false;
+                    }
+                    vpowers[ivar] = power;
+                }
+                result[vpowers] += itterm0->second*itterm1->second;
+            }
+        }
+        terms.swap(result);
+        return true;
+    }
+
+    bool _ParseExpression(TermMap& terms, int depth)
+    {
+        if( !_ParseTerm(terms, depth) ) {
+            return false;
+        }
+        while(true) {
+            _SkipSpaces();
+            if( _p == _pend || (*_p != '+' && *_p != '-') ) {
+                return true;
+            }
+            dReal fmult = *_p == '-' ? -1 : 1;
+            ++_p;
+            TermMap other;
+            if( !_ParseTerm(other, depth) ) {
+                return false;
+            }
+            _Add(terms, other, fmult);
+        }
+    }
+
+    bool _ParseTerm(TermMap& terms, int depth)
+    {
+        if( !_ParseUnary(terms, depth) ) {
+            return false;
+        }
+        while(true) {
+            _SkipSpaces();
+            if( _p == _pend || (*_p != '*' && *_p != '/') ) {
+                return true;
+            }
+            bool bdivide = *_p == '/';
+            ++_p;
+            TermMap other;
+            if( !_ParseUnary(other, depth) ) {
+                return false;
+            }
+            if( bdivide ) {
+                // only division by constants keeps the polynomial shape
+                dReal fdenom;
+                if( !_GetConstant(other, fdenom) || fdenom == 0 ) {
+                    return false;
+                }
+                _SetConstant(other, 1/fdenom);
+            }
+            if( !_Multiply(terms, other) ) {
+                return false;
+            }
+        }
+    }
+
+    bool _ParseUnary(TermMap& terms, int depth)
+    {
+        if( depth > s_nMaxDepth ) {
+            return false;
+        }
+        _SkipSpaces();
+        if( _p != _pend && (*_p == '-' || *_p == '+') ) {
+            dReal fmult = *_p == '-' ? -1 : 1;
+            ++_p;
+            TermMap other;
+            if( !_ParseUnary(other, depth+1) ) {
+                return false;
+            }
+            terms.clear();
+            _Add(terms, other, fmult);
+            return true;
+        }
+        return _ParsePower(terms, depth);
+    }
+
+    bool _ParsePower(TermMap& terms, int depth)
+    {
+        if( !_ParsePrimary(terms, depth) ) {
+            return false;
+        }
+        _SkipSpaces();
+        if( _p == _pend || *_p != '^' ) {
+            return true;
+        }
+        ++_p;
+        TermMap exponent;
+        dReal fexponent;
+        if( !_ParseUnary(exponent, depth+1) || !_GetConstant(exponent, fexponent) ) {
+            return false;
+        }
+        int power = (int)fexponent;
+        if( power != fexponent || power < 0 || power > s_nMaxPower ) {
+            return false;
+        }
+        TermMap base;
+        base.swap(terms);
+        _SetConstant(terms, 1);
+        for(int i = 0; i < power; ++i) {
+            if( !_Multiply(terms, base) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool _ParsePrimary(TermMap& terms, int depth)
+    {
+        _SkipSpaces();
+        if( _p == _pend ) {
+            return false;
+        }
+        if( *_p == '(' ) {
+            ++_p;
+            if( !_ParseExpression(terms, depth+1) ) {
+                return false;
+            }
+            _SkipSpaces();
+            if( _p == _pend || *_p != ')' ) {
+                return false;
+            }
+            ++_p;
+            return true;
+        }
+        if( isdigit((unsigned char)*_p) || *_p == '.' ) {
+            const char* pstart = _p;
+            while( _p != _pend && (isdigit((unsigned char)*_p) || *_p == '.') ) {
+                ++_p;
+            }
+            if( _p != _pend && (*_p == 'e' || *_p == 'E') ) {
+                ++_p;
+                if( _p != _pend && (*_p == '+' || *_p == '-') ) {
+                    ++_p;
+                }
+                while( _p != _pend && isdigit((unsigned char)*_p) ) {
+                    ++_p;
+                }
+            }
+            std::stringstream ss(std::string(pstart, _p));
+            ss.imbue(std::locale::classic());
+            dReal f;
+            ss >> f;
+            if( !ss || ss.peek() != std::stringstream::traits_type::eof() ) {
+                return false;
+            }
+            _SetConstant(terms, f);
+            return true;
+        }
+        if( isalpha((unsigned char)*_p) || *_p == '_' ) {
+            const char* pstart = _p;
+            while( _p != _pend && (isalnum((unsigned char)*_p) || *_p == '_') ) {
+                ++_p;
+            }
+            std::vector<std::string>::const_iterator itvar = std::find(_vvars.begin(), _vvars.end(), std::string(pstart, _p));
+            if( itvar == _vvars.end() ) {
+                // functions and named constants are left to the function parser
+                return false;
+            }
+            std::vector<uint8_t> vpowers(_vvars.size(), 0);
+            vpowers.at(itvar - _vvars.begin()) = 1;
+            terms.clear();
+            terms[vpowers] = 1;
+            return true;
+        }
+        return false;
+    }
+
+    const std::vector<std::string>& _vvars;
+    const char* _p, *_pend;
+};
+
 KinBody::Joint::Joint(KinBodyPtr parent, KinBody::JointType type)
 {
     _parent = parent;
@@ -1348,6 +1647,9 @@ void KinBody::Joint::SetMimicEquations(int iaxis, const std::string& poseq, cons
         mimic->_vdofformat.push_back(dofformat);
     }
 
+    MimicPolynomialCompiler polycompiler(resultVars);
+    mimic->_pospoly = polycompiler.Compile(eq);
+
     // need to set sVars to resultVars since that's what the user will be feeding with the input
     stringstream sVars;
     if( !resultVars.empty() ) {
@@ -1363,6 +1665,7 @@ void KinBody::Joint::SetMimicEquations(int iaxis, const std::string& poseq, cons
         }
 
         std::vector<OpenRAVEFunctionParserRealPtr> vfns(resultVars.size());
+        std::vector<MIMIC::PolynomialConstPtr> vpolys(resultVars.size());
         // extract the equations
         utils::SearchAndReplace(eq,mimic->_equations[itype],jointnamepairs);
         size_t index = eq.find('|');
@@ -1397,22 +1700,33 @@ void KinBody::Joint::SetMimicEquations(int iaxis, const std::string& poseq, cons
                 throw OPENRAVE_EXCEPTION_FORMAT(_("failed to set equation '%s' on %s:%s, at %d. Error is %s"), sequation%parent->GetName()%GetName()%ret%fn->ErrorMsg(),ORE_InvalidArguments);
             }
             vfns.at(itnameindex-resultVars.begin()) = fn;
+            vpolys.at(itnameindex-resultVars.begin()) = polycompiler.Compile(sequation);
         }
         // check if anything is missing
         for(size_t j = 0; j < resultVars.size(); ++j) {
-            if( !vfns[j] ) {
+            if( !vfns[j] && itype == 1 && !!mimic->_pospoly ) {
+                // the partial derivatives of a polynomial are known exactly
+                vpolys[j] = MimicPolynomialCompiler::Differentiate(*mimic->_pospoly, j);
+                vfns[j] = CreateJointFunctionParser();
+                ret = vfns[j]->Parse(MimicPolynomialCompiler::ToString(*vpolys[j], resultVars), sVars.str());
+                BOOST_ASSERT(ret < 0);
+            }
+            else if( !vfns[j] ) {
                 // print a message instead of throwing an exception since it might be common for only position equations to be specified
                 RAVELOG_WARN(str(boost::format("SetMimicEquations: missing variable %s from partial derivatives of joint %s!")%mapinvnames[resultVars[j]]%_info._name));
                 vfns[j] = CreateJointFunctionParser();
                 vfns[j]->Parse("0","");
+                vpolys[j].reset(new MIMIC::Polynomial());
             }
         }
 
         if( itype == 1 ) {
             mimic->_velfns.swap(vfns);
+            mimic->_velpolys.swap(vpolys);
         }
         else {
             mimic->_accelfns.swap(vfns);
+            mimic->_accelpolys.swap(vpolys);
         }
     }
     _vmimic.at(iaxis) = mimic;
@@ -1448,7 +1762,8 @@ void KinBody::Joint::_ComputePartialVelocities(std::vector<std::pair<int,dReal>
                     vtempvalues.push_back(itdofformat->GetJoint(parent)->GetValue(itdofformat->axis));
                 }
             }
-            dReal fvel = _vmimic[iaxis]->_velfns.at(itmimicdof->dofformatindex)->Eval(vtempvalues.empty() ? NULL : &vtempvalues[0]);
+            const MIMIC::PolynomialConstPtr& velpoly = _vmimic[iaxis]->_velpolys.at(itmimicdof->dofformatindex);
+            dReal fvel = !!velpoly ? velpoly->Eval(vtempvalues.empty() ? NULL : &vtempvalues[0]) : _vmimic[iaxis]->_velfns.at(itmimicdof->dofformatindex)->Eval(vtempvalues.empty() ? NULL : &vtempvalues[0]);
             const MIMIC::DOFFormat& dofformat = _vmimic[iaxis]->_vdofformat.at(itmimicdof->dofformatindex);
             if( dofformat.GetJoint(parent)->IsMimic(dofformat.axis) ) {
                 dofformat.GetJoint(parent)->_ComputePartialVelocities(vtemppartials,dofformat.axis,mapcachedpartials);
@@ -1490,14 +1805,24 @@ void KinBody::Joint::_ComputePartialVelocities(std::vector<std::pair<int,dReal>
 
 int KinBody::Joint::_Eval(int axis, uint32_t timederiv, const std::vector<dReal>& vdependentvalues, std::vector<dReal>& voutput)
 {
+    const dReal* pdependentvalues = vdependentvalues.empty() ? NULL : &vdependentvalues[0];
     if( timederiv == 0 ) {
-        _vmimic.at(axis)->_posfn->EvalMulti(voutput, vdependentvalues.empty() ? NULL : &vdependentvalues[0]);
+        if( !!_vmimic.at(axis)->_pospoly ) {
+            voutput.resize(1);
+            voutput[0] = _vmimic[axis]->_pospoly->Eval(pdependentvalues);
+            return 0;
+        }
+        _vmimic.at(axis)->_posfn->EvalMulti(voutput, pdependentvalues);
         return _vmimic.at(axis)->_posfn->EvalError();
     }
     else if( timederiv == 1 ) {
         voutput.resize(_vmimic.at(axis)->_velfns.size());
         for(size_t i = 0; i < voutput.size(); ++i) {
-            voutput[i] = _vmimic.at(axis)->_velfns.at(i)->Eval(vdependentvalues.empty() ? NULL : &vdependentvalues[0]);
+            if( !!_vmimic[axis]->_velpolys.at(i) ) {
+                voutput[i] = _vmimic[axis]->_velpolys[i]->Eval(pdependentvalues);
+                continue;
+            }
+            voutput[i] = _vmimic.at(axis)->_velfns.at(i)->Eval(pdependentvalues);
             int err = _vmimic.at(axis)->_velfns.at(i)->EvalError();
             if( err ) {
                 return err;
@@ -1507,7 +1832,11 @@ int KinBody::Joint::_Eval(int axis, uint32_t timederiv, const std::vector<dReal>
     else if( timederiv == 2 ) {
         voutput.resize(_vmimic.at(axis)->_accelfns.size());
         for(size_t i = 0; i < voutput.size(); ++i) {
-            voutput[i] = _vmimic.at(axis)->_accelfns.at(i)->Eval(vdependentvalues.empty() ? NULL : &vdependentvalues[0]);
+            if( !!_vmimic[axis]->_accelpolys.at(i) ) {
+                voutput[i] = _vmimic[axis]->_accelpolys[i]->Eval(pdependentvalues);
+                continue;
+            }
+            voutput[i] = _vmimic.at(axis)->_accelfns.at(i)->Eval(pdependentvalues);
             int err = _vmimic.at(axis)->_accelfns.at(i)->EvalError();
             if( err ) {
                 return err;
@@ -26,6 +26,11 @@ KinBody::Link::Link(KinBodyPtr parent)
 {
     _parent = parent;
     _index = -1;
+    _nUpdateStampId = 0;
+    _nGeometryStamp = 0;
+    _nLocalAABBGeometryStamp = -1;
+    _nAABBGeometryStamp = -1;
+    _nAABBUpdateStamp = -1;
 }
 
 KinBody::Link::~Link()
@@ -145,115 +150,79 @@ void KinBody::Link::SetMass(dReal mass)
     GetParent()->_PostprocessChangedParameters(Prop_LinkDynamics);
 }
 
-AABB KinBody::Link::ComputeLocalAABB() const
+/// \brief computes the aabb of the geometries transformed by t, geometries without volume are ignored
+///
+/// \param vdefaultpos position of the box if no geometry has volume
+static AABB _ComputeGeometriesAABB(const std::vector<KinBody::Link::GeometryPtr>& vgeometries, const Transform& t, const Vector& vdefaultpos)
 {
-    if( _vGeometries.size() == 1) {
-        return _vGeometries.front()->ComputeAABB(Transform());
+    if( vgeometries.size() == 1) {
+        return vgeometries.front()->ComputeAABB(t);
     }
-    else if( _vGeometries.size() > 1 ) {
-        Vector vmin, vmax;
-        bool binitialized=false;
-        AABB ab;
-        FOREACHC(itgeom,_vGeometries) {
-            ab = (*itgeom)->ComputeAABB(Transform());
-            if( ab.extents.x <= 0 || ab.extents.y <= 0 || ab.extents.z <= 0 ) {
-                continue;
-            }
-            Vector vnmin = ab.pos - ab.extents;
-            Vector vnmax = ab.pos + ab.extents;
-            if( !binitialized ) {
-                vmin = vnmin;
-                vmax = vnmax;
-                binitialized = true;
-            }
-            else {
-                if( vmin.x > vnmin.x ) {
-                    vmin.x = vnmin.x;
-                }
-                if( vmin.y > vnmin.y ) {
-                    vmin.y = vnmin.y;
-                }
-                if( vmin.z > vnmin.z ) {
-                    vmin.z = vnmin.z;
-                }
-                if( vmax.x < vnmax.x ) {
-                    vmax.x = vnmax.x;
-                }
-                if( vmax.y < vnmax.y ) {
-                    vmax.y = vnmax.y;
-                }
-                if( vmax.z < vnmax.z ) {
-                    vmax.z = vnmax.z;
-                }
-            }
+    Vector vmin, vmax;
+    bool binitialized=false;
+    AABB ab;
+    FOREACHC(itgeom,vgeometries) {
+        ab = (*itgeom)->ComputeAABB(t);
+        if( ab.extents.x <= 0 || ab.extents.y <= 0 || ab.extents.z <= 0 ) {
+            continue;
         }
+        Vector vnmin = ab.pos - ab.extents;
+        Vector vnmax = ab.pos + ab.extents;
         if( !binitialized ) {
-            ab.pos = _info._t.trans;
-            ab.extents = Vector(0,0,0);
+            vmin = vnmin;
+            vmax = vnmax;
+            binitialized = true;
         }
         else {
-            ab.pos = (dReal)0.5 * (vmin + vmax);
-            ab.extents = vmax - ab.pos;
+            if( vmin.x > vnmin.x ) {
+                vmin.x = vnmin.x;
+            }
+            if( vmin.y > vnmin.y ) {
+                vmin.y = vnmin.y;
+            }
+            if( vmin.z > vnmin.z ) {
+                vmin.z = vnmin.z;
+            }
+            if( vmax.x < vnmax.x ) {
+                vmax.x = vnmax.x;
+            }
+            if( vmax.y < vnmax.y ) {
+                vmax.y = vnmax.y;
+            }
+            if( vmax.z < vnmax.z ) {
+                vmax.z = vnmax.z;
+            }
         }
-        return ab;
     }
-    return AABB();
+    if( !binitialized ) {
+        ab.pos = vdefaultpos;
+        ab.extents = Vector(0,0,0);
+    }
+    else {
+        ab.pos = (dReal)0.5 * (vmin + vmax);
+        ab.extents = vmax - ab.pos;
+    }
+    return ab;
 }
 
-AABB KinBody::Link::ComputeAABB() const
+AABB KinBody::Link::ComputeLocalAABB() const
 {
-    if( _vGeometries.size() == 1) {
-        return _vGeometries.front()->ComputeAABB(_info._t);
+    if( _nLocalAABBGeometryStamp != _nGeometryStamp ) {
+        _localaabb = _ComputeGeometriesAABB(_vGeometries, Transform(), Vector());
+        _nLocalAABBGeometryStamp = _nGeometryStamp;
     }
-    else if( _vGeometries.size() > 1 ) {
-        Vector vmin, vmax;
-        bool binitialized=false;
-        AABB ab;
-        FOREACHC(itgeom,_vGeometries) {
-            ab = (*itgeom)->ComputeAABB(_info._t);
-            if( ab.extents.x <= 0 || ab.extents.y <= 0 || ab.extents.z <= 0 ) {
-                continue;
-            }
-            Vector vnmin = ab.pos - ab.extents;
-            Vector vnmax = ab.pos + ab.extents;
-            if( !binitialized ) {
-                vmin = vnmin;
-                vmax = vnmax;
-                binitialized = true;
-            }
-            else {
-                if( vmin.x > vnmin.x ) {
-                    vmin.x = vnmin.x;
-                }
-                if( vmin.y > vnmin.y ) {
-                    vmin.y = vnmin.y;
-                }
-                if( vmin.z > vnmin.z ) {
-                    vmin.z = vnmin.z;
-                }
-                if( vmax.x < vnmax.x ) {
-                    vmax.x = vnmax.x;
-                }
-                if( vmax.y < vnmax.y ) {
-                    vmax.y = vnmax.y;
-                }
-                if( vmax.z < vnmax.z ) {
-                    vmax.z = vnmax.z;
-                }
-            }
-        }
-        if( !binitialized ) {
-            ab.pos = _info._t.trans;
-            ab.extents = Vector(0,0,0);
-        }
-        else {
-            ab.pos = (dReal)0.5 * (vmin + vmax);
-            ab.extents = vmax - ab.pos;
-        }
-        return ab;
+    return _localaabb;
+}
+
+AABB KinBody::Link::ComputeAABB() const
+{
+    if( _nAABBGeometryStamp != _nGeometryStamp || _nAABBUpdateStamp != _nUpdateStampId ) {
+        // have to at least return the correct position!
+        _aabb = _ComputeGeometriesAABB(_vGeometries, _info._t, _info._t.trans);
+        _nAABBGeometryStamp = _nGeometryStamp;
+        _nAABBUpdateStamp = _nUpdateStampId;
     }
-    // have to at least return the correct position!
-    return AABB(_info._t.trans,Vector(0,0,0));
+    return _aabb;
 }
 
 void KinBody::Link::serialize(std::ostream& o, int options) const
@@ -283,7 +252,7 @@ void KinBody::Link::SetStatic(bool bStatic)
 void KinBody::Link::SetTransform(const Transform& t)
 {
     _info._t = t;
-    GetParent()->_nUpdateStampId++;
+    _nUpdateStampId = ++GetParent()->_nUpdateStampId;
 }
 
 void KinBody::Link::SetForce(const Vector& force, const Vector& pos, bool bAdd)
@@ -502,6 +471,7 @@ void KinBody::Link::UpdateInfo()
 
 void KinBody::Link::_Update(bool parameterschanged)
 {
+    ++_nGeometryStamp;
     // if there's only one trimesh geometry and it has identity offset, then copy it directly
     if( _vGeometries.size() == 1 && _vGeometries.at(0)->GetType() == GT_TriMesh && TransformDistanceFast(Transform(), _vGeometries.at(0)->GetTransform()) <= g_fEpsilonLinear ) {
         _collision = _vGeometries.at(0)->GetCollisionMesh();
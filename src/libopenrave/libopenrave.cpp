@@ -19,6 +19,8 @@
 #include <boost/scoped_ptr.hpp>
 #include <boost/utility.hpp>
 #include <boost/thread/once.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/functional/hash.hpp>
 
 #include <streambuf>
 
@@ -441,11 +443,6 @@ public:
             RAVELOG_WARN("failed to set to C locale: %s\n",e.what());
         }
 
-        _pdatabase.reset(new RaveDatabase());
-        if( !_pdatabase->Init(bLoadAllPlugins) ) {
-            RAVELOG_FATAL("failed to create the openrave plugin database\n");
-        }
-
         char* phomedir = getenv("OPENRAVE_HOME"); // getenv not thread-safe?
         if( phomedir == NULL ) {
 #ifndef _WIN32
@@ -463,6 +460,11 @@ public:
         CreateDirectory(_homedirectory.c_str(),NULL);
 #endif
 
+        _pdatabase.reset(new RaveDatabase());
+        if( !_pdatabase->Init(bLoadAllPlugins, _homedirectory + s_filesep + string("plugins.index")) ) {
+            RAVELOG_FATAL("failed to create the openrave plugin database\n");
+        }
+
 #ifdef _WIN32
         const char* delim = ";";
 #else
@@ -1148,6 +1150,7 @@ UserDataPtr RaveGlobalState()
 void RaveDestroy()
 {
     RaveGlobal::instance()->Destroy();
+    RaveFlushAsyncLogging(); // messages logged while destroying the environments
 }
 
 void RaveAddCallbackForDestroy(const boost::function<void()>& fn)
@@ -1390,6 +1393,157 @@ ConfigurationSpecification IkParameterization::GetConfigurationSpecification(IkP
     return spec;
 }
 
+void IkParameterization::ComputeDistancesSqr(const std::vector<dReal>& vvalues, std::vector<dReal>& vdists) const
+{
+    const dReal anglemult = 0.4; // has to match ComputeDistanceSqr
+    const size_t numvalues = GetNumberOfValues();
+    OPENRAVE_ASSERT_OP_FORMAT0(numvalues, >, 0, "parameterization has no values", ORE_InvalidArguments);
+    OPENRAVE_ASSERT_OP_FORMAT0(vvalues.size()%numvalues, ==, 0, "number of values is not a multiple of the number of values of the type", ORE_InvalidArguments);
+    const size_t num = vvalues.size()/numvalues;
+    vdists.resize(num);
+    if( num == 0 ) {
+        return;
+    }
+    const dReal* pvalues = &vvalues[0];
+    dReal* pdists = &vdists[0];
+    const Vector& q = _transform.rot, &t = _transform.trans;
+    // the translation parts are only arithmetic and vectorize, the acos of the angle parts is computed in a second pass
+    switch(_type) {
+    case IKP_Transform6D:
+        for(size_t i = 0; i < num; ++i) {
+            const dReal* v = pvalues + 7*i;
+            dReal dx = t.x-v[4], dy = t.y-v[5], dz = t.z-v[6];
+            pdists[i] = dx*dx + dy*dy + dz*dz;
+        }
+        for(size_t i = 0; i < num; ++i) {
+            const dReal* v = pvalues + 7*i;
+            dReal fcos = RaveFabs(q.x*v[0] + q.y*v[1] + q.z*v[2] + q.w*v[3]);
+            if( fcos < 1 ) {
+                dReal facos = RaveAcos(fcos);
+                pdists[i] += anglemult*facos*facos;
+            }
+        }
+        break;
+    case IKP_Rotation3D:
+        for(size_t i = 0; i < num; ++i) {
+            const dReal* v = pvalues + 4*i;
+            dReal fcos = RaveFabs(q.x*v[0] + q.y*v[1] + q.z*v[2] + q.w*v[3]);
+            dReal facos = fcos >= 1 ? 0 : RaveAcos(fcos);
+            pdists[i] = facos*facos;
+        }
+        break;
+    case IKP_Translation3D:
+    case IKP_Lookat3D:
+        // without the direction, the lookat distance is the distance between the points
+        for(size_t i = 0; i < num; ++i) {
+            const dReal* v = pvalues + 3*i;
+            dReal dx = t.x-v[0], dy = t.y-v[1], dz = t.z-v[2];
+            pdists[i] = dx*dx + dy*dy + dz*dz;
+        }
+        break;
+    case IKP_Direction3D:
+        for(size_t i = 0; i < num; ++i) {
+            const dReal* v = pvalues + 3*i;
+            dReal fcos = q.x*v[0] + q.y*v[1] + q.z*v[2];
+            dReal facos = fcos >= 1 ? 0 : RaveAcos(fcos);
+            pdists[i] = facos*facos;
+        }
+        break;
+    case IKP_TranslationDirection5D:
+        for(size_t i = 0; i < num; ++i) {
+            const dReal* v = pvalues + 6*i;
+            dReal dx = t.x-v[3], dy = t.y-v[4], dz = t.z-v[5];
+            pdists[i] = dx*dx + dy*dy + dz*dz;
+        }
+        for(size_t i = 0; i < num; ++i) {
+            const dReal* v = pvalues + 6*i;
+            dReal fcos = q.x*v[0] + q.y*v[1] + q.z*v[2];
+            if( fcos < 1 ) {
+                dReal facos = RaveAcos(fcos);
+                pdists[i] += anglemult*facos*facos;
+            }
+        }
+        break;
+    case IKP_TranslationXY2D:
+        for(size_t i = 0; i < num; ++i) {
+            const dReal* v = pvalues + 2*i;
+            dReal dx = t.x-v[0], dy = t.y-v[1];
+            pdists[i] = dx*dx + dy*dy;
+        }
+        break;
+    case IKP_TranslationLocalGlobal6D:
+        for(size_t i = 0; i < num; ++i) {
+            const dReal* v = pvalues + 6*i;
+            dReal lx = q.x-v[0], ly = q.y-v[1], lz = q.z-v[2], dx = t.x-v[3], dy = t.y-v[4], dz = t.z-v[5];
+            pdists[i] = (lx*lx + ly*ly + lz*lz) + (dx*dx + dy*dy + dz*dz);
+        }
+        break;
+    default: {
+        // the types with angle normalizations, compare one at a time
+        std::vector<dReal> vtemp(numvalues);
+        IkParameterization ikparam;
+        for(size_t i = 0; i < num; ++i) {
+            std::copy(pvalues + numvalues*i, pvalues + numvalues*(i+1), vtemp.begin());
+            ikparam.SetValues(vtemp.begin(), _type);
+            pdists[i] = ComputeDistanceSqr(ikparam);
+        }
+        break;
+    }
+    }
+}
+
+static void _WriteLittleEndian(std::ostream& O, uint64_t value, int numbytes)
+{
+    char buf[8];
+    for(int i = 0; i < numbytes; ++i) {
+        buf[i] = static_cast<char>((value>>(8*i))&0xff);
+    }
+    O.write(buf, numbytes);
+}
+
+static uint64_t _ReadLittleEndian(std::istream& I, int numbytes)
+{
+    unsigned char buf[8];
+    if( !I.read(reinterpret_cast<char*>(buf), numbytes) ) {
+        throw OPENRAVE_EXCEPTION_FORMAT0(_("unexpected end of binary ik parameterization"), ORE_InvalidArguments);
+    }
+    uint64_t value = 0;
+    for(int i = numbytes-1; i >= 0; --i) {
+        value = (value<<8)|buf[i];
+    }
+    return value;
+}
+
+void IkParameterization::SerializeBinary(std::ostream& O) const
+{
+    if( _mapCustomData.size() > 0 ) {
+        throw OPENRAVE_EXCEPTION_FORMAT0(_("binary ik parameterizations do not support custom data"), ORE_InvalidState);
+    }
+    std::vector<dReal> values(GetNumberOfValues());
+    GetValues(values.begin());
+    _WriteLittleEndian(O, static_cast<uint32_t>(_type), 4);
+    FOREACHC(itvalue, values) {
+        double f = *itvalue;
+        uint64_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        _WriteLittleEndian(O, bits, 8);
+    }
+}
+
+void IkParameterization::DeserializeBinary(std::istream& I)
+{
+    IkParameterizationType type = static_cast<IkParameterizationType>(_ReadLittleEndian(I, 4));
+    std::vector<dReal> values(GetNumberOfValues(type));
+    FOREACH(itvalue, values) {
+        uint64_t bits = _ReadLittleEndian(I, 8);
+        double f;
+        memcpy(&f, &bits, sizeof(f));
+        *itvalue = f;
+    }
+    SetValues(values.begin(), type);
+    _mapCustomData.clear();
+}
+
 std::ostream& operator<<(std::ostream& O, const IkParameterization &ikparam)
 {
     int type = ikparam._type;
@@ -1881,6 +2035,53 @@ void CollisionReport::Reset(int coloptions)
     }
 }
 
+/// \brief the free reports of one thread, see RaveGetPooledCollisionReport
+struct CollisionReportPool
+{
+    ~CollisionReportPool() {
+        FOREACH(itreport, vreports) {
+            delete *itreport;
+        }
+    }
+    std::vector<CollisionReport*> vreports;
+};
+
+static const size_t s_maxPooledCollisionReports = 16; ///< reports are only held for the duration of a few nested queries
+static boost::thread_specific_ptr<CollisionReportPool> s_collisionreportpool; ///< free reports of the calling thread
+
+/// \brief deleter of the pooled reports, gives the report back to the pool of the calling thread
+static void ReleasePooledCollisionReport(CollisionReport* preport)
+{
+    CollisionReportPool* ppool = s_collisionreportpool.get();
+    if( !ppool ) {
+        ppool = new CollisionReportPool();
+        ppool->vreports.reserve(s_maxPooledCollisionReports);
+        s_collisionreportpool.reset(ppool);
+    }
+    if( ppool->vreports.size() >= s_maxPooledCollisionReports ) {
+        delete preport;
+        return;
+    }
+    preport->nKeepPrevious = 0;
+    preport->nMaxContacts = 0;
+    preport->Reset();
+    ppool->vreports.push_back(preport);
+}
+
+CollisionReportPtr RaveGetPooledCollisionReport()
+{
+    CollisionReport* preport = NULL;
+    CollisionReportPool* ppool = s_collisionreportpool.get();
+    if( !!ppool && ppool->vreports.size() > 0 ) {
+        preport = ppool->vreports.back();
+        ppool->vreports.pop_back();
+    }
+    else {
+        preport = new CollisionReport();
+    }
+    return CollisionReportPtr(preport, ReleasePooledCollisionReport);
+}
+
 std::string CollisionReport::__str__() const
 {
     stringstream s;
@@ -2050,6 +2251,20 @@ AABB TriMesh::ComputeAABB() const
     return ab;
 }
 
+size_t TriMesh::ComputeHash() const
+{
+    size_t hash = 0;
+    FOREACHC(itvertex, vertices) {
+        boost::hash_combine(hash, itvertex->x);
+        boost::hash_combine(hash, itvertex->y);
+        boost::hash_combine(hash, itvertex->z);
+    }
+    FOREACHC(itindex, indices) {
+        boost::hash_combine(hash, *itindex);
+    }
+    return hash;
+}
+
 void TriMesh::serialize(std::ostream& o, int options) const
 {
     o << vertices.size() << " ";
@@ -2063,6 +2278,71 @@ void TriMesh::serialize(std::ostream& o, int options) const
 }
 
 
+/// \brief returns the key of the robot link collision results cached by Grabbed::_ProcessCollidingLinks
+///
+/// The relative pose of the body and the robot configuration are rounded to fresolution. Quaternions q and -q are the same rotation, so the first component is kept positive.
+static std::string _GetGrabbedCollidingLinksCacheKey(RobotBasePtr probot, KinBodyConstPtr pgrabbedbody, KinBody::LinkConstPtr plinkrobot, const std::set<int>& setRobotLinksToIgnore, dReal fresolution)
+{
+    std::stringstream ss;
+    ss << pgrabbedbody->GetKinematicsGeometryHash() << " " << plinkrobot->GetIndex() << " " << setRobotLinksToIgnore.size();
+    FOREACHC(itindex, setRobotLinksToIgnore) {
+        ss << " " << *itindex;
+    }
+    Transform trelative = plinkrobot->GetTransform().inverse() * pgrabbedbody->GetTransform();
+    if( trelative.rot.x < 0 ) {
+        trelative.rot = -trelative.rot;
+    }
+    for(int i = 0; i < 4; ++i) {
+        ss << " " << (int64_t)floor(trelative.rot[i]/fresolution+0.5);
+    }
+    for(int i = 0; i < 3; ++i) {
+        ss << " " << (int64_t)floor(trelative.trans[i]/fresolution+0.5);
+    }
+    std::vector<dReal> vdofvalues;
+    probot->GetDOFValues(vdofvalues);
+    FOREACHC(itvalue, vdofvalues) {
+        ss << " " << (int64_t)floor(*itvalue/fresolution+0.5);
+    }
+    return ss.str();
+}
+
+/// \brief sets vnoncolliding[ilink] to 1 for the links of probot that do not collide with pgrabbedbody. Links with vcheck[ilink] == 0 are not checked and set to 0.
+///
+/// Uses one body query with CO_AllLinkCollisions and only falls back to checking every link when the checker cannot report the colliding link pairs.
+static void _ComputeNonCollidingRobotLinks(CollisionCheckerBasePtr pchecker, RobotBasePtr probot, KinBodyPtr pgrabbedbody, const std::vector<uint8_t>& vcheck, std::vector<uint8_t>& vnoncolliding)
+{
+    const std::vector<KinBody::LinkPtr>& vlinks = probot->GetLinks();
+    vnoncolliding.resize(0);
+    vnoncolliding.resize(vlinks.size(), 0);
+    // checkers ignore attached bodies, so have to check every link in that case
+    if( !probot->IsAttached(pgrabbedbody) ) {
+        CollisionOptionsStateSaver alllinkssaver(pchecker, CO_AllLinkCollisions);
+        CollisionReportPtr report(new CollisionReport());
+        if( !pchecker->CheckCollision(KinBodyConstPtr(probot), KinBodyConstPtr(pgrabbedbody), report) ) {
+            vnoncolliding = vcheck;
+            return;
+        }
+        if( report->vLinkColliding.size() > 0 ) {
+            KinBodyConstPtr pbody = probot;
+            vnoncolliding = vcheck;
+            FOREACHC(itlinkpair, report->vLinkColliding) {
+                if( !!itlinkpair->first && itlinkpair->first->GetParent() == pbody ) {
+                    vnoncolliding.at(itlinkpair->first->GetIndex()) = 0;
+                }
+                if( !!itlinkpair->second && itlinkpair->second->GetParent() == pbody ) {
+                    vnoncolliding.at(itlinkpair->second->GetIndex()) = 0;
+                }
+            }
+            return;
+        }
+    }
+    for(size_t ilink = 0; ilink < vlinks.size(); ++ilink) {
+        if( vcheck[ilink] && !pchecker->CheckCollision(KinBody::LinkConstPtr(vlinks[ilink]), pgrabbedbody) ) {
+            vnoncolliding[ilink] = 1;
+        }
+    }
+}
+
 void Grabbed::_ProcessCollidingLinks(const std::set<int>& setRobotLinksToIgnore)
 {
     _setRobotLinksToIgnore = setRobotLinksToIgnore;
@@ -2085,21 +2365,40 @@ void Grabbed::_ProcessCollidingLinks(const std::set<int>& setRobotLinksToIgnore)
 
         //uint64_t starttime = utils::GetMicroTime();
 
-        // check collision with all links to see which are valid
-        int numchecked = 0;
-        FOREACHC(itlink, probot->GetLinks()) {
-            int noncolliding = 0;
-            if( find(_vattachedlinks.begin(),_vattachedlinks.end(), *itlink) == _vattachedlinks.end() ) {
-                if( setRobotLinksToIgnore.find((*itlink)->GetIndex()) == setRobotLinksToIgnore.end() ) {
-                    ++numchecked;
-                    //uint64_t localstarttime = utils::GetMicroTime();
-                    if( !pchecker->CheckCollision(KinBody::LinkConstPtr(*itlink), pgrabbedbody) ) {
-                        noncolliding = 1;
+        // check collision with all links to see which are valid, the results only depend on the robot and the body since all their links are enabled
+        std::string cachekey;
+        std::vector<uint8_t> vnoncolliding;
+        std::map<std::string, std::vector<uint8_t> >::const_iterator itcache = probot->_mapGrabbedCollidingLinksCache.end();
+        if( probot->_fGrabbedCollidingLinksCacheResolution > 0 ) {
+            if( probot->_pGrabbedCollidingLinksCacheChecker.lock() != pchecker ) {
+                probot->_mapGrabbedCollidingLinksCache.clear();
+                probot->_pGrabbedCollidingLinksCacheChecker = pchecker;
+            }
+            cachekey = _GetGrabbedCollidingLinksCacheKey(probot, pgrabbedbody, _plinkrobot, setRobotLinksToIgnore, probot->_fGrabbedCollidingLinksCacheResolution);
+            itcache = probot->_mapGrabbedCollidingLinksCache.find(cachekey);
+        }
+        if( itcache != probot->_mapGrabbedCollidingLinksCache.end() ) {
+            vnoncolliding = itcache->second;
+        }
+        else {
+            std::vector<uint8_t> vcheck(probot->GetLinks().size(), 0);
+            FOREACHC(itlink, probot->GetLinks()) {
+                if( find(_vattachedlinks.begin(),_vattachedlinks.end(), *itlink) == _vattachedlinks.end() ) {
+                    if( setRobotLinksToIgnore.find((*itlink)->GetIndex()) == setRobotLinksToIgnore.end() ) {
+                        vcheck[(*itlink)->GetIndex()] = 1;
                     }
-                    //RAVELOG_DEBUG_FORMAT("check %s col %s %s %fs", pchecker->GetXMLId()%(*itlink)->GetName()%pgrabbedbody->GetName()%(1e-6*(utils::GetMicroTime()-localstarttime)));
                 }
             }
-            _mapLinkIsNonColliding[*itlink] = noncolliding;
+            _ComputeNonCollidingRobotLinks(pchecker, probot, pgrabbedbody, vcheck, vnoncolliding);
+            if( cachekey.size() > 0 ) {
+                if( probot->_mapGrabbedCollidingLinksCache.size() >= 1024 ) {
+                    probot->_mapGrabbedCollidingLinksCache.clear();
+                }
+                probot->_mapGrabbedCollidingLinksCache[cachekey] = vnoncolliding;
+            }
+        }
+        FOREACHC(itlink, probot->GetLinks()) {
+            _mapLinkIsNonColliding[*itlink] = vnoncolliding.at((*itlink)->GetIndex());
         }
 
         //uint64_t starttime1 = utils::GetMicroTime();
@@ -2233,7 +2532,7 @@ void DummyXMLReader::characters(const std::string& ch)
     }
 }
 
-EnvironmentBase::EnvironmentBase()
+EnvironmentBase::EnvironmentBase() : __nBodyChangeBatchDepth(0)
 {
     if( !RaveGlobalState() ) {
         RAVELOG_WARN("OpenRAVE global state not initialized! Need to call RaveInitialize before any OpenRAVE services can be used. For now, initializing with default parameters.\n");
@@ -2247,6 +2546,302 @@ EnvironmentBase::~EnvironmentBase()
     RaveGlobal::instance()->UnregisterEnvironment(this);
 }
 
+void EnvironmentBase::BeginBodyChangeBatch()
+{
+    ++__nBodyChangeBatchDepth;
+}
+
+void EnvironmentBase::EndBodyChangeBatch()
+{
+    BOOST_ASSERT(__nBodyChangeBatchDepth > 0);
+    if( --__nBodyChangeBatchDepth > 0 ) {
+        return;
+    }
+    // callbacks can change bodies again, which fires their callbacks immediately since the batch is over
+    std::vector< std::pair<KinBodyWeakPtr, uint32_t> > vbodychanges;
+    vbodychanges.swap(__vBodyChangeBatch);
+    __mapBodyChangeBatchIndices.clear();
+    FOREACH(itchange, vbodychanges) {
+        KinBodyPtr pbody = itchange->first.lock();
+        if( !!pbody ) {
+            pbody->_FireChangeCallbacks(itchange->second);
+        }
+    }
+}
+
+void EnvironmentBase::EnableBodies(const std::vector<KinBodyPtr>& vbodies, bool bEnable)
+{
+    EnvironmentBodyChangeBatch batch(shared_from_this());
+    FOREACH(itbody, vbodies) {
+        (*itbody)->Enable(bEnable);
+    }
+}
+
+void EnvironmentBase::SetBodiesLinkEnableStates(const std::vector<KinBodyPtr>& vbodies, const std::vector< std::vector<uint8_t> >& vlinkenablestates)
+{
+    OPENRAVE_ASSERT_OP(vbodies.size(),==,vlinkenablestates.size());
+    EnvironmentBodyChangeBatch batch(shared_from_this());
+    for(size_t ibody = 0; ibody < vbodies.size(); ++ibody) {
+        vbodies[ibody]->SetLinkEnableStates(vlinkenablestates[ibody]);
+    }
+}
+
+bool EnvironmentBase::_QueueBodyChangeCallbacks(KinBodyPtr pbody, uint32_t parameters)
+{
+    if( __nBodyChangeBatchDepth == 0 ) {
+        return false;
+    }
+    std::pair<std::map<KinBody*, size_t>::iterator, bool> itindex = __mapBodyChangeBatchIndices.insert(std::make_pair(pbody.get(), __vBodyChangeBatch.size()));
+    if( itindex.second ) {
+        __vBodyChangeBatch.push_back(std::make_pair(KinBodyWeakPtr(pbody), parameters));
+    }
+    else {
+        std::pair<KinBodyWeakPtr, uint32_t>& change = __vBodyChangeBatch.at(itindex.first->second);
+        if( change.first.lock() != pbody ) {
+            // the address was reused by a new body after the previous one was destroyed
+            change.first = pbody;
+            change.second = 0;
+        }
+        change.second |= parameters;
+    }
+    return true;
+}
+
+/// first bytes of the published bodies delta format, see EnvironmentBase::WritePublishedBodiesDelta
+static const char s_publishedBodiesDeltaMagic[4] = { '\x89', 'O', 'R', 'D' };
+static const uint32_t s_publishedBodiesDeltaVersion = 1;
+
+/// \brief writes the lower numbytes of value in little-endian order
+static void _WriteDeltaUInt(std::ostream& O, uint64_t value, int numbytes)
+{
+    char buf[8];
+    for(int i = 0; i < numbytes; ++i) {
+        buf[i] = static_cast<char>((value>>(8*i))&0xff);
+    }
+    O.write(buf, numbytes);
+}
+
+static uint64_t _ReadDeltaUInt(std::istream& I, int numbytes)
+{
+    unsigned char buf[8];
+    if( !I.read(reinterpret_cast<char*>(buf), numbytes) ) {
+        throw OPENRAVE_EXCEPTION_FORMAT0(_("published bodies delta is truncated"), ORE_InvalidArguments);
+    }
+    uint64_t value = 0;
+    for(int i = 0; i < numbytes; ++i) {
+        value |= static_cast<uint64_t>(buf[i])<<(8*i);
+    }
+    return value;
+}
+
+/// \brief writes the values in little-endian order
+static void _WriteDeltaReals(std::ostream& O, const dReal* pvalues, size_t numvalues)
+{
+    const uint16_t one = 1;
+    bool blittleendian = *reinterpret_cast<const uint8_t*>(&one) == 1;
+    if( blittleendian ) {
+        O.write(reinterpret_cast<const char*>(pvalues), numvalues*sizeof(dReal));
+        return;
+    }
+    char buf[sizeof(dReal)];
+    for(size_t i = 0; i < numvalues; ++i) {
+        const char* pvalue = reinterpret_cast<const char*>(pvalues+i);
+        std::reverse_copy(pvalue, pvalue+sizeof(dReal), buf);
+        O.write(buf, sizeof(dReal));
+    }
+}
+
+static void _ReadDeltaReals(std::istream& I, dReal* pvalues, size_t numvalues)
+{
+    if( numvalues > 0 && !I.read(reinterpret_cast<char*>(pvalues), numvalues*sizeof(dReal)) ) {
+        throw OPENRAVE_EXCEPTION_FORMAT0(_("published bodies delta is truncated"), ORE_InvalidArguments);
+    }
+    const uint16_t one = 1;
+    if( *reinterpret_cast<const uint8_t*>(&one) != 1 ) {
+        for(size_t i = 0; i < numvalues; ++i) {
+            char* pvalue = reinterpret_cast<char*>(pvalues+i);
+            std::reverse(pvalue, pvalue+sizeof(dReal));
+        }
+    }
+}
+
+void EnvironmentBase::_WritePublishedBodiesDelta(std::ostream& O, const std::vector<KinBody::BodyState>& vbodies, uint64_t stamp, uint64_t newstamp)
+{
+    O.write(s_publishedBodiesDeltaMagic, sizeof(s_publishedBodiesDeltaMagic));
+    _WriteDeltaUInt(O, s_publishedBodiesDeltaVersion, 4);
+    _WriteDeltaUInt(O, sizeof(dReal), 4);
+    _WriteDeltaUInt(O, newstamp, 8);
+    _WriteDeltaUInt(O, vbodies.size(), 4);
+    size_t numchanged = 0;
+    FOREACHC(itstate, vbodies) {
+        _WriteDeltaUInt(O, static_cast<uint32_t>(itstate->environmentid), 4);
+        // a stamp newer than the snapshot means that the replica applied a delta of another environment, so send everything
+        if( itstate->publishedstamp > stamp || stamp > newstamp ) {
+            ++numchanged;
+        }
+    }
+    _WriteDeltaUInt(O, numchanged, 4);
+    dReal vlinkvalues[7];
+    FOREACHC(itstate, vbodies) {
+        if( !(itstate->publishedstamp > stamp || stamp > newstamp) ) {
+            continue;
+        }
+        _WriteDeltaUInt(O, static_cast<uint32_t>(itstate->environmentid), 4);
+        _WriteDeltaUInt(O, static_cast<uint32_t>(itstate->updatestamp), 4);
+        _WriteDeltaUInt(O, itstate->strname.size(), 4);
+        O.write(itstate->strname.c_str(), itstate->strname.size());
+        _WriteDeltaUInt(O, itstate->vectrans.size(), 4);
+        FOREACHC(ittrans, itstate->vectrans) {
+            vlinkvalues[0] = ittrans->rot.x; vlinkvalues[1] = ittrans->rot.y; vlinkvalues[2] = ittrans->rot.z; vlinkvalues[3] = ittrans->rot.w;
+            vlinkvalues[4] = ittrans->trans.x; vlinkvalues[5] = ittrans->trans.y; vlinkvalues[6] = ittrans->trans.z;
+            _WriteDeltaReals(O, vlinkvalues, 7);
+        }
+        _WriteDeltaUInt(O, itstate->jointvalues.size(), 4);
+        if( itstate->jointvalues.size() > 0 ) {
+            _WriteDeltaReals(O, &itstate->jointvalues[0], itstate->jointvalues.size());
+        }
+    }
+}
+
+uint64_t EnvironmentBase::ApplyPublishedBodiesDelta(std::istream& I, std::vector<KinBody::BodyState>& vbodies)
+{
+    char magic[sizeof(s_publishedBodiesDeltaMagic)];
+    if( !I.read(magic, sizeof(magic)) || !std::equal(magic, magic+sizeof(magic), s_publishedBodiesDeltaMagic) ) {
+        throw OPENRAVE_EXCEPTION_FORMAT0(_("stream does not start with a published bodies delta"), ORE_InvalidArguments);
+    }
+    uint32_t version = _ReadDeltaUInt(I, 4);
+    if( version != s_publishedBodiesDeltaVersion ) {
+        throw OPENRAVE_EXCEPTION_FORMAT(_("unsupported published bodies delta version %d"), version, ORE_InvalidArguments);
+    }
+    uint32_t realsize = _ReadDeltaUInt(I, 4);
+    if( realsize != sizeof(dReal) ) {
+        throw OPENRAVE_EXCEPTION_FORMAT(_("published bodies delta has %d byte reals, but dReal is %d bytes"), realsize%sizeof(dReal), ORE_InvalidArguments);
+    }
+    uint64_t newstamp = _ReadDeltaUInt(I, 8);
+    std::vector<int> vids(_ReadDeltaUInt(I, 4));
+    FOREACH(itid, vids) {
+        *itid = static_cast<int>(_ReadDeltaUInt(I, 4));
+    }
+
+    // keep the states of the bodies that are still published in the new order
+    std::map<int, size_t> mapidindices;
+    for(size_t i = 0; i < vbodies.size(); ++i) {
+        mapidindices[vbodies[i].environmentid] = i;
+    }
+    std::vector<KinBody::BodyState> vnewbodies(vids.size());
+    std::map<int, size_t> mapnewindices;
+    for(size_t i = 0; i < vids.size(); ++i) {
+        std::map<int, size_t>::iterator it = mapidindices.find(vids[i]);
+        if( it != mapidindices.end() ) {
+            std::swap(vnewbodies[i], vbodies[it->second]);
+        }
+        vnewbodies[i].environmentid = vids[i];
+        mapnewindices[vids[i]] = i;
+    }
+
+    uint32_t numchanged = _ReadDeltaUInt(I, 4);
+    dReal vlinkvalues[7];
+    for(uint32_t ichanged = 0; ichanged < numchanged; ++ichanged) {
+        int environmentid = static_cast<int>(_ReadDeltaUInt(I, 4));
+        std::map<int, size_t>::iterator it = mapnewindices.find(environmentid);
+        if( it == mapnewindices.end() ) {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("published bodies delta changes body %d that is not published"), environmentid, ORE_InvalidArguments);
+        }
+        KinBody::BodyState& state = vnewbodies[it->second];
+        state.updatestamp = static_cast<int>(_ReadDeltaUInt(I, 4));
+        state.strname.resize(_ReadDeltaUInt(I, 4));
+        if( state.strname.size() > 0 && !I.read(&state.strname[0], state.strname.size()) ) {
+            throw OPENRAVE_EXCEPTION_FORMAT0(_("published bodies delta is truncated"), ORE_InvalidArguments);
+        }
+        state.vectrans.resize(_ReadDeltaUInt(I, 4));
+        FOREACH(ittrans, state.vectrans) {
+            _ReadDeltaReals(I, vlinkvalues, 7);
+            ittrans->rot.x = vlinkvalues[0]; ittrans->rot.y = vlinkvalues[1]; ittrans->rot.z = vlinkvalues[2]; ittrans->rot.w = vlinkvalues[3];
+            ittrans->trans.x = vlinkvalues[4]; ittrans->trans.y = vlinkvalues[5]; ittrans->trans.z = vlinkvalues[6];
+        }
+        state.jointvalues.resize(_ReadDeltaUInt(I, 4));
+        if( state.jointvalues.size() > 0 ) {
+            _ReadDeltaReals(I, &state.jointvalues[0], state.jointvalues.size());
+        }
+        state.publishedstamp = newstamp;
+    }
+    vbodies.swap(vnewbodies);
+    return newstamp;
+}
+
+void EnvironmentBase::ComputeBodiesAABB(std::vector<KinBodyPtr>& bodies, std::vector<AABB>& vaabbs, uint64_t timeout) const
+{
+    GetBodies(bodies, timeout);
+    vaabbs.resize(bodies.size());
+    for(size_t i = 0; i < bodies.size(); ++i) {
+        vaabbs[i] = bodies[i]->ComputeAABB();
+    }
+}
+
+bool EnvironmentBase::SendCommand(std::ostream& sout, std::istream& sinput)
+{
+    std::string cmd;
+    sinput >> cmd;
+    if( !sinput ) {
+        return false;
+    }
+    std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
+    if( cmd == "setprofilingenabled" ) {
+        int benabled = 0;
+        sinput >> benabled;
+        if( !sinput ) {
+            return false;
+        }
+        utils::SetProfilingEnabled(!!benabled);
+        return true;
+    }
+    else if( cmd == "resetprofiling" ) {
+        utils::ResetProfiling();
+        return true;
+    }
+    else if( cmd == "getprofilingstatistics" ) {
+        utils::WriteProfilingStatistics(sout);
+        return true;
+    }
+    else if( cmd == "setthreadpoolsize" ) {
+        int numthreads = 0;
+        sinput >> numthreads;
+        if( !sinput ) {
+            return false;
+        }
+        std::vector<int> vcpus;
+        int cpu;
+        while(sinput >> cpu) {
+            vcpus.push_back(cpu);
+        }
+        utils::SetThreadPoolSize(numthreads, vcpus);
+        return true;
+    }
+    else if( cmd == "getthreadpoolsize" ) {
+        sout << utils::GetThreadPoolSize();
+        return true;
+    }
+    else if( cmd == "resetthreadpoolstatistics" ) {
+        utils::ResetThreadPoolStatistics();
+        return true;
+    }
+    else if( cmd == "getthreadpoolstatistics" ) {
+        utils::WriteThreadPoolStatistics(sout);
+        return true;
+    }
+    RAVELOG_WARN_FORMAT("env %d, unknown command '%s'", GetId()%cmd);
+    return false;
+}
+
+
+SensorBase::SensorDataConstPtr SensorBase::GetLatestSensorData(SensorType type)
+{
+    SensorDataPtr pdata = CreateSensorData(type);
+    if( !pdata || !GetSensorData(pdata) ) {
+        return SensorDataConstPtr();
+    }
+    return pdata;
+}
 
 bool SensorBase::SensorData::serialize(std::ostream& O) const
 {
@@ -2371,6 +2966,189 @@ CollisionOptionsStateSaver::~CollisionOptionsStateSaver()
     _p->SetCollisionOptions(_oldoptions);
 }
 
+size_t CollisionCheckerBase::CheckCollisionBatch(KinBodyPtr pbody, const std::vector<int>& dofindices, const dReal* pconfigs, size_t numconfigs, std::vector<uint8_t>& vresults, bool bcheckself)
+{
+    vresults.resize(numconfigs);
+    std::fill(vresults.begin(), vresults.end(), 0);
+    if( numconfigs == 0 ) {
+        return 0;
+    }
+    KinBody::KinBodyStateSaver saver(pbody, KinBody::Save_LinkTransformation);
+    size_t dof = dofindices.size() > 0 ? dofindices.size() : (size_t)pbody->GetDOF();
+    std::vector<dReal> vvalues(dof);
+    size_t numcolliding = 0;
+    for(size_t iconfig = 0; iconfig < numconfigs; ++iconfig) {
+        std::copy(pconfigs+iconfig*dof, pconfigs+(iconfig+1)*dof, vvalues.begin());
+        pbody->SetDOFValues(vvalues, KinBody::CLA_Nothing, dofindices);
+        if( CheckCollision(KinBodyConstPtr(pbody)) || (bcheckself && CheckStandaloneSelfCollision(KinBodyConstPtr(pbody))) ) {
+            vresults[iconfig] = 1;
+            ++numcolliding;
+        }
+    }
+    return numcolliding;
+}
+
+size_t CollisionCheckerBase::CheckCollisionRays(const std::vector<RAY>& rays, std::vector<dReal>& vdistances, std::vector<KinBody::LinkConstPtr>& vhitlinks)
+{
+    vdistances.resize(rays.size());
+    vhitlinks.resize(rays.size());
+    CollisionReportPtr report = RaveGetPooledCollisionReport();
+    size_t numhits = 0;
+    for(size_t i = 0; i < rays.size(); ++i) {
+        if( CheckCollision(rays[i], report) ) {
+            vdistances[i] = report->minDistance;
+            vhitlinks[i] = !!report->plink1 ? report->plink1 : report->plink2;
+            ++numhits;
+        }
+        else {
+            vdistances[i] = -1;
+            vhitlinks[i].reset();
+        }
+    }
+    return numhits;
+}
+
+bool CollisionCheckerBase::ComputeDistance(KinBodyConstPtr pbody1, KinBodyConstPtr pbody2, DistanceReport& report)
+{
+    CollisionOptionsStateSaver optionsaver(shared_collisionchecker(), GetCollisionOptions(), false); // restores the options when returning
+    if( !SetCollisionOptions(GetCollisionOptions()|CO_Distance) ) {
+        return false;
+    }
+    CollisionReportPtr preport = RaveGetPooledCollisionReport();
+    CheckCollision(pbody1, pbody2, preport);
+    report.Reset();
+    report.distance = preport->minDistance;
+    report.plink1 = preport->plink1;
+    report.plink2 = preport->plink2;
+    return true;
+}
+
+bool CollisionCheckerBase::ComputeDistance(KinBodyConstPtr pbody, DistanceReport& report)
+{
+    CollisionOptionsStateSaver optionsaver(shared_collisionchecker(), GetCollisionOptions(), false); // restores the options when returning
+    if( !SetCollisionOptions(GetCollisionOptions()|CO_Distance) ) {
+        return false;
+    }
+    CollisionReportPtr preport = RaveGetPooledCollisionReport();
+    CheckCollision(pbody, preport);
+    report.Reset();
+    report.distance = preport->minDistance;
+    report.plink1 = preport->plink1;
+    report.plink2 = preport->plink2;
+    return true;
+}
+
+bool CollisionCheckerBase::CheckContinuousCollision(KinBodyPtr pbody, const std::vector<int>& dofindices, const std::vector<dReal>& vstart, const std::vector<dReal>& vend, dReal& fcollisiontime, dReal fdistancetolerance)
+{
+    size_t numdofs = dofindices.size() > 0 ? dofindices.size() : (size_t)pbody->GetDOF();
+    OPENRAVE_ASSERT_OP(vstart.size(),==,numdofs);
+    OPENRAVE_ASSERT_OP(vend.size(),==,numdofs);
+    OPENRAVE_ASSERT_OP(fdistancetolerance,>,0);
+    FOREACHC(itjoint, pbody->GetPassiveJoints()) {
+        if( (*itjoint)->IsMimic() ) {
+            throw OPENRAVE_EXCEPTION_FORMAT("body %s has mimic joints, continuous collision is not supported", pbody->GetName(), ORE_NotImplemented);
+        }
+    }
+
+    KinBody::KinBodyStateSaver saver(pbody, KinBody::Save_LinkTransformation);
+    pbody->SetDOFValues(vstart, KinBody::CLA_Nothing, dofindices);
+
+    // the geometry carried by every link, grabbed bodies move with their grabbing link
+    std::vector< std::pair<int, AABB> > vlinkaabbs;
+    FOREACHC(itlink, pbody->GetLinks()) {
+        if( (*itlink)->GetGeometries().size() > 0 ) {
+            vlinkaabbs.push_back(std::make_pair((*itlink)->GetIndex(), (*itlink)->ComputeAABB()));
+        }
+    }
+    if( pbody->IsRobot() ) {
+        RobotBasePtr probot = RaveInterfaceCast<RobotBase>(pbody);
+        std::vector<KinBodyPtr> vgrabbed;
+        probot->GetGrabbed(vgrabbed);
+        FOREACHC(itgrabbed, vgrabbed) {
+            KinBody::LinkPtr pgrabbinglink = probot->IsGrabbing(*itgrabbed);
+            if( !!pgrabbinglink ) {
+                vlinkaabbs.push_back(std::make_pair(pgrabbinglink->GetIndex(), (*itgrabbed)->ComputeAABB()));
+            }
+        }
+    }
+
+    // bound how far any point of the body can travel when the path parameter advances by one
+    std::vector<dReal> vlower, vupper;
+    std::vector<KinBody::JointPtr> vchainjoints;
+    dReal fmotionbound = 0;
+    for(size_t idof = 0; idof < numdofs; ++idof) {
+        dReal fdelta = RaveFabs(vend[idof] - vstart[idof]);
+        if( fdelta <= 0 ) {
+            continue;
+        }
+        int dofindex = dofindices.size() > 0 ? dofindices[idof] : (int)idof;
+        KinBody::JointPtr pjoint = pbody->GetJointFromDOFIndex(dofindex);
+        int iaxis = dofindex - pjoint->GetDOFIndex();
+        if( !pjoint->IsRevolute(iaxis) ) {
+            fmotionbound += fdelta;
+            continue;
+        }
+        // the distance from the anchor to any moved point is bounded by the rigid distances between the anchors along the chain plus the travel of the prismatic joints in between
+        Vector vanchor = pjoint->GetAnchor();
+        int childindex = pjoint->GetHierarchyChildLink()->GetIndex();
+        dReal fradius = 0;
+        FOREACHC(itlinkaabb, vlinkaabbs) {
+            if( !pbody->DoesAffect(pjoint->GetJointIndex(), itlinkaabb->first) ) {
+                continue;
+            }
+            dReal flinkradius = 0;
+            Vector vprevanchor = vanchor;
+            if( itlinkaabb->first != childindex && pbody->GetChain(childindex, itlinkaabb->first, vchainjoints) ) {
+                FOREACHC(itchainjoint, vchainjoints) {
+                    Vector vchainanchor = (*itchainjoint)->GetAnchor();
+                    flinkradius += RaveSqrt((vchainanchor-vprevanchor).lengthsqr3());
+                    vprevanchor = vchainanchor;
+                    for(int ichainaxis = 0; ichainaxis < (*itchainjoint)->GetDOF(); ++ichainaxis) {
+                        if( (*itchainjoint)->IsPrismatic(ichainaxis) ) {
+                            // travel of the moving prismatic DOFs is known, the rest is bounded by the joint limits
+                            int chaindofindex = (*itchainjoint)->GetDOFIndex() >= 0 ? (*itchainjoint)->GetDOFIndex()+ichainaxis : -1;
+                            std::vector<int>::const_iterator itfound = dofindices.size() > 0 ? find(dofindices.begin(), dofindices.end(), chaindofindex) : dofindices.end();
+                            if( chaindofindex >= 0 && (dofindices.size() == 0 || itfound != dofindices.end()) ) {
+                                size_t ichaindof = dofindices.size() > 0 ? (size_t)(itfound-dofindices.begin()) : (size_t)chaindofindex;
+                                flinkradius += RaveFabs(vend[ichaindof] - vstart[ichaindof]);
+                            }
+                            else if( chaindofindex < 0 ) {
+                                (*itchainjoint)->GetLimits(vlower, vupper);
+                                flinkradius += vupper.at(ichainaxis) - vlower.at(ichainaxis);
+                            }
+                        }
+                    }
+                }
+            }
+            flinkradius += RaveSqrt((itlinkaabb->second.pos-vprevanchor).lengthsqr3()) + RaveSqrt(itlinkaabb->second.extents.lengthsqr3());
+            fradius = max(fradius, flinkradius);
+        }
+        fmotionbound += fdelta*fradius;
+    }
+
+    DistanceReport report;
+    std::vector<dReal> vvalues(numdofs);
+    dReal t = 0;
+    for(;;) {
+        if( !ComputeDistance(pbody, report) ) {
+            throw OPENRAVE_EXCEPTION_FORMAT("collision checker %s does not support distance queries", GetXMLId(), ORE_NotImplemented);
+        }
+        if( report.distance <= fdistancetolerance ) {
+            fcollisiontime = t;
+            return true;
+        }
+        if( t >= 1 || fmotionbound <= 0 ) {
+            return false;
+        }
+        // no point can reach the environment before the distance is covered at the maximum speed
+        t = min(dReal(1), t + report.distance/fmotionbound);
+        for(size_t idof = 0; idof < numdofs; ++idof) {
+            vvalues[idof] = vstart[idof] + t*(vend[idof]-vstart[idof]);
+        }
+        pbody->SetDOFValues(vvalues, KinBody::CLA_Nothing, dofindices);
+    }
+}
+
 void RaveInitRandomGeneration(uint32_t seed)
 {
     RaveGlobal::instance()->GetDefaultSampler()->SetSeed(seed);
@@ -383,6 +383,47 @@ bool ORCBodyInitFromTrimesh(void* body, void* trimesh, bool visible)
     return GetBody(body)->InitFromTrimesh(*ptrimesh,visible);
 }
 
+int ORCBodyCheckCollisionBatch(void* body, const dReal* configurations, int numconfigurations, int checkself, int* collisions)
+{
+    KinBodyPtr pbody = GetBody(body);
+    EnvironmentBasePtr penv = pbody->GetEnv();
+    EnvironmentMutex::scoped_lock lock(penv->GetMutex());
+    KinBody::KinBodyStateSaver saver(pbody);
+    const int dof = pbody->GetDOF();
+    int numcollisions = 0;
+    for(int i = 0; i < numconfigurations; ++i) {
+        pbody->SetDOFValues(configurations+i*dof, dof);
+        bool bCollision = penv->CheckCollision(KinBodyConstPtr(pbody)) || (checkself && pbody->CheckSelfCollision());
+        collisions[i] = bCollision;
+        if( bCollision ) {
+            ++numcollisions;
+        }
+    }
+    return numcollisions;
+}
+
+void ORCBodyGetLinkTransformsBatch(void* body, const dReal* configurations, int numconfigurations, dReal* poses)
+{
+    KinBodyPtr pbody = GetBody(body);
+    EnvironmentMutex::scoped_lock lock(pbody->GetEnv()->GetMutex());
+    KinBody::KinBodyStateSaver saver(pbody);
+    const int dof = pbody->GetDOF();
+    const std::vector<KinBody::LinkPtr>& vlinks = pbody->GetLinks();
+    for(int i = 0; i < numconfigurations; ++i) {
+        pbody->SetDOFValues(configurations+i*dof, dof);
+        FOREACHC(itlink, vlinks) {
+            Transform t = (*itlink)->GetTransform();
+            for(int j = 0; j < 4; ++j) {
+                poses[j] = t.rot[j];
+            }
+            for(int j = 0; j < 3; ++j) {
+                poses[4+j] = t.trans[j];
+            }
+            poses += 7;
+        }
+    }
+}
+
 int ORCBodyLinkGetGeometries(void* link, void** geometries)
 {
     KinBody::LinkPtr plink = GetBodyLink(link);
@@ -411,6 +452,37 @@ const char* ORCRobotGetName(void* robot)
     return GetRobot(robot)->GetName().c_str();
 }
 
+int ORCRobotFindIKSolutionsBatch(void* robot, const char* manipname, const dReal* poses, int numposes, int filteroptions, dReal* solutions, int* success)
+{
+    RobotBasePtr probot = GetRobot(robot);
+    EnvironmentMutex::scoped_lock lock(probot->GetEnv()->GetMutex());
+    RobotBase::ManipulatorPtr pmanip = (!manipname || manipname[0] == 0) ? probot->GetActiveManipulator() : probot->GetManipulator(manipname);
+    if( !pmanip ) {
+        return -1;
+    }
+    RobotBase::RobotStateSaver saver(probot);
+    const int armdof = pmanip->GetArmDOF();
+    std::vector<dReal> vsolution;
+    int numsolutions = 0;
+    for(int i = 0; i < numposes; ++i) {
+        const dReal* pose = poses+7*i;
+        Transform t;
+        for(int j = 0; j < 4; ++j) {
+            t.rot[j] = pose[j];
+        }
+        for(int j = 0; j < 3; ++j) {
+            t.trans[j] = pose[4+j];
+        }
+        t.rot.normalize4();
+        success[i] = pmanip->FindIKSolution(IkParameterization(t), vsolution, filteroptions);
+        if( success[i] ) {
+            std::copy(vsolution.begin(), vsolution.begin()+armdof, solutions+i*armdof);
+            ++numsolutions;
+        }
+    }
+    return numsolutions;
+}
+
 void* ORCModuleCreate(void* env, const char* modulename)
 {
     ModuleBasePtr module = RaveCreateModule(GetEnvironment(env), modulename);
@@ -17,6 +17,7 @@
 #include "libopenrave.h"
 
 #include <openrave/planningutils.h>
+#include <boost/thread/condition.hpp>
 
 namespace OpenRAVE {
 
@@ -144,6 +145,7 @@ PlannerBase::PlannerParameters& PlannerBase::PlannerParameters::operator=(const
     _costfn = r._costfn;
     _goalfn = r._goalfn;
     _distmetricfn = r._distmetricfn;
+    _distmetricbatchfn = r._distmetricbatchfn;
     _checkpathconstraintsfn = r._checkpathconstraintsfn;
     _checkpathvelocityconstraintsfn = r._checkpathvelocityconstraintsfn;
     _samplefn = r._samplefn;
@@ -155,31 +157,48 @@ PlannerBase::PlannerParameters& PlannerBase::PlannerParameters::operator=(const
     _getstatefn = r._getstatefn;
     _diffstatefn = r._diffstatefn;
     _neighstatefn = r._neighstatefn;
+    const planningutils::ActiveDOFNeighStateFn* pneighstatefn = r._neighstatefn.target<planningutils::ActiveDOFNeighStateFn>();
+    if( !!pneighstatefn && pneighstatefn->_pvlowerlimit == &r._vConfigLowerLimit && pneighstatefn->_pvupperlimit == &r._vConfigUpperLimit ) {
+        // clamp to the limits of this copy so that planners can still use GetActiveDOFStateSpace
+        _neighstatefn = planningutils::ActiveDOFNeighStateFn(pneighstatefn->_statespace, _vConfigLowerLimit, _vConfigUpperLimit);
+    }
     _listInternalSamplers = r._listInternalSamplers;
+    _parena = r._parena;
+
+    if( this == &r ) {
+        return *this;
+    }
 
-    vinitialconfig.resize(0);
-    _vInitialConfigVelocities.resize(0);
-    _vGoalConfigVelocities.resize(0);
-    vgoalconfig.resize(0);
-    _configurationspecification = ConfigurationSpecification();
-    _vConfigLowerLimit.resize(0);
-    _vConfigUpperLimit.resize(0);
-    _vConfigResolution.resize(0);
-    _vConfigVelocityLimit.resize(0);
-    _vConfigAccelerationLimit.resize(0);
-    _sPostProcessingPlanner = "";
-    _sPostProcessingParameters.resize(0);
+    // the base data is copied directly, only the data of derived parameters and the extra parameters have to go through xml
+    _configurationspecification = r._configurationspecification;
+    vinitialconfig = r.vinitialconfig;
+    _vInitialConfigVelocities = r._vInitialConfigVelocities;
+    vgoalconfig = r.vgoalconfig;
+    _vGoalConfigVelocities = r._vGoalConfigVelocities;
+    _vConfigLowerLimit = r._vConfigLowerLimit;
+    _vConfigUpperLimit = r._vConfigUpperLimit;
+    _vConfigResolution = r._vConfigResolution;
+    _vConfigVelocityLimit = r._vConfigVelocityLimit;
+    _vConfigAccelerationLimit = r._vConfigAccelerationLimit;
+    _sPostProcessingPlanner = r._sPostProcessingPlanner;
+    _sPostProcessingParameters = r._sPostProcessingParameters;
+    _nMaxIterations = r._nMaxIterations;
+    _nMaxPlanningTime = r._nMaxPlanningTime;
+    _fStepLength = r._fStepLength;
+    _nRandomGeneratorSeed = r._nRandomGeneratorSeed;
     _sExtraParameters.resize(0);
-    _nMaxIterations = 0;
-    _nMaxPlanningTime = 0;
-    _fStepLength = 0.04f;
-    _nRandomGeneratorSeed = 0;
     _plannerparametersdepth = 0;
 
+    if( typeid(r) == typeid(PlannerParameters) && r._sExtraParameters.size() == 0 ) {
+        return *this;
+    }
+
     // transfer data
     std::stringstream ss;
     ss << std::setprecision(std::numeric_limits<dReal>::digits10+1); /// have to do this or otherwise precision gets lost and planners' initial conditions can vioalte constraints
-    ss << r;
+    ss << "<" << GetXMLId() << ">" << endl;
+    r.serialize(ss, 2);
+    ss << "</" << GetXMLId() << ">" << endl;
     ss >> *this;
     return *this;
 }
@@ -204,6 +223,12 @@ int PlannerBase::PlannerParameters::SetStateValues(const std::vector<dReal>& val
 
 bool PlannerBase::PlannerParameters::serialize(std::ostream& O, int options) const
 {
+    if( options & 2 ) {
+        if( !(options & 1) ) {
+            O << _sExtraParameters << endl;
+        }
+        return !!O;
+    }
     O << _configurationspecification << endl;
     O << "<_vinitialconfig>";
     FOREACHC(it, vinitialconfig) {
@@ -442,8 +467,19 @@ void PlannerBase::PlannerParameters::SetRobotActiveJoints(RobotBasePtr robot)
     }
 
     using namespace planningutils;
-    _distmetricfn = boost::bind(&SimpleDistanceMetric::Eval,boost::shared_ptr<SimpleDistanceMetric>(new SimpleDistanceMetric(robot)),_1,_2);
-    _diffstatefn = boost::bind(&RobotBase::SubtractActiveDOFValues,robot,_1,_2);
+    // without affine dofs, use the state space that planners can detect with GetActiveDOFStateSpace and call directly
+    ActiveDOFStateSpacePtr statespace;
+    if( robot->GetAffineDOF() == 0 ) {
+        statespace.reset(new ActiveDOFStateSpace(robot));
+        _distmetricfn = ActiveDOFDistanceMetricFn(statespace);
+        _distmetricbatchfn = boost::bind(&ActiveDOFStateSpace::ComputeDistances,statespace,_1,_2,_3);
+        _diffstatefn = ActiveDOFDiffStateFn(statespace);
+    }
+    else {
+        _distmetricfn = boost::bind(&SimpleDistanceMetric::Eval,boost::shared_ptr<SimpleDistanceMetric>(new SimpleDistanceMetric(robot)),_1,_2);
+        _distmetricbatchfn.clear();
+        _diffstatefn = boost::bind(&RobotBase::SubtractActiveDOFValues,robot,_1,_2);
+    }
     SpaceSamplerBasePtr pconfigsampler = RaveCreateSpaceSampler(robot->GetEnv(),str(boost::format("robotconfiguration %s")%robot->GetName()));
     _listInternalSamplers.clear();
     _listInternalSamplers.push_back(pconfigsampler);
@@ -451,7 +487,8 @@ void PlannerBase::PlannerParameters::SetRobotActiveJoints(RobotBasePtr robot)
     _samplefn = boost::bind(&SimpleNeighborhoodSampler::Sample,defaultsamplefn,_1);
     _sampleneighfn = boost::bind(&SimpleNeighborhoodSampler::Sample,defaultsamplefn,_1,_2,_3);
     _setstatevaluesfn = boost::bind(SetActiveDOFValuesParameters,robot, _1, _2);
-    _getstatefn = boost::bind(&RobotBase::GetActiveDOFValues,robot,_1);
+    void (RobotBase::*getactivedofvaluesptr)(std::vector<dReal>&) const = &RobotBase::GetActiveDOFValues;
+    _getstatefn = boost::bind(getactivedofvaluesptr,robot,_1);
 
     robot->GetActiveDOFLimits(_vConfigLowerLimit,_vConfigUpperLimit);
     robot->GetActiveDOFVelocityLimits(_vConfigVelocityLimit);
@@ -461,7 +498,12 @@ void PlannerBase::PlannerParameters::SetRobotActiveJoints(RobotBasePtr robot)
     robot->GetActiveDOFVelocities(_vInitialConfigVelocities); // necessary?
     _configurationspecification = robot->GetActiveConfigurationSpecification();
 
-    _neighstatefn = boost::bind(AddStatesWithLimitCheck, _1, _2, _3, boost::ref(_vConfigLowerLimit), boost::ref(_vConfigUpperLimit)); // probably ok... do we need to clamp limits?
+    if( !!statespace ) {
+        _neighstatefn = ActiveDOFNeighStateFn(statespace, _vConfigLowerLimit, _vConfigUpperLimit);
+    }
+    else {
+        _neighstatefn = boost::bind(AddStatesWithLimitCheck, _1, _2, _3, boost::ref(_vConfigLowerLimit), boost::ref(_vConfigUpperLimit)); // probably ok... do we need to clamp limits?
+    }
 
     // have to do this last, disable timed constraints for default
     std::list<KinBodyPtr> listCheckCollisions; listCheckCollisions.push_back(robot);
@@ -719,7 +761,8 @@ void PlannerBase::PlannerParameters::SetConfigurationSpecification(EnvironmentBa
             sampleneighfns[isavegroup].second = g.dof;
             setstatevaluesfns[isavegroup].first = boost::bind(SetDOFValuesIndicesParameters, pbody, _1, dofindices, _2);
             setstatevaluesfns[isavegroup].second = g.dof;
-            getstatefns[isavegroup].first = boost::bind(&KinBody::GetDOFValues, pbody, _1, dofindices);
+            void (KinBody::*getdofvaluesptr)(std::vector<dReal>&, const std::vector<int>&) const = &KinBody::GetDOFValues;
+            getstatefns[isavegroup].first = boost::bind(getdofvaluesptr, pbody, _1, dofindices);
             getstatefns[isavegroup].second = g.dof;
             neighstatefns[isavegroup].second = g.dof;
             pbody->GetDOFLimits(v0,v1,dofindices);
@@ -750,6 +793,7 @@ void PlannerBase::PlannerParameters::SetConfigurationSpecification(EnvironmentBa
     }
     _diffstatefn = boost::bind(_CallDiffStateFns,diffstatefns, spec.GetDOF(), nMaxDOFForGroup, _1, _2);
     _distmetricfn = boost::bind(_CallDistMetricFns,distmetricfns, spec.GetDOF(), nMaxDOFForGroup, _1, _2);
+    _distmetricbatchfn.clear();
     _samplefn = boost::bind(_CallSampleFns,samplefns, spec.GetDOF(), nMaxDOFForGroup, _1);
     _sampleneighfn = boost::bind(_CallSampleNeighFns,sampleneighfns, distmetricfns, spec.GetDOF(), nMaxDOFForGroup, _1, _2, _3);
     _setstatevaluesfn = boost::bind(CallSetStateValuesFns,setstatevaluesfns, spec.GetDOF(), nMaxDOFForGroup, _1, _2);
@@ -880,6 +924,154 @@ UserDataPtr PlannerBase::RegisterPlanCallback(const PlanCallbackFn& callbackfn)
     return pdata;
 }
 
+class PlannerBase::PlanPathHandleState
+{
+public:
+    PlanPathHandleState(const PlanCallbackFn& progressfn, uint32_t timeout) : _progressfn(progressfn), _deadline(0), _status(PS_Failed), _bDone(false), _bCancelled(false), _bAnySolution(false), _bError(false), _errorcode(ORE_Failed), _numprogress(0) {
+        if( timeout > 0 ) {
+            _deadline = utils::GetMicroTime() + 1000*(uint64_t)timeout;
+        }
+    }
+
+    /// \brief registered as the last plan callback of the planner
+    PlannerAction OnProgress(const PlannerProgress& progress)
+    {
+        {
+            boost::mutex::scoped_lock lock(_mutex);
+            _progress = progress;
+            _numprogress++;
+            if( !_bCancelled && _deadline > 0 && utils::GetMicroTime() > _deadline ) {
+                _bCancelled = true;
+            }
+            if( _bCancelled ) {
+                return PA_Interrupt;
+            }
+            if( _bAnySolution ) {
+                return PA_ReturnWithAnySolution;
+            }
+        }
+        if( !!_progressfn ) {
+            return _progressfn(progress);
+        }
+        return PA_None;
+    }
+
+    void Run(PlannerBasePtr planner, TrajectoryBasePtr ptraj)
+    {
+        PlannerStatus status = PS_Failed;
+        bool berror = false;
+        std::string errormessage;
+        OpenRAVEErrorCode errorcode = ORE_Failed;
+        try {
+            EnvironmentMutex::scoped_lock lock(planner->GetEnv()->GetMutex());
+            UserDataPtr callbackhandle = planner->RegisterPlanCallback(boost::bind(&PlanPathHandleState::OnProgress, this, _1));
+            utils::ProfileZone profilezone("PlannerBase::PlanPath");
+            status = planner->PlanPath(ptraj);
+        }
+        catch(const openrave_exception& ex) {
+            berror = true;
+            errormessage = ex.message();
+            errorcode = ex.GetCode();
+        }
+        catch(const std::exception& ex) {
+            berror = true;
+            errormessage = ex.what();
+        }
+        boost::mutex::scoped_lock lock(_mutex);
+        _status = status;
+        _bError = berror;
+        _errormessage = errormessage;
+        _errorcode = errorcode;
+        _bDone = true;
+        _condDone.notify_all();
+    }
+
+    PlanCallbackFn _progressfn;
+    uint64_t _deadline; ///< in microseconds, 0 if there is no timeout
+    mutable boost::mutex _mutex;
+    boost::condition _condDone;
+    PlannerStatus _status;
+    bool _bDone, _bCancelled, _bAnySolution;
+    bool _bError;
+    std::string _errormessage;
+    OpenRAVEErrorCode _errorcode;
+    PlannerProgress _progress;
+    int _numprogress;
+};
+
+PlannerBase::PlanPathHandle::PlanPathHandle(boost::shared_ptr<PlanPathHandleState> state, boost::shared_ptr<utils::ThreadPoolTaskGroup> group) : _state(state), _group(group)
+{
+}
+
+PlannerBase::PlanPathHandle::~PlanPathHandle()
+{
+    Cancel();
+    _group.reset(); // waits for PlanPath to return
+}
+
+PlannerStatus PlannerBase::PlanPathHandle::Wait()
+{
+    _group->Wait();
+    boost::mutex::scoped_lock lock(_state->_mutex);
+    if( _state->_bError ) {
+        throw openrave_exception(_state->_errormessage, _state->_errorcode);
+    }
+    return _state->_status;
+}
+
+bool PlannerBase::PlanPathHandle::WaitFor(uint32_t timeout)
+{
+    boost::mutex::scoped_lock lock(_state->_mutex);
+    if( !_state->_bDone ) {
+        _state->_condDone.timed_wait(lock, boost::posix_time::milliseconds(timeout));
+    }
+    return _state->_bDone;
+}
+
+bool PlannerBase::PlanPathHandle::IsDone() const
+{
+    boost::mutex::scoped_lock lock(_state->_mutex);
+    return _state->_bDone;
+}
+
+void PlannerBase::PlanPathHandle::Cancel()
+{
+    boost::mutex::scoped_lock lock(_state->_mutex);
+    _state->_bCancelled = true;
+}
+
+void PlannerBase::PlanPathHandle::RequestAnySolution()
+{
+    boost::mutex::scoped_lock lock(_state->_mutex);
+    _state->_bAnySolution = true;
+}
+
+bool PlannerBase::PlanPathHandle::IsCancelled() const
+{
+    boost::mutex::scoped_lock lock(_state->_mutex);
+    return _state->_bCancelled || (_state->_deadline > 0 && utils::GetMicroTime() > _state->_deadline);
+}
+
+PlannerBase::PlannerProgress PlannerBase::PlanPathHandle::GetProgress() const
+{
+    boost::mutex::scoped_lock lock(_state->_mutex);
+    return _state->_progress;
+}
+
+int PlannerBase::PlanPathHandle::GetNumProgressUpdates() const
+{
+    boost::mutex::scoped_lock lock(_state->_mutex);
+    return _state->_numprogress;
+}
+
+PlannerBase::PlanPathHandlePtr PlannerBase::PlanPathAsync(TrajectoryBasePtr ptraj, const PlanCallbackFn& progressfn, uint32_t timeout)
+{
+    boost::shared_ptr<PlanPathHandleState> state(new PlanPathHandleState(progressfn, timeout));
+    boost::shared_ptr<utils::ThreadPoolTaskGroup> group(new utils::ThreadPoolTaskGroup("PlanPathAsync"));
+    group->Submit(boost::bind(&PlanPathHandleState::Run, state, shared_planner(), ptraj));
+    return PlanPathHandlePtr(new PlanPathHandle(state, group));
+}
+
 PlannerStatus PlannerBase::_ProcessPostPlanners(RobotBasePtr probot, TrajectoryBasePtr ptraj)
 {
     if( GetParameters()->_sPostProcessingPlanner.size() == 0 ) {
@@ -913,6 +1105,7 @@ PlannerStatus PlannerBase::_ProcessPostPlanners(RobotBasePtr probot, TrajectoryB
     params->_nMaxIterations = 0; // have to reset since path optimizers also use it and new parameters could be in extra parameters
     //params->_nMaxPlanningTime = 0; // have to reset since path optimizers also use it and new parameters could be in extra parameters??
     if( __cachePostProcessPlanner->InitPlan(probot, params) ) {
+        utils::ProfileZone profilezone("PlannerBase::PlanPath");
         return __cachePostProcessPlanner->PlanPath(ptraj);
     }
 
@@ -18,6 +18,7 @@
 #include <boost/lexical_cast.hpp>
 #include <openrave/planningutils.h>
 #include <openrave/plannerparameters.h>
+#include "parallelrangeworkers.h"
 
 //#include <boost/iostreams/device/file_descriptor.hpp>
 //#include <boost/iostreams/stream.hpp>
@@ -390,10 +391,42 @@ int JitterCurrentConfiguration(PlannerBase::PlannerParametersConstPtr parameters
     return 0;
 }
 
+/// \brief the shared state of the threads of VerifyTrajectoryIntervals
+struct TrajectoryVerificationState
+{
+    TrajectoryVerificationState(bool bstopatfirst) : _bStopAtFirst(bstopatfirst), _bCancelled(false) {
+    }
+
+    /// \brief records an invalid interval and cancels the other threads if only the first one is needed
+    void AddInvalidInterval(dReal starttime, dReal endtime, const std::string& message)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        InvalidTrajectoryInterval interval;
+        interval.starttime = starttime;
+        interval.endtime = endtime;
+        interval.message = message;
+        _vinvalidintervals.push_back(interval);
+        if( _bStopAtFirst ) {
+            _bCancelled = true;
+        }
+    }
+
+    bool IsCancelled()
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _bCancelled;
+    }
+
+    std::vector<InvalidTrajectoryInterval> _vinvalidintervals;
+    bool _bStopAtFirst;
+    bool _bCancelled;
+    boost::mutex _mutex;
+};
+
 class TrajectoryVerifier
 {
 public:
-    TrajectoryVerifier(PlannerBase::PlannerParametersConstPtr parameters) : _parameters(parameters) {
+    TrajectoryVerifier(PlannerBase::PlannerParametersConstPtr parameters) : _parameters(parameters), _bDumpTrajectory(true) {
         VerifyParameters();
     }
 
@@ -407,144 +440,88 @@ public:
     void VerifyTrajectory(TrajectoryBaseConstPtr trajectory, dReal samplingstep)
     {
         OPENRAVE_ASSERT_FORMAT0(!!trajectory,"need valid trajectory",ORE_InvalidArguments);
-
-        ConfigurationSpecification velspec =  _parameters->_configurationspecification.ConvertToVelocitySpecification();
-
-        dReal fresolutionmean = 0;
-        FOREACHC(it,_parameters->_vConfigResolution) {
-            fresolutionmean += *it;
-        }
-        fresolutionmean /= _parameters->_vConfigResolution.size();
-
-        dReal fthresh = 5e-5f;
-        vector<dReal> deltaq(_parameters->GetDOF(),0);
-        std::vector<dReal> vdata, vdatavel, vdiff;
+        _InitVerification();
         for(size_t ipoint = 0; ipoint < trajectory->GetNumWaypoints(); ++ipoint) {
-            trajectory->GetWaypoint(ipoint,vdata,_parameters->_configurationspecification);
-            trajectory->GetWaypoint(ipoint,vdatavel,velspec);
-            BOOST_ASSERT((int)vdata.size()==_parameters->GetDOF());
-            BOOST_ASSERT((int)vdatavel.size()==_parameters->GetDOF());
-            for(size_t i = 0; i < vdata.size(); ++i) {
-                if( !(vdata[i] >= _parameters->_vConfigLowerLimit[i]-fthresh) || !(vdata[i] <= _parameters->_vConfigUpperLimit[i]+fthresh) ) {
-                    throw OPENRAVE_EXCEPTION_FORMAT(_("limits exceeded configuration %d dof %d: %f in [%f,%f]"), ipoint%i%vdata[i]%_parameters->_vConfigLowerLimit[i]%_parameters->_vConfigUpperLimit[i], ORE_InconsistentConstraints);
-                }
-            }
-            for(size_t i = 0; i < _parameters->_vConfigVelocityLimit.size(); ++i) {
-                if( !(RaveFabs(vdatavel.at(i)) <= _parameters->_vConfigVelocityLimit[i]+fthresh) ) { // !(x<=y) necessary for catching NaNs
-                    throw OPENRAVE_EXCEPTION_FORMAT(_("velocity exceeded configuration %d dof %d: %f>%f"), ipoint%i%RaveFabs(vdatavel.at(i))%_parameters->_vConfigVelocityLimit[i], ORE_InconsistentConstraints);
-                }
-            }
-            if( _parameters->SetStateValues(vdata, 0) != 0 ) {
-                throw OPENRAVE_EXCEPTION_FORMAT0(_("failed to set state values"), ORE_InconsistentConstraints);
-            }
-            vector<dReal> newq;
-            _parameters->_getstatefn(newq);
-            BOOST_ASSERT(vdata.size() == newq.size());
-            vdiff = newq;
-            _parameters->_diffstatefn(vdiff,vdata);
-            for(size_t i = 0; i < vdiff.size(); ++i) {
-                if( !(RaveFabs(vdiff.at(i)) <= 0.001 * _parameters->_vConfigResolution[i]) ) {
-                    throw OPENRAVE_EXCEPTION_FORMAT(_("setstate/getstate inconsistent configuration %d dof %d: %f != %f, wrote trajectory to %s"),ipoint%i%vdata.at(i)%newq.at(i)%DumpTrajectory(trajectory),ORE_InconsistentConstraints);
-                }
-            }
-            if( !!_parameters->_neighstatefn ) {
-                newq = vdata;
-                if( !_parameters->_neighstatefn(newq,vdiff,NSO_OnlyHardConstraints) ) {
-                    throw OPENRAVE_EXCEPTION_FORMAT(_("neighstatefn is rejecting configuration %d, wrote trajectory %s"),ipoint%DumpTrajectory(trajectory),ORE_InconsistentConstraints);
-                }
-                dReal fdist = _parameters->_distmetricfn(newq,vdata);
-                OPENRAVE_ASSERT_OP_FORMAT(fdist,<=,0.01 * fresolutionmean, "neighstatefn is rejecting configuration %d, wrote trajectory %s",ipoint%DumpTrajectory(trajectory),ORE_InconsistentConstraints);
-            }
+            _VerifyWaypoint(trajectory, ipoint);
         }
 
         if( !!_parameters->_checkpathvelocityconstraintsfn && trajectory->GetNumWaypoints() >= 2 ) {
-
             if( trajectory->GetDuration() > 0 && samplingstep > 0 ) {
-                // use sampling and check segment constraints
-                // have to make sure that sampling interval doesn't include a waypoint. otherwise interpolation could become inconsistent!
                 std::vector<dReal> vabstimes, vsampletimes;
-                vabstimes.reserve(trajectory->GetNumWaypoints() + (trajectory->GetDuration()/samplingstep) + 1);
-                ConfigurationSpecification deltatimespec;
-                deltatimespec.AddDeltaTimeGroup();
-                trajectory->GetWaypoints(0, trajectory->GetNumWaypoints(), vabstimes, deltatimespec);
-                dReal totaltime = 0;
-                FOREACH(ittime, vabstimes) {
-                    totaltime += *ittime;
-                    *ittime = totaltime;
-                }
-                for(dReal ftime = 0; ftime < trajectory->GetDuration(); ftime += samplingstep ) {
-                    vabstimes.push_back(ftime);
-                }
-                vsampletimes.resize(vabstimes.size());
-                std::merge(vabstimes.begin(), vabstimes.begin()+trajectory->GetNumWaypoints(), vabstimes.begin()+trajectory->GetNumWaypoints(), vabstimes.end(), vsampletimes.begin());
-                std::vector<dReal> vprevdata, vprevdatavel;
-                ConstraintFilterReturnPtr filterreturn(new ConstraintFilterReturn());
-                trajectory->Sample(vprevdata,0,_parameters->_configurationspecification);
-                trajectory->Sample(vprevdatavel,0,velspec);
-                std::vector<dReal>::iterator itprevtime = vsampletimes.begin();
-                for(std::vector<dReal>::iterator itsampletime = vsampletimes.begin()+1; itsampletime != vsampletimes.end(); ++itsampletime) {
-                    if (*itsampletime < *itprevtime + 1e-5 ) {
-                        continue;
-                    }
-                    filterreturn->Clear();
-                    trajectory->Sample(vdata,*itsampletime,_parameters->_configurationspecification);
-                    trajectory->Sample(vdatavel,*itsampletime,velspec);
-                    dReal deltatime = *itsampletime - *itprevtime;
-                    vdiff = vdata;
-                    _parameters->_diffstatefn(vdiff,vprevdata);
-                    for(size_t i = 0; i < _parameters->_vConfigVelocityLimit.size(); ++i) {
-                        dReal velthresh = _parameters->_vConfigVelocityLimit.at(i)*deltatime+fthresh;
-                        OPENRAVE_ASSERT_OP_FORMAT(RaveFabs(vdiff.at(i)), <=, velthresh, "time %fs-%fs, dof %d traveled %f, but maxvelocity only allows %f, wrote trajectory to %s",*itprevtime%*itsampletime%i%RaveFabs(vdiff.at(i))%velthresh%DumpTrajectory(trajectory),ORE_InconsistentConstraints);
-                    }
-                    if( _parameters->CheckPathAllConstraints(vprevdata,vdata,vprevdatavel, vdatavel, deltatime, IT_Closed, 0xffff|CFO_FillCheckedConfiguration, filterreturn) != 0 ) {
-                        if( IS_DEBUGLEVEL(Level_Verbose) ) {
-                            _parameters->CheckPathAllConstraints(vprevdata,vdata,vprevdatavel, vdatavel, deltatime, IT_Closed, 0xffff|CFO_FillCheckedConfiguration, filterreturn);
-                        }
-                        throw OPENRAVE_EXCEPTION_FORMAT(_("time %fs-%fs, CheckPathAllConstraints failed, wrote trajectory to %s"),*itprevtime%*itsampletime%DumpTrajectory(trajectory),ORE_InconsistentConstraints);
-                    }
-                    OPENRAVE_ASSERT_OP(filterreturn->_configurations.size()%_parameters->GetDOF(),==,0);
-                    std::vector<dReal>::iterator itprevconfig = filterreturn->_configurations.begin();
-                    std::vector<dReal>::iterator itcurconfig = itprevconfig + _parameters->GetDOF();
-                    for(; itcurconfig != filterreturn->_configurations.end(); itcurconfig += _parameters->GetDOF()) {
-                        std::vector<dReal> vprevconfig(itprevconfig,itprevconfig+_parameters->GetDOF());
-                        std::vector<dReal> vcurconfig(itcurconfig,itcurconfig+_parameters->GetDOF());
-                        for(int i = 0; i < _parameters->GetDOF(); ++i) {
-                            deltaq.at(i) = vcurconfig.at(i) - vprevconfig.at(i);
-                        }
-                        if( _parameters->SetStateValues(vprevconfig, 0) != 0 ) {
-                            throw OPENRAVE_EXCEPTION_FORMAT0(_("time %fs-%fs, failed to set state values"), ORE_InconsistentConstraints);
-                        }
-                        vector<dReal> vtemp = vprevconfig;
-                        if( !_parameters->_neighstatefn(vtemp,deltaq,NSO_OnlyHardConstraints) ) {
-                            throw OPENRAVE_EXCEPTION_FORMAT(_("time %fs-%fs, neighstatefn is rejecting configurations from CheckPathAllConstraints, wrote trajectory to %s"),*itprevtime%*itsampletime%DumpTrajectory(trajectory),ORE_InconsistentConstraints);
-                        }
-                        else {
-                            dReal fprevdist = _parameters->_distmetricfn(vprevconfig,vtemp);
-                            dReal fcurdist = _parameters->_distmetricfn(vcurconfig,vtemp);
-                            if( fprevdist > g_fEpsilonLinear ) {
-                                OPENRAVE_ASSERT_OP_FORMAT(fprevdist, >, fcurdist, "time %fs-%fs, neightstatefn returned a configuration closer to the previous configuration %f than the expected current %f, wrote trajectory to %s",*itprevtime%*itsampletime%fprevdist%fcurdist%DumpTrajectory(trajectory), ORE_InconsistentConstraints);
-                            }
-                        }
-                        itprevconfig=itcurconfig;
-                    }
-                    vprevdata.swap(vdata);
-                    vprevdatavel.swap(vdatavel);
-                    itprevtime = itsampletime;
-                }
+                GetSampleTimes(trajectory, samplingstep, vabstimes, vsampletimes);
+                _VerifySegments(trajectory, vsampletimes, 0, vsampletimes.size()-1, NULL);
             }
             else {
                 for(size_t i = 0; i < trajectory->GetNumWaypoints(); ++i) {
-                    trajectory->GetWaypoint(i,vdata,_parameters->_configurationspecification);
-                    if( _parameters->CheckPathAllConstraints(vdata,vdata,std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenStart) != 0 ) {
-                        throw OPENRAVE_EXCEPTION_FORMAT(_("CheckPathAllConstraints, failed at %d, wrote trajectory to %s"),i%DumpTrajectory(trajectory),ORE_InconsistentConstraints);
-                    }
+                    _VerifyWaypointConstraints(trajectory, i);
                 }
             }
         }
     }
 
+    /// \brief checks the waypoints [startindex,endindex) and the sampled segments [startsegment,endsegment) and records the invalid ones in state
+    ///
+    /// \param vabstimes the accumulated times of the waypoints
+    /// \param vsampletimes the sample times from GetSampleTimes, empty if the segment constraints are not checked
+    /// \param bcheckwaypointconstraints if true, the segment constraints are checked at each waypoint rather than along sampled segments
+    void VerifyTrajectoryRange(TrajectoryBaseConstPtr trajectory, const std::vector<dReal>& vabstimes, const std::vector<dReal>& vsampletimes, size_t startindex, size_t endindex, size_t startsegment, size_t endsegment, bool bcheckwaypointconstraints, TrajectoryVerificationState& state)
+    {
+        _InitVerification();
+        for(size_t ipoint = startindex; ipoint < endindex && !state.IsCancelled(); ++ipoint) {
+            try {
+                _VerifyWaypoint(trajectory, ipoint);
+                if( bcheckwaypointconstraints ) {
+                    _VerifyWaypointConstraints(trajectory, ipoint);
+                }
+            }
+            catch(const std::exception& ex) {
+                state.AddInvalidInterval(vabstimes.at(ipoint), vabstimes.at(ipoint), ex.what());
+            }
+        }
+        if( startsegment < endsegment ) {
+            _VerifySegments(trajectory, vsampletimes, startsegment, endsegment, &state);
+        }
+    }
+
+    /// \brief returns the accumulated times of the waypoints and the times the segment constraints are checked at
+    ///
+    /// The sample times include the waypoints so that a sampled segment never crosses a waypoint, otherwise the interpolation could become inconsistent.
+    /// Times closer than 1e-5 to the previous sample time are dropped.
+    static void GetSampleTimes(TrajectoryBaseConstPtr trajectory, dReal samplingstep, std::vector<dReal>& vabstimes, std::vector<dReal>& vsampletimes)
+    {
+        size_t numpoints = trajectory->GetNumWaypoints();
+        ConfigurationSpecification deltatimespec;
+        deltatimespec.AddDeltaTimeGroup();
+        trajectory->GetWaypoints(0, numpoints, vabstimes, deltatimespec);
+        dReal totaltime = 0;
+        FOREACH(ittime, vabstimes) {
+            totaltime += *ittime;
+            *ittime = totaltime;
+        }
+        vsampletimes.resize(0);
+        if( samplingstep <= 0 ) {
+            return;
+        }
+        std::vector<dReal> vtimes;
+        vtimes.reserve(numpoints + (trajectory->GetDuration()/samplingstep) + 1);
+        for(dReal ftime = 0; ftime < trajectory->GetDuration(); ftime += samplingstep ) {
+            vtimes.push_back(ftime);
+        }
+        std::vector<dReal> vmergedtimes(numpoints+vtimes.size());
+        std::merge(vabstimes.begin(), vabstimes.end(), vtimes.begin(), vtimes.end(), vmergedtimes.begin());
+        vsampletimes.reserve(vmergedtimes.size());
+        FOREACHC(ittime, vmergedtimes) {
+            if( vsampletimes.size() == 0 || *ittime >= vsampletimes.back() + 1e-5 ) {
+                vsampletimes.push_back(*ittime);
+            }
+        }
+    }
+
     string DumpTrajectory(TrajectoryBaseConstPtr trajectory)
     {
+        if( !_bDumpTrajectory ) {
+            return string("(not written)");
+        }
         string filename = str(boost::format("%s/failedtrajectory%d.xml")%RaveGetHomeDirectory()%(RaveRandomInt()%1000));
         ofstream f(filename.c_str());
         f << std::setprecision(std::numeric_limits<dReal>::digits10+1);     /// have to do this or otherwise precision gets lost
@@ -552,10 +529,158 @@ public:
         return filename;
     }
 
+    /// \brief if false, failures do not write the trajectory to a file
+    void SetDumpTrajectory(bool bDumpTrajectory)
+    {
+        _bDumpTrajectory = bDumpTrajectory;
+    }
+
 protected:
+    void _InitVerification()
+    {
+        _velspec = _parameters->_configurationspecification.ConvertToVelocitySpecification();
+        _fresolutionmean = 0;
+        FOREACHC(it,_parameters->_vConfigResolution) {
+            _fresolutionmean += *it;
+        }
+        _fresolutionmean /= _parameters->_vConfigResolution.size();
+        _deltaq.resize(_parameters->GetDOF(),0);
+    }
+
+    /// \brief checks the limits and the state functions at waypoint ipoint
+    void _VerifyWaypoint(TrajectoryBaseConstPtr trajectory, size_t ipoint)
+    {
+        trajectory->GetWaypoint(ipoint,_vdata,_parameters->_configurationspecification);
+        trajectory->GetWaypoint(ipoint,_vdatavel,_velspec);
+        BOOST_ASSERT((int)_vdata.size()==_parameters->GetDOF());
+        BOOST_ASSERT((int)_vdatavel.size()==_parameters->GetDOF());
+        for(size_t i = 0; i < _vdata.size(); ++i) {
+            if( !(_vdata[i] >= _parameters->_vConfigLowerLimit[i]-s_fthresh) || !(_vdata[i] <= _parameters->_vConfigUpperLimit[i]+s_fthresh) ) {
+                throw OPENRAVE_EXCEPTION_FORMAT(_("limits exceeded configuration %d dof %d: %f in [%f,%f]"), ipoint%i%_vdata[i]%_parameters->_vConfigLowerLimit[i]%_parameters->_vConfigUpperLimit[i], ORE_InconsistentConstraints);
+            }
+        }
+        for(size_t i = 0; i < _parameters->_vConfigVelocityLimit.size(); ++i) {
+            if( !(RaveFabs(_vdatavel.at(i)) <= _parameters->_vConfigVelocityLimit[i]+s_fthresh) ) { // !(x<=y) necessary for catching NaNs
+                throw OPENRAVE_EXCEPTION_FORMAT(_("velocity exceeded configuration %d dof %d: %f>%f"), ipoint%i%RaveFabs(_vdatavel.at(i))%_parameters->_vConfigVelocityLimit[i], ORE_InconsistentConstraints);
+            }
+        }
+        if( _parameters->SetStateValues(_vdata, 0) != 0 ) {
+            throw OPENRAVE_EXCEPTION_FORMAT0(_("failed to set state values"), ORE_InconsistentConstraints);
+        }
+        vector<dReal> newq;
+        _parameters->_getstatefn(newq);
+        BOOST_ASSERT(_vdata.size() == newq.size());
+        _vdiff = newq;
+        _parameters->_diffstatefn(_vdiff,_vdata);
+        for(size_t i = 0; i < _vdiff.size(); ++i) {
+            if( !(RaveFabs(_vdiff.at(i)) <= 0.001 * _parameters->_vConfigResolution[i]) ) {
+                throw OPENRAVE_EXCEPTION_FORMAT(_("setstate/getstate inconsistent configuration %d dof %d: %f != %f, wrote trajectory to %s"),ipoint%i%_vdata.at(i)%newq.at(i)%DumpTrajectory(trajectory),ORE_InconsistentConstraints);
+            }
+        }
+        if( !!_parameters->_neighstatefn ) {
+            newq = _vdata;
+            if( !_parameters->_neighstatefn(newq,_vdiff,NSO_OnlyHardConstraints) ) {
+                throw OPENRAVE_EXCEPTION_FORMAT(_("neighstatefn is rejecting configuration %d, wrote trajectory %s"),ipoint%DumpTrajectory(trajectory),ORE_InconsistentConstraints);
+            }
+            dReal fdist = _parameters->_distmetricfn(newq,_vdata);
+            OPENRAVE_ASSERT_OP_FORMAT(fdist,<=,0.01 * _fresolutionmean, "neighstatefn is rejecting configuration %d, wrote trajectory %s",ipoint%DumpTrajectory(trajectory),ORE_InconsistentConstraints);
+        }
+    }
+
+    /// \brief checks the path constraints at waypoint ipoint, used when the trajectory is not sampled
+    void _VerifyWaypointConstraints(TrajectoryBaseConstPtr trajectory, size_t ipoint)
+    {
+        trajectory->GetWaypoint(ipoint,_vdata,_parameters->_configurationspecification);
+        if( _parameters->CheckPathAllConstraints(_vdata,_vdata,std::vector<dReal>(), std::vector<dReal>(), 0, IT_OpenStart) != 0 ) {
+            throw OPENRAVE_EXCEPTION_FORMAT(_("CheckPathAllConstraints, failed at %d, wrote trajectory to %s"),ipoint%DumpTrajectory(trajectory),ORE_InconsistentConstraints);
+        }
+    }
+
+    /// \brief checks the segments between vsampletimes[i] and vsampletimes[i+1] for i in [startsegment,endsegment)
+    ///
+    /// \param pstate if not NULL, invalid segments are recorded in it and the check stops when it is cancelled. Otherwise the first invalid segment throws.
+    void _VerifySegments(TrajectoryBaseConstPtr trajectory, const std::vector<dReal>& vsampletimes, size_t startsegment, size_t endsegment, TrajectoryVerificationState* pstate)
+    {
+        ConstraintFilterReturnPtr filterreturn(new ConstraintFilterReturn());
+        trajectory->Sample(_vprevdata,vsampletimes.at(startsegment),_parameters->_configurationspecification);
+        trajectory->Sample(_vprevdatavel,vsampletimes.at(startsegment),_velspec);
+        for(size_t isegment = startsegment; isegment < endsegment; ++isegment) {
+            if( !!pstate && pstate->IsCancelled() ) {
+                break;
+            }
+            trajectory->Sample(_vdata,vsampletimes[isegment+1],_parameters->_configurationspecification);
+            trajectory->Sample(_vdatavel,vsampletimes[isegment+1],_velspec);
+            if( !pstate ) {
+                _VerifySegment(trajectory, vsampletimes[isegment], vsampletimes[isegment+1], filterreturn);
+            }
+            else {
+                try {
+                    _VerifySegment(trajectory, vsampletimes[isegment], vsampletimes[isegment+1], filterreturn);
+                }
+                catch(const std::exception& ex) {
+                    pstate->AddInvalidInterval(vsampletimes[isegment], vsampletimes[isegment+1], ex.what());
+                }
+            }
+            _vprevdata.swap(_vdata);
+            _vprevdatavel.swap(_vdatavel);
+        }
+    }
+
+    /// \brief checks the segment from _vprevdata at prevtime to _vdata at time
+    void _VerifySegment(TrajectoryBaseConstPtr trajectory, dReal prevtime, dReal time, ConstraintFilterReturnPtr filterreturn)
+    {
+        filterreturn->Clear();
+        dReal deltatime = time - prevtime;
+        _vdiff = _vdata;
+        _parameters->_diffstatefn(_vdiff,_vprevdata);
+        for(size_t i = 0; i < _parameters->_vConfigVelocityLimit.size(); ++i) {
+            dReal velthresh = _parameters->_vConfigVelocityLimit.at(i)*deltatime+s_fthresh;
+            OPENRAVE_ASSERT_OP_FORMAT(RaveFabs(_vdiff.at(i)), <=, velthresh, "time %fs-%fs, dof %d traveled %f, but maxvelocity only allows %f, wrote trajectory to %s",prevtime%time%i%RaveFabs(_vdiff.at(i))%velthresh%DumpTrajectory(trajectory),ORE_InconsistentConstraints);
+        }
+        if( _parameters->CheckPathAllConstraints(_vprevdata,_vdata,_vprevdatavel, _vdatavel, deltatime, IT_Closed, 0xffff|CFO_FillCheckedConfiguration, filterreturn) != 0 ) {
+            if( IS_DEBUGLEVEL(Level_Verbose) ) {
+                _parameters->CheckPathAllConstraints(_vprevdata,_vdata,_vprevdatavel, _vdatavel, deltatime, IT_Closed, 0xffff|CFO_FillCheckedConfiguration, filterreturn);
+            }
+            throw OPENRAVE_EXCEPTION_FORMAT(_("time %fs-%fs, CheckPathAllConstraints failed, wrote trajectory to %s"),prevtime%time%DumpTrajectory(trajectory),ORE_InconsistentConstraints);
+        }
+        OPENRAVE_ASSERT_OP(filterreturn->_configurations.size()%_parameters->GetDOF(),==,0);
+        std::vector<dReal>::iterator itprevconfig = filterreturn->_configurations.begin();
+        std::vector<dReal>::iterator itcurconfig = itprevconfig + _parameters->GetDOF();
+        for(; itcurconfig != filterreturn->_configurations.end(); itcurconfig += _parameters->GetDOF()) {
+            std::vector<dReal> vprevconfig(itprevconfig,itprevconfig+_parameters->GetDOF());
+            std::vector<dReal> vcurconfig(itcurconfig,itcurconfig+_parameters->GetDOF());
+            for(int i = 0; i < _parameters->GetDOF(); ++i) {
+                _deltaq.at(i) = vcurconfig.at(i) - vprevconfig.at(i);
+            }
+            if( _parameters->SetStateValues(vprevconfig, 0) != 0 ) {
+                throw OPENRAVE_EXCEPTION_FORMAT0(_("time %fs-%fs, failed to set state values"), ORE_InconsistentConstraints);
+            }
+            vector<dReal> vtemp = vprevconfig;
+            if( !_parameters->_neighstatefn(vtemp,_deltaq,NSO_OnlyHardConstraints) ) {
+                throw OPENRAVE_EXCEPTION_FORMAT(_("time %fs-%fs, neighstatefn is rejecting configurations from CheckPathAllConstraints, wrote trajectory to %s"),prevtime%time%DumpTrajectory(trajectory),ORE_InconsistentConstraints);
+            }
+            else {
+                dReal fprevdist = _parameters->_distmetricfn(vprevconfig,vtemp);
+                dReal fcurdist = _parameters->_distmetricfn(vcurconfig,vtemp);
+                if( fprevdist > g_fEpsilonLinear ) {
+                    OPENRAVE_ASSERT_OP_FORMAT(fprevdist, >, fcurdist, "time %fs-%fs, neightstatefn returned a configuration closer to the previous configuration %f than the expected current %f, wrote trajectory to %s",prevtime%time%fprevdist%fcurdist%DumpTrajectory(trajectory), ORE_InconsistentConstraints);
+                }
+            }
+            itprevconfig=itcurconfig;
+        }
+    }
+
+    static const dReal s_fthresh;
+
     PlannerBase::PlannerParametersConstPtr _parameters;
+    ConfigurationSpecification _velspec;
+    dReal _fresolutionmean;
+    bool _bDumpTrajectory;
+    std::vector<dReal> _vdata, _vdatavel, _vprevdata, _vprevdatavel, _vdiff, _deltaq;
 };
 
+const dReal TrajectoryVerifier::s_fthresh = 5e-5f;
+
 void VerifyTrajectory(PlannerBase::PlannerParametersConstPtr parameters, TrajectoryBaseConstPtr trajectory, dReal samplingstep)
 {
     EnvironmentMutex::scoped_lock lockenv(trajectory->GetEnv()->GetMutex());
@@ -568,6 +693,201 @@ void VerifyTrajectory(PlannerBase::PlannerParametersConstPtr parameters, Traject
     v.VerifyTrajectory(trajectory,samplingstep);
 }
 
+/// \brief one thread of VerifyTrajectoryIntervals, checks its part of the waypoints and of the sampled segments
+static void _VerifyTrajectoryThreadRange(const std::vector<PlannerBase::PlannerParametersConstPtr>& vparameters, const std::vector<TrajectoryBaseConstPtr>& vtrajectories, const std::vector<dReal>& vabstimes, const std::vector<dReal>& vsampletimes, bool bcheckwaypointconstraints, TrajectoryVerificationState& state, size_t startthread, size_t endthread)
+{
+    size_t numthreads = vparameters.size();
+    size_t numpoints = vabstimes.size(), numsegments = vsampletimes.size() > 0 ? vsampletimes.size()-1 : 0;
+    for(size_t ithread = startthread; ithread < endthread; ++ithread) {
+        EnvironmentMutex::scoped_lock lockenv(vtrajectories[ithread]->GetEnv()->GetMutex());
+        TrajectoryVerifier v(vparameters[ithread]);
+        v.SetDumpTrajectory(false);
+        v.VerifyTrajectoryRange(vtrajectories[ithread], vabstimes, vsampletimes, (numpoints*ithread)/numthreads, (numpoints*(ithread+1))/numthreads, (numsegments*ithread)/numthreads, (numsegments*(ithread+1))/numthreads, bcheckwaypointconstraints, state);
+    }
+}
+
+static bool _CompareInvalidIntervals(const InvalidTrajectoryInterval& interval0, const InvalidTrajectoryInterval& interval1)
+{
+    return interval0.starttime < interval1.starttime || (interval0.starttime == interval1.starttime && interval0.endtime < interval1.endtime);
+}
+
+bool VerifyTrajectoryIntervals(PlannerBase::PlannerParametersConstPtr parameters, TrajectoryBaseConstPtr trajectory, std::vector<InvalidTrajectoryInterval>& vinvalidintervals, dReal samplingstep, int numthreads, bool bstopatfirst)
+{
+    OPENRAVE_ASSERT_FORMAT0(!!trajectory,"need valid trajectory",ORE_InvalidArguments);
+    EnvironmentBasePtr penv = trajectory->GetEnv();
+    EnvironmentMutex::scoped_lock lockenv(penv->GetMutex());
+    if( !parameters ) {
+        PlannerBase::PlannerParametersPtr newparams(new PlannerBase::PlannerParameters());
+        newparams->SetConfigurationSpecification(penv, trajectory->GetConfigurationSpecification().GetTimeDerivativeSpecification(0));
+        parameters = newparams;
+    }
+    TrajectoryVerifier verifier(parameters); // throws if the parameters are not consistent
+    bool bcheckconstraints = !!parameters->_checkpathvelocityconstraintsfn && trajectory->GetNumWaypoints() >= 2;
+    bool bsample = bcheckconstraints && trajectory->GetDuration() > 0 && samplingstep > 0;
+    std::vector<dReal> vabstimes, vsampletimes;
+    TrajectoryVerifier::GetSampleTimes(trajectory, bsample ? samplingstep : 0, vabstimes, vsampletimes);
+
+    numthreads = max(1, min(numthreads, (int)max(vabstimes.size(), vsampletimes.size())));
+    std::vector<PlannerBase::PlannerParametersConstPtr> vparameters(numthreads);
+    std::vector<TrajectoryBaseConstPtr> vtrajectories(numthreads);
+    std::vector<EnvironmentBasePtr> vsnapshots;
+    if( numthreads == 1 ) {
+        vparameters[0] = parameters;
+        vtrajectories[0] = trajectory;
+    }
+    else {
+        // every thread sets states and samples on its own snapshot of the environment
+        vsnapshots.resize(numthreads);
+        for(int ithread = 0; ithread < numthreads; ++ithread) {
+            vsnapshots[ithread] = penv->CloneSelf(Clone_Bodies);
+            EnvironmentMutex::scoped_lock locksnapshot(vsnapshots[ithread]->GetMutex());
+            PlannerBase::PlannerParametersPtr params(new PlannerBase::PlannerParameters());
+            params->copy(parameters);
+            params->SetConfigurationSpecification(vsnapshots[ithread], parameters->_configurationspecification);
+            // SetConfigurationSpecification resets the limits to the ones of the bodies
+            params->_vConfigLowerLimit = parameters->_vConfigLowerLimit;
+            params->_vConfigUpperLimit = parameters->_vConfigUpperLimit;
+            params->_vConfigVelocityLimit = parameters->_vConfigVelocityLimit;
+            params->_vConfigAccelerationLimit = parameters->_vConfigAccelerationLimit;
+            params->_vConfigResolution = parameters->_vConfigResolution;
+            if( !bcheckconstraints ) {
+                params->_checkpathvelocityconstraintsfn.clear();
+            }
+            vparameters[ithread] = params;
+            TrajectoryBasePtr ptraj = RaveCreateTrajectory(vsnapshots[ithread], trajectory->GetXMLId());
+            ptraj->Clone(trajectory, 0);
+            vtrajectories[ithread] = ptraj;
+        }
+    }
+
+    TrajectoryVerificationState state(bstopatfirst);
+    if( numthreads == 1 ) {
+        _VerifyTrajectoryThreadRange(vparameters, vtrajectories, vabstimes, vsampletimes, bcheckconstraints && !bsample, state, 0, 1);
+    }
+    else {
+        ParallelRangeWorkers workers(numthreads, "VerifyTrajectoryIntervals");
+        // one job per thread, each job checks a contiguous part of the trajectory
+        workers.Run(numthreads, boost::bind(_VerifyTrajectoryThreadRange, boost::cref(vparameters), boost::cref(vtrajectories), boost::cref(vabstimes), boost::cref(vsampletimes), bcheckconstraints && !bsample, boost::ref(state), _1, _2));
+    }
+    vparameters.clear();
+    vtrajectories.clear();
+    FOREACH(itsnapshot, vsnapshots) {
+        (*itsnapshot)->Destroy();
+    }
+    vinvalidintervals.swap(state._vinvalidintervals);
+    std::sort(vinvalidintervals.begin(), vinvalidintervals.end(), _CompareInvalidIntervals);
+    return vinvalidintervals.size() == 0;
+}
+
+/// \brief keeps the idle planners of the active dof smoothers and retimers so they do not have to be created through the plugin database for every request
+///
+/// Planners are keyed by their name and robot. Since every user calls InitPlan before planning, a planner only has to be re-initialized when it is taken out.
+/// Planners of robots that were removed from their environment are dropped, and all planners are dropped in RaveDestroy before the plugins are unloaded.
+class PlannerPool
+{
+public:
+    PlannerPool() : _bRegisteredDestroy(false) {
+    }
+
+    /// \brief returns an idle planner for the robot or creates a new one
+    PlannerBasePtr Acquire(RobotBasePtr probot, const std::string& plannername)
+    {
+        std::list<PooledPlanner> listremoved;
+        {
+            boost::mutex::scoped_lock lock(_mutex);
+            _Prune(listremoved);
+            FOREACH(it, _listplanners) {
+                if( it->planner->GetXMLId() == plannername && it->probot.lock() == probot ) {
+                    PlannerBasePtr planner = it->planner;
+                    _listplanners.erase(it);
+                    return planner;
+                }
+            }
+        }
+        return RaveCreatePlanner(probot->GetEnv(), plannername);
+    }
+
+    /// \brief gives the planner back to the pool once its user does not need it anymore
+    void Release(RobotBasePtr probot, PlannerBasePtr planner)
+    {
+        if( !probot || !planner ) {
+            return;
+        }
+        boost::mutex::scoped_lock lock(_mutex);
+        if( !_bRegisteredDestroy ) {
+            RaveAddCallbackForDestroy(boost::bind(&PlannerPool::Clear, this));
+            _bRegisteredDestroy = true;
+        }
+        int numidle = 0;
+        FOREACHC(it, _listplanners) {
+            if( it->planner->GetXMLId() == planner->GetXMLId() && it->probot.lock() == probot ) {
+                ++numidle;
+            }
+        }
+        if( numidle < s_nMaxIdlePlanners ) {
+            PooledPlanner pooled;
+            pooled.probot = probot;
+            pooled.planner = planner;
+            _listplanners.push_back(pooled);
+        }
+    }
+
+    void Clear()
+    {
+        std::list<PooledPlanner> listremoved;
+        boost::mutex::scoped_lock lock(_mutex);
+        listremoved.swap(_listplanners);
+        _bRegisteredDestroy = false;
+    }
+
+private:
+    struct PooledPlanner
+    {
+        RobotBaseWeakPtr probot;
+        PlannerBasePtr planner;
+    };
+
+    /// \brief moves the planners of robots that are not in their environment anymore to listremoved, they are destroyed outside of the lock
+    void _Prune(std::list<PooledPlanner>& listremoved)
+    {
+        std::list<PooledPlanner>::iterator it = _listplanners.begin();
+        while(it != _listplanners.end()) {
+            RobotBasePtr probot = it->probot.lock();
+            if( !probot || probot->GetEnvironmentId() == 0 || probot->GetEnv()->GetRobot(probot->GetName()) != probot ) {
+                listremoved.splice(listremoved.end(), _listplanners, it++);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+
+    static const int s_nMaxIdlePlanners = 4; ///< max number of idle planners kept for the same name and robot
+    std::list<PooledPlanner> _listplanners;
+    boost::mutex _mutex;
+    bool _bRegisteredDestroy;
+};
+
+static PlannerPool& GetPlannerPool()
+{
+    static PlannerPool* s_pPlannerPool = new PlannerPool(); // never deleted so that it can be used during static destruction
+    return *s_pPlannerPool;
+}
+
+/// \brief returns the planner to the pool when going out of scope
+class PooledPlannerReleaser
+{
+public:
+    PooledPlannerReleaser(RobotBasePtr probot, PlannerBasePtr planner) : _probot(probot), _planner(planner) {
+    }
+    ~PooledPlannerReleaser() {
+        GetPlannerPool().Release(_probot, _planner);
+    }
+private:
+    RobotBasePtr _probot;
+    PlannerBasePtr _planner;
+};
+
 PlannerStatus _PlanActiveDOFTrajectory(TrajectoryBasePtr traj, RobotBasePtr probot, bool hastimestamps, dReal fmaxvelmult, dReal fmaxaccelmult, const std::string& plannername, bool bsmooth, const std::string& plannerparameters)
 {
     if( traj->GetNumWaypoints() == 1 ) {
@@ -584,7 +904,11 @@ PlannerStatus _PlanActiveDOFTrajectory(TrajectoryBasePtr traj, RobotBasePtr prob
     EnvironmentBasePtr env = traj->GetEnv();
     EnvironmentMutex::scoped_lock lockenv(env->GetMutex());
     CollisionOptionsStateSaver optionstate(env->GetCollisionChecker(),env->GetCollisionChecker()->GetCollisionOptions()|CO_ActiveDOFs,false);
-    PlannerBasePtr planner = RaveCreatePlanner(env,plannername.size() > 0 ? plannername : string("parabolicsmoother"));
+    PlannerBasePtr planner = GetPlannerPool().Acquire(probot, plannername.size() > 0 ? plannername : string("parabolicsmoother"));
+    if( !planner ) {
+        return PS_Failed;
+    }
+    PooledPlannerReleaser plannerreleaser(probot, planner);
     TrajectoryTimingParametersPtr params(new TrajectoryTimingParameters());
     params->SetRobotActiveJoints(probot);
     FOREACH(it,params->_vConfigVelocityLimit) {
@@ -606,7 +930,12 @@ PlannerStatus _PlanActiveDOFTrajectory(TrajectoryBasePtr traj, RobotBasePtr prob
     if( !planner->InitPlan(probot,params) ) {
         return PS_Failed;
     }
-    if( planner->PlanPath(traj) != PS_HasSolution ) {
+    PlannerStatus status;
+    {
+        utils::ProfileZone profilezone("PlannerBase::PlanPath");
+        status = planner->PlanPath(traj);
+    }
+    if( status != PS_HasSolution ) {
         return PS_Failed;
     }
 
@@ -625,7 +954,7 @@ ActiveDOFTrajectorySmoother::ActiveDOFTrajectorySmoother(RobotBasePtr robot, con
     _vRobotActiveIndices = _robot->GetActiveDOFIndices();
     _nRobotAffineDOF = _robot->GetAffineDOF();
     _vRobotRotationAxis = _robot->GetAffineRotationAxis();
-    _planner = RaveCreatePlanner(robot->GetEnv(),plannername);
+    _planner = GetPlannerPool().Acquire(robot, plannername);
     TrajectoryTimingParametersPtr params(new TrajectoryTimingParameters());
     params->SetRobotActiveJoints(_robot);
     params->_sPostProcessingPlanner = ""; // have to turn off the second post processing stage
@@ -638,6 +967,12 @@ ActiveDOFTrajectorySmoother::ActiveDOFTrajectorySmoother(RobotBasePtr robot, con
     _changehandler = robot->RegisterChangeCallback(KinBody::Prop_JointAccelerationVelocityTorqueLimits|KinBody::Prop_JointLimits|KinBody::Prop_JointProperties, boost::bind(&ActiveDOFTrajectorySmoother::_UpdateParameters, this));
 }
 
+ActiveDOFTrajectorySmoother::~ActiveDOFTrajectorySmoother()
+{
+    _changehandler.reset();
+    GetPlannerPool().Release(_robot, _planner);
+}
+
 PlannerStatus ActiveDOFTrajectorySmoother::PlanPath(TrajectoryBasePtr traj)
 {
     if( traj->GetNumWaypoints() == 1 ) {
@@ -653,7 +988,11 @@ PlannerStatus ActiveDOFTrajectorySmoother::PlanPath(TrajectoryBasePtr traj)
 
     EnvironmentBasePtr env = traj->GetEnv();
     CollisionOptionsStateSaver optionstate(env->GetCollisionChecker(),env->GetCollisionChecker()->GetCollisionOptions()|CO_ActiveDOFs,false);
-    PlannerStatus status = _planner->PlanPath(traj);
+    PlannerStatus status;
+    {
+        utils::ProfileZone profilezone("PlannerBase::PlanPath");
+        status = _planner->PlanPath(traj);
+    }
     if( status & PS_HasSolution ) {
         if( RaveGetDebugLevel() & Level_VerifyPlans ) {
             RobotBase::RobotStateSaver saver(_robot);
@@ -686,7 +1025,7 @@ ActiveDOFTrajectoryRetimer::ActiveDOFTrajectoryRetimer(RobotBasePtr robot, const
     _vRobotActiveIndices = _robot->GetActiveDOFIndices();
     _nRobotAffineDOF = _robot->GetAffineDOF();
     _vRobotRotationAxis = _robot->GetAffineRotationAxis();
-    _planner = RaveCreatePlanner(robot->GetEnv(),plannername);
+    _planner = GetPlannerPool().Acquire(robot, plannername);
     TrajectoryTimingParametersPtr params(new TrajectoryTimingParameters());
     params->SetRobotActiveJoints(_robot);
     params->_sPostProcessingPlanner = ""; // have to turn off the second post processing stage
@@ -703,6 +1042,12 @@ ActiveDOFTrajectoryRetimer::ActiveDOFTrajectoryRetimer(RobotBasePtr robot, const
     _changehandler = robot->RegisterChangeCallback(KinBody::Prop_JointAccelerationVelocityTorqueLimits|KinBody::Prop_JointLimits|KinBody::Prop_JointProperties, boost::bind(&ActiveDOFTrajectoryRetimer::_UpdateParameters, this));
 }
 
+ActiveDOFTrajectoryRetimer::~ActiveDOFTrajectoryRetimer()
+{
+    _changehandler.reset();
+    GetPlannerPool().Release(_robot, _planner);
+}
+
 PlannerStatus ActiveDOFTrajectoryRetimer::PlanPath(TrajectoryBasePtr traj, bool hastimestamps)
 {
     if( traj->GetNumWaypoints() == 1 ) {
@@ -724,6 +1069,7 @@ PlannerStatus ActiveDOFTrajectoryRetimer::PlanPath(TrajectoryBasePtr traj, bool
         }
     }
 
+    utils::ProfileZone profilezone("PlannerBase::PlanPath");
     return _planner->PlanPath(traj);
 }
 
@@ -782,7 +1128,12 @@ PlannerStatus _PlanTrajectory(TrajectoryBasePtr traj, bool hastimestamps, dReal
     if( !planner->InitPlan(RobotBasePtr(),params) ) {
         return PS_Failed;
     }
-    if( planner->PlanPath(traj) != PS_HasSolution ) {
+    PlannerStatus status;
+    {
+        utils::ProfileZone profilezone("PlannerBase::PlanPath");
+        status = planner->PlanPath(traj);
+    }
+    if( status != PS_HasSolution ) {
         return PS_Failed;
     }
 
@@ -981,6 +1332,7 @@ static PlannerStatus _PlanAffineTrajectory(TrajectoryBasePtr traj, const std::ve
     if( !planner->InitPlan(RobotBasePtr(),params) ) {
         return PS_Failed;
     }
+    utils::ProfileZone profilezone("PlannerBase::PlanPath");
     if( planner->PlanPath(traj) != PS_HasSolution ) {
         return PS_Failed;
     }
@@ -1139,6 +1491,7 @@ PlannerStatus AffineTrajectoryRetimer::PlanPath(TrajectoryBasePtr traj, const st
         }
     }
 
+    utils::ProfileZone profilezone("PlannerBase::PlanPath");
     return _planner->PlanPath(traj);
 }
 
@@ -1649,64 +2002,281 @@ void ComputeTrajectoryDerivatives(TrajectoryBasePtr traj, int maxderiv)
     traj->Insert(0,data);
 }
 
-TrajectoryBasePtr GetReverseTrajectory(TrajectoryBaseConstPtr sourcetraj)
-{
-    vector<dReal> sourcedata;
-    size_t numpoints = sourcetraj->GetNumWaypoints();
-    int dof = sourcetraj->GetConfigurationSpecification().GetDOF();
-    vector<uint8_t> velocitydofs(dof,0);
-    int timeoffset = -1;
-    vector<uint8_t> velocitynextinterp(dof,0);
-    FOREACHC(itgroup, sourcetraj->GetConfigurationSpecification()._vgroups) {
-        if( itgroup->name.find("_velocities") != string::npos ) {
-            bool bnext = itgroup->interpolation == "next";
-            for(int i = 0; i < itgroup->dof; ++i) {
-                velocitydofs.at(itgroup->offset+i) = 1;
-                velocitynextinterp.at(itgroup->offset+i) = bnext;
-            }
+/// \brief read-only view of a segment or of the reverse of a trajectory that reads the waypoints of the source trajectory when they are needed
+///
+/// Only the times of the view waypoints are stored. The first modification copies the view into a new trajectory and every call
+/// is forwarded to it afterwards. The source trajectory must not be modified while the view reads from it.
+class TrajectoryView : public TrajectoryBase
+{
+public:
+    /// \brief view of the source between starttime and endtime, the first waypoint is sampled at starttime and has a deltatime of 0
+    TrajectoryView(TrajectoryBaseConstPtr psource, dReal starttime, dReal endtime) : TrajectoryBase(psource->GetEnv()), _psource(psource), _bReverse(false)
+    {
+        _Init();
+        _starttime = max(dReal(0), starttime);
+        _endtime = max(_starttime, min(endtime, _psource->GetDuration()));
+        // the source waypoints strictly inside the segment are read as they are
+        _startindex = upper_bound(_vsourceaccumtime.begin(), _vsourceaccumtime.end(), _starttime) - _vsourceaccumtime.begin();
+        size_t endindex = lower_bound(_vsourceaccumtime.begin()+_startindex, _vsourceaccumtime.end(), _endtime) - _vsourceaccumtime.begin();
+        _vaccumtime.push_back(0);
+        for(size_t i = _startindex; i < endindex; ++i) {
+            _vaccumtime.push_back(_vsourceaccumtime[i]-_starttime);
+        }
+        if( _endtime > _starttime ) {
+            _vaccumtime.push_back(_endtime-_starttime);
+        }
+    }
+
+    /// \brief view of the source with the order of the waypoints and times reversed, see \ref planningutils::GetReverseTrajectory
+    TrajectoryView(TrajectoryBaseConstPtr psource) : TrajectoryBase(psource->GetEnv()), _psource(psource), _bReverse(true), _starttime(0), _endtime(0), _startindex(0)
+    {
+        _Init();
+        dReal duration = _vsourceaccumtime.size() > 0 ? _vsourceaccumtime.back() : 0;
+        _vaccumtime.resize(_vsourceaccumtime.size());
+        for(size_t i = 0; i < _vaccumtime.size(); ++i) {
+            _vaccumtime[i] = duration - _vsourceaccumtime[_vsourceaccumtime.size()-1-i];
+        }
+        _vvelocitydofs.resize(_spec.GetDOF(),0);
+        _vnextvelocitydofs.resize(_spec.GetDOF(),0);
+        FOREACHC(itgroup, _spec._vgroups) {
+            if( itgroup->name.find("_velocities") != string::npos ) {
+                bool bnext = itgroup->interpolation == "next";
+                for(int i = 0; i < itgroup->dof; ++i) {
+                    _vvelocitydofs.at(itgroup->offset+i) = 1;
+                    _vnextvelocitydofs.at(itgroup->offset+i) = bnext;
+                }
+            }
+        }
+    }
+
+    void Init(const ConfigurationSpecification& spec)
+    {
+        if( !_pmaterialized ) {
+            _pmaterialized = RaveCreateTrajectory(GetEnv(), _psource->GetXMLId());
+            _psource.reset();
+        }
+        _pmaterialized->Init(spec);
+    }
+
+    void Insert(size_t index, const std::vector<dReal>& data, bool bOverwrite)
+    {
+        _Materialize();
+        _pmaterialized->Insert(index, data, bOverwrite);
+    }
+
+    void Insert(size_t index, const std::vector<dReal>& data, const ConfigurationSpecification& spec, bool bOverwrite)
+    {
+        _Materialize();
+        _pmaterialized->Insert(index, data, spec, bOverwrite);
+    }
+
+    void Remove(size_t startindex, size_t endindex)
+    {
+        _Materialize();
+        _pmaterialized->Remove(startindex, endindex);
+    }
+
+    void Sample(std::vector<dReal>& data, dReal time) const
+    {
+        if( !!_pmaterialized ) {
+            _pmaterialized->Sample(data, time);
+            return;
+        }
+        OPENRAVE_ASSERT_OP_FORMAT0(_vaccumtime.size(),>,0, "trajectory needs at least one point to sample from", ORE_InvalidArguments);
+        size_t index = lower_bound(_vaccumtime.begin(), _vaccumtime.end(), time) - _vaccumtime.begin();
+        if( time >= _vaccumtime.back() || index == 0 ) {
+            // the end points are sampled or reversed differently than the segments
+            GetWaypoints(index == 0 ? 0 : _vaccumtime.size()-1, index == 0 ? 1 : _vaccumtime.size(), data);
+            return;
+        }
+        if( _bReverse ) {
+            _psource->Sample(data, _vaccumtime.back()-time);
+            for(size_t j = 0; j < _vvelocitydofs.size(); ++j) {
+                if( _vvelocitydofs[j] ) {
+                    data[j] = -data[j];
+                }
+            }
+        }
+        else {
+            _psource->Sample(data, _starttime+time);
+        }
+        if( _timeoffset >= 0 ) {
+            data.at(_timeoffset) = time-_vaccumtime[index-1];
+        }
+    }
+
+    const ConfigurationSpecification& GetConfigurationSpecification() const
+    {
+        return !!_pmaterialized ? _pmaterialized->GetConfigurationSpecification() : _spec;
+    }
+
+    size_t GetNumWaypoints() const
+    {
+        return !!_pmaterialized ? _pmaterialized->GetNumWaypoints() : _vaccumtime.size();
+    }
+
+    void GetWaypoints(size_t startindex, size_t endindex, std::vector<dReal>& data) const
+    {
+        if( !!_pmaterialized ) {
+            _pmaterialized->GetWaypoints(startindex, endindex, data);
+            return;
+        }
+        BOOST_ASSERT(startindex <= endindex && endindex <= _vaccumtime.size());
+        int dof = _spec.GetDOF();
+        data.resize((endindex-startindex)*dof);
+        if( startindex == endindex ) {
+            return;
+        }
+        if( _bReverse ) {
+            _GetReverseWaypoints(startindex, endindex, data);
+        }
+        else {
+            _GetSegmentWaypoints(startindex, endindex, data);
+        }
+    }
+
+    const dReal* GetWaypointsData(size_t startindex) const
+    {
+        return !!_pmaterialized ? _pmaterialized->GetWaypointsData(startindex) : NULL;
+    }
+
+    size_t GetFirstWaypointIndexAfterTime(dReal time) const
+    {
+        if( !!_pmaterialized ) {
+            return _pmaterialized->GetFirstWaypointIndexAfterTime(time);
+        }
+        if( _vaccumtime.size() == 0 || time < _vaccumtime.front() ) {
+            return 0;
+        }
+        if( time >= _vaccumtime.back() ) {
+            return _vaccumtime.size();
+        }
+        return lower_bound(_vaccumtime.begin(), _vaccumtime.end(), time) - _vaccumtime.begin();
+    }
+
+    dReal GetDuration() const
+    {
+        if( !!_pmaterialized ) {
+            return _pmaterialized->GetDuration();
+        }
+        return _vaccumtime.size() > 0 ? _vaccumtime.back() : 0;
+    }
+
+protected:
+    /// \brief reads the specification and the accumulated times of the source
+    void _Init()
+    {
+        _spec = _psource->GetConfigurationSpecification();
+        _timeoffset = -1;
+        FOREACHC(itgroup, _spec._vgroups) {
+            if( itgroup->name == "deltatime" ) {
+                _timeoffset = itgroup->offset;
+            }
+        }
+        ConfigurationSpecification deltatimespec;
+        deltatimespec.AddDeltaTimeGroup();
+        _psource->GetWaypoints(0, _psource->GetNumWaypoints(), _vsourceaccumtime, deltatimespec);
+        for(size_t i = 1; i < _vsourceaccumtime.size(); ++i) {
+            _vsourceaccumtime[i] += _vsourceaccumtime[i-1];
+        }
+        SetDescription(_psource->GetDescription());
+    }
+
+    /// \brief copies the view into a new trajectory so that it can be modified
+    void _Materialize()
+    {
+        if( !!_pmaterialized ) {
+            return;
+        }
+        TrajectoryBasePtr ptraj = RaveCreateTrajectory(GetEnv(), _psource->GetXMLId());
+        ptraj->Init(_spec);
+        std::vector<dReal> data;
+        GetWaypoints(0, _vaccumtime.size(), data);
+        ptraj->Insert(0, data);
+        _pmaterialized = ptraj;
+        _psource.reset();
+    }
+
+    void _GetSegmentWaypoints(size_t startindex, size_t endindex, std::vector<dReal>& data) const
+    {
+        int dof = _spec.GetDOF();
+        size_t nummiddle = _vaccumtime.size() - (_endtime > _starttime ? 2 : 1);
+        // the source waypoints inside the segment are read with one call
+        size_t middlestart = max(startindex, size_t(1)), middleend = min(endindex, nummiddle+1);
+        if( middlestart < middleend ) {
+            _psource->GetWaypoints(_startindex+middlestart-1, _startindex+middleend-1, _vtempdata);
+            std::copy(_vtempdata.begin(), _vtempdata.end(), data.begin()+(middlestart-startindex)*dof);
         }
-        else if( itgroup->name == "deltatime" ) {
-            timeoffset = itgroup->offset;
+        if( startindex == 0 ) {
+            _psource->Sample(_vtempdata, _starttime);
+            std::copy(_vtempdata.begin(), _vtempdata.end(), data.begin());
+        }
+        if( endindex == _vaccumtime.size() && _endtime > _starttime ) {
+            _psource->Sample(_vtempdata, _endtime);
+            std::copy(_vtempdata.begin(), _vtempdata.end(), data.end()-dof);
+        }
+        if( _timeoffset >= 0 ) {
+            for(size_t i = startindex; i < endindex; ++i) {
+                // the waypoints strictly inside keep their own deltatime
+                if( i == 0 || i == 1 || i > nummiddle ) {
+                    data[(i-startindex)*dof+_timeoffset] = i > 0 ? _vaccumtime[i]-_vaccumtime[i-1] : 0;
+                }
+            }
         }
     }
-    sourcetraj->GetWaypoints(0,numpoints,sourcedata);
-    vector<dReal> targetdata(sourcedata.size());
-    dReal prevdeltatime = 0;
-    for(size_t i = 0; i < numpoints; ++i) {
-        vector<dReal>::iterator ittarget = targetdata.begin()+i*dof;
-        vector<dReal>::iterator itsource = sourcedata.begin()+(numpoints-i-1)*dof;
-        for(int j = 0; j < dof; ++j) {
-            if( velocitydofs[j] ) {
-                if( velocitynextinterp[j] ) {
-                    if( i < numpoints-1 ) {
-                        *(ittarget+j+dof) = -*(itsource+j);
-                    }
-                    else {
-                        targetdata.at(j) = 0;
-                    }
+
+    void _GetReverseWaypoints(size_t startindex, size_t endindex, std::vector<dReal>& data) const
+    {
+        int dof = _spec.GetDOF();
+        size_t numpoints = _vaccumtime.size();
+        // view waypoint i comes from source waypoint numpoints-1-i, the velocities interpolated with next and the deltatime come from the source waypoint after it
+        size_t sourcestart = numpoints-endindex, sourceend = min(numpoints, numpoints-startindex+1);
+        _psource->GetWaypoints(sourcestart, sourceend, _vtempdata);
+        for(size_t i = startindex; i < endindex; ++i) {
+            std::vector<dReal>::iterator ittarget = data.begin()+(i-startindex)*dof;
+            std::vector<dReal>::const_iterator itsource = _vtempdata.begin()+(numpoints-1-i-sourcestart)*dof;
+            for(int j = 0; j < dof; ++j) {
+                if( _vnextvelocitydofs[j] ) {
+                    *(ittarget+j) = i > 0 ? -*(itsource+dof+j) : 0;
                 }
-                else {
+                else if( _vvelocitydofs[j] ) {
                     *(ittarget+j) = -*(itsource+j);
                 }
+                else {
+                    *(ittarget+j) = *(itsource+j);
+                }
             }
-            else {
-                *(ittarget+j) = *(itsource+j);
+            if( _timeoffset >= 0 ) {
+                *(ittarget+_timeoffset) = i > 0 ? *(itsource+dof+_timeoffset) : 0;
             }
         }
-
-        if( timeoffset >= 0 ) {
-            *(ittarget+timeoffset) = prevdeltatime;
-            prevdeltatime = *(itsource+timeoffset);
-        }
     }
 
+    TrajectoryBaseConstPtr _psource; ///< reset once the view is materialized
+    TrajectoryBasePtr _pmaterialized; ///< the copy of the view every call is forwarded to after the first modification
+    ConfigurationSpecification _spec;
+    int _timeoffset;
+    bool _bReverse;
+    dReal _starttime, _endtime; ///< the segment in the times of the source
+    size_t _startindex; ///< index of the first source waypoint strictly after _starttime
+    std::vector<dReal> _vsourceaccumtime; ///< accumulated times of the source waypoints
+    std::vector<dReal> _vaccumtime; ///< accumulated times of the view waypoints
+    std::vector<uint8_t> _vvelocitydofs, _vnextvelocitydofs; ///< the dofs that are negated when reversing, and the ones interpolated with next that are also shifted by one waypoint
+    mutable std::vector<dReal> _vtempdata;
+};
+
+TrajectoryBasePtr GetReverseTrajectory(TrajectoryBaseConstPtr sourcetraj)
+{
     TrajectoryBasePtr traj = RaveCreateTrajectory(sourcetraj->GetEnv(),sourcetraj->GetXMLId());
-    traj->Init(sourcetraj->GetConfigurationSpecification());
-    traj->Insert(0,targetdata);
-    traj->SetDescription(sourcetraj->GetDescription());
+    traj->Clone(GetReverseTrajectoryView(sourcetraj),0);
     return traj;
 }
 
+TrajectoryBasePtr GetReverseTrajectoryView(TrajectoryBaseConstPtr sourcetraj)
+{
+    return TrajectoryBasePtr(new TrajectoryView(sourcetraj));
+}
+
 TrajectoryBasePtr ReverseTrajectory(TrajectoryBasePtr sourcetraj)
 {
     // might need to change to in-memory reverse...
@@ -1755,48 +2325,14 @@ void SegmentTrajectory(TrajectoryBasePtr traj, dReal starttime, dReal endtime)
 
 TrajectoryBasePtr GetTrajectorySegment(TrajectoryBaseConstPtr traj, dReal starttime, dReal endtime)
 {
-    std::vector<dReal> values;
-    const ConfigurationSpecification& spec = traj->GetConfigurationSpecification();
     TrajectoryBasePtr outtraj = RaveCreateTrajectory(traj->GetEnv(), traj->GetXMLId());
-    outtraj->Init(spec);
-
-    // TODO
-//    size_t startindex = 0;
-//    if( starttime > 0 ) {
-//        startindex = traj->GetFirstWaypointIndexAfterTime(starttime);
-//        if( startindex > 0 ) {
-//            ConfigurationSpecification deltatimespec;
-//            deltatimespec.AddDeltaTimeGroup();
-//            std::vector<dReal> vdeltatime;
-//            traj->GetWaypoint(startindex,vdeltatime,deltatimespec);
-//            traj->Sample(values, starttime);
-//            dReal fSampleDeltaTime=0;
-//            spec.ExtractDeltaTime(fSampleDeltaTime, values.begin());
-//
-//            // have to set deltatime to 0 and insert values
-//            spec.InsertDeltaTime(values.begin(), 0);
-//            traj.Insert(0, values);
-//
-//            // check if the sampletime can be very close to an existing waypoint, in which case can ignore inserting a new point
-//            if( RaveFabs(fSampleDeltaTime-vdeltatime.at(0)) > g_fEpsilonLinear ) {
-//                // have to insert a new point
-//                vdeltatime[0] -= fSampleDeltaTime;
-//                traj->Insert(startindex, vdeltatime, deltatimespec, true);
-//                endremoveindex -= 1;
-//            }
-//        }
-//    }
-//
-//    std::vector<dReal> values;
-//    if( endtime < traj->GetDuration() ) {
-//        size_t endindex = traj->GetFirstWaypointIndexAfterTime(endtime);
-//        if( endindex < traj->GetNumWaypoints() ) {
-//            traj->Sample(values, endtime);
-//            traj->Insert(endindex, values, true);
-//            traj->Remove(endindex+1, traj->GetNumWaypoints());
-//        }
-//    }
-    return TrajectoryBasePtr();
+    outtraj->Clone(GetTrajectorySegmentView(traj, starttime, endtime),0);
+    return outtraj;
+}
+
+TrajectoryBasePtr GetTrajectorySegmentView(TrajectoryBaseConstPtr traj, dReal starttime, dReal endtime)
+{
+    return TrajectoryBasePtr(new TrajectoryView(traj, starttime, endtime));
 }
 
 TrajectoryBasePtr MergeTrajectories(const std::list<TrajectoryBaseConstPtr>& listtrajectories)
@@ -1814,26 +2350,29 @@ TrajectoryBasePtr MergeTrajectories(const std::list<TrajectoryBaseConstPtr>& lis
 
     ConfigurationSpecification spec;
     vector<dReal> vpointdata;
-    vector<dReal> vtimes; vtimes.reserve(listtrajectories.front()->GetNumWaypoints());
+    vector<dReal> vtimes, vdeltatimes;
+    ConfigurationSpecification deltatimespec;
+    deltatimespec.AddDeltaTimeGroup();
     int totaldof = 1; // for delta time
     FOREACHC(ittraj,listtrajectories) {
         const ConfigurationSpecification& trajspec = (*ittraj)->GetConfigurationSpecification();
-        ConfigurationSpecification::Group gtime = trajspec.GetGroupFromName("deltatime");
+        // throws if there is no deltatime group
+        trajspec.GetGroupFromName("deltatime");
         spec += trajspec;
         totaldof += trajspec.GetDOF()-1;
         if( trajspec.FindCompatibleGroup("iswaypoint",true) != trajspec._vgroups.end() ) {
             totaldof -= 1;
         }
+        // only read the deltatime of the waypoints
+        (*ittraj)->GetWaypoints(0,(*ittraj)->GetNumWaypoints(),vdeltatimes,deltatimespec);
         dReal curtime = 0;
-        for(size_t ipoint = 0; ipoint < (*ittraj)->GetNumWaypoints(); ++ipoint) {
-            (*ittraj)->GetWaypoint(ipoint,vpointdata);
-            curtime += vpointdata.at(gtime.offset);
-            vector<dReal>::iterator it = lower_bound(vtimes.begin(),vtimes.end(),curtime);
-            if( *it != curtime ) {
-                vtimes.insert(it,curtime);
-            }
+        FOREACHC(itdeltatime,vdeltatimes) {
+            curtime += *itdeltatime;
+            vtimes.push_back(curtime);
         }
     }
+    sort(vtimes.begin(),vtimes.end());
+    vtimes.erase(unique(vtimes.begin(),vtimes.end()),vtimes.end());
 
     vector<ConfigurationSpecification::Group>::const_iterator itwaypointgroup = spec.FindCompatibleGroup("iswaypoint",true);
     vector<dReal> vwaypoints;
@@ -1853,7 +2392,7 @@ TrajectoryBasePtr MergeTrajectories(const std::list<TrajectoryBaseConstPtr>& lis
     }
 
     // need to find all waypoints
-    vector<dReal> vtemp, vnewdata;
+    vector<dReal> vnewdata;
     stringstream sdesc;
     int deltatimeoffset = spec.GetGroupFromName("deltatime").offset;
     FOREACHC(ittraj,listtrajectories) {
@@ -1862,23 +2401,21 @@ TrajectoryBasePtr MergeTrajectories(const std::list<TrajectoryBaseConstPtr>& lis
         if( itwaypointgrouptraj != (*ittraj)->GetConfigurationSpecification()._vgroups.end() ) {
             waypointoffset = itwaypointgrouptraj->offset;
         }
+        // sample all the times at once, the first trajectory fills the groups of the other trajectories with their default values
         if( vnewdata.size() == 0 ) {
-            vnewdata.reserve(vtimes.size()*spec.GetDOF());
-            for(size_t i = 0; i < vtimes.size(); ++i) {
-                (*ittraj)->Sample(vtemp,vtimes[i],spec);
-                vnewdata.insert(vnewdata.end(),vtemp.begin(),vtemp.end());
-                if( waypointoffset >= 0 ) {
-                    vwaypoints[i] += vtemp[itwaypointgroup->offset]; // have to use the final spec's offset
+            (*ittraj)->SamplePoints(vnewdata,vtimes,spec);
+            if( waypointoffset >= 0 ) {
+                for(size_t i = 0; i < vtimes.size(); ++i) {
+                    vwaypoints[i] += vnewdata[i*spec.GetDOF()+itwaypointgroup->offset]; // have to use the final spec's offset
                 }
             }
         }
         else {
-            vpointdata.resize(0);
-            for(size_t i = 0; i < vtimes.size(); ++i) {
-                (*ittraj)->Sample(vtemp,vtimes[i]);
-                vpointdata.insert(vpointdata.end(),vtemp.begin(),vtemp.end());
-                if( waypointoffset >= 0 ) {
-                    vwaypoints[i] += vtemp[itwaypointgroup->offset]; // have to use the final spec's offset
+            (*ittraj)->SamplePoints(vpointdata,vtimes);
+            if( waypointoffset >= 0 ) {
+                int trajdof = (*ittraj)->GetConfigurationSpecification().GetDOF();
+                for(size_t i = 0; i < vtimes.size(); ++i) {
+                    vwaypoints[i] += vpointdata[i*trajdof+itwaypointgroup->offset]; // have to use the final spec's offset
                 }
             }
             ConfigurationSpecification::ConvertData(vnewdata.begin(),spec,vpointdata.begin(),(*ittraj)->GetConfigurationSpecification(),vtimes.size(),presulttraj->GetEnv(),false);
@@ -1994,7 +2531,7 @@ void GetDHParameters(std::vector<DHParameter>& vparameters, KinBodyConstPtr pbod
     }
 }
 
-DynamicsCollisionConstraint::DynamicsCollisionConstraint(PlannerBase::PlannerParametersConstPtr parameters, const std::list<KinBodyPtr>& listCheckBodies, int filtermask) : _listCheckBodies(listCheckBodies), _filtermask(filtermask), _torquelimitmode(0), _perturbation(0.1)
+DynamicsCollisionConstraint::DynamicsCollisionConstraint(PlannerBase::PlannerParametersConstPtr parameters, const std::list<KinBodyPtr>& listCheckBodies, int filtermask) : _listCheckBodies(listCheckBodies), _filtermask(filtermask), _torquelimitmode(0), _perturbation(0.1), _bsweptconfigsupported(false), _bsweptlinkreachessupported(false)
 {
     BOOST_ASSERT(listCheckBodies.size()>0);
     _report.reset(new CollisionReport());
@@ -2008,6 +2545,7 @@ DynamicsCollisionConstraint::DynamicsCollisionConstraint(PlannerBase::PlannerPar
 void DynamicsCollisionConstraint::SetPlannerParameters(PlannerBase::PlannerParametersConstPtr parameters)
 {
     _parameters = parameters;
+    _vsweptconfigdofindices.resize(0);
     if( !!parameters ) {
         _specvel = parameters->_configurationspecification.ConvertToVelocitySpecification();
         _setvelstatefn = _specvel.GetSetFn(_listCheckBodies.front()->GetEnv());
@@ -2036,6 +2574,9 @@ void DynamicsCollisionConstraint::SetPerturbation(dReal perturbation)
 
 int DynamicsCollisionConstraint::_SetAndCheckState(PlannerBase::PlannerParametersConstPtr params, const std::vector<dReal>& vdofvalues, const std::vector<dReal>& vdofvelocities, const std::vector<dReal>& vdofaccels, int options, ConstraintFilterReturnPtr filterreturn)
 {
+    if( !!filterreturn ) {
+        filterreturn->_numcheckedconfigurations++;
+    }
     if( params->SetStateValues(vdofvalues, 0) != 0 ) {
         return CFO_StateSettingError;
     }
@@ -2167,6 +2708,334 @@ int DynamicsCollisionConstraint::_CheckState(const std::vector<dReal>& vdofveloc
     return 0;
 }
 
+int DynamicsCollisionConstraint::_CheckBisection(PlannerBase::PlannerParametersConstPtr params, const std::vector<dReal>& q0, const std::vector<dReal>& dq0, dReal timeelapsed, int numSteps, int options, ConstraintFilterReturnPtr filterreturn)
+{
+    const std::vector<dReal>& vConfigResolution = params->_vConfigResolution;
+    bool bQuadratic = timeelapsed > 0 && dq0.size() == q0.size() && _vtempaccelconfig.size() == q0.size();
+    if( bQuadratic ) {
+        // sample uniformly in time. the velocity is linear, so its max magnitude is at one of the ends
+        for(size_t i = 0; i < q0.size(); ++i) {
+            dReal fmaxvel = max(RaveFabs(dq0[i]), RaveFabs(dq0[i] + timeelapsed*_vtempaccelconfig[i]));
+            dReal fdist = fmaxvel*timeelapsed;
+            int steps = vConfigResolution[i] != 0 ? (int)(fdist / vConfigResolution[i] + 0.99) : (int)(fdist * 100);
+            if( steps > numSteps ) {
+                numSteps = steps;
+            }
+        }
+    }
+
+    _vtempveldelta.resize(_vtempvelconfig.size()); // dq1 might not have been given, in which case the velocity stays at dq0
+    _vprevtempconfig.resize(q0.size());
+    dReal fisteps = dReal(1.0)/numSteps;
+    int nstride = 1;
+    while(nstride < numSteps) {
+        nstride <<= 1;
+    }
+    // visit the odd multiples of each stride, so that every step in [1,numSteps) is checked once and the middle ones first
+    for(; nstride >= 1; nstride >>= 1) {
+        for(int istep = nstride; istep < numSteps; istep += 2*nstride) {
+            dReal t = istep*fisteps;
+            if( bQuadratic ) {
+                t *= timeelapsed;
+                for(size_t i = 0; i < q0.size(); ++i) {
+                    _vprevtempconfig[i] = t*(dq0[i] + 0.5*t*_vtempaccelconfig[i]);
+                    _vtempvelconfig[i] = dq0[i] + t*_vtempaccelconfig[i];
+                }
+            }
+            else {
+                for(size_t i = 0; i < q0.size(); ++i) {
+                    _vprevtempconfig[i] = t*dQ[i];
+                }
+                for(size_t i = 0; i < _vtempvelconfig.size(); ++i) {
+                    _vtempvelconfig[i] = dq0[i] + t*_vtempveldelta[i];
+                }
+            }
+            _vtempconfig = q0;
+            if( !params->_neighstatefn(_vtempconfig, _vprevtempconfig, NSO_OnlyHardConstraints) ) {
+                if( !!filterreturn ) {
+                    filterreturn->_returncode = CFO_StateSettingError;
+                }
+                return CFO_StateSettingError;
+            }
+            int nstateret = _SetAndCheckState(params, _vtempconfig, _vtempvelconfig, _vtempaccelconfig, options, filterreturn);
+            if( nstateret != 0 ) {
+                if( !!filterreturn ) {
+                    filterreturn->_returncode = nstateret;
+                    filterreturn->_invalidvalues = _vtempconfig;
+                    filterreturn->_invalidvelocities = _vtempvelconfig;
+                    filterreturn->_fTimeWhenInvalid = t;
+                }
+                return nstateret;
+            }
+        }
+    }
+    return 0;
+}
+
+static inline bool _IsAABBOverlapping(const AABB& ab0, const AABB& ab1)
+{
+    return RaveFabs(ab0.pos.x-ab1.pos.x) <= ab0.extents.x+ab1.extents.x && RaveFabs(ab0.pos.y-ab1.pos.y) <= ab0.extents.y+ab1.extents.y && RaveFabs(ab0.pos.z-ab1.pos.z) <= ab0.extents.z+ab1.extents.z;
+}
+
+/// \brief resets the link reaches of DynamicsCollisionConstraint::_IsSweptBoundFree when the body changes
+static void _ResetSweptLinkReaches(std::vector< std::vector< std::pair<int, dReal> > >* pvsweptlinkreaches)
+{
+    pvsweptlinkreaches->resize(0);
+}
+
+bool DynamicsCollisionConstraint::_ComputeSweptLinkReaches(KinBodyPtr pbody)
+{
+    // walk the chain of every link back to the root and accumulate the distances between the joint anchors. The distance between the anchors of
+    // two consecutive revolute joints is the same in all configurations, a prismatic joint can change it by at most its range.
+    _vsweptlinkreaches.resize(pbody->GetLinks().size());
+    std::vector<KinBody::JointPtr> vchain;
+    FOREACHC(itlink, pbody->GetLinks()) {
+        std::vector< std::pair<int, dReal> >& vreaches = _vsweptlinkreaches.at((*itlink)->GetIndex());
+        vreaches.resize(0);
+        if( (*itlink)->GetIndex() == 0 || !pbody->GetChain(0, (*itlink)->GetIndex(), vchain) ) {
+            continue;
+        }
+        AABB alocal = (*itlink)->ComputeLocalAABB();
+        Vector vprevpos = (*itlink)->GetTransform()*alocal.pos;
+        dReal freach = RaveSqrt(alocal.extents.lengthsqr3());
+        for(std::vector<KinBody::JointPtr>::reverse_iterator itjoint = vchain.rbegin(); itjoint != vchain.rend(); ++itjoint) {
+            KinBody::JointPtr pjoint = *itjoint;
+            if( pjoint->IsMimic() ) {
+                return false;
+            }
+            if( pjoint->GetDOFIndex() < 0 ) {
+                continue; // static
+            }
+            if( pjoint->GetDOF() != 1 ) {
+                return false;
+            }
+            Vector vanchor = pjoint->GetAnchor();
+            freach += RaveSqrt((vprevpos-vanchor).lengthsqr3());
+            vprevpos = vanchor;
+            if( pjoint->IsRevolute(0) ) {
+                vreaches.push_back(std::make_pair(pjoint->GetDOFIndex(), freach));
+            }
+            else if( pjoint->IsPrismatic(0) ) {
+                vreaches.push_back(std::make_pair(pjoint->GetDOFIndex(), dReal(1)));
+                std::vector<dReal> vlower, vupper;
+                pjoint->GetLimits(vlower, vupper);
+                freach += vupper.at(0) - vlower.at(0);
+            }
+            else {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool DynamicsCollisionConstraint::_PrepareSweptLinkReaches(PlannerBase::PlannerParametersConstPtr params, const std::vector<dReal>& q0)
+{
+    if( _listCheckBodies.size() != 1 ) {
+        return false;
+    }
+    KinBodyPtr pbody = _listCheckBodies.front();
+    if( pbody->HasAttached() ) {
+        return false;
+    }
+    if( _vsweptconfigdofindices.size() == 0 ) {
+        // the configuration has to consist of only joint values of the body
+        _vsweptconfigdofindices.resize(params->GetDOF(), -1);
+        _bsweptconfigsupported = true;
+        FOREACHC(itgroup, params->_configurationspecification._vgroups) {
+            std::stringstream ss(itgroup->name);
+            std::string grouptype, bodyname;
+            ss >> grouptype >> bodyname;
+            if( grouptype != "joint_values" || bodyname != pbody->GetName() ) {
+                _bsweptconfigsupported = false;
+                break;
+            }
+            for(int i = 0; i < itgroup->dof; ++i) {
+                ss >> _vsweptconfigdofindices.at(itgroup->offset+i);
+            }
+        }
+        if( !!std::count(_vsweptconfigdofindices.begin(), _vsweptconfigdofindices.end(), -1) ) {
+            _bsweptconfigsupported = false;
+        }
+    }
+    if( !_bsweptconfigsupported ) {
+        return false;
+    }
+    if( params->SetStateValues(q0, 0) != 0 ) {
+        return false;
+    }
+    if( _vsweptlinkreaches.size() == 0 ) {
+        _bsweptlinkreachessupported = _ComputeSweptLinkReaches(pbody);
+        _vsweptlinkreaches.resize(pbody->GetLinks().size()); // keep it set even if not supported
+        _sweptbodycallback = pbody->RegisterChangeCallback(KinBody::Prop_LinkGeometry|KinBody::Prop_LinkGeometryGroup|KinBody::Prop_Joints, boost::bind(_ResetSweptLinkReaches, &_vsweptlinkreaches));
+    }
+    return _bsweptlinkreachessupported;
+}
+
+bool DynamicsCollisionConstraint::_IsSweptBoundFree(PlannerBase::PlannerParametersConstPtr params, const std::vector<dReal>& q0, const std::vector<dReal>& dq0, dReal timeelapsed, dReal fperturbation)
+{
+    if( !_PrepareSweptLinkReaches(params, q0) ) {
+        return false;
+    }
+    KinBodyPtr pbody = _listCheckBodies.front();
+
+    // the distance every dof travels over the segment, the quadratic can change direction once
+    bool bQuadratic = timeelapsed > 0 && dq0.size() == q0.size() && _vtempaccelconfig.size() == q0.size();
+    _vsweptdoftravel.resize(pbody->GetDOF());
+    std::fill(_vsweptdoftravel.begin(), _vsweptdoftravel.end(), dReal(0));
+    for(size_t i = 0; i < q0.size(); ++i) {
+        dReal ftravel = RaveFabs(dQ.at(i));
+        if( bQuadratic && RaveFabs(_vtempaccelconfig[i]) > g_fEpsilonLinear ) {
+            dReal inflectiontime = -dq0[i] / _vtempaccelconfig[i];
+            if( inflectiontime >= 0 && inflectiontime < timeelapsed ) {
+                dReal inflectionpoint = 0.5*dq0[i]*inflectiontime;
+                ftravel = RaveFabs(inflectionpoint) + RaveFabs(dQ[i]-inflectionpoint);
+            }
+        }
+        _vsweptdoftravel.at(_vsweptconfigdofindices[i]) += ftravel + fperturbation*params->_vConfigResolution.at(i);
+    }
+
+    // every point of a link moves at most sum(travel*reach) of the dofs moving it
+    _vsweptlinkaabbs.resize(0);
+    FOREACHC(itlink, pbody->GetLinks()) {
+        if( !(*itlink)->IsEnabled() || (*itlink)->GetGeometries().size() == 0 ) {
+            continue;
+        }
+        AABB ab = (*itlink)->ComputeAABB();
+        dReal fdist = 0;
+        FOREACHC(itreach, _vsweptlinkreaches.at((*itlink)->GetIndex())) {
+            fdist += _vsweptdoftravel.at(itreach->first)*itreach->second;
+        }
+        ab.extents += Vector(fdist, fdist, fdist);
+        _vsweptlinkaabbs.push_back(ab);
+    }
+
+    pbody->GetEnv()->ComputeBodiesAABB(_vsweptbodies, _vsweptbodyaabbs);
+    for(size_t ibody = 0; ibody < _vsweptbodies.size(); ++ibody) {
+        const KinBodyPtr& potherbody = _vsweptbodies[ibody];
+        if( potherbody == pbody || !potherbody->IsEnabled() ) {
+            continue;
+        }
+        FOREACHC(itab, _vsweptlinkaabbs) {
+            if( !_IsAABBOverlapping(*itab, _vsweptbodyaabbs[ibody]) ) {
+                continue;
+            }
+            // check the links of the body before giving up
+            FOREACHC(itotherlink, potherbody->GetLinks()) {
+                if( (*itotherlink)->IsEnabled() && (*itotherlink)->GetGeometries().size() > 0 && _IsAABBOverlapping(*itab, (*itotherlink)->ComputeAABB()) ) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+int DynamicsCollisionConstraint::_CheckClearanceAdaptive(PlannerBase::PlannerParametersConstPtr params, const std::vector<dReal>& q0, const std::vector<dReal>& dq0, dReal timeelapsed, int numSteps, int options, ConstraintFilterReturnPtr filterreturn, bool& bsupported)
+{
+    bsupported = false;
+    if( !_PrepareSweptLinkReaches(params, q0) ) {
+        return 0;
+    }
+    KinBodyPtr pbody = _listCheckBodies.front();
+    CollisionCheckerBasePtr pchecker = pbody->GetEnv()->GetCollisionChecker();
+    if( !pchecker ) {
+        return 0;
+    }
+
+    // the path parameter is the time for quadratic segments and the fraction of the segment otherwise. the velocity of a quadratic is linear, so its max magnitude is at one of the ends
+    bool bQuadratic = timeelapsed > 0 && dq0.size() == q0.size() && _vtempaccelconfig.size() == q0.size();
+    dReal fduration = bQuadratic ? timeelapsed : dReal(1);
+    dReal fperturbation = (options & CFO_CheckWithPerturbation) ? _perturbation : dReal(0);
+    _vclearancedofspeeds.resize(pbody->GetDOF());
+    std::fill(_vclearancedofspeeds.begin(), _vclearancedofspeeds.end(), dReal(0));
+    _vclearancedofperturbations.resize(pbody->GetDOF());
+    std::fill(_vclearancedofperturbations.begin(), _vclearancedofperturbations.end(), dReal(0));
+    for(size_t i = 0; i < q0.size(); ++i) {
+        dReal fspeed = bQuadratic ? max(RaveFabs(dq0[i]), RaveFabs(dq0[i] + timeelapsed*_vtempaccelconfig[i])) : RaveFabs(dQ.at(i));
+        _vclearancedofspeeds.at(_vsweptconfigdofindices[i]) += fspeed;
+        _vclearancedofperturbations.at(_vsweptconfigdofindices[i]) += fperturbation*params->_vConfigResolution.at(i);
+    }
+
+    // every point of a link moves at most sum(speed*reach) of the dofs moving it
+    dReal fmaxspeed = 0, fperturbationdist = 0;
+    FOREACHC(itlink, pbody->GetLinks()) {
+        if( !(*itlink)->IsEnabled() || (*itlink)->GetGeometries().size() == 0 ) {
+            continue;
+        }
+        dReal fspeed = 0, fdist = 0;
+        FOREACHC(itreach, _vsweptlinkreaches.at((*itlink)->GetIndex())) {
+            fspeed += _vclearancedofspeeds.at(itreach->first)*itreach->second;
+            fdist += _vclearancedofperturbations.at(itreach->first)*itreach->second;
+        }
+        fmaxspeed = max(fmaxspeed, fspeed);
+        fperturbationdist = max(fperturbationdist, fdist);
+    }
+    if( fmaxspeed <= 0 ) {
+        return 0;
+    }
+
+    int envoptions = options & (CFO_CheckEnvCollisions|CFO_CheckWithPerturbation|CFO_FillCollisionReport);
+    dReal fminstep = fduration/numSteps;
+    _vtempveldelta.resize(_vtempvelconfig.size()); // dq1 might not have been given, in which case the velocity stays at dq0
+    _vprevtempconfig.resize(q0.size());
+    dReal t = 0;
+    while( t < fduration ) {
+        if( bQuadratic ) {
+            for(size_t i = 0; i < q0.size(); ++i) {
+                _vprevtempconfig[i] = t*(dq0[i] + 0.5*t*_vtempaccelconfig[i]);
+                _vtempvelconfig[i] = dq0[i] + t*_vtempaccelconfig[i];
+            }
+        }
+        else {
+            for(size_t i = 0; i < q0.size(); ++i) {
+                _vprevtempconfig[i] = t*dQ[i];
+            }
+            for(size_t i = 0; i < _vtempvelconfig.size(); ++i) {
+                _vtempvelconfig[i] = dq0[i] + t*_vtempveldelta[i];
+            }
+        }
+        _vtempconfig = q0;
+        if( !params->_neighstatefn(_vtempconfig, _vprevtempconfig, NSO_OnlyHardConstraints) || params->SetStateValues(_vtempconfig, 0) != 0 ) {
+            bsupported = true;
+            if( !!filterreturn ) {
+                filterreturn->_returncode = CFO_StateSettingError;
+            }
+            return CFO_StateSettingError;
+        }
+        if( !!filterreturn ) {
+            filterreturn->_numcheckedconfigurations++;
+        }
+        if( !pchecker->ComputeDistance(KinBodyConstPtr(pbody), _distancereport) ) {
+            // the checker does not support distance queries, so check at the regular resolution
+            bsupported = false;
+            return 0;
+        }
+        bsupported = true;
+        dReal fsafe = _distancereport.distance - fperturbationdist;
+        if( fsafe >= fmaxspeed*fminstep ) {
+            // no point of the body, perturbed or not, can reach the environment before t+fsafe/fmaxspeed
+            t += fsafe/fmaxspeed;
+            continue;
+        }
+        if( t > 0 ) {
+            // close to the environment, so check at the regular resolution
+            int nstateret = _SetAndCheckState(params, _vtempconfig, _vtempvelconfig, _vtempaccelconfig, envoptions, filterreturn);
+            if( nstateret != 0 ) {
+                if( !!filterreturn ) {
+                    filterreturn->_returncode = nstateret;
+                    filterreturn->_invalidvalues = _vtempconfig;
+                    filterreturn->_invalidvelocities = _vtempvelconfig;
+                    filterreturn->_fTimeWhenInvalid = t;
+                }
+                return nstateret;
+            }
+        }
+        t += fminstep;
+    }
+    return 0;
+}
+
 void DynamicsCollisionConstraint::_PrintOnFailure(const std::string& prefix)
 {
     if( IS_DEBUGLEVEL(Level_Verbose) ) {
@@ -2377,18 +3246,28 @@ int DynamicsCollisionConstraint::Check(const std::vector<dReal>& q0, const std::
     }
 
     if( !!filterreturn && (options & CFO_FillCheckedConfiguration) ) {
-        if( (int)filterreturn->_configurations.capacity() < (1+numSteps)*params->GetDOF() ) {
-            filterreturn->_configurations.reserve((1+numSteps)*params->GetDOF());
+        // reserve on top of what the caller already accumulated so that a recycled filterreturn never reallocates in the loop below
+        size_t nconfigurations = filterreturn->_configurations.size() + (1+numSteps)*params->GetDOF();
+        if( filterreturn->_configurations.capacity() < nconfigurations ) {
+            filterreturn->_configurations.reserve(nconfigurations);
         }
-        if( (int)filterreturn->_configurationtimes.capacity() < 1+numSteps) {
-            filterreturn->_configurationtimes.reserve(1+numSteps);
+        size_t ntimes = filterreturn->_configurationtimes.size() + 1 + numSteps;
+        if( filterreturn->_configurationtimes.capacity() < ntimes ) {
+            filterreturn->_configurationtimes.reserve(ntimes);
         }
     }
     if (start == 0 ) {
         int nstateret = _SetAndCheckState(params, q0, dq0, _vtempaccelconfig, maskoptions, filterreturn);
-        if( options & CFO_FillCheckedConfiguration ) {
-            filterreturn->_configurations.insert(filterreturn->_configurations.begin(), q0.begin(), q0.end());
-            filterreturn->_configurationtimes.insert(filterreturn->_configurationtimes.begin(), 0);
+        if( !!filterreturn && (options & CFO_FillCheckedConfiguration) ) {
+            if( filterreturn->_configurationtimes.size() == 0 ) {
+                // common case of a cleared filterreturn, so append rather than shift
+                filterreturn->_configurations.insert(filterreturn->_configurations.end(), q0.begin(), q0.end());
+                filterreturn->_configurationtimes.push_back(0);
+            }
+            else {
+                filterreturn->_configurations.insert(filterreturn->_configurations.begin(), q0.begin(), q0.end());
+                filterreturn->_configurationtimes.insert(filterreturn->_configurationtimes.begin(), 0);
+            }
         }
         if( nstateret != 0 ) {
             if( !!filterreturn ) {
@@ -2412,6 +3291,33 @@ int DynamicsCollisionConstraint::Check(const std::vector<dReal>& q0, const std::
         return 0;
     }
 
+    if( (options & CFO_SweptBoundCulling) && (maskoptions & CFO_CheckEnvCollisions) && !(options & CFO_FillCheckedConfiguration) ) {
+        if( _IsSweptBoundFree(params, q0, dq0, timeelapsed, (maskoptions & CFO_CheckWithPerturbation) ? _perturbation : dReal(0)) ) {
+            maskoptions &= ~CFO_CheckEnvCollisions;
+            if( !(maskoptions & (CFO_CheckSelfCollisions|CFO_CheckTimeBasedConstraints|CFO_CheckUserConstraints)) ) {
+                return 0;
+            }
+        }
+    }
+
+    if( (options & CFO_ClearanceAdaptiveSteps) && (maskoptions & CFO_CheckEnvCollisions) && !(options & CFO_FillCheckedConfiguration) ) {
+        bool bsupported = false;
+        int nstateret = _CheckClearanceAdaptive(params, q0, dq0, timeelapsed, numSteps, maskoptions, filterreturn, bsupported);
+        if( nstateret != 0 ) {
+            return nstateret;
+        }
+        if( bsupported ) {
+            maskoptions &= ~CFO_CheckEnvCollisions;
+            if( !(maskoptions & (CFO_CheckSelfCollisions|CFO_CheckTimeBasedConstraints|CFO_CheckUserConstraints)) ) {
+                return 0;
+            }
+        }
+    }
+
+    if( (options & CFO_BisectionCheckOrder) && !(options & CFO_FillCheckedConfiguration) ) {
+        return _CheckBisection(params, q0, dq0, timeelapsed, numSteps, maskoptions, filterreturn);
+    }
+
     for (i = 0; i < params->GetDOF(); i++) {
         _vtempconfig.at(i) = q0.at(i);
     }
@@ -2721,20 +3627,21 @@ int DynamicsCollisionConstraint::Check(const std::vector<dReal>& q0, const std::
 
                 if( numPostNeighSteps > 1 ) {
                     RAVELOG_VERBOSE_FORMAT("have to divide the arc in %d steps post neigh, timestep=%f", numPostNeighSteps%timestep);
-                    // this case should be rare, so can create a vector here. don't look at constraints since we would never converge...
+                    // don't look at constraints since we would never converge...
                     // note that circular constraints would break here
-                    std::vector<dReal> vpostdq(_vtempconfig.size()), vpostddq(_vtempconfig.size());
+                    _vpostdq.resize(_vtempconfig.size());
+                    _vpostddq.resize(_vtempconfig.size());
                     dReal fiNumPostNeighSteps = 1/(dReal)numPostNeighSteps;
                     for(size_t i = 0; i < _vtempconfig.size(); ++i) {
-                        vpostdq[i] = (_vtempconfig[i] - _vprevtempconfig[i]) * fiNumPostNeighSteps;
-                        vpostddq[i] = (_vtempvelconfig[i] - _vprevtempvelconfig[i]) * fiNumPostNeighSteps;
+                        _vpostdq[i] = (_vtempconfig[i] - _vprevtempconfig[i]) * fiNumPostNeighSteps;
+                        _vpostddq[i] = (_vtempvelconfig[i] - _vprevtempvelconfig[i]) * fiNumPostNeighSteps;
                     }
 
                     // do only numPostNeighSteps-1 since the last step should be checked by _vtempconfig
                     for(int ipoststep = 0; ipoststep+1 < numPostNeighSteps; ++ipoststep) {
                         for(size_t i = 0; i < _vtempconfig.size(); ++i) {
-                            _vprevtempconfig[i] += vpostdq[i];
-                            _vprevtempvelconfig[i] += vpostddq[i]; // probably not right with the way interpolation works out, but it is a reasonable approximation
+                            _vprevtempconfig[i] += _vpostdq[i];
+                            _vprevtempvelconfig[i] += _vpostddq[i]; // probably not right with the way interpolation works out, but it is a reasonable approximation
                         }
 
                         int nstateret = _SetAndCheckState(params, _vprevtempconfig, _vprevtempvelconfig, _vtempaccelconfig, maskoptions, filterreturn);
@@ -2794,13 +3701,14 @@ int DynamicsCollisionConstraint::Check(const std::vector<dReal>& q0, const std::
             if( numPostNeighSteps > 1 ) {
                 // should never happen, but just in case _neighstatefn is some non-linear constraint projection
                 RAVELOG_WARN_FORMAT("have to divide the arc in %d steps even after original interpolation is done, timestep=%f", numPostNeighSteps%timestep);
-                // this case should be rare, so can create a vector here. don't look at constraints since we would never converge...
+                // don't look at constraints since we would never converge...
                 // note that circular constraints would break here
-                std::vector<dReal> vpostdq(_vtempconfig.size()), vpostddq(_vtempconfig.size());
+                _vpostdq.resize(_vtempconfig.size());
+                _vpostddq.resize(_vtempconfig.size());
                 dReal fiNumPostNeighSteps = 1/(dReal)numPostNeighSteps;
                 for(size_t i = 0; i < _vtempconfig.size(); ++i) {
-                    vpostdq[i] = (q1[i] - _vtempconfig[i]) * fiNumPostNeighSteps;
-                    vpostddq[i] = (dq1[i] - _vtempvelconfig[i]) * fiNumPostNeighSteps;
+                    _vpostdq[i] = (q1[i] - _vtempconfig[i]) * fiNumPostNeighSteps;
+                    _vpostddq[i] = (dq1[i] - _vtempvelconfig[i]) * fiNumPostNeighSteps;
                 }
 
                 _vprevtempconfig = _vtempconfig;
@@ -2808,8 +3716,8 @@ int DynamicsCollisionConstraint::Check(const std::vector<dReal>& q0, const std::
                 // do only numPostNeighSteps-1 since the last step should be checked by _vtempconfig
                 for(int ipoststep = 0; ipoststep+1 < numPostNeighSteps; ++ipoststep) {
                     for(size_t i = 0; i < _vtempconfig.size(); ++i) {
-                        _vprevtempconfig[i] += vpostdq[i];
-                        _vprevtempvelconfig[i] += vpostddq[i]; // probably not right with the way interpolation works out, but it is a reasonable approximation
+                        _vprevtempconfig[i] += _vpostdq[i];
+                        _vprevtempvelconfig[i] += _vpostddq[i]; // probably not right with the way interpolation works out, but it is a reasonable approximation
                     }
 
                     int nstateret = _SetAndCheckState(params, _vprevtempconfig, _vprevtempvelconfig, _vtempaccelconfig, maskoptions, filterreturn);
@@ -2921,14 +3829,16 @@ int DynamicsCollisionConstraint::Check(const std::vector<dReal>& q0, const std::
             if( numPostNeighSteps > 1 ) {
                 // should never happen, but just in case _neighstatefn is some non-linear constraint projection
                 RAVELOG_WARN_FORMAT("have to divide the arc in %d steps even after original interpolation is done, interval=%d", numPostNeighSteps%interval);
-                // this case should be rare, so can create a vector here. don't look at constraints since we would never converge...
+                // don't look at constraints since we would never converge...
                 // note that circular constraints would break here
-                std::vector<dReal> vpostdq(_vtempconfig.size()), vpostddq(dq1.size());
+                _vpostdq.resize(_vtempconfig.size());
+                _vpostddq.resize(dq1.size());
+                std::fill(_vpostddq.begin(), _vpostddq.end(), dReal(0));
                 dReal fiNumPostNeighSteps = 1/(dReal)numPostNeighSteps;
                 for(size_t i = 0; i < _vtempconfig.size(); ++i) {
-                    vpostdq[i] = (q1[i] - _vtempconfig[i]) * fiNumPostNeighSteps;
+                    _vpostdq[i] = (q1[i] - _vtempconfig[i]) * fiNumPostNeighSteps;
                     if( dq1.size() == _vtempconfig.size() && _vtempvelconfig.size() == _vtempconfig.size() ) {
-                        vpostddq[i] = (dq1[i] - _vtempvelconfig[i]) * fiNumPostNeighSteps;
+                        _vpostddq[i] = (dq1[i] - _vtempvelconfig[i]) * fiNumPostNeighSteps;
                     }
                 }
 
@@ -2937,11 +3847,11 @@ int DynamicsCollisionConstraint::Check(const std::vector<dReal>& q0, const std::
                 // do only numPostNeighSteps-1 since the last step should be checked by _vtempconfig
                 for(int ipoststep = 0; ipoststep+1 < numPostNeighSteps; ++ipoststep) {
                     for(size_t i = 0; i < _vtempconfig.size(); ++i) {
-                        _vprevtempconfig[i] += vpostdq[i];
+                        _vprevtempconfig[i] += _vpostdq[i];
                     }
-                    if( _vprevtempconfig.size() == _vtempconfig.size() && vpostddq.size() == _vtempconfig.size() ) {
+                    if( _vprevtempconfig.size() == _vtempconfig.size() && _vpostddq.size() == _vtempconfig.size() ) {
                         for(size_t i = 0; i < _vtempconfig.size(); ++i) {
-                            _vprevtempvelconfig[i] += vpostddq[i]; // probably not right with the way interpolation works out, but it is a reasonable approximation
+                            _vprevtempvelconfig[i] += _vpostddq[i]; // probably not right with the way interpolation works out, but it is a reasonable approximation
                         }
                     }
 
@@ -2992,6 +3902,85 @@ dReal SimpleDistanceMetric::Eval(const std::vector<dReal>& c0, const std::vector
     return RaveSqrt(dist);
 }
 
+ActiveDOFStateSpace::ActiveDOFStateSpace(RobotBasePtr robot) : _robot(robot)
+{
+    OPENRAVE_ASSERT_FORMAT(robot->GetAffineDOF() == 0, "robot %s has active affine dofs 0x%x", robot->GetName()%robot->GetAffineDOF(), ORE_InvalidArguments);
+    robot->GetActiveDOFWeights(_vweights2);
+    FOREACH(itweight, _vweights2) {
+        *itweight *= *itweight;
+    }
+    const std::vector<int>& vindices = robot->GetActiveDOFIndices();
+    for(size_t i = 0; i < vindices.size(); ++i) {
+        KinBody::JointPtr pjoint = robot->GetJointFromDOFIndex(vindices[i]);
+        int iaxis = vindices[i]-pjoint->GetDOFIndex();
+        if( pjoint->IsCircular(iaxis) ) {
+            _vcircularjoints.resize(vindices.size());
+            _vcircularjoints[i] = std::make_pair(pjoint, iaxis);
+        }
+    }
+}
+
+void ActiveDOFStateSpace::ComputeDistances(const std::vector<dReal>& config, const std::vector<dReal>& vconfigs, std::vector<dReal>& vdistances) const
+{
+    const int dof = GetDOF();
+    OPENRAVE_ASSERT_OP((int)config.size(),==,dof);
+    size_t numconfigs = dof > 0 ? vconfigs.size()/dof : 0;
+    vdistances.resize(numconfigs);
+    for(size_t iconfig = 0; iconfig < numconfigs; ++iconfig) {
+        vdistances[iconfig] = ComputeDistance(&config[0], &vconfigs[iconfig*dof]);
+    }
+}
+
+dReal ActiveDOFDistanceMetricFn::operator()(const std::vector<dReal>& c0, const std::vector<dReal>& c1) const
+{
+    BOOST_ASSERT((int)c0.size() == _statespace->GetDOF() && (int)c1.size() == _statespace->GetDOF());
+    if( c0.size() == 0 ) {
+        return 0;
+    }
+    return _statespace->ComputeDistance(&c0[0], &c1[0]);
+}
+
+void ActiveDOFDiffStateFn::operator()(std::vector<dReal>& q0, const std::vector<dReal>& q1) const
+{
+    BOOST_ASSERT((int)q0.size() == _statespace->GetDOF() && (int)q1.size() == _statespace->GetDOF());
+    if( q0.size() > 0 ) {
+        _statespace->Subtract(&q0[0], &q1[0]);
+    }
+}
+
+bool ActiveDOFNeighStateFn::operator()(std::vector<dReal>& q, const std::vector<dReal>& qdelta, int fromgoal) const
+{
+    BOOST_ASSERT(q.size()==qdelta.size());
+    OPENRAVE_ASSERT_OP((int)q.size(),==,_statespace->GetDOF());
+    if( q.size() > 0 ) {
+        OPENRAVE_ASSERT_OP(_pvlowerlimit->size(),==,q.size());
+        OPENRAVE_ASSERT_OP(_pvupperlimit->size(),==,q.size());
+        _statespace->AddStates(&q[0], &qdelta[0], &(*_pvlowerlimit)[0], &(*_pvupperlimit)[0]);
+    }
+    return true;
+}
+
+ActiveDOFStateSpacePtr GetActiveDOFStateSpace(const PlannerBase::PlannerParameters& params)
+{
+    const ActiveDOFDistanceMetricFn* pdistmetricfn = params._distmetricfn.target<ActiveDOFDistanceMetricFn>();
+    const ActiveDOFDiffStateFn* pdiffstatefn = params._diffstatefn.target<ActiveDOFDiffStateFn>();
+    const ActiveDOFNeighStateFn* pneighstatefn = params._neighstatefn.target<ActiveDOFNeighStateFn>();
+    if( !pdistmetricfn || !pdiffstatefn || !pneighstatefn ) {
+        return ActiveDOFStateSpacePtr();
+    }
+    if( pdistmetricfn->_statespace != pdiffstatefn->_statespace || pdistmetricfn->_statespace != pneighstatefn->_statespace ) {
+        return ActiveDOFStateSpacePtr();
+    }
+    // copied parameters keep the neighbor function of the original parameters
+    if( pneighstatefn->_pvlowerlimit != &params._vConfigLowerLimit || pneighstatefn->_pvupperlimit != &params._vConfigUpperLimit ) {
+        return ActiveDOFStateSpacePtr();
+    }
+    if( pdistmetricfn->_statespace->GetDOF() != params.GetDOF() || (int)params._vConfigLowerLimit.size() != params.GetDOF() || (int)params._vConfigUpperLimit.size() != params.GetDOF() ) {
+        return ActiveDOFStateSpacePtr();
+    }
+    return pdistmetricfn->_statespace;
+}
+
 SimpleNeighborhoodSampler::SimpleNeighborhoodSampler(SpaceSamplerBasePtr psampler, const PlannerBase::PlannerParameters::DistMetricFn& distmetricfn, const PlannerBase::PlannerParameters::DiffStateFn& diffstatefn) : _psampler(psampler), _distmetricfn(distmetricfn), _diffstatefn(diffstatefn)
 {
 }
@@ -3028,6 +4017,8 @@ ManipulatorIKGoalSampler::ManipulatorIKGoalSampler(RobotBase::ManipulatorConstPt
 {
     _tempikindex = -1;
     _fjittermaxdist = 0;
+    _bBatchSolving = false;
+    _bBatchSolved = false;
     _probot = _pmanip->GetRobot();
     _pindexsampler = RaveCreateSpaceSampler(_probot->GetEnv(),"mt19937");
     int orgindex = 0;
@@ -3037,7 +4028,14 @@ ManipulatorIKGoalSampler::ManipulatorIKGoalSampler(RobotBase::ManipulatorConstPt
         s._ikparam = *it;
         s._numleft = _nummaxsamples;
         _listsamples.push_back(s);
+
+        PackedParameterizations& packed = _mapPackedParameterizations[it->GetType()];
+        size_t offset = packed._vvalues.size();
+        packed._vvalues.resize(offset+it->GetNumberOfValues());
+        it->GetValues(packed._vvalues.begin()+offset);
+        packed._vorgindices.push_back(s._orgindex);
     }
+    _listorigsamples = _listsamples;
     _report.reset(new CollisionReport());
     pmanip->GetIkSolver()->GetFreeParameters(_vfreestart);
 
@@ -3086,6 +4084,9 @@ IkReturnPtr ManipulatorIKGoalSampler::Sample()
     if( vindex.at(0) > _fsampleprob ) {
         return IkReturnPtr();
     }
+    if( _bBatchSolving ) {
+        return _SampleBatch();
+    }
     if( _vikreturns.size() > 0 ) {
         IkReturnPtr ikreturnlocal = _vikreturns.back();
         _vikreturns.pop_back();
@@ -3342,5 +4343,122 @@ void ManipulatorIKGoalSampler::SetJitter(dReal maxdist)
     _fjittermaxdist = maxdist;
 }
 
+void ManipulatorIKGoalSampler::SetBatchSolving(bool bbatch)
+{
+    _bBatchSolving = bbatch;
+    _bBatchSolved = false;
+}
+
+int ManipulatorIKGoalSampler::FindClosestIkParameterization(const IkParameterization& ikparam, dReal& fdistsqr)
+{
+    std::map<IkParameterizationType, PackedParameterizations>::const_iterator itpacked = _mapPackedParameterizations.find(ikparam.GetType());
+    if( itpacked == _mapPackedParameterizations.end() ) {
+        return -1;
+    }
+    ikparam.ComputeDistancesSqr(itpacked->second._vvalues, _vtempdists);
+    size_t iclosest = std::min_element(_vtempdists.begin(), _vtempdists.end()) - _vtempdists.begin();
+    fdistsqr = _vtempdists.at(iclosest);
+    return itpacked->second._vorgindices.at(iclosest);
+}
+
+IkReturnPtr ManipulatorIKGoalSampler::_SampleBatch()
+{
+    _GetBatchState(_vtempbodystamps, _vtemprobotstate);
+    if( !_bBatchSolved || _vtempbodystamps != _vbatchbodystamps || _vtemprobotstate != _vbatchrobotstate ) {
+        _SolveBatch();
+        _vbatchbodystamps.swap(_vtempbodystamps);
+        _vbatchrobotstate.swap(_vtemprobotstate);
+        _bBatchSolved = true;
+    }
+    if( _vbatchindices.size() == 0 ) {
+        return IkReturnPtr();
+    }
+    std::vector<dReal> vindex;
+    _pindexsampler->SampleSequence(vindex,1,IT_OpenEnd);
+    size_t ibatch = min(_vbatchindices.size()-1, (size_t)(vindex.at(0)*_vbatchindices.size()));
+    int orgindex = _vbatchindices[ibatch];
+    std::vector<IkReturnPtr>& vsolutions = _vbatchsolutions.at(orgindex);
+    IkReturnPtr ikreturn = vsolutions.back();
+    vsolutions.pop_back();
+    if( vsolutions.size() == 0 ) {
+        _vbatchindices[ibatch] = _vbatchindices.back();
+        _vbatchindices.pop_back();
+    }
+    _listreturnedsamples.push_back(orgindex);
+    return ikreturn;
+}
+
+void ManipulatorIKGoalSampler::_SolveBatch()
+{
+    _listsamples = _listorigsamples;
+    _vikreturns.resize(0);
+    _tempikindex = -1;
+    _vbatchsolutions.resize(0);
+    _vbatchsolutions.resize(_listorigsamples.size());
+    _vbatchindices.resize(0);
+
+    // run the single sample logic until all the parameterizations are exhausted
+    dReal fsampleprob = _fsampleprob;
+    _fsampleprob = 1;
+    _bBatchSolving = false;
+    try {
+        while( _listsamples.size() > 0 || _vikreturns.size() > 0 ) {
+            IkReturnPtr ikreturn = Sample();
+            if( !!ikreturn ) {
+                _vbatchsolutions.at(_listreturnedsamples.back()).push_back(ikreturn);
+                _listreturnedsamples.pop_back();
+            }
+        }
+    }
+    catch(...) {
+        _fsampleprob = fsampleprob;
+        _bBatchSolving = true;
+        throw;
+    }
+    _fsampleprob = fsampleprob;
+    _bBatchSolving = true;
+
+    for(size_t i = 0; i < _vbatchsolutions.size(); ++i) {
+        if( _vbatchsolutions[i].size() > 0 ) {
+            // hand out the solutions in the order they were found, the free samples closest to the middle are solved first
+            std::reverse(_vbatchsolutions[i].begin(), _vbatchsolutions[i].end());
+            _vbatchindices.push_back(i);
+        }
+    }
+}
+
+void ManipulatorIKGoalSampler::_GetBatchState(std::vector<int>& vbodystamps, std::vector<dReal>& vrobotstate)
+{
+    vbodystamps.resize(0);
+    std::vector<KinBodyPtr> vbodies;
+    _probot->GetEnv()->GetBodies(vbodies);
+    FOREACHC(itbody, vbodies) {
+        // the arm of the robot and the grabbed bodies move while planning, which does not change the ik solutions
+        if( *itbody == _probot || !!_probot->IsGrabbing(*itbody) ) {
+            continue;
+        }
+        vbodystamps.push_back((*itbody)->GetEnvironmentId());
+        vbodystamps.push_back((*itbody)->GetUpdateStamp());
+    }
+    std::vector<KinBodyPtr> vgrabbed;
+    _probot->GetGrabbed(vgrabbed);
+    FOREACHC(itbody, vgrabbed) {
+        vbodystamps.push_back(-(*itbody)->GetEnvironmentId());
+    }
+
+    vrobotstate.resize(0);
+    Transform t = _probot->GetTransform();
+    vrobotstate.push_back(t.trans.x); vrobotstate.push_back(t.trans.y); vrobotstate.push_back(t.trans.z);
+    vrobotstate.push_back(t.rot.x); vrobotstate.push_back(t.rot.y); vrobotstate.push_back(t.rot.z); vrobotstate.push_back(t.rot.w);
+    std::vector<dReal> vdofvalues;
+    _probot->GetDOFValues(vdofvalues);
+    const std::vector<int>& varmindices = _pmanip->GetArmIndices();
+    for(size_t idof = 0; idof < vdofvalues.size(); ++idof) {
+        if( find(varmindices.begin(), varmindices.end(), (int)idof) == varmindices.end() ) {
+            vrobotstate.push_back(vdofvalues[idof]);
+        }
+    }
+}
+
 } // planningutils
 } // OpenRAVE
@@ -27,6 +27,8 @@
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 #define PLUGIN_EXT ".dll"
 #define OPENRAVE_LAZY_LOADING false
 #else
@@ -72,6 +74,7 @@ class RaveDatabase : public boost::enable_shared_from_this<RaveDatabase>
             if( !!database ) {
                 boost::mutex::scoped_lock lock(database->_mutex);
                 database->_listRegisteredInterfaces.erase(_iterator);
+                database->_InvalidateRegistry();
             }
         }
 
@@ -84,6 +87,22 @@ protected:
     };
     typedef boost::shared_ptr<RegisteredInterface> RegisteredInterfacePtr;
 
+public:
+    class Plugin;
+    typedef boost::shared_ptr<Plugin> PluginPtr;
+
+protected:
+    /// \brief the registered interfaces and plugins offering one interface name, in the order Create tries them
+    struct InterfaceFactories
+    {
+        std::vector< boost::weak_ptr<RegisteredInterface> > vregistrations;
+        std::vector<PluginPtr> vplugins;
+    };
+    typedef boost::shared_ptr<InterfaceFactories const> InterfaceFactoriesConstPtr;
+
+    /// \brief resolved interface names, indexed by type and lower-case name. Never modified once published, a new copy is made for every newly resolved name.
+    typedef std::map< std::pair<InterfaceType, std::string>, InterfaceFactoriesConstPtr > InterfaceRegistry;
+
 public:
     class Plugin : public UserData, public boost::enable_shared_from_this<Plugin>
     {
@@ -310,11 +329,10 @@ protected:
 
         friend class RaveDatabase;
     };
-    typedef boost::shared_ptr<Plugin> PluginPtr;
     typedef boost::shared_ptr<Plugin const> PluginConstPtr;
     friend class Plugin;
 
-    RaveDatabase() : _bShutdown(false) {
+    RaveDatabase() : _bPluginIndexModified(false), _bShutdown(false) {
     }
     virtual ~RaveDatabase() {
         Destroy();
@@ -360,8 +378,11 @@ protected:
         return RaveInterfaceCast<SpaceSamplerBase>(Create(penv, PT_SpaceSampler, name));
     }
 
-    virtual bool Init(bool bLoadAllPlugins)
+    /// \param indexfilename file caching the interfaces offered by the plugins, so that plugins are only loaded once one of their interfaces is created. If empty, all plugins are loaded to query their interfaces.
+    virtual bool Init(bool bLoadAllPlugins, const std::string& indexfilename=std::string())
     {
+        _pluginindexfilename = indexfilename;
+        _LoadPluginIndex();
         _threadPluginLoader.reset(new boost::thread(boost::bind(&RaveDatabase::_PluginLoaderThread, this)));
         std::vector<std::string> vplugindirs;
 #ifdef _WIN32
@@ -421,11 +442,13 @@ protected:
             }
         }
         if( bLoadAllPlugins ) {
+            uint64_t starttime = utils::GetMicroTime();
             FOREACH(it, vplugindirs) {
                 if( it->size() > 0 ) {
                     AddDirectory(it->c_str());
                 }
             }
+            RAVELOG_DEBUG("loaded plugin directories in %fs\n", 1e-6*(utils::GetMicroTime()-starttime));
         }
         return true;
     }
@@ -446,6 +469,7 @@ protected:
         {
             boost::mutex::scoped_lock lock(_mutex);
             _listplugins.clear();
+            _InvalidateRegistry();
         }
         // cannot lock mutex due to __erase_iterator
         // cannot clear _listRegisteredInterfaces since there are destructors that will remove items from the list
@@ -493,35 +517,26 @@ protected:
                 return InterfaceBasePtr();
             }
 
-            // have to copy in order to allow plugins to register stuff inside their creation methods
-            std::list< boost::weak_ptr<RegisteredInterface> > listRegisteredInterfaces;
-            list<PluginPtr> listplugins;
-            {
-                boost::mutex::scoped_lock lock(_mutex);
-                listRegisteredInterfaces = _listRegisteredInterfaces;
-                listplugins = _listplugins;
-            }
-            FOREACH(it, listRegisteredInterfaces) {
+            // the factories are a snapshot, so plugins can register stuff inside their creation methods
+            InterfaceFactoriesConstPtr pfactories = _GetInterfaceFactories(type, name.substr(0, nInterfaceNameLength));
+            FOREACHC(it, pfactories->vregistrations) {
                 RegisteredInterfacePtr registration = it->lock();
                 if( !!registration ) {
-                    if(( nInterfaceNameLength >= registration->_name.size()) &&( _strnicmp(name.c_str(),registration->_name.c_str(),registration->_name.size()) == 0) ) {
-                        std::stringstream sinput(name);
-                        std::string interfacename;
-                        sinput >> interfacename;
-                        std::transform(interfacename.begin(), interfacename.end(), interfacename.begin(), ::tolower);
-                        pointer = registration->_createfn(penv,sinput);
-                        if( !!pointer ) {
-                            if( pointer->GetInterfaceType() != type ) {
-                                RAVELOG_FATAL(str(boost::format("plugin interface name %s, type %s, types do not match\n")%name%RaveGetInterfaceName(type)));
-                                pointer.reset();
-                            }
-                            else {
-                                pointer = InterfaceBasePtr(pointer.get(), utils::smart_pointer_deleter<InterfaceBasePtr>(pointer,INTERFACE_PREDELETER));
-                                pointer->__strpluginname = "__internal__";
-                                pointer->__strxmlid = name;
-                                //pointer->__plugin; // need to protect resources?
-                                break;
-                            }
+                    std::stringstream sinput(name);
+                    std::string interfacename;
+                    sinput >> interfacename;
+                    pointer = registration->_createfn(penv,sinput);
+                    if( !!pointer ) {
+                        if( pointer->GetInterfaceType() != type ) {
+                            RAVELOG_FATAL(str(boost::format("plugin interface name %s, type %s, types do not match\n")%name%RaveGetInterfaceName(type)));
+                            pointer.reset();
+                        }
+                        else {
+                            pointer = InterfaceBasePtr(pointer.get(), utils::smart_pointer_deleter<InterfaceBasePtr>(pointer,INTERFACE_PREDELETER));
+                            pointer->__strpluginname = "__internal__";
+                            pointer->__strxmlid = name;
+                            //pointer->__plugin; // need to protect resources?
+                            break;
                         }
                     }
                 }
@@ -529,8 +544,8 @@ protected:
 
             if( !pointer ) {
                 const char* hash = RaveGetInterfaceHash(type);
-                list<PluginPtr>::iterator itplugin = listplugins.begin();
-                while(itplugin != listplugins.end()) {
+                std::vector<PluginPtr>::const_iterator itplugin = pfactories->vplugins.begin();
+                while(itplugin != pfactories->vplugins.end()) {
                     pointer = (*itplugin)->CreateInterface(type, name, hash, penv);
                     if( !!pointer ) {
                         if( strcmp(pointer->GetHash(), hash) ) {
@@ -554,6 +569,7 @@ protected:
                     if( !(*itplugin)->IsValid() ) {
                         boost::mutex::scoped_lock lock(_mutex);
                         _listplugins.remove(*itplugin);
+                        _InvalidateRegistry();
                     }
                     ++itplugin;
                 }
@@ -601,7 +617,7 @@ protected:
                 string strplugin = pdir;
                 strplugin += "\\";
                 strplugin += FindFileData.cFileName;
-                LoadPlugin(strplugin.c_str());
+                LoadPlugin(strplugin.c_str(), false);
             } while (FindNextFileA(hFind, &FindFileData) != 0);
             FindClose(hFind);
         }
@@ -617,7 +633,7 @@ protected:
                     string strplugin = pdir;
                     strplugin += "/";
                     strplugin += ep->d_name;
-                    LoadPlugin(strplugin.c_str());
+                    LoadPlugin(strplugin.c_str(), false);
                 }
             }
             (void) closedir (dp);
@@ -626,6 +642,8 @@ protected:
             RAVELOG_DEBUG("Couldn't open directory %s\n", pdir.c_str());
         }
 #endif
+        boost::mutex::scoped_lock lock(_mutex);
+        _SavePluginIndex();
         return true;
     }
 
@@ -638,10 +656,12 @@ protected:
                 *itplugin = newplugin;
             }
         }
+        _InvalidateRegistry();
         _CleanupUnusedLibraries();
     }
 
-    bool LoadPlugin(const std::string& pluginname)
+    /// \param bSavePluginIndex if true, writes the plugin index when the plugin was not indexed yet
+    bool LoadPlugin(const std::string& pluginname, bool bSavePluginIndex=true)
     {
         boost::mutex::scoped_lock lock(_mutex);
         std::list<PluginPtr>::iterator it = _GetPlugin(pluginname);
@@ -658,7 +678,11 @@ protected:
         if( !!p ) {
             _listplugins.push_back(p);
         }
+        _InvalidateRegistry();
         _CleanupUnusedLibraries();
+        if( bSavePluginIndex ) {
+            _SavePluginIndex();
+        }
         return !!p;
     }
 
@@ -670,27 +694,23 @@ protected:
             return false;
         }
         _listplugins.erase(it);
+        _InvalidateRegistry();
         _CleanupUnusedLibraries();
         return true;
     }
 
     virtual bool HasInterface(InterfaceType type, const string& interfacename)
     {
-        boost::mutex::scoped_lock lock(_mutex);
-        FOREACHC(it,_listRegisteredInterfaces) {
-            RegisteredInterfacePtr registration = it->lock();
-            if( !!registration ) {
-                if(( interfacename.size() >= registration->_name.size()) &&( _strnicmp(interfacename.c_str(),registration->_name.c_str(),registration->_name.size()) == 0) ) {
-                    return true;
-                }
-            }
+        if( interfacename.size() == 0 ) {
+            return false;
         }
-        FOREACHC(itplugin, _listplugins) {
-            if( (*itplugin)->HasInterface(type,interfacename) ) {
+        InterfaceFactoriesConstPtr pfactories = _GetInterfaceFactories(type, interfacename);
+        FOREACHC(it, pfactories->vregistrations) {
+            if( !it->expired() ) {
                 return true;
             }
         }
-        return false;
+        return pfactories->vplugins.size() > 0;
     }
 
     void GetPluginInfo(std::list< std::pair<std::string, PLUGININFO> >& plugins) const
@@ -753,6 +773,7 @@ protected:
         boost::mutex::scoped_lock lock(_mutex);
         RegisteredInterfacePtr pdata(new RegisteredInterface(type,name,createfn,shared_from_this()));
         pdata->_iterator = _listRegisteredInterfaces.insert(_listRegisteredInterfaces.end(),pdata);
+        _InvalidateRegistry();
         return pdata;
     }
 
@@ -761,6 +782,78 @@ protected:
     }
 
 protected:
+    /// \brief returns the factories offering interfacename, resolving and caching them the first time the name is asked for.
+    ///
+    /// Once resolved, looking up a name does not lock _mutex, so environments creating interfaces in parallel do not serialize here.
+    InterfaceFactoriesConstPtr _GetInterfaceFactories(InterfaceType type, const std::string& interfacename)
+    {
+        std::pair<InterfaceType, std::string> key(type, utils::ConvertToLowerCase(interfacename));
+        boost::shared_ptr<InterfaceRegistry const> pregistry = _LoadRegistry();
+        if( !!pregistry ) {
+            InterfaceRegistry::const_iterator it = pregistry->find(key);
+            if( it != pregistry->end() ) {
+                return it->second;
+            }
+        }
+
+        // the locked registrations have to be released after _mutex since their destructor locks it
+        std::vector<RegisteredInterfacePtr> vregistrations;
+        boost::mutex::scoped_lock lock(_mutex);
+        pregistry = _pregistry;
+        if( !!pregistry ) {
+            // another thread might have resolved the name in the meantime
+            InterfaceRegistry::const_iterator it = pregistry->find(key);
+            if( it != pregistry->end() ) {
+                return it->second;
+            }
+        }
+        boost::shared_ptr<InterfaceFactories> pfactories(new InterfaceFactories());
+        FOREACHC(it, _listRegisteredInterfaces) {
+            RegisteredInterfacePtr registration = it->lock();
+            if( !!registration ) {
+                if( registration->_type == type && interfacename.size() >= registration->_name.size() && _strnicmp(interfacename.c_str(),registration->_name.c_str(),registration->_name.size()) == 0 ) {
+                    pfactories->vregistrations.push_back(*it);
+                }
+                vregistrations.push_back(registration);
+            }
+        }
+        FOREACHC(itplugin, _listplugins) {
+            if( (*itplugin)->HasInterface(type,interfacename) ) {
+                pfactories->vplugins.push_back(*itplugin);
+            }
+        }
+        boost::shared_ptr<InterfaceRegistry> pnewregistry(!pregistry ? new InterfaceRegistry() : new InterfaceRegistry(*pregistry));
+        (*pnewregistry)[key] = pfactories;
+        _StoreRegistry(pnewregistry);
+        return pfactories;
+    }
+
+    /// \brief forgets all resolved names, has to be called with _mutex locked whenever _listplugins or _listRegisteredInterfaces change
+    void _InvalidateRegistry()
+    {
+        _StoreRegistry(boost::shared_ptr<InterfaceRegistry const>());
+    }
+
+    boost::shared_ptr<InterfaceRegistry const> _LoadRegistry() const
+    {
+#if BOOST_VERSION >= 105300
+        return boost::atomic_load(&_pregistry);
+#else
+        boost::mutex::scoped_lock lock(_mutex);
+        return _pregistry;
+#endif
+    }
+
+    /// \brief _mutex has to be locked
+    void _StoreRegistry(boost::shared_ptr<InterfaceRegistry const> pregistry)
+    {
+#if BOOST_VERSION >= 105300
+        boost::atomic_store(&_pregistry, pregistry);
+#else
+        _pregistry = pregistry;
+#endif
+    }
+
     void _CleanupUnusedLibraries()
     {
         FOREACH(it,_listDestroyLibraryQueue) {
@@ -806,6 +899,24 @@ protected:
     PluginPtr _LoadPlugin(const string& _libraryname)
     {
         string libraryname = _libraryname;
+        PluginIndexEntry indexentry;
+        if( _GetLibraryStamp(libraryname, indexentry.mtime, indexentry.size) ) {
+            std::map<std::string, PluginIndexEntry>::const_iterator itentry = _mapPluginIndex.find(libraryname);
+            if( itentry != _mapPluginIndex.end() && itentry->second.mtime == indexentry.mtime && itentry->second.size == indexentry.size ) {
+                if( !itentry->second.bIsPlugin ) {
+                    return PluginPtr();
+                }
+                // the library is only loaded when one of its interfaces is created, see Plugin::_confirmLibrary
+                PluginPtr p(new Plugin(shared_from_this()));
+                p->ppluginname = libraryname;
+                p->_infocached = itentry->second.info;
+                p->_bInitializing = false;
+                RAVELOG_DEBUG("indexed plugin: %s\n", libraryname.c_str());
+                return p;
+            }
+        }
+
+        uint64_t starttime = utils::GetMicroTime();
         void* plibrary = _SysLoadLibrary(libraryname.c_str(),OPENRAVE_LAZY_LOADING);
         if( plibrary == NULL ) {
             // check if PLUGIN_EXT is missing
@@ -866,6 +977,7 @@ protected:
             if( !p->Load_GetPluginAttributes() ) {
                 // might not be a plugin
                 RAVELOG_VERBOSE(str(boost::format("%s: can't load GetPluginAttributes function, might not be an OpenRAVE plugin\n")%libraryname));
+                _AddToPluginIndex(libraryname, false, PLUGININFO());
                 return PluginPtr();
             }
 
@@ -896,8 +1008,9 @@ protected:
         else {
             dladdr((void*)p->pfnGetPluginAttributes, &info);
         }
-        RAVELOG_DEBUG("loading plugin: %s\n", info.dli_fname);
+        RAVELOG_DEBUG("loading plugin: %s (%fs)\n", info.dli_fname, 1e-6*(utils::GetMicroTime()-starttime));
 #endif
+        _AddToPluginIndex(libraryname, true, p->_infocached);
 
         p->_bInitializing = false;
         if( OPENRAVE_LAZY_LOADING ) {
@@ -988,6 +1101,111 @@ protected:
         plugin.reset();
     }
 
+    /// \brief returns the modification time and size of a library, which invalidate its plugin index entry
+    static bool _GetLibraryStamp(const std::string& filename, int64_t& mtime, uint64_t& size)
+    {
+        struct stat filestat;
+        if( stat(filename.c_str(), &filestat) != 0 ) {
+            return false;
+        }
+        mtime = (int64_t)filestat.st_mtime;
+        size = (uint64_t)filestat.st_size;
+        return true;
+    }
+
+    /// \brief reads the plugin index written by \ref _SavePluginIndex. The index is discarded if written by a different openrave version.
+    void _LoadPluginIndex()
+    {
+        _mapPluginIndex.clear();
+        _bPluginIndexModified = false;
+        if( _pluginindexfilename.size() == 0 ) {
+            return;
+        }
+        ifstream f(_pluginindexfilename.c_str());
+        if( !f ) {
+            return;
+        }
+        string header, pluginhash;
+        int version = 0;
+        f >> header >> version >> pluginhash;
+        if( !f || header != "openrave_plugin_index" || version != OPENRAVE_VERSION || pluginhash != OPENRAVE_PLUGININFO_HASH ) {
+            RAVELOG_DEBUG("ignoring stale plugin index %s\n", _pluginindexfilename.c_str());
+            return;
+        }
+        while( !!f ) {
+            PluginIndexEntry entry;
+            int bIsPlugin = 0;
+            size_t numtypes = 0;
+            f >> entry.mtime >> entry.size >> bIsPlugin >> entry.info.version >> numtypes;
+            f.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            string libraryname;
+            if( !f || !getline(f, libraryname) ) {
+                break;
+            }
+            entry.bIsPlugin = bIsPlugin != 0;
+            for(size_t itype = 0; itype < numtypes && !!f; ++itype) {
+                int type = 0;
+                size_t numnames = 0;
+                f >> type >> numnames;
+                std::vector<std::string>& vnames = entry.info.interfacenames[(InterfaceType)type];
+                vnames.resize(numnames);
+                for(size_t iname = 0; iname < numnames; ++iname) {
+                    f >> vnames[iname];
+                }
+            }
+            if( !f ) {
+                break;
+            }
+            _mapPluginIndex[libraryname] = entry;
+        }
+    }
+
+    void _AddToPluginIndex(const std::string& libraryname, bool bIsPlugin, const PLUGININFO& info)
+    {
+        PluginIndexEntry entry;
+        if( _pluginindexfilename.size() == 0 || !_GetLibraryStamp(libraryname, entry.mtime, entry.size) ) {
+            return;
+        }
+        entry.bIsPlugin = bIsPlugin;
+        entry.info = info;
+        _mapPluginIndex[libraryname] = entry;
+        _bPluginIndexModified = true;
+    }
+
+    /// \brief writes the plugin index if new libraries were loaded
+    void _SavePluginIndex()
+    {
+        if( !_bPluginIndexModified || _pluginindexfilename.size() == 0 ) {
+            return;
+        }
+        // write to a temporary file and rename so that other processes never read a partial index
+        string tempfilename = str(boost::format("%s.%d")%_pluginindexfilename%utils::GetNanoTime());
+        {
+            ofstream f(tempfilename.c_str());
+            if( !f ) {
+                return;
+            }
+            f << "openrave_plugin_index " << OPENRAVE_VERSION << " " << OPENRAVE_PLUGININFO_HASH << endl;
+            FOREACHC(itentry, _mapPluginIndex) {
+                const PluginIndexEntry& entry = itentry->second;
+                f << entry.mtime << " " << entry.size << " " << (int)entry.bIsPlugin << " " << entry.info.version << " " << entry.info.interfacenames.size() << endl;
+                f << itentry->first << endl;
+                FOREACHC(ittype, entry.info.interfacenames) {
+                    f << (int)ittype->first << " " << ittype->second.size();
+                    FOREACHC(itname, ittype->second) {
+                        f << " " << *itname;
+                    }
+                    f << endl;
+                }
+            }
+        }
+        if( std::rename(tempfilename.c_str(), _pluginindexfilename.c_str()) != 0 ) {
+            std::remove(tempfilename.c_str());
+            return;
+        }
+        _bPluginIndexModified = false;
+    }
+
     void _AddToLoader(PluginPtr p)
     {
         boost::mutex::scoped_lock lock(_mutexPluginLoader);
@@ -1017,11 +1235,15 @@ protected:
                 if( _bShutdown ) {
                     break;
                 }
+                uint64_t starttime = utils::GetMicroTime();
                 (*itplugin)->plibrary = _SysLoadLibrary((*itplugin)->ppluginname,false);
                 if( (*itplugin)->plibrary == NULL ) {
                     // for some reason cannot load the library, so shut it down
                     (*itplugin)->_bShutdown = true;
                 }
+                else {
+                    RAVELOG_DEBUG("loaded plugin library %s (%fs)\n", (*itplugin)->ppluginname.c_str(), 1e-6*(utils::GetMicroTime()-starttime));
+                }
                 (*itplugin)->_cond.notify_all();
             }
         }
@@ -1031,8 +1253,25 @@ protected:
     mutable boost::mutex _mutex;     ///< changing plugin database
     std::list<void*> _listDestroyLibraryQueue;
     std::list< boost::weak_ptr<RegisteredInterface> > _listRegisteredInterfaces;
+    boost::shared_ptr<InterfaceRegistry const> _pregistry; ///< names resolved from _listplugins and _listRegisteredInterfaces, empty when it has to be rebuilt. Written with _mutex locked, read atomically.
     std::list<std::string> _listplugindirs;
 
+    /// \name plugin index
+    //@{
+    struct PluginIndexEntry
+    {
+        PluginIndexEntry() : mtime(0), size(0), bIsPlugin(false) {
+        }
+        int64_t mtime; ///< modification time of the library
+        uint64_t size; ///< size of the library
+        bool bIsPlugin; ///< false if the library does not export GetPluginAttributes
+        PLUGININFO info;
+    };
+    std::string _pluginindexfilename;
+    std::map<std::string, PluginIndexEntry> _mapPluginIndex; ///< indexed by the library filename, protected by _mutex
+    bool _bPluginIndexModified;
+    //@}
+
     /// \name plugin loading
     //@{
     mutable boost::mutex _mutexPluginLoader;     ///< specifically for loading shared objects
@@ -211,7 +211,7 @@ void RobotBase::RobotStateSaver::_RestoreRobot(boost::shared_ptr<RobotBase> prob
             }
         }
     }
-    if( _options & Save_GrabbedBodies ) {
+    if( (_options & Save_GrabbedBodies) && !(probot == _probot && probot->_vGrabbedBodies == _vGrabbedBodies) ) {
         // have to release all grabbed first
         probot->ReleaseAllGrabbed();
         OPENRAVE_ASSERT_OP(probot->_vGrabbedBodies.size(),==,0);
@@ -307,6 +307,8 @@ RobotBase::RobotBase(EnvironmentBasePtr penv) : KinBody(PT_Robot, penv)
     _fQuatMaxAngleVelocity = 1.0;
     _fQuatAngleResolution = 0.01f;
     _fQuatAngleWeight = 0.4f;
+
+    _fGrabbedCollidingLinksCacheResolution = 0.001;
 }
 
 RobotBase::~RobotBase()
@@ -378,6 +380,13 @@ void RobotBase::SetDOFValues(const std::vector<dReal>& vJointValues, uint32_t bC
     _UpdateAttachedSensors();
 }
 
+void RobotBase::SetDOFValues(const dReal* pJointValues, size_t numvalues, uint32_t bCheckLimits, const std::vector<int>& dofindices)
+{
+    KinBody::SetDOFValues(pJointValues, numvalues, bCheckLimits, dofindices);
+    _UpdateGrabbedBodies();
+    _UpdateAttachedSensors();
+}
+
 void RobotBase::SetDOFValues(const std::vector<dReal>& vJointValues, const Transform& transbase, uint32_t bCheckLimits)
 {
     KinBody::SetDOFValues(vJointValues, transbase, bCheckLimits); // should call RobotBase::SetDOFValues, so no need to upgrade grabbed bodies, attached sensors
@@ -434,17 +443,27 @@ void RobotBase::SetDOFVelocities(const std::vector<dReal>& dofvelocities, uint32
 
 void RobotBase::_UpdateGrabbedBodies()
 {
+    if( _vGrabbedBodies.size() == 0 ) {
+        return;
+    }
+    // query the physics engine once for all the links instead of once per grabbed body
+    GetLinkVelocities(_vGrabbedLinkVelocities);
     vector<UserDataPtr>::iterator itgrabbed = _vGrabbedBodies.begin();
     while(itgrabbed != _vGrabbedBodies.end() ) {
-        GrabbedPtr pgrabbed = boost::dynamic_pointer_cast<Grabbed>(*itgrabbed);
+        GrabbedPtr pgrabbed = boost::static_pointer_cast<Grabbed>(*itgrabbed);
         KinBodyPtr pbody = pgrabbed->_pgrabbedbody.lock();
         if( !!pbody ) {
             Transform t = pgrabbed->_plinkrobot->GetTransform();
             pbody->SetTransform(t * pgrabbed->_troot);
             // set the correct velocity
-            std::pair<Vector, Vector> velocity = pgrabbed->_plinkrobot->GetVelocity();
+            std::pair<Vector, Vector> velocity = _vGrabbedLinkVelocities.at(pgrabbed->_plinkrobot->GetIndex());
             velocity.first += velocity.second.cross(t.rotate(pgrabbed->_troot.trans));
-            pbody->SetVelocity(velocity.first, velocity.second);
+            // robots that are only moved kinematically (planning) always have zero velocities, so do not keep setting them on the grabbed bodies
+            bool bZeroVelocity = velocity.first.lengthsqr3() == 0 && velocity.second.lengthsqr3() == 0;
+            if( !bZeroVelocity || !pgrabbed->_bZeroVelocity ) {
+                pbody->SetVelocity(velocity.first, velocity.second);
+                pgrabbed->_bZeroVelocity = bZeroVelocity;
+            }
             ++itgrabbed;
         }
         else {
@@ -647,17 +666,24 @@ void RobotBase::SetActiveDOFs(const std::vector<int>& vJointIndices, int nAffine
 }
 
 void RobotBase::SetActiveDOFValues(const std::vector<dReal>& values, uint32_t bCheckLimits)
+{
+    SetActiveDOFValues(values.size() > 0 ? &values[0] : NULL, values.size(), bCheckLimits);
+}
+
+void RobotBase::SetActiveDOFValues(const dReal* pValues, size_t numvalues, uint32_t bCheckLimits)
 {
     if(_nActiveDOF < 0) {
-        SetDOFValues(values,bCheckLimits);
+        SetDOFValues(pValues,numvalues,bCheckLimits);
         return;
     }
-    OPENRAVE_ASSERT_OP_FORMAT((int)values.size(),>=,GetActiveDOF(), "not enough values %d<%d",values.size()%GetActiveDOF(),ORE_InvalidArguments);
+    OPENRAVE_ASSERT_OP_FORMAT((int)numvalues,>=,GetActiveDOF(), "not enough values %d<%d",numvalues%GetActiveDOF(),ORE_InvalidArguments);
 
     Transform t;
     if( (int)_vActiveDOFIndices.size() < _nActiveDOF ) {
         t = GetTransform();
-        RaveGetTransformFromAffineDOFValues(t, values.begin()+_vActiveDOFIndices.size(),_nAffineDOFs,vActvAffineRotationAxis);
+        _vTempAffineValues.resize(_nActiveDOF-_vActiveDOFIndices.size());
+        std::copy(pValues+_vActiveDOFIndices.size(), pValues+_nActiveDOF, _vTempAffineValues.begin());
+        RaveGetTransformFromAffineDOFValues(t, _vTempAffineValues.begin(),_nAffineDOFs,vActvAffineRotationAxis);
         if( _nAffineDOFs & OpenRAVE::DOF_RotationQuat ) {
             t.rot = quatMultiply(_vRotationQuatLimitStart, t.rot);
         }
@@ -669,7 +695,7 @@ void RobotBase::SetActiveDOFValues(const std::vector<dReal>& values, uint32_t bC
     if( _vActiveDOFIndices.size() > 0 ) {
         GetDOFValues(_vTempRobotJoints);
         for(size_t i = 0; i < _vActiveDOFIndices.size(); ++i) {
-            _vTempRobotJoints[_vActiveDOFIndices[i]] = values[i];
+            _vTempRobotJoints[_vActiveDOFIndices[i]] = pValues[i];
         }
         if( (int)_vActiveDOFIndices.size() < _nActiveDOF ) {
             SetDOFValues(_vTempRobotJoints, t, bCheckLimits);
@@ -682,20 +708,25 @@ void RobotBase::SetActiveDOFValues(const std::vector<dReal>& values, uint32_t bC
 
 void RobotBase::GetActiveDOFValues(std::vector<dReal>& values) const
 {
-    if( _nActiveDOF < 0 ) {
-        GetDOFValues(values);
+    values.resize(GetActiveDOF());
+    if( values.size() == 0 ) {
         return;
     }
+    GetActiveDOFValues(&values[0], values.size());
+}
 
-    values.resize(GetActiveDOF());
-    if( values.size() == 0 ) {
+void RobotBase::GetActiveDOFValues(dReal* pValues, size_t numvalues) const
+{
+    if( _nActiveDOF < 0 ) {
+        GetDOFValues(pValues, numvalues);
         return;
     }
-    vector<dReal>::iterator itvalues = values.begin();
+    OPENRAVE_ASSERT_OP_FORMAT((int)numvalues,>=,GetActiveDOF(), "not enough space for values %d<%d",numvalues%GetActiveDOF(),ORE_InvalidArguments);
+
     if( _vActiveDOFIndices.size() != 0 ) {
         GetDOFValues(_vTempRobotJoints);
         FOREACHC(it, _vActiveDOFIndices) {
-            *itvalues++ = _vTempRobotJoints[*it];
+            *pValues++ = _vTempRobotJoints[*it];
         }
     }
 
@@ -706,7 +737,9 @@ void RobotBase::GetActiveDOFValues(std::vector<dReal>& values) const
     if( _nAffineDOFs & OpenRAVE::DOF_RotationQuat ) {
         t.rot = quatMultiply(quatInverse(_vRotationQuatLimitStart), t.rot);
     }
-    RaveGetAffineDOFValuesFromTransform(itvalues,t,_nAffineDOFs,vActvAffineRotationAxis);
+    _vTempAffineValues.resize(_nActiveDOF-_vActiveDOFIndices.size());
+    RaveGetAffineDOFValuesFromTransform(_vTempAffineValues.begin(),t,_nAffineDOFs,vActvAffineRotationAxis);
+    std::copy(_vTempAffineValues.begin(), _vTempAffineValues.end(), pValues);
 }
 
 void RobotBase::SetActiveDOFVelocities(const std::vector<dReal>& velocities, uint32_t bCheckLimits)
@@ -1447,6 +1480,7 @@ const std::set<int>& RobotBase::GetNonAdjacentLinks(int adjacentoptions) const
             }
         }
         _nNonAdjacentLinkCache |= requestedoptions;
+        _nNonAdjacentLinkUpdateStamp++;
     }
     return _setNonAdjacentLinks.at(adjacentoptions);
 }
@@ -1633,6 +1667,15 @@ void RobotBase::ReleaseAllGrabbed()
     }
 }
 
+void RobotBase::SetGrabbedCollidingLinksCacheResolution(dReal fResolution)
+{
+    OPENRAVE_ASSERT_OP(fResolution,>=,0);
+    if( fResolution != _fGrabbedCollidingLinksCacheResolution ) {
+        _fGrabbedCollidingLinksCacheResolution = fResolution;
+        _mapGrabbedCollidingLinksCache.clear();
+    }
+}
+
 void RobotBase::RegrabAll()
 {
     CollisionCheckerBasePtr collisionchecker = !!_selfcollisionchecker ? _selfcollisionchecker : GetEnv()->GetCollisionChecker();
@@ -2244,6 +2287,7 @@ void RobotBase::SimulationStep(dReal fElapsedTime)
 void RobotBase::_ComputeInternalInformation()
 {
     KinBody::_ComputeInternalInformation();
+    _mapGrabbedCollidingLinksCache.clear();
     _vAllDOFIndices.resize(GetDOF());
     for(int i = 0; i < GetDOF(); ++i) {
         _vAllDOFIndices[i] = i;
@@ -2360,6 +2404,9 @@ void RobotBase::_PostprocessChangedParameters(uint32_t parameters)
             (*itmanip)->__hashkinematicsstructure.resize(0);
         }
     }
+    if( parameters & (Prop_JointMimic|Prop_JointOffset|Prop_LinkGeometry|Prop_LinkGeometryGroup) ) {
+        _mapGrabbedCollidingLinksCache.clear();
+    }
     KinBody::_PostprocessChangedParameters(parameters);
 
     if( (parameters&Prop_LinkEnable) == Prop_LinkEnable ) {
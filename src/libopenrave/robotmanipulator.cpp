@@ -207,6 +207,7 @@ bool RobotBase::Manipulator::FindIKSolution(const IkParameterization& goal, cons
         localgoal=goal;
     }
     boost::shared_ptr< vector<dReal> > psolution(&solution, utils::null_deleter());
+    utils::ProfileZone profilezone("IkSolverBase::Solve");
     return vFreeParameters.size() == 0 ? pIkSolver->Solve(localgoal, solution, filteroptions, psolution) : pIkSolver->Solve(localgoal, solution, vFreeParameters, filteroptions, psolution);
 }
 
@@ -227,6 +228,7 @@ bool RobotBase::Manipulator::FindIKSolutions(const IkParameterization& goal, con
     else {
         localgoal=goal;
     }
+    utils::ProfileZone profilezone("IkSolverBase::SolveAll");
     return vFreeParameters.size() == 0 ? pIkSolver->SolveAll(localgoal,filteroptions,solutions) : pIkSolver->SolveAll(localgoal,vFreeParameters,filteroptions,solutions);
 }
 
@@ -254,6 +256,7 @@ bool RobotBase::Manipulator::FindIKSolution(const IkParameterization& goal, cons
     else {
         localgoal=goal;
     }
+    utils::ProfileZone profilezone("IkSolverBase::Solve");
     return vFreeParameters.size() == 0 ? pIkSolver->Solve(localgoal, solution, filteroptions, ikreturn) : pIkSolver->Solve(localgoal, solution, vFreeParameters, filteroptions, ikreturn);
 }
 
@@ -274,6 +277,7 @@ bool RobotBase::Manipulator::FindIKSolutions(const IkParameterization& goal, con
     else {
         localgoal=goal;
     }
+    utils::ProfileZone profilezone("IkSolverBase::SolveAll");
     return vFreeParameters.size() == 0 ? pIkSolver->SolveAll(localgoal,filteroptions,vikreturns) : pIkSolver->SolveAll(localgoal,vFreeParameters,filteroptions,vikreturns);
 }
 
@@ -817,6 +821,102 @@ bool RobotBase::Manipulator::CheckEndEffectorSelfCollision(const Transform& tEE,
     return bincollision;
 }
 
+/// \brief conservative bounding boxes of an end effector that is rigidly moved to sampled transforms, used to skip collision checks of samples that are far from everything
+class EndEffectorSampleCuller
+{
+public:
+    /// \param vchildlinks the links that move with the end effector
+    /// \param tEE the current transform of the end effector
+    /// \param vsamplecenter the position of the end effector origin in all the samples
+    EndEffectorSampleCuller(RobotBasePtr probot, const std::vector<KinBody::LinkPtr>& vchildlinks, const Transform& tEE, const Vector& vsamplecenter)
+    {
+        Transform tinvEE = tEE.inverse();
+        _vparts.reserve(vchildlinks.size());
+        FOREACHC(itlink, vchildlinks) {
+            _AddPart(tinvEE*(*itlink)->GetTransform(), (*itlink)->ComputeLocalAABB());
+        }
+        // bodies grabbed by the end effector move with it, their world aabb is taken as a box in the current world frame
+        std::vector<KinBodyPtr> vgrabbed;
+        probot->GetGrabbed(vgrabbed);
+        FOREACHC(itgrabbed, vgrabbed) {
+            KinBody::LinkPtr pgrabbinglink = probot->IsGrabbing(*itgrabbed);
+            if( !!pgrabbinglink && find(vchildlinks.begin(), vchildlinks.end(), pgrabbinglink) != vchildlinks.end() ) {
+                _AddPart(tinvEE, (*itgrabbed)->ComputeAABB());
+            }
+        }
+
+        // every point of the end effector keeps its distance to the end effector origin, so all samples around vsamplecenter stay inside one sphere.
+        // only the bodies overlapping the box of that sphere can collide with any sample. the robot and its attached bodies are ignored by the link checks.
+        dReal fradius = 0;
+        FOREACHC(itpart, _vparts) {
+            fradius = max(fradius, RaveSqrt((itpart->first*itpart->second.pos).lengthsqr3()) + RaveSqrt(itpart->second.extents.lengthsqr3()));
+        }
+        std::set<KinBodyPtr> setattached;
+        probot->GetAttached(setattached);
+        std::vector<KinBodyPtr> vbodies;
+        probot->GetEnv()->GetBodies(vbodies);
+        FOREACHC(itbody, vbodies) {
+            if( setattached.find(*itbody) != setattached.end() ) {
+                continue;
+            }
+            AABB ab = (*itbody)->ComputeAABB();
+            if( _Overlaps(ab, vsamplecenter, Vector(fradius,fradius,fradius)) ) {
+                _vobstacles.push_back(ab);
+            }
+        }
+    }
+
+    /// \return true if the end effector at tsample cannot be in collision with the environment
+    bool IsFree(const Transform& tsample) const
+    {
+        if( _vobstacles.size() == 0 || _vparts.size() == 0 ) {
+            return true;
+        }
+        Vector vmin, vmax;
+        for(size_t ipart = 0; ipart < _vparts.size(); ++ipart) {
+            TransformMatrix t(tsample*_vparts[ipart].first);
+            const AABB& ab = _vparts[ipart].second;
+            Vector vpos = t*ab.pos, vextents;
+            for(int i = 0; i < 3; ++i) {
+                vextents[i] = RaveFabs(t.m[4*i+0])*ab.extents.x + RaveFabs(t.m[4*i+1])*ab.extents.y + RaveFabs(t.m[4*i+2])*ab.extents.z;
+            }
+            if( ipart == 0 ) {
+                vmin = vpos - vextents;
+                vmax = vpos + vextents;
+            }
+            else {
+                for(int i = 0; i < 3; ++i) {
+                    vmin[i] = min(vmin[i], vpos[i]-vextents[i]);
+                    vmax[i] = max(vmax[i], vpos[i]+vextents[i]);
+                }
+            }
+        }
+        Vector vcenter = 0.5*(vmin+vmax), vhalf = 0.5*(vmax-vmin);
+        FOREACHC(itobstacle, _vobstacles) {
+            if( _Overlaps(*itobstacle, vcenter, vhalf) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    void _AddPart(const Transform& tEEpart, const AABB& ab)
+    {
+        if( ab.extents.x > 0 || ab.extents.y > 0 || ab.extents.z > 0 ) {
+            _vparts.push_back(std::make_pair(tEEpart, ab));
+        }
+    }
+
+    static bool _Overlaps(const AABB& ab, const Vector& vcenter, const Vector& vhalf)
+    {
+        return RaveFabs(ab.pos.x-vcenter.x) <= ab.extents.x+vhalf.x && RaveFabs(ab.pos.y-vcenter.y) <= ab.extents.y+vhalf.y && RaveFabs(ab.pos.z-vcenter.z) <= ab.extents.z+vhalf.z;
+    }
+
+    std::vector< std::pair<Transform, AABB> > _vparts; ///< transform of the box frame in the end effector frame, and the box in that frame
+    std::vector<AABB> _vobstacles; ///< world boxes of the bodies that are close enough to collide with some sample
+};
+
 bool RobotBase::Manipulator::CheckEndEffectorCollision(const IkParameterization& ikparam, CollisionReportPtr report, int numredundantsamples) const
 {
     if( ikparam.GetType() == IKP_Transform6D ) {
@@ -829,9 +929,13 @@ bool RobotBase::Manipulator::CheckEndEffectorCollision(const IkParameterization&
             tStartEE.rot = quatRotateDirection(_info._vdirection, ikparam.GetTranslationDirection5D().dir);
             tStartEE.trans = ikparam.GetTranslationDirection5D().pos;
             Vector qdelta = quatFromAxisAngle(_info._vdirection, 2*M_PI/dReal(numredundantsamples));
+            // the samples are rotations about the end effector origin, so most of them can be accepted by bounding boxes alone
+            std::vector<LinkPtr> vchildlinks;
+            GetChildLinks(vchildlinks);
+            EndEffectorSampleCuller culler(probot, vchildlinks, GetTransform(), tStartEE.trans);
             bool bNotInCollision = false;
             for(int i = 0; i < numredundantsamples; ++i) {
-                if( !CheckEndEffectorCollision(tStartEE,report) ) {
+                if( culler.IsFree(tStartEE) || !CheckEndEffectorCollision(tStartEE,report) ) {
                     // doesn't collide, but will need to verify that there actually exists an IK solution there...
                     // if we accidentally return here even there's no IK solution, then later processes could waste a lot of time looking for it.
                     bNotInCollision = true;
@@ -868,6 +972,7 @@ bool RobotBase::Manipulator::CheckEndEffectorCollision(const IkParameterization&
     // need to use free params here since sometimes IK can have 3+ free DOF and it would freeze searching for all of them
     std::vector<dReal> vFreeParameters;
     pIkSolver->GetFreeParameters(vFreeParameters);
+    utils::ProfileZone profilezone("IkSolverBase::Solve");
     if( pIkSolver->Solve(localgoal, std::vector<dReal>(), vFreeParameters, IKFO_CheckEnvCollisions|IKFO_IgnoreCustomFilters, pikreturn) ) {
         return false;
     }
@@ -1127,6 +1232,13 @@ void RobotBase::Manipulator::CalculateAngularVelocityJacobian(boost::multi_array
     }
 }
 
+void RobotBase::Manipulator::CalculateJacobians(std::vector<dReal>& jacobian) const
+{
+    RobotBasePtr probot(__probot);
+    std::vector< std::pair<int, Vector> > vlinkpositions(1, std::make_pair(__pEffector->GetIndex(), __pEffector->GetTransform() * _info._tLocalTool.trans));
+    probot->ComputeJacobians(vlinkpositions, jacobian, __varmdofindices);
+}
+
 void RobotBase::Manipulator::serialize(std::ostream& o, int options, IkParameterizationType iktype) const
 {
     if( options & SO_RobotManipulators ) {
@@ -99,7 +99,7 @@ UserDataPtr SimpleSensorSystem::RegisterXMLReaderId(EnvironmentBasePtr penv, con
     return RaveRegisterXMLReader(PT_KinBody,xmlid, boost::bind(&SimpleSensorSystem::CreateXMLReaderId,xmlid, _1,_2));
 }
 
-SimpleSensorSystem::SimpleSensorSystem(const std::string& xmlid, EnvironmentBasePtr penv) : SensorSystemBase(penv), _expirationtime(2000000), _bShutdown(false), _threadUpdate(boost::bind(&SimpleSensorSystem::_UpdateBodiesThread,this))
+SimpleSensorSystem::SimpleSensorSystem(const std::string& xmlid, EnvironmentBasePtr penv) : SensorSystemBase(penv), _expirationtime(2000000), _ftranslationthresh(0), _frotationthresh(0), _bShutdown(false), _threadUpdate(boost::bind(&SimpleSensorSystem::_UpdateBodiesThread,this))
 {
     _xmlid = xmlid;
     std::transform(_xmlid.begin(), _xmlid.end(), _xmlid.begin(), ::tolower);
@@ -116,6 +116,7 @@ void SimpleSensorSystem::Reset()
 {
     boost::mutex::scoped_lock lock(_mutex);
     _mapbodies.clear();
+    _mapqueuedtransforms.clear();
 }
 
 void SimpleSensorSystem::AddRegisteredBodies(const std::vector<KinBodyPtr>& vbodies)
@@ -209,6 +210,21 @@ bool SimpleSensorSystem::SwitchBody(KinBodyPtr pbody1, KinBodyPtr pbody2)
     return true;
 }
 
+void SimpleSensorSystem::QueueTransforms(const std::vector< std::pair<int, Transform> >& vtransforms)
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    FOREACHC(it, vtransforms) {
+        _mapqueuedtransforms[it->first] = it->second;
+    }
+}
+
+void SimpleSensorSystem::SetUpdateThresholds(dReal ftranslationthresh, dReal frotationthresh)
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    _ftranslationthresh = ftranslationthresh;
+    _frotationthresh = frotationthresh;
+}
+
 boost::shared_ptr<SimpleSensorSystem::BodyData> SimpleSensorSystem::CreateBodyData(KinBodyPtr pbody, boost::shared_ptr<XMLData const> pdata)
 {
     boost::shared_ptr<XMLData> pnewdata(new XMLData(_xmlid));
@@ -220,6 +236,12 @@ void SimpleSensorSystem::_UpdateBodies(list<SimpleSensorSystem::SNAPSHOT>& listb
 {
     EnvironmentMutex::scoped_lock lockenv(GetEnv()->GetMutex()); // always lock environment to preserve mutex order
     uint64_t curtime = utils::GetMicroTime();
+    dReal ftranslationthresh, frotationthresh;
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        ftranslationthresh = _ftranslationthresh;
+        frotationthresh = _frotationthresh;
+    }
     if( listbodies.size() > 0 ) {
 
         FOREACH(it, listbodies) {
@@ -233,9 +255,18 @@ void SimpleSensorSystem::_UpdateBodies(list<SimpleSensorSystem::SNAPSHOT>& listb
             TransformMatrix tlink = plink->GetTransform();
             TransformMatrix tbase = plink->GetParent()->GetTransform();
             TransformMatrix toffset = tbase * tlink.inverse() * it->first->_initdata->transOffset;
-            TransformMatrix tfinal = toffset * it->second*it->first->_initdata->transPreOffset;
+            Transform tfinal = toffset * it->second*it->first->_initdata->transPreOffset;
 
-            plink->GetParent()->SetTransform(tfinal);
+            // skip small changes so that the bodies keep their update stamps and the collision checkers do not have to synchronize them
+            bool bmove = true;
+            if( ftranslationthresh > 0 ) {
+                Transform tcur = plink->GetParent()->GetTransform();
+                dReal fcosangle = RaveFabs(tfinal.rot.dot(tcur.rot));
+                bmove = (tfinal.trans-tcur.trans).lengthsqr3() >= ftranslationthresh*ftranslationthresh || 2*RaveAcos(min(dReal(1),fcosangle)) >= frotationthresh;
+            }
+            if( bmove ) {
+                plink->GetParent()->SetTransform(tfinal);
+            }
             it->first->lastupdated = curtime;
             it->first->tnew = it->second;
 
@@ -277,9 +308,25 @@ void SimpleSensorSystem::_UpdateBodies(list<SimpleSensorSystem::SNAPSHOT>& listb
 void SimpleSensorSystem::_UpdateBodiesThread()
 {
     list< SNAPSHOT > listbodies;
+    std::map<int, Transform> mapqueuedtransforms;
 
     while(!_bShutdown) {
         {
+            // take all the queued transforms so that they are applied with one environment lock
+            listbodies.clear();
+            {
+                boost::mutex::scoped_lock lock(_mutex);
+                mapqueuedtransforms.swap(_mapqueuedtransforms);
+                if( mapqueuedtransforms.size() > 0 ) {
+                    FOREACH(itbody, _mapbodies) {
+                        std::map<int, Transform>::iterator ittrans = mapqueuedtransforms.find(itbody->second->GetId());
+                        if( ittrans != mapqueuedtransforms.end() && itbody->second->IsEnabled() ) {
+                            listbodies.push_back(SNAPSHOT(itbody->second, ittrans->second));
+                        }
+                    }
+                }
+            }
+            mapqueuedtransforms.clear();
             _UpdateBodies(listbodies);
         }
         usleep(10000); // 10ms
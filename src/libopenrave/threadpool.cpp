@@ -0,0 +1,419 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2006-2014 Rosen Diankov (rosen.diankov@gmail.com)
+//
+// This file is part of OpenRAVE.
+// OpenRAVE is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "libopenrave.h"
+
+#include <deque>
+#include <boost/thread/tss.hpp>
+#include <boost/thread/condition.hpp>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace OpenRAVE {
+namespace utils {
+
+class ThreadPoolTaskGroupState
+{
+public:
+    ThreadPoolTaskGroupState(const std::string& tasktype, const boost::function<bool()>& cancelfn) : _tasktype(tasktype), _cancelfn(cancelfn), _numpending(0), _bCancelled(false), _bError(false) {
+    }
+
+    bool IsCancelled() const {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _bCancelled;
+    }
+
+    std::string _tasktype;
+    boost::function<bool()> _cancelfn; ///< only called by the thread in ThreadPoolTaskGroup::Wait
+    mutable boost::mutex _mutex;
+    boost::condition _condDone;
+    size_t _numpending; ///< submitted tasks that did not finish
+    bool _bCancelled;
+    bool _bError;
+    std::string _errormessage; ///< message of the first exception thrown by a task
+};
+
+typedef boost::shared_ptr<ThreadPoolTaskGroupState> ThreadPoolTaskGroupStatePtr;
+
+struct ThreadPoolTask
+{
+    boost::function<void()> fn;
+    ThreadPoolTaskGroupStatePtr group;
+    uint64_t queuedtime;
+};
+
+typedef boost::shared_ptr<ThreadPoolTask> ThreadPoolTaskPtr;
+
+struct ThreadPoolTaskTypeStatistics
+{
+    ThreadPoolTaskTypeStatistics() : count(0), cancelled(0), total(0), max(0), queuetotal(0) {
+    }
+    uint64_t count, cancelled, total, max, queuetotal; ///< times in nanoseconds
+};
+
+/// \brief process-wide pool of workers, each with its own deque of tasks
+///
+/// A worker takes the newest task of its own deque so that nested tasks run while their data is still in the cache, and steals the oldest task
+/// of the other deques when its own is empty. All deques are protected by one mutex since the tasks are coarse ranges of jobs.
+class ThreadPool
+{
+public:
+    ThreadPool() : _numqueued(0), _nextworker(0), _bStop(false), _bResizing(false) {
+    }
+
+    ~ThreadPool() {
+        _StopWorkers();
+    }
+
+    void SetSize(int numthreads, const std::vector<int>& vcpus)
+    {
+        if( !!_currentworker.get() ) {
+            throw OPENRAVE_EXCEPTION_FORMAT0("cannot resize the thread pool from one of its tasks", ORE_InvalidState);
+        }
+        if( numthreads <= 0 ) {
+            numthreads = _GetDefaultSize();
+        }
+        boost::mutex::scoped_lock resizelock(_mutexresize);
+        {
+            boost::mutex::scoped_lock lock(_mutex);
+            _bResizing = true;
+        }
+        _StopWorkers();
+        boost::mutex::scoped_lock lock(_mutex);
+        _vcpus = vcpus;
+        _StartWorkers(numthreads);
+        _bResizing = false;
+    }
+
+    int GetSize()
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _vthreads.size() > 0 ? (int)_vthreads.size() : _GetDefaultSize();
+    }
+
+    void Submit(ThreadPoolTaskPtr task)
+    {
+        task->queuedtime = GetNanoPerformanceTime();
+        boost::mutex::scoped_lock lock(_mutex);
+        if( _vthreads.size() == 0 && !_bResizing ) {
+            _StartWorkers(_GetDefaultSize());
+        }
+        if( _vworkerdeques.size() == 0 ) {
+            // resizing the first time, the task is moved to the new workers when they start
+            _vworkerdeques.resize(1);
+        }
+        int* pworker = _currentworker.get();
+        if( !!pworker && *pworker < (int)_vworkerdeques.size() ) {
+            _vworkerdeques.at(*pworker).push_back(task);
+        }
+        else {
+            _nextworker %= _vworkerdeques.size();
+            _vworkerdeques.at(_nextworker).push_back(task);
+            _nextworker = (_nextworker+1)%_vworkerdeques.size();
+        }
+        ++_numqueued;
+        _condWork.notify_one();
+    }
+
+    /// \brief removes the newest queued task of the group, or returns an empty pointer if it has none
+    ThreadPoolTaskPtr PopGroupTask(ThreadPoolTaskGroupStatePtr group)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        FOREACH(itdeque, _vworkerdeques) {
+            for(std::deque<ThreadPoolTaskPtr>::reverse_iterator ittask = itdeque->rbegin(); ittask != itdeque->rend(); ++ittask) {
+                if( (*ittask)->group == group ) {
+                    ThreadPoolTaskPtr task = *ittask;
+                    itdeque->erase(--ittask.base());
+                    --_numqueued;
+                    return task;
+                }
+            }
+        }
+        return ThreadPoolTaskPtr();
+    }
+
+    void RunTask(ThreadPoolTaskPtr task)
+    {
+        ThreadPoolTaskGroupStatePtr group = task->group;
+        uint64_t starttime = GetNanoPerformanceTime();
+        bool bcancelled = group->IsCancelled();
+        if( !bcancelled ) {
+            std::string errormessage;
+            bool berror = false;
+            try {
+                task->fn();
+            }
+            catch(const std::exception& ex) {
+                errormessage = ex.what();
+                berror = true;
+            }
+            catch(...) {
+                errormessage = "unknown exception";
+                berror = true;
+            }
+            if( berror ) {
+                RAVELOG_DEBUG_FORMAT("%s task failed: %s", group->_tasktype%errormessage);
+                boost::mutex::scoped_lock lock(group->_mutex);
+                if( !group->_bError ) {
+                    group->_bError = true;
+                    group->_errormessage = errormessage;
+                }
+            }
+        }
+        task->fn.clear();
+        uint64_t endtime = GetNanoPerformanceTime();
+        {
+            boost::mutex::scoped_lock lock(_mutexstats);
+            ThreadPoolTaskTypeStatistics& stats = _mapstats[group->_tasktype];
+            if( bcancelled ) {
+                stats.cancelled++;
+            }
+            else {
+                stats.count++;
+                stats.total += endtime-starttime;
+                stats.max = std::max(stats.max, endtime-starttime);
+            }
+            stats.queuetotal += starttime-task->queuedtime;
+        }
+        boost::mutex::scoped_lock lock(group->_mutex);
+        if( --group->_numpending == 0 ) {
+            group->_condDone.notify_all();
+        }
+    }
+
+    void ResetStatistics()
+    {
+        boost::mutex::scoped_lock lock(_mutexstats);
+        _mapstats.clear();
+    }
+
+    void WriteStatistics(std::ostream& sout)
+    {
+        std::map<std::string, ThreadPoolTaskTypeStatistics> mapstats;
+        {
+            boost::mutex::scoped_lock lock(_mutexstats);
+            mapstats = _mapstats;
+        }
+        std::stringstream ss;
+        ss << std::setprecision(9) << "{";
+        FOREACH(itstats, mapstats) {
+            if( itstats != mapstats.begin() ) {
+                ss << ", ";
+            }
+            const ThreadPoolTaskTypeStatistics& stats = itstats->second;
+            ss << "\"" << itstats->first << "\": {\"count\": " << stats.count << ", \"cancelled\": " << stats.cancelled << ", \"total\": " << 1e-9*stats.total << ", \"max\": " << 1e-9*stats.max << ", \"queuetotal\": " << 1e-9*stats.queuetotal << "}";
+        }
+        ss << "}";
+        sout << ss.str();
+    }
+
+private:
+    static int _GetDefaultSize() {
+        return std::max(1, (int)boost::thread::hardware_concurrency());
+    }
+
+    /// \brief _mutex has to be locked, the tasks queued on the previous workers are spread over the new ones
+    void _StartWorkers(int numthreads)
+    {
+        std::vector<ThreadPoolTaskPtr> vtasks;
+        FOREACH(itdeque, _vworkerdeques) {
+            vtasks.insert(vtasks.end(), itdeque->begin(), itdeque->end());
+        }
+        _vworkerdeques.resize(0);
+        _vworkerdeques.resize(numthreads);
+        for(size_t itask = 0; itask < vtasks.size(); ++itask) {
+            _vworkerdeques[itask%numthreads].push_back(vtasks[itask]);
+        }
+        _nextworker = 0;
+        _bStop = false;
+        for(int ithread = 0; ithread < numthreads; ++ithread) {
+            boost::shared_ptr<boost::thread> pthread(new boost::thread(boost::bind(&ThreadPool::_WorkerThread, this, ithread)));
+#ifdef __linux__
+            if( _vcpus.size() > 0 ) {
+                cpu_set_t cpuset;
+                CPU_ZERO(&cpuset);
+                CPU_SET(_vcpus[ithread%_vcpus.size()], &cpuset);
+                if( pthread_setaffinity_np(pthread->native_handle(), sizeof(cpu_set_t), &cpuset) != 0 ) {
+                    RAVELOG_WARN_FORMAT("failed to pin thread pool worker %d to cpu %d", ithread%_vcpus[ithread%_vcpus.size()]);
+                }
+            }
+#else
+            if( _vcpus.size() > 0 && ithread == 0 ) {
+                RAVELOG_WARN("setting the cpus of the thread pool is only supported on linux\n");
+            }
+#endif
+            _vthreads.push_back(pthread);
+        }
+    }
+
+    /// \brief joins the workers, their queued tasks are kept until the next _StartWorkers
+    void _StopWorkers()
+    {
+        std::vector< boost::shared_ptr<boost::thread> > vthreads;
+        {
+            boost::mutex::scoped_lock lock(_mutex);
+            _bStop = true;
+            _condWork.notify_all();
+            vthreads.swap(_vthreads);
+        }
+        FOREACH(itthread, vthreads) {
+            (*itthread)->join();
+        }
+    }
+
+    void _WorkerThread(int iworker)
+    {
+        _currentworker.reset(new int(iworker));
+        boost::mutex::scoped_lock lock(_mutex);
+        while(!_bStop) {
+            ThreadPoolTaskPtr task;
+            std::deque<ThreadPoolTaskPtr>& workerdeque = _vworkerdeques.at(iworker);
+            if( workerdeque.size() > 0 ) {
+                task = workerdeque.back();
+                workerdeque.pop_back();
+            }
+            else {
+                for(size_t i = 1; i < _vworkerdeques.size(); ++i) {
+                    std::deque<ThreadPoolTaskPtr>& otherdeque = _vworkerdeques[(iworker+i)%_vworkerdeques.size()];
+                    if( otherdeque.size() > 0 ) {
+                        task = otherdeque.front();
+                        otherdeque.pop_front();
+                        break;
+                    }
+                }
+            }
+            if( !task ) {
+                _condWork.wait(lock);
+                continue;
+            }
+            --_numqueued;
+            lock.unlock();
+            RunTask(task);
+            task.reset();
+            lock.lock();
+        }
+    }
+
+    std::vector< std::deque<ThreadPoolTaskPtr> > _vworkerdeques; ///< protected by _mutex
+    std::vector< boost::shared_ptr<boost::thread> > _vthreads;
+    std::vector<int> _vcpus;
+    size_t _numqueued;
+    size_t _nextworker; ///< deque that the next task submitted from outside of the pool goes to
+    bool _bStop;
+    bool _bResizing; ///< true while SetSize replaces the workers, so that Submit does not start its own
+    boost::mutex _mutex, _mutexresize, _mutexstats;
+    boost::condition _condWork;
+    boost::thread_specific_ptr<int> _currentworker; ///< index of the worker running on the calling thread
+    std::map<std::string, ThreadPoolTaskTypeStatistics> _mapstats; ///< protected by _mutexstats
+};
+
+static ThreadPool& GetThreadPool()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+void SetThreadPoolSize(int numthreads, const std::vector<int>& vcpus)
+{
+    GetThreadPool().SetSize(numthreads, vcpus);
+}
+
+int GetThreadPoolSize()
+{
+    return GetThreadPool().GetSize();
+}
+
+void ResetThreadPoolStatistics()
+{
+    GetThreadPool().ResetStatistics();
+}
+
+void WriteThreadPoolStatistics(std::ostream& sout)
+{
+    GetThreadPool().WriteStatistics(sout);
+}
+
+ThreadPoolTaskGroup::ThreadPoolTaskGroup(const std::string& tasktype, const boost::function<bool()>& cancelfn)
+{
+    _state.reset(new ThreadPoolTaskGroupState(tasktype, cancelfn));
+}
+
+ThreadPoolTaskGroup::~ThreadPoolTaskGroup()
+{
+    Cancel();
+    boost::mutex::scoped_lock lock(_state->_mutex);
+    while(_state->_numpending > 0) {
+        // the skipped tasks still have to be popped by the workers
+        _state->_condDone.wait(lock);
+    }
+}
+
+void ThreadPoolTaskGroup::Submit(const boost::function<void()>& fn)
+{
+    ThreadPoolTaskPtr task(new ThreadPoolTask());
+    task->fn = fn;
+    task->group = _state;
+    {
+        boost::mutex::scoped_lock lock(_state->_mutex);
+        _state->_numpending++;
+    }
+    GetThreadPool().Submit(task);
+}
+
+void ThreadPoolTaskGroup::Wait()
+{
+    ThreadPool& pool = GetThreadPool();
+    while(1) {
+        if( !!_state->_cancelfn && !_state->IsCancelled() && _state->_cancelfn() ) {
+            Cancel();
+        }
+        ThreadPoolTaskPtr task = pool.PopGroupTask(_state);
+        if( !!task ) {
+            pool.RunTask(task);
+            continue;
+        }
+        boost::mutex::scoped_lock lock(_state->_mutex);
+        if( _state->_numpending == 0 ) {
+            break;
+        }
+        // wake up regularly to run the tasks that the running ones submit and to poll the cancel function
+        _state->_condDone.timed_wait(lock, boost::posix_time::milliseconds(1));
+    }
+    boost::mutex::scoped_lock lock(_state->_mutex);
+    if( _state->_bError ) {
+        std::string errormessage = _state->_errormessage;
+        _state->_bError = false;
+        _state->_errormessage.clear();
+        throw OPENRAVE_EXCEPTION_FORMAT("%s task failed: %s", _state->_tasktype%errormessage, ORE_Failed);
+    }
+}
+
+void ThreadPoolTaskGroup::Cancel()
+{
+    boost::mutex::scoped_lock lock(_state->_mutex);
+    _state->_bCancelled = true;
+}
+
+bool ThreadPoolTaskGroup::IsCancelled() const
+{
+    return _state->IsCancelled();
+}
+
+} // utils
+} // OpenRAVE
@@ -25,8 +25,61 @@ TrajectoryBase::TrajectoryBase(EnvironmentBasePtr penv) : InterfaceBase(PT_Traje
 {
 }
 
+/// first bytes of the binary trajectory format, the first byte can never start an XML document
+static const char s_binaryTrajectoryMagic[4] = { '\x89', 'O', 'R', 'T' };
+static const uint32_t s_binaryTrajectoryVersion = 1;
+
+static bool _IsHostLittleEndian()
+{
+    const uint16_t value = 1;
+    return *reinterpret_cast<const uint8_t*>(&value) == 1;
+}
+
+/// \brief writes the lower numbytes of value in little-endian order
+static void _WriteBinaryUInt(std::ostream& O, uint64_t value, int numbytes)
+{
+    char buf[8];
+    for(int i = 0; i < numbytes; ++i) {
+        buf[i] = static_cast<char>((value>>(8*i))&0xff);
+    }
+    O.write(buf, numbytes);
+}
+
+static uint64_t _ReadBinaryUInt(std::istream& I, int numbytes)
+{
+    unsigned char buf[8];
+    if( !I.read(reinterpret_cast<char*>(buf), numbytes) ) {
+        throw OPENRAVE_EXCEPTION_FORMAT0(_("binary trajectory is truncated"), ORE_InvalidArguments);
+    }
+    uint64_t value = 0;
+    for(int i = 0; i < numbytes; ++i) {
+        value |= static_cast<uint64_t>(buf[i])<<(8*i);
+    }
+    return value;
+}
+
+static void _WriteBinaryString(std::ostream& O, const std::string& s)
+{
+    _WriteBinaryUInt(O, s.size(), 4);
+    O.write(s.c_str(), s.size());
+}
+
+static void _ReadBinaryString(std::istream& I, std::string& s)
+{
+    s.resize(_ReadBinaryUInt(I, 4));
+    if( s.size() > 0 && !I.read(&s[0], s.size()) ) {
+        throw OPENRAVE_EXCEPTION_FORMAT0(_("binary trajectory is truncated"), ORE_InvalidArguments);
+    }
+}
+
 void TrajectoryBase::serialize(std::ostream& O, int options) const
 {
+    if( options & SO_BinaryTrajectory ) {
+        std::vector<dReal> data;
+        GetWaypoints(0,GetNumWaypoints(),data);
+        _SerializeBinary(O, GetConfigurationSpecification(), data.size() > 0 ? &data[0] : NULL, GetNumWaypoints(), options);
+        return;
+    }
     O << "<trajectory type=\"" << GetXMLId() << "\">" << endl << GetConfigurationSpecification();
     O << "<data count=\"" << GetNumWaypoints() << "\">" << endl;
     std::vector<dReal> data;
@@ -51,6 +104,17 @@ void TrajectoryBase::serialize(std::ostream& O, int options) const
 
 InterfaceBasePtr TrajectoryBase::deserialize(std::istream& I)
 {
+    if( _IsBinaryFormat(I) ) {
+        ConfigurationSpecification spec;
+        size_t numwaypoints = 0;
+        _DeserializeBinaryHeader(I, spec, numwaypoints);
+        Init(spec);
+        std::vector<dReal> data(numwaypoints*spec.GetDOF());
+        _DeserializeBinaryData(I, data.size() > 0 ? &data[0] : NULL, data.size());
+        Insert(GetNumWaypoints(), data);
+        _DeserializeBinaryFooter(I);
+        return shared_from_this();
+    }
     stringbuf buf;
     stringstream::streampos pos = I.tellg();
     I.get(buf, 0); // get all the data, yes this is inefficient, not sure if there anyway to search in streams
@@ -72,6 +136,107 @@ InterfaceBasePtr TrajectoryBase::deserialize(std::istream& I)
     return shared_from_this();
 }
 
+bool TrajectoryBase::_IsBinaryFormat(std::istream& I)
+{
+    I >> std::ws;
+    return !!I && I.peek() == static_cast<unsigned char>(s_binaryTrajectoryMagic[0]);
+}
+
+void TrajectoryBase::_SerializeBinary(std::ostream& O, const ConfigurationSpecification& spec, const dReal* pdata, size_t numwaypoints, int options) const
+{
+    O.write(s_binaryTrajectoryMagic, sizeof(s_binaryTrajectoryMagic));
+    _WriteBinaryUInt(O, s_binaryTrajectoryVersion, 4);
+    _WriteBinaryUInt(O, sizeof(dReal), 4);
+    _WriteBinaryUInt(O, spec._vgroups.size(), 4);
+    FOREACHC(itgroup, spec._vgroups) {
+        _WriteBinaryString(O, itgroup->name);
+        _WriteBinaryUInt(O, static_cast<uint32_t>(itgroup->offset), 4);
+        _WriteBinaryUInt(O, static_cast<uint32_t>(itgroup->dof), 4);
+        _WriteBinaryString(O, itgroup->interpolation);
+    }
+    _WriteBinaryUInt(O, numwaypoints, 8);
+    size_t numvalues = numwaypoints*spec.GetDOF();
+    if( _IsHostLittleEndian() ) {
+        if( numvalues > 0 ) {
+            O.write(reinterpret_cast<const char*>(pdata), numvalues*sizeof(dReal));
+        }
+    }
+    else {
+        char buf[sizeof(dReal)];
+        for(size_t i = 0; i < numvalues; ++i) {
+            const char* pvalue = reinterpret_cast<const char*>(pdata+i);
+            std::reverse_copy(pvalue, pvalue+sizeof(dReal), buf);
+            O.write(buf, sizeof(dReal));
+        }
+    }
+    _WriteBinaryString(O, GetDescription());
+    std::string readables;
+    if( GetReadableInterfaces().size() > 0 ) {
+        xmlreaders::StreamXMLWriterPtr writer(new xmlreaders::StreamXMLWriter("readable"));
+        FOREACHC(it, GetReadableInterfaces()) {
+            BaseXMLWriterPtr newwriter = writer->AddChild(it->first);
+            it->second->Serialize(newwriter,options);
+        }
+        std::stringstream ss;
+        writer->Serialize(ss);
+        readables = ss.str();
+    }
+    _WriteBinaryString(O, readables);
+}
+
+void TrajectoryBase::_DeserializeBinaryHeader(std::istream& I, ConfigurationSpecification& spec, size_t& numwaypoints)
+{
+    char magic[sizeof(s_binaryTrajectoryMagic)];
+    if( !I.read(magic, sizeof(magic)) || !std::equal(magic, magic+sizeof(magic), s_binaryTrajectoryMagic) ) {
+        throw OPENRAVE_EXCEPTION_FORMAT0(_("stream does not start with a binary trajectory"), ORE_InvalidArguments);
+    }
+    uint32_t version = _ReadBinaryUInt(I, 4);
+    if( version != s_binaryTrajectoryVersion ) {
+        throw OPENRAVE_EXCEPTION_FORMAT(_("unsupported binary trajectory version %d"), version, ORE_InvalidArguments);
+    }
+    uint32_t realsize = _ReadBinaryUInt(I, 4);
+    if( realsize != sizeof(dReal) ) {
+        throw OPENRAVE_EXCEPTION_FORMAT(_("binary trajectory has %d byte reals, but dReal is %d bytes"), realsize%sizeof(dReal), ORE_InvalidArguments);
+    }
+    spec._vgroups.resize(_ReadBinaryUInt(I, 4));
+    FOREACH(itgroup, spec._vgroups) {
+        _ReadBinaryString(I, itgroup->name);
+        itgroup->offset = static_cast<int>(_ReadBinaryUInt(I, 4));
+        itgroup->dof = static_cast<int>(_ReadBinaryUInt(I, 4));
+        _ReadBinaryString(I, itgroup->interpolation);
+    }
+    numwaypoints = _ReadBinaryUInt(I, 8);
+}
+
+void TrajectoryBase::_DeserializeBinaryData(std::istream& I, dReal* pdata, size_t numvalues)
+{
+    if( numvalues == 0 ) {
+        return;
+    }
+    if( !I.read(reinterpret_cast<char*>(pdata), numvalues*sizeof(dReal)) ) {
+        throw OPENRAVE_EXCEPTION_FORMAT(_("binary trajectory is truncated, failed to read %d values"), numvalues, ORE_InvalidArguments);
+    }
+    if( !_IsHostLittleEndian() ) {
+        for(size_t i = 0; i < numvalues; ++i) {
+            char* pvalue = reinterpret_cast<char*>(pdata+i);
+            std::reverse(pvalue, pvalue+sizeof(dReal));
+        }
+    }
+}
+
+void TrajectoryBase::_DeserializeBinaryFooter(std::istream& I)
+{
+    std::string description, readables;
+    _ReadBinaryString(I, description);
+    _ReadBinaryString(I, readables);
+    SetDescription(description);
+    if( readables.size() > 0 ) {
+        std::string xmldata = std::string("<trajectory>") + readables + std::string("</trajectory>");
+        xmlreaders::TrajectoryReader reader(GetEnv(),shared_trajectory());
+        LocalXML::ParseXMLData(BaseXMLReaderPtr(&reader,utils::null_deleter()), xmldata.c_str(), xmldata.size());
+    }
+}
+
 void TrajectoryBase::Clone(InterfaceBaseConstPtr preference, int cloningoptions)
 {
     InterfaceBase::Clone(preference,cloningoptions);
@@ -108,12 +273,55 @@ void TrajectoryBase::SamplePoints(std::vector<dReal>& data, const std::vector<dR
     std::vector<dReal> tempdata;
     data.resize(spec.GetDOF()*times.size());
     std::vector<dReal>::iterator itdata = data.begin();
+    SamplerPtr psampler = CreateSampler(spec);
     for(size_t i = 0; i < times.size(); ++i, itdata += spec.GetDOF()) {
-        Sample(tempdata, times[i], spec);
+        psampler->Sample(tempdata, times[i]);
         std::copy(tempdata.begin(), tempdata.end(), itdata);
     }
 }
 
+/// \brief the sample times of SamplePointsSameDeltaTime
+static void _GetSameDeltaTimes(std::vector<dReal>& times, dReal duration, dReal deltatime, bool ensureLastPoint)
+{
+    OPENRAVE_ASSERT_OP(deltatime,>,0);
+    size_t numpoints = (size_t)(duration/deltatime)+1;
+    times.resize(numpoints);
+    for(size_t i = 0; i < numpoints; ++i) {
+        times[i] = i*deltatime;
+    }
+    if( ensureLastPoint && times.back()+g_fEpsilon < duration ) {
+        times.push_back(duration);
+    }
+}
+
+void TrajectoryBase::SamplePointsSameDeltaTime(std::vector<dReal>& data, dReal deltatime, bool ensureLastPoint) const
+{
+    std::vector<dReal> times;
+    _GetSameDeltaTimes(times, GetDuration(), deltatime, ensureLastPoint);
+    SamplePoints(data, times);
+}
+
+void TrajectoryBase::SamplePointsSameDeltaTime(std::vector<dReal>& data, dReal deltatime, bool ensureLastPoint, const ConfigurationSpecification& spec) const
+{
+    std::vector<dReal> times;
+    _GetSameDeltaTimes(times, GetDuration(), deltatime, ensureLastPoint);
+    SamplePoints(data, times, spec);
+}
+
+TrajectoryBase::Sampler::Sampler(TrajectoryBaseConstPtr traj, const ConfigurationSpecification& spec) : _traj(traj), _spec(spec)
+{
+}
+
+void TrajectoryBase::Sampler::Sample(std::vector<dReal>& data, dReal time)
+{
+    _traj->Sample(data, time, _spec);
+}
+
+TrajectoryBase::SamplerPtr TrajectoryBase::CreateSampler(const ConfigurationSpecification& spec) const
+{
+    return SamplerPtr(new Sampler(shared_trajectory_const(), spec));
+}
+
 void TrajectoryBase::GetWaypoints(size_t startindex, size_t endindex, std::vector<dReal>& data, const ConfigurationSpecification& spec) const
 {
     RAVELOG_VERBOSE(str(boost::format("TrajectoryBase::GetWaypoints: calling slow implementation %s")%GetXMLId()));
@@ -18,10 +18,73 @@
 #include <openrave/utils.h>
 
 #include "md5.h"
+#include <boost/thread/tss.hpp>
 
 namespace OpenRAVE {
 namespace utils {
 
+MonotonicArena::MonotonicArena(size_t blocksize) : _blocksize(std::max(blocksize, size_t(64))), _curblock(0), _curoffset(0), _numallocations(0), _numresets(0)
+{
+}
+
+MonotonicArena::~MonotonicArena()
+{
+    FOREACH(itblock, _vblocks) {
+        delete[] itblock->first;
+    }
+}
+
+void* MonotonicArena::Allocate(size_t size, size_t alignment)
+{
+    OPENRAVE_ASSERT_OP_FORMAT0(alignment&(alignment-1), ==, 0, "alignment has to be a power of two", ORE_InvalidArguments);
+    boost::mutex::scoped_lock lock(_mutex);
+    while(_curblock < _vblocks.size()) {
+        char* pblock = _vblocks[_curblock].first;
+        size_t offset = (size_t)((uintptr_t)(pblock+_curoffset+alignment-1) & ~(uintptr_t)(alignment-1)) - (size_t)(uintptr_t)pblock;
+        if( offset + size <= _vblocks[_curblock].second ) {
+            _curoffset = offset + size;
+            ++_numallocations;
+            return pblock + offset;
+        }
+        // try the next block, the rest of this one stays unused until Reset
+        ++_curblock;
+        _curoffset = 0;
+    }
+    size_t blocksize = std::max(_blocksize, size+alignment);
+    _vblocks.push_back(std::make_pair(new char[blocksize], blocksize));
+    _curblock = _vblocks.size()-1;
+    char* pblock = _vblocks[_curblock].first;
+    size_t offset = (size_t)((uintptr_t)(pblock+alignment-1) & ~(uintptr_t)(alignment-1)) - (size_t)(uintptr_t)pblock;
+    _curoffset = offset + size;
+    ++_numallocations;
+    return pblock + offset;
+}
+
+void MonotonicArena::Reset()
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    _curblock = 0;
+    _curoffset = 0;
+    _numallocations = 0;
+    ++_numresets;
+}
+
+void MonotonicArena::GetStatistics(Statistics& stats) const
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    stats.numblocks = _vblocks.size();
+    stats.reservedbytes = 0;
+    stats.usedbytes = _curoffset;
+    for(size_t iblock = 0; iblock < _vblocks.size(); ++iblock) {
+        stats.reservedbytes += _vblocks[iblock].second;
+        if( iblock < _curblock ) {
+            stats.usedbytes += _vblocks[iblock].second;
+        }
+    }
+    stats.numallocations = _numallocations;
+    stats.numresets = _numresets;
+}
+
 std::string GetMD5HashString(const std::string& s)
 {
     if( s.size() == 0 )
@@ -121,5 +184,250 @@ std::string GetFilenameUntilSeparator(std::istream& sinput, char separator)
     return filename.substr( startpos, endpos-startpos+1 );
 }
 
+namespace {
+
+/// powers of ten that are exactly representable as doubles
+const double s_fExactPowersOfTen[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+inline bool IsValueSeparator(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/// \brief parses the number starting at p, returns where the number ends or NULL if p does not start with a number
+///
+/// Numbers whose mantissa fits in 53 bits and whose exponent is within the exactly representable powers of ten are computed with one
+/// multiplication or division, which is correctly rounded. Everything else goes through the classic locale stream parser.
+const char* ParseRealValue(const char* p, const char* pend, dReal& value)
+{
+    const char* pstart = p;
+    bool bnegative = false;
+    if( *p == '-' || *p == '+' ) {
+        bnegative = *p == '-';
+        ++p;
+    }
+    uint64_t mantissa = 0;
+    int exponent = 0, numdigits = 0;
+    bool btruncated = false;
+    for(; p != pend && *p >= '0' && *p <= '9'; ++p, ++numdigits) {
+        if( mantissa < 100000000000000000ULL ) {
+            mantissa = mantissa*10 + (*p-'0');
+        }
+        else {
+            ++exponent;
+            btruncated = true;
+        }
+    }
+    if( p != pend && *p == '.' ) {
+        for(++p; p != pend && *p >= '0' && *p <= '9'; ++p, ++numdigits) {
+            if( mantissa < 100000000000000000ULL ) {
+                mantissa = mantissa*10 + (*p-'0');
+                --exponent;
+            }
+            else {
+                btruncated = true;
+            }
+        }
+    }
+    if( numdigits == 0 ) {
+        return NULL;
+    }
+    if( p != pend && (*p == 'e' || *p == 'E') ) {
+        ++p;
+        bool bnegativeexp = false;
+        if( p != pend && (*p == '-' || *p == '+') ) {
+            bnegativeexp = *p == '-';
+            ++p;
+        }
+        if( p == pend || *p < '0' || *p > '9' ) {
+            return NULL;
+        }
+        int fileexponent = 0;
+        for(; p != pend && *p >= '0' && *p <= '9'; ++p) {
+            if( fileexponent < 100000 ) {
+                fileexponent = fileexponent*10 + (*p-'0');
+            }
+        }
+        exponent += bnegativeexp ? -fileexponent : fileexponent;
+    }
+    if( !btruncated && mantissa <= (1ULL<<53) && exponent >= -22 && exponent <= 22 ) {
+        double f = (double)mantissa;
+        f = exponent >= 0 ? f*s_fExactPowersOfTen[exponent] : f/s_fExactPowersOfTen[-exponent];
+        value = (dReal)(bnegative ? -f : f);
+        return p;
+    }
+    std::istringstream ss(std::string(pstart, p));
+    ss.imbue(std::locale::classic());
+    double f = 0;
+    ss >> f;
+    if( !ss ) {
+        return NULL;
+    }
+    value = (dReal)f;
+    return p;
+}
+
+} // end namespace
+
+const char* ParseRealValues(const char* pbegin, const char* pend, std::vector<dReal>& values)
+{
+    const char* p = pbegin;
+    while(1) {
+        while(p != pend && IsValueSeparator(*p)) {
+            ++p;
+        }
+        if( p == pend ) {
+            break;
+        }
+        dReal value;
+        const char* pnumberend = ParseRealValue(p, pend, value);
+        if( !pnumberend ) {
+            break;
+        }
+        values.push_back(value);
+        p = pnumberend;
+        if( p != pend && !IsValueSeparator(*p) ) {
+            // like the stream operators, keep the number and stop at the trailing characters
+            break;
+        }
+    }
+    return p;
+}
+
+void ParseRealValues(std::stringstream& ss, std::vector<dReal>& values, std::string& sbuffer)
+{
+    values.resize(0);
+    std::streamoff pos = ss.tellg();
+    if( pos < 0 ) {
+        return;
+    }
+    sbuffer = ss.str();
+    if( pos >= (std::streamoff)sbuffer.size() ) {
+        ss.setstate(std::ios::eofbit|std::ios::failbit);
+        return;
+    }
+    const char* pbegin = sbuffer.c_str()+pos, *pend = sbuffer.c_str()+sbuffer.size();
+    const char* pstop = ParseRealValues(pbegin, pend, values);
+    if( pstop == pend ) {
+        ss.setstate(std::ios::eofbit|std::ios::failbit);
+    }
+    else {
+        ss.seekg(pos + (pstop-pbegin));
+        ss.setstate(std::ios::failbit);
+    }
+}
+
+namespace {
+
+struct ProfileZoneStatistics
+{
+    ProfileZoneStatistics() : count(0), total(0), min(0), max(0) {
+    }
+    void Add(uint64_t nanoseconds) {
+        if( count == 0 || nanoseconds < min ) {
+            min = nanoseconds;
+        }
+        if( nanoseconds > max ) {
+            max = nanoseconds;
+        }
+        ++count;
+        total += nanoseconds;
+    }
+    void Merge(const ProfileZoneStatistics& r) {
+        if( r.count == 0 ) {
+            return;
+        }
+        if( count == 0 || r.min < min ) {
+            min = r.min;
+        }
+        if( r.max > max ) {
+            max = r.max;
+        }
+        count += r.count;
+        total += r.total;
+    }
+    uint64_t count, total, min, max;
+};
+
+/// \brief zones recorded by one thread. The mutex is only contended when the statistics are written or reset.
+struct ThreadProfile
+{
+    boost::mutex mutex;
+    std::map<const char*, ProfileZoneStatistics> mapzones;
+};
+
+bool s_bProfilingEnabled = false;
+boost::mutex s_profilingmutex; ///< protects s_vthreadprofiles
+std::vector< boost::shared_ptr<ThreadProfile> > s_vthreadprofiles; ///< owns the profiles so that they outlive their threads
+
+void NoThreadProfileCleanup(ThreadProfile*)
+{
+}
+
+boost::thread_specific_ptr<ThreadProfile> s_threadprofile(NoThreadProfileCleanup);
+
+}
+
+void SetProfilingEnabled(bool benabled)
+{
+    s_bProfilingEnabled = benabled;
+}
+
+bool IsProfilingEnabled()
+{
+    return s_bProfilingEnabled;
+}
+
+void AddProfileSample(const char* zonename, uint64_t nanoseconds)
+{
+    ThreadProfile* pprofile = s_threadprofile.get();
+    if( !pprofile ) {
+        boost::shared_ptr<ThreadProfile> pnewprofile(new ThreadProfile());
+        {
+            boost::mutex::scoped_lock lock(s_profilingmutex);
+            s_vthreadprofiles.push_back(pnewprofile);
+        }
+        s_threadprofile.reset(pnewprofile.get());
+        pprofile = pnewprofile.get();
+    }
+    boost::mutex::scoped_lock lock(pprofile->mutex);
+    pprofile->mapzones[zonename].Add(nanoseconds);
+}
+
+void ResetProfiling()
+{
+    boost::mutex::scoped_lock lock(s_profilingmutex);
+    FOREACH(itprofile, s_vthreadprofiles) {
+        boost::mutex::scoped_lock profilelock((*itprofile)->mutex);
+        (*itprofile)->mapzones.clear();
+    }
+}
+
+void WriteProfilingStatistics(std::ostream& sout)
+{
+    // the same zone name can have different addresses in different libraries
+    std::map<std::string, ProfileZoneStatistics> mapzones;
+    {
+        boost::mutex::scoped_lock lock(s_profilingmutex);
+        FOREACH(itprofile, s_vthreadprofiles) {
+            boost::mutex::scoped_lock profilelock((*itprofile)->mutex);
+            FOREACH(itzone, (*itprofile)->mapzones) {
+                mapzones[itzone->first].Merge(itzone->second);
+            }
+        }
+    }
+    std::stringstream ss;
+    ss << std::setprecision(9) << "{";
+    FOREACH(itzone, mapzones) {
+        if( itzone != mapzones.begin() ) {
+            ss << ", ";
+        }
+        const ProfileZoneStatistics& stats = itzone->second;
+        ss << "\"" << itzone->first << "\": {\"count\": " << stats.count << ", \"total\": " << 1e-9*stats.total << ", \"mean\": " << 1e-9*stats.total/stats.count << ", \"min\": " << 1e-9*stats.min << ", \"max\": " << 1e-9*stats.max << "}";
+    }
+    ss << "}";
+    sout << ss.str();
+}
+
 } // utils
 } // OpenRAVE
@@ -399,7 +399,9 @@ bool GeometryInfoReader::endElement(const std::string& xmlname)
                 }
             }
             else if( xmlname == "vertices" ) {
-                vector<dReal> values((istream_iterator<dReal>(_ss)), istream_iterator<dReal>());
+                vector<dReal> values;
+                std::string sbuffer;
+                utils::ParseRealValues(_ss, values, sbuffer);
                 if( (values.size()%9) ) {
                     RAVELOG_WARN(str(boost::format("number of points specified in the vertices field needs to be a multiple of 3 (it is %d), ignoring...\n")%values.size()));
                 }
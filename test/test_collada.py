@@ -556,3 +556,21 @@ class TestCOLLADA(EnvironmentSetup):
         env2.Load('test_externalgrab.dae')
         misc.CompareEnvironments(env, env2)
         
+
+    def test_binarymeshes(self):
+        self.log.info('write large meshes to a binary sidecar file and read them back')
+        env=self.env
+        robot = self.LoadRobot('robots/barrettwam.robot.xml')
+        for compression in ['raw', 'zlib']:
+            if os.path.exists('test_binarymeshes.dae.meshes'):
+                os.remove('test_binarymeshes.dae.meshes')
+            env.Save('test_binarymeshes.dae',Environment.SelectionOptions.Everything,{'binarymeshes':compression, 'binarymeshminvertices':'1'})
+            assert(os.path.exists('test_binarymeshes.dae.meshes'))
+            
+            env2 = Environment()
+            try:
+                env2.Load('test_binarymeshes.dae')
+                robot2 = env2.GetRobot(robot.GetName())
+                misc.CompareBodies(robot,robot2,comparegeometries=True,comparesensors=False,comparemanipulators=True,comparegrabbed=False,comparephysics=False,computeadjacent=False,epsilon=1e-7)
+            finally:
+                env2.Destroy()
@@ -12,6 +12,7 @@
 # See the License for the specific language governing permissions and
 # limitations under the License.
 from common_test_openrave import *
+import json
 
 class RunCollision(EnvironmentSetup):
     def __init__(self,collisioncheckername):
@@ -82,6 +83,51 @@ class RunCollision(EnvironmentSetup):
             assert(not target1.CheckSelfCollision())
             assert(self.env.CheckCollision(target1,report))
 
+    def test_selfcollisionspheres(self):
+        env=self.env
+        with env:
+            self.LoadEnv('robots/barrettwam.robot.xml')
+            robot=env.GetRobots()[0]
+            lower,upper = robot.GetDOFLimits()
+            for i in range(200):
+                robot.SetDOFValues(lower+random.rand(len(lower))*(upper-lower))
+                if not robot.CheckSelfCollisionSpheres(KinBody.AdjacentOptions.Enabled):
+                    # the spheres are conservative, so the checker cannot find any collision
+                    assert(not env.GetCollisionChecker().CheckSelfCollision(robot))
+                    assert(not robot.CheckSelfCollision())
+                if env.GetCollisionChecker().CheckSelfCollision(robot):
+                    assert(robot.CheckSelfCollision())
+            
+    def test_nonadjacentlinkpairs(self):
+        env=self.env
+        with env:
+            self.LoadEnv('robots/barrettwam.robot.xml')
+            robot=env.GetRobots()[0]
+            nonadjacent = robot.GetNonAdjacentLinks(KinBody.AdjacentOptions.Enabled)
+            stamp = robot.GetNonAdjacentLinksUpdateStamp()
+            assert(len(nonadjacent) > 0)
+            assert(all([index1 < index2 for index1,index2 in nonadjacent]))
+            assert(robot.GetNonAdjacentLinks(KinBody.AdjacentOptions.Enabled) == nonadjacent)
+            assert(robot.GetNonAdjacentLinksUpdateStamp() == stamp)
+            
+            link = robot.GetLinks()[nonadjacent[0][0]]
+            link.Enable(False)
+            nonadjacent2 = robot.GetNonAdjacentLinks(KinBody.AdjacentOptions.Enabled)
+            assert(robot.GetNonAdjacentLinksUpdateStamp() != stamp)
+            assert(nonadjacent2 == [pair for pair in nonadjacent if link.GetIndex() not in pair])
+            link.Enable(True)
+            assert(robot.GetNonAdjacentLinks(KinBody.AdjacentOptions.Enabled) == nonadjacent)
+            
+            lower,upper = robot.GetDOFLimits()
+            for i in range(10):
+                robot.SetDOFValues(randlimits(lower,upper))
+                bcollision = False
+                for index1,index2 in nonadjacent:
+                    if env.CheckCollision(robot.GetLinks()[index1],robot.GetLinks()[index2]):
+                        bcollision = True
+                        break
+                assert(robot.CheckSelfCollision() == bcollision)
+
     def test_attachedbodiescollision(self):
         with self.env:
             self.loadEnv('data/lab1.env.xml')
@@ -220,6 +266,38 @@ class RunCollision(EnvironmentSetup):
         assert(env.CheckCollision(env.GetKinBody('mug1')))
         assert(len(reports)==1)
 
+    def test_collisionthreads(self):
+        self.log.info('collision checks of several environments from python threads, callbacks reacquire the gil')
+        import threading
+        envs = [self.env, Environment()]
+        for env in envs:
+            env.SetCollisionChecker(RaveCreateCollisionChecker(env,self.collisioncheckername))
+        self.LoadEnv('data/lab1.env.xml')
+        envs[1].LoadURI('data/lab1.env.xml')
+        counts = [0]*len(envs)
+        errors = []
+        def collisioncallback(report,fromphysics):
+            return CollisionAction.DefaultAction
+        handles = [env.RegisterCollisionCallback(collisioncallback) for env in envs]
+        def checkcollisions(index):
+            try:
+                env = envs[index]
+                with env:
+                    mug = env.GetKinBody('mug1')
+                    for i in range(200):
+                        if env.CheckCollision(mug):
+                            counts[index] += 1
+            except Exception, e:
+                errors.append(e)
+        threads = [threading.Thread(target=checkcollisions,args=(i,)) for i in range(len(envs))]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        assert(len(errors)==0)
+        assert(counts == [200]*len(envs))
+        envs[1].Destroy()
+
     def test_activedofdistance(self):
         self.log.debug('test distance computation with active dofs')
         env=self.env
@@ -268,6 +346,357 @@ class RunCollision(EnvironmentSetup):
         manip.CheckEndEffectorCollision(report)
         assert(len(report.vLinkColliding)==4)
 
+    def test_raydistances(self):
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        rays = r_[c_[random.rand(20,2)*2-1,2*ones(20),zeros((20,2)),-4*ones(20)], [[10,10,10,0,0,-1]]]
+        distances = env.GetCollisionChecker().CheckCollisionRayDistances(rays)
+        assert(len(distances)==len(rays))
+        assert(distances[-1] < 0)
+        report = CollisionReport()
+        for ray,distance in izip(rays,distances):
+            if env.GetCollisionChecker().CheckCollision(Ray(ray[0:3],ray[3:6]),report):
+                assert(abs(report.minDistance-distance) <= g_epsilon)
+            else:
+                assert(distance < 0)
+
+    def test_computedistance(self):
+        env=self.env
+        with env:
+            box1=RaveCreateKinBody(env,'')
+            box1.InitFromBoxes(array([[0,0,0,0.1,0.1,0.1]]),True)
+            box1.SetName('box1')
+            env.Add(box1,True)
+            box2=RaveCreateKinBody(env,'')
+            box2.InitFromBoxes(array([[0,0,0,0.1,0.1,0.1]]),True)
+            box2.SetName('box2')
+            env.Add(box2,True)
+            checker = env.GetCollisionChecker()
+            for offset in [1.0, 0.9, 0.5, 0.45, 0.8]:
+                box2.SetTransform(matrixFromPose([1,0,0,0,offset,0,0]))
+                result = checker.ComputeDistance(box1,box2)
+                if result is None:
+                    # checker does not support distance queries
+                    return
+                distance, link1, link2 = result
+                assert(abs(distance-(offset-0.2)) <= 1e-4)
+                assert(link1.GetParent() == box1 and link2.GetParent() == box2)
+                distance, link1, link2 = checker.ComputeDistance(box1)
+                assert(abs(distance-(offset-0.2)) <= 1e-4)
+                assert(link2.GetParent() == box2)
+            box2.SetTransform(matrixFromPose([1,0,0,0,0.1,0,0]))
+            distance, link1, link2 = checker.ComputeDistance(box1,box2)
+            assert(distance == 0)
+
+    def test_continuouscollision(self):
+        env=self.env
+        xmldata = """<KinBody name="slider">
+  <Body name="base" type="static">
+  </Body>
+  <Body name="box">
+    <Geom type="box">
+      <extents>0.05 0.05 0.05</extents>
+    </Geom>
+  </Body>
+  <Joint name="j0" type="slider">
+    <body>base</body>
+    <body>box</body>
+    <axis>1 0 0</axis>
+    <limits>-2 2</limits>
+  </Joint>
+</KinBody>
+"""
+        with env:
+            slider=env.ReadKinBodyXMLData(xmldata)
+            env.Add(slider,True)
+            obstacle=RaveCreateKinBody(env,'')
+            obstacle.InitFromBoxes(array([[1,0,0,0.01,0.5,0.5]]),True)
+            obstacle.SetName('obstacle')
+            env.Add(obstacle,True)
+            checker = env.GetCollisionChecker()
+            if checker.ComputeDistance(slider) is None:
+                # checker does not support distance queries
+                return
+            # both endpoints are free, but the box passes through the obstacle
+            slider.SetDOFValues([1.5])
+            assert(not env.CheckCollision(slider))
+            slider.SetDOFValues([0])
+            assert(not env.CheckCollision(slider))
+            t = checker.CheckContinuousCollision(slider,[0],[0],[1.5],0.001)
+            assert(t is not None)
+            assert(abs(t*1.5-0.94) <= 0.01)
+            # the values are restored
+            assert(abs(slider.GetDOFValues()[0]) <= g_epsilon)
+            assert(checker.CheckContinuousCollision(slider,[0],[0],[0.8],0.001) is None)
+
+    def test_broadphaseauto(self):
+        env=self.env
+        with env:
+            checker = env.GetCollisionChecker()
+            try:
+                checker.SendCommand('SetBroadphaseAlgorithm Auto 2')
+            except openrave_exception:
+                # checker does not support selecting the broadphase
+                return
+            boxes = []
+            for i in range(10):
+                box=RaveCreateKinBody(env,'')
+                box.InitFromBoxes(array([[0.3*i,0,0,0.1,0.1,0.1]]),True)
+                box.SetName('box%d'%i)
+                env.Add(box,True)
+                boxes.append(box)
+            # the results do not depend on the broadphase being timed
+            for iquery in range(40):
+                boxes[0].SetTransform(matrixFromPose([1,0,0,0,0,0,0]))
+                assert(not env.CheckCollision(boxes[0]))
+                boxes[0].SetTransform(matrixFromPose([1,0,0,0,0.35,0,0]))
+                assert(env.CheckCollision(boxes[0]))
+                assert(env.CheckCollision(boxes[0].GetLinks()[0]))
+
+    def test_staticspace(self):
+        env=self.env
+        with env:
+            checker = env.GetCollisionChecker()
+            for spacetype in ['sap', 'hash', 'quadtree 0 0 0 5 5 5 4']:
+                try:
+                    if checker.SendCommand('SetStaticSpace %s'%spacetype) is None:
+                        return
+                except openrave_exception:
+                    # checker does not have a static space
+                    return
+                for body in env.GetBodies():
+                    env.Remove(body)
+                boxes = []
+                for i in range(10):
+                    box=RaveCreateKinBody(env,'')
+                    box.InitFromBoxes(array([[0.3*i,0,0,0.1,0.1,0.1]]),True)
+                    box.SetName('box%d'%i)
+                    env.Add(box,True)
+                    boxes.append(box)
+                # static against static
+                assert(not env.CheckCollision(boxes[1]))
+                boxes[1].SetTransform(matrixFromPose([1,0,0,0,0.5,0,0]))
+                # moved out of the static space
+                assert(env.CheckCollision(boxes[1]))
+                assert(env.CheckCollision(boxes[1].GetLinks()[0]))
+                assert(env.CheckCollision(boxes[2]))
+                boxes[1].SetTransform(matrixFromPose([1,0,0,0,0.3,0,0]))
+                assert(not env.CheckCollision(boxes[1]))
+                assert(env.CheckCollision(Ray([2.1,0,1],[0,0,-2])))
+            checker.SendCommand('SetStaticSpace none')
+
+    def test_querystatistics(self):
+        env=self.env
+        with env:
+            checker = env.GetCollisionChecker()
+            try:
+                checker.SendCommand('SetStatisticsEnabled 1')
+            except openrave_exception:
+                # checker does not record statistics
+                return
+            box=RaveCreateKinBody(env,'')
+            box.InitFromBoxes(array([[0,0,0,0.1,0.1,0.1]]),True)
+            box.SetName('box')
+            env.Add(box,True)
+            checker.SendCommand('ResetStatistics')
+            for i in range(10):
+                env.CheckCollision(box)
+            env.CheckCollision(box.GetLinks()[0])
+            stats = json.loads(checker.SendCommand('GetStatistics'))
+            assert(stats['BodyEnv']['count'] == 10)
+            assert(stats['LinkEnv']['count'] == 1)
+            assert(0 <= stats['BodyEnv']['p50'] <= stats['BodyEnv']['p99'] <= stats['BodyEnv']['max'])
+            checker.SendCommand('SetStatisticsEnabled 0')
+            env.CheckCollision(box)
+            assert(json.loads(checker.SendCommand('GetStatistics'))['BodyEnv']['count'] == 10)
+
+    def test_resultcache(self):
+        env=self.env
+        with env:
+            checker = env.GetCollisionChecker()
+            try:
+                checker.SendCommand('SetResultCacheEnabled 1')
+                checker.SendCommand('SetStatisticsEnabled 1')
+            except openrave_exception:
+                # checker does not cache results
+                return
+            boxes = []
+            for i in range(2):
+                box=RaveCreateKinBody(env,'')
+                box.InitFromBoxes(array([[0,0,0,0.1,0.1,0.1]]),True)
+                box.SetName('box%d'%i)
+                env.Add(box,True)
+                boxes.append(box)
+            boxes[1].SetTransform(matrixFromPose([1,0,0,0,0.15,0,0]))
+            checker.SendCommand('ResetStatistics')
+            for i in range(5):
+                assert(env.CheckCollision(boxes[0],boxes[1]))
+            stats = json.loads(checker.SendCommand('GetStatistics'))
+            assert(stats['BodyBody']['count'] == 1)
+            assert(stats['BodyBodyCached']['count'] == 4)
+            # moving or disabling a body invalidates the result
+            boxes[1].SetTransform(matrixFromPose([1,0,0,0,0.5,0,0]))
+            assert(not env.CheckCollision(boxes[0],boxes[1]))
+            boxes[1].SetTransform(matrixFromPose([1,0,0,0,0.15,0,0]))
+            assert(env.CheckCollision(boxes[0],boxes[1]))
+            boxes[1].GetLinks()[0].Enable(False)
+            assert(not env.CheckCollision(boxes[0],boxes[1]))
+            boxes[1].GetLinks()[0].Enable(True)
+            # a cached collision is checked again when a report is requested
+            report = CollisionReport()
+            assert(env.CheckCollision(boxes[0],boxes[1],report=report))
+            assert(report.plink1 is not None)
+            checker.SendCommand('SetResultCacheEnabled 0')
+            checker.SendCommand('SetStatisticsEnabled 0')
+
+    def test_envmanagercache(self):
+        env=self.env
+        with env:
+            checker = env.GetCollisionChecker()
+            try:
+                checker.SendCommand('SetEnvManagerCacheCapacity 2')
+            except openrave_exception:
+                # checker does not cache environment managers
+                return
+            boxes = []
+            for i in range(3):
+                box=RaveCreateKinBody(env,'')
+                box.InitFromBoxes(array([[0,0,0,0.1,0.1,0.1]]),True)
+                box.SetName('box%d'%i)
+                box.SetTransform(matrixFromPose([1,0,0,0,i,0,0]))
+                env.Add(box,True)
+                boxes.append(box)
+            checker.SendCommand('ResetStatistics')
+            # every body excludes itself, so each one needs its own manager
+            for box in boxes:
+                assert(not env.CheckCollision(box))
+            assert(not env.CheckCollision(boxes[2]))
+            stats = json.loads(checker.SendCommand('GetEnvManagerCacheStatistics'))
+            assert(stats['misses'] >= 3)
+            assert(stats['hits'] >= 1)
+            assert(stats['evictions'] >= 1)
+            assert(stats['size'] <= 2)
+            assert(stats['bytes'] > 0)
+            checker.SendCommand('SetEnvManagerCacheCapacity 64')
+
+    def test_octree(self):
+        env=self.env
+        with env:
+            info = KinBody.Link.GeometryInfo()
+            info._type = GeometryType.Octree
+            info._vGeomData = [0.05,0,0]
+            octree = RaveCreateKinBody(env,'')
+            octree.InitFromGeometries([info])
+            octree.SetName('octree')
+            env.Add(octree,True)
+            box=RaveCreateKinBody(env,'')
+            box.InitFromBoxes(array([[0,0,0,0.04,0.04,0.04]]),True)
+            box.SetName('box')
+            env.Add(box,True)
+            box.SetTransform(matrixFromPose([1,0,0,0,0.5,0,0]))
+            geom = octree.GetLinks()[0].GetGeometries()[0]
+            assert(not env.CheckCollision(box,octree))
+            # marking the voxels updates the geometry without recreating the body
+            points = array([[0.505+0.01*i,0.01,0.01] for i in range(10)])
+            assert(geom.UpdateOctreeVoxels(points,True) == 2)
+            assert(geom.UpdateOctreeVoxels(points,True) == 0)
+            assert(len(geom.GetOctreeVoxelCenters()) == 2)
+            assert(env.CheckCollision(box,octree))
+            assert(geom.UpdateOctreeVoxels(points,False) == 2)
+            assert(not env.CheckCollision(box,octree))
+            geom.UpdateOctreeVoxels([[0.51,0.01,0.01]],True)
+            assert(env.CheckCollision(box,octree))
+            geom.ClearOctreeVoxels()
+            assert(len(geom.GetOctreeVoxelCenters()) == 0)
+            assert(not env.CheckCollision(box,octree))
+
+    def test_modifygeometry(self):
+        env=self.env
+        with env:
+            box=RaveCreateKinBody(env,'')
+            box.InitFromBoxes(array([[0,0,0,0.1,0.1,0.1]]),True)
+            boxmesh = box.GetLinks()[0].GetGeometries()[0].GetCollisionMesh()
+            infos = []
+            for x in [0,1]:
+                info = KinBody.Link.GeometryInfo()
+                info._type = GeometryType.Trimesh
+                info._meshcollision = TriMesh(boxmesh.vertices+array([x,0,0]),boxmesh.indices)
+                infos.append(info)
+            body=RaveCreateKinBody(env,'')
+            body.InitFromGeometries(infos)
+            body.SetName('body')
+            env.Add(body,True)
+            probe=RaveCreateKinBody(env,'')
+            probe.InitFromBoxes(array([[0,0,0,0.05,0.05,0.05]]),True)
+            probe.SetName('probe')
+            env.Add(probe,True)
+            geoms = body.GetLinks()[0].GetGeometries()
+            probe.SetTransform(matrixFromPose([1,0,0,0,0,0.5,0]))
+            assert(not env.CheckCollision(body,probe))
+            # move the mesh of the first geometry under the probe, the second geometry has to stay valid
+            mesh = geoms[0].GetCollisionMesh()
+            mesh.vertices[:,1] += 0.5
+            geoms[0].SetCollisionMesh(mesh)
+            assert(env.CheckCollision(body,probe))
+            probe.SetTransform(matrixFromPose([1,0,0,0,0,0,0]))
+            assert(not env.CheckCollision(body,probe))
+            probe.SetTransform(matrixFromPose([1,0,0,0,1,0,0]))
+            assert(env.CheckCollision(body,probe))
+            body.SetTransform(matrixFromPose([1,0,0,0,0,1,0]))
+            assert(not env.CheckCollision(body,probe))
+            probe.SetTransform(matrixFromPose([1,0,0,0,0,1.5,0]))
+            assert(env.CheckCollision(body,probe))
+
+    def test_batcharrays(self):
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        with env:
+            robot=env.GetRobots()[0]
+            manip=robot.GetActiveManipulator()
+            armindices=manip.GetArmIndices()
+            lower,upper = robot.GetDOFLimits(armindices)
+            configs = array([lower+random.rand(len(lower))*(upper-lower) for i in range(20)])
+            initialvalues = robot.GetDOFValues()
+            collisions = env.GetCollisionChecker().CheckCollisionBatch(robot,configs,armindices)
+            selfcollisions = robot.CheckSelfCollisionBatch(configs,armindices)
+            transforms = robot.ComputeLinkTransformationsBatch(configs,armindices)
+            assert(len(collisions) == len(configs) and len(selfcollisions) == len(configs))
+            assert(transforms.shape == (len(configs),len(robot.GetLinks()),4,4))
+            assert(transdist(robot.GetDOFValues(),initialvalues) <= g_epsilon)
+            for i,config in enumerate(configs):
+                robot.SetDOFValues(config,armindices)
+                assert(collisions[i] == env.CheckCollision(robot))
+                assert(selfcollisions[i] == robot.CheckSelfCollision())
+                for link,T in izip(robot.GetLinks(),transforms[i]):
+                    assert(transdist(link.GetTransform(),T) <= g_epsilon)
+
+    def test_enablebodies(self):
+        env=self.env
+        with env:
+            boxes = []
+            for i in range(5):
+                box=RaveCreateKinBody(env,'')
+                box.InitFromBoxes(array([[0.15*i,0,0,0.1,0.1,0.1]]),True)
+                box.SetName('box%d'%i)
+                env.Add(box,True)
+                boxes.append(box)
+            assert(env.CheckCollision(boxes[0]))
+            # toggle several times without moving to exercise the cached collision objects
+            for iter in range(3):
+                env.EnableBodies(boxes[1:],False)
+                assert(not env.CheckCollision(boxes[0]))
+                assert(not env.CheckCollision(boxes[2]))
+                assert(all([not box.IsEnabled() for box in boxes[1:]]))
+                env.EnableBodies(boxes[1:],True)
+                assert(env.CheckCollision(boxes[0]))
+            env.SetBodiesLinkEnableStates([boxes[1],boxes[3]],[[0],[0]])
+            assert(not env.CheckCollision(boxes[0]))
+            assert(not env.CheckCollision(boxes[2]))
+            boxes[1].Enable(True)
+            boxes[1].SetTransform(matrixFromPose([1,0,0,0,0.5,0,0]))
+            assert(not env.CheckCollision(boxes[0]))
+            assert(env.CheckCollision(boxes[1]))
+
 #generate_classes(RunCollision, globals(), [('ode','ode'),('bullet','bullet')])
 
 class test_ode(RunCollision):
@@ -146,6 +146,169 @@ class TestConfigurationCache(EnvironmentSetup):
             self.log.info('writing cache to file...')
             cachechecker.SendCommand('SaveCache')
 
+    def test_cachestatisticsjson(self):
+        import json
+        env = self.env
+        with env:
+            self.LoadEnv('data/lab1.env.xml')
+            robot = env.GetRobots()[0]
+            robot.SetActiveDOFs(robot.GetActiveManipulator().GetArmIndices())
+            cachechecker = RaveCreateCollisionChecker(env,'CacheChecker')
+            assert(cachechecker.SendCommand('TrackRobotState %s'%robot.GetName()) is not None)
+            cachechecker.SendCommand('ResetSelfCache')
+            cachechecker.SendCommand('ResetCacheStatistics')
+            sampler = RaveCreateSpaceSampler(env, u'RobotConfiguration %s'%robot.GetName())
+            numchecks = 300
+            for iter in range(numchecks):
+                robot.SetActiveDOFValues(sampler.SampleSequence(SampleDataType.Real,1))
+                cachechecker.CheckSelfCollision(robot)
+
+            stats = json.loads(cachechecker.SendCommand('GetCacheStatisticsJSON'))
+            selfstats = stats['selfcache']
+            assert(selfstats['numqueries'] == numchecks)
+            latency = selfstats['latency']
+            resultnames = ['hitcollision', 'hitfree', 'missfree', 'misscollision']
+            assert(sum([latency[name]['count'] for name in resultnames]) == numchecks)
+            for name in resultnames:
+                assert(sum(latency[name]['histogram']) == latency[name]['count'])
+                assert(len(latency[name]['histogram']) == len(latency['bucketupperbounds_us']))
+            # every node is stored at exactly one level
+            assert(sum([level['numnodes'] for level in selfstats['levels']]) == selfstats['numnodes'])
+            assert(selfstats['numnodes'] > 0)
+            assert(len(selfstats['nodecounts']) > 0 and selfstats['nodecounts'][0]['numqueries'] == 0)
+            assert(stats['cache']['numqueries'] == 0)
+
+            cachechecker.SendCommand('ResetCacheStatistics')
+            stats = json.loads(cachechecker.SendCommand('GetCacheStatisticsJSON'))
+            assert(stats['selfcache']['numqueries'] == 0)
+            assert(stats['selfcache']['numnodes'] == selfstats['numnodes'])
+
+    def test_approximatelookup(self):
+        import json
+        env = self.env
+        with env:
+            self.LoadEnv('data/lab1.env.xml')
+            robot = env.GetRobots()[0]
+            robot.SetActiveDOFs(robot.GetActiveManipulator().GetArmIndices())
+            cachechecker = RaveCreateCollisionChecker(env,'CacheChecker')
+            assert(cachechecker.SendCommand('TrackRobotState %s'%robot.GetName()) is not None)
+            cachechecker.SendCommand('ResetSelfCache')
+            sampler = RaveCreateSpaceSampler(env, u'RobotConfiguration %s'%robot.GetName())
+            for iter in range(300):
+                robot.SetActiveDOFValues(sampler.SampleSequence(SampleDataType.Real,1))
+                cachechecker.CheckSelfCollision(robot)
+
+            # visiting a single node gives up on almost every lookup, the answers still have to come from the real checker
+            assert(cachechecker.SendCommand('SetCacheApproximation 0.5 1 self').split() == ['0.5', '1'])
+            cachechecker.SendCommand('ResetCacheStatistics')
+            numchecks = 100
+            for iter in range(numchecks):
+                robot.SetActiveDOFValues(sampler.SampleSequence(SampleDataType.Real,1))
+                assert(cachechecker.CheckSelfCollision(robot) == env.GetCollisionChecker().CheckSelfCollision(robot))
+            selfstats = json.loads(cachechecker.SendCommand('GetCacheStatisticsJSON'))['selfcache']
+            approximation = selfstats['approximation']
+            assert(approximation['maxvisitednodes'] == 1)
+            assert(approximation['abortedlookups'] > 0)
+            assert(approximation['visitednodes'] <= numchecks)
+            latency = selfstats['latency']
+            assert(latency['missfree']['count'] + latency['misscollision']['count'] >= approximation['abortedlookups'])
+
+            cachechecker.SendCommand('SetCacheApproximation 0 0 self')
+            cachechecker.SendCommand('ResetCacheStatistics')
+            robot.SetActiveDOFValues(sampler.SampleSequence(SampleDataType.Real,1))
+            cachechecker.CheckSelfCollision(robot)
+            approximation = json.loads(cachechecker.SendCommand('GetCacheStatisticsJSON'))['selfcache']['approximation']
+            assert(approximation['abortedlookups'] == 0 and approximation['visitednodes'] > 0)
+
+    def test_selfcachesaveload(self):
+        env = self.env
+        with env:
+            self.LoadEnv('data/lab1.env.xml')
+            robot = env.GetRobots()[0]
+            robot.SetActiveDOFs(robot.GetActiveManipulator().GetArmIndices())
+            cachechecker = RaveCreateCollisionChecker(env,'CacheChecker')
+            assert(cachechecker.SendCommand('TrackRobotState %s'%robot.GetName()) is not None)
+            cachechecker.SendCommand('ResetSelfCache')
+            sampler = RaveCreateSpaceSampler(env, u'RobotConfiguration %s'%robot.GetName())
+            for iter in range(200):
+                robot.SetActiveDOFValues(sampler.SampleSequence(SampleDataType.Real,1))
+                cachechecker.CheckSelfCollision(robot)
+            selfcachesize = int(cachechecker.SendCommand('GetSelfCacheStatistics').split()[3])
+            assert(selfcachesize > 0)
+            cachechecker.SendCommand('SaveCache')
+
+            # a new checker tracking the same robot loads the saved cache
+            cachechecker2 = RaveCreateCollisionChecker(env,'CacheChecker')
+            assert(cachechecker2.SendCommand('TrackRobotState %s'%robot.GetName()) is not None)
+            assert(int(cachechecker2.SendCommand('GetSelfCacheStatistics').split()[3]) == selfcachesize)
+            assert(int(cachechecker2.SendCommand('ValidateSelfCache')) == 1)
+
+    def test_warmselfcache(self):
+        import tempfile
+        env = self.env
+        with env:
+            self.LoadEnv('data/lab1.env.xml')
+            robot = env.GetRobots()[0]
+            robot.SetActiveDOFs(robot.GetActiveManipulator().GetArmIndices())
+            cachechecker = RaveCreateCollisionChecker(env,'CacheChecker')
+            assert(cachechecker.SendCommand('TrackRobotState %s'%robot.GetName()) is not None)
+            cachechecker.SendCommand('ResetSelfCache')
+            sampler = RaveCreateSpaceSampler(env, u'RobotConfiguration %s'%robot.GetName())
+            configs = []
+            for iter in range(100):
+                robot.SetActiveDOFValues(sampler.SampleSequence(SampleDataType.Real,1))
+                configs.append(robot.GetDOFValues())
+            traj = RaveCreateTrajectory(env,'')
+            traj.Init(robot.GetActiveConfigurationSpecification())
+            for iter in range(50):
+                traj.Insert(traj.GetNumWaypoints(), sampler.SampleSequence(SampleDataType.Real,1))
+            trajfile = tempfile.NamedTemporaryFile(suffix='.xml', delete=False)
+            try:
+                trajfile.write(traj.serialize(0))
+                trajfile.close()
+                command = 'WarmSelfCache numthreads 4 trajectory %s configurations %d %s'%(trajfile.name, len(configs), ' '.join([' '.join(['%.15e'%v for v in config]) for config in configs]))
+                numconfigs, numlabeled, numinserted, numcollision = [int(s) for s in cachechecker.SendCommand(command).split()]
+            finally:
+                os.remove(trajfile.name)
+            assert(numconfigs == 150)
+            assert(numinserted > 0 and numinserted <= numlabeled and numlabeled <= numconfigs)
+            selfcachesize = int(cachechecker.SendCommand('GetSelfCacheStatistics').split()[3])
+            assert(selfcachesize == numinserted)
+            assert(int(cachechecker.SendCommand('ValidateSelfCache')) == 1)
+
+            # the warmed cache was saved, a new checker starts with it
+            cachechecker2 = RaveCreateCollisionChecker(env,'CacheChecker')
+            assert(cachechecker2.SendCommand('TrackRobotState %s'%robot.GetName()) is not None)
+            assert(int(cachechecker2.SendCommand('GetSelfCacheStatistics').split()[3]) == selfcachesize)
+
+    def test_sharedselfcache(self):
+        env = self.env
+        with env:
+            self.LoadEnv('data/lab1.env.xml')
+            robot = env.GetRobots()[0]
+            cachechecker = RaveCreateCollisionChecker(env,'CacheChecker')
+            assert(cachechecker.SendCommand('TrackRobotState %s'%robot.GetName()) is not None)
+            cachechecker.SendCommand('ResetSelfCache')
+            env.SetCollisionChecker(cachechecker)
+            clonedenv = env.CloneSelf(CloningOptions.Bodies)
+            try:
+                clonedrobot = clonedenv.GetRobot(robot.GetName())
+                clonedchecker = clonedenv.GetCollisionChecker()
+                assert(clonedchecker.SendCommand('GetTrackedRobot').strip() == robot.GetName())
+                # self collision checks in the cloned environment fill the cache of the original one
+                sampler = RaveCreateSpaceSampler(env, u'RobotConfiguration %s'%robot.GetName())
+                with clonedenv:
+                    for iter in range(100):
+                        clonedrobot.SetActiveDOFValues(sampler.SampleSequence(SampleDataType.Real,1))
+                        clonedchecker.CheckSelfCollision(clonedrobot)
+                selfcachesize = int(cachechecker.SendCommand('GetSelfCacheStatistics').split()[3])
+                assert(selfcachesize > 0)
+                assert(int(clonedchecker.SendCommand('GetSelfCacheStatistics').split()[3]) == selfcachesize)
+            finally:
+                clonedenv.Destroy()
+            # destroying the cloned environment keeps the shared nodes
+            assert(int(cachechecker.SendCommand('GetSelfCacheStatistics').split()[3]) == selfcachesize)
+
     def test_find_insert(self):
 
         self.LoadEnv('data/lab1.env.xml')
@@ -226,6 +389,41 @@ class TestConfigurationCache(EnvironmentSetup):
             assert(int(cachechecker.SendCommand('ValidateSelfCache')) == 1)
             self.log.info('valid tests passed')
 
+    def test_partialupdates(self):
+        env = self.env
+        with env:
+            self.LoadEnv('data/lab1.env.xml')
+            robot = env.GetRobots()[0]
+            robot.SetActiveDOFs(range(7))
+            cachechecker = RaveCreateCollisionChecker(env,'CacheChecker')
+            assert(cachechecker.SendCommand('TrackRobotState %s'%robot.GetName()) is not None)
+            env.SetCollisionChecker(cachechecker)
+
+            sampler = RaveCreateSpaceSampler(env, u'MT19937')
+            sampler.SetSpaceDOF(robot.GetActiveDOF())
+            originalvalues = robot.GetActiveDOFValues()
+            for iter in range(200):
+                robot.SetActiveDOFValues(originalvalues + 0.2*(sampler.SampleSequence(SampleDataType.Real,1)-0.5))
+                env.CheckCollision(robot)
+            cachesize = int(cachechecker.SendCommand('GetCacheStatistics').split()[3])
+            assert(cachesize > 0)
+
+            # a box far away from the robot keeps the cache
+            box = RaveCreateKinBody(env,'')
+            box.SetName('smallbox')
+            box.InitFromBoxes(array([[0,0,0,0.02,0.02,0.02]]),True)
+            box.SetTransform(matrixFromPose([1,0,0,0,10,10,10]))
+            env.Add(box)
+            box.SetTransform(matrixFromPose([1,0,0,0,10,10.1,10]))
+            farcachesize = int(cachechecker.SendCommand('GetCacheStatistics').split()[3])
+            assert(farcachesize == cachesize)
+
+            # moving it into the arm removes the free configurations around it
+            box.SetTransform(matrixFromPose([1,0,0,0]+list(robot.GetActiveManipulator().GetTransform()[0:3,3])))
+            nearcachesize = int(cachechecker.SendCommand('GetCacheStatistics').split()[3])
+            assert(nearcachesize < farcachesize)
+            assert(int(cachechecker.SendCommand('ValidateCache')) == 1)
+
     def test_planning(self):
             env = self.env
             with env:
@@ -66,6 +66,92 @@ class test_ideal(RunController):
     def __init__(self):
         RunController.__init__(self, 'IdealController')
 
+    def test_replacepath(self):
+        self.log.debug('replaces a trajectory before it is picked up by the simulation')
+        env=self.env
+        robot=self.LoadRobot('robots/schunk-lwa3.zae')
+        with env:
+            initvalues = robot.GetActiveDOFValues()
+            trajs = []
+            for value in [0.3,0.5]:
+                waypoint=zeros(robot.GetActiveDOF())
+                waypoint[0] = value
+                traj=RaveCreateTrajectory(env, '')
+                traj.Init(robot.GetActiveConfigurationSpecification('quadratic'))
+                traj.Insert(0,r_[initvalues,waypoint])
+                ret=planningutils.RetimeActiveDOFTrajectory(traj,robot,False)
+                assert(ret==PlannerStatus.HasSolution)
+                trajs.append((traj,waypoint))
+            robot.GetController().SendCommand('GetStepStatistics reset')
+            robot.GetController().SetPath(trajs[0][0])
+            robot.GetController().SetPath(trajs[1][0])
+            assert(not robot.GetController().IsDone())
+            while not robot.GetController().IsDone():
+                env.StepSimulation(0.01)
+            assert(transdist(robot.GetActiveDOFValues(),trajs[1][1]) <= g_epsilon)
+            numsteps,meanstepus,maxstepus,numcommands,numstreamunderruns = [int(s) for s in robot.GetController().SendCommand('GetStepStatistics').split()]
+            assert(numsteps > 0 and maxstepus >= meanstepus and numcommands == 2 and numstreamunderruns == 0)
+
+    def test_streaming(self):
+        self.log.debug('appends waypoints to a trajectory while it is executed')
+        env=self.env
+        robot=self.LoadRobot('robots/schunk-lwa3.zae')
+        with env:
+            initvalues = robot.GetActiveDOFValues()
+            waypoints = [initvalues]
+            chunks = []
+            for value in [0.3,0.5]:
+                waypoint=zeros(robot.GetActiveDOF())
+                waypoint[0] = value
+                chunk=RaveCreateTrajectory(env, '')
+                chunk.Init(robot.GetActiveConfigurationSpecification('quadratic'))
+                chunk.Insert(0,r_[waypoints[-1],waypoint])
+                ret=planningutils.RetimeActiveDOFTrajectory(chunk,robot,False)
+                assert(ret==PlannerStatus.HasSolution)
+                chunks.append(chunk)
+                waypoints.append(waypoint)
+            traj = chunks[0]
+            robot.GetController().SendCommand('SetStreaming 1')
+            robot.GetController().SetPath(traj)
+            # play the first half of the first chunk and append the second one
+            while robot.GetController().GetTime() < 0.5*traj.GetDuration():
+                env.StepSimulation(0.01)
+            traj.Insert(traj.GetNumWaypoints(),chunks[1].GetWaypoints(1,chunks[1].GetNumWaypoints()),chunks[1].GetConfigurationSpecification())
+            # the controller has to wait at the end until the stream ends
+            for i in range(int(traj.GetDuration()/0.01)+10):
+                env.StepSimulation(0.01)
+            assert(not robot.GetController().IsDone())
+            assert(transdist(robot.GetActiveDOFValues(),waypoints[2]) <= g_epsilon)
+            assert(robot.GetController().SendCommand('EndStream') is not None)
+            while not robot.GetController().IsDone():
+                env.StepSimulation(0.01)
+            assert(transdist(robot.GetActiveDOFValues(),waypoints[2]) <= g_epsilon)
+            numstreamunderruns = int(robot.GetController().SendCommand('GetStepStatistics').split()[4])
+            assert(numstreamunderruns > 0)
+            robot.GetController().SendCommand('SetStreaming 0')
+
+    def test_multicontrollerstatistics(self):
+        self.log.debug('times the controllers attached to a multi-controller')
+        env=self.env
+        robot=self.LoadRobot('robots/schunk-lwa3.zae')
+        with env:
+            multicontroller = RaveCreateMultiController(env,'')
+            robot.SetController(multicontroller,range(robot.GetDOF()),0)
+            dofindices = range(robot.GetDOF())
+            for indices in [dofindices[:3], dofindices[3:]]:
+                assert(multicontroller.AttachController(RaveCreateController(env,'IdealController'),indices,0))
+            assert(multicontroller.SendCommand('SetNumThreads 0') is None)
+            for i in range(5):
+                env.StepSimulation(0.01)
+            lines = multicontroller.SendCommand('GetStepStatistics').splitlines()
+            assert(len(lines) == 2)
+            for line in lines:
+                values = line.split()
+                assert(int(values[1]) == 5)
+                assert(0 <= float(values[2]) <= float(values[4]) and 0 <= float(values[3]) <= float(values[4]))
+            assert(multicontroller.SendCommand('ResetStepStatistics') is not None)
+            assert(all([int(line.split()[1]) == 0 for line in multicontroller.SendCommand('GetStepStatistics').splitlines()]))
+
 # class test_bullet(RunController):
 #     def __init__(self):
 #         RunController.__init__(self, 'bullet')
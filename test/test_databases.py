@@ -37,6 +37,51 @@ class TestDatabases(EnvironmentSetup):
             out=ikmodule.SendCommand('LoadIKFastSolver %s %d 1'%(robot.GetName(),iktype))
             assert(out is not None)
             assert(manip.GetIkSolver() is not None)
-            
+
+    def test_ikmodulepreload(self):
+        env=self.env
+        self.LoadEnv('robots/neuronics-katana.zae')
+        robot=env.GetRobots()[0]
+        robot.SetActiveManipulator('arm')
+        ikmodel = databases.inversekinematics.InverseKinematicsModel(robot,iktype=IkParameterizationType.TranslationDirection5D)
+        if not ikmodel.load():
+            ikmodel.autogenerate()
+        filename = ikmodel.getfilename(True)
+        assert(len(filename) > 0)
+        
+        ikmodule = RaveCreateModule(env,'ikfast')
+        env.Add(ikmodule)
+        assert(ikmodule.SendCommand('PreloadIkLibraries %s'%filename) is not None)
+        # loading the same library while it is preloaded should return the same solver
+        out = ikmodule.SendCommand('AddIkLibrary %s %s'%(ikmodel.getikname().split()[1],filename))
+        assert(int(out) == int(IkParameterizationType.TranslationDirection5D))
+
+    def test_memorymapdataset(self):
+        try:
+            import h5py
+        except ImportError:
+            return
+        
+        values = numpy.reshape(numpy.arange(24,dtype=numpy.float64),(6,4))
+        filename = 'test_memorymapdataset.h5'
+        f = h5py.File(filename,'w')
+        try:
+            f['values'] = values
+            f.create_dataset('chunked',data=values,chunks=(2,4))
+        finally:
+            f.close()
+        f = h5py.File(filename,'r')
+        try:
+            mapped = databases.DatabaseGenerator._MemoryMapDataset(f['values'])
+            assert(isinstance(mapped,numpy.memmap))
+            assert(numpy.all(mapped == values))
+            assert(numpy.all(mapped[2:4] == values[2:4]))
+            # chunked datasets cannot be mapped, so they are read
+            chunked = databases.DatabaseGenerator._MemoryMapDataset(f['chunked'])
+            assert(not isinstance(chunked,numpy.memmap))
+            assert(numpy.all(chunked == values))
+        finally:
+            f.close()
+        
 #     def test_database_paths(self):
 #         pass
@@ -15,6 +15,7 @@ from common_test_openrave import *
 from subprocess import Popen, PIPE
 import shutil
 import threading
+import json
 
 class TestEnvironment(EnvironmentSetup):
     def test_load(self):
@@ -33,7 +34,31 @@ class TestEnvironment(EnvironmentSetup):
         robot=env.GetRobots()[0]
         trimesh=env.Triangulate(robot)
         assert(len(trimesh.vertices)==0)
-        
+
+    def test_triangulatescenecache(self):
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        with env:
+            def triangulatebodies():
+                vertices = []
+                for body in env.GetBodies():
+                    vertices.append(env.Triangulate(body).vertices)
+                return concatenate(vertices)
+            trimesh = env.TriangulateScene(Environment.SelectionOptions.Everything,'')
+            assert(transdist(trimesh.vertices, triangulatebodies()) <= g_epsilon)
+            # the moved body has to be triangulated again, the others come from the cache
+            body = env.GetKinBody('mug1')
+            T = body.GetTransform()
+            T[0:3,3] += [0.1,0.2,0.3]
+            body.SetTransform(T)
+            robot = env.GetRobots()[0]
+            robot.SetDOFValues(robot.GetDOFValues()+0.1)
+            trimesh = env.TriangulateScene(Environment.SelectionOptions.Everything,'')
+            assert(transdist(trimesh.vertices, triangulatebodies()) <= g_epsilon)
+            env.Remove(body)
+            trimesh = env.TriangulateScene(Environment.SelectionOptions.Everything,'')
+            assert(transdist(trimesh.vertices, triangulatebodies()) <= g_epsilon)
+
     def test_misc(self):
         env=self.env
         assert(env.plot3([0,0,0],10)==None) # no viewer attached
@@ -48,6 +73,40 @@ class TestEnvironment(EnvironmentSetup):
         testdict = {robot.GetManipulators()[0]:1}
         assert(testdict[robot.GetManipulators()[0]] == 1)
         
+    def test_bodynames(self):
+        env=self.env
+        with env:
+            self.LoadEnv('data/lab1.env.xml')
+            robot=env.GetRobots()[0]
+            for body in env.GetBodies():
+                assert(env.GetKinBody(body.GetName()) == body)
+                assert(env.GetBodyFromEnvironmentId(body.GetEnvironmentId()) == body)
+            assert(env.GetRobot(robot.GetName()) == robot)
+            assert(env.GetRobot(env.GetKinBody('mug1').GetName()) is None)
+            
+            oldname = robot.GetName()
+            robot.SetName('renamedrobot')
+            assert(env.GetKinBody(oldname) is None)
+            assert(env.GetRobot('renamedrobot') == robot)
+            
+            mug = env.GetKinBody('mug1')
+            envid = mug.GetEnvironmentId()
+            env.Remove(mug)
+            assert(env.GetKinBody('mug1') is None)
+            assert(env.GetBodyFromEnvironmentId(envid) is None)
+            env.Add(mug)
+            assert(env.GetKinBody('mug1') == mug)
+            assert(env.GetBodyFromEnvironmentId(mug.GetEnvironmentId()) == mug)
+            
+            env2 = env.CloneSelf(CloningOptions.Bodies)
+            try:
+                for body in env.GetBodies():
+                    body2 = env2.GetKinBody(body.GetName())
+                    assert(body2 is not None and body2.GetEnvironmentId() == body.GetEnvironmentId())
+                    assert(env2.GetBodyFromEnvironmentId(body.GetEnvironmentId()) == body2)
+            finally:
+                env2.Destroy()
+                
     def test_uri(self):
         env=self.env
         xml="""<environment>
@@ -84,7 +143,61 @@ class TestEnvironment(EnvironmentSetup):
                 for link in body3.GetLinks():
                     for geom in link.GetGeometries():
                         assert( transdist(geom.GetRenderScale(),scalefactor) <= g_epsilon )
-            
+
+    def test_meshcache(self):
+        self.log.info('test that meshes reloaded from the mesh cache match the converted meshes')
+        env=self.env
+        with env:
+            body1=env.ReadKinBodyURI('data/mug1.kinbody.xml',{'scalegeometry':'1.5 1.5 1.5'})
+            cachedir = RaveFindDatabaseFile('meshcache',False)
+            assert( os.path.isdir(cachedir) and len(os.listdir(cachedir)) > 0 )
+            body2=env.ReadKinBodyURI('data/mug1.kinbody.xml',{'scalegeometry':'1.5 1.5 1.5'})
+            geoms1 = [geom for link in body1.GetLinks() for geom in link.GetGeometries()]
+            geoms2 = [geom for link in body2.GetLinks() for geom in link.GetGeometries()]
+            assert( len(geoms1) == len(geoms2) )
+            for geom1,geom2 in izip(geoms1,geoms2):
+                mesh1 = geom1.GetCollisionMesh()
+                mesh2 = geom2.GetCollisionMesh()
+                assert( mesh1.vertices.shape == mesh2.vertices.shape and mesh1.indices.shape == mesh2.indices.shape )
+                assert( sum(abs(mesh1.vertices-mesh2.vertices)) <= g_epsilon and all(mesh1.indices == mesh2.indices) )
+                assert( transdist(geom1.GetDiffuseColor(),geom2.GetDiffuseColor()) <= g_epsilon )
+
+    def test_bodiesaabb(self):
+        self.log.info('test that the cached bounding boxes follow the bodies')
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        with env:
+            robot=env.GetRobots()[0]
+            lower,upper = robot.GetDOFLimits()
+            for iter in range(3):
+                bodies,aabbs = env.ComputeBodiesAABB()
+                assert( len(bodies) == len(env.GetBodies()) )
+                for body,ab in izip(bodies,aabbs):
+                    ab2 = body.ComputeAABB()
+                    assert( transdist(ab.pos(),ab2.pos()) <= g_epsilon and transdist(ab.extents(),ab2.extents()) <= g_epsilon )
+                    vertices = env.Triangulate(body).vertices
+                    if len(vertices) > 0:
+                        assert( all(vertices >= ab.pos()-ab.extents()-g_epsilon) and all(vertices <= ab.pos()+ab.extents()+g_epsilon) )
+                robot.SetDOFValues(lower+random.rand(len(lower))*(upper-lower))
+
+    def test_loadmeshesordering(self):
+        self.log.info('test that the meshes loaded in parallel with the environment match the meshes of a single robot')
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        robot1 = env.GetRobot('BarrettWAM')
+        robot2 = env.ReadRobotURI('robots/barrettsegway.robot.xml')
+        assert( len(robot1.GetLinks()) == len(robot2.GetLinks()) )
+        for link1,link2 in izip(robot1.GetLinks(),robot2.GetLinks()):
+            assert( link1.GetName() == link2.GetName() )
+            assert( len(link1.GetGeometries()) == len(link2.GetGeometries()) )
+            for geom1,geom2 in izip(link1.GetGeometries(),link2.GetGeometries()):
+                assert( geom1.GetType() == geom2.GetType() )
+                assert( geom1.GetCollisionMesh().vertices.shape == geom2.GetCollisionMesh().vertices.shape )
+            mesh1 = link1.GetCollisionData()
+            mesh2 = link2.GetCollisionData()
+            assert( mesh1.vertices.shape == mesh2.vertices.shape and all(mesh1.indices == mesh2.indices) )
+            assert( sum(abs(mesh1.vertices-mesh2.vertices)) <= g_epsilon*len(mesh1.vertices) )
+
     def test_unicode(self):
         env=self.env
         name = 'テスト名前'.decode('utf-8')
@@ -190,7 +303,30 @@ class TestEnvironment(EnvironmentSetup):
             self.log.info('new clone time: %fs',endtime)
             assert(endtime <= 0.05)
             misc.CompareEnvironments(env,clonedenv,epsilon=g_epsilon)
-            
+
+    def test_clone_skipunchanged(self):
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        with env:
+            robot=env.GetRobots()[0]
+            clonedenv = env.CloneSelf(CloningOptions.Bodies)
+            options = CloningOptions.Bodies|CloningOptions.SkipUnchangedBodies
+            clonedenv.Clone(env, options)
+            misc.CompareEnvironments(env,clonedenv,epsilon=g_epsilon)
+
+            # change the source robot
+            robot.SetDOFValues(robot.GetDOFValues()+0.1*ones(robot.GetDOF()), checklimits=KinBody.CheckLimitsAction.CheckLimitsSilent)
+            clonedenv.Clone(env, options)
+            misc.CompareEnvironments(env,clonedenv,epsilon=g_epsilon)
+
+            # change the cloned robot, the next clone has to restore it
+            clonedrobot = clonedenv.GetRobot(robot.GetName())
+            clonedrobot.SetDOFValues(zeros(robot.GetDOF()), checklimits=KinBody.CheckLimitsAction.CheckLimitsSilent)
+            clonedenv.Clone(env, options)
+            assert(transdist(clonedrobot.GetDOFValues(),robot.GetDOFValues()) <= g_epsilon)
+            misc.CompareEnvironments(env,clonedenv,epsilon=g_epsilon)
+            clonedenv.Destroy()
+
     def test_multithread(self):
         self.log.info('test multiple threads accessing same resource')
         def mythread(env,threadid):
@@ -209,6 +345,98 @@ class TestEnvironment(EnvironmentSetup):
         for t in threads:
             t.join()
 
+    def test_lockstatistics(self):
+        self.log.info('test concurrent body queries and the lock contention counters')
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        numbodies = len(env.GetBodies())
+        env.GetLockStatistics(True)
+        def querythread(env,results):
+            for counter in range(200):
+                results.append(len(env.GetBodies()) == numbodies and env.GetKinBody(env.GetBodies()[0].GetName()) is not None)
+
+        results = []
+        threads = []
+        for ithread in range(4):
+            t = threading.Thread(target=querythread,args=(env,results))
+            t.start()
+            threads.append(t)
+        for t in threads:
+            t.join()
+        assert(all(results) and len(results) == 800)
+        stats = env.GetLockStatistics(True)
+        for key in ['numEnvironmentContended','numInterfacesSharedContended','numInterfacesExclusiveContended']:
+            assert(stats[key] >= 0)
+        stats = env.GetLockStatistics()
+        assert(stats['numInterfacesSharedContended'] == 0 and stats['interfacesSharedWaitTime'] == 0)
+
+    def test_profiling(self):
+        self.log.info('test the profiling zones of the hot paths')
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        robot=env.GetRobots()[0]
+        assert(env.SendCommand('ResetProfiling') is not None)
+        assert(env.SendCommand('SetProfilingEnabled 1') is not None)
+        try:
+            with env:
+                for i in range(5):
+                    robot.SetDOFValues(robot.GetDOFValues())
+                    env.CheckCollision(robot)
+        finally:
+            env.SendCommand('SetProfilingEnabled 0')
+        stats = json.loads(env.SendCommand('GetProfilingStatistics'))
+        assert(stats['KinBody::SetDOFValues']['count'] >= 5)
+        assert(stats['EnvironmentBase::CheckCollision']['count'] >= 5)
+        zone = stats['EnvironmentBase::CheckCollision']
+        assert(0 <= zone['min'] <= zone['mean'] <= zone['max'])
+        # disabled zones are not recorded
+        with env:
+            env.CheckCollision(robot)
+        assert(json.loads(env.SendCommand('GetProfilingStatistics'))['EnvironmentBase::CheckCollision']['count'] == zone['count'])
+        assert(env.SendCommand('UnknownCommand') is None)
+
+    def test_threadpool(self):
+        self.log.info('test sizing the shared thread pool and its statistics')
+        env=self.env
+        try:
+            assert(env.SendCommand('SetThreadPoolSize 3') is not None)
+            assert(int(env.SendCommand('GetThreadPoolSize')) == 3)
+            assert(env.SendCommand('ResetThreadPoolStatistics') is not None)
+            assert(json.loads(env.SendCommand('GetThreadPoolStatistics')) == {})
+            self.LoadEnv('data/lab1.env.xml')
+            with env:
+                env.TriangulateScene(Environment.SelectionOptions.Everything,'')
+            for tasktype, stats in json.loads(env.SendCommand('GetThreadPoolStatistics')).iteritems():
+                assert(stats['count'] >= 0 and stats['cancelled'] >= 0)
+                assert(0 <= stats['max'] <= stats['total'])
+            assert(env.SendCommand('SetThreadPoolSize') is None)
+        finally:
+            env.SendCommand('SetThreadPoolSize 0')
+
+    def test_simulationsubsystems(self):
+        self.log.info('test stepping the subsystems at different periods and the simulation counters')
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        assert(env.GetSimulationSubsystemPeriod(Environment.SimulationSubsystem.Sensors) == 0)
+        env.SetSimulationSubsystemPeriod(Environment.SimulationSubsystem.Sensors, 0.01)
+        assert(abs(env.GetSimulationSubsystemPeriod(Environment.SimulationSubsystem.Sensors)-0.01) <= g_epsilon)
+        env.GetSimulationStatistics(True)
+        for i in range(100):
+            env.StepSimulation(0.001)
+        stats = env.GetSimulationStatistics(True)
+        assert(stats['numSteps'] == 100 and stats['numLateSteps'] == 0)
+        assert(stats['simulationTime'] >= 100000)
+        assert(stats['subsystems'][int(Environment.SimulationSubsystem.Physics)]['numSteps'] == 100)
+        assert(stats['subsystems'][int(Environment.SimulationSubsystem.Controllers)]['numSteps'] == 100)
+        numsensorsteps = stats['subsystems'][int(Environment.SimulationSubsystem.Sensors)]['numSteps']
+        assert(numsensorsteps >= 9 and numsensorsteps <= 10)
+        # manual stepping never skips ticks
+        for substats in stats['subsystems']:
+            assert(substats['numSkippedTicks'] == 0)
+            assert(substats['maxStepTime'] <= substats['totalStepTime'])
+        stats = env.GetSimulationStatistics()
+        assert(stats['numSteps'] == 0 and stats['simulationTime'] == 0)
+
     def test_dataccess(self):
         RaveDestroy()
         OPENRAVE_DATA = os.environ.get('OPENRAVE_DATA','')
@@ -262,3 +490,48 @@ class TestEnvironment(EnvironmentSetup):
         # thread is done, so should be able to lock
         assert(env.Lock(1.0))
         env.Unlock()
+
+    def test_publishedbodies(self):
+        env=self.env
+        robot = self.LoadRobot('robots/barrettwam.robot.xml')
+        env.UpdatePublishedBodies()
+        stamp = env.GetPublishedBodiesStamp()
+        states = env.GetPublishedBodies()
+        assert(len(states) == 1 and states[0]['name'] == robot.GetName())
+        # readers do not wait on the environment lock
+        with env:
+            values = robot.GetDOFValues()
+            values[0] += 0.1
+            robot.SetDOFValues(values)
+            states2 = env.GetPublishedBodies(1000)
+            assert(env.GetPublishedBodiesStamp() == stamp)
+            assert(transdist(states2[0]['jointvalues'], states[0]['jointvalues']) <= g_epsilon)
+            env.UpdatePublishedBodies()
+        assert(env.GetPublishedBodiesStamp() != stamp)
+        states3 = env.GetPublishedBodies()
+        assert(transdist(states3[0]['jointvalues'], robot.GetDOFValues()) <= g_epsilon)
+        # the earlier snapshot is not modified by later updates
+        assert(transdist(states[0]['jointvalues'], states3[0]['jointvalues']) > g_epsilon)
+        env.Reset()
+        assert(len(env.GetPublishedBodies()) == 0)
+
+    def test_publishedbodiesdelta(self):
+        self.log.info('test streaming only the published bodies that changed')
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        robot=env.GetRobots()[0]
+        env.UpdatePublishedBodies()
+        stamp, fulldelta = env.WritePublishedBodiesDelta(0)
+        assert(stamp == env.GetPublishedBodiesStamp())
+        assert(fulldelta[:4] == '\x89ORD')
+        # nothing changed, so only the ids of the bodies are sent
+        stamp2, emptydelta = env.WritePublishedBodiesDelta(stamp)
+        assert(stamp2 == stamp and len(emptydelta) < len(fulldelta))
+        with env:
+            values = robot.GetDOFValues()
+            values[0] += 0.1
+            robot.SetDOFValues(values)
+            env.UpdatePublishedBodies()
+        stamp3, robotdelta = env.WritePublishedBodiesDelta(stamp)
+        assert(stamp3 > stamp)
+        assert(len(emptydelta) < len(robotdelta) < len(fulldelta))
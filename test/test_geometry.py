@@ -70,6 +70,22 @@ def test_transformations():
         T = matrixFromPose([ 0.00422863, 0.00522595, 0.707, 0.707182, 0.204229, 0.628939, 1.40061])
         assert(abs(linalg.det(T[0:3,0:3])-1) <= g_epsilon )
 
+def test_nativetransformations():
+    log.info('compares the native transform math against the numpy reference')
+    for i in range(20):
+        X = random.rand(100,3)-0.5
+        posearray = randpose(5)
+        # tolerance is relative to the native precision, so that the scalar and SIMD kernels are held to the same bound
+        eps = 64*finfo(poseTransformPoints(posearray[0],X[0:1]).dtype).eps
+        for j in range(len(posearray)):
+            pose0 = posearray[j]
+            pose1 = posearray[(j+1)%len(posearray)]
+            assert( all(abs(quatMult(pose0[0:4],pose1[0:4]) - quatMultArrayT(pose0[0:4],array([pose1[0:4]]))[0]) <= eps) )
+            assert( all(abs(poseMult(pose0,pose1) - poseMultArrayT(pose0,array([pose1]))[0]) <= eps) )
+            Xnew = quatRotateArrayT(pose0[0:4],X)+tile(pose0[4:7],(len(X),1))
+            assert( all(abs(poseTransformPoints(pose0,X) - Xnew) <= eps) )
+            assert( all(abs(poseMult(invertPoses(array([pose0]))[0],pose0) - array([1,0,0,0,0,0,0])) <= eps) )
+
 def test_quatRotateDirection():
     pairs = [ [[1,0,0], [0,1,0]], [[1,0,0], [1,0,0]], [[1,1,0], [0,1,1]] ]
     for sourcedir, targetdir in pairs:
@@ -13,6 +13,7 @@
 # limitations under the License.
 from common_test_openrave import *
 import imp
+import threading
 
 log=logging.getLogger('openravepytest')
 
@@ -24,6 +25,41 @@ def test_pluginloading():
     env=Environment()
     assert(RaveCreateProblem(env,'ikfast') is not None)
 
+@with_destroy
+def test_pluginindex():
+    RaveInitialize(load_all_plugins=True)
+    indexfilename = os.path.join(RaveGetHomeDirectory(),'plugins.index')
+    assert(os.path.exists(indexfilename))
+    plugininfo = RaveGetPluginInfo()
+    RaveDestroy()
+    # second initialization reads the interfaces from the index without loading the libraries
+    RaveInitialize(load_all_plugins=True)
+    assert(len(RaveGetPluginInfo()) == len(plugininfo))
+    env=Environment()
+    assert(RaveCreateProblem(env,'ikfast') is not None)
+    assert(RaveCreateCollisionChecker(env,'ode') is not None)
+
+@with_destroy
+def test_interfaceresolution():
+    RaveInitialize(load_all_plugins=False)
+    assert(not RaveHasInterface(InterfaceType.module,'ikfast'))
+    # loading a plugin has to be seen by names that were already resolved
+    assert(RaveLoadPlugin('ikfastsolvers'))
+    assert(RaveHasInterface(InterfaceType.module,'ikfast'))
+    assert(RaveHasInterface(InterfaceType.module,'IkFast'))
+    assert(not RaveHasInterface(InterfaceType.planner,'ikfast'))
+    env=Environment()
+    modules = []
+    def createmodules():
+        for i in range(20):
+            modules.append(RaveCreateModule(env,'ikfast'))
+    threads = [threading.Thread(target=createmodules) for i in range(4)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    assert(len(modules) == 80 and all([module is not None for module in modules]))
+
 class RunTutorialExample(object):
     __name__= 'test_global.tutorialexample'
     def __call__(self,modulepath):
@@ -63,3 +99,24 @@ def test_ikparam():
     
     ikparam2 = ikparam*T
     ikparam2.GetTranslationDirection5D().pos()
+
+def test_ikparambatch():
+    ikparams = []
+    for i in range(20):
+        T = matrixFromAxisAngle(random.rand(3)*pi)
+        T[0:3,3] = random.rand(3)
+        ikparams += [IkParameterization(T, IkParameterizationType.Transform6D), IkParameterization(T, IkParameterizationType.Translation3D), IkParameterization(Ray(T[0:3,3],T[0:3,2]), IkParameterizationType.TranslationDirection5D), IkParameterization((T[0:3,3],4*random.rand()-2), IkParameterizationType.TranslationXAxisAngle4D)]
+    for query in ikparams[:4]:
+        others = [ikparam for ikparam in ikparams if ikparam.GetType() == query.GetType()]
+        dists = query.ComputeDistancesSqr(array([ikparam.GetValues() for ikparam in others]))
+        assert(len(dists) == len(others))
+        for ikparam, dist in izip(others,dists):
+            assert(abs(query.ComputeDistanceSqr(ikparam)-dist) <= g_epsilon)
+    
+    for ikparam in ikparams:
+        data = ikparam.SerializeBinary()
+        assert(len(data) == 4+8*ikparam.GetNumberOfValues())
+        ikparam2 = IkParameterization()
+        ikparam2.DeserializeBinary(data)
+        assert(ikparam2.GetType() == ikparam.GetType())
+        assert(all(ikparam2.GetValues() == ikparam.GetValues()))
@@ -94,6 +94,40 @@ class TestIkSolver(EnvironmentSetup):
             sampler=planningutils.ManipulatorIKGoalSampler(robot.GetActiveManipulator(),[ikparam],nummaxsamples=20,nummaxtries=10,jitter=0.03)
             assert(sampler.Sample() is not None)
 
+    def test_goalsamplerbatch(self):
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        robot=env.GetRobots()[0]
+        ikmodel = databases.inversekinematics.InverseKinematicsModel(robot,IkParameterization.Type.Transform6D)
+        if not ikmodel.load():
+            ikmodel.autogenerate()
+
+        with env:
+            manip = robot.GetActiveManipulator()
+            ikparam = manip.GetIkParameterization(IkParameterizationType.Transform6D)
+            sampler=planningutils.ManipulatorIKGoalSampler(manip,[ikparam],nummaxsamples=20,nummaxtries=10)
+            sampler.SetBatchSolving(True)
+            sols = []
+            while True:
+                sol = sampler.Sample()
+                if sol is None:
+                    break
+                sols.append(sol)
+            assert(len(sols) > 0)
+            with robot:
+                for sol in sols:
+                    robot.SetDOFValues(sol, manip.GetArmIndices())
+                    assert(transdist(manip.GetTransform(), ikparam.GetTransform6D()) <= g_epsilon)
+
+            # moving the arm does not solve again
+            robot.SetDOFValues(sols[0], manip.GetArmIndices())
+            assert(sampler.Sample() is None)
+
+            # moving another body does
+            body = [b for b in env.GetBodies() if not b.IsRobot()][0]
+            body.SetTransform(body.GetTransform())
+            assert(sampler.Sample() is not None)
+
     def test_jointlimitsfilter(self):
         env=self.env
         self.LoadEnv('data/lab1.env.xml')
@@ -267,6 +301,137 @@ class TestIkSolver(EnvironmentSetup):
                 
                 assert(numsolutions==numexpected)
 
+    def test_solveallbatch(self):
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        robot=env.GetRobots()[0]
+        ikmodel = databases.inversekinematics.InverseKinematicsModel(robot,IkParameterization.Type.Transform6D)
+        if not ikmodel.load():
+            ikmodel.autogenerate()
+
+        with env:
+            iksolver = ikmodel.manip.GetIkSolver()
+            lower,upper = robot.GetDOFLimits(ikmodel.manip.GetArmIndices())
+            ikparams = []
+            with robot:
+                for i in range(40):
+                    robot.SetDOFValues(lower+random.rand(len(lower))*(upper-lower),ikmodel.manip.GetArmIndices())
+                    ikparams.append(ikmodel.manip.GetIkParameterization(IkParameterization.Type.Transform6D,False))
+            for filteroptions in [0, IkFilterOptions.CheckEnvCollisions]:
+                expectedsolutions = [iksolver.SolveAll(ikparam,filteroptions) for ikparam in ikparams]
+                for numthreads in [1,3]:
+                    assert(iksolver.SendCommand('SetBatchThreads %d'%numthreads) is not None)
+                    batchsolutions = iksolver.SolveAllBatch(ikparams,filteroptions)
+                    assert(len(batchsolutions) == len(ikparams))
+                    for expected, solutions in izip(expectedsolutions, batchsolutions):
+                        assert(len(expected) == len(solutions))
+                        for expectedreturn, ikreturn in izip(expected, solutions):
+                            assert(transdist(expectedreturn.GetSolution(), ikreturn.GetSolution()) <= g_epsilon)
+            iksolver.SendCommand('SetBatchThreads 1')
+
+    def test_freesweepthreads(self):
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        robot=env.GetRobots()[0]
+        ikmodel = databases.inversekinematics.InverseKinematicsModel(robot,IkParameterization.Type.Transform6D)
+        if not ikmodel.load():
+            ikmodel.autogenerate()
+
+        with env:
+            iksolver = ikmodel.manip.GetIkSolver()
+            assert(iksolver.GetNumFreeParameters() > 0)
+            robot.SetDOFValues(ones(robot.GetDOF()),range(robot.GetDOF()),checklimits=True)
+            ikparam = ikmodel.manip.GetIkParameterization(IkParameterization.Type.Transform6D,False)
+            expected = iksolver.SolveAll(ikparam,IkFilterOptions.CheckEnvCollisions)
+            assert(len(expected) > 2)
+            try:
+                assert(iksolver.SendCommand('SetFreeSweepThreads 3') is not None)
+                ikreturns = iksolver.SolveAll(ikparam,IkFilterOptions.CheckEnvCollisions)
+                assert(len(ikreturns) == len(expected))
+                for expectedreturn, ikreturn in izip(expected, ikreturns):
+                    assert(transdist(expectedreturn.GetSolution(), ikreturn.GetSolution()) <= g_epsilon)
+
+                # only the first solutions of the sweep are returned
+                assert(iksolver.SendCommand('SetMaxSolutions 2') is not None)
+                for numthreads in [1,3]:
+                    iksolver.SendCommand('SetFreeSweepThreads %d'%numthreads)
+                    ikreturns = iksolver.SolveAll(ikparam,IkFilterOptions.CheckEnvCollisions)
+                    assert(len(ikreturns) == 2)
+                    for ikreturn in ikreturns:
+                        assert(min([transdist(expectedreturn.GetSolution(), ikreturn.GetSolution()) for expectedreturn in expected]) <= g_epsilon)
+            finally:
+                iksolver.SendCommand('SetMaxSolutions 0')
+                iksolver.SendCommand('SetFreeSweepThreads 1')
+
+    def test_closestsolution(self):
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        robot=env.GetRobots()[0]
+        ikmodel = databases.inversekinematics.InverseKinematicsModel(robot,IkParameterization.Type.Transform6D)
+        if not ikmodel.load():
+            ikmodel.autogenerate()
+
+        with env:
+            iksolver = ikmodel.manip.GetIkSolver()
+            assert(iksolver.GetNumFreeParameters() > 0)
+            armindices = ikmodel.manip.GetArmIndices()
+            weights2 = robot.GetDOFWeights(armindices)**2
+            robot.SetDOFValues(ones(robot.GetDOF()),range(robot.GetDOF()),checklimits=True)
+            ikparam = ikmodel.manip.GetIkParameterization(IkParameterization.Type.Transform6D,False)
+            qseed = robot.GetDOFValues(armindices)
+            try:
+                assert(iksolver.SendCommand('SetClosestSolutionSearch 1') is not None)
+                # the seed itself is a solution
+                ikreturn = iksolver.Solve(ikparam,qseed,IkFilterOptions.CheckEnvCollisions)
+                assert(ikreturn.GetAction() == IkReturnAction.Success)
+                assert(transdist(ikreturn.GetSolution(),qseed) <= g_epsilon)
+                # never farther from the seed than the first solution found
+                qseed = qseed + 0.4*(random.rand(len(qseed))-0.5)
+                closestreturn = iksolver.Solve(ikparam,qseed,IkFilterOptions.CheckEnvCollisions)
+                assert(closestreturn.GetAction() == IkReturnAction.Success)
+                iksolver.SendCommand('SetClosestSolutionSearch 0')
+                firstreturn = iksolver.Solve(ikparam,qseed,IkFilterOptions.CheckEnvCollisions)
+                assert(firstreturn.GetAction() == IkReturnAction.Success)
+                closestdist = sum(weights2*robot.SubtractDOFValues(closestreturn.GetSolution(),qseed,armindices)**2)
+                firstdist = sum(weights2*robot.SubtractDOFValues(firstreturn.GetSolution(),qseed,armindices)**2)
+                assert(closestdist <= firstdist+g_epsilon)
+            finally:
+                iksolver.SendCommand('SetClosestSolutionSearch 0')
+
+    def test_solutioncache(self):
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        robot=env.GetRobots()[0]
+        ikmodel = databases.inversekinematics.InverseKinematicsModel(robot,IkParameterization.Type.Transform6D)
+        if not ikmodel.load():
+            ikmodel.autogenerate()
+
+        with env:
+            iksolver = ikmodel.manip.GetIkSolver()
+            robot.SetDOFValues(ones(robot.GetDOF()),range(robot.GetDOF()),checklimits=True)
+            ikparam = ikmodel.manip.GetIkParameterization(IkParameterization.Type.Transform6D,False)
+            expected = iksolver.SolveAll(ikparam,IkFilterOptions.CheckEnvCollisions)
+            assert(len(expected) > 0)
+            try:
+                assert(iksolver.SendCommand('SetSolutionCache 1000') is not None)
+                for i in range(2):
+                    ikreturns = iksolver.SolveAll(ikparam,IkFilterOptions.CheckEnvCollisions)
+                    assert(len(ikreturns) == len(expected))
+                    for expectedreturn, ikreturn in izip(expected, ikreturns):
+                        assert(transdist(expectedreturn.GetSolution(), ikreturn.GetSolution()) <= g_epsilon)
+                nhits,nmisses,nentries = [int(s) for s in iksolver.SendCommand('GetSolutionCacheStats').split()]
+                assert(nhits == nmisses and nentries == nmisses)
+
+                # the filters are still run on the cached solutions
+                ikreturns = iksolver.SolveAll(ikparam,IkFilterOptions.IgnoreJointLimits)
+                assert(len(ikreturns) >= len(expected))
+                handle = iksolver.RegisterCustomFilter(0,lambda solution,manip,ikparam: IkReturnAction.Reject)
+                assert(iksolver.Solve(ikparam,None,IkFilterOptions.CheckEnvCollisions).GetAction() != IkReturnAction.Success)
+                handle.close()
+                assert(iksolver.Solve(ikparam,None,IkFilterOptions.CheckEnvCollisions).GetAction() == IkReturnAction.Success)
+            finally:
+                iksolver.SendCommand('SetSolutionCache 0')
+
     def test_circularfree(self):
         # test when free joint is circular and IK doesn't succeed (thanks to Chris Dellin)
         robotxmldata = '''<Robot name="BarrettWAM">
@@ -589,6 +589,82 @@ class TestKinematics(EnvironmentSetup):
                         coeffs1,residuals, rank, singular_values, rcond=polyfit(mults,errsecond/errsecond[-1],3,full=True)
                         assert(residuals<0.01)
                         
+    def test_batchjacobians(self):
+        self.log.info('check that the batched jacobians match the per link jacobians')
+        env=self.env
+        self.LoadEnv('robots/barrettwam.robot.xml',{'skipgeometry':'1'})
+        robot = env.GetRobots()[0]
+        lowerlimit,upperlimit = robot.GetDOFLimits()
+        with env:
+            for i in range(10):
+                robot.SetDOFValues(randlimits(lowerlimit,upperlimit))
+                linkpositions = [(ilink,random.rand(3)-0.5) for ilink in range(len(robot.GetLinks()))]
+                for indices in [None, range(0,robot.GetDOF(),2)]:
+                    jacobians = robot.ComputeJacobians(linkpositions,indices)
+                    assert(jacobians.shape[0] == len(linkpositions) and jacobians.shape[1] == 6)
+                    for (ilink,position),J in izip(linkpositions,jacobians):
+                        assert(sum(abs(J[0:3]-robot.ComputeJacobianTranslation(ilink,position,indices))) <= g_epsilon)
+                        assert(sum(abs(J[3:6]-robot.ComputeJacobianAxisAngle(ilink,indices))) <= g_epsilon)
+                for manip in robot.GetManipulators():
+                    J = manip.CalculateJacobians()
+                    assert(sum(abs(J[0:3]-manip.CalculateJacobian())) <= g_epsilon)
+                    assert(sum(abs(J[3:6]-manip.CalculateAngularVelocityJacobian())) <= g_epsilon)
+
+    def test_batchlinktransformations(self):
+        self.log.info('check that the batched forward kinematics match SetDOFValues and do not change the body')
+        env=self.env
+        for robotfile in ['robots/barrettwam.robot.xml','robots/pr2-beta-static.zae']:
+            env.Reset()
+            self.LoadEnv(robotfile,{'skipgeometry':'1'})
+            robot = env.GetRobots()[0]
+            lowerlimit,upperlimit = robot.GetDOFLimits()
+            with env:
+                robot.SetTransform(matrixFromAxisAngle([0.1,0.2,0.3]))
+                robot.SetDOFValues(randlimits(lowerlimit,upperlimit))
+                initialvalues = robot.GetDOFValues()
+                stamp = robot.GetUpdateStamp()
+                configs = array([randlimits(lowerlimit,upperlimit) for i in range(9)])
+                transforms = robot.ComputeLinkTransformationsBatch(configs)
+                assert(transforms.shape == (len(configs),len(robot.GetLinks()),4,4))
+                assert(robot.GetUpdateStamp() == stamp)
+                assert(transdist(robot.GetDOFValues(),initialvalues) <= g_epsilon)
+                for config,configtransforms in izip(configs,transforms):
+                    robot.SetDOFValues(config,checklimits=KinBody.CheckLimitsAction.Nothing)
+                    for link,T in izip(robot.GetLinks(),configtransforms):
+                        assert(transdist(link.GetTransform(),T) <= g_epsilon)
+
+    def test_inversedynamicssequence(self):
+        self.log.info('check that the batched inverse dynamics match the per state inverse dynamics')
+        env=self.env
+        self.LoadEnv('robots/barrettwam.robot.xml',{'skipgeometry':'1'})
+        robot = env.GetRobots()[0]
+        with env:
+            env.GetPhysicsEngine().SetGravity([0,0,-9.8])
+            lower,upper = robot.GetDOFLimits()
+            vellimits = robot.GetDOFVelocityLimits()
+            dofvalues = array([randlimits(lower,upper) for i in range(10)])
+            dofvelocities = array([randlimits(-vellimits,vellimits) for i in range(10)])
+            dofaccelerations = 10*random.rand(10,robot.GetDOF())-5
+            initialvalues = robot.GetDOFValues()
+            for accelerations in [dofaccelerations, None]:
+                torques = robot.ComputeInverseDynamicsSequence(dofvalues,dofvelocities,accelerations)
+                assert(torques.shape == dofvalues.shape)
+                assert(transdist(robot.GetDOFValues(),initialvalues) <= g_epsilon)
+                for i in range(len(dofvalues)):
+                    robot.SetDOFValues(dofvalues[i])
+                    robot.SetDOFVelocities(dofvelocities[i])
+                    expectedtorques = robot.ComputeInverseDynamics(accelerations[i] if accelerations is not None else None)
+                    assert(transdist(torques[i],expectedtorques) <= g_epsilon)
+                robot.SetDOFValues(initialvalues)
+
+            # changing the inertia of a link has to be reflected in the next call
+            robot.SetDOFValues(dofvalues[0])
+            robot.SetDOFVelocities(dofvelocities[0])
+            torques = robot.ComputeInverseDynamics(dofaccelerations[0])
+            link = robot.GetLinks()[-1]
+            link.SetPrincipalMomentsOfInertia(link.GetPrincipalMomentsOfInertia()*2+0.1)
+            assert(transdist(robot.ComputeInverseDynamics(dofaccelerations[0]),torques) > g_epsilon)
+
     def test_initkinbody(self):
         self.log.info('tests initializing a kinematics body')
         env=self.env
@@ -691,6 +767,31 @@ class TestKinematics(EnvironmentSetup):
             
             body.SetLinkEnableStates(body.GetLinkEnableStates())
 
+    def test_statesaverstamps(self):
+        self.log.info('test that state savers only restore the bodies that changed')
+        env=self.env
+        with env:
+            robot=self.LoadRobot('robots/pr2-beta-static.zae')
+            lower,upper = robot.GetDOFLimits()
+            values0 = 0.5*(lower+upper)
+            values1 = 0.75*lower+0.25*upper
+            robot.SetDOFValues(values0)
+            stamp = robot.GetUpdateStamp()
+            with robot.CreateRobotStateSaver():
+                pass
+            # nothing changed, so the saver should not touch the links
+            assert(robot.GetUpdateStamp()==stamp)
+
+            with robot.CreateKinBodyStateSaver():
+                robot.SetDOFValues(values1)
+                with robot.CreateKinBodyStateSaver():
+                    robot.SetDOFValues(values0)
+                assert(transdist(robot.GetDOFValues(),values1) <= g_epsilon)
+                with robot.CreateKinBodyStateSaver():
+                    pass
+                assert(transdist(robot.GetDOFValues(),values1) <= g_epsilon)
+            assert(transdist(robot.GetDOFValues(),values0) <= g_epsilon)
+
     def test_geometrychange(self):
         self.log.info('change geometry and test if changes are updated')
         env=self.env
@@ -713,6 +814,17 @@ class TestKinematics(EnvironmentSetup):
         robot.SetLinkTransformations([randtrans() for link in robot.GetLinks()],zeros(robot.GetDOF()))
         hash1 = robot.GetKinematicsGeometryHash()
         assert( hash0 == hash1 )
+        # modifying one geometry changes the hash, restoring it gives back the original hash
+        with self.env:
+            for link in robot.GetLinks():
+                for geom in link.GetGeometries():
+                    if geom.IsModifiable() and len(geom.GetCollisionMesh().vertices) > 0:
+                        mesh = geom.GetCollisionMesh()
+                        geom.SetCollisionMesh(TriMesh(*misc.ComputeBoxMesh([0.1,0.2,0.3])))
+                        assert( robot.GetKinematicsGeometryHash() != hash0 )
+                        geom.SetCollisionMesh(mesh)
+                        assert( robot.GetKinematicsGeometryHash() == hash0 )
+                        return
 
     def test_staticlinks(self):
         env=self.env
@@ -875,6 +987,41 @@ class TestKinematics(EnvironmentSetup):
         assert(J0a.GetMimicDOFIndices() == [0])
         assert(J0b.GetMimicDOFIndices() == [0])
 
+    def test_mimicpolynomial(self):
+        self.log.info('polynomial mimic equations without velocity equations get exact partial derivatives')
+        env=self.env
+        xml="""
+<kinbody name="a">
+  <body name="L0">
+  </body>
+  <body name="L1">
+  </body>
+  <body name="L2">
+  </body>
+  <joint name="J0" type="hinge">
+    <body>L0</body>
+    <body>L1</body>
+    <axis>1 0 0</axis>
+  </joint>
+  <joint name="J0a" type="hinge" mimic_pos="J0^2 + 0.5*J0">
+    <body>L1</body>
+    <body>L2</body>
+    <axis>1 0 0</axis>
+    <limitsdeg>-180 180</limitsdeg>
+  </joint>
+</kinbody>
+"""
+        body = env.ReadKinBodyData(xml)
+        env.Add(body)
+        value = 0.5
+        body.SetDOFValues([value])
+        J0a = body.GetJoint('J0a')
+        assert(abs(J0a.GetValues()[0]-(value**2+0.5*value)) <= g_epsilon )
+        body.SetDOFVelocities([1.0])
+        linkvelocities = body.GetLinkVelocities()
+        # L2 rotates with J0 and with the partial derivative 2*J0+0.5 of J0a
+        assert(abs(linkvelocities[2][3]-(1.0+2*value+0.5)) <= g_epsilon )
+
     def test_specification(self):
         env=self.env
         self.LoadEnv('data/lab1.env.xml')
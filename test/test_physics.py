@@ -273,6 +273,35 @@ class test_ode(RunPhysics):
     def __init__(self):
         RunPhysics.__init__(self, 'ode')
 
+    def test_odethreads(self):
+        log.info('multi-threaded stepping gives the same simulation as single-threaded stepping')
+        env=self.env
+        self.LoadEnv('data/hanoi.env.xml')
+        with env:
+            env.GetPhysicsEngine().SetGravity([0,0,-9.81])
+            for i,bodyname in enumerate(['data/lego2.kinbody.xml', 'data/lego4.kinbody.xml', 'data/mug1.kinbody.xml']):
+                body = env.ReadKinBodyURI(bodyname)
+                body.SetName('body%d'%i)
+                env.Add(body)
+                T = eye(4)
+                T[0:3,3] = [-0.5+0.3*i,-0.5,1.0]
+                body.SetTransform(T)
+            env2 = env.CloneSelf(CloningOptions.Bodies)
+            env2.SetPhysicsEngine(RaveCreatePhysicsEngine(env2,'ode'))
+            env2.GetPhysicsEngine().SetGravity([0,0,-9.81])
+            assert(env2.GetPhysicsEngine().SendCommand('SetNumThreads 4') is not None)
+            env.GetPhysicsEngine().SendCommand('ResetStepTimes')
+            for i in range(100):
+                env.StepSimulation(0.01)
+            with env2:
+                for i in range(100):
+                    env2.StepSimulation(0.01)
+                for body in env.GetBodies():
+                    assert( transdist(body.GetTransform(),env2.GetKinBody(body.GetName()).GetTransform()) <= g_epsilon )
+            times = [float(f) for f in env.GetPhysicsEngine().SendCommand('GetStepTimes').split()]
+            assert(len(times)==4 and times[0]==100)
+        env2.Destroy()
+
 # class test_bullet(RunPhysics):
 #     def __init__(self):
 #         RunPhysics.__init__(self, 'bullet')
@@ -42,6 +42,13 @@ class RunPlanning(EnvironmentSetup):
                 parameters = Planner.PlannerParameters()
                 parameters.SetRobotActiveJoints(robot)
                 planningutils.VerifyTrajectory(parameters,traj,samplingstep=0.002)
+                assert(len(planningutils.VerifyTrajectoryIntervals(parameters,traj,samplingstep=0.002,numthreads=4)) == 0)
+                # every waypoint that moves violates the lowered velocity limits
+                parameters.SetConfigVelocityLimit(0.01*robot.GetActiveDOFMaxVel())
+                intervals = planningutils.VerifyTrajectoryIntervals(parameters,traj,samplingstep=0.002,numthreads=4,stopatfirst=False)
+                assert(len(intervals) > 1)
+                assert(all(intervals[i][0] <= intervals[i+1][0] for i in range(len(intervals)-1)))
+                assert(len(planningutils.VerifyTrajectoryIntervals(parameters,traj,samplingstep=0.002,numthreads=1,stopatfirst=True)) == 1)
             self.RunTrajectory(robot,traj)
 
             spec = manip.GetArmConfigurationSpecification()
@@ -615,6 +622,498 @@ class RunPlanning(EnvironmentSetup):
             assert(success)
             assert(not env.CheckCollision(collisionbody))
 
+    def test_birrtnearestneighbor(self):
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        robot=env.GetRobots()[0]
+        with env:
+            robot.SetActiveDOFs(robot.GetActiveManipulator().GetArmIndices())
+            params = Planner.PlannerParameters()
+            params.SetRobotActiveJoints(robot)
+            params.SetInitialConfig(robot.GetActiveDOFValues())
+            params.SetGoalConfig(robot.GetActiveDOFValues()+0.2)
+            params.SetExtraParameters('<_nmaxiterations>2000</_nmaxiterations>')
+            planner = RaveCreatePlanner(env,'birrt')
+            assert(planner.SendCommand('SetNearestNeighborOptions weights robot numthreads 2'))
+            assert(planner.InitPlan(robot,params))
+            results = planner.SendCommand('BenchmarkNearestNeighbor 500 100').split()
+            assert(len(results) == 6 and results[0] == 'metric' and results[3] == 'options')
+            assert(all([float(value) > 0 for value in results[1:3]+results[4:6]]))
+            traj = RaveCreateTrajectory(env,'')
+            assert(planner.PlanPath(traj) == PlannerStatus.HasSolution)
+            assert(traj.GetNumWaypoints() >= 2)
+
+    def test_birrtpythonmetric(self):
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        robot=env.GetRobots()[0]
+        with env:
+            robot.SetActiveDOFs(robot.GetActiveManipulator().GetArmIndices())
+            params = Planner.PlannerParameters()
+            params.SetRobotActiveJoints(robot)
+            params.SetInitialConfig(robot.GetActiveDOFValues())
+            params.SetGoalConfig(robot.GetActiveDOFValues()+0.2)
+            params.SetExtraParameters('<_nmaxiterations>2000</_nmaxiterations>')
+            weights = robot.GetActiveDOFWeights()**2
+            numbatchcalls = [0]
+            def distmetric(q0,q1):
+                return sqrt(dot(weights,(q0-q1)**2))
+            def distmetricbatch(q,configs,distances):
+                numbatchcalls[0] += 1
+                distances[:] = sqrt(dot((configs-q)**2,weights))
+            params.SetDistanceMetricFn(distmetric)
+            params.SetDistanceMetricBatchFn(distmetricbatch)
+            planner = RaveCreatePlanner(env,'birrt')
+            assert(planner.InitPlan(robot,params))
+            traj = RaveCreateTrajectory(env,'')
+            assert(planner.PlanPath(traj) == PlannerStatus.HasSolution)
+            assert(numbatchcalls[0] > 0)
+
+    def test_birrtracing(self):
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        robot=env.GetRobots()[0]
+        with env:
+            robot.SetActiveDOFs(robot.GetActiveManipulator().GetArmIndices())
+            initvalues = robot.GetActiveDOFValues()
+            goalvalues = initvalues+0.2
+            params = Planner.PlannerParameters()
+            params.SetRobotActiveJoints(robot)
+            params.SetInitialConfig(initvalues)
+            params.SetGoalConfig(goalvalues)
+            params.SetExtraParameters('<numthreads>3</numthreads><_nmaxiterations>2000</_nmaxiterations>')
+            planner = RaveCreatePlanner(env,'birrt')
+            for iter in range(2):
+                assert(planner.InitPlan(robot,params))
+                traj = RaveCreateTrajectory(env,'')
+                assert(planner.PlanPath(traj) == PlannerStatus.HasSolution)
+                assert(traj.GetDuration() > 0)
+                spec = traj.GetConfigurationSpecification()
+                assert(transdist(spec.ExtractJointValues(traj.GetWaypoint(0),robot,robot.GetActiveDOFIndices(),0),initvalues) <= g_epsilon)
+                assert(transdist(spec.ExtractJointValues(traj.GetWaypoint(-1),robot,robot.GetActiveDOFIndices(),0),goalvalues) <= g_epsilon)
+
+    def test_basicrrtbatched(self):
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        robot=env.GetRobots()[0]
+        with env:
+            robot.SetActiveDOFs(robot.GetActiveManipulator().GetArmIndices())
+            initvalues = robot.GetActiveDOFValues()
+            goalvalues = initvalues+0.2
+            params = Planner.PlannerParameters()
+            params.SetRobotActiveJoints(robot)
+            params.SetInitialConfig(initvalues)
+            params.SetGoalConfig(goalvalues)
+            params.SetExtraParameters('<numthreads>3</numthreads><_nmaxiterations>4000</_nmaxiterations>')
+            planner = RaveCreatePlanner(env,'basicrrt')
+            assert(planner.InitPlan(robot,params))
+            traj = RaveCreateTrajectory(env,'')
+            assert(planner.PlanPath(traj) == PlannerStatus.HasSolution)
+            spec = traj.GetConfigurationSpecification()
+            assert(transdist(spec.ExtractJointValues(traj.GetWaypoint(0),robot,robot.GetActiveDOFIndices(),0),initvalues) <= g_epsilon)
+            # the path ends within two step lengths of the goal
+            assert(transdist(spec.ExtractJointValues(traj.GetWaypoint(-1),robot,robot.GetActiveDOFIndices(),0),goalvalues) <= 0.5)
+
+            params = Planner.PlannerParameters()
+            params.SetRobotActiveJoints(robot)
+            params.SetInitialConfig(initvalues)
+            params.SetExtraParameters('<numthreads>3</numthreads><exploreprob>0.5</exploreprob><expectedsize>200</expectedsize><_nmaxiterations>10000</_nmaxiterations>')
+            planner = RaveCreatePlanner(env,'explorationrrt')
+            assert(planner.InitPlan(robot,params))
+            traj = RaveCreateTrajectory(env,'')
+            assert(planner.PlanPath(traj) == PlannerStatus.HasSolution)
+            assert(traj.GetNumWaypoints() >= 200)
+            spec = traj.GetConfigurationSpecification()
+            for i in range(traj.GetNumWaypoints()):
+                robot.SetActiveDOFValues(spec.ExtractJointValues(traj.GetWaypoint(i),robot,robot.GetActiveDOFIndices(),0))
+                assert(not env.CheckCollision(robot) and not robot.CheckSelfCollision())
+
+    def test_planpathasync(self):
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        robot=env.GetRobots()[0]
+        with env:
+            robot.SetActiveDOFs(robot.GetActiveManipulator().GetArmIndices())
+            params = Planner.PlannerParameters()
+            params.SetRobotActiveJoints(robot)
+            params.SetInitialConfig(robot.GetActiveDOFValues())
+            params.SetGoalConfig(robot.GetActiveDOFValues()+0.2)
+            params.SetExtraParameters('<_nmaxiterations>2000</_nmaxiterations>')
+            planner = RaveCreatePlanner(env,'birrt')
+            assert(planner.InitPlan(robot,params))
+        # the environment is locked by the planning thread, so wait without holding it
+        traj = RaveCreateTrajectory(env,'')
+        handle = planner.PlanPathAsync(traj)
+        assert(handle.Wait() == PlannerStatus.HasSolution)
+        assert(handle.IsDone() and not handle.IsCancelled())
+        assert(traj.GetNumWaypoints() >= 2)
+
+        with env:
+            assert(planner.InitPlan(robot,params))
+        traj = RaveCreateTrajectory(env,'')
+        handle = planner.PlanPathAsync(traj)
+        handle.Cancel()
+        status = handle.Wait()
+        assert(handle.IsCancelled())
+        assert(status == PlannerStatus.HasSolution or handle.GetNumProgressUpdates() > 0 and status in [PlannerStatus.Interrupted, PlannerStatus.InterruptedWithSolution])
+
+    def test_birrtstatistics(self):
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        robot=env.GetRobots()[0]
+        with env:
+            robot.SetActiveDOFs(robot.GetActiveManipulator().GetArmIndices())
+            params = Planner.PlannerParameters()
+            params.SetRobotActiveJoints(robot)
+            params.SetInitialConfig(robot.GetActiveDOFValues())
+            params.SetGoalConfig(robot.GetActiveDOFValues()+0.2)
+            planner = RaveCreatePlanner(env,'birrt')
+            reservedbytes = None
+            for iter in range(3):
+                assert(planner.InitPlan(robot,params))
+                traj = RaveCreateTrajectory(env,'')
+                assert(planner.PlanPath(traj) == PlannerStatus.HasSolution)
+                stats = {}
+                for line in planner.SendCommand('GetStatistics').splitlines():
+                    values = line.split()
+                    stats[values[0]] = dict([(values[i],int(values[i+1])) for i in range(1,len(values),2)])
+                assert(stats['forward']['numnodes'] > 0 and stats['forward']['numused'] >= stats['forward']['numnodes'])
+                assert(stats['backward']['numresets'] == iter)
+                if reservedbytes is not None:
+                    # memory is reused between the planning calls
+                    assert(stats['forward']['reservedbytes'] == reservedbytes)
+                reservedbytes = stats['forward']['reservedbytes']
+
+    def test_planningreplay(self):
+        from openravepy import planningreplay
+        import tempfile, shutil
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        robot=env.GetRobots()[0]
+        with env:
+            robot.SetActiveDOFs(robot.GetActiveManipulator().GetArmIndices())
+            params = Planner.PlannerParameters()
+            params.SetRobotActiveJoints(robot)
+            params.SetInitialConfig(robot.GetActiveDOFValues())
+            params.SetGoalConfig(robot.GetActiveDOFValues()+0.2)
+            params.SetRandomGeneratorSeed(10)
+            planner = RaveCreatePlanner(env,'birrt')
+            assert(planner.InitPlan(robot,params))
+        directory = tempfile.mkdtemp()
+        replayenv = Environment()
+        try:
+            planningreplay.RecordPlanningRequest(planner,robot,directory,name='lab1')
+            requests = planningreplay.LoadPlanningRequests(directory)
+            assert(len(requests) == 1 and requests[0][1]['planner'] == 'birrt' and requests[0][1]['robot'] == robot.GetName())
+            results = [planningreplay.ReplayPlanningRequest(replayenv,requestdir,request,seed=seed) for requestdir,request in requests for seed in [None,1]]
+            for result in results:
+                assert(result['success'] and result['duration'] > 0)
+                assert(all(stage in result['stages'] for stage in ['planning','smoothing','retiming','verification']))
+            summary = planningreplay.SummarizeReplays(results)
+            assert(summary['replays'] == 2 and summary['successrate'] == 1.0)
+            assert(summary['stages']['planning']['count'] == 2)
+        finally:
+            replayenv.Destroy()
+            shutil.rmtree(directory)
+
+    def test_birrtlazy(self):
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        robot=env.GetRobots()[0]
+        with env:
+            robot.SetActiveDOFs(robot.GetActiveManipulator().GetArmIndices())
+            initvalues = robot.GetActiveDOFValues()
+            lower,upper = robot.GetActiveDOFLimits()
+            # random collision free goals, some of them need the planner to go around obstacles
+            goals = []
+            while len(goals) < 3:
+                with robot:
+                    values = lower+random.rand(len(lower))*(upper-lower)
+                    robot.SetActiveDOFValues(values)
+                    if not env.CheckCollision(robot) and not robot.CheckSelfCollision():
+                        goals.append(values)
+            planner = RaveCreatePlanner(env,'birrt')
+            for goal in goals:
+                params = Planner.PlannerParameters()
+                params.SetRobotActiveJoints(robot)
+                params.SetInitialConfig(initvalues)
+                params.SetGoalConfig(goal)
+                params.SetExtraParameters('<lazycollisionchecking>10</lazycollisionchecking><_nmaxiterations>5000</_nmaxiterations>')
+                assert(planner.InitPlan(robot,params))
+                traj = RaveCreateTrajectory(env,'')
+                assert(planner.PlanPath(traj) == PlannerStatus.HasSolution)
+                assert('lazy' in planner.SendCommand('GetStatistics'))
+                with robot:
+                    parameters = Planner.PlannerParameters()
+                    parameters.SetRobotActiveJoints(robot)
+                    planningutils.VerifyTrajectory(parameters,traj,samplingstep=0.002)
+
+    def test_prmmultiquery(self):
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        robot=env.GetRobots()[0]
+        with env:
+            robot.SetActiveDOFs(robot.GetActiveManipulator().GetArmIndices())
+            initvalues = robot.GetActiveDOFValues()
+            lower,upper = robot.GetActiveDOFLimits()
+            goals = []
+            while len(goals) < 2:
+                with robot:
+                    values = lower+random.rand(len(lower))*(upper-lower)
+                    robot.SetActiveDOFValues(values)
+                    if not env.CheckCollision(robot) and not robot.CheckSelfCollision():
+                        goals.append(values)
+            planner = RaveCreatePlanner(env,'prm')
+            vnumvertices = []
+            # the roadmap is kept between the queries, so repeating them does not add vertices
+            for goal in goals+goals:
+                params = Planner.PlannerParameters()
+                params.SetRobotActiveJoints(robot)
+                params.SetInitialConfig(initvalues)
+                params.SetGoalConfig(goal)
+                assert(planner.InitPlan(robot,params))
+                traj = RaveCreateTrajectory(env,'')
+                assert(planner.PlanPath(traj) == PlannerStatus.HasSolution)
+                with robot:
+                    parameters = Planner.PlannerParameters()
+                    parameters.SetRobotActiveJoints(robot)
+                    planningutils.VerifyTrajectory(parameters,traj,samplingstep=0.002)
+                vnumvertices.append(int(planner.SendCommand('GetRoadmapStatistics').split()[0]))
+            assert(vnumvertices[2] == vnumvertices[1] and vnumvertices[3] == vnumvertices[1])
+            numvertices = vnumvertices[-1]
+
+            filename = planner.SendCommand('SaveRoadmap')
+            try:
+                planner.SendCommand('ResetRoadmap')
+                assert(planner.SendCommand('GetRoadmapStatistics').split()[0] == '0')
+                planner.SendCommand('LoadRoadmap %s'%filename)
+                assert(int(planner.SendCommand('GetRoadmapStatistics').split()[0]) == numvertices)
+                assert(planner.PlanPath(traj) == PlannerStatus.HasSolution)
+            finally:
+                os.remove(filename)
+
+    def test_pathlibrary(self):
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        robot=env.GetRobots()[0]
+        with env:
+            robot.SetActiveDOFs(robot.GetActiveManipulator().GetArmIndices())
+            initvalues = robot.GetActiveDOFValues()
+            lower,upper = robot.GetActiveDOFLimits()
+            while True:
+                with robot:
+                    goalvalues = lower+random.rand(len(lower))*(upper-lower)
+                    robot.SetActiveDOFValues(goalvalues)
+                    if not env.CheckCollision(robot) and not robot.CheckSelfCollision():
+                        break
+            planner = RaveCreatePlanner(env,'pathlibrary')
+            # the second query is a small variation of the first, so it is answered from the library
+            for goal in [goalvalues, minimum(goalvalues+0.001,upper)]:
+                params = Planner.PlannerParameters()
+                params.SetRobotActiveJoints(robot)
+                params.SetInitialConfig(initvalues)
+                params.SetGoalConfig(goal)
+                assert(planner.InitPlan(robot,params))
+                traj = RaveCreateTrajectory(env,'')
+                assert(planner.PlanPath(traj) == PlannerStatus.HasSolution)
+                spec = traj.GetConfigurationSpecification()
+                assert(transdist(spec.ExtractJointValues(traj.GetWaypoint(-1),robot,robot.GetActiveDOFIndices(),0),goal) <= g_epsilon)
+                with robot:
+                    parameters = Planner.PlannerParameters()
+                    parameters.SetRobotActiveJoints(robot)
+                    planningutils.VerifyTrajectory(parameters,traj,samplingstep=0.002)
+            values = planner.SendCommand('GetStatistics').split()
+            stats = dict([(values[i],float(values[i+1])) for i in range(1,len(values),2)])
+            assert(stats['numqueries'] == 2 and stats['numfallbacks'] == 1)
+            assert(stats['numhits']+stats['numrepaired'] == 1 and stats['hitrate'] == 0.5)
+
+    def test_parabolicsmoothingthreads(self):
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        robot=env.GetRobots()[0]
+        with env:
+            robot.SetActiveDOFs(robot.GetActiveManipulator().GetArmIndices())
+            initvalues = robot.GetActiveDOFValues()
+            goalvalues = initvalues+0.2
+            params = Planner.PlannerParameters()
+            params.SetRobotActiveJoints(robot)
+            params.SetInitialConfig(initvalues)
+            params.SetGoalConfig(goalvalues)
+            planner = RaveCreatePlanner(env,'birrt')
+            assert(planner.InitPlan(robot,params))
+            traj = RaveCreateTrajectory(env,'')
+            assert(planner.PlanPath(traj) == PlannerStatus.HasSolution)
+
+            params = Planner.PlannerParameters()
+            params.SetRobotActiveJoints(robot)
+            params.SetExtraParameters('<nshortcutthreads>3</nshortcutthreads><_nmaxiterations>50</_nmaxiterations>')
+            smoother = RaveCreatePlanner(env,'parabolicsmoother')
+            assert(smoother.InitPlan(robot,params))
+            assert(smoother.PlanPath(traj) == PlannerStatus.HasSolution)
+            spec = traj.GetConfigurationSpecification()
+            assert(transdist(spec.ExtractJointValues(traj.GetWaypoint(0),robot,robot.GetActiveDOFIndices(),0),initvalues) <= g_epsilon)
+            assert(transdist(spec.ExtractJointValues(traj.GetWaypoint(-1),robot,robot.GetActiveDOFIndices(),0),goalvalues) <= g_epsilon)
+            stats = {}
+            for line in smoother.SendCommand('GetStatistics').splitlines():
+                values = line.split()
+                stats[values[0]] = dict([(values[i],float(values[i+1])) for i in range(1,len(values),2)])
+            assert(stats['shortcut']['numthreads'] == 3)
+            assert(stats['shortcut']['numcandidates'] > 0 and stats['shortcut']['numaccepted'] <= stats['shortcut']['numcandidates'])
+            assert(0 <= stats['shortcut']['acceptancerate'] <= 1)
+            with robot:
+                parameters = Planner.PlannerParameters()
+                parameters.SetRobotActiveJoints(robot)
+                planningutils.VerifyTrajectory(parameters,traj,samplingstep=0.002)
+
+    def test_parabolicsmoothingwindows(self):
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        robot=env.GetRobots()[0]
+        with env:
+            robot.SetActiveDOFs(robot.GetActiveManipulator().GetArmIndices())
+            initvalues = robot.GetActiveDOFValues()
+            # zig-zag through many waypoints so that the path is split into several windows
+            spec = robot.GetActiveConfigurationSpecification()
+            traj = RaveCreateTrajectory(env,'')
+            traj.Init(spec)
+            for i in range(25):
+                traj.Insert(traj.GetNumWaypoints(),initvalues+0.004*i+0.02*(i%2))
+            goalvalues = traj.GetWaypoint(-1)
+            vwaypoints = []
+            for itry in range(2):
+                smoothtraj = RaveCreateTrajectory(env,'')
+                smoothtraj.Clone(traj,0)
+                params = Planner.PlannerParameters()
+                params.SetRobotActiveJoints(robot)
+                params.SetExtraParameters('<nshortcutthreads>3</nshortcutthreads><nshortcutwindowsize>4</nshortcutwindowsize><_nmaxiterations>40</_nmaxiterations>')
+                smoother = RaveCreatePlanner(env,'parabolicsmoother')
+                assert(smoother.InitPlan(robot,params))
+                assert(smoother.PlanPath(smoothtraj) == PlannerStatus.HasSolution)
+                smoothspec = smoothtraj.GetConfigurationSpecification()
+                assert(transdist(smoothspec.ExtractJointValues(smoothtraj.GetWaypoint(0),robot,robot.GetActiveDOFIndices(),0),initvalues) <= g_epsilon)
+                assert(transdist(smoothspec.ExtractJointValues(smoothtraj.GetWaypoint(-1),robot,robot.GetActiveDOFIndices(),0),goalvalues) <= g_epsilon)
+                with robot:
+                    parameters = Planner.PlannerParameters()
+                    parameters.SetRobotActiveJoints(robot)
+                    planningutils.VerifyTrajectory(parameters,smoothtraj,samplingstep=0.002)
+                vwaypoints.append(smoothtraj.GetWaypoints(0,smoothtraj.GetNumWaypoints()))
+            # the windows are seeded by their index, so the thread timing does not change the path
+            assert(len(vwaypoints[0]) == len(vwaypoints[1]) and transdist(vwaypoints[0],vwaypoints[1]) <= g_epsilon)
+
+    def test_linearsmoothingthreads(self):
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        robot=env.GetRobots()[0]
+        with env:
+            robot.SetActiveDOFs(robot.GetActiveManipulator().GetArmIndices())
+            initvalues = robot.GetActiveDOFValues()
+            goalvalues = initvalues+0.2
+            params = Planner.PlannerParameters()
+            params.SetRobotActiveJoints(robot)
+            params.SetInitialConfig(initvalues)
+            params.SetGoalConfig(goalvalues)
+            planner = RaveCreatePlanner(env,'birrt')
+            assert(planner.InitPlan(robot,params))
+            traj = RaveCreateTrajectory(env,'')
+            assert(planner.PlanPath(traj) == PlannerStatus.HasSolution)
+            spec = traj.GetConfigurationSpecification()
+            for plannername in ['linearsmoother','shortcut_linear']:
+                self.log.info('planner %s', plannername)
+                vwaypoints = []
+                for itry in range(2):
+                    smoothtraj = RaveCreateTrajectory(env,'')
+                    smoothtraj.Clone(traj,0)
+                    params = Planner.PlannerParameters()
+                    params.SetRobotActiveJoints(robot)
+                    params.SetExtraParameters('<_nmaxiterations>40</_nmaxiterations>')
+                    smoother = RaveCreatePlanner(env,plannername)
+                    assert(smoother.SendCommand('SetNumThreads 3') is not None)
+                    assert(smoother.InitPlan(robot,params))
+                    assert(smoother.PlanPath(smoothtraj) == PlannerStatus.HasSolution)
+                    smoothspec = smoothtraj.GetConfigurationSpecification()
+                    assert(transdist(smoothspec.ExtractJointValues(smoothtraj.GetWaypoint(0),robot,robot.GetActiveDOFIndices(),0),initvalues) <= g_epsilon)
+                    assert(transdist(smoothspec.ExtractJointValues(smoothtraj.GetWaypoint(-1),robot,robot.GetActiveDOFIndices(),0),goalvalues) <= g_epsilon)
+                    with robot:
+                        parameters = Planner.PlannerParameters()
+                        parameters.SetRobotActiveJoints(robot)
+                        planningutils.VerifyTrajectory(parameters,smoothtraj,samplingstep=0.002)
+                    vwaypoints.append(smoothtraj.GetWaypoints(0,smoothtraj.GetNumWaypoints()))
+                # the same seed and number of threads give the same path
+                assert(len(vwaypoints[0]) == len(vwaypoints[1]) and transdist(vwaypoints[0],vwaypoints[1]) <= g_epsilon)
+
+    def test_parabolicsmoothingbisection(self):
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        robot=env.GetRobots()[0]
+        with env:
+            robot.SetActiveDOFs(robot.GetActiveManipulator().GetArmIndices())
+            initvalues = robot.GetActiveDOFValues()
+            goalvalues = initvalues+0.2
+            params = Planner.PlannerParameters()
+            params.SetRobotActiveJoints(robot)
+            params.SetInitialConfig(initvalues)
+            params.SetGoalConfig(goalvalues)
+            planner = RaveCreatePlanner(env,'birrt')
+            assert(planner.InitPlan(robot,params))
+            traj = RaveCreateTrajectory(env,'')
+            assert(planner.PlanPath(traj) == PlannerStatus.HasSolution)
+
+            smoother = RaveCreatePlanner(env,'parabolicsmoother')
+            for bisection in [0,1]:
+                smoothedtraj = RaveCreateTrajectory(env,'')
+                smoothedtraj.Clone(traj,0)
+                params = Planner.PlannerParameters()
+                params.SetRobotActiveJoints(robot)
+                params.SetExtraParameters('<bisectioncheckorder>%d</bisectioncheckorder><_nmaxiterations>50</_nmaxiterations>'%bisection)
+                assert(smoother.InitPlan(robot,params))
+                assert(smoother.PlanPath(smoothedtraj) == PlannerStatus.HasSolution)
+                spec = smoothedtraj.GetConfigurationSpecification()
+                assert(transdist(spec.ExtractJointValues(smoothedtraj.GetWaypoint(-1),robot,robot.GetActiveDOFIndices(),0),goalvalues) <= g_epsilon)
+                stats = {}
+                for line in smoother.SendCommand('GetStatistics').splitlines():
+                    values = line.split()
+                    stats[values[0]] = dict([(values[i],float(values[i+1])) for i in range(1,len(values),2)])
+                assert(stats['segments']['bisection'] == bisection)
+                assert(stats['segments']['numaccepted'] > 0 and stats['segments']['checkedperaccepted'] > 0)
+                with robot:
+                    parameters = Planner.PlannerParameters()
+                    parameters.SetRobotActiveJoints(robot)
+                    planningutils.VerifyTrajectory(parameters,smoothedtraj,samplingstep=0.002)
+
+    def test_onlineparabolicsmoothing(self):
+        env=self.env
+        self.LoadEnv('data/lab1.env.xml')
+        robot=env.GetRobots()[0]
+        with env:
+            robot.SetActiveDOFs(robot.GetActiveManipulator().GetArmIndices())
+            initvalues = robot.GetActiveDOFValues()
+            goalvalues = initvalues+0.2
+            params = Planner.PlannerParameters()
+            params.SetRobotActiveJoints(robot)
+            params.SetInitialConfig(initvalues)
+            params.SetGoalConfig(goalvalues)
+            planner = RaveCreatePlanner(env,'birrt')
+            assert(planner.InitPlan(robot,params))
+            traj = RaveCreateTrajectory(env,'')
+            assert(planner.PlanPath(traj) == PlannerStatus.HasSolution)
+
+            # the execution starts long after the deadline, so the deadline has to stop the shortcutting
+            params = Planner.PlannerParameters()
+            params.SetRobotActiveJoints(robot)
+            params.SetExtraParameters('<onlineleadtime>100</onlineleadtime><_nmaxplanningtime>200</_nmaxplanningtime><_nmaxiterations>1000000</_nmaxiterations>')
+            smoother = RaveCreatePlanner(env,'onlineparabolicsmoother')
+            assert(smoother.InitPlan(robot,params))
+            starttime = time.time()
+            assert(smoother.PlanPath(traj) == PlannerStatus.HasSolution)
+            assert(time.time()-starttime < 20)
+            spec = traj.GetConfigurationSpecification()
+            assert(transdist(spec.ExtractJointValues(traj.GetWaypoint(0),robot,robot.GetActiveDOFIndices(),0),initvalues) <= g_epsilon)
+            assert(transdist(spec.ExtractJointValues(traj.GetWaypoint(-1),robot,robot.GetActiveDOFIndices(),0),goalvalues) <= g_epsilon)
+            with robot:
+                parameters = Planner.PlannerParameters()
+                parameters.SetRobotActiveJoints(robot)
+                planningutils.VerifyTrajectory(parameters,traj,samplingstep=0.002)
+
 #generate_classes(RunPlanning, globals(), [('ode','ode'),('bullet','bullet')])
 
 class test_ode(RunPlanning):
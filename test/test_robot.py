@@ -121,6 +121,32 @@ class RunRobot(EnvironmentSetup):
             robot.ReleaseAllGrabbed()
             assert(env.CheckCollision(leftmug,rightmug))
             
+    def test_grabcollidinglinkscache(self):
+        env=self.env
+        with env:
+            robot=self.LoadRobot('robots/barrettwam.robot.xml')
+            manip=robot.GetActiveManipulator()
+            gripperindices = manip.GetGripperIndices()
+            lower,upper = robot.GetDOFLimits(gripperindices)
+            body=RaveCreateKinBody(env,'')
+            body.InitFromBoxes(array([[0,0,0.05,0.04,0.04,0.12]]),True)
+            body.SetName('part')
+            env.Add(body,True)
+            body.SetTransform(manip.GetTransform())
+            assert(robot.GetGrabbedCollidingLinksCacheResolution() > 0)
+            # grabbing the same way again hits the cache, the results have to be the same as without the cache
+            for grabvalues,movevalues in [(lower,upper),(upper,lower)]:
+                selfcollisions = []
+                for resolution in [0.001,0.001,0]:
+                    robot.SetGrabbedCollidingLinksCacheResolution(resolution)
+                    robot.SetDOFValues(grabvalues,gripperindices)
+                    robot.Grab(body)
+                    robot.SetDOFValues(movevalues,gripperindices)
+                    selfcollisions.append(robot.CheckSelfCollision())
+                    robot.ReleaseAllGrabbed()
+                assert(selfcollisions[0] == selfcollisions[1] and selfcollisions[0] == selfcollisions[2])
+            robot.SetGrabbedCollidingLinksCacheResolution(0.001)
+
     def test_grabcollision_dynamic(self):
         self.log.info('test if can handle grabbed bodies being enabled/disabled')
         env=self.env
@@ -631,7 +657,23 @@ class RunRobot(EnvironmentSetup):
 
         assert robot.CheckSelfCollision() # succeeds
         assert cloned_robot.CheckSelfCollision() # fails
-        
+
+    def test_activedofvaluesreuse(self):
+        # repeatedly setting values through the internal buffers has to return the same values as a single call
+        env=self.env
+        with env:
+            robot=self.LoadRobot('robots/barrettwam.robot.xml')
+            lower,upper = robot.GetDOFLimits()
+            robot.SetActiveDOFs(range(robot.GetDOF()),DOFAffine.X|DOFAffine.Y|DOFAffine.RotationAxis,[0,0,1])
+            for i in range(20):
+                values = lower+(upper-lower)*(i/19.0)
+                activevalues = r_[values,[0.1*i,-0.05*i,0.02*i]]
+                robot.SetActiveDOFValues(activevalues)
+                assert(transdist(robot.GetActiveDOFValues(),activevalues) <= g_epsilon)
+                assert(transdist(robot.GetDOFValues(),values) <= g_epsilon)
+                robot.SetDOFValues(values[3:5],[3,4])
+                assert(transdist(robot.GetDOFValues([3,4]),values[3:5]) <= g_epsilon)
+
 #generate_classes(RunRobot, globals(), [('ode','ode'),('bullet','bullet')])
 
 class test_ode(RunRobot):
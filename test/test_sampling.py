@@ -56,3 +56,32 @@ class TestSampling(EnvironmentSetup):
         robot.SetActiveDOFs(range(robot.GetDOF()-4),Robot.DOFAffine.X|Robot.DOFAffine.Y|Robot.DOFAffine.RotationAxis,[0,0,1])
         values = sp.SampleSequence(SampleDataType.Real,1)
         assert(len(values[0]) == robot.GetActiveDOF())
+
+    def test_blocksampling(self):
+        sp=RaveCreateSpaceSampler(self.env,'MT19937')
+        sp.SetSpaceDOF(3)
+        for interval in [Interval.Closed, Interval.Open, Interval.OpenEnd, Interval.OpenStart]:
+            # more values than the mt19937 state so the state is regenerated in the middle of a block
+            sp.SetSeed(10)
+            blockvalues = sp.SampleSequence2D(SampleDataType.Real,1000,interval)
+            sp.SetSeed(10)
+            for i in range(1000):
+                values = sp.SampleSequence2D(SampleDataType.Real,1,interval)
+                assert(transdist(values[0],blockvalues[i]) == 0)
+
+    def test_substreams(self):
+        for samplername in ['MT19937','Halton']:
+            sp=RaveCreateSpaceSampler(self.env,samplername)
+            if sp is None:
+                continue
+            sp.SetSpaceDOF(2)
+            sp.SetSeed(5)
+            values0 = sp.CreateSubstream(0,2).SampleSequence2D(SampleDataType.Real,100)
+            values1 = sp.CreateSubstream(1,2).SampleSequence2D(SampleDataType.Real,100)
+            assert(transdist(values0,sp.CreateSubstream(0,2).SampleSequence2D(SampleDataType.Real,100)) == 0)
+            assert(transdist(values0,values1) > 0)
+            if samplername == 'Halton':
+                # substreams leapfrog the sequence
+                values = sp.SampleSequence2D(SampleDataType.Real,200)
+                assert(transdist(values[0::2],values0) <= g_epsilon)
+                assert(transdist(values[1::2],values1) <= g_epsilon)
@@ -393,7 +393,47 @@ class TestTrajectory(EnvironmentSetup):
         assert(ret == PlannerStatus.HasSolution)
         self.RunTrajectory(robot, traj)
         assert( abs(traj.GetDuration()-1.01688888888873) < g_epsilon)
-        
+
+    def test_jerklimitedretiming(self):
+        env=self.env
+        robot=self.LoadRobot('robots/pumaarm.zae')
+        vellimits = array([7.854, 7.854, 5.236, 9.4248, 10.8747, 12.5664])
+        accellimits = array([26.18, 19.635, 14.96, 47.124, 36.249, 41.888])
+        jerklimits = array([100.0, 80.0, 60.0, 200.0, 150.0, 170.0])
+        robot.SetDOFVelocityLimits(vellimits)
+        robot.SetDOFAccelerationLimits(accellimits)
+        robot.SetDOFLimits(array([-4.1887902047863905, -2.0943951023931953,  0.                , -3.4906585039886591, -2.0943951023931953, -6.2831853071795862]),
+                           array([ 4.1887902047863905,  2.0943951023931953,  2.8099800957108707, 3.4906585039886591,  2.0943951023931953,  6.2831853071795862]))
+        controller_timestep = 0.00711111111111
+        points = [[-1.5, -0.5, 2.7, 3.1, 0.6, 6.2], [1.5, 0.3, 2.4, -3.1, 1.1, 0.0], [1.0, 0.2, 2.0, -2.0, 1.0, 0.5]]
+        traj = RaveCreateTrajectory(robot.GetEnv(),'')
+        traj.Init(robot.GetActiveConfigurationSpecification())
+        for i, point in enumerate(points):
+            traj.Insert(i,point)
+        retimer = planningutils.ActiveDOFTrajectoryRetimer(robot, plannername='JerkLimitedTrajectoryRetimer',plannerparameters='<_fsteplength>%.15e</_fsteplength><_vconfigjerklimit>%s</_vconfigjerklimit>'%(controller_timestep, ' '.join(str(f) for f in jerklimits)))
+        ret=retimer.PlanPath(traj,False)
+        assert(ret == PlannerStatus.HasSolution)
+        # every segment starts and ends at rest, so its time is the closed-form minimum over all dofs rounded up to the time step
+        expectedduration = 0
+        for i in range(len(points)-1):
+            px = abs(array(points[i+1])-array(points[i]))
+            mintime = max(max(1.875*px/vellimits), max(sqrt(10/sqrt(3.0)*px/accellimits)), max((60*px/jerklimits)**(1.0/3)))
+            expectedduration += ceil(mintime/controller_timestep-1e-7)*controller_timestep
+        assert( abs(traj.GetDuration()-expectedduration) < 1e-6)
+        spec = traj.GetConfigurationSpecification()
+        for t in arange(0,traj.GetDuration(),0.001):
+            data = traj.Sample(t)
+            accel = spec.ExtractJointValues(data,robot,robot.GetActiveDOFIndices(),2)
+            assert(all(abs(accel) <= accellimits+1e-6))
+            jerk = spec.ExtractJointValues(data,robot,robot.GetActiveDOFIndices(),3)
+            assert(all(abs(jerk) <= jerklimits+1e-6))
+        # the waypoints are at rest
+        for i in range(traj.GetNumWaypoints()):
+            data = traj.GetWaypoint(i)
+            assert(all(abs(spec.ExtractJointValues(data,robot,robot.GetActiveDOFIndices(),1)) <= g_epsilon))
+            assert(all(abs(spec.ExtractJointValues(data,robot,robot.GetActiveDOFIndices(),2)) <= g_epsilon))
+        self.RunTrajectory(robot, traj)
+
     def test_ikparamretiming(self):
         self.log.info('retime workspace ikparam')
         env=self.env
@@ -678,6 +718,44 @@ class TestTrajectory(EnvironmentSetup):
             self.RunTrajectory(robot,rtraj1)
             assert( transdist(originalvalues, robot.GetConfigurationValues()) <= g_epsilon)
 
+    def test_trajectoryviews(self):
+        self.log.info('segment and reverse views read the same data as the copies and can be modified')
+        env=self.env
+        robot=self.LoadRobot('robots/pumaarm.zae')
+        traj = RaveCreateTrajectory(env,'')
+        traj.Init(robot.GetActiveConfigurationSpecification())
+        traj.Insert(0,robot.GetActiveDOFValues())
+        traj.Insert(1,robot.GetActiveDOFValues()+0.5)
+        traj.Insert(2,robot.GetActiveDOFValues()-0.2)
+        planningutils.RetimeActiveDOFTrajectory(traj,robot,False)
+        numpoints = traj.GetNumWaypoints()
+        rtraj = planningutils.GetReverseTrajectory(traj)
+        rview = planningutils.GetReverseTrajectoryView(traj)
+        assert( rview.GetNumWaypoints() == numpoints )
+        assert( abs(rview.GetDuration()-traj.GetDuration()) <= g_epsilon )
+        assert( sum(abs(rview.GetWaypoints(0,numpoints)-rtraj.GetWaypoints(0,numpoints))) <= g_epsilon )
+        assert( sum(abs(rview.GetWaypoints(1,numpoints-1)-rtraj.GetWaypoints(1,numpoints-1))) <= g_epsilon )
+        for t in linspace(0,traj.GetDuration(),10):
+            assert( sum(abs(rview.Sample(t)-rtraj.Sample(t))) <= 1e-7 )
+        starttime = 0.25*traj.GetDuration()
+        endtime = 0.75*traj.GetDuration()
+        sview = planningutils.GetTrajectorySegmentView(traj,starttime,endtime)
+        straj = planningutils.GetTrajectorySegment(traj,starttime,endtime)
+        assert( sview.GetNumWaypoints() == straj.GetNumWaypoints() )
+        assert( abs(sview.GetDuration()-(endtime-starttime)) <= g_epsilon )
+        spec = traj.GetConfigurationSpecification()
+        for t in linspace(0,endtime-starttime,10):
+            assert( sum(abs(spec.ExtractJointValues(sview.Sample(t),robot,robot.GetActiveDOFIndices())-spec.ExtractJointValues(traj.Sample(starttime+t),robot,robot.GetActiveDOFIndices()))) <= 1e-7 )
+        # writing copies the view, the source is untouched
+        sourcedata = traj.GetWaypoints(0,numpoints)
+        sview.Remove(0,1)
+        assert( sview.GetNumWaypoints() == straj.GetNumWaypoints()-1 )
+        assert( all(traj.GetWaypoints(0,numpoints) == sourcedata) )
+        # a segment over the whole trajectory keeps all the waypoints
+        straj = planningutils.GetTrajectorySegment(traj,0,traj.GetDuration())
+        assert( straj.GetNumWaypoints() == numpoints )
+        assert( sum(abs(straj.GetWaypoints(0,numpoints)-sourcedata)) <= g_epsilon )
+
     def test_worktraj(self):
         self.log.debug('test workspace trajerctory with ikparameterization')
         env=self.env
@@ -855,3 +933,157 @@ class TestTrajectory(EnvironmentSetup):
         planningutils.SegmentTrajectory(traj, startoffset, duration)
         assert( abs(traj.GetDuration() - (duration-startoffset)) <= g_epsilon )
 
+
+    def test_samplepointsspec(self):
+        self.log.info('bulk sampling in a different specification matches single sampling')
+        env=self.env
+        trajstr = '''<trajectory>
+<configuration>
+<group name="deltatime" offset="12" dof="1" interpolation=""/>
+<group name="joint_velocities muratecpicker0 0 1 2 3 4 5" offset="6" dof="6" interpolation="linear"/>
+<group name="joint_values muratecpicker0 0 1 2 3 4 5" offset="0" dof="6" interpolation="quadratic"/>
+<group name="iswaypoint" offset="13" dof="1" interpolation="next"/>
+</configuration>
+<data count="3">
+0.6117269650558744 0.9266602002674107 0.8438166789174414 0 1.371115774404944 -0.9590693617390226 0 0 0 0 0 0 0 1 1.17529158313744 0.189183598445679 1.49708779104353 -0.001910739864792349 1.446569660068643 0.1559566101894805 2.196724161297836 -2.874617422095069 2.546392001631284 -0.00744789202919198 0.294112455578719 4.346270887885016 0.5130954791780579 0 1.738856201219005 -0.5482930033760525 2.150358903169619 -0.003821479729584697 1.522023545732342 1.270982582117983 0 0 0 0 0 0 0.5130954791780579 1 </data>
+</trajectory>
+        '''
+        traj=RaveCreateTrajectory(env, '')
+        traj.deserialize(trajstr)
+        spec = ConfigurationSpecification()
+        spec.AddGroup('joint_values muratecpicker0 0 1 2 3 4 5', 6, 'quadratic')
+        spec.AddGroup('iswaypoint', 1, 'next')
+        times = r_[arange(0,traj.GetDuration()+0.1,0.01), traj.GetDuration()*random.rand(50)]
+        data = traj.SamplePoints2D(times, spec)
+        for i, t in enumerate(times):
+            assert( sum(abs(data[i]-traj.Sample(t, spec))) <= g_epsilon )
+
+    def test_samplepointssamedeltatime(self):
+        self.log.info('uniform bulk sampling matches single sampling')
+        env=self.env
+        robot=self.LoadRobot('robots/pumaarm.zae')
+        traj = RaveCreateTrajectory(env,'')
+        traj.Init(robot.GetActiveConfigurationSpecification())
+        traj.Insert(0,robot.GetActiveDOFValues())
+        traj.Insert(1,robot.GetActiveDOFValues()+0.5)
+        traj.Insert(2,robot.GetActiveDOFValues()-0.2)
+        planningutils.RetimeActiveDOFTrajectory(traj,robot,False)
+        deltatime = 0.003
+        spec = robot.GetActiveConfigurationSpecification()
+        for ensurelastpoint in [False,True]:
+            data = traj.SamplePointsSameDeltaTime2D(deltatime,ensurelastpoint,spec)
+            numpoints = int(traj.GetDuration()/deltatime)+1
+            if ensurelastpoint and (numpoints-1)*deltatime+g_epsilon < traj.GetDuration():
+                numpoints += 1
+            assert( len(data) == numpoints )
+            for i in range(numpoints):
+                assert( sum(abs(data[i]-traj.Sample(min(i*deltatime,traj.GetDuration()),spec))) <= g_epsilon )
+            data = traj.SamplePointsSameDeltaTime2D(deltatime,ensurelastpoint)
+            assert( sum(abs(data[-1]-traj.Sample(min((numpoints-1)*deltatime,traj.GetDuration())))) <= g_epsilon )
+
+    def test_binaryserialization(self):
+        self.log.info('binary trajectory serialization matches the xml one')
+        env=self.env
+        robot=self.LoadRobot('robots/pumaarm.zae')
+        traj = RaveCreateTrajectory(env,'')
+        traj.Init(robot.GetActiveConfigurationSpecification())
+        traj.Insert(0,robot.GetActiveDOFValues())
+        traj.Insert(1,robot.GetActiveDOFValues()+0.5)
+        traj.Insert(2,robot.GetActiveDOFValues()-0.2)
+        planningutils.RetimeActiveDOFTrajectory(traj,robot,False)
+        traj.SetDescription('binary test')
+        data = traj.serialize(SerializationOptions.BinaryTrajectory)
+        assert( len(data) < len(traj.serialize(0)) )
+        traj2 = RaveCreateTrajectory(env,'').deserialize(data)
+        assert( traj2.GetConfigurationSpecification() == traj.GetConfigurationSpecification() )
+        assert( traj2.GetNumWaypoints() == traj.GetNumWaypoints() )
+        assert( all(traj2.GetWaypoints(0,traj2.GetNumWaypoints()) == traj.GetWaypoints(0,traj.GetNumWaypoints())) )
+        assert( traj2.GetDescription() == 'binary test' )
+        assert( abs(traj2.GetDuration()-traj.GetDuration()) <= g_epsilon )
+        # xml still works
+        traj3 = RaveCreateTrajectory(env,'').deserialize(traj.serialize(0))
+        assert( traj3.GetNumWaypoints() == traj.GetNumWaypoints() )
+
+    def test_compactstorage(self):
+        self.log.info('trajectories in the compact storage sample within single precision and keep exact durations')
+        env=self.env
+        robot=self.LoadRobot('robots/pumaarm.zae')
+        traj = RaveCreateTrajectory(env,'')
+        traj.Init(robot.GetActiveConfigurationSpecification())
+        traj.Insert(0,robot.GetActiveDOFValues())
+        traj.Insert(1,robot.GetActiveDOFValues()+0.5)
+        traj.Insert(2,robot.GetActiveDOFValues()-0.2)
+        planningutils.RetimeActiveDOFTrajectory(traj,robot,False)
+        traj2 = RaveCreateTrajectory(env,'')
+        traj2.Clone(traj,0)
+        assert( traj2.SendCommand('GetCompactStorage') == '0' )
+        assert( traj2.SendCommand('SetCompactStorage 1') is not None )
+        assert( traj2.SendCommand('GetCompactStorage') == '1' )
+        assert( traj2.GetNumWaypoints() == traj.GetNumWaypoints() )
+        assert( traj2.GetDuration() == traj.GetDuration() )
+        for t in linspace(0,traj.GetDuration(),20):
+            assert( sum(abs(traj2.Sample(t)-traj.Sample(t))) <= 1e-5 )
+        sampler = traj2.CreateSampler(robot.GetActiveConfigurationSpecification())
+        assert( sum(abs(sampler.Sample(0.5*traj.GetDuration())-traj.Sample(0.5*traj.GetDuration(),robot.GetActiveConfigurationSpecification()))) <= 1e-5 )
+        # modifications keep the storage compact
+        traj2.Insert(traj2.GetNumWaypoints(),traj.GetWaypoint(-1))
+        assert( traj2.GetNumWaypoints() == traj.GetNumWaypoints()+1 )
+        assert( traj2.SendCommand('GetCompactStorage') == '1' )
+        traj3 = RaveCreateTrajectory(env,'').deserialize(traj2.serialize(SerializationOptions.BinaryTrajectory))
+        assert( sum(abs(traj3.GetWaypoints(0,traj3.GetNumWaypoints())-traj2.GetWaypoints(0,traj2.GetNumWaypoints()))) == 0 )
+        traj2.SendCommand('SetCompactStorage 0')
+        assert( sum(abs(traj2.GetWaypoints(0,traj.GetNumWaypoints())-traj.GetWaypoints(0,traj.GetNumWaypoints()))) <= 1e-5*len(traj.GetWaypoints(0,traj.GetNumWaypoints())) )
+
+    def test_waypointsview(self):
+        self.log.info('waypoint views share the trajectory data and arrays can be filled in place')
+        env=self.env
+        robot=self.LoadRobot('robots/pumaarm.zae')
+        traj = RaveCreateTrajectory(env,'')
+        traj.Init(robot.GetActiveConfigurationSpecification())
+        traj.Insert(0,robot.GetActiveDOFValues())
+        traj.Insert(1,robot.GetActiveDOFValues()+0.5)
+        view = traj.GetAllWaypointsView()
+        assert( view.shape == (2,robot.GetActiveDOF()) )
+        assert( all(view == traj.GetAllWaypoints2D()) )
+        assert( not view.flags.writeable )
+        del traj
+        assert( all(view[1] == robot.GetActiveDOFValues()+0.5) ) # view keeps the trajectory alive
+        out = zeros(robot.GetDOF())
+        robot.SetDOFValues(robot.GetDOFValues()+0.1)
+        robot.GetDOFValuesToArray(out)
+        assert( all(out == robot.GetDOFValues()) )
+        outtransforms = zeros((len(robot.GetLinks()),4,4))
+        robot.GetLinkTransformationsToArray(outtransforms)
+        assert( all(outtransforms == array(robot.GetLinkTransformations())) )
+        try:
+            robot.GetDOFValuesToArray(zeros(robot.GetDOF()+1))
+            assert(False)
+        except openrave_exception:
+            pass
+
+    def test_convertdata(self):
+        self.log.info('converting between specifications reorders joints and fills missing values from the environment')
+        env=self.env
+        robot=self.LoadRobot('robots/pumaarm.zae')
+        sourcespec = ConfigurationSpecification()
+        sourcespec.AddGroup('joint_values %s 2 0 1'%robot.GetName(), 3, 'linear')
+        sourcespec.AddDeltaTimeGroup()
+        targetspec = robot.GetConfigurationSpecification()
+        targetspec.AddDeltaTimeGroup()
+        sourcedata = r_[0.3,0.1,0.2,0.5, -0.3,-0.1,-0.2,0.7]
+        for iteration in range(2):
+            robot.SetDOFValues(robot.GetDOFValues()+0.1)
+            targetdata = reshape(sourcespec.ConvertData(targetspec, sourcedata, 2, env, True), (2,targetspec.GetDOF()))
+            for i in range(2):
+                assert( all(targetdata[i][:3] == sourcedata[4*i:4*i+3][[1,2,0]]) )
+                assert( sum(abs(targetdata[i][3:robot.GetDOF()]-robot.GetDOFValues()[3:])) <= g_epsilon )
+                assert( targetdata[i][-1] == sourcedata[4*i+3] )
+        # trajectories cache the conversions they are sampled with, the cache must not hide changes of the environment
+        traj = RaveCreateTrajectory(env,'')
+        traj.Init(sourcespec)
+        traj.Insert(0,sourcedata)
+        for iteration in range(2):
+            robot.SetDOFValues(robot.GetDOFValues()+0.1)
+            data = traj.Sample(0,targetspec)
+            assert( sum(abs(data[3:robot.GetDOF()]-robot.GetDOFValues()[3:])) <= g_epsilon )
+            assert( all(traj.GetWaypoint(1,targetspec)[:3] == sourcedata[4:7][[1,2,0]]) )